@@ -11,6 +11,7 @@
 STDMETHODIMP CProjDef::Initialize(BSTR proj_string, int *success)
 {
 	USES_CONVERSION;
+	DropPlan();
 	psProj = pj_init_plus( W2A(proj_string) );
 
 	if( psProj != NULL )
@@ -25,13 +26,52 @@ STDMETHODIMP CProjDef::Initialize(BSTR proj_string, int *success)
 	return S_OK;
 }
 
-STDMETHODIMP CProjDef::TransformPoint3D(IUnknown *srcProj, double *x, double *y, double *z, int *success)
+void *CProjDef::GetSource( IUnknown *srcProj )
 {
-	void *psProjOther;
+	void *psProjOther = NULL;
 	IProjDef *srcProjReal;
 
-	srcProj->QueryInterface( IID_IProjDef, (void **) &srcProjReal );
-	srcProjReal->GetHandle( (long *) &psProjOther );
+	if( srcProj->QueryInterface( IID_IProjDef, (void **) &srcProjReal ) == S_OK )
+	{
+		srcProjReal->GetHandle( (long *) &psProjOther );
+		srcProjReal->Release();
+	}
+
+	return psProjOther;
+}
+
+// pj_transform() from psProjOther, or the kept plan, rebuilt when the
+// source changes.
+int CProjDef::Transform( void *psProjOther, long point_count, int point_offset,
+                         double *x, double *y, double *z )
+{
+	if( !bKeepPlan )
+		return pj_transform( psProjOther, psProj, point_count, point_offset, x, y, z );
+
+	if( psPlan == NULL || psPlanSrc != psProjOther )
+	{
+		DropPlan();
+		psPlan = pj_transform_plan_create( (projPJ) psProjOther, (projPJ) psProj );
+		if( psPlan == NULL )
+			return *pj_get_errno_ref() != 0 ? *pj_get_errno_ref() : -1;
+		psPlanSrc = psProjOther;
+	}
+
+	return pj_transform_plan_execute( (projTransformPlan) psPlan, 
+	                                  point_count, point_offset, x, y, z );
+}
+
+void CProjDef::DropPlan()
+{
+	if( psPlan != NULL )
+		pj_transform_plan_free( (projTransformPlan) psPlan );
+	psPlan = NULL;
+	psPlanSrc = NULL;
+}
+
+STDMETHODIMP CProjDef::TransformPoint3D(IUnknown *srcProj, double *x, double *y, double *z, int *success)
+{
+	void *psProjOther = GetSource( srcProj );
 
 	if( psProjOther == NULL || psProj == NULL )
 	{
@@ -46,7 +86,7 @@ STDMETHODIMP CProjDef::TransformPoint3D(IUnknown *srcProj, double *x, double *y,
 		*y *= DEG_TO_RAD;
 	}
 
-	*success = pj_transform( psProjOther, psProj, 1, 0, x, y, z ) == 0;
+	*success = Transform( psProjOther, 1, 0, x, y, z ) == 0;
 	if( ! *success )
 		SetProjError( "pj_transform failed." );
 
@@ -59,6 +99,102 @@ STDMETHODIMP CProjDef::TransformPoint3D(IUnknown *srcProj, double *x, double *y,
 	return S_OK;
 }
 
+// Element count of a one dimensional array of doubles, or -1.
+static long ArrayCount( SAFEARRAY *psa )
+{
+	long lower, upper;
+
+	if( psa == NULL || SafeArrayGetDim( psa ) != 1 
+	    || SafeArrayGetElemsize( psa ) != sizeof(double)
+	    || FAILED(SafeArrayGetLBound( psa, 1, &lower ))
+	    || FAILED(SafeArrayGetUBound( psa, 1, &upper )) )
+		return -1;
+
+	return upper - lower + 1;
+}
+
+// All the points of the x, y and z arrays in one pj_transform() call,
+// the values of a point being point_offset elements after those of the
+// previous one.  z may be an empty array for points without heights.
+STDMETHODIMP CProjDef::TransformPoints(IUnknown *srcProj, long point_offset, 
+                                       SAFEARRAY **x, SAFEARRAY **y, SAFEARRAY **z, 
+                                       int *success)
+{
+	void   *psProjOther = GetSource( srcProj );
+	double *px = NULL, *py = NULL, *pz = NULL;
+	long    x_count, y_count, z_count, point_count, needed, i;
+
+	*success = 0;
+	if( psProjOther == NULL || psProj == NULL )
+	{
+		SetError( "One of projections not set." );
+		return E_FAIL;
+	}
+	if( point_offset < 1 )
+		point_offset = 1;
+
+	x_count = ArrayCount( *x );
+	y_count = ArrayCount( *y );
+	z_count = z != NULL && *z != NULL ? ArrayCount( *z ) : 0;
+	point_count = x_count > 0 ? (x_count + point_offset - 1) / point_offset : 0;
+	needed = point_count > 0 ? (point_count - 1) * point_offset + 1 : 0;
+	if( x_count < 0 || y_count < needed || (z_count != 0 && z_count < needed) )
+	{
+		SetError( "Arrays of doubles of the same length expected." );
+		return E_INVALIDARG;
+	}
+	if( point_count == 0 )
+	{
+		*success = 1;
+		return S_OK;
+	}
+
+	SafeArrayAccessData( *x, (void **) &px );
+	SafeArrayAccessData( *y, (void **) &py );
+	if( z_count != 0 )
+		SafeArrayAccessData( *z, (void **) &pz );
+
+	if( pj_is_latlong( psProjOther ) )
+	{
+		for( i = 0; i < point_count; i++ )
+		{
+			px[i * point_offset] *= DEG_TO_RAD;
+			py[i * point_offset] *= DEG_TO_RAD;
+		}
+	}
+
+	*success = Transform( psProjOther, point_count, point_offset, px, py, pz ) == 0;
+	if( ! *success )
+		SetProjError( "pj_transform failed." );
+
+	else if( pj_is_latlong( psProj ) )
+	{
+		for( i = 0; i < point_count; i++ )
+		{
+			px[i * point_offset] *= RAD_TO_DEG;
+			py[i * point_offset] *= RAD_TO_DEG;
+		}
+	}
+
+	if( pz != NULL )
+		SafeArrayUnaccessData( *z );
+	SafeArrayUnaccessData( *y );
+	SafeArrayUnaccessData( *x );
+
+	return S_OK;
+}
+
+// Keep a transform plan between the source and this definition from one
+// call to the next, rather than resolving the pipeline on every call.
+STDMETHODIMP CProjDef::KeepPlan(int keep)
+{
+	bKeepPlan = keep != 0;
+	if( !bKeepPlan )
+		DropPlan();
+
+	return S_OK;
+}
+
 STDMETHODIMP CProjDef::GetHandle(long *pHandle)
 {
 	*pHandle = (long) psProj;
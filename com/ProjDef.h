@@ -16,6 +16,9 @@ public:
 	CProjDef()
 	{
 		psProj = NULL;
+		psPlan = NULL;
+		psPlanSrc = NULL;
+		bKeepPlan = FALSE;
 		sLastError = NULL;
 		SetError("");
 	}
@@ -24,6 +27,11 @@ DECLARE_REGISTRY_RESOURCEID(IDR_PROJDEF)
 
 DECLARE_PROTECT_FINAL_CONSTRUCT()
 
+	void FinalRelease()
+	{
+		DropPlan();
+	}
+
 BEGIN_COM_MAP(CProjDef)
 	COM_INTERFACE_ENTRY(IProjDef)
 	COM_INTERFACE_ENTRY(IDispatch)
@@ -36,13 +44,22 @@ public:
 	STDMETHOD(GetHandle)(long *pHandle);
 	STDMETHOD(TransformPoint3D)(IUnknown *srcProj, double *x, double *y, double *z, int *success);
 	STDMETHOD(Initialize)(BSTR proj_string, int *success);
+	STDMETHOD(TransformPoints)(IUnknown *srcProj, long point_offset, SAFEARRAY **x, SAFEARRAY **y, SAFEARRAY **z, int *success);
+	STDMETHOD(KeepPlan)(int keep);
 
 private:
 	void  SetError( const char *pszMessage );
 	void  SetProjError( const char *pszMessage );
+	void *GetSource( IUnknown *srcProj );
+	int   Transform( void *psProjOther, long point_count, int point_offset, 
+	                 double *x, double *y, double *z );
+	void  DropPlan();
 
 	BSTR  sLastError;
 	void *psProj;
+	void *psPlan;		// transform plan from psPlanSrc, see KeepPlan()
+	void *psPlanSrc;
+	BOOL  bKeepPlan;
 
 };
 
@@ -32,6 +32,12 @@
  */
 package org.proj4;
 
+import java.nio.ByteOrder;
+import java.nio.DoubleBuffer;
+import java.nio.ReadOnlyBufferException;
+import java.util.LinkedHashMap;
+import java.util.Map;
+
 
 /**
  * Wraps the <a href="http://proj.osgeo.org/">Proj4</a> {@code PJ} native data structure.
@@ -44,6 +50,10 @@ package org.proj4;
  * {@link org.opengis.referencing.cs.CoordinateSystem}, {@link org.opengis.referencing.crs.CoordinateReferenceSystem}
  * and their sub-interfaces. The relationship with the GeoAPI methods is indicated in the
  * "See" tags when appropriate.
+ * <p>
+ * Each {@code PJ} object has its own Proj.4 context, so different threads can use different
+ * objects concurrently. A single object shall not be used by many threads at the same time:
+ * see {@link #PJ(PJ)} and {@link #forCurrentThread(String)} for getting one object per thread.
  *
  * @author  Martin Desruisseaux (Geomatys)
  */
@@ -107,6 +117,63 @@ public class PJ {
         }
     }
 
+    /**
+     * Creates a copy of the given {@code PJ} structure. The copy has the same definition,
+     * but it is independent of the original: the two objects can be used concurrently by
+     * different threads.
+     *
+     * @param  crs The CRS to copy.
+     * @throws IllegalArgumentException If the PJ structure can not be created.
+     */
+    public PJ(final PJ crs) throws IllegalArgumentException {
+        if (crs == null) {
+            // TODO: Use Objects with JDK 7.
+            throw new NullPointerException("The CRS must be non-null.");
+        }
+        ptr = allocateClonePJ(crs);
+        if (ptr == 0) {
+            throw new IllegalArgumentException(crs.getDefinition());
+        }
+    }
+
+    /**
+     * Returns a {@code PJ} structure for the given definition string, reserved to the calling thread.
+     * Each thread keeps a pool of the last {@value #POOL_SIZE} definitions it used, so worker threads
+     * can transform concurrently without any synchronization, and without parsing the same definition
+     * each time. The returned object shall not be given to another thread.
+     *
+     * @param  definition The Proj.4 definition string.
+     * @return The PJ structure of the calling thread for the given definition.
+     * @throws IllegalArgumentException If the PJ structure can not be created from the given string.
+     */
+    public static PJ forCurrentThread(final String definition) throws IllegalArgumentException {
+        final Map<String,PJ> pool = POOL.get();
+        PJ pj = pool.get(definition);
+        if (pj == null) {
+            pj = new PJ(definition);
+            pool.put(definition, pj);
+        }
+        return pj;
+    }
+
+    /**
+     * Maximal number of definitions kept by the pool of each thread in {@link #forCurrentThread(String)}.
+     */
+    private static final int POOL_SIZE = 64;
+
+    /**
+     * The {@code PJ} structures of each thread, by definition string, in access order.
+     */
+    private static final ThreadLocal<Map<String,PJ>> POOL = new ThreadLocal<Map<String,PJ>>() {
+        @Override protected Map<String,PJ> initialValue() {
+            return new LinkedHashMap<String,PJ>(16, 0.75f, true) {
+                @Override protected boolean removeEldestEntry(final Map.Entry<String,PJ> eldest) {
+                    return size() > POOL_SIZE;
+                }
+            };
+        }
+    };
+
     /**
      * Allocates a PJ native data structure and returns the pointer to it. This method should be
      * invoked by the constructor only, and the return value <strong>must</strong> be assigned
@@ -129,6 +196,16 @@ public class PJ {
      */
     private static native long allocateGeoPJ(PJ projected);
 
+    /**
+     * Allocates a copy of the given PJ native data structure, with its own context. This method
+     * should be invoked by the constructor only, and the return value <strong>must</strong> be
+     * assigned to the {@link #ptr} field.
+     *
+     * @param  original The PJ object to copy.
+     * @return A pointer to the PJ native data structure, or 0 if the operation failed.
+     */
+    private static native long allocateClonePJ(PJ original);
+
     /**
      * Returns the version number of the Proj4 library.
      *
@@ -269,6 +346,51 @@ public class PJ {
     public native void transform(PJ target, int dimension, double[] coordinates, int offset, int numPts)
             throws PJException;
 
+    /**
+     * Transforms in-place the coordinates in the given buffer. This method is identical to
+     * {@link #transform(PJ, int, double[], int, int)} except that the coordinates are read
+     * from a {@link DoubleBuffer}. Direct buffers in the native byte order are transformed
+     * where they are, without any copy and without blocking the garbage collector. Other
+     * buffers shall be backed by an accessible array.
+     *
+     * @param  target The target CRS.
+     * @param  dimension The dimension of each coordinate value. Must be in the [2-{@value #DIMENSION_MAX}] range.
+     * @param  coordinates The coordinates to transform, as a sequence of
+     *         (<var>x</var>,<var>y</var>,&lt;<var>z</var>&gt;,&hellip;) tuples.
+     * @param  offset Index in the buffer of the first coordinate, ignoring the buffer position.
+     * @param  numPts Number of points to transform.
+     * @throws NullPointerException If the {@code target} or {@code coordinates} argument is null.
+     * @throws IndexOutOfBoundsException if the {@code offset} or {@code numPts} arguments are invalid.
+     * @throws ReadOnlyBufferException If the buffer is read-only.
+     * @throws IllegalArgumentException If the buffer is neither direct in native order nor backed by an array.
+     * @throws PJException If the operation failed for an other reason (provided by Proj4).
+     */
+    public void transform(PJ target, int dimension, DoubleBuffer coordinates, int offset, int numPts)
+            throws PJException
+    {
+        if (coordinates.isReadOnly()) {
+            throw new ReadOnlyBufferException();
+        }
+        if (coordinates.isDirect() && coordinates.order() == ByteOrder.nativeOrder()) {
+            transformDirect(target, dimension, coordinates, offset, numPts);
+        } else if (coordinates.hasArray()) {
+            if (offset < 0 || numPts < 0 || offset + (long) dimension * numPts > coordinates.capacity()) {
+                throw new IndexOutOfBoundsException("Illegal offset or illegal number of points.");
+            }
+            transform(target, dimension, coordinates.array(), coordinates.arrayOffset() + offset, numPts);
+        } else {
+            throw new IllegalArgumentException("The buffer must be direct in native order or backed by an array.");
+        }
+    }
+
+    /**
+     * Transforms in-place the coordinates in the given direct buffer in native byte order.
+     *
+     * @see #transform(PJ, int, DoubleBuffer, int, int)
+     */
+    private native void transformDirect(PJ target, int dimension, DoubleBuffer coordinates, int offset, int numPts)
+            throws PJException;
+
     /**
      * Returns a description of the last error that occurred, or {@code null} if none.
      *
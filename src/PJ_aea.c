@@ -38,10 +38,12 @@
 	double	phi1; \
 	double	phi2; \
 	double	*en; \
+	double	*apa; \
 	int		ellips;
 
 #define PJ_LIB__
 #include <projects.h>
+#include <pj_math.h>
 
 PJ_CVSID("$Id$");
 
@@ -56,29 +58,51 @@ PROJ_HEAD(leac, "Lambert Equal Area Conic")
 # define N_ITER 15
 # define EPSILON 1.0e-7
 # define TOL 1.0e-10
+	static PJ_INLINE double /* the Newton step of phi1_(), negated */
+newton_step(double Phi, double qs, PJ *P) {
+	double sinpi, cospi, con, com;
+
+	pj_sincos(Phi, &sinpi, &cospi);
+	con = P->e * sinpi;
+	com = 1. - con * con;
+	return -(.5 * com * com / cospi * (qs / P->one_es -
+	   sinpi / com + .5 / P->e * log ((1. - con) /
+	   (1. + con))));
+}
+	static PJ_INLINE double /* authalic latitude of phi1_() */
+phi1_beta(double qs, PJ *P) {
+	double s = qs / P->ec;
+
+	/* past the pole, which the callers let through within TOL7 */
+	if (!(fabs(s) < 1.))
+		return HUGE_VAL;
+	return asin(s);
+}
+	static PJ_INLINE double /* start of phi1_(), from the authalic latitude */
+phi1_start(double qs, PJ *P) {
+	double beta = phi1_beta(qs, P);
+
+	return beta == HUGE_VAL ? HUGE_VAL : pj_authlat_i(beta, P->apa);
+}
 	static double
-phi1_(double qs, double Te, double Tone_es) {
+phi1_(double qs, PJ *P) {
 	int i;
-	double Phi, sinpi, cospi, con, com, dphi;
-
-	Phi = asin (.5 * qs);
-	if (Te < EPSILON)
-		return( Phi );
-	i = N_ITER;
-	do {
-		sinpi = sin (Phi);
-		cospi = cos (Phi);
-		con = Te * sinpi;
-		com = 1. - con * con;
-		dphi = .5 * com * com / cospi * (qs / Tone_es -
-		   sinpi / com + .5 / Te * log ((1. - con) /
-		   (1. + con)));
-		Phi += dphi;
-	} while (fabs(dphi) > TOL && --i);
+	double Phi, dphi;
+
+	if (P->e < EPSILON)
+		return( asin (.5 * qs) );
+	/* within about e^8 of the root, one step short of rounding */
+	if ((Phi = phi1_start(qs, P)) == HUGE_VAL)
+		return HUGE_VAL;
+	for (i = N_ITER; i; --i) {
+		Phi -= dphi = newton_step(Phi, qs, P);
+		if (fabs(dphi) < TOL)
+			break;
+	}
 	return( i ? Phi : HUGE_VAL );
 }
 FORWARD(e_forward); /* ellipsoid & spheroid */
-	if ((P->rho = P->c - (P->ellips ? P->n * pj_qsfn(sin(lp.phi),
+	if ((P->rho = P->c - (P->ellips ? P->n * pj_qsfn_i(sin(lp.phi),
 		P->e, P->one_es) : P->n2 * sin(lp.phi))) < 0.) F_ERROR
 	P->rho = P->dd * sqrt(P->rho);
 	xy.x = P->rho * sin( lp.lam *= P->n );
@@ -96,7 +120,7 @@ INVERSE(e_inverse) /* ellipsoid & spheroid */;
 		if (P->ellips) {
 			lp.phi = (P->c - lp.phi * lp.phi) / P->n;
 			if (fabs(P->ec - fabs(lp.phi)) > TOL7) {
-				if ((lp.phi = phi1_(lp.phi, P->e, P->one_es)) == HUGE_VAL)
+				if ((lp.phi = phi1_(lp.phi, P)) == HUGE_VAL)
 					I_ERROR
 			} else
 				lp.phi = lp.phi < 0. ? -HALFPI : HALFPI;
@@ -111,7 +135,119 @@ INVERSE(e_inverse) /* ellipsoid & spheroid */;
 	}
 	return (lp);
 }
-FREEUP; if (P) { if (P->en) pj_dalloc(P->en); pj_dalloc(P); } }
+SPECIAL(fac) { /* ellipsoid & spheroid */
+	double sinphi, cosphi, r, dq, rho, drho;
+
+	sinphi = sin(lp.phi);
+	cosphi = cos(lp.phi);
+	if (P->ellips) {
+		r = P->c - P->n * pj_qsfn_i(sinphi, P->e, P->one_es);
+		dq = 1. - P->es * sinphi * sinphi;
+		dq = 2. * P->one_es * cosphi / (dq * dq);
+	} else {
+		r = P->c - P->n2 * sinphi;
+		dq = 2. * cosphi;
+	}
+	if (r <= 0.)
+		return;
+	r = sqrt(r);
+	rho = P->dd * r;
+	drho = - .5 * dq / r;
+	lp.lam *= P->n;
+	fac->code |= IS_ANAL_XL_YL + IS_ANAL_XP_YP;
+	fac->der.x_l = rho * P->n * cos(lp.lam);
+	fac->der.y_l = - rho * P->n * sin(lp.lam);
+	fac->der.x_p = - drho * sin(lp.lam);
+	fac->der.y_p = - drho * cos(lp.lam);
+}
+FORWARD_ARRAY(s_forward_n, e_forward)
+	static int /* ellipsoid, the q of a run of points at once */
+e_forward_n(PJ *P, long n, int stride, double *x, double *y) {
+	double q[PJ_ARRAY_RUN];
+	long i0, io, j, m;
+	int err = 0;
+
+	for (i0 = 0; i0 < n; i0 += PJ_ARRAY_RUN) {
+		m = n - i0 < PJ_ARRAY_RUN ? n - i0 : PJ_ARRAY_RUN;
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride)
+			q[j] = x[io] == HUGE_VAL ? HUGE_VAL : y[io];
+		pj_qsfn_n(m, 1, q, P->e, P->one_es);
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			double rho, lam;
+
+			if (x[io] == HUGE_VAL)
+				continue;
+			if ((rho = P->c - P->n * q[j]) < 0.) {
+				x[io] = y[io] = HUGE_VAL;
+				err = -20;
+				continue;
+			}
+			rho = P->dd * sqrt(rho);
+			lam = x[io] * P->n;
+			x[io] = rho * sin(lam);
+			y[io] = P->rho0 - rho * cos(lam);
+		}
+	}
+	return err;
+}
+INVERSE_ARRAY(s_inverse_n, e_inverse)
+	static int /* ellipsoid, phi1_() of a run of points at once */
+e_inverse_n(PJ *P, long n, int stride, double *x, double *y) {
+	double phi[PJ_NEWTON_RUN], qs[PJ_NEWTON_RUN];
+	char conv[PJ_NEWTON_RUN];
+	long i0, io, j, m;
+	int err = 0;
+
+	for (i0 = 0; i0 < n; i0 += PJ_NEWTON_RUN) {
+		m = n - i0 < PJ_NEWTON_RUN ? n - i0 : PJ_NEWTON_RUN;
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			double u, v, rho;
+
+			/* 1 to skip, 3 if done */
+			phi[j] = HUGE_VAL;
+			if ((conv[j] = x[io] == HUGE_VAL))
+				continue;
+			conv[j] = 3;
+			if( (rho = hypot(u = x[io], v = P->rho0 - y[io])) != 0.0 ) {
+				if (P->n < 0.) {
+					rho = -rho;
+					u = -u;
+					v = -v;
+				}
+				rho /= P->dd;
+				qs[j] = (P->c - rho * rho) / P->n;
+				x[io] = atan2(u, v) / P->n;
+				if (fabs(P->ec - fabs(qs[j])) > TOL7) {
+					if ((phi[j] = phi1_beta(qs[j], P)) != HUGE_VAL)
+						conv[j] = 0;
+					else {
+						x[io] = y[io] = HUGE_VAL;
+						err = -20;
+					}
+				} else
+					y[io] = qs[j] < 0. ? -HALFPI : HALFPI;
+			} else {
+				x[io] = 0.;
+				y[io] = P->n > 0. ? HALFPI : - HALFPI;
+			}
+		}
+		/* the starts of the points iterated, from their authalic latitude */
+		pj_authlat_n(m, 1, phi, P->apa);
+		pj_newton_run(newton_step, P, N_ITER, TOL, m, phi, qs, conv);
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride)
+			if (conv[j] == 2)
+				y[io] = phi[j];
+			else if (!conv[j]) {
+				x[io] = y[io] = HUGE_VAL;
+				err = -20;
+			}
+	}
+	return err;
+}
+FREEUP; if (P) {
+	if (P->en) pj_table_release(P->en);
+	if (P->apa) pj_table_release(P->apa);
+	pj_dalloc(P); } }
 	static PJ *
 setup(PJ *P) {
 	double cosphi, sinphi;
@@ -125,22 +261,23 @@ setup(PJ *P) {
 		double ml1, m1;
 
 		if (!(P->en = pj_enfn(P->es))) E_ERROR_0;
-		m1 = pj_msfn(sinphi, cosphi, P->es);
-		ml1 = pj_qsfn(sinphi, P->e, P->one_es);
+		if (!(P->apa = pj_authset(P->es))) E_ERROR_0;
+		m1 = pj_msfn_i(sinphi, cosphi, P->es);
+		ml1 = pj_qsfn_i(sinphi, P->e, P->one_es);
 		if (secant) { /* secant cone */
 			double ml2, m2;
 
 			sinphi = sin(P->phi2);
 			cosphi = cos(P->phi2);
-			m2 = pj_msfn(sinphi, cosphi, P->es);
-			ml2 = pj_qsfn(sinphi, P->e, P->one_es);
+			m2 = pj_msfn_i(sinphi, cosphi, P->es);
+			ml2 = pj_qsfn_i(sinphi, P->e, P->one_es);
 			P->n = (m1 * m1 - m2 * m2) / (ml2 - ml1);
 		}
 		P->ec = 1. - .5 * P->one_es * log((1. - P->e) /
 			(1. + P->e)) / P->e;
 		P->c = m1 * m1 + P->n * ml1;
 		P->dd = 1. / P->n;
-		P->rho0 = P->dd * sqrt(P->c - P->n * pj_qsfn(sin(P->phi0),
+		P->rho0 = P->dd * sqrt(P->c - P->n * pj_qsfn_i(sin(P->phi0),
 			P->e, P->one_es));
 	} else {
 		if (secant) P->n = .5 * (P->n + sin(P->phi2));
@@ -150,13 +287,16 @@ setup(PJ *P) {
 		P->rho0 = P->dd * sqrt(P->c - P->n2 * sin(P->phi0));
 	}
 	P->inv = e_inverse; P->fwd = e_forward;
+	P->inv_n = P->ellips && P->e >= EPSILON ? e_inverse_n : s_inverse_n;
+	P->fwd_n = P->ellips ? e_forward_n : s_forward_n;
+	P->spc = fac;
 	return P;
 }
-ENTRY1(aea,en)
+ENTRY2(aea,en,apa)
 	P->phi1 = pj_param(P->ctx, P->params, "rlat_1").f;
 	P->phi2 = pj_param(P->ctx, P->params, "rlat_2").f;
 ENDENTRY(setup(P))
-ENTRY1(leac,en)
+ENTRY2(leac,en,apa)
 	P->phi2 = pj_param(P->ctx, P->params, "rlat_1").f;
 	P->phi1 = pj_param(P->ctx, P->params, "bsouth").i ? - HALFPI: HALFPI;
 ENDENTRY(setup(P))
@@ -41,6 +41,7 @@
 #define PJ_LIB__
 #include	"geodesic.h"
 #include	<projects.h>
+#include	<pj_math.h>
 
 PJ_CVSID("$Id$");
 
@@ -62,11 +63,11 @@ FORWARD(e_guam_fwd); /* Guam elliptical */
 	sinphi = sin(lp.phi);
 	t = 1. / sqrt(1. - P->es * sinphi * sinphi);
 	xy.x = lp.lam * cosphi * t;
-	xy.y = pj_mlfn(lp.phi, sinphi, cosphi, P->en) - P->M1 +
+	xy.y = pj_mlfn_i(lp.phi, sinphi, cosphi, P->en) - P->M1 +
 		.5 * lp.lam * lp.lam * cosphi * sinphi * t;
 	return (xy);
 }
-FORWARD(e_forward); /* elliptical */
+FORWARD_MODAL(e_forward); /* elliptical */
 	double  coslam, cosphi, sinphi, rho;
 	double azi1, azi2, s12;
 	double lam1, phi1, lam2, phi2;
@@ -74,11 +75,11 @@ FORWARD(e_forward); /* elliptical */
 	coslam = cos(lp.lam);
 	cosphi = cos(lp.phi);
 	sinphi = sin(lp.phi);
-	switch (P->mode) {
+	switch (mode) {
 	case N_POLE:
 		coslam = - coslam;
 	case S_POLE:
-		xy.x = (rho = fabs(P->Mp - pj_mlfn(lp.phi, sinphi, cosphi, P->en))) *
+		xy.x = (rho = fabs(P->Mp - pj_mlfn_i(lp.phi, sinphi, cosphi, P->en))) *
 			sin(lp.lam);
 		xy.y = rho * coslam;
 		break;
@@ -100,13 +101,13 @@ FORWARD(e_forward); /* elliptical */
 	}
 	return (xy);
 }
-FORWARD(s_forward); /* spherical */
+FORWARD_MODAL(s_forward); /* spherical */
 	double  coslam, cosphi, sinphi;
 
 	sinphi = sin(lp.phi);
 	cosphi = cos(lp.phi);
 	coslam = cos(lp.lam);
-	switch (P->mode) {
+	switch (mode) {
 	case EQUIT:
 		xy.y = cosphi * coslam;
 		goto oblcon;
@@ -122,7 +123,7 @@ oblcon:
 			xy.y = acos(xy.y);
 			xy.y /= sin(xy.y);
 			xy.x = xy.y * cosphi * sin(lp.lam);
-			xy.y *= (P->mode == EQUIT) ? sinphi :
+			xy.y *= (mode == EQUIT) ? sinphi :
 		   		P->cosph0 * sinphi - P->sinph0 * cosphi * coslam;
 		}
 		break;
@@ -151,7 +152,7 @@ INVERSE(e_guam_inv); /* Guam elliptical */
 	lp.lam = xy.x * t / cos(lp.phi);
 	return (lp);
 }
-INVERSE(e_inverse); /* elliptical */
+INVERSE_MODAL(e_inverse); /* elliptical */
 	double c;
 	double azi1, azi2, s12, x2, y2, lat1, lon1, lat2, lon2;
 
@@ -160,7 +161,7 @@ INVERSE(e_inverse); /* elliptical */
 		lp.lam = 0.;
 		return (lp);
 	}
-	if (P->mode == OBLIQ || P->mode == EQUIT) {
+	if (mode == OBLIQ || mode == EQUIT) {
 
 		x2 = xy.x * P->a;
 		y2 = xy.y * P->a;
@@ -173,13 +174,13 @@ INVERSE(e_inverse); /* elliptical */
 		lp.lam = lon2 / RHO;
 		lp.lam -= P->lam0;
 	} else { /* Polar */
-		lp.phi = pj_inv_mlfn(P->ctx, P->mode == N_POLE ? P->Mp - c : P->Mp + c,
+		lp.phi = pj_inv_mlfn(P->ctx, mode == N_POLE ? P->Mp - c : P->Mp + c,
 			P->es, P->en);
-		lp.lam = atan2(xy.x, P->mode == N_POLE ? -xy.y : xy.y);
+		lp.lam = atan2(xy.x, mode == N_POLE ? -xy.y : xy.y);
 	}
 	return (lp);
 }
-INVERSE(s_inverse); /* spherical */
+INVERSE_MODAL(s_inverse); /* spherical */
 	double cosc, c_rh, sinc;
 
 	if ((c_rh = hypot(xy.x, xy.y)) > PI) {
@@ -190,21 +191,21 @@ INVERSE(s_inverse); /* spherical */
 		lp.lam = 0.;
 		return (lp);
 	}
-	if (P->mode == OBLIQ || P->mode == EQUIT) {
+	if (mode == OBLIQ || mode == EQUIT) {
 		sinc = sin(c_rh);
 		cosc = cos(c_rh);
-		if (P->mode == EQUIT) {
-                        lp.phi = aasin(P->ctx, xy.y * sinc / c_rh);
+		if (mode == EQUIT) {
+                        lp.phi = pj_aasin_i(P->ctx, xy.y * sinc / c_rh);
 			xy.x *= sinc;
 			xy.y = cosc * c_rh;
 		} else {
-			lp.phi = aasin(P->ctx,cosc * P->sinph0 + xy.y * sinc * P->cosph0 /
+			lp.phi = pj_aasin_i(P->ctx,cosc * P->sinph0 + xy.y * sinc * P->cosph0 /
 				c_rh);
 			xy.y = (cosc - P->sinph0 * sin(lp.phi)) * c_rh;
 			xy.x *= sinc * P->cosph0;
 		}
 		lp.lam = xy.y == 0. ? 0. : atan2(xy.x, xy.y);
-	} else if (P->mode == N_POLE) {
+	} else if (mode == N_POLE) {
 		lp.phi = HALFPI - c_rh;
 		lp.lam = atan2(xy.x, -xy.y);
 	} else {
@@ -213,10 +214,38 @@ INVERSE(s_inverse); /* spherical */
 	}
 	return (lp);
 }
+FORWARD_MODE(e_forward_npole, e_forward, N_POLE)
+FORWARD_MODE(e_forward_spole, e_forward, S_POLE)
+FORWARD_MODE(e_forward_equit, e_forward, EQUIT)
+FORWARD_MODE(e_forward_obliq, e_forward, OBLIQ)
+INVERSE_MODE(e_inverse_npole, e_inverse, N_POLE)
+INVERSE_MODE(e_inverse_spole, e_inverse, S_POLE)
+INVERSE_MODE(e_inverse_equit, e_inverse, EQUIT)
+INVERSE_MODE(e_inverse_obliq, e_inverse, OBLIQ)
+FORWARD_MODE(s_forward_npole, s_forward, N_POLE)
+FORWARD_MODE(s_forward_spole, s_forward, S_POLE)
+FORWARD_MODE(s_forward_equit, s_forward, EQUIT)
+FORWARD_MODE(s_forward_obliq, s_forward, OBLIQ)
+INVERSE_MODE(s_inverse_npole, s_inverse, N_POLE)
+INVERSE_MODE(s_inverse_spole, s_inverse, S_POLE)
+INVERSE_MODE(s_inverse_equit, s_inverse, EQUIT)
+INVERSE_MODE(s_inverse_obliq, s_inverse, OBLIQ)
+static const struct PJ_KERNELS e_kernels[] = { /* by mode */
+	MODE_KERNELS(e_forward_npole, e_inverse_npole),
+	MODE_KERNELS(e_forward_spole, e_inverse_spole),
+	MODE_KERNELS(e_forward_equit, e_inverse_equit),
+	MODE_KERNELS(e_forward_obliq, e_inverse_obliq)
+};
+static const struct PJ_KERNELS s_kernels[] = {
+	MODE_KERNELS(s_forward_npole, s_inverse_npole),
+	MODE_KERNELS(s_forward_spole, s_inverse_spole),
+	MODE_KERNELS(s_forward_equit, s_inverse_equit),
+	MODE_KERNELS(s_forward_obliq, s_inverse_obliq)
+};
 FREEUP;
     if (P) {
 		if (P->en)
-			pj_dalloc(P->en);
+			pj_table_release(P->en);
 		pj_dalloc(P);
 	}
 }
@@ -237,29 +266,29 @@ ENTRY1(aeqd, en)
 		P->cosph0 = cos(P->phi0);
 	}
 	if (! P->es) {
-		P->inv = s_inverse; P->fwd = s_forward;
+		SET_KERNELS(P, s_kernels[P->mode]);
 	} else {
 		if (!(P->en = pj_enfn(P->es))) E_ERROR_0;
+		P->en = pj_inv_mlfn_accuracy(P->en, P->es, P->a, P->cold->accuracy);
 		if (pj_param(P->ctx, P->params, "bguam").i) {
-			P->M1 = pj_mlfn(P->phi0, P->sinph0, P->cosph0, P->en);
+			P->M1 = pj_mlfn_i(P->phi0, P->sinph0, P->cosph0, P->en);
 			P->inv = e_guam_inv; P->fwd = e_guam_fwd;
 		} else {
 			switch (P->mode) {
 			case N_POLE:
-				P->Mp = pj_mlfn(HALFPI, 1., 0., P->en);
+				P->Mp = pj_mlfn_i(HALFPI, 1., 0., P->en);
 				break;
 			case S_POLE:
-				P->Mp = pj_mlfn(-HALFPI, -1., 0., P->en);
+				P->Mp = pj_mlfn_i(-HALFPI, -1., 0., P->en);
 				break;
 			case EQUIT:
 			case OBLIQ:
-				P->inv = e_inverse; P->fwd = e_forward;
 				P->N1 = 1. / sqrt(1. - P->es * P->sinph0 * P->sinph0);
 				P->G = P->sinph0 * (P->He = P->e / sqrt(P->one_es));
 				P->He *= P->cosph0;
 				break;
 			}
-			P->inv = e_inverse; P->fwd = e_forward;
+			SET_KERNELS(P, e_kernels[P->mode]);
 		}
 	}
 ENDENTRY(P)
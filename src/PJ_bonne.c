@@ -58,7 +58,7 @@ INVERSE(e_inverse); /* ellipsoid */
 FREEUP;
 	if (P) {
 		if (P->en)
-			pj_dalloc(P->en);
+			pj_table_release(P->en);
 		pj_dalloc(P);
 	}
 }
@@ -69,6 +69,7 @@ ENTRY1(bonne, en)
 	if (fabs(P->phi1) < EPS10) E_ERROR(-23);
 	if (P->es) {
 		P->en = pj_enfn(P->es);
+		P->en = pj_inv_mlfn_accuracy(P->en, P->es, P->a, P->cold->accuracy);
 		P->m1 = pj_mlfn(P->phi1, P->am1 = sin(P->phi1),
 			c = cos(P->phi1), P->en);
 		P->am1 = c / (sqrt(1. - P->es * P->am1 * P->am1) * P->am1);
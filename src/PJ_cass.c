@@ -12,6 +12,7 @@
 	double *en;
 #define PJ_LIB__
 # include	<projects.h>
+# include	<pj_math.h>
 PROJ_HEAD(cass, "Cassini") "\n\tCyl, Sph&Ell";
 # define EPS10	1e-10
 # define C1	.16666666666666666666
@@ -20,7 +21,7 @@ PROJ_HEAD(cass, "Cassini") "\n\tCyl, Sph&Ell";
 # define C4	.33333333333333333333
 # define C5	.06666666666666666666
 FORWARD(e_forward); /* ellipsoid */
-	xy.y = pj_mlfn(lp.phi, P->n = sin(lp.phi), P->c = cos(lp.phi), P->en);
+	xy.y = pj_mlfn_i(lp.phi, P->n = sin(lp.phi), P->c = cos(lp.phi), P->en);
 	P->n = 1./sqrt(1. - P->es * P->n * P->n);
 	P->tn = tan(lp.phi); P->t = P->tn * P->tn;
 	P->a1 = lp.lam * P->c;
@@ -62,14 +63,15 @@ INVERSE(s_inverse); /* spheroid */
 FREEUP;
 	if (P) {
 		if (P->en)
-			pj_dalloc(P->en);
+			pj_table_release(P->en);
 		pj_dalloc(P);
 	}
 }
 ENTRY1(cass, en)
 	if (P->es) {
 		if (!(P->en = pj_enfn(P->es))) E_ERROR_0;
-		P->m0 = pj_mlfn(P->phi0, sin(P->phi0), cos(P->phi0), P->en);
+		P->en = pj_inv_mlfn_accuracy(P->en, P->es, P->a, P->cold->accuracy);
+		P->m0 = pj_mlfn_i(P->phi0, sin(P->phi0), cos(P->phi0), P->en);
 		P->inv = e_inverse;
 		P->fwd = e_forward;
 	} else {
@@ -16,4 +16,9 @@ INVERSE(s_inverse); /* spheroid */
 	return (lp);
 }
 FREEUP; if (P) pj_dalloc(P); }
-ENTRY0(cc) P->es = 0.; P->inv = s_inverse; P->fwd = s_forward; ENDENTRY(P)
+ENTRY0(cc)
+	P->es = 0.;
+	P->inv = s_inverse;
+	P->fwd = s_forward;
+	P->separable = 1;
+ENDENTRY(P)
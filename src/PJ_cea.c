@@ -3,11 +3,12 @@
 	double *apa;
 #define PJ_LIB__
 # include	<projects.h>
+# include	<pj_math.h>
 PROJ_HEAD(cea, "Equal Area Cylindrical") "\n\tCyl, Sph&Ell\n\tlat_ts=";
 # define EPS	1e-10
 FORWARD(e_forward); /* spheroid */
 	xy.x = P->k0 * lp.lam;
-	xy.y = .5 * pj_qsfn(sin(lp.phi), P->e, P->one_es) / P->k0;
+	xy.y = .5 * pj_qsfn_i(sin(lp.phi), P->e, P->one_es) / P->k0;
 	return (xy);
 }
 FORWARD(s_forward); /* spheroid */
@@ -31,11 +32,48 @@ INVERSE(s_inverse); /* spheroid */
 		lp.lam = xy.x / P->k0;
 	} else I_ERROR;
 	return (lp);
+}
+	static int /* ellipsoid, the q of a run of points at once */
+e_forward_n(PJ *P, long n, int stride, double *x, double *y) {
+	double q[PJ_ARRAY_RUN];
+	long i0, io, j, m;
+
+	for (i0 = 0; i0 < n; i0 += PJ_ARRAY_RUN) {
+		m = n - i0 < PJ_ARRAY_RUN ? n - i0 : PJ_ARRAY_RUN;
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride)
+			q[j] = x[io] == HUGE_VAL ? HUGE_VAL : y[io];
+		pj_qsfn_n(m, 1, q, P->e, P->one_es);
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride)
+			if (x[io] != HUGE_VAL) {
+				x[io] = P->k0 * x[io];
+				y[io] = .5 * q[j] / P->k0;
+			}
+	}
+	return 0;
+}
+	static int /* ellipsoid, the latitudes of a run of points at once */
+e_inverse_n(PJ *P, long n, int stride, double *x, double *y) {
+	double beta[PJ_ARRAY_RUN];
+	long i0, io, j, m;
+
+	for (i0 = 0; i0 < n; i0 += PJ_ARRAY_RUN) {
+		m = n - i0 < PJ_ARRAY_RUN ? n - i0 : PJ_ARRAY_RUN;
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride)
+			beta[j] = x[io] == HUGE_VAL ? HUGE_VAL :
+			   asin( 2. * y[io] * P->k0 / P->qp);
+		pj_authlat_n(m, 1, beta, P->apa);
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride)
+			if (x[io] != HUGE_VAL) {
+				x[io] = x[io] / P->k0;
+				y[io] = beta[j];
+			}
+	}
+	return 0;
 }
 FREEUP;
 	if (P) {
 		if (P->apa)
-			pj_dalloc(P->apa);
+			pj_table_release(P->apa);
 		pj_dalloc(P);
 	}
 }
@@ -50,11 +88,14 @@ ENTRY1(cea, apa)
 		P->k0 /= sqrt(1. - P->es * t * t);
 		P->e = sqrt(P->es);
 		if (!(P->apa = pj_authset(P->es))) E_ERROR_0;
-		P->qp = pj_qsfn(1., P->e, P->one_es);
+		P->qp = pj_qsfn_i(1., P->e, P->one_es);
 		P->inv = e_inverse;
 		P->fwd = e_forward;
+		P->inv_n = e_inverse_n;
+		P->fwd_n = e_forward_n;
 	} else {
 		P->inv = s_inverse;
 		P->fwd = s_forward;
 	}
+	P->separable = 1;
 ENDENTRY(P)
@@ -1,5 +1,6 @@
 #define PJ_LIB__
 #include	<projects.h>
+#include	<pj_math.h>
 PROJ_HEAD(eck4, "Eckert IV") "\n\tPCyl, Sph.";
 #define C_x	.42223820031577120149
 #define C_y	1.32650042817700232218
@@ -8,18 +9,22 @@ PROJ_HEAD(eck4, "Eckert IV") "\n\tPCyl, Sph.";
 #define RC_p	.28004957675577868795
 #define EPS	1e-7
 #define NITER	6
+	static PJ_INLINE double
+newton_step(double t, double p, PJ *P) {
+	double c = cos(t), s = sin(t);
+
+	(void) P;
+	return ((t + s * (c + 2.) - p) / (1. + c * (c + 2.) - s * s));
+}
 FORWARD(s_forward); /* spheroid */
-	double p, V, s, c;
+	double p, V;
 	int i;
 
 	p = C_p * sin(lp.phi);
 	V = lp.phi * lp.phi;
 	lp.phi *= 0.895168 + V * ( 0.0218849 + V * 0.00826809 );
 	for (i = NITER; i ; --i) {
-		c = cos(lp.phi);
-		s = sin(lp.phi);
-		lp.phi -= V = (lp.phi + s * (c + 2.) - p) /
-			(1. + c * (c + 2.) - s * s);
+		lp.phi -= V = newton_step(lp.phi, p, P);
 		if (fabs(V) < EPS)
 			break;
 	}
@@ -31,6 +36,36 @@ FORWARD(s_forward); /* spheroid */
 		xy.y = C_y * sin(lp.phi);
 	}
 	return (xy);
+}
+	static int /* spheroid, the Newton iteration of a run of points at once */
+s_forward_n(PJ *P, long n, int stride, double *x, double *y) {
+	double phi[PJ_NEWTON_RUN], p[PJ_NEWTON_RUN];
+	char conv[PJ_NEWTON_RUN];
+	long i0, io, j, m;
+
+	for (i0 = 0; i0 < n; i0 += PJ_NEWTON_RUN) {
+		m = n - i0 < PJ_NEWTON_RUN ? n - i0 : PJ_NEWTON_RUN;
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			double V = y[io] * y[io];
+
+			p[j] = C_p * sin(y[io]);
+			phi[j] = y[io] * (0.895168 + V * ( 0.0218849 + V * 0.00826809 ));
+			conv[j] = x[io] == HUGE_VAL;
+		}
+		pj_newton_run(newton_step, P, NITER, EPS, m, phi, p, conv);
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			if (conv[j] == 1)
+				continue;
+			if (!conv[j]) {
+				x[io] = C_x * x[io];
+				y[io] = phi[j] < 0. ? -C_y : C_y;
+			} else {
+				x[io] = C_x * x[io] * (1. + cos(phi[j]));
+				y[io] = C_y * sin(phi[j]);
+			}
+		}
+	}
+	return 0;
 }
 INVERSE(s_inverse); /* spheroid */
 	double c;
@@ -40,5 +75,12 @@ INVERSE(s_inverse); /* spheroid */
 	lp.phi = aasin(P->ctx,(lp.phi + sin(lp.phi) * (c + 2.)) / C_p);
 	return (lp);
 }
+INVERSE_ARRAY(s_inverse_n, s_inverse)
 FREEUP; if (P) pj_dalloc(P); }
-ENTRY0(eck4); P->es = 0.; P->inv = s_inverse; P->fwd = s_forward; ENDENTRY(P)
+ENTRY0(eck4)
+	P->es = 0.;
+	P->inv = s_inverse;
+	P->fwd = s_forward;
+	P->inv_n = s_inverse_n;
+	P->fwd_n = s_forward_n;
+ENDENTRY(P)
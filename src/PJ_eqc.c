@@ -14,10 +14,15 @@ INVERSE(s_inverse); /* spheroid */
 	lp.phi = xy.y + P->phi0;
 	return (lp);
 }
+FORWARD_ARRAY(s_forward_n, s_forward)
+INVERSE_ARRAY(s_inverse_n, s_inverse)
 FREEUP; if (P) pj_dalloc(P); }
 ENTRY0(eqc)
 	if ((P->rc = cos(pj_param(P->ctx, P->params, "rlat_ts").f)) <= 0.) E_ERROR(-24);
 	P->inv = s_inverse;
 	P->fwd = s_forward;
+	P->inv_n = s_inverse_n;
+	P->fwd_n = s_forward_n;
 	P->es = 0.;
+	P->separable = 1;
 ENDENTRY(P)
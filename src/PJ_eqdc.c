@@ -9,11 +9,12 @@
 	int		ellips;
 #define PJ_LIB__
 #include	<projects.h>
+#include	<pj_math.h>
 PROJ_HEAD(eqdc, "Equidistant Conic")
 	"\n\tConic, Sph&Ell\n\tlat_1= lat_2=";
 # define EPS10	1.e-10
 FORWARD(e_forward); /* sphere & ellipsoid */
-	P->rho = P->c - (P->ellips ? pj_mlfn(lp.phi, sin(lp.phi),
+	P->rho = P->c - (P->ellips ? pj_mlfn_i(lp.phi, sin(lp.phi),
 		cos(lp.phi), P->en) : lp.phi);
 	xy.x = P->rho * sin( lp.lam *= P->n );
 	xy.y = P->rho0 - P->rho * cos(lp.lam);
@@ -43,10 +44,12 @@ SPECIAL(fac) {
 	cosphi = cos(lp.phi);
 	fac->code |= IS_ANAL_HK;
 	fac->h = 1.;
-	fac->k = P->n * (P->c - (P->ellips ? pj_mlfn(lp.phi, sinphi,
-		cosphi, P->en) : lp.phi)) / pj_msfn(sinphi, cosphi, P->es);
+	fac->k = P->n * (P->c - (P->ellips ? pj_mlfn_i(lp.phi, sinphi,
+		cosphi, P->en) : lp.phi)) / pj_msfn_i(sinphi, cosphi, P->es);
 }
-FREEUP; if (P) { if (P->en) pj_dalloc(P->en); pj_dalloc(P); } }
+FORWARD_ARRAY(e_forward_n, e_forward)
+INVERSE_ARRAY(e_inverse_n, e_inverse)
+FREEUP; if (P) { if (P->en) pj_table_release(P->en); pj_dalloc(P); } }
 ENTRY1(eqdc, en)
 	double cosphi, sinphi;
 	int secant;
@@ -56,22 +59,23 @@ ENTRY1(eqdc, en)
 	if (fabs(P->phi1 + P->phi2) < EPS10) E_ERROR(-21);
 	if (!(P->en = pj_enfn(P->es)))
 		E_ERROR_0;
+	P->en = pj_inv_mlfn_accuracy(P->en, P->es, P->a, P->cold->accuracy);
 	P->n = sinphi = sin(P->phi1);
 	cosphi = cos(P->phi1);
 	secant = fabs(P->phi1 - P->phi2) >= EPS10;
 	if( (P->ellips = (P->es > 0.)) ) {
 		double ml1, m1;
 
-		m1 = pj_msfn(sinphi, cosphi, P->es);
-		ml1 = pj_mlfn(P->phi1, sinphi, cosphi, P->en);
+		m1 = pj_msfn_i(sinphi, cosphi, P->es);
+		ml1 = pj_mlfn_i(P->phi1, sinphi, cosphi, P->en);
 		if (secant) { /* secant cone */
 			sinphi = sin(P->phi2);
 			cosphi = cos(P->phi2);
-			P->n = (m1 - pj_msfn(sinphi, cosphi, P->es)) /
-				(pj_mlfn(P->phi2, sinphi, cosphi, P->en) - ml1);
+			P->n = (m1 - pj_msfn_i(sinphi, cosphi, P->es)) /
+				(pj_mlfn_i(P->phi2, sinphi, cosphi, P->en) - ml1);
 		}
 		P->c = ml1 + m1 / P->n;
-		P->rho0 = P->c - pj_mlfn(P->phi0, sin(P->phi0),
+		P->rho0 = P->c - pj_mlfn_i(P->phi0, sin(P->phi0),
 			cos(P->phi0), P->en);
 	} else {
 		if (secant)
@@ -81,5 +85,7 @@ ENTRY1(eqdc, en)
 	}
 	P->inv = e_inverse;
 	P->fwd = e_forward;
+	P->inv_n = e_inverse_n;
+	P->fwd_n = e_forward_n;
 	P->spc = fac;
 ENDENTRY(P)
@@ -41,6 +41,7 @@ LIBPROJ_ID[] = "$Id$";
         int     flip_axis;
 #define PJ_LIB__
 #include	<projects.h>
+#include	<errno.h>
 
 PROJ_HEAD(geos, "Geostationary Satellite View") "\n\tAzi, Sph&Ell\n\th=";
 
@@ -190,3 +191,99 @@ ENTRY0(geos)
 		P->fwd = s_forward;
 	}
 ENDENTRY(P)
+
+/*
+** Navigate a grid of row_count rows of col_count pixels of a full disk
+** image, x holding the projected coordinates of the columns and y those
+** of the rows, with the units, offsets and +sweep of P, a +proj=geos PJ.
+** lam and phi get the longitude and latitude (radians) of each pixel, by
+** rows, as pj_inv() would, and mask 1 for pixels on the disk and 0
+** for the others, which are HUGE_VAL.  mask may be NULL.
+**
+** The scan angles are those of the column and of the row, so their
+** tangents and the norms of the rays are taken once for each, and only
+** the intersection of the ray with the ellipsoid is done per pixel.
+** Since the visible points are on the near side, where Vx > 0, the
+** latitude is had from the ray without the lam of atan2() and the
+** geocentric latitude.  Returns the error of the last failed pixel,
+** -20 for off disk ones, as for pj_inv_array().
+*/
+	int
+pj_geos_grid(PJ *P, int col_count, const double *x, int row_count,
+		const double *y, double *lam, double *phi, unsigned char *mask) {
+	double *tc, *hc, tr = 0., hr = 0., u, v, Vx, Vy, Vz, a, k, d;
+	long i;
+	int r, c, err = 0;
+
+	if (P->descr != des_geos)
+		return -5;
+	if (P->ctx->errno_globals)
+		errno = pj_errno = 0;
+	P->ctx->last_errno = 0;
+
+	/* tangent of the scan angle of each column, and for the y sweep,
+	   the norm of its ray in the x plane */
+	if (!(tc = (double *) pj_malloc(2 * sizeof(double) * (col_count + 1)))) {
+		pj_ctx_set_errno(P->ctx, ENOMEM);
+		return ENOMEM;
+	}
+	hc = tc + col_count + 1;
+	for (c = 0; c < col_count; ++c) {
+		if (x[c] == HUGE_VAL) {
+			tc[c] = HUGE_VAL;
+			continue;
+		}
+		u = (x[c] * P->to_meter - P->x0) * P->ra;
+		tc[c] = tan(u / P->radius_g_1);
+		hc[c] = hypot(1.0, tc[c]);
+	}
+
+	for (r = 0, i = 0; r < row_count; ++r) {
+		if (y[r] != HUGE_VAL) {
+			v = (y[r] * P->to_meter - P->y0) * P->ra;
+			tr = tan(v / P->radius_g_1);
+			hr = hypot(1.0, tr);
+		}
+		for (c = 0; c < col_count; ++c, ++i) {
+			lam[i] = phi[i] = HUGE_VAL;
+			if (mask)
+				mask[i] = 0;
+			if (y[r] == HUGE_VAL || tc[c] == HUGE_VAL) {
+				err = -15;
+				continue;
+			}
+			if (P->flip_axis) {
+				Vy = tc[c] * hr;
+				Vz = tr;
+			} else {
+				Vy = tc[c];
+				Vz = tr * hc[c];
+			}
+			/* k of the near intersection of the ray, as by the
+			   quadratic of the inverses, with b = -2 radius_g */
+			a = Vz / P->radius_p;
+			a = Vy * Vy + a * a + 1.0;
+			if ((d = P->radius_g * P->radius_g - a * P->C) < 0.) {
+				err = -20;
+				continue;
+			}
+			k = (P->radius_g - sqrt(d)) / a;
+			Vx = P->radius_g - k;
+			Vy *= k;
+			Vz *= k;
+			lam[i] = atan2(Vy, Vx) + P->lam0;
+			if (!P->over)
+				lam[i] = adjlon(lam[i]);
+			d = Vz / hypot(Vx, Vy);
+			/* geocentric, the tangent would be scaled back */
+			phi[i] = atan(P->geoc ? d : P->radius_p_inv2 * d);
+			if (mask)
+				mask[i] = 1;
+		}
+	}
+
+	pj_dalloc(tc);
+	if (err)
+		pj_ctx_set_errno(P->ctx, err);
+	return err;
+}
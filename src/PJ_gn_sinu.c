@@ -3,6 +3,7 @@
 	double	m, n, C_x, C_y;
 #define PJ_LIB__
 #include	<projects.h>
+#include	<pj_math.h>
 PROJ_HEAD(gn_sinu, "General Sinusoidal Series") "\n\tPCyl, Sph.\n\tm= n=";
 PROJ_HEAD(sinu, "Sinusoidal (Sanson-Flamsteed)") "\n\tPCyl, Sph&Ell";
 PROJ_HEAD(eck6, "Eckert VI") "\n\tPCyl, Sph.";
@@ -14,7 +15,7 @@ PROJ_HEAD(mbtfps, "McBryde-Thomas Flat-Polar Sinusoidal") "\n\tPCyl, Sph.";
 FORWARD(e_forward); /* ellipsoid */
 	double s, c;
 
-	xy.y = pj_mlfn(lp.phi, s = sin(lp.phi), c = cos(lp.phi), P->en);
+	xy.y = pj_mlfn_i(lp.phi, s = sin(lp.phi), c = cos(lp.phi), P->en);
 	xy.x = lp.lam * c / sqrt(1. - P->es * s * s);
 	return (xy);
 }
@@ -32,7 +33,7 @@ INVERSE(e_inverse); /* ellipsoid */
 /* General spherical sinusoidals */
 FORWARD(s_forward); /* sphere */
 	if (!P->m)
-		lp.phi = P->n != 1. ? aasin(P->ctx,P->n * sin(lp.phi)): lp.phi;
+		lp.phi = P->n != 1. ? pj_aasin_i(P->ctx,P->n * sin(lp.phi)): lp.phi;
 	else {
 		double k, V;
 		int i;
@@ -53,22 +54,27 @@ FORWARD(s_forward); /* sphere */
 }
 INVERSE(s_inverse); /* sphere */
 	xy.y /= P->C_y;
-	lp.phi = P->m ? aasin(P->ctx,(P->m * xy.y + sin(xy.y)) / P->n) :
-		( P->n != 1. ? aasin(P->ctx,sin(xy.y) / P->n) : xy.y );
+	lp.phi = P->m ? pj_aasin_i(P->ctx,(P->m * xy.y + sin(xy.y)) / P->n) :
+		( P->n != 1. ? pj_aasin_i(P->ctx,sin(xy.y) / P->n) : xy.y );
 	lp.lam = xy.x / (P->C_x * (P->m + cos(xy.y)));
 	return (lp);
 }
-FREEUP; if (P) { if (P->en) pj_dalloc(P->en); pj_dalloc(P); } }
+FORWARD_ARRAY(s_forward_n, s_forward)
+INVERSE_ARRAY(s_inverse_n, s_inverse)
+FREEUP; if (P) { if (P->en) pj_table_release(P->en); pj_dalloc(P); } }
 	static void /* for spheres, only */
 setup(PJ *P) {
 	P->es = 0;
 	P->C_x = (P->C_y = sqrt((P->m + 1.) / P->n))/(P->m + 1.);
 	P->inv = s_inverse;
 	P->fwd = s_forward;
+	P->inv_n = s_inverse_n;
+	P->fwd_n = s_forward_n;
 }
 ENTRY1(sinu, en)
 	if (!(P->en = pj_enfn(P->es)))
 		E_ERROR_0;
+	P->en = pj_inv_mlfn_accuracy(P->en, P->es, P->a, P->cold->accuracy);
 	if (P->es) {
 		P->inv = e_inverse;
 		P->fwd = e_forward;
@@ -10,13 +10,13 @@ PROJ_HEAD(gnom, "Gnomonic") "\n\tAzi, Sph.";
 #define S_POLE 1
 #define EQUIT	2
 #define OBLIQ	3
-FORWARD(s_forward); /* spheroid */
+FORWARD_MODAL(s_forward); /* spheroid */
 	double  coslam, cosphi, sinphi;
 
 	sinphi = sin(lp.phi);
 	cosphi = cos(lp.phi);
 	coslam = cos(lp.lam);
-	switch (P->mode) {
+	switch (mode) {
 	case EQUIT:
 		xy.y = cosphi * coslam;
 		break;
@@ -32,7 +32,7 @@ FORWARD(s_forward); /* spheroid */
 	}
 	if (xy.y <= EPS10) F_ERROR;
 	xy.x = (xy.y = 1. / xy.y) * cosphi * sin(lp.lam);
-	switch (P->mode) {
+	switch (mode) {
 	case EQUIT:
 		xy.y *= sinphi;
 		break;
@@ -47,7 +47,7 @@ FORWARD(s_forward); /* spheroid */
 	}
 	return (xy);
 }
-INVERSE(s_inverse); /* spheroid */
+INVERSE_MODAL(s_inverse); /* spheroid */
 	double  rh, cosz, sinz;
 
 	rh = hypot(xy.x, xy.y);
@@ -57,7 +57,7 @@ INVERSE(s_inverse); /* spheroid */
 		lp.phi = P->phi0;
 		lp.lam = 0.;
 	} else {
-		switch (P->mode) {
+		switch (mode) {
 		case OBLIQ:
 			lp.phi = cosz * P->sinph0 + xy.y * sinz * P->cosph0 / rh;
 			if (fabs(lp.phi) >= 1.)
@@ -88,6 +88,20 @@ INVERSE(s_inverse); /* spheroid */
 	}
 	return (lp);
 }
+FORWARD_MODE(s_forward_npole, s_forward, N_POLE)
+FORWARD_MODE(s_forward_spole, s_forward, S_POLE)
+FORWARD_MODE(s_forward_equit, s_forward, EQUIT)
+FORWARD_MODE(s_forward_obliq, s_forward, OBLIQ)
+INVERSE_MODE(s_inverse_npole, s_inverse, N_POLE)
+INVERSE_MODE(s_inverse_spole, s_inverse, S_POLE)
+INVERSE_MODE(s_inverse_equit, s_inverse, EQUIT)
+INVERSE_MODE(s_inverse_obliq, s_inverse, OBLIQ)
+static const struct PJ_KERNELS s_kernels[] = { /* by mode */
+	MODE_KERNELS(s_forward_npole, s_inverse_npole),
+	MODE_KERNELS(s_forward_spole, s_inverse_spole),
+	MODE_KERNELS(s_forward_equit, s_inverse_equit),
+	MODE_KERNELS(s_forward_obliq, s_inverse_obliq)
+};
 FREEUP; if (P) pj_dalloc(P); }
 ENTRY0(gnom)
 	if (fabs(fabs(P->phi0) - HALFPI) < EPS10)
@@ -99,7 +113,6 @@ ENTRY0(gnom)
 		P->sinph0 = sin(P->phi0);
 		P->cosph0 = cos(P->phi0);
 	}
-	P->inv = s_inverse;
-	P->fwd = s_forward;
+	SET_KERNELS(P, s_kernels[P->mode]);
 	P->es = 0.;
 ENDENTRY(P)
@@ -1,5 +1,6 @@
 #define PJ_LIB__
 #include	<projects.h>
+#include	<pj_math.h>
 PROJ_HEAD(hatano, "Hatano Asymmetrical Equal Area") "\n\tPCyl, Sph.";
 #define NITER	20
 #define EPS	1e-7
@@ -14,18 +15,47 @@ PROJ_HEAD(hatano, "Hatano Asymmetrical Equal Area") "\n\tPCyl, Sph.";
 #define RYCS	0.51799515156538134803
 #define FXC	0.85
 #define RXC	1.17647058823529411764
+	static PJ_INLINE double
+newton_step(double t, double c, PJ *P) {
+	(void) P;
+	return ((t + sin(t) - c) / (1. + cos(t)));
+}
 FORWARD(s_forward); /* spheroid */
 	double th1, c;
 	int i;
 
 	c = sin(lp.phi) * (lp.phi < 0. ? CS : CN);
+	lp.phi = pj_tsin_start(c);
 	for (i = NITER; i; --i) {
-		lp.phi -= th1 = (lp.phi + sin(lp.phi) - c) / (1. + cos(lp.phi));
+		lp.phi -= th1 = newton_step(lp.phi, c, P);
 		if (fabs(th1) < EPS) break;
 	}
 	xy.x = FXC * lp.lam * cos(lp.phi *= .5);
 	xy.y = sin(lp.phi) * (lp.phi < 0. ? FYCS : FYCN);
 	return (xy);
+}
+	static int /* spheroid, the Newton iteration of a run of points at once */
+s_forward_n(PJ *P, long n, int stride, double *x, double *y) {
+	double th[PJ_NEWTON_RUN], c[PJ_NEWTON_RUN];
+	char conv[PJ_NEWTON_RUN];
+	long i0, io, j, m;
+
+	for (i0 = 0; i0 < n; i0 += PJ_NEWTON_RUN) {
+		m = n - i0 < PJ_NEWTON_RUN ? n - i0 : PJ_NEWTON_RUN;
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			c[j] = sin(y[io]) * (y[io] < 0. ? CS : CN);
+			th[j] = pj_tsin_start(c[j]);
+			conv[j] = x[io] == HUGE_VAL;
+		}
+		pj_newton_run(newton_step, P, NITER, EPS, m, th, c, conv);
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			if (conv[j] == 1)
+				continue;
+			x[io] = FXC * x[io] * cos(th[j] *= .5);
+			y[io] = sin(th[j]) * (th[j] < 0. ? FYCS : FYCN);
+		}
+	}
+	return 0;
 }
 INVERSE(s_inverse); /* spheroid */
 	double th;
@@ -46,5 +76,12 @@ INVERSE(s_inverse); /* spheroid */
 		lp.phi = asin(lp.phi);
 	return (lp);
 }
+INVERSE_ARRAY(s_inverse_n, s_inverse)
 FREEUP; if (P) pj_dalloc(P); }
-ENTRY0(hatano) P->es = 0.; P->inv = s_inverse; P->fwd = s_forward; ENDENTRY(P)
+ENTRY0(hatano)
+	P->es = 0.;
+	P->inv = s_inverse;
+	P->fwd = s_forward;
+	P->inv_n = s_inverse_n;
+	P->fwd_n = s_forward_n;
+ENDENTRY(P)
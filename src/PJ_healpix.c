@@ -37,6 +37,7 @@
     double *apa;
 # define PJ_LIB__    
 # include	<projects.h>
+# include	<pj_math.h>
 PROJ_HEAD(healpix, "HEALPix") "\n\tSph., Ellps.";
 PROJ_HEAD(rhealpix, "rHEALPix") "\n\tSph., Ellps.\n\tnorth_square= south_square=";
 # include	<stdio.h>
@@ -191,22 +192,45 @@ int in_image(double x, double y, int proj, int north_square, int south_square) {
  * return the approximate latitude of authalic latitude alpha (if inverse=1).    
  * P contains the relavent ellipsoid parameters. 
  **/
+static double auth_sin(PJ *P, double alpha);
 double auth_lat(PJ *P, double alpha, int inverse) {
     if (inverse == 0) {
         /* Authalic latitude. */
-        double q = pj_qsfn(sin(alpha), P->e, 1.0 - P->es);
-        double qp = P->qp; 
-	    double ratio = q/qp;
-	    if (fabsl(ratio) > 1) {
-	        /* Rounding error. */
-	        ratio = pj_sign(ratio);
-	    }
-	    return asin(ratio);
+	    return asin(auth_sin(P, alpha));
     } else {
         /* Approximation to inverse authalic latitude. */
         return pj_authlat(alpha, P->apa);
     }
 }
+/**
+ * Return the sine of the authalic latitude of latitude alpha.
+ * P contains the relavent ellipsoid parameters.
+ **/
+static double auth_sin(PJ *P, double alpha) {
+    double q = pj_qsfn(sin(alpha), P->e, 1.0 - P->es);
+    double qp = P->qp; 
+    double ratio = q/qp;
+    if (fabsl(ratio) > 1) {
+        /* Rounding error. */
+        ratio = pj_sign(ratio);
+    }
+    return ratio;
+}
+/**
+ * Replace the n latitudes in alpha, stride doubles apart, by the sines of
+ * their authalic latitudes, as auth_sin(), their q being taken at once.
+ * HUGE_VAL values are left as they are.
+ **/
+static void auth_sin_n(PJ *P, long n, int stride, double *alpha) {
+    long i;
+    pj_qsfn_n(n, stride, alpha, P->e, P->one_es);
+    for (i = 0; i < n; ++i, alpha += stride) {
+        if (*alpha != HUGE_VAL) {
+            double ratio = *alpha/P->qp;
+            *alpha = fabs(ratio) > 1 ? pj_sign(ratio) : ratio;
+        }
+    }
+}
 /**
  * Return the HEALPix projection of the longitude-latitude point lp on
  * the unit sphere.
@@ -529,10 +553,101 @@ INVERSE(e_rhealpix_inverse); /* ellipsoid */
     lp.phi = auth_lat(P, lp.phi, 1);
     return lp;
 }
+/**
+ * Array versions of the ellipsoidal forward and inverse projections of
+ * HEALPix (rhealpix=0) and rHEALPix (rhealpix=1), converting the
+ * latitudes of each run of points to or from authalic ones at once.
+ **/
+static int e_forward_run(PJ *P, long n, int stride, double *x, double *y,
+                         int rhealpix) {
+    double beta[PJ_ARRAY_RUN];
+    long i0, io, j, m;
+    for (i0 = 0; i0 < n; i0 += PJ_ARRAY_RUN) {
+        m = n - i0 < PJ_ARRAY_RUN ? n - i0 : PJ_ARRAY_RUN;
+        for (j = 0, io = i0*stride; j < m; ++j, io += stride) {
+            beta[j] = x[io] == HUGE_VAL ? HUGE_VAL : y[io];
+        }
+        auth_sin_n(P, m, 1, beta);
+        for (j = 0, io = i0*stride; j < m; ++j, io += stride) {
+            LP lp;
+            XY xy;
+            if (x[io] == HUGE_VAL) {
+                continue;
+            }
+            lp.lam = x[io];
+            lp.phi = asin(beta[j]);
+            xy = healpix_sphere(lp);
+            if (rhealpix) {
+                xy = combine_caps(xy.x, xy.y, P->north_square,
+                                  P->south_square, 0);
+            }
+            x[io] = xy.x;
+            y[io] = xy.y;
+        }
+    }
+    return 0;
+}
+static int e_inverse_run(PJ *P, long n, int stride, double *x, double *y,
+                         int rhealpix) {
+    double beta[PJ_ARRAY_RUN];
+    long i0, io, j, m;
+    int err = 0;
+    for (i0 = 0; i0 < n; i0 += PJ_ARRAY_RUN) {
+        m = n - i0 < PJ_ARRAY_RUN ? n - i0 : PJ_ARRAY_RUN;
+        for (j = 0, io = i0*stride; j < m; ++j, io += stride) {
+            LP lp;
+            XY xy;
+            beta[j] = HUGE_VAL;
+            if (x[io] == HUGE_VAL) {
+                continue;
+            }
+            /* Check whether (x, y) lies in the image. */
+            if (in_image(x[io], y[io], rhealpix,
+                         rhealpix ? P->north_square : 0,
+                         rhealpix ? P->south_square : 0) == 0) {
+                x[io] = y[io] = HUGE_VAL;
+                err = -15;
+                continue;
+            }
+            xy.x = x[io];
+            xy.y = y[io];
+            if (rhealpix) {
+                xy = combine_caps(xy.x, xy.y, P->north_square,
+                                  P->south_square, 1);
+            }
+            lp = healpix_sphere_inverse(xy);
+            x[io] = lp.lam;
+            y[io] = beta[j] = lp.phi;
+        }
+        pj_authlat_n(m, 1, beta, P->apa);
+        for (j = 0, io = i0*stride; j < m; ++j, io += stride) {
+            if (beta[j] != HUGE_VAL) {
+                y[io] = beta[j];
+            }
+        }
+    }
+    return err;
+}
+static int e_healpix_forward_n(PJ *P, long n, int stride, double *x,
+                               double *y) {
+    return e_forward_run(P, n, stride, x, y, 0);
+}
+static int e_healpix_inverse_n(PJ *P, long n, int stride, double *x,
+                               double *y) {
+    return e_inverse_run(P, n, stride, x, y, 0);
+}
+static int e_rhealpix_forward_n(PJ *P, long n, int stride, double *x,
+                                double *y) {
+    return e_forward_run(P, n, stride, x, y, 1);
+}
+static int e_rhealpix_inverse_n(PJ *P, long n, int stride, double *x,
+                                double *y) {
+    return e_inverse_run(P, n, stride, x, y, 1);
+}
 FREEUP;
 	if (P) {
 		if (P->apa)
-			pj_dalloc(P->apa);
+			pj_table_release(P->apa);
 		pj_dalloc(P);
 	}
 }
@@ -544,6 +659,8 @@ ENTRY1(healpix, apa)
         P->ra = 1.0/P->a;
     	P->fwd = e_healpix_forward;
     	P->inv = e_healpix_inverse; 
+    	P->fwd_n = e_healpix_forward_n;
+    	P->inv_n = e_healpix_inverse_n;
     } else {
     	P->fwd = s_healpix_forward;
     	P->inv = s_healpix_inverse; 
@@ -566,8 +683,304 @@ ENTRY1(rhealpix, apa)
         P->ra = 1.0/P->a;
 	    P->fwd = e_rhealpix_forward;
 	    P->inv = e_rhealpix_inverse; 
+	    P->fwd_n = e_rhealpix_forward_n;
+	    P->inv_n = e_rhealpix_inverse_n;
     } else {
 	    P->fwd = s_rhealpix_forward;
 	    P->inv = s_rhealpix_inverse; 
     }
 ENDENTRY(P)
+/* Largest order whose pixel ids fit in a long. */
+# define HEALPIX_MAX_ORDER (sizeof(long) > 4 ? 29 : 13)
+/* Row and column of the southernmost corner of each base pixel, in units
+   of nside, for pixel_center(). */
+static const int jrll[12] = {2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4};
+static const int jpll[12] = {1, 3, 5, 7, 0, 2, 4, 6, 1, 3, 5, 7};
+/**
+ * Return 1 if P is a HEALPix or rHEALPix projection.
+ **/
+static int is_healpix(PJ *P) {
+    return P->fwd == s_healpix_forward || P->fwd == e_healpix_forward ||
+           P->fwd == s_rhealpix_forward || P->fwd == e_rhealpix_forward;
+}
+/**
+ * Return the integer square root of v.
+ **/
+static long isqrt(long v) {
+    long r = (long)sqrt((double)v + 0.5);
+    while (r*r > v) {
+        r--;
+    }
+    while ((r + 1)*(r + 1) <= v) {
+        r++;
+    }
+    return r;
+}
+/**
+ * Return the nested index within its base pixel of the pixel in column ix
+ * and row iy.
+ **/
+static long xy2pix(long ix, long iy, int order) {
+    long pix = 0;
+    int i;
+    for (i = 0; i < order; i++) {
+        pix |= ((ix >> i) & 1) << (2*i);
+        pix |= ((iy >> i) & 1) << (2*i + 1);
+    }
+    return pix;
+}
+/**
+ * Return the inverse of xy2pix().
+ **/
+static void pix2xy(long pix, int order, long *ix, long *iy) {
+    int i;
+    *ix = *iy = 0;
+    for (i = 0; i < order; i++) {
+        *ix |= ((pix >> (2*i)) & 1) << i;
+        *iy |= ((pix >> (2*i + 1)) & 1) << i;
+    }
+}
+/**
+ * Return the pixel at the given order containing the point of longitude lam
+ * (radians, -pi to pi) and sine z of authalic latitude, in the nested
+ * (nest=1) or ring (nest=0) scheme.
+ * The polar caps use the same sigma = sqrt(3(1 - |z|)) as healpix_sphere(),
+ * and the base pixel comes from the edge line indices, not from pnpoly().
+ **/
+static long pixel_index(double lam, double z, int order, int nest) {
+    long nside = 1L << order, npface = nside*nside;
+    double za = fabs(z), tt = lam*(2.0/PI);
+    long jp, jm, ix, iy;
+    int face;
+    if (tt < 0) {
+        tt += 4.0;
+    }
+    if (tt >= 4.0) {
+        tt -= 4.0;
+    }
+    if (za <= 2.0/3.0) {
+        /* Equatorial region: indices of the ascending and descending edge
+           lines through the point. */
+        double temp1 = nside*(0.5 + tt);
+        double temp2 = nside*(z*0.75);
+        long ifp, ifm;
+        jp = (long)(temp1 - temp2);
+        jm = (long)(temp1 + temp2);
+        if (!nest) {
+            long ir = nside + 1 + jp - jm; /* ring from 1 to 2*nside + 1 */
+            long kshift = 1 - (ir & 1);
+            long ip = ((jp + jm - nside + kshift + 1 + 8*nside) >> 1)
+                      % (4*nside);
+            return 2*nside*(nside - 1) + (ir - 1)*4*nside + ip;
+        }
+        ifp = jp >> order;
+        ifm = jm >> order;
+        face = (int)(ifp == ifm ? ((ifp & 3) | 4)
+                                : (ifp < ifm ? (ifp & 3) : (ifm & 3) + 8));
+        ix = jm & (nside - 1);
+        iy = nside - (jp & (nside - 1)) - 1;
+    } else {
+        /* Polar caps. */
+        int ntt = (int)tt;
+        double tp, tmp;
+        if (ntt >= 4) {
+            ntt = 3;
+        }
+        tp = tt - ntt;
+        tmp = nside*sqrt(3.0*(1.0 - za));
+        jp = (long)(tp*tmp);
+        jm = (long)((1.0 - tp)*tmp);
+        if (jp >= nside) {
+            jp = nside - 1;
+        }
+        if (jm >= nside) {
+            jm = nside - 1;
+        }
+        if (!nest) {
+            long ir = jp + jm + 1; /* ring from the nearest pole */
+            long ip = (long)(tt*ir);
+            if (ip >= 4*ir) {
+                ip -= 4*ir;
+            }
+            return z > 0 ? 2*ir*(ir - 1) + ip
+                         : 12*npface - 2*ir*(ir + 1) + ip;
+        }
+        if (z >= 0) {
+            face = ntt;
+            ix = nside - jm - 1;
+            iy = nside - jp - 1;
+        } else {
+            face = ntt + 8;
+            ix = jp;
+            iy = jm;
+        }
+    }
+    return face*npface + xy2pix(ix, iy, order);
+}
+/**
+ * Return the longitude (radians, -pi to pi) and the sine of authalic
+ * latitude of the center of pixel pix in the nested (nest=1) or ring
+ * (nest=0) scheme.
+ **/
+static void pixel_center(long pix, int order, int nest, double *lam,
+                         double *z) {
+    long nside = 1L << order, npface = nside*nside, npix = 12*npface;
+    long ncap = 2*nside*(nside - 1);
+    double fact2 = 4.0/npix, fact1 = 2*nside*fact2, phi;
+    if (nest) {
+        int face = (int)(pix >> (2*order));
+        long ix, iy, jr, nr, jp, kshift = 0;
+        pix2xy(pix & (npface - 1), order, &ix, &iy);
+        jr = jrll[face]*nside - ix - iy - 1;
+        if (jr < nside) {
+            nr = jr;
+            *z = 1.0 - nr*nr*fact2;
+        } else if (jr > 3*nside) {
+            nr = 4*nside - jr;
+            *z = nr*nr*fact2 - 1.0;
+        } else {
+            nr = nside;
+            *z = (2*nside - jr)*fact1;
+            kshift = (jr - nside) & 1;
+        }
+        jp = (jpll[face]*nr + ix - iy + 1 + kshift)/2;
+        if (jp > 4*nside) {
+            jp -= 4*nside;
+        }
+        if (jp < 1) {
+            jp += 4*nside;
+        }
+        phi = (jp - (kshift + 1)*0.5)*(PI/2.0/nr);
+    } else if (pix < ncap) {
+        long iring = (1 + isqrt(1 + 2*pix)) >> 1;
+        long iphi = pix + 1 - 2*iring*(iring - 1);
+        *z = 1.0 - iring*iring*fact2;
+        phi = (iphi - 0.5)*(PI/2.0/iring);
+    } else if (pix < npix - ncap) {
+        long ip = pix - ncap;
+        long iring = ip/(4*nside) + nside;
+        long iphi = ip % (4*nside) + 1;
+        double fodd = ((iring + nside) & 1) ? 1.0 : 0.5;
+        *z = (2*nside - iring)*fact1;
+        phi = (iphi - fodd)*(PI/(2.0*nside));
+    } else {
+        long ip = npix - pix;
+        long iring = (1 + isqrt(2*ip - 1)) >> 1;
+        long iphi = 4*iring + 1 - (ip - 2*iring*(iring - 1));
+        *z = iring*iring*fact2 - 1.0;
+        phi = (iphi - 0.5)*(PI/2.0/iring);
+    }
+    *lam = phi > PI ? phi - 2.0*PI : phi;
+}
+/**
+ * Return in cells the HEALPix pixel ids at the given order of point_count
+ * longitude-latitude points (radians), in the nested (nest=1) or ring
+ * (nest=0) scheme.  The authalic latitude of P's ellipsoid is used, so the
+ * pixels are those of P's projection.  The cells of failed points are -1,
+ * and the error of the last of them is returned.
+ **/
+int pj_healpix_cells(PJ *P, int order, int nest, long point_count,
+                     int point_offset, const double *lam, const double *phi,
+                     long *cells) {
+    double lamr[PJ_ARRAY_RUN], z[PJ_ARRAY_RUN];
+    long i0, io, j, m;
+    int err = 0;
+    if (!is_healpix(P)) {
+        return -5;
+    }
+    if (order < 0 || order > (int)HEALPIX_MAX_ORDER) {
+        return -14;
+    }
+    if (point_offset == 0) {
+        point_offset = 1;
+    }
+    /* The sines of the authalic latitudes of each run are taken at once. */
+    for (i0 = 0; i0 < point_count; i0 += PJ_ARRAY_RUN) {
+        m = point_count - i0 < PJ_ARRAY_RUN ? point_count - i0 : PJ_ARRAY_RUN;
+        for (j = 0, io = i0*point_offset; j < m; ++j, io += point_offset) {
+            LP lp;
+            double t;
+            lp.lam = lam[io];
+            lp.phi = phi[io];
+            if ((t = fabs(lp.phi) - HALFPI) > 1e-12 || fabs(lp.lam) > 10.) {
+                cells[io] = -1;
+                z[j] = HUGE_VAL;
+                err = -14;
+                continue;
+            }
+            if (fabs(t) <= 1e-12) {
+                lp.phi = lp.phi < 0. ? -HALFPI : HALFPI;
+            } else if (P->geoc) {
+                lp.phi = atan(P->rone_es*tan(lp.phi));
+            }
+            lamr[j] = adjlon(lp.lam - P->lam0);
+            z[j] = P->es ? lp.phi : sin(lp.phi);
+        }
+        if (P->es) {
+            auth_sin_n(P, m, 1, z);
+        }
+        for (j = 0, io = i0*point_offset; j < m; ++j, io += point_offset) {
+            if (z[j] != HUGE_VAL) {
+                cells[io] = pixel_index(lamr[j], z[j], order, nest);
+            }
+        }
+    }
+    if (err) {
+        pj_ctx_set_errno(P->ctx, err);
+    }
+    return err;
+}
+/**
+ * Return in lam and phi the longitude-latitude (radians) of the centers of
+ * point_count HEALPix pixels at the given order, the inverse of
+ * pj_healpix_cells().  Invalid pixel ids give HUGE_VAL, and the error of
+ * the last of them is returned.
+ **/
+int pj_healpix_centers(PJ *P, int order, int nest, long point_count,
+                       int point_offset, const long *cells, double *lam,
+                       double *phi) {
+    long i, npix;
+    int err = 0;
+    if (!is_healpix(P)) {
+        return -5;
+    }
+    if (order < 0 || order > (int)HEALPIX_MAX_ORDER) {
+        return -15;
+    }
+    if (point_offset == 0) {
+        point_offset = 1;
+    }
+    npix = 12*(1L << (2*order));
+    for (i = 0; i < point_count; i++) {
+        long io = i*point_offset;
+        double z;
+        if (cells[io] < 0 || cells[io] >= npix) {
+            lam[io] = phi[io] = HUGE_VAL;
+            err = -15;
+            continue;
+        }
+        pixel_center(cells[io], order, nest, lam + io, &z);
+        phi[io] = asin(z);
+    }
+    /* The latitudes of the authalic ones are taken at once. */
+    if (P->es) {
+        pj_authlat_n(point_count, point_offset, phi, P->apa);
+    }
+    for (i = 0; i < point_count; i++) {
+        long io = i*point_offset;
+        if (phi[io] == HUGE_VAL) {
+            continue;
+        }
+        if (P->geoc && fabs(fabs(phi[io]) - HALFPI) > 1e-12) {
+            phi[io] = atan(P->one_es*tan(phi[io]));
+        }
+        lam[io] += P->lam0;
+        if (!P->over) {
+            lam[io] = adjlon(lam[io]);
+        }
+    }
+    if (err) {
+        pj_ctx_set_errno(P->ctx, err);
+    }
+    return err;
+}
@@ -24,26 +24,44 @@ static const double d180 = 180 * DEG_TO_RAD;
 
 static const double EPSLN = 1.e-10; // allow a little 'slack' on zone edge positions
 
-FORWARD(s_forward); /* spheroid */
-        int z;
-        if (lp.phi >=  d4044118) {          // 1|2
-          z = (lp.lam <= -d40 ? 1: 2);
-        }
-        else if (lp.phi >=  0) {            // 3|4
-          z = (lp.lam <= -d40 ? 3: 4);
-        }
-        else if (lp.phi >= -d4044118) {     // 5|6|7|8
-               if (lp.lam <= -d100) z =  5; // 5
-          else if (lp.lam <=  -d20) z =  6; // 6
-          else if (lp.lam <=   d80) z =  7; // 7
-          else z = 8;                       // 8
-        }
-        else {                              // 9|10|11|12
-               if (lp.lam <= -d100) z =  9; // 9
-          else if (lp.lam <=  -d20) z = 10; // 10
-          else if (lp.lam <=   d80) z = 11; // 11
-          else z = 12;                      // 12
+static const int band_zone[4] = { 1, 3, 5, 9 }; // first zone of each band
+
+/* zone of a point by band of v and longitude edges of u, 1 to 12 */
+static int igh_zone(double v, double u) {
+        int band = (v >= d4044118 ? 0 : v >= 0 ? 1 : v >= -d4044118 ? 2 : 3);
+
+        if (band < 2)
+          return band_zone[band] + (u > -d40);
+        return band_zone[band] + (u > -d100) + (u > -d20) + (u > d80);
+}
+
+/* is lp, unshifted by zone z, projectable in that zone? */
+static int igh_valid(int z, LP lp) {
+        switch (z) {
+          case  1: return (lp.lam >= -d180-EPSLN && lp.lam <=  -d40+EPSLN) ||
+                         ((lp.lam >=  -d40-EPSLN && lp.lam <=  -d10+EPSLN) &&
+                          (lp.phi >=   d60-EPSLN && lp.phi <=   d90+EPSLN));
+          case  2: return (lp.lam >=  -d40-EPSLN && lp.lam <=  d180+EPSLN) ||
+                         ((lp.lam >= -d180-EPSLN && lp.lam <= -d160+EPSLN) &&
+                          (lp.phi >=   d50-EPSLN && lp.phi <=   d90+EPSLN)) ||
+                         ((lp.lam >=  -d50-EPSLN && lp.lam <=  -d40+EPSLN) &&
+                          (lp.phi >=   d60-EPSLN && lp.phi <=   d90+EPSLN));
+          case  3: return (lp.lam >= -d180-EPSLN && lp.lam <=  -d40+EPSLN);
+          case  4: return (lp.lam >=  -d40-EPSLN && lp.lam <=  d180+EPSLN);
+          case  5: return (lp.lam >= -d180-EPSLN && lp.lam <= -d100+EPSLN);
+          case  6: return (lp.lam >= -d100-EPSLN && lp.lam <=  -d20+EPSLN);
+          case  7: return (lp.lam >=  -d20-EPSLN && lp.lam <=   d80+EPSLN);
+          case  8: return (lp.lam >=   d80-EPSLN && lp.lam <=  d180+EPSLN);
+          case  9: return (lp.lam >= -d180-EPSLN && lp.lam <= -d100+EPSLN);
+          case 10: return (lp.lam >= -d100-EPSLN && lp.lam <=  -d20+EPSLN);
+          case 11: return (lp.lam >=  -d20-EPSLN && lp.lam <=   d80+EPSLN);
+          case 12: return (lp.lam >=   d80-EPSLN && lp.lam <=  d180+EPSLN);
         }
+        return 0;
+}
+
+FORWARD(s_forward); /* spheroid */
+        int z = igh_zone(lp.phi, lp.lam);
 
         lp.lam -= P->pj[z-1]->lam0;
         xy = P->pj[z-1]->fwd(lp, P->pj[z-1]);
@@ -56,62 +74,127 @@ INVERSE(s_inverse); /* spheroid */
         const double y90 = P->dy0 + sqrt(2); // lt=90 corresponds to y=y0+sqrt(2)
 
         int z = 0;
-        if (xy.y > y90+EPSLN || xy.y < -y90+EPSLN) // 0
+        if (xy.y > y90+EPSLN || xy.y < -y90-EPSLN) // 0
           z = 0;
-        else if (xy.y >=  d4044118)       // 1|2
-          z = (xy.x <= -d40? 1: 2);
-        else if (xy.y >=  0)              // 3|4
-          z = (xy.x <= -d40? 3: 4);
-        else if (xy.y >= -d4044118) {     // 5|6|7|8
-               if (xy.x <= -d100) z =  5; // 5
-          else if (xy.x <=  -d20) z =  6; // 6
-          else if (xy.x <=   d80) z =  7; // 7
-          else z = 8;                     // 8
-        }
-        else {                            // 9|10|11|12
-               if (xy.x <= -d100) z =  9; // 9
-          else if (xy.x <=  -d20) z = 10; // 10
-          else if (xy.x <=   d80) z = 11; // 11
-          else z = 12;                    // 12
-        }
+        else
+          z = igh_zone(xy.y, xy.x);
 
-        if (z)
+        if (z && fabs(xy.y) >= y90-EPSLN) // a pole, whose x says nothing
+        {
+          lp.lam = P->pj[z-1]->lam0;
+          lp.phi = (xy.y < 0. ? -HALFPI : HALFPI);
+        }
+        else if (z)
         {
-          int ok = 0;
-
           xy.x -= P->pj[z-1]->x0;
           xy.y -= P->pj[z-1]->y0;
           lp = P->pj[z-1]->inv(xy, P->pj[z-1]);
           lp.lam += P->pj[z-1]->lam0;
 
-          switch (z) {
-            case  1: ok = (lp.lam >= -d180-EPSLN && lp.lam <=  -d40+EPSLN) ||
-                         ((lp.lam >=  -d40-EPSLN && lp.lam <=  -d10+EPSLN) &&
-                          (lp.phi >=   d60-EPSLN && lp.phi <=   d90+EPSLN)); break;
-            case  2: ok = (lp.lam >=  -d40-EPSLN && lp.lam <=  d180+EPSLN) ||
-                         ((lp.lam >= -d180-EPSLN && lp.lam <= -d160+EPSLN) &&
-                          (lp.phi >=   d50-EPSLN && lp.phi <=   d90+EPSLN)) ||
-                         ((lp.lam >=  -d50-EPSLN && lp.lam <=  -d40+EPSLN) &&
-                          (lp.phi >=   d60-EPSLN && lp.phi <=   d90+EPSLN)); break;
-            case  3: ok = (lp.lam >= -d180-EPSLN && lp.lam <=  -d40+EPSLN); break;
-            case  4: ok = (lp.lam >=  -d40-EPSLN && lp.lam <=  d180+EPSLN); break;
-            case  5: ok = (lp.lam >= -d180-EPSLN && lp.lam <= -d100+EPSLN); break;
-            case  6: ok = (lp.lam >= -d100-EPSLN && lp.lam <=  -d20+EPSLN); break;
-            case  7: ok = (lp.lam >=  -d20-EPSLN && lp.lam <=   d80+EPSLN); break;
-            case  8: ok = (lp.lam >=   d80-EPSLN && lp.lam <=  d180+EPSLN); break;
-            case  9: ok = (lp.lam >= -d180-EPSLN && lp.lam <= -d100+EPSLN); break;
-            case 10: ok = (lp.lam >= -d100-EPSLN && lp.lam <=  -d20+EPSLN); break;
-            case 11: ok = (lp.lam >=  -d20-EPSLN && lp.lam <=   d80+EPSLN); break;
-            case 12: ok = (lp.lam >=   d80-EPSLN && lp.lam <=  d180+EPSLN); break;
-          }
-
-          z = (!ok? 0: z); // projectable?
+          z = (!igh_valid(z, lp)? 0: z); // projectable?
         }
      // if (!z) pj_errno = -15; // invalid x or y
         if (!z) lp.lam = HUGE_VAL;
         if (!z) lp.phi = HUGE_VAL;
         return (lp);
 }
+
+/*
+  The array kernels sort a run of points into zones, and pass the
+  points of each zone to the array kernel of its projection at once.
+*/
+#define IGH_RUN 256
+
+static int s_forward_n(PJ *P, long n, int stride, double *x, double *y) {
+        double u[IGH_RUN], v[IGH_RUN];
+        long at[IGH_RUN], i0, j, k, m;
+        char zone[IGH_RUN];
+        int z, err = 0;
+
+        for (i0 = 0; i0 < n; i0 += IGH_RUN) {
+          m = (n - i0 < IGH_RUN ? n - i0 : IGH_RUN);
+          for (j = 0; j < m; ++j) {
+            long io = (i0 + j) * stride;
+            zone[j] = (x[io] == HUGE_VAL ? 0 : igh_zone(y[io], x[io]));
+          }
+          for (z = 1; z <= 12; ++z) {
+            PJ *Q = P->pj[z-1];
+            int kerr;
+
+            for (j = k = 0; j < m; ++j)
+              if (zone[j] == z) {
+                long io = (i0 + j) * stride;
+                at[k] = io;
+                u[k] = x[io] - Q->lam0;
+                v[k++] = y[io];
+              }
+            if (!k)
+              continue;
+            if ((kerr = pj_fwd_kernel(Q, k, 1, u, v)) != 0)
+              err = kerr;
+            for (j = 0; j < k; ++j) {
+              x[at[j]] = u[j] + Q->x0;
+              y[at[j]] = v[j] + Q->y0;
+            }
+          }
+        }
+        return err;
+}
+
+static int s_inverse_n(PJ *P, long n, int stride, double *x, double *y) {
+        const double y90 = P->dy0 + sqrt(2);
+        double u[IGH_RUN], v[IGH_RUN];
+        long at[IGH_RUN], i0, j, k, m;
+        char zone[IGH_RUN];
+        int z, err = 0;
+
+        for (i0 = 0; i0 < n; i0 += IGH_RUN) {
+          m = (n - i0 < IGH_RUN ? n - i0 : IGH_RUN);
+          for (j = 0; j < m; ++j) {
+            long io = (i0 + j) * stride;
+            if (x[io] == HUGE_VAL)
+              zone[j] = -1;
+            else if (y[io] > y90+EPSLN || y[io] < -y90-EPSLN)
+              zone[j] = 0;
+            else
+              zone[j] = igh_zone(y[io], x[io]);
+            if (!zone[j])
+              x[io] = y[io] = HUGE_VAL;
+            else if (fabs(y[io]) >= y90-EPSLN) { // a pole, as s_inverse
+              x[io] = P->pj[zone[j]-1]->lam0;
+              y[io] = (y[io] < 0. ? -HALFPI : HALFPI);
+              zone[j] = -1;
+            }
+          }
+          for (z = 1; z <= 12; ++z) {
+            PJ *Q = P->pj[z-1];
+            int kerr;
+
+            for (j = k = 0; j < m; ++j)
+              if (zone[j] == z) {
+                long io = (i0 + j) * stride;
+                at[k] = io;
+                u[k] = x[io] - Q->x0;
+                v[k++] = y[io] - Q->y0;
+              }
+            if (!k)
+              continue;
+            if ((kerr = pj_inv_kernel(Q, k, 1, u, v)) != 0)
+              err = kerr;
+            for (j = 0; j < k; ++j) {
+              LP lp;
+
+              lp.lam = u[j] + Q->lam0;
+              lp.phi = v[j];
+              if (!igh_valid(z, lp))
+                lp.lam = lp.phi = HUGE_VAL;
+              x[at[j]] = lp.lam;
+              y[at[j]] = lp.phi;
+            }
+          }
+        }
+        return err;
+}
 FREEUP;
         if (P) {
                 int i;
@@ -146,6 +229,7 @@ ENTRY0(igh)
 
 #define SETUP(n, proj, x_0, y_0, lon_0) \
     if (!(P->pj[n-1] = pj_##proj(0))) E_ERROR_0; \
+    P->pj[n-1]->ctx = P->ctx; \
     if (!(P->pj[n-1] = pj_##proj(P->pj[n-1]))) E_ERROR_0; \
     P->pj[n-1]->x0 = x_0; \
     P->pj[n-1]->y0 = y_0; \
@@ -183,6 +267,8 @@ ENTRY0(igh)
 
         P->inv = s_inverse;
         P->fwd = s_forward;
+        P->inv_n = s_inverse_n;
+        P->fwd_n = s_forward_n;
         P->es = 0.;
 ENDENTRY(P)
 
@@ -100,7 +100,7 @@ xy(PJ *P, double phi, double *x, double *y, double *sp, double *R) {
 	*y = *R * (1 - cos(F));
 	*x = *R * sin(F);
 }
-FREEUP; if (P) { if (P->en) pj_dalloc(P->en); pj_dalloc(P); } }
+FREEUP; if (P) { if (P->en) pj_table_release(P->en); pj_dalloc(P); } }
 ENTRY1(imw_p, en)
 	double del, sig, s, t, x1, x2, T2, y1, m1, m2, y2;
 	int i;
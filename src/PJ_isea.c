@@ -114,6 +114,13 @@ enum isea_address_form { ISEA_GEO, ISEA_Q2DI, ISEA_SEQNUM, ISEA_INTERLEAVE,
 	ISEA_PLANE, ISEA_Q2DD, ISEA_PROJTRI, ISEA_VERTEX2DD, ISEA_HEX
 };
 
+/* constants of a face, from isea_grid_init() */
+struct isea_face {
+	double	lon, sin_lat, cos_lat; /* center of the face */
+	double	v[3]; /* unit vector of the center */
+	double	az_offset; /* az_adjustment() */
+};
+
 struct isea_dgg {
 	int	polyhedron; /* ignored, icosahedron */
 	double	o_lat, o_lon, o_az; /* orientation, radians */
@@ -126,6 +133,9 @@ struct isea_dgg {
 	int	triangle; /* triangle of last transformed point */
 	int	quad; /* quad of last transformed point */
 	unsigned long serial;
+	/* snyder constants of the icosahedron, in radians */
+	double	g, G, sin_G, cos_g, cos_G, tan_g, cot_theta;
+	struct isea_face face[21]; /* face[0] unused */
 };
 
 struct isea_pt {
@@ -301,186 +311,174 @@ isea_triangle_xy(int triangle)
 	return c;
 }
 
-/* snyder eq 14 */
-static double
-sph_azimuth(double f_lon, double f_lat, double t_lon, double t_lat)
-{
-	double          az;
-
-	az = atan2(cos(t_lat) * sin(t_lon - f_lon),
-		   cos(f_lat) * sin(t_lat)
-		   - sin(f_lat) * cos(t_lat) * cos(t_lon - f_lon)
-		);
-	return az;
-}
+/* margin of q - z in radians within which a face is not trusted */
+#define ISEA_FACE_MARGIN 1.0e-4
 
-/* coord needs to be in radians */
-ISEA_STATIC
-int
-isea_snyder_forward(struct isea_geo * ll, struct isea_pt * out)
+/*
+ * project ll on triangle i, returns 0 if not on it and sets *margin to
+ * how far inside the edge it is
+ */
+static int
+isea_snyder_face(struct isea_dgg *g, int i, struct isea_geo *ll,
+		 double sin_lat, double cos_lat,
+		 struct isea_pt *out, double *margin)
 {
-	int             i;
-
-	/*
-	 * spherical distance from center of polygon face to any of its
-	 * vertexes on the globe
-	 */
-	double          g;
-
-	/*
-	 * spherical angle between radius vector to center and adjacent edge
-	 * of spherical polygon on the globe
-	 */
-	double          G;
-
-	/*
-	 * plane angle between radius vector to center and adjacent edge of
-	 * plane polygon
-	 */
-	double          theta;
+	struct isea_face *face = g->face + i;
 
 	/* additional variables from snyder */
 	double          q, Rprime, H, Ag, Azprime, Az, dprime, f, rho,
-	                x, y;
-
-	/* variables used to store intermediate results */
-	double          cot_theta, tan_g, az_offset;
+	                x, y, z, dlon, cos_dlon;
 
 	/* how many multiples of 60 degrees we adjust the azimuth */
 	int             Az_adjust_multiples;
 
-	struct snyder_constants c;
-
-	/*
-	 * TODO by locality of reference, start by trying the same triangle
-	 * as last time
-	 */
+	/* step 1 */
+	dlon = ll->lon - face->lon;
+	cos_dlon = cos(dlon);
+	z = acos(face->sin_lat * sin_lat + face->cos_lat * cos_lat * cos_dlon);
 
-	/* TODO put these constants in as radians to begin with */
-	c = constants[SNYDER_POLY_ICOSAHEDRON];
-	theta = c.theta * DEG2RAD;
-	g = c.g * DEG2RAD;
-	G = c.G * DEG2RAD;
-
-	for (i = 1; i <= 20; i++) {
-		double          z;
-		struct isea_geo center;
+	/* not on this triangle */
+	*margin = 0.0;
+	if (z > g->g + 0.000005) { /* TODO DBL_EPSILON */
+		return 0;
+	}
 
-		center = icostriangles[i];
+	Az = atan2(cos_lat * sin(dlon),
+		   face->cos_lat * sin_lat - face->sin_lat * cos_lat * cos_dlon);
 
-		/* step 1 */
-#if 0
-		z = sph_distance(center.lon, center.lat, ll->lon, ll->lat);
-#else
-		z = acos(sin(center.lat) * sin(ll->lat)
-			 + cos(center.lat) * cos(ll->lat) * cos(ll->lon - center.lon));
-#endif
+	/* step 2 */
 
-		/* not on this triangle */
-		if (z > g + 0.000005) { /* TODO DBL_EPSILON */
-			continue;
-		}
-		Az = sph_azimuth(ll->lon, ll->lat, center.lon, center.lat);
+	/* This calculates "some" vertex coordinate */
+	Az -= face->az_offset;
 
-		Az = atan2(cos(ll->lat) * sin(ll->lon - center.lon),
-			   cos(center.lat) * sin(ll->lat)
-		- sin(center.lat) * cos(ll->lat) * cos(ll->lon - center.lon)
-			);
+	/* TODO I don't know why we do this.  It's not in snyder */
+	/* maybe because we should have picked a better vertex */
+	if (Az < 0.0) {
+		Az += 2.0 * M_PI;
+	}
+	/*
+	 * adjust Az for the point to fall within the range of 0 to
+	 * 2(90 - theta) or 60 degrees for the hexagon, by
+	 * and therefore 120 degrees for the triangle
+	 * of the icosahedron
+	 * subtracting or adding multiples of 60 degrees to Az and
+	 * recording the amount of adjustment
+	 */
 
-		/* step 2 */
+	Az_adjust_multiples = 0;
+	while (Az < 0.0) {
+		Az += DEG120;
+		Az_adjust_multiples--;
+	}
+	while (Az > DEG120 + DBL_EPSILON) {
+		Az -= DEG120;
+		Az_adjust_multiples++;
+	}
 
-		/* This calculates "some" vertex coordinate */
-		az_offset = az_adjustment(i);
+	/* step 3 */
 
-		Az -= az_offset;
+	/* Calculate q from eq 9. */
+	q = atan2(g->tan_g, cos(Az) + sin(Az) * g->cot_theta);
 
-		/* TODO I don't know why we do this.  It's not in snyder */
-		/* maybe because we should have picked a better vertex */
-		if (Az < 0.0) {
-			Az += 2.0 * M_PI;
-		}
-		/*
-		 * adjust Az for the point to fall within the range of 0 to
-		 * 2(90 - theta) or 60 degrees for the hexagon, by
-		 * and therefore 120 degrees for the triangle
-		 * of the icosahedron
-		 * subtracting or adding multiples of 60 degrees to Az and
-		 * recording the amount of adjustment
-		 */
-
-		Az_adjust_multiples = 0;
-		while (Az < 0.0) {
-			Az += DEG120;
-			Az_adjust_multiples--;
-		}
-		while (Az > DEG120 + DBL_EPSILON) {
-			Az -= DEG120;
-			Az_adjust_multiples++;
-		}
+	/* not in this triangle */
+	*margin = q - z;
+	if (z > q + 0.000005) {
+		return 0;
+	}
+	/* step 4 */
 
-		/* step 3 */
-		cot_theta = 1.0 / tan(theta);
-		tan_g = tan(g);	/* TODO this is a constant */
+	/* Apply equations 5-8 and 10-12 in order */
 
-		/* Calculate q from eq 9. */
-		/* TODO cot_theta is cot(30) */
-		q = atan2(tan_g, cos(Az) + sin(Az) * cot_theta);
+	/* eq 5 */
+	/* Rprime = 0.9449322893 * R; */
+	/* R' in the paper is for the truncated */
+	Rprime = RPRIME;
 
-		/* not in this triangle */
-		if (z > q + 0.000005) {
-			continue;
-		}
-		/* step 4 */
+	/* eq 6 */
+	H = acos(sin(Az) * g->sin_G * g->cos_g - cos(Az) * g->cos_G);
 
-		/* Apply equations 5-8 and 10-12 in order */
+	/* eq 7 */
+	/* Ag = (Az + G + H - DEG180) * M_PI * R * R / DEG180; */
+	Ag = Az + g->G + H - DEG180;
 
-		/* eq 5 */
-		/* Rprime = 0.9449322893 * R; */
-		/* R' in the paper is for the truncated */
-		Rprime = 0.91038328153090290025;
+	/* eq 8 */
+	Azprime = atan2(2.0 * Ag, Rprime * Rprime * g->tan_g * g->tan_g
+			- 2.0 * Ag * g->cot_theta);
 
-		/* eq 6 */
-		H = acos(sin(Az) * sin(G) * cos(g) - cos(Az) * cos(G));
+	/* eq 10 */
+	/* cot(theta) = 1.73205080756887729355 */
+	dprime = Rprime * g->tan_g / (cos(Azprime) + sin(Azprime) * g->cot_theta);
 
-		/* eq 7 */
-		/* Ag = (Az + G + H - DEG180) * M_PI * R * R / DEG180; */
-		Ag = Az + G + H - DEG180;
+	/* eq 11 */
+	f = dprime / (2.0 * Rprime * sin(q / 2.0));
 
-		/* eq 8 */
-		Azprime = atan2(2.0 * Ag, Rprime * Rprime * tan_g * tan_g - 2.0 * Ag * cot_theta);
+	/* eq 12 */
+	rho = 2.0 * Rprime * f * sin(z / 2.0);
 
-		/* eq 10 */
-		/* cot(theta) = 1.73205080756887729355 */
-		dprime = Rprime * tan_g / (cos(Azprime) + sin(Azprime) * cot_theta);
+	/*
+	 * add back the same 60 degree multiple adjustment from step
+	 * 2 to Azprime
+	 */
 
-		/* eq 11 */
-		f = dprime / (2.0 * Rprime * sin(q / 2.0));
+	Azprime += DEG120 * Az_adjust_multiples;
 
-		/* eq 12 */
-		rho = 2.0 * Rprime * f * sin(z / 2.0);
+	/* calculate rectangular coordinates */
 
-		/*
-		 * add back the same 60 degree multiple adjustment from step
-		 * 2 to Azprime
-		 */
+	x = rho * sin(Azprime);
+	y = rho * cos(Azprime);
 
-		Azprime += DEG120 * Az_adjust_multiples;
+	/*
+	 * TODO
+	 * translate coordinates to the origin for the particular
+	 * hexagon on the flattened polyhedral map plot
+	 */
 
-		/* calculate rectangular coordinates */
+	out->x = x;
+	out->y = y;
 
-		x = rho * sin(Azprime);
-		y = rho * cos(Azprime);
+	return 1;
+}
 
-		/*
-		 * TODO
-		 * translate coordinates to the origin for the particular
-		 * hexagon on the flattened polyhedral map plot
-		 */
+/* coord needs to be in radians */
+ISEA_STATIC
+int
+isea_snyder_forward(struct isea_dgg *g, struct isea_geo * ll,
+		    struct isea_pt * out)
+{
+	int             i, best;
+	double          sin_lat, cos_lat, p[3], dot, best_dot, margin;
+
+	sin_lat = sin(ll->lat);
+	cos_lat = cos(ll->lat);
+
+	/* the face is the one with the nearest center */
+	p[0] = cos_lat * cos(ll->lon);
+	p[1] = cos_lat * sin(ll->lon);
+	p[2] = sin_lat;
+	best = 1;
+	best_dot = -2.0;
+	for (i = 1; i <= 20; i++) {
+		double *v = g->face[i].v;
 
-		out->x = x;
-		out->y = y;
+		dot = v[0] * p[0] + v[1] * p[1] + v[2] * p[2];
+		if (dot > best_dot) {
+			best_dot = dot;
+			best = i;
+		}
+	}
+	if (isea_snyder_face(g, best, ll, sin_lat, cos_lat, out, &margin)
+	    && margin > ISEA_FACE_MARGIN) {
+		return best;
+	}
 
-		return i;
+	/*
+	 * near an edge the tolerances may also accept a neighbour, so take
+	 * the first triangle that does
+	 */
+	for (i = 1; i <= 20; i++) {
+		if (isea_snyder_face(g, i, ll, sin_lat, cos_lat, out, &margin)) {
+			return i;
+		}
 	}
 
 	/*
@@ -593,6 +591,37 @@ isea_ctran(struct isea_geo * np, struct isea_geo * pt, double lon0)
 
 /* fuller's at 5.2454 west, 2.3009 N, adjacent at 7.46658 deg */
 
+/* per face constants of isea_snyder_forward() */
+static void
+isea_face_init(struct isea_dgg * g)
+{
+	struct snyder_constants c;
+	double          theta;
+	int             i;
+
+	c = constants[SNYDER_POLY_ICOSAHEDRON];
+	theta = c.theta * DEG2RAD;
+	g->g = c.g * DEG2RAD;
+	g->G = c.G * DEG2RAD;
+	g->sin_G = sin(g->G);
+	g->cos_G = cos(g->G);
+	g->cos_g = cos(g->g);
+	g->tan_g = tan(g->g);
+	g->cot_theta = 1.0 / tan(theta);
+
+	for (i = 1; i <= 20; i++) {
+		struct isea_face *f = g->face + i;
+
+		f->lon = icostriangles[i].lon;
+		f->sin_lat = sin(icostriangles[i].lat);
+		f->cos_lat = cos(icostriangles[i].lat);
+		f->v[0] = f->cos_lat * cos(f->lon);
+		f->v[1] = f->cos_lat * sin(f->lon);
+		f->v[2] = f->sin_lat;
+		f->az_offset = az_adjustment(i);
+	}
+}
+
 ISEA_STATIC
 int
 isea_grid_init(struct isea_dgg * g)
@@ -608,6 +637,7 @@ isea_grid_init(struct isea_dgg * g)
 	g->resolution = 6;
 	g->radius = 1.0;
 	g->topology = 6;
+	isea_face_init(g);
 
 	return 1;
 }
@@ -649,7 +679,7 @@ isea_transform(struct isea_dgg * g, struct isea_geo * in,
 
 	i = isea_ctran(&pole, in, g->o_az);
 
-	tri = isea_snyder_forward(&i, out);
+	tri = isea_snyder_forward(g, &i, out);
 	out->x *= g->radius;
 	out->y *= g->radius;
 	g->triangle = tri;
@@ -1051,6 +1081,54 @@ FORWARD(s_forward);
 }
 FREEUP; if (P) pj_dalloc(P); }
 
+/*
+ * isea_dgg sequence numbers of the cells of point_count points, longitudes
+ * and latitudes in radians as for pj_fwd().  The cells of failed points
+ * are 0, and the error of the last of them is returned.
+ */
+	int
+pj_isea_cells(PJ *P, long point_count, int point_offset,
+		const double *lam, const double *phi, unsigned long *cells) {
+	struct isea_dgg g;
+	struct isea_geo in;
+	long i;
+	int err = 0;
+
+	if (P->fwd != s_forward)
+		return -5;
+	if (point_offset == 0)
+		point_offset = 1;
+
+	/* a copy, so P->dgg keeps its own output and last cell */
+	g = P->dgg;
+	g.output = ISEA_SEQNUM;
+	for (i = 0; i < point_count; i++) {
+		long io = i * point_offset;
+		double t;
+
+		in.lon = lam[io];
+		in.lat = phi[io];
+		if ((t = fabs(in.lat) - HALFPI) > 1.0e-12 || fabs(in.lon) > 10.) {
+			cells[io] = 0;
+			err = -14;
+			continue;
+		}
+		if (fabs(t) <= 1.0e-12)
+			in.lat = in.lat < 0. ? -HALFPI : HALFPI;
+		else if (P->geoc)
+			in.lat = atan(P->rone_es * tan(in.lat));
+		in.lon -= P->lam0;
+		if (!P->over)
+			in.lon = adjlon(in.lon);
+		isea_forward(&g, &in);
+		cells[io] = g.serial;
+	}
+
+	if (err)
+		pj_ctx_set_errno(P->ctx, err);
+	return err;
+}
+
 ENTRY0(isea)
 	char *opt;
 
@@ -30,7 +30,10 @@
  *****************************************************************************/
 
 #define PROJ_PARMS__ \
-	double	C_x;
+	double	C_x; \
+	double	alfa, k, ik, n, ro0, ts0, ts0n; \
+	double	cosad, sinad; \
+	int	czech;
 #define PJ_LIB__
 
 #include <projects.h>
@@ -66,62 +69,38 @@ PROJ_HEAD(krovak, "Krovak") "\n\tPCyl., Ellps.";
 
 
 
+/* Constants of the algorithm.  The ellipsoid is Bessel 1841, with a = 1
+   here as pj_fwd() and pj_inv() scale by a = 6377397.155m. */
+#define S45 0.785398163397448           /* 45 deg */
+#define S90 (2 * S45)
+#define UQ 1.04216856380474             /* DU(2, 59, 42, 42.69689) */
+#define S0 1.37008346281555             /* pseudo standard parallel 78d30'N */
+#define E2 0.006674372230614
+#define EPS 0.000000000000001
+#define N_ITER 10
+
 FORWARD(e_forward); /* ellipsoid */
 /* calculate xy from lat/lon */
+	double e, gfi, u, deltav, s, d, eps, ro;
 
-/* Constants, identical to inverse transform function */
-	double s45, s90, e2, e, alfa, uq, u0, g, k, k1, n0, ro0, ad, a, s0, n;
-	double gfi, u, fi0, deltav, s, d, eps, ro;
-
-
-	s45 = 0.785398163397448;    /* 45 */
-	s90 = 2 * s45;
-	fi0 = P->phi0;    /* Latitude of projection centre 49 30' */
-
-   /* Ellipsoid is used as Parameter in for.c and inv.c, therefore a must 
-      be set to 1 here.
-      Ellipsoid Bessel 1841 a = 6377397.155m 1/f = 299.1528128,
-      e2=0.006674372230614;
-   */
-	a =  1; /* 6377397.155; */
-	/* e2 = P->es;*/       /* 0.006674372230614; */
-	e2 = 0.006674372230614;
-	e = sqrt(e2);
-
-	alfa = sqrt(1. + (e2 * pow(cos(fi0), 4)) / (1. - e2));
-
-	uq = 1.04216856380474;      /* DU(2, 59, 42, 42.69689) */
-	u0 = asin(sin(fi0) / alfa);
-	g = pow(   (1. + e * sin(fi0)) / (1. - e * sin(fi0)) , alfa * e / 2.  );
-
-	k = tan( u0 / 2. + s45) / pow  (tan(fi0 / 2. + s45) , alfa) * g;
-
-	k1 = P->k0;
-	n0 = a * sqrt(1. - e2) / (1. - e2 * pow(sin(fi0), 2));
-	s0 = 1.37008346281555;       /* Latitude of pseudo standard parallel 78 30'00" N */
-	n = sin(s0);
-	ro0 = k1 * n0 / tan(s0);
-	ad = s90 - uq;
-
-/* Transformation */
-
+	e = sqrt(E2);
 	gfi =pow ( ((1. + e * sin(lp.phi)) /
-               (1. - e * sin(lp.phi))) , (alfa * e / 2.));
+               (1. - e * sin(lp.phi))) , (P->alfa * e / 2.));
 
-	u= 2. * (atan(k * pow( tan(lp.phi / 2. + s45), alfa) / gfi)-s45);
+	u= 2. * (atan(P->k * pow( tan(lp.phi / 2. + S45), P->alfa) / gfi)-S45);
 
-	deltav = - lp.lam * alfa;
+	deltav = - lp.lam * P->alfa;
 
-	s = asin(cos(ad) * sin(u) + sin(ad) * cos(u) * cos(deltav));
+	s = asin(P->cosad * sin(u) + P->sinad * cos(u) * cos(deltav));
 	d = asin(cos(u) * sin(deltav) / cos(s));
-	eps = n * d;
-	ro = ro0 * pow(tan(s0 / 2. + s45) , n) / pow(tan(s / 2. + s45) , n)   ;
+	eps = P->n * d;
+	ro = P->ro0 * P->ts0n / pow(tan(s / 2. + S45) , P->n)   ;
 
    /* x and y are reverted! */
-	xy.y = ro * cos(eps) / a;
-	xy.x = ro * sin(eps) / a;
+	xy.y = ro * cos(eps);
+	xy.x = ro * sin(eps);
 
-        if( !pj_param(P->ctx, P->params, "tczech").i )
+        if( !P->czech )
 	  {
 	    xy.y *= -1.0;
 	    xy.x *= -1.0;
@@ -130,53 +109,19 @@ FORWARD(e_forward); /* ellipsoid */
 	return (xy);
 }
 
-
-
 INVERSE(e_inverse); /* ellipsoid */
 	/* calculate lat/lon from xy */
+	double e, u, deltav, s, d, eps, ro, fi1, xy0, K, f, sinfi, dfi;
+	int i;
 
-/* Constants, identisch wie in der Umkehrfunktion */
-	double s45, s90, fi0, e2, e, alfa, uq, u0, g, k, k1, n0, ro0, ad, a, s0, n;
-	double u, deltav, s, d, eps, ro, fi1, xy0;
-	int ok;
-
-	s45 = 0.785398163397448;    /* 45 */
-	s90 = 2 * s45;
-	fi0 = P->phi0;    /* Latitude of projection centre 49 30' */
+	e = sqrt(E2);
 
-
-   /* Ellipsoid is used as Parameter in for.c and inv.c, therefore a must 
-      be set to 1 here.
-      Ellipsoid Bessel 1841 a = 6377397.155m 1/f = 299.1528128,
-      e2=0.006674372230614;
-   */
-	a = 1; /* 6377397.155; */
-	/* e2 = P->es; */      /* 0.006674372230614; */
-	e2 = 0.006674372230614;
-	e = sqrt(e2);
-
-	alfa = sqrt(1. + (e2 * pow(cos(fi0), 4)) / (1. - e2));
-	uq = 1.04216856380474;      /* DU(2, 59, 42, 42.69689) */
-	u0 = asin(sin(fi0) / alfa);
-	g = pow(   (1. + e * sin(fi0)) / (1. - e * sin(fi0)) , alfa * e / 2.  );
-
-	k = tan( u0 / 2. + s45) / pow  (tan(fi0 / 2. + s45) , alfa) * g;
-
-	k1 = P->k0;
-	n0 = a * sqrt(1. - e2) / (1. - e2 * pow(sin(fi0), 2));
-	s0 = 1.37008346281555;       /* Latitude of pseudo standard parallel 78 30'00" N */
-	n = sin(s0);
-	ro0 = k1 * n0 / tan(s0);
-	ad = s90 - uq;
-
-
-/* Transformation */
    /* revert y, x*/
 	xy0=xy.x;
 	xy.x=xy.y;
 	xy.y=xy0;
 
-        if( !pj_param(P->ctx, P->params, "tczech").i )
+        if( !P->czech )
 	  {
 	    xy.x *= -1.0;
 	    xy.y *= -1.0;
@@ -184,40 +129,41 @@ INVERSE(e_inverse); /* ellipsoid */
 
 	ro = sqrt(xy.x * xy.x + xy.y * xy.y);
 	eps = atan2(xy.y, xy.x);
-	d = eps / sin(s0);
-	s = 2. * (atan(  pow(ro0 / ro, 1. / n) * tan(s0 / 2. + s45)) - s45);
+	d = eps / P->n;
+	s = 2. * (atan(  pow(P->ro0 / ro, 1. / P->n) * P->ts0) - S45);
 
-	u = asin(cos(ad) * sin(s) - sin(ad) * cos(s) * cos(d));
+	u = asin(P->cosad * sin(s) - P->sinad * cos(s) * cos(d));
 	deltav = asin(cos(s) * sin(d) / cos(u));
 
-	lp.lam = P->lam0 - deltav / alfa;
-
-/* ITERATION FOR lp.phi */
-   fi1 = u;
-
-   ok = 0;
-   do
-   {
-   	lp.phi = 2. * ( atan( pow( k, -1. / alfa)  *
-                            pow( tan(u / 2. + s45) , 1. / alfa)  *
-                            pow( (1. + e * sin(fi1)) / (1. - e * sin(fi1)) , e / 2.)
-                           )  - s45);
-
-      if (fabs(fi1 - lp.phi) < 0.000000000000001) ok=1;
-      fi1 = lp.phi;
-
-   }
-   while (ok==0);
-
-   lp.lam -= P->lam0;
-
-   return (lp);
+	lp.lam = - deltav / P->alfa;
+
+/* ITERATION FOR lp.phi, by Newton's method on the fixed point
+   fi = 2 (atan(K ((1 + e sin fi) / (1 - e sin fi))^(e/2)) - 45 deg),
+   which the plain iteration approaches only by a factor e2 a step */
+	K = P->ik * pow( tan(u / 2. + S45) , 1. / P->alfa);
+	fi1 = u;
+	for (i = N_ITER; i; --i) {
+		sinfi = sin(fi1);
+		f = 2. * ( atan( K * pow( (1. + e * sinfi) / (1. - e * sinfi) ,
+			e / 2.) ) - S45);
+		dfi = (f - fi1) / (1. - cos(f) * E2 * cos(fi1) /
+			(1. - E2 * sinfi * sinfi));
+		fi1 += dfi;
+		if (fabs(dfi) < EPS)
+			break;
+	}
+	if (!i) I_ERROR;
+	lp.phi = fi1;
+
+	return (lp);
 }
+FORWARD_ARRAY(e_forward_n, e_forward)
+INVERSE_ARRAY(e_inverse_n, e_inverse)
 
 FREEUP; if (P) pj_dalloc(P); }
 
 ENTRY0(krovak)
-	double ts;
+	double ts, e, g, u0, n0;
 	/* read some Parameters,
 	 * here Latitude Truescale */
 
@@ -242,9 +188,29 @@ ENTRY0(krovak)
 	if (!pj_param(P->ctx, P->params, "tk").i)
             P->k0 = 0.9999;
 
+	P->czech = pj_param(P->ctx, P->params, "tczech").i;
+
+	/* constants of the projection centre */
+	e = sqrt(E2);
+	P->alfa = sqrt(1. + (E2 * pow(cos(P->phi0), 4)) / (1. - E2));
+	u0 = asin(sin(P->phi0) / P->alfa);
+	g = pow(   (1. + e * sin(P->phi0)) / (1. - e * sin(P->phi0)) ,
+		P->alfa * e / 2.  );
+	P->k = tan( u0 / 2. + S45) / pow  (tan(P->phi0 / 2. + S45) , P->alfa) * g;
+	P->ik = pow( P->k, -1. / P->alfa);
+	n0 = sqrt(1. - E2) / (1. - E2 * pow(sin(P->phi0), 2));
+	P->n = sin(S0);
+	P->ro0 = P->k0 * n0 / tan(S0);
+	P->ts0 = tan(S0 / 2. + S45);
+	P->ts0n = pow(P->ts0, P->n);
+	P->cosad = cos(S90 - UQ);
+	P->sinad = sin(S90 - UQ);
+
 	/* always the same */
         P->inv = e_inverse; 
 	P->fwd = e_forward;
+	P->inv_n = e_inverse_n;
+	P->fwd_n = e_forward_n;
 
 ENDENTRY(P)
 
@@ -11,6 +11,7 @@
 	int		mode;
 #define PJ_LIB__
 #include	<projects.h>
+#include	<pj_math.h>
 PROJ_HEAD(laea, "Lambert Azimuthal Equal Area") "\n\tAzi, Sph&Ell";
 #define sinph0	P->sinb1
 #define cosph0	P->cosb1
@@ -21,18 +22,18 @@ PROJ_HEAD(laea, "Lambert Azimuthal Equal Area") "\n\tAzi, Sph&Ell";
 #define S_POLE	1
 #define EQUIT	2
 #define OBLIQ	3
-FORWARD(e_forward); /* ellipsoid */
-	double coslam, sinlam, sinphi, q, sinb=0.0, cosb=0.0, b=0.0;
+	static PJ_INLINE XY /* e_forward() once q of lp.phi is known */
+e_forward_q(LP lp, double q, PJ *P, int mode) {
+	XY xy = {0.0,0.0};
+	double coslam, sinlam, sinb=0.0, cosb=0.0, b=0.0;
 
 	coslam = cos(lp.lam);
 	sinlam = sin(lp.lam);
-	sinphi = sin(lp.phi);
-	q = pj_qsfn(sinphi, P->e, P->one_es);
-	if (P->mode == OBLIQ || P->mode == EQUIT) {
+	if (mode == OBLIQ || mode == EQUIT) {
 		sinb = q / P->qp;
 		cosb = sqrt(1. - sinb * sinb);
 	}
-	switch (P->mode) {
+	switch (mode) {
 	case OBLIQ:
 		b = 1. + P->sinb1 * sinb + P->cosb1 * cosb * coslam;
 		break;
@@ -49,7 +50,7 @@ FORWARD(e_forward); /* ellipsoid */
 		break;
 	}
 	if (fabs(b) < EPS10) F_ERROR;
-	switch (P->mode) {
+	switch (mode) {
 	case OBLIQ:
 		xy.y = P->ymf * ( b = sqrt(2. / b) )
 		   * (P->cosb1 * sinb - P->sinb1 * cosb * coslam);
@@ -64,20 +65,54 @@ eqcon:
 	case S_POLE:
 		if (q >= 0.) {
 			xy.x = (b = sqrt(q)) * sinlam;
-			xy.y = coslam * (P->mode == S_POLE ? b : -b);
+			xy.y = coslam * (mode == S_POLE ? b : -b);
 		} else
 			xy.x = xy.y = 0.;
 		break;
 	}
 	return (xy);
 }
-FORWARD(s_forward); /* spheroid */
+FORWARD_MODAL(e_forward); /* ellipsoid */
+	(void) xy;
+	return e_forward_q(lp, pj_qsfn_i(sin(lp.phi), P->e, P->one_es), P, mode);
+}
+	static PJ_INLINE int /* e_forward() of a run of points, their q at once */
+e_forward_run(PJ *P, long n, int stride, double *x, double *y, int mode) {
+	double q[PJ_ARRAY_RUN];
+	long i0, io, j, m;
+	int err = 0;
+
+	for (i0 = 0; i0 < n; i0 += PJ_ARRAY_RUN) {
+		m = n - i0 < PJ_ARRAY_RUN ? n - i0 : PJ_ARRAY_RUN;
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride)
+			q[j] = x[io] == HUGE_VAL ? HUGE_VAL : y[io];
+		pj_qsfn_n(m, 1, q, P->e, P->one_es);
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			LP lp; XY xy;
+
+			if (x[io] == HUGE_VAL)
+				continue;
+			lp.lam = x[io];
+			lp.phi = y[io];
+			xy = e_forward_q(lp, q[j], P, mode);
+			if (P->ctx->last_errno) {
+				err = P->ctx->last_errno;
+				P->ctx->last_errno = 0;
+				xy.x = xy.y = HUGE_VAL;
+			}
+			x[io] = xy.x;
+			y[io] = xy.y;
+		}
+	}
+	return err;
+}
+FORWARD_MODAL(s_forward); /* spheroid */
 	double  coslam, cosphi, sinphi;
 
 	sinphi = sin(lp.phi);
 	cosphi = cos(lp.phi);
 	coslam = cos(lp.lam);
-	switch (P->mode) {
+	switch (mode) {
 	case EQUIT:
 		xy.y = 1. + cosphi * coslam;
 		goto oblcon;
@@ -86,7 +121,7 @@ FORWARD(s_forward); /* spheroid */
 oblcon:
 		if (xy.y <= EPS10) F_ERROR;
 		xy.x = (xy.y = sqrt(2. / xy.y)) * cosphi * sin(lp.lam);
-		xy.y *= P->mode == EQUIT ? sinphi :
+		xy.y *= mode == EQUIT ? sinphi :
 		   cosph0 * sinphi - sinph0 * cosphi * coslam;
 		break;
 	case N_POLE:
@@ -94,27 +129,56 @@ oblcon:
 	case S_POLE:
 		if (fabs(lp.phi + P->phi0) < EPS10) F_ERROR;
 		xy.y = FORTPI - lp.phi * .5;
-		xy.y = 2. * (P->mode == S_POLE ? cos(xy.y) : sin(xy.y));
+		xy.y = 2. * (mode == S_POLE ? cos(xy.y) : sin(xy.y));
 		xy.x = xy.y * sin(lp.lam);
 		xy.y *= coslam;
 		break;
 	}
 	return (xy);
 }
-INVERSE(e_inverse); /* ellipsoid */
+SPECIAL(s_fac) { /* spheroid, oblique and equatorial */
+	double sinphi, cosphi, sinlam, coslam, s0, c0, d, f, df, dl, dp, n;
+
+	if (P->mode == EQUIT) {
+		s0 = 0.;
+		c0 = 1.;
+	} else {
+		s0 = sinph0;
+		c0 = cosph0;
+	}
+	sinphi = sin(lp.phi);
+	cosphi = cos(lp.phi);
+	sinlam = sin(lp.lam);
+	coslam = cos(lp.lam);
+	if ((d = 1. + s0 * sinphi + c0 * cosphi * coslam) <= EPS10)
+		return;
+	f = sqrt(2. / d); /* x = f cosphi sinlam, y = f n */
+	df = - .5 * f / d;
+	dl = - c0 * cosphi * sinlam;
+	dp = s0 * cosphi - c0 * sinphi * coslam;
+	n = c0 * sinphi - s0 * cosphi * coslam;
+	fac->code |= IS_ANAL_XL_YL + IS_ANAL_XP_YP;
+	fac->der.x_l = f * cosphi * coslam + cosphi * sinlam * df * dl;
+	fac->der.x_p = f * sinphi * sinlam - cosphi * sinlam * df * dp;
+	fac->der.y_l = - f * s0 * cosphi * sinlam - n * df * dl;
+	fac->der.y_p = f * (c0 * cosphi + s0 * sinphi * coslam) + n * df * dp;
+}
+	static PJ_INLINE double /* sine of the authalic latitude of xy, with
+	                           lp->lam set, or HUGE_VAL and lp at the origin */
+e_inverse_ab(XY xy, PJ *P, int mode, LP *lp) {
 	double cCe, sCe, q, rho, ab=0.0;
 
-	switch (P->mode) {
+	switch (mode) {
 	case EQUIT:
 	case OBLIQ:
 		if ((rho = hypot(xy.x /= P->dd, xy.y *=  P->dd)) < EPS10) {
-			lp.lam = 0.;
-			lp.phi = P->phi0;
-			return (lp);
+			lp->lam = 0.;
+			lp->phi = P->phi0;
+			return HUGE_VAL;
 		}
 		cCe = cos(sCe = 2. * asin(.5 * rho / P->rq));
 		xy.x *= (sCe = sin(sCe));
-		if (P->mode == OBLIQ) {
+		if (mode == OBLIQ) {
 			q = P->qp * (ab = cCe * P->sinb1 + xy.y * sCe * P->cosb1 / rho);
 			xy.y = rho * P->cosb1 * cCe - xy.y * P->sinb1 * sCe;
 		} else {
@@ -126,33 +190,68 @@ INVERSE(e_inverse); /* ellipsoid */
 		xy.y = -xy.y;
 	case S_POLE:
 		if (!(q = (xy.x * xy.x + xy.y * xy.y)) ) {
-			lp.lam = 0.;
-			lp.phi = P->phi0;
-			return (lp);
+			lp->lam = 0.;
+			lp->phi = P->phi0;
+			return HUGE_VAL;
 		}
 		/*
 		q = P->qp - q;
 		*/
 		ab = 1. - q / P->qp;
-		if (P->mode == S_POLE)
+		if (mode == S_POLE)
 			ab = - ab;
 		break;
 	}
-	lp.lam = atan2(xy.x, xy.y);
-	lp.phi = pj_authlat(asin(ab), P->apa);
+	lp->lam = atan2(xy.x, xy.y);
+	return ab;
+}
+INVERSE_MODAL(e_inverse); /* ellipsoid */
+	double ab = e_inverse_ab(xy, P, mode, &lp);
+
+	if (ab != HUGE_VAL)
+		lp.phi = pj_authlat_i(asin(ab), P->apa);
 	return (lp);
 }
-INVERSE(s_inverse); /* spheroid */
+	static PJ_INLINE int /* e_inverse() of a run of points, their latitude
+	                        from the authalic one at once */
+e_inverse_run(PJ *P, long n, int stride, double *x, double *y, int mode) {
+	double beta[PJ_ARRAY_RUN];
+	long i0, io, j, m;
+
+	for (i0 = 0; i0 < n; i0 += PJ_ARRAY_RUN) {
+		m = n - i0 < PJ_ARRAY_RUN ? n - i0 : PJ_ARRAY_RUN;
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			LP lp = {0.0,0.0}; XY xy;
+
+			beta[j] = HUGE_VAL;
+			if (x[io] == HUGE_VAL)
+				continue;
+			xy.x = x[io];
+			xy.y = y[io];
+			if ((beta[j] = e_inverse_ab(xy, P, mode, &lp)) != HUGE_VAL)
+				beta[j] = asin(beta[j]);
+			else
+				y[io] = lp.phi;
+			x[io] = lp.lam;
+		}
+		pj_authlat_n(m, 1, beta, P->apa);
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride)
+			if (beta[j] != HUGE_VAL)
+				y[io] = beta[j];
+	}
+	return 0;
+}
+INVERSE_MODAL(s_inverse); /* spheroid */
 	double  cosz=0.0, rh, sinz=0.0;
 
 	rh = hypot(xy.x, xy.y);
 	if ((lp.phi = rh * .5 ) > 1.) I_ERROR;
 	lp.phi = 2. * asin(lp.phi);
-	if (P->mode == OBLIQ || P->mode == EQUIT) {
+	if (mode == OBLIQ || mode == EQUIT) {
 		sinz = sin(lp.phi);
 		cosz = cos(lp.phi);
 	}
-	switch (P->mode) {
+	switch (mode) {
 	case EQUIT:
 		lp.phi = fabs(rh) <= EPS10 ? 0. : asin(xy.y * sinz / rh);
 		xy.x *= sinz;
@@ -172,14 +271,47 @@ INVERSE(s_inverse); /* spheroid */
 		lp.phi -= HALFPI;
 		break;
 	}
-	lp.lam = (xy.y == 0. && (P->mode == EQUIT || P->mode == OBLIQ)) ?
+	lp.lam = (xy.y == 0. && (mode == EQUIT || mode == OBLIQ)) ?
 		0. : atan2(xy.x, xy.y);
 	return (lp);
 }
+	/* as FORWARD_MODE and INVERSE_MODE, the array functions going
+	   through e_forward_run() and e_inverse_run() */
+#define E_MODE_KERNELS(fwd, inv, mode) \
+static XY fwd(LP lp, PJ *P) { return e_forward(lp, P, mode); } \
+static LP inv(XY xy, PJ *P) { return e_inverse(xy, P, mode); } \
+static int fwd##_n(PJ *P, long n, int stride, double *x, double *y) { \
+	return e_forward_run(P, n, stride, x, y, mode); } \
+static int inv##_n(PJ *P, long n, int stride, double *x, double *y) { \
+	return e_inverse_run(P, n, stride, x, y, mode); }
+E_MODE_KERNELS(e_forward_npole, e_inverse_npole, N_POLE)
+E_MODE_KERNELS(e_forward_spole, e_inverse_spole, S_POLE)
+E_MODE_KERNELS(e_forward_equit, e_inverse_equit, EQUIT)
+E_MODE_KERNELS(e_forward_obliq, e_inverse_obliq, OBLIQ)
+FORWARD_MODE(s_forward_npole, s_forward, N_POLE)
+FORWARD_MODE(s_forward_spole, s_forward, S_POLE)
+FORWARD_MODE(s_forward_equit, s_forward, EQUIT)
+FORWARD_MODE(s_forward_obliq, s_forward, OBLIQ)
+INVERSE_MODE(s_inverse_npole, s_inverse, N_POLE)
+INVERSE_MODE(s_inverse_spole, s_inverse, S_POLE)
+INVERSE_MODE(s_inverse_equit, s_inverse, EQUIT)
+INVERSE_MODE(s_inverse_obliq, s_inverse, OBLIQ)
+static const struct PJ_KERNELS e_kernels[] = { /* by mode */
+	MODE_KERNELS(e_forward_npole, e_inverse_npole),
+	MODE_KERNELS(e_forward_spole, e_inverse_spole),
+	MODE_KERNELS(e_forward_equit, e_inverse_equit),
+	MODE_KERNELS(e_forward_obliq, e_inverse_obliq)
+};
+static const struct PJ_KERNELS s_kernels[] = {
+	MODE_KERNELS(s_forward_npole, s_inverse_npole),
+	MODE_KERNELS(s_forward_spole, s_inverse_spole),
+	MODE_KERNELS(s_forward_equit, s_inverse_equit),
+	MODE_KERNELS(s_forward_obliq, s_inverse_obliq)
+};
 FREEUP;
     if (P) {
 		if (P->apa)
-			pj_dalloc(P->apa);
+			pj_table_release(P->apa);
 		pj_dalloc(P);
 	}
 }
@@ -196,7 +328,7 @@ ENTRY1(laea,apa)
 		double sinphi;
 
 		P->e = sqrt(P->es);
-		P->qp = pj_qsfn(1., P->e, P->one_es);
+		P->qp = pj_qsfn_i(1., P->e, P->one_es);
 		P->mmf = .5 / (1. - P->es);
 		P->apa = pj_authset(P->es);
 		switch (P->mode) {
@@ -212,7 +344,7 @@ ENTRY1(laea,apa)
 		case OBLIQ:
 			P->rq = sqrt(.5 * P->qp);
 			sinphi = sin(P->phi0);
-			P->sinb1 = pj_qsfn(sinphi, P->e, P->one_es) / P->qp;
+			P->sinb1 = pj_qsfn_i(sinphi, P->e, P->one_es) / P->qp;
 			P->cosb1 = sqrt(1. - P->sinb1 * P->sinb1);
 			P->dd = cos(P->phi0) / (sqrt(1. - P->es * sinphi * sinphi) *
 			   P->rq * P->cosb1);
@@ -220,14 +352,14 @@ ENTRY1(laea,apa)
 			P->xmf *= P->dd;
 			break;
 		}
-		P->inv = e_inverse;
-		P->fwd = e_forward;
+		SET_KERNELS(P, e_kernels[P->mode]);
 	} else {
 		if (P->mode == OBLIQ) {
 			sinph0 = sin(P->phi0);
 			cosph0 = cos(P->phi0);
 		}
-		P->inv = s_inverse;
-		P->fwd = s_forward;
+		SET_KERNELS(P, s_kernels[P->mode]);
+		if (P->mode == OBLIQ || P->mode == EQUIT)
+			P->spc = s_fac;
 	}
 ENDENTRY(P)
@@ -4,9 +4,11 @@
 	double	n; \
 	double	rho0; \
 	double	c; \
-	int		ellips;
+	int		ellips; \
+	struct PJ_PHI2 cnf;
 #define PJ_LIB__
 #include	<projects.h>
+#include	<pj_math.h>
 PROJ_HEAD(lcc, "Lambert Conformal Conic")
 	"\n\tConic, Sph&Ell\n\tlat_1= and lat_2= or lat_0";
 # define EPS10	1.e-10
@@ -17,7 +19,7 @@ FORWARD(e_forward); /* ellipsoid & spheroid */
 		rho = 0.;
 		}
 	else
-		rho = P->c * (P->ellips ? pow(pj_tsfn(lp.phi, sin(lp.phi),
+		rho = P->c * (P->ellips ? pow(pj_tsfn_i(lp.phi, sin(lp.phi),
 			P->e), P->n) : pow(tan(FORTPI + .5 * lp.phi), -P->n));
 	xy.x = P->k0 * (rho * sin( lp.lam *= P->n ) );
 	xy.y = P->k0 * (P->rho0 - rho * cos(lp.lam) );
@@ -34,7 +36,7 @@ INVERSE(e_inverse); /* ellipsoid & spheroid */
 			xy.y = -xy.y;
 		}
 		if (P->ellips) {
-			if ((lp.phi = pj_phi2(P->ctx, pow(rho / P->c, 1./P->n), P->e))
+			if ((lp.phi = pj_phi2_ts(P->ctx, &P->cnf, pow(rho / P->c, 1./P->n)))
 				== HUGE_VAL)
 				I_ERROR;
 		} else
@@ -47,18 +49,32 @@ INVERSE(e_inverse); /* ellipsoid & spheroid */
 	return (lp);
 }
 SPECIAL(fac) {
-        double rho;
+        double rho, drho, sinphi;
 	if (fabs(fabs(lp.phi) - HALFPI) < EPS10) {
 		if ((lp.phi * P->n) <= 0.) return;
 		rho = 0.;
 	} else
-		rho = P->c * (P->ellips ? pow(pj_tsfn(lp.phi, sin(lp.phi),
+		rho = P->c * (P->ellips ? pow(pj_tsfn_i(lp.phi, sin(lp.phi),
 			P->e), P->n) : pow(tan(FORTPI + .5 * lp.phi), -P->n));
 	fac->code |= IS_ANAL_HK + IS_ANAL_CONV;
 	fac->k = fac->h = P->k0 * P->n * rho /
-		pj_msfn(sin(lp.phi), cos(lp.phi), P->es);
+		pj_msfn_i(sin(lp.phi), cos(lp.phi), P->es);
 	fac->conv = - P->n * lp.lam;
+	if (rho == 0.)
+		return;
+	/* derivatives of x and y, from d rho / d phi */
+	sinphi = sin(lp.phi);
+	drho = - P->n * rho * P->one_es /
+		((1. - P->es * sinphi * sinphi) * cos(lp.phi));
+	lp.lam *= P->n;
+	fac->code |= IS_ANAL_XL_YL + IS_ANAL_XP_YP;
+	fac->der.x_l = P->k0 * rho * P->n * cos(lp.lam);
+	fac->der.y_l = - P->k0 * rho * P->n * sin(lp.lam);
+	fac->der.x_p = - P->k0 * drho * sin(lp.lam);
+	fac->der.y_p = - P->k0 * drho * cos(lp.lam);
 }
+FORWARD_ARRAY(e_forward_n, e_forward)
+INVERSE_ARRAY(e_inverse_n, e_inverse)
 FREEUP; if (P) pj_dalloc(P); }
 ENTRY0(lcc)
 	double cosphi, sinphi;
@@ -80,16 +96,17 @@ ENTRY0(lcc)
 		double ml1, m1;
 
 		P->e = sqrt(P->es);
-		m1 = pj_msfn(sinphi, cosphi, P->es);
-		ml1 = pj_tsfn(P->phi1, sinphi, P->e);
+		pj_phi2_init(&P->cnf, P->e);
+		m1 = pj_msfn_i(sinphi, cosphi, P->es);
+		ml1 = pj_tsfn_i(P->phi1, sinphi, P->e);
 		if (secant) { /* secant cone */
 			P->n = log(m1 /
-			   pj_msfn(sinphi = sin(P->phi2), cos(P->phi2), P->es));
-			P->n /= log(ml1 / pj_tsfn(P->phi2, sinphi, P->e));
+			   pj_msfn_i(sinphi = sin(P->phi2), cos(P->phi2), P->es));
+			P->n /= log(ml1 / pj_tsfn_i(P->phi2, sinphi, P->e));
 		}
 		P->c = (P->rho0 = m1 * pow(ml1, -P->n) / P->n);
 		P->rho0 *= (fabs(fabs(P->phi0) - HALFPI) < EPS10) ? 0. :
-			pow(pj_tsfn(P->phi0, sin(P->phi0), P->e), P->n);
+			pow(pj_tsfn_i(P->phi0, sin(P->phi0), P->e), P->n);
 	} else {
 		if (secant)
 			P->n = log(cosphi / cos(P->phi2)) /
@@ -101,5 +118,7 @@ ENTRY0(lcc)
 	}
 	P->inv = e_inverse;
 	P->fwd = e_forward;
+	P->inv_n = e_inverse_n;
+	P->fwd_n = e_forward_n;
 	P->spc = fac;
 ENDENTRY(P)
@@ -49,11 +49,12 @@ INVERSE(e_inverse); /* ellipsoid & spheroid */
 	lp.phi = pj_inv_mlfn(P->ctx, S + P->M0, P->es, P->en);
 	return (lp);
 }
-FREEUP; if (P) { if (P->en) pj_dalloc(P->en); pj_dalloc(P); } }
+FREEUP; if (P) { if (P->en) pj_table_release(P->en); pj_dalloc(P); } }
 ENTRY0(lcca)
 	double s2p0, N0, R0, tan0, tan20;
 
 	if (!(P->en = pj_enfn(P->es))) E_ERROR_0;
+	P->en = pj_inv_mlfn_accuracy(P->en, P->es, P->a, P->cold->accuracy);
 	if (!pj_param(P->ctx, P->params, "tlat_0").i) E_ERROR(50);
 	if (P->phi0 == 0.) E_ERROR(51);
 	P->l = sin(P->phi0);
@@ -1,11 +1,12 @@
 /* based upon Snyder and Linck, USGS-NMD */
 #define PROJ_PARMS__ \
     double a2, a4, b, c1, c3; \
-    double q, t, u, w, p22, sa, ca, xj, rlm, rlm2;
+    double q, t, u, w, p22, sa, ca, xj, rlm, rlm2; \
+    double *track;
 #define PJ_LIB__
 #include	<projects.h>
 PROJ_HEAD(lsat, "Space oblique for LANDSAT")
-	"\n\tCyl, Sph&Ell\n\tlsat= path=";
+	"\n\tCyl, Sph&Ell\n\tlsat= path= [track_table]";
 #define TOL 1e-7
 #define PI_HALFPI 4.71238898038468985766
 #define TWOPI_HALFPI 7.85398163397448309610
@@ -29,15 +30,14 @@ seraz0(double lam, double mult, PJ *P) {
     P->c1 += fc * cos(lam);
     P->c3 += fc * cos(lam * 3.);
 }
-FORWARD(e_forward); /* ellipsoid */
+/* the search of the forward for the transformed longitude lamdp of lp,
+   over the branches of its equation, and the lamt it ends with.
+   Returns 0 if the iteration on a branch does not converge. */
+	static int
+lsat_search(LP lp, PJ *P, double *lamdp_out, double *lamt_out) {
     int l, nn;
-    double lamt, xlam, sdsq, c, d, s, lamdp, phidp, lampp, tanph,
-		lamtp, cl, sd, sp, fac, sav, tanphi;
+    double lamt, xlam, c, lamdp, lampp, lamtp, cl, fac, sav, tanphi;
 
-	if (lp.phi > HALFPI)
-	    lp.phi = HALFPI;
-	else if (lp.phi < -HALFPI)
-	    lp.phi = -HALFPI;
 	lampp = lp.phi >= 0. ? HALFPI : PI_HALFPI;
 	tanphi = tan(lp.phi);
 	for (nn = 0;;) {
@@ -54,7 +54,7 @@ FORWARD(e_forward); /* ellipsoid */
 			xlam = (P->one_es * tanphi * P->sa + sin(lamt) * P->ca) / c;
 			lamdp = atan(xlam) + fac;
 			if (fabs(fabs(sav) - fabs(lamdp)) < TOL)
-			    break;
+				break;
 			sav = lamdp;
 		}
 		if (!l || ++nn >= 3 || (lamdp > P->rlm && lamdp < P->rlm2))
@@ -64,23 +64,219 @@ FORWARD(e_forward); /* ellipsoid */
 		else if (lamdp >= P->rlm2)
 		    lampp = HALFPI;
 	}
-	if (l) {
-		sp = sin(lp.phi);
-		phidp = aasin(P->ctx,(P->one_es * P->ca * sp - P->sa * cos(lp.phi) * 
-			sin(lamt)) / sqrt(1. - P->es * sp * sp));
-		tanph = log(tan(FORTPI + .5 * phidp));
-		sd = sin(lamdp);
-		sdsq = sd * sd;
-		s = P->p22 * P->sa * cos(lamdp) * sqrt((1. + P->t * sdsq)
-			 / ((1. + P->w * sdsq) * (1. + P->q * sdsq)));
-		d = sqrt(P->xj * P->xj + s * s);
-		xy.x = P->b * lamdp + P->a2 * sin(2. * lamdp) + P->a4 *
-			sin(lamdp * 4.) - tanph * s / d;
-		xy.y = P->c1 * sd + P->c3 * sin(lamdp * 3.) + tanph * P->xj / d;
-	} else
+	*lamdp_out = lamdp;
+	*lamt_out = lamt;
+	return l;
+}
+/* the forward from lamdp and lamt */
+	static XY
+lsat_xy(LP lp, double lamdp, double lamt, PJ *P) {
+    XY xy;
+    double sdsq, d, s, phidp, tanph, sd, sp;
+
+	sp = sin(lp.phi);
+	phidp = aasin(P->ctx,(P->one_es * P->ca * sp - P->sa * cos(lp.phi) * 
+		sin(lamt)) / sqrt(1. - P->es * sp * sp));
+	tanph = log(tan(FORTPI + .5 * phidp));
+	sd = sin(lamdp);
+	sdsq = sd * sd;
+	s = P->p22 * P->sa * cos(lamdp) * sqrt((1. + P->t * sdsq)
+		 / ((1. + P->w * sdsq) * (1. + P->q * sdsq)));
+	d = sqrt(P->xj * P->xj + s * s);
+	xy.x = P->b * lamdp + P->a2 * sin(2. * lamdp) + P->a4 *
+		sin(lamdp * 4.) - tanph * s / d;
+	xy.y = P->c1 * sd + P->c3 * sin(lamdp * 3.) + tanph * P->xj / d;
+	return xy;
+}
+/*
+  With +track_table, the lamdp found by lsat_search() is kept at init
+  for a lattice of longitudes and latitudes, every TRACK_STEP.  The
+  forward starts from the bilinear interpolation of the lattice at the
+  point, and refines it by Newton's method on
+
+    F(lamdp) = sin(lamdp) cos(lamt) - cos(lamdp) (A + ca sin(lamt)),
+
+  lamt = lam + p22 lamdp and A = (1 - es) tan(phi) sa, whose roots are
+  those of the fixed point iteration of lsat_search() on each of its
+  branches.  The start depends on the point only, so a point projects
+  the same alone or in any array.  The root is found to 1e-12, where
+  the search stops on steps under 1e-7 short of it, so the two differ
+  by up to half a metre, the table being nearer.  Cells across the
+  jump of lamdp from rlm2 to rlm or with a node where the search
+  fails, points beyond TRACK_PHI, and roots off the start or outside
+  rlm to rlm2 take the search.
+*/
+#define TRACK_STEP	(2. * DEG_TO_RAD)
+#define TRACK_NLAM	181		/* -180 to 180 */
+#define TRACK_NPHI	89		/* -88 to 88 */
+#define TRACK_PHI	(88. * DEG_TO_RAD)
+#define TRACK_JUMP	.5		/* of lamdp over a cell, or from its start */
+#define TRACK_ITER	8
+#define TRACK_TOL	1e-12
+#define TRACK_RUN	64
+	static double
+track_start(LP lp, PJ *P) {
+	double u, v, *f, lo, hi;
+	int i, j, k;
+
+	if (fabs(lp.phi) > TRACK_PHI || fabs(lp.lam) > PI)
+		return HUGE_VAL;
+	u = (lp.lam + PI) / TRACK_STEP;
+	v = (lp.phi + TRACK_PHI) / TRACK_STEP;
+	if ((i = (int) u) > TRACK_NLAM - 2)
+		i = TRACK_NLAM - 2;
+	if ((j = (int) v) > TRACK_NPHI - 2)
+		j = TRACK_NPHI - 2;
+	u -= i;
+	v -= j;
+	f = P->track + j * TRACK_NLAM + i;
+	lo = hi = f[0];
+	for (k = 1; k < 4; ++k) {
+		double g = f[(k >> 1) * TRACK_NLAM + (k & 1)];
+
+		if (g == HUGE_VAL)
+			return HUGE_VAL;
+		if (g < lo) lo = g;
+		if (g > hi) hi = g;
+	}
+	if (lo == HUGE_VAL || hi - lo > TRACK_JUMP)
+		return HUGE_VAL;
+	return (1. - v) * ((1. - u) * f[0] + u * f[1]) +
+		v * ((1. - u) * f[TRACK_NLAM] + u * f[TRACK_NLAM + 1]);
+}
+/* the Newton step of F at lamdp, for a of the point */
+	static PJ_INLINE double
+track_step(double lamdp, double lam, double a, PJ *P) {
+	double lamt = lam + P->p22 * lamdp;
+	double sl = sin(lamdp), cl = cos(lamdp), st = sin(lamt), ct = cos(lamt);
+	double g = a + P->ca * st;
+
+	return (sl * ct - cl * g) /
+		(cl * ct + sl * g - P->p22 * (sl * st + P->ca * cl * ct));
+}
+/* is the root lamdp from start the lamdp of the search?  If so, lamt
+   is set as the search would */
+	static int
+track_root(double lamdp, double start, double lam, PJ *P, double *lamt) {
+	if (fabs(lamdp - start) >= TRACK_JUMP ||
+			!(lamdp > P->rlm && lamdp < P->rlm2))
+		return 0;
+	*lamt = lam + P->p22 * lamdp;
+	if (fabs(cos(*lamt)) < TOL)
+		*lamt -= TOL;
+	return 1;
+}
+	static void
+track_init(PJ *P) {
+	LP lp;
+	double lamt;
+	int i, j;
+
+	P->track = (double *) pj_malloc(TRACK_NLAM * TRACK_NPHI * sizeof(double));
+	if (P->track == NULL)
+		return;
+	for (j = 0; j < TRACK_NPHI; ++j)
+		for (i = 0; i < TRACK_NLAM; ++i) {
+			double *f = P->track + j * TRACK_NLAM + i;
+
+			lp.lam = i * TRACK_STEP - PI;
+			lp.phi = j * TRACK_STEP - TRACK_PHI;
+			if (!lsat_search(lp, P, f, &lamt) ||
+					!(*f > P->rlm && *f < P->rlm2))
+				*f = HUGE_VAL;
+		}
+}
+FORWARD(e_forward); /* ellipsoid */
+	double lamdp, lamt, start = HUGE_VAL;
+	int i;
+
+	if (lp.phi > HALFPI)
+	    lp.phi = HALFPI;
+	else if (lp.phi < -HALFPI)
+	    lp.phi = -HALFPI;
+	if (P->track != NULL && (start = track_start(lp, P)) != HUGE_VAL) {
+		double a = P->one_es * tan(lp.phi) * P->sa, V;
+
+		lamdp = start;
+		for (i = TRACK_ITER; i; --i) {
+			lamdp -= V = track_step(lamdp, lp.lam, a, P);
+			if (fabs(V) < TRACK_TOL)
+				break;
+		}
+		if (!i || !track_root(lamdp, start, lp.lam, P, &lamt))
+			start = HUGE_VAL;
+	}
+	if (start == HUGE_VAL && !lsat_search(lp, P, &lamdp, &lamt))
 		xy.x = xy.y = HUGE_VAL;
+	else
+		xy = lsat_xy(lp, lamdp, lamt, P);
 	return xy;
 }
+/* the forward of a run of points at once, the Newton steps of all the
+   points from the table going together, each point taking the steps
+   e_forward() takes for it */
+	static int
+e_forward_n(PJ *P, long n, int stride, double *x, double *y) {
+	double lamdp[TRACK_RUN], start[TRACK_RUN], a[TRACK_RUN];
+	char conv[TRACK_RUN];
+	long i0, io, j, m;
+	int i, left, err = 0;
+
+	for (i0 = 0; i0 < n; i0 += TRACK_RUN) {
+		m = n - i0 < TRACK_RUN ? n - i0 : TRACK_RUN;
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			LP lp;
+
+			conv[j] = 1;
+			if (x[io] == HUGE_VAL || P->track == NULL)
+				continue;
+			lp.lam = x[io];
+			lp.phi = y[io] > HALFPI ? HALFPI : y[io] < -HALFPI ? -HALFPI : y[io];
+			if ((start[j] = track_start(lp, P)) == HUGE_VAL)
+				continue;
+			lamdp[j] = start[j];
+			a[j] = P->one_es * tan(lp.phi) * P->sa;
+			conv[j] = 0;
+		}
+		for (i = TRACK_ITER, left = 1; i && left; --i)
+			for (j = left = 0, io = i0 * stride; j < m; ++j, io += stride) {
+				double V;
+
+				if (conv[j])
+					continue;
+				lamdp[j] -= V = track_step(lamdp[j], x[io], a[j], P);
+				if (fabs(V) < TRACK_TOL)
+					conv[j] = 2;
+				else
+					left = 1;
+			}
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			LP lp;
+			XY xy;
+			double lamt;
+
+			if (x[io] == HUGE_VAL)
+				continue;
+			lp.lam = x[io];
+			lp.phi = y[io];
+			if (conv[j] == 2 &&
+					track_root(lamdp[j], start[j], lp.lam, P, &lamt)) {
+				lp.phi = lp.phi > HALFPI ? HALFPI :
+					lp.phi < -HALFPI ? -HALFPI : lp.phi;
+				xy = lsat_xy(lp, lamdp[j], lamt, P);
+			} else
+				xy = e_forward(lp, P);
+			if (P->ctx->last_errno) {
+				err = P->ctx->last_errno;
+				P->ctx->last_errno = 0;
+				xy.x = xy.y = HUGE_VAL;
+			}
+			x[io] = xy.x;
+			y[io] = xy.y;
+		}
+	}
+	return err;
+}
 INVERSE(e_inverse); /* ellipsoid */
     int nn;
     double lamt, sdsq, s, lamdp, phidp, sppsq, dd, sd, sl, fac, scl, sav, spp;
@@ -122,8 +318,9 @@ INVERSE(e_inverse); /* ellipsoid */
 			(P->one_es * P->sa));
 	return lp;
 }
-FREEUP; if (P) pj_dalloc(P); }
-ENTRY0(lsat)
+INVERSE_ARRAY(e_inverse_n, e_inverse)
+FREEUP; if (P) { pj_dalloc(P->track); pj_dalloc(P); } }
+ENTRY1(lsat, track)
     int land, path;
     double lam, alf, esc, ess;
 
@@ -167,5 +364,10 @@ ENTRY0(lsat)
 	P->b /= 30.;
 	P->c1 /= 15.;
 	P->c3 /= 45.;
+	if (pj_param(P->ctx, P->params, "btrack_table").i) {
+		track_init(P);
+		if (P->track == NULL) E_ERROR_0;
+	}
 	P->inv = e_inverse; P->fwd = e_forward;
+	P->inv_n = e_inverse_n; P->fwd_n = e_forward_n;
 ENDENTRY(P)
@@ -1,11 +1,14 @@
+#define PROJ_PARMS__ \
+	struct PJ_PHI2 cnf;
 #define PJ_LIB__
 #include	<projects.h>
+#include	<pj_math.h>
 PROJ_HEAD(merc, "Mercator") "\n\tCyl, Sph&Ell\n\tlat_ts=";
 #define EPS10 1.e-10
 FORWARD(e_forward); /* ellipsoid */
 	if (fabs(fabs(lp.phi) - HALFPI) <= EPS10) F_ERROR;
 	xy.x = P->k0 * lp.lam;
-	xy.y = - P->k0 * log(pj_tsfn(lp.phi, sin(lp.phi), P->e));
+	xy.y = - P->k0 * log(pj_tsfn_i(lp.phi, sin(lp.phi), P->e));
 	return (xy);
 }
 FORWARD(s_forward); /* spheroid */
@@ -15,7 +18,7 @@ FORWARD(s_forward); /* spheroid */
 	return (xy);
 }
 INVERSE(e_inverse); /* ellipsoid */
-	if ((lp.phi = pj_phi2(P->ctx, exp(- xy.y / P->k0), P->e)) == HUGE_VAL) I_ERROR;
+	if ((lp.phi = pj_phi2_ts(P->ctx, &P->cnf, exp(- xy.y / P->k0))) == HUGE_VAL) I_ERROR;
 	lp.lam = xy.x / P->k0;
 	return (lp);
 }
@@ -24,6 +27,40 @@ INVERSE(s_inverse); /* spheroid */
 	lp.lam = xy.x / P->k0;
 	return (lp);
 }
+SPECIAL(fac) { /* ellipsoid & spheroid */
+	double sinphi = sin(lp.phi);
+
+	fac->code |= IS_ANAL_XL_YL + IS_ANAL_XP_YP;
+	fac->der.x_l = P->k0;
+	fac->der.y_l = 0.;
+	fac->der.x_p = 0.;
+	fac->der.y_p = P->k0 * P->one_es /
+		((1. - P->es * sinphi * sinphi) * cos(lp.phi));
+}
+FORWARD_ARRAY(e_forward_n, e_forward)
+	static int /* ellipsoid, the latitudes of a contiguous run at once */
+e_inverse_n(PJ *P, long n, int stride, double *x, double *y) {
+	long i, io;
+	int err;
+
+	for (i = io = 0; i < n; ++i, io += stride)
+		if (x[io] != HUGE_VAL) {
+			y[io] = exp(- y[io] / P->k0);
+			x[io] /= P->k0;
+		} else
+			y[io] = HUGE_VAL;
+	if (stride == 1)
+		pj_phi2_array(P->ctx, &P->cnf, n, y);
+	else
+		for (i = io = 0; i < n; ++i, io += stride)
+			if (y[io] != HUGE_VAL)
+				y[io] = pj_phi2_ts(P->ctx, &P->cnf, y[io]);
+	if ((err = P->ctx->last_errno) != 0)
+		P->ctx->last_errno = 0;
+	return err;
+}
+FORWARD_ARRAY(s_forward_n, s_forward)
+INVERSE_ARRAY(s_inverse_n, s_inverse)
 FREEUP; if (P) pj_dalloc(P); }
 ENTRY0(merc)
 	double phits=0.0;
@@ -35,13 +72,20 @@ ENTRY0(merc)
 	}
 	if (P->es) { /* ellipsoid */
 		if (is_phits)
-			P->k0 = pj_msfn(sin(phits), cos(phits), P->es);
+			P->k0 = pj_msfn_i(sin(phits), cos(phits), P->es);
+		pj_phi2_init(&P->cnf, P->e);
 		P->inv = e_inverse;
 		P->fwd = e_forward;
+		P->inv_n = e_inverse_n;
+		P->fwd_n = e_forward_n;
 	} else { /* sphere */
 		if (is_phits)
 			P->k0 = cos(phits);
 		P->inv = s_inverse;
 		P->fwd = s_forward;
+		P->inv_n = s_inverse_n;
+		P->fwd_n = s_forward_n;
 	}
+	P->spc = fac;
+	P->separable = 1;
 ENDENTRY(P)
@@ -2,37 +2,71 @@
 	double	C_x, C_y, C_p;
 #define PJ_LIB__
 #include	<projects.h>
+#include	<pj_math.h>
 PROJ_HEAD(moll, "Mollweide") "\n\tPCyl., Sph.";
 PROJ_HEAD(wag4, "Wagner IV") "\n\tPCyl., Sph.";
 PROJ_HEAD(wag5, "Wagner V") "\n\tPCyl., Sph.";
 #define MAX_ITER	10
 #define LOOP_TOL	1e-7
+	static PJ_INLINE double
+newton_step(double t, double k, PJ *P) {
+	(void) P;
+	return ((t + sin(t) - k) / (1. + cos(t)));
+}
 FORWARD(s_forward); /* spheroid */
 	double k, V;
 	int i;
 
 	k = P->C_p * sin(lp.phi);
+	lp.phi = pj_tsin_start(k);
 	for (i = MAX_ITER; i ; --i) {
-		lp.phi -= V = (lp.phi + sin(lp.phi) - k) /
-			(1. + cos(lp.phi));
+		lp.phi -= V = newton_step(lp.phi, k, P);
 		if (fabs(V) < LOOP_TOL)
 			break;
 	}
-	if (!i)
-		lp.phi = (lp.phi < 0.) ? -HALFPI : HALFPI;
+	if (!i) /* at the poles the step is 0/0 */
+		lp.phi = (k < 0.) ? -HALFPI : HALFPI;
 	else
 		lp.phi *= 0.5;
 	xy.x = P->C_x * lp.lam * cos(lp.phi);
 	xy.y = P->C_y * sin(lp.phi);
 	return (xy);
+}
+	static int /* spheroid, the Newton iteration of a run of points at once */
+s_forward_n(PJ *P, long n, int stride, double *x, double *y) {
+	double phi[PJ_NEWTON_RUN], k[PJ_NEWTON_RUN];
+	char conv[PJ_NEWTON_RUN];
+	long i0, io, j, m;
+
+	for (i0 = 0; i0 < n; i0 += PJ_NEWTON_RUN) {
+		m = n - i0 < PJ_NEWTON_RUN ? n - i0 : PJ_NEWTON_RUN;
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			k[j] = P->C_p * sin(y[io]);
+			phi[j] = pj_tsin_start(k[j]);
+			conv[j] = x[io] == HUGE_VAL;
+		}
+		pj_newton_run(newton_step, P, MAX_ITER, LOOP_TOL, m, phi, k, conv);
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			if (conv[j] == 1)
+				continue;
+			if (!conv[j])
+				phi[j] = (k[j] < 0.) ? -HALFPI : HALFPI;
+			else
+				phi[j] *= 0.5;
+			x[io] = P->C_x * x[io] * cos(phi[j]);
+			y[io] = P->C_y * sin(phi[j]);
+		}
+	}
+	return 0;
 }
 INVERSE(s_inverse); /* spheroid */
-	lp.phi = aasin(P->ctx, xy.y / P->C_y);
+	lp.phi = pj_aasin_i(P->ctx, xy.y / P->C_y);
 	lp.lam = xy.x / (P->C_x * cos(lp.phi));
 	lp.phi += lp.phi;
-	lp.phi = aasin(P->ctx, (lp.phi + sin(lp.phi)) / P->C_p);
+	lp.phi = pj_aasin_i(P->ctx, (lp.phi + sin(lp.phi)) / P->C_p);
 	return (lp);
 }
+INVERSE_ARRAY(s_inverse_n, s_inverse)
 FREEUP; if (P) pj_dalloc(P); }
 	static PJ *
 setup(PJ *P, double p) {
@@ -46,6 +80,8 @@ setup(PJ *P, double p) {
 	P->C_p = p2 + sin(p2);
 	P->inv = s_inverse;
 	P->fwd = s_forward;
+	P->inv_n = s_inverse_n;
+	P->fwd_n = s_forward_n;
 	return P;
 }
 ENTRY0(moll) ENDENTRY(setup(P, HALFPI))
@@ -57,4 +93,6 @@ ENTRY0(wag5)
 	P->C_p = 3.00896;
 	P->inv = s_inverse;
 	P->fwd = s_forward;
+	P->inv_n = s_inverse_n;
+	P->fwd_n = s_forward_n;
 ENDENTRY(P)
@@ -13,6 +13,9 @@ and designed in collaboration with Tom Patterson.
 Port to PROJ.4 by Bernhard Jenny, 6 June 2011
 */
 
+#define NE_NODES 32
+#define PROJ_PARMS__ \
+	double	ci[4][NE_NODES];
 #define PJ_LIB__
 #include	<projects.h>
 PROJ_HEAD(natearth, "Natural Earth") "\n\tPCyl., Sph.";
@@ -43,29 +46,39 @@ FORWARD(s_forward); /* spheroid */
 	xy.y = lp.phi * (B0 + phi2 * (B1 + phi4 * (B2 + B3 * phi2 + B4 * phi4)));
 	return (xy);
 }
-INVERSE(s_inverse); /* spheroid */
-	double yc, tol, y2, y4, f, fder;
+	static double /* Newton-Raphson for the latitude of y, from yc */
+s_lat(double y, double yc) {
+	double tol, y2, y4, f, fder;
 
-        /* make sure y is inside valid range */
-	if (xy.y > MAX_Y) {
-		xy.y = MAX_Y;
-	} else if (xy.y < -MAX_Y) {
-		xy.y = -MAX_Y;
-	}
-
-        /* latitude */
-	yc = xy.y;
-        for (;;) { /* Newton-Raphson */
+	for (;;) {
 		y2 = yc * yc;
 		y4 = y2 * y2;
-		f = (yc * (B0 + y2 * (B1 + y4 * (B2 + B3 * y2 + B4 * y4)))) - xy.y;
+		f = (yc * (B0 + y2 * (B1 + y4 * (B2 + B3 * y2 + B4 * y4)))) - y;
 		fder = C0 + y2 * (C1 + y4 * (C2 + C3 * y2 + C4 * y4));
 		yc -= tol = f / fder;
 		if (fabs(tol) < EPS) {
 			break;
 		}
 	}
-	lp.phi = yc;
+	return yc;
+}
+INVERSE(s_inverse); /* spheroid */
+	double yc, y2, t;
+	int i;
+
+        /* make sure y is inside valid range */
+	if (xy.y > MAX_Y) {
+		xy.y = MAX_Y;
+	} else if (xy.y < -MAX_Y) {
+		xy.y = -MAX_Y;
+	}
+
+        /* latitude, from the inverse cubic of the interval of y */
+	t = fabs(xy.y) * (NE_NODES / MAX_Y);
+	if ((i = (int)t) >= NE_NODES) i = NE_NODES - 1;
+	t -= i;
+	yc = P->ci[0][i] + t * (P->ci[1][i] + t * (P->ci[2][i] + t * P->ci[3][i]));
+	lp.phi = yc = s_lat(xy.y, xy.y < 0. ? -yc : yc);
 
         /* longitude */
 	y2 = yc * yc;
@@ -73,5 +86,48 @@ INVERSE(s_inverse); /* spheroid */
 
 	return (lp);
 }
+	static int /* s_forward() of n points, without the calls */
+s_forward_n(PJ *P, long n, int stride, double *x, double *y) {
+	long i;
+
+	for (i = 0; i < n; i++) {
+		long io = i * stride;
+		double phi2, phi4;
+
+		if (x[io] == HUGE_VAL)
+			continue;
+		phi2 = y[io] * y[io];
+		phi4 = phi2 * phi2;
+		x[io] *= (A0 + phi2 * (A1 + phi2 * (A2 + phi4 * phi2 * (A3 + phi2 * A4))));
+		y[io] *= (B0 + phi2 * (B1 + phi4 * (B2 + B3 * phi2 + B4 * phi4)));
+	}
+	return 0;
+}
+INVERSE_ARRAY(s_inverse_n, s_inverse)
 FREEUP; if (P) pj_dalloc(P); }
-ENTRY0(natearth) P->es = 0; P->inv = s_inverse; P->fwd = s_forward; ENDENTRY(P)
+ENTRY0(natearth)
+	double h = MAX_Y / NE_NODES, phi0, phi1, d0, d1;
+	int i;
+
+	/* Hermite cubics of the latitude over NE_NODES intervals of y */
+	phi0 = 0.;
+	d0 = h / C0;
+	for (i = 0; i < NE_NODES; ++i) {
+		double y2;
+
+		phi1 = s_lat((i + 1) * h, phi0);
+		y2 = phi1 * phi1;
+		d1 = h / (C0 + y2 * (C1 + y2 * y2 * (C2 + C3 * y2 + C4 * y2 * y2)));
+		P->ci[0][i] = phi0;
+		P->ci[1][i] = d0;
+		P->ci[2][i] = 3. * (phi1 - phi0) - 2. * d0 - d1;
+		P->ci[3][i] = d0 + d1 - 2. * (phi1 - phi0);
+		phi0 = phi1;
+		d0 = d1;
+	}
+	P->es = 0;
+	P->inv = s_inverse;
+	P->fwd = s_forward;
+	P->inv_n = s_inverse_n;
+	P->fwd_n = s_forward_n;
+ENDENTRY(P)
@@ -1,8 +1,14 @@
 #define PJ_LIB__
 #include	<projects.h>
+#include	<pj_math.h>
 PROJ_HEAD(nell, "Nell") "\n\tPCyl., Sph.";
 #define MAX_ITER	10
 #define LOOP_TOL	1e-7
+	static PJ_INLINE double
+newton_step(double t, double k, PJ *P) {
+	(void) P;
+	return ((t + sin(t) - k) / (1. + cos(t)));
+}
 FORWARD(s_forward); /* spheroid */
 	double k, V;
 	int i;
@@ -11,19 +17,50 @@ FORWARD(s_forward); /* spheroid */
 	V = lp.phi * lp.phi;
 	lp.phi *= 1.00371 + V * (-0.0935382 + V * -0.011412);
 	for (i = MAX_ITER; i ; --i) {
-		lp.phi -= V = (lp.phi + sin(lp.phi) - k) /
-			(1. + cos(lp.phi));
+		lp.phi -= V = newton_step(lp.phi, k, P);
 		if (fabs(V) < LOOP_TOL)
 			break;
 	}
 	xy.x = 0.5 * lp.lam * (1. + cos(lp.phi));
 	xy.y = lp.phi;
 	return (xy);
+}
+	static int /* spheroid, the Newton iteration of a run of points at once */
+s_forward_n(PJ *P, long n, int stride, double *x, double *y) {
+	double phi[PJ_NEWTON_RUN], k[PJ_NEWTON_RUN];
+	char conv[PJ_NEWTON_RUN];
+	long i0, io, j, m;
+
+	for (i0 = 0; i0 < n; i0 += PJ_NEWTON_RUN) {
+		m = n - i0 < PJ_NEWTON_RUN ? n - i0 : PJ_NEWTON_RUN;
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			double V = y[io] * y[io];
+
+			k[j] = 2. * sin(y[io]);
+			phi[j] = y[io] * (1.00371 + V * (-0.0935382 + V * -0.011412));
+			conv[j] = x[io] == HUGE_VAL;
+		}
+		pj_newton_run(newton_step, P, MAX_ITER, LOOP_TOL, m, phi, k, conv);
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			if (conv[j] == 1)
+				continue;
+			x[io] = 0.5 * x[io] * (1. + cos(phi[j]));
+			y[io] = phi[j];
+		}
+	}
+	return 0;
 }
 INVERSE(s_inverse); /* spheroid */
 	lp.lam = 2. * xy.x / (1. + cos(xy.y));
 	lp.phi = aasin(P->ctx,0.5 * (xy.y + sin(xy.y)));
 	return (lp);
 }
+INVERSE_ARRAY(s_inverse_n, s_inverse)
 FREEUP; if (P) pj_dalloc(P); }
-ENTRY0(nell) P->es = 0; P->inv = s_inverse; P->fwd = s_forward; ENDENTRY(P)
+ENTRY0(nell)
+	P->es = 0;
+	P->inv = s_inverse;
+	P->fwd = s_forward;
+	P->inv_n = s_inverse_n;
+	P->fwd_n = s_forward_n;
+ENDENTRY(P)
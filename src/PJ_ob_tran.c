@@ -1,9 +1,9 @@
 #define PROJ_PARMS__ \
-	struct PJconsts *link; \
 	double	lamp; \
 	double	cphip, sphip;
 #define PJ_LIB__
 #include <projects.h>
+#include <pj_math.h>
 #include <string.h>
 PROJ_HEAD(ob_tran, "General Oblique Transformation") "\n\tMisc Sph"
 "\n\to_proj= plus parameters for projection"
@@ -19,9 +19,9 @@ FORWARD(o_forward); /* spheroid */
 	coslam = cos(lp.lam);
 	sinphi = sin(lp.phi);
 	cosphi = cos(lp.phi);
-	lp.lam = adjlon(aatan2(cosphi * sin(lp.lam), P->sphip * cosphi * coslam +
+	lp.lam = adjlon(pj_aatan2_i(cosphi * sin(lp.lam), P->sphip * cosphi * coslam +
 		P->cphip * sinphi) + P->lamp);
-	lp.phi = aasin(P->ctx,P->sphip * sinphi - P->cphip * cosphi * coslam);
+	lp.phi = pj_aasin_i(P->ctx,P->sphip * sinphi - P->cphip * cosphi * coslam);
 	return (P->link->fwd(lp, P->link));
 }
 FORWARD(t_forward); /* spheroid */
@@ -31,8 +31,8 @@ FORWARD(t_forward); /* spheroid */
 
 	cosphi = cos(lp.phi);
 	coslam = cos(lp.lam);
-	lp.lam = adjlon(aatan2(cosphi * sin(lp.lam), sin(lp.phi)) + P->lamp);
-	lp.phi = aasin(P->ctx, - cosphi * coslam);
+	lp.lam = adjlon(pj_aatan2_i(cosphi * sin(lp.lam), sin(lp.phi)) + P->lamp);
+	lp.phi = pj_aasin_i(P->ctx, - cosphi * coslam);
 	return (P->link->fwd(lp, P->link));
 }
 INVERSE(o_inverse); /* spheroid */
@@ -43,8 +43,8 @@ INVERSE(o_inverse); /* spheroid */
 		coslam = cos(lp.lam -= P->lamp);
 		sinphi = sin(lp.phi);
 		cosphi = cos(lp.phi);
-		lp.phi = aasin(P->ctx,P->sphip * sinphi + P->cphip * cosphi * coslam);
-		lp.lam = aatan2(cosphi * sin(lp.lam), P->sphip * cosphi * coslam -
+		lp.phi = pj_aasin_i(P->ctx,P->sphip * sinphi + P->cphip * cosphi * coslam);
+		lp.lam = pj_aatan2_i(cosphi * sin(lp.lam), P->sphip * cosphi * coslam -
 			P->cphip * sinphi);
 	}
 	return (lp);
@@ -56,11 +56,117 @@ INVERSE(t_inverse); /* spheroid */
 	if (lp.lam != HUGE_VAL) {
 		cosphi = cos(lp.phi);
 		t = lp.lam - P->lamp;
-		lp.lam = aatan2(cosphi * sin(t), - sin(lp.phi));
-		lp.phi = aasin(P->ctx,cosphi * cos(t));
+		lp.lam = pj_aatan2_i(cosphi * sin(t), - sin(lp.phi));
+		lp.phi = pj_aasin_i(P->ctx,cosphi * cos(t));
 	}
 	return (lp);
 }
+/*
+** The array kernels rotate all of the points, and then run the
+** linked projection over them at once.
+*/
+	static int
+o_forward_n(PJ *P, long n, int stride, double *x, double *y) {
+	long i;
+	int err = 0, kerr;
+
+	for (i = 0; i < n; i++) {
+		double coslam, sinphi, cosphi;
+		long io = i * stride;
+
+		if (x[io] == HUGE_VAL)
+			continue;
+		coslam = cos(x[io]);
+		sinphi = sin(y[io]);
+		cosphi = cos(y[io]);
+		x[io] = adjlon(pj_aatan2_i(cosphi * sin(x[io]), P->sphip * cosphi *
+			coslam + P->cphip * sinphi) + P->lamp);
+		y[io] = pj_aasin_i(P->ctx,P->sphip * sinphi - P->cphip * cosphi * coslam);
+		if (P->ctx->last_errno) {
+			err = P->ctx->last_errno;
+			P->ctx->last_errno = 0;
+			x[io] = y[io] = HUGE_VAL;
+		}
+	}
+	if ((kerr = pj_fwd_kernel(P->link, n, stride, x, y)) != 0)
+		err = kerr;
+	return err;
+}
+	static int
+t_forward_n(PJ *P, long n, int stride, double *x, double *y) {
+	long i;
+	int err = 0, kerr;
+
+	for (i = 0; i < n; i++) {
+		double cosphi, coslam;
+		long io = i * stride;
+
+		if (x[io] == HUGE_VAL)
+			continue;
+		cosphi = cos(y[io]);
+		coslam = cos(x[io]);
+		x[io] = adjlon(pj_aatan2_i(cosphi * sin(x[io]), sin(y[io])) + P->lamp);
+		y[io] = pj_aasin_i(P->ctx, - cosphi * coslam);
+		if (P->ctx->last_errno) {
+			err = P->ctx->last_errno;
+			P->ctx->last_errno = 0;
+			x[io] = y[io] = HUGE_VAL;
+		}
+	}
+	if ((kerr = pj_fwd_kernel(P->link, n, stride, x, y)) != 0)
+		err = kerr;
+	return err;
+}
+	static int
+o_inverse_n(PJ *P, long n, int stride, double *x, double *y) {
+	long i;
+	int err;
+
+	err = pj_inv_kernel(P->link, n, stride, x, y);
+	for (i = 0; i < n; i++) {
+		double coslam, sinphi, cosphi, lam;
+		long io = i * stride;
+
+		if (x[io] == HUGE_VAL)
+			continue;
+		coslam = cos(lam = x[io] - P->lamp);
+		sinphi = sin(y[io]);
+		cosphi = cos(y[io]);
+		y[io] = pj_aasin_i(P->ctx,P->sphip * sinphi + P->cphip * cosphi * coslam);
+		x[io] = pj_aatan2_i(cosphi * sin(lam), P->sphip * cosphi * coslam -
+			P->cphip * sinphi);
+		if (P->ctx->last_errno) {
+			err = P->ctx->last_errno;
+			P->ctx->last_errno = 0;
+			x[io] = y[io] = HUGE_VAL;
+		}
+	}
+	return err;
+}
+	static int
+t_inverse_n(PJ *P, long n, int stride, double *x, double *y) {
+	long i;
+	int err;
+
+	err = pj_inv_kernel(P->link, n, stride, x, y);
+	for (i = 0; i < n; i++) {
+		double cosphi, t;
+		long io = i * stride;
+
+		if (x[io] == HUGE_VAL)
+			continue;
+		cosphi = cos(y[io]);
+		t = x[io] - P->lamp;
+		x[io] = pj_aatan2_i(cosphi * sin(t), - sin(y[io]));
+		y[io] = pj_aasin_i(P->ctx,cosphi * cos(t));
+		if (P->ctx->last_errno) {
+			err = P->ctx->last_errno;
+			P->ctx->last_errno = 0;
+			x[io] = y[io] = HUGE_VAL;
+		}
+	}
+	return err;
+}
 FREEUP;
 	if (P) {
 		if (P->link)
@@ -69,14 +175,14 @@ FREEUP;
 	}
 }
 ENTRY1(ob_tran, link)
-	int i;
+	struct PJ_LIST *entry;
 	double phip;
-	char *name, *s;
+	char *name;
 
 	/* get name of projection to be translated */
 	if (!(name = pj_param(P->ctx, P->params, "so_proj").s)) E_ERROR(-26);
-	for (i = 0; (s = pj_list[i].id) && strcmp(name, s) ; ++i) ;
-	if (!s || !(P->link = (*pj_list[i].proj)(0))) E_ERROR(-37);
+	if (!(entry = pj_find_proj(name)) || !(P->link = (*entry->proj)(0)))
+		E_ERROR(-37);
 	/* copy existing header into new */
 	P->es = 0.; /* force to spherical */
 	P->link->params = P->params;
@@ -94,7 +200,7 @@ ENTRY1(ob_tran, link)
 	/* force spherical earth */
 	P->link->one_es = P->link->rone_es = 1.;
 	P->link->es = P->link->e = 0.;
-	if (!(P->link = pj_list[i].proj(P->link))) {
+	if (!(P->link = entry->proj(P->link))) {
 		freeup(P);
 		return 0;
 	}
@@ -111,8 +217,8 @@ ENTRY1(ob_tran, link)
 */
 		if (fabs(fabs(phic) - HALFPI) <= TOL)
 			E_ERROR(-32);
-		P->lamp = lamc + aatan2(-cos(alpha), -sin(alpha) * sin(phic));
-		phip = aasin(P->ctx,cos(phic) * sin(alpha));
+		P->lamp = lamc + pj_aatan2_i(-cos(alpha), -sin(alpha) * sin(phic));
+		phip = pj_aasin_i(P->ctx,cos(phic) * sin(alpha));
 	} else if (pj_param(P->ctx, P->params, "to_lat_p").i) { /* specified new pole */
 		P->lamp = pj_param(P->ctx, P->params, "ro_lon_p").f;
 		phip = pj_param(P->ctx, P->params, "ro_lat_p").f;
@@ -138,8 +244,12 @@ ENTRY1(ob_tran, link)
 		P->sphip = sin(phip);
 		P->fwd = o_forward;
 		P->inv = P->link->inv ? o_inverse : 0;
+		P->fwd_n = o_forward_n;
+		P->inv_n = P->link->inv ? o_inverse_n : 0;
 	} else { /* transverse */
 		P->fwd = t_forward;
 		P->inv = P->link->inv ? t_inverse : 0;
+		P->fwd_n = t_forward_n;
+		P->inv_n = P->link->inv ? t_inverse_n : 0;
 	}
 ENDENTRY(P)
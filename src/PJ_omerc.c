@@ -24,9 +24,11 @@
 #define PROJ_PARMS__ \
 	double	A, B, E, AB, ArB, BrA, rB, singam, cosgam, sinrot, cosrot; \
 	double  v_pole_n, v_pole_s, u_0; \
-	int no_rot;
+	int no_rot; \
+	struct PJ_PHI2 cnf;
 #define PJ_LIB__
 #include <projects.h>
+#include <pj_math.h>
 
 PROJ_HEAD(omerc, "Oblique Mercator")
 	"\n\tCyl, Sph&Ell no_rot\n\t"
@@ -34,11 +36,11 @@ PROJ_HEAD(omerc, "Oblique Mercator")
 #define TOL	1.e-7
 #define EPS	1.e-10
 
-FORWARD(e_forward); /* ellipsoid */
+FORWARD_MODAL(e_forward); /* ellipsoid, mode being no_rot */
 	double  Q, S, T, U, V, temp, u, v;
 
 	if (fabs(fabs(lp.phi) - HALFPI) > EPS) {
-		Q = P->E / pow(pj_tsfn(lp.phi, sin(lp.phi), P->e), P->B);
+		Q = P->E / pow(pj_tsfn_i(lp.phi, sin(lp.phi), P->e), P->B);
 		temp = 1. / Q;
 		S = .5 * (Q - temp);
 		T = .5 * (Q + temp);
@@ -57,7 +59,7 @@ FORWARD(e_forward); /* ellipsoid */
 		v = lp.phi > 0 ? P->v_pole_n : P->v_pole_s;
 		u = P->ArB * lp.phi;
 	}
-	if (P->no_rot) {
+	if (mode) {
 		xy.x = u;
 		xy.y = v;
 	} else {
@@ -67,10 +69,38 @@ FORWARD(e_forward); /* ellipsoid */
 	}
 	return (xy);
 }
-INVERSE(e_inverse); /* ellipsoid */
+SPECIAL(fac) { /* ellipsoid, from the lam derivatives of e_forward() */
+	double  Q, S, T, U, V, M, N, dU, dN, dM, u_l, v_l;
+
+	if (fabs(fabs(lp.phi) - HALFPI) <= EPS)
+		return;
+	Q = P->E / pow(pj_tsfn_i(lp.phi, sin(lp.phi), P->e), P->B);
+	S = .5 * (Q - 1. / Q);
+	T = .5 * (Q + 1. / Q);
+	V = sin(P->B * lp.lam);
+	M = cos(P->B * lp.lam);
+	U = (S * P->singam - V * P->cosgam) / T;
+	if (fabs(fabs(U) - 1.0) < EPS || fabs(M) < TOL)
+		return;
+	dU = - P->B * M * P->cosgam / T;
+	v_l = - P->ArB * dU / (1. - U * U);
+	N = S * P->cosgam + V * P->singam;
+	dN = P->B * M * P->singam;
+	dM = - P->B * V;
+	u_l = P->ArB * (M * dN - N * dM) / (M * M + N * N);
+	if (P->no_rot) { /* u, v is a mirrored system */
+		pj_conformal_der(lp, P, u_l, v_l, fac);
+		fac->der.x_p = - fac->der.x_p;
+		fac->der.y_p = - fac->der.y_p;
+	} else
+		pj_conformal_der(lp, P, v_l * P->cosrot + u_l * P->sinrot,
+			u_l * P->cosrot - v_l * P->sinrot, fac);
+}
+	static PJ_INLINE double /* e_inverse() up to the isometric ts */
+e_inverse_ts(PJ *P, XY xy, int no_rot, double *lam, double *pole) {
 	double  u, v, Qp, Sp, Tp, Vp, Up;
 
-	if (P->no_rot) {
+	if (no_rot) {
 		v = xy.y;
 		u = xy.x;
 	} else {
@@ -83,17 +113,67 @@ INVERSE(e_inverse); /* ellipsoid */
 	Vp = sin(P->BrA * u);
 	Up = (Vp * P->cosgam + Sp * P->singam) / Tp;
 	if (fabs(fabs(Up) - 1.) < EPS) {
-		lp.lam = 0.;
-		lp.phi = Up < 0. ? -HALFPI : HALFPI;
-	} else {
-		lp.phi = P->E / sqrt((1. + Up) / (1. - Up));
-		if ((lp.phi = pj_phi2(P->ctx, pow(lp.phi, 1. / P->B), P->e)) == HUGE_VAL)
-			I_ERROR;
-		lp.lam = - P->rB * atan2((Sp * P->cosgam -
-			Vp * P->singam), cos(P->BrA * u));
+		*lam = 0.;
+		*pole = Up < 0. ? -HALFPI : HALFPI;
+		return 0.;
 	}
+	*lam = - P->rB * atan2((Sp * P->cosgam -
+		Vp * P->singam), cos(P->BrA * u));
+	*pole = 0.;
+	return pow(P->E / sqrt((1. + Up) / (1. - Up)), 1. / P->B);
+}
+INVERSE_MODAL(e_inverse); /* ellipsoid, mode being no_rot */
+	double  ts, pole;
+
+	ts = e_inverse_ts(P, xy, mode, &lp.lam, &pole);
+	if (pole != 0.)
+		lp.phi = pole;
+	else if ((lp.phi = pj_phi2_ts(P->ctx, &P->cnf, ts)) == HUGE_VAL)
+		I_ERROR;
 	return (lp);
 }
+	static PJ_INLINE int /* e_inverse() of a run, its latitudes at once */
+e_inverse_run(PJ *P, long n, int stride, double *x, double *y, int no_rot) {
+	double ts[PJ_ARRAY_RUN], pole[PJ_ARRAY_RUN];
+	long i0, io, j, m;
+	int err;
+
+	for (i0 = 0; i0 < n; i0 += PJ_ARRAY_RUN) {
+		m = n - i0 < PJ_ARRAY_RUN ? n - i0 : PJ_ARRAY_RUN;
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			XY xy;
+
+			ts[j] = HUGE_VAL;
+			pole[j] = 0.;
+			if (x[io] == HUGE_VAL)
+				continue;
+			xy.x = x[io];
+			xy.y = y[io];
+			ts[j] = e_inverse_ts(P, xy, no_rot, x + io, pole + j);
+			if (pole[j] != 0.)
+				ts[j] = HUGE_VAL;
+		}
+		pj_phi2_array(P->ctx, &P->cnf, m, ts);
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride)
+			if (x[io] != HUGE_VAL)
+				y[io] = pole[j] != 0. ? pole[j] : ts[j];
+	}
+	if ((err = P->ctx->last_errno) != 0)
+		P->ctx->last_errno = 0;
+	return err;
+}
+	/* the plain and array functions of one constant no_rot */
+#define E_MODE_KERNELS(fwd, inv, no_rot) \
+FORWARD_MODE(fwd, e_forward, no_rot) \
+static LP inv(XY xy, PJ *P) { return e_inverse(xy, P, no_rot); } \
+static int inv##_n(PJ *P, long n, int stride, double *x, double *y) { \
+	return e_inverse_run(P, n, stride, x, y, no_rot); }
+E_MODE_KERNELS(e_forward_rot, e_inverse_rot, 0)
+E_MODE_KERNELS(e_forward_no_rot, e_inverse_no_rot, 1)
+static const struct PJ_KERNELS e_kernels[] = { /* by no_rot */
+	MODE_KERNELS(e_forward_rot, e_inverse_rot),
+	MODE_KERNELS(e_forward_no_rot, e_inverse_no_rot)
+};
 FREEUP; if (P) pj_dalloc(P); }
 ENTRY0(omerc)
 	double con, com, cosph0, D, F, H, L, sinph0, p, J, gamma=0,
@@ -146,7 +226,7 @@ ENTRY0(omerc)
 				F = -F;
 		}
 		P->E = F += D;
-		P->E *= pow(pj_tsfn(P->phi0, sinph0, P->e), P->B);
+		P->E *= pow(pj_tsfn_i(P->phi0, sinph0, P->e), P->B);
 	} else {
 		P->B = 1. / com;
 		P->A = P->k0;
@@ -166,8 +246,8 @@ ENTRY0(omerc)
 		P->lam0 = lamc - asin(.5 * (F - 1. / F) *
 		   tan(gamma0)) / P->B;
 	} else {
-		H = pow(pj_tsfn(phi1, sin(phi1), P->e), P->B);
-		L = pow(pj_tsfn(phi2, sin(phi2), P->e), P->B);
+		H = pow(pj_tsfn_i(phi1, sin(phi1), P->e), P->B);
+		L = pow(pj_tsfn_i(phi2, sin(phi2), P->e), P->B);
 		F = P->E / H;
 		p = (L - H) / (L + H);
 		J = P->E * P->E;
@@ -182,6 +262,7 @@ ENTRY0(omerc)
 		   (F - 1. / F));
 		gamma = alpha_c = asin(D * sin(gamma0));
 	}
+	pj_phi2_init(&P->cnf, P->e);
 	P->singam = sin(gamma0);
 	P->cosgam = cos(gamma0);
 	P->sinrot = sin(gamma);
@@ -198,6 +279,6 @@ ENTRY0(omerc)
 	F = 0.5 * gamma0;
 	P->v_pole_n = P->ArB * log(tan(FORTPI - F));
 	P->v_pole_s = P->ArB * log(tan(FORTPI + F));
-	P->inv = e_inverse;
-	P->fwd = e_forward;
+	SET_KERNELS(P, e_kernels[P->no_rot != 0]);
+	P->spc = fac;
 ENDENTRY(P)
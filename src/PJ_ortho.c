@@ -10,12 +10,12 @@ PROJ_HEAD(ortho, "Orthographic") "\n\tAzi, Sph.";
 #define S_POLE 1
 #define EQUIT	2
 #define OBLIQ	3
-FORWARD(s_forward); /* spheroid */
+FORWARD_MODAL(s_forward); /* spheroid */
 	double  coslam, cosphi, sinphi;
 
 	cosphi = cos(lp.phi);
 	coslam = cos(lp.lam);
-	switch (P->mode) {
+	switch (mode) {
 	case EQUIT:
 		if (cosphi * coslam < - EPS10) F_ERROR;
 		xy.y = sin(lp.phi);
@@ -36,7 +36,7 @@ FORWARD(s_forward); /* spheroid */
 	return (xy);
 }
 
-INVERSE(s_inverse); /* spheroid */
+INVERSE_MODAL(s_inverse); /* spheroid */
     double  rh, cosc, sinc;
 
     if ((sinc = (rh = hypot(xy.x, xy.y))) > 1.) {
@@ -48,7 +48,7 @@ INVERSE(s_inverse); /* spheroid */
         lp.phi = P->phi0;
         lp.lam = 0.0;
     } else {
-        switch (P->mode) {
+        switch (mode) {
         case N_POLE:
             xy.y = -xy.y;
             lp.phi = acos(sinc);
@@ -72,13 +72,27 @@ INVERSE(s_inverse); /* spheroid */
                 lp.phi = asin(lp.phi);
             break;
         }
-        lp.lam = (xy.y == 0. && (P->mode == OBLIQ || P->mode == EQUIT))
+        lp.lam = (xy.y == 0. && (mode == OBLIQ || mode == EQUIT))
              ? (xy.x == 0. ? 0. : xy.x < 0. ? -HALFPI : HALFPI)
                            : atan2(xy.x, xy.y);
     }
     return (lp);
 }
 
+FORWARD_MODE(s_forward_npole, s_forward, N_POLE)
+FORWARD_MODE(s_forward_spole, s_forward, S_POLE)
+FORWARD_MODE(s_forward_equit, s_forward, EQUIT)
+FORWARD_MODE(s_forward_obliq, s_forward, OBLIQ)
+INVERSE_MODE(s_inverse_npole, s_inverse, N_POLE)
+INVERSE_MODE(s_inverse_spole, s_inverse, S_POLE)
+INVERSE_MODE(s_inverse_equit, s_inverse, EQUIT)
+INVERSE_MODE(s_inverse_obliq, s_inverse, OBLIQ)
+static const struct PJ_KERNELS s_kernels[] = { /* by mode */
+	MODE_KERNELS(s_forward_npole, s_inverse_npole),
+	MODE_KERNELS(s_forward_spole, s_inverse_spole),
+	MODE_KERNELS(s_forward_equit, s_inverse_equit),
+	MODE_KERNELS(s_forward_obliq, s_inverse_obliq)
+};
 FREEUP; if (P) pj_dalloc(P); }
 ENTRY0(ortho)
 	if (fabs(fabs(P->phi0) - HALFPI) <= EPS10)
@@ -89,7 +103,6 @@ ENTRY0(ortho)
 		P->cosph0 = cos(P->phi0);
 	} else
 		P->mode = EQUIT;
-	P->inv = s_inverse;
-	P->fwd = s_forward;
+	SET_KERNELS(P, s_kernels[P->mode]);
 	P->es = 0.;
 ENDENTRY(P)
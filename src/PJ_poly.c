@@ -3,6 +3,7 @@
 	double *en;
 #define PJ_LIB__
 #include <projects.h>
+#include <pj_math.h>
 PROJ_HEAD(poly, "Polyconic (American)")
 	"\n\tConic, Sph&Ell";
 #define TOL	1e-10
@@ -16,9 +17,9 @@ FORWARD(e_forward); /* ellipsoid */
 	if (fabs(lp.phi) <= TOL) { xy.x = lp.lam; xy.y = -P->ml0; }
 	else {
 		sp = sin(lp.phi);
-		ms = fabs(cp = cos(lp.phi)) > TOL ? pj_msfn(sp, cp, P->es) / sp : 0.;
+		ms = fabs(cp = cos(lp.phi)) > TOL ? pj_msfn_i(sp, cp, P->es) / sp : 0.;
 		xy.x = ms * sin(lp.lam *= sp);
-		xy.y = (pj_mlfn(lp.phi, sp, cp, P->en) - P->ml0) + ms * (1. - cos(lp.lam));
+		xy.y = (pj_mlfn_i(lp.phi, sp, cp, P->en) - P->ml0) + ms * (1. - cos(lp.lam));
 	}
 	return (xy);
 }
@@ -47,7 +48,7 @@ INVERSE(e_inverse); /* ellipsoid */
 			if (fabs(cp) < ITOL)
 				I_ERROR;
 			c = sp * (mlp = sqrt(1. - P->es * sp * sp)) / cp;
-			ml = pj_mlfn(lp.phi, sp, cp, P->en);
+			ml = pj_mlfn_i(lp.phi, sp, cp, P->en);
 			mlb = ml * ml + r;
 			mlp = P->one_es / (mlp * mlp * mlp);
 			lp.phi += ( dPhi =
@@ -84,11 +85,11 @@ INVERSE(s_inverse); /* spheroid */
 	}
 	return (lp);
 }
-FREEUP; if (P) { if (P->en) pj_dalloc(P->en); pj_dalloc(P); } }
+FREEUP; if (P) { if (P->en) pj_table_release(P->en); pj_dalloc(P); } }
 ENTRY1(poly, en)
 	if (P->es) {
 		if (!(P->en = pj_enfn(P->es))) E_ERROR_0;
-		P->ml0 = pj_mlfn(P->phi0, sin(P->phi0), cos(P->phi0), P->en);
+		P->ml0 = pj_mlfn_i(P->phi0, sin(P->phi0), cos(P->phi0), P->en);
 		P->inv = e_inverse;
 		P->fwd = e_forward;
 	} else {
@@ -1,5 +1,6 @@
 #define PJ_LIB__
 #include	<projects.h>
+#include	<pj_math.h>
 PROJ_HEAD(putp2, "Putnins P2") "\n\tPCyl., Sph.";
 #define C_x	1.89490
 #define C_y	1.71848
@@ -7,18 +8,22 @@ PROJ_HEAD(putp2, "Putnins P2") "\n\tPCyl., Sph.";
 #define EPS	1e-10
 #define NITER	10
 #define PI_DIV_3	1.0471975511965977
+	static PJ_INLINE double
+newton_step(double t, double p, PJ *P) {
+	double c = cos(t), s = sin(t);
+
+	(void) P;
+	return ((t + s * (c - 1.) - p) / (1. + c * (c - 1.) - s * s));
+}
 FORWARD(s_forward); /* spheroid */
-	double p, c, s, V;
+	double p, s, V;
 	int i;
 
 	p = C_p * sin(lp.phi);
 	s = lp.phi * lp.phi;
 	lp.phi *= 0.615709 + s * ( 0.00909953 + s * 0.0046292 );
 	for (i = NITER; i ; --i) {
-		c = cos(lp.phi);
-		s = sin(lp.phi);
-		lp.phi -= V = (lp.phi + s * (c - 1.) - p) /
-			(1. + c * (c - 1.) - s * s);
+		lp.phi -= V = newton_step(lp.phi, p, P);
 		if (fabs(V) < EPS)
 			break;
 	}
@@ -27,6 +32,33 @@ FORWARD(s_forward); /* spheroid */
 	xy.x = C_x * lp.lam * (cos(lp.phi) - 0.5);
 	xy.y = C_y * sin(lp.phi);
 	return (xy);
+}
+	static int /* spheroid, the Newton iteration of a run of points at once */
+s_forward_n(PJ *P, long n, int stride, double *x, double *y) {
+	double phi[PJ_NEWTON_RUN], p[PJ_NEWTON_RUN];
+	char conv[PJ_NEWTON_RUN];
+	long i0, io, j, m;
+
+	for (i0 = 0; i0 < n; i0 += PJ_NEWTON_RUN) {
+		m = n - i0 < PJ_NEWTON_RUN ? n - i0 : PJ_NEWTON_RUN;
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			double s = y[io] * y[io];
+
+			p[j] = C_p * sin(y[io]);
+			phi[j] = y[io] * (0.615709 + s * ( 0.00909953 + s * 0.0046292 ));
+			conv[j] = x[io] == HUGE_VAL;
+		}
+		pj_newton_run(newton_step, P, NITER, EPS, m, phi, p, conv);
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			if (conv[j] == 1)
+				continue;
+			if (!conv[j])
+				phi[j] = phi[j] < 0 ? - PI_DIV_3 : PI_DIV_3;
+			x[io] = C_x * x[io] * (cos(phi[j]) - 0.5);
+			y[io] = C_y * sin(phi[j]);
+		}
+	}
+	return 0;
 }
 INVERSE(s_inverse); /* spheroid */
 	double c;
@@ -36,5 +68,12 @@ INVERSE(s_inverse); /* spheroid */
 	lp.phi = aasin(P->ctx,(lp.phi + sin(lp.phi) * (c - 1.)) / C_p);
 	return (lp);
 }
+INVERSE_ARRAY(s_inverse_n, s_inverse)
 FREEUP; if (P) pj_dalloc(P); }
-ENTRY0(putp2) P->es = 0.; P->inv = s_inverse; P->fwd = s_forward; ENDENTRY(P)
+ENTRY0(putp2)
+	P->es = 0.;
+	P->inv = s_inverse;
+	P->fwd = s_forward;
+	P->inv_n = s_inverse_n;
+	P->fwd_n = s_forward_n;
+ENDENTRY(P)
@@ -36,6 +36,13 @@
  * between (-1/4 * PI) and (+1/4 * PI) on the current cube face. This area
  * of definition is named AREA_0 in the projection code below. The other
  * three areas of a cube face are handled by rotation of AREA_0.
+ *
+ * The face is fixed by the projection center, so the kernels are
+ * specialized by face as those of other projections by mode, see
+ * FORWARD_MODAL.  The area of each point is selected by comparisons
+ * folded into its arithmetic instead of branches, and the array kernels
+ * take a run of points through each step together, so that the steps
+ * without calls to the math library compile to loops over the run.
  */
 
 #define PROJ_PARMS__ \
@@ -46,6 +53,7 @@
         double one_minus_f_squared;
 #define PJ_LIB__
 #include        <projects.h>
+#include        <pj_math.h>
 PROJ_HEAD(qsc, "Quadrilateralized Spherical Cube") "\n\tAzi, Sph.";
 #define EPS10 1.e-10
 
@@ -64,128 +72,91 @@ PROJ_HEAD(qsc, "Quadrilateralized Spherical Cube") "\n\tAzi, Sph.";
 #define AREA_2 2
 #define AREA_3 3
 
+/* The angle added to mu going forward, by area. */
+static const double qsc_area_mu[4] = { 0.0, HALFPI, PI, HALFPI + PI };
+
 /* Helper function for forward projection: compute the theta angle
  * and determine the area number. */
-static double
+static PJ_INLINE double
 qsc_fwd_equat_face_theta(double phi, double y, double x, int *area) {
-        double theta;
-        if (phi < EPS10) {
-            *area = AREA_0;
-            theta = 0.0;
-        } else {
-            theta = atan2(y, x);
-            if (fabs(theta) <= FORTPI) {
-                *area = AREA_0;
-            } else if (theta > FORTPI && theta <= HALFPI + FORTPI) {
-                *area = AREA_1;
-                theta -= HALFPI;
-            } else if (theta > HALFPI + FORTPI || theta <= -(HALFPI + FORTPI)) {
-                *area = AREA_2;
-                theta = (theta >= 0.0 ? theta - PI : theta + PI);
-            } else {
-                *area = AREA_3;
-                theta += HALFPI;
-            }
-        }
-        return (theta);
+        double theta = atan2(y, x);
+        int a1 = theta > FORTPI && theta <= HALFPI + FORTPI;
+        int a2 = theta > HALFPI + FORTPI || theta <= -(HALFPI + FORTPI);
+        int a3 = theta < -FORTPI && theta > -(HALFPI + FORTPI);
+
+        theta -= a1 ? HALFPI : a3 ? -HALFPI
+                 : a2 ? (theta >= 0.0 ? PI : -PI) : 0.0;
+        *area = phi < EPS10 ? AREA_0 : a1 * AREA_1 + a2 * AREA_2 + a3 * AREA_3;
+        return (phi < EPS10 ? 0.0 : theta);
 }
 
 /* Helper function: shift the longitude. */
-static double
+static PJ_INLINE double
 qsc_shift_lon_origin(double lon, double offset) {
         double slon = lon + offset;
-        if (slon < -PI) {
-            slon += TWOPI;
-        } else if (slon > +PI) {
-            slon -= TWOPI;
-        }
-        return slon;
+        return slon + (slon < -PI ? TWOPI : slon > +PI ? -TWOPI : 0.0);
 }
 
-/* Forward projection, ellipsoid */
-FORWARD(e_forward);
-        double lat, lon;
-        double sinlat, coslat;
-        double sinlon, coslon;
-        double q, r, s;
-        double theta, phi;
-        double t, mu, nu;
-        int area;
-
-        /* Convert the geodetic latitude to a geocentric latitude.
-         * This corresponds to the shift from the ellipsoid to the sphere
-         * described in [LK12]. */
-        if (P->es) {
-            lat = atan(P->one_minus_f_squared * tan(lp.phi));
-        } else {
-            lat = lp.phi;
-        }
+/* Forward projection, from the geocentric latitude: the phi and theta
+ * angles used by QSC, and the area. */
+static PJ_INLINE void
+qsc_fwd_face(int face, double lat, double lon, double *phi, double *theta,
+             int *area) {
+        double q = 0.0, r = 0.0, s = 0.0;
 
-        /* Convert the input lat, lon into theta, phi as used by QSC.
-         * This depends on the cube face and the area on it.
-         * For the top and bottom face, we can compute theta and phi
+        /* For the top and bottom face, we can compute theta and phi
          * directly from phi, lam. For the other faces, we must use
          * unit sphere cartesian coordinates as an intermediate step. */
-        lon = lp.lam;
-        if (P->face != FACE_TOP && P->face != FACE_BOTTOM) {
-            if (P->face == FACE_RIGHT) {
+        if (face != FACE_TOP && face != FACE_BOTTOM) {
+            if (face == FACE_RIGHT) {
                 lon = qsc_shift_lon_origin(lon, +HALFPI);
-            } else if (P->face == FACE_BACK) {
+            } else if (face == FACE_BACK) {
                 lon = qsc_shift_lon_origin(lon, +PI);
-            } else if (P->face == FACE_LEFT) {
+            } else if (face == FACE_LEFT) {
                 lon = qsc_shift_lon_origin(lon, -HALFPI);
             }
-            sinlat = sin(lat);
-            coslat = cos(lat);
-            sinlon = sin(lon);
-            coslon = cos(lon);
-            q = coslat * coslon;
-            r = coslat * sinlon;
-            s = sinlat;
+            q = cos(lat) * cos(lon);
+            r = cos(lat) * sin(lon);
+            s = sin(lat);
         }
-        if (P->face == FACE_FRONT) {
-            phi = acos(q);
-            theta = qsc_fwd_equat_face_theta(phi, s, r, &area);
-        } else if (P->face == FACE_RIGHT) {
-            phi = acos(r);
-            theta = qsc_fwd_equat_face_theta(phi, s, -q, &area);
-        } else if (P->face == FACE_BACK) {
-            phi = acos(-q);
-            theta = qsc_fwd_equat_face_theta(phi, s, -r, &area);
-        } else if (P->face == FACE_LEFT) {
-            phi = acos(-r);
-            theta = qsc_fwd_equat_face_theta(phi, s, q, &area);
-        } else if (P->face == FACE_TOP) {
-            phi = HALFPI - lat;
-            if (lon >= FORTPI && lon <= HALFPI + FORTPI) {
-                area = AREA_0;
-                theta = lon - HALFPI;
-            } else if (lon > HALFPI + FORTPI || lon <= -(HALFPI + FORTPI)) {
-                area = AREA_1;
-                theta = (lon > 0.0 ? lon - PI : lon + PI);
-            } else if (lon > -(HALFPI + FORTPI) && lon <= -FORTPI) {
-                area = AREA_2;
-                theta = lon + HALFPI;
-            } else {
-                area = AREA_3;
-                theta = lon;
-            }
-        } else /* P->face == FACE_BOTTOM */ {
-            phi = HALFPI + lat;
-            if (lon >= FORTPI && lon <= HALFPI + FORTPI) {
-                area = AREA_0;
-                theta = -lon + HALFPI;
-            } else if (lon < FORTPI && lon >= -FORTPI) {
-                area = AREA_1;
-                theta = -lon;
-            } else if (lon < -FORTPI && lon >= -(HALFPI + FORTPI)) {
-                area = AREA_2;
-                theta = -lon - HALFPI;
-            } else {
-                area = AREA_3;
-                theta = (lon > 0.0 ? -lon + PI : -lon - PI);
-            }
+        if (face == FACE_FRONT) {
+            *phi = acos(q);
+            *theta = qsc_fwd_equat_face_theta(*phi, s, r, area);
+        } else if (face == FACE_RIGHT) {
+            *phi = acos(r);
+            *theta = qsc_fwd_equat_face_theta(*phi, s, -q, area);
+        } else if (face == FACE_BACK) {
+            *phi = acos(-q);
+            *theta = qsc_fwd_equat_face_theta(*phi, s, -r, area);
+        } else if (face == FACE_LEFT) {
+            *phi = acos(-r);
+            *theta = qsc_fwd_equat_face_theta(*phi, s, q, area);
+        } else if (face == FACE_TOP) {
+            int a0 = lon >= FORTPI && lon <= HALFPI + FORTPI;
+            int a1 = lon > HALFPI + FORTPI || lon <= -(HALFPI + FORTPI);
+            int a2 = lon > -(HALFPI + FORTPI) && lon <= -FORTPI;
+
+            *phi = HALFPI - lat;
+            *area = a0 ? AREA_0 : a1 ? AREA_1 : a2 ? AREA_2 : AREA_3;
+            *theta = a0 ? lon - HALFPI : a1 ? (lon > 0.0 ? lon - PI : lon + PI)
+                     : a2 ? lon + HALFPI : lon;
+        } else /* face == FACE_BOTTOM */ {
+            int a0 = lon >= FORTPI && lon <= HALFPI + FORTPI;
+            int a1 = lon < FORTPI && lon >= -FORTPI;
+            int a2 = lon < -FORTPI && lon >= -(HALFPI + FORTPI);
+
+            *phi = HALFPI + lat;
+            *area = a0 ? AREA_0 : a1 ? AREA_1 : a2 ? AREA_2 : AREA_3;
+            *theta = a0 ? -lon + HALFPI : a1 ? -lon : a2 ? -lon - HALFPI
+                     : (lon > 0.0 ? -lon + PI : -lon - PI);
         }
+}
+
+/* Forward projection, from phi, theta and the area to x, y. */
+static PJ_INLINE XY
+qsc_fwd_xy(double phi, double theta, int area) {
+        XY xy;
+        double mu, t;
 
         /* Compute mu and nu for the area of definition.
          * For mu, see Eq. (3-21) in [OL76], but note the typos:
@@ -195,13 +166,7 @@ FORWARD(e_forward);
         /* nu = atan(t);        We don't really need nu, just t, see below. */
 
         /* Apply the result to the real area. */
-        if (area == AREA_1) {
-            mu += HALFPI;
-        } else if (area == AREA_2) {
-            mu += PI;
-        } else if (area == AREA_3) {
-            mu += HALFPI + PI;
-        }
+        mu += qsc_area_mu[area];
 
         /* Now compute x, y from mu and nu */
         /* t = tan(nu); */
@@ -210,113 +175,105 @@ FORWARD(e_forward);
         return (xy);
 }
 
-/* Inverse projection, ellipsoid */
-INVERSE(e_inverse);
-        double mu, nu, cosmu, tannu;
-        double tantheta, theta, cosphi, phi;
-        double t;
+/* Forward projection, ellipsoid */
+FORWARD_MODAL(e_forward);
+        double lat, phi, theta;
         int area;
 
-        /* Convert the input x, y to the mu and nu angles as used by QSC.
-         * This depends on the area of the cube face. */
-        nu = atan(sqrt(xy.x * xy.x + xy.y * xy.y));
-        mu = atan2(xy.y, xy.x);
-        if (xy.x >= 0.0 && xy.x >= fabs(xy.y)) {
-            area = AREA_0;
-        } else if (xy.y >= 0.0 && xy.y >= fabs(xy.x)) {
-            area = AREA_1;
-            mu -= HALFPI;
-        } else if (xy.x < 0.0 && -xy.x >= fabs(xy.y)) {
-            area = AREA_2;
-            mu = (mu < 0.0 ? mu + PI : mu - PI);
+        (void) xy;
+        /* Convert the geodetic latitude to a geocentric latitude.
+         * This corresponds to the shift from the ellipsoid to the sphere
+         * described in [LK12]. */
+        if (P->es) {
+            lat = atan(P->one_minus_f_squared * tan(lp.phi));
         } else {
-            area = AREA_3;
-            mu += HALFPI;
+            lat = lp.phi;
         }
 
-        /* Compute phi and theta for the area of definition.
-         * The inverse projection is not described in the original paper, but some
+        /* Convert the input lat, lon into theta, phi as used by QSC.
+         * This depends on the cube face and the area on it. */
+        qsc_fwd_face(mode, lat, lp.lam, &phi, &theta, &area);
+        return qsc_fwd_xy(phi, theta, area);
+}
+
+/* Inverse projection: the mu and nu angles used by QSC, and the area. */
+static PJ_INLINE int
+qsc_inv_area(double x, double y, double *mu, double *nu) {
+        int a0 = x >= 0.0 && x >= fabs(y);
+        int a1 = !a0 && y >= 0.0 && y >= fabs(x);
+        int a2 = !a0 && !a1 && x < 0.0 && -x >= fabs(y);
+        double m = atan2(y, x);
+
+        /* Convert the input x, y to the mu and nu angles as used by QSC.
+         * This depends on the area of the cube face. */
+        *nu = atan(sqrt(x * x + y * y));
+        *mu = a0 ? m : a1 ? m - HALFPI : a2 ? (m < 0.0 ? m + PI : m - PI)
+              : m + HALFPI;
+        return (a0 ? AREA_0 : a1 ? AREA_1 : a2 ? AREA_2 : AREA_3);
+}
+
+/* Inverse projection: phi, as its cosine, and theta for the area of
+ * definition. */
+static PJ_INLINE double
+qsc_inv_cosphi(double mu, double nu, double *theta) {
+        double t, tantheta, cosmu, tannu, cosphi;
+
+        /* The inverse projection is not described in the original paper, but some
          * good hints can be found here (as of 2011-12-14):
          * http://fits.gsfc.nasa.gov/fitsbits/saf.93/saf.9302
          * (search for "Message-Id: <9302181759.AA25477 at fits.cv.nrao.edu>") */
         t = (PI / 12.0) * tan(mu);
         tantheta = sin(t) / (cos(t) - (1.0 / sqrt(2.0)));
-        theta = atan(tantheta);
+        *theta = atan(tantheta);
         cosmu = cos(mu);
         tannu = tan(nu);
-        cosphi = 1.0 - cosmu * cosmu * tannu * tannu * (1.0 - cos(atan(1.0 / cos(theta))));
-        if (cosphi < -1.0) {
-            cosphi = -1.0;
-        } else if (cosphi > +1.0) {
-            cosphi = +1.0;
-        }
+        cosphi = 1.0 - cosmu * cosmu * tannu * tannu * (1.0 - cos(atan(1.0 / cos(*theta))));
+        return (cosphi < -1.0 ? -1.0 : cosphi > +1.0 ? +1.0 : cosphi);
+}
+
+/* Inverse projection: apply the result to the real area on the cube
+ * face, giving the geocentric latitude. */
+static PJ_INLINE LP
+qsc_inv_face(int face, double cosphi, double theta, int area) {
+        LP lp;
 
-        /* Apply the result to the real area on the cube face.
-         * For the top and bottom face, we can compute phi and lam directly.
+        /* For the top and bottom face, we can compute phi and lam directly.
          * For the other faces, we must use unit sphere cartesian coordinates
          * as an intermediate step. */
-        if (P->face == FACE_TOP) {
-            phi = acos(cosphi);
-            lp.phi = HALFPI - phi;
-            if (area == AREA_0) {
-                lp.lam = theta + HALFPI;
-            } else if (area == AREA_1) {
-                lp.lam = (theta < 0.0 ? theta + PI : theta - PI);
-            } else if (area == AREA_2) {
-                lp.lam = theta - HALFPI;
-            } else /* area == AREA_3 */ {
-                lp.lam = theta;
-            }
-        } else if (P->face == FACE_BOTTOM) {
-            phi = acos(cosphi);
-            lp.phi = phi - HALFPI;
-            if (area == AREA_0) {
-                lp.lam = -theta + HALFPI;
-            } else if (area == AREA_1) {
-                lp.lam = -theta;
-            } else if (area == AREA_2) {
-                lp.lam = -theta - HALFPI;
-            } else /* area == AREA_3 */ {
-                lp.lam = (theta < 0.0 ? -theta - PI : -theta + PI);
-            }
+        if (face == FACE_TOP) {
+            lp.phi = HALFPI - acos(cosphi);
+            lp.lam = area == AREA_0 ? theta + HALFPI
+                     : area == AREA_1 ? (theta < 0.0 ? theta + PI : theta - PI)
+                     : area == AREA_2 ? theta - HALFPI : theta;
+        } else if (face == FACE_BOTTOM) {
+            lp.phi = acos(cosphi) - HALFPI;
+            lp.lam = area == AREA_0 ? -theta + HALFPI
+                     : area == AREA_1 ? -theta
+                     : area == AREA_2 ? -theta - HALFPI
+                     : (theta < 0.0 ? -theta - PI : -theta + PI);
         } else {
             /* Compute phi and lam via cartesian unit sphere coordinates. */
-            double q, r, s, t;
+            double q, r, s, t, u;
             q = cosphi;
             t = q * q;
-            if (t >= 1.0) {
-                s = 0.0;
-            } else {
-                s = sqrt(1.0 - t) * sin(theta);
-            }
+            s = t >= 1.0 ? 0.0 : sqrt(1.0 - t) * sin(theta);
             t += s * s;
-            if (t >= 1.0) {
-                r = 0.0;
-            } else {
-                r = sqrt(1.0 - t);
-            }
+            r = t >= 1.0 ? 0.0 : sqrt(1.0 - t);
             /* Rotate q,r,s into the correct area. */
-            if (area == AREA_1) {
-                t = r;
-                r = -s;
-                s = t;
-            } else if (area == AREA_2) {
-                r = -r;
-                s = -s;
-            } else if (area == AREA_3) {
-                t = r;
-                r = s;
-                s = -t;
-            }
+            u = r;
+            r = area == AREA_1 ? -s : area == AREA_2 ? -u
+                : area == AREA_3 ? s : u;
+            s = area == AREA_1 ? u : area == AREA_2 ? -s
+                : area == AREA_3 ? -u : s;
             /* Rotate q,r,s into the correct cube face. */
-            if (P->face == FACE_RIGHT) {
+            if (face == FACE_RIGHT) {
                 t = q;
                 q = -r;
                 r = t;
-            } else if (P->face == FACE_BACK) {
+            } else if (face == FACE_BACK) {
                 q = -q;
                 r = -r;
-            } else if (P->face == FACE_LEFT) {
+            } else if (face == FACE_LEFT) {
                 t = q;
                 q = r;
                 r = -t;
@@ -324,34 +281,140 @@ INVERSE(e_inverse);
             /* Now compute phi and lam from the unit sphere coordinates. */
             lp.phi = acos(-s) - HALFPI;
             lp.lam = atan2(r, q);
-            if (P->face == FACE_RIGHT) {
+            if (face == FACE_RIGHT) {
                 lp.lam = qsc_shift_lon_origin(lp.lam, -HALFPI);
-            } else if (P->face == FACE_BACK) {
+            } else if (face == FACE_BACK) {
                 lp.lam = qsc_shift_lon_origin(lp.lam, -PI);
-            } else if (P->face == FACE_LEFT) {
+            } else if (face == FACE_LEFT) {
                 lp.lam = qsc_shift_lon_origin(lp.lam, +HALFPI);
             }
         }
+        return (lp);
+}
+
+/* Apply the shift from the sphere to the ellipsoid as described
+ * in [LK12]. */
+static PJ_INLINE double
+qsc_inv_geodetic(PJ *P, double phi) {
+        int invert_sign = (phi < 0.0 ? 1 : 0);
+        double tanphi = tan(phi);
+        double xa = P->b / sqrt(tanphi * tanphi + P->one_minus_f_squared);
+
+        phi = atan(sqrt(P->a * P->a - xa * xa) / (P->one_minus_f * xa));
+        return (invert_sign ? -phi : phi);
+}
+
+/* Inverse projection, ellipsoid */
+INVERSE_MODAL(e_inverse);
+        double mu, nu, theta, cosphi;
+        int area;
 
-        /* Apply the shift from the sphere to the ellipsoid as described
-         * in [LK12]. */
+        area = qsc_inv_area(xy.x, xy.y, &mu, &nu);
+        cosphi = qsc_inv_cosphi(mu, nu, &theta);
+        lp = qsc_inv_face(mode, cosphi, theta, area);
         if (P->es) {
-            int invert_sign;
-            double tanphi, xa;
-            invert_sign = (lp.phi < 0.0 ? 1 : 0);
-            tanphi = tan(lp.phi);
-            xa = P->b / sqrt(tanphi * tanphi + P->one_minus_f_squared);
-            lp.phi = atan(sqrt(P->a * P->a - xa * xa) / (P->one_minus_f * xa));
-            if (invert_sign) {
-                lp.phi = -lp.phi;
-            }
+            lp.phi = qsc_inv_geodetic(P, lp.phi);
         }
         return (lp);
 }
+
+/* Forward projection of a run of points at a time, each step done for
+ * all of them before the next.  The failed points are taken through
+ * the steps as 0, 0 and left alone. */
+static PJ_INLINE int
+e_forward_run(PJ *P, long n, int stride, double *x, double *y, int face) {
+        double lat[PJ_ARRAY_RUN], lon[PJ_ARRAY_RUN];
+        double phi[PJ_ARRAY_RUN], theta[PJ_ARRAY_RUN];
+        int area[PJ_ARRAY_RUN];
+        long i0, io, j, m;
+
+        for (i0 = 0; i0 < n; i0 += PJ_ARRAY_RUN) {
+            m = n - i0 < PJ_ARRAY_RUN ? n - i0 : PJ_ARRAY_RUN;
+            for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+                int live = x[io] != HUGE_VAL;
+                lon[j] = live ? x[io] : 0.0;
+                lat[j] = live ? y[io] : 0.0;
+            }
+            if (P->es) {
+                for (j = 0; j < m; ++j) {
+                    lat[j] = atan(P->one_minus_f_squared * tan(lat[j]));
+                }
+            }
+            for (j = 0; j < m; ++j) {
+                qsc_fwd_face(face, lat[j], lon[j], phi + j, theta + j,
+                             area + j);
+            }
+            for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+                XY xy = qsc_fwd_xy(phi[j], theta[j], area[j]);
+                if (x[io] != HUGE_VAL) {
+                    x[io] = xy.x;
+                    y[io] = xy.y;
+                }
+            }
+        }
+        return 0;
+}
+
+/* Inverse projection of a run of points at a time, as e_forward_run() */
+static PJ_INLINE int
+e_inverse_run(PJ *P, long n, int stride, double *x, double *y, int face) {
+        double mu[PJ_ARRAY_RUN], nu[PJ_ARRAY_RUN];
+        double cosphi[PJ_ARRAY_RUN], theta[PJ_ARRAY_RUN];
+        int area[PJ_ARRAY_RUN];
+        long i0, io, j, m;
+
+        for (i0 = 0; i0 < n; i0 += PJ_ARRAY_RUN) {
+            m = n - i0 < PJ_ARRAY_RUN ? n - i0 : PJ_ARRAY_RUN;
+            for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+                int live = x[io] != HUGE_VAL;
+                area[j] = qsc_inv_area(live ? x[io] : 0.0,
+                                       live ? y[io] : 0.0, mu + j, nu + j);
+            }
+            for (j = 0; j < m; ++j) {
+                cosphi[j] = qsc_inv_cosphi(mu[j], nu[j], theta + j);
+            }
+            for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+                LP lp = qsc_inv_face(face, cosphi[j], theta[j], area[j]);
+                if (x[io] != HUGE_VAL) {
+                    x[io] = lp.lam;
+                    y[io] = lp.phi;
+                }
+            }
+            if (P->es) {
+                for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+                    if (x[io] != HUGE_VAL) {
+                        y[io] = qsc_inv_geodetic(P, y[io]);
+                    }
+                }
+            }
+        }
+        return 0;
+}
+
+/* The kernels of one face. */
+#define QSC_FACE_KERNELS(fwd, inv, face) \
+static XY fwd(LP lp, PJ *P) { return e_forward(lp, P, face); } \
+static LP inv(XY xy, PJ *P) { return e_inverse(xy, P, face); } \
+static int fwd##_n(PJ *P, long n, int stride, double *x, double *y) { \
+        return e_forward_run(P, n, stride, x, y, face); } \
+static int inv##_n(PJ *P, long n, int stride, double *x, double *y) { \
+        return e_inverse_run(P, n, stride, x, y, face); }
+QSC_FACE_KERNELS(e_forward_front, e_inverse_front, FACE_FRONT)
+QSC_FACE_KERNELS(e_forward_right, e_inverse_right, FACE_RIGHT)
+QSC_FACE_KERNELS(e_forward_back, e_inverse_back, FACE_BACK)
+QSC_FACE_KERNELS(e_forward_left, e_inverse_left, FACE_LEFT)
+QSC_FACE_KERNELS(e_forward_top, e_inverse_top, FACE_TOP)
+QSC_FACE_KERNELS(e_forward_bottom, e_inverse_bottom, FACE_BOTTOM)
+static const struct PJ_KERNELS qsc_kernels[] = { /* by face */
+        MODE_KERNELS(e_forward_front, e_inverse_front),
+        MODE_KERNELS(e_forward_right, e_inverse_right),
+        MODE_KERNELS(e_forward_back, e_inverse_back),
+        MODE_KERNELS(e_forward_left, e_inverse_left),
+        MODE_KERNELS(e_forward_top, e_inverse_top),
+        MODE_KERNELS(e_forward_bottom, e_inverse_bottom)
+};
 FREEUP; if (P) pj_dalloc(P); }
 ENTRY0(qsc)
-        P->inv = e_inverse;
-        P->fwd = e_forward;
         /* Determine the cube face from the center of projection. */
         if (P->phi0 >= HALFPI - FORTPI / 2.0) {
             P->face = FACE_TOP;
@@ -364,6 +427,7 @@ ENTRY0(qsc)
         } else {
             P->face = FACE_BACK;
         }
+        SET_KERNELS(P, qsc_kernels[P->face]);
         /* Fill in useful values for the ellipsoid <-> sphere shift
          * described in [LK12]. */
         if (P->es) {
@@ -1,8 +1,16 @@
+#define NODES	18
+#define PROJ_PARMS__ \
+	double	cx[4][NODES + 1]; \
+	double	cy[4][NODES + 1]; \
+	double	ci[4][NODES];
 #define PJ_LIB__
 #include	<projects.h>
 PROJ_HEAD(robin, "Robinson") "\n\tPCyl., Sph.";
 #define V(C,z) (C.c0 + z * (C.c1 + z * (C.c2 + z * C.c3)))
 #define DV(C,z) (C.c1 + z * (C.c2 + C.c2 + z * 3. * C.c3))
+	/* the same, on the tables of the PJ */
+#define VT(C,i,z) (C[0][i] + z * (C[1][i] + z * (C[2][i] + z * C[3][i])))
+#define DVT(C,i,z) (C[1][i] + z * (C[2][i] + C[2][i] + z * 3. * C[3][i]))
 
 /* 
 note: following terms based upon 5 deg. intervals in degrees.
@@ -63,7 +71,6 @@ static const struct COEFS Y[] = {
 #define FYC	1.3523
 #define C1	11.45915590261646417544
 #define RC1	0.08726646259971647884
-#define NODES	18
 #define ONEEPS	1.000001
 #define EPS	1e-8
 FORWARD(s_forward); /* spheroid */
@@ -73,15 +80,14 @@ FORWARD(s_forward); /* spheroid */
 	i = floor((dphi = fabs(lp.phi)) * C1);
 	if (i >= NODES) i = NODES - 1;
 	dphi = RAD_TO_DEG * (dphi - RC1 * i);
-	xy.x = V(X[i], dphi) * FXC * lp.lam;
-	xy.y = V(Y[i], dphi) * FYC;
+	xy.x = VT(P->cx, i, dphi) * FXC * lp.lam;
+	xy.y = VT(P->cy, i, dphi) * FYC;
 	if (lp.phi < 0.) xy.y = -xy.y;
 	return (xy);
 }
 INVERSE(s_inverse); /* spheroid */
 	int i;
-	double t, t1;
-	struct COEFS T;
+	double t, t1, c0;
 
 	lp.lam = xy.x / FXC;
 	lp.phi = fabs(xy.y / FYC);
@@ -89,30 +95,78 @@ INVERSE(s_inverse); /* spheroid */
 		if (lp.phi > ONEEPS) I_ERROR
 		else {
 			lp.phi = xy.y < 0. ? -HALFPI : HALFPI;
-			lp.lam /= X[NODES].c0;
+			lp.lam /= P->cx[0][NODES];
 		}
 	} else { /* general problem */
 		/* in Y space, reduce to table interval */
 		for (i = floor(lp.phi * NODES);;) {
-			if (Y[i].c0 > lp.phi) --i;
-			else if (Y[i+1].c0 <= lp.phi) ++i;
+			if (P->cy[0][i] > lp.phi) --i;
+			else if (P->cy[0][i+1] <= lp.phi) ++i;
 			else break;
 		}
-		T = Y[i];
-		/* first guess, linear interp */
-		t = 5. * (lp.phi - T.c0)/(Y[i+1].c0 - T.c0);
+		/* first guess, from the inverse cubic of the interval */
+		t = (lp.phi - P->cy[0][i])/(P->cy[0][i+1] - P->cy[0][i]);
+		t = VT(P->ci, i, t);
 		/* make into root */
-		T.c0 -= lp.phi;
+		c0 = P->cy[0][i] - lp.phi;
 		for (;;) { /* Newton-Raphson reduction */
-			t -= t1 = V(T,t) / DV(T,t);
+			t -= t1 = (c0 + t * (P->cy[1][i] + t * (P->cy[2][i] +
+				t * P->cy[3][i]))) / DVT(P->cy, i, t);
 			if (fabs(t1) < EPS)
 				break;
 		}
 		lp.phi = (5 * i + t) * DEG_TO_RAD;
 		if (xy.y < 0.) lp.phi = -lp.phi;
-		lp.lam /= V(X[i], t);
+		lp.lam /= VT(P->cx, i, t);
 	}
 	return (lp);
 }
+	static int /* s_forward() of n points, without the calls */
+s_forward_n(PJ *P, long n, int stride, double *x, double *y) {
+	long j;
+
+	for (j = 0; j < n; j++) {
+		long io = j * stride;
+		int i;
+		double dphi;
+
+		if (x[io] == HUGE_VAL)
+			continue;
+		i = floor((dphi = fabs(y[io])) * C1);
+		if (i >= NODES) i = NODES - 1;
+		dphi = RAD_TO_DEG * (dphi - RC1 * i);
+		x[io] = VT(P->cx, i, dphi) * FXC * x[io];
+		dphi = VT(P->cy, i, dphi) * FYC;
+		y[io] = y[io] < 0. ? -dphi : dphi;
+	}
+	return 0;
+}
+INVERSE_ARRAY(s_inverse_n, s_inverse)
 FREEUP; if (P) pj_dalloc(P); }
-ENTRY0(robin) P->es = 0.; P->inv = s_inverse; P->fwd = s_forward; ENDENTRY(P)
+ENTRY0(robin)
+	int i;
+
+	/* the tables as doubles, arranged by coefficient */
+	for (i = 0; i <= NODES; ++i) {
+		P->cx[0][i] = X[i].c0; P->cx[1][i] = X[i].c1;
+		P->cx[2][i] = X[i].c2; P->cx[3][i] = X[i].c3;
+		P->cy[0][i] = Y[i].c0; P->cy[1][i] = Y[i].c1;
+		P->cy[2][i] = Y[i].c2; P->cy[3][i] = Y[i].c3;
+	}
+	/* Hermite cubic of t over the fraction of each Y interval */
+	for (i = 0; i < NODES; ++i) {
+		double dy = Y[i+1].c0 - Y[i].c0, m0, m1;
+
+		m0 = dy / DV(Y[i], 0.);
+		m1 = dy / DV(Y[i], 5.);
+		P->ci[0][i] = 0.;
+		P->ci[1][i] = m0;
+		P->ci[2][i] = 15. - 2. * m0 - m1;
+		P->ci[3][i] = m0 + m1 - 10.;
+	}
+	P->es = 0.;
+	P->inv = s_inverse;
+	P->fwd = s_forward;
+	P->inv_n = s_inverse_n;
+	P->fwd_n = s_forward_n;
+ENDENTRY(P)
@@ -2,6 +2,7 @@
 	double	K, c, hlf_e, kR, cosp0, sinp0;
 #define PJ_LIB__
 #include	<projects.h>
+#include	<pj_math.h>
 PROJ_HEAD(somerc, "Swiss. Obl. Mercator") "\n\tCyl, Ell\n\tFor CH1903";
 #define EPS	1.e-10
 #define NITER 6
@@ -14,8 +15,8 @@ FORWARD(e_forward);
 		+ P->K)) - HALFPI;
 	lamp = P->c * lp.lam;
 	cp = cos(phip);
-	phipp = aasin(P->ctx,P->cosp0 * sin(phip) - P->sinp0 * cp * cos(lamp));
-	lampp = aasin(P->ctx,cp * sin(lamp) / cos(phipp));
+	phipp = pj_aasin_i(P->ctx,P->cosp0 * sin(phip) - P->sinp0 * cp * cos(lamp));
+	lampp = pj_aasin_i(P->ctx,cp * sin(lamp) / cos(phipp));
 	xy.x = P->kR * lampp;
 	xy.y = P->kR * log(tan(FORTPI + 0.5 * phipp));
 	return (xy);
@@ -27,8 +28,8 @@ INVERSE(e_inverse); /* ellipsoid & spheroid */
 	phipp = 2. * (atan(exp(xy.y / P->kR)) - FORTPI);
 	lampp = xy.x / P->kR;
 	cp = cos(phipp);
-	phip = aasin(P->ctx,P->cosp0 * sin(phipp) + P->sinp0 * cp * cos(lampp));
-	lamp = aasin(P->ctx,cp * sin(lampp) / cos(phip));
+	phip = pj_aasin_i(P->ctx,P->cosp0 * sin(phipp) + P->sinp0 * cp * cos(lampp));
+	lamp = pj_aasin_i(P->ctx,cp * sin(lampp) / cos(phip));
 	con = (P->K - log(tan(FORTPI + 0.5 * phip)))/P->c;
 	for (i = NITER; i ; --i) {
 		esp = P->e * sin(phip);
@@ -55,7 +56,7 @@ ENTRY0(somerc)
 	cp *= cp;
 	P->c = sqrt(1 + P->es * cp * cp * P->rone_es);
 	sp = sin(P->phi0);
-	P->cosp0 = cos( phip0 = aasin(P->ctx, P->sinp0 = sp / P->c) );
+	P->cosp0 = cos( phip0 = pj_aasin_i(P->ctx, P->sinp0 = sp / P->c) );
 	sp *= P->e;
 	P->K = log(tan(FORTPI + 0.5 * phip0)) - P->c * (
 		log(tan(FORTPI + 0.5 * P->phi0)) - P->hlf_e *
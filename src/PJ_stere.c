@@ -6,6 +6,7 @@
 	int	mode;
 #define PJ_LIB__
 #include	<projects.h>
+#include	<pj_math.h>
 PROJ_HEAD(stere, "Stereographic") "\n\tAzi, Sph&Ell\n\tlat_ts=";
 PROJ_HEAD(ups, "Universal Polar Stereographic") "\n\tAzi, Sph&Ell\n\tsouth";
 #define sinph0	P->sinX1
@@ -24,17 +25,16 @@ ssfn_(double phit, double sinphi, double eccen) {
 	return (tan (.5 * (HALFPI + phit)) *
 	   pow((1. - sinphi) / (1. + sinphi), .5 * eccen));
 }
-FORWARD(e_forward); /* ellipsoid */
+FORWARD_MODAL(e_forward); /* ellipsoid */
 	double coslam, sinlam, sinX=0.0, cosX=0.0, X, A, sinphi;
 
-	coslam = cos(lp.lam);
-	sinlam = sin(lp.lam);
+	pj_sincos(lp.lam, &sinlam, &coslam);
 	sinphi = sin(lp.phi);
-	if (P->mode == OBLIQ || P->mode == EQUIT) {
-		sinX = sin(X = 2. * atan(ssfn_(lp.phi, sinphi, P->e)) - HALFPI);
-		cosX = cos(X);
+	if (mode == OBLIQ || mode == EQUIT) {
+		pj_sincos(X = 2. * atan(ssfn_(lp.phi, sinphi, P->e)) - HALFPI,
+			&sinX, &cosX);
 	}
-	switch (P->mode) {
+	switch (mode) {
 	case OBLIQ:
 		A = P->akm1 / (P->cosX1 * (1. + P->sinX1 * sinX +
 		   P->cosX1 * cosX * coslam));
@@ -51,21 +51,19 @@ xmul:
 		coslam = - coslam;
 		sinphi = -sinphi;
 	case N_POLE:
-		xy.x = P->akm1 * pj_tsfn(lp.phi, sinphi, P->e);
+		xy.x = P->akm1 * pj_tsfn_i(lp.phi, sinphi, P->e);
 		xy.y = - xy.x * coslam;
 		break;
 	}
 	xy.x = xy.x * sinlam;
 	return (xy);
 }
-FORWARD(s_forward); /* spheroid */
+FORWARD_MODAL(s_forward); /* spheroid */
 	double  sinphi, cosphi, coslam, sinlam;
 
-	sinphi = sin(lp.phi);
-	cosphi = cos(lp.phi);
-	coslam = cos(lp.lam);
-	sinlam = sin(lp.lam);
-	switch (P->mode) {
+	pj_sincos(lp.phi, &sinphi, &cosphi);
+	pj_sincos(lp.lam, &sinlam, &coslam);
+	switch (mode) {
 	case EQUIT:
 		xy.y = 1. + cosphi * coslam;
 		goto oblcon;
@@ -74,7 +72,7 @@ FORWARD(s_forward); /* spheroid */
 oblcon:
 		if (xy.y <= EPS10) F_ERROR;
 		xy.x = (xy.y = P->akm1 / xy.y) * cosphi * sinlam;
-		xy.y *= (P->mode == EQUIT) ? sinphi :
+		xy.y *= (mode == EQUIT) ? sinphi :
 		   cosph0 * sinphi - sinph0 * cosphi * coslam;
 		break;
 	case N_POLE:
@@ -88,12 +86,90 @@ oblcon:
 	}
 	return (xy);
 }
-INVERSE(e_inverse); /* ellipsoid */
+SPECIAL(s_fac_obliq) { /* spheroid, oblique and equatorial */
+	double sinphi, cosphi, sinlam, coslam, s0, c0, d, f, df, dl, dp, n;
+
+	if (P->mode == EQUIT) {
+		s0 = 0.;
+		c0 = 1.;
+	} else {
+		s0 = sinph0;
+		c0 = cosph0;
+	}
+	sinphi = sin(lp.phi);
+	cosphi = cos(lp.phi);
+	sinlam = sin(lp.lam);
+	coslam = cos(lp.lam);
+	if ((d = 1. + s0 * sinphi + c0 * cosphi * coslam) <= EPS10)
+		return;
+	f = P->akm1 / d; /* x = f cosphi sinlam, y = f n */
+	df = - f / d;
+	dl = - c0 * cosphi * sinlam;
+	dp = s0 * cosphi - c0 * sinphi * coslam;
+	n = c0 * sinphi - s0 * cosphi * coslam;
+	fac->code |= IS_ANAL_XL_YL + IS_ANAL_XP_YP;
+	fac->der.x_l = f * cosphi * coslam + cosphi * sinlam * df * dl;
+	fac->der.x_p = f * sinphi * sinlam - cosphi * sinlam * df * dp;
+	fac->der.y_l = - f * s0 * cosphi * sinlam - n * df * dl;
+	fac->der.y_p = f * (c0 * cosphi + s0 * sinphi * coslam) + n * df * dp;
+}
+SPECIAL(e_fac) { /* ellipsoid */
+	double coslam, sinlam, sinX, cosX, s0, c0, A, dA, sinphi, r;
+
+	coslam = cos(lp.lam);
+	sinlam = sin(lp.lam);
+	sinphi = sin(lp.phi);
+	switch (P->mode) {
+	case OBLIQ:
+	case EQUIT:
+		sinX = sin(A = 2. * atan(ssfn_(lp.phi, sinphi, P->e)) - HALFPI);
+		cosX = cos(A);
+		if (P->mode == OBLIQ) {
+			s0 = P->sinX1;
+			c0 = P->cosX1;
+			A = P->akm1 / P->cosX1;
+		} else {
+			s0 = 0.;
+			c0 = 1.;
+			A = 2. * P->akm1;
+		}
+		if ((r = 1. + s0 * sinX + c0 * cosX * coslam) <= EPS10)
+			return;
+		A /= r;
+		dA = A * c0 * cosX * sinlam / r;
+		pj_conformal_der(lp, P, A * cosX * coslam + dA * cosX * sinlam,
+			A * s0 * cosX * sinlam +
+			dA * (c0 * sinX - s0 * cosX * coslam), fac);
+		break;
+	case S_POLE:
+		r = P->akm1 * pj_tsfn_i(-lp.phi, -sinphi, P->e);
+		pj_conformal_der(lp, P, r * coslam, - r * sinlam, fac);
+		break;
+	case N_POLE:
+		r = P->akm1 * pj_tsfn_i(lp.phi, sinphi, P->e);
+		pj_conformal_der(lp, P, r * coslam, r * sinlam, fac);
+		break;
+	}
+}
+SPECIAL(s_fac) { /* spheroid, polar */
+	double r;
+
+	if (P->mode == N_POLE) {
+		if (fabs(lp.phi + HALFPI) < TOL) return;
+		r = P->akm1 * tan(FORTPI - .5 * lp.phi);
+		pj_conformal_der(lp, P, r * cos(lp.lam), r * sin(lp.lam), fac);
+	} else {
+		if (fabs(lp.phi - HALFPI) < TOL) return;
+		r = P->akm1 * tan(FORTPI + .5 * lp.phi);
+		pj_conformal_der(lp, P, r * cos(lp.lam), - r * sin(lp.lam), fac);
+	}
+}
+INVERSE_MODAL(e_inverse); /* ellipsoid */
 	double cosphi, sinphi, tp=0.0, phi_l=0.0, rho, halfe=0.0, halfpi=0.0;
 	int i;
 
 	rho = hypot(xy.x, xy.y);
-	switch (P->mode) {
+	switch (mode) {
 	case OBLIQ:
 	case EQUIT:
 		cosphi = cos( tp = 2. * atan2(rho * P->cosX1 , P->akm1) );
@@ -122,7 +198,7 @@ INVERSE(e_inverse); /* ellipsoid */
 		lp.phi = 2. * atan(tp * pow((1.+sinphi)/(1.-sinphi),
 		   halfe)) - halfpi;
 		if (fabs(phi_l - lp.phi) < CONV) {
-			if (P->mode == S_POLE)
+			if (mode == S_POLE)
 				lp.phi = -lp.phi;
 			lp.lam = (xy.x == 0. && xy.y == 0.) ? 0. : atan2(xy.x, xy.y);
 			return (lp);
@@ -130,13 +206,13 @@ INVERSE(e_inverse); /* ellipsoid */
 	}
 	I_ERROR;
 }
-INVERSE(s_inverse); /* spheroid */
+INVERSE_MODAL(s_inverse); /* spheroid */
 	double  c, rh, sinc, cosc;
 
 	sinc = sin(c = 2. * atan((rh = hypot(xy.x, xy.y)) / P->akm1));
 	cosc = cos(c);
 	lp.lam = 0.;
-	switch (P->mode) {
+	switch (mode) {
 	case EQUIT:
 		if (fabs(rh) <= EPS10)
 			lp.phi = 0.;
@@ -159,12 +235,40 @@ INVERSE(s_inverse); /* spheroid */
 		if (fabs(rh) <= EPS10)
 			lp.phi = P->phi0;
 		else
-			lp.phi = asin(P->mode == S_POLE ? - cosc : cosc);
+			lp.phi = asin(mode == S_POLE ? - cosc : cosc);
 		lp.lam = (xy.x == 0. && xy.y == 0.) ? 0. : atan2(xy.x, xy.y);
 		break;
 	}
 	return (lp);
 }
+FORWARD_MODE(e_forward_spole, e_forward, S_POLE)
+FORWARD_MODE(e_forward_npole, e_forward, N_POLE)
+FORWARD_MODE(e_forward_obliq, e_forward, OBLIQ)
+FORWARD_MODE(e_forward_equit, e_forward, EQUIT)
+INVERSE_MODE(e_inverse_spole, e_inverse, S_POLE)
+INVERSE_MODE(e_inverse_npole, e_inverse, N_POLE)
+INVERSE_MODE(e_inverse_obliq, e_inverse, OBLIQ)
+INVERSE_MODE(e_inverse_equit, e_inverse, EQUIT)
+FORWARD_MODE(s_forward_spole, s_forward, S_POLE)
+FORWARD_MODE(s_forward_npole, s_forward, N_POLE)
+FORWARD_MODE(s_forward_obliq, s_forward, OBLIQ)
+FORWARD_MODE(s_forward_equit, s_forward, EQUIT)
+INVERSE_MODE(s_inverse_spole, s_inverse, S_POLE)
+INVERSE_MODE(s_inverse_npole, s_inverse, N_POLE)
+INVERSE_MODE(s_inverse_obliq, s_inverse, OBLIQ)
+INVERSE_MODE(s_inverse_equit, s_inverse, EQUIT)
+static const struct PJ_KERNELS e_kernels[] = { /* by mode */
+	MODE_KERNELS(e_forward_spole, e_inverse_spole),
+	MODE_KERNELS(e_forward_npole, e_inverse_npole),
+	MODE_KERNELS(e_forward_obliq, e_inverse_obliq),
+	MODE_KERNELS(e_forward_equit, e_inverse_equit)
+};
+static const struct PJ_KERNELS s_kernels[] = {
+	MODE_KERNELS(s_forward_spole, s_inverse_spole),
+	MODE_KERNELS(s_forward_npole, s_inverse_npole),
+	MODE_KERNELS(s_forward_obliq, s_inverse_obliq),
+	MODE_KERNELS(s_forward_equit, s_inverse_equit)
+};
 FREEUP; if (P) pj_dalloc(P); }
 	static PJ *
 setup(PJ *P) { /* general initialization */
@@ -186,7 +290,7 @@ setup(PJ *P) { /* general initialization */
 				   sqrt(pow(1+P->e,1+P->e)*pow(1-P->e,1-P->e));
 			else {
 				P->akm1 = cos(P->phits) /
-				   pj_tsfn(P->phits, t = sin(P->phits), P->e);
+				   pj_tsfn_i(P->phits, t = sin(P->phits), P->e);
 				t *= P->e;
 				P->akm1 /= sqrt(1. - t * t);
 			}
@@ -201,8 +305,8 @@ setup(PJ *P) { /* general initialization */
 			P->cosX1 = cos(X);
 			break;
 		}
-		P->inv = e_inverse;
-		P->fwd = e_forward;
+		SET_KERNELS(P, e_kernels[P->mode]);
+		P->spc = e_fac;
 	} else {
 		switch (P->mode) {
 		case OBLIQ:
@@ -218,8 +322,8 @@ setup(PJ *P) { /* general initialization */
 			   2. * P->k0 ;
 			break;
 		}
-		P->inv = s_inverse;
-		P->fwd = s_forward;
+		SET_KERNELS(P, s_kernels[P->mode]);
+		P->spc = P->mode == OBLIQ || P->mode == EQUIT ? s_fac_obliq : s_fac;
 	}
 	return P;
 }
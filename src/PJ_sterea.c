@@ -29,6 +29,7 @@ LIBPROJ_ID[] = "$Id$";
 	double phic0; \
 	double cosc0, sinc0; \
 	double R2; \
+	double C; \
 	void *en;
 
 #define PJ_LIB__
@@ -51,6 +52,23 @@ FORWARD(e_forward); /* ellipsoid */
 	xy.y = k * (P->cosc0 * sinc - P->sinc0 * cosc * cosl);
 	return (xy);
 }
+SPECIAL(e_fac) { /* ellipsoid */
+	double cosc, sinc, cosl, sinl, d, k, dk;
+	LP slp = pj_gauss(P->ctx, lp, P->en);
+
+	sinc = sin(slp.phi);
+	cosc = cos(slp.phi);
+	cosl = cos(slp.lam);
+	sinl = sin(slp.lam);
+	if ((d = 1. + P->sinc0 * sinc + P->cosc0 * cosc * cosl) <= DEL_TOL)
+		return;
+	k = P->k0 * P->R2 / d;
+	dk = k * P->cosc0 * cosc * sinl / d;
+	/* the gaussian longitude is C lam */
+	pj_conformal_der(lp, P, P->C * (k * cosc * cosl + dk * cosc * sinl),
+		P->C * (k * P->sinc0 * cosc * sinl +
+		dk * (P->cosc0 * sinc - P->sinc0 * cosc * cosl)), fac);
+}
 INVERSE(e_inverse); /* ellipsoid */
 	double rho, c, sinc, cosc;
 
@@ -68,6 +86,50 @@ INVERSE(e_inverse); /* ellipsoid */
 		lp.lam = 0.;
 	}
 	return(pj_inv_gauss(P->ctx, lp, P->en));
+}
+	static int /* ellipsoid, the points on the gaussian sphere at once */
+e_forward_n(PJ *P, long n, int stride, double *x, double *y) {
+	long i, io;
+
+	pj_gauss_array(P->ctx, n, stride, x, y, P->en);
+	for (i = io = 0; i < n; ++i, io += stride) {
+		double cosc, sinc, cosl, k;
+
+		if (x[io] == HUGE_VAL)
+			continue;
+		sinc = sin(y[io]);
+		cosc = cos(y[io]);
+		cosl = cos(x[io]);
+		k = P->k0 * P->R2 / (1. + P->sinc0 * sinc + P->cosc0 * cosc * cosl);
+		x[io] = k * cosc * sin(x[io]);
+		y[io] = k * (P->cosc0 * sinc - P->sinc0 * cosc * cosl);
+	}
+	return 0;
+}
+	static int /* ellipsoid */
+e_inverse_n(PJ *P, long n, int stride, double *x, double *y) {
+	long i, io;
+
+	for (i = io = 0; i < n; ++i, io += stride) {
+		double rho, c, sinc, cosc, u, v;
+
+		if (x[io] == HUGE_VAL)
+			continue;
+		u = x[io] / P->k0;
+		v = y[io] / P->k0;
+		if((rho = hypot(u, v))) {
+			c = 2. * atan2(rho, P->R2);
+			sinc = sin(c);
+			cosc = cos(c);
+			y[io] = asin(cosc * P->sinc0 + v * sinc * P->cosc0 / rho);
+			x[io] = atan2(u * sinc, rho * P->cosc0 * cosc -
+				v * P->sinc0 * sinc);
+		} else {
+			y[io] = P->phic0;
+			x[io] = 0.;
+		}
+	}
+	return pj_inv_gauss_array(P->ctx, n, stride, x, y, P->en);
 }
 FREEUP; if (P) { if (P->en) free(P->en); free(P); } }
 ENTRYA(sterea)
@@ -80,6 +142,11 @@ ENTRYX
 	P->sinc0 = sin(P->phic0);
 	P->cosc0 = cos(P->phic0);
 	P->R2 = 2. * R;
+	R = cos(P->phi0); R *= R; /* as in pj_gauss_ini() */
+	P->C = sqrt(1. + P->es * R * R / P->one_es);
 	P->inv = e_inverse;
 	P->fwd = e_forward;
+	P->inv_n = e_inverse_n;
+	P->fwd_n = e_forward_n;
+	P->spc = e_fac;
 ENDENTRY(P)
@@ -4,6 +4,7 @@
 	double	*en;
 #define PJ_LIB__
 #include	<projects.h>
+#include	<pj_math.h>
 PROJ_HEAD(tmerc, "Transverse Mercator") "\n\tCyl, Sph&Ell";
 PROJ_HEAD(utm, "Universal Transverse Mercator (UTM)")
 	"\n\tCyl, Sph\n\tzone= south";
@@ -36,7 +37,7 @@ FORWARD(e_forward); /* ellipse */
             return xy;
         }
 
-	sinphi = sin(lp.phi); cosphi = cos(lp.phi);
+	pj_sincos(lp.phi, &sinphi, &cosphi);
 	t = fabs(cosphi) > 1e-10 ? sinphi/cosphi : 0.;
 	t *= t;
 	al = cosphi * lp.lam;
@@ -48,7 +49,7 @@ FORWARD(e_forward); /* ellipse */
 		FC5 * als * (5. + t * (t - 18.) + n * (14. - 58. * t)
 		+ FC7 * als * (61. + t * ( t * (179. - t) - 479. ) )
 		)));
-	xy.y = P->k0 * (pj_mlfn(lp.phi, sinphi, cosphi, P->en) - P->ml0 +
+	xy.y = P->k0 * (pj_mlfn_i(lp.phi, sinphi, cosphi, P->en) - P->ml0 +
 		sinphi * al * lp.lam * FC2 * ( 1. +
 		FC4 * als * (5. - t + n * (9. + 4. * n) +
 		FC6 * als * (61. + t * (t - 58.) + n * (270. - 330 * t)
@@ -86,6 +87,66 @@ FORWARD(s_forward); /* sphere */
 	xy.y = aks0 * (xy.y - P->phi0);
 	return (xy);
 }
+SPECIAL(e_fac) { /* ellipse, the derivatives of the series of e_forward() */
+	double al, als, n, cosphi, sinphi, t, w, sx, sy, a, b, c, d, e, f;
+	double dal, dals, dn, dt, dsx, dsy;
+
+	if( lp.lam < -HALFPI || lp.lam > HALFPI )
+		return;
+	pj_sincos(lp.phi, &sinphi, &cosphi);
+	t = fabs(cosphi) > 1e-10 ? sinphi/cosphi : 0.;
+	dt = 2. * t / (cosphi * cosphi);
+	t *= t;
+	als = cosphi * lp.lam;
+	als *= als;
+	dals = -2. * sinphi * cosphi * lp.lam * lp.lam;
+	w = 1. / sqrt(1. - P->es * sinphi * sinphi);
+	al = cosphi * w;
+	dal = (P->es * cosphi * cosphi * w * w - 1.) * sinphi * w;
+	n = P->esp * cosphi * cosphi;
+	dn = -2. * P->esp * sinphi * cosphi;
+	a = 1. - t + n;
+	b = 5. + t * (t - 18.) + n * (14. - 58. * t);
+	c = 61. + t * ( t * (179. - t) - 479. );
+	sx = FC1 + FC3 * als * (a + FC5 * als * (b + FC7 * als * c));
+	dsx = FC3 * (a + FC5 * als * (2. * b + FC7 * als * 3. * c)) * dals +
+		FC3 * als * (-1. + FC5 * als * ((2. * t - 18. - 58. * n) +
+		FC7 * als * (t * (358. - 3. * t) - 479.))) * dt +
+		FC3 * als * (1. + FC5 * als * (14. - 58. * t)) * dn;
+	d = 5. - t + n * (9. + 4. * n);
+	e = 61. + t * (t - 58.) + n * (270. - 330 * t);
+	f = 1385. + t * ( t * (543. - t) - 3111.);
+	sy = 1. + FC4 * als * (d + FC6 * als * (e + FC8 * als * f));
+	dsy = FC4 * (d + FC6 * als * (2. * e + FC8 * als * 3. * f)) * dals +
+		FC4 * als * (-1. + FC6 * als * ((2. * t - 58. - 330. * n) +
+		FC8 * als * (t * (1086. - 3. * t) - 3111.))) * dt +
+		FC4 * als * ((9. + 8. * n) + FC6 * als * (270. - 330. * t)) * dn;
+	fac->code |= IS_ANAL_XL_YL + IS_ANAL_XP_YP;
+	fac->der.x_l = P->k0 * al * (FC1 +
+		FC3 * als * (3. * a + FC5 * als * (5. * b + FC7 * als * 7. * c)));
+	fac->der.y_l = - P->k0 * sinphi * al * lp.lam * (1. +
+		FC4 * als * (2. * d + FC6 * als * (3. * e + FC8 * als * 4. * f)));
+	fac->der.x_p = - P->k0 * lp.lam * (dal * sx + al * dsx);
+	fac->der.y_p = P->k0 * (P->one_es * w * w * w + FC2 * lp.lam * lp.lam *
+		((cosphi * al + sinphi * dal) * sy + sinphi * al * dsy));
+}
+SPECIAL(s_fac) { /* sphere */
+	double b, d, cosphi, sinphi, coslam, sinlam;
+
+	if( lp.lam < -HALFPI || lp.lam > HALFPI )
+		return;
+	pj_sincos(lp.phi, &sinphi, &cosphi);
+	pj_sincos(lp.lam, &sinlam, &coslam);
+	b = cosphi * sinlam;
+	if ((d = 1. - b * b) <= EPS10)
+		return;
+	d = aks0 / d;
+	fac->code |= IS_ANAL_XL_YL + IS_ANAL_XP_YP;
+	fac->der.x_l = d * cosphi * coslam;
+	fac->der.x_p = d * sinphi * sinlam;
+	fac->der.y_l = - d * sinphi * b;
+	fac->der.y_p = d * coslam;
+}
 INVERSE(e_inverse); /* ellipsoid */
 	double n, con, cosphi, d, ds, sinphi, t;
 
@@ -127,10 +188,149 @@ INVERSE(s_inverse); /* sphere */
 	lp.lam = (g || h) ? atan2(g, h) : 0.;
 	return (lp);
 }
+/*
+ * Array kernels for the ellipsoidal case.  Each chunk is gathered into
+ * contiguous buffers, the libm calls are done in a first pass and the
+ * series are evaluated in a second pass without calls or branches, so
+ * that the compiler can vectorize it.  The arithmetic is that of
+ * e_forward()/e_inverse() (and pj_mlfn_i()) term for term.
+ */
+#define KERNEL_CHUNK 64
+	static int
+e_forward_n(PJ *P, long n, int stride, double *x, double *y) {
+	double lam[KERNEL_CHUNK], phi[KERNEL_CHUNK];
+	double sp[KERNEL_CHUNK], cp[KERNEL_CHUNK];
+	double xs[KERNEL_CHUNK], ys[KERNEL_CHUNK];
+	double *en = P->en;
+	long base, i, m;
+	int err = 0;
+
+	for (base = 0; base < n; base += KERNEL_CHUNK) {
+		double *cx = x + base * stride, *cy = y + base * stride;
+
+		m = n - base;
+		if (m > KERNEL_CHUNK)
+			m = KERNEL_CHUNK;
+		for (i = 0; i < m; i++) {
+			lam[i] = cx[i * stride];
+			phi[i] = cy[i * stride];
+			if (lam[i] == HUGE_VAL) {
+				sp[i] = 0.; cp[i] = 1.;
+			} else if (lam[i] < -HALFPI || lam[i] > HALFPI) {
+				/* see e_forward() */
+				lam[i] = HUGE_VAL;
+				sp[i] = 0.; cp[i] = 1.;
+				err = -14;
+			} else {
+				sp[i] = sin(phi[i]);
+				cp[i] = cos(phi[i]);
+			}
+		}
+		for (i = 0; i < m; i++) {
+			double al, als, nn, t, sinphi = sp[i], cosphi = cp[i];
+
+			t = fabs(cosphi) > 1e-10 ? sinphi/cosphi : 0.;
+			t *= t;
+			al = cosphi * lam[i];
+			als = al * al;
+			al /= sqrt(1. - P->es * sinphi * sinphi);
+			nn = P->esp * cosphi * cosphi;
+			xs[i] = P->k0 * al * (FC1 +
+				FC3 * als * (1. - t + nn +
+				FC5 * als * (5. + t * (t - 18.) + nn * (14. - 58. * t)
+				+ FC7 * als * (61. + t * ( t * (179. - t) - 479. ) )
+				)));
+			ys[i] = P->k0 * ((en[0] * phi[i] - (cosphi * sinphi) *
+				(en[1] + (sinphi * sinphi) * (en[2] + (sinphi * sinphi) *
+				(en[3] + (sinphi * sinphi) * en[4])))) - P->ml0 +
+				sinphi * al * lam[i] * FC2 * ( 1. +
+				FC4 * als * (5. - t + nn * (9. + 4. * nn) +
+				FC6 * als * (61. + t * (t - 58.) + nn * (270. - 330 * t)
+				+ FC8 * als * (1385. + t * ( t * (543. - t) - 3111.) )
+				))));
+		}
+		for (i = 0; i < m; i++) {
+			if (lam[i] == HUGE_VAL)
+				xs[i] = ys[i] = HUGE_VAL;
+			cx[i * stride] = xs[i];
+			cy[i * stride] = ys[i];
+		}
+	}
+	return err;
+}
+	static int
+e_inverse_n(PJ *P, long n, int stride, double *x, double *y) {
+	double xx[KERNEL_CHUNK], yy[KERNEL_CHUNK], phi[KERNEL_CHUNK];
+	double sp[KERNEL_CHUNK], cp[KERNEL_CHUNK];
+	double lams[KERNEL_CHUNK], phis[KERNEL_CHUNK];
+	long base, i, m;
+	int err = 0;
+
+	for (base = 0; base < n; base += KERNEL_CHUNK) {
+		double *cx = x + base * stride, *cy = y + base * stride;
+
+		m = n - base;
+		if (m > KERNEL_CHUNK)
+			m = KERNEL_CHUNK;
+		for (i = 0; i < m; i++) {
+			xx[i] = cx[i * stride];
+			yy[i] = cy[i * stride];
+			sp[i] = 0.; cp[i] = 1.;
+			if (xx[i] == HUGE_VAL) {
+				phi[i] = 0.;
+				continue;
+			}
+			phi[i] = pj_inv_mlfn(P->ctx, P->ml0 + yy[i] / P->k0, P->es, P->en);
+			if (P->ctx->last_errno) {
+				err = P->ctx->last_errno;
+				P->ctx->last_errno = 0;
+				xx[i] = HUGE_VAL;
+				phi[i] = 0.;
+			} else if (fabs(phi[i]) < HALFPI) {
+				sp[i] = sin(phi[i]);
+				cp[i] = cos(phi[i]);
+			}
+		}
+		for (i = 0; i < m; i++) {
+			double con, d, ds, nn, t, sinphi = sp[i], cosphi = cp[i];
+
+			t = fabs(cosphi) > 1e-10 ? sinphi/cosphi : 0.;
+			nn = P->esp * cosphi * cosphi;
+			d = xx[i] * sqrt(con = 1. - P->es * sinphi * sinphi) / P->k0;
+			con *= t;
+			t *= t;
+			ds = d * d;
+			phis[i] = phi[i] - (con * ds / (1.-P->es)) * FC2 * (1. -
+				ds * FC4 * (5. + t * (3. - 9. *  nn) + nn * (1. - 4 * nn) -
+				ds * FC6 * (61. + t * (90. - 252. * nn +
+					45. * t) + 46. * nn
+			   - ds * FC8 * (1385. + t * (3633. + t * (4095. + 1574. * t)) )
+				)));
+			lams[i] = d*(FC1 -
+				ds*FC3*( 1. + 2.*t + nn -
+				ds*FC5*(5. + t*(28. + 24.*t + 8.*nn) + 6.*nn
+			   - ds * FC7 * (61. + t * (662. + t * (1320. + 720. * t)) )
+			))) / cosphi;
+		}
+		for (i = 0; i < m; i++) {
+			if (xx[i] == HUGE_VAL)
+				lams[i] = phis[i] = HUGE_VAL;
+			else if (fabs(phi[i]) >= HALFPI) {
+				phis[i] = yy[i] < 0. ? -HALFPI : HALFPI;
+				lams[i] = 0.;
+			}
+			cx[i * stride] = lams[i];
+			cy[i * stride] = phis[i];
+		}
+	}
+	return err;
+}
+FORWARD_ARRAY(s_forward_n, s_forward)
+INVERSE_ARRAY(s_inverse_n, s_inverse)
 FREEUP;
 	if (P) {
 		if (P->en)
-			pj_dalloc(P->en);
+			pj_table_release(P->en);
 		pj_dalloc(P);
 	}
 }
@@ -139,15 +339,22 @@ setup(PJ *P) { /* general initialization */
 	if (P->es) {
 		if (!(P->en = pj_enfn(P->es)))
 			E_ERROR_0;
-		P->ml0 = pj_mlfn(P->phi0, sin(P->phi0), cos(P->phi0), P->en);
+		P->en = pj_inv_mlfn_accuracy(P->en, P->es, P->a, P->cold->accuracy);
+		P->ml0 = pj_mlfn_i(P->phi0, sin(P->phi0), cos(P->phi0), P->en);
 		P->esp = P->es / (1. - P->es);
 		P->inv = e_inverse;
 		P->fwd = e_forward;
+		P->inv_n = e_inverse_n;
+		P->fwd_n = e_forward_n;
+		P->spc = e_fac;
 	} else {
 		aks0 = P->k0;
 		aks5 = .5 * aks0;
 		P->inv = s_inverse;
 		P->fwd = s_forward;
+		P->inv_n = s_inverse_n;
+		P->fwd_n = s_forward_n;
+		P->spc = s_fac;
 	}
 	return P;
 }
@@ -173,3 +380,95 @@ ENTRY1(utm, en)
 	P->k0 = 0.9996;
 	P->phi0 = 0.;
 ENDENTRY(setup(P))
+
+/*
+ * Project point_count longitude-latitude points (radians) each to the
+ * UTM zone it falls in, with the ellipsoid and units of P, a +proj=utm
+ * PJ whose own zone and +south are ignored.  The zone is the 6 degree
+ * band of the longitude but for the exceptions of southwest Norway (32V)
+ * and Svalbard (31X to 37X); the hemisphere is that of the latitude.
+ * Eastings and northings go to x and y, and the zones to zones, negated
+ * in the southern hemisphere.  All zones share P and its kernels, only
+ * the longitudes differ.  Failed points are HUGE_VAL, with a zone of 0,
+ * and the error of the last of them is returned.
+ */
+	static int
+utm_auto_zone(double lam, double phi) {
+	double lon = lam * RAD_TO_DEG, lat = phi * RAD_TO_DEG;
+	int zone = (int) ((lon + 180.) / 6.) + 1; /* lon + 180 is >= 0 */
+
+	if (zone > 60)
+		zone = 60;
+	if (lat >= 56. && lon >= 0. && lon < 42.) {
+		if (lat < 64. && lon >= 3. && lon < 12.)
+			zone = 32;
+		else if (lat >= 72.)
+			zone = lon < 9. ? 31 : lon < 21. ? 33 : lon < 33. ? 35 : 37;
+	}
+	return zone;
+}
+#define UTM_CHUNK 256
+	int
+pj_utm_array(PJ *P, long point_count, int point_offset,
+		const double *lam, const double *phi,
+		double *x, double *y, int *zones) {
+	long base, i, n;
+	int err = 0, kerr;
+
+	if (P->descr != des_utm || !P->fwd_n)
+		return -5;
+	if (point_offset == 0)
+		point_offset = 1;
+
+	for (base = 0; base < point_count; base += UTM_CHUNK) {
+		long b = base * point_offset;
+
+		n = point_count - base;
+		if (n > UTM_CHUNK)
+			n = UTM_CHUNK;
+
+		/* range check and normalize as pj_fwd() does, to the zone */
+		for (i = 0; i < n; i++) {
+			long io = b + i * point_offset;
+			double t, l;
+
+			if ((t = fabs(phi[io]) - HALFPI) > 1.0e-12 ||
+			    fabs(lam[io]) > 10.) {
+				x[io] = y[io] = HUGE_VAL;
+				err = -14;
+				continue;
+			}
+			l = adjlon(lam[io]);
+			zones[io] = utm_auto_zone(l, phi[io]);
+			/* within 9 degrees of the zone meridian */
+			x[io] = l - ((zones[io] - .5) * PI / 30. - PI);
+			if (fabs(t) <= 1.0e-12)
+				y[io] = phi[io] < 0. ? -HALFPI : HALFPI;
+			else if (P->geoc)
+				y[io] = atan(P->rone_es * tan(phi[io]));
+			else
+				y[io] = phi[io];
+			if (phi[io] < 0.)
+				zones[io] = -zones[io];
+		}
+
+		if ((kerr = pj_fwd_kernel(P, n, point_offset, x + b, y + b)) != 0)
+			err = kerr;
+
+		for (i = 0; i < n; i++) {
+			long io = b + i * point_offset;
+
+			if (x[io] == HUGE_VAL) {
+				zones[io] = 0;
+				continue;
+			}
+			x[io] = P->fr_meter * (P->a * x[io] + 500000.);
+			y[io] = P->fr_meter * (P->a * y[io] +
+				(zones[io] < 0 ? 10000000. : 0.));
+		}
+	}
+
+	if (err)
+		pj_ctx_set_errno(P->ctx, err);
+	return err;
+}
@@ -2,33 +2,68 @@
 	double	cosphi1;
 #define PJ_LIB__
 # include	<projects.h>
+# include	<pj_math.h>
 PROJ_HEAD(wink2, "Winkel II") "\n\tPCyl., Sph., no inv.\n\tlat_1=";
 #define MAX_ITER    10
 #define LOOP_TOL    1e-7
 #define TWO_D_PI 0.636619772367581343
+	static PJ_INLINE double
+newton_step(double t, double k, PJ *P) {
+	(void) P;
+	return ((t + sin(t) - k) / (1. + cos(t)));
+}
 FORWARD(s_forward); /* spheroid */
 	double k, V;
 	int i;
 
 	xy.y = lp.phi * TWO_D_PI;
 	k = PI * sin(lp.phi);
-	lp.phi *= 1.8;
+	lp.phi = pj_tsin_start(k);
 	for (i = MAX_ITER; i ; --i) {
-		lp.phi -= V = (lp.phi + sin(lp.phi) - k) /
-			(1. + cos(lp.phi));
+		lp.phi -= V = newton_step(lp.phi, k, P);
 		if (fabs(V) < LOOP_TOL)
 			break;
 	}
-	if (!i)
-		lp.phi = (lp.phi < 0.) ? -HALFPI : HALFPI;
+	if (!i) /* at the poles the step is 0/0 */
+		lp.phi = (k < 0.) ? -HALFPI : HALFPI;
 	else
 		lp.phi *= 0.5;
 	xy.x = 0.5 * lp.lam * (cos(lp.phi) + P->cosphi1);
 	xy.y = FORTPI * (sin(lp.phi) + xy.y);
 	return (xy);
+}
+	static int /* spheroid, the Newton iteration of a run of points at once */
+s_forward_n(PJ *P, long n, int stride, double *x, double *y) {
+	double phi[PJ_NEWTON_RUN], k[PJ_NEWTON_RUN];
+	char conv[PJ_NEWTON_RUN];
+	long i0, io, j, m;
+
+	for (i0 = 0; i0 < n; i0 += PJ_NEWTON_RUN) {
+		m = n - i0 < PJ_NEWTON_RUN ? n - i0 : PJ_NEWTON_RUN;
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			k[j] = PI * sin(y[io]);
+			phi[j] = pj_tsin_start(k[j]);
+			conv[j] = x[io] == HUGE_VAL;
+		}
+		pj_newton_run(newton_step, P, MAX_ITER, LOOP_TOL, m, phi, k, conv);
+		for (j = 0, io = i0 * stride; j < m; ++j, io += stride) {
+			double v;
+
+			if (conv[j] == 1)
+				continue;
+			if (!conv[j])
+				phi[j] = (k[j] < 0.) ? -HALFPI : HALFPI;
+			else
+				phi[j] *= 0.5;
+			v = y[io] * TWO_D_PI;
+			x[io] = 0.5 * x[io] * (cos(phi[j]) + P->cosphi1);
+			y[io] = FORTPI * (sin(phi[j]) + v);
+		}
+	}
+	return 0;
 }
 FREEUP; if (P) pj_dalloc(P); }
 ENTRY0(wink2)
 	P->cosphi1 = cos(pj_param(P->ctx, P->params, "rlat_1").f);
-	P->es = 0.; P->inv = 0; P->fwd = s_forward;
+	P->es = 0.; P->inv = 0; P->fwd = s_forward; P->fwd_n = s_forward_n;
 ENDENTRY(P)
@@ -13,3 +13,36 @@ double adjlon (double lon) {
     lon -= ONEPI;  /* adjust back to -pi..pi rad */
     return( lon );
 }
+
+/* adjlon() of n values, stride doubles apart, in place.  HUGE_VAL
+   values are left as they are.  Both sides of the test are computed and
+   one is selected, so that the loop vectorizes; the results are those
+   of adjlon(). */
+void adjlon_n (long n, int stride, double *lon) {
+    long i;
+
+    for (i = 0; i < n; ++i, lon += stride) {
+        double l = *lon, r;
+
+        r = l + ONEPI;
+        r -= TWOPI * floor(r / TWOPI);
+        r -= ONEPI;
+        *lon = (fabs(l) <= SPI || l == HUGE_VAL) ? l : r;
+    }
+}
+
+/* reduce n values, stride doubles apart, to center +/- pi in place, as
+   the lon_wrap loops adding or removing TWOPI did.  HUGE_VAL values are
+   left as they are. */
+void adjlon_wrap_n (long n, int stride, double *lon, double center) {
+    double lo = center - ONEPI, hi = center + ONEPI;
+    long i;
+
+    for (i = 0; i < n; ++i, lon += stride) {
+        double l = *lon, k;
+
+        k = l < lo ? -ceil((lo - l) / TWOPI) :
+            (l > hi && l != HUGE_VAL) ? ceil((l - hi) / TWOPI) : 0.;
+        *lon = l - k * TWOPI;
+    }
+}
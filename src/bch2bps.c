@@ -35,7 +35,7 @@ rows(projUV *c, projUV *d, int n) {
 	projUV sv, *dd;
 	int j, k;
 
-	dd = (projUV *)vector1(n-1, sizeof(projUV));
+	dd = (projUV *)vector1(n, sizeof(projUV));
 	sv.u = sv.v = 0.;
 	for (j = 0; j < n; ++j) d[j] = dd[j] = sv;
 	d[0] = c[n-1];
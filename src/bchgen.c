@@ -1,10 +1,22 @@
 /* generate double bivariate Chebychev polynomial */
 #include <projects.h>
+/* func of bchgen(), for bchgen_data() */
+struct BCH_FUNC { projUV (*func)(projUV); };
+	static projUV
+call_func(projUV arg, void *data) {
+	return (*((struct BCH_FUNC *)data)->func)(arg);
+}
 	int
 bchgen(projUV a, projUV b, int nu, int nv, projUV **f, projUV(*func)(projUV)) {
-	int i, j, k;
-	projUV arg, *t, bma, bpa, *c;
-	double d, fac;
+	struct BCH_FUNC data;
+
+	data.func = func;
+	return bchgen_data(a, b, nu, nv, f, call_func, &data);
+}
+	void	/* Chebychev nodes of bchgen(), the arguments of func */
+bchgen_nodes(projUV a, projUV b, int nu, int nv, projUV **f) {
+	int i, j;
+	projUV arg, bma, bpa;
 
 	bma.u = 0.5 * (b.u - a.u); bma.v = 0.5 * (b.v - a.v);
 	bpa.u = 0.5 * (b.u + a.u); bpa.v = 0.5 * (b.v + a.v);
@@ -12,20 +24,51 @@ bchgen(projUV a, projUV b, int nu, int nv, projUV **f, projUV(*func)(projUV)) {
 		arg.u = cos(PI * (i + 0.5) / nu) * bma.u + bpa.u;
 		for ( j = 0; j < nv; ++j) {
 			arg.v = cos(PI * (j + 0.5) / nv) * bma.v + bpa.v;
-			f[i][j] = (*func)(arg);
+			f[i][j] = arg;
+		}
+	}
+}
+	int	/* same as bchgen(), with data passed to func */
+bchgen_data(projUV a, projUV b, int nu, int nv, projUV **f,
+	projUV(*func)(projUV, void *), void *data) {
+	int i, j;
+
+	bchgen_nodes(a, b, nu, nv, f);
+	for ( i = 0; i < nu; ++i)
+		for ( j = 0; j < nv; ++j) {
+			f[i][j] = (*func)(f[i][j], data);
 			if ((f[i][j]).u == HUGE_VAL)
 				return(1);
 		}
+	return bchgen_values(nu, nv, f);
+}
+	int	/* coefficients from the values of func at bchgen_nodes() in f */
+bchgen_values(int nu, int nv, projUV **f) {
+	int i, j, k;
+	projUV arg, *t, *c;
+	double *du, *dv, fac;
+
+	/* cosines of the sums, the same for each row and column */
+	if (!(du = (double *) vector1(nu * nu + nv * nv, sizeof(double))))
+		return 1;
+	dv = du + nu * nu;
+	for (i = 0; i < nu; ++i)
+		for (k = 0; k < nu; ++k)
+			du[i * nu + k] = cos(PI * i * (k + .5) / nu);
+	for (j = 0; j < nv; ++j)
+		for (k = 0; k < nv; ++k)
+			dv[j * nv + k] = cos(PI * j * (k + .5) / nv);
+	if (!(c = (projUV *) vector1(nu, sizeof(projUV)))) {
+		pj_dalloc(du);
+		return 1;
 	}
-	if (!(c = (projUV *) vector1(nu, sizeof(projUV)))) return 1;
 	fac = 2. / nu;
 	for ( j = 0; j < nv ; ++j) {
 		for ( i = 0; i < nu; ++i) {
 			arg.u = arg.v = 0.;
 			for (k = 0; k < nu; ++k) {
-				d = cos(PI * i * (k + .5) / nu);
-				arg.u += f[k][j].u * d;
-				arg.v += f[k][j].v * d;
+				arg.u += f[k][j].u * du[i * nu + k];
+				arg.v += f[k][j].v * du[i * nu + k];
 			}
 			arg.u *= fac;
 			arg.v *= fac;
@@ -35,16 +78,18 @@ bchgen(projUV a, projUV b, int nu, int nv, projUV **f, projUV(*func)(projUV)) {
 			f[i][j] = c[i];
 	}
 	pj_dalloc(c);
-	if (!(c = (projUV*) vector1(nv, sizeof(projUV)))) return 1;
+	if (!(c = (projUV*) vector1(nv, sizeof(projUV)))) {
+		pj_dalloc(du);
+		return 1;
+	}
 	fac = 2. / nv;
 	for ( i = 0; i < nu; ++i) {
 		t = f[i];
 		for (j = 0; j < nv; ++j) {
 			arg.u = arg.v = 0.;
 			for (k = 0; k < nv; ++k) {
-				d = cos(PI * j * (k + .5) / nv);
-				arg.u += t[k].u * d;
-				arg.v += t[k].v * d;
+				arg.u += t[k].u * dv[j * nv + k];
+				arg.v += t[k].v * dv[j * nv + k];
 			}
 			arg.u *= fac;
 			arg.v *= fac;
@@ -54,5 +99,6 @@ bchgen(projUV a, projUV b, int nu, int nv, projUV **f, projUV(*func)(projUV)) {
 		c = t;
 	}
 	pj_dalloc(c);
+	pj_dalloc(du);
 	return(0);
 }
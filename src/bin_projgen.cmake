@@ -0,0 +1,7 @@
+set(PROJGEN_SRC projgen.c workload.c)
+
+source_group("Source Files\\Bin" FILES ${PROJGEN_SRC})
+
+#Executable, not installed
+add_executable(projgen ${PROJGEN_SRC})
+target_link_libraries(projgen ${PROJ_LIBRARIES})
@@ -85,3 +85,170 @@ biveval(projUV in, Tseries *T) {
     }
 }
 
+
+/* Batched evaluation.  The coefficients are packed by pack_series() in
+** one block of rows padded with zeros to the same length, so that a
+** recurrence runs over BIV_LANES points at once with fixed loop counts,
+** which compilers vectorize.  The padding zeros leave the sums as they
+** are, and the results are those of the single point evaluators. */
+# define BIV_LANES	8
+
+int /* pack coefficient rows of T, returns 0 if out of memory */
+pack_series(Tseries *T) {
+    int nu = T->mu + 1, nv = T->mv + 1, m = 1, i, j;
+    double *p;
+
+    for (i = 0; i < nu; ++i)
+        if (T->cu[i].m > m) m = T->cu[i].m;
+    for (i = 0; i < nv; ++i)
+        if (T->cv[i].m > m) m = T->cv[i].m;
+    if (nu < 0) nu = 0;
+    if (nv < 0) nv = 0;
+    if (!(p = (double *)pj_malloc(sizeof(double) * m * (nu + nv + 1))))
+        return 0;
+    T->packed = p;
+    T->packed_m = m;
+    for (i = 0; i < m * (nu + nv + 1); ++i)
+        p[i] = 0.;
+    for (i = 0; i < nu; ++i, p += m)
+        for (j = 0; j < T->cu[i].m; ++j)
+            p[j] = T->cu[i].c[j];
+    for (i = 0; i < nv; ++i, p += m)
+        for (j = 0; j < T->cv[i].m; ++j)
+            p[j] = T->cv[i].c[j];
+    return 1;
+}
+
+/* ceval() of n rows packed by m coefficients, for BIV_LANES points */
+static void ceval_n(struct PW_COEF *C, const double *P, int n, int m,
+                    const double *wu, const double *wv, double *out) {
+    double d[BIV_LANES], dd[BIV_LANES], vd[BIV_LANES], vdd[BIV_LANES];
+    double w2u[BIV_LANES], w2v[BIV_LANES], tmp;
+    const double *c;
+    int i, j, k;
+
+    if (n <= 0) {
+        for (k = 0; k < BIV_LANES; ++k) out[k] = 0.;
+        return;
+    }
+    for (k = 0; k < BIV_LANES; ++k) {
+        d[k] = dd[k] = 0.;
+        w2u[k] = wu[k] + wu[k];
+        w2v[k] = wv[k] + wv[k];
+    }
+    for (i = n - 1; i >= 0; --i) {
+        c = P + i * m;
+        for (k = 0; k < BIV_LANES; ++k) vd[k] = vdd[k] = 0.;
+        /* the padding of the row is skipped, c[0] is 0 for empty rows */
+        for (j = C[i].m - 1; j > 0; --j)
+            for (k = 0; k < BIV_LANES; ++k) {
+                tmp = vd[k];
+                vd[k] = w2v[k] * tmp - vdd[k] + c[j];
+                vdd[k] = tmp;
+            }
+        if (i)
+            for (k = 0; k < BIV_LANES; ++k) {
+                tmp = d[k];
+                d[k] = w2u[k] * tmp - dd[k] + wv[k] * vd[k]
+                    - vdd[k] + 0.5 * *c;
+                dd[k] = tmp;
+            }
+        else
+            for (k = 0; k < BIV_LANES; ++k)
+                out[k] = wu[k] * d[k] - dd[k]
+                    + 0.5 * (wv[k] * vd[k] - vdd[k] + 0.5 * *c);
+    }
+}
+
+void /* bcheval() of n points, in may be out */
+bcheval_n(const projUV *in, projUV *out, long n, Tseries *T) {
+    double wu[BIV_LANES], wv[BIV_LANES], ou[BIV_LANES], ov[BIV_LANES];
+    int bad[BIV_LANES], count, k;
+    long base;
+
+    if (!T->packed) {
+        for (base = 0; base < n; ++base)
+            out[base] = bcheval(in[base], T);
+        return;
+    }
+    for (base = 0; base < n; base += BIV_LANES) {
+        count = n - base < BIV_LANES ? (int)(n - base) : BIV_LANES;
+        for (k = 0; k < BIV_LANES; ++k) {
+            wu[k] = wv[k] = 0.;
+            if (k >= count)
+                continue;
+            /* scale to +-1 */
+            wu[k] = ( in[base+k].u + in[base+k].u - T->a.u ) * T->b.u;
+            wv[k] = ( in[base+k].v + in[base+k].v - T->a.v ) * T->b.v;
+            if ((bad[k] = fabs(wu[k]) > NEAR_ONE || fabs(wv[k]) > NEAR_ONE))
+                wu[k] = wv[k] = 0.;
+        }
+        ceval_n(T->cu, T->packed, T->mu + 1, T->packed_m, wu, wv, ou);
+        ceval_n(T->cv,
+                T->packed + (T->mu + 1 > 0 ? T->mu + 1 : 0) * T->packed_m,
+                T->mv + 1, T->packed_m, wu, wv, ov);
+        for (k = 0; k < count; ++k)
+            if (bad[k]) {
+                out[base+k].u = out[base+k].v = HUGE_VAL;
+                pj_errno = -36;
+            } else {
+                out[base+k].u = ou[k];
+                out[base+k].v = ov[k];
+            }
+    }
+}
+
+/* power series of n packed rows of m coefficients, for BIV_LANES points */
+static void peval_n(const double *C, int n, int m, const double *u,
+                    const double *v, double *out) {
+    double row[BIV_LANES];
+    const double *c;
+    int i, j, k;
+
+    for (k = 0; k < BIV_LANES; ++k) out[k] = 0.;
+    for (i = n - 1; i >= 0; --i) {
+        c = C + i * m;
+        for (k = 0; k < BIV_LANES; ++k) row[k] = 0.;
+        for (j = m - 1; j >= 0; --j)
+            for (k = 0; k < BIV_LANES; ++k)
+                row[k] = c[j] + v[k] * row[k];
+        for (k = 0; k < BIV_LANES; ++k)
+            out[k] = row[k] + u[k] * out[k];
+    }
+}
+
+void /* bpseval() of n points, in may be out */
+bpseval_n(const projUV *in, projUV *out, long n, Tseries *T) {
+    double u[BIV_LANES], v[BIV_LANES], ou[BIV_LANES], ov[BIV_LANES];
+    int count, k;
+    long base;
+
+    if (!T->packed) {
+        for (base = 0; base < n; ++base)
+            out[base] = bpseval(in[base], T);
+        return;
+    }
+    for (base = 0; base < n; base += BIV_LANES) {
+        count = n - base < BIV_LANES ? (int)(n - base) : BIV_LANES;
+        for (k = 0; k < BIV_LANES; ++k) {
+            u[k] = k < count ? in[base+k].u : 0.;
+            v[k] = k < count ? in[base+k].v : 0.;
+        }
+        peval_n(T->packed, T->mu + 1, T->packed_m, u, v, ou);
+        peval_n(T->packed + (T->mu + 1 > 0 ? T->mu + 1 : 0) * T->packed_m,
+                T->mv + 1, T->packed_m, u, v, ov);
+        for (k = 0; k < count; ++k) {
+            out[base+k].u = ou[k];
+            out[base+k].v = ov[k];
+        }
+    }
+}
+
+void /* biveval() of n points, in may be out */
+biveval_n(const projUV *in, projUV *out, long n, Tseries *T) {
+
+    if (T->power)
+        bpseval_n(in, out, n, T);
+    else
+        bcheval_n(in, out, n, T);
+}
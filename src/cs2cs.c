@@ -36,28 +36,95 @@
 #include <math.h>
 #include "emess.h"
 
+#if defined(MSDOS) || defined(OS2) || defined(WIN32) || defined(__WIN32__)
+#  include <fcntl.h>
+#  include <io.h>
+#  define SET_BINARY_MODE(file) setmode(fileno(file), O_BINARY)
+#else
+#  define SET_BINARY_MODE(file)
+#  define HAVE_SERVE
+#  include <errno.h>
+#  include <signal.h>
+#  include <unistd.h>
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/socket.h>
+#  include <sys/un.h>
+#endif
+
 #define MAX_LINE 1000
 #define MAX_PARGS 100
+#define BATCH_LINES 4096	/* lines per pj_transform() call with -j */
+#define BATCH_READ_SIZE 1048576
 
 static projPJ   fromProj, toProj;
+static projTransformPlan transformPlan;
 
 static int
+bin_in = 0,	/* != 0 then binary input */
+bin_out = 0,	/* != 0 then binary output */
 reversein = 0,	/* != 0 reverse input arguments */
 reverseout = 0,	/* != 0 reverse output arguments */
 echoin = 0,	/* echo input data to output line */
+threads = 0,	/* != 0 process input in batches on this many threads */
 tag = '#';	/* beginning of line tag character */
 	static char
 *oform = (char *)0,	/* output format for x-y or decimal degrees */
 *oterr = "*\t*",	/* output line for unprojectable input */
 *usage =
-"%s\nusage: %s [ -eEfIlrstvwW [args] ] [ +opts[=arg] ]\n"
+"%s\nusage: %s [ -bcCeEfiIjlorsStvwW [args] ] [ +opts[=arg] ]\n"
 "                   [+to [+opts[=arg] [ files ]\n";
 
+static char *column_in[3], *column_out[3]; /* x, y and z file names */
+static char *serve_path;  /* -S socket */
+static FILE *column_fid[3];
+
 static struct FACTORS facs;
 static double (*informat)(const char *, 
                           char **); /* input data deformatter function */
 
 
+/************************************************************************/
+/*                            print_double()                            */
+/************************************************************************/
+static void print_double(const char *format, double value)
+
+{
+    char buf[MAX_LINE];
+
+    pj_format_double(buf, format, value);
+    fputs(buf, stdout);
+}
+
+/************************************************************************/
+/*                           write_binary()                             */
+/*                                                                      */
+/*      Write x, y, z records to stdout, or to the -C column files.     */
+/************************************************************************/
+static void write_binary(const double *xyz, size_t count)
+
+{
+    static double column[1024];
+    size_t done, i;
+    int c;
+
+    if (column_out[0] == NULL) {
+        (void)fwrite(xyz, 3 * sizeof(double), count, stdout);
+        return;
+    }
+
+    for (done = 0; done < count; done += i) {
+        size_t n = count - done < 1024 ? count - done : 1024;
+
+        for (c = 0; c < 3 && column_out[c] != NULL; c++) {
+            for (i = 0; i < n; i++)
+                column[i] = xyz[(done + i) * 3 + c];
+            (void)fwrite(column, sizeof(double), n, column_fid[c]);
+        }
+        i = n;
+    }
+}
+
 /************************************************************************/
 /*                              process()                               */
 /*                                                                      */
@@ -82,7 +149,8 @@ static void process(FILE *fid)
             while ((c = fgetc(fid)) != EOF && c != '\n') ;
         }
         if (*s == tag) {
-            fputs(line, stdout);
+            if (!bin_out)
+                fputs(line, stdout);
             continue;
         }
 
@@ -94,14 +162,14 @@ static void process(FILE *fid)
             data.v = (*informat)(s, &s);
         }
 
-        z = strtod( s, &s );
+        z = pj_strtod( s, &s );
 
         if (data.v == HUGE_VAL)
             data.u = HUGE_VAL;
 
         if (!*s && (s > line)) --s; /* assumed we gobbled \n */
 
-        if ( echoin) {
+        if (!bin_out && echoin) {
             int t;
             t = *s;
             *s = '\0';
@@ -111,8 +179,8 @@ static void process(FILE *fid)
         }
 
         if (data.u != HUGE_VAL) {
-            if( pj_transform( fromProj, toProj, 1, 0, 
-                              &(data.u), &(data.v), &z ) != 0 )
+            if( pj_transform_plan_execute( transformPlan, 1, 0, 
+                                           &(data.u), &(data.v), &z ) != 0 )
             {
                 data.u = HUGE_VAL;
                 data.v = HUGE_VAL;
@@ -120,6 +188,16 @@ static void process(FILE *fid)
             }
         }
 
+        if (bin_out) { /* binary output */
+            double xyz[3];
+
+            xyz[0] = data.u;
+            xyz[1] = data.v;
+            xyz[2] = z;
+            write_binary(xyz, 1);
+            continue;
+        }
+
         if (data.u == HUGE_VAL) /* error output */
             fputs(oterr, stdout);
 
@@ -140,19 +218,19 @@ static void process(FILE *fid)
                 data.u *= RAD_TO_DEG;
             }
             if (reverseout) {
-                printf(oform,data.v); putchar('\t');
-                printf(oform,data.u);
+                print_double(oform,data.v); putchar('\t');
+                print_double(oform,data.u);
             } else {
-                printf(oform,data.u); putchar('\t');
-                printf(oform,data.v);
+                print_double(oform,data.u); putchar('\t');
+                print_double(oform,data.v);
             }
         }
 
         putchar(' ');
         if( oform != NULL )
-            printf( oform, z );
+            print_double( oform, z );
         else
-            printf( "%.3f", z );
+            print_double( "%.3f", z );
         if( s )
             printf( "%s", s );
         else
@@ -160,6 +238,909 @@ static void process(FILE *fid)
     }
 }
 
+/*
+** With -j the input is read in large blocks and cut into batches of
+** lines, each parsed, transformed with a single pj_transform() call and
+** formatted on a worker thread with its own context and copies of the
+** projections.  The output of the batches is written in input order.
+** Binary input is always read this way, in batches of points.
+*/
+typedef struct {
+    projCtx ctx;
+    projPJ  fromProj, toProj;
+    projTransformPlan plan;
+    void    *thread;
+
+    int     line_count;
+    int     first_line;     /* for error messages */
+    char    *text;          /* the lines, each with its newline */
+    size_t  text_len, text_size;
+    size_t  line_start[BATCH_LINES];
+    char    *rest[BATCH_LINES];  /* after the coordinates, NULL for tags */
+    double  u[BATCH_LINES], v[BATCH_LINES], z[BATCH_LINES];
+    int     error[BATCH_LINES];
+    int     point_line[BATCH_LINES];
+    double  x[BATCH_LINES], y[BATCH_LINES], zz[BATCH_LINES];
+
+    char    *out;
+    size_t  out_len, out_size;
+} BATCH_JOB;
+
+typedef struct {
+    FILE    *fid;
+    char    *buf;
+    size_t  len, pos;
+    int     eof;
+} BATCH_READER;
+
+/* binary input, one file of x, y, z records or 2 or 3 column files */
+typedef struct {
+    int     count;
+    FILE    *fid[3];
+    PAFile  file[3];        /* if mapped */
+    void    *map_handle[3];
+    const char *map[3];
+    size_t  map_size[3], map_pos[3];
+} BIN_INPUT;
+
+static BATCH_JOB *jobs;
+
+/************************************************************************/
+/*                            batch_grow()                              */
+/************************************************************************/
+
+static char *batch_grow( char *buf, size_t *size, size_t needed )
+
+{
+    if( needed <= *size )
+        return buf;
+
+    while( *size < needed )
+        *size = *size ? *size * 2 : 65536;
+    if( (buf = (char *) realloc( buf, *size )) == NULL )
+        emess(3,"out of memory for batch");
+
+    return buf;
+}
+
+/************************************************************************/
+/*                          batch_read_line()                           */
+/*                                                                      */
+/*      Append the next input line to the text of a batch, cut as       */
+/*      fgets() is in process().  Returns 0 at end of file.             */
+/************************************************************************/
+
+static int batch_read_line( BATCH_READER *reader, BATCH_JOB *job )
+
+{
+    size_t kept = 0;
+    int found_newline = 0;
+    char *line;
+
+    job->text = batch_grow( job->text, &(job->text_size), 
+                            job->text_len + MAX_LINE + 2 );
+    line = job->text + job->text_len;
+
+    while( !found_newline ) {
+        char *start, *newline;
+        size_t n;
+
+        if (reader->pos == reader->len) {
+            if (reader->eof)
+                break;
+            reader->len = fread(reader->buf, 1, BATCH_READ_SIZE, reader->fid);
+            reader->pos = 0;
+            reader->eof = reader->len < BATCH_READ_SIZE;
+            continue;
+        }
+
+        start = reader->buf + reader->pos;
+        n = reader->len - reader->pos;
+        if ((newline = (char *) memchr(start, '\n', n)) != NULL) {
+            n = newline - start;
+            found_newline = 1;
+        }
+        reader->pos += n + found_newline;
+
+        /* overlong lines are cut, as with fgets() */
+        if (n > MAX_LINE - 1 - kept)
+            n = MAX_LINE - 1 - kept;
+        memcpy(line + kept, start, n);
+        kept += n;
+    }
+
+    if (kept == 0 && !found_newline)
+        return 0;
+
+    line[kept++] = '\n';
+    line[kept++] = '\0';
+    job->line_start[job->line_count++] = job->text_len;
+    job->text_len += kept;
+
+    return 1;
+}
+
+/************************************************************************/
+/*                             bin_open()                               */
+/*                                                                      */
+/*      Open one of the files of binary input, mapping it if possible.  */
+/************************************************************************/
+
+static int bin_open( BIN_INPUT *in, const char *name )
+
+{
+    projCtx ctx = pj_get_default_ctx();
+    int i = in->count;
+    PAFile file;
+
+    in->fid[i] = NULL;
+    in->file[i] = NULL;
+    in->map[i] = NULL;
+    in->map_size[i] = in->map_pos[i] = 0;
+
+    if (strcmp(name, "-") == 0) {
+        SET_BINARY_MODE(stdin);
+        in->fid[i] = stdin;
+    }
+    else if ((file = pj_ctx_fopen(ctx, name, "rb")) != NULL) {
+        long size;
+
+        if (pj_ctx_fseek(ctx, file, 0, SEEK_END) == 0
+            && (size = pj_ctx_ftell(ctx, file)) > 0
+            && (in->map[i] = (const char *) 
+                pj_ctx_fmap(ctx, file, 0, size, &(in->map_handle[i]))) 
+               != NULL) {
+            in->file[i] = file;
+            in->map_size[i] = size;
+        }
+        else {
+            pj_ctx_fclose(ctx, file);
+            in->fid[i] = fopen(name, "rb");
+        }
+    }
+
+    if (in->fid[i] == NULL && in->map[i] == NULL) {
+        emess(-2, (char *) name, "input file");
+        return 0;
+    }
+
+    in->count++;
+    return 1;
+}
+
+/************************************************************************/
+/*                             bin_close()                              */
+/************************************************************************/
+
+static void bin_close( BIN_INPUT *in )
+
+{
+    projCtx ctx = pj_get_default_ctx();
+    int i;
+
+    for (i = 0; i < in->count; i++) {
+        if (in->map[i] != NULL) {
+            pj_ctx_get_filemapapi(ctx)->FUnmap(in->map_handle[i]);
+            pj_ctx_fclose(ctx, in->file[i]);
+        }
+        else if (in->fid[i] != stdin)
+            fclose(in->fid[i]);
+    }
+    in->count = 0;
+}
+
+/************************************************************************/
+/*                              bin_read()                              */
+/************************************************************************/
+
+static size_t bin_read( BIN_INPUT *in, int i, void *buf, size_t size )
+
+{
+    if (in->map[i] == NULL)
+        return fread(buf, 1, size, in->fid[i]);
+
+    if (size > in->map_size[i] - in->map_pos[i])
+        size = in->map_size[i] - in->map_pos[i];
+    memcpy(buf, in->map[i] + in->map_pos[i], size);
+    in->map_pos[i] += size;
+
+    return size;
+}
+
+/************************************************************************/
+/*                         batch_read_binary()                          */
+/*                                                                      */
+/*      Fill a batch with the next points of binary input.  An          */
+/*      incomplete record at the end is dropped with a warning.         */
+/************************************************************************/
+
+static void batch_read_binary( BIN_INPUT *in, BATCH_JOB *job )
+
+{
+    size_t n, size;
+    int i;
+
+    if (in->count == 1) {
+        double *xyz;
+
+        job->text = batch_grow( job->text, &(job->text_size), 
+                                BATCH_LINES * 3 * sizeof(double) );
+        xyz = (double *) job->text;
+        size = bin_read(in, 0, xyz, BATCH_LINES * 3 * sizeof(double));
+        n = size / (3 * sizeof(double));
+        for (i = 0; i < (int) n; i++) {
+            job->u[i] = xyz[3 * i];
+            job->v[i] = xyz[3 * i + 1];
+            job->z[i] = xyz[3 * i + 2];
+        }
+    }
+    else {
+        size_t nz;
+
+        size = bin_read(in, 0, job->u, BATCH_LINES * sizeof(double));
+        n = bin_read(in, 1, job->v, BATCH_LINES * sizeof(double));
+        if (n != size)
+            emess(-1,"column files of different lengths");
+        if (n > size)
+            n = size;
+
+        if (in->count == 3) {
+            nz = bin_read(in, 2, job->z, BATCH_LINES * sizeof(double));
+            if (nz != n)
+                emess(-1,"column files of different lengths");
+            if (nz < n)
+                n = nz;
+        }
+        size = n;
+        n /= sizeof(double);
+        if (in->count == 2)
+            for (i = 0; i < (int) n; i++)
+                job->z[i] = 0.0;
+    }
+
+    if (n < BATCH_LINES && size % (in->count == 1 ? 3 * sizeof(double) 
+                                                   : sizeof(double)))
+        emess(-1,"incomplete binary record ignored");
+
+    job->line_count = (int) n;
+}
+
+/************************************************************************/
+/*                      batch_puts(), batch_printf()                    */
+/************************************************************************/
+
+static void batch_write( BATCH_JOB *job, const void *data, size_t len )
+
+{
+    job->out = batch_grow( job->out, &(job->out_size), job->out_len + len );
+    memcpy( job->out + job->out_len, data, len );
+    job->out_len += len;
+}
+
+static void batch_puts( BATCH_JOB *job, const char *s )
+
+{
+    batch_write( job, s, strlen(s) );
+}
+
+static void batch_printf( BATCH_JOB *job, const char *format, double value )
+
+{
+    char buf[MAX_LINE];
+
+    batch_write( job, buf, pj_format_double( buf, format, value ) - buf );
+}
+
+/************************************************************************/
+/*                             batch_run()                              */
+/*                                                                      */
+/*      Parse, transform and format the lines of a batch, as done by    */
+/*      process() for each line.                                        */
+/************************************************************************/
+
+static void batch_run( void *arg )
+
+{
+    BATCH_JOB *job = (BATCH_JOB *) arg;
+    char pline[40];
+    int i, n = 0;
+
+/* -------------------------------------------------------------------- */
+/*      Parse the lines, gathering the points to transform.             */
+/* -------------------------------------------------------------------- */
+    for (i = 0; i < job->line_count; i++) {
+        char *line = job->text + job->line_start[i], *s = line;
+
+        job->error[i] = 0;
+        if (bin_in) { /* read already */
+            job->rest[i] = (char *) "\n";
+            goto gather;
+        }
+        if (*s == tag) {
+            job->rest[i] = NULL;
+            continue;
+        }
+
+        if (reversein) {
+            job->v[i] = (*informat)(s, &s);
+            job->u[i] = (*informat)(s, &s);
+        } else {
+            job->u[i] = (*informat)(s, &s);
+            job->v[i] = (*informat)(s, &s);
+        }
+
+        job->z[i] = pj_strtod( s, &s );
+
+        if (job->v[i] == HUGE_VAL)
+            job->u[i] = HUGE_VAL;
+
+        if (!*s && (s > line)) --s; /* assumed we gobbled \n */
+        job->rest[i] = s;
+
+      gather:
+        if (job->u[i] != HUGE_VAL) {
+            job->point_line[n] = i;
+            job->x[n] = job->u[i];
+            job->y[n] = job->v[i];
+            job->zz[n] = job->z[i];
+            n++;
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Transform them in one call.  Points that failed, or all of      */
+/*      them if the call did, are transformed again one at a time to    */
+/*      get their error, as they would have been without -j.            */
+/* -------------------------------------------------------------------- */
+    if (n > 0) {
+        int failed = pj_transform_plan_execute( job->plan, n, 1, 
+                                                job->x, job->y, job->zz );
+        int k;
+
+        for (k = 0; k < n; k++) {
+            int line = job->point_line[k];
+
+            if (!failed && job->x[k] != HUGE_VAL) {
+                job->u[line] = job->x[k];
+                job->v[line] = job->y[k];
+                job->z[line] = job->zz[k];
+                continue;
+            }
+
+            pj_ctx_set_errno( job->ctx, 0 );
+            if( pj_transform_plan_execute( job->plan, 1, 0, job->u + line,
+                                           job->v + line, job->z + line ) )
+            {
+                job->u[line] = HUGE_VAL;
+                job->v[line] = HUGE_VAL;
+                job->error[line] = pj_ctx_get_errno( job->ctx );
+                if (job->error[line] == 0)
+                    job->error[line] = -1;
+            }
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Format the output lines.                                        */
+/* -------------------------------------------------------------------- */
+    job->out_len = 0;
+    for (i = 0; i < job->line_count; i++) {
+        char *line = job->text + job->line_start[i], *s = job->rest[i];
+        double u = job->u[i], v = job->v[i];
+
+        if (s == NULL) {
+            if (!bin_out)
+                batch_puts(job, line);
+            continue;
+        }
+
+        if (bin_out) { /* binary output */
+            double xyz[3];
+
+            xyz[0] = u;
+            xyz[1] = v;
+            xyz[2] = job->z[i];
+            batch_write(job, xyz, sizeof(xyz));
+            continue;
+        }
+
+        if (!bin_in && echoin) {
+            int t;
+            t = *s;
+            *s = '\0';
+            batch_puts(job, line);
+            *s = t;
+            batch_puts(job, "\t");
+        }
+
+        if (u == HUGE_VAL) /* error output */
+            batch_puts(job, oterr);
+
+        else if (pj_is_latlong(job->toProj) && !oform) {	/*ascii DMS output */
+            if (reverseout) {
+                batch_puts(job, rtodms(pline, v, 'N', 'S'));
+                batch_puts(job, "\t");
+                batch_puts(job, rtodms(pline, u, 'E', 'W'));
+            } else {
+                batch_puts(job, rtodms(pline, u, 'E', 'W'));
+                batch_puts(job, "\t");
+                batch_puts(job, rtodms(pline, v, 'N', 'S'));
+            }
+
+        } else {	/* x-y or decimal degree ascii output */
+            if ( pj_is_latlong(job->toProj) ) {
+                v *= RAD_TO_DEG;
+                u *= RAD_TO_DEG;
+            }
+            if (reverseout) {
+                batch_printf(job, oform, v); batch_puts(job, "\t");
+                batch_printf(job, oform, u);
+            } else {
+                batch_printf(job, oform, u); batch_puts(job, "\t");
+                batch_printf(job, oform, v);
+            }
+        }
+
+        batch_puts(job, " ");
+        if( oform != NULL )
+            batch_printf(job, oform, job->z[i]);
+        else
+            batch_printf(job, "%.3f", job->z[i]);
+        batch_puts(job, s);
+    }
+}
+
+/************************************************************************/
+/*                           process_batch()                            */
+/*                                                                      */
+/*      File processing function for -j and binary input, from fid or   */
+/*      bin.  The next batches are read while the first ones are        */
+/*      transformed.                                                    */
+/************************************************************************/
+
+static void process_batch(FILE *fid, BIN_INPUT *bin)
+
+{
+    BATCH_READER reader;
+    int done = 0;
+
+    reader.fid = fid;
+    reader.len = reader.pos = 0;
+    reader.eof = 0;
+    reader.buf = NULL;
+    if (bin == NULL
+        && (reader.buf = (char *) malloc(BATCH_READ_SIZE)) == NULL)
+        emess(3,"out of memory for batch");
+
+    while (!done) {
+        int j, i, job_count = 0, read_line;
+
+        for (j = 0; j < threads; j++) {
+            BATCH_JOB *job = jobs + j;
+
+            job->line_count = 0;
+            job->text_len = 0;
+            job->first_line = emess_dat.File_line + 1;
+            if (bin != NULL) {
+                batch_read_binary(bin, job);
+                emess_dat.File_line += job->line_count;
+            }
+            else
+                while (job->line_count < BATCH_LINES 
+                       && batch_read_line(&reader, job))
+                    ++emess_dat.File_line;
+
+            if (job->line_count < BATCH_LINES)
+                done = 1;
+            if (job->line_count == 0)
+                break;
+
+            /* run it here if no thread can be started */
+            if ((job->thread = pj_thread_start(batch_run, job)) == NULL)
+                batch_run(job);
+            job_count++;
+            if (done)
+                break;
+        }
+
+        read_line = emess_dat.File_line;
+        for (j = 0; j < job_count; j++) {
+            BATCH_JOB *job = jobs + j;
+
+            pj_thread_join(job->thread);
+            if (bin_out)
+                write_binary((double *) job->out, 
+                             job->out_len / (3 * sizeof(double)));
+            else
+                fwrite(job->out, 1, job->out_len, stdout);
+
+            /* reported at their own line, the read count kept for
+               the next batches */
+            for (i = 0; i < job->line_count; i++) {
+                if (job->error[i] != 0) {
+                    emess_dat.File_line = job->first_line + i;
+                    emess(-3,"pj_transform(): %s", 
+                          pj_strerrno(job->error[i]));
+                    emess_dat.File_line = read_line;
+                }
+            }
+        }
+    }
+
+    free(reader.buf);
+}
+
+/************************************************************************/
+/*                          batch_jobs_init()                           */
+/************************************************************************/
+
+static void batch_jobs_init()
+
+{
+    int j;
+
+    if ((jobs = (BATCH_JOB *) calloc(threads, sizeof(BATCH_JOB))) == NULL)
+        emess(3,"out of memory for batch");
+
+    for (j = 0; j < threads; j++) {
+        BATCH_JOB *job = jobs + j;
+
+        job->ctx = pj_ctx_alloc();
+        pj_ctx_set_errno_globals( job->ctx, 0 );
+        if (!(job->fromProj = pj_clone(job->ctx, fromProj))
+            || !(job->toProj = pj_clone(job->ctx, toProj)))
+            emess(3,"projection initialization failure\ncause: %s",
+                  pj_strerrno(pj_ctx_get_errno(job->ctx)));
+        if (!(job->plan = pj_transform_plan_create( job->fromProj, 
+                                                    job->toProj )))
+            emess(3,"transformation plan allocation failure");
+    }
+}
+
+/************************************************************************/
+/*                          batch_jobs_free()                           */
+/************************************************************************/
+
+static void batch_jobs_free()
+
+{
+    int j;
+
+    for (j = 0; j < threads; j++) {
+        BATCH_JOB *job = jobs + j;
+
+        pj_transform_plan_free( job->plan );
+        pj_free( job->fromProj );
+        pj_free( job->toProj );
+        pj_ctx_free( job->ctx );
+        free( job->text );
+        free( job->out );
+    }
+    free( jobs );
+}
+
+/************************************************************************/
+/*                           split_columns()                            */
+/*                                                                      */
+/*      Split a -c or -C argument into the x, y and optional z file     */
+/*      names, none of them empty.                                      */
+/************************************************************************/
+
+static void split_columns(char *arg, char **names)
+
+{
+    int c;
+
+    for (c = 0; c < 3; c++) {
+        names[c] = arg;
+        if ((arg = strchr(arg, ',')) != NULL)
+            *arg++ = '\0';
+        if (*names[c] == '\0' || arg == NULL)
+            break;
+    }
+    if (c == 0 || c == 3 || *names[c] == '\0')
+        emess(1,"expected x,y or x,y,z column files");
+}
+
+/*
+** With -S cs2cs serves transformations on a Unix socket instead of
+** reading input files.  Each worker, one per -j thread or just the main
+** one, accepts connections in turn and answers their requests in order
+** until the client closes it.  The workers keep their own context and a
+** few plans of the last definitions asked for, while the init cache and
+** the grids loaded are shared and stay warm for the life of the server.
+**
+** All fields are in the byte order of the host.  A request is
+**
+**     char   magic[4]        "PJS1"
+**     int    from_len, to_len, point_count
+**     char   from[from_len], to[to_len]
+**     double xyz[point_count][3]
+**
+** where from and to are definitions as for pj_init_plus(), without the
+** terminating nul.  Empty ones are the latlong of the other, or, both
+** empty, the definitions of the run line.  Coordinates are those of
+** pj_transform(), geographic ones in radians, as with -b.  The answer
+** is
+**
+**     char   magic[4]        "PJS1"
+**     int    error, point_count
+**     double xyz[point_count][3]
+**     int    status[point_count]
+**
+** error being that of the definitions or 0, and status that of each
+** point as by pj_transform_plan_execute_status().  No points follow a
+** non zero error.
+*/
+#ifdef HAVE_SERVE
+
+#define SERVE_MAGIC "PJS1"
+#define SERVE_PLANS 16          /* cached per worker */
+#define SERVE_MAX_DEFN 65536
+#define SERVE_MAX_POINTS 16777216
+
+typedef struct {
+    char    *from, *to;         /* NULL for an empty slot */
+    projPJ  fromProj, toProj;
+    projTransformPlan plan;
+} SERVE_PLAN;
+
+typedef struct {
+    projCtx ctx;
+    int     fd;                 /* listening socket */
+    SERVE_PLAN plans[SERVE_PLANS];
+    int     next_plan;          /* slot replaced next */
+    SERVE_PLAN run_line;        /* the definitions of the run line */
+} SERVE_WORKER;
+
+/************************************************************************/
+/*                             serve_io()                               */
+/*                                                                      */
+/*      Read or write all of len bytes.  0 on end of file or error.     */
+/************************************************************************/
+
+static int serve_io( int fd, void *buf, size_t len, int writing )
+
+{
+    char *p = (char *) buf;
+
+    while (len > 0) {
+        ssize_t n = writing ? write(fd, p, len) : read(fd, p, len);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        p += n;
+        len -= n;
+    }
+    return 1;
+}
+
+/************************************************************************/
+/*                          serve_plan_free()                           */
+/************************************************************************/
+
+static void serve_plan_free( SERVE_PLAN *sp )
+
+{
+    pj_transform_plan_free( sp->plan );
+    if (sp->fromProj != NULL)
+        pj_free( sp->fromProj );
+    if (sp->toProj != NULL)
+        pj_free( sp->toProj );
+    free( sp->from );
+    free( sp->to );
+    memset( sp, 0, sizeof(SERVE_PLAN) );
+}
+
+/************************************************************************/
+/*                            serve_plan()                              */
+/*                                                                      */
+/*      The plan of a pair of definitions, from the cache of the        */
+/*      worker or made in the slot replaced next.  NULL with *error     */
+/*      set if a definition or the plan fails.                          */
+/************************************************************************/
+
+static projTransformPlan serve_plan( SERVE_WORKER *w, const char *from,
+                                     const char *to, int *error )
+
+{
+    SERVE_PLAN *sp;
+    int i;
+
+    if (*from == '\0' && *to == '\0') {
+        if (w->run_line.plan == NULL)
+            *error = -1;
+        return w->run_line.plan;
+    }
+
+    for (i = 0; i < SERVE_PLANS; i++) {
+        sp = w->plans + i;
+        if (sp->from != NULL && strcmp(sp->from, from) == 0
+            && strcmp(sp->to, to) == 0)
+            return sp->plan;
+    }
+
+    sp = w->plans + w->next_plan;
+    w->next_plan = (w->next_plan + 1) % SERVE_PLANS;
+    serve_plan_free( sp );
+
+    pj_ctx_set_errno( w->ctx, 0 );
+    if (*from != '\0')
+        sp->fromProj = pj_init_plus_ctx( w->ctx, from );
+    if (*to != '\0' && (*from == '\0' || sp->fromProj != NULL))
+        sp->toProj = pj_init_plus_ctx( w->ctx, to );
+    if (sp->fromProj == NULL && sp->toProj != NULL)
+        sp->fromProj = pj_latlong_from_proj( sp->toProj );
+    else if (sp->toProj == NULL && sp->fromProj != NULL && *to == '\0')
+        sp->toProj = pj_latlong_from_proj( sp->fromProj );
+
+    if (sp->fromProj == NULL || sp->toProj == NULL
+        || (sp->plan = pj_transform_plan_create( sp->fromProj,
+                                                 sp->toProj )) == NULL
+        || (sp->from = strdup(from)) == NULL
+        || (sp->to = strdup(to)) == NULL) {
+        if ((*error = pj_ctx_get_errno( w->ctx )) == 0)
+            *error = -1;
+        serve_plan_free( sp );
+        return NULL;
+    }
+
+    return sp->plan;
+}
+
+/************************************************************************/
+/*                           serve_client()                             */
+/*                                                                      */
+/*      Answer the requests of one connection until it is closed.       */
+/************************************************************************/
+
+static void serve_client( SERVE_WORKER *w, int fd )
+
+{
+    char   *defn = NULL;
+    double *xyz = NULL;
+    int    *status = NULL;
+    long   allocated = 0;
+
+    for (;;) {
+        char  magic[4];
+        int   head[3], answer[2], error = 0;
+        long  n;
+        projTransformPlan plan;
+
+        if (!serve_io(fd, magic, 4, 0) || !serve_io(fd, head, sizeof(head), 0)
+            || memcmp(magic, SERVE_MAGIC, 4) != 0
+            || head[0] < 0 || head[0] > SERVE_MAX_DEFN
+            || head[1] < 0 || head[1] > SERVE_MAX_DEFN
+            || head[2] < 0 || head[2] > SERVE_MAX_POINTS)
+            break;
+        n = head[2];
+
+        defn = (char *) realloc( defn, head[0] + head[1] + 2 );
+        if (n > allocated) {
+            free( xyz );
+            free( status );
+            xyz = (double *) malloc( n * 3 * sizeof(double) );
+            status = (int *) malloc( n * sizeof(int) );
+            allocated = n;
+        }
+        if (defn == NULL || (n > 0 && (xyz == NULL || status == NULL))) {
+            emess(-3,"out of memory for a request of %ld points", n);
+            break;
+        }
+
+        /* from and to, each nul terminated */
+        if (!serve_io(fd, defn, head[0], 0)
+            || !serve_io(fd, defn + head[0] + 1, head[1], 0)
+            || !serve_io(fd, xyz, n * 3 * sizeof(double), 0))
+            break;
+        defn[head[0]] = '\0';
+        defn[head[0] + head[1] + 1] = '\0';
+
+        if ((plan = serve_plan(w, defn, defn + head[0] + 1, &error)) != NULL)
+            pj_transform_plan_execute_status( plan, n, 3, xyz, xyz + 1,
+                                              xyz + 2, status );
+        else
+            n = 0;
+
+        answer[0] = error;
+        answer[1] = (int) n;
+        if (!serve_io(fd, (void *) SERVE_MAGIC, 4, 1)
+            || !serve_io(fd, answer, sizeof(answer), 1)
+            || !serve_io(fd, xyz, n * 3 * sizeof(double), 1)
+            || !serve_io(fd, status, n * sizeof(int), 1))
+            break;
+    }
+
+    free( defn );
+    free( xyz );
+    free( status );
+}
+
+/************************************************************************/
+/*                           serve_worker()                             */
+/************************************************************************/
+
+static void serve_worker( void *arg )
+
+{
+    SERVE_WORKER *w = (SERVE_WORKER *) arg;
+
+    for (;;) {
+        int fd = accept(w->fd, NULL, NULL);
+
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            emess(3,"accept() on %s failed: %s", serve_path,
+                  strerror(errno));
+        }
+        serve_client(w, fd);
+        close(fd);
+    }
+}
+
+/************************************************************************/
+/*                              serve()                                 */
+/*                                                                      */
+/*      Listen on serve_path and run the workers, never returning.      */
+/*      fromProj and toProj may be NULL if the run line has no          */
+/*      definitions.                                                    */
+/************************************************************************/
+
+static void serve( void )
+
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    SERVE_WORKER *workers;
+    int fd, j, count = threads > 0 ? threads : 1;
+
+    if (strlen(serve_path) >= sizeof(addr.sun_path))
+        emess(3,"socket path too long: %s", serve_path);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, serve_path);
+
+    /* a socket left by an earlier server */
+    if (stat(serve_path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(serve_path);
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+        || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0
+        || listen(fd, 64) != 0)
+        emess(3,"cannot listen on %s: %s", serve_path, strerror(errno));
+    signal(SIGPIPE, SIG_IGN);
+
+    if ((workers = (SERVE_WORKER *) calloc(count, sizeof(SERVE_WORKER)))
+        == NULL)
+        emess(3,"out of memory for workers");
+
+    for (j = 0; j < count; j++) {
+        SERVE_WORKER *w = workers + j;
+
+        w->ctx = pj_ctx_alloc();
+        pj_ctx_set_errno_globals( w->ctx, 0 );
+        w->fd = fd;
+        if (fromProj != NULL) {
+            if (!(w->run_line.fromProj = pj_clone(w->ctx, fromProj))
+                || !(w->run_line.toProj = pj_clone(w->ctx, toProj))
+                || !(w->run_line.plan = pj_transform_plan_create(
+                         w->run_line.fromProj, w->run_line.toProj )))
+                emess(3,"projection initialization failure\ncause: %s",
+                      pj_strerrno(pj_ctx_get_errno(w->ctx)));
+        }
+        /* the last worker runs here */
+        if (j < count - 1 && pj_thread_start(serve_worker, w) == NULL)
+            emess(3,"cannot start worker thread");
+    }
+    serve_worker(workers + count - 1);
+}
+
+#endif /* HAVE_SERVE */
+
 /************************************************************************/
 /*                                main()                                */
 /************************************************************************/
@@ -189,6 +1170,25 @@ int main(int argc, char **argv)
               case 'v': /* monitor dump of initialization */
                 mon = 1;
                 continue;
+              case 'b': /* binary I/O */
+                bin_in = bin_out = 1;
+                continue;
+              case 'i': /* input binary */
+                bin_in = 1;
+                continue;
+              case 'o': /* output binary */
+                bin_out = 1;
+                continue;
+              case 'c': /* binary input columns */
+                if (--argc <= 0) goto noargument;
+                split_columns(*++argv, column_in);
+                bin_in = 1;
+                continue;
+              case 'C': /* binary output columns */
+                if (--argc <= 0) goto noargument;
+                split_columns(*++argv, column_out);
+                bin_out = 1;
+                continue;
               case 'I': /* alt. method to spec inverse */
                 inverse = 1;
                 continue;
@@ -283,6 +1283,19 @@ int main(int argc, char **argv)
               case 's': /* reverse output */
                 reverseout = 1;
                 continue;
+              case 'j': /* batches on n threads */
+                if (--argc <= 0) goto noargument;
+                if ((threads = atoi(*++argv)) < 1)
+                    emess(1,"-j argument must be at least 1");
+                continue;
+              case 'S': /* serve on a socket */
+                if (--argc <= 0) goto noargument;
+#ifdef HAVE_SERVE
+                serve_path = *++argv;
+#else
+                emess(1,"-S is not supported on this platform");
+#endif
+                continue;
               case 'd': /* set debug level */
                 if (--argc <= 0) goto noargument;
                 pj_ctx_set_debug( pj_get_default_ctx(), atoi(*++argv));
@@ -317,6 +1330,12 @@ int main(int argc, char **argv)
     if (eargc == 0 ) /* if no specific files force sysin */
         eargv[eargc++] = "-";
 
+#ifdef HAVE_SERVE
+    /* only the definitions of the requests */
+    if (serve_path != NULL && from_argc == 0 && to_argc == 0)
+        serve();
+#endif
+
     /* 
      * If the user has requested inverse, then just reverse the
      * coordinate systems.
@@ -401,7 +1420,7 @@ int main(int argc, char **argv)
 
     /* set input formating control */
     if( !fromProj->is_latlong )
-        informat = strtod;
+        informat = pj_strtod;
     else {
         informat = dmstor;
     }
@@ -409,8 +1428,61 @@ int main(int argc, char **argv)
     if( !toProj->is_latlong && !oform )
         oform = "%.2f";
 
+    /* resolve the transformation pipeline once for all input points */
+    if (!(transformPlan = pj_transform_plan_create( fromProj, toProj )))
+        emess(3,"transformation plan allocation failure");
+
+#ifdef HAVE_SERVE
+    if (serve_path != NULL)
+        serve();
+#endif
+
+    /* binary input is always read in batches */
+    if (bin_in && threads == 0)
+        threads = 1;
+
+    if (threads > 0)
+        batch_jobs_init();
+
+    if (bin_out) {
+        SET_BINARY_MODE(stdout);
+        for (i = 0; i < 3 && column_out[i] != NULL; i++)
+            if ((column_fid[i] = fopen(column_out[i], "wb")) == NULL)
+                emess(3,"cannot create column file %s", column_out[i]);
+    }
+
+    /* binary input from column files instead of the input files */
+    if (column_in[0] != NULL) {
+        BIN_INPUT bin;
+
+        bin.count = 0;
+        for (i = 0; i < 3 && column_in[i] != NULL; i++)
+            if (!bin_open(&bin, column_in[i]))
+                exit(1);
+        emess_dat.File_name = column_in[0];
+        emess_dat.File_line = 0;
+        process_batch(NULL, &bin);
+        bin_close(&bin);
+        emess_dat.File_name = 0;
+        eargc = 0;
+    }
+
     /* process input file list */
     for ( ; eargc-- ; ++eargv) {
+        if (bin_in) {
+            BIN_INPUT bin;
+
+            bin.count = 0;
+            if (!bin_open(&bin, **eargv == '-' ? "-" : *eargv))
+                continue;
+            emess_dat.File_name = **eargv == '-' ? "<stdin>" : *eargv;
+            emess_dat.File_line = 0;
+            process_batch(NULL, &bin);
+            bin_close(&bin);
+            emess_dat.File_name = 0;
+            continue;
+        }
+
         if (**eargv == '-') {
             fid = stdin;
             emess_dat.File_name = "<stdin>";
@@ -423,11 +1495,22 @@ int main(int argc, char **argv)
             emess_dat.File_name = *eargv;
         }
         emess_dat.File_line = 0;
-        process(fid);
+        if (threads > 0)
+            process_batch(fid, NULL);
+        else
+            process(fid);
         fclose(fid);
         emess_dat.File_name = 0;
     }
 
+    if (threads > 0)
+        batch_jobs_free();
+
+    for (i = 0; i < 3 && column_out[i] != NULL; i++)
+        fclose(column_fid[i]);
+
+    pj_transform_plan_free( transformPlan );
+
     if( fromProj != NULL )
         pj_free( fromProj );
     if( toProj != NULL )
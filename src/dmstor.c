@@ -3,8 +3,6 @@
 #include <string.h>
 #include <ctype.h>
 
-static double proj_strtod(char *nptr, char **endptr);
-
 /* following should be sufficient for all but the rediculous */
 #define MAX_WORK 64
 	static const char
@@ -40,7 +38,7 @@ dmstor_ctx(projCtx ctx, const char *is, char **rs) {
 	else sign = '+';
 	for (v = 0., nl = 0 ; nl < 3 ; nl = n + 1 ) {
 		if (!(isdigit(*s) || *s == '.')) break;
-		if ((tv = proj_strtod(s, &s)) == HUGE_VAL)
+		if ((tv = pj_strtod(s, &s)) == HUGE_VAL)
 			return tv;
 		switch (*s) {
 		case 'D': case 'd':
@@ -80,34 +78,3 @@ dmstor_ctx(projCtx ctx, const char *is, char **rs) {
 		*rs = (char *)is + (s - work);
 	return v;
 }
-
-static double
-proj_strtod(char *nptr, char **endptr) 
-
-{
-    char c, *cp = nptr;
-    double result;
-
-    /*
-     * Scan for characters which cause problems with VC++ strtod()
-     */
-    while ((c = *cp) != '\0') {
-        if (c == 'd' || c == 'D') {
-
-            /*
-             * Found one, so NUL it out, call strtod(),
-             * then restore it and return
-             */
-            *cp = '\0';
-            result = strtod(nptr, endptr);
-            *cp = c;
-            return result;
-        }
-        ++cp;
-    }
-
-    /* no offending characters, just handle normally */
-
-    return strtod(nptr, endptr);
-}
-
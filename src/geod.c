@@ -7,19 +7,22 @@
 # include <string.h>
 
 # define MAXLINE 200
+# define BATCH_LINES 4096	/* lines per geod_inverse_n() call with -j */
+# define BATCH_READ_SIZE 1048576
 # define MAX_PARGS 50
 # define TAB putchar('\t')
 	static int
 fullout = 0,	/* output full set of geodesic values */
 tag = '#',	/* beginning of line tag character */
 pos_azi = 0,	/* output azimuths as positive values */
+threads = 0,	/* != 0 process input in batches on this many threads */
 inverse = 0;	/* != 0 then inverse geodesic */
 	static char
 *oform = (char *)0,	/* output format for decimal degrees */
 *osform = "%.3f",	/* output format for S */
 pline[50],		/* work string */
 *usage =
-"%s\nusage: %s [ -afFIptTwW [args] ] [ +opts[=arg] ] [ files ]\n";
+"%s\nusage: %s [ -afFIjptTwW [args] ] [ +opts[=arg] ] [ files ]\n";
 	static void
 printLL(double p, double l) {
 	if (oform) {
@@ -123,6 +126,251 @@ process(FILE *fid) {
 	}
 }
 
+/*
+** With -j the input is read in large blocks and cut into batches of
+** lines, each parsed, solved with a single geod_inverse_n() or
+** geod_direct_n() call and formatted on a worker thread.  The ellipsoid
+** is only read by the workers.  The output of the batches is written in
+** input order.
+*/
+	typedef struct {
+	double lat_1, lon_1, lat_2, lon_2, az12, az21, dist; /* radians, m */
+} BATCH_POINT;
+	typedef struct {
+	void *thread;
+	int line_count;
+	char *text;		/* the lines, each with its newline */
+	size_t text_len, text_size;
+	size_t line_start[BATCH_LINES];
+	char *rest[BATCH_LINES];	/* after the values, NULL for tags */
+	BATCH_POINT point[BATCH_LINES];
+	int point_line[BATCH_LINES];
+	double in[4][BATCH_LINES], res[3][BATCH_LINES];	/* degrees, m */
+	char *out;
+	size_t out_len, out_size;
+} BATCH_JOB;
+	typedef struct {
+	FILE *fid;
+	char *buf;
+	size_t len, pos;
+	int eof;
+} BATCH_READER;
+	static BATCH_JOB
+*jobs;
+	static char *
+batch_grow(char *buf, size_t *size, size_t needed) {
+	if (needed <= *size)
+		return buf;
+	while (*size < needed)
+		*size = *size ? *size * 2 : 65536;
+	if ((buf = (char *)realloc(buf, *size)) == NULL)
+		emess(3,"out of memory for batch");
+	return buf;
+}
+	static int	/* next line of a batch, cut as fgets() is in process() */
+batch_read_line(BATCH_READER *reader, BATCH_JOB *job) {
+	size_t kept = 0;
+	int found_newline = 0;
+	char *line;
+
+	job->text = batch_grow(job->text, &job->text_size,
+		job->text_len + MAXLINE + 2);
+	line = job->text + job->text_len;
+	while (!found_newline) {
+		char *start, *newline;
+		size_t n;
+
+		if (reader->pos == reader->len) {
+			if (reader->eof)
+				break;
+			reader->len = fread(reader->buf, 1, BATCH_READ_SIZE,
+				reader->fid);
+			reader->pos = 0;
+			reader->eof = reader->len < BATCH_READ_SIZE;
+			continue;
+		}
+		start = reader->buf + reader->pos;
+		n = reader->len - reader->pos;
+		if ((newline = (char *)memchr(start, '\n', n)) != NULL) {
+			n = newline - start;
+			found_newline = 1;
+		}
+		reader->pos += n + found_newline;
+		/* overlong lines are cut, as with fgets() */
+		if (n > MAXLINE - 1 - kept)
+			n = MAXLINE - 1 - kept;
+		(void)memcpy(line + kept, start, n);
+		kept += n;
+	}
+	if (kept == 0 && !found_newline)
+		return 0;
+	line[kept++] = '\n';
+	line[kept++] = '\0';
+	job->line_start[job->line_count++] = job->text_len;
+	job->text_len += kept;
+	return 1;
+}
+	static void
+batch_puts(BATCH_JOB *job, const char *s) {
+	size_t len = strlen(s);
+
+	job->out = batch_grow(job->out, &job->out_size, job->out_len + len);
+	(void)memcpy(job->out + job->out_len, s, len);
+	job->out_len += len;
+}
+	static void
+batch_printf(BATCH_JOB *job, const char *format, double value) {
+	char buf[MAXLINE];
+
+	(void)pj_format_double(buf, format, value);
+	batch_puts(job, buf);
+}
+	static void
+batch_LL(BATCH_JOB *job, double p, double l) {
+	char work[50];
+
+	if (oform) {
+		batch_printf(job, oform, p * RAD_TO_DEG); batch_puts(job, "\t");
+		batch_printf(job, oform, l * RAD_TO_DEG);
+	} else {
+		batch_puts(job, rtodms(work, p, 'N', 'S')); batch_puts(job, "\t");
+		batch_puts(job, rtodms(work, l, 'E', 'W'));
+	}
+}
+	static void
+batch_azi(BATCH_JOB *job, double az) {
+	char work[50];
+
+	if (oform)
+		batch_printf(job, oform, az * RAD_TO_DEG);
+	else
+		batch_puts(job, rtodms(work, az, 0, 0));
+}
+	static void	/* parse, solve and format a batch as process() does */
+batch_run(void *arg) {
+	BATCH_JOB *job = (BATCH_JOB *)arg;
+	double degree = PI/180;
+	int i, k, n = 0;
+
+	/* parse the lines, gathering the points in degrees */
+	for (i = 0; i < job->line_count; ++i) {
+		char *line = job->text + job->line_start[i], *s = line;
+		BATCH_POINT *pt = job->point + i;
+
+		if (*s == tag) {
+			job->rest[i] = NULL;
+			continue;
+		}
+		pt->lat_1 = dmstor(s, &s);
+		pt->lon_1 = dmstor(s, &s);
+		job->in[0][n] = pt->lat_1 / degree;
+		job->in[1][n] = pt->lon_1 / degree;
+		if (inverse) {
+			pt->lat_2 = dmstor(s, &s);
+			pt->lon_2 = dmstor(s, &s);
+			job->in[2][n] = pt->lat_2 / degree;
+			job->in[3][n] = pt->lon_2 / degree;
+		} else {
+			pt->az12 = dmstor(s, &s);
+			pt->dist = strtod(s, &s) * to_meter;
+			job->in[2][n] = pt->az12 / degree;
+			job->in[3][n] = pt->dist;
+		}
+		if (!*s && (s > line)) --s; /* assumed we gobbled \n */
+		job->rest[i] = s;
+		job->point_line[n++] = i;
+	}
+	/* solve them in one call */
+	if (inverse)
+		geod_inverse_n(&GlobalGeodesic, n, job->in[0], job->in[1],
+			job->in[2], job->in[3], job->res[0], job->res[1],
+			job->res[2]);
+	else
+		geod_direct_n(&GlobalGeodesic, n, job->in[0], job->in[1],
+			job->in[2], job->in[3], job->res[0], job->res[1],
+			job->res[2]);
+	for (k = 0; k < n; ++k) {
+		BATCH_POINT *pt = job->point + job->point_line[k];
+		double azi2 = job->res[2][k];
+
+		azi2 += azi2 >= 0 ? -180 : 180; /* Compute back azimuth */
+		pt->az21 = azi2 * degree;
+		if (inverse) {
+			pt->dist = job->res[0][k];
+			pt->az12 = job->res[1][k] * degree;
+		} else {
+			pt->lat_2 = job->res[0][k] * degree;
+			pt->lon_2 = job->res[1][k] * degree;
+		}
+		if (pos_azi) {
+			if (pt->az12 < 0.) pt->az12 += TWOPI;
+			if (pt->az21 < 0.) pt->az21 += TWOPI;
+		}
+	}
+	/* format the output lines */
+	job->out_len = 0;
+	for (i = 0; i < job->line_count; ++i) {
+		BATCH_POINT *pt = job->point + i;
+
+		if (job->rest[i] == NULL) {
+			batch_puts(job, job->text + job->line_start[i]);
+			continue;
+		}
+		if (fullout) {
+			batch_LL(job, pt->lat_1, pt->lon_1); batch_puts(job, "\t");
+			batch_LL(job, pt->lat_2, pt->lon_2); batch_puts(job, "\t");
+		}
+		if (fullout || inverse) {
+			batch_azi(job, pt->az12); batch_puts(job, "\t");
+			batch_azi(job, pt->az21); batch_puts(job, "\t");
+			batch_printf(job, osform, pt->dist * fr_meter);
+		} else {
+			batch_LL(job, pt->lat_2, pt->lon_2); batch_puts(job, "\t");
+			batch_azi(job, pt->az21);
+		}
+		batch_puts(job, job->rest[i]);
+	}
+}
+	static void	/* file processing function for -j */
+process_batch(FILE *fid) {
+	BATCH_READER reader;
+	int done = 0;
+
+	reader.fid = fid;
+	reader.len = reader.pos = 0;
+	reader.eof = 0;
+	if ((reader.buf = (char *)malloc(BATCH_READ_SIZE)) == NULL)
+		emess(3,"out of memory for batch");
+	while (!done) {
+		int j, job_count = 0;
+
+		for (j = 0; j < threads; ++j) {
+			BATCH_JOB *job = jobs + j;
+
+			job->line_count = 0;
+			job->text_len = 0;
+			while (job->line_count < BATCH_LINES
+				&& batch_read_line(&reader, job)) ;
+			emess_dat.File_line += job->line_count;
+			if (job->line_count < BATCH_LINES)
+				done = 1;
+			if (job->line_count == 0)
+				break;
+			/* run it here if no thread can be started */
+			if ((job->thread = pj_thread_start(batch_run, job)) == NULL)
+				batch_run(job);
+			job_count++;
+			if (done)
+				break;
+		}
+		for (j = 0; j < job_count; ++j) {
+			pj_thread_join(jobs[j].thread);
+			(void)fwrite(jobs[j].out, 1, jobs[j].out_len, stdout);
+		}
+	}
+	free(reader.buf);
+}
+
 static char *pargv[MAX_PARGS];
 static int   pargc = 0;
 
@@ -192,6 +440,11 @@ noargument:		   emess(1,"missing argument for -%c",*arg);
 			case 'p': /* output azimuths as positive */
 				pos_azi = 1;
 				continue;
+			case 'j': /* batches on n threads */
+				if (--argc <= 0) goto noargument;
+				if ((threads = atoi(*++argv)) < 1)
+					emess(1,"-j argument must be at least 1");
+				continue;
 			default:
 				emess(1, "invalid option: -%c",*arg);
 				break;
@@ -216,6 +469,9 @@ noargument:		   emess(1,"missing argument for -%c",*arg);
 	else { /* process input file list */
 		if (eargc == 0) /* if no specific files force sysin */
 			eargv[eargc++] = "-";
+		if (threads > 0 && (jobs = (BATCH_JOB *)
+			calloc(threads, sizeof(BATCH_JOB))) == NULL)
+			emess(3,"out of memory for batch");
 		for ( ; eargc-- ; ++eargv) {
 			if (**eargv == '-') {
 				fid = stdin;
@@ -228,10 +484,18 @@ noargument:		   emess(1,"missing argument for -%c",*arg);
 				emess_dat.File_name = *eargv;
 			}
 			emess_dat.File_line = 0;
-			process(fid);
+			if (threads > 0)
+				process_batch(fid);
+			else
+				process(fid);
 			(void)fclose(fid);
 			emess_dat.File_name = (char *)0;
 		}
+		for (c = 0; c < threads; ++c) {
+			free(jobs[c].text);
+			free(jobs[c].out);
+		}
+		free(jobs);
 	}
 	exit(0); /* normal completion */
 }
@@ -59,8 +59,5 @@ geod_set(int argc, char **argv) {
 			emess(1,"no interval divisor selected");
 	}
 	/* free up linked list */
-	for ( ; start; start = curr) {
-		curr = start->next;
-		pj_dalloc(start);
-	}
+	pj_free_paralist(start);
 }
@@ -267,10 +267,22 @@ void geod_init(struct geod_geodesic* g, real a, real f) {
   C4coeff(g);
 }
 
-void geod_lineinit(struct geod_geodesicline* l,
-                   const struct geod_geodesic* g,
-                   real lat1, real lon1, real azi1, unsigned caps) {
-  real alp1, cbet1, sbet1, phi, eps;
+/* The reduced latitude of the start of a line, which does not depend on its
+ * azimuth */
+static void linestart(const struct geod_geodesic* g, real lat1,
+                      real* psbet1, real* pcbet1) {
+  real phi = lat1 * degree;
+  /* Ensure cbet1 = +epsilon at poles */
+  *psbet1 = g->f1 * sin(phi);
+  *pcbet1 = fabs(lat1) == 90 ? tiny : cos(phi);
+  norm2(psbet1, pcbet1);
+}
+
+static void lineinit_int(struct geod_geodesicline* l,
+                         const struct geod_geodesic* g,
+                         real lat1, real lon1, real azi1, unsigned caps,
+                         real sbet1, real cbet1) {
+  real alp1, eps;
   l->a = g->a;
   l->f = g->f;
   l->b = g->b;
@@ -291,11 +303,6 @@ void geod_lineinit(struct geod_geodesicline* l,
    * problems directly than to skirt them. */
   l->salp1 =      l->azi1  == -180 ? 0 : sin(alp1);
   l->calp1 = fabs(l->azi1) ==   90 ? 0 : cos(alp1);
-  phi = lat1 * degree;
-  /* Ensure cbet1 = +epsilon at poles */
-  sbet1 = l->f1 * sin(phi);
-  cbet1 = fabs(lat1) == 90 ? tiny : cos(phi);
-  norm2(&sbet1, &cbet1);
   l->dn1 = sqrt(1 + g->ep2 * sq(sbet1));
 
   /* Evaluate alp0 from sin(alp1) * cos(bet1) = sin(alp0), */
@@ -356,6 +363,28 @@ void geod_lineinit(struct geod_geodesicline* l,
   }
 }
 
+void geod_lineinit(struct geod_geodesicline* l,
+                   const struct geod_geodesic* g,
+                   real lat1, real lon1, real azi1, unsigned caps) {
+  real sbet1, cbet1;
+  linestart(g, lat1, &sbet1, &cbet1);
+  lineinit_int(l, g, lat1, lon1, azi1, caps, sbet1, cbet1);
+}
+
+/* The line of azimuth -azi1 from the same point as l, of azimuth azi1 in
+ * (0, 180).  Only the terms odd in the sine of the azimuth change sign, so
+ * that the series of l are kept. */
+static void linemirror(const struct geod_geodesicline* l,
+                       struct geod_geodesicline* m) {
+  *m = *l;
+  m->azi1 = -l->azi1;
+  m->salp1 = -l->salp1;
+  m->salp0 = -l->salp0;
+  m->somg1 = -l->somg1;
+  m->A3c = -l->A3c;
+  m->A4 = -l->A4;
+}
+
 real geod_genposition(const struct geod_geodesicline* l,
                       unsigned flags, real s12_a12,
                       real* plat2, real* plon2, real* pazi2,
@@ -563,6 +592,92 @@ void geod_position(const struct geod_geodesicline* l, real s12,
   geod_genposition(l, FALSE, s12, plat2, plon2, pazi2, 0, 0, 0, 0, 0);
 }
 
+/* Sine and cosine of a small angle, |x| <= 1/64, to round off */
+static void sincossmall(real x, real* sinx, real* cosx) {
+  real x2 = x * x;
+  *sinx = x * (1 - x2/6 * (1 - x2/20 * (1 - x2/42 * (1 - x2/72))));
+  *cosx = 1 - x2/2 * (1 - x2/12 * (1 - x2/30 * (1 - x2/56)));
+}
+
+void geod_line_sample(const struct geod_geodesicline* l,
+                      real s0, real ds, long n,
+                      real lat[], real lon[], real azi[]) {
+  /* Number of steps of the recurrence between exact evaluations */
+  enum { reseed = 16 };
+  real scale = l->b * (1 + l->A1m1), stau12 = 0, ctau12 = 1, sdtau, cdtau;
+  boolx dolon = lon && (l->caps & GEOD_LONGITUDE & OUT_ALL);
+  long k;
+
+  if (!(l->caps & GEOD_DISTANCE_IN & OUT_ALL) || n <= 0)
+    return;
+  sdtau = sin(ds / scale); cdtau = cos(ds / scale);
+
+  for (k = 0; k < n; ++k) {
+    real
+      s12 = s0 + k * ds,
+      tau12 = s12 / scale,
+      B12, sig12, ssig12, csig12, ssig2, csig2, sbet2, cbet2, d;
+    /* sin and cos of tau12 = tau0 + k * dtau by rotation */
+    if (k % reseed == 0) {
+      stau12 = sin(tau12); ctau12 = cos(tau12);
+    } else {
+      real t = stau12 * cdtau + ctau12 * sdtau;
+      ctau12 = ctau12 * cdtau - stau12 * sdtau;
+      stau12 = t;
+    }
+    /* tau2 = tau1 + tau12, as in geod_genposition */
+    B12 = - SinCosSeries(TRUE,
+                         l->stau1 * ctau12 + l->ctau1 * stau12,
+                         l->ctau1 * ctau12 - l->stau1 * stau12,
+                         l->C1pa, nC1p);
+    d = B12 - l->B11;
+    sig12 = tau12 - d;
+    if (fabs(l->f) > 0.01 || !(fabs(d) <= 1/(real)64)) {
+      /* Newton correction needed or large series term, as usual */
+      real serr;
+      ssig12 = sin(sig12); csig12 = cos(sig12);
+      if (fabs(l->f) > 0.01) {
+        ssig2 = l->ssig1 * csig12 + l->csig1 * ssig12;
+        csig2 = l->csig1 * csig12 - l->ssig1 * ssig12;
+        B12 = SinCosSeries(TRUE, ssig2, csig2, l->C1a, nC1);
+        serr = (1 + l->A1m1) * (sig12 + (B12 - l->B11)) - s12 / l->b;
+        sig12 = sig12 - serr / sqrt(1 + l->k2 * sq(ssig2));
+        ssig12 = sin(sig12); csig12 = cos(sig12);
+      }
+    } else {
+      /* sig12 = tau12 - d with d small */
+      real sd, cd;
+      sincossmall(d, &sd, &cd);
+      ssig12 = stau12 * cd - ctau12 * sd;
+      csig12 = ctau12 * cd + stau12 * sd;
+    }
+
+    /* sig2 = sig1 + sig12 */
+    ssig2 = l->ssig1 * csig12 + l->csig1 * ssig12;
+    csig2 = l->csig1 * csig12 - l->ssig1 * ssig12;
+    sbet2 = l->calp0 * ssig2;
+    cbet2 = hypotx(l->salp0, l->calp0 * csig2);
+    if (cbet2 == 0)
+      cbet2 = csig2 = tiny;
+
+    if (dolon) {
+      real
+        somg2 = l->salp0 * ssig2, comg2 = csig2,
+        omg12 = atan2(somg2 * l->comg1 - comg2 * l->somg1,
+                      comg2 * l->comg1 + somg2 * l->somg1),
+        lam12 = omg12 + l->A3c *
+        ( sig12 + (SinCosSeries(TRUE, ssig2, csig2, l->C3a, nC3-1)
+                   - l->B31));
+      lon[k] = AngNormalize(AngNormalize(l->lon1) +
+                            AngNormalize2(lam12 / degree));
+    }
+    if (lat)
+      lat[k] = atan2(sbet2, l->f1 * cbet2) / degree;
+    if (azi)
+      azi[k] = 0 - atan2(-l->salp0, l->calp0 * csig2) / degree;
+  }
+}
+
 real geod_gendirect(const struct geod_geodesic* g,
                     real lat1, real lon1, real azi1,
                     unsigned flags, real s12_a12,
@@ -595,14 +710,30 @@ void geod_direct(const struct geod_geodesic* g,
                  0, 0, 0, 0, 0);
 }
 
-real geod_geninverse(const struct geod_geodesic* g,
-                     real lat1, real lon1, real lat2, real lon2,
-                     real* ps12, real* pazi1, real* pazi2,
-                     real* pm12, real* pM12, real* pM21, real* pS12) {
+/* The terms of a point of the inverse problem which do not depend on the
+ * other point: rounded latitude, normalized longitude, and the sine and
+ * cosine of the reduced latitude. */
+static void inversepoint(const struct geod_geodesic* g,
+                         struct geod_inverseorigin* o, real lat, real lon) {
+  real phi;
+  o->lat = AngRound(lat);
+  o->lon = AngNormalize(lon);
+  phi = o->lat * degree;
+  /* Ensure cbet = +epsilon at poles */
+  o->sbet = g->f1 * sin(phi);
+  o->cbet = fabs(o->lat) == 90 ? tiny : cos(phi);
+  norm2(&o->sbet, &o->cbet);
+}
+
+static real geninverse_int(const struct geod_geodesic* g,
+                           const struct geod_inverseorigin* p1,
+                           const struct geod_inverseorigin* p2,
+                           real* ps12, real* pazi1, real* pazi2,
+                           real* pm12, real* pM12, real* pM21, real* pS12) {
   real s12 = 0, azi1 = 0, azi2 = 0, m12 = 0, M12 = 0, M21 = 0, S12 = 0;
-  real lon12;
+  real lon12, lat1, lat2;
   int latsign, lonsign, swapp;
-  real phi, sbet1, cbet1, sbet2, cbet2, s12x = 0, m12x = 0;
+  real sbet1, cbet1, sbet2, cbet2, s12x = 0, m12x = 0;
   real dn1, dn2, lam12, slam12, clam12;
   real a12 = 0, sig12, calp1 = 0, salp1 = 0, calp2 = 0, salp2 = 0;
   /* index zero elements of these arrays are unused */
@@ -621,21 +752,23 @@ real geod_geninverse(const struct geod_geodesic* g,
   /* Compute longitude difference (AngDiff does this carefully).  Result is
    * in [-180, 180] but -180 is only for west-going geodesics.  180 is for
    * east-going and meridional geodesics. */
-  lon12 = AngDiff(AngNormalize(lon1), AngNormalize(lon2));
+  lon12 = AngDiff(p1->lon, p2->lon);
   /* If very close to being on the same half-meridian, then make it so. */
   lon12 = AngRound(lon12);
   /* Make longitude difference positive. */
   lonsign = lon12 >= 0 ? 1 : -1;
   lon12 *= lonsign;
-  /* If really close to the equator, treat as on equator. */
-  lat1 = AngRound(lat1);
-  lat2 = AngRound(lat2);
+  /* If really close to the equator, treat as on equator (done by
+   * inversepoint). */
   /* Swap points so that point with higher (abs) latitude is point 1 */
-  swapp = fabs(lat1) >= fabs(lat2) ? 1 : -1;
+  swapp = fabs(p1->lat) >= fabs(p2->lat) ? 1 : -1;
   if (swapp < 0) {
+    const struct geod_inverseorigin* t = p1;
     lonsign *= -1;
-    swapx(&lat1, &lat2);
+    p1 = p2; p2 = t;
   }
+  lat1 = p1->lat;
+  lat2 = p2->lat;
   /* Make lat1 <= 0 */
   latsign = lat1 < 0 ? 1 : -1;
   lat1 *= latsign;
@@ -652,17 +785,9 @@ real geod_geninverse(const struct geod_geodesic* g,
    * check, e.g., on verifying quadrants in atan2.  In addition, this
    * enforces some symmetries in the results returned. */
 
-  phi = lat1 * degree;
-  /* Ensure cbet1 = +epsilon at poles */
-  sbet1 = g->f1 * sin(phi);
-  cbet1 = lat1 == -90 ? tiny : cos(phi);
-  norm2(&sbet1, &cbet1);
-
-  phi = lat2 * degree;
-  /* Ensure cbet2 = +epsilon at poles */
-  sbet2 = g->f1 * sin(phi);
-  cbet2 = fabs(lat2) == 90 ? tiny : cos(phi);
-  norm2(&sbet2, &cbet2);
+  /* The reduced latitudes, with the sign changed as lat1 and lat2 */
+  sbet1 = latsign * p1->sbet; cbet1 = p1->cbet;
+  sbet2 = latsign * p2->sbet; cbet2 = p2->cbet;
 
   /* If cbet1 < -sbet1, then cbet2 - cbet1 is a sensitive measure of the
    * |bet1| - |bet2|.  Alternatively (cbet1 >= -sbet1), abs(sbet2) + sbet1 is
@@ -941,12 +1066,155 @@ real geod_geninverse(const struct geod_geodesic* g,
   return a12;
 }
 
+real geod_geninverse(const struct geod_geodesic* g,
+                     real lat1, real lon1, real lat2, real lon2,
+                     real* ps12, real* pazi1, real* pazi2,
+                     real* pm12, real* pM12, real* pM21, real* pS12) {
+  struct geod_inverseorigin p1, p2;
+  inversepoint(g, &p1, lat1, lon1);
+  inversepoint(g, &p2, lat2, lon2);
+  return geninverse_int(g, &p1, &p2,
+                        ps12, pazi1, pazi2, pm12, pM12, pM21, pS12);
+}
+
 void geod_inverse(const struct geod_geodesic* g,
                   real lat1, real lon1, real lat2, real lon2,
                   real* ps12, real* pazi1, real* pazi2) {
   geod_geninverse(g, lat1, lon1, lat2, lon2, ps12, pazi1, pazi2, 0, 0, 0, 0);
 }
 
+/* x and y are the same value, telling 0 from -0 */
+static boolx samevalue(real x, real y)
+{ return x == y && (x != 0 || 1/x == 1/y); }
+
+void geod_direct_n(const struct geod_geodesic* g, long n,
+                   const real lat1[], const real lon1[], const real azi1[],
+                   const real s12[],
+                   real lat2[], real lon2[], real azi2[]) {
+  struct geod_geodesicline l;
+  unsigned caps = GEOD_DISTANCE_IN |
+    (lat2 ? GEOD_LATITUDE : 0U) |
+    (lon2 ? GEOD_LONGITUDE : 0U) |
+    (azi2 ? GEOD_AZIMUTH : 0U);
+  real la = 0, lo = 0, az = 0;
+  long i;
+
+  for (i = 0; i < n; ++i) {
+    real s = s12[i];
+    /* Consecutive points on the same geodesic share its line */
+    if (i == 0 || !samevalue(lat1[i], la) || !samevalue(lon1[i], lo) ||
+        !samevalue(azi1[i], az)) {
+      la = lat1[i]; lo = lon1[i]; az = azi1[i];
+      geod_lineinit(&l, g, la, lo, az, caps);
+    }
+    geod_genposition(&l, FALSE, s,
+                     lat2 ? lat2 + i : 0, lon2 ? lon2 + i : 0,
+                     azi2 ? azi2 + i : 0, 0, 0, 0, 0, 0);
+  }
+}
+
+void geod_circle(const struct geod_geodesic* g,
+                 real lat1, real lon1, real s12, long n,
+                 real lat2[], real lon2[]) {
+  struct geod_geodesicline l, m;
+  unsigned caps = GEOD_DISTANCE_IN | GEOD_LATITUDE | GEOD_LONGITUDE;
+  real sbet1, cbet1;
+  long i;
+
+  if (n <= 0)
+    return;
+  linestart(g, lat1, &sbet1, &cbet1);
+  /* Points i and n - i are at azimuths azi and -azi */
+  for (i = 0; 2 * i <= n; ++i) {
+    real azi = i * (real)(360) / n;
+    lineinit_int(&l, g, lat1, lon1, azi, caps, sbet1, cbet1);
+    geod_genposition(&l, FALSE, s12, lat2 + i, lon2 + i, 0, 0, 0, 0, 0, 0);
+    if (i > 0 && 2 * i < n) {
+      linemirror(&l, &m);
+      geod_genposition(&m, FALSE, s12, lat2 + n - i, lon2 + n - i,
+                       0, 0, 0, 0, 0, 0);
+    }
+  }
+}
+
+void geod_inverse_n(const struct geod_geodesic* g, long n,
+                    const real lat1[], const real lon1[],
+                    const real lat2[], const real lon2[],
+                    real s12[], real azi1[], real azi2[]) {
+  long i;
+
+  for (i = 0; i < n; ++i)
+    geod_geninverse(g, lat1[i], lon1[i], lat2[i], lon2[i],
+                    s12 ? s12 + i : 0, azi1 ? azi1 + i : 0,
+                    azi2 ? azi2 + i : 0, 0, 0, 0, 0);
+}
+
+void geod_inverse_from(const struct geod_geodesic* g,
+                       struct geod_inverseorigin* o,
+                       real lat1, real lon1) {
+  inversepoint(g, o, lat1, lon1);
+}
+
+void geod_inverse_to_many(const struct geod_geodesic* g,
+                          const struct geod_inverseorigin* o, long n,
+                          const real lat2[], const real lon2[],
+                          real s12[], real azi1[], real azi2[]) {
+  struct geod_inverseorigin p2;
+  long i;
+
+  for (i = 0; i < n; ++i) {
+    inversepoint(g, &p2, lat2[i], lon2[i]);
+    geninverse_int(g, o, &p2,
+                   s12 ? s12 + i : 0, azi1 ? azi1 + i : 0,
+                   azi2 ? azi2 + i : 0, 0, 0, 0, 0);
+  }
+}
+
+real geod_distance(const struct geod_geodesic* g,
+                   real lat1, real lon1, real lat2, real lon2, real tol) {
+  real s12;
+  if (tol > 0) {
+    /* The chord c between the points is a lower bound of the distance.  A
+     * curve of length s12 and curvature at most kmax has a chord at least
+     * 2 * sin(kmax * s12 / 2) / kmax (Schur), and the curvature of a
+     * geodesic is the normal curvature of the ellipsoid in its direction.
+     * So s12 is in [c, smax]. */
+    real
+      lam12 = AngDiff(AngNormalize(lon1), AngNormalize(lon2)) * degree,
+      phi1 = lat1 * degree, phi2 = lat2 * degree,
+      sphi1 = sin(phi1), cphi1 = cos(phi1),
+      sphi2 = sin(phi2), cphi2 = cos(phi2),
+      n1 = g->a / sqrt(1 - g->e2 * sq(sphi1)),
+      n2 = g->a / sqrt(1 - g->e2 * sq(sphi2)),
+      /* geocentric, with point 1 at longitude 0 */
+      x = n2 * cphi2 * cos(lam12) - n1 * cphi1,
+      y = n2 * cphi2 * sin(lam12),
+      z = (1 - g->e2) * (n2 * sphi2 - n1 * sphi1),
+      c = sqrt(x * x + y * y + z * z),
+      kmax = 1 / minx(sq(g->b) / g->a, sq(g->a) / g->b),
+      h = kmax * c / 2;
+    if (h < (real)(0.5)) {
+      real smax = 2 * asin(h) / kmax;
+      /* with the roundoff of the chord */
+      if (smax - c + 64 * epsilon * g->a <= tol) {
+        /* The arc of the normal curvature at the middle, in [c, smax] */
+        real
+          phim = (phi1 + phi2) / 2, w = 1 - g->e2 * sq(sin(phim)),
+          N = g->a / sqrt(w), M = N * (1 - g->e2) / w,
+          dn = M * (phi2 - phi1), de = N * cos(phim) * lam12,
+          d2 = sq(dn) + sq(de), k;
+        if (d2 == 0 || c == 0)
+          return c;
+        k = (sq(dn) / M + sq(de) / N) / d2;
+        s12 = 2 * asin(minx(k, kmax) * c / 2) / minx(k, kmax);
+        return maxx(c, minx(s12, smax));
+      }
+    }
+  }
+  geod_geninverse(g, lat1, lon1, lat2, lon2, &s12, 0, 0, 0, 0, 0, 0);
+  return s12;
+}
+
 real SinCosSeries(boolx sinp, real sinx, real cosx, const real c[], int n) {
   /* Evaluate
    * y = sinp ? sum(c[i] * sin( 2*i    * x), i, 1, n) :
@@ -194,6 +194,19 @@ extern "C" {
     unsigned caps;              /**< the capabilities */
   };
 
+  /**
+   * The struct containing the terms of the first point of the inverse problem
+   * which do not depend on the second one.  This must be initialized by
+   * geod_inverse_from() before use.
+   **********************************************************************/
+  struct geod_inverseorigin {
+    double lat;                 /**< the latitude, rounded */
+    double lon;                 /**< the longitude, normalized */
+    /**< @cond SKIP */
+    double sbet, cbet;
+    /**< @endcond */
+  };
+
   /**
    * The struct for accumulating information about a geodesic polygon.  This is
    * used for computing the perimeter and area of a polygon.  This must be
@@ -347,6 +360,173 @@ extern "C" {
                     double lat1, double lon1, double lat2, double lon2,
                     double* ps12, double* pazi1, double* pazi2);
 
+  /**
+   * Solve the direct geodesic problem for arrays of points.
+   *
+   * @param[in] g a pointer to the geod_geodesic object specifying the
+   *   ellipsoid.
+   * @param[in] n the number of points.
+   * @param[in] lat1 latitudes of point 1 (degrees).
+   * @param[in] lon1 longitudes of point 1 (degrees).
+   * @param[in] azi1 azimuths at point 1 (degrees).
+   * @param[in] s12 distances between point 1 and point 2 (meters); they can
+   *   be negative.
+   * @param[out] lat2 latitudes of point 2 (degrees).
+   * @param[out] lon2 longitudes of point 2 (degrees).
+   * @param[out] azi2 (forward) azimuths at point 2 (degrees).
+   *
+   * The results are those of geod_direct() for each point.  Consecutive
+   * points with the same \e lat1, \e lon1, and \e azi1 are computed on the
+   * same geod_geodesicline, so that way points along a geodesic cost about
+   * as much as with geod_position().  Any of the output arrays may be
+   * replaced by 0, and an output array may be the same as an input one.
+   **********************************************************************/
+  void geod_direct_n(const struct geod_geodesic* g, long n,
+                     const double lat1[], const double lon1[],
+                     const double azi1[], const double s12[],
+                     double lat2[], double lon2[], double azi2[]);
+
+  /**
+   * Compute the points at a given distance all around a point.
+   *
+   * @param[in] g a pointer to the geod_geodesic object specifying the
+   *   ellipsoid.
+   * @param[in] lat1 latitude of the center (degrees).
+   * @param[in] lon1 longitude of the center (degrees).
+   * @param[in] s12 the distance from the center (meters).
+   * @param[in] n the number of points.
+   * @param[out] lat2 latitudes of the points (degrees).
+   * @param[out] lon2 longitudes of the points (degrees).
+   *
+   * Point \e i is that of geod_direct() at azimuth \e i &times; 360&deg; /
+   * \e n, given as &minus;(\e n &minus; \e i) &times; 360&deg; / \e n past
+   * 180&deg;, so that points \e i and \e n &minus; \e i are mirror images
+   * sharing the series of their geodesics, and the reduced latitude of the
+   * center is computed once.  This function is part of PROJ.4, and is not
+   * in the GeographicLib C library.
+   **********************************************************************/
+  void geod_circle(const struct geod_geodesic* g,
+                   double lat1, double lon1, double s12, long n,
+                   double lat2[], double lon2[]);
+
+  /**
+   * Solve the inverse geodesic problem for arrays of points.
+   *
+   * @param[in] g a pointer to the geod_geodesic object specifying the
+   *   ellipsoid.
+   * @param[in] n the number of points.
+   * @param[in] lat1 latitudes of point 1 (degrees).
+   * @param[in] lon1 longitudes of point 1 (degrees).
+   * @param[in] lat2 latitudes of point 2 (degrees).
+   * @param[in] lon2 longitudes of point 2 (degrees).
+   * @param[out] s12 distances between point 1 and point 2 (meters).
+   * @param[out] azi1 azimuths at point 1 (degrees).
+   * @param[out] azi2 (forward) azimuths at point 2 (degrees).
+   *
+   * The results are those of geod_inverse() for each point.  Any of the
+   * output arrays may be replaced by 0, and an output array may be the
+   * same as an input one.
+   **********************************************************************/
+  void geod_inverse_n(const struct geod_geodesic* g, long n,
+                      const double lat1[], const double lon1[],
+                      const double lat2[], const double lon2[],
+                      double s12[], double azi1[], double azi2[]);
+
+  /**
+   * Solve the inverse geodesic problem between two sets of points.
+   *
+   * @param[in] g a pointer to the geod_geodesic object specifying the
+   *   ellipsoid.
+   * @param[in] n1 the number of points 1, the rows of the results.
+   * @param[in] lat1 latitudes of points 1 (degrees).
+   * @param[in] lon1 longitudes of points 1 (degrees).
+   * @param[in] n2 the number of points 2, the columns of the results.
+   * @param[in] lat2 latitudes of points 2 (degrees).
+   * @param[in] lon2 longitudes of points 2 (degrees).
+   * @param[out] s12 the \e n1 &times; \e n2 distances between points 1 and
+   *   points 2 (meters), by rows.
+   * @param[out] azi1 the azimuths at points 1 (degrees), by rows.
+   * @param[out] azi2 the (forward) azimuths at points 2 (degrees), by rows.
+   * @param[in] thread_count the number of threads to use, including the
+   *   calling one.
+   *
+   * The result of row \e i and column \e j, at index \e i &times; \e n2 +
+   * \e j, is that of geod_inverse() for lat1[\e i], lon1[\e i], lat2[\e j],
+   * and lon2[\e j].  The rows are shared over the threads in bands.  Any of
+   * the output arrays may be replaced by 0.  This function is part of
+   * PROJ.4, and is not in the GeographicLib C library.
+   **********************************************************************/
+  void geod_inverse_matrix(const struct geod_geodesic* g,
+                           long n1, const double lat1[], const double lon1[],
+                           long n2, const double lat2[], const double lon2[],
+                           double s12[], double azi1[], double azi2[],
+                           int thread_count);
+
+  /**
+   * Prepare a point for solving the inverse geodesic problem from it to many
+   * others.
+   *
+   * @param[in] g a pointer to the geod_geodesic object specifying the
+   *   ellipsoid.
+   * @param[out] o a pointer to the geod_inverseorigin object to be
+   *   initialized.
+   * @param[in] lat1 latitude of point 1 (degrees).
+   * @param[in] lon1 longitude of point 1 (degrees).
+   *
+   * \e o is only valid with \e g.  This function is part of PROJ.4, and is
+   * not in the GeographicLib C library.
+   **********************************************************************/
+  void geod_inverse_from(const struct geod_geodesic* g,
+                         struct geod_inverseorigin* o,
+                         double lat1, double lon1);
+
+  /**
+   * Solve the inverse geodesic problem from a prepared point to many points.
+   *
+   * @param[in] g a pointer to the geod_geodesic object specifying the
+   *   ellipsoid.
+   * @param[in] o a pointer to point 1, initialized by geod_inverse_from()
+   *   with \e g.
+   * @param[in] n the number of points 2.
+   * @param[in] lat2 latitudes of points 2 (degrees).
+   * @param[in] lon2 longitudes of points 2 (degrees).
+   * @param[out] s12 distances between point 1 and points 2 (meters).
+   * @param[out] azi1 azimuths at point 1 (degrees).
+   * @param[out] azi2 (forward) azimuths at points 2 (degrees).
+   *
+   * The results are those of geod_inverse() from point 1 to each point 2,
+   * without computing the reduced latitude of point 1 again for each.  Any
+   * of the output arrays may be replaced by 0.  This function is part of
+   * PROJ.4, and is not in the GeographicLib C library.
+   **********************************************************************/
+  void geod_inverse_to_many(const struct geod_geodesic* g,
+                            const struct geod_inverseorigin* o, long n,
+                            const double lat2[], const double lon2[],
+                            double s12[], double azi1[], double azi2[]);
+
+  /**
+   * The distance between two points, within a tolerance.
+   *
+   * @param[in] g a pointer to the geod_geodesic object specifying the
+   *   ellipsoid.
+   * @param[in] lat1 latitude of point 1 (degrees).
+   * @param[in] lon1 longitude of point 1 (degrees).
+   * @param[in] lat2 latitude of point 2 (degrees).
+   * @param[in] lon2 longitude of point 2 (degrees).
+   * @param[in] tol the error allowed (meters).
+   * @return the distance between point 1 and point 2 (meters).
+   *
+   * Points close enough that the error is bound to be within \e tol are
+   * done from their chord, bounded with the largest curvature of the
+   * ellipsoid; a tolerance of 1 mm covers points up to about 10 km apart
+   * on the WGS84 ellipsoid.  Others, and all with \e tol = 0, get the
+   * distance of geod_inverse().  This function is part of PROJ.4, and is
+   * not in the GeographicLib C library.
+   **********************************************************************/
+  double geod_distance(const struct geod_geodesic* g,
+                       double lat1, double lon1, double lat2, double lon2,
+                       double tol);
+
   /**
    * Compute the position along a geod_geodesicline.
    *
@@ -396,6 +576,31 @@ extern "C" {
   void geod_position(const struct geod_geodesicline* l, double s12,
                      double* plat2, double* plon2, double* pazi2);
 
+  /**
+   * Compute equally spaced positions along a geod_geodesicline.
+   *
+   * @param[in] l a pointer to the geod_geodesicline object specifying the
+   *   geodesic line.
+   * @param[in] s0 distance from point 1 to the first position (meters).
+   * @param[in] ds distance between the positions (meters); it can be
+   *   negative.
+   * @param[in] n the number of positions.
+   * @param[out] lat latitudes of the positions (degrees).
+   * @param[out] lon longitudes of the positions (degrees); requires that
+   *   \e l was initialized with \e caps |= GEOD_LONGITUDE.
+   * @param[out] azi (forward) azimuths at the positions (degrees).
+   *
+   * Position \e k is that of geod_position() for \e s12 = \e s0 + \e k
+   * \e ds, to within round off (about 10 nm).  The sines and cosines of
+   * the arc lengths are obtained by a recurrence between exact evaluations,
+   * so each position costs about 40% less than with geod_position().  This is
+   * meant for densifying paths.  Any of the output arrays may be replaced
+   * by 0.
+   **********************************************************************/
+  void geod_line_sample(const struct geod_geodesicline* l,
+                        double s0, double ds, long n,
+                        double lat[], double lon[], double azi[]);
+
   /**
    * The general direct geodesic problem.
    *
@@ -768,6 +973,34 @@ extern "C" {
                         double lats[], double lons[], int n,
                         double* pA, double* pP);
 
+  /**
+   * Compute the areas and perimeters of many geodesic polygons.
+   *
+   * @param[in] g a pointer to the geod_geodesic object specifying the
+   *   ellipsoid.
+   * @param[in] ring_count the number of polygons.
+   * @param[in] ring_starts the index in \e lats and \e lons of the first
+   *   vertex of each polygon, and that of the end of the last one, in
+   *   ring_count + 1 entries.
+   * @param[in] lats an array of latitudes of the polygon vertices (degrees).
+   * @param[in] lons an array of longitudes of the polygon vertices (degrees).
+   * @param[out] A the areas of the polygons (meters<sup>2</sup>).
+   * @param[out] P the perimeters of the polygons (meters).
+   * @param[in] thread_count the number of threads to use, including the
+   *   calling one.
+   *
+   * The results of polygon \e i are those of geod_polygonarea() for vertices
+   * ring_starts[\e i] to ring_starts[\e i + 1] &minus; 1.  The polygons are
+   * shared over the threads in bands of about as many vertices.  The areas of
+   * holes are to be subtracted by the caller, or given clockwise so that they
+   * are negative.  Either output array may be replaced by 0.  This function
+   * is part of PROJ.4, and is not in the GeographicLib C library.
+   **********************************************************************/
+  void geod_polygonarea_n(const struct geod_geodesic* g,
+                          long ring_count, const long ring_starts[],
+                          const double lats[], const double lons[],
+                          double A[], double P[], int thread_count);
+
   /**
    * mask values for the \e caps argument to geod_lineinit().
    **********************************************************************/
@@ -0,0 +1,415 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Compile init files, like epsg and proj_def.dat, into a C source
+ *           of sorted definitions built into libproj.  See pj_initdb.c.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+/*
+** Usage: init2c output.c file...
+**
+** The definitions of each file are read with the rules of get_opt() in
+** pj_init.c: a <tag> starts a word and the rest of its line is skipped
+** unless it is the tag looked for, comments run from a '#' starting a
+** word to the end of the line, the parameters of a definition run from
+** its tag to the next tag with one leading '+' dropped, and only the
+** first definition of a tag counts.  Each distinct string is written
+** once, and referred to by offset so that the tables need no
+** relocation when the library is loaded.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define WORD_MAX 300            /* as the sword buffer of get_opt() */
+
+typedef struct {
+    int    file;
+    int    order;               /* in the file, to keep the first */
+    unsigned int tag;           /* offsets in strings */
+    unsigned int first;         /* in params */
+    unsigned int count;
+} definition;
+
+static char *strings;
+static unsigned int strings_size, strings_alloc;
+static unsigned int *string_slots; /* hash of offsets + 1, 0 if empty */
+static unsigned int slot_count, slots_used;
+
+static unsigned int *params;
+static unsigned int param_count, params_alloc;
+
+static definition *defs;
+static int def_count, defs_alloc;
+
+static const char *file_names[256];
+static int file_count;
+
+/************************************************************************/
+/*                              xrealloc()                              */
+/************************************************************************/
+
+static void *xrealloc( void *data, size_t size )
+
+{
+    data = realloc( data, size );
+    if( data == NULL )
+    {
+        fprintf( stderr, "init2c: out of memory\n" );
+        exit( 1 );
+    }
+    return data;
+}
+
+/************************************************************************/
+/*                               intern()                               */
+/*                                                                      */
+/*      Offset of a copy of the len characters of word in strings,      */
+/*      adding it if it is not there yet.                               */
+/************************************************************************/
+
+static unsigned int string_hash( const char *word, size_t len )
+
+{
+    unsigned int hash = 2166136261U;
+    size_t i;
+
+    for( i = 0; i < len; i++ )
+        hash = (hash ^ (unsigned char) word[i]) * 16777619U;
+
+    return hash;
+}
+
+static unsigned int intern( const char *word, size_t len )
+
+{
+    unsigned int slot, offset;
+
+    if( 2 * (slots_used + 1) > slot_count )
+    {
+        unsigned int *old = string_slots, old_count = slot_count, i;
+
+        slot_count = slot_count == 0 ? 4096 : slot_count * 2;
+        string_slots = (unsigned int *)
+            xrealloc( NULL, sizeof(unsigned int) * slot_count );
+        memset( string_slots, 0, sizeof(unsigned int) * slot_count );
+        for( i = 0; i < old_count; i++ )
+        {
+            const char *s;
+
+            if( old[i] == 0 )
+                continue;
+            s = strings + old[i] - 1;
+            for( slot = string_hash( s, strlen(s) ) & (slot_count - 1);
+                 string_slots[slot] != 0; slot = (slot + 1) & (slot_count - 1) )
+                {}
+            string_slots[slot] = old[i];
+        }
+        free( old );
+    }
+
+    for( slot = string_hash( word, len ) & (slot_count - 1);
+         string_slots[slot] != 0; slot = (slot + 1) & (slot_count - 1) )
+    {
+        const char *s = strings + string_slots[slot] - 1;
+
+        if( strncmp( s, word, len ) == 0 && s[len] == '\0' )
+            return string_slots[slot] - 1;
+    }
+
+    if( strings_size + len + 1 > strings_alloc )
+    {
+        strings_alloc = strings_alloc * 2 + len + 65536;
+        strings = (char *) xrealloc( strings, strings_alloc );
+    }
+    offset = strings_size;
+    memcpy( strings + offset, word, len );
+    strings[offset + len] = '\0';
+    strings_size += len + 1;
+
+    string_slots[slot] = offset + 1;
+    slots_used++;
+
+    return offset;
+}
+
+/************************************************************************/
+/*                            read_params()                             */
+/*                                                                      */
+/*      Append the parameters of the definition starting at p.          */
+/************************************************************************/
+
+static unsigned int read_params( const char *p )
+
+{
+    unsigned int count = 0;
+
+    for( ; ; )
+    {
+        const char *word;
+        size_t len;
+
+        while( isspace((unsigned char) *p) )
+            p++;
+
+        if( *p == '\0' || *p == '<' )
+            break;
+
+        if( *p == '#' )
+        {
+            while( *p != '\0' && *p != '\n' )
+                p++;
+            continue;
+        }
+
+        if( *p == '+' )
+            p++;
+        for( word = p; *p != '\0' && !isspace((unsigned char) *p); p++ ) {}
+        len = p - word;
+        if( len > WORD_MAX )
+            len = WORD_MAX;
+
+        if( param_count == params_alloc )
+        {
+            params_alloc = params_alloc * 2 + 65536;
+            params = (unsigned int *)
+                xrealloc( params, sizeof(unsigned int) * params_alloc );
+        }
+        params[param_count++] = intern( word, len );
+        count++;
+    }
+
+    return count;
+}
+
+/************************************************************************/
+/*                             read_file()                              */
+/************************************************************************/
+
+static void read_file( const char *path, int file )
+
+{
+    FILE  *fp = fopen( path, "rb" );
+    char  *text = NULL;
+    size_t size = 0, alloc = 0, got;
+    const char *p;
+    int    order = 0;
+
+    if( fp == NULL )
+    {
+        fprintf( stderr, "init2c: cannot open %s\n", path );
+        exit( 1 );
+    }
+
+    do
+    {
+        if( size + 65536 > alloc )
+        {
+            alloc = alloc * 2 + 65536;
+            text = (char *) xrealloc( text, alloc + 1 );
+        }
+        got = fread( text + size, 1, alloc - size, fp );
+        size += got;
+    } while( got > 0 );
+    fclose( fp );
+
+    /* get_opt() reads up to a nul */
+    text[size] = '\0';
+
+    for( p = text; *p != '\0'; )
+    {
+        while( isspace((unsigned char) *p) )
+            p++;
+
+        if( *p == '<' )
+        {
+            const char *end;
+
+            for( end = p + 1; *end != '\0' && *end != '>'
+                     && !isspace((unsigned char) *end); end++ ) {}
+
+            if( *end == '>' )
+            {
+                if( def_count == defs_alloc )
+                {
+                    defs_alloc = defs_alloc * 2 + 4096;
+                    defs = (definition *)
+                        xrealloc( defs, sizeof(definition) * defs_alloc );
+                }
+                defs[def_count].file = file;
+                defs[def_count].order = order++;
+                defs[def_count].tag = intern( p + 1, end - p - 1 );
+                defs[def_count].first = param_count;
+                defs[def_count].count = read_params( end + 1 );
+                def_count++;
+            }
+        }
+
+        /* tags and comments hide the rest of their line */
+        if( *p == '<' || *p == '#' )
+        {
+            while( *p != '\0' && *p != '\n' )
+                p++;
+        }
+        else
+        {
+            while( *p != '\0' && !isspace((unsigned char) *p) )
+                p++;
+        }
+    }
+
+    free( text );
+}
+
+/************************************************************************/
+/*                          compare_defs()                              */
+/*                                                                      */
+/*      By file name, tag, and order in the file.                       */
+/************************************************************************/
+
+static int compare_defs( const void *a_in, const void *b_in )
+
+{
+    const definition *a = (const definition *) a_in;
+    const definition *b = (const definition *) b_in;
+    int result = strcmp( file_names[a->file], file_names[b->file] );
+
+    if( result == 0 )
+        result = strcmp( strings + a->tag, strings + b->tag );
+    if( result == 0 )
+        result = a->order - b->order;
+
+    return result;
+}
+
+/************************************************************************/
+/*                                main()                                */
+/************************************************************************/
+
+int main( int argc, char **argv )
+
+{
+    FILE *out;
+    int   i, j, kept, sorted[256];
+    unsigned int k;
+
+    if( argc < 3 || argc - 2 > 256 )
+    {
+        fprintf( stderr, "Usage: init2c output.c file...\n" );
+        return 1;
+    }
+
+    for( i = 2; i < argc; i++ )
+    {
+        const char *name = argv[i] + strlen(argv[i]);
+
+        while( name > argv[i] && name[-1] != '/' && name[-1] != '\\' )
+            name--;
+        file_names[file_count] = name;
+        read_file( argv[i], file_count++ );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Sort, keeping the first definition of each tag of a file.       */
+/* -------------------------------------------------------------------- */
+    qsort( defs, def_count, sizeof(definition), compare_defs );
+    for( i = 0, kept = 0; i < def_count; i++ )
+    {
+        if( kept > 0 && defs[kept-1].file == defs[i].file
+            && defs[kept-1].tag == defs[i].tag )
+            continue;
+        defs[kept++] = defs[i];
+    }
+    def_count = kept;
+
+    /* files by name, the order of the definitions */
+    for( i = 0; i < file_count; i++ )
+        sorted[i] = i;
+    for( i = 1; i < file_count; i++ )
+        for( j = i; j > 0 && strcmp( file_names[sorted[j-1]],
+                                     file_names[sorted[j]] ) > 0; j-- )
+        {
+            int t = sorted[j];
+            sorted[j] = sorted[j-1];
+            sorted[j-1] = t;
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Write the tables.                                               */
+/* -------------------------------------------------------------------- */
+    out = fopen( argv[1], "w" );
+    if( out == NULL )
+    {
+        fprintf( stderr, "init2c: cannot create %s\n", argv[1] );
+        return 1;
+    }
+
+    fprintf( out, "/* Generated by init2c, do not edit. */\n\n"
+             "#include <projects.h>\n\n"
+             "static const char * const init_db_files[] = {\n" );
+    for( i = 0; i < file_count; i++ )
+        fprintf( out, "    \"%s\",\n", file_names[sorted[i]] );
+    fprintf( out, "};\n\n" );
+
+    fprintf( out, "static const PJ_INIT_DB_ENTRY init_db_entries[] = {\n" );
+    for( i = 0; i < def_count; i++ )
+    {
+        for( j = 0; sorted[j] != defs[i].file; j++ ) {}
+        fprintf( out, "    { %d, %u, %u, %u },\n",
+                 j, defs[i].count, defs[i].tag, defs[i].first );
+    }
+    fprintf( out, "};\n\n" );
+
+    fprintf( out, "static const unsigned int init_db_params[] = {" );
+    for( k = 0; k < param_count; k++ )
+        fprintf( out, "%s%u,", k % 12 == 0 ? "\n    " : " ", params[k] );
+    fprintf( out, "\n    0\n};\n\n" );
+
+    /* as numbers, string literals this long are not portable */
+    fprintf( out, "static const char init_db_strings[] = {" );
+    for( k = 0; k < strings_size; k++ )
+        fprintf( out, "%s%d,", k % 16 == 0 ? "\n    " : " ",
+                 (unsigned char) strings[k] );
+    fprintf( out, "\n    0\n};\n\n" );
+
+    fprintf( out, "const PJ_INIT_DB pj_init_db_embedded = {\n"
+             "    %d, init_db_files,\n"
+             "    %d, init_db_entries,\n"
+             "    init_db_params, init_db_strings\n"
+             "};\n", file_count, def_count );
+
+    if( fclose( out ) != 0 )
+    {
+        fprintf( stderr, "init2c: cannot write %s\n", argv[1] );
+        return 1;
+    }
+
+    printf( "init2c: %d definitions of %d parameters, %u bytes of strings\n",
+            def_count, param_count, strings_size );
+
+    return 0;
+}
@@ -57,6 +57,9 @@
 #define PJ_MAX_DIMENSION 100
 /* The PJ_MAX_DIMENSION value appears also in quoted strings.
    Please perform a search-and-replace if this value is changed. */
+#define PJ_CHUNK_LENGTH 16384
+/* Number of ordinates transformed at once, small enough to stay in the cache
+   and for the copy of a chunk of a Java array to not delay the garbage collector. */
 
 PJ_CVSID("$Id$");
 
@@ -116,7 +119,40 @@ JNIEXPORT jstring JNICALL Java_org_proj4_PJ_getVersion
 
 /*!
  * \brief
- * Allocates a new PJ structure from a definition string.
+ * Internal method allocating the context of a new PJ structure. Every PJ structure created by
+ * the JNI wrappers has its own context, so the Java objects used by different threads never
+ * share an error code. The context does not set the pj_errno and errno globals either, since
+ * they are shared by all threads.
+ *
+ * \return The new context, or NULL if it can not be allocated.
+ */
+projCtx allocateContext()
+{
+    projCtx ctx = pj_ctx_alloc();
+    if (ctx) {
+        ctx->errno_globals = 0;
+    }
+    return ctx;
+}
+
+/*!
+ * \brief
+ * Internal method releasing the context of a PJ structure, if it is not the default one.
+ *
+ * \param ctx - The context to release.
+ */
+void releaseContext(projCtx ctx)
+{
+    if (ctx && ctx != pj_get_default_ctx()) {
+        pj_ctx_free(ctx);
+    }
+}
+
+/*!
+ * \brief
+ * Allocates a new PJ structure from a definition string, with its own context. The expanded
+ * parameters of the definition are cached by pj_init_plus_cached(), so allocating the same
+ * definition again does not read the init files again.
  *
  * \param  env        - The JNI environment.
  * \param  class      - The class from which this method has been invoked.
@@ -128,14 +164,16 @@ JNIEXPORT jlong JNICALL Java_org_proj4_PJ_allocatePJ
 {
     const char *def_utf = (*env)->GetStringUTFChars(env, definition, NULL);
     if (!def_utf) return 0; /* OutOfMemoryError already thrown. */
-    PJ *pj = pj_init_plus(def_utf);
+    projCtx ctx = allocateContext();
+    PJ *pj = (ctx) ? pj_init_plus_cached(ctx, def_utf) : NULL;
     (*env)->ReleaseStringUTFChars(env, definition, def_utf);
+    if (!pj) releaseContext(ctx);
     return (jlong) pj;
 }
 
 /*!
  * \brief
- * Allocates a new geographic PJ structure from an existing one.
+ * Allocates a new geographic PJ structure from an existing one, with its own context.
  *
  * \param  env       - The JNI environment.
  * \param  class     - The class from which this method has been invoked.
@@ -146,7 +184,37 @@ JNIEXPORT jlong JNICALL Java_org_proj4_PJ_allocateGeoPJ
   (JNIEnv *env, jclass class, jobject projected)
 {
     PJ *pj = getPJ(env, projected);
-    return (pj) ? (jlong) pj_latlong_from_proj(pj) : 0;
+    if (!pj) return 0;
+    projCtx ctx = allocateContext();
+    if (!ctx) return 0;
+    PJ *geo = pj_latlong_from_proj(pj);
+    if (geo) {
+        pj_set_ctx(geo, ctx);
+    } else {
+        releaseContext(ctx);
+    }
+    return (jlong) geo;
+}
+
+/*!
+ * \brief
+ * Allocates a copy of an existing PJ structure, with its own context.
+ *
+ * \param  env      - The JNI environment.
+ * \param  class    - The class from which this method has been invoked.
+ * \param  original - The PJ object to copy.
+ * \return The address of the new PJ structure, or 0 in case of failure.
+ */
+JNIEXPORT jlong JNICALL Java_org_proj4_PJ_allocateClonePJ
+  (JNIEnv *env, jclass class, jobject original)
+{
+    PJ *pj = getPJ(env, original);
+    if (!pj) return 0;
+    projCtx ctx = allocateContext();
+    if (!ctx) return 0;
+    PJ *copy = pj_clone(ctx, pj);
+    if (!copy) releaseContext(ctx);
+    return (jlong) copy;
 }
 
 /*!
@@ -239,7 +307,7 @@ JNIEXPORT jdouble JNICALL Java_org_proj4_PJ_getSemiMajorAxis
   (JNIEnv *env, jobject object)
 {
     PJ *pj = getPJ(env, object);
-    return pj ? pj->a_orig : javaNaN(env);
+    return pj ? pj->cold->a_orig : javaNaN(env);
 }
 
 /*!
@@ -256,8 +324,8 @@ JNIEXPORT jdouble JNICALL Java_org_proj4_PJ_getSemiMinorAxis
 {
     PJ *pj = getPJ(env, object);
     if (!pj) return javaNaN(env);
-    double a = pj->a_orig;
-    return sqrt(a*a * (1.0 - pj->es_orig));
+    double a = pj->cold->a_orig;
+    return sqrt(a*a * (1.0 - pj->cold->es_orig));
 }
 
 /*!
@@ -272,7 +340,7 @@ JNIEXPORT jdouble JNICALL Java_org_proj4_PJ_getEccentricitySquared
   (JNIEnv *env, jobject object)
 {
     PJ *pj = getPJ(env, object);
-    return pj ? pj->es_orig : javaNaN(env);
+    return pj ? pj->cold->es_orig : javaNaN(env);
 }
 
 /*!
@@ -288,7 +356,7 @@ JNIEXPORT jcharArray JNICALL Java_org_proj4_PJ_getAxisDirections
 {
     PJ *pj = getPJ(env, object);
     if (pj) {
-        int length = strlen(pj->axis);
+        int length = strlen(pj->cold->axis);
         jcharArray array = (*env)->NewCharArray(env, length);
         if (array) {
             jchar* axis = (*env)->GetCharArrayElements(env, array, NULL);
@@ -296,7 +364,7 @@ JNIEXPORT jcharArray JNICALL Java_org_proj4_PJ_getAxisDirections
                 /* Don't use memcp because the type may not be the same. */
                 int i;
                 for (i=0; i<length; i++) {
-                    axis[i] = pj->axis[i];
+                    axis[i] = pj->cold->axis[i];
                 }
                 (*env)->ReleaseCharArrayElements(env, array, axis, 0);
             }
@@ -318,7 +386,7 @@ JNIEXPORT jdouble JNICALL Java_org_proj4_PJ_getGreenwichLongitude
   (JNIEnv *env, jobject object)
 {
     PJ *pj = getPJ(env, object);
-    return (pj) ? (pj->from_greenwich)*(180/M_PI) : javaNaN(env);
+    return (pj) ? (pj->cold->from_greenwich)*(180/M_PI) : javaNaN(env);
 }
 
 /*!
@@ -335,7 +403,7 @@ JNIEXPORT jdouble JNICALL Java_org_proj4_PJ_getLinearUnitToMetre
 {
     PJ *pj = getPJ(env, object);
     if (pj) {
-        return (vertical) ? pj->vto_meter : pj->to_meter;
+        return (vertical) ? pj->cold->vto_meter : pj->to_meter;
     }
     return javaNaN(env);
 }
@@ -377,10 +445,97 @@ void convertAngularOrdinates(PJ *pj, double* data, jint numPts, int dimension, d
     }
 }
 
+/*!
+ * \brief
+ * Transforms in-place a block of coordinates by chunks of PJ_CHUNK_LENGTH ordinates, converting
+ * the angular ordinates of each chunk just before and after its transform while it is still
+ * in the cache. The interleaved ordinates are given to the plan as packed points.
+ *
+ * \param src_pj    - The source Proj.4 PJ structure.
+ * \param dst_pj    - The target Proj.4 PJ structure.
+ * \param data      - The coordinates to transform.
+ * \param numPts    - Number of points to transform.
+ * \param dimension - Dimension of points in the coordinate array.
+ * \return The pj_transform() error code of the first chunk that failed, or 0.
+ */
+int transformChunks(PJ *src_pj, PJ *dst_pj, double* data, jint numPts, int dimension) {
+    jint step = PJ_CHUNK_LENGTH / dimension;
+    jint start;
+    PJ_TRANSFORM_PLAN plan;
+    pj_transform_plan_init(&plan, src_pj, dst_pj);
+    for (start = 0; start < numPts; start += step) {
+        double *x = data + start*dimension;
+        jint n = (numPts - start < step) ? numPts - start : step;
+        projCoords coords;
+        pj_coords_packed(&coords, PJ_COORD_DOUBLE, x, dimension);
+        convertAngularOrdinates(src_pj, x, n, dimension, M_PI/180);
+        int err = pj_transform_plan_execute_coords(&plan, n, &coords, &coords);
+        convertAngularOrdinates(dst_pj, x, n, dimension, 180/M_PI);
+        if (err) {
+            return err;
+        }
+    }
+    return 0;
+}
+
+/*!
+ * \brief
+ * Internal method checking the arguments shared by the transform methods, and throwing
+ * the appropriate Java exception if one of them is invalid.
+ *
+ * \param  env         - The JNI environment.
+ * \param  target      - The target CRS.
+ * \param  coordinates - The coordinates array or buffer.
+ * \param  length      - The number of ordinates in the coordinates array or buffer.
+ * \param  dimension   - The dimension of each coordinate value.
+ * \param  offset      - Offset of the first coordinate.
+ * \param  numPts      - Number of points to transform.
+ * \return 1 if the arguments are valid, or 0 if an exception has been thrown.
+ */
+int checkTransformArguments(JNIEnv *env, jobject target, jobject coordinates, jlong length,
+                            jint dimension, jint offset, jint numPts)
+{
+    if (!target || !coordinates) {
+        jclass c = (*env)->FindClass(env, "java/lang/NullPointerException");
+        if (c) (*env)->ThrowNew(env, c, "The target CRS and the coordinates array can not be null.");
+        return 0;
+    }
+    if (dimension < 2 || dimension > PJ_MAX_DIMENSION) { /* Arbitrary upper value for catching potential misuse. */
+        jclass c = (*env)->FindClass(env, "java/lang/IllegalArgumentException");
+        if (c) (*env)->ThrowNew(env, c, "Illegal dimension. Must be in the [2-100] range.");
+        return 0;
+    }
+    if ((offset < 0) || (numPts < 0) || (offset + (jlong) dimension*numPts) > length) {
+        jclass c = (*env)->FindClass(env, "java/lang/ArrayIndexOutOfBoundsException");
+        if (c) (*env)->ThrowNew(env, c, "Illegal offset or illegal number of points.");
+        return 0;
+    }
+    return 1;
+}
+
+/*!
+ * \brief
+ * Internal method throwing a PJException for the given pj_transform() error code, if non-zero.
+ *
+ * \param env - The JNI environment.
+ * \param err - The pj_transform() error code.
+ */
+void throwTransformError(JNIEnv *env, int err)
+{
+    if (err) {
+        jclass c = (*env)->FindClass(env, "org/proj4/PJException");
+        if (c) (*env)->ThrowNew(env, c, pj_strerrno(err));
+    }
+}
+
 /*!
  * \brief
  * Transforms in-place the coordinates in the given array.
  *
+ * The array is copied by chunks of PJ_CHUNK_LENGTH ordinates into a native buffer rather than
+ * pinned with GetPrimitiveArrayCritical, so the garbage collector is never blocked for longer
+ * than the copy of one chunk, whatever the size of the array.
+ *
  * \param env         - The JNI environment.
  * \param object      - The Java object wrapping the PJ structure (not allowed to be NULL).
  * \param target      - The target CRS.
@@ -392,43 +547,66 @@ void convertAngularOrdinates(PJ *pj, double* data, jint numPts, int dimension, d
 JNIEXPORT void JNICALL Java_org_proj4_PJ_transform
   (JNIEnv *env, jobject object, jobject target, jint dimension, jdoubleArray coordinates, jint offset, jint numPts)
 {
-    if (!target || !coordinates) {
-        jclass c = (*env)->FindClass(env, "java/lang/NullPointerException");
-        if (c) (*env)->ThrowNew(env, c, "The target CRS and the coordinates array can not be null.");
+    if (!checkTransformArguments(env, target, coordinates,
+            coordinates ? (*env)->GetArrayLength(env, coordinates) : 0, dimension, offset, numPts)) {
         return;
     }
-    if (dimension < 2 || dimension > PJ_MAX_DIMENSION) { /* Arbitrary upper value for catching potential misuse. */
+    PJ *src_pj = getPJ(env, object);
+    PJ *dst_pj = getPJ(env, target);
+    if (src_pj && dst_pj) {
+        jint step = PJ_CHUNK_LENGTH / dimension;
+        jint n = (numPts < step) ? numPts : step;
+        double *buffer = pj_malloc(sizeof(double) * dimension * (n > 0 ? n : 1));
+        jint start;
+        int err = 0;
+        if (!buffer) {
+            jclass c = (*env)->FindClass(env, "java/lang/OutOfMemoryError");
+            if (c) (*env)->ThrowNew(env, c, "Can not allocate the transform buffer.");
+            return;
+        }
+        for (start = 0; start < numPts && !err; start += step) {
+            jint first = offset + start*dimension;
+            n = (numPts - start < step) ? numPts - start : step;
+            (*env)->GetDoubleArrayRegion(env, coordinates, first, n*dimension, buffer);
+            err = transformChunks(src_pj, dst_pj, buffer, n, dimension);
+            (*env)->SetDoubleArrayRegion(env, coordinates, first, n*dimension, buffer);
+        }
+        pj_dalloc(buffer);
+        throwTransformError(env, err);
+    }
+}
+
+/*!
+ * \brief
+ * Transforms in-place the coordinates in the given direct buffer. The buffer memory is
+ * not managed by the garbage collector, so it is transformed where it is without any copy.
+ * The Java caller shall ensure that the buffer is direct and in the native byte order.
+ *
+ * \param env         - The JNI environment.
+ * \param object      - The Java object wrapping the PJ structure (not allowed to be NULL).
+ * \param target      - The target CRS.
+ * \param dimension   - The dimension of each coordinate value. Must be equals or greater than 2.
+ * \param coordinates - The coordinates to transform, as a sequence of (x,y,<z>,...) tuples.
+ * \param offset      - Offset of the first coordinate in the given buffer.
+ * \param numPts      - Number of points to transform.
+ */
+JNIEXPORT void JNICALL Java_org_proj4_PJ_transformDirect
+  (JNIEnv *env, jobject object, jobject target, jint dimension, jobject coordinates, jint offset, jint numPts)
+{
+    double *data = coordinates ? (*env)->GetDirectBufferAddress(env, coordinates) : NULL;
+    if (coordinates && !data) {
         jclass c = (*env)->FindClass(env, "java/lang/IllegalArgumentException");
-        if (c) (*env)->ThrowNew(env, c, "Illegal dimension. Must be in the [2-100] range.");
+        if (c) (*env)->ThrowNew(env, c, "The coordinates buffer is not direct.");
         return;
     }
-    if ((offset < 0) || (numPts < 0) || (offset + dimension*numPts) > (*env)->GetArrayLength(env, coordinates)) {
-        jclass c = (*env)->FindClass(env, "java/lang/ArrayIndexOutOfBoundsException");
-        if (c) (*env)->ThrowNew(env, c, "Illegal offset or illegal number of points.");
+    if (!checkTransformArguments(env, target, coordinates,
+            coordinates ? (*env)->GetDirectBufferCapacity(env, coordinates) : 0, dimension, offset, numPts)) {
         return;
     }
     PJ *src_pj = getPJ(env, object);
     PJ *dst_pj = getPJ(env, target);
     if (src_pj && dst_pj) {
-        /* Using GetPrimitiveArrayCritical/ReleasePrimitiveArrayCritical rather than
-           GetDoubleArrayElements/ReleaseDoubleArrayElements increase the chances that
-           the JVM returns direct reference to its internal array without copying data.
-           However we must promise to run the "critical" code fast, to not make any
-           system call that may wait for the JVM and to not invoke any other JNI method. */
-        double *data = (*env)->GetPrimitiveArrayCritical(env, coordinates, NULL);
-        if (data) {
-            double *x = data + offset;
-            double *y = x + 1;
-            double *z = (dimension >= 3) ? y+1 : NULL;
-            convertAngularOrdinates(src_pj, x, numPts, dimension, M_PI/180);
-            int err = pj_transform(src_pj, dst_pj, numPts, dimension, x, y, z);
-            convertAngularOrdinates(dst_pj, x, numPts, dimension, 180/M_PI);
-            (*env)->ReleasePrimitiveArrayCritical(env, coordinates, data, 0);
-            if (err) {
-                jclass c = (*env)->FindClass(env, "org/proj4/PJException");
-                if (c) (*env)->ThrowNew(env, c, pj_strerrno(err));
-            }
-        }
+        throwTransformError(env, transformChunks(src_pj, dst_pj, data + offset, numPts, dimension));
     }
 }
 
@@ -472,8 +650,10 @@ JNIEXPORT void JNICALL Java_org_proj4_PJ_finalize
     if (id) {
         PJ *pj = (PJ*) (*env)->GetLongField(env, object, id);
         if (pj) {
+            projCtx ctx = pj->ctx;
             (*env)->SetLongField(env, object, id, (jlong) 0);
             pj_free(pj);
+            releaseContext(ctx);
         }
     }
 }
@@ -155,43 +155,69 @@ SET(SRC_LIBPROJ_CORE
         nad_intr.c
         pj_apply_gridshift.c
         pj_apply_vgridshift.c
+        pj_approx.c
+        pj_arena.c
         pj_auth.c
         pj_ctx.c
         pj_fileapi.c
         pj_datum_set.c
         pj_datums.c
+        pj_def.c
         pj_deriv.c
         pj_ell_set.c
         pj_ellps.c
         pj_errno.c
         pj_factors.c
+        pj_format.c
         pj_fwd.c
         pj_gauss.c
         pj_gc_reader.c
         pj_geocent.c
+        pj_geodmatrix.c
+        pj_geodpoly.c
+        pj_gridbudget.c
         pj_gridcatalog.c
+        pj_gridindex.c
         pj_gridinfo.c
         pj_gridlist.c
+        pj_gridorder.c
+        pj_gridpages.c
+        pj_gridquant.c
+        pj_gridtile.c
+        pj_gtiff.c
         PJ_healpix.c
         pj_init.c
         pj_initcache.c
+        pj_initdb.c
+        pj_initsnap.c
         pj_inv.c
         pj_latlong.c
         pj_list.c
         pj_list.h
         pj_log.c
         pj_malloc.c
+        pj_math.h
         pj_mlfn.c
         pj_msfn.c
         pj_mutex.c
+        pj_network.c
         pj_open_lib.c
         pj_param.c
         pj_phi2.c
         pj_pr_list.c
+        pj_prefetch.c
         pj_qsfn.c
         pj_release.c
+        pj_stats.c
         pj_strerrno.c
+        pj_strtod.c
+        pj_tables.c
+        pj_trace.h
         pj_transform.c
+        pj_transform_bounds.c
+        pj_transform_coords.c
+        pj_transform_grid.c
+        pj_transform_line.c
         pj_tsfn.c
         pj_units.c
         pj_utils.c
@@ -200,6 +226,20 @@ SET(SRC_LIBPROJ_CORE
         proj_rouss.c
         rtodms.c
         vector1.c
+        pj_transform_async.c
+        pj_stream.c
+        pj_arrow.c
+        pj_ellps_tables.c
+        pj_gridshm.c
+        pj_shm.c
+        pj_memory.c
+        pj_freeze.c
+        pj_tune.c
+        pj_tile_cache.c
+        pj_executor.c
+        pj_intern.c
+        pj_canonical.c
+        pj_cpu.c
         ${CMAKE_CURRENT_BINARY_DIR}/proj_config.h
  )
 
@@ -240,6 +280,50 @@ if(JNI_SUPPORT)
   boost_report_value(JNI_INCLUDE_DIRS)
 endif(JNI_SUPPORT)
 
+#################################################
+## grids read from http(s) urls with libcurl
+#################################################
+option(CURL_SUPPORT "Build support of grids read from http(s) urls with libcurl" OFF)
+if(CURL_SUPPORT)
+  find_package(CURL)
+  if(NOT CURL_FOUND)
+    message(FATAL_ERROR "curl support is required but libcurl is not found")
+  endif(NOT CURL_FOUND)
+  add_definitions(-DHAVE_LIBCURL)
+  include_directories( ${CURL_INCLUDE_DIRS})
+endif(CURL_SUPPORT)
+boost_report_value(CURL_SUPPORT)
+
+#################################################
+## static trace points, see pj_trace.h
+#################################################
+include(CheckIncludeFiles)
+check_include_files(sys/sdt.h HAVE_SYS_SDT_H)
+if(HAVE_SYS_SDT_H)
+  add_definitions(-DHAVE_SYS_SDT_H)
+endif(HAVE_SYS_SDT_H)
+boost_report_value(HAVE_SYS_SDT_H)
+
+#################################################
+## init files compiled into the library
+#################################################
+option(EMBED_INIT_FILES "Build the epsg, esri, IGNF and proj_def.dat init files into the proj library" OFF)
+if(EMBED_INIT_FILES)
+  set(INIT_DB_FILES ${PROJ4_SOURCE_DIR}/nad/epsg
+                    ${PROJ4_SOURCE_DIR}/nad/esri
+                    ${PROJ4_SOURCE_DIR}/nad/IGNF
+                    ${PROJ4_SOURCE_DIR}/nad/proj_def.dat)
+  add_executable(init2c init2c.c)
+  add_custom_command(OUTPUT ${CMAKE_CURRENT_BINARY_DIR}/pj_init_db.c
+                     COMMAND init2c ${CMAKE_CURRENT_BINARY_DIR}/pj_init_db.c
+                             ${INIT_DB_FILES}
+                     DEPENDS init2c ${INIT_DB_FILES})
+  set(SRC_LIBPROJ_CORE ${SRC_LIBPROJ_CORE}
+                       ${CMAKE_CURRENT_BINARY_DIR}/pj_init_db.c)
+  add_definitions(-DPJ_EMBED_INIT)
+endif(EMBED_INIT_FILES)
+boost_report_value(EMBED_INIT_FILES)
+
 #################################################
 ## targets: libproj and proj_config.h
 #################################################
@@ -298,6 +382,17 @@ endif(UNIX AND BUILD_LIBPROJ_SHARED)
 if(USE_THREAD AND Threads_FOUND AND CMAKE_USE_PTHREADS_INIT AND BUILD_LIBPROJ_SHARED)
    TARGET_LINK_LIBRARIES(${PROJ_CORE_TARGET} ${CMAKE_THREAD_LIBS_INIT})
 endif(USE_THREAD AND Threads_FOUND AND CMAKE_USE_PTHREADS_INIT AND BUILD_LIBPROJ_SHARED)
+if(CURL_SUPPORT)
+   TARGET_LINK_LIBRARIES(${PROJ_CORE_TARGET} ${CURL_LIBRARIES})
+endif(CURL_SUPPORT)
+if(UNIX AND BUILD_LIBPROJ_SHARED)
+    # shm_open() of pj_shm.c, in librt with older glibc
+    include(CheckLibraryExists)
+    check_library_exists(rt shm_open "" HAVE_LIBRT)
+    if(HAVE_LIBRT)
+      TARGET_LINK_LIBRARIES(${PROJ_CORE_TARGET} rt)
+    endif()
+endif(UNIX AND BUILD_LIBPROJ_SHARED)
 
 
 ##############################################
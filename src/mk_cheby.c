@@ -28,23 +28,37 @@ makeT(int nru, int nrv) {
             T->cu[i].c = 0;
         for (i = 0; i < nrv; ++i)
             T->cv[i].c = 0;
+        T->packed = 0;
+        T->packed_m = 0;
         return T;
     } else
         return 0;
 }
+/* func of mk_cheby(), for mk_cheby_data() */
+struct CHEBY_FUNC { projUV (*func)(projUV); };
+static projUV
+call_func(projUV arg, void *data) {
+    return (*((struct CHEBY_FUNC *)data)->func)(arg);
+}
 Tseries *
 mk_cheby(projUV a, projUV b, double res, projUV *resid, projUV (*func)(projUV), 
          int nu, int nv, int power) {
+    struct CHEBY_FUNC data;
+
+    data.func = func;
+    return mk_cheby_data(a, b, res, resid, call_func, &data, nu, nv, power);
+}
+static Tseries * /* series of the coefficients of bchgen_values() in w */
+fit_series(projUV a, projUV b, double res, projUV *resid, projUV **w,
+           int nu, int nv, int power) {
     int j, i, nru, nrv, *ncu, *ncv;
-    Tseries *T;
-    projUV **w;
+    Tseries *T = 0;
     double cutres;
 
-    if (!(w = (projUV **)vector2(nu, nv, sizeof(projUV))) ||
-        !(ncu = (int *)vector1(nu + nv, sizeof(int))))
+    if (!(ncu = (int *)vector1(nu + nu, sizeof(int))))
         return 0;
     ncv = ncu + nu;
-    if (!bchgen(a, b, nu, nv, w, func)) {
+    {
         projUV *s;
         double ab, *p;
 
@@ -158,6 +172,8 @@ mk_cheby(projUV a, projUV b, double res, projUV *resid, projUV (*func)(projUV),
         } else
             goto error;
     }
+    if (T) /* a failed packing only slows the _n evaluators */
+        pack_series(T);
     goto gohome;
   error:
     if (T) { /* pj_dalloc up possible allocations */
@@ -171,7 +187,28 @@ mk_cheby(projUV a, projUV b, double res, projUV *resid, projUV (*func)(projUV),
     }
     T = 0;
   gohome:
-    freev2((void **) w, nu);
     pj_dalloc(ncu);
     return T;
 }
+Tseries * /* same as mk_cheby(), with data passed to func */
+mk_cheby_data(projUV a, projUV b, double res, projUV *resid,
+              projUV (*func)(projUV, void *), void *data,
+              int nu, int nv, int power) {
+    Tseries *T = 0;
+    projUV **w;
+
+    if (!(w = (projUV **)vector2(nu, nv, sizeof(projUV))))
+        return 0;
+    if (!bchgen_data(a, b, nu, nv, w, func, data))
+        T = fit_series(a, b, res, resid, w, nu, nv, power);
+    freev2((void **) w, nu);
+    return T;
+}
+Tseries * /* same as mk_cheby(), from the values of func at the
+             bchgen_nodes() of a and b, in w, which is overwritten */
+mk_cheby_values(projUV a, projUV b, double res, projUV *resid, projUV **w,
+                int nu, int nv, int power) {
+    if (bchgen_values(nu, nv, w))
+        return 0;
+    return fit_series(a, b, res, resid, w, nu, nv, power);
+}
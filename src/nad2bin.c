@@ -1,7 +1,11 @@
 /* Convert bivariate ASCII NAD27 to NAD83 tables to NTv2 binary structure */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <ctype.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #define PJ_LIB__
 #include <projects.h>
@@ -46,331 +50,981 @@ static void swap_words( void *data_in, int word_size, int word_count )
 static void Usage()
 {
     fprintf(stderr,
-            "usage: nad2bin [-f ctable/ctable2/ntv2] binary_output < ascii_source\n" );
+            "usage: nad2bin [-j threads] [-f ctable/ctable2/ntv2/cache] binary_output < ascii_source\n"
+            "       nad2bin -f cache -i grid_file binary_output\n"
+            "       nad2bin -f catalog -i catalog.csv catalog.csv.bin\n" );
     exit(1);
 }
 
+/* ==================================================================== */
+/*      Grid cache output, written a block of values at a time.  The    */
+/*      header and index go first with the checksums left out, and      */
+/*      are written again once all the values are.                      */
+/* ==================================================================== */
+
+typedef struct {
+    FILE   *fp;
+    PJ_GRID_CACHE_HEADER header;
+    PJ_GRID_CACHE_ENTRY *entries;
+    int    count;
+    int    grid;                /* whose values are being written */
+} cache_writer;
+
 /************************************************************************/
-/*                                main()                                */
+/*                            cache_begin()                             */
 /************************************************************************/
-int main(int argc, char **argv) {
-    struct CTABLE ct;
-    FLP *p, t;
-    size_t tsize;
-    int i, j, ichk;
-    long lam, laml, phi, phil;
-    FILE *fp;
 
-    const char *output_file = NULL;
+static void cache_begin( cache_writer *w, const char *output_file, int count,
+                         PJ_GRID_CACHE_ENTRY *entries, const char *source )
+{
+    struct stat st;
+    long offset;
+    int i;
 
-    const char *format   = "ctable2";
-    const char *GS_TYPE  = "SECONDS";
-    const char *VERSION  = "";
-    const char *SYSTEM_F = "NAD27";
-    const char *SYSTEM_T = "NAD83";
-    const char *SUB_NAME = "";
-    const char *CREATED  = "";
-    const char *UPDATED  = "";
+    memset( w, 0, sizeof(*w) );
+    w->entries = entries;
+    w->count = count;
+    w->grid = -1;
 
-/* ==================================================================== */
-/*      Process arguments.                                              */
-/* ==================================================================== */
-    for( i = 1; i < argc; i++ )
+    memcpy( w->header.magic, PJ_GRID_CACHE_MAGIC, 16 );
+    w->header.byte_order = PJ_GRID_CACHE_BYTE_ORDER;
+    w->header.grid_count = count;
+    if( source != NULL )
     {
-        if( strcmp(argv[i],"-f") == 0 && i < argc-1 ) 
+        char path[MAX_PATH_FILENAME+1];
+
+        strncpy( w->header.source, source, sizeof(w->header.source)-1 );
+
+        /* relative names may have been found through PROJ_LIB */
+        strncpy( path, source, MAX_PATH_FILENAME );
+        path[MAX_PATH_FILENAME] = '\0';
+        if( stat( path, &st ) != 0 && getenv("PROJ_LIB") != NULL
+            && strlen(getenv("PROJ_LIB")) + strlen(source) + 1 
+               < MAX_PATH_FILENAME )
+            sprintf( path, "%s%c%s", getenv("PROJ_LIB"), DIR_CHAR, source );
+
+        if( stat( path, &st ) == 0 )
         {
-            format = argv[++i];
+            w->header.source_mtime = (double) st.st_mtime;
+            w->header.source_size = (double) st.st_size;
         }
-        else if( output_file == NULL )
+    }
+
+    /* values of each grid start on a 16 byte boundary */
+    offset = sizeof(w->header) + count * sizeof(PJ_GRID_CACHE_ENTRY);
+    for( i = 0; i < count; i++ )
+    {
+        offset = (offset + 15) & ~15L;
+        entries[i].data_offset = (int) offset;
+        entries[i].checksum = 1;
+        offset += sizeof(FLP) * entries[i].lim.lam * entries[i].lim.phi;
+    }
+
+    if (!(w->fp = fopen(output_file, "wb"))) {
+        perror(output_file);
+        exit(2);
+    }
+
+    if( fwrite( &w->header, sizeof(w->header), 1, w->fp ) != 1
+        || fwrite( entries, sizeof(PJ_GRID_CACHE_ENTRY), count, w->fp ) 
+           != count )
+    {
+        perror( "fwrite" );
+        exit( 2 );
+    }
+}
+
+/************************************************************************/
+/*                            cache_values()                            */
+/*                                                                      */
+/*      Append the next values of a grid, written in index order.       */
+/************************************************************************/
+
+static void cache_values( cache_writer *w, int grid, 
+                          const FLP *values, size_t count )
+{
+    PJ_GRID_CACHE_ENTRY *entry = w->entries + grid;
+    size_t size = sizeof(FLP) * count;
+
+    if( grid != w->grid )
+    {
+        static const char zeros[16];
+
+        if( ftell( w->fp ) < entry->data_offset
+            && fwrite( zeros, entry->data_offset - ftell( w->fp ), 1, w->fp )
+            != 1 )
         {
-            output_file = argv[i];
+            perror( "fwrite" );
+            exit( 2 );
         }
-        else
-            Usage();
+        w->grid = grid;
     }
 
-    if( output_file == NULL )
-        Usage();
+    if( size > 0 && fwrite( values, size, 1, w->fp ) != 1 )
+    {
+        perror( "fwrite" );
+        exit( 2 );
+    }
+    entry->checksum = pj_grid_checksum_update( entry->checksum, values, size );
+}
 
-    fprintf( stdout, "Output Binary File Format: %s\n", format );
+/************************************************************************/
+/*                             cache_end()                              */
+/************************************************************************/
 
-/* ==================================================================== */
-/*      Read the ASCII Table                                            */
-/* ==================================================================== */
+static void cache_end( cache_writer *w )
+{
+    w->header.index_checksum = 
+        pj_grid_checksum( w->entries, w->count * sizeof(PJ_GRID_CACHE_ENTRY) );
 
-    if ( NULL == fgets(ct.id, MAX_TAB_ID, stdin) ) {
-        perror("fgets");
-        exit(1);
+    if( fseek( w->fp, 0, SEEK_SET ) != 0
+        || fwrite( &w->header, sizeof(w->header), 1, w->fp ) != 1
+        || fwrite( w->entries, sizeof(PJ_GRID_CACHE_ENTRY), w->count, w->fp )
+           != w->count
+        || fclose( w->fp ) != 0 )
+    {
+        perror( "fwrite" );
+        exit( 2 );
     }
-    if ( EOF == scanf("%d %d %*d %lf %lf %lf %lf", &ct.lim.lam, &ct.lim.phi,
-          &ct.ll.lam, &ct.del.lam, &ct.ll.phi, &ct.del.phi) ) {
-        perror("scanf");
-        exit(1);
+}
+
+/************************************************************************/
+/*                          add_cache_grids()                           */
+/*                                                                      */
+/*      Append a grid list and, right after each grid, its children     */
+/*      to the cache index.                                             */
+/************************************************************************/
+
+static int add_cache_grids( PJ_GRIDINFO *gi, int parent,
+                            PJ_GRID_CACHE_ENTRY *entries, 
+                            PJ_GRIDINFO **grids, int count )
+{
+    for( ; gi != NULL; gi = gi->next )
+    {
+        int self = count;
+
+        if( gi->ct == NULL || pj_gridinfo_heights( gi ) )
+        {
+            fprintf( stderr, "grid %s cannot be cached: %s\n", gi->gridname,
+                     gi->ct == NULL ? "unreadable" 
+                     : "the cache only holds horizontal shifts" );
+            exit( 1 );
+        }
+
+        memset( entries + count, 0, sizeof(PJ_GRID_CACHE_ENTRY) );
+        memcpy( entries[count].id, gi->ct->id, MAX_TAB_ID-1 );
+        entries[count].id[MAX_TAB_ID-1] = '\0';
+        entries[count].ll = gi->ct->ll;
+        entries[count].del = gi->ct->del;
+        entries[count].lim = gi->ct->lim;
+        entries[count].parent = parent;
+        grids[count++] = gi;
+
+        count = add_cache_grids( gi->child, self, entries, grids, count );
+    }
+
+    return count;
+}
+
+/************************************************************************/
+/*                          count_grids()                               */
+/************************************************************************/
+
+static int count_grids( PJ_GRIDINFO *gi )
+{
+    int count = 0;
+
+    for( ; gi != NULL; gi = gi->next )
+        count += 1 + count_grids( gi->child );
+
+    return count;
+}
+
+/************************************************************************/
+/*                          cache_grid_file()                           */
+/*                                                                      */
+/*      Convert a grid file, with all its subgrids, to a grid cache,    */
+/*      reading CACHE_BLOCK_ROWS rows of a grid at a time.              */
+/************************************************************************/
+
+#define CACHE_BLOCK_ROWS 256
+
+static void cache_grid_file( const char *input_grid, const char *output_file )
+{
+    projCtx ctx = pj_get_default_ctx();
+    PJ_GRIDINFO *gilist, **grids;
+    PJ_GRID_CACHE_ENTRY *entries;
+    cache_writer w;
+    int count, i;
+
+    gilist = pj_gridinfo_init( ctx, input_grid );
+    if( gilist == NULL || gilist->ct == NULL )
+    {
+        fprintf( stderr, "failed to open grid %s\n", input_grid );
+        exit( 1 );
     }
-    if (!(ct.cvs = (FLP *)malloc(tsize = ct.lim.lam * ct.lim.phi *
-                                 sizeof(FLP)))) {
+
+    count = count_grids( gilist );
+    entries = (PJ_GRID_CACHE_ENTRY *) 
+        malloc(sizeof(PJ_GRID_CACHE_ENTRY) * count);
+    grids = (PJ_GRIDINFO **) malloc(sizeof(PJ_GRIDINFO *) * count);
+    if( entries == NULL || grids == NULL )
+    {
         perror("mem. alloc");
         exit(1);
     }
-    ct.ll.lam *= DEG_TO_RAD;
-    ct.ll.phi *= DEG_TO_RAD;
-    ct.del.lam *= DEG_TO_RAD;
-    ct.del.phi *= DEG_TO_RAD;
-    /* load table */
-    for (p = ct.cvs, i = 0; i < ct.lim.phi; ++i) {
-        if ( EOF == scanf("%d:%ld %ld", &ichk, &laml, &phil) ) {
-            perror("scanf on row");
-            exit(1);
-        }
-        if (ichk != i) {
-            fprintf(stderr,"format check on row\n");
-            exit(1);
+
+    add_cache_grids( gilist, -1, entries, grids, 0 );
+    cache_begin( &w, output_file, count, entries, gilist->filename );
+
+    for( i = 0; i < count; i++ )
+    {
+        struct CTABLE *ct = grids[i]->ct;
+        FLP *block;
+        PAFile fid;
+        int row;
+
+        block = (FLP *) malloc(sizeof(FLP) * ct->lim.lam * CACHE_BLOCK_ROWS);
+        fid = pj_open_lib( ctx, grids[i]->filename, "rb" );
+        if( block == NULL || fid == NULL )
+        {
+            fprintf( stderr, "failed to load grid %s\n", grids[i]->gridname );
+            exit( 1 );
         }
-        t.lam = laml * U_SEC_TO_RAD;
-        t.phi = phil * U_SEC_TO_RAD;
-        *p++ = t;
-        for (j = 1; j < ct.lim.lam; ++j) {
-            if ( EOF == scanf("%ld %ld", &lam, &phi) ) {
-                perror("scanf on column");
-                exit(1);
+
+        for( row = 0; row < ct->lim.phi; row += CACHE_BLOCK_ROWS )
+        {
+            int rows = MIN(CACHE_BLOCK_ROWS, ct->lim.phi - row);
+
+            if( !pj_gridinfo_load_rows( ctx, grids[i], fid, row, rows, block ) )
+            {
+                fprintf( stderr, "failed to load grid %s\n", 
+                         grids[i]->gridname );
+                exit( 1 );
             }
-            t.lam = (laml += lam) * U_SEC_TO_RAD;
-            t.phi = (phil += phi) * U_SEC_TO_RAD;
-            *p++ = t;
+            cache_values( &w, i, block, (size_t) ct->lim.lam * rows );
         }
-    }
-    if (feof(stdin)) {
-        fprintf(stderr, "premature EOF\n");
-        exit(1);
+
+        pj_ctx_fclose( ctx, fid );
+        free( block );
     }
 
+    cache_end( &w );
+}
+
 /* ==================================================================== */
-/*      Write out the old ctable format - this is machine and byte      */
-/*      order specific.                                                 */
+/*      Output of a grid read from ASCII, written a block of rows at    */
+/*      a time.                                                         */
 /* ==================================================================== */
+
+typedef struct {
+    const char    *format;
+    FILE          *fp;
+    struct CTABLE *ct;
+    cache_writer   cache;
+    PJ_GRID_CACHE_ENTRY entry;
+    float         *row_buf;     /* of ntv2 */
+} grid_output;
+
+/************************************************************************/
+/*                         write_ntv2_header()                          */
+/************************************************************************/
+
+static void write_ntv2_header( FILE *fp, const struct CTABLE *ct )
+{
+    const char *GS_TYPE  = "SECONDS";
+    const char *VERSION  = "";
+    const char *SYSTEM_F = "NAD27";
+    const char *SYSTEM_T = "NAD83";
+    const char *SUB_NAME = "";
+    const char *CREATED  = "";
+    const char *UPDATED  = "";
+
+/* -------------------------------------------------------------------- */
+/*      Write the file header.                                          */
+/* -------------------------------------------------------------------- */
+    {    
+        char achHeader[11*16];
+
+        memset( achHeader, 0, sizeof(achHeader) );
+    
+        memcpy( achHeader +  0*16, "NUM_OREC", 8 );
+        achHeader[ 0*16 + 8] = 0xb;
+
+        memcpy( achHeader +  1*16, "NUM_SREC", 8 );
+        achHeader[ 1*16 + 8] = 0xb;
+
+        memcpy( achHeader +  2*16, "NUM_FILE", 8 );
+        achHeader[ 2*16 + 8] = 0x1;
+
+        memcpy( achHeader +  3*16, "GS_TYPE         ", 16 );
+        memcpy( achHeader +  3*16+8, GS_TYPE, MIN(16,strlen(GS_TYPE)) );
+
+        memcpy( achHeader +  4*16, "VERSION         ", 16 );
+        memcpy( achHeader +  4*16+8, VERSION, MIN(16,strlen(VERSION)) );
+
+        memcpy( achHeader +  5*16, "SYSTEM_F        ", 16 );
+        memcpy( achHeader +  5*16+8, SYSTEM_F, MIN(16,strlen(SYSTEM_F)) );
+
+        memcpy( achHeader +  6*16, "SYSTEM_T        ", 16 );
+        memcpy( achHeader +  6*16+8, SYSTEM_T, MIN(16,strlen(SYSTEM_T)) );
+
+        memcpy( achHeader +  7*16, "MAJOR_F ", 8);
+        memcpy( achHeader +  8*16, "MINOR_F ", 8 );
+        memcpy( achHeader +  9*16, "MAJOR_T ", 8 );
+        memcpy( achHeader + 10*16, "MINOR_T ", 8 );
+
+        fwrite( achHeader, 1, sizeof(achHeader), fp );
+    }
+    
+/* -------------------------------------------------------------------- */
+/*      Write the grid header.                                          */
+/* -------------------------------------------------------------------- */
+    {
+        unsigned char achHeader[11*16];
+        double dfValue;
+        int nGSCount = ct->lim.lam * ct->lim.phi;
+        LP ur;
+
+        ur.lam = ct->ll.lam + (ct->lim.lam-1) * ct->del.lam;
+        ur.phi = ct->ll.phi + (ct->lim.phi-1) * ct->del.phi;
+
+        assert( sizeof(nGSCount) == 4 );
+
+        memset( achHeader, 0, sizeof(achHeader) );
+
+        memcpy( achHeader +  0*16, "SUB_NAME        ", 16 );
+        memcpy( achHeader +  0*16+8, SUB_NAME, MIN(16,strlen(SUB_NAME)) );
+
+        memcpy( achHeader +  1*16, "PARENT          ", 16 );
+        memcpy( achHeader +  1*16+8, "NONE", MIN(16,strlen("NONE")) );
+
+        memcpy( achHeader +  2*16, "CREATED         ", 16 );
+        memcpy( achHeader +  2*16+8, CREATED, MIN(16,strlen(CREATED)) );
+
+        memcpy( achHeader +  3*16, "UPDATED         ", 16 );
+        memcpy( achHeader +  3*16+8, UPDATED, MIN(16,strlen(UPDATED)) );
+
+        memcpy( achHeader +  4*16, "S_LAT   ", 8 );
+        dfValue = ct->ll.phi * 3600.0 / DEG_TO_RAD;
+        memcpy( achHeader +  4*16 + 8, &dfValue, 8 );
+
+        memcpy( achHeader +  5*16, "N_LAT   ", 8 );
+        dfValue = ur.phi * 3600.0 / DEG_TO_RAD;
+        memcpy( achHeader +  5*16 + 8, &dfValue, 8 );
+
+        memcpy( achHeader +  6*16, "E_LONG  ", 8 );
+        dfValue = -1 * ur.lam * 3600.0 / DEG_TO_RAD;
+        memcpy( achHeader +  6*16 + 8, &dfValue, 8 );
+
+        memcpy( achHeader +  7*16, "W_LONG  ", 8 );
+        dfValue = -1 * ct->ll.lam * 3600.0 / DEG_TO_RAD;
+        memcpy( achHeader +  7*16 + 8, &dfValue, 8 );
+
+        memcpy( achHeader +  8*16, "LAT_INC ", 8 );
+        dfValue = ct->del.phi * 3600.0 / DEG_TO_RAD;
+        memcpy( achHeader +  8*16 + 8, &dfValue, 8 );
+
+        memcpy( achHeader +  9*16, "LONG_INC", 8 );
+        dfValue = ct->del.lam * 3600.0 / DEG_TO_RAD;
+        memcpy( achHeader +  9*16 + 8, &dfValue, 8 );
+
+        memcpy( achHeader + 10*16, "GS_COUNT", 8 );
+        memcpy( achHeader + 10*16+8, &nGSCount, 4 );
+
+        if( !IS_LSB ) 
+        {
+            swap_words( achHeader +  4*16 + 8, 8, 1 );
+            swap_words( achHeader +  5*16 + 8, 8, 1 );
+            swap_words( achHeader +  6*16 + 8, 8, 1 );
+            swap_words( achHeader +  7*16 + 8, 8, 1 );
+            swap_words( achHeader +  8*16 + 8, 8, 1 );
+            swap_words( achHeader +  9*16 + 8, 8, 1 );
+            swap_words( achHeader + 10*16 + 8, 4, 1 );
+        }
+
+        fwrite( achHeader, 1, sizeof(achHeader), fp );
+    }
+}
+
+/************************************************************************/
+/*                            output_begin()                            */
+/*                                                                      */
+/*      Create the output file, and write what comes before the         */
+/*      values.                                                         */
+/************************************************************************/
+
+static void output_begin( grid_output *out, const char *format, 
+                          const char *output_file, struct CTABLE *ct )
+{
+    memset( out, 0, sizeof(*out) );
+    out->format = format;
+    out->ct = ct;
+
+/* -------------------------------------------------------------------- */
+/*      A single grid cache.                                            */
+/* -------------------------------------------------------------------- */
+    if( strcmp(format,"cache") == 0 ) 
+    {
+        memcpy( out->entry.id, ct->id, MAX_TAB_ID );
+        out->entry.id[MAX_TAB_ID-1] = '\0';
+        out->entry.ll = ct->ll;
+        out->entry.del = ct->del;
+        out->entry.lim = ct->lim;
+        out->entry.parent = -1;
+
+        cache_begin( &out->cache, output_file, 1, &out->entry, NULL );
+        return;
+    }
+
+    if (!(out->fp = fopen(output_file, "wb"))) {
+        perror(output_file);
+        exit(2);
+    }
+
+/* -------------------------------------------------------------------- */
+/*      The old ctable format - this is machine and byte order          */
+/*      specific.                                                       */
+/* -------------------------------------------------------------------- */
     if( strcmp(format,"ctable") == 0 ) 
     {
-	if (!(fp = fopen(output_file, "wb"))) {
-            perror(output_file);
-            exit(2);
-	}
-	if (fwrite(&ct, sizeof(ct), 1, fp) != 1 ||
-            fwrite(ct.cvs, tsize, 1, fp) != 1) {
+        if (fwrite(ct, sizeof(*ct), 1, out->fp) != 1) {
             fprintf(stderr, "output failure\n");
             exit(2);
-	}
-        fclose( fp );
-	exit(0); /* normal completion */
+        }
     }
 
-/* ==================================================================== */
-/*      Write out the old ctable format - this is machine and byte      */
-/*      order specific.                                                 */
-/* ==================================================================== */
-    if( strcmp(format,"ctable2") == 0 ) 
+/* -------------------------------------------------------------------- */
+/*      The ctable2 format, of LSB values.                              */
+/* -------------------------------------------------------------------- */
+    else if( strcmp(format,"ctable2") == 0 ) 
     {
         char header[160];
 
-	if (!(fp = fopen(output_file, "wb"))) {
-            perror(output_file);
-            exit(2);
-	}
-
         assert( MAX_TAB_ID == 80 );
         assert( sizeof(int) == 4 ); /* for ct.lim.lam/phi */
 
         memset( header, 0, sizeof(header) );
 
         memcpy( header +   0, "CTABLE V2.0     ", 16 );
-        memcpy( header +  16, ct.id, 80 );
-        memcpy( header +  96, &ct.ll.lam, 8 );
-        memcpy( header + 104, &ct.ll.phi, 8 );
-        memcpy( header + 112, &ct.del.lam, 8 );
-        memcpy( header + 120, &ct.del.phi, 8 );
-        memcpy( header + 128, &ct.lim.lam, 4 );
-        memcpy( header + 132, &ct.lim.phi, 4 );
+        memcpy( header +  16, ct->id, 80 );
+        memcpy( header +  96, &ct->ll.lam, 8 );
+        memcpy( header + 104, &ct->ll.phi, 8 );
+        memcpy( header + 112, &ct->del.lam, 8 );
+        memcpy( header + 120, &ct->del.phi, 8 );
+        memcpy( header + 128, &ct->lim.lam, 4 );
+        memcpy( header + 132, &ct->lim.phi, 4 );
 
         /* force into LSB format */
         if( !IS_LSB ) 
         {
             swap_words( header +  96, 8, 4 );
             swap_words( header + 128, 4, 2 );
-            swap_words( ct.cvs, 4, ct.lim.lam * 2 * ct.lim.phi );
         }
 
-        if( fwrite( header, sizeof(header), 1, fp ) != 1 ) {
+        if( fwrite( header, sizeof(header), 1, out->fp ) != 1 ) {
             perror( "fwrite" );
             exit( 2 );
         }
+    }
 
-	if (fwrite(ct.cvs, tsize, 1, fp) != 1) {
-            perror( "fwrite" );
-            exit(2);
-	}
+/* -------------------------------------------------------------------- */
+/*      The NTv2 format grid shift file.                                */
+/* -------------------------------------------------------------------- */
+    else if( strcmp(format,"ntv2") == 0 ) 
+    {
+        write_ntv2_header( out->fp, ct );
+
+        out->row_buf = (float *) pj_malloc(ct->lim.lam * sizeof(float) * 4);
+        if( out->row_buf == NULL )
+        {
+            perror("mem. alloc");
+            exit(1);
+        }
+        /* We leave the accuracy values as zero */
+        memset( out->row_buf, 0, ct->lim.lam * sizeof(float) * 4 );
+    }
+}
+
+/************************************************************************/
+/*                            output_rows()                             */
+/*                                                                      */
+/*      Write the next row_count rows of values, which may be           */
+/*      changed in the process.                                         */
+/************************************************************************/
+
+static void output_rows( grid_output *out, FLP *cvs, int row_count )
+{
+    const struct CTABLE *ct = out->ct;
+    size_t words = (size_t) ct->lim.lam * row_count;
+    int row;
 
-        fclose( fp );
-	exit(0); /* normal completion */
+    if( strcmp(out->format,"cache") == 0 ) 
+    {
+        cache_values( &out->cache, 0, cvs, words );
+        return;
     }
 
-/* ==================================================================== */
-/*      Write out the NTv2 format grid shift file.                      */
-/* ==================================================================== */
-    if( strcmp(format,"ntv2") == 0 ) 
+    if( strcmp(out->format,"ntv2") != 0 ) 
     {
-        if (!(fp = fopen(output_file, "wb"))) 
+        /* ctable2 values are LSB */
+        if( strcmp(out->format,"ctable2") == 0 && !IS_LSB )
+            swap_words( cvs, 4, (int) words * 2 );
+
+        if( fwrite( cvs, sizeof(FLP), words, out->fp ) != words ) {
+            perror( "fwrite" );
+            exit( 2 );
+        }
+        return;
+    }
+
+    for( row = 0; row < row_count; row++ )
+    {
+        float *row_buf = out->row_buf;
+        int	    i;
+
+        for( i = 0; i < ct->lim.lam; i++ )
         {
-            perror(output_file);
-            exit(2);
+            FLP *value = cvs + (row) * ct->lim.lam + (ct->lim.lam - i - 1);
+
+            /* convert radians to seconds */
+            row_buf[i*4+0] = value->phi * (3600.0 / (PI/180.0));
+            row_buf[i*4+1] = value->lam * (3600.0 / (PI/180.0));
         }
-        
-/* -------------------------------------------------------------------- */
-/*      Write the file header.                                          */
-/* -------------------------------------------------------------------- */
-        {    
-            char achHeader[11*16];
 
-            memset( achHeader, 0, sizeof(achHeader) );
-        
-            memcpy( achHeader +  0*16, "NUM_OREC", 8 );
-            achHeader[ 0*16 + 8] = 0xb;
+        if( !IS_LSB )
+            swap_words( row_buf, 4, ct->lim.lam * 4 );
 
-            memcpy( achHeader +  1*16, "NUM_SREC", 8 );
-            achHeader[ 1*16 + 8] = 0xb;
+        if( fwrite( row_buf, sizeof(float), ct->lim.lam*4, out->fp ) 
+            != 4 * ct->lim.lam )
+        {
+            perror( "write()" );
+            exit( 2 );
+        }
+    }
+}
 
-            memcpy( achHeader +  2*16, "NUM_FILE", 8 );
-            achHeader[ 2*16 + 8] = 0x1;
+/************************************************************************/
+/*                             output_end()                             */
+/************************************************************************/
 
-            memcpy( achHeader +  3*16, "GS_TYPE         ", 16 );
-            memcpy( achHeader +  3*16+8, GS_TYPE, MIN(16,strlen(GS_TYPE)) );
+static void output_end( grid_output *out )
+{
+    if( strcmp(out->format,"cache") == 0 ) 
+    {
+        cache_end( &out->cache );
+        return;
+    }
 
-            memcpy( achHeader +  4*16, "VERSION         ", 16 );
-            memcpy( achHeader +  4*16+8, VERSION, MIN(16,strlen(VERSION)) );
+    if( fclose( out->fp ) != 0 ) 
+    {
+        perror( "fclose" );
+        exit( 2 );
+    }
+    pj_dalloc( out->row_buf );
+}
 
-            memcpy( achHeader +  5*16, "SYSTEM_F        ", 16 );
-            memcpy( achHeader +  5*16+8, SYSTEM_F, MIN(16,strlen(SYSTEM_F)) );
+/* ==================================================================== */
+/*      Parsing of the rows of an ASCII table, each of a row number     */
+/*      and colon, the first node in integer seconds and the            */
+/*      differences of the next ones to it.  The text is read           */
+/*      LLA_CHUNK bytes at a time, and the complete rows of a chunk     */
+/*      parsed into their values on up to the -j number of threads,     */
+/*      as rows are independent of each other.                          */
+/* ==================================================================== */
 
-            memcpy( achHeader +  6*16, "SYSTEM_T        ", 16 );
-            memcpy( achHeader +  6*16+8, SYSTEM_T, MIN(16,strlen(SYSTEM_T)) );
+#define LLA_CHUNK   (8 * 1024 * 1024)
 
-            memcpy( achHeader +  7*16, "MAJOR_F ", 8);
-            memcpy( achHeader +  8*16, "MINOR_F ", 8 );
-            memcpy( achHeader +  9*16, "MAJOR_T ", 8 );
-            memcpy( achHeader + 10*16, "MINOR_T ", 8 );
+typedef struct {
+    const char **starts;        /* of each row, and of the next */
+    int    first;               /* row number of starts[0] */
+    int    begin, end;          /* rows of this job, in starts */
+    int    last;                /* the last row of the table */
+    int    cols;
+    FLP   *cvs;                 /* of row starts[0] */
+    int    bad_row;             /* the first that failed, or -1 */
+    int    status;              /* of lla_row() for it */
+    void  *thread;
+} lla_job;
 
-            fwrite( achHeader, 1, sizeof(achHeader), fp );
-        }
-        
-/* -------------------------------------------------------------------- */
-/*      Write the grid header.                                          */
-/* -------------------------------------------------------------------- */
+/************************************************************************/
+/*                             lla_long()                               */
+/*                                                                      */
+/*      Parse an integer, as %ld of scanf(), returning the end of it    */
+/*      or NULL if there is none before end.                            */
+/************************************************************************/
+
+static const char *lla_long( const char *p, const char *end, long *value )
+{
+    long v = 0;
+    int  negative = 0;
+
+    while( p < end && isspace((unsigned char) *p) )
+        p++;
+    if( p < end && (*p == '-' || *p == '+') )
+        negative = *(p++) == '-';
+    if( p == end || !isdigit((unsigned char) *p) )
+        return NULL;
+
+    while( p < end && isdigit((unsigned char) *p) )
+        v = v * 10 + (*(p++) - '0');
+
+    *value = negative ? -v : v;
+    return p;
+}
+
+/************************************************************************/
+/*                             lla_row()                                */
+/*                                                                      */
+/*      Parse the text of a row between p and end.  Only whitespace     */
+/*      may follow its values, except after the last row.  Returns 1,   */
+/*      0 if the row is malformed, or -1 if the text ends before its    */
+/*      values do.                                                      */
+/************************************************************************/
+
+static int lla_short( const char *p, const char *end )
+{
+    while( p < end && isspace((unsigned char) *p) )
+        p++;
+    return p == end ? -1 : 0;
+}
+
+static int lla_row( const char *p, const char *end, int row, int last,
+                    int cols, FLP *cvs )
+{
+    const char *next;
+    long ichk, lam, phi, laml, phil;
+    int  j;
+
+    if( (next = lla_long( p, end, &ichk )) == NULL )
+        return lla_short( p, end );
+    if( next == end || *next != ':' || ichk != row )
+        return 0;
+    if( (next = lla_long( p = next + 1, end, &laml )) == NULL
+        || (next = lla_long( p = next, end, &phil )) == NULL )
+        return lla_short( p, end );
+    p = next;
+
+    cvs[0].lam = laml * U_SEC_TO_RAD;
+    cvs[0].phi = phil * U_SEC_TO_RAD;
+    for (j = 1; j < cols; ++j) {
+        if( (next = lla_long( p, end, &lam )) == NULL
+            || (next = lla_long( p = next, end, &phi )) == NULL )
+            return lla_short( p, end );
+        p = next;
+        cvs[j].lam = (laml += lam) * U_SEC_TO_RAD;
+        cvs[j].phi = (phil += phi) * U_SEC_TO_RAD;
+    }
+
+    if( row != last && lla_short( p, end ) != -1 )
+        return 0;
+
+    return 1;
+}
+
+/************************************************************************/
+/*                            lla_parse()                               */
+/************************************************************************/
+
+static void lla_parse( void *arg )
+{
+    lla_job *job = (lla_job *) arg;
+    int i;
+
+    job->bad_row = -1;
+    for( i = job->begin; i < job->end; i++ )
+    {
+        job->status = lla_row( job->starts[i], job->starts[i+1], 
+                               job->first + i, job->last, job->cols, 
+                               job->cvs + (size_t) i * job->cols );
+        if( job->status != 1 )
         {
-            unsigned char achHeader[11*16];
-            double dfValue;
-            int nGSCount = ct.lim.lam * ct.lim.phi;
-            LP ur;
+            job->bad_row = i;
+            return;
+        }
+    }
+}
 
-            ur.lam = ct.ll.lam + (ct.lim.lam-1) * ct.del.lam;
-            ur.phi = ct.ll.phi + (ct.lim.phi-1) * ct.del.phi;
+/************************************************************************/
+/*                           convert_lla()                              */
+/*                                                                      */
+/*      Convert the rows of the ASCII table on stdin, after its         */
+/*      header, to out.                                                 */
+/************************************************************************/
 
-            assert( sizeof(nGSCount) == 4 );
+static void convert_lla( struct CTABLE *ct, grid_output *out, int threads )
+{
+    char   *text = NULL;
+    const char **starts = NULL;
+    FLP    *cvs = NULL;
+    size_t  size = 0, alloc = 0;
+    int     starts_alloc = 0, cvs_rows = 0, row = 0, at_eof = 0, j;
+    lla_job *jobs;
 
-            memset( achHeader, 0, sizeof(achHeader) );
+    jobs = (lla_job *) calloc( threads, sizeof(lla_job) );
+    if( jobs == NULL )
+    {
+        perror("mem. alloc");
+        exit(1);
+    }
 
-            memcpy( achHeader +  0*16, "SUB_NAME        ", 16 );
-            memcpy( achHeader +  0*16+8, SUB_NAME, MIN(16,strlen(SUB_NAME)) );
-    
-            memcpy( achHeader +  1*16, "PARENT          ", 16 );
-            memcpy( achHeader +  1*16+8, "NONE", MIN(16,strlen("NONE")) );
-    
-            memcpy( achHeader +  2*16, "CREATED         ", 16 );
-            memcpy( achHeader +  2*16+8, CREATED, MIN(16,strlen(CREATED)) );
-    
-            memcpy( achHeader +  3*16, "UPDATED         ", 16 );
-            memcpy( achHeader +  3*16+8, UPDATED, MIN(16,strlen(UPDATED)) );
+    while( row < ct->lim.phi )
+    {
+        int count = 0, rows;
+        const char *p;
 
-            memcpy( achHeader +  4*16, "S_LAT   ", 8 );
-            dfValue = ct.ll.phi * 3600.0 / DEG_TO_RAD;
-            memcpy( achHeader +  4*16 + 8, &dfValue, 8 );
+/* -------------------------------------------------------------------- */
+/*      Read on, growing the buffer if the rows seen so far fill it.    */
+/* -------------------------------------------------------------------- */
+        if( !at_eof )
+        {
+            size_t got;
 
-            memcpy( achHeader +  5*16, "N_LAT   ", 8 );
-            dfValue = ur.phi * 3600.0 / DEG_TO_RAD;
-            memcpy( achHeader +  5*16 + 8, &dfValue, 8 );
+            if( size == alloc )
+            {
+                alloc = alloc == 0 ? LLA_CHUNK : alloc * 2;
+                if( (text = (char *) realloc( text, alloc )) == NULL )
+                {
+                    perror("mem. alloc");
+                    exit(1);
+                }
+            }
+            got = fread( text + size, 1, alloc - size, stdin );
+            size += got;
+            at_eof = got == 0;
+        }
 
-            memcpy( achHeader +  6*16, "E_LONG  ", 8 );
-            dfValue = -1 * ur.lam * 3600.0 / DEG_TO_RAD;
-            memcpy( achHeader +  6*16 + 8, &dfValue, 8 );
+/* -------------------------------------------------------------------- */
+/*      Rows start with the number before a colon.  The last row of     */
+/*      the text may be incomplete until the end of the input.          */
+/* -------------------------------------------------------------------- */
+        for( p = text; p < text + size; p++ )
+        {
+            const char *start = p;
 
-            memcpy( achHeader +  7*16, "W_LONG  ", 8 );
-            dfValue = -1 * ct.ll.lam * 3600.0 / DEG_TO_RAD;
-            memcpy( achHeader +  7*16 + 8, &dfValue, 8 );
+            if( *p != ':' )
+                continue;
+            while( start > text && isdigit((unsigned char) start[-1]) )
+                start--;
+            if( start > text && (start[-1] == '-' || start[-1] == '+') )
+                start--;
 
-            memcpy( achHeader +  8*16, "LAT_INC ", 8 );
-            dfValue = ct.del.phi * 3600.0 / DEG_TO_RAD;
-            memcpy( achHeader +  8*16 + 8, &dfValue, 8 );
-    
-            memcpy( achHeader +  9*16, "LONG_INC", 8 );
-            dfValue = ct.del.lam * 3600.0 / DEG_TO_RAD;
-            memcpy( achHeader +  9*16 + 8, &dfValue, 8 );
-    
-            memcpy( achHeader + 10*16, "GS_COUNT", 8 );
-            memcpy( achHeader + 10*16+8, &nGSCount, 4 );
-    
-            if( !IS_LSB ) 
+            if( count + 1 >= starts_alloc )
+            {
+                starts_alloc = starts_alloc * 2 + 4096;
+                starts = (const char **) 
+                    realloc( (void *) starts, sizeof(char *) * starts_alloc );
+                if( starts == NULL )
+                {
+                    perror("mem. alloc");
+                    exit(1);
+                }
+            }
+            starts[count++] = start;
+        }
+
+        /* nothing but whitespace before the first row */
+        for( p = text; row == 0 && count > 0 && p < starts[0]; p++ )
+        {
+            if( !isspace((unsigned char) *p) )
             {
-                swap_words( achHeader +  4*16 + 8, 8, 1 );
-                swap_words( achHeader +  5*16 + 8, 8, 1 );
-                swap_words( achHeader +  6*16 + 8, 8, 1 );
-                swap_words( achHeader +  7*16 + 8, 8, 1 );
-                swap_words( achHeader +  8*16 + 8, 8, 1 );
-                swap_words( achHeader +  9*16 + 8, 8, 1 );
-                swap_words( achHeader + 10*16 + 8, 4, 1 );
+                fprintf(stderr,"format check on row\n");
+                exit(1);
             }
+        }
 
-            fwrite( achHeader, 1, sizeof(achHeader), fp );
+        rows = at_eof ? count : count - 1;
+        if( rows > ct->lim.phi - row )
+            rows = ct->lim.phi - row;
+        if( rows <= 0 )
+        {
+            if( at_eof )
+            {
+                fprintf(stderr, "premature EOF\n");
+                exit(1);
+            }
+            continue;
         }
+        starts[count] = text + size;
 
 /* -------------------------------------------------------------------- */
-/*      Write the actual grid cells.                                    */
+/*      Parse the complete rows, split across the threads.              */
 /* -------------------------------------------------------------------- */
+        if( rows > cvs_rows )
         {
-            float *row_buf;
-            int row;
+            cvs_rows = rows;
+            cvs = (FLP *) realloc( cvs, sizeof(FLP) * ct->lim.lam * cvs_rows );
+            if( cvs == NULL )
+            {
+                perror("mem. alloc");
+                exit(1);
+            }
+        }
 
-            row_buf = (float *) pj_malloc(ct.lim.lam * sizeof(float) * 4);
-            memset( row_buf, 0, sizeof(float)*4 );
+        for( j = 0; j < threads; j++ )
+        {
+            lla_job *job = jobs + j;
 
-            for( row = 0; row < ct.lim.phi; row++ )
-            {
-                int	    i;
+            job->starts = starts;
+            job->first = row;
+            job->begin = (int) ((double) rows * j / threads);
+            job->end = (int) ((double) rows * (j + 1) / threads);
+            job->last = ct->lim.phi - 1;
+            job->cols = ct->lim.lam;
+            job->cvs = cvs;
+            job->thread = NULL;
+            if( j > 0 && job->end > job->begin )
+                job->thread = pj_thread_start( lla_parse, job );
+        }
+        for( j = 0; j < threads; j++ )
+        {
+            if( j == 0 || jobs[j].thread == NULL )
+                lla_parse( jobs + j );
+            else
+                pj_thread_join( jobs[j].thread );
+        }
+        for( j = 0; j < threads; j++ )
+        {
+            if( jobs[j].bad_row < 0 )
+                continue;
 
-                for( i = 0; i < ct.lim.lam; i++ )
-                {
-                    FLP *cvs = ct.cvs + (row) * ct.lim.lam
-                        + (ct.lim.lam - i - 1);
+            /* the text ran out in its last row */
+            if( at_eof && jobs[j].status == -1 
+                && jobs[j].bad_row == count - 1 )
+                fprintf(stderr, "premature EOF\n");
+            else
+                fprintf(stderr, "format check on row %d\n", 
+                        row + jobs[j].bad_row);
+            exit(1);
+        }
 
-                    /* convert radians to seconds */
-                    row_buf[i*4+0] = cvs->phi * (3600.0 / (PI/180.0));
-                    row_buf[i*4+1] = cvs->lam * (3600.0 / (PI/180.0));
+        output_rows( out, cvs, rows );
+        row += rows;
 
-                    /* We leave the accuracy values as zero */
-                }
+        /* keep the text of the rows still to parse */
+        if( rows < count )
+        {
+            size -= starts[rows] - text;
+            memmove( text, starts[rows], size );
+        }
+        else
+            size = 0;
+    }
 
-                if( !IS_LSB )
-                    swap_words( row_buf, 4, ct.lim.lam * 4 );
+    free( text );
+    free( (void *) starts );
+    free( cvs );
+    free( jobs );
+}
 
-                if( fwrite( row_buf, sizeof(float), ct.lim.lam*4, fp ) 
-                    != 4 * ct.lim.lam )
-                {
-                    perror( "write()" );
-                    exit( 2 );
-                }
-            }
+/************************************************************************/
+/*                                main()                                */
+/************************************************************************/
+int main(int argc, char **argv) {
+    struct CTABLE ct;
+    grid_output out;
+    int i, threads = 1;
+
+    const char *output_file = NULL;
+    const char *input_grid = NULL;
+
+    const char *format   = "ctable2";
+
+/* ==================================================================== */
+/*      Process arguments.                                              */
+/* ==================================================================== */
+    for( i = 1; i < argc; i++ )
+    {
+        if( strcmp(argv[i],"-f") == 0 && i < argc-1 ) 
+        {
+            format = argv[++i];
         }
+        else if( strcmp(argv[i],"-i") == 0 && i < argc-1 ) 
+        {
+            input_grid = argv[++i];
+        }
+        else if( strcmp(argv[i],"-j") == 0 && i < argc-1 ) 
+        {
+            if( (threads = atoi(argv[++i])) < 1 )
+                Usage();
+        }
+        else if( output_file == NULL )
+        {
+            output_file = argv[i];
+        }
+        else
+            Usage();
+    }
+
+    if( output_file == NULL )
+        Usage();
 
-        fclose( fp );
+    fprintf( stdout, "Output Binary File Format: %s\n", format );
+
+/* ==================================================================== */
+/*      Convert a csv grid catalog to its binary form, which is used    */
+/*      in place of the csv as long as the csv does not change.         */
+/* ==================================================================== */
+    if( input_grid != NULL && strcmp(format,"catalog") == 0 )
+    {
+        projCtx ctx = pj_get_default_ctx();
+
+        if( pj_gc_writecatalog( ctx, input_grid, output_file ) != 0 )
+        {
+            fprintf( stderr, "failed to convert catalog %s: %s\n", 
+                     input_grid, pj_strerrno( pj_ctx_get_errno( ctx ) ) );
+            exit( 1 );
+        }
         exit(0); /* normal completion */
     }
 
-    fprintf( stderr, "Unsupported format, nothing written.\n" );
-    exit( 3 );
+/* ==================================================================== */
+/*      Convert an existing grid file, with all its subgrids, to a      */
+/*      grid cache.                                                     */
+/* ==================================================================== */
+    if( input_grid != NULL )
+    {
+        if( strcmp(format,"cache") != 0 )
+            Usage();
+
+        cache_grid_file( input_grid, output_file );
+        exit(0); /* normal completion */
+    }
+
+    if( strcmp(format,"ctable") != 0 && strcmp(format,"ctable2") != 0
+        && strcmp(format,"cache") != 0 && strcmp(format,"ntv2") != 0 )
+    {
+        fprintf( stderr, "Unsupported format, nothing written.\n" );
+        exit( 3 );
+    }
+
+/* ==================================================================== */
+/*      Read the ASCII Table header, and convert its rows as they       */
+/*      are read.                                                       */
+/* ==================================================================== */
+
+    memset( &ct, 0, sizeof(ct) );
+    if ( NULL == fgets(ct.id, MAX_TAB_ID, stdin) ) {
+        perror("fgets");
+        exit(1);
+    }
+    if ( EOF == scanf("%d %d %*d %lf %lf %lf %lf", &ct.lim.lam, &ct.lim.phi,
+          &ct.ll.lam, &ct.del.lam, &ct.ll.phi, &ct.del.phi) ) {
+        perror("scanf");
+        exit(1);
+    }
+    if ( ct.lim.lam < 1 || ct.lim.phi < 1 ) {
+        fprintf(stderr, "bad grid size\n");
+        exit(1);
+    }
+    ct.ll.lam *= DEG_TO_RAD;
+    ct.ll.phi *= DEG_TO_RAD;
+    ct.del.lam *= DEG_TO_RAD;
+    ct.del.phi *= DEG_TO_RAD;
+
+    output_begin( &out, format, output_file, &ct );
+    convert_lla( &ct, &out, threads );
+    output_end( &out );
+
+    exit(0); /* normal completion */
 }
@@ -2,8 +2,53 @@
 #include <projects.h>
 #define MAX_TRY 9
 #define TOL 1e-12
-	LP
-nad_cvt(LP in, int inverse, struct CTABLE *ct) {
+/* gi is only set for grids read through the context tile cache */
+#define INTR(t) (gi != NULL ? nad_intr_tiled(t, ctx, gi) : nad_intr(t, ct))
+/* Newton step of the inverse: r is the residual of the forward shift at
+   t, and d_lam/d_phi the slopes of the shift there.  The Jacobian is
+   within a few 1e-5 of unity for any real grid; should it not be, the
+   plain fixed point step r is taken instead. */
+	static LP
+nad_newton(LP r, LP d_lam, LP d_phi) {
+	double a = 1. - d_lam.lam, b = -d_phi.lam;
+	double c = d_lam.phi, d = 1. + d_phi.phi;
+	double det = a * d - b * c;
+	LP dif;
+
+	if (fabs(det) < 0.5)
+		return r;
+	dif.lam = (d * r.lam - b * r.phi) / det;
+	dif.phi = (a * r.phi - c * r.lam) / det;
+	return dif;
+}
+/* Inverse of a point whose Newton iteration left the grid, by the fixed
+   point iteration from the first order guess used before it.  The result
+   is an approximation either way, and this one keeps the values points
+   on or just outside the edge of a grid have always had (#141). */
+	static LP
+nad_cvt_edge(LP tb, struct CTABLE *ct, projCtx ctx, PJ_GRIDINFO *gi) {
+	LP t, del, dif;
+	int i = MAX_TRY;
+
+	t = INTR(tb);
+	if (t.lam == HUGE_VAL) return t;
+	t.lam = tb.lam + t.lam;
+	t.phi = tb.phi - t.phi;
+
+	do {
+		del = INTR(t);
+		if (del.lam == HUGE_VAL)
+			break;	/* the first approximation, see nad_cvt_core() */
+
+		t.lam -= dif.lam = t.lam - del.lam - tb.lam;
+		t.phi -= dif.phi = t.phi + del.phi - tb.phi;
+	} while (i-- && fabs(dif.lam) > TOL && fabs(dif.phi) > TOL);
+	if (i < 0)
+		t.lam = t.phi = HUGE_VAL;
+	return t;
+}
+	static LP
+nad_cvt_core(LP in, int inverse, struct CTABLE *ct, projCtx ctx, PJ_GRIDINFO *gi) {
 	LP t, tb;
 
 	if (in.lam == HUGE_VAL)
@@ -13,17 +58,30 @@ nad_cvt(LP in, int inverse, struct CTABLE *ct) {
 	tb.lam -= ct->ll.lam;
 	tb.phi -= ct->ll.phi;
 	tb.lam = adjlon(tb.lam - PI) + PI;
-	t = nad_intr(tb, ct);
 	if (inverse) {
-		LP del, dif;
+		LP del, dif, d_lam, d_phi;
 		int i = MAX_TRY;
 
-		if (t.lam == HUGE_VAL) return t;
-		t.lam = tb.lam + t.lam;
-		t.phi = tb.phi - t.phi;
+		/* Newton iteration on the forward shift, from the input point.
+		   The slopes at tb are kept for the later steps, as they barely
+		   change over the length of a shift: the first step is already
+		   good to second order, and the next one normally converges. */
+		t = tb;
+		del = nad_intr_slope(t, ct, ctx, gi, &d_lam, &d_phi);
+		if (del.lam == HUGE_VAL) return del;
 
 		do {
-			del = nad_intr(t, ct);
+			LP r;
+
+			r.lam = t.lam - del.lam - tb.lam;
+			r.phi = t.phi + del.phi - tb.phi;
+			dif = nad_newton(r, d_lam, d_phi);
+			t.lam -= dif.lam;
+			t.phi -= dif.phi;
+			if (fabs(dif.lam) <= TOL && fabs(dif.phi) <= TOL)
+				break;
+
+			del = INTR(t);
 
                         /* This case used to return failure, but I have
                            changed it to return the first order approximation
@@ -41,12 +99,11 @@ nad_cvt(LP in, int inverse, struct CTABLE *ct) {
                                          "Inverse grid shift iteration failed, presumably at grid edge.\n"
                                          "Using first approximation.\n" );
                             /* return del */;
+                            t = nad_cvt_edge(tb, ct, ctx, gi);
+                            if (t.lam == HUGE_VAL) return t;
                             break;
                         }
-
-			t.lam -= dif.lam = t.lam - del.lam - tb.lam;
-			t.phi -= dif.phi = t.phi + del.phi - tb.phi;
-		} while (i-- && fabs(dif.lam) > TOL && fabs(dif.phi) > TOL);
+		} while (i--);
 		if (i < 0) {
                     if( getenv( "PROJ_DEBUG" ) != NULL )
                         fprintf( stderr, 
@@ -57,6 +114,7 @@ nad_cvt(LP in, int inverse, struct CTABLE *ct) {
 		in.lam = adjlon(t.lam + ct->ll.lam);
 		in.phi = t.phi + ct->ll.phi;
 	} else {
+		t = INTR(tb);
 		if (t.lam == HUGE_VAL)
 			in = t;
 		else {
@@ -65,4 +123,153 @@ nad_cvt(LP in, int inverse, struct CTABLE *ct) {
 		}
 	}
 	return in;
+}
+	LP
+nad_cvt(LP in, int inverse, struct CTABLE *ct) {
+	return nad_cvt_core(in, inverse, ct, NULL, NULL);
+}
+	LP
+nad_cvt_tiled(LP in, int inverse, projCtx ctx, PJ_GRIDINFO *gi) {
+	return nad_cvt_core(in, inverse, gi->ct, ctx, gi);
+}
+/* nad_cvt() of count points in place, for a table with its values in
+   memory.  The points go through nad_intr_array() in batches, and the
+   inverse iteration is run on the batch until every point has converged
+   or failed, with those still iterating kept packed at the front.
+   pairs, if set, is the table of pj_gridinfo_row_pairs(). */
+	void
+nad_cvt_array(projCtx ctx, struct CTABLE *ct, const FLP *pairs,
+			  int inverse, long count, LP *points) {
+	LP tb[NAD_ARRAY_MAX], t[NAD_ARRAY_MAX], val[NAD_ARRAY_MAX];
+	LP d_lam[NAD_ARRAY_MAX], d_phi[NAD_ARRAY_MAX];
+	LP *out[NAD_ARRAY_MAX];
+	int tries[NAD_ARRAY_MAX];
+	long base;
+	int n, i;
+
+	for (base = 0; base < count; base += n) {
+		int active;
+
+		n = count - base > NAD_ARRAY_MAX ? NAD_ARRAY_MAX : count - base;
+
+		/* normalize input to ll origin */
+		for (i = 0; i < n; i++) {
+			LP in = points[base + i];
+
+			tb[i].lam = in.lam == HUGE_VAL ? HUGE_VAL :
+				in.lam - ct->ll.lam - PI;
+			tb[i].phi = in.phi - ct->ll.phi;
+		}
+		adjlon_n(n, 2, &tb[0].lam);
+		for (i = 0; i < n; i++) {
+			if (tb[i].lam == HUGE_VAL) { /* passed through, see below */
+				tb[i].lam = -2. * ct->del.lam;
+				tb[i].phi = -2. * ct->del.phi;
+			} else
+				tb[i].lam += PI;
+		}
+		if (!inverse) {
+			nad_intr_array(ct, pairs, n, tb, val, NULL, NULL);
+			for (i = 0; i < n; i++) {
+				LP *in = points + base + i;
+
+				if (in->lam == HUGE_VAL)
+					continue;
+				if (val[i].lam == HUGE_VAL)
+					*in = val[i];
+				else {
+					in->lam -= val[i].lam;
+					in->phi += val[i].phi;
+				}
+			}
+			continue;
+		}
+
+		/* the lanes left to iterate, starting from the input points */
+		nad_intr_array(ct, pairs, n, tb, val, d_lam, d_phi);
+		for (i = 0, active = 0; i < n; i++) {
+			LP *in = points + base + i;
+
+			if (in->lam == HUGE_VAL)
+				continue;
+			if (val[i].lam == HUGE_VAL) {
+				*in = val[i];
+				continue;
+			}
+			tb[active] = t[active] = tb[i];
+			val[active] = val[i];
+			d_lam[active] = d_lam[i];
+			d_phi[active] = d_phi[i];
+			tries[active] = MAX_TRY;
+			out[active++] = in;
+		}
+
+		/* same steps as nad_cvt_core(), each pass stepping every lane
+		   and then interpolating at the new positions of those left */
+		while (active > 0) {
+			int kept = 0;
+
+			for (i = 0; i < active; i++) {
+				LP r, dif;
+
+				r.lam = t[i].lam - val[i].lam - tb[i].lam;
+				r.phi = t[i].phi + val[i].phi - tb[i].phi;
+				dif = nad_newton(r, d_lam[i], d_phi[i]);
+				t[i].lam -= dif.lam;
+				t[i].phi -= dif.phi;
+				if (fabs(dif.lam) > TOL || fabs(dif.phi) > TOL) {
+					if (tries[i]-- == 0) {
+						if (pj_log_site_wanted(ctx, PJ_LOG_DEBUG_MINOR,
+								PJ_LOG_SITE_GRID_INVERSE))
+							pj_log(ctx, PJ_LOG_DEBUG_MINOR,
+								   "Inverse grid shift iterator failed to converge.");
+						out[i]->lam = out[i]->phi = HUGE_VAL;
+						continue;
+					}
+					/* keep iterating */
+					tb[kept] = tb[i];
+					t[kept] = t[i];
+					d_lam[kept] = d_lam[i];
+					d_phi[kept] = d_phi[i];
+					tries[kept] = tries[i];
+					out[kept++] = out[i];
+					continue;
+				}
+				out[i]->lam = adjlon(t[i].lam + ct->ll.lam);
+				out[i]->phi = t[i].phi + ct->ll.phi;
+			}
+			active = kept;
+			if (active == 0)
+				break;
+
+			nad_intr_array(ct, pairs, active, t, val, NULL, NULL);
+			for (i = 0, kept = 0; i < active; i++) {
+				/* see nad_cvt_core() for why the last approximation
+				   is kept when the iteration leaves the grid */
+				if (val[i].lam == HUGE_VAL) {
+					if (pj_log_site_wanted(ctx, PJ_LOG_DEBUG_MINOR,
+							PJ_LOG_SITE_GRID_INVERSE))
+						pj_log(ctx, PJ_LOG_DEBUG_MINOR,
+							   "Inverse grid shift iteration failed, presumably at grid edge.\n"
+							   "Using first approximation.");
+					t[i] = nad_cvt_edge(tb[i], ct, ctx, NULL);
+					if (t[i].lam == HUGE_VAL)
+						*out[i] = t[i];
+					else {
+						out[i]->lam = adjlon(t[i].lam + ct->ll.lam);
+						out[i]->phi = t[i].phi + ct->ll.phi;
+					}
+					continue;
+				}
+				tb[kept] = tb[i];
+				t[kept] = t[i];
+				val[kept] = val[i];
+				d_lam[kept] = d_lam[i];
+				d_phi[kept] = d_phi[i];
+				tries[kept] = tries[i];
+				out[kept++] = out[i];
+			}
+			active = kept;
+		}
+	}
 }
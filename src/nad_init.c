@@ -79,24 +79,29 @@ static void swap_words( void *data_in, int word_size, int word_count )
 /************************************************************************/
 /*                          nad_ctable_load()                           */
 /*                                                                      */
-/*      Load the data portion of a ctable formatted grid.               */
+/*      Load the data portion of a ctable formatted grid, into          */
+/*      ct->cvs if it is already allocated.                             */
 /************************************************************************/
 
 int nad_ctable_load( projCtx ctx, struct CTABLE *ct, PAFile fid )
 
 {
-    int  a_size;
+    int  a_size, owned = ct->cvs == NULL;
 
     pj_ctx_fseek( ctx, fid, sizeof(struct CTABLE), SEEK_SET );
 
     /* read all the actual shift values */
     a_size = ct->lim.lam * ct->lim.phi;
-    ct->cvs = (FLP *) pj_malloc(sizeof(FLP) * a_size);
+    if( owned )
+        ct->cvs = (FLP *) pj_malloc(sizeof(FLP) * a_size);
     if( ct->cvs == NULL 
         || pj_ctx_fread(ctx, ct->cvs, sizeof(FLP), a_size, fid) != a_size )
     {
-        pj_dalloc( ct->cvs );
-        ct->cvs = NULL;
+        if( owned )
+        {
+            pj_dalloc( ct->cvs );
+            ct->cvs = NULL;
+        }
 
         pj_log( ctx, PJ_LOG_ERROR, 
                 "ctable loading failed on fread() - binary incompatible?\n" );
@@ -152,24 +157,29 @@ struct CTABLE *nad_ctable_init( projCtx ctx, PAFile fid )
 /************************************************************************/
 /*                          nad_ctable2_load()                          */
 /*                                                                      */
-/*      Load the data portion of a ctable2 formatted grid.              */
+/*      Load the data portion of a ctable2 formatted grid, into         */
+/*      ct->cvs if it is already allocated.                             */
 /************************************************************************/
 
 int nad_ctable2_load( projCtx ctx, struct CTABLE *ct, PAFile fid )
 
 {
-    int  a_size;
+    int  a_size, owned = ct->cvs == NULL;
 
     pj_ctx_fseek( ctx, fid, 160, SEEK_SET );
 
     /* read all the actual shift values */
     a_size = ct->lim.lam * ct->lim.phi;
-    ct->cvs = (FLP *) pj_malloc(sizeof(FLP) * a_size);
+    if( owned )
+        ct->cvs = (FLP *) pj_malloc(sizeof(FLP) * a_size);
     if( ct->cvs == NULL 
         || pj_ctx_fread(ctx, ct->cvs, sizeof(FLP), a_size, fid) != a_size )
     {
-        pj_dalloc( ct->cvs );
-        ct->cvs = NULL;
+        if( owned )
+        {
+            pj_dalloc( ct->cvs );
+            ct->cvs = NULL;
+        }
 
         if( getenv("PROJ_DEBUG") != NULL )
         {
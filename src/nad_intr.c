@@ -1,52 +1,49 @@
 /* Determine nad table correction value */
 #define PJ_LIB__
 #include <projects.h>
-	LP
-nad_intr(LP t, struct CTABLE *ct) {
-	LP val, frct;
-	ILP indx;
-	double m00, m10, m01, m11;
-	FLP *f00, *f10, *f01, *f11;
-	long index;
+/* locate the cell holding t, returns 0 if it is outside the table */
+	static int
+nad_cell(LP *t, struct CTABLE *ct, ILP *indx, LP *frct) {
 	int in;
 
-	indx.lam = floor(t.lam /= ct->del.lam);
-	indx.phi = floor(t.phi /= ct->del.phi);
-	frct.lam = t.lam - indx.lam;
-	frct.phi = t.phi - indx.phi;
-	val.lam = val.phi = HUGE_VAL;
-	if (indx.lam < 0) {
-		if (indx.lam == -1 && frct.lam > 0.99999999999) {
-			++indx.lam;
-			frct.lam = 0.;
+	indx->lam = floor(t->lam /= ct->del.lam);
+	indx->phi = floor(t->phi /= ct->del.phi);
+	frct->lam = t->lam - indx->lam;
+	frct->phi = t->phi - indx->phi;
+	if (indx->lam < 0) {
+		if (indx->lam == -1 && frct->lam > 0.99999999999) {
+			++indx->lam;
+			frct->lam = 0.;
 		} else
-			return val;
-	} else if ((in = indx.lam + 1) >= ct->lim.lam) {
-		if (in == ct->lim.lam && frct.lam < 1e-11) {
-			--indx.lam;
-			frct.lam = 1.;
+			return 0;
+	} else if ((in = indx->lam + 1) >= ct->lim.lam) {
+		if (in == ct->lim.lam && frct->lam < 1e-11) {
+			--indx->lam;
+			frct->lam = 1.;
 		} else
-			return val;
+			return 0;
 	}
-	if (indx.phi < 0) {
-		if (indx.phi == -1 && frct.phi > 0.99999999999) {
-			++indx.phi;
-			frct.phi = 0.;
+	if (indx->phi < 0) {
+		if (indx->phi == -1 && frct->phi > 0.99999999999) {
+			++indx->phi;
+			frct->phi = 0.;
 		} else
-			return val;
-	} else if ((in = indx.phi + 1) >= ct->lim.phi) {
-		if (in == ct->lim.phi && frct.phi < 1e-11) {
-			--indx.phi;
-			frct.phi = 1.;
+			return 0;
+	} else if ((in = indx->phi + 1) >= ct->lim.phi) {
+		if (in == ct->lim.phi && frct->phi < 1e-11) {
+			--indx->phi;
+			frct->phi = 1.;
 		} else
-			return val;
+			return 0;
 	}
-	index = indx.phi * ct->lim.lam + indx.lam;
-	f00 = ct->cvs + index++;
-	f10 = ct->cvs + index;
-	index += ct->lim.lam;
-	f11 = ct->cvs + index--;
-	f01 = ct->cvs + index;
+	return 1;
+}
+/* bilinear interpolation between the cell corners */
+	static LP
+nad_blend(LP frct, FLP *f00, FLP *f10, FLP *f01, FLP *f11) {
+	LP val;
+	double m00, m10, m01, m11;
+
 	m11 = m10 = frct.lam;
 	m00 = m01 = 1. - frct.lam;
 	m11 *= frct.phi;
@@ -60,3 +57,137 @@ nad_intr(LP t, struct CTABLE *ct) {
 			  m01 * f01->phi + m11 * f11->phi;
 	return val;
 }
+/* slopes of the bilinear surface with respect to lam and phi, in the
+   units of the shifts per radian */
+	static void
+nad_slope(LP frct, FLP *f00, FLP *f10, FLP *f01, FLP *f11,
+		  struct CTABLE *ct, LP *d_lam, LP *d_phi) {
+	double r0 = 1. - frct.phi, c0 = 1. - frct.lam;
+
+	d_lam->lam = (r0 * (f10->lam - f00->lam) +
+				  frct.phi * (f11->lam - f01->lam)) / ct->del.lam;
+	d_lam->phi = (r0 * (f10->phi - f00->phi) +
+				  frct.phi * (f11->phi - f01->phi)) / ct->del.lam;
+	d_phi->lam = (c0 * (f01->lam - f00->lam) +
+				  frct.lam * (f11->lam - f10->lam)) / ct->del.phi;
+	d_phi->phi = (c0 * (f01->phi - f00->phi) +
+				  frct.lam * (f11->phi - f10->phi)) / ct->del.phi;
+}
+	LP
+nad_intr(LP t, struct CTABLE *ct) {
+	LP val, frct;
+	ILP indx;
+	FLP *f00, *f10, *f01, *f11;
+	long index;
+
+	val.lam = val.phi = HUGE_VAL;
+	if (!nad_cell(&t, ct, &indx, &frct))
+		return val;
+	index = indx.phi * ct->lim.lam + indx.lam;
+	f00 = ct->cvs + index++;
+	f10 = ct->cvs + index;
+	index += ct->lim.lam;
+	f11 = ct->cvs + index--;
+	f01 = ct->cvs + index;
+	return nad_blend(frct, f00, f10, f01, f11);
+}
+/* nad_intr() also returning the slopes of the shift at t, reading the
+   table through the context tile cache if gi is set */
+	LP
+nad_intr_slope(LP t, struct CTABLE *ct, projCtx ctx, PJ_GRIDINFO *gi,
+			   LP *d_lam, LP *d_phi) {
+	LP val, frct;
+	ILP indx;
+	FLP *row0, *row1;
+
+	val.lam = val.phi = HUGE_VAL;
+	if (!nad_cell(&t, ct, &indx, &frct))
+		return val;
+	if (gi != NULL) {
+		if ((row0 = pj_grid_tile_row(ctx, gi, indx.phi)) == NULL ||
+			(row1 = pj_grid_tile_row(ctx, gi, indx.phi + 1)) == NULL)
+			return val;
+		row0 += indx.lam;
+		row1 += indx.lam;
+	} else {
+		row0 = ct->cvs + indx.phi * ct->lim.lam + indx.lam;
+		row1 = row0 + ct->lim.lam;
+	}
+	nad_slope(frct, row0, row0 + 1, row1, row1 + 1, ct, d_lam, d_phi);
+	return nad_blend(frct, row0, row0 + 1, row1, row1 + 1);
+}
+/* same, fetching the two rows needed through the context tile cache */
+	LP
+nad_intr_tiled(LP t, projCtx ctx, PJ_GRIDINFO *gi) {
+	LP val, frct;
+	ILP indx;
+	FLP *row0, *row1;
+
+	val.lam = val.phi = HUGE_VAL;
+	if (!nad_cell(&t, gi->ct, &indx, &frct))
+		return val;
+	if ((row0 = pj_grid_tile_row(ctx, gi, indx.phi)) == NULL ||
+		(row1 = pj_grid_tile_row(ctx, gi, indx.phi + 1)) == NULL)
+		return val;
+	return nad_blend(frct, row0 + indx.lam, row0 + indx.lam + 1,
+					 row1 + indx.lam, row1 + indx.lam + 1);
+}
+/* batch of count points, for tables with their values in memory.  The
+   cells are all located before their corners are fetched and blended.
+   The slopes are returned too unless d_lam is NULL.  If pairs is set,
+   the corners are read from it, see pj_gridinfo_row_pairs(). */
+	void
+nad_intr_array(struct CTABLE *ct, const FLP *pairs, int count,
+			   const LP *t, LP *val, LP *d_lam, LP *d_phi) {
+	long index[NAD_ARRAY_MAX];
+	LP frct[NAD_ARRAY_MAX];
+	int i;
+
+	for (i = 0; i < count; i++) {
+		LP ti = t[i];
+		ILP indx;
+
+		if (nad_cell(&ti, ct, &indx, frct + i))
+			index[i] = indx.phi * ct->lim.lam + indx.lam;
+		else
+			index[i] = -1;
+	}
+	for (i = 0; i < count; i++) {
+		FLP *f00, *f10, *f01, *f11;
+
+		if (index[i] < 0) {
+			val[i].lam = val[i].phi = HUGE_VAL;
+			continue;
+		}
+		if (pairs != NULL) {
+			/* node, node above, next node, next node above */
+			f00 = (FLP *) pairs + 2 * index[i];
+			f01 = f00 + 1;
+			f10 = f00 + 2;
+			f11 = f00 + 3;
+		} else {
+			f00 = ct->cvs + index[i];
+			f10 = f00 + 1;
+			f01 = f00 + ct->lim.lam;
+			f11 = f01 + 1;
+		}
+		val[i] = nad_blend(frct[i], f00, f10, f01, f11);
+		if (d_lam != NULL)
+			nad_slope(frct[i], f00, f10, f01, f11, ct, d_lam + i, d_phi + i);
+	}
+}
+/* whether nad_cvt() finds a cell of the table for in, as it does for a
+   forward shift, without reading the values of the table */
+	int
+nad_covers(LP in, struct CTABLE *ct) {
+	ILP indx;
+	LP frct;
+
+	if (in.lam == HUGE_VAL)
+		return 0;
+	/* normalize input to ll origin, as nad_cvt() */
+	in.lam -= ct->ll.lam;
+	in.phi -= ct->ll.phi;
+	in.lam = adjlon(in.lam - PI) + PI;
+	return nad_cell(&in, ct, &indx, &frct);
+}
@@ -25,6 +25,14 @@ JNIEXPORT jlong JNICALL Java_org_proj4_PJ_allocatePJ
 JNIEXPORT jlong JNICALL Java_org_proj4_PJ_allocateGeoPJ
   (JNIEnv *, jclass, jobject);
 
+/*
+ * Class:     org_proj4_PJ
+ * Method:    allocateClonePJ
+ * Signature: (Lorg/proj4/PJ;)J
+ */
+JNIEXPORT jlong JNICALL Java_org_proj4_PJ_allocateClonePJ
+  (JNIEnv *, jclass, jobject);
+
 /*
  * Class:     org_proj4_PJ
  * Method:    getVersion
@@ -105,6 +113,14 @@ JNIEXPORT jdouble JNICALL Java_org_proj4_PJ_getLinearUnitToMetre
 JNIEXPORT void JNICALL Java_org_proj4_PJ_transform
   (JNIEnv *, jobject, jobject, jint, jdoubleArray, jint, jint);
 
+/*
+ * Class:     org_proj4_PJ
+ * Method:    transformDirect
+ * Signature: (Lorg/proj4/PJ;ILjava/nio/DoubleBuffer;II)V
+ */
+JNIEXPORT void JNICALL Java_org_proj4_PJ_transformDirect
+  (JNIEnv *, jobject, jobject, jint, jobject, jint, jint);
+
 /*
  * Class:     org_proj4_PJ
  * Method:    getLastError
@@ -85,26 +85,185 @@ int pj_apply_gridshift_2( PJ *defn, int inverse,
                           double *x, double *y, double *z )
 
 {
-    if( defn->catalog_name != NULL )
+    return pj_apply_gridshift_t( defn, inverse, point_count, point_offset,
+                                 x, y, z, NULL );
+}
+
+/************************************************************************/
+/*                        pj_apply_gridshift_t()                        */
+/*                                                                      */
+/*      As pj_apply_gridshift_2(), with the dates of the points, in     */
+/*      decimal years and with the stride of x, for a grid catalog.     */
+/*      If t is NULL, the +date of the definition is used.              */
+/************************************************************************/
+
+int pj_apply_gridshift_t( PJ *defn, int inverse, 
+                          long point_count, int point_offset,
+                          double *x, double *y, double *z,
+                          const double *t )
+
+{
+    if( defn->cold->catalog_name != NULL )
         return pj_gc_apply_gridshift( defn, inverse, point_count, point_offset,
-                                      x, y, z );
+                                      x, y, z, t );
                                       
-    if( defn->gridlist == NULL )
+    if( defn->cold->gridlist == NULL )
     {
-        defn->gridlist = 
-            pj_gridlist_from_nadgrids( pj_get_ctx( defn ),
+        defn->cold->gridlist = 
+            pj_gridlist_from_registry( pj_get_ctx( defn ),
+                                       pj_grid_registry_of( defn ),
                                        pj_param(defn->ctx, defn->params,"snadgrids").s,
-                                       &(defn->gridlist_count) );
+                                       &(defn->cold->gridlist_count) );
 
-        if( defn->gridlist == NULL || defn->gridlist_count == 0 )
+        if( defn->cold->gridlist == NULL || defn->cold->gridlist_count == 0 )
             return defn->ctx->last_errno;
     }
      
-    return pj_apply_gridshift_3( pj_get_ctx( defn ),
-                                 defn->gridlist, defn->gridlist_count, inverse, 
-                                 point_count, point_offset, x, y, z );
+    return pj_apply_gridshift_last( pj_get_ctx( defn ),
+                                    defn->cold->gridlist,
+                                    defn->cold->gridlist_count, 
+                                    inverse, point_count, point_offset, 
+                                    x, y, z, &(defn->gridlist_last), 
+                                    &(defn->gridlist_last_table) );
+}
+
+/************************************************************************/
+/*                         pj_gridshift_array()                         */
+/*                                                                      */
+/*      nad_cvt_array() and nad_cvt() with a grid in memory, through    */
+/*      its inverse table for reverse shifts, and its row pairs, if     */
+/*      the context asks for them.                                      */
+/************************************************************************/
+
+static void pj_gridshift_array( projCtx ctx, PJ_GRIDINFO *gi, int inverse,
+                                long count, LP *points )
+
+{
+    struct CTABLE *ict;
+
+    /* a grid of zero shifts, like "null", leaves the points as they are */
+    if( gi->is_null )
+        return;
+
+    if( inverse && ctx->inverse_grids 
+        && (ict = pj_gridinfo_inverse( ctx, gi )) != NULL )
+        nad_cvt_array( ctx, ict, NULL, 0, count, points );
+    else
+        nad_cvt_array( ctx, gi->ct, 
+                       ctx->grid_row_pairs 
+                       ? pj_gridinfo_row_pairs( ctx, gi ) : NULL,
+                       inverse, count, points );
+}
+
+static LP pj_gridshift_cvt( projCtx ctx, PJ_GRIDINFO *gi, int inverse,
+                            LP input )
+
+{
+    struct CTABLE *ict;
+
+    if( gi->is_null )
+        return input;
+
+    if( inverse && ctx->inverse_grids 
+        && (ict = pj_gridinfo_inverse( ctx, gi )) != NULL )
+        return nad_cvt( input, 0, ict );
+    return nad_cvt( input, inverse, gi->ct );
+}
+
+/************************************************************************/
+/*                        pj_gridshift_point()                          */
+/*                                                                      */
+/*      Shift one point with a grid, leaving output at HUGE_VAL if it   */
+/*      falls outside.  Returns 0, or -38 if the grid is unreadable.   */
+/*      Returns PJD_ERR_GRID_NOT_READY, leaving output, if the          */
+/*      context must not wait for the grid to be read.                  */
+/************************************************************************/
+
+static int pj_gridshift_point( projCtx ctx, PJ_GRIDINFO *gi, LP input,
+                               int inverse, LP *output )
+
+{
+    int err;
+
+    if( (err = pj_gridinfo_ready( ctx, gi )) != 0 )
+        return err;
+
+    /* large grids are read on demand, a tile at a time */
+    if( pj_gridinfo_tiled( ctx, gi ) )
+    {
+        *output = nad_cvt_tiled( input, inverse, ctx, gi );
+        if( ctx->last_errno == -38 )
+            return -38;
+    }
+    else
+    {
+        /* load the grid shift info if we don't have it. */
+        if( !pj_gridinfo_acquire( ctx, gi ) )
+        {
+            pj_ctx_set_errno( ctx, -38 );
+            return -38;
+        }
+
+        *output = pj_gridshift_cvt( ctx, gi, inverse, input );
+        pj_gridinfo_release( gi );
+    }
+
+    return 0;
 }
 
+/************************************************************************/
+/*                         pj_grid_covers()                             */
+/*                                                                      */
+/*      Whether the extent of the grid, widened by the tolerance        */
+/*      used below, covers the point.                                   */
+/************************************************************************/
+
+static int pj_grid_covers( PJ_GRIDINFO *gi, LP input )
+
+{
+    struct CTABLE *ct = gi->ct;
+    double epsilon = (fabs(ct->del.phi)+fabs(ct->del.lam))/10000.0;
+
+    return !( ct->ll.phi - epsilon > input.phi 
+              || ct->ll.lam - epsilon > input.lam
+              || (ct->ll.phi + (ct->lim.phi-1) * ct->del.phi + epsilon 
+                  < input.phi)
+              || (ct->ll.lam + (ct->lim.lam-1) * ct->del.lam + epsilon 
+                  < input.lam) );
+}
+
+/************************************************************************/
+/*                       pj_grid_meets_earlier()                        */
+/*                                                                      */
+/*      Whether the widened extent of tables[itable] meets that of an   */
+/*      earlier table, which would be tried first for some points.      */
+/************************************************************************/
+
+static int pj_grid_meets_earlier( PJ_GRIDINFO **tables, int itable )
+
+{
+    struct CTABLE *ct1 = tables[itable]->ct;
+    double eps1 = (fabs(ct1->del.phi)+fabs(ct1->del.lam))/10000.0;
+    int i;
+
+    for( i = 0; i < itable; i++ )
+    {
+        struct CTABLE *ct2 = tables[i]->ct;
+        double eps2 = (fabs(ct2->del.phi)+fabs(ct2->del.lam))/10000.0;
+
+        if( ct1->ll.lam - eps1 
+            <= ct2->ll.lam + (ct2->lim.lam-1) * ct2->del.lam + eps2
+            && ct2->ll.lam - eps2 
+            <= ct1->ll.lam + (ct1->lim.lam-1) * ct1->del.lam + eps1
+            && ct1->ll.phi - eps1 
+            <= ct2->ll.phi + (ct2->lim.phi-1) * ct2->del.phi + eps2
+            && ct2->ll.phi - eps2 
+            <= ct1->ll.phi + (ct1->lim.phi-1) * ct1->del.phi + eps1 )
+            return 1;
+    }
+
+    return 0;
+}
 
 /************************************************************************/
 /*                        pj_apply_gridshift_3()                        */
@@ -117,8 +276,100 @@ int pj_apply_gridshift_3( projCtx ctx, PJ_GRIDINFO **tables, int grid_count,
                           double *x, double *y, double *z )
 
 {
-    int  i;
-    static int debug_count = 0;
+    PJ_GRIDINFO *last = NULL;
+    int last_table = 0;
+
+    return pj_apply_gridshift_last( ctx, tables, grid_count, inverse, 
+                                    point_count, point_offset, x, y, z,
+                                    &last, &last_table );
+}
+
+/************************************************************************/
+/*                        pj_gridshift_missed()                         */
+/*                                                                      */
+/*      Deal with a point that no table could shift.                    */
+/************************************************************************/
+
+static void pj_gridshift_missed( projCtx ctx, PJ_GRIDINFO **tables, 
+                                 int grid_count, long point_index,
+                                 double *x, double *y )
+
+{
+    int itable;
+
+    if( pj_log_site_wanted( ctx, PJ_LOG_DEBUG_MAJOR, 
+                            PJ_LOG_SITE_GRID_MISSED ) )
+    {
+        pj_log_record( ctx, PJ_LOG_DEBUG_MAJOR, NULL, point_index, 0,
+            "pj_apply_gridshift(): failed to find a grid shift table for\n"
+            "                      location (%.7fdW,%.7fdN)",
+            *x * RAD_TO_DEG, 
+            *y * RAD_TO_DEG );
+        for( itable = 0; itable < grid_count; itable++ )
+        {
+            PJ_GRIDINFO *gi = tables[itable];
+            if( itable == 0 )
+                pj_log_record( ctx, PJ_LOG_DEBUG_MAJOR, gi->gridname,
+                               point_index, 0, "   tried: %s", gi->gridname );
+            else
+                pj_log_record( ctx, PJ_LOG_DEBUG_MAJOR, gi->gridname,
+                               point_index, 0, ",%s", gi->gridname );
+        }
+    }
+
+    /* 
+     * We don't actually have any machinery currently to set the 
+     * following macro, so this is mostly kept here to make it clear 
+     * how we ought to operate if we wanted to make it super clear 
+     * that an error has occured when points are outside our available
+     * datum shift areas.  But if this is on, we will find that "low 
+     * value" points on the fringes of some datasets will completely 
+     * fail causing lots of problems when it is more or less ok to 
+     * just not apply a datum shift.  So rather than deal with
+     * that we just fallback to no shift. (see also bug #45).
+     */
+#ifdef ERR_GRID_AREA_TRANSIENT_SEVERE
+    *y = HUGE_VAL;
+    *x = HUGE_VAL;
+#else
+    /* leave x/y unshifted. */
+#endif
+}
+
+/************************************************************************/
+/*                       pj_apply_gridshift_last()                      */
+/*                                                                      */
+/*      As pj_apply_gridshift_3(), but consecutive points usually       */
+/*      fall in the same grid, so the search starts from the grid      */
+/*      used for the last point, *p_last.  It is only remembered when   */
+/*      every point in its extent would be sent to it by the full       */
+/*      search, whose results we so keep exactly.                       */
+/*                                                                      */
+/*      The grid of each point of a chunk is found first, and runs of   */
+/*      points in the same grid are then shifted together with          */
+/*      nad_cvt_array().  Points the grid does not shift go on to the   */
+/*      following tables one at a time, as in the full search.          */
+/*                                                                      */
+/*      Points needing a grid a non-blocking context does not have in   */
+/*      memory are set to HUGE_VAL, with PJD_ERR_GRID_NOT_READY set     */
+/*      on the context, see pj_ctx_set_grid_nonblocking().              */
+/************************************************************************/
+
+#define GRIDSHIFT_CHUNK 256
+
+int pj_apply_gridshift_last( projCtx ctx, PJ_GRIDINFO **tables, 
+                             int grid_count, int inverse, 
+                             long point_count, int point_offset,
+                             double *x, double *y, double *z,
+                             PJ_GRIDINFO **p_last, int *p_last_table )
+
+{
+    PJ_GRIDINFO *grid[GRIDSHIFT_CHUNK];
+    int  table[GRIDSHIFT_CHUNK];
+    LP   shifted[GRIDSHIFT_CHUNK];
+    long base, last_hits = 0;
+    int  n, k, err;
+    double start = 0.0, run_start = 0.0;
 
     if( tables == NULL || grid_count == 0 )
     {
@@ -126,130 +377,780 @@ int pj_apply_gridshift_3( projCtx ctx, PJ_GRIDINFO **tables, int grid_count,
         return -38;
     }
 
+    /* the list may have been rebuilt since */
+    if( *p_last_table >= grid_count )
+        *p_last = NULL;
+
     ctx->last_errno = 0;
 
-    for( i = 0; i < point_count; i++ )
-    {
-        long io = i * point_offset;
-        LP   input, output;
-        int  itable;
+    if( ctx->stats != NULL )
+        start = pj_clock_ns();
 
-        input.phi = y[io];
-        input.lam = x[io];
-        output.phi = HUGE_VAL;
-        output.lam = HUGE_VAL;
+    for( base = 0; base < point_count; base += n )
+    {
+        n = point_count - base > GRIDSHIFT_CHUNK 
+            ? GRIDSHIFT_CHUNK : (int) (point_count - base);
 
-        /* keep trying till we find a table that works */
-        for( itable = 0; itable < grid_count; itable++ )
+/* -------------------------------------------------------------------- */
+/*      Find the first grid covering each point, trying the grid of     */
+/*      the last point before the full search.                          */
+/* -------------------------------------------------------------------- */
+        for( k = 0; k < n; k++ )
         {
-            PJ_GRIDINFO *gi = tables[itable];
-            struct CTABLE *ct = gi->ct;
-            double epsilon = (fabs(ct->del.phi)+fabs(ct->del.lam))/10000.0;
-
-            /* skip tables that don't match our point at all.  */
-            if( ct->ll.phi - epsilon > input.phi 
-                || ct->ll.lam - epsilon > input.lam
-                || (ct->ll.phi + (ct->lim.phi-1) * ct->del.phi + epsilon 
-                    < input.phi)
-                || (ct->ll.lam + (ct->lim.lam-1) * ct->del.lam + epsilon 
-                    < input.lam) )
+            long io = (base + k) * point_offset;
+            LP   input;
+            int  itable;
+
+            input.phi = y[io];
+            input.lam = x[io];
+            grid[k] = NULL;
+
+            if( *p_last != NULL && pj_grid_covers( *p_last, input ) )
+            {
+                grid[k] = pj_gridinfo_descend( *p_last, input, 1, NULL );
+                table[k] = *p_last_table;
+                last_hits++;
                 continue;
+            }
 
-            /* If we have child nodes, check to see if any of them apply. */
-            while( gi->child )
+            for( itable = 0; itable < grid_count; itable++ )
             {
-                PJ_GRIDINFO *child;
+                int exclusive;
 
-                for( child = gi->child; child != NULL; child = child->next )
+                /* skip tables that don't match our point at all.  */
+                if( !pj_grid_covers( tables[itable], input ) )
+                    continue;
+
+                /* If we have child nodes, check to see if any of them apply. */
+                grid[k] = pj_gridinfo_descend( tables[itable], input, 1, 
+                                               &exclusive );
+                table[k] = itable;
+
+                /* *p_last_table is always a table known to meet none 
+                   of the earlier ones */
+                if( exclusive 
+                    && (*p_last_table == itable
+                        || !pj_grid_meets_earlier( tables, itable )) )
                 {
-                    struct CTABLE *ct1 = child->ct;
-                    double epsilon = 
-                        (fabs(ct1->del.phi)+fabs(ct1->del.lam))/10000.0;
-
-                    if( ct1->ll.phi - epsilon > input.phi 
-                        || ct1->ll.lam - epsilon > input.lam
-                        || (ct1->ll.phi+(ct1->lim.phi-1)*ct1->del.phi + epsilon 
-                            < input.phi)
-                        || (ct1->ll.lam+(ct1->lim.lam-1)*ct1->del.lam + epsilon 
-                            < input.lam) )
-                        continue;
+                    *p_last = grid[k];
+                    *p_last_table = itable;
+                }
+                else
+                    *p_last = NULL;
+                break;
+            }
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Shift the runs of points sharing a grid held in memory.         */
+/* -------------------------------------------------------------------- */
+        for( k = 0; k < n; )
+        {
+            PJ_GRIDINFO *gi = grid[k];
+            int k1, m;
+
+            for( k1 = k + 1; k1 < n && grid[k1] == gi; k1++ ) {}
 
-                    break;
+            if( ctx->stats != NULL )
+                run_start = pj_clock_ns();
+
+            /* to be tried again once the grid is loaded */
+            if( gi != NULL && (err = pj_gridinfo_ready( ctx, gi )) != 0 )
+            {
+                if( err != PJD_ERR_GRID_NOT_READY )
+                    return err;
+                for( m = k; m < k1; m++ )
+                {
+                    long io = (base + m) * point_offset;
+
+                    x[io] = y[io] = HUGE_VAL;
                 }
+                k = k1;
+                continue;
+            }
 
-                /* If we didn't find a child then nothing more to do */
+            if( gi != NULL && !pj_gridinfo_tiled( ctx, gi ) )
+            {
+                if( !pj_gridinfo_acquire( ctx, gi ) )
+                {
+                    pj_ctx_set_errno( ctx, -38 );
+                    return -38;
+                }
 
-                if( child == NULL ) break;
+                for( m = k; m < k1; m++ )
+                {
+                    long io = (base + m) * point_offset;
 
-                /* Otherwise use the child, first checking it's children */
+                    shifted[m].phi = y[io];
+                    shifted[m].lam = x[io];
+                }
+                pj_gridshift_array( ctx, gi, inverse, k1 - k, shifted + k );
+                pj_gridinfo_release( gi );
+            }
+            else if( gi != NULL )
+            {
+                for( m = k; m < k1; m++ )
+                {
+                    long io = (base + m) * point_offset;
+                    LP   input;
 
-                gi = child;
-                ct = child->ct;
+                    input.phi = y[io];
+                    input.lam = x[io];
+                    if( pj_gridshift_point( ctx, gi, input, inverse, 
+                                            shifted + m ) != 0 )
+                        return -38;
+                }
             }
 
-            /* load the grid shift info if we don't have it. */
-            if( ct->cvs == NULL && !pj_gridinfo_load( ctx, gi ) )
+/* -------------------------------------------------------------------- */
+/*      Points not shifted by their first grid go on to the             */
+/*      following tables.                                               */
+/* -------------------------------------------------------------------- */
+            for( m = k; m < k1; m++ )
             {
-                pj_ctx_set_errno( ctx, -38 );
-                return -38;
+                long io = (base + m) * point_offset;
+                LP   input, output;
+                int  itable, waiting = 0;
+
+                output.lam = output.phi = HUGE_VAL;
+                if( gi != NULL )
+                {
+                    output = shifted[m];
+                    itable = table[m] + 1;
+                }
+                else
+                    itable = grid_count;
+
+                input.phi = y[io];
+                input.lam = x[io];
+
+                for( ; output.lam == HUGE_VAL && itable < grid_count; 
+                     itable++ )
+                {
+                    PJ_GRIDINFO *gi2 = tables[itable];
+
+                    if( !pj_grid_covers( gi2, input ) )
+                        continue;
+
+                    gi2 = pj_gridinfo_descend( gi2, input, 1, NULL );
+                    if( (err = pj_gridshift_point( ctx, gi2, input, inverse, 
+                                                   &output )) != 0 )
+                    {
+                        if( err != PJD_ERR_GRID_NOT_READY )
+                            return -38;
+                        waiting = 1;
+                        break;
+                    }
+
+                    if( output.lam != HUGE_VAL 
+                        && pj_log_site_wanted( ctx, PJ_LOG_DEBUG_MINOR,
+                                               PJ_LOG_SITE_GRID_USED ) )
+                        pj_log_record( ctx, PJ_LOG_DEBUG_MINOR, gi2->gridname,
+                                       base + m, 0,
+                                       "pj_apply_gridshift(): used %s", 
+                                       gi2->ct->id );
+                }
+
+                if( waiting )
+                    x[io] = y[io] = HUGE_VAL;
+                else if( output.lam == HUGE_VAL )
+                    pj_gridshift_missed( ctx, tables, grid_count, base + m,
+                                         x + io, y + io );
+                else
+                {
+                    if( itable == table[m] + 1 
+                        && pj_log_site_wanted( ctx, PJ_LOG_DEBUG_MINOR,
+                                               PJ_LOG_SITE_GRID_USED ) )
+                        pj_log_record( ctx, PJ_LOG_DEBUG_MINOR, gi->gridname,
+                                       base + m, 0,
+                                       "pj_apply_gridshift(): used %s", 
+                                       gi->ct->id );
+                    y[io] = output.phi;
+                    x[io] = output.lam;
+                }
             }
-            
-            output = nad_cvt( input, inverse, ct );
-            if( output.lam != HUGE_VAL )
+
+            if( ctx->stats != NULL && gi != NULL )
+                pj_stats_add_grid( ctx->stats, gi->gridname, k1 - k,
+                                   pj_clock_ns() - run_start );
+
+            k = k1;
+        }
+    }
+
+    if( ctx->stats != NULL )
+        pj_stats_add( &(ctx->stats->stats.gridshift), point_count,
+                      pj_clock_ns() - start );
+
+    if( point_count > 1 && pj_log_enabled( ctx, PJ_LOG_DEBUG_MINOR ) )
+        pj_log( ctx, PJ_LOG_DEBUG_MINOR,
+                "pj_apply_gridshift(): %ld of %ld points used the last grid",
+                last_hits, point_count );
+
+    return 0;
+}
+
+/************************************************************************/
+/*                          pj_grid_coverage()                          */
+/*                                                                      */
+/*      Set mask[i] to 1 for the points (lon[i], lat[i]), in radians,   */
+/*      that pj_apply_gridshift() would shift forward with a grid of   */
+/*      the nadgrids list, and to 0 for those it would leave as they    */
+/*      are.  The grids are searched as there, through the index of     */
+/*      their subgrids, and their values are not read.  Returns 0,      */
+/*      or the error of a required grid that cannot be opened.          */
+/************************************************************************/
+
+int pj_grid_coverage( projCtx ctx, const char *nadgrids, long point_count,
+                      const double *lon, const double *lat,
+                      unsigned char *mask )
+
+{
+    PJ_GRIDINFO **tables;
+    int       grid_count, itable, last_table = -1;
+    long      i;
+
+    if( ctx == NULL )
+        ctx = pj_get_default_ctx();
+
+    ctx->last_errno = 0;
+    tables = pj_gridlist_from_nadgrids( ctx, nadgrids, &grid_count );
+    if( tables == NULL )
+        return ctx->last_errno ? ctx->last_errno : -38;
+
+    for( i = 0; i < point_count; i++ )
+    {
+        LP   input;
+
+        input.lam = lon[i];
+        input.phi = lat[i];
+        mask[i] = 0;
+        if( input.lam == HUGE_VAL )
+            continue;
+
+        /* the table of the last point covered, if no earlier table
+           meets it, before the full search */
+        if( last_table >= 0 
+            && pj_grid_covers( tables[last_table], input )
+            && nad_covers( input, pj_gridinfo_descend( tables[last_table],
+                                                       input, 1, NULL )->ct ) )
+        {
+            mask[i] = 1;
+            continue;
+        }
+
+        for( itable = 0; itable < grid_count; itable++ )
+        {
+            if( !pj_grid_covers( tables[itable], input ) )
+                continue;
+
+            if( nad_covers( input, pj_gridinfo_descend( tables[itable], 
+                                                        input, 1, 
+                                                        NULL )->ct ) )
             {
-                if( debug_count++ < 20 )
-                    pj_log( ctx, PJ_LOG_DEBUG_MINOR,
-                            "pj_apply_gridshift(): used %s", ct->id );
+                mask[i] = 1;
+                last_table = pj_grid_meets_earlier( tables, itable ) 
+                    ? -1 : itable;
                 break;
             }
         }
+    }
+
+    pj_dalloc( tables );
+
+    return 0;
+}
+
+/************************************************************************/
+/*                          pj_grid_pair_grid()                         */
+/*                                                                      */
+/*      The grid a point is shifted with from a list, as found by       */
+/*      pj_apply_gridshift_last(), or NULL if none covers it.           */
+/************************************************************************/
+
+static PJ_GRIDINFO *pj_grid_pair_grid( PJ *defn, LP input )
+
+{
+    int itable;
+
+    for( itable = 0; itable < defn->cold->gridlist_count; itable++ )
+    {
+        if( pj_grid_covers( defn->cold->gridlist[itable], input ) )
+            return pj_gridinfo_descend( defn->cold->gridlist[itable], input, 1,
+                                        NULL );
+    }
+
+    return NULL;
+}
+
+/************************************************************************/
+/*                         pj_grid_pair_exact()                         */
+/*                                                                      */
+/*      Shift count points forward with the grids of srcdefn, then      */
+/*      inverse with those of dstdefn, noting the grid of each shift.   */
+/*      Returns FALSE on an error of either shift.                      */
+/************************************************************************/
+
+static int pj_grid_pair_exact( PJ *srcdefn, PJ *dstdefn, long count,
+                               double *x, double *y,
+                               PJ_GRIDINFO **src_grid, 
+                               PJ_GRIDINFO **dst_grid )
+
+{
+    long i;
+
+    for( i = 0; i < count; i++ )
+    {
+        LP input;
+
+        input.lam = x[i];
+        input.phi = y[i];
+        src_grid[i] = pj_grid_pair_grid( srcdefn, input );
+    }
+    if( pj_apply_gridshift_t( srcdefn, 0, count, 1, x, y, NULL, NULL ) != 0
+        || srcdefn->ctx->last_errno != 0 )
+        return 0;
+
+    for( i = 0; i < count; i++ )
+    {
+        LP input;
+
+        input.lam = x[i];
+        input.phi = y[i];
+        dst_grid[i] = pj_grid_pair_grid( dstdefn, input );
+    }
+    if( pj_apply_gridshift_t( dstdefn, 1, count, 1, x, y, NULL, NULL ) != 0
+        || dstdefn->ctx->last_errno != 0 )
+        return 0;
+
+    /* a failed shift, or none, is not sampled */
+    for( i = 0; i < count; i++ )
+    {
+        if( x[i] == HUGE_VAL || dst_grid[i] == NULL )
+            src_grid[i] = NULL;
+    }
+
+    return 1;
+}
+
+/************************************************************************/
+/*                         pj_grid_pair_build()                         */
+/*                                                                      */
+/*      Sample the composed shifts on a lattice over the extent of      */
+/*      the source grids, as far as the destination grids reach, at     */
+/*      the finest spacing of the grids of both lists, and coarser if   */
+/*      that would take more than GRID_PAIR_MAX_NODES nodes.  A cell    */
+/*      is kept when its corners are shifted by the same two grids,     */
+/*      and the bilinear shift on a lattice GRID_PAIR_STEPS times       */
+/*      finer through the cell is within tol of the composed one, as    */
+/*      the composed shifts bend along the cell lines of both grids.    */
+/*      tol is taken in metres on the WGS84 ellipsoid, the one the      */
+/*      grids shift to.                                                 */
+/************************************************************************/
+
+#define GRID_PAIR_MAX_NODES (1L << 18)
+#define GRID_PAIR_STEPS     4
+#define GRID_PAIR_SAMPLES   ((GRID_PAIR_STEPS+1) * (GRID_PAIR_STEPS+1) - 4)
+#define GRID_PAIR_WGS84_A   6378137.0
+
+static void pj_grid_pair_build( PJ *srcdefn, PJ *dstdefn, 
+                                PJ_GRID_PAIR *pair )
+
+{
+    struct CTABLE *ct = &(pair->ct);
+    LP      ur, del, dst_ll, dst_ur;
+    long    nx, ny, count, cells, i, j, row_samples;
+    int     itable, s;
+    double  *x = NULL, *y = NULL, sample[GRID_PAIR_SAMPLES][2];
+    PJ_GRIDINFO **src_grid = NULL, **dst_grid = NULL;
+    FLP     *cvs = NULL;
+
+    /* the points of a cell on a lattice GRID_PAIR_STEPS times finer,
+       but its corners, the first at the centre */
+    sample[0][0] = sample[0][1] = 0.5;
+    for( s = 1, i = 0; i <= GRID_PAIR_STEPS; i++ )
+        for( j = 0; j <= GRID_PAIR_STEPS; j++ )
+        {
+            if( (i == 0 || i == GRID_PAIR_STEPS) 
+                && (j == 0 || j == GRID_PAIR_STEPS) )
+                continue;
+            if( 2 * i == GRID_PAIR_STEPS && 2 * j == GRID_PAIR_STEPS )
+                continue;
+            sample[s][0] = (double) i / GRID_PAIR_STEPS;
+            sample[s++][1] = (double) j / GRID_PAIR_STEPS;
+        }
+
+    if( srcdefn->cold->gridlist_count == 0
+        || dstdefn->cold->gridlist_count == 0 )
+        return;
+
+/* -------------------------------------------------------------------- */
+/*      The lattice.                                                    */
+/* -------------------------------------------------------------------- */
+    ct->ll = srcdefn->cold->gridlist[0]->ct->ll;
+    ur.lam = ur.phi = -HUGE_VAL;
+    del = srcdefn->cold->gridlist[0]->ct->del;
+    for( itable = 0; itable < srcdefn->cold->gridlist_count; itable++ )
+    {
+        struct CTABLE *gct = srcdefn->cold->gridlist[itable]->ct;
+
+        ct->ll.lam = MIN( ct->ll.lam, gct->ll.lam );
+        ct->ll.phi = MIN( ct->ll.phi, gct->ll.phi );
+        ur.lam = MAX( ur.lam, gct->ll.lam + (gct->lim.lam-1) * gct->del.lam );
+        ur.phi = MAX( ur.phi, gct->ll.phi + (gct->lim.phi-1) * gct->del.phi );
+        del.lam = MIN( del.lam, gct->del.lam );
+        del.phi = MIN( del.phi, gct->del.phi );
+    }
+
+    /* only where the destination grids are, a cell wider for the
+       shift of the source grids */
+    dst_ll.lam = dst_ll.phi = HUGE_VAL;
+    dst_ur.lam = dst_ur.phi = -HUGE_VAL;
+    for( itable = 0; itable < dstdefn->cold->gridlist_count; itable++ )
+    {
+        struct CTABLE *gct = dstdefn->cold->gridlist[itable]->ct;
+
+        dst_ll.lam = MIN( dst_ll.lam, gct->ll.lam - gct->del.lam );
+        dst_ll.phi = MIN( dst_ll.phi, gct->ll.phi - gct->del.phi );
+        dst_ur.lam = MAX( dst_ur.lam, 
+                          gct->ll.lam + gct->lim.lam * gct->del.lam );
+        dst_ur.phi = MAX( dst_ur.phi, 
+                          gct->ll.phi + gct->lim.phi * gct->del.phi );
+        del.lam = MIN( del.lam, gct->del.lam );
+        del.phi = MIN( del.phi, gct->del.phi );
+    }
+    if( dst_ll.lam > ct->ll.lam )
+        ct->ll.lam += floor( (dst_ll.lam - ct->ll.lam) / del.lam ) * del.lam;
+    if( dst_ll.phi > ct->ll.phi )
+        ct->ll.phi += floor( (dst_ll.phi - ct->ll.phi) / del.phi ) * del.phi;
+    ur.lam = MIN( ur.lam, dst_ur.lam );
+    ur.phi = MIN( ur.phi, dst_ur.phi );
+    if( !(del.lam > 0.0) || !(del.phi > 0.0) 
+        || !(ur.lam > ct->ll.lam) || !(ur.phi > ct->ll.phi) )
+        return;
+
+    for( ; ; )
+    {
+        double fx = ceil( (ur.lam - ct->ll.lam) / del.lam - 1e-9 ) + 1;
+        double fy = ceil( (ur.phi - ct->ll.phi) / del.phi - 1e-9 ) + 1;
+
+        if( fx * fy <= GRID_PAIR_MAX_NODES )
+        {
+            nx = (long) fx;
+            ny = (long) fy;
+            break;
+        }
+        del.lam *= 2;
+        del.phi *= 2;
+    }
+    if( nx < 2 || ny < 2 )
+        return;
+    ct->del = del;
+    ct->lim.lam = (int) nx;
+    ct->lim.phi = (int) ny;
+    count = nx * ny;
+    cells = (nx - 1) * (ny - 1);
+    row_samples = (nx - 1) * GRID_PAIR_SAMPLES;
 
-        if( output.lam == HUGE_VAL )
+/* -------------------------------------------------------------------- */
+/*      The composed shifts at the nodes.                               */
+/* -------------------------------------------------------------------- */
+    x = (double *) pj_malloc( sizeof(double) * count );
+    y = (double *) pj_malloc( sizeof(double) * count );
+    src_grid = (PJ_GRIDINFO **) pj_malloc( sizeof(PJ_GRIDINFO *) * count );
+    dst_grid = (PJ_GRIDINFO **) pj_malloc( sizeof(PJ_GRIDINFO *) * count );
+    cvs = (FLP *) pj_malloc( sizeof(FLP) * count );
+    pair->exact = (unsigned char *) pj_malloc( cells );
+    if( x == NULL || y == NULL || src_grid == NULL || dst_grid == NULL
+        || cvs == NULL || pair->exact == NULL )
+        goto done;
+
+    for( j = 0; j < ny; j++ )
+        for( i = 0; i < nx; i++ )
         {
-            if( ctx->debug_level >= PJ_LOG_DEBUG_MAJOR )
+            x[j * nx + i] = ct->ll.lam + i * del.lam;
+            y[j * nx + i] = ct->ll.phi + j * del.phi;
+        }
+    if( !pj_grid_pair_exact( srcdefn, dstdefn, count, x, y, 
+                             src_grid, dst_grid ) )
+        goto done;
+    for( j = 0; j < ny; j++ )
+        for( i = 0; i < nx; i++ )
+        {
+            long k = j * nx + i;
+
+            if( src_grid[k] == NULL )
+                continue;
+            cvs[k].lam = (float) (x[k] - (ct->ll.lam + i * del.lam));
+            cvs[k].phi = (float) (y[k] - (ct->ll.phi + j * del.phi));
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Keep the grids of the cell corners, over the node arrays,       */
+/*      and check the cells a row at a time.                            */
+/* -------------------------------------------------------------------- */
+    for( j = 0; j < ny - 1; j++ )
+        for( i = 0; i < nx - 1; i++ )
+        {
+            long k = j * nx + i, c = j * (nx - 1) + i;
+
+            pair->exact[c] = src_grid[k] == NULL
+                || src_grid[k+1] != src_grid[k] 
+                || src_grid[k+nx] != src_grid[k]
+                || src_grid[k+nx+1] != src_grid[k]
+                || dst_grid[k+1] != dst_grid[k] 
+                || dst_grid[k+nx] != dst_grid[k]
+                || dst_grid[k+nx+1] != dst_grid[k];
+        }
+    pj_dalloc( x );
+    pj_dalloc( y );
+    pj_dalloc( src_grid );
+    pj_dalloc( dst_grid );
+    x = (double *) pj_malloc( sizeof(double) * row_samples );
+    y = (double *) pj_malloc( sizeof(double) * row_samples );
+    src_grid = (PJ_GRIDINFO **) 
+        pj_malloc( sizeof(PJ_GRIDINFO *) * row_samples );
+    dst_grid = (PJ_GRIDINFO **) 
+        pj_malloc( sizeof(PJ_GRIDINFO *) * row_samples );
+    if( x == NULL || y == NULL || src_grid == NULL || dst_grid == NULL )
+        goto done;
+
+    for( j = 0; j < ny - 1; j++ )
+    {
+        unsigned char *exact = pair->exact + j * (nx - 1);
+
+        for( i = 0; i < nx - 1; i++ )
+            for( s = 0; s < GRID_PAIR_SAMPLES; s++ )
             {
-                pj_log( ctx, PJ_LOG_DEBUG_MAJOR,
-                    "pj_apply_gridshift(): failed to find a grid shift table for\n"
-                    "                      location (%.7fdW,%.7fdN)",
-                    x[io] * RAD_TO_DEG, 
-                    y[io] * RAD_TO_DEG );
-                for( itable = 0; itable < grid_count; itable++ )
-                {
-                    PJ_GRIDINFO *gi = tables[itable];
-                    if( itable == 0 )
-                        pj_log( ctx, PJ_LOG_DEBUG_MAJOR,
-                                "   tried: %s", gi->gridname );
-                    else
-                        pj_log( ctx, PJ_LOG_DEBUG_MAJOR,
-                                ",%s", gi->gridname );
-                }
+                x[i * GRID_PAIR_SAMPLES + s] = 
+                    ct->ll.lam + (i + sample[s][0]) * del.lam;
+                y[i * GRID_PAIR_SAMPLES + s] = 
+                    ct->ll.phi + (j + sample[s][1]) * del.phi;
             }
+        if( !pj_grid_pair_exact( srcdefn, dstdefn, row_samples, x, y,
+                                 src_grid, dst_grid ) )
+            goto done;
 
-            /* 
-             * We don't actually have any machinery currently to set the 
-             * following macro, so this is mostly kept here to make it clear 
-             * how we ought to operate if we wanted to make it super clear 
-             * that an error has occured when points are outside our available
-             * datum shift areas.  But if this is on, we will find that "low 
-             * value" points on the fringes of some datasets will completely 
-             * fail causing lots of problems when it is more or less ok to 
-             * just not apply a datum shift.  So rather than deal with
-             * that we just fallback to no shift. (see also bug #45).
-             */
-#ifdef ERR_GRID_AREA_TRANSIENT_SEVERE
-            y[io] = HUGE_VAL;
-            x[io] = HUGE_VAL;
-#else
-            /* leave x/y unshifted. */
-#endif
+        for( i = 0; i < nx - 1; i++ )
+        {
+            const FLP *f = cvs + j * nx + i;
+            PJ_GRIDINFO *gs = src_grid[i * GRID_PAIR_SAMPLES];
+            PJ_GRIDINFO *gd = dst_grid[i * GRID_PAIR_SAMPLES];
+
+            for( s = 0; !exact[i] && s < GRID_PAIR_SAMPLES; s++ )
+            {
+                long   k = i * GRID_PAIR_SAMPLES + s;
+                double fx = sample[s][0];
+                double fy = sample[s][1];
+                double lam = ct->ll.lam + (i + fx) * del.lam;
+                double phi = ct->ll.phi + (j + fy) * del.phi;
+                double m00 = (1.0-fx) * (1.0-fy), m10 = fx * (1.0-fy);
+                double m01 = (1.0-fx) * fy, m11 = fx * fy;
+                double dlam, dphi;
+
+                dlam = lam + m00 * f[0].lam + m10 * f[1].lam
+                    + m01 * f[nx].lam + m11 * f[nx+1].lam - x[k];
+                dphi = phi + m00 * f[0].phi + m10 * f[1].phi
+                    + m01 * f[nx].phi + m11 * f[nx+1].phi - y[k];
+                dlam *= cos( phi );
+                exact[i] = src_grid[k] != gs || dst_grid[k] != gd
+                    || GRID_PAIR_WGS84_A 
+                       * sqrt( dlam * dlam + dphi * dphi ) > pair->tol;
+            }
         }
-        else
+    }
+
+    for( i = 0; i < cells && pair->exact[i]; i++ ) {}
+    if( i < cells )
+    {
+        ct->cvs = cvs;
+        cvs = NULL;
+    }
+
+  done:
+    pj_dalloc( x );
+    pj_dalloc( y );
+    pj_dalloc( src_grid );
+    pj_dalloc( dst_grid );
+    pj_dalloc( cvs );
+    if( ct->cvs == NULL )
+    {
+        pj_dalloc( pair->exact );
+        pair->exact = NULL;
+    }
+}
+
+/************************************************************************/
+/*                          pj_grid_pair_get()                          */
+/*                                                                      */
+/*      The composed shifts between two grid based datums, within tol   */
+/*      metres, built on first use and kept by the registry of the      */
+/*      source.  NULL if the definitions are in different registries,   */
+/*      or no cell is within the error.  The same lists of grids        */
+/*      always give the same shifts, so the pairs are found by the      */
+/*      +nadgrids= of the datums.  Non-blocking contexts, which could   */
+/*      not read the grids, leave the pair to be built by another.      */
+/************************************************************************/
+
+static PJ_GRID_PAIR *pj_grid_pair_find( PJ_GRID_REGISTRY *registry,
+                                        const char *src_grids, 
+                                        const char *dst_grids, double tol )
+
+{
+    PJ_GRID_PAIR *pair;
+
+    for( pair = registry->grid_pairs; pair != NULL; pair = pair->next )
+        if( pair->tol == tol && strcmp( pair->src_grids, src_grids ) == 0
+            && strcmp( pair->dst_grids, dst_grids ) == 0 )
+            break;
+
+    return pair;
+}
+
+static void pj_grid_pair_free( PJ_GRID_PAIR *pair )
+
+{
+    pj_dalloc( pair->src_grids );
+    pj_dalloc( pair->dst_grids );
+    pj_dalloc( pair->ct.cvs );
+    pj_dalloc( pair->exact );
+    pj_dalloc( pair );
+}
+
+PJ_GRID_PAIR *pj_grid_pair_get( PJ *srcdefn, PJ *dstdefn, double tol )
+
+{
+    PJ_GRID_REGISTRY *registry = pj_grid_registry_of( srcdefn );
+    const char *src_grids = 
+        pj_param( srcdefn->ctx, srcdefn->params, "snadgrids" ).s;
+    const char *dst_grids = 
+        pj_param( dstdefn->ctx, dstdefn->params, "snadgrids" ).s;
+    PJ_GRID_PAIR *pair, *built;
+
+    if( registry != pj_grid_registry_of( dstdefn )
+        || src_grids == NULL || dst_grids == NULL )
+        return NULL;
+
+    pj_rwlock_acquire( registry->grid_lock, 0 );
+    pair = pj_grid_pair_find( registry, src_grids, dst_grids, tol );
+    pj_rwlock_release( registry->grid_lock, 0 );
+
+/* -------------------------------------------------------------------- */
+/*      Build outside the lock, shifting points with the grids, and     */
+/*      keep the first pair built if another thread got there too.      */
+/* -------------------------------------------------------------------- */
+    if( pair == NULL )
+    {
+        if( srcdefn->ctx->grid_nonblocking || dstdefn->ctx->grid_nonblocking )
+            return NULL;
+
+        built = (PJ_GRID_PAIR *) pj_malloc( sizeof(PJ_GRID_PAIR) );
+        if( built == NULL )
+            return NULL;
+        memset( built, 0, sizeof(PJ_GRID_PAIR) );
+        built->tol = tol;
+        built->src_grids = (char *) pj_malloc( strlen(src_grids) + 1 );
+        built->dst_grids = (char *) pj_malloc( strlen(dst_grids) + 1 );
+        if( built->src_grids != NULL )
+            strcpy( built->src_grids, src_grids );
+        if( built->dst_grids != NULL )
+            strcpy( built->dst_grids, dst_grids );
+        if( built->src_grids == NULL || built->dst_grids == NULL )
         {
-            y[io] = output.phi;
-            x[io] = output.lam;
+            pj_grid_pair_free( built );
+            return NULL;
         }
+
+        /* the lists are looked up by the shifts, if not yet */
+        if( srcdefn->cold->gridlist == NULL )
+            pj_apply_gridshift_t( srcdefn, 0, 0, 1, NULL, NULL, NULL, NULL );
+        if( dstdefn->cold->gridlist == NULL )
+            pj_apply_gridshift_t( dstdefn, 1, 0, 1, NULL, NULL, NULL, NULL );
+        if( srcdefn->cold->gridlist != NULL
+            && dstdefn->cold->gridlist != NULL )
+            pj_grid_pair_build( srcdefn, dstdefn, built );
+        srcdefn->ctx->last_errno = 0;
+        dstdefn->ctx->last_errno = 0;
+
+        pj_rwlock_acquire( registry->grid_lock, 1 );
+        pair = pj_grid_pair_find( registry, src_grids, dst_grids, tol );
+        if( pair == NULL )
+        {
+            built->next = registry->grid_pairs;
+            registry->grid_pairs = pair = built;
+            built = NULL;
+        }
+        pj_rwlock_release( registry->grid_lock, 1 );
+
+        if( built != NULL )
+            pj_grid_pair_free( built );
     }
 
-    return 0;
+    return pair->ct.cvs != NULL ? pair : NULL;
+}
+
+/************************************************************************/
+/*                         pj_grid_pair_apply()                         */
+/*                                                                      */
+/*      Shift the points in the kept cells of the pair, setting         */
+/*      left[i] for the others, which are left as they are.             */
+/************************************************************************/
+
+void pj_grid_pair_apply( const PJ_GRID_PAIR *pair, long point_count, 
+                         int point_offset, double *x, double *y,
+                         unsigned char *left )
+
+{
+    const struct CTABLE *ct = &(pair->ct);
+    long   nx = ct->lim.lam, i;
+
+    for( i = 0; i < point_count; i++ )
+    {
+        long   io = i * point_offset;
+        double fx = (x[io] - ct->ll.lam) / ct->del.lam;
+        double fy = (y[io] - ct->ll.phi) / ct->del.phi;
+        long   ix, iy;
+        const FLP *f;
+
+        left[i] = 1;
+        /* also false for HUGE_VAL and NaN */
+        if( !(fx >= 0.0 && fx <= nx - 1) 
+            || !(fy >= 0.0 && fy <= ct->lim.phi - 1) )
+            continue;
+        ix = (long) fx;
+        iy = (long) fy;
+        if( ix == nx - 1 )
+            ix--;
+        if( iy == ct->lim.phi - 1 )
+            iy--;
+        if( pair->exact[iy * (nx - 1) + ix] )
+            continue;
+
+        fx -= ix;
+        fy -= iy;
+        f = ct->cvs + iy * nx + ix;
+        x[io] += (1.0-fx) * (1.0-fy) * f[0].lam + fx * (1.0-fy) * f[1].lam
+            + (1.0-fx) * fy * f[nx].lam + fx * fy * f[nx+1].lam;
+        y[io] += (1.0-fx) * (1.0-fy) * f[0].phi + fx * (1.0-fy) * f[1].phi
+            + (1.0-fx) * fy * f[nx].phi + fx * fy * f[nx+1].phi;
+        left[i] = 0;
+    }
 }
 
+/************************************************************************/
+/*                         pj_grid_pairs_free()                         */
+/*                                                                      */
+/*      Free the grid pairs of a registry.                              */
+/************************************************************************/
+
+void pj_grid_pairs_free( PJ_GRID_REGISTRY *registry )
+
+{
+    while( registry->grid_pairs != NULL )
+    {
+        PJ_GRID_PAIR *pair = registry->grid_pairs;
+
+        registry->grid_pairs = pair->next;
+        pj_grid_pair_free( pair );
+    }
+}
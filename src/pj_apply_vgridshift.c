@@ -33,6 +33,239 @@
 #include <projects.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
+
+#define VGRIDSHIFT_CHUNK 256
+
+/************************************************************************/
+/*                         pj_vgrid_covers()                            */
+/*                                                                      */
+/*      Whether the extent of the grid covers the point.  Unlike the    */
+/*      horizontal shifts, the extents are taken exactly.               */
+/************************************************************************/
+
+static int pj_vgrid_covers( PJ_GRIDINFO *gi, LP input )
+
+{
+    struct CTABLE *ct = gi->ct;
+
+    return !( ct->ll.phi > input.phi || ct->ll.lam > input.lam
+              || ct->ll.phi + (ct->lim.phi-1) * ct->del.phi < input.phi
+              || ct->ll.lam + (ct->lim.lam-1) * ct->del.lam < input.lam );
+}
+
+/************************************************************************/
+/*                      pj_vgrid_meets_earlier()                        */
+/*                                                                      */
+/*      Whether the extent of tables[itable] meets that of an earlier   */
+/*      table, which would be tried first for some points.              */
+/************************************************************************/
+
+static int pj_vgrid_meets_earlier( PJ_GRIDINFO **tables, int itable )
+
+{
+    struct CTABLE *ct1 = tables[itable]->ct;
+    int i;
+
+    for( i = 0; i < itable; i++ )
+    {
+        struct CTABLE *ct2 = tables[i]->ct;
+
+        if( ct1->ll.lam <= ct2->ll.lam + (ct2->lim.lam-1) * ct2->del.lam
+            && ct2->ll.lam <= ct1->ll.lam + (ct1->lim.lam-1) * ct1->del.lam
+            && ct1->ll.phi <= ct2->ll.phi + (ct2->lim.phi-1) * ct2->del.phi
+            && ct2->ll.phi <= ct1->ll.phi + (ct1->lim.phi-1) * ct1->del.phi )
+            return 1;
+    }
+
+    return 0;
+}
+
+/************************************************************************/
+/*                         pj_vgrid_cells()                             */
+/*                                                                      */
+/*      Locate the cells of count points, which all lie within the      */
+/*      extent of the table: the index of the lower left node of        */
+/*      each, and the fractions of the point across it.  Points on      */
+/*      the east or north edge use the last cell rather than reading    */
+/*      past the table.                                                 */
+/************************************************************************/
+
+static void pj_vgrid_cells( struct CTABLE *ct, int count, const LP *input,
+                            long *index, double *fx, double *fy )
+
+{
+    long   row = ct->lim.lam;
+    int    i;
+
+    for( i = 0; i < count; i++ )
+    {
+        double grid_x = (input[i].lam - ct->ll.lam) / ct->del.lam;
+        double grid_y = (input[i].phi - ct->ll.phi) / ct->del.phi;
+        /* not negative within the extent, so truncation is floor() */
+        int    grid_ix = (int) grid_x;
+        int    grid_iy = (int) grid_y;
+
+        grid_x -= grid_ix;
+        grid_y -= grid_iy;
+        if( grid_ix >= ct->lim.lam - 1 && grid_ix > 0 )
+        {
+            grid_ix--;
+            grid_x += 1.0;
+        }
+        if( grid_iy >= ct->lim.phi - 1 && grid_iy > 0 )
+        {
+            grid_iy--;
+            grid_y += 1.0;
+        }
+        index[i] = grid_ix + grid_iy * row;
+        fx[i] = grid_x;
+        fy[i] = grid_y;
+    }
+}
+
+/************************************************************************/
+/*                         pj_vgrid_blend()                             */
+/*                                                                      */
+/*      Blend the float corners of the located cells, in a loop         */
+/*      without branches, which compilers can vectorize.                */
+/************************************************************************/
+
+static void pj_vgrid_blend( const float *cvs, long row, int count,
+                            const long *index, const double *fx,
+                            const double *fy, double *value )
+
+{
+    int    i;
+
+    for( i = 0; i < count; i++ )
+    {
+        const float *f = cvs + index[i];
+
+        value[i] = f[0] * (1.0-fx[i]) * (1.0-fy[i])
+            + f[1] * (fx[i]) * (1.0-fy[i])
+            + f[row] * (1.0-fx[i]) * (fy[i])
+            + f[row + 1] * (fx[i]) * (fy[i]);
+    }
+}
+
+/************************************************************************/
+/*                         pj_vgrid_values()                            */
+/*                                                                      */
+/*      Interpolate the grid at count points, which all lie within      */
+/*      its extent.  The heights are unpacked corner by corner if       */
+/*      quant is set.                                                   */
+/************************************************************************/
+
+static void pj_vgrid_values( PJ_GRIDINFO *gi, PJ_GRID_QUANT *quant, 
+                             int count, const LP *input, double *value )
+
+{
+    struct CTABLE *ct = gi->ct;
+    long   index[VGRIDSHIFT_CHUNK];
+    double fx[VGRIDSHIFT_CHUNK], fy[VGRIDSHIFT_CHUNK];
+    long   row = ct->lim.lam;
+    int    i;
+
+    pj_vgrid_cells( ct, count, input, index, fx, fy );
+
+    if( quant != NULL )
+    {
+        for( i = 0; i < count; i++ )
+        {
+            int   ix = (int) (index[i] % row), iy = (int) (index[i] / row);
+            float f[4];
+
+            f[0] = pj_grid_quant_height( gi, ix, iy );
+            f[1] = pj_grid_quant_height( gi, ix + 1, iy );
+            f[2] = pj_grid_quant_height( gi, ix, iy + 1 );
+            f[3] = pj_grid_quant_height( gi, ix + 1, iy + 1 );
+
+            value[i] = f[0] * (1.0-fx[i]) * (1.0-fy[i])
+                + f[1] * (fx[i]) * (1.0-fy[i])
+                + f[2] * (1.0-fx[i]) * (fy[i])
+                + f[3] * (fx[i]) * (fy[i]);
+        }
+        return;
+    }
+
+    pj_vgrid_blend( (float *) ct->cvs, row, count, index, fx, fy, value );
+}
+
+/************************************************************************/
+/*                       pj_vgrid_interpolate()                         */
+/*                                                                      */
+/*      pj_vgrid_values() with the grid loaded if needed, or through    */
+/*      its quantized heights if the context asks for them.  Returns    */
+/*      0, -38 if the grid cannot be read, or PJD_ERR_GRID_NOT_READY    */
+/*      if the context must not wait for it to be.                      */
+/************************************************************************/
+
+static int pj_vgrid_interpolate( projCtx ctx, PJ_GRIDINFO *gi, int count,
+                                 const LP *input, double *value )
+
+{
+    PJ_GRID_QUANT *quant;
+    int err;
+
+    if( (err = pj_gridinfo_ready( ctx, gi )) != 0 )
+        return err;
+
+    if( ctx->grid_quantize > 0.0 && gi->ct->cvs == NULL
+        && (quant = pj_gridinfo_quantized( ctx, gi )) != NULL )
+    {
+        pj_vgrid_values( gi, quant, count, input, value );
+        return 0;
+    }
+
+    /* load the grid shift info if we don't have it. */
+    if( !pj_gridinfo_acquire( ctx, gi ) )
+        return -38;
+    pj_vgrid_values( gi, NULL, count, input, value );
+    pj_gridinfo_release( gi );
+
+    return 0;
+}
+
+/************************************************************************/
+/*                        pj_vgridshift_missed()                        */
+/*                                                                      */
+/*      Log a point that no table could shift.                          */
+/************************************************************************/
+
+static void pj_vgridshift_missed( projCtx ctx, PJ_GRIDINFO **tables,
+                                  int grid_count, long point_index,
+                                  double x, double y )
+
+{
+    char gridlist[3000];
+    int itable;
+
+    pj_log_record( ctx, PJ_LOG_DEBUG_MAJOR, NULL, point_index,
+            PJD_ERR_GRID_AREA,
+            "pj_apply_vgridshift(): failed to find a grid shift table for\n"
+            "                       location (%.7fdW,%.7fdN)",
+            x * RAD_TO_DEG, 
+            y * RAD_TO_DEG );
+
+    gridlist[0] = '\0';
+    for( itable = 0; itable < grid_count; itable++ )
+    {
+        PJ_GRIDINFO *gi = tables[itable];
+        if( strlen(gridlist) + strlen(gi->gridname) > sizeof(gridlist)-100 )
+        {
+            strcat( gridlist, "..." );
+            break;
+        }
+
+        if( itable == 0 )
+            sprintf( gridlist, "   tried: %s", gi->gridname );
+        else
+            sprintf( gridlist+strlen(gridlist), ",%s", gi->gridname );
+    }
+    pj_log_record( ctx, PJ_LOG_DEBUG_MAJOR, NULL, point_index,
+                   PJD_ERR_GRID_AREA, "%s", gridlist );
+}
 
 /************************************************************************/
 /*                        pj_apply_vgridshift()                         */
@@ -41,6 +274,20 @@
 /*      system definition.  If the gridlist has not yet been            */
 /*      populated in the coordinate system definition we set it up      */
 /*      now.                                                            */
+/*                                                                      */
+/*      The points are taken a chunk at a time.  The grid of each       */
+/*      point is found first, starting with the table of the last       */
+/*      point, then runs of points in the same grid are interpolated    */
+/*      together.  Points on nodata go on to the following tables       */
+/*      one at a time, as before.                                       */
+/*                                                                      */
+/*      A point no grid covers fails the whole call, unless status,     */
+/*      with an entry per point, is passed: the point is then set to    */
+/*      HUGE_VAL with PJD_ERR_GRID_AREA as status, and points whose     */
+/*      status is already non-zero are left alone.  Points needing a    */
+/*      grid a non-blocking context does not have in memory are set     */
+/*      to HUGE_VAL, with PJD_ERR_GRID_NOT_READY set on the context,    */
+/*      see pj_ctx_set_grid_nonblocking().                              */
 /************************************************************************/
 
 int pj_apply_vgridshift( PJ *defn, const char *listname,
@@ -48,17 +295,23 @@ int pj_apply_vgridshift( PJ *defn, const char *listname,
                          int *gridlist_count_p,
                          int inverse, 
                          long point_count, int point_offset,
-                         double *x, double *y, double *z )
+                         double *x, double *y, double *z, int *status )
 
 {
-    int  i;
-    static int debug_count = 0;
     PJ_GRIDINFO **tables;
+    PJ_GRIDINFO *grid[VGRIDSHIFT_CHUNK];
+    int    table[VGRIDSHIFT_CHUNK];
+    LP     input[VGRIDSHIFT_CHUNK];
+    double value[VGRIDSHIFT_CHUNK];
+    int    last_table = -1;
+    long   base;
+    int    n, k, err;
 
     if( *gridlist_p == NULL )
     {
         *gridlist_p = 
-            pj_gridlist_from_nadgrids( pj_get_ctx(defn), 
+            pj_gridlist_from_registry( pj_get_ctx(defn), 
+                                       pj_grid_registry_of( defn ),
                                        pj_param(defn->ctx,defn->params,listname).s,
                                        gridlist_count_p );
 
@@ -75,137 +328,535 @@ int pj_apply_vgridshift( PJ *defn, const char *listname,
     tables = *gridlist_p;
     defn->ctx->last_errno = 0;
 
-    for( i = 0; i < point_count; i++ )
+    for( base = 0; base < point_count; base += n )
     {
-        long io = i * point_offset;
-        LP   input;
-        int  itable;
-        double value = HUGE_VAL;
+        n = point_count - base > VGRIDSHIFT_CHUNK 
+            ? VGRIDSHIFT_CHUNK : (int) (point_count - base);
 
-        input.phi = y[io];
-        input.lam = x[io];
-
-        /* keep trying till we find a table that works */
-        for( itable = 0; itable < *gridlist_count_p; itable++ )
+/* -------------------------------------------------------------------- */
+/*      Find the first grid covering each point.  The table of the      */
+/*      last point is only tried first when no earlier table meets      */
+/*      it, so that the search order is kept.                           */
+/* -------------------------------------------------------------------- */
+        for( k = 0; k < n; k++ )
         {
-            PJ_GRIDINFO *gi = tables[itable];
-            struct CTABLE *ct = gi->ct;
-            double grid_x, grid_y;
-            int    grid_ix, grid_iy;
-            float  *cvs;
-
-            /* skip tables that don't match our point at all.  */
-            if( ct->ll.phi > input.phi || ct->ll.lam > input.lam
-                || ct->ll.phi + (ct->lim.phi-1) * ct->del.phi < input.phi
-                || ct->ll.lam + (ct->lim.lam-1) * ct->del.lam < input.lam )
-                continue;
+            long io = (base + k) * point_offset;
+            int  itable;
 
-            /* If we have child nodes, check to see if any of them apply. */
-            while( gi->child != NULL )
-            {
-                PJ_GRIDINFO *child;
+            input[k].phi = y[io];
+            input[k].lam = x[io];
+            grid[k] = NULL;
+            table[k] = *gridlist_count_p;
 
-                for( child = gi->child; child != NULL; child = child->next )
+            if( last_table >= 0 
+                && pj_vgrid_covers( tables[last_table], input[k] ) )
+                itable = last_table;
+            else
+            {
+                for( itable = 0; itable < *gridlist_count_p; itable++ )
                 {
-                    struct CTABLE *ct1 = child->ct;
+                    /* skip tables that don't match our point at all.  */
+                    if( pj_vgrid_covers( tables[itable], input[k] ) )
+                        break;
+                }
+                if( itable == *gridlist_count_p )
+                    continue;
 
-                    if( ct1->ll.phi > input.phi || ct1->ll.lam > input.lam
-                      || ct1->ll.phi+(ct1->lim.phi-1)*ct1->del.phi < input.phi
-                      || ct1->ll.lam+(ct1->lim.lam-1)*ct1->del.lam < input.lam)
-                        continue;
+                last_table = -1;
+                if( !pj_vgrid_meets_earlier( tables, itable ) )
+                    last_table = itable;
+            }
 
-                    break;
+            /* If we have child nodes, check to see if any of them apply. */
+            grid[k] = pj_gridinfo_descend( tables[itable], input[k], 0, NULL );
+            table[k] = itable;
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Interpolate the runs of points sharing a grid.                  */
+/* -------------------------------------------------------------------- */
+        for( k = 0; k < n; )
+        {
+            PJ_GRIDINFO *gi = grid[k];
+            int k1;
+
+            for( k1 = k + 1; k1 < n && grid[k1] == gi; k1++ ) {}
+
+            if( gi != NULL
+                && (err = pj_vgrid_interpolate( pj_get_ctx(defn), gi, k1 - k,
+                                                input + k, value + k )) != 0 )
+            {
+                if( err != PJD_ERR_GRID_NOT_READY )
+                {
+                    pj_ctx_set_errno( defn->ctx, -38 );
+                    return -38;
                 }
+                /* to be tried again once the grid is loaded */
+                for( ; k < k1; k++ )
+                    value[k] = HUGE_VAL;
+            }
+            k = k1;
+        }
 
-                /* we didn't find a more refined child node to use, so go with current grid */
-                if( child == NULL )
+/* -------------------------------------------------------------------- */
+/*      Apply the values in point order, trying the following tables    */
+/*      for points on nodata.                                           */
+/* -------------------------------------------------------------------- */
+        for( k = 0; k < n; k++ )
+        {
+            long io = (base + k) * point_offset;
+            PJ_GRIDINFO *gi = grid[k];
+            int  itable = table[k];
+
+            if( status != NULL && status[base + k] != 0 )
+                continue;
+
+            while( gi != NULL && value[k] == -88.88880f ) /* nodata? */
+            {
+                gi = NULL;
+                for( itable++; itable < *gridlist_count_p; itable++ )
                 {
+                    if( !pj_vgrid_covers( tables[itable], input[k] ) )
+                        continue;
+
+                    gi = pj_gridinfo_descend( tables[itable], input[k], 
+                                              0, NULL );
+                    err = pj_vgrid_interpolate( pj_get_ctx(defn), gi, 1,
+                                                input + k, value + k );
+                    if( err == PJD_ERR_GRID_NOT_READY )
+                        value[k] = HUGE_VAL;
+                    else if( err != 0 )
+                    {
+                        pj_ctx_set_errno( defn->ctx, -38 );
+                        return -38;
+                    }
                     break;
                 }
+            }
 
-                /* Otherwise let's try for childrens children .. */
-                gi = child;
-                ct = child->ct;
+            if( gi != NULL && value[k] == HUGE_VAL )
+            {
+                x[io] = y[io] = HUGE_VAL;
+                pj_ctx_set_errno( defn->ctx, PJD_ERR_GRID_NOT_READY );
+                continue;
             }
 
-            /* load the grid shift info if we don't have it. */
-            if( ct->cvs == NULL && !pj_gridinfo_load( pj_get_ctx(defn), gi ) )
+            if( gi == NULL )
             {
-                pj_ctx_set_errno( defn->ctx, -38 );
-                return -38;
+                /* once per batch, or per point with a status */
+                if( status != NULL 
+                    ? pj_log_site_wanted( defn->ctx, PJ_LOG_DEBUG_MAJOR,
+                                          PJ_LOG_SITE_GRID_MISSED )
+                    : pj_log_enabled( defn->ctx, PJ_LOG_DEBUG_MAJOR ) )
+                    pj_vgridshift_missed( defn->ctx, tables, 
+                                          *gridlist_count_p, base + k,
+                                          x[io], y[io] );
+
+                if( status != NULL )
+                {
+                    status[base + k] = PJD_ERR_GRID_AREA;
+                    x[io] = y[io] = HUGE_VAL;
+                    continue;
+                }
+
+                pj_ctx_set_errno( defn->ctx, PJD_ERR_GRID_AREA );
+                return PJD_ERR_GRID_AREA;
             }
 
-            /* Interpolation a location within the grid */
-            grid_x = (input.lam - ct->ll.lam) / ct->del.lam;
-            grid_y = (input.phi - ct->ll.phi) / ct->del.phi;
-            grid_ix = (int) floor(grid_x);
-            grid_iy = (int) floor(grid_y);
-            grid_x -= grid_ix;
-            grid_y -= grid_iy;
-
-            cvs = (float *) ct->cvs;
-            value = cvs[grid_ix + grid_iy * ct->lim.lam] 
-                * (1.0-grid_x) * (1.0-grid_y)
-                + cvs[grid_ix + 1 + grid_iy * ct->lim.lam] 
-                * (grid_x) * (1.0-grid_y)
-                + cvs[grid_ix + (grid_iy+1) * ct->lim.lam] 
-                * (1.0-grid_x) * (grid_y)
-                + cvs[grid_ix + 1 + (grid_iy+1) * ct->lim.lam] 
-                * (grid_x) * (grid_y);
-
-            if( value == -88.88880f ) /* nodata? */
-                value = HUGE_VAL;
+            if( inverse )
+                z[io] -= value[k];
             else
+                z[io] += value[k];
+
+            if( pj_log_site_wanted( defn->ctx, PJ_LOG_DEBUG_MINOR,
+                                    PJ_LOG_SITE_VGRID_USED ) )
+                pj_log_record( defn->ctx, PJ_LOG_DEBUG_MINOR, gi->gridname,
+                               base + k, 0,
+                               "pj_apply_gridshift(): used %s",
+                               gi->ct->id );
+        }
+    }
+
+    return 0;
+}
+
+/************************************************************************/
+/*                         pj_vgrid_coverage()                          */
+/*                                                                      */
+/*      As pj_grid_coverage(), for the points a geoidgrids list would   */
+/*      shift: those in the extent of a grid, and on a value of it      */
+/*      rather than on nodata, which takes reading the grids.  A        */
+/*      non-blocking context gets PJD_ERR_GRID_NOT_READY until they     */
+/*      are loaded.                                                     */
+/************************************************************************/
+
+int pj_vgrid_coverage( projCtx ctx, const char *geoidgrids, long point_count,
+                       const double *lon, const double *lat,
+                       unsigned char *mask )
+
+{
+    PJ_GRIDINFO **tables;
+    int       grid_count, err;
+    long      i;
+
+    if( ctx == NULL )
+        ctx = pj_get_default_ctx();
+
+    ctx->last_errno = 0;
+    tables = pj_gridlist_from_nadgrids( ctx, geoidgrids, &grid_count );
+    if( tables == NULL )
+        return ctx->last_errno ? ctx->last_errno : -38;
+
+    for( i = 0; i < point_count; i++ )
+    {
+        LP     input;
+        double value;
+        int    itable;
+
+        input.lam = lon[i];
+        input.phi = lat[i];
+        mask[i] = 0;
+        if( input.lam == HUGE_VAL )
+            continue;
+
+        for( itable = 0; itable < grid_count; itable++ )
+        {
+            PJ_GRIDINFO *gi;
+
+            if( !pj_vgrid_covers( tables[itable], input ) )
+                continue;
+
+            gi = pj_gridinfo_descend( tables[itable], input, 0, NULL );
+            if( (err = pj_vgrid_interpolate( ctx, gi, 1, &input, 
+                                             &value )) != 0 )
             {
-                if( inverse )
-                    z[io] -= value;
-                else
-                    z[io] += value;
+                pj_dalloc( tables );
+                pj_ctx_set_errno( ctx, err );
+                return err;
             }
-                
-            if( value != HUGE_VAL )
+            if( value != -88.88880f ) /* nodata? */
             {
-                if( debug_count++ < 20 )
-                    pj_log( defn->ctx, PJ_LOG_DEBUG_MINOR, 
-                            "pj_apply_gridshift(): used %s",
-                            ct->id );
+                mask[i] = 1;
                 break;
             }
         }
+    }
+
+    pj_dalloc( tables );
 
-        if( value == HUGE_VAL )
+    return 0;
+}
+
+/************************************************************************/
+/*                        pj_geoid_diff_build()                         */
+/*                                                                      */
+/*      The heights of src less those of dst on the nodes they          */
+/*      share.  The grids qualify if their nodes are on one lattice,    */
+/*      with at least one cell in common and no nodata there.  The      */
+/*      difference is rounded to a float, as the heights are, which     */
+/*      is within a few micrometres for geoid grids.  The values are    */
+/*      NULL if the grids do not qualify, or cannot be read, so that    */
+/*      they are not tried again.                                       */
+/************************************************************************/
+
+static PJ_GEOID_DIFF *pj_geoid_diff_build( projCtx ctx, PJ_GRIDINFO *src,
+                                           PJ_GRIDINFO *dst )
+
+{
+    PJ_GEOID_DIFF *diff;
+    struct CTABLE *cs = src->ct, *cd = dst->ct;
+    double  ox, oy;
+    long    sx, sy, dx, dy, nx, ny, i, j;
+    float  *values;
+
+    diff = (PJ_GEOID_DIFF *) pj_malloc( sizeof(PJ_GEOID_DIFF) );
+    if( diff == NULL )
+        return NULL;
+    memset( diff, 0, sizeof(PJ_GEOID_DIFF) );
+    diff->src = src;
+    diff->dst = dst;
+
+    if( fabs(cs->del.lam - cd->del.lam) > 1e-12 * fabs(cs->del.lam)
+        || fabs(cs->del.phi - cd->del.phi) > 1e-12 * fabs(cs->del.phi) )
+        return diff;
+
+    /* nodes of dst counted from those of src */
+    ox = (cd->ll.lam - cs->ll.lam) / cs->del.lam;
+    oy = (cd->ll.phi - cs->ll.phi) / cs->del.phi;
+    if( fabs(ox - floor(ox + 0.5)) > 1e-9 || fabs(oy - floor(oy + 0.5)) > 1e-9
+        || fabs(ox) > INT_MAX || fabs(oy) > INT_MAX )
+        return diff;
+    ox = floor(ox + 0.5);
+    oy = floor(oy + 0.5);
+
+    sx = ox > 0 ? (long) ox : 0;
+    sy = oy > 0 ? (long) oy : 0;
+    dx = ox < 0 ? (long) -ox : 0;
+    dy = oy < 0 ? (long) -oy : 0;
+    nx = MIN( cs->lim.lam - sx, cd->lim.lam - dx );
+    ny = MIN( cs->lim.phi - sy, cd->lim.phi - dy );
+    if( nx < 2 || ny < 2 )
+        return diff;
+
+    if( !pj_gridinfo_acquire( ctx, src ) )
+        return diff;
+    if( !pj_gridinfo_acquire( ctx, dst ) )
+    {
+        pj_gridinfo_release( src );
+        return diff;
+    }
+
+    values = (float *) 
+        pj_gridinfo_alloc_values( ctx, src, sizeof(float) * nx * ny,
+                                  &(diff->values_paged) );
+    for( j = 0; values != NULL && j < ny; j++ )
+    {
+        const float *hs = (float *) cs->cvs + (sy + j) * cs->lim.lam + sx;
+        const float *hd = (float *) cd->cvs + (dy + j) * cd->lim.lam + dx;
+
+        for( i = 0; i < nx; i++ )
+        {
+            if( hs[i] == -88.88880f || hd[i] == -88.88880f ) /* nodata? */
+                break;
+            values[j * nx + i] = hs[i] - hd[i];
+        }
+        if( i < nx )
         {
-            char gridlist[3000];
+            pj_gridinfo_free_values( src, values, diff->values_paged );
+            values = NULL;
+        }
+    }
 
-            pj_log( defn->ctx, PJ_LOG_DEBUG_MAJOR,
-                    "pj_apply_vgridshift(): failed to find a grid shift table for\n"
-                    "                       location (%.7fdW,%.7fdN)",
-                    x[io] * RAD_TO_DEG, 
-                    y[io] * RAD_TO_DEG );
+    pj_gridinfo_release( dst );
+    pj_gridinfo_release( src );
 
-            gridlist[0] = '\0';
-            for( itable = 0; itable < *gridlist_count_p; itable++ )
-            {
-                PJ_GRIDINFO *gi = tables[itable];
-                if( strlen(gridlist) + strlen(gi->gridname) > sizeof(gridlist)-100 )
-                {
-                    strcat( gridlist, "..." );
-                    break;
-                }
+    if( values == NULL )
+        return diff;
+
+    strcpy( diff->ct.id, "geoid difference" );
+    diff->ct.ll.lam = ox > 0 ? cd->ll.lam : cs->ll.lam;
+    diff->ct.ll.phi = oy > 0 ? cd->ll.phi : cs->ll.phi;
+    diff->ct.del = cs->del;
+    diff->ct.lim.lam = (int) nx;
+    diff->ct.lim.phi = (int) ny;
+    diff->ct.cvs = (FLP *) values;
+
+    return diff;
+}
+
+/************************************************************************/
+/*                         pj_geoid_diff_get()                          */
+/*                                                                      */
+/*      The difference of the geoid grids of two definitions, built     */
+/*      on first use and kept by their registry.  NULL if they do not   */
+/*      have a single grid each, without children, in one registry,     */
+/*      or if their grids do not qualify.  Quantized heights are not    */
+/*      differenced, as they would be used in place of the grids.      */
+/*      Non-blocking contexts do not build it before both grids are    */
+/*      loaded, see pj_ctx_set_grid_nonblocking().                      */
+/************************************************************************/
+
+static PJ_GEOID_DIFF *pj_geoid_diff_get( PJ *srcdefn, PJ *dstdefn )
+
+{
+    projCtx ctx = pj_get_ctx( srcdefn );
+    PJ_GRID_REGISTRY *registry = pj_grid_registry_of( srcdefn );
+    PJ_GRIDINFO *src, *dst;
+    PJ_GEOID_DIFF *diff, *built;
+
+    if( srcdefn->cold->vgridlist_geoid_count != 1
+        || dstdefn->cold->vgridlist_geoid_count != 1
+        || registry != pj_grid_registry_of( dstdefn )
+        || ctx->grid_quantize > 0.0 
+        || pj_get_ctx( dstdefn )->grid_quantize > 0.0 )
+        return NULL;
+
+    src = srcdefn->cold->vgridlist_geoid[0];
+    dst = dstdefn->cold->vgridlist_geoid[0];
+    if( src->ct == NULL || dst->ct == NULL 
+        || src->child != NULL || dst->child != NULL )
+        return NULL;
+
+    pj_rwlock_acquire( registry->grid_lock, 0 );
+    for( diff = registry->geoid_diffs; diff != NULL; diff = diff->next )
+        if( diff->src == src && diff->dst == dst )
+            break;
+    pj_rwlock_release( registry->grid_lock, 0 );
+
+/* -------------------------------------------------------------------- */
+/*      Build outside the lock, reading the grids, and keep the first   */
+/*      one built if another thread got there too.                      */
+/* -------------------------------------------------------------------- */
+    if( diff == NULL )
+    {
+        if( ctx->grid_nonblocking 
+            && (src->ct->cvs == NULL || dst->ct->cvs == NULL) )
+            return NULL;
+
+        built = pj_geoid_diff_build( ctx, src, dst );
+        if( built == NULL )
+            return NULL;
+
+        pj_rwlock_acquire( registry->grid_lock, 1 );
+        for( diff = registry->geoid_diffs; diff != NULL; diff = diff->next )
+            if( diff->src == src && diff->dst == dst )
+                break;
+        if( diff == NULL )
+        {
+            built->next = registry->geoid_diffs;
+            registry->geoid_diffs = diff = built;
+            built = NULL;
+        }
+        pj_rwlock_release( registry->grid_lock, 1 );
+
+        if( built != NULL )
+        {
+            if( built->ct.cvs != NULL )
+                pj_gridinfo_free_values( src, built->ct.cvs, 
+                                         built->values_paged );
+            pj_dalloc( built );
+        }
+    }
+
+    return diff->ct.cvs != NULL ? diff : NULL;
+}
+
+/************************************************************************/
+/*                        pj_geoid_diffs_free()                         */
+/*                                                                      */
+/*      Free the geoid differences of a registry, before its grids.     */
+/************************************************************************/
+
+void pj_geoid_diffs_free( PJ_GRID_REGISTRY *registry )
+
+{
+    while( registry->geoid_diffs != NULL )
+    {
+        PJ_GEOID_DIFF *diff = registry->geoid_diffs;
+
+        registry->geoid_diffs = diff->next;
+        if( diff->ct.cvs != NULL )
+            pj_gridinfo_free_values( diff->src, diff->ct.cvs, 
+                                     diff->values_paged );
+        pj_dalloc( diff );
+    }
+}
 
-                if( itable == 0 )
-                    sprintf( gridlist, "   tried: %s", gi->gridname );
-                else
-                    sprintf( gridlist+strlen(gridlist), ",%s", gi->gridname );
+/************************************************************************/
+/*                        pj_apply_geoid_diff()                         */
+/*                                                                      */
+/*      Go from the geoid heights of srcdefn to those of dstdefn, as    */
+/*      pj_apply_vgridshift() forward with the geoid grids of the       */
+/*      source and then inverse with those of the destination.  When   */
+/*      both have a single grid, on one lattice, their difference is    */
+/*      interpolated once instead, which reads half the values.  That  */
+/*      is done only if every point to shift lies in both grids, and    */
+/*      the two shifts are applied otherwise, so that failures are      */
+/*      those of the two.  Returns 0, or the error of the failing       */
+/*      shift.                                                          */
+/************************************************************************/
+
+int pj_apply_geoid_diff( PJ *srcdefn, PJ *dstdefn,
+                         long point_count, int point_offset,
+                         double *x, double *y, double *z, int *status )
+
+{
+    PJ_GEOID_DIFF *diff = NULL;
+    LP     input[VGRIDSHIFT_CHUNK];
+    long   index[VGRIDSHIFT_CHUNK];
+    double fx[VGRIDSHIFT_CHUNK], fy[VGRIDSHIFT_CHUNK];
+    double value[VGRIDSHIFT_CHUNK];
+    long   base, i;
+    int    n, k;
+
+    if( srcdefn->cold->vgridlist_geoid == NULL )
+        srcdefn->cold->vgridlist_geoid = 
+            pj_gridlist_from_registry( pj_get_ctx(srcdefn), 
+                pj_grid_registry_of( srcdefn ),
+                pj_param(srcdefn->ctx,srcdefn->params,"sgeoidgrids").s,
+                &(srcdefn->cold->vgridlist_geoid_count) );
+    if( dstdefn->cold->vgridlist_geoid == NULL )
+        dstdefn->cold->vgridlist_geoid = 
+            pj_gridlist_from_registry( pj_get_ctx(dstdefn), 
+                pj_grid_registry_of( dstdefn ),
+                pj_param(dstdefn->ctx,dstdefn->params,"sgeoidgrids").s,
+                &(dstdefn->cold->vgridlist_geoid_count) );
+
+    if( srcdefn->cold->vgridlist_geoid != NULL
+        && dstdefn->cold->vgridlist_geoid != NULL )
+        diff = pj_geoid_diff_get( srcdefn, dstdefn );
+
+    for( i = 0; diff != NULL && i < point_count; i++ )
+    {
+        LP   p;
+
+        if( status != NULL && status[i] != 0 )
+            continue;
+        p.lam = x[i * point_offset];
+        p.phi = y[i * point_offset];
+        if( !pj_vgrid_covers( diff->src, p ) 
+            || !pj_vgrid_covers( diff->dst, p ) )
+            diff = NULL;
+    }
+
+    if( diff == NULL )
+    {
+        if( pj_apply_vgridshift( srcdefn, "sgeoidgrids", 
+                                 &(srcdefn->cold->vgridlist_geoid), 
+                                 &(srcdefn->cold->vgridlist_geoid_count),
+                                 0, point_count, point_offset, x, y, z,
+                                 status ) != 0 )
+            return pj_ctx_get_errno( srcdefn->ctx );
+        if( pj_apply_vgridshift( dstdefn, "sgeoidgrids", 
+                                 &(dstdefn->cold->vgridlist_geoid), 
+                                 &(dstdefn->cold->vgridlist_geoid_count),
+                                 1, point_count, point_offset, x, y, z,
+                                 status ) != 0 )
+            return dstdefn->ctx->last_errno;
+        return 0;
+    }
+
+    srcdefn->ctx->last_errno = 0;
+    dstdefn->ctx->last_errno = 0;
+
+    for( base = 0; base < point_count; base += n )
+    {
+        n = point_count - base > VGRIDSHIFT_CHUNK 
+            ? VGRIDSHIFT_CHUNK : (int) (point_count - base);
+
+        /* skipped points are taken at the corner, and left alone */
+        for( k = 0; k < n; k++ )
+        {
+            long io = (base + k) * point_offset;
+
+            if( status != NULL && status[base + k] != 0 )
+                input[k] = diff->ct.ll;
+            else
+            {
+                input[k].lam = x[io];
+                input[k].phi = y[io];
             }
-            pj_log( defn->ctx, PJ_LOG_DEBUG_MAJOR,
-                    "%s", gridlist );
-                
-            pj_ctx_set_errno( defn->ctx, PJD_ERR_GRID_AREA );
-            return PJD_ERR_GRID_AREA;
+        }
+
+        pj_vgrid_cells( &(diff->ct), n, input, index, fx, fy );
+        pj_vgrid_blend( (float *) diff->ct.cvs, diff->ct.lim.lam, n,
+                        index, fx, fy, value );
+
+        for( k = 0; k < n; k++ )
+        {
+            if( status != NULL && status[base + k] != 0 )
+                continue;
+
+            z[(base + k) * point_offset] += value[k];
+
+            if( pj_log_site_wanted( srcdefn->ctx, PJ_LOG_DEBUG_MINOR,
+                                    PJ_LOG_SITE_VGRID_USED ) )
+                pj_log_record( srcdefn->ctx, PJ_LOG_DEBUG_MINOR, 
+                               diff->src->gridname, base + k, 0,
+                               "pj_apply_gridshift(): used %s less %s",
+                               diff->src->ct->id, diff->dst->ct->id );
         }
     }
 
     return 0;
 }
-
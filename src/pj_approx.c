@@ -0,0 +1,1258 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Runtime Chebyshev approximation of the forward and inverse
+ *           projection over a region, for +approx=cheby.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** +approx=cheby +approx_region=w,s,e,n [+approx_tol=meters]
+**
+** The region, in degrees, is covered by a quadtree of tiles.  Each tile
+** gets a bivariate Chebyshev series of P->fwd from mk_cheby(), which is
+** then compared with the exact projection on a grid twice as dense as
+** the fitting nodes.  Tiles within the tolerance (1 mm by default, or
+** +accuracy= if given) are kept, the others are split in four, down to
+** a depth limit where they are left to the exact projection.  The
+** inverse is done the same way over the bounding box of the projected
+** region.
+**
+** Points outside the region, or in tiles left exact, go through the
+** projection itself.  The tiles are built by pj_init() and only read
+** afterwards, so a PJ with an approximation is used as any other.
+**
+** With a directory set by pj_set_approx_cache(), or PROJ_APPROX_CACHE,
+** the tiles fitted are saved there, one file per definition, and later
+** definitions expanding to the same parameters load them instead of
+** fitting again.
+*/
+#define APPROX_ORDER     12     /* Chebyshev nodes on each axis of a tile */
+#define APPROX_NODES     (APPROX_ORDER * APPROX_ORDER)
+#define APPROX_CHECK     (2 * APPROX_ORDER + 1)
+#define APPROX_CHECKS    (APPROX_CHECK * APPROX_CHECK)
+#define APPROX_HALF      (APPROX_CHECK / 2)
+#define APPROX_SHARED    ((APPROX_HALF + 1) * (APPROX_HALF + 1))
+#define APPROX_DEPTH     8
+#define APPROX_MAX_FITS  4096   /* tiles tried, which bounds pj_init() time */
+#define APPROX_TOL       1e-3
+#define APPROX_RUN       64     /* points evaluated together by the arrays */
+#define APPROX_GROUP     64     /* tiles sampled in one batch */
+#define APPROX_MIN_SPLIT 256    /* samples of a batch for each thread */
+#define APPROX_MAGIC     "PJAPPRX1" /* changed with the fitting of tiles */
+
+#define APPROX_TILE_EXACT  0
+#define APPROX_TILE_SERIES 1
+#define APPROX_TILE_SPLIT  2
+
+typedef struct PJ_APPROX_TILE {
+    projUV                 a, b;    /* lower left and upper right corners */
+    Tseries                *T;      /* NULL if split, or left exact */
+    struct PJ_APPROX_TILE  *child;  /* four quarters, or NULL */
+} PJ_APPROX_TILE;
+
+struct PJ_APPROX {
+    XY  (*fwd)(LP, PJ *);           /* the exact projection */
+    LP  (*inv)(XY, PJ *);
+    PJ_APPROX_TILE  fwd_tiles;
+    PJ_APPROX_TILE  inv_tiles;
+    double          tol;            /* on the unit sphere */
+    int             fits;
+};
+
+/*
+** The tiles are fitted a level of the quadtree at a time, the samples of
+** groups of tiles of the level being evaluated in batches.  A batch is
+** split between P and clones of it without the approximation, on scratch
+** contexts, when the context has threads to share batches with (see
+** pj_ctx_set_threads()).  The check grid of a quarter has every other
+** point on that of its tile, so those are taken from it, rather than
+** evaluated again.
+*/
+static char *cache_dir = NULL;
+
+typedef struct {
+    PJ      *P;
+    XY      (*fwd)(LP, PJ *);       /* the exact projection of P */
+    LP      (*inv)(XY, PJ *);
+    int     inverse;
+    long    n;                      /* points of the batch for it */
+    projUV  *points;                /* evaluated in place */
+    void    *thread;
+} APPROX_WORKER;
+
+typedef struct {
+    struct PJ_APPROX  *A;
+    APPROX_WORKER     *workers;     /* on P, then on the clones */
+    int               worker_count;
+    APPROX_WORKER     self;         /* the workers if out of memory */
+} APPROX_FIT;
+
+typedef struct {
+    PJ_APPROX_TILE  *tile;
+    int             depth;
+    int             shared;         /* quarter of a tile that was checked */
+    projUV          from_tile[APPROX_SHARED];
+    Tseries         *T;             /* fitted, not checked yet */
+} APPROX_TODO;
+
+/************************************************************************/
+/*                            approx_exact()                            */
+/*                                                                      */
+/*      The exact projection of a point, with HUGE_VAL for points       */
+/*      that cannot be projected.                                       */
+/************************************************************************/
+
+static projUV approx_exact( projUV in, APPROX_WORKER *worker )
+
+{
+    PJ *P = worker->P;
+    projUV out;
+
+    P->ctx->last_errno = 0;
+    if( worker->inverse )
+    {
+        XY xy;
+        LP lp;
+
+        xy.x = in.u;
+        xy.y = in.v;
+        lp = (*worker->inv)( xy, P );
+        out.u = lp.lam;
+        out.v = lp.phi;
+    }
+    else
+    {
+        LP lp;
+        XY xy;
+
+        lp.lam = in.u;
+        lp.phi = in.v;
+        xy = (*worker->fwd)( lp, P );
+        out.u = xy.x;
+        out.v = xy.y;
+    }
+
+    /* also catches nan */
+    if( P->ctx->last_errno || !(fabs(out.u) < HUGE_VAL)
+        || !(fabs(out.v) < HUGE_VAL) )
+        out.u = out.v = HUGE_VAL;
+
+    return out;
+}
+
+/************************************************************************/
+/*                             approx_run()                             */
+/************************************************************************/
+
+static void approx_run( void *arg )
+
+{
+    APPROX_WORKER *worker = (APPROX_WORKER *) arg;
+    long i;
+
+    for( i = 0; i < worker->n; i++ )
+        worker->points[i] = approx_exact( worker->points[i], worker );
+}
+
+/************************************************************************/
+/*                            approx_eval()                             */
+/*                                                                      */
+/*      Evaluate a batch of points in place, split between the          */
+/*      workers.                                                        */
+/************************************************************************/
+
+static void approx_eval( APPROX_FIT *fit, int inverse, long n,
+                         projUV *points )
+
+{
+    long per, start;
+    int count = fit->worker_count, k;
+
+    if( count > n / APPROX_MIN_SPLIT )
+        count = n / APPROX_MIN_SPLIT > 0 ? (int) (n / APPROX_MIN_SPLIT) : 1;
+    per = (n + count - 1) / count;
+
+    for( k = count - 1; k >= 0; k-- )
+    {
+        APPROX_WORKER *worker = fit->workers + k;
+
+        start = per * k;
+        worker->inverse = inverse;
+        worker->points = points + start;
+        worker->n = n - start < per ? n - start : per;
+        worker->thread = NULL;
+        if( k > 0 )
+            worker->thread = pj_thread_start( approx_run, worker );
+        if( worker->thread == NULL )
+            approx_run( worker );
+    }
+
+    for( k = 1; k < count; k++ )
+        if( fit->workers[k].thread != NULL )
+            pj_thread_join( fit->workers[k].thread );
+}
+
+/************************************************************************/
+/*                           approx_free_T()                            */
+/************************************************************************/
+
+static void approx_free_T( Tseries *T )
+
+{
+    int i;
+
+    if( T == NULL )
+        return;
+
+    for( i = 0; i <= T->mu; i++ )
+        if( T->cu[i].c )
+            pj_dalloc( T->cu[i].c );
+    for( i = 0; i <= T->mv; i++ )
+        if( T->cv[i].c )
+            pj_dalloc( T->cv[i].c );
+    if( T->packed )
+        pj_dalloc( T->packed );
+    pj_dalloc( T->cu );
+    pj_dalloc( T->cv );
+    pj_dalloc( T );
+}
+
+/************************************************************************/
+/*                         approx_free_tiles()                          */
+/************************************************************************/
+
+static void approx_free_tiles( PJ_APPROX_TILE *tile )
+
+{
+    int i;
+
+    approx_free_T( tile->T );
+    if( tile->child != NULL )
+    {
+        for( i = 0; i < 4; i++ )
+            approx_free_tiles( tile->child + i );
+        pj_dalloc( tile->child );
+    }
+}
+
+/************************************************************************/
+/*                          approx_check_in()                           */
+/*                                                                      */
+/*      Point i, j of the check grid of a tile, twice as dense as       */
+/*      the fitting nodes.                                              */
+/************************************************************************/
+
+static projUV approx_check_in( PJ_APPROX_TILE *tile, int i, int j )
+
+{
+    projUV in;
+
+    in.u = tile->a.u + (tile->b.u - tile->a.u) * i / (APPROX_CHECK - 1);
+    in.v = tile->a.v + (tile->b.v - tile->a.v) * j / (APPROX_CHECK - 1);
+
+    return in;
+}
+
+/************************************************************************/
+/*                            approx_check()                            */
+/*                                                                      */
+/*      Is the series of a tile within the tolerance on the check       */
+/*      grid, given the exact values there?                             */
+/************************************************************************/
+
+static int approx_check( struct PJ_APPROX *A, int inverse,
+                         PJ_APPROX_TILE *tile, Tseries *T,
+                         const projUV *check )
+
+{
+    projUV approx[APPROX_CHECK];
+    double du, dv, tol2 = A->tol * A->tol;
+    int i, j;
+
+    /* a row at a time, to stop at the first one off */
+    for( i = 0; i < APPROX_CHECK; i++, check += APPROX_CHECK )
+    {
+        for( j = 0; j < APPROX_CHECK; j++ )
+            approx[j] = approx_check_in( tile, i, j );
+        bcheval_n( approx, approx, APPROX_CHECK, T );
+
+        for( j = 0; j < APPROX_CHECK; j++ )
+        {
+            if( check[j].u == HUGE_VAL )
+                return 0;
+
+            du = approx[j].u - check[j].u;
+            dv = approx[j].v - check[j].v;
+            /* a longitude error counts for its length on the ground */
+            if( inverse )
+                du *= cos(check[j].v);
+            if( !(du * du + dv * dv <= tol2) )
+                return 0;
+        }
+    }
+
+    return 1;
+}
+
+/************************************************************************/
+/*                        approx_check_shared()                         */
+/*                                                                      */
+/*      Is point i, j of the check grid of a tile taken from the        */
+/*      tile it is a quarter of?                                        */
+/************************************************************************/
+
+static int approx_check_shared( APPROX_TODO *todo, int i, int j )
+
+{
+    return todo->shared && (i % 2) == 0 && (j % 2) == 0;
+}
+
+/************************************************************************/
+/*                          approx_fit_nodes()                          */
+/*                                                                      */
+/*      The series of a tile from the exact values at its nodes, or     */
+/*      NULL if some could not be projected.                            */
+/************************************************************************/
+
+static Tseries *approx_fit_nodes( struct PJ_APPROX *A, APPROX_TODO *todo,
+                                  const projUV *samples, projUV **w )
+
+{
+    projUV resid;
+    int i, j;
+
+    for( i = 0; i < APPROX_ORDER; i++ )
+        for( j = 0; j < APPROX_ORDER; j++ )
+        {
+            w[i][j] = *samples++;
+            if( w[i][j].u == HUGE_VAL )
+                return NULL;
+        }
+
+    return mk_cheby_values( todo->tile->a, todo->tile->b, A->tol * 0.25,
+                            &resid, w, APPROX_ORDER, APPROX_ORDER, 0 );
+}
+
+/************************************************************************/
+/*                           approx_split()                             */
+/*                                                                      */
+/*      Split a tile that could not be fitted, if the limits allow,     */
+/*      adding its quarters to next, with the points of check, if       */
+/*      not NULL, they share with it.                                   */
+/************************************************************************/
+
+static void approx_split( struct PJ_APPROX *A, APPROX_TODO *todo,
+                          const projUV *check, APPROX_TODO *next,
+                          long *next_count )
+
+{
+    PJ_APPROX_TILE *tile = todo->tile;
+    projUV mid;
+    int i, j, q;
+
+    if( todo->depth >= APPROX_DEPTH || A->fits + 4 > APPROX_MAX_FITS )
+        return;
+    tile->child = (PJ_APPROX_TILE *) pj_malloc( 4 * sizeof(PJ_APPROX_TILE) );
+    if( tile->child == NULL )
+        return;
+    A->fits += 4;
+
+/* -------------------------------------------------------------------- */
+/*      Quarters are ordered by u then v, so that the point is in       */
+/*      child (u >= mid.u) + 2 * (v >= mid.v).                          */
+/* -------------------------------------------------------------------- */
+    mid.u = 0.5 * (tile->a.u + tile->b.u);
+    mid.v = 0.5 * (tile->a.v + tile->b.v);
+    for( q = 0; q < 4; q++ )
+    {
+        PJ_APPROX_TILE *child = tile->child + q;
+        APPROX_TODO *quarter = next + (*next_count)++;
+        int ou = (q & 1) ? APPROX_HALF : 0, ov = (q & 2) ? APPROX_HALF : 0;
+
+        child->a.u = (q & 1) ? mid.u : tile->a.u;
+        child->b.u = (q & 1) ? tile->b.u : mid.u;
+        child->a.v = (q & 2) ? mid.v : tile->a.v;
+        child->b.v = (q & 2) ? tile->b.v : mid.v;
+        child->T = NULL;
+        child->child = NULL;
+
+        quarter->tile = child;
+        quarter->depth = todo->depth + 1;
+        quarter->shared = check != NULL;
+        for( i = 0; check != NULL && i <= APPROX_HALF; i++ )
+            for( j = 0; j <= APPROX_HALF; j++ )
+                quarter->from_tile[i * (APPROX_HALF + 1) + j] =
+                    check[(i + ou) * APPROX_CHECK + j + ov];
+    }
+}
+
+/************************************************************************/
+/*                            approx_group()                            */
+/*                                                                      */
+/*      Fit a group of tiles of a level, evaluating the nodes of all    */
+/*      of them in one batch, then the check grids of those that        */
+/*      could be fitted in another.  points has room for the nodes      */
+/*      and check grids of the group, check for a check grid.           */
+/************************************************************************/
+
+static void approx_group( APPROX_FIT *fit, int inverse, APPROX_TODO *todo,
+                          int group, projUV *points, projUV *check,
+                          projUV **w, APPROX_TODO *next, long *next_count )
+
+{
+    struct PJ_APPROX *A = fit->A;
+    projUV *checks = points + group * APPROX_NODES;
+    long n = 0, used;
+    int g, i, j;
+
+    for( g = 0; g < group; g++ )
+    {
+        bchgen_nodes( todo[g].tile->a, todo[g].tile->b,
+                      APPROX_ORDER, APPROX_ORDER, w );
+        for( i = 0; i < APPROX_ORDER; i++ )
+            for( j = 0; j < APPROX_ORDER; j++ )
+                points[n++] = w[i][j];
+    }
+    approx_eval( fit, inverse, n, points );
+
+    for( n = 0, g = 0; g < group; g++ )
+    {
+        todo[g].T = approx_fit_nodes( A, todo + g,
+                                      points + g * APPROX_NODES, w );
+        if( todo[g].T == NULL || todo[g].T->mu < 0 || todo[g].T->mv < 0 )
+        {
+            approx_free_T( todo[g].T );
+            todo[g].T = NULL;
+            approx_split( A, todo + g, NULL, next, next_count );
+            continue;
+        }
+
+        for( i = 0; i < APPROX_CHECK; i++ )
+            for( j = 0; j < APPROX_CHECK; j++ )
+                if( !approx_check_shared( todo + g, i, j ) )
+                    checks[n++] = approx_check_in( todo[g].tile, i, j );
+    }
+    approx_eval( fit, inverse, n, checks );
+
+    for( used = 0, g = 0; g < group; g++ )
+    {
+        if( todo[g].T == NULL )
+            continue;
+
+        for( i = 0; i < APPROX_CHECK; i++ )
+            for( j = 0; j < APPROX_CHECK; j++ )
+                check[i * APPROX_CHECK + j] =
+                    approx_check_shared( todo + g, i, j )
+                    ? todo[g].from_tile[(i / 2) * (APPROX_HALF + 1) + j / 2]
+                    : checks[used++];
+
+        if( approx_check( A, inverse, todo[g].tile, todo[g].T, check ) )
+            todo[g].tile->T = todo[g].T;
+        else
+        {
+            approx_free_T( todo[g].T );
+            approx_split( A, todo + g, check, next, next_count );
+        }
+    }
+}
+
+/************************************************************************/
+/*                             approx_fit()                             */
+/*                                                                      */
+/*      Fit the quadtree of tiles under root, leaving those that        */
+/*      cannot be fitted to the exact projection.                       */
+/************************************************************************/
+
+static void approx_fit( APPROX_FIT *fit, int inverse, PJ_APPROX_TILE *root )
+
+{
+    struct PJ_APPROX *A = fit->A;
+    APPROX_TODO *todo, *next;
+    projUV *points, *check, **w;
+    long todo_count = 1, next_count, base;
+    int group;
+
+    todo = (APPROX_TODO *) pj_malloc( sizeof(APPROX_TODO) );
+    points = (projUV *) pj_malloc( sizeof(projUV) * APPROX_GROUP
+                                   * (APPROX_NODES + APPROX_CHECKS) );
+    check = (projUV *) pj_malloc( sizeof(projUV) * APPROX_CHECKS );
+    w = (projUV **) vector2( APPROX_ORDER, APPROX_ORDER, sizeof(projUV) );
+    if( todo == NULL || points == NULL || check == NULL || w == NULL )
+        todo_count = 0;
+    else
+    {
+        todo->tile = root;
+        todo->depth = 0;
+        todo->shared = 0;
+    }
+    A->fits = 1;
+
+    while( todo_count > 0 )
+    {
+        next = (APPROX_TODO *) pj_malloc( sizeof(APPROX_TODO)
+            * (4 * todo_count < APPROX_MAX_FITS
+               ? 4 * todo_count : APPROX_MAX_FITS) );
+        if( next == NULL )
+            break;
+        next_count = 0;
+
+        for( base = 0; base < todo_count; base += group )
+        {
+            group = todo_count - base < APPROX_GROUP
+                ? (int) (todo_count - base) : APPROX_GROUP;
+            approx_group( fit, inverse, todo + base, group, points,
+                          check, w, next, &next_count );
+        }
+
+        pj_dalloc( todo );
+        todo = next;
+        todo_count = next_count;
+    }
+
+    pj_dalloc( todo );
+    pj_dalloc( points );
+    pj_dalloc( check );
+    if( w != NULL )
+        freev2( (void **) w, APPROX_ORDER );
+}
+
+/************************************************************************/
+/*                            approx_find()                             */
+/************************************************************************/
+
+static Tseries *approx_find( PJ_APPROX_TILE *tile, projUV in )
+
+{
+    /* also false for nan, and empty for an inverse that was not fitted */
+    if( !(in.u >= tile->a.u && in.u <= tile->b.u
+          && in.v >= tile->a.v && in.v <= tile->b.v) )
+        return NULL;
+
+    while( tile->child != NULL )
+    {
+        projUV mid = tile->child[3].a;
+
+        tile = tile->child + (in.u >= mid.u) + 2 * (in.v >= mid.v);
+    }
+
+    return tile->T;
+}
+
+/************************************************************************/
+/*                      approx_fwd() / approx_inv()                     */
+/************************************************************************/
+
+static XY approx_fwd( LP lp, PJ *P )
+
+{
+    projUV in, out;
+    Tseries *T;
+    XY xy;
+
+    in.u = lp.lam;
+    in.v = lp.phi;
+    if( (T = approx_find( &P->approx->fwd_tiles, in )) == NULL )
+        return (*P->approx->fwd)( lp, P );
+
+    out = bcheval( in, T );
+    xy.x = out.u;
+    xy.y = out.v;
+    return xy;
+}
+
+static LP approx_inv( XY xy, PJ *P )
+
+{
+    projUV in, out;
+    Tseries *T;
+    LP lp;
+
+    in.u = xy.x;
+    in.v = xy.y;
+    if( (T = approx_find( &P->approx->inv_tiles, in )) == NULL )
+        return (*P->approx->inv)( xy, P );
+
+    out = bcheval( in, T );
+    lp.lam = out.u;
+    lp.phi = out.v;
+    return lp;
+}
+
+/************************************************************************/
+/*                            approx_array()                            */
+/*                                                                      */
+/*      P->fwd_n or P->inv_n, evaluating runs of points in the same     */
+/*      tile together.                                                  */
+/************************************************************************/
+
+static int approx_array( PJ *P, int inverse, long n, int stride,
+                         double *x, double *y )
+
+{
+    struct PJ_APPROX *A = P->approx;
+    PJ_APPROX_TILE *tiles = inverse ? &A->inv_tiles : &A->fwd_tiles;
+    projUV run[APPROX_RUN], in;
+    long run_index[APPROX_RUN], i;
+    Tseries *T, *run_T = NULL;
+    int count = 0, err = 0, k;
+
+    for( i = 0; i <= n; i++ )
+    {
+        long io = i * stride;
+
+        T = NULL;
+        if( i < n )
+        {
+            if( x[io] == HUGE_VAL )
+                continue;
+            in.u = x[io];
+            in.v = y[io];
+            T = approx_find( tiles, in );
+        }
+
+        if( count > 0 && (T != run_T || count == APPROX_RUN || i == n) )
+        {
+            bcheval_n( run, run, count, run_T );
+            for( k = 0; k < count; k++ )
+            {
+                x[run_index[k]] = run[k].u;
+                y[run_index[k]] = run[k].v;
+            }
+            count = 0;
+        }
+        if( i == n )
+            break;
+
+        if( T != NULL )
+        {
+            run_T = T;
+            run_index[count] = io;
+            run[count++] = in;
+            continue;
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Outside the tiles, as FORWARD_ARRAY and INVERSE_ARRAY do.       */
+/* -------------------------------------------------------------------- */
+        if( inverse )
+        {
+            XY xy;
+            LP lp;
+
+            xy.x = in.u;
+            xy.y = in.v;
+            lp = (*A->inv)( xy, P );
+            in.u = lp.lam;
+            in.v = lp.phi;
+        }
+        else
+        {
+            LP lp;
+            XY xy;
+
+            lp.lam = in.u;
+            lp.phi = in.v;
+            xy = (*A->fwd)( lp, P );
+            in.u = xy.x;
+            in.v = xy.y;
+        }
+        if( P->ctx->last_errno )
+        {
+            err = P->ctx->last_errno;
+            P->ctx->last_errno = 0;
+            in.u = in.v = HUGE_VAL;
+        }
+        x[io] = in.u;
+        y[io] = in.v;
+    }
+
+    return err;
+}
+
+static int approx_fwd_n( PJ *P, long n, int stride, double *x, double *y )
+
+{
+    return approx_array( P, 0, n, stride, x, y );
+}
+
+static int approx_inv_n( PJ *P, long n, int stride, double *x, double *y )
+
+{
+    return approx_array( P, 1, n, stride, x, y );
+}
+
+/************************************************************************/
+/*                        approx_start_workers()                        */
+/*                                                                      */
+/*      Set up the workers of the batches: P itself, and as many        */
+/*      clones as the context has other threads for.                    */
+/************************************************************************/
+
+static void approx_start_workers( APPROX_FIT *fit, struct PJ_APPROX *A,
+                                  PJ *P )
+
+{
+    projCtx ctx = P->ctx;
+    int count = ctx->threads > 1 ? ctx->threads : 1, k;
+
+    fit->A = A;
+    fit->workers = (APPROX_WORKER *) pj_malloc(sizeof(APPROX_WORKER) * count);
+    fit->worker_count = 0;
+    if( fit->workers == NULL )
+    {
+        fit->workers = &(fit->self);
+        count = 1;
+    }
+    memset( fit->workers, 0, sizeof(APPROX_WORKER) * count );
+
+    fit->workers[0].P = P;
+    fit->workers[0].fwd = A->fwd;
+    fit->workers[0].inv = A->inv;
+    for( k = 1; k < count; k++ )
+    {
+        APPROX_WORKER *worker = fit->workers + k;
+        projCtx worker_ctx = pj_ctx_alloc();
+
+        if( worker_ctx == NULL )
+            break;
+        memcpy( worker_ctx, ctx, sizeof(projCtx_t) );
+        worker_ctx->last_errno = 0;
+        worker_ctx->grid_tiles = NULL;
+        worker_ctx->grid_tile_count = 0;
+        worker_ctx->errno_globals = 0;
+        worker_ctx->threads = 1;
+        worker_ctx->stats = NULL;
+
+        worker->P = pj_clone_exact( worker_ctx, P );
+        if( worker->P == NULL )
+        {
+            pj_ctx_free( worker_ctx );
+            break;
+        }
+        worker->fwd = worker->P->fwd;
+        worker->inv = worker->P->inv;
+    }
+    fit->worker_count = k;
+}
+
+/************************************************************************/
+/*                        approx_stop_workers()                         */
+/************************************************************************/
+
+static void approx_stop_workers( APPROX_FIT *fit )
+
+{
+    int k;
+
+    for( k = 1; k < fit->worker_count; k++ )
+    {
+        projCtx worker_ctx = fit->workers[k].P->ctx;
+
+        pj_free( fit->workers[k].P );
+        pj_ctx_free( worker_ctx );
+    }
+    if( fit->workers != &(fit->self) )
+        pj_dalloc( fit->workers );
+}
+
+/************************************************************************/
+/*                          approx_cache_path()                         */
+/*                                                                      */
+/*      The file of the cache directory for a definition, named by      */
+/*      pj_hash_name().  Returns FALSE without a directory.             */
+/************************************************************************/
+
+static int approx_cache_path( const char *key, char *path )
+
+{
+    char name[17];
+    int ok;
+
+    pj_hash_name( key, name );
+
+    pj_acquire_lock();
+    ok = cache_dir != NULL && strlen(cache_dir) + 24 <= MAX_PATH_FILENAME;
+    if( ok )
+        sprintf( path, "%s%c%s.apx", cache_dir, DIR_CHAR, name );
+    pj_release_lock();
+
+    return ok;
+}
+
+/************************************************************************/
+/*                             approx_row()                             */
+/*                                                                      */
+/*      Row i of the coefficients of a series, the cu rows then the     */
+/*      cv rows.                                                        */
+/************************************************************************/
+
+static struct PW_COEF *approx_row( Tseries *T, int i )
+
+{
+    return i <= T->mu ? T->cu + i : T->cv + (i - T->mu - 1);
+}
+
+/************************************************************************/
+/*                         approx_write_tiles()                         */
+/*                                                                      */
+/*      Write a tile and those under it, in native byte order, which    */
+/*      the check value of the header catches.                          */
+/************************************************************************/
+
+static int approx_write_tiles( PJ_CACHE_FILE *f, PJ_APPROX_TILE *tile )
+
+{
+    Tseries *T = tile->T;
+    int kind, i;
+
+    kind = T != NULL ? APPROX_TILE_SERIES
+        : tile->child != NULL ? APPROX_TILE_SPLIT : APPROX_TILE_EXACT;
+    if( !pj_cache_file_put( f, &(tile->a), sizeof(projUV), 1 )
+        || !pj_cache_file_put( f, &(tile->b), sizeof(projUV), 1 )
+        || !pj_cache_file_put( f, &kind, sizeof(int), 1 ) )
+        return 0;
+
+    if( kind == APPROX_TILE_SPLIT )
+    {
+        for( i = 0; i < 4; i++ )
+            if( !approx_write_tiles( f, tile->child + i ) )
+                return 0;
+    }
+    else if( kind == APPROX_TILE_SERIES )
+    {
+        if( !pj_cache_file_put( f, &(T->a), sizeof(projUV), 1 )
+            || !pj_cache_file_put( f, &(T->b), sizeof(projUV), 1 )
+            || !pj_cache_file_put( f, &(T->mu), sizeof(int), 1 )
+            || !pj_cache_file_put( f, &(T->mv), sizeof(int), 1 )
+            || !pj_cache_file_put( f, &(T->power), sizeof(int), 1 ) )
+            return 0;
+        for( i = 0; i <= T->mu + T->mv + 1; i++ )
+        {
+            struct PW_COEF *row = approx_row( T, i );
+
+            if( !pj_cache_file_put( f, &(row->m), sizeof(int), 1 )
+                || (row->m > 0
+                    && !pj_cache_file_put( f, row->c, sizeof(double), row->m )) )
+                return 0;
+        }
+    }
+
+    return 1;
+}
+
+/************************************************************************/
+/*                         approx_read_tiles()                          */
+/*                                                                      */
+/*      Read what approx_write_tiles() wrote into tile, checking that   */
+/*      it is something approx_fit() could have built.                  */
+/************************************************************************/
+
+static int approx_read_tiles( PJ_CACHE_FILE *f, PJ_APPROX_TILE *tile,
+                              int depth )
+
+{
+    Tseries *T;
+    int kind, i;
+
+    tile->T = NULL;
+    tile->child = NULL;
+    if( !pj_cache_file_get( f, &(tile->a), sizeof(projUV), 1 )
+        || !pj_cache_file_get( f, &(tile->b), sizeof(projUV), 1 )
+        || !pj_cache_file_get( f, &kind, sizeof(int), 1 ) )
+        return 0;
+
+    if( kind == APPROX_TILE_SPLIT )
+    {
+        if( depth >= APPROX_DEPTH )
+            return 0;
+        tile->child = (PJ_APPROX_TILE *)
+            pj_malloc( 4 * sizeof(PJ_APPROX_TILE) );
+        if( tile->child == NULL )
+            return 0;
+        memset( tile->child, 0, 4 * sizeof(PJ_APPROX_TILE) );
+        for( i = 0; i < 4; i++ )
+            if( !approx_read_tiles( f, tile->child + i, depth + 1 ) )
+                return 0;
+        return 1;
+    }
+    if( kind != APPROX_TILE_SERIES )
+        return kind == APPROX_TILE_EXACT;
+
+    T = tile->T = (Tseries *) pj_malloc( sizeof(Tseries) );
+    if( T == NULL )
+        return 0;
+    memset( T, 0, sizeof(Tseries) );
+    T->mu = T->mv = -1;
+    if( !pj_cache_file_get( f, &(T->a), sizeof(projUV), 1 )
+        || !pj_cache_file_get( f, &(T->b), sizeof(projUV), 1 )
+        || !pj_cache_file_get( f, &(T->mu), sizeof(int), 1 )
+        || !pj_cache_file_get( f, &(T->mv), sizeof(int), 1 )
+        || !pj_cache_file_get( f, &(T->power), sizeof(int), 1 )
+        || T->mu < 0 || T->mu >= APPROX_ORDER
+        || T->mv < 0 || T->mv >= APPROX_ORDER )
+    {
+        T->mu = T->mv = -1;
+        return 0;
+    }
+
+    T->cu = (struct PW_COEF *) pj_malloc( sizeof(struct PW_COEF)
+                                          * (T->mu + 1) );
+    T->cv = (struct PW_COEF *) pj_malloc( sizeof(struct PW_COEF)
+                                          * (T->mv + 1) );
+    if( T->cu == NULL || T->cv == NULL )
+    {
+        pj_dalloc( T->cu );
+        pj_dalloc( T->cv );
+        T->cu = T->cv = NULL;
+        T->mu = T->mv = -1;
+        return 0;
+    }
+    memset( T->cu, 0, sizeof(struct PW_COEF) * (T->mu + 1) );
+    memset( T->cv, 0, sizeof(struct PW_COEF) * (T->mv + 1) );
+
+    for( i = 0; i <= T->mu + T->mv + 1; i++ )
+    {
+        struct PW_COEF *row = approx_row( T, i );
+        int m;
+
+        if( !pj_cache_file_get( f, &m, sizeof(int), 1 )
+            || m < 0 || m > APPROX_ORDER )
+            return 0;
+        if( m == 0 )
+            continue;
+        row->c = (double *) pj_malloc( sizeof(double) * m );
+        if( row->c == NULL
+            || !pj_cache_file_get( f, row->c, sizeof(double), m ) )
+            return 0;
+        row->m = m;
+    }
+
+    /* a failed packing only slows the _n evaluators */
+    pack_series( T );
+
+    return 1;
+}
+
+/************************************************************************/
+/*                          approx_cache_load()                         */
+/*                                                                      */
+/*      Load the tiles of the definition key from the cache, if they    */
+/*      are there.  Returns FALSE, with no tiles, otherwise.            */
+/************************************************************************/
+
+static int approx_cache_load( struct PJ_APPROX *A, const char *key )
+
+{
+    char path[MAX_PATH_FILENAME+1];
+    PJ_CACHE_FILE f;
+    int ok;
+
+    if( !approx_cache_path( key, path )
+        || !pj_cache_file_open( &f, path, APPROX_MAGIC, key ) )
+        return 0;
+
+    ok = approx_read_tiles( &f, &(A->fwd_tiles), 0 )
+        && approx_read_tiles( &f, &(A->inv_tiles), 0 );
+    ok = pj_cache_file_close( &f, ok );
+
+    if( !ok )
+    {
+        approx_free_tiles( &(A->fwd_tiles) );
+        approx_free_tiles( &(A->inv_tiles) );
+        memset( &(A->fwd_tiles), 0, sizeof(PJ_APPROX_TILE) );
+        memset( &(A->inv_tiles), 0, sizeof(PJ_APPROX_TILE) );
+    }
+
+    return ok;
+}
+
+/************************************************************************/
+/*                          approx_cache_save()                         */
+/*                                                                      */
+/*      Save the tiles fitted for the definition key in the cache.      */
+/*      They are written to a temporary file renamed into place, so     */
+/*      that other processes sharing the directory never read a         */
+/*      partial file.  Failures only cost fitting again next time.      */
+/************************************************************************/
+
+static void approx_cache_save( struct PJ_APPROX *A, const char *key )
+
+{
+    char path[MAX_PATH_FILENAME+1];
+    PJ_CACHE_FILE f;
+    int ok;
+
+    if( !approx_cache_path( key, path ) )
+        return;
+
+    ok = pj_cache_file_create( &f, path, A, APPROX_MAGIC, key )
+        && approx_write_tiles( &f, &(A->fwd_tiles) )
+        && approx_write_tiles( &f, &(A->inv_tiles) );
+    if( f.fp != NULL )
+        pj_cache_file_commit( &f, path, ok );
+}
+
+/************************************************************************/
+/*                         approx_read_region()                         */
+/*                                                                      */
+/*      Parse w,s,e,n into the lower left and upper right corners.      */
+/************************************************************************/
+
+static int approx_read_region( PJ *P, const char *s, projUV *a, projUV *b )
+
+{
+    double v[4];
+    char *next;
+    int i;
+
+    for( i = 0; i < 4; i++ )
+    {
+        v[i] = dmstor_ctx( P->ctx, s, &next );
+        if( v[i] == HUGE_VAL || next == s || *next != (i < 3 ? ',' : '\0') )
+            return 0;
+        s = next + 1;
+    }
+
+    a->u = v[0];
+    a->v = v[1];
+    b->u = v[2];
+    b->v = v[3];
+
+    return a->u < b->u && b->u - a->u <= TWOPI
+        && a->v < b->v && a->v >= -HALFPI && b->v <= HALFPI;
+}
+
+/************************************************************************/
+/*                         approx_fit_region()                          */
+/*                                                                      */
+/*      Fit the tiles of the forward projection over the region from    */
+/*      a to b, then those of the inverse.                              */
+/************************************************************************/
+
+static void approx_fit_region( PJ *P, struct PJ_APPROX *A,
+                               projUV a, projUV b )
+
+{
+    APPROX_FIT fit;
+    projUV *box;
+    int i, j, inv_points = 0;
+
+    A->fwd_tiles.a = a;
+    A->fwd_tiles.b = b;
+    approx_start_workers( &fit, A, P );
+    approx_fit( &fit, 0, &A->fwd_tiles );
+
+/* -------------------------------------------------------------------- */
+/*      The inverse is fitted over the bounding box of the region.      */
+/* -------------------------------------------------------------------- */
+    box = P->inv != NULL
+        ? (projUV *) pj_malloc( sizeof(projUV) * APPROX_CHECKS ) : NULL;
+    for( i = 0; box != NULL && i < APPROX_CHECK; i++ )
+    {
+        for( j = 0; j < APPROX_CHECK; j++ )
+        {
+            projUV *in = box + i * APPROX_CHECK + j;
+
+            in->u = a.u + (b.u - a.u) * i / (APPROX_CHECK - 1);
+            in->v = a.v + (b.v - a.v) * j / (APPROX_CHECK - 1);
+        }
+    }
+    if( box != NULL )
+        approx_eval( &fit, 0, APPROX_CHECKS, box );
+    for( i = 0; box != NULL && i < APPROX_CHECKS; i++ )
+    {
+        projUV out = box[i];
+
+        if( out.u == HUGE_VAL )
+            continue;
+        if( inv_points++ == 0 )
+        {
+            A->inv_tiles.a = A->inv_tiles.b = out;
+            continue;
+        }
+        A->inv_tiles.a.u = MIN(A->inv_tiles.a.u, out.u);
+        A->inv_tiles.a.v = MIN(A->inv_tiles.a.v, out.v);
+        A->inv_tiles.b.u = MAX(A->inv_tiles.b.u, out.u);
+        A->inv_tiles.b.v = MAX(A->inv_tiles.b.v, out.v);
+    }
+    pj_dalloc( box );
+    if( inv_points > 0 && A->inv_tiles.a.u < A->inv_tiles.b.u
+        && A->inv_tiles.a.v < A->inv_tiles.b.v )
+        approx_fit( &fit, 1, &A->inv_tiles );
+
+    approx_stop_workers( &fit );
+}
+
+/************************************************************************/
+/*                           pj_approx_init()                           */
+/*                                                                      */
+/*      Set up the approximation asked for by +approx, called by        */
+/*      pj_init() once the projection itself is set up.  Returns        */
+/*      non-zero, with the error set, for invalid parameters.           */
+/************************************************************************/
+
+int pj_approx_init( PJ *P )
+
+{
+    struct PJ_APPROX *A;
+    const char *s;
+    char *key = NULL, *def;
+    projUV a, b;
+    double tol = APPROX_TOL, width;
+
+    if( !pj_param(P->ctx, P->params, "tapprox").i )
+        return 0;
+
+    s = pj_param(P->ctx, P->params, "sapprox").s;
+    if( s == NULL || strcmp(s, "cheby") != 0 )
+        goto bad_param;
+    if( pj_param(P->ctx, P->params, "tapprox_tol").i )
+        tol = pj_param(P->ctx, P->params, "dapprox_tol").f;
+    else if( P->cold->accuracy > 0.0 )
+        tol = P->cold->accuracy;
+    if( !(tol > 0.0) )
+        goto bad_param;
+    s = pj_param(P->ctx, P->params, "sapprox_region").s;
+    if( s == NULL || !approx_read_region( P, s, &a, &b ) )
+        goto bad_param;
+
+/* -------------------------------------------------------------------- */
+/*      Take the region to what P->fwd is given by pj_fwd().            */
+/* -------------------------------------------------------------------- */
+    width = b.u - a.u;
+    a.u -= P->lam0;
+    if( !P->over )
+    {
+        a.u = adjlon( a.u );
+        if( a.u + width > PI + 1e-12 )  /* across the antimeridian of lon_0 */
+            goto bad_param;
+    }
+    b.u = a.u + width;
+    if( P->geoc )
+    {
+        a.v = atan(P->rone_es * tan(a.v));
+        b.v = atan(P->rone_es * tan(b.v));
+    }
+
+    A = (struct PJ_APPROX *) pj_malloc( sizeof(struct PJ_APPROX) );
+    if( A == NULL )
+    {
+        pj_ctx_set_errno( P->ctx, -38 );
+        return 1;
+    }
+    memset( A, 0, sizeof(struct PJ_APPROX) );
+    A->fwd = P->fwd;
+    A->inv = P->inv;
+    A->tol = tol / P->a;
+
+    /* equivalent definitions share the fit */
+    if( (def = pj_get_def( P, 0 )) != NULL )
+    {
+        key = pj_canonical_def( P->ctx, def );
+        pj_dalloc( def );
+    }
+    if( key == NULL || !approx_cache_load( A, key ) )
+    {
+        approx_fit_region( P, A, a, b );
+        if( key != NULL )
+            approx_cache_save( A, key );
+    }
+    pj_dalloc( key );
+
+/* -------------------------------------------------------------------- */
+/*      Points failing the exact projection while fitting leave         */
+/*      errors that are not those of pj_init().                         */
+/* -------------------------------------------------------------------- */
+    P->ctx->last_errno = 0;
+    errno = 0;
+
+    P->approx = A;
+    P->fwd = approx_fwd;
+    P->fwd_n = approx_fwd_n;
+    if( P->inv != NULL )
+    {
+        P->inv = approx_inv;
+        P->inv_n = approx_inv_n;
+    }
+
+    return 0;
+
+  bad_param:
+    pj_ctx_set_errno( P->ctx, -50 );
+    return 1;
+}
+
+/************************************************************************/
+/*                           pj_approx_free()                           */
+/************************************************************************/
+
+void pj_approx_free( PJ *P )
+
+{
+    if( P->approx == NULL )
+        return;
+
+    approx_free_tiles( &P->approx->fwd_tiles );
+    approx_free_tiles( &P->approx->inv_tiles );
+    pj_dalloc( P->approx );
+    P->approx = NULL;
+}
+
+/************************************************************************/
+/*                         pj_set_approx_cache()                        */
+/*                                                                      */
+/*      Keep the tiles fitted for +approx definitions in directory,     */
+/*      which must exist, to be loaded by later pj_init() calls of      */
+/*      this or other processes instead of fitting them again.  Call    */
+/*      with NULL to stop.                                              */
+/************************************************************************/
+
+void pj_set_approx_cache( const char *directory )
+
+{
+    char *dir = NULL;
+
+    if( directory != NULL )
+    {
+        dir = (char *) pj_malloc( strlen(directory) + 1 );
+        if( dir != NULL )
+            strcpy( dir, directory );
+    }
+
+    pj_acquire_lock();
+    pj_dalloc( cache_dir );
+    cache_dir = dir;
+    pj_release_lock();
+}
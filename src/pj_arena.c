@@ -0,0 +1,108 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Bump allocation of the objects set up with a projection, such
+ *           as its parameter list, freed all at once with it.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <projects.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** An arena is a chain of blocks, the most recent first, each handing out
+** its bytes in turn.  Nothing is freed on its own, so the objects of a
+** definition, set up together and used together, are next to each other
+** and cost a handful of allocations rather than one each.
+*/
+
+/* the parameter nodes of most definitions, their texts being shared */
+#define ARENA_BLOCK_MIN (16 * sizeof(paralist))
+
+/* the data follows the header, aligned for doubles */
+#define ARENA_HEADER \
+    ((sizeof(PJ_ARENA) + sizeof(double) - 1) / sizeof(double) * sizeof(double))
+
+/************************************************************************/
+/*                           pj_arena_alloc()                           */
+/*                                                                      */
+/*      Allocate size bytes from the arena, aligned for doubles,        */
+/*      starting a new block if the current one is full.  *arena may    */
+/*      be NULL for an arena without blocks yet.  Returns NULL if out   */
+/*      of memory.                                                      */
+/************************************************************************/
+
+void *pj_arena_alloc( PJ_ARENA **arena, size_t size )
+
+{
+    PJ_ARENA *block = *arena;
+    void     *result;
+
+    size = (size + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+
+    if( block == NULL || block->used + size > block->size )
+    {
+        size_t block_size = ARENA_BLOCK_MIN;
+
+        /* grow with each block, as they are freed only at the end */
+        if( block != NULL && 2 * block->size > block_size )
+            block_size = 2 * block->size;
+        if( block_size < size )
+            block_size = size;
+
+        block = (PJ_ARENA *) pj_malloc( ARENA_HEADER + block_size );
+        if( block == NULL )
+            return NULL;
+
+        block->next = *arena;
+        block->size = block_size;
+        block->used = 0;
+        *arena = block;
+    }
+
+    result = (char *) block + ARENA_HEADER + block->used;
+    block->used += size;
+
+    return result;
+}
+
+/************************************************************************/
+/*                           pj_arena_free()                            */
+/*                                                                      */
+/*      Free all the blocks of an arena, and so everything allocated   */
+/*      from it.                                                        */
+/************************************************************************/
+
+void pj_arena_free( PJ_ARENA *arena )
+
+{
+    while( arena != NULL )
+    {
+        PJ_ARENA *next = arena->next;
+
+        pj_dalloc( arena );
+        arena = next;
+    }
+}
@@ -0,0 +1,387 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Transformation of GeoArrow coordinates exchanged through the
+ *           Arrow C data interface, in place or into a new array.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#if defined(_MSC_VER) && _MSC_VER < 1600
+typedef __int64 int64_t;
+#else
+#include <stdint.h>
+#endif
+
+PJ_CVSID("$Id$");
+
+/*
+** The structures of the Arrow C data interface, as its specification has
+** users copy them, only defined if the application has not done so.
+**
+** A GeoArrow column is a point array under up to three levels of lists,
+** for linestrings, polygons and multipolygons.  The points are either a
+** struct of x, y and optional z and m double arrays, or a fixed size
+** list of 2 to 4 doubles named xy, xyz, xym or xyzm.  Only the doubles
+** of the points change: the lists are passed over, and all the points of
+** the child of a list are transformed, whatever its offsets refer to.
+*/
+
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+struct ArrowSchema {
+    const char *format;
+    const char *name;
+    const char *metadata;
+    int64_t    flags;
+    int64_t    n_children;
+    struct ArrowSchema **children;
+    struct ArrowSchema *dictionary;
+    void       (*release)(struct ArrowSchema *);
+    void       *private_data;
+};
+
+struct ArrowArray {
+    int64_t    length;
+    int64_t    null_count;
+    int64_t    offset;
+    int64_t    n_buffers;
+    int64_t    n_children;
+    const void **buffers;
+    struct ArrowArray **children;
+    struct ArrowArray *dictionary;
+    void       (*release)(struct ArrowArray *);
+    void       *private_data;
+};
+
+#endif /* ARROW_C_DATA_INTERFACE */
+
+#define ARROW_DOUBLE      0     /* g */
+#define ARROW_STRUCT      1     /* +s */
+#define ARROW_FIXED_LIST  2     /* +w:n */
+#define ARROW_LIST        3     /* +l */
+#define ARROW_LARGE_LIST  4     /* +L */
+
+#define ARROW_MAX_CHILDREN 4
+
+/* a copy of an array, with the buffers it owns, see pj_arrow_copy() */
+typedef struct {
+    const void *buffers[3];
+    void       *data[3];
+    struct ArrowArray *children[ARROW_MAX_CHILDREN];
+    struct ArrowArray child_arrays[ARROW_MAX_CHILDREN];
+} PJ_ARROW_NODE;
+
+/************************************************************************/
+/*                           pj_arrow_kind()                            */
+/*                                                                      */
+/*      The kind of arrays of a schema, with the size of fixed size     */
+/*      lists, or -1 for the kinds not in GeoArrow coordinates.         */
+/************************************************************************/
+
+static int pj_arrow_kind( const struct ArrowSchema *schema, int *size )
+
+{
+    const char *format = schema->format;
+
+    *size = 0;
+    if( strcmp( format, "g" ) == 0 )
+        return ARROW_DOUBLE;
+    if( strcmp( format, "+s" ) == 0 )
+        return ARROW_STRUCT;
+    if( strcmp( format, "+l" ) == 0 )
+        return ARROW_LIST;
+    if( strcmp( format, "+L" ) == 0 )
+        return ARROW_LARGE_LIST;
+    if( strncmp( format, "+w:", 3 ) == 0 )
+    {
+        *size = atoi( format + 3 );
+        return ARROW_FIXED_LIST;
+    }
+    return -1;
+}
+
+/************************************************************************/
+/*                          pj_arrow_values()                           */
+/*                                                                      */
+/*      The doubles of a double array, from its offset.                 */
+/************************************************************************/
+
+static double *pj_arrow_values( const struct ArrowSchema *schema,
+                                const struct ArrowArray *array )
+
+{
+    int size;
+
+    if( pj_arrow_kind( schema, &size ) != ARROW_DOUBLE
+        || array->n_buffers != 2 || array->buffers[1] == NULL )
+        return NULL;
+
+    return ((double *) array->buffers[1]) + array->offset;
+}
+
+/************************************************************************/
+/*                          pj_arrow_points()                           */
+/*                                                                      */
+/*      Describe the points of a GeoArrow column in coords.  Returns    */
+/*      their count, or -1 if the column is not of GeoArrow points.     */
+/************************************************************************/
+
+static long pj_arrow_points( const struct ArrowSchema *schema,
+                             const struct ArrowArray *array,
+                             projCoords *coords )
+
+{
+    int       kind, size, depth;
+
+    for( depth = 0; ; depth++ )
+    {
+        kind = pj_arrow_kind( schema, &size );
+        if( kind != ARROW_LIST && kind != ARROW_LARGE_LIST )
+            break;
+        if( depth == 3 || schema->n_children != 1
+            || array->n_children != 1 )
+            return -1;
+        schema = schema->children[0];
+        array = array->children[0];
+    }
+
+    memset( coords, 0, sizeof(projCoords) );
+    coords->type = PJ_COORD_DOUBLE;
+
+    if( kind == ARROW_STRUCT )
+    {
+        int  i, axis;
+
+        if( schema->n_children < 2 || schema->n_children > 4
+            || array->n_children != schema->n_children )
+            return -1;
+
+        for( i = 0; i < schema->n_children; i++ )
+        {
+            const char *name = schema->children[i]->name;
+            double *values = pj_arrow_values( schema->children[i],
+                                              array->children[i] );
+
+            if( values == NULL )
+                return -1;
+            values += array->offset;
+
+            /* by name, or else x, y, z and m in order */
+            axis = name != NULL && name[0] != '\0' && name[1] == '\0'
+                && strchr( "xyzm", name[0] ) != NULL ? name[0] : "xyzm"[i];
+            if( axis == 'x' )
+                coords->x = values;
+            else if( axis == 'y' )
+                coords->y = values;
+            else if( axis == 'z' )
+                coords->z = values;
+        }
+        if( coords->x == NULL || coords->y == NULL )
+            return -1;
+        coords->stride_x = coords->stride_y = coords->stride_z = 1;
+    }
+    else if( kind == ARROW_FIXED_LIST )
+    {
+        const char *name = schema->n_children == 1
+            ? schema->children[0]->name : NULL;
+        double    *values;
+
+        if( size < 2 || size > 4 || schema->n_children != 1
+            || array->n_children != 1 )
+            return -1;
+
+        values = pj_arrow_values( schema->children[0], array->children[0] );
+        if( values == NULL )
+            return -1;
+        values += array->offset * size;
+
+        coords->x = values;
+        coords->y = values + 1;
+        if( size == 4 || (size == 3
+                          && (name == NULL || strcmp( name, "xym" ) != 0)) )
+            coords->z = values + 2;
+        coords->stride_x = coords->stride_y = coords->stride_z = size;
+    }
+    else
+        return -1;
+
+    return (long) array->length;
+}
+
+/************************************************************************/
+/*                          pj_arrow_release()                          */
+/************************************************************************/
+
+static void pj_arrow_release( struct ArrowArray *array )
+
+{
+    PJ_ARROW_NODE *node = (PJ_ARROW_NODE *) array->private_data;
+    int       i;
+
+    /* children moved out by the consumer are released already */
+    for( i = 0; i < array->n_children; i++ )
+        if( node->child_arrays[i].release != NULL )
+            node->child_arrays[i].release( node->child_arrays + i );
+
+    for( i = 0; i < 3; i++ )
+        pj_dalloc( node->data[i] );
+    pj_dalloc( node );
+
+    array->release = NULL;
+}
+
+/************************************************************************/
+/*                           pj_arrow_copy()                            */
+/*                                                                      */
+/*      Copy an array of a GeoArrow column, with its buffers and        */
+/*      children, into out, which owns them and frees them by its       */
+/*      release callback.  Returns 0 if out of memory, out then being   */
+/*      released.                                                       */
+/************************************************************************/
+
+static int pj_arrow_copy( const struct ArrowSchema *schema,
+                          const struct ArrowArray *in,
+                          struct ArrowArray *out )
+
+{
+    PJ_ARROW_NODE *node;
+    int       kind, size, i;
+    size_t    sizes[3];
+    size_t    count = (size_t) (in->offset + in->length);
+
+    kind = pj_arrow_kind( schema, &size );
+    if( kind < 0 || in->n_buffers > 2 || in->n_children > ARROW_MAX_CHILDREN 
+        || in->n_children != schema->n_children || in->dictionary != NULL )
+        return 0;
+
+    sizes[0] = (count + 7) / 8;   /* validity */
+    sizes[1] = kind == ARROW_DOUBLE ? count * sizeof(double)
+        : kind == ARROW_LIST ? (count + 1) * 4
+        : kind == ARROW_LARGE_LIST ? (count + 1) * 8 : 0;
+    sizes[2] = 0;
+
+    node = (PJ_ARROW_NODE *) pj_malloc( sizeof(PJ_ARROW_NODE) );
+    if( node == NULL )
+        return 0;
+    memset( node, 0, sizeof(PJ_ARROW_NODE) );
+
+    memset( out, 0, sizeof(struct ArrowArray) );
+    out->length = in->length;
+    out->null_count = in->null_count;
+    out->offset = in->offset;
+    out->n_buffers = in->n_buffers;
+    out->n_children = in->n_children;
+    out->buffers = node->buffers;
+    out->children = node->children;
+    out->release = pj_arrow_release;
+    out->private_data = node;
+
+    for( i = 0; i < in->n_buffers; i++ )
+    {
+        if( in->buffers[i] == NULL || sizes[i] == 0 )
+            continue;
+        node->data[i] = pj_malloc( sizes[i] );
+        if( node->data[i] == NULL )
+        {
+            pj_arrow_release( out );
+            return 0;
+        }
+        memcpy( node->data[i], in->buffers[i], sizes[i] );
+        node->buffers[i] = node->data[i];
+    }
+
+    for( i = 0; i < in->n_children; i++ )
+    {
+        node->children[i] = node->child_arrays + i;
+        if( !pj_arrow_copy( schema->children[i], in->children[i],
+                            node->child_arrays + i ) )
+        {
+            pj_arrow_release( out );
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/************************************************************************/
+/*                  pj_transform_plan_execute_arrow()                   */
+/*                                                                      */
+/*      Transform the points of a GeoArrow column, as described by      */
+/*      schema, with pj_transform_plan_execute_coords().  With out      */
+/*      NULL the doubles of array are changed in place.  Otherwise      */
+/*      array is left as it is, and out gets a new array of the same    */
+/*      layout with the points transformed, to be freed by its          */
+/*      release callback.  The offsets and validity of the geometries   */
+/*      are kept as they are; m values are not changed.  Returns 0,     */
+/*      -53 for arrays other than GeoArrow points, lines or polygons    */
+/*      of doubles, ENOMEM, or the error of the transformation.         */
+/************************************************************************/
+
+int pj_transform_plan_execute_arrow( PJ_TRANSFORM_PLAN *plan,
+                                     const struct ArrowSchema *schema,
+                                     struct ArrowArray *array,
+                                     struct ArrowArray *out )
+
+{
+    projCtx   ctx = plan->srcdefn->ctx;
+    projCoords coords;
+    long      point_count;
+    int       err;
+
+    if( pj_arrow_points( schema, array, &coords ) < 0 )
+    {
+        pj_ctx_set_errno( ctx, -53 );
+        return -53;
+    }
+
+    if( out != NULL )
+    {
+        if( !pj_arrow_copy( schema, array, out ) )
+        {
+            pj_ctx_set_errno( ctx, ENOMEM );
+            return ENOMEM;
+        }
+        array = out;
+    }
+
+    point_count = pj_arrow_points( schema, array, &coords );
+    if( point_count == 0 )
+        return 0;
+
+    err = pj_transform_plan_execute_coords( plan, point_count, 
+                                            &coords, &coords );
+    if( err != 0 && out != NULL )
+        out->release( out );
+
+    return err;
+}
@@ -1,5 +1,6 @@
 /* determine latitude from authalic latitude */
 #include <projects.h>
+#include <pj_math.h>
 # define P00 .33333333333333333333 /*   1 /     3 */
 # define P01 .17222222222222222222 /*  31 /   180 */
 # define P02 .10257936507936507937 /* 517 /  5040 */
@@ -7,24 +8,34 @@
 # define P11 .06640211640211640212 /* 251 /  3780 */
 # define P20 .01677689594356261023 /* 761 / 45360 */
 #define APA_SIZE 3
-	double *
-pj_authset(double es) {
-	double t, *APA;
+	static void
+fill_apa(double es, double *APA) {
+	double t;
 
-	if ((APA = (double *)pj_malloc(APA_SIZE * sizeof(double))) != NULL) {
-		APA[0] = es * P00;
-		t = es * es;
-		APA[0] += t * P01;
-		APA[1] = t * P10;
-		t *= es;
-		APA[0] += t * P02;
-		APA[1] += t * P11;
-		APA[2] = t * P20;
-	}
-	return APA;
+	APA[0] = es * P00;
+	t = es * es;
+	APA[0] += t * P01;
+	APA[1] = t * P10;
+	t *= es;
+	APA[0] += t * P02;
+	APA[1] += t * P11;
+	APA[2] = t * P20;
+}
+	double * /* shared by the projections on the ellipsoid, which
+	            release it with pj_table_release() */
+pj_authset(double es) {
+	return pj_table_acquire(PJ_TABLE_APA, es, APA_SIZE, fill_apa);
 }
 	double
 pj_authlat(double beta, double *APA) {
-	double t = beta+beta;
-	return(beta + APA[0] * sin(t) + APA[1] * sin(t+t) + APA[2] * sin(t+t+t));
+	return pj_authlat_i(beta, APA);
+}
+	void /* pj_authlat() of n authalic latitudes, stride doubles apart, in
+	        place.  HUGE_VAL values are left as they are */
+pj_authlat_n(long n, int stride, double *beta, const double *APA) {
+	long i;
+
+	for (i = 0; i < n; ++i, beta += stride)
+		if (*beta != HUGE_VAL)
+			*beta = pj_authlat_i(*beta, APA);
 }
@@ -0,0 +1,396 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Canonical text of a definition, the key of the caches of
+ *           equivalent definitions.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <projects.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** Two definitions with the same canonical text set up the same
+** projection, so the caches may hand the parameters of one out for the
+** other.  Only rewrites known to keep the parameters pj_param() finds
+** are done, which more or less follow pj_init():
+**
+**  - white space and empty parameters are dropped, and so are the later
+**    parameters of a name, as pj_param() only finds the first one;
+**  - without +init=, whose parameters come after those of the
+**    definition and could not be told from them, +datum= is replaced by
+**    its ellipsoid and shift if neither is given, the defaults are
+**    added unless +no_defs is given, and +no_defs is then always given,
+**    and +units= and +vunits= are replaced by their +to_meter= and
+**    +vto_meter=, written as the numbers they are, and left out if they
+**    are the default;
+**  - the parameters are sorted.
+*/
+
+#define CANON_MAX_ARG 200  /* as pj_init_plus_ctx() */
+
+typedef struct {
+    char **items;         /* allocated */
+    int    count, alloc;
+} canon_list;
+
+/************************************************************************/
+/*                            canon_find()                              */
+/*                                                                      */
+/*      The index of the parameter named name, or -1.                   */
+/************************************************************************/
+
+static int canon_find( const canon_list *list, const char *name )
+
+{
+    size_t len = strcspn( name, "=" );
+    int i;
+
+    for( i = 0; i < list->count; i++ )
+        if( strncmp( list->items[i], name, len ) == 0
+            && (list->items[i][len] == '\0' || list->items[i][len] == '=') )
+            return i;
+    return -1;
+}
+
+/************************************************************************/
+/*                            canon_add()                               */
+/*                                                                      */
+/*      Add a copy of text, unless a parameter of the same name is      */
+/*      already there.  Returns FALSE if out of memory.                 */
+/************************************************************************/
+
+static int canon_add( canon_list *list, const char *text )
+
+{
+    if( *text == '\0' || canon_find( list, text ) >= 0 )
+        return 1;
+
+    if( list->count == list->alloc )
+    {
+        char **items;
+
+        list->alloc = list->alloc * 2 + 16;
+        items = (char **) pj_malloc( sizeof(char *) * list->alloc );
+        if( items == NULL )
+            return 0;
+        if( list->count > 0 )
+            memcpy( items, list->items, sizeof(char *) * list->count );
+        pj_dalloc( list->items );
+        list->items = items;
+    }
+
+    if( (list->items[list->count] = (char *) pj_malloc( strlen(text) + 1 ))
+        == NULL )
+        return 0;
+    strcpy( list->items[list->count++], text );
+
+    return 1;
+}
+
+/************************************************************************/
+/*                           canon_remove()                             */
+/************************************************************************/
+
+static void canon_remove( canon_list *list, int i )
+
+{
+    pj_dalloc( list->items[i] );
+    list->items[i] = list->items[--list->count];
+}
+
+/************************************************************************/
+/*                           canon_meters()                             */
+/*                                                                      */
+/*      The value of a +to_meter= text, as pj_init() reads it, "a/b"    */
+/*      being a ratio.                                                  */
+/************************************************************************/
+
+static double canon_meters( const char *text )
+
+{
+    char *end;
+    double value = pj_strtod( text, &end );
+
+    if( *end == '/' )
+        value /= pj_strtod( end + 1, NULL );
+    return value;
+}
+
+/************************************************************************/
+/*                           canon_set_meters()                         */
+/*                                                                      */
+/*      Replace the parameter of name by name=value, written as the     */
+/*      shortest text reading back as value, or leave it out if value   */
+/*      is the default.  Returns FALSE if out of memory.                */
+/************************************************************************/
+
+static int canon_set_meters( canon_list *list, const char *name,
+                             double value, double default_value )
+
+{
+    char text[64], *c;
+    int i = canon_find( list, name ), digits = 15;
+
+    if( i >= 0 )
+        canon_remove( list, i );
+    if( value == default_value )
+        return 1;
+
+    do {
+        sprintf( text, "%s=%.*g", name, digits, value );
+        for( c = text; *c; ++c ) /* in case of a decimal comma */
+            if( *c == ',' )
+                *c = '.';
+    } while( ++digits <= 17
+             && pj_atof( text + strlen(name) + 1 ) != value );
+
+    return canon_add( list, text );
+}
+
+/************************************************************************/
+/*                           canon_units()                              */
+/*                                                                      */
+/*      Replace units (or vunits) by to_meter (or vto_meter), as        */
+/*      pj_init() sets them up, unless the units are unknown.           */
+/*      Returns FALSE if out of memory.                                 */
+/************************************************************************/
+
+static int canon_units( canon_list *list, const char *units_name,
+                        const char *meter_name, double default_value,
+                        double *value )
+
+{
+    int i = canon_find( list, units_name ), m;
+
+    *value = default_value;
+    if( i >= 0 )
+    {
+        struct PJ_UNITS *units;
+
+        if( list->items[i][strlen(units_name)] != '='
+            || (units = pj_find_units( list->items[i]
+                                       + strlen(units_name) + 1 )) == NULL )
+            return 1;
+        *value = canon_meters( units->to_meter );
+        canon_remove( list, i );
+    }
+    else if( (m = canon_find( list, meter_name )) >= 0 )
+    {
+        const char *text = list->items[m] + strlen(meter_name);
+
+        *value = *text == '=' ? canon_meters( text + 1 ) : 0.0;
+    }
+
+    return canon_set_meters( list, meter_name, *value, default_value );
+}
+
+/************************************************************************/
+/*                          canon_defaults()                            */
+/*                                                                      */
+/*      Add the defaults of tag, as get_defaults() does.  Returns       */
+/*      FALSE if out of memory.                                         */
+/************************************************************************/
+
+static int canon_defaults( projCtx ctx, canon_list *list, const char *tag )
+
+{
+    paralist *defaults = pj_search_defaults( ctx, tag ), *item;
+    int ok = 1;
+
+    for( item = defaults; item != NULL && ok; item = item->next )
+    {
+        /* as add_opt(), no default ellipse for any earth model */
+        if( strncmp( item->param, "ellps=", 6 ) == 0
+            && (canon_find( list, "datum" ) >= 0
+                || canon_find( list, "ellps" ) >= 0
+                || canon_find( list, "a" ) >= 0
+                || canon_find( list, "b" ) >= 0
+                || canon_find( list, "rf" ) >= 0
+                || canon_find( list, "f" ) >= 0) )
+            continue;
+        ok = canon_add( list, item->param );
+    }
+    pj_free_paralist( defaults );
+
+    return ok;
+}
+
+/************************************************************************/
+/*                          canon_compare()                             */
+/************************************************************************/
+
+static int canon_compare( const void *a, const void *b )
+
+{
+    return strcmp( *(char * const *) a, *(char * const *) b );
+}
+
+/************************************************************************/
+/*                           canon_expand()                             */
+/*                                                                      */
+/*      The rewrites of a definition without +init=.  Returns FALSE     */
+/*      if out of memory.                                               */
+/************************************************************************/
+
+static int canon_expand( projCtx ctx, canon_list *list )
+
+{
+    int i, errno_saved = errno;
+    double to_meter, vto_meter;
+    const char *name;
+
+    /* +datum=, if pj_datum_set() would find what it adds missing */
+    if( (i = canon_find( list, "datum" )) >= 0
+        && list->items[i][5] == '='
+        && canon_find( list, "ellps" ) < 0
+        && canon_find( list, "towgs84" ) < 0
+        && canon_find( list, "nadgrids" ) < 0 )
+    {
+        struct PJ_DATUMS *datum = pj_find_datum( list->items[i] + 6 );
+
+        if( datum != NULL )
+        {
+            char entry[100];
+
+            canon_remove( list, i );
+            if( datum->ellipse_id && strlen(datum->ellipse_id) > 0 )
+            {
+                strcpy( entry, "ellps=" );
+                strncat( entry, datum->ellipse_id, 80 );
+                if( !canon_add( list, entry ) )
+                    return 0;
+            }
+            if( datum->defn && strlen(datum->defn) > 0
+                && !canon_add( list, datum->defn ) )
+                return 0;
+        }
+    }
+
+    /* the defaults, which are then all given */
+    if( canon_find( list, "no_defs" ) < 0 )
+    {
+        if( (i = canon_find( list, "proj" )) < 0
+            || list->items[i][4] != '=' )
+            return 1;
+        name = list->items[i] + 5;
+
+        if( !canon_defaults( ctx, list, "general" )
+            || !canon_defaults( ctx, list, name )
+            || !canon_add( list, "no_defs" ) )
+            return 0;
+
+        /* as get_defaults(), missing defaults files are no error */
+        errno = errno_saved;
+        ctx->last_errno = 0;
+    }
+
+    /* the units, to_meter first as it is the default of vto_meter */
+    return canon_units( list, "units", "to_meter", 1.0, &to_meter )
+        && canon_units( list, "vunits", "vto_meter", to_meter, &vto_meter );
+}
+
+/************************************************************************/
+/*                          pj_canonical_def()                          */
+/*                                                                      */
+/*      Return the canonical text of a "+proj=..." definition, the      */
+/*      same for equivalent definitions, as a string to be freed with   */
+/*      pj_dalloc().  The defaults files are read as for pj_init().     */
+/*      Returns NULL, setting the error of ctx, on failure.             */
+/************************************************************************/
+
+char *pj_canonical_def( projCtx ctx, const char *definition )
+
+{
+    char *argv[CANON_MAX_ARG], *defn_copy, *result = NULL;
+    canon_list list;
+    int argc, i, ok = 1;
+    size_t size = 1;
+
+    if( ctx == NULL )
+        ctx = pj_get_default_ctx();
+
+    if( definition == NULL )
+    {
+        pj_ctx_set_errno( ctx, -1 );
+        return NULL;
+    }
+
+    if( (defn_copy = (char *) pj_malloc( strlen(definition) + 1 )) == NULL )
+    {
+        pj_ctx_set_errno( ctx, ENOMEM );
+        return NULL;
+    }
+    strcpy( defn_copy, definition );
+
+    if( (argc = pj_split_definition( defn_copy, argv, CANON_MAX_ARG )) < 0 )
+    {
+        pj_dalloc( defn_copy );
+        pj_ctx_set_errno( ctx, -44 );
+        return NULL;
+    }
+
+    memset( &list, 0, sizeof(list) );
+    for( i = 0; i < argc && ok; i++ )
+        ok = canon_add( &list, argv[i] );
+    pj_dalloc( defn_copy );
+
+    if( ok && canon_find( &list, "init" ) < 0 )
+        ok = canon_expand( ctx, &list );
+
+    if( ok )
+    {
+        qsort( list.items, list.count, sizeof(char *), canon_compare );
+
+        for( i = 0; i < list.count; i++ )
+            size += strlen( list.items[i] ) + 2;
+        if( (result = (char *) pj_malloc( size )) != NULL )
+        {
+            char *out = result;
+
+            for( i = 0; i < list.count; i++ )
+            {
+                if( i > 0 )
+                    *out++ = ' ';
+                *out++ = '+';
+                strcpy( out, list.items[i] );
+                out += strlen( out );
+            }
+            *out = '\0';
+        }
+    }
+
+    for( i = 0; i < list.count; i++ )
+        pj_dalloc( list.items[i] );
+    pj_dalloc( list.items );
+
+    if( result == NULL )
+        pj_ctx_set_errno( ctx, ENOMEM );
+
+    return result;
+}
@@ -0,0 +1,212 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Instruction sets of the processor, and the choice of the
+ *           variants of kernels built for them.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <projects.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(PJ_ISA_VARIANTS_X86)
+#  include <cpuid.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  include <intrin.h>
+#  define PJ_CPUID_MSC
+#endif
+
+PJ_CVSID("$Id$");
+
+/*
+** Distributions ship one build for every processor of an architecture,
+** so kernels gaining from a later instruction set come in variants, the
+** generic one built for the baseline of the build, and the others in the
+** same file with the PJ_TARGET_* attributes.  The instruction set of the
+** processor is found once, and pj_isa_select() picks for a context the
+** best variant the processor runs, unless pj_ctx_set_isa() holds the
+** context to an earlier set.  Every variant gives the same results as
+** the generic one: the attributes do not enable fused multiply-adds,
+** so the compiler may only reorder the lanes of the same operations.
+*/
+
+static volatile long cpu_once = 0;
+static int cpu_isa = PJ_ISA_GENERIC;
+
+/************************************************************************/
+/*                            pj_xcr0()                                 */
+/*                                                                      */
+/*      The low word of the register telling which vector registers     */
+/*      the system saves, read by the instruction itself for the        */
+/*      assemblers that do not know xgetbv.                             */
+/************************************************************************/
+
+#if defined(PJ_ISA_VARIANTS_X86)
+static unsigned int pj_xcr0( void )
+
+{
+    unsigned int lo, hi;
+
+    __asm__ __volatile__( ".byte 0x0f, 0x01, 0xd0" 
+                          : "=a" (lo), "=d" (hi) : "c" (0) );
+    return lo;
+}
+#endif
+
+/************************************************************************/
+/*                           pj_cpu_setup()                             */
+/************************************************************************/
+
+static void pj_cpu_setup( void )
+
+{
+#if defined(PJ_ISA_VARIANTS_X86) || defined(PJ_CPUID_MSC)
+    unsigned int regs[4], ebx7 = 0, xcr0 = 0;
+    int max_leaf;
+
+#  if defined(PJ_ISA_VARIANTS_X86)
+    __cpuid( 0, regs[0], regs[1], regs[2], regs[3] );
+    max_leaf = (int) regs[0];
+    __cpuid( 1, regs[0], regs[1], regs[2], regs[3] );
+    if( (regs[2] & (1U << 27)) != 0 )   /* osxsave */
+        xcr0 = pj_xcr0();
+    if( max_leaf >= 7 )
+    {
+        unsigned int leaf7[4];
+
+        __cpuid_count( 7, 0, leaf7[0], leaf7[1], leaf7[2], leaf7[3] );
+        ebx7 = leaf7[1];
+    }
+#  else
+    int info[4];
+
+    __cpuid( info, 0 );
+    max_leaf = info[0];
+    __cpuid( info, 1 );
+    memcpy( regs, info, sizeof(regs) );
+    if( (regs[2] & (1U << 27)) != 0 )
+        xcr0 = (unsigned int) _xgetbv( 0 );
+    if( max_leaf >= 7 )
+    {
+        __cpuidex( info, 7, 0 );
+        ebx7 = (unsigned int) info[1];
+    }
+#  endif
+
+    if( (regs[3] & (1U << 26)) != 0 )
+        cpu_isa = PJ_ISA_SSE2;
+
+    /* avx2, with the ymm registers saved by the system */
+    if( cpu_isa == PJ_ISA_SSE2 && (regs[2] & (1U << 28)) != 0 
+        && (xcr0 & 0x6) == 0x6 && (ebx7 & (1U << 5)) != 0 )
+        cpu_isa = PJ_ISA_AVX2;
+
+    /* avx512f, bw and vl, with the zmm and mask registers saved */
+    if( cpu_isa == PJ_ISA_AVX2 && (xcr0 & 0xe6) == 0xe6
+        && (ebx7 & (1U << 16)) != 0 && (ebx7 & (1U << 30)) != 0
+        && (ebx7 & (1U << 31)) != 0 )
+        cpu_isa = PJ_ISA_AVX512;
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    /* only where the build already requires it */
+    cpu_isa = PJ_ISA_NEON;
+#endif
+}
+
+/************************************************************************/
+/*                            pj_cpu_isa()                              */
+/*                                                                      */
+/*      The best instruction set of the processor with a PJ_ISA_*       */
+/*      level, found on the first call.                                 */
+/************************************************************************/
+
+int pj_cpu_isa( void )
+
+{
+    pj_once( &cpu_once, pj_cpu_setup );
+
+    return cpu_isa;
+}
+
+/************************************************************************/
+/*                            pj_isa_name()                             */
+/*                                                                      */
+/*      The name of a PJ_ISA_* level, as PROJ_ISA takes it.             */
+/************************************************************************/
+
+static const char * const isa_names[] = 
+    { "generic", "sse2", "avx2", "avx512", "neon" };
+
+const char *pj_isa_name( int isa )
+
+{
+    if( isa < PJ_ISA_GENERIC || isa > PJ_ISA_NEON )
+        return "unknown";
+
+    return isa_names[isa];
+}
+
+/************************************************************************/
+/*                           pj_isa_by_name()                           */
+/*                                                                      */
+/*      The level of a name of pj_isa_name(), or -1.                    */
+/************************************************************************/
+
+int pj_isa_by_name( const char *name )
+
+{
+    int isa;
+
+    for( isa = PJ_ISA_GENERIC; isa <= PJ_ISA_NEON; isa++ )
+        if( strcmp( name, isa_names[isa] ) == 0 )
+            return isa;
+
+    return -1;
+}
+
+/************************************************************************/
+/*                            pj_isa_select()                           */
+/*                                                                      */
+/*      The first of the count variants of a kernel, listed from the    */
+/*      latest instruction set to the generic one, that the context     */
+/*      runs, see pj_ctx_get_isa().  As variants are only built for     */
+/*      the architecture of the build, their levels can be compared.    */
+/*      The last variant is taken if none other is.                     */
+/************************************************************************/
+
+PJ_ISA_FN pj_isa_select( projCtx ctx, const PJ_ISA_VARIANT *variants, 
+                         int count )
+
+{
+    int isa = pj_ctx_get_isa( ctx ), i;
+
+    for( i = 0; i < count - 1; i++ )
+    {
+        if( variants[i].isa <= isa )
+            break;
+    }
+
+    return variants[i].fn;
+}
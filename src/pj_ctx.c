@@ -33,7 +33,7 @@
 PJ_CVSID("$Id$");
 
 static projCtx_t default_context;
-static volatile int       default_context_initialized = 0;
+static volatile long      default_context_once = 0;
 
 /************************************************************************/
 /*                             pj_get_ctx()                             */
@@ -58,37 +58,120 @@ void pj_set_ctx( projPJ pj, projCtx ctx )
 }
 
 /************************************************************************/
-/*                         pj_get_default_ctx()                         */
+/*                        pj_init_default_ctx()                         */
 /************************************************************************/
 
-projCtx pj_get_default_ctx()
+static void pj_init_default_ctx( void )
 
 {
-    pj_acquire_lock();
+    default_context.last_errno = 0;
+    default_context.debug_level = PJ_LOG_NONE;
+    default_context.logger = pj_stderr_logger;
+    default_context.record_logger = NULL;
+    memset( default_context.log_site_count, 0, 
+            sizeof(default_context.log_site_count) );
+    default_context.app_data = NULL;
+    default_context.fileapi = pj_get_default_fileapi();
+    default_context.filemapapi = pj_get_default_filemapapi();
+    default_context.fileapi_ex = pj_get_default_fileapi_ex();
+    default_context.grid_tiles = NULL;
+    default_context.grid_tile_count = 0;
+    default_context.grid_tile_limit = PJ_GRID_TILE_DEFAULT_LIMIT;
+    default_context.grid_registry = NULL;
+    default_context.errno_globals = 1;
+    default_context.inverse_grids = 0;
+    default_context.stats = NULL;
+    default_context.threads = 1;
+    default_context.grid_sort_threshold = PJ_GRID_SORT_DEFAULT_THRESHOLD;
+    default_context.batch_grain = PJ_BATCH_DEFAULT_GRAIN;
+    default_context.batch_min_split = PJ_BATCH_DEFAULT_MIN_SPLIT;
+    default_context.array_chunk = PJ_ARRAY_DEFAULT_CHUNK;
+    default_context.allocator.alloc = NULL;
+    default_context.allocator.dalloc = NULL;
+    default_context.allocator.user_data = NULL;
+    default_context.grid_huge_pages = PJ_HUGE_PAGES_NONE;
+    default_context.grid_row_pairs = 0;
+    default_context.grid_quantize = 0.0;
+    default_context.grid_shm = 0;
+    default_context.init_shm = 0;
+    default_context.grid_nonblocking = 0;
+    default_context.low_memory = 0;
+    default_context.isa_limit = PJ_ISA_BEST;
 
-    if( !default_context_initialized )
+    if( getenv("PROJ_DEBUG") != NULL )
     {
-        default_context.last_errno = 0;
-        default_context.debug_level = PJ_LOG_NONE;
-        default_context.logger = pj_stderr_logger;
-        default_context.app_data = NULL;
-        default_context.fileapi = pj_get_default_fileapi();
-
-        if( getenv("PROJ_DEBUG") != NULL )
-        {
-            if( atoi(getenv("PROJ_DEBUG")) > 0 )
-                default_context.debug_level = atoi(getenv("PROJ_DEBUG"));
-            else
-                default_context.debug_level = PJ_LOG_DEBUG_MINOR;
-        }
-        default_context_initialized = 1;
+        if( atoi(getenv("PROJ_DEBUG")) > 0 )
+            default_context.debug_level = atoi(getenv("PROJ_DEBUG"));
+        else
+            default_context.debug_level = PJ_LOG_DEBUG_MINOR;
     }
 
-    pj_release_lock();
+    if( getenv("PROJ_NETWORK") != NULL
+        && strcmp(getenv("PROJ_NETWORK"),"ON") == 0 )
+        pj_ctx_set_network( &default_context, 1 );
+    if( getenv("PROJ_GRID_SHM") != NULL
+        && strcmp(getenv("PROJ_GRID_SHM"),"ON") == 0 )
+        pj_ctx_set_grid_shm( &default_context, 1 );
+    if( getenv("PROJ_INIT_SHM") != NULL
+        && strcmp(getenv("PROJ_INIT_SHM"),"ON") == 0 )
+        pj_ctx_set_init_shm( &default_context, 1 );
+    if( getenv("PROJ_GRID_NONBLOCKING") != NULL
+        && strcmp(getenv("PROJ_GRID_NONBLOCKING"),"ON") == 0 )
+        pj_ctx_set_grid_nonblocking( &default_context, 1 );
+    if( getenv("PROJ_LOW_MEMORY") != NULL
+        && strcmp(getenv("PROJ_LOW_MEMORY"),"ON") == 0 )
+        pj_ctx_set_low_memory( &default_context, 1 );
+    if( getenv("PROJ_ISA") != NULL && pj_isa_by_name(getenv("PROJ_ISA")) >= 0 )
+        pj_ctx_set_isa( &default_context, pj_isa_by_name(getenv("PROJ_ISA")) );
+    if( getenv("PROJ_TUNE_FILE") != NULL )
+        pj_ctx_load_tuning( &default_context, getenv("PROJ_TUNE_FILE") );
+    if( getenv("PROJ_NETWORK_CACHE") != NULL )
+        pj_set_network_cache( getenv("PROJ_NETWORK_CACHE"),
+                              PJ_NETWORK_CACHE_DEFAULT_MB );
+    if( getenv("PROJ_APPROX_CACHE") != NULL )
+        pj_set_approx_cache( getenv("PROJ_APPROX_CACHE") );
+    if( getenv("PROJ_GRID_MEMORY_LIMIT") != NULL
+        && atof(getenv("PROJ_GRID_MEMORY_LIMIT")) > 0 )
+        pj_set_grid_memory_limit(
+            (size_t) atof(getenv("PROJ_GRID_MEMORY_LIMIT")) );
+    if( getenv("PROJ_INITCACHE_MEMORY_LIMIT") != NULL
+        && atof(getenv("PROJ_INITCACHE_MEMORY_LIMIT")) > 0 )
+        pj_set_initcache_memory_limit(
+            (size_t) atof(getenv("PROJ_INITCACHE_MEMORY_LIMIT")) );
+}
+
+/************************************************************************/
+/*                         pj_get_default_ctx()                         */
+/*                                                                      */
+/*      Initialized on the first call, after which this takes no        */
+/*      lock.                                                           */
+/************************************************************************/
+
+projCtx pj_get_default_ctx()
+
+{
+    pj_once( &default_context_once, pj_init_default_ctx );
 
     return &default_context;
 }
 
+/************************************************************************/
+/*                            pj_ctx_copy()                             */
+/*                                                                      */
+/*      Set up ctx with the settings of model, and none of its state.   */
+/************************************************************************/
+
+static void pj_ctx_copy( projCtx ctx, projCtx model )
+
+{
+    memcpy( ctx, model, sizeof(projCtx_t) );
+    ctx->last_errno = 0;
+    ctx->grid_tiles = NULL;
+    ctx->grid_tile_count = 0;
+    ctx->stats = NULL;
+    memset( ctx->log_site_count, 0, sizeof(ctx->log_site_count) );
+}
+
 /************************************************************************/
 /*                            pj_ctx_alloc()                            */
 /************************************************************************/
@@ -97,8 +180,7 @@ projCtx pj_ctx_alloc()
 
 {
     projCtx ctx = (projCtx_t *) malloc(sizeof(projCtx_t));
-    memcpy( ctx, pj_get_default_ctx(), sizeof(projCtx_t) );
-    ctx->last_errno = 0;
+    pj_ctx_copy( ctx, pj_get_default_ctx() );
 
     return ctx;
 }
@@ -110,9 +192,163 @@ projCtx pj_ctx_alloc()
 void pj_ctx_free( projCtx ctx )
 
 {
+    pj_grid_tiles_free( ctx, NULL );
+    pj_dalloc( ctx->stats );
     free( ctx );
 }
 
+/*
+** A context pool hands out contexts set up as its model was when the
+** pool was made, so that short lived users, such as the handlers of
+** requests, need not allocate and configure one each time.  Released
+** contexts get the settings of the model back, but keep their grid
+** tiles, which are often wanted again by the next user.
+*/
+
+typedef struct
+{
+    projCtx_t   model;
+    void       *lock;
+    projCtx    *idle;
+    int         idle_count;
+    int         max_idle;
+} PJ_CTX_POOL;
+
+/************************************************************************/
+/*                         pj_ctx_pool_alloc()                          */
+/*                                                                      */
+/*      Make a pool of contexts like model, which may be NULL for the   */
+/*      default context.  Up to max_idle released contexts are kept     */
+/*      for reuse, the others are freed.                                */
+/************************************************************************/
+
+projCtxPool pj_ctx_pool_alloc( projCtx model, int max_idle )
+
+{
+    PJ_CTX_POOL *pool;
+
+    if( max_idle < 0 )
+        max_idle = 0;
+
+    pool = (PJ_CTX_POOL *) pj_malloc( sizeof(PJ_CTX_POOL) );
+    if( pool == NULL )
+        return NULL;
+
+    pool->idle = (projCtx *) pj_malloc( sizeof(projCtx) * (max_idle + 1) );
+    pool->lock = pj_mutex_create( PJ_LOCK_CTX_POOL );
+    if( pool->idle == NULL || pool->lock == NULL )
+    {
+        pj_dalloc( pool->idle );
+        pj_mutex_destroy( pool->lock );
+        pj_dalloc( pool );
+        return NULL;
+    }
+
+    pj_ctx_copy( &(pool->model), 
+                 model != NULL ? model : pj_get_default_ctx() );
+    pool->idle_count = 0;
+    pool->max_idle = max_idle;
+
+    return (projCtxPool) pool;
+}
+
+/************************************************************************/
+/*                        pj_ctx_pool_acquire()                         */
+/*                                                                      */
+/*      Take an idle context of the pool, or allocate one.  It is       */
+/*      used by one thread at a time as any context, and is given       */
+/*      back with pj_ctx_pool_release().                                */
+/************************************************************************/
+
+projCtx pj_ctx_pool_acquire( projCtxPool pool_handle )
+
+{
+    PJ_CTX_POOL *pool = (PJ_CTX_POOL *) pool_handle;
+    projCtx ctx = NULL;
+
+    pj_mutex_lock( pool->lock );
+    if( pool->idle_count > 0 )
+        ctx = pool->idle[--pool->idle_count];
+    pj_mutex_unlock( pool->lock );
+
+    if( ctx == NULL )
+    {
+        ctx = (projCtx) malloc( sizeof(projCtx_t) );
+        if( ctx != NULL )
+            pj_ctx_copy( ctx, &(pool->model) );
+    }
+
+    return ctx;
+}
+
+/************************************************************************/
+/*                        pj_ctx_pool_release()                         */
+/*                                                                      */
+/*      Give back a context of pj_ctx_pool_acquire().  Its settings     */
+/*      are reset to those of the model, and its instrumentation is     */
+/*      dropped.  Grid tiles are kept unless the allocator or the       */
+/*      tile limit of the model would not do for them.                  */
+/************************************************************************/
+
+void pj_ctx_pool_release( projCtxPool pool_handle, projCtx ctx )
+
+{
+    PJ_CTX_POOL *pool = (PJ_CTX_POOL *) pool_handle;
+    struct PJ_GRID_TILE_t *tiles;
+    int tile_count;
+
+    if( ctx == NULL )
+        return;
+
+    if( ctx->allocator.alloc != pool->model.allocator.alloc
+        || ctx->allocator.dalloc != pool->model.allocator.dalloc
+        || ctx->allocator.user_data != pool->model.allocator.user_data
+        || ctx->grid_tile_count > pool->model.grid_tile_limit )
+        pj_grid_tiles_free( ctx, NULL );
+    pj_ctx_set_stats( ctx, 0 );
+
+    tiles = ctx->grid_tiles;
+    tile_count = ctx->grid_tile_count;
+    pj_ctx_copy( ctx, &(pool->model) );
+    ctx->grid_tiles = tiles;
+    ctx->grid_tile_count = tile_count;
+
+    pj_mutex_lock( pool->lock );
+    if( pool->idle_count < pool->max_idle )
+    {
+        pool->idle[pool->idle_count++] = ctx;
+        ctx = NULL;
+    }
+    pj_mutex_unlock( pool->lock );
+
+    if( ctx != NULL )
+        pj_ctx_free( ctx );
+}
+
+/************************************************************************/
+/*                          pj_ctx_pool_free()                          */
+/*                                                                      */
+/*      Free the pool and its idle contexts.  All the contexts          */
+/*      acquired must have been released.                               */
+/************************************************************************/
+
+void pj_ctx_pool_free( projCtxPool pool_handle )
+
+{
+    PJ_CTX_POOL *pool = (PJ_CTX_POOL *) pool_handle;
+    int i;
+
+    if( pool == NULL )
+        return;
+
+    for( i = 0; i < pool->idle_count; i++ )
+        pj_ctx_free( pool->idle[i] );
+
+    pj_mutex_destroy( pool->lock );
+    pj_dalloc( pool->idle );
+    pj_dalloc( pool );
+}
+
 /************************************************************************/
 /*                          pj_ctx_get_errno()                          */
 /************************************************************************/
@@ -126,17 +362,45 @@ int pj_ctx_get_errno( projCtx ctx )
 /************************************************************************/
 /*                          pj_ctx_set_errno()                          */
 /*                                                                      */
-/*      Also sets the global errno.                                     */
+/*      Also sets the global errno, unless the context was told not     */
+/*      to with pj_ctx_set_errno_globals().                             */
 /************************************************************************/
 
 void pj_ctx_set_errno( projCtx ctx, int new_errno )
 
 {
     ctx->last_errno = new_errno;
-    if( new_errno != 0 )
+    if( new_errno != 0 && ctx->errno_globals )
         pj_errno = new_errno;
 }
 
+/************************************************************************/
+/*                      pj_ctx_set_errno_globals()                      */
+/*                                                                      */
+/*      Whether errors of the context are also reported in the          */
+/*      global pj_errno, and pj_fwd() and pj_inv() reset pj_errno       */
+/*      and errno on each call.  This is on by default for existing     */
+/*      applications.  Threaded applications should turn it off, and    */
+/*      use pj_ctx_get_errno() instead, so that per point calls only    */
+/*      touch the context.                                              */
+/************************************************************************/
+
+void pj_ctx_set_errno_globals( projCtx ctx, int enable )
+
+{
+    ctx->errno_globals = enable;
+}
+
+/************************************************************************/
+/*                      pj_ctx_get_errno_globals()                      */
+/************************************************************************/
+
+int pj_ctx_get_errno_globals( projCtx ctx )
+
+{
+    return ctx->errno_globals;
+}
+
 /************************************************************************/
 /*                          pj_ctx_set_debug()                          */
 /************************************************************************/
@@ -157,6 +421,20 @@ void pj_ctx_set_logger( projCtx ctx, void (*new_logger)(void*,int,const char*) )
     ctx->logger = new_logger;
 }
 
+/************************************************************************/
+/*                      pj_ctx_set_record_logger()                      */
+/*                                                                      */
+/*      Messages go to this logger instead of the plain one when it     */
+/*      is set, with the grid, point and error they are about.          */
+/************************************************************************/
+
+void pj_ctx_set_record_logger( projCtx ctx, 
+                               void (*new_logger)(void*,const projLogRecord*) )
+
+{
+    ctx->record_logger = new_logger;
+}
+
 /************************************************************************/
 /*                        pj_ctx_set_app_data()                         */
 /************************************************************************/
@@ -177,14 +455,521 @@ void *pj_ctx_get_app_data( projCtx ctx )
     return ctx->app_data;
 }
 
+/************************************************************************/
+/*                     pj_ctx_set_grid_tile_limit()                     */
+/*                                                                      */
+/*      Set how many tiles of large grids may be resident in the        */
+/*      context at once.  Zero or less loads whole grids instead.       */
+/************************************************************************/
+
+void pj_ctx_set_grid_tile_limit( projCtx ctx, int max_tiles )
+
+{
+    ctx->grid_tile_limit = max_tiles;
+    pj_grid_tiles_free( ctx, NULL );
+}
+
+/************************************************************************/
+/*                     pj_ctx_get_grid_tile_limit()                     */
+/************************************************************************/
+
+int pj_ctx_get_grid_tile_limit( projCtx ctx )
+
+{
+    return ctx->grid_tile_limit;
+}
+
+/************************************************************************/
+/*                      pj_ctx_set_inverse_grids()                      */
+/*                                                                      */
+/*      Whether grids applied in reverse should get a table of the      */
+/*      inverse shift, built with the first such use, so that each      */
+/*      point needs a single interpolation instead of an iteration.     */
+/*      This costs the memory of a second copy of each grid, and the    */
+/*      interpolated inverse strays from the iterated one by up to a    */
+/*      few centimetres where the shifts vary quickly.  Grids read a    */
+/*      tile at a time are always iterated.                             */
+/************************************************************************/
+
+void pj_ctx_set_inverse_grids( projCtx ctx, int enable )
+
+{
+    ctx->inverse_grids = enable;
+}
+
+/************************************************************************/
+/*                      pj_ctx_get_inverse_grids()                      */
+/************************************************************************/
+
+int pj_ctx_get_inverse_grids( projCtx ctx )
+
+{
+    return ctx->inverse_grids;
+}
+
+/************************************************************************/
+/*                     pj_ctx_set_grid_row_pairs()                      */
+/*                                                                      */
+/*      Whether grids in memory should get a second copy of their       */
+/*      values with each row interleaved with the next one, built       */
+/*      with the first batch of points shifted, so that the four        */
+/*      corners of a cell are contiguous and the interpolation of a     */
+/*      point touches one cache line instead of two a row apart.        */
+/*      This costs about twice the memory of each grid, and pays on     */
+/*      large grids with scattered points.  Grids read a tile at a      */
+/*      time, and inverse tables, keep the plain layout.                */
+/************************************************************************/
+
+void pj_ctx_set_grid_row_pairs( projCtx ctx, int enable )
+
+{
+    ctx->grid_row_pairs = enable;
+}
+
+/************************************************************************/
+/*                     pj_ctx_get_grid_row_pairs()                      */
+/************************************************************************/
+
+int pj_ctx_get_grid_row_pairs( projCtx ctx )
+
+{
+    return ctx->grid_row_pairs;
+}
+
+/************************************************************************/
+/*                     pj_ctx_set_grid_quantize()                       */
+/*                                                                      */
+/*      Hold the values of large horizontal grids, and of vertical      */
+/*      grids, as 16 bit integers scaled by blocks of nodes, for half   */
+/*      the memory, provided no node moves by more than max_error       */
+/*      metres, the shifts being taken on a sphere of the WGS84 major   */
+/*      axis.  The first context quantizing a grid checks the bound,    */
+/*      and a grid that misses it is left as it is.  The quantized      */
+/*      values are shared by the contexts and kept until the grid is    */
+/*      freed, outside of pj_set_grid_memory_limit().  Horizontal       */
+/*      grids are unpacked a tile at a time into the tiles of each      */
+/*      context, see pj_ctx_set_grid_tile_limit().  0 disables it.      */
+/************************************************************************/
+
+void pj_ctx_set_grid_quantize( projCtx ctx, double max_error )
+
+{
+    ctx->grid_quantize = max_error > 0.0 ? max_error : 0.0;
+}
+
+/************************************************************************/
+/*                     pj_ctx_get_grid_quantize()                       */
+/************************************************************************/
+
+double pj_ctx_get_grid_quantize( projCtx ctx )
+
+{
+    return ctx->grid_quantize;
+}
+
+/************************************************************************/
+/*                        pj_ctx_set_grid_shm()                         */
+/*                                                                      */
+/*      Whether the grids this context loads should have their          */
+/*      values in shared memory, mapped by every process on the host    */
+/*      loading the same grid file with this enabled, instead of a      */
+/*      private copy in each.  This helps grids converted on loading,   */
+/*      which cannot be mapped from their file, and such grids are      */
+/*      then loaded whole rather than a tile at a time.  Grids from     */
+/*      urls, and quantized ones, stay private.  A grid is shared or    */
+/*      not as the context first loading it in the process asks.        */
+/*      Only on POSIX systems; elsewhere this does nothing.             */
+/************************************************************************/
+
+void pj_ctx_set_grid_shm( projCtx ctx, int enable )
+
+{
+    ctx->grid_shm = enable;
+}
+
+/************************************************************************/
+/*                        pj_ctx_get_grid_shm()                         */
+/************************************************************************/
+
+int pj_ctx_get_grid_shm( projCtx ctx )
+
+{
+    return ctx->grid_shm;
+}
+
+/************************************************************************/
+/*                        pj_ctx_set_init_shm()                         */
+/*                                                                      */
+/*      Whether the index of the <tag> definitions of each init file,   */
+/*      built by scanning the whole file on the first +init= of it,     */
+/*      should be shared through shared memory with the other           */
+/*      processes on the host enabling this, so that only the first     */
+/*      one scans each file.  A changed file gets a new index.  Files   */
+/*      of file apis set by the application are indexed privately.     */
+/*      Only on POSIX systems; elsewhere this does nothing.             */
+/************************************************************************/
+
+void pj_ctx_set_init_shm( projCtx ctx, int enable )
+
+{
+    ctx->init_shm = enable;
+}
+
+/************************************************************************/
+/*                        pj_ctx_get_init_shm()                         */
+/************************************************************************/
+
+int pj_ctx_get_init_shm( projCtx ctx )
+
+{
+    return ctx->init_shm;
+}
+
+/************************************************************************/
+/*                    pj_ctx_set_grid_nonblocking()                     */
+/*                                                                      */
+/*      Whether the grids used through this context should never be     */
+/*      read on the calling thread.  When the values a point needs      */
+/*      are not in memory, the whole grid is loaded in the background   */
+/*      and the point is set to HUGE_VAL with PJD_ERR_GRID_NOT_READY    */
+/*      (-54), its status with pj_transform_status(), so that only      */
+/*      such points need to be tried again later.  Grids read a tile    */
+/*      at a time are loaded whole instead.  Without threads the        */
+/*      grids are loaded by the caller as usual.                        */
+/************************************************************************/
+
+void pj_ctx_set_grid_nonblocking( projCtx ctx, int enable )
+
+{
+    ctx->grid_nonblocking = enable;
+}
+
+/************************************************************************/
+/*                    pj_ctx_get_grid_nonblocking()                     */
+/************************************************************************/
+
+int pj_ctx_get_grid_nonblocking( projCtx ctx )
+
+{
+    return ctx->grid_nonblocking;
+}
+
+/************************************************************************/
+/*                        pj_ctx_set_low_memory()                       */
+/*                                                                      */
+/*      Whether the context should keep to a small and predictable      */
+/*      footprint, for devices with a few megabytes, at some cost in    */
+/*      speed.  Large grids are then read on demand into at most        */
+/*      PJ_LOW_MEMORY_TILE_LIMIT tiles, rather than loaded whole or     */
+/*      shared, definitions are only cached while both init caches      */
+/*      hold less than PJ_LOW_MEMORY_INITCACHE bytes, pj_init_many()    */
+/*      does not read whole init files ahead, and pj_transform() needs  */
+/*      scratch copies of at most PJ_LOW_MEMORY_WINDOW points.          */
+/*      Enabling it also lowers the tile limit to                       */
+/*      PJ_LOW_MEMORY_TILE_LIMIT, leaves one thread, and disables       */
+/*      inverse grid tables and paired grid rows, all of which may be   */
+/*      set again afterwards, and which disabling it leaves as they     */
+/*      are.                                                            */
+/************************************************************************/
+
+void pj_ctx_set_low_memory( projCtx ctx, int enable )
+
+{
+    ctx->low_memory = enable;
+    if( !enable )
+        return;
+
+    if( ctx->grid_tile_limit <= 0 
+        || ctx->grid_tile_limit > PJ_LOW_MEMORY_TILE_LIMIT )
+        pj_ctx_set_grid_tile_limit( ctx, PJ_LOW_MEMORY_TILE_LIMIT );
+    ctx->threads = 1;
+    ctx->inverse_grids = 0;
+    ctx->grid_row_pairs = 0;
+}
+
+/************************************************************************/
+/*                        pj_ctx_get_low_memory()                       */
+/************************************************************************/
+
+int pj_ctx_get_low_memory( projCtx ctx )
+
+{
+    return ctx->low_memory;
+}
+
+/************************************************************************/
+/*                           pj_ctx_set_isa()                           */
+/*                                                                      */
+/*      Hold the kernels of the context to the variants of a PJ_ISA_*   */
+/*      instruction set and earlier ones, to compare them or to work    */
+/*      around a processor, PJ_ISA_GENERIC keeping to the baseline of   */
+/*      the build.  PJ_ISA_BEST, the default, runs the best variant     */
+/*      the processor has.                                              */
+/************************************************************************/
+
+void pj_ctx_set_isa( projCtx ctx, int isa )
+
+{
+    ctx->isa_limit = isa < PJ_ISA_GENERIC ? PJ_ISA_GENERIC : isa;
+}
+
+/************************************************************************/
+/*                           pj_ctx_get_isa()                           */
+/*                                                                      */
+/*      The instruction set the kernels run with in the context: that   */
+/*      of the processor, see pj_cpu_isa(), unless pj_ctx_set_isa()     */
+/*      set an earlier one.  A limit of x86 sets leaves the generic     */
+/*      kernels on ARM.                                                 */
+/************************************************************************/
+
+int pj_ctx_get_isa( projCtx ctx )
+
+{
+    int isa = pj_cpu_isa();
+
+    if( ctx->isa_limit >= isa )
+        return isa;
+
+    if( isa == PJ_ISA_NEON )
+        return PJ_ISA_GENERIC;
+
+    return ctx->isa_limit;
+}
+
+/************************************************************************/
+/*                         pj_ctx_set_threads()                         */
+/*                                                                      */
+/*      Set how many threads pj_transform() and the transformation      */
+/*      plans of the context's definitions may split a large batch      */
+/*      across, the calling one included.  Each other thread works on   */
+/*      copies of the definitions in a context of its own, with its    */
+/*      own grid tiles, and sharing the grid registry.  The logger and  */
+/*      file hooks of the context must then be safe to call from       */
+/*      several threads at once.  Whole NTv1, NTv2 and GTX grids are    */
+/*      decoded in bands of rows on as many threads when loaded.  1,    */
+/*      the default, runs every batch on the calling thread.            */
+/************************************************************************/
+
+void pj_ctx_set_threads( projCtx ctx, int threads )
+
+{
+    ctx->threads = threads < 1 ? 1 : threads;
+}
+
+/************************************************************************/
+/*                         pj_ctx_get_threads()                         */
+/************************************************************************/
+
+int pj_ctx_get_threads( projCtx ctx )
+
+{
+    return ctx->threads;
+}
+
+/************************************************************************/
+/*                   pj_ctx_set_grid_sort_threshold()                   */
+/*                                                                      */
+/*      Set from how many points a batch going through grids read a     */
+/*      tile at a time is reordered along a space filling curve for     */
+/*      them, so that the tiles are visited in turn rather than read    */
+/*      again for about every point of an unsorted point cloud.         */
+/*      Points mostly in order already are left so.  Zero or less       */
+/*      disables it.  Batches split across threads are reordered by     */
+/*      chunk, so only when this is at most the chunk size of 2048      */
+/*      points.                                                         */
+/************************************************************************/
+
+void pj_ctx_set_grid_sort_threshold( projCtx ctx, long min_points )
+
+{
+    ctx->grid_sort_threshold = min_points;
+}
+
+/************************************************************************/
+/*                   pj_ctx_get_grid_sort_threshold()                   */
+/************************************************************************/
+
+long pj_ctx_get_grid_sort_threshold( projCtx ctx )
+
+{
+    return ctx->grid_sort_threshold;
+}
+
+/************************************************************************/
+/*                        pj_ctx_set_batch_grain()                      */
+/*                                                                      */
+/*      Set how many points the chunks of the batches split between     */
+/*      the threads of the context have, see pj_ctx_set_threads().      */
+/*      Threads done with their own chunks take over those of others,   */
+/*      so smaller chunks balance the work better, for more overhead.   */
+/************************************************************************/
+
+void pj_ctx_set_batch_grain( projCtx ctx, long points )
+
+{
+    ctx->batch_grain = points < 1 ? PJ_BATCH_DEFAULT_GRAIN : points;
+}
+
+/************************************************************************/
+/*                        pj_ctx_get_batch_grain()                      */
+/************************************************************************/
+
+long pj_ctx_get_batch_grain( projCtx ctx )
+
+{
+    return ctx->batch_grain;
+}
+
+/************************************************************************/
+/*                      pj_ctx_set_batch_min_split()                    */
+/*                                                                      */
+/*      Set how many points each thread a batch is split between        */
+/*      must get at least, so batches of less than twice this are not  */
+/*      split.                                                          */
+/************************************************************************/
+
+void pj_ctx_set_batch_min_split( projCtx ctx, long points )
+
+{
+    ctx->batch_min_split = points < 1 ? PJ_BATCH_DEFAULT_MIN_SPLIT : points;
+}
+
+/************************************************************************/
+/*                      pj_ctx_get_batch_min_split()                    */
+/************************************************************************/
+
+long pj_ctx_get_batch_min_split( projCtx ctx )
+
+{
+    return ctx->batch_min_split;
+}
+
+/************************************************************************/
+/*                        pj_ctx_set_array_chunk()                      */
+/*                                                                      */
+/*      Set how many points the array kernels of the projections are    */
+/*      run on at a time, with the range checks and steps around them   */
+/*      done over the same points while they are in cache.              */
+/************************************************************************/
+
+void pj_ctx_set_array_chunk( projCtx ctx, int points )
+
+{
+    ctx->array_chunk = points < 1 ? PJ_ARRAY_DEFAULT_CHUNK : points;
+}
+
+/************************************************************************/
+/*                        pj_ctx_get_array_chunk()                      */
+/************************************************************************/
+
+int pj_ctx_get_array_chunk( projCtx ctx )
+
+{
+    return ctx->array_chunk;
+}
+
+/************************************************************************/
+/*                        pj_ctx_set_allocator()                        */
+/*                                                                      */
+/*      Set the functions the memory of grids loaded through the        */
+/*      context comes from: their values, names and tiles, and the      */
+/*      grid catalogs.  user_data is passed as the first argument of    */
+/*      both.  A grid keeps the allocator of the context that opened    */
+/*      it (or of its registry, see pj_grid_registry_set_allocator())   */
+/*      until it is freed, so the functions must stay usable, and safe  */
+/*      to call from any thread using such grids, until then.  The      */
+/*      resident tiles of the context are dropped.  A NULL alloc        */
+/*      restores pj_malloc() and pj_dalloc().                           */
+/************************************************************************/
+
+void pj_ctx_set_allocator( projCtx ctx, void *(*alloc)(void *, size_t),
+                           void (*dalloc)(void *, void *), void *user_data )
+
+{
+    pj_grid_tiles_free( ctx, NULL );
+
+    ctx->allocator.alloc = alloc != NULL && dalloc != NULL ? alloc : NULL;
+    ctx->allocator.dalloc = ctx->allocator.alloc != NULL ? dalloc : NULL;
+    ctx->allocator.user_data = user_data;
+}
+
+/************************************************************************/
+/*                     pj_ctx_set_grid_huge_pages()                     */
+/*                                                                      */
+/*      Set whether grids of 2 MB and more loaded through the context   */
+/*      get their values in huge pages, cutting the TLB misses of       */
+/*      lookups all over a large grid.  PJ_HUGE_PAGES_ADVISE asks for   */
+/*      transparent huge pages, for read and for memory mapped grids,   */
+/*      and PJ_HUGE_PAGES_EXPLICIT takes read grids from the reserved   */
+/*      huge page pool while it lasts.  Grids with an allocator of      */
+/*      their own (see pj_ctx_set_allocator()) are left to it.  The     */
+/*      default, PJ_HUGE_PAGES_NONE, loads grids as before.             */
+/************************************************************************/
+
+void pj_ctx_set_grid_huge_pages( projCtx ctx, int mode )
+
+{
+    if( mode != PJ_HUGE_PAGES_ADVISE && mode != PJ_HUGE_PAGES_EXPLICIT )
+        mode = PJ_HUGE_PAGES_NONE;
+    ctx->grid_huge_pages = mode;
+}
+
+/************************************************************************/
+/*                     pj_ctx_get_grid_huge_pages()                     */
+/************************************************************************/
+
+int pj_ctx_get_grid_huge_pages( projCtx ctx )
+
+{
+    return ctx->grid_huge_pages;
+}
+
+/************************************************************************/
+/*                      pj_ctx_set_grid_registry()                      */
+/*                                                                      */
+/*      Set the registry the context loads grids and catalogs into,     */
+/*      or NULL for the default one.  Contexts sharing a registry       */
+/*      share the loaded grids, and only contend with each other.       */
+/************************************************************************/
+
+void pj_ctx_set_grid_registry( projCtx ctx, projGridRegistry registry )
+
+{
+    ctx->grid_registry = registry;
+}
+
+/************************************************************************/
+/*                      pj_ctx_get_grid_registry()                      */
+/************************************************************************/
+
+projGridRegistry pj_ctx_get_grid_registry( projCtx ctx )
+
+{
+    return ctx->grid_registry;
+}
+
 /************************************************************************/
 /*                         pj_ctx_set_fileapi()                         */
+/*                                                                      */
+/*      The default mapping and extended hooks only understand files    */
+/*      of the default file api, so they are dropped for any other      */
+/*      api.                                                            */
 /************************************************************************/
 
 void pj_ctx_set_fileapi( projCtx ctx, projFileAPI *fileapi )
 
 {
     ctx->fileapi = fileapi;
+    if( fileapi == pj_get_default_fileapi() )
+    {
+        ctx->filemapapi = pj_get_default_filemapapi();
+        ctx->fileapi_ex = pj_get_default_fileapi_ex();
+    }
+    else
+    {
+        ctx->filemapapi = NULL;
+        ctx->fileapi_ex = NULL;
+    }
 }
 
 /************************************************************************/
@@ -197,4 +982,53 @@ projFileAPI *pj_ctx_get_fileapi( projCtx ctx )
     return ctx->fileapi;
 }
 
+/************************************************************************/
+/*                       pj_ctx_set_filemapapi()                        */
+/*                                                                      */
+/*      Set the memory mapping hooks to use with the context's file     */
+/*      api, or NULL to always read grids into memory.                  */
+/************************************************************************/
+
+void pj_ctx_set_filemapapi( projCtx ctx, projFileMapAPI *filemapapi )
+
+{
+    ctx->filemapapi = filemapapi;
+}
+
+/************************************************************************/
+/*                       pj_ctx_get_filemapapi()                        */
+/************************************************************************/
+
+projFileMapAPI *pj_ctx_get_filemapapi( projCtx ctx )
+
+{
+    return ctx->filemapapi;
+}
+
+/************************************************************************/
+/*                       pj_ctx_set_fileapi_ex()                        */
+/*                                                                      */
+/*      Set the positional read and mapping hooks to use with the       */
+/*      context's file api, or NULL to only use the plain api (and      */
+/*      the mapping hooks of pj_ctx_set_filemapapi()).  Hooks of a      */
+/*      version this library does not know are ignored.  Grid tiles     */
+/*      and whole grids are read with FReadAt when it is set.           */
+/************************************************************************/
+
+void pj_ctx_set_fileapi_ex( projCtx ctx, projFileAPIEx *fileapi_ex )
+
+{
+    if( fileapi_ex != NULL && fileapi_ex->version != PJ_FILEAPI_EX_VERSION )
+        fileapi_ex = NULL;
+    ctx->fileapi_ex = fileapi_ex;
+}
+
+/************************************************************************/
+/*                       pj_ctx_get_fileapi_ex()                        */
+/************************************************************************/
+
+projFileAPIEx *pj_ctx_get_fileapi_ex( projCtx ctx )
 
+{
+    return ctx->fileapi_ex;
+}
@@ -42,7 +42,7 @@ int pj_datum_set(projCtx ctx, paralist *pl, PJ *projdef)
 {
     const char *name, *towgs84, *nadgrids, *catalog;
 
-    projdef->datum_type = PJD_UNKNOWN;
+    projdef->cold->datum_type = PJD_UNKNOWN;
 
 /* -------------------------------------------------------------------- */
 /*      Is there a datum definition in the parameters list?  If so,     */
@@ -57,28 +57,26 @@ int pj_datum_set(projCtx ctx, paralist *pl, PJ *projdef)
     if( (name = pj_param(ctx, pl,"sdatum").s) != NULL )
     {
         paralist *curr;
-        const char *s;
-        int i;
+        struct PJ_DATUMS *datum;
 
         /* find the end of the list, so we can add to it */
         for (curr = pl; curr && curr->next ; curr = curr->next) {}
         
         /* find the datum definition */
-        for (i = 0; (s = pj_datums[i].id) && strcmp(name, s) ; ++i) {}
-
-        if (!s) { pj_ctx_set_errno(ctx, -9); return 1; }
+        if( (datum = pj_find_datum(name)) == NULL )
+        { pj_ctx_set_errno(ctx, -9); return 1; }
 
-        if( pj_datums[i].ellipse_id && strlen(pj_datums[i].ellipse_id) > 0 )
+        if( datum->ellipse_id && strlen(datum->ellipse_id) > 0 )
         {
             char	entry[100];
             
             strcpy( entry, "ellps=" );
-            strncat( entry, pj_datums[i].ellipse_id, 80 );
+            strncat( entry, datum->ellipse_id, 80 );
             curr = curr->next = pj_mkparam(entry);
         }
         
-        if( pj_datums[i].defn && strlen(pj_datums[i].defn) > 0 )
-            curr = curr->next = pj_mkparam(pj_datums[i].defn);
+        if( datum->defn && strlen(datum->defn) > 0 )
+            curr = curr->next = pj_mkparam(datum->defn);
     }
 
 /* -------------------------------------------------------------------- */
@@ -89,7 +87,7 @@ int pj_datum_set(projCtx ctx, paralist *pl, PJ *projdef)
         /* We don't actually save the value separately.  It will continue
            to exist int he param list for use in pj_apply_gridshift.c */
 
-        projdef->datum_type = PJD_GRIDSHIFT;
+        projdef->cold->datum_type = PJD_GRIDSHIFT;
     }
 
 /* -------------------------------------------------------------------- */
@@ -99,12 +97,12 @@ int pj_datum_set(projCtx ctx, paralist *pl, PJ *projdef)
     {
         const char *date;
 
-        projdef->datum_type = PJD_GRIDSHIFT;
-        projdef->catalog_name = strdup(catalog);
+        projdef->cold->datum_type = PJD_GRIDSHIFT;
+        projdef->cold->catalog_name = strdup(catalog);
 
         date = pj_param(ctx, pl, "sdate").s;
         if( date != NULL) 
-            projdef->datum_date = pj_gc_parsedate( ctx, date);
+            projdef->cold->datum_date = pj_gc_parsedate( ctx, date);
     }
 
 /* -------------------------------------------------------------------- */
@@ -115,36 +113,36 @@ int pj_datum_set(projCtx ctx, paralist *pl, PJ *projdef)
         int    parm_count = 0;
         const char *s;
 
-        memset( projdef->datum_params, 0, sizeof(double) * 7);
+        memset( projdef->cold->datum_params, 0, sizeof(double) * 7);
 
         /* parse out the parameters */
         s = towgs84;
         for( s = towgs84; *s != '\0' && parm_count < 7; ) 
         {
-            projdef->datum_params[parm_count++] = atof(s);
+            projdef->cold->datum_params[parm_count++] = pj_atof(s);
             while( *s != '\0' && *s != ',' )
                 s++;
             if( *s == ',' )
                 s++;
         }
 
-        if( projdef->datum_params[3] != 0.0 
-            || projdef->datum_params[4] != 0.0 
-            || projdef->datum_params[5] != 0.0 
-            || projdef->datum_params[6] != 0.0 )
+        if( projdef->cold->datum_params[3] != 0.0 
+            || projdef->cold->datum_params[4] != 0.0 
+            || projdef->cold->datum_params[5] != 0.0 
+            || projdef->cold->datum_params[6] != 0.0 )
         {
-            projdef->datum_type = PJD_7PARAM;
+            projdef->cold->datum_type = PJD_7PARAM;
 
             /* transform from arc seconds to radians */
-            projdef->datum_params[3] *= SEC_TO_RAD;
-            projdef->datum_params[4] *= SEC_TO_RAD;
-            projdef->datum_params[5] *= SEC_TO_RAD;
+            projdef->cold->datum_params[3] *= SEC_TO_RAD;
+            projdef->cold->datum_params[4] *= SEC_TO_RAD;
+            projdef->cold->datum_params[5] *= SEC_TO_RAD;
             /* transform from parts per million to scaling factor */
-            projdef->datum_params[6] = 
-                (projdef->datum_params[6]/1000000.0) + 1;
+            projdef->cold->datum_params[6] = 
+                (projdef->cold->datum_params[6]/1000000.0) + 1;
         }
         else 
-            projdef->datum_type = PJD_3PARAM;
+            projdef->cold->datum_type = PJD_3PARAM;
 
         /* Note that pj_init() will later switch datum_type to 
            PJD_WGS84 if shifts are all zero, and ellipsoid is WGS84 or GRS80 */
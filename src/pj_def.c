@@ -0,0 +1,161 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Build a definition one parameter at a time, for
+ *           pj_init_from_def().
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <projects.h>
+#include <string.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** A definition such as
+**
+**     projDef def = pj_def_new();
+**     pj_def_set_string( def, "proj", "tmerc" );
+**     pj_def_set_double( def, "lat_0", 45.0 );
+**     pj_def_set_string( def, "no_defs", NULL );
+**
+** gives the same projection with pj_init_from_def() as
+** "+proj=tmerc +lat_0=45 +no_defs" with pj_init_plus(), but numbers
+** are kept as given instead of being formatted and parsed again.
+** Angles are in degrees, as in definition strings.  Parameters keep the
+** order they were first set in, and setting one again replaces its
+** value.
+*/
+
+/************************************************************************/
+/*                             pj_def_new()                             */
+/************************************************************************/
+
+PJ_DEF *pj_def_new( void )
+
+{
+    PJ_DEF *def = (PJ_DEF *) pj_malloc( sizeof(PJ_DEF) );
+
+    if( def != NULL )
+        def->start = def->last = NULL;
+
+    return def;
+}
+
+/************************************************************************/
+/*                             def_append()                             */
+/*                                                                      */
+/*      Add item to the definition, in place of a parameter of the      */
+/*      same name.                                                      */
+/************************************************************************/
+
+static int def_append( PJ_DEF *def, paralist *item )
+
+{
+    paralist **link, *prev = NULL;
+    size_t len;
+
+    if( item == NULL )
+        return -1;
+
+    len = strcspn( item->param, "=" );
+    for( link = &def->start; *link != NULL; link = &(*link)->next )
+    {
+        paralist *old = *link;
+
+        if( strncmp( old->param, item->param, len ) == 0
+            && (old->param[len] == '\0' || old->param[len] == '=') )
+        {
+            item->next = old->next;
+            *link = item;
+            if( def->last == old )
+                def->last = item;
+            pj_free_param( old );
+            return 0;
+        }
+        prev = old;
+    }
+
+    if( prev != NULL )
+        prev->next = item;
+    else
+        def->start = item;
+    def->last = item;
+
+    return 0;
+}
+
+/************************************************************************/
+/*                         pj_def_set_double()                          */
+/*                                                                      */
+/*      Returns 0, or -1 if out of memory.                              */
+/************************************************************************/
+
+int pj_def_set_double( PJ_DEF *def, const char *name, double value )
+
+{
+    return def_append( def, pj_mkparam_value( NULL, name, value ) );
+}
+
+/************************************************************************/
+/*                         pj_def_set_string()                          */
+/*                                                                      */
+/*      Set name=value, or just name as for +no_defs if value is        */
+/*      NULL.  Returns 0, or -1 if out of memory.                       */
+/************************************************************************/
+
+int pj_def_set_string( PJ_DEF *def, const char *name, const char *value )
+
+{
+    paralist *item;
+    char *text;
+
+    if( value == NULL )
+        return def_append( def, pj_mkparam_arena( NULL, name ) );
+
+    text = (char *) pj_malloc( strlen(name) + strlen(value) + 2 );
+    if( text == NULL )
+        return -1;
+    strcpy( text, name );
+    strcat( text, "=" );
+    strcat( text, value );
+    item = pj_mkparam_arena( NULL, text );
+    pj_dalloc( text );
+
+    return def_append( def, item );
+}
+
+/************************************************************************/
+/*                             pj_def_free()                            */
+/************************************************************************/
+
+void pj_def_free( PJ_DEF *def )
+
+{
+    if( def != NULL )
+    {
+        pj_free_paralist( def->start );
+        pj_dalloc( def );
+    }
+}
@@ -25,14 +25,14 @@ pj_ell_set(projCtx ctx, paralist *pl, double *a, double *es) {
 
 		/* check if ellps present and temporarily append its values to pl */
         if ((name = pj_param(ctx,pl, "sellps").s) != NULL) {
-			char *s;
+			struct PJ_ELLPS *ellps;
 
 			for (start = pl; start && start->next ; start = start->next) ;
 			curr = start;
-			for (i = 0; (s = pj_ellps[i].id) && strcmp(name, s) ; ++i) ;
-			if (!s) { pj_ctx_set_errno( ctx, -9); return 1; }
-			curr = curr->next = pj_mkparam(pj_ellps[i].major);
-			curr = curr->next = pj_mkparam(pj_ellps[i].ell);
+			if (!(ellps = pj_find_ellps(name)))
+				{ pj_ctx_set_errno( ctx, -9); return 1; }
+			curr = curr->next = pj_mkparam(ellps->major);
+			curr = curr->next = pj_mkparam(ellps->ell);
 		}
 		*a = pj_param(ctx,pl, "da").f;
 		if (pj_param(ctx,pl, "tes").i) /* eccentricity squared */
@@ -89,9 +89,7 @@ pj_ell_set(projCtx ctx, paralist *pl, double *a, double *es) {
 		}
 bomb:
 		if (start) { /* clean up temporary extension of list */
-			pj_dalloc(start->next->next);
-			pj_dalloc(start->next);
-			start->next = 0;
+			pj_param_truncate(pl, start);
 		}
 		if (ctx->last_errno)
 			return 1;
@@ -0,0 +1,148 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Tables derived from the ellipsoid, shared by the projections
+ *           on the same one.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <projects.h>
+#include <stddef.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** The meridian distance coefficients of pj_enfn() and the authalic ones
+** of pj_authset() depend only on the eccentricity squared, and most
+** definitions use one of a handful of ellipsoids.  The tables are kept
+** once per kind and es in a list, under the global lock, and counted by
+** the projections holding them, which must not change them.  A table is
+** freed when the last of them is.
+*/
+typedef struct PJ_TABLE {
+    struct PJ_TABLE *next;
+    int             kind;
+    double          es;
+    int             refs;
+    int             count;
+    double          values[1];          /* as many as the kind has */
+} PJ_TABLE;
+
+static PJ_TABLE *table_list = NULL;
+
+/************************************************************************/
+/*                          pj_table_acquire()                          */
+/*                                                                      */
+/*      The count values of the table of a kind for es, made with       */
+/*      fill() if no projection holds it yet.  The result must be       */
+/*      released with pj_table_release().  Returns NULL if out of       */
+/*      memory.                                                         */
+/************************************************************************/
+
+double *pj_table_acquire( int kind, double es, int count,
+                          void (*fill)(double es, double *values) )
+
+{
+    PJ_TABLE *table;
+
+    pj_acquire_lock();
+    for( table = table_list; table != NULL; table = table->next )
+    {
+        if( table->kind == kind && table->es == es )
+        {
+            table->refs++;
+            pj_release_lock();
+            return table->values;
+        }
+    }
+
+    table = (PJ_TABLE *) pj_malloc( sizeof(PJ_TABLE)
+                                    + (count - 1) * sizeof(double) );
+    if( table != NULL )
+    {
+        table->kind = kind;
+        table->es = es;
+        table->refs = 1;
+        table->count = count;
+        fill( es, table->values );
+        table->next = table_list;
+        table_list = table;
+    }
+    pj_release_lock();
+
+    return table != NULL ? table->values : NULL;
+}
+
+/************************************************************************/
+/*                          pj_table_release()                          */
+/*                                                                      */
+/*      Release a table of pj_table_acquire(), pj_enfn() or             */
+/*      pj_authset().  NULL is ignored.                                 */
+/************************************************************************/
+
+void pj_table_release( double *values )
+
+{
+    PJ_TABLE *table, **link;
+
+    if( values == NULL )
+        return;
+
+    table = (PJ_TABLE *) ((char *) values - offsetof(PJ_TABLE, values));
+
+    pj_acquire_lock();
+    if( --table->refs == 0 )
+    {
+        for( link = &table_list; *link != NULL; link = &(*link)->next )
+        {
+            if( *link == table )
+            {
+                *link = table->next;
+                break;
+            }
+        }
+        pj_dalloc( table );
+    }
+    pj_release_lock();
+}
+
+/************************************************************************/
+/*                           pj_table_memory()                          */
+/*                                                                      */
+/*      Bytes held by the tables of all projections.                    */
+/************************************************************************/
+
+double pj_table_memory()
+
+{
+    PJ_TABLE *table;
+    double bytes = 0;
+
+    pj_acquire_lock();
+    for( table = table_list; table != NULL; table = table->next )
+        bytes += sizeof(PJ_TABLE) + (table->count - 1) * sizeof(double);
+    pj_release_lock();
+
+    return bytes;
+}
@@ -0,0 +1,512 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Executor grouping the small jobs of many plans into batches,
+ *           one per plan, run on other threads.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <string.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** Jobs submitted wait in the group of their plan.  A group is started
+** once it holds max_points points, or its oldest job has waited max_wait
+** milliseconds, which is checked whenever a job is submitted and by
+** pj_executor_poll().  The points of its jobs are then copied into one
+** batch, run by pj_transform_plan_execute_async(), where it is split
+** between the threads of the context of the plan (pj_ctx_set_threads()).
+** When it is done the points are copied back and the callback of each
+** job called, on the thread of the batch.
+**
+** At most one batch a processor runs at once: starting another waits for
+** the oldest to be done.  Batches done are waited for by the next call
+** of the executor, which adds their errors and statistics to the
+** contexts of their plans, as pj_transform_async_wait() does.
+*/
+#define EXEC_DEFAULT_POINTS 65536
+
+typedef struct PJ_EXEC_JOB_s {
+    long       point_count;
+    double     *x, *y, *z;
+    int        *status;
+    void       (*done)(void *user, long result);
+    void       *user;
+    struct PJ_EXEC_JOB_s *next;
+} PJ_EXEC_JOB;
+
+typedef struct PJ_EXEC_GROUP_s {
+    struct PJ_EXECUTOR_s *executor;
+    PJ_TRANSFORM_PLAN *plan;
+    PJ_EXEC_JOB *jobs, *last;
+    long       point_count;
+    int        has_z;
+    double     first_ns;        /* when its oldest job came */
+    double     *x, *y, *z;      /* the batch */
+    int        *status;
+    projTransformAsync async;
+    int        finished;        /* under the lock of the executor */
+    struct PJ_EXEC_GROUP_s *next;
+} PJ_EXEC_GROUP;
+
+typedef struct PJ_EXECUTOR_s {
+    void       *lock;
+    long       max_points;
+    double     max_wait_ns;
+    int        max_running;
+    int        running_count;
+    PJ_EXEC_GROUP *waiting;     /* by plan, collecting jobs */
+    PJ_EXEC_GROUP *running;     /* started, oldest first */
+} PJ_EXECUTOR;
+
+/************************************************************************/
+/*                          exec_group_free()                           */
+/************************************************************************/
+
+static void exec_group_free( PJ_EXEC_GROUP *group )
+
+{
+    PJ_EXEC_JOB *job, *next;
+
+    for( job = group->jobs; job != NULL; job = next )
+    {
+        next = job->next;
+        pj_dalloc( job );
+    }
+    pj_dalloc( group->x );
+    pj_dalloc( group->status );
+    pj_dalloc( group );
+}
+
+/************************************************************************/
+/*                          exec_group_done()                           */
+/*                                                                      */
+/*      Copy the points of a batch back to its jobs and call their      */
+/*      callbacks with their failed points.                             */
+/************************************************************************/
+
+static void exec_group_done( void *user, long result )
+
+{
+    PJ_EXEC_GROUP *group = (PJ_EXEC_GROUP *) user;
+    PJ_EXEC_JOB *job;
+    long at = 0, i;
+
+    (void) result;
+
+    for( job = group->jobs; job != NULL; job = job->next )
+    {
+        long failed = 0;
+
+        memcpy( job->x, group->x + at, sizeof(double) * job->point_count );
+        memcpy( job->y, group->y + at, sizeof(double) * job->point_count );
+        if( job->z != NULL )
+            memcpy( job->z, group->z + at,
+                    sizeof(double) * job->point_count );
+        for( i = 0; i < job->point_count; i++ )
+            if( group->status[at+i] != 0 )
+                failed++;
+        if( job->status != NULL )
+            memcpy( job->status, group->status + at,
+                    sizeof(int) * job->point_count );
+        at += job->point_count;
+
+        if( job->done != NULL )
+            job->done( job->user, failed );
+    }
+
+    pj_mutex_lock( group->executor->lock );
+    group->finished = 1;
+    pj_mutex_unlock( group->executor->lock );
+}
+
+/************************************************************************/
+/*                          exec_group_wait()                           */
+/*                                                                      */
+/*      Wait for a batch taken off the running list, and free it.       */
+/************************************************************************/
+
+static void exec_group_wait( PJ_EXECUTOR *executor, PJ_EXEC_GROUP *group )
+
+{
+    if( group->async != NULL )
+        pj_transform_async_wait( group->async );
+    exec_group_free( group );
+
+    pj_mutex_lock( executor->lock );
+    executor->running_count--;
+    pj_mutex_unlock( executor->lock );
+}
+
+/************************************************************************/
+/*                             exec_reap()                              */
+/*                                                                      */
+/*      Wait for the batches that are done, or for all of them.         */
+/************************************************************************/
+
+static void exec_reap( PJ_EXECUTOR *executor, int all )
+
+{
+    for( ;; )
+    {
+        PJ_EXEC_GROUP **link, *group = NULL;
+
+        pj_mutex_lock( executor->lock );
+        for( link = &(executor->running); *link != NULL;
+             link = &((*link)->next) )
+        {
+            if( all || (*link)->finished )
+            {
+                group = *link;
+                *link = group->next;
+                break;
+            }
+        }
+        pj_mutex_unlock( executor->lock );
+
+        if( group == NULL )
+            return;
+        exec_group_wait( executor, group );
+    }
+}
+
+/************************************************************************/
+/*                           exec_start()                               */
+/*                                                                      */
+/*      Start the batch of a group taken off the waiting list.          */
+/************************************************************************/
+
+static void exec_start( PJ_EXECUTOR *executor, PJ_EXEC_GROUP *group )
+
+{
+    PJ_EXEC_GROUP *oldest, **link;
+    PJ_EXEC_JOB *job;
+    long n = group->point_count, at = 0, i;
+
+    /* no more batches at once than processors */
+    for( ;; )
+    {
+        pj_mutex_lock( executor->lock );
+        oldest = NULL;
+        if( executor->running_count >= executor->max_running
+            && executor->running != NULL )
+        {
+            oldest = executor->running;
+            executor->running = oldest->next;
+        }
+        else
+            executor->running_count++;
+        pj_mutex_unlock( executor->lock );
+
+        if( oldest == NULL )
+            break;
+        exec_group_wait( executor, oldest );
+    }
+
+    group->x = (double *) pj_malloc( sizeof(double) * 3 * n );
+    group->status = (int *) pj_malloc( sizeof(int) * n );
+    if( group->x != NULL && group->status != NULL )
+    {
+        group->y = group->x + n;
+        group->z = group->has_z ? group->y + n : NULL;
+
+        for( job = group->jobs; job != NULL; job = job->next )
+        {
+            memcpy( group->x + at, job->x, sizeof(double) * job->point_count );
+            memcpy( group->y + at, job->y, sizeof(double) * job->point_count );
+            if( group->z != NULL )
+            {
+                if( job->z != NULL )
+                    memcpy( group->z + at, job->z,
+                            sizeof(double) * job->point_count );
+                else
+                    for( i = 0; i < job->point_count; i++ )
+                        group->z[at+i] = 0.0;
+            }
+            at += job->point_count;
+        }
+
+        group->async = pj_transform_plan_execute_async(
+            group->plan, n, 1, group->x, group->y, group->z,
+            group->status, exec_group_done, group );
+        if( group->async == NULL )
+        {
+            /* out of memory for a thread: transform it here */
+            pj_transform_plan_execute_status( group->plan, n, 1, group->x,
+                                              group->y, group->z,
+                                              group->status );
+            exec_group_done( group, 0 );
+        }
+    }
+    else
+    {
+        /* out of memory for the batch: fail every point */
+        for( job = group->jobs; job != NULL; job = job->next )
+        {
+            for( i = 0; job->status != NULL && i < job->point_count; i++ )
+                job->status[i] = -38;
+            if( job->done != NULL )
+                job->done( job->user, job->point_count );
+        }
+        group->finished = 1;
+    }
+
+    /* at the end of the running list, the oldest being first */
+    pj_mutex_lock( executor->lock );
+    for( link = &(executor->running); *link != NULL;
+         link = &((*link)->next) ) {}
+    group->next = NULL;
+    *link = group;
+    pj_mutex_unlock( executor->lock );
+}
+
+/************************************************************************/
+/*                           exec_dispatch()                            */
+/*                                                                      */
+/*      Start the waiting groups that are full or have waited long      */
+/*      enough, or all of them.                                         */
+/************************************************************************/
+
+static void exec_dispatch( PJ_EXECUTOR *executor, int all )
+
+{
+    for( ;; )
+    {
+        PJ_EXEC_GROUP **link, *group = NULL;
+        double now = all ? 0.0 : pj_clock_ns();
+
+        pj_mutex_lock( executor->lock );
+        for( link = &(executor->waiting); *link != NULL;
+             link = &((*link)->next) )
+        {
+            if( all || (*link)->point_count >= executor->max_points
+                || (executor->max_wait_ns >= 0.0
+                    && now - (*link)->first_ns >= executor->max_wait_ns) )
+            {
+                group = *link;
+                *link = group->next;
+                break;
+            }
+        }
+        pj_mutex_unlock( executor->lock );
+
+        if( group == NULL )
+            return;
+        exec_start( executor, group );
+    }
+}
+
+/************************************************************************/
+/*                          pj_executor_alloc()                         */
+/*                                                                      */
+/*      An executor starting the batch of a plan once it holds          */
+/*      max_points points, 65536 if 0 or less, or its oldest job has    */
+/*      waited max_wait milliseconds, never if less than 0.  Returns    */
+/*      NULL if out of memory.                                          */
+/************************************************************************/
+
+projExecutor pj_executor_alloc( long max_points, double max_wait )
+
+{
+    PJ_EXECUTOR *executor;
+
+    executor = (PJ_EXECUTOR *) pj_malloc( sizeof(PJ_EXECUTOR) );
+    if( executor == NULL )
+        return NULL;
+    memset( executor, 0, sizeof(PJ_EXECUTOR) );
+
+    executor->lock = pj_mutex_create( PJ_LOCK_EXECUTOR );
+    executor->max_points = max_points > 0 ? max_points
+        : EXEC_DEFAULT_POINTS;
+    executor->max_wait_ns = max_wait >= 0.0 ? max_wait * 1e6 : -1.0;
+    executor->max_running = pj_cpu_count();
+    if( executor->max_running < 1 )
+        executor->max_running = 1;
+
+    return (projExecutor) executor;
+}
+
+/************************************************************************/
+/*                         pj_executor_submit()                         */
+/*                                                                      */
+/*      Queue the transformation of point_count points through the      */
+/*      plan, z being 0 for each if z is NULL.  When it is done the     */
+/*      points are transformed in place, status, if not NULL, gets      */
+/*      the error of each point as from                                 */
+/*      pj_transform_plan_execute_status(), and done(user, failed) is   */
+/*      called with the number of failed points, on the thread of its   */
+/*      batch.  The points and the plan must stay until then.  Returns  */
+/*      0, or -38 if out of memory, done not being called.              */
+/************************************************************************/
+
+int pj_executor_submit( projExecutor handle, PJ_TRANSFORM_PLAN *plan,
+                        long point_count, double *x, double *y, double *z,
+                        int *status, void (*done)(void *user, long result),
+                        void *user )
+
+{
+    PJ_EXECUTOR *executor = (PJ_EXECUTOR *) handle;
+    PJ_EXEC_GROUP *group, *fresh = NULL;
+    PJ_EXEC_JOB *job;
+
+    exec_reap( executor, 0 );
+
+    if( point_count <= 0 )
+    {
+        if( done != NULL )
+            done( user, 0 );
+        return 0;
+    }
+
+    job = (PJ_EXEC_JOB *) pj_malloc( sizeof(PJ_EXEC_JOB) );
+    if( job == NULL )
+    {
+        pj_ctx_set_errno( plan->srcdefn->ctx, -38 );
+        return -38;
+    }
+    job->point_count = point_count;
+    job->x = x;
+    job->y = y;
+    job->z = z;
+    job->status = status;
+    job->done = done;
+    job->user = user;
+    job->next = NULL;
+
+    pj_mutex_lock( executor->lock );
+    for( ;; )
+    {
+        for( group = executor->waiting; group != NULL; group = group->next )
+            if( group->plan == plan )
+                break;
+        if( group != NULL || fresh != NULL )
+            break;
+
+        /* the first job of the plan: allocate its group unlocked */
+        pj_mutex_unlock( executor->lock );
+        fresh = (PJ_EXEC_GROUP *) pj_malloc( sizeof(PJ_EXEC_GROUP) );
+        if( fresh == NULL )
+        {
+            pj_dalloc( job );
+            pj_ctx_set_errno( plan->srcdefn->ctx, -38 );
+            return -38;
+        }
+        pj_mutex_lock( executor->lock );
+    }
+    if( group == NULL )
+    {
+        group = fresh;
+        fresh = NULL;
+        memset( group, 0, sizeof(PJ_EXEC_GROUP) );
+        group->executor = executor;
+        group->plan = plan;
+        group->first_ns = pj_clock_ns();
+        group->next = executor->waiting;
+        executor->waiting = group;
+    }
+    if( group->last != NULL )
+        group->last->next = job;
+    else
+        group->jobs = job;
+    group->last = job;
+    group->point_count += point_count;
+    if( z != NULL )
+        group->has_z = 1;
+    pj_mutex_unlock( executor->lock );
+
+    pj_dalloc( fresh );
+
+    exec_dispatch( executor, 0 );
+
+    return 0;
+}
+
+/************************************************************************/
+/*                          pj_executor_poll()                          */
+/*                                                                      */
+/*      Start the batches that have waited max_wait, for callers that   */
+/*      may not submit for a while.                                     */
+/************************************************************************/
+
+void pj_executor_poll( projExecutor handle )
+
+{
+    PJ_EXECUTOR *executor = (PJ_EXECUTOR *) handle;
+
+    exec_reap( executor, 0 );
+    exec_dispatch( executor, 0 );
+}
+
+/************************************************************************/
+/*                         pj_executor_flush()                          */
+/*                                                                      */
+/*      Start the batches of all jobs submitted, without waiting.       */
+/************************************************************************/
+
+void pj_executor_flush( projExecutor handle )
+
+{
+    PJ_EXECUTOR *executor = (PJ_EXECUTOR *) handle;
+
+    exec_reap( executor, 0 );
+    exec_dispatch( executor, 1 );
+}
+
+/************************************************************************/
+/*                          pj_executor_wait()                          */
+/*                                                                      */
+/*      Run all jobs submitted and wait for them to be done.            */
+/************************************************************************/
+
+void pj_executor_wait( projExecutor handle )
+
+{
+    PJ_EXECUTOR *executor = (PJ_EXECUTOR *) handle;
+
+    exec_dispatch( executor, 1 );
+    exec_reap( executor, 1 );
+}
+
+/************************************************************************/
+/*                          pj_executor_free()                          */
+/*                                                                      */
+/*      Wait for all jobs, as pj_executor_wait(), and free it.          */
+/************************************************************************/
+
+void pj_executor_free( projExecutor handle )
+
+{
+    PJ_EXECUTOR *executor = (PJ_EXECUTOR *) handle;
+
+    if( executor == NULL )
+        return;
+
+    pj_executor_wait( executor );
+    pj_mutex_destroy( executor->lock );
+    pj_dalloc( executor );
+}
@@ -6,81 +6,235 @@
 #define DEFAULT_H   1e-5    /* radian default for numeric h */
 #endif
 #define EPS 1.0e-12
+#define FACTORS_CHUNK 256   /* points differenced at once by the arrays */
+#define FACTORS_ANAL (IS_ANAL_XL_YL+IS_ANAL_XP_YP)
+	static int /* range check and normalize lp as for P->fwd */
+factors_lp(LP *lp, PJ *P, double *h) {
+	if (fabs(lp->phi)-HALFPI > EPS || fabs(lp->lam) > 10.)
+		return 1;
+	if (*h < EPS)
+		*h = DEFAULT_H;
+	if (fabs(lp->phi) > (HALFPI - *h))
+	/* adjust to value around pi/2 where derived still exists*/
+		lp->phi = lp->phi < 0. ? (-HALFPI+*h) : (HALFPI-*h);
+	else if (P->geoc)
+		lp->phi = atan(P->rone_es * tan(lp->phi));
+	lp->lam -= P->lam0;	/* compute del lp.lam */
+	if (!P->over)
+		lp->lam = adjlon(lp->lam); /* adjust del longitude */
+	return 0;
+}
+	static void /* factors from the derivatives and analytic values */
+factors_finish(LP lp, PJ *P, struct DERIVS *der, struct FACTORS *fac) {
+	double cosphi, t, n, r;
+
+	if (!(fac->code & IS_ANAL_XL_YL)) {
+		fac->der.x_l = der->x_l;
+		fac->der.y_l = der->y_l;
+	}
+	if (!(fac->code & IS_ANAL_XP_YP)) {
+		fac->der.x_p = der->x_p;
+		fac->der.y_p = der->y_p;
+	}
+	cosphi = cos(lp.phi);
+	if (!(fac->code & IS_ANAL_HK)) {
+		fac->h = hypot(fac->der.x_p, fac->der.y_p);
+		fac->k = hypot(fac->der.x_l, fac->der.y_l) / cosphi;
+		if (P->es) {
+			t = sin(lp.phi);
+			t = 1. - P->es * t * t;
+			n = sqrt(t);
+			fac->h *= t * n / P->one_es;
+			fac->k *= n;
+			r = t * t / P->one_es;
+		} else
+			r = 1.;
+	} else if (P->es) {
+		r = sin(lp.phi);
+		r = 1. - P->es * r * r;
+		r = r * r / P->one_es;
+	} else
+		r = 1.;
+	/* convergence */
+	if (!(fac->code & IS_ANAL_CONV)) {
+		fac->conv = - atan2(fac->der.y_l, fac->der.x_l);
+		if (fac->code & IS_ANAL_XL_YL)
+			fac->code |= IS_ANAL_CONV;
+	}
+	/* areal scale factor */
+	fac->s = (fac->der.y_p * fac->der.x_l - fac->der.x_p * fac->der.y_l) *
+		r / cosphi;
+	/* meridian-parallel angle theta prime */
+	fac->thetap = aasin(P->ctx,fac->s / (fac->h * fac->k));
+	/* Tissot ellips axis */
+	t = fac->k * fac->k + fac->h * fac->h;
+	fac->a = sqrt(t + 2. * fac->s);
+	t = (t = t - 2. * fac->s) <= 0. ? 0. : sqrt(t);
+	fac->b = 0.5 * (fac->a - t);
+	fac->a = 0.5 * (fac->a + t);
+	/* omega */
+	fac->omega = 2. * aasin(P->ctx,(fac->a - fac->b)/(fac->a + fac->b));
+}
 	int
 pj_factors(LP lp, PJ *P, double h, struct FACTORS *fac) {
 	struct DERIVS der;
-	double cosphi, t, n, r;
 
 	/* check for forward and latitude or longitude overange */
-	if ((t = fabs(lp.phi)-HALFPI) > EPS || fabs(lp.lam) > 10.) {
+	if (factors_lp(&lp, P, &h)) {
                 pj_ctx_set_errno( P->ctx, -14);
 		return 1;
 	} else { /* proceed */
-		errno = pj_errno = 0;
+		if (P->ctx->errno_globals)
+			errno = pj_errno = 0;
                 P->ctx->last_errno = 0;
 
-		if (h < EPS)
-			h = DEFAULT_H;
-		if (fabs(lp.phi) > (HALFPI - h)) 
-                /* adjust to value around pi/2 where derived still exists*/
-		        lp.phi = lp.phi < 0. ? (-HALFPI+h) : (HALFPI-h);
-		else if (P->geoc)
-			lp.phi = atan(P->rone_es * tan(lp.phi));
-		lp.lam -= P->lam0;	/* compute del lp.lam */
-		if (!P->over)
-			lp.lam = adjlon(lp.lam); /* adjust del longitude */
+		/* the flags of an earlier call in fac would keep its values
+		   wherever P->spc declines the point */
+		fac->code = 0;
 		if (P->spc)	/* get what projection analytic values */
 			P->spc(lp, P, fac);
-		if (((fac->code & (IS_ANAL_XL_YL+IS_ANAL_XP_YP)) !=
-			  (IS_ANAL_XL_YL+IS_ANAL_XP_YP)) &&
+		if (((fac->code & FACTORS_ANAL) != FACTORS_ANAL) &&
 			  pj_deriv(lp, h, P, &der))
 			return 1;
-		if (!(fac->code & IS_ANAL_XL_YL)) {
-			fac->der.x_l = der.x_l;
-			fac->der.y_l = der.y_l;
+		factors_finish(lp, P, &der, fac);
+	}
+	return 0;
+}
+	void /* derivatives of a conformal projection from those along lam */
+pj_conformal_der(LP lp, PJ *P, double x_l, double y_l, struct FACTORS *fac) {
+	double m = sin(lp.phi);
+
+	m = P->one_es / ((1. - P->es * m * m) * cos(lp.phi));
+	fac->code |= IS_ANAL_XL_YL + IS_ANAL_XP_YP;
+	fac->der.x_l = x_l;
+	fac->der.y_l = - y_l;
+	fac->der.x_p = m * y_l;
+	fac->der.y_p = m * x_l;
+}
+	static void /* pj_deriv() of n points, through P->fwd_n if any */
+factors_deriv_n(PJ *P, long n, double h, const LP *lp, struct DERIVS *der,
+		int *failed) {
+	double x[4 * FACTORS_CHUNK], y[4 * FACTORS_CHUNK], h2 = h + h;
+	long i, j;
+
+	/* the corners of pj_deriv(), in its order and arithmetic */
+	for (i = 0; i < n; ++i) {
+		double lam = lp[i].lam + h, phi = lp[i].phi + h;
+
+		for (j = 0; j < 4; ++j) {
+			if (j == 1) phi -= h2;
+			else if (j == 2) lam -= h2;
+			else if (j == 3) phi += h2;
+			x[4*i+j] = lam;
+			y[4*i+j] = phi;
+			if (fabs(phi) > HALFPI)
+				failed[i] = 1;
 		}
-		if (!(fac->code & IS_ANAL_XP_YP)) {
-			fac->der.x_p = der.x_p;
-			fac->der.y_p = der.y_p;
+		if (failed[i])
+			x[4*i] = x[4*i+1] = x[4*i+2] = x[4*i+3] = HUGE_VAL;
+	}
+	if (P->fwd_n)
+		(*P->fwd_n)(P, 4 * n, 1, x, y);
+	else
+		for (i = 0; i < 4 * n; ++i) {
+			LP t;
+			XY xy;
+
+			if (x[i] == HUGE_VAL)
+				continue;
+			t.lam = x[i];
+			t.phi = y[i];
+			xy = (*P->fwd)(t, P);
+			x[i] = xy.x;
+			y[i] = xy.y;
 		}
-		cosphi = cos(lp.phi);
-		if (!(fac->code & IS_ANAL_HK)) {
-			fac->h = hypot(fac->der.x_p, fac->der.y_p);
-			fac->k = hypot(fac->der.x_l, fac->der.y_l) / cosphi;
-			if (P->es) {
-				t = sin(lp.phi);
-				t = 1. - P->es * t * t;
-				n = sqrt(t);
-				fac->h *= t * n / P->one_es;
-				fac->k *= n;
-				r = t * t / P->one_es;
-			} else
-				r = 1.;
-		} else if (P->es) {
-			r = sin(lp.phi);
-			r = 1. - P->es * r * r;
-			r = r * r / P->one_es;
-		} else
-			r = 1.;
-		/* convergence */
-		if (!(fac->code & IS_ANAL_CONV)) {
-			fac->conv = - atan2(fac->der.y_l, fac->der.x_l);
-			if (fac->code & IS_ANAL_XL_YL)
-				fac->code |= IS_ANAL_CONV;
+	P->ctx->last_errno = 0;
+
+	for (i = 0; i < n; ++i) {
+		double *tx = x + 4*i, *ty = y + 4*i;
+		double h4;
+
+		if (failed[i])
+			continue;
+		if (tx[0] == HUGE_VAL || tx[1] == HUGE_VAL ||
+			tx[2] == HUGE_VAL || tx[3] == HUGE_VAL) {
+			failed[i] = 1;
+			continue;
 		}
-		/* areal scale factor */
-		fac->s = (fac->der.y_p * fac->der.x_l - fac->der.x_p * fac->der.y_l) *
-			r / cosphi;
-		/* meridian-parallel angle theta prime */
-		fac->thetap = aasin(P->ctx,fac->s / (fac->h * fac->k));
-		/* Tissot ellips axis */
-		t = fac->k * fac->k + fac->h * fac->h;
-		fac->a = sqrt(t + 2. * fac->s);
-		t = (t = t - 2. * fac->s) <= 0. ? 0. : sqrt(t);
-		fac->b = 0.5 * (fac->a - t);
-		fac->a = 0.5 * (fac->a + t);
-		/* omega */
-		fac->omega = 2. * aasin(P->ctx,(fac->a - fac->b)/(fac->a + fac->b));
+		der[i].x_l = tx[0]; der[i].y_p = ty[0];
+		der[i].x_p = -tx[0]; der[i].y_l = -ty[0];
+		der[i].x_l += tx[1]; der[i].y_p -= ty[1];
+		der[i].x_p += tx[1]; der[i].y_l -= ty[1];
+		der[i].x_l -= tx[2]; der[i].y_p -= ty[2];
+		der[i].x_p += tx[2]; der[i].y_l += ty[2];
+		der[i].x_l -= tx[3]; der[i].y_p += ty[3];
+		der[i].x_p -= tx[3]; der[i].y_l += ty[3];
+		h4 = h2 + h2;
+		der[i].x_l /= h4;
+		der[i].y_p /= h4;
+		der[i].x_p /= h4;
+		der[i].y_l /= h4;
 	}
-	return 0;
+}
+	long /* pj_factors() of point_count points, returns the count failed */
+pj_factors_array(PJ *P, long point_count, int point_offset,
+		const double *lam, const double *phi, double h,
+		struct FACTORS *fac, int *failed) {
+	LP lp[FACTORS_CHUNK], dlp[FACTORS_CHUNK];
+	struct DERIVS der[FACTORS_CHUNK];
+	int bad[FACTORS_CHUNK], dbad[FACTORS_CHUNK], range_err = 0;
+	long base, i, n, nd, failures = 0;
+	double hn = h;
+
+	if (point_offset == 0)
+		point_offset = 1;
+	if (P->ctx->errno_globals)
+		errno = pj_errno = 0;
+	P->ctx->last_errno = 0;
+
+	for (base = 0; base < point_count; base += FACTORS_CHUNK) {
+		struct FACTORS *cf = fac + base;
+
+		n = point_count - base;
+		if (n > FACTORS_CHUNK)
+			n = FACTORS_CHUNK;
+
+		/* analytic values, and the points needing derivatives */
+		for (nd = i = 0; i < n; ++i) {
+			long io = (base + i) * point_offset;
+
+			lp[i].lam = lam[io];
+			lp[i].phi = phi[io];
+			hn = h;
+			cf[i].code = 0;
+			if ((bad[i] = factors_lp(lp + i, P, &hn)) != 0) {
+				range_err = 1;
+				continue;
+			}
+			if (P->spc)
+				P->spc(lp[i], P, cf + i);
+			if ((cf[i].code & FACTORS_ANAL) != FACTORS_ANAL) {
+				dlp[nd] = lp[i];
+				dbad[nd++] = 0;
+			}
+		}
+		if (nd > 0)
+			factors_deriv_n(P, nd, hn, dlp, der, dbad);
+
+		for (nd = i = 0; i < n; ++i) {
+			struct DERIVS *d = der + nd;
+
+			if (!bad[i] && (cf[i].code & FACTORS_ANAL) != FACTORS_ANAL)
+				bad[i] = dbad[nd++];
+			if (!bad[i])
+				factors_finish(lp[i], P, d, cf + i);
+			if (failed)
+				failed[base + i] = bad[i];
+			failures += bad[i];
+		}
+	}
+
+	if (range_err)
+		pj_ctx_set_errno(P->ctx, -14);
+	return failures;
 }
@@ -28,8 +28,25 @@
  * DEALINGS IN THE SOFTWARE.
  *****************************************************************************/
 
+#if !defined(_WIN32) && !defined(FILEMAP_stub)
+#  define FILEMAP_posix
+/* off_t of 64 bits for pread() and mmap() on 32 bit systems too */
+#  ifndef _FILE_OFFSET_BITS
+#    define _FILE_OFFSET_BITS 64
+#  endif
+#endif
+
 #include <projects.h>
 #include <string.h>
+#include <limits.h>
+
+#ifdef FILEMAP_posix
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#  include <errno.h>
+#endif
 
 PJ_CVSID("$Id$");
 
@@ -54,6 +71,33 @@ typedef struct {
     FILE *fp;
 } stdio_pafile;
 
+#ifdef FILEMAP_posix
+static void *pj_stdio_fmap(PAFile file, long offset, size_t size, 
+                           void **handle);
+static void pj_stdio_funmap(void *handle);
+static size_t pj_stdio_fread_at(PAFile file, void *buffer, size_t size, 
+                                projFileOffset offset);
+static void *pj_stdio_fmap_at(PAFile file, projFileOffset offset, 
+                              size_t size, void **handle);
+
+static projFileMapAPI default_filemapapi = {
+    pj_stdio_fmap,
+    pj_stdio_funmap
+};
+
+static projFileAPIEx default_fileapi_ex = {
+    PJ_FILEAPI_EX_VERSION,
+    pj_stdio_fread_at,
+    pj_stdio_fmap_at,
+    pj_stdio_funmap
+};
+
+typedef struct {
+    void   *base;
+    size_t length;
+} stdio_mapping;
+#endif
+
 /************************************************************************/
 /*                       pj_get_default_fileapi()                       */
 /************************************************************************/
@@ -63,6 +107,37 @@ projFileAPI *pj_get_default_fileapi()
     return &default_fileapi;
 }
 
+/************************************************************************/
+/*                     pj_get_default_filemapapi()                      */
+/*                                                                      */
+/*      Returns NULL on platforms where mapping is not supported.       */
+/************************************************************************/
+
+projFileMapAPI *pj_get_default_filemapapi() 
+{
+#ifdef FILEMAP_posix
+    return &default_filemapapi;
+#else
+    return NULL;
+#endif
+}
+
+/************************************************************************/
+/*                     pj_get_default_fileapi_ex()                      */
+/*                                                                      */
+/*      The positional read and mapping hooks of the default file       */
+/*      api, or NULL on platforms without them.                         */
+/************************************************************************/
+
+projFileAPIEx *pj_get_default_fileapi_ex() 
+{
+#ifdef FILEMAP_posix
+    return &default_fileapi_ex;
+#else
+    return NULL;
+#endif
+}
+
 /************************************************************************/
 /*                           pj_stdio_fopen()                           */
 /************************************************************************/
@@ -124,6 +199,109 @@ static void pj_stdio_fclose(PAFile file)
     free(pafile);
 }
 
+#ifdef FILEMAP_posix
+/************************************************************************/
+/*                          pj_stdio_fmap_at()                          */
+/*                                                                      */
+/*      Map from the page holding offset, as mmap() offsets have to     */
+/*      be page aligned.                                                */
+/************************************************************************/
+static void *pj_stdio_fmap_at(PAFile file, projFileOffset offset, 
+                              size_t size, void **handle)
+{
+    stdio_pafile *pafile = (stdio_pafile *) file;
+    stdio_mapping *mapping;
+    struct stat st;
+    long page = sysconf(_SC_PAGESIZE);
+    size_t head;
+    void *base;
+
+    /* touching pages past the end of file would raise SIGBUS */
+    if (fstat(fileno(pafile->fp), &st) != 0 || page <= 0
+        || offset < 0 || (projFileOffset) (off_t) offset != offset
+        || (projFileOffset) st.st_size - offset < (projFileOffset) size)
+    {
+        return NULL;
+    }
+
+    head = (size_t) (offset % page);
+    if (size > (size_t) -1 - head)
+    {
+        return NULL;
+    }
+
+    base = mmap(NULL, head + size, PROT_READ, MAP_SHARED, 
+                fileno(pafile->fp), (off_t) (offset - head));
+    if (base == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    mapping = (stdio_mapping *) malloc(sizeof(stdio_mapping));
+    if (mapping == NULL)
+    {
+        munmap(base, head + size);
+        return NULL;
+    }
+    mapping->base = base;
+    mapping->length = head + size;
+    *handle = mapping;
+
+    return ((char *) base) + head;
+}
+
+/************************************************************************/
+/*                           pj_stdio_fmap()                            */
+/************************************************************************/
+static void *pj_stdio_fmap(PAFile file, long offset, size_t size,
+                           void **handle)
+{
+    return pj_stdio_fmap_at(file, offset, size, handle);
+}
+
+/************************************************************************/
+/*                         pj_stdio_fread_at()                          */
+/*                                                                      */
+/*      pread() leaves the position of the stream alone, and the        */
+/*      data buffered by stdio is only ever read, so both can be        */
+/*      used on the same file.                                          */
+/************************************************************************/
+static size_t pj_stdio_fread_at(PAFile file, void *buffer, size_t size, 
+                                projFileOffset offset)
+{
+    stdio_pafile *pafile = (stdio_pafile *) file;
+    size_t done = 0;
+
+    if (offset < 0 || (projFileOffset) (off_t) offset != offset)
+    {
+        return 0;
+    }
+
+    while (done < size)
+    {
+        ssize_t n = pread(fileno(pafile->fp), (char *) buffer + done, 
+                          size - done, (off_t) (offset + done));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
+    }
+
+    return done;
+}
+
+/************************************************************************/
+/*                          pj_stdio_funmap()                           */
+/************************************************************************/
+static void pj_stdio_funmap(void *handle)
+{
+    stdio_mapping *mapping = (stdio_mapping *) handle;
+    munmap(mapping->base, mapping->length);
+    free(mapping);
+}
+#endif /* def FILEMAP_posix */
+
 /************************************************************************/
 /*                            pj_ctx_fopen()                            */
 /*                                                                      */
@@ -167,6 +345,101 @@ void   pj_ctx_fclose(projCtx ctx, PAFile file)
     ctx->fileapi->FClose(file);
 }
 
+/************************************************************************/
+/*                            pj_ctx_fmap()                             */
+/*                                                                      */
+/*      Map part of an open file read-only, if the context has          */
+/*      mapping hooks.  Returns NULL if the caller should read the      */
+/*      data instead.                                                   */
+/************************************************************************/
+void *pj_ctx_fmap(projCtx ctx, PAFile file, long offset, size_t size,
+                  void **handle)
+{
+    if (ctx->filemapapi == NULL || ctx->filemapapi->FMap == NULL)
+        return NULL;
+    return ctx->filemapapi->FMap(file, offset, size, handle);
+}
+
+/************************************************************************/
+/*                          pj_ctx_fmap_at()                            */
+/*                                                                      */
+/*      pj_ctx_fmap() at any offset the file hooks can address, with    */
+/*      the extended hooks if the context has them.  *unmap is set to   */
+/*      the function releasing the mapping with *handle.                */
+/************************************************************************/
+void *pj_ctx_fmap_at(projCtx ctx, PAFile file, projFileOffset offset, 
+                     size_t size, void **handle, void (**unmap)(void *))
+{
+    projFileAPIEx *ex = ctx->fileapi_ex;
+    void *data;
+
+    if (ex != NULL && ex->FMap != NULL && ex->FUnmap != NULL)
+    {
+        data = ex->FMap(file, offset, size, handle);
+        *unmap = ex->FUnmap;
+        return data;
+    }
+
+    if (ctx->filemapapi == NULL || ctx->filemapapi->FMap == NULL 
+        || offset < 0 || offset > LONG_MAX)
+        return NULL;
+    *unmap = ctx->filemapapi->FUnmap;
+    return ctx->filemapapi->FMap(file, (long) offset, size, handle);
+}
+
+/************************************************************************/
+/*                          pj_ctx_fread_at()                           */
+/*                                                                      */
+/*      Read up to size bytes at offset, returning how many were.       */
+/*      Without an FReadAt hook this seeks and reads, so it then        */
+/*      moves the position of the file, is limited to offsets of a      */
+/*      long, and the file must not be shared with other threads.       */
+/************************************************************************/
+size_t pj_ctx_fread_at(projCtx ctx, PAFile file, void *buffer, size_t size,
+                       projFileOffset offset)
+{
+    projFileAPIEx *ex = ctx->fileapi_ex;
+
+    if (ex != NULL && ex->FReadAt != NULL)
+        return ex->FReadAt(file, buffer, size, offset);
+
+    if (offset < 0 || offset > LONG_MAX 
+        || pj_ctx_fseek(ctx, file, (long) offset, SEEK_SET) != 0)
+        return 0;
+    return pj_ctx_fread(ctx, buffer, 1, size, file);
+}
+
+/************************************************************************/
+/*                          pj_ctx_fidentity()                          */
+/*                                                                      */
+/*      The device, inode, size and time of last change of a file       */
+/*      opened with the default file api, telling whether two           */
+/*      processes opened the same file.  Returns FALSE for files of     */
+/*      other apis, and on platforms without fstat().                   */
+/************************************************************************/
+int pj_ctx_fidentity(projCtx ctx, PAFile file, double id[4])
+{
+#ifdef FILEMAP_posix
+    stdio_pafile *pafile = (stdio_pafile *) file;
+    struct stat st;
+
+    if (ctx->fileapi != &default_fileapi 
+        || fstat(fileno(pafile->fp), &st) != 0)
+        return 0;
+
+    id[0] = (double) st.st_dev;
+    id[1] = (double) st.st_ino;
+    id[2] = (double) st.st_size;
+    id[3] = (double) st.st_mtime;
+    return 1;
+#else
+    (void) ctx;
+    (void) file;
+    (void) id;
+    return 0;
+#endif
+}
+
 /************************************************************************/
 /*                            pj_ctx_fgets()                            */
 /*                                                                      */
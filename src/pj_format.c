@@ -0,0 +1,172 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Fast fixed precision formatting of numbers for the text output
+ *           of the programs, giving the same result as printf().
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** The value is scaled by a power of ten and rounded to an integer.  The
+** scaling is exact to within half a unit in the last place, which below
+** 2^44 is less than 2^-9, so the rounding is that of the exact value
+** unless the scaled value is very close to a half.  Those, and values
+** out of range, are left to sprintf().
+*/
+#define FIXED_PRECISION_MAX 17
+#define FIXED_SCALED_MAX    17592186044416.0   /* 2^44 */
+#define FIXED_TIE_MARGIN    (1.0 / 128)
+
+static const double powers_of_ten[FIXED_PRECISION_MAX+1] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17
+};
+
+/************************************************************************/
+/*                          pj_format_fixed()                           */
+/*                                                                      */
+/*      Format value as printf("%.*f") does in the "C" locale, and      */
+/*      return the end of the string.  buf must hold the result,        */
+/*      which may be long for large values as with sprintf().           */
+/************************************************************************/
+
+char *pj_format_fixed( char *buf, double value, int precision )
+
+{
+    double scaled, rounded, frac, high;
+    unsigned long high_part, low_part;
+    char digits[32];
+    int digit_count = 0, negative = 0, i;
+    char *out = buf;
+
+    if( precision < 0 || precision > FIXED_PRECISION_MAX )
+        goto fallback;
+
+    if( value < 0.0 )
+    {
+        negative = 1;
+        value = -value;
+    }
+    else if( value == 0.0 && 1.0 / value < 0.0 )
+        negative = 1; /* -0.0 */
+
+    /* also false for nan and infinity */
+    scaled = value * powers_of_ten[precision];
+    if( !(scaled < FIXED_SCALED_MAX) )
+        goto fallback;
+
+    rounded = floor(scaled);
+    frac = scaled - rounded;
+    if( fabs(frac - 0.5) < FIXED_TIE_MARGIN )
+        goto fallback;
+    if( frac > 0.5 )
+        rounded += 1.0;
+
+/* -------------------------------------------------------------------- */
+/*      Collect the digits, least significant first, from two parts     */
+/*      that fit in an unsigned long.                                   */
+/* -------------------------------------------------------------------- */
+    high = floor(rounded / 1e8);
+    high_part = (unsigned long) high;
+    low_part = (unsigned long) (rounded - high * 1e8);
+
+    do {
+        digits[digit_count++] = (char) ('0' + low_part % 10);
+        low_part /= 10;
+    } while( low_part != 0 );
+
+    if( high_part != 0 )
+    {
+        while( digit_count < 8 )
+            digits[digit_count++] = '0';
+        do {
+            digits[digit_count++] = (char) ('0' + high_part % 10);
+            high_part /= 10;
+        } while( high_part != 0 );
+    }
+
+    while( digit_count <= precision )
+        digits[digit_count++] = '0';
+
+/* -------------------------------------------------------------------- */
+/*      Write them out with the decimal point.                          */
+/* -------------------------------------------------------------------- */
+    if( negative )
+        *out++ = '-';
+    for( i = digit_count - 1; i >= precision; i-- )
+        *out++ = digits[i];
+    if( precision > 0 )
+    {
+        *out++ = '.';
+        for( ; i >= 0; i-- )
+            *out++ = digits[i];
+    }
+    *out = '\0';
+
+    return out;
+
+  fallback:
+    sprintf( buf, "%.*f", precision, negative ? -value : value );
+    return buf + strlen(buf);
+}
+
+/************************************************************************/
+/*                          pj_format_double()                          */
+/*                                                                      */
+/*      sprintf() of a single double, through pj_format_fixed() for     */
+/*      the plain "%f" and "%.<n>f" formats.  Returns the end of the    */
+/*      string.                                                         */
+/************************************************************************/
+
+char *pj_format_double( char *buf, const char *format, double value )
+
+{
+    const char *f = format;
+    int precision = 6;
+
+    if( *f++ == '%' )
+    {
+        if( *f == '.' )
+        {
+            f++;
+            for( precision = 0; *f >= '0' && *f <= '9' && precision < 100;
+                 f++ )
+                precision = precision * 10 + (*f - '0');
+        }
+        if( f[0] == 'f' && f[1] == '\0' )
+            return pj_format_fixed( buf, value, precision );
+    }
+
+    sprintf( buf, format, value );
+    return buf + strlen(buf);
+}
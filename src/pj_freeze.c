@@ -0,0 +1,226 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Sharing of a definition between threads, each passing its own
+ *           context to the transformations.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <string.h>
+#include <errno.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** A frozen definition is never written by a transformation.  Each call
+** runs over views of it, copies of the PJ with the members of its
+** projection, struct_size bytes, and of its PJ_COLD, bound to the
+** context of the call.  The views share everything the PJ points to,
+** which stays as it was, and keep their own copy of what the shifts
+** remember between points, the last grid and the last grids of a
+** catalog.  That is why the lists the shifts would otherwise look up on
+** first use are looked up when freezing.
+*/
+
+/************************************************************************/
+/*                             pj_freeze()                              */
+/*                                                                      */
+/*      Look up the grids, or the catalog, and the geoid grids of a     */
+/*      definition, binding them to the grid registry of its context,   */
+/*      and mark it as shareable.  It may then be passed to             */
+/*      pj_transform_ctx() from any number of threads at once, but      */
+/*      must not be passed to the functions using its own context, or   */
+/*      changed, meanwhile.  Returns 0, or the error of a required      */
+/*      grid that cannot be opened, the definition staying as it was.   */
+/************************************************************************/
+
+int pj_freeze( projPJ P )
+
+{
+    projCtx ctx;
+
+    if( P == NULL )
+        return -1;
+
+    ctx = pj_get_ctx( P );
+    ctx->last_errno = 0;
+
+    pj_grid_registry_of( P );
+
+    if( P->cold->datum_type == PJD_GRIDSHIFT )
+        pj_apply_gridshift_t( P, 0, 0, 1, NULL, NULL, NULL, NULL );
+    if( ctx->last_errno == 0 && P->cold->has_geoid_vgrids )
+        pj_apply_vgridshift( P, "sgeoidgrids", &(P->cold->vgridlist_geoid),
+                             &(P->cold->vgridlist_geoid_count), 0, 0, 1,
+                             NULL, NULL, NULL, NULL );
+    if( ctx->last_errno != 0 )
+        return ctx->last_errno;
+
+    /* those the transformations look up, so that they are already
+       marked as used */
+    pj_param( ctx, P->params, "snadgrids" );
+    pj_param( ctx, P->params, "sgeoidgrids" );
+    pj_param( ctx, P->params, "sproj" );
+
+    if( P->link != NULL )
+        P->link->frozen = 1;
+    P->frozen = 1;
+
+    return 0;
+}
+
+/************************************************************************/
+/*                              pj_view()                               */
+/************************************************************************/
+
+static PJ *pj_view( projCtx ctx, PJ *P )
+
+{
+    PJ *view = (PJ *) pj_malloc( PJ_ALLOC_SIZE(P->struct_size) );
+
+    if( view == NULL )
+        return NULL;
+
+    memcpy( view, P, P->struct_size );
+    view->cold = (PJ_COLD *) ((char *) view
+                              + PJ_COLD_OFFSET(P->struct_size));
+    memcpy( view->cold, P->cold, sizeof(PJ_COLD) );
+    view->ctx = ctx;
+    view->cold->gc_blends = NULL; /* its own */
+    if( P->link != NULL && (view->link = pj_view( ctx, P->link )) == NULL )
+    {
+        pj_dalloc( view );
+        return NULL;
+    }
+
+    return view;
+}
+
+/************************************************************************/
+/*                           pj_view_free()                             */
+/*                                                                      */
+/*      Free a view, with the lists it looked up itself, those of       */
+/*      optional grids all missing when freezing, and its blends of     */
+/*      catalog grids.                                                  */
+/************************************************************************/
+
+static void pj_view_free( PJ *view, PJ *P )
+
+{
+    if( view->link != NULL )
+        pj_view_free( view->link, P->link );
+    if( view->cold->gridlist != P->cold->gridlist )
+        pj_dalloc( view->cold->gridlist );
+    if( view->cold->vgridlist_geoid != P->cold->vgridlist_geoid )
+        pj_dalloc( view->cold->vgridlist_geoid );
+    pj_gc_blend_free( view );
+    pj_dalloc( view );
+}
+
+/************************************************************************/
+/*                        pj_transform_views()                          */
+/************************************************************************/
+
+static long pj_transform_views( projCtx ctx, PJ *src, PJ *dst,
+                                long point_count, int point_offset,
+                                double *x, double *y, double *z,
+                                int *status )
+
+{
+    PJ   *vsrc, *vdst;
+    long result;
+
+    if( ctx == NULL )
+        ctx = pj_get_default_ctx();
+
+    if( !src->frozen || !dst->frozen )
+    {
+        pj_ctx_set_errno( ctx, PJD_ERR_NOT_FROZEN );
+        return PJD_ERR_NOT_FROZEN;
+    }
+
+    vsrc = pj_view( ctx, src );
+    vdst = dst == src ? vsrc : pj_view( ctx, dst );
+    if( vsrc == NULL || vdst == NULL )
+    {
+        if( vsrc != NULL )
+            pj_view_free( vsrc, src );
+        if( vdst != NULL )
+            pj_view_free( vdst, dst );
+        pj_ctx_set_errno( ctx, ENOMEM );
+        return ENOMEM;
+    }
+
+    if( status != NULL )
+        result = pj_transform_status( vsrc, vdst, point_count, point_offset,
+                                      x, y, z, status );
+    else
+        result = pj_transform( vsrc, vdst, point_count, point_offset,
+                               x, y, z );
+
+    if( vdst != vsrc )
+        pj_view_free( vdst, dst );
+    pj_view_free( vsrc, src );
+
+    return result;
+}
+
+/************************************************************************/
+/*                          pj_transform_ctx()                          */
+/*                                                                      */
+/*      pj_transform() between definitions frozen with pj_freeze(),     */
+/*      with ctx, NULL for the default one, in place of their own       */
+/*      contexts, for its settings and errors.  Their grids still       */
+/*      come from the registry they were frozen with.  Fails with       */
+/*      PJD_ERR_NOT_FROZEN if either is not frozen.  Contexts used      */
+/*      from several threads at once should have their errno globals    */
+/*      turned off with pj_ctx_set_errno_globals().                     */
+/************************************************************************/
+
+int pj_transform_ctx( projCtx ctx, projPJ src, projPJ dst,
+                      long point_count, int point_offset,
+                      double *x, double *y, double *z )
+
+{
+    return (int) pj_transform_views( ctx, src, dst, point_count,
+                                     point_offset, x, y, z, NULL );
+}
+
+/************************************************************************/
+/*                       pj_transform_status_ctx()                      */
+/*                                                                      */
+/*      pj_transform_status() as pj_transform_ctx().                    */
+/************************************************************************/
+
+long pj_transform_status_ctx( projCtx ctx, projPJ src, projPJ dst,
+                              long point_count, int point_offset,
+                              double *x, double *y, double *z, int *status )
+
+{
+    return pj_transform_views( ctx, src, dst, point_count, point_offset,
+                               x, y, z, status );
+}
@@ -14,8 +14,10 @@ pj_fwd(LP lp, PJ *P) {
 		pj_ctx_set_errno( P->ctx, -14);
 	} else { /* proceed with projection */
                 P->ctx->last_errno = 0;
-                pj_errno = 0;
-                errno = 0;
+                if (P->ctx->errno_globals) {
+                        pj_errno = 0;
+                        errno = 0;
+                }
 
 		if (fabs(t) <= EPS)
 			lp.phi = lp.phi < 0. ? -HALFPI : HALFPI;
@@ -35,3 +37,156 @@ pj_fwd(LP lp, PJ *P) {
 	}
 	return xy;
 }
+
+/************************************************************************/
+/*                           pj_fwd_kernel()                            */
+/*                                                                      */
+/*      Run the forward projection of P over an array of points        */
+/*      normalized as for P->fwd, with its array kernel if it has one.  */
+/*      Failed points are set to HUGE_VAL and the error of the last    */
+/*      failed point is returned.                                      */
+/************************************************************************/
+
+	int
+pj_fwd_kernel(PJ *P, long n, int point_offset, double *x, double *y) {
+	long i;
+	int err = 0;
+
+	if (P->fwd_n)
+		return (*P->fwd_n)(P, n, point_offset, x, y);
+
+	for (i = 0; i < n; i++) {
+		long io = i * point_offset;
+		LP lp;
+		XY xy;
+
+		if (x[io] == HUGE_VAL)
+			continue;
+		lp.lam = x[io];
+		lp.phi = y[io];
+		xy = (*P->fwd)(lp, P);
+		if (P->ctx->last_errno) {
+			err = P->ctx->last_errno;
+			P->ctx->last_errno = 0;
+			xy.x = xy.y = HUGE_VAL;
+		}
+		x[io] = xy.x;
+		y[io] = xy.y;
+	}
+	return err;
+}
+
+/************************************************************************/
+/*                            pj_fwd_array()                            */
+/*                                                                      */
+/*      Forward project an array of points in place.  Longitudes and   */
+/*      latitudes are in radians.  Points with x already HUGE_VAL are  */
+/*      skipped, failed points are set to HUGE_VAL and the error of    */
+/*      the last failed point is returned.                             */
+/************************************************************************/
+
+	int
+pj_fwd_array(PJ *P, long point_count, int point_offset, double *x, double *y) {
+	return pj_fwd_array_steps(P, point_count, point_offset, x, y, NULL, NULL);
+}
+
+/************************************************************************/
+/*                         pj_fwd_array_steps()                         */
+/*                                                                      */
+/*      pj_fwd_array(), with the prime meridian of steps taken off     */
+/*      the longitudes first, and its axis and z scale applied to the  */
+/*      results, as the pj_transform() stages would, while the points  */
+/*      of a chunk are at hand.  z may be NULL, as may steps.          */
+/************************************************************************/
+
+	int
+pj_fwd_array_steps(PJ *P, long point_count, int point_offset, double *x,
+                   double *y, double *z, const PJ_ARRAY_STEPS *steps) {
+	long i, base, n, chunk;
+	int err = 0, kerr;
+	double pm = steps ? steps->pm : 0.;
+
+	if (point_offset == 0)
+		point_offset = 1;
+
+	P->ctx->last_errno = 0;
+	if (P->ctx->errno_globals) {
+		pj_errno = 0;
+		errno = 0;
+	}
+
+	/* points run together, see pj_ctx_set_array_chunk() */
+	chunk = P->ctx->array_chunk > 0 ? P->ctx->array_chunk
+	                                : PJ_ARRAY_DEFAULT_CHUNK;
+
+	for (base = 0; base < point_count; base += chunk) {
+		double *cx = x + base * point_offset;
+		double *cy = y + base * point_offset;
+		double *cz = z && steps && steps->z_scale != 1. ?
+			z + base * point_offset : NULL;
+
+		n = point_count - base;
+		if (n > chunk)
+			n = chunk;
+
+		/* range check and normalize as pj_fwd() does */
+		for (i = 0; i < n; i++) {
+			long io = i * point_offset;
+			double t;
+
+			if (cx[io] == HUGE_VAL) /* already failed */
+				continue;
+			if (pm != 0.)
+				cx[io] -= pm;
+			t = fabs(cy[io]) - HALFPI;
+			if (t > EPS || fabs(cx[io]) > 10.) {
+				cx[io] = cy[io] = HUGE_VAL;
+				err = -14;
+				continue;
+			}
+			if (fabs(t) <= EPS)
+				cy[io] = cy[io] < 0. ? -HALFPI : HALFPI;
+			else if (P->geoc)
+				cy[io] = atan(P->rone_es * tan(cy[io]));
+			cx[io] -= P->lam0;
+		}
+		if (!P->over)
+			adjlon_n(n, point_offset, cx);
+
+		/* project */
+		if ((kerr = pj_fwd_kernel(P, n, point_offset, cx, cy)) != 0)
+			err = kerr;
+
+		/* adjust for major axis and easting/northings */
+		if (steps == NULL)
+			for (i = 0; i < n; i++) {
+				long io = i * point_offset;
+
+				if (cx[io] == HUGE_VAL)
+					continue;
+				cx[io] = P->fr_meter * (P->a * cx[io] + P->x0);
+				cy[io] = P->fr_meter * (P->a * cy[io] + P->y0);
+			}
+		else
+			/* and to the axis, which also turns failed points */
+			for (i = 0; i < n; i++) {
+				long io = i * point_offset;
+				double X = cx[io], Y = cy[io];
+
+				if (X != HUGE_VAL) {
+					X = P->fr_meter * (P->a * X + P->x0);
+					Y = P->fr_meter * (P->a * Y + P->y0);
+				}
+				cx[io] = steps->x_sign * (steps->axis_swap ? Y : X);
+				cy[io] = steps->y_sign * (steps->axis_swap ? X : Y);
+				if (cz)
+					cz[io] *= steps->z_scale;
+			}
+	}
+
+	if (err)
+		pj_ctx_set_errno(P->ctx, err);
+	else
+		P->ctx->last_errno = 0;
+	return err;
+}
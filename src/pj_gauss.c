@@ -30,11 +30,20 @@ LIBPROJ_ID[] = "$Id$";
 
 #define MAX_ITER 20
 
+/*
+** The inverse starts from the series of the geodetic in the conformal
+** latitude, to the eighth power of e, and then iterates as before.  The
+** error of the series start is about e^10, and each iteration cuts it
+** by about es, so that two or three iterations reach DEL_TOL where the
+** spherical start took seven or more.
+*/
 struct GAUSS {
 	double C;
 	double K;
 	double e;
 	double ratexp;
+	double rC;      /* 1 / C */
+	double chi[4];  /* sin 2k chi coefficients of the series start */
 };
 #define EN ((struct GAUSS *)en)
 #define DEL_TOL 1e-14
@@ -45,7 +54,7 @@ srat(double esinp, double exp) {
 
 	void *
 pj_gauss_ini(double e, double phi0, double *chi, double *rc) {
-	double sphi, cphi, es;
+	double sphi, cphi, es, es2, es3, es4;
 	struct GAUSS *en;
 
 	if ((en = (struct GAUSS *)malloc(sizeof(struct GAUSS))) == NULL)
@@ -61,34 +70,94 @@ pj_gauss_ini(double e, double phi0, double *chi, double *rc) {
 	EN->K = tan(.5 * *chi + FORTPI) / (
 		pow(tan(.5 * phi0 + FORTPI), EN->C) *
 		srat(EN->e * sphi, EN->ratexp)  );
+	EN->rC = 1. / EN->C;
+	es2 = es * es; es3 = es2 * es; es4 = es3 * es;
+	EN->chi[0] = es / 2. + 5. * es2 / 24. + es3 / 12. + 13. * es4 / 360.;
+	EN->chi[1] = 7. * es2 / 48. + 29. * es3 / 240. + 811. * es4 / 11520.;
+	EN->chi[2] = 7. * es3 / 120. + 81. * es4 / 1120.;
+	EN->chi[3] = 4279. * es4 / 161280.;
 	return ((void *)en);
+}
+	static PJ_INLINE double
+gauss_phi(double phi, const struct GAUSS *g) {
+	return 2. * atan( g->K *
+		pow(tan(.5 * phi + FORTPI), g->C) *
+		srat(g->e * sin(phi), g->ratexp) ) - HALFPI;
 }
 	LP
 pj_gauss(projCtx ctx, LP elp, const void *en) {
 	LP slp;
 
-	slp.phi = 2. * atan( EN->K *
-		pow(tan(.5 * elp.phi + FORTPI), EN->C) *
-		srat(EN->e * sin(elp.phi), EN->ratexp) ) - HALFPI;
+	slp.phi = gauss_phi(elp.phi, EN);
 	slp.lam = EN->C * (elp.lam);
 	return(slp);
 }
-	LP
-pj_inv_gauss(projCtx ctx, LP slp, const void *en) {
-	LP elp;
-	double num;
+	static PJ_INLINE int /* 0, or -17 if the iteration did not converge */
+inv_gauss_phi(double *phi, const struct GAUSS *g) {
+	double num, chi, c2, h = 0., h1 = 0., t, sphi;
 	int i;
 
-	elp.lam = slp.lam / EN->C;
-	num = pow(tan(.5 * slp.phi + FORTPI)/EN->K, 1./EN->C);
+	num = pow(tan(.5 * *phi + FORTPI) / g->K, g->rC);
+	chi = 2. * atan(num) - HALFPI;
+	c2 = 2. * cos(2. * chi);
+	for (i = 3; i >= 0; --i) {
+		t = h;
+		h = c2 * h - h1 + g->chi[i];
+		h1 = t;
+	}
+	sphi = chi + sin(2. * chi) * h;
 	for (i = MAX_ITER; i; --i) {
-		elp.phi = 2. * atan(num * srat(EN->e * sin(slp.phi), -.5 * EN->e))
+		*phi = 2. * atan(num * srat(g->e * sin(sphi), -.5 * g->e))
 			- HALFPI;
-		if (fabs(elp.phi - slp.phi) < DEL_TOL) break;
-			slp.phi = elp.phi;
-	}	
+		if (fabs(*phi - sphi) < DEL_TOL) break;
+			sphi = *phi;
+	}
 	/* convergence failed */
-	if (!i)
+	return i ? 0 : -17;
+}
+	LP
+pj_inv_gauss(projCtx ctx, LP slp, const void *en) {
+	LP elp;
+
+	elp.lam = slp.lam / EN->C;
+	elp.phi = slp.phi;
+	if (inv_gauss_phi(&elp.phi, EN))
 		pj_ctx_set_errno( ctx, -17 );
 	return (elp);
 }
+
+/*
+** The array versions map n points, lam[i * stride] and phi[i * stride],
+** in place, skipping those with lam HUGE_VAL.  Failed points are set to
+** HUGE_VAL and the error of the last of them is returned.
+*/
+	int
+pj_gauss_array(projCtx ctx, long n, int stride, double *lam, double *phi,
+               const void *en) {
+	long i, io;
+
+	(void) ctx;
+	for (i = io = 0; i < n; ++i, io += stride)
+		if (lam[io] != HUGE_VAL) {
+			phi[io] = gauss_phi(phi[io], EN);
+			lam[io] = EN->C * lam[io];
+		}
+	return 0;
+}
+	int
+pj_inv_gauss_array(projCtx ctx, long n, int stride, double *lam, double *phi,
+                   const void *en) {
+	long i, io;
+	int err = 0;
+
+	(void) ctx;
+	for (i = io = 0; i < n; ++i, io += stride)
+		if (lam[io] != HUGE_VAL) {
+			if (inv_gauss_phi(phi + io, EN)) {
+				lam[io] = phi[io] = HUGE_VAL;
+				err = -17;
+			} else
+				lam[io] = lam[io] / EN->C;
+		}
+	return err;
+}
@@ -2,7 +2,8 @@
  * $Id$
  *
  * Project:  PROJ.4
- * Purpose:  Code to read a grid catalog from a .cvs file.
+ * Purpose:  Code to read a grid catalog from a .cvs file, or from its
+ *           binary form.
  * Author:   Frank Warmerdam, warmerdam@pobox.com
  *
  ******************************************************************************
@@ -32,53 +33,205 @@
 #include <projects.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
 
-static int pj_gc_readentry(projCtx ctx, PAFile fid, PJ_GridCatalogEntry *entry);
+/*
+** A binary catalog, as written by pj_gc_writecatalog() for
+** "nad2bin -f catalog -i catalog.csv catalog.csv.bin", holds the entries
+** of a csv catalog already parsed, with their bin and date indexes, in
+** the native layout and byte order so that it is used straight from a
+** memory mapping of the file.  pj_gc_readcatalog() uses <catalog>.bin
+** when it is found, and valid for the csv text: as the file api gives
+** no modification times, the binary records the size and checksum of
+** the text it was made from, so the csv is still read, but only parsed
+** if it has changed since, or if there is no valid binary.
+**
+**     header, entry_count entries, date_count dates, nx*ny+1 bin
+**     starts, member_count bin members, and strings_size bytes of nul
+**     terminated definitions.
+*/
+
+#define GC_BINARY_MAGIC   "PROJ GRID CATLG1"
+#define GC_BINARY_SUFFIX  ".bin"
+#define GC_BINARY_MAX_BINS 4096       /* along either axis */
+
+typedef struct {
+    char   magic[16];           /* GC_BINARY_MAGIC */
+    int    byte_order;          /* PJ_GRID_CACHE_BYTE_ORDER */
+    int    entry_count;
+    unsigned int source_checksum; /* pj_grid_checksum() of the csv text */
+    unsigned int body_checksum; /* of all that follows the header */
+    double source_size;         /* csv text size in bytes */
+    PJ_Region region;           /* of the catalog */
+    LP     ll;                  /* origin and size of the bins */
+    LP     del;
+    int    nx, ny;              /* zero if there is no index */
+    int    member_count;
+    int    date_count;
+    int    strings_size;
+    int    reserved;
+} GC_BINARY_HEADER;
+
+typedef struct {
+    PJ_Region region;
+    double date;
+    int    priority;
+    int    definition;          /* offset in the strings */
+} GC_BINARY_ENTRY;
+
+static int pj_gc_readentry( projCtx ctx, const char **next, const char *end,
+                            PJ_GridCatalogEntry *entry );
 static void pj_gc_sortcatalog( projCtx ctx, PJ_GridCatalog *catalog );
 
 /************************************************************************/
-/*                         pj_gc_readcatalog()                          */
+/*                          pj_gc_newcatalog()                          */
 /*                                                                      */
-/*      Read a grid catalog from a .csv file.                           */
+/*      An empty catalog with room for entry_max entries.               */
 /************************************************************************/
 
-PJ_GridCatalog *pj_gc_readcatalog( projCtx ctx, const char *catalog_name )
+static PJ_GridCatalog *pj_gc_newcatalog( projCtx ctx, 
+                                         const char *catalog_name,
+                                         int entry_max )
+
 {
-    PAFile fid;
     PJ_GridCatalog *catalog;
-    int entry_max;
-    char line[302];
+
+    catalog = (PJ_GridCatalog *) pj_ctx_malloc(ctx, sizeof(PJ_GridCatalog));
+    if( !catalog )
+        return NULL;
+    memset( catalog, 0, sizeof(PJ_GridCatalog) );
+    catalog->allocator = ctx->allocator;
     
-    fid = pj_open_lib( ctx, (char *) catalog_name, "r" );
-    if (fid == NULL) 
+    catalog->catalog_name = pj_ctx_strdup(ctx, catalog_name);
+    catalog->entries = (PJ_GridCatalogEntry *) 
+        pj_ctx_malloc(ctx, entry_max * sizeof(PJ_GridCatalogEntry));
+    if( catalog->catalog_name == NULL || catalog->entries == NULL )
+    {
+        pj_gc_free_catalog( catalog );
         return NULL;
+    }
 
-    /* discard title line */
-    pj_ctx_fgets(ctx, line, sizeof(line)-1, fid);
+    return catalog;
+}
 
-    catalog = (PJ_GridCatalog *) calloc(1,sizeof(PJ_GridCatalog));
-    if( !catalog )
+/************************************************************************/
+/*                           pj_gc_readtext()                           */
+/*                                                                      */
+/*      All of a file, in a buffer to free with pj_dalloc().            */
+/************************************************************************/
+
+static char *pj_gc_readtext( projCtx ctx, PAFile fid, size_t *size )
+
+{
+    char  *text = NULL;
+    size_t alloc = 0, got;
+
+    *size = 0;
+    do
+    {
+        if( *size + 65536 > alloc )
+        {
+            char *grown;
+
+            alloc = alloc * 2 + 65536;
+            grown = (char *) pj_malloc( alloc );
+            if( grown == NULL )
+            {
+                pj_dalloc( text );
+                return NULL;
+            }
+            if( *size > 0 )
+                memcpy( grown, text, *size );
+            pj_dalloc( text );
+            text = grown;
+        }
+        got = pj_ctx_fread( ctx, text + *size, 1, alloc - *size, fid );
+        *size += got;
+    } while( got > 0 );
+
+    return text;
+}
+
+/************************************************************************/
+/*                            pj_gc_gets()                              */
+/*                                                                      */
+/*      The next line of the text, as pj_ctx_fgets() would read it      */
+/*      from the file into a buffer of 301 bytes.                       */
+/************************************************************************/
+
+static char *pj_gc_gets( char *line, const char **next, const char *end )
+
+{
+    const char *p = *next;
+    size_t n = end - p, i;
+
+    if( n == 0 )
         return NULL;
+    if( n > 300 )
+        n = 300;
+
+    for( i = 0; i < n && i < 299; i++ )
+    {
+        if( p[i] == '\n' )
+        {
+            n = i + 1;
+            break;
+        }
+    }
+
+    memcpy( line, p, n );
+    line[n] = '\0';
+    *next = p + n;
+
+    return line;
+}
+
+/************************************************************************/
+/*                          pj_gc_parse_csv()                           */
+/*                                                                      */
+/*      The catalog of the text of a .csv file.                         */
+/************************************************************************/
+
+static PJ_GridCatalog *pj_gc_parse_csv( projCtx ctx, 
+                                        const char *catalog_name,
+                                        const char *text, size_t size )
+
+{
+    PJ_GridCatalog *catalog;
+    const char *next = text, *end = text + size;
+    int entry_max;
+    char line[302];
     
-    catalog->catalog_name = strdup(catalog_name);
-    
+    /* discard title line */
+    pj_gc_gets( line, &next, end );
+
     entry_max = 10;
-    catalog->entries = (PJ_GridCatalogEntry *) 
-        malloc(entry_max * sizeof(PJ_GridCatalogEntry));
+    catalog = pj_gc_newcatalog( ctx, catalog_name, entry_max );
+    if( !catalog )
+        return NULL;
+    catalog->source_size = (double) size;
+    catalog->source_checksum = pj_grid_checksum( text, size );
     
-    while( pj_gc_readentry( ctx, fid, 
+    while( pj_gc_readentry( ctx, &next, end,
                             catalog->entries+catalog->entry_count) == 0)
     {
         catalog->entry_count++;
         
         if( catalog->entry_count == entry_max ) 
         {
-            entry_max = entry_max * 2;
-            catalog->entries = (PJ_GridCatalogEntry *) 
-                realloc(catalog->entries, 
-                        entry_max * sizeof(PJ_GridCatalogEntry));
-            if (catalog->entries == NULL )
+            PJ_GridCatalogEntry *entries = (PJ_GridCatalogEntry *)
+                pj_ctx_malloc(ctx, 2 * entry_max * sizeof(PJ_GridCatalogEntry));
+
+            if (entries == NULL )
+            {
+                pj_gc_free_catalog( catalog );
                 return NULL;
+            }
+            memcpy( entries, catalog->entries, 
+                    entry_max * sizeof(PJ_GridCatalogEntry) );
+            pj_ctx_dalloc( ctx, catalog->entries );
+            catalog->entries = entries;
+            entry_max = entry_max * 2;
         }
     }
 
@@ -87,6 +240,452 @@ PJ_GridCatalog *pj_gc_readcatalog( projCtx ctx, const char *catalog_name )
     return catalog;
 }
 
+/************************************************************************/
+/*                         pj_gc_binary_valid()                         */
+/*                                                                      */
+/*      Whether the size bytes of image are a binary catalog we can     */
+/*      use without further checks.                                     */
+/************************************************************************/
+
+static int pj_gc_binary_valid( const GC_BINARY_HEADER *header,
+                               const unsigned char *image, size_t size )
+
+{
+    const GC_BINARY_ENTRY *records;
+    const double *dates;
+    const int *bin_start, *members;
+    const char *strings;
+    size_t left, bins;
+    int i;
+
+    if( memcmp( header->magic, GC_BINARY_MAGIC, 16 ) != 0
+        || header->byte_order != PJ_GRID_CACHE_BYTE_ORDER
+        || header->entry_count < 0 || header->member_count < 0
+        || header->date_count < 0 || header->date_count > header->entry_count
+        || header->strings_size < 1
+        || header->nx < 0 || header->nx > GC_BINARY_MAX_BINS
+        || header->ny < 0 || header->ny > GC_BINARY_MAX_BINS
+        || (header->nx == 0) != (header->ny == 0) )
+        return 0;
+    bins = header->nx > 0 ? (size_t) header->nx * header->ny + 1 : 0;
+
+/* -------------------------------------------------------------------- */
+/*      The sections have to fill the file exactly.                     */
+/* -------------------------------------------------------------------- */
+    left = size - sizeof(GC_BINARY_HEADER);
+    if( left / sizeof(GC_BINARY_ENTRY) < (size_t) header->entry_count )
+        return 0;
+    left -= sizeof(GC_BINARY_ENTRY) * header->entry_count;
+    if( left / sizeof(double) < (size_t) header->date_count )
+        return 0;
+    left -= sizeof(double) * header->date_count;
+    if( left / sizeof(int) < bins )
+        return 0;
+    left -= sizeof(int) * bins;
+    if( left / sizeof(int) < (size_t) header->member_count )
+        return 0;
+    left -= sizeof(int) * header->member_count;
+    if( left != (size_t) header->strings_size )
+        return 0;
+
+    if( pj_grid_checksum( image + sizeof(GC_BINARY_HEADER), 
+                          size - sizeof(GC_BINARY_HEADER) ) 
+        != header->body_checksum )
+        return 0;
+
+/* -------------------------------------------------------------------- */
+/*      Check what the lookups rely on.                                 */
+/* -------------------------------------------------------------------- */
+    records = (const GC_BINARY_ENTRY *) (image + sizeof(GC_BINARY_HEADER));
+    dates = (const double *) (records + header->entry_count);
+    bin_start = (const int *) (dates + header->date_count);
+    members = bin_start + bins;
+    strings = (const char *) (members + header->member_count);
+
+    if( strings[header->strings_size-1] != '\0' )
+        return 0;
+    for( i = 0; i < header->entry_count; i++ )
+    {
+        if( records[i].definition < 0 
+            || records[i].definition >= header->strings_size )
+            return 0;
+    }
+    for( i = 1; i < header->date_count; i++ )
+    {
+        if( !(dates[i-1] < dates[i]) )
+            return 0;
+    }
+    if( bins > 0 
+        && (bin_start[0] != 0 || bin_start[bins-1] != header->member_count) )
+        return 0;
+    for( i = 1; i < (int) bins; i++ )
+    {
+        if( bin_start[i] < bin_start[i-1] )
+            return 0;
+    }
+    for( i = 0; i < header->member_count; i++ )
+    {
+        if( members[i] < 0 || members[i] >= header->entry_count )
+            return 0;
+    }
+
+    return 1;
+}
+
+/************************************************************************/
+/*                         pj_gc_readbinary()                           */
+/*                                                                      */
+/*      The catalog of <catalog_name>.bin, if it is a valid binary      */
+/*      catalog of the csv text, or of any csv if text is NULL.         */
+/*      Returns NULL otherwise, leaving the context errno as it was.    */
+/************************************************************************/
+
+static PJ_GridCatalog *pj_gc_readbinary( projCtx ctx, 
+                                         const char *catalog_name,
+                                         const char *text, size_t size )
+
+{
+    GC_BINARY_HEADER header;
+    const GC_BINARY_ENTRY *records;
+    const char *strings;
+    PJ_GridCatalog *catalog;
+    PJ_GC_INDEX *index = NULL;
+    PAFile fid;
+    char *name;
+    long file_size;
+    unsigned char *image;
+    void *handle = NULL;
+    void (*unmap)(void *) = NULL;
+    int saved_errno = ctx->last_errno, i;
+
+    name = (char *) pj_malloc( strlen(catalog_name) 
+                               + strlen(GC_BINARY_SUFFIX) + 1 );
+    if( name == NULL )
+        return NULL;
+    sprintf( name, "%s%s", catalog_name, GC_BINARY_SUFFIX );
+    fid = pj_open_lib( ctx, name, "rb" );
+    ctx->last_errno = saved_errno;
+    if( fid == NULL )
+    {
+        pj_dalloc( name );
+        return NULL;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Map the file, or else read it.                                  */
+/* -------------------------------------------------------------------- */
+    if( pj_ctx_fseek( ctx, fid, 0, SEEK_END ) != 0
+        || (file_size = pj_ctx_ftell( ctx, fid )) 
+           < (long) sizeof(GC_BINARY_HEADER) )
+    {
+        pj_ctx_fclose( ctx, fid );
+        pj_dalloc( name );
+        return NULL;
+    }
+
+    image = (unsigned char *)
+        pj_ctx_fmap_at( ctx, fid, 0, (size_t) file_size, &handle, &unmap );
+    if( image == NULL )
+    {
+        unmap = NULL;
+        image = (unsigned char *) pj_malloc( (size_t) file_size );
+        if( image != NULL
+            && (pj_ctx_fseek( ctx, fid, 0, SEEK_SET ) != 0
+                || pj_ctx_fread( ctx, image, 1, (size_t) file_size, fid )
+                   != (size_t) file_size) )
+        {
+            pj_dalloc( image );
+            image = NULL;
+        }
+    }
+    pj_ctx_fclose( ctx, fid );
+    ctx->last_errno = saved_errno;
+    if( image == NULL )
+    {
+        pj_dalloc( name );
+        return NULL;
+    }
+
+    memcpy( &header, image, sizeof(header) );
+    if( !pj_gc_binary_valid( &header, image, (size_t) file_size )
+        || (text != NULL 
+            && (header.source_size != (double) size
+                || header.source_checksum != pj_grid_checksum( text, size ))) )
+    {
+        pj_log( ctx, PJ_LOG_DEBUG_MINOR, 
+                "grid catalog %s is stale or invalid, reading %s",
+                name, catalog_name );
+        if( unmap != NULL )
+            unmap( handle );
+        else
+            pj_dalloc( image );
+        pj_dalloc( name );
+        return NULL;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Set up the entries, and the index on the arrays of the image.   */
+/* -------------------------------------------------------------------- */
+    catalog = pj_gc_newcatalog( ctx, catalog_name, 
+                                header.entry_count > 0 ? header.entry_count : 1 );
+    if( catalog != NULL && header.nx > 0 )
+    {
+        index = (PJ_GC_INDEX *) pj_malloc(sizeof(PJ_GC_INDEX));
+        if( index == NULL )
+        {
+            pj_gc_free_catalog( catalog );
+            catalog = NULL;
+        }
+    }
+    if( catalog == NULL )
+    {
+        if( unmap != NULL )
+            unmap( handle );
+        else
+            pj_dalloc( image );
+        pj_dalloc( name );
+        return NULL;
+    }
+
+    records = (const GC_BINARY_ENTRY *) (image + sizeof(GC_BINARY_HEADER));
+    strings = (const char *) image + file_size - header.strings_size;
+    memset( catalog->entries, 0, 
+            sizeof(PJ_GridCatalogEntry) * header.entry_count );
+    for( i = 0; i < header.entry_count; i++ )
+    {
+        PJ_GridCatalogEntry *entry = catalog->entries + i;
+
+        entry->region = records[i].region;
+        entry->priority = records[i].priority;
+        entry->date = records[i].date;
+        entry->definition = (char *) strings + records[i].definition;
+    }
+    catalog->entry_count = header.entry_count;
+    catalog->region = header.region;
+    catalog->source_size = header.source_size;
+    catalog->source_checksum = header.source_checksum;
+    catalog->image = image;
+    catalog->image_size = (size_t) file_size;
+    catalog->image_handle = handle;
+    catalog->image_unmap = unmap;
+
+    if( index != NULL )
+    {
+        memset( index, 0, sizeof(PJ_GC_INDEX) );
+        index->ll = header.ll;
+        index->del = header.del;
+        index->nx = header.nx;
+        index->ny = header.ny;
+        index->dates = (double *) (records + header.entry_count);
+        index->date_count = header.date_count;
+        index->bin_start = (int *) (index->dates + header.date_count);
+        index->bin_members = index->bin_start + header.nx * header.ny + 1;
+        index->in_image = 1;
+        catalog->index = index;
+    }
+
+    pj_log( ctx, PJ_LOG_DEBUG_MINOR, 
+            "Read grid catalog %s, %d entries%s", name, 
+            catalog->entry_count, unmap != NULL ? ", mapped" : "" );
+    pj_dalloc( name );
+
+    return catalog;
+}
+
+/************************************************************************/
+/*                         pj_gc_readcatalog()                          */
+/*                                                                      */
+/*      Read a grid catalog from a .csv file, or from its binary        */
+/*      form, <catalog_name>.bin, if that is up to date.                */
+/************************************************************************/
+
+PJ_GridCatalog *pj_gc_readcatalog( projCtx ctx, const char *catalog_name )
+{
+    PAFile fid;
+    PJ_GridCatalog *catalog;
+    char *text = NULL;
+    size_t size = 0;
+    int saved_errno = ctx->last_errno;
+    
+    fid = pj_open_lib( ctx, (char *) catalog_name, "r" );
+    if( fid != NULL )
+    {
+        text = pj_gc_readtext( ctx, fid, &size );
+        pj_ctx_fclose( ctx, fid );
+        if( text == NULL )
+            return NULL;
+    }
+
+    /* without the csv, any valid binary will do */
+    catalog = pj_gc_readbinary( ctx, catalog_name, text, size );
+    if( catalog != NULL )
+        ctx->last_errno = saved_errno;
+    else if( text != NULL )
+        catalog = pj_gc_parse_csv( ctx, catalog_name, text, size );
+
+    pj_dalloc( text );
+
+    return catalog;
+}
+
+/************************************************************************/
+/*                         pj_gc_writecatalog()                         */
+/*                                                                      */
+/*      Write the binary form of the .csv catalog catalog_name to       */
+/*      filename, normally <catalog_name>.bin, replacing it only        */
+/*      once it is complete.  Returns 0, or -1 with the context         */
+/*      errno set.                                                      */
+/************************************************************************/
+
+int pj_gc_writecatalog( projCtx ctx, const char *catalog_name, 
+                        const char *filename )
+
+{
+    GC_BINARY_HEADER header;
+    GC_BINARY_ENTRY *records;
+    PJ_GridCatalog *catalog;
+    PJ_GC_INDEX *index;
+    PAFile fid;
+    unsigned char *image;
+    char *text, *strings, *tmp;
+    size_t size, text_size, bins = 0;
+    int i, strings_size = 1, ok;
+    FILE *fp;
+
+    if( ctx == NULL )
+        ctx = pj_get_default_ctx();
+
+    fid = pj_open_lib( ctx, (char *) catalog_name, "r" );
+    if( fid == NULL )
+    {
+        if( ctx->last_errno == 0 )
+            pj_ctx_set_errno( ctx, ENOENT );
+        return -1;
+    }
+    text = pj_gc_readtext( ctx, fid, &text_size );
+    pj_ctx_fclose( ctx, fid );
+
+    catalog = text != NULL 
+        ? pj_gc_parse_csv( ctx, catalog_name, text, text_size ) : NULL;
+    pj_dalloc( text );
+    if( catalog == NULL )
+    {
+        pj_ctx_set_errno( ctx, ENOMEM );
+        return -1;
+    }
+
+    index = catalog->index = pj_gc_index_build( catalog );
+    if( index == NULL && catalog->entry_count > 0 )
+    {
+        pj_gc_free_catalog( catalog );
+        pj_ctx_set_errno( ctx, ENOMEM );
+        return -1;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Lay out the image.                                              */
+/* -------------------------------------------------------------------- */
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, GC_BINARY_MAGIC, 16 );
+    header.byte_order = PJ_GRID_CACHE_BYTE_ORDER;
+    header.entry_count = catalog->entry_count;
+    header.source_checksum = catalog->source_checksum;
+    header.source_size = catalog->source_size;
+    header.region = catalog->region;
+    if( index != NULL )
+    {
+        header.ll = index->ll;
+        header.del = index->del;
+        header.nx = index->nx;
+        header.ny = index->ny;
+        bins = (size_t) index->nx * index->ny + 1;
+        header.member_count = index->bin_start[bins-1];
+        header.date_count = index->date_count;
+    }
+    for( i = 0; i < catalog->entry_count; i++ )
+        strings_size += (int) strlen( catalog->entries[i].definition ) + 1;
+    header.strings_size = strings_size;
+
+    size = sizeof(GC_BINARY_HEADER) 
+        + sizeof(GC_BINARY_ENTRY) * header.entry_count
+        + sizeof(double) * header.date_count
+        + sizeof(int) * (bins + header.member_count)
+        + strings_size;
+    image = (unsigned char *) pj_malloc( size );
+    tmp = (char *) pj_malloc( strlen(filename) + 5 );
+    if( image == NULL || tmp == NULL )
+    {
+        pj_dalloc( image );
+        pj_dalloc( tmp );
+        pj_gc_free_catalog( catalog );
+        pj_ctx_set_errno( ctx, ENOMEM );
+        return -1;
+    }
+    memset( image, 0, size );
+
+    records = (GC_BINARY_ENTRY *) (image + sizeof(GC_BINARY_HEADER));
+    strings = (char *) image + size - strings_size;
+    strings_size = 1;           /* the empty string first */
+    for( i = 0; i < catalog->entry_count; i++ )
+    {
+        PJ_GridCatalogEntry *entry = catalog->entries + i;
+
+        records[i].region = entry->region;
+        records[i].date = entry->date;
+        records[i].priority = entry->priority;
+        records[i].definition = strings_size;
+        strcpy( strings + strings_size, entry->definition );
+        strings_size += (int) strlen( entry->definition ) + 1;
+    }
+    if( index != NULL )
+    {
+        double *dates = (double *) (records + header.entry_count);
+        int *bin_start = (int *) (dates + header.date_count);
+
+        memcpy( dates, index->dates, sizeof(double) * header.date_count );
+        memcpy( bin_start, index->bin_start, sizeof(int) * bins );
+        memcpy( bin_start + bins, index->bin_members, 
+                sizeof(int) * header.member_count );
+    }
+    header.body_checksum = pj_grid_checksum( image + sizeof(header), 
+                                             size - sizeof(header) );
+    memcpy( image, &header, sizeof(header) );
+    pj_gc_free_catalog( catalog );
+
+/* -------------------------------------------------------------------- */
+/*      Write to a temporary file renamed over the target, so that      */
+/*      readers never see a partial catalog.                            */
+/* -------------------------------------------------------------------- */
+    sprintf( tmp, "%s.tmp", filename );
+    fp = fopen( tmp, "wb" );
+    ok = fp != NULL;
+    if( ok )
+    {
+        ok = fwrite( image, 1, size, fp ) == size;
+        ok = fclose( fp ) == 0 && ok;
+#ifdef _WIN32
+        if( ok )
+            remove( filename );
+#endif
+        if( !ok || rename( tmp, filename ) != 0 )
+        {
+            remove( tmp );
+            ok = 0;
+        }
+    }
+
+    pj_dalloc( image );
+    pj_dalloc( tmp );
+
+    if( !ok )
+    {
+        pj_ctx_set_errno( ctx, errno ? errno : EIO );
+        return -1;
+    }
+
+    return 0;
+}
+
 /************************************************************************/
 /*                         pj_gc_sortcatalog()                          */
 /*                                                                      */
@@ -106,12 +705,13 @@ static void pj_gc_sortcatalog( projCtx ctx, PJ_GridCatalog *catalog )
 /*      token count.                                                    */
 /************************************************************************/
 
-static int pj_gc_read_csv_line( projCtx ctx, PAFile fid, 
+static int pj_gc_read_csv_line( projCtx ctx, const char **text,
+                                const char *end,
                                 char **tokens, int max_tokens ) 
 {
     char line[302];
    
-    while( pj_ctx_fgets(ctx, line, sizeof(line)-1, fid) != NULL )
+    while( pj_gc_gets(line, text, end) != NULL )
     {
         char *next = line;
         int token_count = 0;
@@ -136,7 +736,7 @@ static int pj_gc_read_csv_line( projCtx ctx, PAFile fid,
                 next++;
             }
             
-            tokens[token_count++] = strdup(start);
+            tokens[token_count++] = pj_ctx_strdup(ctx, start);
         }
 
         return token_count;
@@ -167,7 +767,7 @@ double pj_gc_parsedate( projCtx ctx, const char *date_string )
     }
     else 
     {
-        return atof(date_string);
+        return pj_atof(date_string);
     }
 }
 
@@ -175,13 +775,14 @@ double pj_gc_parsedate( projCtx ctx, const char *date_string )
 /************************************************************************/
 /*                          pj_gc_readentry()                           */
 /*                                                                      */
-/*      Read one catalog entry from the file                            */
+/*      Read one catalog entry from the text at *next.                  */
 /*                                                                      */
 /*      Format:                                                         */
 /*        gridname,ll_long,ll_lat,ur_long,ur_lat,priority,date          */
 /************************************************************************/
 
-static int pj_gc_readentry(projCtx ctx, PAFile fid, PJ_GridCatalogEntry *entry) 
+static int pj_gc_readentry( projCtx ctx, const char **next, const char *end,
+                            PJ_GridCatalogEntry *entry ) 
 {
 #define MAX_TOKENS 30
     char *tokens[MAX_TOKENS];
@@ -190,7 +791,7 @@ static int pj_gc_readentry(projCtx ctx, PAFile fid, PJ_GridCatalogEntry *entry)
 
     memset( entry, 0, sizeof(PJ_GridCatalogEntry) );
     
-    token_count = pj_gc_read_csv_line( ctx, fid, tokens, MAX_TOKENS );
+    token_count = pj_gc_read_csv_line( ctx, next, end, tokens, MAX_TOKENS );
     if( token_count < 5 )
     {
         error = 1; /* TODO: need real error codes */
@@ -201,7 +802,7 @@ static int pj_gc_readentry(projCtx ctx, PAFile fid, PJ_GridCatalogEntry *entry)
     {
         memset( entry, 0, sizeof(PJ_GridCatalogEntry));
         
-        entry->definition = strdup( tokens[0] );
+        entry->definition = pj_ctx_strdup( ctx, tokens[0] );
         entry->region.ll_long = dmstor_ctx( ctx, tokens[1], NULL );
         entry->region.ll_lat = dmstor_ctx( ctx, tokens[2], NULL );
         entry->region.ur_long = dmstor_ctx( ctx, tokens[3], NULL );
@@ -213,7 +814,7 @@ static int pj_gc_readentry(projCtx ctx, PAFile fid, PJ_GridCatalogEntry *entry)
     }
 
     for( i = 0; i < token_count; i++ )
-        free( tokens[i] );
+        pj_ctx_dalloc( ctx, tokens[i] );
 
     return error;
 }
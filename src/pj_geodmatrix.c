@@ -0,0 +1,134 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Matrices of inverse geodesic solutions, computed by bands of
+ *           rows on several threads.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include "geodesic.h"
+
+PJ_CVSID("$Id$");
+
+/*
+** Each band is a range of rows, with its own part of the results.  The
+** geodesic is only read, so the bands need no locking.
+*/
+typedef struct {
+    const struct geod_geodesic *g;
+    long         row_start, row_end, n2;
+    const double *lat1, *lon1, *lat2, *lon2;
+    double       *s12, *azi1, *azi2;
+    void         *thread;
+} PJ_GEOD_BAND;
+
+/************************************************************************/
+/*                         pj_geod_band_run()                           */
+/************************************************************************/
+
+static void pj_geod_band_run( void *arg )
+
+{
+    PJ_GEOD_BAND *band = (PJ_GEOD_BAND *) arg;
+    long i, j;
+
+    for( i = band->row_start; i < band->row_end; i++ )
+    {
+        long base = i * band->n2;
+
+        for( j = 0; j < band->n2; j++ )
+        {
+            geod_inverse( band->g, band->lat1[i], band->lon1[i],
+                          band->lat2[j], band->lon2[j],
+                          band->s12 ? band->s12 + base + j : NULL,
+                          band->azi1 ? band->azi1 + base + j : NULL,
+                          band->azi2 ? band->azi2 + base + j : NULL );
+        }
+    }
+}
+
+/************************************************************************/
+/*                        geod_inverse_matrix()                         */
+/************************************************************************/
+
+void geod_inverse_matrix( const struct geod_geodesic *g,
+                          long n1, const double lat1[], const double lon1[],
+                          long n2, const double lat2[], const double lon2[],
+                          double s12[], double azi1[], double azi2[],
+                          int thread_count )
+
+{
+    PJ_GEOD_BAND *bands = NULL;
+    long rows_done = 0;
+    int i;
+
+    if( n1 <= 0 || n2 <= 0 )
+        return;
+
+    if( thread_count > n1 )
+        thread_count = (int) n1;
+    if( thread_count > 1 )
+        bands = (PJ_GEOD_BAND *)
+            pj_malloc(sizeof(PJ_GEOD_BAND) * thread_count);
+    if( bands == NULL )
+        thread_count = 1;
+
+/* -------------------------------------------------------------------- */
+/*      Start a thread for each band but the last, which is computed    */
+/*      here.  Bands that cannot get a thread are also computed here.   */
+/* -------------------------------------------------------------------- */
+    for( i = 0; i < thread_count; i++ )
+    {
+        PJ_GEOD_BAND local_band, *band = bands ? bands + i : &local_band;
+
+        band->g = g;
+        band->row_start = rows_done;
+        rows_done = n1 * (i + 1) / thread_count;
+        band->row_end = rows_done;
+        band->n2 = n2;
+        band->lat1 = lat1;
+        band->lon1 = lon1;
+        band->lat2 = lat2;
+        band->lon2 = lon2;
+        band->s12 = s12;
+        band->azi1 = azi1;
+        band->azi2 = azi2;
+        band->thread = NULL;
+
+        if( i < thread_count - 1 )
+            band->thread = pj_thread_start( pj_geod_band_run, band );
+        if( band->thread == NULL )
+            pj_geod_band_run( band );
+    }
+
+    if( bands != NULL )
+    {
+        for( i = 0; i < thread_count - 1; i++ )
+            pj_thread_join( bands[i].thread );
+        pj_dalloc( bands );
+    }
+}
@@ -0,0 +1,155 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Areas and perimeters of many geodesic polygons, computed by
+ *           bands of rings on several threads.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include "geodesic.h"
+
+PJ_CVSID("$Id$");
+/*
+** Each band is a range of rings, with about as many vertices as the
+** others, and its own part of the results.  The geodesic is only read,
+** so the bands need no locking.
+*/
+typedef struct {
+    const struct geod_geodesic *g;
+    long         ring_start, ring_end;
+    const long   *starts;
+    const double *lats, *lons;
+    double       *A, *P;
+    void         *thread;
+} PJ_GEOD_RINGS;
+
+/************************************************************************/
+/*                         pj_geod_rings_run()                          */
+/************************************************************************/
+
+static void pj_geod_rings_run( void *arg )
+
+{
+    PJ_GEOD_RINGS *band = (PJ_GEOD_RINGS *) arg;
+    struct geod_polygon p;
+    long i, k;
+
+    for( i = band->ring_start; i < band->ring_end; i++ )
+    {
+        double A, P;
+
+        geod_polygon_init( &p, 0 );
+        for( k = band->starts[i]; k < band->starts[i+1]; k++ )
+            geod_polygon_addpoint( band->g, &p, band->lats[k], band->lons[k] );
+        geod_polygon_compute( band->g, &p, 0, 1, &A, &P );
+
+        if( band->A )
+            band->A[i] = A;
+        if( band->P )
+            band->P[i] = P;
+    }
+}
+
+/************************************************************************/
+/*                         geod_polygonarea_n()                         */
+/************************************************************************/
+
+void geod_polygonarea_n( const struct geod_geodesic *g,
+                         long ring_count, const long ring_starts[],
+                         const double lats[], const double lons[],
+                         double A[], double P[], int thread_count )
+
+{
+    PJ_GEOD_RINGS *bands = NULL;
+    long rings_done = 0, vertex_count;
+    int i;
+
+    if( ring_count <= 0 )
+        return;
+
+    if( thread_count > ring_count )
+        thread_count = (int) ring_count;
+    if( thread_count > 1 )
+        bands = (PJ_GEOD_RINGS *)
+            pj_malloc(sizeof(PJ_GEOD_RINGS) * thread_count);
+    if( bands == NULL )
+        thread_count = 1;
+    vertex_count = ring_starts[ring_count] - ring_starts[0];
+
+/* -------------------------------------------------------------------- */
+/*      Start a thread for each band but the last, which is computed    */
+/*      here.  Bands that cannot get a thread are also computed here.   */
+/* -------------------------------------------------------------------- */
+    for( i = 0; i < thread_count; i++ )
+    {
+        PJ_GEOD_RINGS local_band, *band = bands ? bands + i : &local_band;
+        long end = ring_count;
+
+        /* the first ring starting beyond this band's share of vertices */
+        if( i < thread_count - 1 )
+        {
+            long share = ring_starts[0]
+                + (long) ((double) vertex_count * (i + 1) / thread_count);
+            long lo = rings_done, hi = ring_count;
+
+            while( lo < hi )
+            {
+                long mid = lo + (hi - lo) / 2;
+
+                if( ring_starts[mid] < share )
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            end = lo;
+        }
+
+        band->g = g;
+        band->ring_start = rings_done;
+        band->ring_end = end;
+        band->starts = ring_starts;
+        band->lats = lats;
+        band->lons = lons;
+        band->A = A;
+        band->P = P;
+        band->thread = NULL;
+        rings_done = end;
+
+        if( i < thread_count - 1 && band->ring_end > band->ring_start )
+            band->thread = pj_thread_start( pj_geod_rings_run, band );
+        if( band->thread == NULL )
+            pj_geod_rings_run( band );
+    }
+
+    if( bands != NULL )
+    {
+        for( i = 0; i < thread_count - 1; i++ )
+            if( bands[i].thread != NULL )
+                pj_thread_join( bands[i].thread );
+        pj_dalloc( bands );
+    }
+}
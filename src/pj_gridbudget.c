@@ -0,0 +1,368 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Process wide budget for the memory of loaded grid values, with
+ *           eviction of the least recently used grids.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <string.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** Loaded grids are kept on a list protected by the core lock, with the
+** bytes of values they hold.  Readers pin a grid while they use its
+** values, and a grid is only evicted under its own lock when it has no
+** pins.  Pinning is only done once a limit has been set, so that grids
+** are read without any locking otherwise.
+**
+** With atomic operations a pin is taken without locking: the reader
+** counts itself then checks that no eviction is running, while the
+** evictor flags itself then checks for readers.  Either the reader sees
+** the flag and takes the lock, or the evictor sees the reader.
+*/
+#if defined(__GNUC__) && !defined(MUTEX_stub)
+#  define GRID_ATOMIC_ADD(v, n)  __sync_add_and_fetch( &(v), (n) )
+#  define GRID_BARRIER()         __sync_synchronize()
+#endif
+
+static int         budget_enabled = 0;
+static size_t      budget_limit = 0;
+static size_t      resident_bytes = 0;
+static long        grid_loads = 0;
+static long        grid_evictions = 0;
+static volatile long use_clock = 0;
+static PJ_GRIDINFO *resident_list = NULL;
+
+/************************************************************************/
+/*                       pj_set_grid_memory_limit()                     */
+/*                                                                      */
+/*      Limit the memory used by the values of loaded grids, 0 for no   */
+/*      limit.  This should be set before grids are used by other       */
+/*      threads.  The limit is exceeded rather than evict grids in      */
+/*      use, or tables read by tiles which have their own limit.        */
+/************************************************************************/
+
+void pj_set_grid_memory_limit( size_t bytes )
+
+{
+    pj_acquire_lock();
+    budget_limit = bytes;
+    if( bytes > 0 )
+        budget_enabled = 1;
+    pj_release_lock();
+
+    pj_grid_budget_enforce( NULL );
+}
+
+/************************************************************************/
+/*                       pj_get_grid_memory_limit()                     */
+/************************************************************************/
+
+size_t pj_get_grid_memory_limit()
+
+{
+    return budget_limit;
+}
+
+/************************************************************************/
+/*                       pj_get_grid_memory_stats()                     */
+/*                                                                      */
+/*      Fetch the number of grids loaded and evicted so far, and the    */
+/*      bytes of grid values now held.  Any pointer may be NULL.        */
+/************************************************************************/
+
+void pj_get_grid_memory_stats( long *loads, long *evictions,
+                               size_t *bytes )
+
+{
+    pj_acquire_lock();
+    if( loads != NULL )
+        *loads = grid_loads;
+    if( evictions != NULL )
+        *evictions = grid_evictions;
+    if( bytes != NULL )
+        *bytes = resident_bytes;
+    pj_release_lock();
+}
+
+/************************************************************************/
+/*                        pj_grid_resident_size()                       */
+/*                                                                      */
+/*      Bytes allocated for the values of a grid.  Mapped values are    */
+/*      not counted, as the system can drop them itself.                */
+/************************************************************************/
+
+static size_t pj_grid_resident_size( PJ_GRIDINFO *gi )
+
+{
+    size_t nodes, size = 0;
+
+    if( gi->ct == NULL )
+        return 0;
+
+    nodes = (size_t) gi->ct->lim.lam * gi->ct->lim.phi;
+    if( gi->ct->cvs != NULL && gi->map_handle == NULL )
+        size += nodes * (pj_gridinfo_heights( gi )
+                         ? sizeof(float) : sizeof(FLP));
+    if( gi->inverse_ct != NULL )
+        size += nodes * sizeof(FLP);
+    if( gi->row_pairs != NULL )
+        size += 2 * (nodes - gi->ct->lim.lam) * sizeof(FLP);
+
+    return size;
+}
+
+/************************************************************************/
+/*                       pj_grid_resident_insert()                      */
+/************************************************************************/
+
+static void pj_grid_resident_insert( PJ_GRIDINFO *gi, int loaded )
+
+{
+    size_t size = pj_grid_resident_size( gi );
+
+    pj_acquire_lock();
+    if( !gi->resident )
+    {
+        gi->resident = 1;
+        gi->resident_next = resident_list;
+        resident_list = gi;
+    }
+    resident_bytes += size - gi->resident_size;
+    gi->resident_size = size;
+    if( loaded )
+        grid_loads++;
+    gi->last_used = ++use_clock;
+    pj_release_lock();
+}
+
+/************************************************************************/
+/*                         pj_grid_resident_add()                       */
+/*                                                                      */
+/*      Count a grid whose values were just loaded, or whose inverse    */
+/*      was built, evicting others if this goes over the limit.  The    */
+/*      grid lock must not be held.                                     */
+/************************************************************************/
+
+void pj_grid_resident_add( PJ_GRIDINFO *gi, int loaded )
+
+{
+    pj_grid_resident_insert( gi, loaded );
+    pj_grid_budget_enforce( gi );
+}
+
+/************************************************************************/
+/*                       pj_grid_resident_remove()                      */
+/*                                                                      */
+/*      Take a grid off the resident list, before it is freed or        */
+/*      evicted.                                                        */
+/************************************************************************/
+
+void pj_grid_resident_remove( PJ_GRIDINFO *gi )
+
+{
+    PJ_GRIDINFO **link;
+
+    pj_acquire_lock();
+    for( link = &resident_list; gi->resident && *link != NULL;
+         link = &((*link)->resident_next) )
+    {
+        if( *link == gi )
+        {
+            *link = gi->resident_next;
+            gi->resident = 0;
+            resident_bytes -= gi->resident_size;
+            gi->resident_size = 0;
+            break;
+        }
+    }
+    pj_release_lock();
+}
+
+/************************************************************************/
+/*                           pj_grid_evict()                            */
+/*                                                                      */
+/*      Release the values of a grid taken off the resident list, if    */
+/*      nobody is using them.                                           */
+/************************************************************************/
+
+static int pj_grid_evict( PJ_GRIDINFO *gi )
+
+{
+    int evicted = 0;
+
+    pj_mutex_lock( gi->lock );
+
+    gi->evicting = 1;
+#ifdef GRID_BARRIER
+    GRID_BARRIER();
+#endif
+    if( gi->users == 0 && gi->ct->cvs != NULL )
+    {
+        if( gi->map_handle != NULL )
+        {
+            gi->unmap( gi->map_handle );
+            gi->map_handle = NULL;
+        }
+        else
+            pj_gridinfo_free_values( gi, gi->ct->cvs, gi->values_paged );
+        gi->ct->cvs = NULL;
+
+        pj_gridinfo_free_table( gi, gi->inverse_ct, gi->inverse_paged );
+        gi->inverse_ct = NULL;
+        pj_gridinfo_free_values( gi, gi->row_pairs, gi->row_pairs_paged );
+        gi->row_pairs = NULL;
+        evicted = 1;
+    }
+#ifdef GRID_BARRIER
+    GRID_BARRIER();
+#endif
+    gi->evicting = 0;
+
+    pj_mutex_unlock( gi->lock );
+
+    return evicted;
+}
+
+/************************************************************************/
+/*                        pj_grid_budget_enforce()                      */
+/*                                                                      */
+/*      Evict the least recently used grids until within the limit.     */
+/*      The grid just loaded, if any, is kept.  Grid locks are only     */
+/*      taken with the core lock released, as a grid without a lock     */
+/*      of its own is loaded under the core lock.                       */
+/************************************************************************/
+
+void pj_grid_budget_enforce( PJ_GRIDINFO *keep )
+
+{
+    for( ; ; )
+    {
+        PJ_GRIDINFO *gi, *oldest = NULL;
+
+        pj_acquire_lock();
+        if( budget_limit == 0 || resident_bytes <= budget_limit )
+        {
+            pj_release_lock();
+            return;
+        }
+
+        for( gi = resident_list; gi != NULL; gi = gi->resident_next )
+        {
+            if( gi != keep && gi->resident_size > 0 && gi->users == 0
+                && (oldest == NULL || gi->last_used < oldest->last_used) )
+                oldest = gi;
+        }
+        pj_release_lock();
+
+        if( oldest == NULL )
+            return;
+
+        pj_grid_resident_remove( oldest );
+
+        /* the grid was pinned meanwhile, give up until the next load */
+        if( !pj_grid_evict( oldest ) )
+        {
+            pj_grid_resident_insert( oldest, 0 );
+            return;
+        }
+
+        pj_acquire_lock();
+        grid_evictions++;
+        pj_release_lock();
+    }
+}
+
+/************************************************************************/
+/*                        pj_gridinfo_acquire()                         */
+/*                                                                      */
+/*      Load the values of a grid if needed, and keep them in memory    */
+/*      until pj_gridinfo_release().  Returns FALSE if they cannot be   */
+/*      loaded.                                                         */
+/************************************************************************/
+
+int pj_gridinfo_acquire( projCtx ctx, PJ_GRIDINFO *gi )
+
+{
+    if( !budget_enabled )
+        return gi->ct->cvs != NULL || pj_gridinfo_load( ctx, gi );
+
+    /* uses since the last load count as equally recent */
+    if( gi->last_used != use_clock )
+        gi->last_used = use_clock;
+
+#ifdef GRID_ATOMIC_ADD
+    GRID_ATOMIC_ADD( gi->users, 1 );
+    if( !gi->evicting && gi->ct->cvs != NULL )
+        return 1;
+    GRID_ATOMIC_ADD( gi->users, -1 );
+#endif
+
+/* -------------------------------------------------------------------- */
+/*      Otherwise pin under the grid lock, loading again if the         */
+/*      values were evicted in between.                                 */
+/* -------------------------------------------------------------------- */
+    for( ; ; )
+    {
+        if( gi->ct->cvs == NULL && !pj_gridinfo_load( ctx, gi ) )
+            return 0;
+
+        pj_mutex_lock( gi->lock );
+        if( gi->ct->cvs != NULL )
+        {
+#ifdef GRID_ATOMIC_ADD
+            GRID_ATOMIC_ADD( gi->users, 1 );
+#else
+            gi->users++;
+#endif
+            pj_mutex_unlock( gi->lock );
+            return 1;
+        }
+        pj_mutex_unlock( gi->lock );
+    }
+}
+
+/************************************************************************/
+/*                        pj_gridinfo_release()                         */
+/************************************************************************/
+
+void pj_gridinfo_release( PJ_GRIDINFO *gi )
+
+{
+    if( !budget_enabled )
+        return;
+
+#ifdef GRID_ATOMIC_ADD
+    GRID_ATOMIC_ADD( gi->users, -1 );
+#else
+    pj_mutex_lock( gi->lock );
+    gi->users--;
+    pj_mutex_unlock( gi->lock );
+#endif
+}
@@ -31,34 +31,287 @@
 
 #include <projects.h>
 #include <string.h>
+#include <math.h>
+#include <float.h>
 #include <assert.h>
 
-static PJ_GridCatalog *grid_catalog_list = NULL;
+#define MAX_BINS_PER_AXIS 64
 
 /************************************************************************/
-/*                          pj_gc_unloadall()                           */
+/*                             pj_gc_bin()                              */
 /*                                                                      */
-/*      Deallocate all the grid catalogs (but not the referenced        */
-/*      grids).                                                         */
+/*      Bin number along one axis, clamped so that points outside       */
+/*      the catalog extent still land in an edge bin.                   */
 /************************************************************************/
 
-void pj_gc_unloadall( projCtx ctx )
+static int pj_gc_bin( double value, double origin, double size, int count )
+
+{
+    double bin = floor((value - origin) / size);
+
+    if( !(bin >= 0) ) /* also catches NaN */
+        return 0;
+    if( bin >= count )
+        return count - 1;
+    return (int) bin;
+}
+
+/************************************************************************/
+/*                          pj_gc_index_free()                          */
+/************************************************************************/
+
+static void pj_gc_index_free( PJ_GC_INDEX *index )
+
+{
+    if( index == NULL )
+        return;
+
+    if( !index->in_image )
+    {
+        pj_dalloc( index->bin_start );
+        pj_dalloc( index->bin_members );
+        pj_dalloc( index->dates );
+    }
+    pj_dalloc( index );
+}
+
+/************************************************************************/
+/*                          pj_gc_compare_dates()                       */
+/************************************************************************/
+
+static int pj_gc_compare_dates( const void *a_in, const void *b_in )
+
+{
+    double a = *(const double *) a_in, b = *(const double *) b_in;
+
+    return a < b ? -1 : a > b;
+}
+
+/************************************************************************/
+/*                         pj_gc_index_dates()                          */
+/*                                                                      */
+/*      The distinct dates of the entries, in ascending order.  NaN     */
+/*      dates never bound a span in pj_gc_date_span(), so are left      */
+/*      out.  Returns FALSE if we run out of memory.                    */
+/************************************************************************/
+
+static int pj_gc_index_dates( PJ_GC_INDEX *index, 
+                              const PJ_GridCatalog *catalog )
+
+{
+    int i, count = 0;
+
+    index->dates = (double *) 
+        pj_malloc(sizeof(double) * catalog->entry_count);
+    if( index->dates == NULL )
+        return 0;
+
+    for( i = 0; i < catalog->entry_count; i++ )
+    {
+        if( catalog->entries[i].date == catalog->entries[i].date )
+            index->dates[count++] = catalog->entries[i].date;
+    }
+    qsort( index->dates, count, sizeof(double), pj_gc_compare_dates );
+
+    index->date_count = count > 0;
+    for( i = 1; i < count; i++ )
+    {
+        if( index->dates[i] != index->dates[index->date_count-1] )
+            index->dates[index->date_count++] = index->dates[i];
+    }
+
+    return 1;
+}
+
+/************************************************************************/
+/*                         pj_gc_index_build()                          */
+/*                                                                      */
+/*      Set the extent of the catalog, and build the bin index of its   */
+/*      entries and the index of their dates.  Returns NULL if we run   */
+/*      out of memory, in which case the entries are just scanned.      */
+/************************************************************************/
+
+PJ_GC_INDEX *pj_gc_index_build( PJ_GridCatalog *catalog )
 
 {
-    while( grid_catalog_list != NULL )
+    PJ_GC_INDEX *index;
+    int member_count = 0, i, bin, pass, *fill = NULL;
+
+    if( catalog->entry_count == 0 )
+        return NULL;
+
+    catalog->region = catalog->entries[0].region;
+    for( i = 1; i < catalog->entry_count; i++ )
     {
-        int i;
-        PJ_GridCatalog *catalog = grid_catalog_list;
-        grid_catalog_list = grid_catalog_list->next;
+        PJ_Region *region = &(catalog->entries[i].region);
+
+        if( region->ll_long < catalog->region.ll_long )
+            catalog->region.ll_long = region->ll_long;
+        if( region->ll_lat < catalog->region.ll_lat )
+            catalog->region.ll_lat = region->ll_lat;
+        if( region->ur_long > catalog->region.ur_long )
+            catalog->region.ur_long = region->ur_long;
+        if( region->ur_lat > catalog->region.ur_lat )
+            catalog->region.ur_lat = region->ur_lat;
+    }
+
+    index = (PJ_GC_INDEX *) pj_malloc(sizeof(PJ_GC_INDEX));
+    if( index == NULL )
+        return NULL;
+    memset( index, 0, sizeof(PJ_GC_INDEX) );
+
+/* -------------------------------------------------------------------- */
+/*      About four bins per entry, within a fixed limit.                */
+/* -------------------------------------------------------------------- */
+    index->nx = index->ny = 2 * (int) ceil(sqrt((double) catalog->entry_count));
+    if( index->nx > MAX_BINS_PER_AXIS )
+        index->nx = index->ny = MAX_BINS_PER_AXIS;
 
+    index->ll.lam = catalog->region.ll_long;
+    index->ll.phi = catalog->region.ll_lat;
+    index->del.lam = (catalog->region.ur_long - catalog->region.ll_long) 
+        / index->nx;
+    index->del.phi = (catalog->region.ur_lat - catalog->region.ll_lat) 
+        / index->ny;
+    if( !(index->del.lam > 0) )
+    {
+        index->nx = 1;
+        index->del.lam = 1.0;
+    }
+    if( !(index->del.phi > 0) )
+    {
+        index->ny = 1;
+        index->del.phi = 1.0;
+    }
+
+    index->bin_start = (int *)
+        pj_malloc(sizeof(int) * (index->nx * index->ny + 1));
+    if( index->bin_start == NULL )
+    {
+        pj_gc_index_free( index );
+        return NULL;
+    }
+    memset( index->bin_start, 0, sizeof(int) * (index->nx * index->ny + 1) );
+
+/* -------------------------------------------------------------------- */
+/*      Count the members of each bin, then fill them in catalog        */
+/*      order.                                                          */
+/* -------------------------------------------------------------------- */
+    for( pass = 0; pass < 2; pass++ )
+    {
         for( i = 0; i < catalog->entry_count; i++ )
         {
-            /* we don't own gridinfo - do not free here */
-            free( catalog->entries[i].definition );
+            PJ_Region *region = &(catalog->entries[i].region);
+            int ix, iy, ix1, iy1;
+
+            ix1 = pj_gc_bin( region->ur_long, index->ll.lam, 
+                             index->del.lam, index->nx );
+            iy1 = pj_gc_bin( region->ur_lat, index->ll.phi, 
+                             index->del.phi, index->ny );
+            for( iy = pj_gc_bin( region->ll_lat, index->ll.phi,
+                                 index->del.phi, index->ny ); iy <= iy1; iy++ )
+            {
+                for( ix = pj_gc_bin( region->ll_long, index->ll.lam, 
+                                     index->del.lam, index->nx );
+                     ix <= ix1; ix++ )
+                {
+                    if( pass == 0 )
+                    {
+                        index->bin_start[iy * index->nx + ix + 1]++;
+                        member_count++;
+                    }
+                    else
+                        index->bin_members[fill[iy * index->nx + ix]++] = i;
+                }
+            }
         }
-        free( catalog->entries );
-        free( catalog );
+
+        if( pass == 0 )
+        {
+            for( bin = 0; bin < index->nx * index->ny; bin++ )
+                index->bin_start[bin+1] += index->bin_start[bin];
+
+            index->bin_members = (int *) 
+                pj_malloc(sizeof(int) * (member_count + 1));
+            fill = (int *) pj_malloc(sizeof(int) * index->nx * index->ny);
+            if( index->bin_members == NULL || fill == NULL )
+            {
+                pj_dalloc( fill );
+                pj_gc_index_free( index );
+                return NULL;
+            }
+            memcpy( fill, index->bin_start, 
+                    sizeof(int) * index->nx * index->ny );
+        }
+    }
+
+    pj_dalloc( fill );
+
+    if( !pj_gc_index_dates( index, catalog ) )
+    {
+        pj_gc_index_free( index );
+        return NULL;
+    }
+
+    return index;
+}
+
+/************************************************************************/
+/*                         pj_gc_free_catalog()                         */
+/*                                                                      */
+/*      Deallocate a grid catalog (but not the referenced grids).       */
+/************************************************************************/
+
+void pj_gc_free_catalog( PJ_GridCatalog *catalog )
+
+{
+    PJ_ALLOCATOR allocator = catalog->allocator;
+    int i;
+
+    /* the definitions of a binary catalog are in its image */
+    for( i = 0; catalog->image == NULL && i < catalog->entry_count; i++ )
+    {
+        /* we don't own gridinfo - do not free here */
+        pj_allocator_free( &allocator, catalog->entries[i].definition );
     }
+    pj_gc_index_free( catalog->index );
+    if( catalog->image_unmap != NULL )
+        catalog->image_unmap( catalog->image_handle );
+    else
+        pj_dalloc( catalog->image );
+    pj_allocator_free( &allocator, catalog->catalog_name );
+    pj_allocator_free( &allocator, catalog->entries );
+    pj_allocator_free( &allocator, catalog );
+}
+
+/************************************************************************/
+/*                        pj_gc_free_catalogs()                         */
+/*                                                                      */
+/*      Deallocate the grid catalogs of a registry.                     */
+/************************************************************************/
+
+void pj_gc_free_catalogs( PJ_GRID_REGISTRY *registry )
+
+{
+    while( registry->catalog_list != NULL )
+    {
+        PJ_GridCatalog *catalog = registry->catalog_list;
+        registry->catalog_list = registry->catalog_list->next;
+
+        pj_gc_free_catalog( catalog );
+    }
+}
+
+/************************************************************************/
+/*                          pj_gc_unloadall()                           */
+/*                                                                      */
+/*      Deallocate all the grid catalogs of the context's registry.     */
+/************************************************************************/
+
+void pj_gc_unloadall( projCtx ctx )
+
+{
+    pj_gc_free_catalogs( pj_ctx_grid_registry( ctx ) );
 }
 
 /************************************************************************/
@@ -67,49 +320,491 @@ void pj_gc_unloadall( projCtx ctx )
 
 PJ_GridCatalog *pj_gc_findcatalog( projCtx ctx, const char *name )
 
+{
+    return pj_gc_findcatalog_in( ctx, pj_ctx_grid_registry( ctx ), name );
+}
+
+/************************************************************************/
+/*                        pj_gc_findcatalog_in()                        */
+/*                                                                      */
+/*      pj_gc_findcatalog() in the given registry, whose grids the      */
+/*      entries of the catalog then use.                                */
+/************************************************************************/
+
+PJ_GridCatalog *pj_gc_findcatalog_in( projCtx ctx, 
+                                      PJ_GRID_REGISTRY *registry,
+                                      const char *name )
+
 {
     PJ_GridCatalog *catalog;
 
-    pj_acquire_lock();
+    pj_rwlock_acquire( registry->catalog_lock, 0 );
 
-    for( catalog=grid_catalog_list; catalog != NULL; catalog = catalog->next ) 
+    for( catalog=registry->catalog_list; catalog != NULL; 
+         catalog = catalog->next ) 
     {
         if( strcmp(catalog->catalog_name, name) == 0 )
         {
-            pj_release_lock();
+            pj_rwlock_release( registry->catalog_lock, 0 );
             return catalog;
         }
     }
 
-    pj_release_lock();
+    pj_rwlock_release( registry->catalog_lock, 0 );
 
     catalog = pj_gc_readcatalog( ctx, name );
     if( catalog == NULL )
         return NULL;
+    /* a binary catalog comes with its index */
+    if( catalog->index == NULL )
+        catalog->index = pj_gc_index_build( catalog );
 
-    pj_acquire_lock();
-    catalog->next = grid_catalog_list;
-    grid_catalog_list = catalog;
-    pj_release_lock();
+    catalog->registry = registry;
+
+    pj_rwlock_acquire( registry->catalog_lock, 1 );
+    catalog->next = registry->catalog_list;
+    registry->catalog_list = catalog;
+    pj_rwlock_release( registry->catalog_lock, 1 );
 
     return catalog;
 }
 
+/************************************************************************/
+/*                        pj_gc_region_covers()                         */
+/************************************************************************/
+
+static int pj_gc_region_covers( const PJ_Region *region, LP location )
+
+{
+    return !( location.lam < region->ll_long
+              || location.lam > region->ur_long
+              || location.phi < region->ll_lat
+              || location.phi > region->ur_lat );
+}
+
+/************************************************************************/
+/*                          pj_gc_date_span()                           */
+/*                                                                      */
+/*      The dates around date between which the entries that apply      */
+/*      for it, in the sense of pj_gc_entry_applies(), stay the same,   */
+/*      and so the grid pj_gc_findgrid() returns.  For "after" grids    */
+/*      this is span[0] < date <= span[1], for "before" grids           */
+/*      span[0] <= date < span[1].                                      */
+/************************************************************************/
+
+static void pj_gc_date_span( const PJ_GridCatalog *catalog, int after,
+                             double date, double *span )
+
+{
+    const PJ_GC_INDEX *index = catalog->index;
+    int i;
+
+    span[0] = -HUGE_VAL;
+    span[1] = HUGE_VAL;
+
+/* -------------------------------------------------------------------- */
+/*      With the date index, the span is around the first date that     */
+/*      is not before date.                                             */
+/* -------------------------------------------------------------------- */
+    if( index != NULL )
+    {
+        int lo = 0, hi = index->date_count;
+
+        while( lo < hi )
+        {
+            int mid = (lo + hi) / 2;
+            double d = index->dates[mid];
+
+            if( after ? d < date : d <= date )
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if( lo > 0 )
+            span[0] = index->dates[lo-1];
+        if( lo < index->date_count )
+            span[1] = index->dates[lo];
+        return;
+    }
+
+    for( i = 0; i < catalog->entry_count; i++ )
+    {
+        double d = catalog->entries[i].date;
+
+        if( after ? d < date : d <= date )
+        {
+            if( d > span[0] )
+                span[0] = d;
+        }
+        else if( d < span[1] )
+            span[1] = d;
+    }
+}
+
+static int pj_gc_span_holds( int after, const double *span, double date )
+
+{
+    if( after )
+        return span[0] < date && date <= span[1];
+    return span[0] <= date && date < span[1];
+}
+
+/************************************************************************/
+/*                          pj_gc_grid_for()                            */
+/*                                                                      */
+/*      The "after" or "before" grid for a point and date, or NULL if   */
+/*      no usable entry covers it, setting *grid_date to the date of    */
+/*      the grid.  The grid found for the last point is kept along      */
+/*      with the region and the dates over which pj_gc_findgrid()       */
+/*      would return it again, so only points leaving them need a new   */
+/*      lookup.                                                         */
+/************************************************************************/
+
+static PJ_GRIDINFO *pj_gc_grid_for( PJ *defn, int after, LP input, 
+                                    double date, double *grid_date )
+
+{
+    PJ_GRIDINFO **last_grid;
+    PJ_Region   *last_region;
+    double      *last_date, *last_span;
+
+    if( after )
+    {
+        last_grid = &(defn->cold->last_after_grid);
+        last_region = &(defn->cold->last_after_region);
+        last_date = &(defn->cold->last_after_date);
+        last_span = defn->cold->last_after_span;
+    }
+    else
+    {
+        last_grid = &(defn->cold->last_before_grid);
+        last_region = &(defn->cold->last_before_region);
+        last_date = &(defn->cold->last_before_date);
+        last_span = defn->cold->last_before_span;
+    }
+
+    /* make sure we have an appropriate shift file available */
+    if( *last_grid == NULL
+        || !pj_gc_region_covers( last_region, input )
+        || !pj_gc_span_holds( after, last_span, date ) )
+    {
+        *last_grid = pj_gc_findgrid( defn->ctx, defn->cold->catalog, 
+                                     after, input, date, 
+                                     last_region, last_date );
+        pj_gc_date_span( defn->cold->catalog, after, date, last_span );
+    }
+    *grid_date = *last_date;
+
+    return *last_grid;
+}
+
+/************************************************************************/
+/*                          pj_gc_shift_with()                          */
+/*                                                                      */
+/*      Shift a point with the "after" or "before" grid for date,       */
+/*      setting *grid_date to the date of the grid, see                 */
+/*      pj_gc_grid_for().  Returns -38 if the grid cannot be loaded,    */
+/*      with output at HUGE_VAL if no grid shifts the point.            */
+/************************************************************************/
+
+static int pj_gc_shift_with( PJ *defn, int after, int inverse, LP input, 
+                             double date, LP *output, double *grid_date )
+
+{
+    PJ_GRIDINFO *gi = pj_gc_grid_for( defn, after, input, date, grid_date );
+
+    /* no usable entry covers the point */
+    if( gi == NULL )
+    {
+        output->lam = output->phi = HUGE_VAL;
+        return 0;
+    }
+
+    assert( gi->child == NULL );
+
+    /* load the grid shift info if we don't have it. */
+    if( !pj_gridinfo_acquire( defn->ctx, gi ) )
+    {
+        pj_ctx_set_errno( defn->ctx, -38 );
+        return -38;
+    }
+
+    *output = nad_cvt( input, inverse, gi->ct );
+    pj_gridinfo_release( gi );
+
+    return 0;
+}
+
+/*
+** Without dates of their own, the points of a definition are all
+** shifted for its +date, so each pair of "after" and "before" grids
+** they use is mixed with the same ratio.  The bilinear interpolation
+** being linear in the values of the grid, the pair is, to the float
+** rounding of the values, one grid of the mixed values, when both have
+** the same rows and columns, as the grids of a date series do.  Such a
+** blend is kept for each of the last PJ_GC_BLEND_MAX pairs used, its
+** values mixed PJ_GC_BLEND_ROWS rows at a time as points need them, so
+** that each point takes one interpolation instead of two.
+*/
+
+#define PJ_GC_BLEND_MAX  4
+#define PJ_GC_BLEND_ROWS 16
+
+typedef struct PJ_GC_BLEND_s {
+    struct PJ_GC_BLEND_s *next;   /* less recently used */
+    PJ_GRIDINFO   *after, *before;
+    double        date, mix_ratio;
+    struct CTABLE ct;             /* of the mixed values */
+    int           band_count;
+    unsigned char *band_ready;    /* bands of rows mixed */
+    double        max_phi;        /* largest latitude shift mixed */
+} PJ_GC_BLEND;
+
+/************************************************************************/
+/*                         pj_gc_blend_free()                           */
+/*                                                                      */
+/*      Free the blends of a definition, see pj_gc_apply_gridshift().   */
+/************************************************************************/
+
+void pj_gc_blend_free( PJ *defn )
+
+{
+    PJ_GC_BLEND *blend, *next;
+
+    for( blend = defn->cold->gc_blends; blend != NULL; blend = next )
+    {
+        next = blend->next;
+        pj_dalloc( blend->ct.cvs );
+        pj_dalloc( blend->band_ready );
+        pj_dalloc( blend );
+    }
+    defn->cold->gc_blends = NULL;
+}
+
+/************************************************************************/
+/*                          pj_gc_blend_get()                           */
+/*                                                                      */
+/*      The blend of a pair of grids for date, its values not mixed     */
+/*      yet, made the most recently used.  Returns NULL where the       */
+/*      grids have other rows or columns, or if out of memory.          */
+/************************************************************************/
+
+static PJ_GC_BLEND *pj_gc_blend_get( PJ *defn, PJ_GRIDINFO *after, 
+                                     PJ_GRIDINFO *before, double date,
+                                     double mix_ratio )
+
+{
+    PJ_GC_BLEND **link = &(defn->cold->gc_blends), *blend;
+    struct CTABLE *a = after->ct, *b = before->ct;
+    int count = 0;
+
+    if( a == NULL || b == NULL
+        || a->ll.lam != b->ll.lam || a->ll.phi != b->ll.phi
+        || a->del.lam != b->del.lam || a->del.phi != b->del.phi
+        || a->lim.lam != b->lim.lam || a->lim.phi != b->lim.phi
+        || a->lim.lam < 1 || a->lim.phi < 1 )
+        return NULL;
+
+    for( blend = *link; blend != NULL; blend = *link )
+    {
+        if( blend->after == after && blend->before == before 
+            && blend->date == date )
+        {
+            *link = blend->next;
+            blend->next = defn->cold->gc_blends;
+            defn->cold->gc_blends = blend;
+            return blend;
+        }
+
+        /* the least recently used makes room for the new one */
+        if( ++count == PJ_GC_BLEND_MAX && blend->next == NULL )
+        {
+            *link = NULL;
+            pj_dalloc( blend->ct.cvs );
+            pj_dalloc( blend->band_ready );
+            pj_dalloc( blend );
+            break;
+        }
+        link = &(blend->next);
+    }
+
+    if( (blend = (PJ_GC_BLEND *) pj_malloc( sizeof(PJ_GC_BLEND) )) == NULL )
+        return NULL;
+    memset( blend, 0, sizeof(PJ_GC_BLEND) );
+    blend->after = after;
+    blend->before = before;
+    blend->date = date;
+    blend->mix_ratio = mix_ratio;
+    blend->ct = *a;
+    blend->band_count = (a->lim.phi + PJ_GC_BLEND_ROWS - 1) 
+        / PJ_GC_BLEND_ROWS;
+
+    /* the values of a band are only written, and so paged in, when mixed */
+    blend->ct.cvs = (FLP *) 
+        pj_malloc( sizeof(FLP) * (size_t) a->lim.lam * a->lim.phi );
+    blend->band_ready = (unsigned char *) pj_malloc( blend->band_count );
+    if( blend->ct.cvs == NULL || blend->band_ready == NULL )
+    {
+        pj_dalloc( blend->ct.cvs );
+        pj_dalloc( blend->band_ready );
+        pj_dalloc( blend );
+        return NULL;
+    }
+    memset( blend->band_ready, 0, blend->band_count );
+
+    blend->next = defn->cold->gc_blends;
+    defn->cold->gc_blends = blend;
+
+    return blend;
+}
+
+/************************************************************************/
+/*                          pj_gc_blend_rows()                          */
+/*                                                                      */
+/*      Mix the values of the rows first to last of a blend, if not     */
+/*      done yet.  Returns -38 if the grids cannot be loaded.           */
+/************************************************************************/
+
+static int pj_gc_blend_rows( PJ *defn, PJ_GC_BLEND *blend, 
+                             int first, int last )
+
+{
+    int band, first_band, last_band, columns = blend->ct.lim.lam;
+    double mix = blend->mix_ratio;
+
+    if( first < 0 )
+        first = 0;
+    if( last >= blend->ct.lim.phi )
+        last = blend->ct.lim.phi - 1;
+    if( first > last )
+        return 0;
+    first_band = first / PJ_GC_BLEND_ROWS;
+    last_band = last / PJ_GC_BLEND_ROWS;
+
+    for( band = first_band; band <= last_band; band++ )
+    {
+        long i, start, end;
+
+        if( blend->band_ready[band] )
+            continue;
+
+        if( !pj_gridinfo_acquire( defn->ctx, blend->after ) )
+        {
+            pj_ctx_set_errno( defn->ctx, -38 );
+            return -38;
+        }
+        if( !pj_gridinfo_acquire( defn->ctx, blend->before ) )
+        {
+            pj_gridinfo_release( blend->after );
+            pj_ctx_set_errno( defn->ctx, -38 );
+            return -38;
+        }
+
+        start = (long) band * PJ_GC_BLEND_ROWS * columns;
+        end = (long) (band + 1) * PJ_GC_BLEND_ROWS * columns;
+        if( end > (long) blend->ct.lim.phi * columns )
+            end = (long) blend->ct.lim.phi * columns;
+
+        for( i = start; i < end; i++ )
+        {
+            const FLP *a = blend->after->ct->cvs + i;
+            const FLP *b = blend->before->ct->cvs + i;
+            FLP *v = blend->ct.cvs + i;
+
+            v->lam = (float) (mix * a->lam + (1.0-mix) * b->lam);
+            v->phi = (float) (mix * a->phi + (1.0-mix) * b->phi);
+            if( fabs(v->phi) > blend->max_phi )
+                blend->max_phi = fabs(v->phi);
+        }
+
+        pj_gridinfo_release( blend->before );
+        pj_gridinfo_release( blend->after );
+        blend->band_ready[band] = 1;
+    }
+
+    return 0;
+}
+
+/************************************************************************/
+/*                         pj_gc_blend_shift()                          */
+/*                                                                      */
+/*      Shift a point with a blend, mixing the rows it needs first.     */
+/*      The inverse iterates within the largest latitude shift of the   */
+/*      rows mixed of the input point, so the rows within it are        */
+/*      mixed until it no longer grows.  Returns -38 if the grids       */
+/*      cannot be loaded, with output at HUGE_VAL if the point is       */
+/*      outside of them.                                                */
+/************************************************************************/
+
+static int pj_gc_blend_shift( PJ *defn, PJ_GC_BLEND *blend, int inverse,
+                              LP input, LP *output )
+
+{
+    double row = (input.phi - blend->ct.ll.phi) / blend->ct.del.phi;
+    double max_phi;
+    int margin = 1;
+
+    if( row < -1.0 || row > blend->ct.lim.phi + 1.0 )
+    {
+        output->lam = output->phi = HUGE_VAL;
+        return 0;
+    }
+
+    do {
+        max_phi = blend->max_phi;
+        if( inverse )
+            margin = (int) ceil( max_phi / blend->ct.del.phi ) + 1;
+        if( pj_gc_blend_rows( defn, blend, (int) floor(row) - margin,
+                              (int) floor(row) + 1 + margin ) != 0 )
+            return -38;
+    } while( inverse && blend->max_phi > max_phi );
+
+    *output = nad_cvt( input, inverse, &(blend->ct) );
+
+    return 0;
+}
+
+/************************************************************************/
+/*                          pj_gc_log_miss()                            */
+/************************************************************************/
+
+static void pj_gc_log_miss( PJ *defn, double x, double y )
+
+{
+    if( defn->ctx->debug_level >= PJ_LOG_DEBUG_MAJOR )
+    {
+        pj_log( defn->ctx, PJ_LOG_DEBUG_MAJOR,
+                "pj_apply_gridshift(): failed to find a grid shift table for\n"
+                "                      location (%.7fdW,%.7fdN)",
+                x * RAD_TO_DEG, y * RAD_TO_DEG );
+    }
+}
+
 /************************************************************************/
 /*                       pj_gc_apply_gridshift()                        */
+/*                                                                      */
+/*      Shift the points with the grids of the catalog for their        */
+/*      dates, interpolating between the grids before and after a       */
+/*      date.  The dates are t[i*point_offset], in decimal years, or    */
+/*      the +date of the definition for all points if t is NULL, when   */
+/*      points go through the blend of their two grids where there is   */
+/*      one, see pj_gc_blend_get().                                     */
 /************************************************************************/
 
 int pj_gc_apply_gridshift( PJ *defn, int inverse, 
-                           long point_count, int point_offset, 
-                           double *x, double *y, double *z )
+                           long point_count, int point_offset,
+                           double *x, double *y, double *z, 
+                           const double *t )
 
 {
-    int i;
+    long i;
 
-    if( defn->catalog == NULL ) 
+    if( defn->cold->catalog == NULL ) 
     {
-        defn->catalog = pj_gc_findcatalog( defn->ctx, defn->catalog_name );
-        if( defn->catalog == NULL )
+        defn->cold->catalog = pj_gc_findcatalog_in( defn->ctx, 
+                                              pj_grid_registry_of( defn ),
+                                              defn->cold->catalog_name );
+        if( defn->cold->catalog == NULL )
             return defn->ctx->last_errno;
     }
 
@@ -119,94 +814,74 @@ int pj_gc_apply_gridshift( PJ *defn, int inverse,
     {
         long io = i * point_offset;
         LP   input, output_after, output_before;
-        double mix_ratio;
-        PJ_GRIDINFO *gi;
+        double mix_ratio, date, after_date, before_date;
 
         input.phi = y[io];
         input.lam = x[io];
+        date = t != NULL ? t[io] : defn->cold->datum_date;
 
-        /* make sure we have appropriate "after" shift file available */
-        if( defn->last_after_grid == NULL
-            || input.lam < defn->last_after_region.ll_long
-            || input.lam > defn->last_after_region.ur_long
-            || input.phi < defn->last_after_region.ll_lat
-            || input.phi > defn->last_after_region.ll_lat ) {
-            defn->last_after_grid = 
-                pj_gc_findgrid( defn->ctx, defn->catalog, 
-                                1, input, defn->datum_date, 
-                                &(defn->last_after_region), 
-                                &(defn->last_after_date));
+/* -------------------------------------------------------------------- */
+/*      With the date of the definition, through the blend of the       */
+/*      two grids of the point, where they mix.                         */
+/* -------------------------------------------------------------------- */
+        if( t == NULL && date != 0.0 )
+        {
+            PJ_GRIDINFO *after, *before;
+            PJ_GC_BLEND *blend = NULL;
+
+            after = pj_gc_grid_for( defn, 1, input, date, &after_date );
+            before = pj_gc_grid_for( defn, 0, input, date, &before_date );
+            if( after != NULL && before != NULL 
+                && after_date != before_date )
+                blend = pj_gc_blend_get( defn, after, before, date,
+                                         (date - before_date) 
+                                         / (after_date - before_date) );
+            if( blend != NULL )
+            {
+                if( pj_gc_blend_shift( defn, blend, inverse, input, 
+                                       &output_after ) != 0 )
+                    return -38;
+                if( output_after.lam == HUGE_VAL )
+                    pj_gc_log_miss( defn, x[io], y[io] );
+                else
+                {
+                    y[io] = output_after.phi;
+                    x[io] = output_after.lam;
+                }
+                continue;
+            }
         }
-        gi = defn->last_after_grid;
-        assert( gi->child == NULL );
 
-        /* load the grid shift info if we don't have it. */
-        if( gi->ct->cvs == NULL && !pj_gridinfo_load( defn->ctx, gi ) )
-        {
-            pj_ctx_set_errno( defn->ctx, -38 );
+        if( pj_gc_shift_with( defn, 1, inverse, input, date, 
+                              &output_after, &after_date ) != 0 )
             return -38;
-        }
-            
-        output_after = nad_cvt( input, inverse, gi->ct );
         if( output_after.lam == HUGE_VAL )
         {
-            if( defn->ctx->debug_level >= PJ_LOG_DEBUG_MAJOR )
-            {
-                pj_log( defn->ctx, PJ_LOG_DEBUG_MAJOR,
-                        "pj_apply_gridshift(): failed to find a grid shift table for\n"
-                        "                      location (%.7fdW,%.7fdN)",
-                        x[io] * RAD_TO_DEG, 
-                        y[io] * RAD_TO_DEG );
-            }
+            pj_gc_log_miss( defn, x[io], y[io] );
             continue;
         }
 
-        if( defn->datum_date == 0.0 ) 
+        if( date == 0.0 ) 
         {
             y[io] = output_after.phi;
             x[io] = output_after.lam;
             continue;
         }
 
-        /* make sure we have appropriate "before" shift file available */
-        if( defn->last_before_grid == NULL
-            || input.lam < defn->last_before_region.ll_long
-            || input.lam > defn->last_before_region.ur_long
-            || input.phi < defn->last_before_region.ll_lat
-            || input.phi > defn->last_before_region.ll_lat ) {
-            defn->last_before_grid = 
-                pj_gc_findgrid( defn->ctx, defn->catalog, 
-                                0, input, defn->datum_date, 
-                                &(defn->last_before_region), 
-                                &(defn->last_before_date));
-        }
-
-        gi = defn->last_before_grid;
-        assert( gi->child == NULL );
-
-        /* load the grid shift info if we don't have it. */
-        if( gi->ct->cvs == NULL && !pj_gridinfo_load( defn->ctx, gi ) )
-        {
-            pj_ctx_set_errno( defn->ctx, -38 );
+        if( pj_gc_shift_with( defn, 0, inverse, input, date, 
+                              &output_before, &before_date ) != 0 )
             return -38;
-        }
-            
-        output_before = nad_cvt( input, inverse, gi->ct );
         if( output_before.lam == HUGE_VAL )
         {
-            if( defn->ctx->debug_level >= PJ_LOG_DEBUG_MAJOR )
-            {
-                pj_log( defn->ctx, PJ_LOG_DEBUG_MAJOR,
-                        "pj_apply_gridshift(): failed to find a grid shift table for\n"
-                        "                      location (%.7fdW,%.7fdN)",
-                        x[io] * RAD_TO_DEG, 
-                        y[io] * RAD_TO_DEG );
-            }
+            pj_gc_log_miss( defn, x[io], y[io] );
             continue;
         }
 
-        mix_ratio = (defn->datum_date - defn->last_before_date) 
-            / (defn->last_after_date - defn->last_before_date);
+        /* both are the grid of the date itself */
+        if( after_date == before_date )
+            mix_ratio = 1.0;
+        else
+            mix_ratio = (date - before_date) / (after_date - before_date);
 
         y[io] = mix_ratio * output_after.phi 
             + (1.0-mix_ratio) * output_before.phi;
@@ -217,8 +892,96 @@ int pj_gc_apply_gridshift( PJ *defn, int inverse,
     return 0;
 }
 
+/************************************************************************/
+/*                        pj_gc_entry_applies()                         */
+/*                                                                      */
+/*      Whether the entry may be used on the given side of the date.    */
+/************************************************************************/
+
+static int pj_gc_entry_applies( const PJ_GridCatalogEntry *entry, int after,
+                                double date )
+
+{
+    if( (after && entry->date < date) 
+        || (!after && entry->date > date) )
+        return 0;
+
+    return entry->available != -1;
+}
+
+/************************************************************************/
+/*                        pj_gc_region_exclude()                        */
+/*                                                                      */
+/*      Shrink region so that it no longer meets other, which does      */
+/*      not cover location.  Of the sides of other that location is     */
+/*      beyond, the cut keeping the largest area is made.  The cut      */
+/*      stays a little clear of other, as regions include their         */
+/*      edges.                                                          */
+/************************************************************************/
+
+static double pj_gc_below( double value )
+
+{
+    return value - fabs(value) * DBL_EPSILON - DBL_MIN;
+}
+
+static double pj_gc_above( double value )
+
+{
+    return value + fabs(value) * DBL_EPSILON + DBL_MIN;
+}
+
+static void pj_gc_region_exclude( PJ_Region *region, const PJ_Region *other,
+                                  LP location )
+
+{
+    PJ_Region cut, best;
+    double area, best_area = -1.0;
+
+    if( other->ll_long > region->ur_long || other->ur_long < region->ll_long
+        || other->ll_lat > region->ur_lat || other->ur_lat < region->ll_lat )
+        return;
+
+    best = *region;
+
+#define TRY_CUT(test, field, value)                                     \
+    if( test )                                                          \
+    {                                                                   \
+        cut = *region;                                                  \
+        cut.field = value;                                              \
+        area = (cut.ur_long - cut.ll_long) * (cut.ur_lat - cut.ll_lat); \
+        if( area > best_area )                                          \
+        {                                                               \
+            best = cut;                                                 \
+            best_area = area;                                           \
+        }                                                               \
+    }
+
+    TRY_CUT( location.lam < other->ll_long, ur_long, 
+             pj_gc_below(other->ll_long) );
+    TRY_CUT( location.lam > other->ur_long, ll_long, 
+             pj_gc_above(other->ur_long) );
+    TRY_CUT( location.phi < other->ll_lat, ur_lat, 
+             pj_gc_below(other->ll_lat) );
+    TRY_CUT( location.phi > other->ur_lat, ll_lat, 
+             pj_gc_above(other->ur_lat) );
+
+#undef TRY_CUT
+
+    *region = best;
+}
+
 /************************************************************************/
 /*                           pj_c_findgrid()                            */
+/*                                                                      */
+/*      Return the grid of the first entry, in catalog order, that      */
+/*      covers location and applies on the given side of date.  Only    */
+/*      the entries of the index bin of location need be tried.         */
+/*                                                                      */
+/*      If optimal_region is set it is given a region around            */
+/*      location over which the same entry would be found: the          */
+/*      entry region within the bin, less the earlier entries of the    */
+/*      bin that apply.                                                 */
 /************************************************************************/
 
 PJ_GRIDINFO *pj_gc_findgrid( projCtx ctx, PJ_GridCatalog *catalog, int after,
@@ -226,30 +989,60 @@ PJ_GRIDINFO *pj_gc_findgrid( projCtx ctx, PJ_GridCatalog *catalog, int after,
                              PJ_Region *optimal_region,
                              double *grid_date ) 
 {
-    int iEntry;
+    PJ_GC_INDEX *index = catalog->index;
+    const int *members = NULL;
+    int first = 0, last = catalog->entry_count, m, m2;
+    int bin_x = 0, bin_y = 0;
     PJ_GridCatalogEntry *entry = NULL;
 
-    for( iEntry = 0; iEntry < catalog->entry_count; iEntry++ ) 
+    if( index != NULL )
     {
-        entry = catalog->entries + iEntry;
+        int bin;
 
-        if( (after && entry->date < date) 
-            || (!after && entry->date > date) )
-            continue;
+        bin_x = pj_gc_bin( location.lam, index->ll.lam, index->del.lam, 
+                           index->nx );
+        bin_y = pj_gc_bin( location.phi, index->ll.phi, index->del.phi, 
+                           index->ny );
+        bin = bin_y * index->nx + bin_x;
 
-        if( location.lam < entry->region.ll_long
-            || location.lam > entry->region.ur_long
-            || location.phi < entry->region.ll_lat
-            || location.phi > entry->region.ur_lat )
+        members = index->bin_members;
+        first = index->bin_start[bin];
+        last = index->bin_start[bin+1];
+    }
+
+    for( m = first; m < last; m++ ) 
+    {
+        entry = catalog->entries + (members != NULL ? members[m] : m);
+
+        if( !pj_gc_entry_applies( entry, after, date )
+            || !pj_gc_region_covers( &(entry->region), location ) )
             continue;
 
-        if( entry->available == -1 )
+        if( entry->gridinfo == NULL )
+        {
+            PJ_GRIDINFO **gridlist = NULL;
+            int grid_count = 0;
+            gridlist = pj_gridlist_from_registry( ctx, 
+                catalog->registry != NULL 
+                ? catalog->registry : pj_ctx_grid_registry( ctx ),
+                entry->definition, &grid_count );
+            if( grid_count == 1 )
+                entry->gridinfo = gridlist[0];
+            pj_dalloc( gridlist );
+        }
+
+        /* entries whose grid cannot be used are skipped from now on */
+        if( entry->gridinfo == NULL )
+        {
+            entry->available = -1;
             continue;
+        }
+        entry->available = 1;
 
         break;
     }
 
-    if( iEntry == catalog->entry_count )
+    if( m == last )
     {
         if( grid_date )
             *grid_date = 0.0;
@@ -263,19 +1056,42 @@ PJ_GRIDINFO *pj_gc_findgrid( projCtx ctx, PJ_GridCatalog *catalog, int after,
 
     if( optimal_region )
     {
-        
+        PJ_Region region = entry->region;
+
+        /* stay clear of the edges of inner bins, whose neighbours 
+           list other entries */
+        if( index != NULL )
+        {
+            double margin_lam = index->del.lam * 1e-6;
+            double margin_phi = index->del.phi * 1e-6;
+            double edge;
+
+            edge = index->ll.lam + bin_x * index->del.lam + margin_lam;
+            if( bin_x > 0 && edge > region.ll_long )
+                region.ll_long = edge;
+            edge = index->ll.lam + (bin_x+1) * index->del.lam - margin_lam;
+            if( bin_x < index->nx - 1 && edge < region.ur_long )
+                region.ur_long = edge;
+            edge = index->ll.phi + bin_y * index->del.phi + margin_phi;
+            if( bin_y > 0 && edge > region.ll_lat )
+                region.ll_lat = edge;
+            edge = index->ll.phi + (bin_y+1) * index->del.phi - margin_phi;
+            if( bin_y < index->ny - 1 && edge < region.ur_lat )
+                region.ur_lat = edge;
+        }
+
+        for( m2 = first; m2 < m; m2++ )
+        {
+            PJ_GridCatalogEntry *other = 
+                catalog->entries + (members != NULL ? members[m2] : m2);
+
+            if( pj_gc_entry_applies( other, after, date ) )
+                pj_gc_region_exclude( &region, &(other->region), location );
+        }
+
+        *optimal_region = region;
     }
 
-    if( entry->gridinfo == NULL )
-    {
-        PJ_GRIDINFO **gridlist = NULL;
-        int grid_count = 0;
-        gridlist = pj_gridlist_from_nadgrids( ctx, entry->definition, 
-                                              &grid_count);
-        if( grid_count == 1 )
-            entry->gridinfo = gridlist[0];
-    }
-    
     return entry->gridinfo;
 }
                              
@@ -0,0 +1,365 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Bin index used to pick the subgrid of a grid shift file that
+ *           covers a location, without testing every child in turn.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <string.h>
+#include <math.h>
+
+PJ_CVSID("$Id$");
+
+#define MAX_BINS_PER_AXIS 64
+
+/************************************************************************/
+/*                           pj_grid_bin()                              */
+/*                                                                      */
+/*      Bin number along one axis, clamped so that points and           */
+/*      extents outside the parent still land in an edge bin.           */
+/************************************************************************/
+
+static int pj_grid_bin( double value, double origin, double size, int count )
+
+{
+    double bin = floor((value - origin) / size);
+
+    if( !(bin >= 0) ) /* also catches NaN */
+        return 0;
+    if( bin >= count )
+        return count - 1;
+    return (int) bin;
+}
+
+/************************************************************************/
+/*                         pj_grid_index_free()                         */
+/************************************************************************/
+
+void pj_grid_index_free( PJ_GRID_INDEX *index )
+
+{
+    if( index == NULL )
+        return;
+
+    pj_dalloc( index->entries );
+    pj_dalloc( index->bin_start );
+    pj_dalloc( index->bin_members );
+    pj_dalloc( index );
+}
+
+/************************************************************************/
+/*                         pj_grid_index_build()                        */
+/*                                                                      */
+/*      Build the bin index of the children of gi.  Returns NULL if     */
+/*      we run out of memory, in which case the children are just       */
+/*      scanned.                                                        */
+/************************************************************************/
+
+static PJ_GRID_INDEX *pj_grid_index_build( PJ_GRIDINFO *gi )
+
+{
+    struct CTABLE *ct = gi->ct;
+    PJ_GRID_INDEX *index;
+    PJ_GRIDINFO *child;
+    int child_count = 0, member_count = 0, i, bin;
+
+    for( child = gi->child; child != NULL; child = child->next )
+        child_count++;
+
+    index = (PJ_GRID_INDEX *) pj_malloc(sizeof(PJ_GRID_INDEX));
+    if( index == NULL )
+        return NULL;
+    memset( index, 0, sizeof(PJ_GRID_INDEX) );
+
+/* -------------------------------------------------------------------- */
+/*      About four bins per child, within a fixed limit.                */
+/* -------------------------------------------------------------------- */
+    index->nx = index->ny = 2 * (int) ceil(sqrt((double) child_count));
+    if( index->nx > MAX_BINS_PER_AXIS )
+        index->nx = index->ny = MAX_BINS_PER_AXIS;
+
+    index->ll = ct->ll;
+    index->del.lam = (ct->lim.lam - 1) * ct->del.lam / index->nx;
+    index->del.phi = (ct->lim.phi - 1) * ct->del.phi / index->ny;
+    if( !(index->del.lam > 0) )
+    {
+        index->nx = 1;
+        index->del.lam = 1.0;
+    }
+    if( !(index->del.phi > 0) )
+    {
+        index->ny = 1;
+        index->del.phi = 1.0;
+    }
+
+    index->entries = (PJ_GRID_INDEX_ENTRY *)
+        pj_malloc(sizeof(PJ_GRID_INDEX_ENTRY) * child_count);
+    index->bin_start = (int *)
+        pj_malloc(sizeof(int) * (index->nx * index->ny + 1));
+    if( index->entries == NULL || index->bin_start == NULL )
+    {
+        pj_grid_index_free( index );
+        return NULL;
+    }
+    memset( index->bin_start, 0, sizeof(int) * (index->nx * index->ny + 1) );
+
+/* -------------------------------------------------------------------- */
+/*      Record the extents, and count the members of each bin.          */
+/* -------------------------------------------------------------------- */
+    for( child = gi->child, i = 0; child != NULL; child = child->next, i++ )
+    {
+        PJ_GRID_INDEX_ENTRY *entry = index->entries + i;
+        struct CTABLE *ct1 = child->ct;
+        int ix, iy, ix1, iy1;
+
+        entry->gi = child;
+        entry->min = ct1->ll;
+        entry->max.lam = ct1->ll.lam + (ct1->lim.lam-1) * ct1->del.lam;
+        entry->max.phi = ct1->ll.phi + (ct1->lim.phi-1) * ct1->del.phi;
+        entry->epsilon = (fabs(ct1->del.phi)+fabs(ct1->del.lam))/10000.0;
+
+        ix1 = pj_grid_bin( entry->max.lam + entry->epsilon, index->ll.lam,
+                           index->del.lam, index->nx );
+        iy1 = pj_grid_bin( entry->max.phi + entry->epsilon, index->ll.phi,
+                           index->del.phi, index->ny );
+        for( iy = pj_grid_bin( entry->min.phi - entry->epsilon, index->ll.phi,
+                               index->del.phi, index->ny ); iy <= iy1; iy++ )
+        {
+            for( ix = pj_grid_bin( entry->min.lam - entry->epsilon,
+                                   index->ll.lam, index->del.lam, index->nx );
+                 ix <= ix1; ix++ )
+            {
+                index->bin_start[iy * index->nx + ix + 1]++;
+                member_count++;
+            }
+        }
+    }
+
+    for( bin = 0; bin < index->nx * index->ny; bin++ )
+        index->bin_start[bin+1] += index->bin_start[bin];
+
+/* -------------------------------------------------------------------- */
+/*      Fill the bins, keeping the list order of the children.          */
+/* -------------------------------------------------------------------- */
+    index->bin_members = (int *) pj_malloc(sizeof(int) * (member_count + 1));
+    if( index->bin_members == NULL )
+    {
+        pj_grid_index_free( index );
+        return NULL;
+    }
+
+    {
+        int *fill = (int *) pj_malloc(sizeof(int) * index->nx * index->ny);
+
+        if( fill == NULL )
+        {
+            pj_grid_index_free( index );
+            return NULL;
+        }
+        memcpy( fill, index->bin_start, sizeof(int) * index->nx * index->ny );
+
+        for( i = 0; i < child_count; i++ )
+        {
+            PJ_GRID_INDEX_ENTRY *entry = index->entries + i;
+            int ix, iy, ix1, iy1;
+
+            ix1 = pj_grid_bin( entry->max.lam + entry->epsilon, index->ll.lam,
+                               index->del.lam, index->nx );
+            iy1 = pj_grid_bin( entry->max.phi + entry->epsilon, index->ll.phi,
+                               index->del.phi, index->ny );
+            for( iy = pj_grid_bin( entry->min.phi - entry->epsilon,
+                                   index->ll.phi, index->del.phi, index->ny );
+                 iy <= iy1; iy++ )
+            {
+                for( ix = pj_grid_bin( entry->min.lam - entry->epsilon,
+                                       index->ll.lam, index->del.lam,
+                                       index->nx );
+                     ix <= ix1; ix++ )
+                    index->bin_members[fill[iy * index->nx + ix]++] = i;
+            }
+        }
+
+        pj_dalloc( fill );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Flag the children whose widened extent is within the parent's   */
+/*      and meets no earlier sibling, so that a point in it is sure     */
+/*      to descend to it.  Siblings meeting it share one of its bins.   */
+/* -------------------------------------------------------------------- */
+    {
+        double epsilon = (fabs(ct->del.phi)+fabs(ct->del.lam))/10000.0;
+        LP pmin, pmax;
+
+        pmin.lam = ct->ll.lam - epsilon;
+        pmin.phi = ct->ll.phi - epsilon;
+        pmax.lam = ct->ll.lam + (ct->lim.lam-1) * ct->del.lam + epsilon;
+        pmax.phi = ct->ll.phi + (ct->lim.phi-1) * ct->del.phi + epsilon;
+
+        for( i = 0; i < child_count; i++ )
+        {
+            PJ_GRID_INDEX_ENTRY *entry = index->entries + i;
+
+            entry->exclusive = 
+                entry->min.lam - entry->epsilon >= pmin.lam
+                && entry->min.phi - entry->epsilon >= pmin.phi
+                && entry->max.lam + entry->epsilon <= pmax.lam
+                && entry->max.phi + entry->epsilon <= pmax.phi;
+        }
+
+        for( bin = 0; bin < index->nx * index->ny; bin++ )
+        {
+            int m1, m2;
+
+            for( m1 = index->bin_start[bin]; m1 < index->bin_start[bin+1]; 
+                 m1++ )
+            {
+                PJ_GRID_INDEX_ENTRY *e1 = 
+                    index->entries + index->bin_members[m1];
+
+                for( m2 = index->bin_start[bin]; m2 < m1; m2++ )
+                {
+                    PJ_GRID_INDEX_ENTRY *e2 = 
+                        index->entries + index->bin_members[m2];
+
+                    if( e1->min.lam - e1->epsilon <= e2->max.lam + e2->epsilon
+                        && e2->min.lam - e2->epsilon <= e1->max.lam + e1->epsilon
+                        && e1->min.phi - e1->epsilon <= e2->max.phi + e2->epsilon
+                        && e2->min.phi - e2->epsilon <= e1->max.phi + e1->epsilon )
+                    {
+                        e1->exclusive = 0;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    return index;
+}
+
+/************************************************************************/
+/*                        pj_gridinfo_descend()                         */
+/*                                                                      */
+/*      Return the most refined grid covering input, starting from      */
+/*      gi which is assumed to cover it.  Like the linear search it     */
+/*      replaces, the first matching child in list order is used at     */
+/*      each level.  If widen is set the extents are widened by the     */
+/*      tolerance used by pj_apply_gridshift_3(), otherwise they are    */
+/*      taken exactly as pj_apply_vgridshift() does.                    */
+/*                                                                      */
+/*      If exclusive is not NULL it is set to whether any point in      */
+/*      the widened extent of the returned grid would descend to it     */
+/*      through the same children, which lets pj_apply_gridshift_3()    */
+/*      start from it for the next point.                               */
+/************************************************************************/
+
+PJ_GRIDINFO *pj_gridinfo_descend( PJ_GRIDINFO *gi, LP input, int widen,
+                                  int *exclusive )
+
+{
+    if( exclusive != NULL )
+        *exclusive = widen;
+
+    while( gi->child != NULL )
+    {
+        PJ_GRID_INDEX *index = gi->child_index;
+        PJ_GRIDINFO *found = NULL;
+        int bin, member;
+
+        if( index == NULL )
+        {
+            pj_mutex_lock( gi->lock );
+            if( gi->child_index == NULL )
+                gi->child_index = pj_grid_index_build( gi );
+            index = gi->child_index;
+            pj_mutex_unlock( gi->lock );
+        }
+
+        if( index == NULL )
+        {
+            /* no memory for an index, test each child in turn */
+            PJ_GRIDINFO *child;
+
+            for( child = gi->child; child != NULL; child = child->next )
+            {
+                struct CTABLE *ct1 = child->ct;
+                double epsilon = widen ?
+                    (fabs(ct1->del.phi)+fabs(ct1->del.lam))/10000.0 : 0.0;
+
+                if( ct1->ll.phi - epsilon > input.phi
+                    || ct1->ll.lam - epsilon > input.lam
+                    || (ct1->ll.phi+(ct1->lim.phi-1)*ct1->del.phi + epsilon
+                        < input.phi)
+                    || (ct1->ll.lam+(ct1->lim.lam-1)*ct1->del.lam + epsilon
+                        < input.lam) )
+                    continue;
+
+                break;
+            }
+            found = child;
+
+            if( exclusive != NULL && found != NULL )
+                *exclusive = 0;
+        }
+        else
+        {
+            bin = pj_grid_bin( input.phi, index->ll.phi,
+                               index->del.phi, index->ny ) * index->nx
+                + pj_grid_bin( input.lam, index->ll.lam,
+                               index->del.lam, index->nx );
+
+            for( member = index->bin_start[bin];
+                 member < index->bin_start[bin+1]; member++ )
+            {
+                PJ_GRID_INDEX_ENTRY *entry =
+                    index->entries + index->bin_members[member];
+                double epsilon = widen ? entry->epsilon : 0.0;
+
+                if( entry->min.phi - epsilon > input.phi
+                    || entry->min.lam - epsilon > input.lam
+                    || entry->max.phi + epsilon < input.phi
+                    || entry->max.lam + epsilon < input.lam )
+                    continue;
+
+                found = entry->gi;
+                if( exclusive != NULL && !entry->exclusive )
+                    *exclusive = 0;
+                break;
+            }
+        }
+
+        /* If we didn't find a child then nothing more to do */
+        if( found == NULL )
+            break;
+
+        gi = found;
+    }
+
+    return gi;
+}
@@ -31,6 +31,7 @@
 #define PJ_LIB__
 
 #include <projects.h>
+#include <pj_trace.h>
 #include <string.h>
 #include <math.h>
 #include <errno.h>
@@ -46,7 +47,7 @@
 #endif /* _WIN32_WCE */
 
 /************************************************************************/
-/*                             swap_words()                             */
+/*                           pj_swap_words()                            */
 /*                                                                      */
 /*      Convert the byte order of the given word(s) in place.           */
 /************************************************************************/
@@ -54,11 +55,48 @@
 static int  byte_order_test = 1;
 #define IS_LSB	(((unsigned char *) (&byte_order_test))[0] == 1)
 
-static void swap_words( unsigned char *data, int word_size, int word_count )
+#define PJ_SWAP32(v) (((v) >> 24) | (((v) >> 8) & 0xff00U) \
+                      | (((v) & 0xff00U) << 8) | (((v) & 0xffU) << 24))
+
+static PJ_INLINE void swap_words_inline( unsigned char *data, 
+                                        int word_size, int word_count )
 
 {
     int	word;
 
+    /* words of 4 and 8 bytes as 32 bit values, for the compiler to use
+       its byte swap and shuffle instructions */
+    if( word_size == 4 && sizeof(unsigned int) == 4 )
+    {
+        for( word = 0; word < word_count; word++ )
+        {
+            unsigned int v;
+
+            memcpy( &v, data, 4 );
+            v = PJ_SWAP32( v );
+            memcpy( data, &v, 4 );
+            data += 4;
+        }
+        return;
+    }
+
+    if( word_size == 8 && sizeof(unsigned int) == 4 )
+    {
+        for( word = 0; word < word_count; word++ )
+        {
+            unsigned int lo, hi;
+
+            memcpy( &lo, data, 4 );
+            memcpy( &hi, data + 4, 4 );
+            lo = PJ_SWAP32( lo );
+            hi = PJ_SWAP32( hi );
+            memcpy( data, &hi, 4 );
+            memcpy( data + 4, &lo, 4 );
+            data += 8;
+        }
+        return;
+    }
+
     for( word = 0; word < word_count; word++ )
     {
         int	i;
@@ -76,6 +114,151 @@ static void swap_words( unsigned char *data, int word_size, int word_count )
     }
 }
 
+void pj_swap_words( unsigned char *data, int word_size, int word_count )
+
+{
+    swap_words_inline( data, word_size, word_count );
+}
+
+/************************************************************************/
+/*                          swap_words_bulk()                           */
+/*                                                                      */
+/*      pj_swap_words() of the values of a grid, with the variant the   */
+/*      context runs, see pj_isa_select().                              */
+/************************************************************************/
+
+#if defined(PJ_ISA_VARIANTS_X86)
+PJ_TARGET_AVX2 
+static void swap_words_avx2( unsigned char *data, int word_size, 
+                             int word_count )
+
+{
+    swap_words_inline( data, word_size, word_count );
+}
+#endif
+
+typedef void (*PJ_SWAP_WORDS_FN)( unsigned char *, int, int );
+
+static const PJ_ISA_VARIANT swap_words_variants[] = {
+#if defined(PJ_ISA_VARIANTS_X86)
+    { PJ_ISA_AVX2, (PJ_ISA_FN) swap_words_avx2 },
+#endif
+    { PJ_ISA_GENERIC, (PJ_ISA_FN) pj_swap_words }
+};
+
+static void swap_words_bulk( projCtx ctx, unsigned char *data, 
+                             int word_size, int word_count )
+
+{
+    PJ_SWAP_WORDS_FN fn = (PJ_SWAP_WORDS_FN) 
+        pj_isa_select( ctx, swap_words_variants, 
+                       sizeof(swap_words_variants) 
+                       / sizeof(swap_words_variants[0]) );
+
+    fn( data, word_size, word_count );
+}
+
+/************************************************************************/
+/*                          pj_grid_checksum()                          */
+/*                                                                      */
+/*      Adler-32 checksum, used to validate grid cache files.           */
+/************************************************************************/
+
+unsigned int pj_grid_checksum( const void *data, size_t size )
+
+{
+    return pj_grid_checksum_update( 1, data, size );
+}
+
+/************************************************************************/
+/*                      pj_grid_checksum_update()                       */
+/*                                                                      */
+/*      The checksum of data following that of which checksum is        */
+/*      the pj_grid_checksum(), so that it can be computed a block      */
+/*      at a time.                                                      */
+/************************************************************************/
+
+unsigned int pj_grid_checksum_update( unsigned int checksum, 
+                                      const void *data, size_t size )
+
+{
+    const unsigned char *bytes = (const unsigned char *) data;
+    unsigned int s1 = checksum & 0xffff, s2 = checksum >> 16;
+
+    while( size > 0 )
+    {
+        /* 5552 bytes is the most that cannot overflow s2 */
+        size_t n = size < 5552 ? size : 5552;
+
+        size -= n;
+        while( n-- > 0 )
+        {
+            s1 += *(bytes++);
+            s2 += s1;
+        }
+        s1 %= 65521;
+        s2 %= 65521;
+    }
+
+    return (s2 << 16) | s1;
+}
+
+/************************************************************************/
+/*                      pj_gridinfo_alloc_values()                      */
+/*                                                                      */
+/*      Allocate memory for size bytes of values of a table of the      */
+/*      grid, in huge pages if ctx asks for them and the grid has no    */
+/*      allocator of its own.  *paged tells to pass the values back     */
+/*      to pj_gridinfo_free_values().                                   */
+/************************************************************************/
+
+void *pj_gridinfo_alloc_values( projCtx ctx, PJ_GRIDINFO *gi, size_t size,
+                                int *paged )
+
+{
+    void *values = NULL;
+
+    if( gi->allocator.alloc == NULL )
+        values = pj_grid_pages_alloc( ctx->grid_huge_pages, size );
+
+    *paged = values != NULL;
+    if( values == NULL )
+        values = pj_allocator_malloc( &(gi->allocator), size );
+
+    return values;
+}
+
+/************************************************************************/
+/*                      pj_gridinfo_free_values()                       */
+/************************************************************************/
+
+void pj_gridinfo_free_values( PJ_GRIDINFO *gi, void *values, int paged )
+
+{
+    if( paged )
+        pj_grid_pages_free( values );
+    else
+        pj_allocator_free( &(gi->allocator), values );
+}
+
+/************************************************************************/
+/*                       pj_gridinfo_free_table()                       */
+/*                                                                      */
+/*      nad_free() for a table of the grid, whose values come from      */
+/*      pj_gridinfo_alloc_values().                                     */
+/************************************************************************/
+
+void pj_gridinfo_free_table( PJ_GRIDINFO *gi, struct CTABLE *ct, int paged )
+
+{
+    if( ct == NULL )
+        return;
+
+    pj_gridinfo_free_values( gi, ct->cvs, paged );
+    ct->cvs = NULL;
+    nad_free( ct );
+}
+
 /************************************************************************/
 /*                          pj_gridinfo_free()                          */
 /************************************************************************/
@@ -83,9 +266,16 @@ static void swap_words( unsigned char *data, int word_size, int word_count )
 void pj_gridinfo_free( projCtx ctx, PJ_GRIDINFO *gi )
 
 {
+    PJ_ALLOCATOR allocator;
+
     if( gi == NULL )
         return;
 
+    /* a background load is waited for, see pj_gridinfo_load_async() */
+    pj_thread_join( gi->load_thread );
+
+    pj_grid_resident_remove( gi );
+
     if( gi->child != NULL )
     {
         PJ_GRIDINFO *child, *next;
@@ -97,39 +287,416 @@ void pj_gridinfo_free( projCtx ctx, PJ_GRIDINFO *gi )
         }
     }
 
-    if( gi->ct != NULL )
-        nad_free( gi->ct );
+    if( gi->tile_serial != 0 )
+        pj_grid_tiles_free( ctx, gi );
 
-    free( gi->gridname );
-    if( gi->filename != NULL )
-        free( gi->filename );
+    pj_grid_index_free( gi->child_index );
+
+    if( gi->map_handle != NULL )
+    {
+        gi->unmap( gi->map_handle );
+        gi->ct->cvs = NULL;
+    }
 
-    pj_dalloc( gi );
+    pj_gridinfo_free_table( gi, gi->ct, gi->values_paged );
+    pj_gridinfo_free_table( gi, gi->inverse_ct, gi->inverse_paged );
+    pj_gridinfo_free_values( gi, gi->row_pairs, gi->row_pairs_paged );
+    pj_grid_quant_free( gi );
+    pj_gtiff_free( gi );
+
+    allocator = gi->allocator;
+    pj_allocator_free( &allocator, gi->gridname );
+    pj_allocator_free( &allocator, gi->filename );
+
+    pj_mutex_destroy( gi->lock );
+    pj_allocator_free( &allocator, gi );
 }
 
 /************************************************************************/
-/*                          pj_gridinfo_load()                          */
+/*                          pj_gridinfo_map()                           */
 /*                                                                      */
-/*      This function is intended to implement delayed loading of       */
-/*      the data contents of a grid file.  The header and related       */
-/*      stuff are loaded by pj_gridinfo_init().                         */
+/*      Try to use the grid values directly from a memory mapping of    */
+/*      the file, for formats whose on disk layout matches the          */
+/*      in memory CTABLE.  Returns FALSE if they have to be read.       */
 /************************************************************************/
 
-int pj_gridinfo_load( projCtx ctx, PJ_GRIDINFO *gi )
+static int pj_gridinfo_map( projCtx ctx, PJ_GRIDINFO *gi, PAFile fid, 
+                            projFileOffset offset, size_t size )
 
 {
-    struct CTABLE ct_tmp;
+    void *handle = NULL;
+    void (*unmap)(void *) = NULL;
+    void *data;
 
-    if( gi == NULL || gi->ct == NULL )
+    data = pj_ctx_fmap_at( ctx, fid, offset, size, &handle, &unmap );
+    if( data == NULL )
         return 0;
 
-    pj_acquire_lock();
-    if( gi->ct->cvs != NULL )
+    pj_log( ctx, PJ_LOG_DEBUG_MINOR, 
+            "Mapped %d bytes of grid %s", (int) size, gi->gridname );
+
+    if( ctx->grid_huge_pages != PJ_HUGE_PAGES_NONE )
+        pj_grid_pages_advise( data, size );
+
+    gi->unmap = unmap;
+    gi->map_handle = handle;
+    gi->ct->cvs = (FLP *) data;
+
+    return 1;
+}
+
+/************************************************************************/
+/*                       pj_gridinfo_mappable()                         */
+/************************************************************************/
+
+static int pj_gridinfo_mappable( projCtx ctx )
+
+{
+    return ctx->filemapapi != NULL 
+        || (ctx->fileapi_ex != NULL && ctx->fileapi_ex->FMap != NULL);
+}
+
+/************************************************************************/
+/*                        pj_gridinfo_heights()                         */
+/*                                                                      */
+/*      Is this a vertical grid, of one float height per node?          */
+/************************************************************************/
+
+int pj_gridinfo_heights( const PJ_GRIDINFO *gi )
+
+{
+    return strcmp(gi->format,"gtx") == 0 
+        || strcmp(gi->format,"gtiff_heights") == 0;
+}
+
+/************************************************************************/
+/*                         pj_gridinfo_tiled()                          */
+/*                                                                      */
+/*      Should the values of this (not yet loaded) grid be read on      */
+/*      demand with pj_grid_tile_row() rather than all at once?  This   */
+/*      is the case for large grids in a row oriented format, unless    */
+/*      the file can be mapped which is lazy anyway, or the values      */
+/*      are shared between processes, and for large horizontal grids    */
+/*      the context asks to quantize.  Contexts in low memory mode      */
+/*      do not use shared memory.                                       */
+/************************************************************************/
+
+int pj_gridinfo_tiled( projCtx ctx, PJ_GRIDINFO *gi )
+
+{
+    int mappable;
+
+    if( ctx->grid_tile_limit <= 0 || gi->ct == NULL || gi->ct->cvs != NULL
+        || gi->ct->lim.phi <= PJ_GRID_TILE_ROWS )
+        return 0;
+
+    /* the quantized values are unpacked a tile at a time */
+    if( ctx->grid_quantize > 0.0 && !pj_gridinfo_heights( gi ) )
+        return 1;
+
+    /* all at once into shared memory, for the other processes */
+    if( !ctx->low_memory && pj_grid_shm_usable( ctx, gi ) )
+        return 0;
+
+    /* urls are never mapped, see pj_network.c */
+    mappable = pj_gridinfo_mappable( ctx ) 
+        && !pj_network_is_url( gi->filename );
+
+    if( strcmp(gi->format,"ntv1") == 0 || strcmp(gi->format,"ntv2") == 0
+        || strcmp(gi->format,"gtiff") == 0 )
+        return 1;
+
+    if( strcmp(gi->format,"ctable") == 0 || strcmp(gi->format,"cache") == 0 )
+        return !mappable;
+
+    if( strcmp(gi->format,"ctable2") == 0 )
+        return !IS_LSB || !mappable;
+
+    return 0;
+}
+
+/************************************************************************/
+/*                          pj_grid_band_run()                          */
+/*                                                                      */
+/*      Read and decode a band of rows of an NTv1, NTv2 or GTX grid,    */
+/*      PJ_GRID_BLOCK_BYTES of the file at a time.  Errors are only     */
+/*      recorded in the band, the context being shared by the bands.   */
+/************************************************************************/
+
+#define PJ_GRID_BLOCK_BYTES    (256 * 1024)
+#define PJ_GRID_BAND_MIN_ROWS  64
+
+typedef struct {
+    projCtx      ctx;
+    PJ_GRIDINFO *gi;
+    PAFile       fid;
+    int          first_row, row_count;
+    FLP         *cvs;
+    int          ok;
+    void        *thread;
+} PJ_GRID_BAND;
+
+static void pj_grid_band_run( void *arg )
+
+{
+    PJ_GRID_BAND *band = (PJ_GRID_BAND *) arg;
+    PJ_GRIDINFO  *gi = band->gi;
+    int    cols = gi->ct->lim.lam;
+    int    ntv1 = strcmp(gi->format,"ntv1") == 0;
+    int    gtx = strcmp(gi->format,"gtx") == 0;
+    size_t row_size = (size_t) cols * (gtx ? sizeof(float) : 16);
+    int    block_rows = (int) (PJ_GRID_BLOCK_BYTES / row_size);
+    unsigned char *buf = NULL;
+    int    row, n;
+
+    band->ok = 0;
+    if( block_rows < 1 )
+        block_rows = 1;
+
+    /* GTX rows are read in place, being stored as they are held */
+    if( !gtx 
+        && (buf = (unsigned char *) pj_malloc(row_size * block_rows)) == NULL )
+        return;
+
+    for( row = 0; row < band->row_count; row += n )
+    {
+        FLP    *cvs = band->cvs + (size_t) row * cols;
+        projFileOffset offset = gi->grid_offset 
+            + (projFileOffset) (band->first_row + row) * row_size;
+        unsigned char *data = gtx ? (unsigned char *) 
+            ((float *) band->cvs + (size_t) row * cols) : buf;
+        long   count;
+        int    r, c;
+
+        n = band->row_count - row;
+        if( n > block_rows )
+            n = block_rows;
+        count = (long) n * cols;
+
+        if( pj_ctx_fread_at( band->ctx, band->fid, data, row_size * n, 
+                             offset ) != row_size * n )
+        {
+            pj_dalloc( buf );
+            return;
+        }
+
+/* -------------------------------------------------------------------- */
+/*      GTX values are floats stored MSB first.                         */
+/* -------------------------------------------------------------------- */
+        if( gtx )
+        {
+            if( IS_LSB )
+                swap_words_bulk( band->ctx, data, 4, count );
+            continue;
+        }
+
+/* -------------------------------------------------------------------- */
+/*      NTv1 nodes are of phi and lam doubles stored MSB first, and     */
+/*      NTv2 ones of phi, lam and their accuracies as floats stored     */
+/*      LSB first, both in arc seconds and going west, so the columns   */
+/*      of the CTABLE are reversed.                                     */
+/* -------------------------------------------------------------------- */
+        if( ntv1 )
+        {
+            double *diff_seconds = (double *) buf;
+
+            if( IS_LSB )
+                swap_words_bulk( band->ctx, buf, 8, count * 2 );
+
+            for( r = 0; r < n; r++ )
+            {
+                FLP *node = cvs + (size_t) r * cols + cols - 1;
+
+                for( c = 0; c < cols; c++, node--, diff_seconds += 2 )
+                {
+                    node->phi = diff_seconds[0] * ((PI/180.0) / 3600.0);
+                    node->lam = diff_seconds[1] * ((PI/180.0) / 3600.0);
+                }
+            }
+        }
+        else
+        {
+            float *diff_seconds = (float *) buf;
+
+            if( !IS_LSB )
+                swap_words_bulk( band->ctx, buf, 4, count * 4 );
+
+            for( r = 0; r < n; r++ )
+            {
+                FLP *node = cvs + (size_t) r * cols + cols - 1;
+
+                for( c = 0; c < cols; c++, node--, diff_seconds += 4 )
+                {
+                    node->phi = diff_seconds[0] * ((PI/180.0) / 3600.0);
+                    node->lam = diff_seconds[1] * ((PI/180.0) / 3600.0);
+                }
+            }
+        }
+    }
+
+    pj_dalloc( buf );
+    band->ok = 1;
+}
+
+/************************************************************************/
+/*                         pj_grid_bands_load()                         */
+/*                                                                      */
+/*      Load rows of an NTv1, NTv2 or GTX grid split in bands decoded   */
+/*      on up to the threads of the context, the calling one            */
+/*      included, when its file hooks can read at an offset from       */
+/*      several threads at once.  Bands that cannot get a thread are    */
+/*      decoded here.  Returns 0 if any band failed.                    */
+/************************************************************************/
+
+static int pj_grid_bands_load( projCtx ctx, PJ_GRIDINFO *gi, PAFile fid,
+                               int first_row, int row_count, FLP *cvs )
+
+{
+    PJ_GRID_BAND *bands = NULL;
+    size_t node_size = strcmp(gi->format,"gtx") == 0 
+        ? sizeof(float) : sizeof(FLP);
+    int band_count = ctx->threads;
+    int rows_done = 0, ok = 1, i;
+
+    if( ctx->fileapi_ex == NULL || ctx->fileapi_ex->FReadAt == NULL )
+        band_count = 1;
+    if( band_count > row_count / PJ_GRID_BAND_MIN_ROWS )
+        band_count = row_count / PJ_GRID_BAND_MIN_ROWS;
+    if( band_count > 1 )
+        bands = (PJ_GRID_BAND *) pj_malloc(sizeof(PJ_GRID_BAND) * band_count);
+    if( bands == NULL )
+        band_count = 1;
+
+    for( i = 0; i < band_count; i++ )
+    {
+        PJ_GRID_BAND local_band, *band = bands ? bands + i : &local_band;
+
+        band->ctx = ctx;
+        band->gi = gi;
+        band->fid = fid;
+        band->first_row = first_row + rows_done;
+        band->cvs = (FLP *) ((char *) cvs 
+                             + (size_t) rows_done * gi->ct->lim.lam 
+                             * node_size);
+        rows_done = (int) ((double) row_count * (i + 1) / band_count);
+        band->row_count = first_row + rows_done - band->first_row;
+        band->thread = NULL;
+
+        if( i < band_count - 1 )
+            band->thread = pj_thread_start( pj_grid_band_run, band );
+        if( band->thread == NULL )
+        {
+            pj_grid_band_run( band );
+            ok = ok && band->ok;
+        }
+    }
+
+    if( bands != NULL )
+    {
+        for( i = 0; i < band_count - 1; i++ )
+        {
+            if( bands[i].thread != NULL )
+            {
+                pj_thread_join( bands[i].thread );
+                ok = ok && bands[i].ok;
+            }
+        }
+        pj_dalloc( bands );
+    }
+
+    return ok;
+}
+
+/************************************************************************/
+/*                       pj_gridinfo_load_rows()                        */
+/*                                                                      */
+/*      Read row_count rows of grid values starting at first_row        */
+/*      into cvs, converted to the in memory CTABLE layout, which is    */
+/*      of floats for vertical grids.  Values of "cache" grids are not  */
+/*      checksummed when read this way.  The rows are read at their     */
+/*      offset with pj_ctx_fread_at(), so the file position is left     */
+/*      undefined.                                                      */
+/************************************************************************/
+
+int pj_gridinfo_load_rows( projCtx ctx, PJ_GRIDINFO *gi, PAFile fid, 
+                           int first_row, int row_count, FLP *cvs )
+
+{
+    int  cols = gi->ct->lim.lam;
+
+    if( first_row < 0 || row_count < 0 
+        || first_row + row_count > gi->ct->lim.phi )
     {
-        pj_release_lock();
+        pj_ctx_set_errno( ctx, -38 );
+        return 0;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Formats already holding FLP values in radians.                  */
+/* -------------------------------------------------------------------- */
+    if( strcmp(gi->format,"ctable") == 0 
+        || strcmp(gi->format,"ctable2") == 0
+        || strcmp(gi->format,"cache") == 0 )
+    {
+        projFileOffset base;
+        size_t words = (size_t) cols * row_count;
+
+        if( strcmp(gi->format,"ctable") == 0 )
+            base = sizeof(struct CTABLE);
+        else if( strcmp(gi->format,"ctable2") == 0 )
+            base = 160;
+        else
+            base = gi->grid_offset;
+
+        base += (projFileOffset) first_row * cols * sizeof(FLP);
+        if( pj_ctx_fread_at( ctx, fid, cvs, words * sizeof(FLP), base )
+            != words * sizeof(FLP) )
+        {
+            pj_ctx_set_errno( ctx, -38 );
+            return 0;
+        }
+
+        /* ctable2 values are stored LSB first */
+        if( strcmp(gi->format,"ctable2") == 0 && !IS_LSB )
+            swap_words_bulk( ctx, (unsigned char *) cvs, 4, words * 2 );
+
         return 1;
     }
 
+/* -------------------------------------------------------------------- */
+/*      NTv1, NTv2 and GTX formats, decoded in bands of rows.           */
+/* -------------------------------------------------------------------- */
+    else if( strcmp(gi->format,"ntv1") == 0 
+             || strcmp(gi->format,"ntv2") == 0
+             || strcmp(gi->format,"gtx") == 0 )
+    {
+        if( !pj_grid_bands_load( ctx, gi, fid, first_row, row_count, cvs ) )
+        {
+            pj_ctx_set_errno( ctx, -38 );
+            return 0;
+        }
+        return 1;
+    }
+
+    else if( gi->gtiff != NULL )
+        return pj_gtiff_load_rows( ctx, gi, fid, first_row, row_count, cvs );
+
+    pj_ctx_set_errno( ctx, -38 );
+    return 0;
+}
+
+/************************************************************************/
+/*                       pj_gridinfo_load_locked()                      */
+/*                                                                      */
+/*      Load the values of a grid, with the grid lock held.             */
+/************************************************************************/
+
+static int pj_gridinfo_load_locked( projCtx ctx, PJ_GRIDINFO *gi )
+
+{
+    struct CTABLE ct_tmp;
+    int paged = 0;
+
     memcpy(&ct_tmp, gi->ct, sizeof(struct CTABLE));
 
 /* -------------------------------------------------------------------- */
@@ -145,16 +712,31 @@ int pj_gridinfo_load( projCtx ctx, PJ_GRIDINFO *gi )
         if( fid == NULL )
         {
             pj_ctx_set_errno( ctx, -38 );
-            pj_release_lock();
             return 0;
         }
 
-        result = nad_ctable_load( ctx, &ct_tmp, fid );
+        if( pj_gridinfo_map( ctx, gi, fid, sizeof(struct CTABLE),
+                             sizeof(FLP) * gi->ct->lim.lam * gi->ct->lim.phi ) )
+        {
+            pj_ctx_fclose( ctx, fid );
+            return 1;
+        }
+
+        ct_tmp.cvs = (FLP *) pj_gridinfo_alloc_values( ctx, gi, 
+                     gi->ct->lim.lam*gi->ct->lim.phi*sizeof(FLP), &paged );
+        result = ct_tmp.cvs != NULL && nad_ctable_load( ctx, &ct_tmp, fid );
 
         pj_ctx_fclose( ctx, fid );
 
+        if( !result )
+        {
+            pj_gridinfo_free_values( gi, ct_tmp.cvs, paged );
+            pj_ctx_set_errno( ctx, -38 );
+            return 0;
+        }
+
         gi->ct->cvs = ct_tmp.cvs;
-        pj_release_lock();
+        gi->values_paged = paged;
 
         return result;
     }
@@ -165,38 +747,177 @@ int pj_gridinfo_load( projCtx ctx, PJ_GRIDINFO *gi )
     else if( strcmp(gi->format,"ctable2") == 0 )
     {
         PAFile fid;
-        int result;
+        int result;
+
+        fid = pj_open_lib( ctx, gi->filename, "rb" );
+
+        if( fid == NULL )
+        {
+            pj_ctx_set_errno( ctx, -38 );
+            return 0;
+        }
+
+        /* the values are stored LSB first */
+        if( IS_LSB 
+            && pj_gridinfo_map( ctx, gi, fid, 160,
+                                sizeof(FLP) * gi->ct->lim.lam * gi->ct->lim.phi ) )
+        {
+            pj_ctx_fclose( ctx, fid );
+            return 1;
+        }
+
+        ct_tmp.cvs = (FLP *) pj_gridinfo_alloc_values( ctx, gi, 
+                     gi->ct->lim.lam*gi->ct->lim.phi*sizeof(FLP), &paged );
+        result = ct_tmp.cvs != NULL && nad_ctable2_load( ctx, &ct_tmp, fid );
+
+        pj_ctx_fclose( ctx, fid );
+
+        if( !result )
+        {
+            pj_gridinfo_free_values( gi, ct_tmp.cvs, paged );
+            pj_ctx_set_errno( ctx, -38 );
+            return 0;
+        }
+
+        gi->ct->cvs = ct_tmp.cvs;
+        gi->values_paged = paged;
+
+        return result;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      NTv1 and NTv2 format, converted row by row.                     */
+/* -------------------------------------------------------------------- */
+    else if( strcmp(gi->format,"ntv1") == 0 
+             || strcmp(gi->format,"ntv2") == 0 )
+    {
+        PAFile fid;
+
+        if( strcmp(gi->format,"ntv2") == 0 )
+            pj_log( ctx, PJ_LOG_DEBUG_MINOR,
+                    "NTv2 - loading grid %s", gi->ct->id );
+
+        fid = pj_open_lib( ctx, gi->filename, "rb" );
+
+        if( fid == NULL )
+        {
+            pj_ctx_set_errno( ctx, -38 );
+            return 0;
+        }
+
+        ct_tmp.cvs = (FLP *) pj_gridinfo_alloc_values( ctx, gi, 
+                     gi->ct->lim.lam*gi->ct->lim.phi*sizeof(FLP), &paged );
+        if( ct_tmp.cvs == NULL 
+            || !pj_gridinfo_load_rows( ctx, gi, fid, 0, gi->ct->lim.phi,
+                                       ct_tmp.cvs ) )
+        {
+            pj_gridinfo_free_values( gi, ct_tmp.cvs, paged );
+            pj_ctx_fclose( ctx, fid );
+            pj_ctx_set_errno( ctx, -38 );
+            return 0;
+        }
+
+        pj_ctx_fclose( ctx, fid );
+
+        gi->ct->cvs = ct_tmp.cvs;
+        gi->values_paged = paged;
+
+        return 1;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Grid cache, already in the in memory layout.                    */
+/* -------------------------------------------------------------------- */
+    else if( strcmp(gi->format,"cache") == 0 )
+    {
+        size_t size = sizeof(FLP) * gi->ct->lim.lam * gi->ct->lim.phi;
+        PAFile fid;
+
+        fid = pj_open_lib( ctx, gi->filename, "rb" );
+
+        if( fid == NULL )
+        {
+            pj_ctx_set_errno( ctx, -38 );
+            return 0;
+        }
+
+        if( pj_gridinfo_map( ctx, gi, fid, gi->grid_offset, size ) )
+        {
+            pj_ctx_fclose( ctx, fid );
+            return 1;
+        }
+
+        ct_tmp.cvs = (FLP *) pj_gridinfo_alloc_values( ctx, gi, size, &paged );
+        if( ct_tmp.cvs == NULL 
+            || pj_ctx_fread_at( ctx, fid, ct_tmp.cvs, size, gi->grid_offset ) 
+               != size
+            || pj_grid_checksum( ct_tmp.cvs, size ) != gi->checksum )
+        {
+            pj_log( ctx, PJ_LOG_ERROR, 
+                    "grid cache %s: %s values unreadable or corrupt",
+                    gi->filename, gi->ct->id );
+            pj_gridinfo_free_values( gi, ct_tmp.cvs, paged );
+            pj_ctx_fclose( ctx, fid );
+            pj_ctx_set_errno( ctx, -38 );
+            return 0;
+        }
+
+        pj_ctx_fclose( ctx, fid );
+        gi->ct->cvs = ct_tmp.cvs;
+        gi->values_paged = paged;
+        return 1;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      GTX format.                                                     */
+/* -------------------------------------------------------------------- */
+    else if( strcmp(gi->format,"gtx") == 0 )
+    {
+        int   words = gi->ct->lim.lam * gi->ct->lim.phi;
+        PAFile fid;
 
         fid = pj_open_lib( ctx, gi->filename, "rb" );
 
         if( fid == NULL )
         {
             pj_ctx_set_errno( ctx, -38 );
-            pj_release_lock();
             return 0;
         }
 
-        result = nad_ctable2_load( ctx, &ct_tmp, fid );
+        /* the values are stored MSB first */
+        if( !IS_LSB 
+            && pj_gridinfo_map( ctx, gi, fid, gi->grid_offset,
+                                words * sizeof(float) ) )
+        {
+            pj_ctx_fclose( ctx, fid );
+            return 1;
+        }
 
-        pj_ctx_fclose( ctx, fid );
+        ct_tmp.cvs = (FLP *) pj_gridinfo_alloc_values( ctx, gi, 
+                                             words*sizeof(float), &paged );
+        if( ct_tmp.cvs == NULL 
+            || !pj_gridinfo_load_rows( ctx, gi, fid, 0, gi->ct->lim.phi,
+                                       ct_tmp.cvs ) )
+        {
+            pj_gridinfo_free_values( gi, ct_tmp.cvs, paged );
+            pj_ctx_fclose( ctx, fid );
+            pj_ctx_set_errno( ctx, -38 );
+            return 0;
+        }
 
+        pj_ctx_fclose( ctx, fid );
         gi->ct->cvs = ct_tmp.cvs;
-
-        pj_release_lock();
-        return result;
+        gi->values_paged = paged;
+        return 1;
     }
 
 /* -------------------------------------------------------------------- */
-/*      NTv1 format.                                                    */
-/*      We process one line at a time.  Note that the array storage     */
-/*      direction (e-w) is different in the NTv1 file and what          */
-/*      the CTABLE is supposed to have.  The phi/lam are also           */
-/*      reversed, and we have to be aware of byte swapping.             */
+/*      GeoTIFF format, decoded a tile at a time.                       */
 /* -------------------------------------------------------------------- */
-    else if( strcmp(gi->format,"ntv1") == 0 )
+    else if( gi->gtiff != NULL )
     {
-        double	*row_buf;
-        int	row;
+        size_t size = (size_t) gi->ct->lim.lam * gi->ct->lim.phi
+            * (pj_gridinfo_heights( gi ) ? sizeof(float) : sizeof(FLP));
         PAFile fid;
 
         fid = pj_open_lib( ctx, gi->filename, "rb" );
@@ -204,215 +925,292 @@ int pj_gridinfo_load( projCtx ctx, PJ_GRIDINFO *gi )
         if( fid == NULL )
         {
             pj_ctx_set_errno( ctx, -38 );
-            pj_release_lock();
             return 0;
         }
 
-        pj_ctx_fseek( ctx, fid, gi->grid_offset, SEEK_SET );
-
-        row_buf = (double *) pj_malloc(gi->ct->lim.lam * sizeof(double) * 2);
-        ct_tmp.cvs = (FLP *) pj_malloc(gi->ct->lim.lam*gi->ct->lim.phi*sizeof(FLP));
-        if( row_buf == NULL || ct_tmp.cvs == NULL )
+        ct_tmp.cvs = (FLP *) pj_gridinfo_alloc_values( ctx, gi, size, &paged );
+        if( ct_tmp.cvs == NULL 
+            || !pj_gridinfo_load_rows( ctx, gi, fid, 0, gi->ct->lim.phi,
+                                       ct_tmp.cvs ) )
         {
+            pj_gridinfo_free_values( gi, ct_tmp.cvs, paged );
+            pj_ctx_fclose( ctx, fid );
             pj_ctx_set_errno( ctx, -38 );
-            pj_release_lock();
             return 0;
         }
 
-        for( row = 0; row < gi->ct->lim.phi; row++ )
-        {
-            int	    i;
-            FLP     *cvs;
-            double  *diff_seconds;
+        pj_ctx_fclose( ctx, fid );
+        gi->ct->cvs = ct_tmp.cvs;
+        gi->values_paged = paged;
+        return 1;
+    }
 
-            if( pj_ctx_fread( ctx, row_buf,
-                              sizeof(double), gi->ct->lim.lam * 2, fid )
-                != 2 * gi->ct->lim.lam )
-            {
-                pj_dalloc( row_buf );
-                pj_dalloc( ct_tmp.cvs );
-                pj_ctx_set_errno( ctx, -38 );
-                return 0;
-            }
+    else
+        return 0;
+}
 
-            if( IS_LSB )
-                swap_words( (unsigned char *) row_buf, 8, gi->ct->lim.lam*2 );
+/************************************************************************/
+/*                          pj_grid_is_null()                           */
+/*                                                                      */
+/*      Are all the shifts of a loaded horizontal grid zero?  Such      */
+/*      grids, like "null", are only there to suppress a datum shift,   */
+/*      and points in them are passed through unchanged.                */
+/************************************************************************/
 
-            /* convert seconds to radians */
-            diff_seconds = row_buf;
+static int pj_grid_is_null( struct CTABLE *ct )
 
-            for( i = 0; i < gi->ct->lim.lam; i++ )
-            {
-                cvs = ct_tmp.cvs + (row) * gi->ct->lim.lam
-                    + (gi->ct->lim.lam - i - 1);
+{
+    long i, count = (long) ct->lim.lam * ct->lim.phi;
 
-                cvs->phi = *(diff_seconds++) * ((PI/180.0) / 3600.0);
-                cvs->lam = *(diff_seconds++) * ((PI/180.0) / 3600.0);
-            }
-        }
+    for( i = 0; i < count; i++ )
+    {
+        if( ct->cvs[i].lam != 0.0 || ct->cvs[i].phi != 0.0 )
+            return 0;
+    }
 
-        pj_dalloc( row_buf );
+    return 1;
+}
 
-        pj_ctx_fclose( ctx, fid );
+/************************************************************************/
+/*                          pj_gridinfo_load()                          */
+/*                                                                      */
+/*      This function is intended to implement delayed loading of       */
+/*      the data contents of a grid file.  The header and related       */
+/*      stuff are loaded by pj_gridinfo_init().  Grids are loaded       */
+/*      under their own lock, so that threads using other grids are     */
+/*      not held up, and once loaded the values are read unlocked.      */
+/************************************************************************/
 
-        gi->ct->cvs = ct_tmp.cvs;
-        pj_release_lock();
+int pj_gridinfo_load( projCtx ctx, PJ_GRIDINFO *gi )
+
+{
+    int result;
+    double start, bytes;
+
+    if( gi == NULL || gi->ct == NULL )
+        return 0;
 
+    if( gi->ct->cvs != NULL )
         return 1;
+
+    /* a load is slow enough to time always, for the trace point */
+    start = pj_clock_ns();
+    PJ_TRACE1( grid__load__start, gi->gridname );
+
+    pj_mutex_lock( gi->lock );
+    if( gi->ct->cvs != NULL )
+        result = -1;
+    else
+    {
+        /* from another process if it has the grid in shared memory,
+           or else loaded here and offered to the others */
+        result = pj_grid_shm_attach( ctx, gi );
+        if( !result )
+        {
+            result = pj_gridinfo_load_locked( ctx, gi );
+            if( result && gi->map_handle == NULL )
+                pj_grid_shm_publish( ctx, gi );
+        }
+        if( result && !pj_gridinfo_heights( gi ) )
+            gi->is_null = pj_grid_is_null( gi->ct );
     }
+    pj_mutex_unlock( gi->lock );
 
-/* -------------------------------------------------------------------- */
-/*      NTv2 format.                                                    */
-/*      We process one line at a time.  Note that the array storage     */
-/*      direction (e-w) is different in the NTv2 file and what          */
-/*      the CTABLE is supposed to have.  The phi/lam are also           */
-/*      reversed, and we have to be aware of byte swapping.             */
-/* -------------------------------------------------------------------- */
-    else if( strcmp(gi->format,"ntv2") == 0 )
+    /* loaded by another thread meanwhile */
+    if( result == -1 )
     {
-        float	*row_buf;
-        int	row;
-        PAFile fid;
+        PJ_TRACE4( grid__load__done, gi->gridname, 0L,
+                   (long) (pj_clock_ns() - start), 1 );
+        return 1;
+    }
 
-        pj_log( ctx, PJ_LOG_DEBUG_MINOR,
-                "NTv2 - loading grid %s", gi->ct->id );
+    if( result )
+        pj_grid_resident_add( gi, 1 );
 
-        fid = pj_open_lib( ctx, gi->filename, "rb" );
+    /* counting the bytes read, mapped or not */
+    bytes = result ? (double) gi->ct->lim.lam * gi->ct->lim.phi
+                     * (pj_gridinfo_heights( gi )
+                        ? sizeof(float) : sizeof(FLP)) : 0.0;
+    PJ_TRACE4( grid__load__done, gi->gridname, (long) bytes,
+               (long) (pj_clock_ns() - start), result );
 
-        if( fid == NULL )
-        {
-            pj_ctx_set_errno( ctx, -38 );
-            pj_release_lock();
-            return 0;
-        }
+    if( result && ctx->stats != NULL )
+        pj_stats_add_grid_load( ctx->stats, bytes, pj_clock_ns() - start );
+
+    return result;
+}
+
+/************************************************************************/
+/*                        pj_gridinfo_inverse()                         */
+/*                                                                      */
+/*      Return a table on the same nodes as the loaded grid, holding    */
+/*      the shift that nad_cvt() applied forward needs to invert the    */
+/*      grid, building it on first use.  Each node is inverted with     */
+/*      the usual iteration.  Returns NULL if the grid is not in        */
+/*      memory or the table cannot be allocated, in which case the      */
+/*      caller iterates as before.                                      */
+/************************************************************************/
+
+struct CTABLE *pj_gridinfo_inverse( projCtx ctx, PJ_GRIDINFO *gi )
+
+{
+    struct CTABLE *ct = gi->ct, *ict;
+    LP *row;
+    int i, j, paged = 0;
+
+    if( gi->inverse_ct != NULL )
+        return gi->inverse_ct;
+    if( ct == NULL || ct->cvs == NULL )
+        return NULL;
+
+    pj_mutex_lock( gi->lock );
+    if( gi->inverse_ct != NULL )
+    {
+        pj_mutex_unlock( gi->lock );
+        return gi->inverse_ct;
+    }
+
+    ict = (struct CTABLE *) pj_malloc(sizeof(struct CTABLE));
+    row = (LP *) pj_malloc(sizeof(LP) * ct->lim.lam);
+    if( ict != NULL )
+    {
+        memcpy( ict, ct, sizeof(struct CTABLE) );
+        ict->cvs = (FLP *) pj_gridinfo_alloc_values( ctx, gi, 
+                      sizeof(FLP) * ct->lim.lam * ct->lim.phi, &paged );
+    }
+    if( ict == NULL || ict->cvs == NULL || row == NULL )
+    {
+        pj_gridinfo_free_table( gi, ict, paged );
+        pj_dalloc( row );
+        pj_mutex_unlock( gi->lock );
+        return NULL;
+    }
 
-        pj_ctx_fseek( ctx, fid, gi->grid_offset, SEEK_SET );
+    for( j = 0; j < ct->lim.phi; j++ )
+    {
+        FLP *fwd = ct->cvs + j * ct->lim.lam;
+        FLP *inv = ict->cvs + j * ct->lim.lam;
+        double phi = ct->ll.phi + j * ct->del.phi;
 
-        row_buf = (float *) pj_malloc(gi->ct->lim.lam * sizeof(float) * 4);
-        ct_tmp.cvs = (FLP *) pj_malloc(gi->ct->lim.lam*gi->ct->lim.phi*sizeof(FLP));
-        if( row_buf == NULL || ct_tmp.cvs == NULL )
+        for( i = 0; i < ct->lim.lam; i++ )
         {
-            pj_ctx_set_errno( ctx, -38 );
-            pj_release_lock();
-            return 0;
+            row[i].lam = ct->ll.lam + i * ct->del.lam;
+            row[i].phi = phi;
         }
+        nad_cvt_array( ctx, ct, gi->row_pairs, 1, ct->lim.lam, row );
 
-        for( row = 0; row < gi->ct->lim.phi; row++ )
+        for( i = 0; i < ct->lim.lam; i++ )
         {
-            int	    i;
-            FLP     *cvs;
-            float   *diff_seconds;
-
-            if( pj_ctx_fread( ctx, row_buf, sizeof(float),
-                              gi->ct->lim.lam*4, fid )
-                != 4 * gi->ct->lim.lam )
+            /* a node that does not converge keeps the first order guess */
+            if( row[i].lam == HUGE_VAL )
             {
-                pj_dalloc( row_buf );
-                pj_dalloc( ct_tmp.cvs );
-                pj_ctx_set_errno( ctx, -38 );
-                pj_release_lock();
-                return 0;
+                inv[i].lam = -fwd[i].lam;
+                inv[i].phi = -fwd[i].phi;
+                continue;
             }
+            inv[i].lam = (float) 
+                adjlon(ct->ll.lam + i * ct->del.lam - row[i].lam);
+            inv[i].phi = (float) (row[i].phi - phi);
+        }
+    }
+    pj_dalloc( row );
 
-            if( !IS_LSB )
-                swap_words( (unsigned char *) row_buf, 4,
-                            gi->ct->lim.lam*4 );
+    pj_log( ctx, PJ_LOG_DEBUG_MINOR, 
+            "Built inverse of grid %s", ct->id );
 
-            /* convert seconds to radians */
-            diff_seconds = row_buf;
+    gi->inverse_ct = ict;
+    gi->inverse_paged = paged;
+    pj_mutex_unlock( gi->lock );
 
-            for( i = 0; i < gi->ct->lim.lam; i++ )
-            {
-                cvs = ct_tmp.cvs + (row) * gi->ct->lim.lam
-                    + (gi->ct->lim.lam - i - 1);
+    pj_grid_resident_add( gi, 0 );
 
-                cvs->phi = *(diff_seconds++) * ((PI/180.0) / 3600.0);
-                cvs->lam = *(diff_seconds++) * ((PI/180.0) / 3600.0);
-                diff_seconds += 2; /* skip accuracy values */
-            }
-        }
+    return ict;
+}
 
-        pj_dalloc( row_buf );
+/************************************************************************/
+/*                       pj_gridinfo_row_pairs()                        */
+/*                                                                      */
+/*      Return the values of the loaded grid with each row but the      */
+/*      last interleaved with the next one: node i of pair j holds      */
+/*      node i of rows j and j+1, so that the corners of a cell are     */
+/*      four consecutive FLPs.  The table is built on first use.        */
+/*      Returns NULL if the grid is not in memory, has a single row,    */
+/*      or the table cannot be allocated, in which case the caller      */
+/*      reads the plain values.                                         */
+/************************************************************************/
 
-        pj_ctx_fclose( ctx, fid );
+FLP *pj_gridinfo_row_pairs( projCtx ctx, PJ_GRIDINFO *gi )
 
-        gi->ct->cvs = ct_tmp.cvs;
+{
+    struct CTABLE *ct = gi->ct;
+    FLP *pairs;
+    int i, j, paged = 0;
 
-        pj_release_lock();
-        return 1;
-    }
+    if( gi->row_pairs != NULL )
+        return gi->row_pairs;
+    if( ct == NULL || ct->cvs == NULL || ct->lim.phi < 2 )
+        return NULL;
 
-/* -------------------------------------------------------------------- */
-/*      GTX format.                                                     */
-/* -------------------------------------------------------------------- */
-    else if( strcmp(gi->format,"gtx") == 0 )
+    pj_mutex_lock( gi->lock );
+    if( gi->row_pairs != NULL )
     {
-        int   words = gi->ct->lim.lam * gi->ct->lim.phi;
-        PAFile fid;
-
-        fid = pj_open_lib( ctx, gi->filename, "rb" );
+        pj_mutex_unlock( gi->lock );
+        return gi->row_pairs;
+    }
 
-        if( fid == NULL )
-        {
-            pj_ctx_set_errno( ctx, -38 );
-            pj_release_lock();
-            return 0;
-        }
+    pairs = (FLP *) pj_gridinfo_alloc_values( ctx, gi, 
+                2 * sizeof(FLP) * ct->lim.lam * (ct->lim.phi - 1), &paged );
+    if( pairs == NULL )
+    {
+        pj_mutex_unlock( gi->lock );
+        return NULL;
+    }
 
-        pj_ctx_fseek( ctx, fid, gi->grid_offset, SEEK_SET );
+    for( j = 0; j < ct->lim.phi - 1; j++ )
+    {
+        const FLP *row0 = ct->cvs + j * ct->lim.lam;
+        const FLP *row1 = row0 + ct->lim.lam;
+        FLP *pair = pairs + 2 * j * ct->lim.lam;
 
-        ct_tmp.cvs = (FLP *) pj_malloc(words*sizeof(float));
-        if( ct_tmp.cvs == NULL )
+        for( i = 0; i < ct->lim.lam; i++ )
         {
-            pj_ctx_set_errno( ctx, -38 );
-            pj_release_lock();
-            return 0;
+            pair[2*i] = row0[i];
+            pair[2*i+1] = row1[i];
         }
+    }
 
-        if( pj_ctx_fread( ctx, ct_tmp.cvs, sizeof(float), words, fid )
-            != words )
-        {
-            pj_dalloc( ct_tmp.cvs );
-            pj_release_lock();
-            return 0;
-        }
+    pj_log( ctx, PJ_LOG_DEBUG_MINOR, 
+            "Built row pairs of grid %s", ct->id );
 
-        if( IS_LSB )
-            swap_words( (unsigned char *) ct_tmp.cvs, 4, words );
+    gi->row_pairs = pairs;
+    gi->row_pairs_paged = paged;
+    pj_mutex_unlock( gi->lock );
 
-        pj_ctx_fclose( ctx, fid );
-        gi->ct->cvs = ct_tmp.cvs;
-        pj_release_lock();
-        return 1;
-    }
+    pj_grid_resident_add( gi, 0 );
 
-    else
-    {
-        pj_release_lock();
-        return 0;
-    }
+    return pairs;
 }
 
 /************************************************************************/
-/*                       pj_gridinfo_init_ntv2()                        */
+/*                         pj_gridinfo_id_hash()                        */
 /*                                                                      */
-/*      Seek a parent grid file by name from a grid list                */
+/*      Hash of a subgrid name, of at most 8 characters as in the       */
+/*      NTv2 headers.                                                   */
 /************************************************************************/
 
-static PJ_GRIDINFO* pj_gridinfo_parent( PJ_GRIDINFO *gilist, 
-        const char *name, int length )
+static unsigned long pj_gridinfo_id_hash( const char *name )
+
 {
-    while( gilist )
+    unsigned long hash = 2166136261UL;
+    int i;
+
+    for( i = 0; i < 8 && name[i] != '\0'; i++ )
     {
-        if( strncmp(gilist->ct->id,name,length) == 0 ) return gilist;
-        if( gilist->child )
-        {
-            PJ_GRIDINFO *parent=pj_gridinfo_parent( gilist->child, name, length );
-            if( parent ) return parent;
-        }
-        gilist=gilist->next;
+        hash ^= (unsigned char) name[i];
+        hash = (hash * 16777619UL) & 0xffffffffUL;
     }
-    return gilist;
+
+    return hash;
 }
 
 /************************************************************************/
@@ -424,7 +1222,9 @@ static PJ_GRIDINFO* pj_gridinfo_parent( PJ_GRIDINFO *gilist,
 static int pj_gridinfo_init_ntv2( projCtx ctx, PAFile fid, PJ_GRIDINFO *gilist )
 {
     unsigned char header[11*16];
-    int num_subfiles, subfile;
+    int num_subfiles, subfile, hash_size, ok = 1;
+    PJ_GRIDINFO **grids, **tails, *top_tail = gilist;
+    int *slots;
 
     assert( sizeof(int) == 4 );
     assert( sizeof(double) == 8 );
@@ -450,25 +1250,51 @@ static int pj_gridinfo_init_ntv2( projCtx ctx, PAFile fid, PJ_GRIDINFO *gilist )
 /* -------------------------------------------------------------------- */
     if( !IS_LSB )
     {
-        swap_words( header+8, 4, 1 );
-        swap_words( header+8+16, 4, 1 );
-        swap_words( header+8+32, 4, 1 );
-        swap_words( header+8+7*16, 8, 1 );
-        swap_words( header+8+8*16, 8, 1 );
-        swap_words( header+8+9*16, 8, 1 );
-        swap_words( header+8+10*16, 8, 1 );
+        pj_swap_words( header+8, 4, 1 );
+        pj_swap_words( header+8+16, 4, 1 );
+        pj_swap_words( header+8+32, 4, 1 );
+        pj_swap_words( header+8+7*16, 8, 1 );
+        pj_swap_words( header+8+8*16, 8, 1 );
+        pj_swap_words( header+8+9*16, 8, 1 );
+        pj_swap_words( header+8+10*16, 8, 1 );
     }
 
 /* -------------------------------------------------------------------- */
 /*      Get the subfile count out ... all we really use for now.        */
 /* -------------------------------------------------------------------- */
     memcpy( &num_subfiles, header+8+32, 4 );
+    if( num_subfiles < 1 || num_subfiles > 1000000 )
+    {
+        pj_ctx_set_errno( ctx, -38 );
+        return 0;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      The subgrids so far, the last child of each, and an open        */
+/*      addressing table of their names, at most half full, so          */
+/*      parents are found and children appended in constant time.       */
+/* -------------------------------------------------------------------- */
+    for( hash_size = 16; hash_size < 2 * num_subfiles; hash_size *= 2 ) {}
+
+    grids = (PJ_GRIDINFO **) pj_malloc(sizeof(PJ_GRIDINFO *) * num_subfiles);
+    tails = (PJ_GRIDINFO **) pj_malloc(sizeof(PJ_GRIDINFO *) * num_subfiles);
+    slots = (int *) pj_malloc(sizeof(int) * hash_size);
+    if( grids == NULL || tails == NULL || slots == NULL )
+    {
+        pj_dalloc( grids );
+        pj_dalloc( tails );
+        pj_dalloc( slots );
+        pj_ctx_set_errno( ctx, ENOMEM );
+        return 0;
+    }
+    memset( slots, 0xff, sizeof(int) * hash_size );
 
 /* ==================================================================== */
 /*      Step through the subfiles, creating a PJ_GRIDINFO for each.     */
 /* ==================================================================== */
     for( subfile = 0; subfile < num_subfiles; subfile++ )
     {
+        unsigned long slot;
         struct CTABLE *ct;
         LP ur;
         int gs_count;
@@ -480,13 +1306,15 @@ static int pj_gridinfo_init_ntv2( projCtx ctx, PAFile fid, PJ_GRIDINFO *gilist )
         if( pj_ctx_fread( ctx, header, sizeof(header), 1, fid ) != 1 )
         {
             pj_ctx_set_errno( ctx, -38 );
-            return 0;
+            ok = 0;
+            break;
         }
 
         if( strncmp((const char *) header,"SUB_NAME",8) != 0 )
         {
             pj_ctx_set_errno( ctx, -38 );
-            return 0;
+            ok = 0;
+            break;
         }
 
 /* -------------------------------------------------------------------- */
@@ -494,13 +1322,13 @@ static int pj_gridinfo_init_ntv2( projCtx ctx, PAFile fid, PJ_GRIDINFO *gilist )
 /* -------------------------------------------------------------------- */
         if( !IS_LSB )
         {
-            swap_words( header+8+16*4, 8, 1 );
-            swap_words( header+8+16*5, 8, 1 );
-            swap_words( header+8+16*6, 8, 1 );
-            swap_words( header+8+16*7, 8, 1 );
-            swap_words( header+8+16*8, 8, 1 );
-            swap_words( header+8+16*9, 8, 1 );
-            swap_words( header+8+16*10, 4, 1 );
+            pj_swap_words( header+8+16*4, 8, 1 );
+            pj_swap_words( header+8+16*5, 8, 1 );
+            pj_swap_words( header+8+16*6, 8, 1 );
+            pj_swap_words( header+8+16*7, 8, 1 );
+            pj_swap_words( header+8+16*8, 8, 1 );
+            pj_swap_words( header+8+16*9, 8, 1 );
+            pj_swap_words( header+8+16*10, 4, 1 );
         }
 
 /* -------------------------------------------------------------------- */
@@ -541,8 +1369,10 @@ static int pj_gridinfo_init_ntv2( projCtx ctx, PAFile fid, PJ_GRIDINFO *gilist )
                     "GS_COUNT(%d) does not match expected cells (%dx%d=%d)\n",
                     gs_count, ct->lim.lam, ct->lim.phi,
                     ct->lim.lam * ct->lim.phi );
+            pj_dalloc( ct );
             pj_ctx_set_errno( ctx, -38 );
-            return 0;
+            ok = 0;
+            break;
         }
 
         ct->cvs = NULL;
@@ -555,11 +1385,16 @@ static int pj_gridinfo_init_ntv2( projCtx ctx, PAFile fid, PJ_GRIDINFO *gilist )
             gi = gilist;
         else
         {
-            gi = (PJ_GRIDINFO *) pj_malloc(sizeof(PJ_GRIDINFO));
+            gi = (PJ_GRIDINFO *) pj_allocator_malloc( &(gilist->allocator),
+                                                      sizeof(PJ_GRIDINFO) );
             memset( gi, 0, sizeof(PJ_GRIDINFO) );
+            gi->allocator = gilist->allocator;
+            gi->lock = pj_mutex_create( PJ_LOCK_GRID );
 
-            gi->gridname = strdup( gilist->gridname );
-            gi->filename = strdup( gilist->filename );
+            gi->gridname = pj_allocator_strdup( &(gi->allocator), 
+                                                gilist->gridname );
+            gi->filename = pj_allocator_strdup( &(gi->allocator), 
+                                                gilist->filename );
             gi->next = NULL;
         }
 
@@ -568,56 +1403,82 @@ static int pj_gridinfo_init_ntv2( projCtx ctx, PAFile fid, PJ_GRIDINFO *gilist )
         gi->grid_offset = pj_ctx_ftell( ctx, fid );
 
 /* -------------------------------------------------------------------- */
-/*      Attach to the correct list or sublist.                          */
+/*      Attach to the correct list or sublist.  The first of            */
+/*      several subgrids of the same name stays the parent.             */
 /* -------------------------------------------------------------------- */
+        grids[subfile] = gi;
+        tails[subfile] = NULL;
+
         if( strncmp((const char *)header+24,"NONE",4) == 0 )
         {
             if( gi != gilist )
             {
-                PJ_GRIDINFO *lnk;
-
-                for( lnk = gilist; lnk->next != NULL; lnk = lnk->next ) {}
-                lnk->next = gi;
+                top_tail->next = gi;
+                top_tail = gi;
             }
         }
 
         else
         {
-            PJ_GRIDINFO *lnk;
-            PJ_GRIDINFO *gp = pj_gridinfo_parent(gilist,
-                                                 (const char*)header+24,8);
+            int parent = -1;
+
+            for( slot = pj_gridinfo_id_hash( (const char *) header+24 );
+                 slots[slot & (hash_size-1)] >= 0; slot++ )
+            {
+                int i = slots[slot & (hash_size-1)];
+
+                if( strncmp( grids[i]->ct->id, (const char *) header+24,
+                             8 ) == 0 )
+                {
+                    parent = i;
+                    break;
+                }
+            }
 
-            if( gp == NULL )
+            if( parent < 0 )
             {
                 pj_log( ctx, PJ_LOG_ERROR,
                         "pj_gridinfo_init_ntv2(): "
                         "failed to find parent %8.8s for %s.\n",
                         (const char *) header+24, gi->ct->id );
 
-                for( lnk = gilist; lnk->next != NULL; lnk = lnk->next ) {}
-                lnk->next = gi;
+                if( gi != gilist )
+                {
+                    top_tail->next = gi;
+                    top_tail = gi;
+                }
             }
             else
             {
-                if( gp->child == NULL )
-                {
-                    gp->child = gi;
-                }
+                if( tails[parent] == NULL )
+                    grids[parent]->child = gi;
                 else
-                {
-                    for( lnk = gp->child; lnk->next != NULL; lnk = lnk->next ) {}
-                    lnk->next = gi;
-                }
+                    tails[parent]->next = gi;
+                tails[parent] = gi;
             }
         }
 
+        for( slot = pj_gridinfo_id_hash( ct->id ); 
+             slots[slot & (hash_size-1)] >= 0; slot++ )
+        {
+            if( strncmp( grids[slots[slot & (hash_size-1)]]->ct->id, 
+                         ct->id, 8 ) == 0 )
+                break;
+        }
+        if( slots[slot & (hash_size-1)] < 0 )
+            slots[slot & (hash_size-1)] = subfile;
+
 /* -------------------------------------------------------------------- */
 /*      Seek past the data.                                             */
 /* -------------------------------------------------------------------- */
         pj_ctx_fseek( ctx, fid, gs_count * 16, SEEK_CUR );
     }
 
-    return 1;
+    pj_dalloc( grids );
+    pj_dalloc( tails );
+    pj_dalloc( slots );
+
+    return ok;
 }
 
 /************************************************************************/
@@ -657,13 +1518,13 @@ static int pj_gridinfo_init_ntv1( projCtx ctx, PAFile fid, PJ_GRIDINFO *gi )
 /* -------------------------------------------------------------------- */
     if( IS_LSB )
     {
-        swap_words( header+8, 4, 1 );
-        swap_words( header+24, 8, 1 );
-        swap_words( header+40, 8, 1 );
-        swap_words( header+56, 8, 1 );
-        swap_words( header+72, 8, 1 );
-        swap_words( header+88, 8, 1 );
-        swap_words( header+104, 8, 1 );
+        pj_swap_words( header+8, 4, 1 );
+        pj_swap_words( header+24, 8, 1 );
+        pj_swap_words( header+40, 8, 1 );
+        pj_swap_words( header+56, 8, 1 );
+        pj_swap_words( header+72, 8, 1 );
+        pj_swap_words( header+88, 8, 1 );
+        pj_swap_words( header+104, 8, 1 );
     }
 
     if( *((int *) (header+8)) != 12 )
@@ -745,8 +1606,8 @@ static int pj_gridinfo_init_gtx( projCtx ctx, PAFile fid, PJ_GRIDINFO *gi )
 /* -------------------------------------------------------------------- */
     if( IS_LSB )
     {
-        swap_words( header+0, 8, 4 );
-        swap_words( header+32, 4, 2 );
+        pj_swap_words( header+0, 8, 4 );
+        pj_swap_words( header+32, 4, 2 );
     }
 
     memcpy( &yorigin, header+0, 8 );
@@ -810,6 +1671,150 @@ static int pj_gridinfo_init_gtx( projCtx ctx, PAFile fid, PJ_GRIDINFO *gi )
     return 1;
 }
 
+/************************************************************************/
+/*                      pj_gridinfo_init_cache()                        */
+/*                                                                      */
+/*      Load the index of a grid cache file written by nad2bin,         */
+/*      rebuilding the grid tree it describes.                          */
+/************************************************************************/
+
+static int pj_gridinfo_init_cache( projCtx ctx, PAFile fid, 
+                                   PJ_GRIDINFO *gilist )
+
+{
+    PJ_GRID_CACHE_HEADER header;
+    PJ_GRID_CACHE_ENTRY *entries;
+    PJ_GRIDINFO **grids, **tails, *top_tail = gilist;
+    int i;
+
+/* -------------------------------------------------------------------- */
+/*      Read and validate the header and index.                         */
+/* -------------------------------------------------------------------- */
+    if( pj_ctx_fread( ctx, &header, sizeof(header), 1, fid ) != 1 )
+    {
+        pj_ctx_set_errno( ctx, -38 );
+        return 0;
+    }
+
+    if( header.byte_order != PJ_GRID_CACHE_BYTE_ORDER )
+    {
+        pj_log( ctx, PJ_LOG_ERROR, 
+                "grid cache %s was written with another byte order.",
+                gilist->filename );
+        pj_ctx_set_errno( ctx, -38 );
+        return 0;
+    }
+
+    if( header.grid_count < 1 || header.grid_count > 100000 )
+    {
+        pj_ctx_set_errno( ctx, -38 );
+        return 0;
+    }
+
+    entries = (PJ_GRID_CACHE_ENTRY *) 
+        pj_malloc(sizeof(PJ_GRID_CACHE_ENTRY) * header.grid_count);
+    grids = (PJ_GRIDINFO **) 
+        pj_malloc(sizeof(PJ_GRIDINFO *) * header.grid_count);
+    tails = (PJ_GRIDINFO **) 
+        pj_malloc(sizeof(PJ_GRIDINFO *) * header.grid_count);
+    if( entries == NULL || grids == NULL || tails == NULL
+        || pj_ctx_fread( ctx, entries, sizeof(PJ_GRID_CACHE_ENTRY), 
+                         header.grid_count, fid ) != header.grid_count
+        || pj_grid_checksum( entries, sizeof(PJ_GRID_CACHE_ENTRY) 
+                             * header.grid_count ) != header.index_checksum )
+    {
+        pj_log( ctx, PJ_LOG_ERROR, "grid cache %s has a corrupt index.",
+                gilist->filename );
+        pj_dalloc( entries );
+        pj_dalloc( grids );
+        pj_dalloc( tails );
+        pj_ctx_set_errno( ctx, -38 );
+        return 0;
+    }
+
+    pj_log( ctx, PJ_LOG_DEBUG_MINOR, 
+            "grid cache of %.160s (%.0f bytes, time %.0f), %d grids",
+            header.source, header.source_size, header.source_mtime,
+            header.grid_count );
+
+/* ==================================================================== */
+/*      Create a PJ_GRIDINFO for each entry.                            */
+/* ==================================================================== */
+    for( i = 0; i < header.grid_count; i++ )
+    {
+        PJ_GRID_CACHE_ENTRY *entry = entries + i;
+        struct CTABLE *ct;
+        PJ_GRIDINFO *gi;
+
+        if( entry->parent >= i || entry->lim.lam < 1 || entry->lim.phi < 1 )
+        {
+            pj_dalloc( entries );
+            pj_dalloc( grids );
+            pj_dalloc( tails );
+            pj_ctx_set_errno( ctx, -38 );
+            return 0;
+        }
+
+        ct = (struct CTABLE *) pj_malloc(sizeof(struct CTABLE));
+        memcpy( ct->id, entry->id, MAX_TAB_ID );
+        ct->id[MAX_TAB_ID-1] = '\0';
+        ct->ll = entry->ll;
+        ct->del = entry->del;
+        ct->lim = entry->lim;
+        ct->cvs = NULL;
+
+        if( i == 0 )
+            gi = gilist;
+        else
+        {
+            gi = (PJ_GRIDINFO *) pj_allocator_malloc( &(gilist->allocator),
+                                                      sizeof(PJ_GRIDINFO) );
+            memset( gi, 0, sizeof(PJ_GRIDINFO) );
+            gi->allocator = gilist->allocator;
+            gi->lock = pj_mutex_create( PJ_LOCK_GRID );
+
+            gi->gridname = pj_allocator_strdup( &(gi->allocator), 
+                                                gilist->gridname );
+            gi->filename = pj_allocator_strdup( &(gi->allocator), 
+                                                gilist->filename );
+            gi->next = NULL;
+        }
+
+        gi->ct = ct;
+        gi->format = "cache";
+        gi->grid_offset = entry->data_offset;
+        gi->checksum = entry->checksum;
+        grids[i] = gi;
+        tails[i] = NULL;
+
+/* -------------------------------------------------------------------- */
+/*      Attach to the top level list or to the parent's children.       */
+/* -------------------------------------------------------------------- */
+        if( i == 0 )
+            continue;
+
+        if( entry->parent < 0 )
+        {
+            top_tail->next = gi;
+            top_tail = gi;
+        }
+        else
+        {
+            if( tails[entry->parent] == NULL )
+                grids[entry->parent]->child = gi;
+            else
+                tails[entry->parent]->next = gi;
+            tails[entry->parent] = gi;
+        }
+    }
+
+    pj_dalloc( entries );
+    pj_dalloc( grids );
+    pj_dalloc( tails );
+
+    return 1;
+}
+
 /************************************************************************/
 /*                          pj_gridinfo_init()                          */
 /*                                                                      */
@@ -824,6 +1829,8 @@ PJ_GRIDINFO *pj_gridinfo_init( projCtx ctx, const char *gridname )
 {
     char 	fname[MAX_PATH_FILENAME+1];
     PJ_GRIDINFO *gilist;
+    PJ_GRID_REGISTRY *registry;
+    const PJ_ALLOCATOR *allocator;
     PAFile 	fp;
     char	header[160];
 
@@ -834,10 +1841,17 @@ PJ_GRIDINFO *pj_gridinfo_init( projCtx ctx, const char *gridname )
 /*      Initialize a GRIDINFO with stub info we would use if it         */
 /*      cannot be loaded.                                               */
 /* -------------------------------------------------------------------- */
-    gilist = (PJ_GRIDINFO *) pj_malloc(sizeof(PJ_GRIDINFO));
+    registry = pj_ctx_grid_registry( ctx );
+    allocator = registry->allocator.alloc != NULL 
+        ? &(registry->allocator) : &(ctx->allocator);
+
+    gilist = (PJ_GRIDINFO *) pj_allocator_malloc( allocator, 
+                                                  sizeof(PJ_GRIDINFO) );
     memset( gilist, 0, sizeof(PJ_GRIDINFO) );
+    gilist->allocator = *allocator;
+    gilist->lock = pj_mutex_create( PJ_LOCK_GRID );
 
-    gilist->gridname = strdup( gridname );
+    gilist->gridname = pj_allocator_strdup( allocator, gridname );
     gilist->filename = NULL;
     gilist->format = "missing";
     gilist->grid_offset = 0;
@@ -853,7 +1867,7 @@ PJ_GRIDINFO *pj_gridinfo_init( projCtx ctx, const char *gridname )
         return gilist;
     }
 
-    gilist->filename = strdup(fname);
+    gilist->filename = pj_allocator_strdup( allocator, fname );
 
 /* -------------------------------------------------------------------- */
 /*      Load a header, to determine the file type.                      */
@@ -883,6 +1897,12 @@ PJ_GRIDINFO *pj_gridinfo_init( projCtx ctx, const char *gridname )
         pj_gridinfo_init_ntv2( ctx, fp, gilist );
     }
 
+    else if( memcmp(header + 0, "II*\0", 4) == 0 
+             || memcmp(header + 0, "MM\0*", 4) == 0 )
+    {
+        pj_gridinfo_init_gtiff( ctx, fp, gilist );
+    }
+
     else if( strlen(gridname) > 4
              && (strcmp(gridname+strlen(gridname)-3,"gtx") == 0
                  || strcmp(gridname+strlen(gridname)-3,"GTX") == 0) )
@@ -890,6 +1910,11 @@ PJ_GRIDINFO *pj_gridinfo_init( projCtx ctx, const char *gridname )
         pj_gridinfo_init_gtx( ctx, fp, gilist );
     }
 
+    else if( strncmp(header + 0, PJ_GRID_CACHE_MAGIC, 16) == 0 )
+    {
+        pj_gridinfo_init_cache( ctx, fp, gilist );
+    }
+
     else if( strncmp(header + 0,"CTABLE V2",9) == 0 )
     {
         struct CTABLE *ct = nad_ctable2_init( ctx, fp );
@@ -33,6 +33,7 @@
 #include <projects.h>
 #include <string.h>
 #include <math.h>
+#include <errno.h>
 
 #ifdef _WIN32_WCE
 /* assert.h includes all Windows API headers and causes 'LP' name clash.
@@ -44,181 +45,825 @@
 # include <assert.h>
 #endif /* _WIN32_WCE */
 
-static PJ_GRIDINFO *grid_list = NULL;
+/*
+** Grids are kept in a registry, which may be attached to one or more
+** contexts with pj_ctx_set_grid_registry().  Contexts without one share
+** the default registry.  Each registry loads its own copy of a grid, so
+** registries can also keep grids close to the threads using them, see
+** pj_grid_registry_set_allocator().  The registry has read/write locks guarding its
+** lists of grids and of catalogs, so lookups of grids already in the list
+** run concurrently.  The headers of new grid files are read before the
+** list lock is taken, so opening a file only holds up the threads
+** opening the same one.  Each grid has its own lock for loading its
+** values, the threads needing a grid being loaded waiting on it
+** while the others go on, and the values of a loaded grid are read
+** without locking.
+**
+** The grids of each grid name are found through a hash of the names,
+** and the list built for each nadgrids string is kept, so that the
+** definitions using the same string just get a copy of it.
+**
+** A projection binds to the registry of its context when it first
+** looks grids up, see pj_grid_registry_of(), and counts as a user of it
+** until freed.  pj_deallocate_grids() and pj_grid_registry_free() only
+** retire a registry that still has users: the default registry is then
+** replaced by a new one for the lookups to come, and the retired one is
+** freed with its last user.  At the start of each batch, a projection
+** bound to a retired registry drops the grids it found there and binds
+** again, see pj_grid_registry_refresh(), while the batches already
+** running go on with the grids they started with.  Updated grid files
+** are so picked up without stopping transformations.
+*/
+static PJ_GRID_REGISTRY default_registry = 
+    { NULL, NULL, NULL, NULL, { NULL, NULL, NULL } };
+static PJ_GRID_REGISTRY *default_current = &default_registry;
+static volatile long default_registry_once = 0;
+
+static void pj_grid_registry_free_grids( PJ_GRID_REGISTRY *registry );
+static void pj_grid_registry_destroy( PJ_GRID_REGISTRY *registry );
 
 /************************************************************************/
-/*                        pj_deallocate_grids()                         */
+/*                       pj_grid_registry_setup()                       */
+/************************************************************************/
+
+static void pj_grid_registry_setup( void )
+
+{
+    default_registry.grid_lock = pj_rwlock_create( PJ_LOCK_GRID_LIST );
+    default_registry.catalog_lock = pj_rwlock_create( PJ_LOCK_CATALOG_LIST );
+}
+
+/************************************************************************/
+/*                        pj_ctx_grid_registry()                        */
+/************************************************************************/
+
+PJ_GRID_REGISTRY *pj_ctx_grid_registry( projCtx ctx )
+
+{
+    if( ctx != NULL && ctx->grid_registry != NULL )
+        return ctx->grid_registry;
+
+    pj_once( &default_registry_once, pj_grid_registry_setup );
+
+    return default_current;
+}
+
+/************************************************************************/
+/*                       pj_grid_registry_alloc()                       */
 /*                                                                      */
-/*      Deallocate all loaded grids.                                    */
+/*      Create an empty registry of grids, to be attached to contexts   */
+/*      with pj_ctx_set_grid_registry().                                */
 /************************************************************************/
 
-void pj_deallocate_grids()
+PJ_GRID_REGISTRY *pj_grid_registry_alloc()
+
+{
+    PJ_GRID_REGISTRY *registry;
+
+    registry = (PJ_GRID_REGISTRY *) pj_malloc(sizeof(PJ_GRID_REGISTRY));
+    if( registry == NULL )
+        return NULL;
+
+    memset( registry, 0, sizeof(PJ_GRID_REGISTRY) );
+    registry->grid_lock = pj_rwlock_create( PJ_LOCK_GRID_LIST );
+    registry->catalog_lock = pj_rwlock_create( PJ_LOCK_CATALOG_LIST );
+
+    return registry;
+}
+
+/************************************************************************/
+/*                  pj_grid_registry_set_allocator()                    */
+/*                                                                      */
+/*      Set the functions the memory of grids opened through the        */
+/*      registry from now on comes from, in place of the allocator of   */
+/*      the opening context (see pj_ctx_set_allocator()).  On NUMA      */
+/*      machines, a registry per node with an allocator binding its     */
+/*      memory to that node, attached to the contexts of the threads    */
+/*      pinned there, replicates each grid on the nodes that use it,    */
+/*      and every thread reads node local values.  The threads helping  */
+/*      with a batch of pj_ctx_set_threads() use the registry of the    */
+/*      calling context.  A NULL alloc restores the context's.          */
+/************************************************************************/
+
+void pj_grid_registry_set_allocator( PJ_GRID_REGISTRY *registry, 
+                                     void *(*alloc)(void *, size_t),
+                                     void (*dalloc)(void *, void *),
+                                     void *user_data )
 
 {
-    while( grid_list != NULL )
+    if( registry == NULL )
+        registry = pj_ctx_grid_registry( NULL );
+
+    pj_rwlock_acquire( registry->grid_lock, 1 );
+    registry->allocator.alloc = alloc != NULL && dalloc != NULL ? alloc : NULL;
+    registry->allocator.dalloc = 
+        registry->allocator.alloc != NULL ? dalloc : NULL;
+    registry->allocator.user_data = user_data;
+    pj_rwlock_release( registry->grid_lock, 1 );
+}
+
+/************************************************************************/
+/*                    pj_grid_registry_free_grids()                     */
+/************************************************************************/
+
+static void pj_grid_names_free( PJ_GRID_NAME **buckets )
+
+{
+    int i;
+
+    for( i = 0; i < PJ_GRID_NAME_BUCKETS; i++ )
     {
-        PJ_GRIDINFO *item = grid_list;
-        grid_list = grid_list->next;
+        while( buckets[i] != NULL )
+        {
+            PJ_GRID_NAME *entry = buckets[i];
+
+            buckets[i] = entry->next;
+            pj_dalloc( entry->name );
+            pj_dalloc( entry->grids );
+            pj_dalloc( entry );
+        }
+    }
+}
+
+static void pj_grid_registry_free_grids( PJ_GRID_REGISTRY *registry )
+
+{
+    pj_geoid_diffs_free( registry );
+    pj_grid_pairs_free( registry );
+    pj_grid_names_free( registry->grid_names );
+    pj_grid_names_free( registry->nadgrids_lists );
+
+    while( registry->grid_list != NULL )
+    {
+        PJ_GRIDINFO *item = registry->grid_list;
+        registry->grid_list = registry->grid_list->next;
         item->next = NULL;
 
         pj_gridinfo_free( pj_get_default_ctx(), item );
     }
 }
 
+/************************************************************************/
+/*                      pj_grid_registry_destroy()                      */
+/*                                                                      */
+/*      Free the grids and catalogs of a registry without users, and    */
+/*      the registry itself unless it is the static default one.        */
+/************************************************************************/
+
+static void pj_grid_registry_destroy( PJ_GRID_REGISTRY *registry )
+
+{
+    pj_gc_free_catalogs( registry );
+    pj_grid_registry_free_grids( registry );
+    registry->retired = 0;
+
+    if( registry == &default_registry )
+        return;
+
+    pj_rwlock_destroy( registry->grid_lock );
+    pj_rwlock_destroy( registry->catalog_lock );
+    pj_dalloc( registry );
+}
+
+/************************************************************************/
+/*                       pj_grid_registry_free()                        */
+/*                                                                      */
+/*      Free a registry with its grids and catalogs, once the last      */
+/*      projection that used it for shifts is freed or has moved on     */
+/*      to the registry of its context.  No context may still use it.   */
+/************************************************************************/
+
+void pj_grid_registry_free( PJ_GRID_REGISTRY *registry )
+
+{
+    int used;
+
+    if( registry == NULL || registry == &default_registry )
+        return;
+
+    pj_acquire_lock();
+    used = registry->refs > 0;
+    registry->retired = 1;
+    pj_release_lock();
+
+    if( !used )
+        pj_grid_registry_destroy( registry );
+}
+
+/************************************************************************/
+/*                        pj_deallocate_grids()                         */
+/*                                                                      */
+/*      Deallocate all grids loaded in the default registry.  If        */
+/*      projections still use them, the registry is replaced by an      */
+/*      empty one for the lookups to come, and freed with the last of   */
+/*      them, so that updated grid files are read again without         */
+/*      pulling grids from under running transformations.               */
+/************************************************************************/
+
+void pj_deallocate_grids()
+
+{
+    PJ_GRID_REGISTRY *old, *fresh = NULL;
+    int replaced = 0;
+
+    /* sets up the default registry if need be */
+    pj_ctx_grid_registry( NULL );
+
+    pj_acquire_lock();
+    old = default_current;
+    if( old->refs > 0 )
+    {
+        if( (fresh = pj_grid_registry_alloc()) != NULL )
+        {
+            fresh->allocator = old->allocator;
+            old->retired = 1;
+            default_current = fresh;
+        }
+    }
+    /* back to the static registry once it is free again */
+    else if( old != &default_registry && !default_registry.retired )
+    {
+        default_registry.allocator = old->allocator;
+        default_current = &default_registry;
+        replaced = 1;
+    }
+    pj_release_lock();
+
+    if( replaced )
+        pj_grid_registry_destroy( old );
+    /* without users, or if no new registry could be had */
+    else if( fresh == NULL )
+        pj_grid_registry_free_grids( old );
+}
+
+/************************************************************************/
+/*                        pj_grid_registry_of()                         */
+/*                                                                      */
+/*      The registry the grids of the projection come from, binding     */
+/*      it to that of its context on first use.  The projection keeps   */
+/*      it, even once retired, until unbound.                           */
+/************************************************************************/
+
+PJ_GRID_REGISTRY *pj_grid_registry_of( PJ *defn )
+
+{
+    PJ_GRID_REGISTRY *registry = defn->cold->grid_registry;
+
+    if( registry != NULL )
+        return registry;
+
+    /* sets up the default registry if need be */
+    pj_ctx_grid_registry( defn->ctx );
+
+    pj_acquire_lock();
+    registry = defn->ctx != NULL && defn->ctx->grid_registry != NULL
+        ? defn->ctx->grid_registry : default_current;
+    registry->refs++;
+    defn->cold->grid_registry = registry;
+    pj_release_lock();
+
+    return registry;
+}
+
+/************************************************************************/
+/*                      pj_grid_registry_unbind()                       */
+/*                                                                      */
+/*      Drop the grids and catalog the projection found, and its hold   */
+/*      on their registry, the last user of a retired registry          */
+/*      freeing it.                                                     */
+/************************************************************************/
+
+void pj_grid_registry_unbind( PJ *defn )
+
+{
+    PJ_GRID_REGISTRY *registry = defn->cold->grid_registry;
+    int last;
+
+    pj_dalloc( defn->cold->gridlist );
+    defn->cold->gridlist = NULL;
+    defn->cold->gridlist_count = 0;
+    defn->gridlist_last = NULL;
+    defn->gridlist_last_table = 0;
+    pj_dalloc( defn->cold->vgridlist_geoid );
+    defn->cold->vgridlist_geoid = NULL;
+    defn->cold->vgridlist_geoid_count = 0;
+    defn->cold->catalog = NULL;
+    defn->cold->last_before_grid = NULL;
+    defn->cold->last_after_grid = NULL;
+    pj_gc_blend_free( defn );
+
+    if( registry == NULL )
+        return;
+    defn->cold->grid_registry = NULL;
+
+    pj_acquire_lock();
+    last = --registry->refs == 0 && registry->retired;
+    pj_release_lock();
+
+    if( last )
+        pj_grid_registry_destroy( registry );
+}
+
+/************************************************************************/
+/*                      pj_grid_registry_refresh()                      */
+/*                                                                      */
+/*      Called before each batch: if the registry of the projection     */
+/*      has been retired, unbind it, so that its grids are looked up    */
+/*      again in the current one.  Returns TRUE if it was.              */
+/************************************************************************/
+
+int pj_grid_registry_refresh( PJ *defn )
+
+{
+    /* retired only ever goes from 0 to 1, so an unlocked look is safe */
+    if( defn == NULL || defn->cold->grid_registry == NULL 
+        || !defn->cold->grid_registry->retired )
+        return 0;
+
+    pj_log( defn->ctx, PJ_LOG_DEBUG_MINOR,
+            "Grids of the definition replaced, looking them up again" );
+    pj_grid_registry_unbind( defn );
+    return 1;
+}
+
+/************************************************************************/
+/*                           pj_grid_name_find()                        */
+/*                                                                      */
+/*      The entry of a name in a table of the registry, or NULL.  The   */
+/*      hash is FNV-1a, as for the init cache.                          */
+/************************************************************************/
+
+static int pj_grid_name_hash( const char *name )
+
+{
+    unsigned long hash = 2166136261UL;
+
+    for( ; *name != '\0'; name++ )
+    {
+        hash ^= (unsigned char) *name;
+        hash = (hash * 16777619UL) & 0xffffffffUL;
+    }
+
+    return (int) (hash & (PJ_GRID_NAME_BUCKETS - 1));
+}
+
+static PJ_GRID_NAME *pj_grid_name_find( PJ_GRID_NAME **buckets, 
+                                        const char *name )
+
+{
+    PJ_GRID_NAME *entry;
+
+    for( entry = buckets[pj_grid_name_hash( name )]; entry != NULL;
+         entry = entry->next )
+    {
+        if( strcmp( entry->name, name ) == 0 )
+            return entry;
+    }
+
+    return NULL;
+}
+
+/************************************************************************/
+/*                           pj_grid_name_add()                         */
+/*                                                                      */
+/*      Add a name with a copy of its grids to a table, with the grid   */
+/*      list lock held exclusively.  Returns NULL out of memory.        */
+/************************************************************************/
+
+static PJ_GRID_NAME *pj_grid_name_add( PJ_GRID_NAME **buckets, 
+                                       const char *name,
+                                       PJ_GRIDINFO **grids, int grid_count )
+
+{
+    PJ_GRID_NAME *entry;
+    int bucket = pj_grid_name_hash( name );
+
+    entry = (PJ_GRID_NAME *) pj_malloc( sizeof(PJ_GRID_NAME) );
+    if( entry == NULL )
+        return NULL;
+
+    entry->name = (char *) pj_malloc( strlen(name) + 1 );
+    entry->grids = grid_count > 0 
+        ? (PJ_GRIDINFO **) pj_malloc( sizeof(void*) * grid_count ) : NULL;
+    if( entry->name == NULL || (grid_count > 0 && entry->grids == NULL) )
+    {
+        pj_dalloc( entry->name );
+        pj_dalloc( entry->grids );
+        pj_dalloc( entry );
+        return NULL;
+    }
+
+    strcpy( entry->name, name );
+    if( grid_count > 0 )
+        memcpy( entry->grids, grids, sizeof(void*) * grid_count );
+    entry->grid_count = grid_count;
+
+    entry->next = buckets[bucket];
+    buckets[bucket] = entry;
+
+    return entry;
+}
+
+/************************************************************************/
+/*                        pj_gridlist_next_name()                       */
+/*                                                                      */
+/*      Copy the next grid name of a nadgrids string into name, of      */
+/*      PJ_GRID_NAME_MAX bytes, moving *s past it and setting           */
+/*      *required unless it is prefixed with '@'.  Returns FALSE if     */
+/*      the name is too long.                                           */
+/************************************************************************/
+
+#define PJ_GRID_NAME_MAX 128
+
+static int pj_gridlist_next_name( const char **s, char *name, int *required )
+
+{
+    int end_char;
+
+    *required = 1;
+    if( **s == '@' )
+    {
+        *required = 0;
+        (*s)++;
+    }
+
+    for( end_char = 0; 
+         (*s)[end_char] != '\0' && (*s)[end_char] != ','; 
+         end_char++ ) {}
+
+    if( end_char >= PJ_GRID_NAME_MAX )
+        return 0;
+        
+    strncpy( name, *s, end_char );
+    name[end_char] = '\0';
+
+    *s += end_char;
+    if( **s == ',' )
+        (*s)++;
+
+    return 1;
+}
+
+/************************************************************************/
+/*                       pj_gridlist_open_names()                       */
+/*                                                                      */
+/*      Read the headers of the grid files of a nadgrids string that    */
+/*      the registry does not know yet, up to PJ_GRID_OPEN_MAX of       */
+/*      them, without the grid list lock, so that a thread opening a    */
+/*      grid, maybe over the network, does not hold up the threads      */
+/*      looking up or opening others.  A grid another thread opened     */
+/*      meanwhile is kept instead, see pj_gridlist_opened_free().       */
+/*      Returns the number of files opened into opened.                 */
+/************************************************************************/
+
+#define PJ_GRID_OPEN_MAX 8
+
+typedef struct {
+    char        name[PJ_GRID_NAME_MAX];
+    PJ_GRIDINFO *grids;  /* of pj_gridinfo_init(), NULL once registered */
+} PJ_GRID_OPENED;
+
+static int pj_gridlist_open_names( projCtx ctx, PJ_GRID_REGISTRY *registry,
+                                   const char *nadgrids, 
+                                   PJ_GRID_OPENED *opened )
+
+{
+    const char *s;
+    int opened_count = 0, required, known, i;
+
+    for( s = nadgrids; *s != '\0' && opened_count < PJ_GRID_OPEN_MAX; )
+    {
+        if( !pj_gridlist_next_name( &s, opened[opened_count].name, 
+                                    &required ) )
+            break;
+
+        for( i = 0; i < opened_count; i++ )
+            if( strcmp( opened[i].name, opened[opened_count].name ) == 0 )
+                break;
+        if( i < opened_count )
+            continue;
+
+        pj_rwlock_acquire( registry->grid_lock, 0 );
+        known = pj_grid_name_find( registry->grid_names, 
+                                   opened[opened_count].name ) != NULL;
+        pj_rwlock_release( registry->grid_lock, 0 );
+        if( known )
+            continue;
+
+        opened[opened_count].grids = 
+            pj_gridinfo_init( ctx, opened[opened_count].name );
+        if( opened[opened_count].grids != NULL )
+            opened_count++;
+    }
+
+    return opened_count;
+}
+
+/************************************************************************/
+/*                       pj_gridlist_opened_free()                      */
+/*                                                                      */
+/*      Free the grids of pj_gridlist_open_names() that were not        */
+/*      registered, with the grid list lock released.                   */
+/************************************************************************/
+
+static void pj_gridlist_opened_free( projCtx ctx, PJ_GRID_OPENED *opened,
+                                     int opened_count )
+
+{
+    int i;
+
+    for( i = 0; i < opened_count; i++ )
+    {
+        while( opened[i].grids != NULL )
+        {
+            PJ_GRIDINFO *gi = opened[i].grids;
+
+            opened[i].grids = gi->next;
+            gi->next = NULL;
+            pj_gridinfo_free( ctx, gi );
+        }
+    }
+}
+
 /************************************************************************/
 /*                       pj_gridlist_merge_grid()                       */
 /*                                                                      */
 /*      Find/load the named gridfile and merge it into the              */
-/*      last_nadgrids_list.                                             */
+/*      last_nadgrids_list, with the grid list lock held exclusively.   */
+/*      The grids of a file already opened are taken from opened.       */
 /************************************************************************/
 
 static int pj_gridlist_merge_gridfile( projCtx ctx, 
+                                       PJ_GRID_REGISTRY *registry,
                                        const char *gridname,
+                                       PJ_GRID_OPENED *opened,
+                                       int opened_count,
                                        PJ_GRIDINFO ***p_gridlist,
                                        int *p_gridcount, 
                                        int *p_gridmax )
 
 {
-    int got_match=0;
-    PJ_GRIDINFO *this_grid, *tail = NULL;
+    PJ_GRID_NAME *entry;
+    PJ_GRIDINFO *this_grid = NULL, *tail, **grids = NULL;
+    int count = 0, i;
+
+    entry = pj_grid_name_find( registry->grid_names, gridname );
 
 /* -------------------------------------------------------------------- */
-/*      Try to find in the existing list of loaded grids.  Add all      */
-/*      matching grids as with NTv2 we can get many grids from one      */
+/*      Try to load the named grid, and keep all the grids it gave      */
+/*      under its name, as with NTv2 we can get many grids from one     */
 /*      file (one shared gridname).                                     */
 /* -------------------------------------------------------------------- */
-    for( this_grid = grid_list; this_grid != NULL; this_grid = this_grid->next)
+    if( entry == NULL )
     {
-        if( strcmp(this_grid->gridname,gridname) == 0 )
+        for( i = 0; i < opened_count && this_grid == NULL; i++ )
         {
-            got_match = 1;
-
-            /* dont add to the list if it is invalid. */
-            if( this_grid->ct == NULL )
-                return 0;
-
-            /* do we need to grow the list? */
-            if( *p_gridcount >= *p_gridmax - 2 )
+            if( opened[i].grids != NULL 
+                && strcmp( opened[i].name, gridname ) == 0 )
             {
-                PJ_GRIDINFO **new_list;
-                int new_max = *p_gridmax + 20;
-
-                new_list = (PJ_GRIDINFO **) pj_malloc(sizeof(void*) * new_max);
-                if( *p_gridlist != NULL )
-                {
-                    memcpy( new_list, *p_gridlist,
-                            sizeof(void*) * (*p_gridmax) );
-                    pj_dalloc( *p_gridlist );
-                }
-
-                *p_gridlist = new_list;
-                *p_gridmax = new_max;
+                this_grid = opened[i].grids;
+                opened[i].grids = NULL;
             }
+        }
+        if( this_grid == NULL )
+            this_grid = pj_gridinfo_init( ctx, gridname );
+
+        if( this_grid == NULL )
+        {
+            /* we should get at least a stub grid with a missing "ct" member */
+            assert( FALSE );
+            return 0;
+        }
 
-            /* add to the list */
-            (*p_gridlist)[(*p_gridcount)++] = this_grid;
-            (*p_gridlist)[*p_gridcount] = NULL;
+        /* dont add to the list if it is invalid. */
+        for( tail = this_grid; ; tail = tail->next )
+        {
+            if( tail->ct != NULL )
+                count++;
+            if( tail->next == NULL )
+                break;
         }
 
-        tail = this_grid;
+        if( count > 0 
+            && (grids = (PJ_GRIDINFO **) 
+                pj_malloc( sizeof(void*) * count )) != NULL )
+        {
+            PJ_GRIDINFO *gi;
+
+            count = 0;
+            for( gi = this_grid; gi != NULL; gi = gi->next )
+                if( gi->ct != NULL )
+                    grids[count++] = gi;
+        }
+
+        tail->next = registry->grid_list;
+        registry->grid_list = this_grid;
+
+        if( count > 0 && grids == NULL )
+            return 0;
+        entry = pj_grid_name_add( registry->grid_names, gridname, 
+                                  grids, count );
+        pj_dalloc( grids );
+        if( entry == NULL )
+            return 0;
     }
 
-    if( got_match )
-        return 1;
+    if( entry->grid_count == 0 )
+        return 0;
 
 /* -------------------------------------------------------------------- */
-/*      Try to load the named grid.                                     */
+/*      Add its grids to the list, keeping it NULL terminated.          */
 /* -------------------------------------------------------------------- */
-    this_grid = pj_gridinfo_init( ctx, gridname );
-
-    if( this_grid == NULL )
+    if( *p_gridcount + entry->grid_count >= *p_gridmax )
     {
-        /* we should get at least a stub grid with a missing "ct" member */
-        assert( FALSE );
-        return 0;
+        PJ_GRIDINFO **new_list;
+        int new_max = *p_gridmax * 2 + entry->grid_count + 1;
+
+        new_list = (PJ_GRIDINFO **) pj_malloc(sizeof(void*) * new_max);
+        if( new_list == NULL )
+            return 0;
+        if( *p_gridlist != NULL )
+        {
+            memcpy( new_list, *p_gridlist, sizeof(void*) * (*p_gridcount) );
+            pj_dalloc( *p_gridlist );
+        }
+
+        *p_gridlist = new_list;
+        *p_gridmax = new_max;
     }
-    
-    if( tail != NULL )
-        tail->next = this_grid;
-    else
-        grid_list = this_grid;
 
-/* -------------------------------------------------------------------- */
-/*      Recurse to add the grid now that it is loaded.                  */
-/* -------------------------------------------------------------------- */
-    return pj_gridlist_merge_gridfile( ctx, gridname, p_gridlist, 
-                                       p_gridcount, p_gridmax );
+    memcpy( *p_gridlist + *p_gridcount, entry->grids, 
+            sizeof(void*) * entry->grid_count );
+    *p_gridcount += entry->grid_count;
+    (*p_gridlist)[*p_gridcount] = NULL;
+
+    return 1;
 }
 
 /************************************************************************/
-/*                     pj_gridlist_from_nadgrids()                      */
+/*                       pj_gridlist_from_names()                       */
 /*                                                                      */
-/*      This functions loads the list of grids corresponding to a       */
-/*      particular nadgrids string into a list, and returns it.  The    */
-/*      list is kept around till a request is made with a different     */
-/*      string in order to cut down on the string parsing cost, and     */
-/*      the cost of building the list of tables each time.              */
+/*      Build the list of grids of a nadgrids string with the grid      */
+/*      list lock held exclusively.                                     */
 /************************************************************************/
 
-PJ_GRIDINFO **pj_gridlist_from_nadgrids( projCtx ctx, const char *nadgrids, 
-                                         int *grid_count)
+static int pj_gridlist_from_names( projCtx ctx, PJ_GRID_REGISTRY *registry,
+                                   const char *nadgrids, 
+                                   PJ_GRID_OPENED *opened,
+                                   int opened_count,
+                                   PJ_GRIDINFO ***p_gridlist,
+                                   int *grid_count )
 
 {
     const char *s;
-    PJ_GRIDINFO **gridlist = NULL;
     int grid_max = 0;
 
-    pj_errno = 0;
-    *grid_count = 0;
-
-    pj_acquire_lock();
-
 /* -------------------------------------------------------------------- */
 /*      Loop processing names out of nadgrids one at a time.            */
 /* -------------------------------------------------------------------- */
     for( s = nadgrids; *s != '\0'; )
     {
-        int   end_char;
-        int   required = 1;
-        char  name[128];
+        int   required;
+        int   merged;
+        char  name[PJ_GRID_NAME_MAX];
 
-        if( *s == '@' )
+        if( !pj_gridlist_next_name( &s, name, &required ) )
         {
-            required = 0;
-            s++;
+            pj_ctx_set_errno( ctx, -38 );
+            return 0;
         }
 
-        for( end_char = 0; 
-             s[end_char] != '\0' && s[end_char] != ','; 
-             end_char++ ) {}
-
-        if( end_char >= sizeof(name) )
+        merged = pj_gridlist_merge_gridfile( ctx, registry, name, 
+                                             opened, opened_count,
+                                             p_gridlist, grid_count, 
+                                             &grid_max );
+        if( merged == 0 && required )
         {
             pj_ctx_set_errno( ctx, -38 );
-            pj_release_lock();
-            return NULL;
+            return 0;
         }
-        
-        strncpy( name, s, end_char );
-        name[end_char] = '\0';
+        else if( ctx->errno_globals )
+            pj_errno = 0;
+    }
+
+    return 1;
+}
+
+/************************************************************************/
+/*                       pj_gridlist_copy_known()                       */
+/*                                                                      */
+/*      Copy the list kept for a nadgrids string, with the grid list    */
+/*      lock held.  Returns -1 if there is none yet, 0 out of memory    */
+/*      and 1 otherwise.                                                */
+/************************************************************************/
+
+static int pj_gridlist_copy_known( projCtx ctx, PJ_GRID_REGISTRY *registry,
+                                   const char *nadgrids, 
+                                   PJ_GRIDINFO ***p_gridlist,
+                                   int *grid_count )
+
+{
+    PJ_GRID_NAME *entry;
 
-        s += end_char;
-        if( *s == ',' )
-            s++;
+    entry = pj_grid_name_find( registry->nadgrids_lists, nadgrids );
+    if( entry == NULL )
+        return -1;
 
-        if( !pj_gridlist_merge_gridfile( ctx, name, &gridlist, grid_count, 
-                                         &grid_max) 
-            && required )
+    if( entry->grid_count > 0 )
+    {
+        *p_gridlist = (PJ_GRIDINFO **) 
+            pj_malloc( sizeof(void*) * (entry->grid_count + 1) );
+        if( *p_gridlist == NULL )
         {
-            pj_ctx_set_errno( ctx, -38 );
-            pj_release_lock();
-            return NULL;
+            pj_ctx_set_errno( ctx, ENOMEM );
+            return 0;
         }
-        else
-            pj_errno = 0;
+        memcpy( *p_gridlist, entry->grids, 
+                sizeof(void*) * entry->grid_count );
+        (*p_gridlist)[entry->grid_count] = NULL;
     }
+    *grid_count = entry->grid_count;
 
-    pj_release_lock();
+    return 1;
+}
+
+/************************************************************************/
+/*                     pj_gridlist_from_nadgrids()                      */
+/*                                                                      */
+/*      This functions loads the list of grids corresponding to a       */
+/*      particular nadgrids string into a list, and returns it.  The    */
+/*      list of each string is kept in the registry, to cut down on     */
+/*      the string parsing cost, and the cost of building the list of   */
+/*      tables each time, and the caller gets a copy of it.             */
+/*                                                                      */
+/*      The list is first looked for with the grid list lock shared,    */
+/*      and only if it has to be built do we start over with it held    */
+/*      exclusively.                                                    */
+/************************************************************************/
+
+PJ_GRIDINFO **pj_gridlist_from_nadgrids( projCtx ctx, const char *nadgrids, 
+                                         int *grid_count)
+
+{
+    return pj_gridlist_from_registry( ctx, pj_ctx_grid_registry( ctx ),
+                                      nadgrids, grid_count );
+}
+
+/************************************************************************/
+/*                     pj_gridlist_from_registry()                      */
+/*                                                                      */
+/*      pj_gridlist_from_nadgrids() in the given registry, as that of   */
+/*      a projection, see pj_grid_registry_of().                        */
+/************************************************************************/
+
+PJ_GRIDINFO **pj_gridlist_from_registry( projCtx ctx, 
+                                         PJ_GRID_REGISTRY *registry,
+                                         const char *nadgrids, 
+                                         int *grid_count)
+
+{
+    PJ_GRIDINFO **gridlist = NULL;
+    int result;
+
+    if( ctx->errno_globals )
+        pj_errno = 0;
+
+    *grid_count = 0;
+
+    pj_rwlock_acquire( registry->grid_lock, 0 );
+    result = pj_gridlist_copy_known( ctx, registry, nadgrids, &gridlist,
+                                     grid_count );
+    pj_rwlock_release( registry->grid_lock, 0 );
+
+    if( result < 0 )
+    {
+        PJ_GRID_OPENED opened[PJ_GRID_OPEN_MAX];
+        int opened_count = pj_gridlist_open_names( ctx, registry, nadgrids,
+                                                   opened );
+
+        pj_rwlock_acquire( registry->grid_lock, 1 );
+        result = pj_gridlist_copy_known( ctx, registry, nadgrids, &gridlist,
+                                         grid_count );
+        if( result < 0 )
+        {
+            result = pj_gridlist_from_names( ctx, registry, nadgrids, 
+                                             opened, opened_count,
+                                             &gridlist, grid_count );
+            /* a failure to keep it only costs building it again */
+            if( result == 1 )
+                pj_grid_name_add( registry->nadgrids_lists, nadgrids, 
+                                  gridlist, *grid_count );
+        }
+        pj_rwlock_release( registry->grid_lock, 1 );
+
+        pj_gridlist_opened_free( ctx, opened, opened_count );
+    }
+
+    if( result != 1 )
+    {
+        pj_dalloc( gridlist );
+        return NULL;
+    }
 
     return gridlist;
 }
@@ -0,0 +1,163 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Ordering of batches of points along a space filling curve, so
+ *           that grid lookups visit neighbouring cells in turn.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <projects.h>
+#include <string.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** The keys interleave the bits of x and y quantized to 8 bits each over
+** the extent of the points (a Morton, or Z order, curve), so points
+** close on the curve are close on the grids, whatever their cell size.
+** This is fine enough for the grid tiles and caches, and lets the
+** indices be sorted by key with a radix sort of two byte passes, which
+** keeps points of equal keys in their order.
+**
+** Points mostly close to the one before them, such as scan lines or
+** points sorted already, are left in their order, the sort costing more
+** than it would save.
+*/
+
+/************************************************************************/
+/*                          pj_morton_spread()                          */
+/*                                                                      */
+/*      Spread the 8 bits of v to the even bits of the result.         */
+/************************************************************************/
+
+static unsigned int pj_morton_spread( unsigned int v )
+
+{
+    v = (v | (v << 4)) & 0x0F0FU;
+    v = (v | (v << 2)) & 0x3333U;
+    v = (v | (v << 1)) & 0x5555U;
+    return v;
+}
+
+/************************************************************************/
+/*                           pj_grid_order()                            */
+/*                                                                      */
+/*      Put in order the indices of the point_count points of x and     */
+/*      y, at a stride of point_offset, along the curve.  Points at     */
+/*      HUGE_VAL come last.  order and keys are work arrays of twice    */
+/*      point_count entries.  Returns 0, without an order, if the      */
+/*      points are better left as they are.                             */
+/************************************************************************/
+
+int pj_grid_order( long point_count, int point_offset, 
+                   const double *x, const double *y,
+                   long *order, unsigned short *keys )
+
+{
+    unsigned short *keys_tmp = keys + point_count;
+    long   *order_tmp = order + point_count;
+    long   count[256], i, jumps = 0;
+    double min_x = HUGE_VAL, max_x = -HUGE_VAL;
+    double min_y = HUGE_VAL, max_y = -HUGE_VAL;
+    double scale_x, scale_y;
+    int    shift, last_cx = -2, last_cy = -2;
+
+    for( i = 0; i < point_count; i++ )
+    {
+        double px = x[i * point_offset], py = y[i * point_offset];
+
+        if( px == HUGE_VAL || py == HUGE_VAL )
+            continue;
+        if( px < min_x ) min_x = px;
+        if( px > max_x ) max_x = px;
+        if( py < min_y ) min_y = py;
+        if( py > max_y ) max_y = py;
+    }
+
+    scale_x = max_x > min_x ? 255.0 / (max_x - min_x) : 0.0;
+    scale_y = max_y > min_y ? 255.0 / (max_y - min_y) : 0.0;
+
+    for( i = 0; i < point_count; i++ )
+    {
+        double px = x[i * point_offset], py = y[i * point_offset];
+        int    cx, cy;
+
+        order[i] = i;
+        if( px == HUGE_VAL || py == HUGE_VAL )
+        {
+            keys[i] = 0xFFFFU;
+            continue;
+        }
+
+        cx = (int) ((px - min_x) * scale_x);
+        cy = (int) ((py - min_y) * scale_y);
+        keys[i] = (unsigned short) 
+            (pj_morton_spread( cx ) | (pj_morton_spread( cy ) << 1));
+
+        if( cx - last_cx > 1 || last_cx - cx > 1 
+            || cy - last_cy > 1 || last_cy - cy > 1 )
+            jumps++;
+        last_cx = cx;
+        last_cy = cy;
+    }
+
+    if( jumps < point_count / 16 )
+        return 0;
+
+/* -------------------------------------------------------------------- */
+/*      Sort by the low then the high byte of the keys, going to the    */
+/*      second halves of the arrays and back.                           */
+/* -------------------------------------------------------------------- */
+    for( shift = 0; shift < 16; shift += 8 )
+    {
+        unsigned short *from_key = shift == 0 ? keys : keys_tmp;
+        unsigned short *to_key = shift == 0 ? keys_tmp : keys;
+        long           *from = shift == 0 ? order : order_tmp;
+        long           *to = shift == 0 ? order_tmp : order;
+        long           total = 0;
+        int            b;
+
+        memset( count, 0, sizeof(count) );
+        for( i = 0; i < point_count; i++ )
+            count[(from_key[i] >> shift) & 0xFF]++;
+
+        for( b = 0; b < 256; b++ )
+        {
+            long c = count[b];
+
+            count[b] = total;
+            total += c;
+        }
+
+        for( i = 0; i < point_count; i++ )
+        {
+            long dest = count[(from_key[i] >> shift) & 0xFF]++;
+
+            to_key[dest] = from_key[i];
+            to[dest] = from[i];
+        }
+    }
+
+    return 1;
+}
@@ -0,0 +1,169 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Memory for the values of large grids, backed by huge pages
+ *           where the platform has them.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <projects.h>
+
+#if !defined(_WIN32) && !defined(GRIDPAGES_stub)
+#  define GRIDPAGES_posix
+#endif
+
+#ifdef GRIDPAGES_posix
+#  include <sys/types.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#  if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#    define MAP_ANONYMOUS MAP_ANON
+#  endif
+#  ifndef MAP_ANONYMOUS
+#    undef GRIDPAGES_posix
+#  endif
+#endif
+
+PJ_CVSID("$Id$");
+
+/*
+** Grid values are looked up at about random places, so a grid of tens
+** of megabytes in 4 KB pages misses the TLB on most lookups.  The
+** values of grids of at least a huge page are put in anonymous mappings
+** aligned on 2 MB, which the kernel may back with transparent huge
+** pages once advised to, or taken from the reserved huge page pool.
+** Mapped grid files are advised to as well.
+** The length of a mapping is kept in a header before the values.
+** Elsewhere pj_grid_pages_alloc() fails, and grids are loaded in memory
+** of the usual allocator.
+*/
+
+#define HUGE_PAGE_SIZE    (2 * 1024 * 1024)
+#define GRID_PAGES_HEADER 64
+
+/************************************************************************/
+/*                        pj_grid_pages_advise()                        */
+/*                                                                      */
+/*      Ask for huge pages for a range of mapped memory, if the         */
+/*      platform takes such advice.  The range is widened to the page   */
+/*      holding its start.  Pages of mapped files only get huge pages   */
+/*      where the kernel and file system support it.                    */
+/************************************************************************/
+
+void pj_grid_pages_advise( void *start, size_t size )
+
+{
+#if defined(GRIDPAGES_posix) && defined(MADV_HUGEPAGE)
+    size_t page = (size_t) sysconf( _SC_PAGESIZE );
+    size_t head = page > 0 ? (size_t) start % page : 0;
+
+    madvise( (char *) start - head, size + head, MADV_HUGEPAGE );
+#else
+    (void) start;
+    (void) size;
+#endif
+}
+
+/************************************************************************/
+/*                        pj_grid_pages_alloc()                         */
+/*                                                                      */
+/*      Allocate size bytes of grid values in huge pages, as in a       */
+/*      PJ_HUGE_PAGES_* mode.  PJ_HUGE_PAGES_EXPLICIT falls back to     */
+/*      advised pages when the pool is empty.  Returns NULL if there    */
+/*      is no point or no way to, for the caller to allocate the        */
+/*      values otherwise.                                               */
+/************************************************************************/
+
+void *pj_grid_pages_alloc( int mode, size_t size )
+
+{
+#ifdef GRIDPAGES_posix
+    size_t length;
+    char *base = (char *) MAP_FAILED;
+
+    if( mode == PJ_HUGE_PAGES_NONE || size < HUGE_PAGE_SIZE )
+        return NULL;
+
+    length = (size + GRID_PAGES_HEADER + HUGE_PAGE_SIZE - 1) 
+        / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+#ifdef MAP_HUGETLB
+    if( mode == PJ_HUGE_PAGES_EXPLICIT )
+        base = (char *) mmap( NULL, length, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, 
+                              -1, 0 );
+#endif
+
+    if( base == (char *) MAP_FAILED )
+    {
+        size_t head;
+
+        /* map a huge page more, and trim it to a huge page boundary */
+        base = (char *) mmap( NULL, length + HUGE_PAGE_SIZE, 
+                              PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if( base == (char *) MAP_FAILED )
+            return NULL;
+
+        head = HUGE_PAGE_SIZE - (size_t) base % HUGE_PAGE_SIZE;
+        if( head == HUGE_PAGE_SIZE )
+            head = 0;
+        if( head > 0 )
+            munmap( base, head );
+        if( HUGE_PAGE_SIZE - head > 0 )
+            munmap( base + head + length, HUGE_PAGE_SIZE - head );
+        base += head;
+
+        pj_grid_pages_advise( base, length );
+    }
+
+    *((size_t *) base) = length;
+
+    return base + GRID_PAGES_HEADER;
+#else
+    (void) mode;
+    (void) size;
+    return NULL;
+#endif
+}
+
+/************************************************************************/
+/*                         pj_grid_pages_free()                         */
+/************************************************************************/
+
+void pj_grid_pages_free( void *values )
+
+{
+#ifdef GRIDPAGES_posix
+    char *base;
+
+    if( values == NULL )
+        return;
+
+    base = (char *) values - GRID_PAGES_HEADER;
+    munmap( base, *((size_t *) base) );
+#else
+    (void) values;
+#endif
+}
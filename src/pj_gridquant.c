@@ -0,0 +1,374 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Grid values held as 16 bit integers scaled by blocks of nodes,
+ *           to cut the memory of large grids.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <string.h>
+#include <math.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** Each component of a block of PJ_GRID_QUANT_BLOCK by PJ_GRID_QUANT_BLOCK
+** nodes is stored as steps of (max - min) / 65534 above its minimum, so
+** shifts varying slowly within a block keep well under a millimetre.
+** The values are read back as the floats of the plain table would be,
+** so everything past the unpacking is unchanged.  The store is built
+** once under the grid lock and never changed, so it is read without
+** locking, as the inverse tables are.
+*/
+
+#define QUANT_STEPS 65534.0
+#define QUANT_SHIFT_METRES 6378137.0  /* metres per radian of shift */
+#define QUANT_NODATA -88.88880f       /* nodata height of gtx grids */
+
+/************************************************************************/
+/*                          pj_grid_quant_free()                        */
+/************************************************************************/
+
+void pj_grid_quant_free( PJ_GRIDINFO *gi )
+
+{
+    PJ_GRID_QUANT *quant = gi->quant;
+
+    if( quant == NULL )
+        return;
+
+    if( quant->values != NULL )
+        pj_gridinfo_free_values( gi, quant->values, quant->values_paged );
+    pj_dalloc( quant->offset );
+    pj_dalloc( quant->scale );
+    pj_dalloc( quant );
+    gi->quant = NULL;
+}
+
+/************************************************************************/
+/*                         pj_grid_quant_block()                        */
+/*                                                                      */
+/*      Quantize one component of the nodes of a block, of which band   */
+/*      holds the rows read from the file.  Returns the largest error   */
+/*      in the units of the values, or HUGE_VAL if one of them is not   */
+/*      finite.                                                         */
+/************************************************************************/
+
+static double pj_grid_quant_block( PJ_GRID_QUANT *quant, int cols,
+                                   int first_row, int row_count,
+                                   int first_col, int col_count,
+                                   int component, const float *band,
+                                   int block )
+
+{
+    int    nc = quant->components, r, c, nodata = nc == 1;
+    double lo = HUGE_VAL, hi = -HUGE_VAL, offset, scale, max_error = 0.0;
+
+    for( r = 0; r < row_count; r++ )
+    {
+        const float *v = band + ((long) r * cols + first_col) * nc + component;
+
+        for( c = 0; c < col_count; c++, v += nc )
+        {
+            if( nodata && *v == QUANT_NODATA )
+                continue;
+            if( !(*v > -HUGE_VAL && *v < HUGE_VAL) )
+                return HUGE_VAL;
+            if( *v < lo )
+                lo = *v;
+            if( *v > hi )
+                hi = *v;
+        }
+    }
+
+    if( lo > hi )
+        lo = hi = 0.0;
+    offset = lo;
+    scale = (hi - lo) / QUANT_STEPS;
+    quant->offset[block * nc + component] = offset;
+    quant->scale[block * nc + component] = scale;
+
+    for( r = 0; r < row_count; r++ )
+    {
+        const float *v = band + ((long) r * cols + first_col) * nc + component;
+        unsigned short *q = quant->values
+            + ((long) (first_row + r) * cols + first_col) * nc + component;
+
+        for( c = 0; c < col_count; c++, v += nc, q += nc )
+        {
+            double step, error;
+
+            if( nodata && *v == QUANT_NODATA )
+            {
+                *q = PJ_GRID_QUANT_NODATA;
+                continue;
+            }
+
+            step = scale > 0.0 ? floor((*v - offset) / scale + 0.5) : 0.0;
+            if( step > QUANT_STEPS )
+                step = QUANT_STEPS;
+            *q = (unsigned short) step;
+
+            error = fabs( (float) (offset + step * scale) - *v );
+            if( error > max_error )
+                max_error = error;
+        }
+    }
+
+    return max_error;
+}
+
+/************************************************************************/
+/*                          pj_grid_quant_build()                       */
+/*                                                                      */
+/*      Read the values of the grid a band of blocks at a time and      */
+/*      quantize them, setting max_error.  Returns FALSE if they        */
+/*      cannot be read or allocated.                                    */
+/************************************************************************/
+
+static int pj_grid_quant_build( projCtx ctx, PJ_GRIDINFO *gi,
+                                PJ_GRID_QUANT *quant )
+
+{
+    struct CTABLE *ct = gi->ct;
+    int    cols = ct->lim.lam, rows = ct->lim.phi, nc = quant->components;
+    int    blocks_y, by, bx, k;
+    double unit = nc == 1 ? 1.0 : QUANT_SHIFT_METRES;
+    float  *band;
+    PAFile fid;
+
+    quant->blocks_x = (cols + PJ_GRID_QUANT_BLOCK - 1) / PJ_GRID_QUANT_BLOCK;
+    blocks_y = (rows + PJ_GRID_QUANT_BLOCK - 1) / PJ_GRID_QUANT_BLOCK;
+
+    quant->offset = (double *)
+        pj_malloc(sizeof(double) * quant->blocks_x * blocks_y * nc);
+    quant->scale = (double *)
+        pj_malloc(sizeof(double) * quant->blocks_x * blocks_y * nc);
+    quant->values = (unsigned short *) pj_gridinfo_alloc_values(
+        ctx, gi, sizeof(unsigned short) * nc * cols * rows,
+        &(quant->values_paged) );
+    band = (float *)
+        pj_malloc(sizeof(float) * nc * cols * PJ_GRID_QUANT_BLOCK);
+    fid = pj_open_lib( ctx, gi->filename, "rb" );
+
+    if( quant->offset == NULL || quant->scale == NULL
+        || quant->values == NULL || band == NULL || fid == NULL )
+    {
+        if( fid != NULL )
+            pj_ctx_fclose( ctx, fid );
+        pj_dalloc( band );
+        return 0;
+    }
+
+    for( by = 0; by < blocks_y; by++ )
+    {
+        int first_row = by * PJ_GRID_QUANT_BLOCK;
+        int row_count = rows - first_row;
+
+        if( row_count > PJ_GRID_QUANT_BLOCK )
+            row_count = PJ_GRID_QUANT_BLOCK;
+
+        if( !pj_gridinfo_load_rows( ctx, gi, fid, first_row, row_count,
+                                    (FLP *) band ) )
+        {
+            pj_ctx_fclose( ctx, fid );
+            pj_dalloc( band );
+            return 0;
+        }
+
+        for( bx = 0; bx < quant->blocks_x; bx++ )
+        {
+            int first_col = bx * PJ_GRID_QUANT_BLOCK;
+            int col_count = cols - first_col;
+
+            if( col_count > PJ_GRID_QUANT_BLOCK )
+                col_count = PJ_GRID_QUANT_BLOCK;
+
+            for( k = 0; k < nc; k++ )
+            {
+                double error =
+                    pj_grid_quant_block( quant, cols, first_row, row_count,
+                                         first_col, col_count, k, band,
+                                         by * quant->blocks_x + bx );
+                if( error * unit > quant->max_error )
+                    quant->max_error = error * unit;
+            }
+        }
+    }
+
+    pj_ctx_fclose( ctx, fid );
+    pj_dalloc( band );
+
+    return 1;
+}
+
+/************************************************************************/
+/*                        pj_gridinfo_quantized()                       */
+/*                                                                      */
+/*      Return the quantized values of a grid not loaded otherwise,     */
+/*      building them on first use, if they are within the bound of     */
+/*      the context.  Returns NULL if the context does not ask for      */
+/*      them, the grid misses the bound of the context that first       */
+/*      quantized it, or it cannot be read, in which case the caller    */
+/*      uses the plain values.                                          */
+/************************************************************************/
+
+PJ_GRID_QUANT *pj_gridinfo_quantized( projCtx ctx, PJ_GRIDINFO *gi )
+
+{
+    PJ_GRID_QUANT *quant;
+    double start = 0.0;
+    int saved_errno = ctx->last_errno;
+
+    if( ctx->grid_quantize <= 0.0 || gi->ct == NULL )
+        return NULL;
+
+    if( gi->quant == NULL )
+    {
+        pj_mutex_lock( gi->lock );
+        if( gi->quant == NULL && gi->ct->cvs == NULL )
+        {
+            quant = (PJ_GRID_QUANT *) pj_malloc(sizeof(PJ_GRID_QUANT));
+            if( quant == NULL )
+            {
+                pj_mutex_unlock( gi->lock );
+                return NULL;
+            }
+            memset( quant, 0, sizeof(PJ_GRID_QUANT) );
+            quant->components = pj_gridinfo_heights( gi ) ? 1 : 2;
+
+            if( ctx->stats != NULL )
+                start = pj_clock_ns();
+
+            /* a grid that cannot be quantized is not tried again, and
+               is read as usual by the caller */
+            if( !pj_grid_quant_build( ctx, gi, quant ) )
+            {
+                pj_gridinfo_free_values( gi, quant->values,
+                                         quant->values_paged );
+                quant->values = NULL;
+                quant->max_error = HUGE_VAL;
+                pj_ctx_set_errno( ctx, saved_errno );
+            }
+
+            else if( ctx->stats != NULL )
+                pj_stats_add_grid_load( ctx->stats,
+                                        (double) sizeof(unsigned short)
+                                        * quant->components
+                                        * gi->ct->lim.lam * gi->ct->lim.phi,
+                                        pj_clock_ns() - start );
+
+            if( quant->values == NULL )
+                pj_log( ctx, PJ_LOG_DEBUG_MINOR,
+                        "Grid %s could not be quantized", gi->ct->id );
+            else if( quant->max_error > ctx->grid_quantize )
+            {
+                pj_log( ctx, PJ_LOG_DEBUG_MINOR,
+                        "Grid %s not quantized, error %.3g m over %.3g m",
+                        gi->ct->id, quant->max_error, ctx->grid_quantize );
+                pj_gridinfo_free_values( gi, quant->values,
+                                         quant->values_paged );
+                quant->values = NULL;
+            }
+            else
+                pj_log( ctx, PJ_LOG_DEBUG_MINOR,
+                        "Quantized grid %s, error up to %.3g m",
+                        gi->ct->id, quant->max_error );
+
+            gi->quant = quant;
+        }
+        pj_mutex_unlock( gi->lock );
+    }
+
+    quant = gi->quant;
+    if( quant == NULL || quant->values == NULL
+        || quant->max_error > ctx->grid_quantize )
+        return NULL;
+
+    return quant;
+}
+
+/************************************************************************/
+/*                         pj_grid_quant_rows()                         */
+/*                                                                      */
+/*      Unpack row_count rows of the quantized shifts of a grid,        */
+/*      starting at first_row, into cvs in the CTABLE layout.           */
+/************************************************************************/
+
+void pj_grid_quant_rows( PJ_GRIDINFO *gi, int first_row, int row_count,
+                         FLP *cvs )
+
+{
+    const PJ_GRID_QUANT *quant = gi->quant;
+    int cols = gi->ct->lim.lam, r, c;
+
+    for( r = 0; r < row_count; r++ )
+    {
+        int row = first_row + r;
+        const unsigned short *q = quant->values + (long) row * cols * 2;
+        int block = (row / PJ_GRID_QUANT_BLOCK) * quant->blocks_x;
+        FLP *out = cvs + (long) r * cols;
+
+        for( c = 0; c < cols; c += PJ_GRID_QUANT_BLOCK, block++ )
+        {
+            double off_lam = quant->offset[block * 2];
+            double off_phi = quant->offset[block * 2 + 1];
+            double sc_lam = quant->scale[block * 2];
+            double sc_phi = quant->scale[block * 2 + 1];
+            int    end = c + PJ_GRID_QUANT_BLOCK < cols
+                ? c + PJ_GRID_QUANT_BLOCK : cols;
+            int    i;
+
+            for( i = c; i < end; i++ )
+            {
+                out[i].lam = (float) (off_lam + q[2*i] * sc_lam);
+                out[i].phi = (float) (off_phi + q[2*i+1] * sc_phi);
+            }
+        }
+    }
+}
+
+/************************************************************************/
+/*                        pj_grid_quant_height()                        */
+/*                                                                      */
+/*      The quantized height of one node of a gtx grid, as the float    */
+/*      of the plain table.                                             */
+/************************************************************************/
+
+float pj_grid_quant_height( PJ_GRIDINFO *gi, int col, int row )
+
+{
+    const PJ_GRID_QUANT *quant = gi->quant;
+    unsigned short q = quant->values[(long) row * gi->ct->lim.lam + col];
+    int block = (row / PJ_GRID_QUANT_BLOCK) * quant->blocks_x
+        + col / PJ_GRID_QUANT_BLOCK;
+
+    if( q == PJ_GRID_QUANT_NODATA )
+        return QUANT_NODATA;
+
+    return (float) (quant->offset[block] + q * quant->scale[block]);
+}
@@ -0,0 +1,183 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Grid values shared between the processes of a host through
+ *           named shared memory segments.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <projects.h>
+#include <string.h>
+#include <stdio.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** Grids whose values cannot be mapped from their file, as they are
+** converted, byte swapped or decompressed on loading, would otherwise be
+** held privately by every process using them.  With pj_ctx_set_grid_shm()
+** the first process loading such a grid copies its values into a shared
+** memory segment, see pj_shm.c, and the others map them from there
+** read-only, as if mapped from a file.
+**
+** A segment is keyed by the identity of the grid file (device, inode,
+** size and time of last change, so only files of the default file api
+** are shared), the place of the grid in it, and the layout of the
+** values, so a changed file gets a new segment.
+*/
+
+/************************************************************************/
+/*                          pj_grid_shm_key()                           */
+/*                                                                      */
+/*      The key of the segment of the grid.  Returns FALSE for grids    */
+/*      whose file cannot be told apart from others.                    */
+/************************************************************************/
+
+static int pj_grid_shm_key( projCtx ctx, PJ_GRIDINFO *gi, char *key )
+
+{
+    double id[4];
+    PAFile fid;
+    int known;
+
+    if( strlen( gi->filename ) > PJ_SHM_KEY_MAX - 200 )
+        return 0;
+
+    fid = pj_open_lib( ctx, gi->filename, "rb" );
+    if( fid == NULL )
+        return 0;
+    known = pj_ctx_fidentity( ctx, fid, id );
+    pj_ctx_fclose( ctx, fid );
+    if( !known )
+        return 0;
+
+    sprintf( key, "grid|%.0f|%.0f|%.0f|%.0f|%d|%s|%d|%d|%.40s|%d|%s",
+             id[0], id[1], id[2], id[3],
+             gi->grid_offset, gi->format, gi->ct->lim.lam, gi->ct->lim.phi,
+             gi->ct->id, (int) sizeof(FLP), gi->filename );
+
+    return 1;
+}
+
+/************************************************************************/
+/*                          pj_grid_shm_size()                          */
+/************************************************************************/
+
+static size_t pj_grid_shm_size( PJ_GRIDINFO *gi )
+
+{
+    return (size_t) gi->ct->lim.lam * gi->ct->lim.phi
+        * (pj_gridinfo_heights( gi ) ? sizeof(float) : sizeof(FLP));
+}
+
+/************************************************************************/
+/*                           pj_grid_shm_use()                          */
+/************************************************************************/
+
+static void pj_grid_shm_use( projCtx ctx, PJ_GRIDINFO *gi, PJ_SHM *shm )
+
+{
+    pj_log( ctx, PJ_LOG_DEBUG_MINOR, "Shared %.0f bytes of grid %s in %s",
+            (double) pj_shm_size( shm ), gi->gridname,
+            pj_shm_get_name( shm ) );
+
+    gi->unmap = pj_shm_release;
+    gi->map_handle = shm;
+    gi->ct->cvs = (FLP *) pj_shm_data( shm );
+}
+
+/************************************************************************/
+/*                         pj_grid_shm_usable()                         */
+/*                                                                      */
+/*      Would the values of the grid be shared if loaded with ctx?      */
+/************************************************************************/
+
+int pj_grid_shm_usable( projCtx ctx, PJ_GRIDINFO *gi )
+
+{
+    return ctx->grid_shm && pj_shm_supported()
+        && gi->ct != NULL && gi->filename != NULL
+        && ctx->fileapi == pj_get_default_fileapi()
+        && !pj_network_is_url( gi->filename );
+}
+
+/************************************************************************/
+/*                         pj_grid_shm_attach()                         */
+/*                                                                      */
+/*      Map the values of a grid not loaded yet from the segment of     */
+/*      another process.  Returns FALSE if there is none complete,      */
+/*      for the grid to be loaded as usual.                             */
+/************************************************************************/
+
+int pj_grid_shm_attach( projCtx ctx, PJ_GRIDINFO *gi )
+
+{
+    char key[PJ_SHM_KEY_MAX];
+    PJ_SHM *shm;
+
+    if( !pj_grid_shm_usable( ctx, gi ) || !pj_grid_shm_key( ctx, gi, key )
+        || (shm = pj_shm_attach( "grid", key )) == NULL )
+        return 0;
+
+    if( pj_shm_size( shm ) != pj_grid_shm_size( gi ) )
+    {
+        pj_shm_release( shm );
+        return 0;
+    }
+
+    pj_grid_shm_use( ctx, gi, shm );
+    return 1;
+}
+
+/************************************************************************/
+/*                        pj_grid_shm_publish()                         */
+/*                                                                      */
+/*      Copy the values just loaded privately into a new segment for    */
+/*      the other processes, and use them from there, freeing the       */
+/*      private ones.  Nothing is done if another process made the      */
+/*      segment meanwhile, or if it cannot be made.                     */
+/************************************************************************/
+
+void pj_grid_shm_publish( projCtx ctx, PJ_GRIDINFO *gi )
+
+{
+    char key[PJ_SHM_KEY_MAX];
+    size_t size;
+    PJ_SHM *shm;
+
+    if( gi->ct->cvs == NULL || gi->map_handle != NULL
+        || !pj_grid_shm_usable( ctx, gi ) || !pj_grid_shm_key( ctx, gi, key ) )
+        return;
+
+    size = pj_grid_shm_size( gi );
+    if( (shm = pj_shm_create( "grid", key, size )) == NULL )
+        return;
+
+    memcpy( pj_shm_data( shm ), gi->ct->cvs, size );
+    pj_shm_ready( shm );
+
+    pj_gridinfo_free_values( gi, gi->ct->cvs, gi->values_paged );
+    gi->values_paged = 0;
+    pj_grid_shm_use( ctx, gi, shm );
+}
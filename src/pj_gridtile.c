@@ -0,0 +1,212 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Per context cache of grid value tiles, so that large grids are
+ *           only read for the rows actually used.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <string.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** Tiles belong to a single context, so no locking is needed except to
+** hand out the serial numbers of the shared grids.  The serial makes sure
+** that a grid freed and reallocated at the same address does not pick up
+** stale tiles from contexts that never saw it freed.
+*/
+static int last_tile_serial = 0;
+
+/************************************************************************/
+/*                        pj_grid_tile_destroy()                        */
+/************************************************************************/
+
+static void pj_grid_tile_destroy( projCtx ctx, PJ_GRID_TILE *tile )
+
+{
+    pj_ctx_dalloc( ctx, tile->cvs );
+    pj_ctx_dalloc( ctx, tile );
+}
+
+/************************************************************************/
+/*                          pj_grid_tile_row()                          */
+/*                                                                      */
+/*      Return the values of one row of a grid, reading the tile        */
+/*      holding it if it is not resident.  The pointer stays valid      */
+/*      until the next call for this context.  Returns NULL on          */
+/*      read failure.                                                   */
+/************************************************************************/
+
+FLP *pj_grid_tile_row( projCtx ctx, PJ_GRIDINFO *gi, int row )
+
+{
+    PJ_GRID_TILE *tile, *prev = NULL;
+    struct CTABLE *ct = gi->ct;
+    int first_row;
+    PAFile fid;
+    double start = 0.0;
+
+    if( row < 0 || row >= ct->lim.phi )
+        return NULL;
+
+    if( gi->tile_serial == 0 )
+    {
+        pj_acquire_lock();
+        if( gi->tile_serial == 0 )
+            gi->tile_serial = ++last_tile_serial;
+        pj_release_lock();
+    }
+
+    first_row = row - row % PJ_GRID_TILE_ROWS;
+
+/* -------------------------------------------------------------------- */
+/*      Look for a resident tile, moving it to the front of the list.   */
+/* -------------------------------------------------------------------- */
+    for( tile = ctx->grid_tiles; tile != NULL; prev = tile, tile = tile->next )
+    {
+        if( tile->gi == gi && tile->serial == gi->tile_serial
+            && tile->first_row == first_row )
+        {
+            if( prev != NULL )
+            {
+                prev->next = tile->next;
+                tile->next = ctx->grid_tiles;
+                ctx->grid_tiles = tile;
+            }
+            return tile->cvs + (row - first_row) * ct->lim.lam;
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Evict the least recently used tile if we are at the limit.      */
+/*      The most recently used one is kept, as nad_intr_tiled() may     */
+/*      still be holding a row of it.                                   */
+/* -------------------------------------------------------------------- */
+    if( ctx->grid_tile_count >= ctx->grid_tile_limit
+        && ctx->grid_tile_count > 1 )
+    {
+        prev = ctx->grid_tiles;
+        while( prev->next->next != NULL )
+            prev = prev->next;
+
+        pj_grid_tile_destroy( ctx, prev->next );
+        prev->next = NULL;
+        ctx->grid_tile_count--;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Read the new tile, or unpack it from the quantized values.      */
+/* -------------------------------------------------------------------- */
+    tile = (PJ_GRID_TILE *) pj_ctx_malloc(ctx, sizeof(PJ_GRID_TILE));
+    if( tile == NULL )
+    {
+        pj_ctx_set_errno( ctx, -38 );
+        return NULL;
+    }
+
+    tile->gi = gi;
+    tile->serial = gi->tile_serial;
+    tile->first_row = first_row;
+    tile->row_count = ct->lim.phi - first_row;
+    if( tile->row_count > PJ_GRID_TILE_ROWS )
+        tile->row_count = PJ_GRID_TILE_ROWS;
+    tile->cvs = (FLP *)
+        pj_ctx_malloc(ctx, sizeof(FLP) * ct->lim.lam * tile->row_count);
+
+    if( tile->cvs != NULL && pj_gridinfo_quantized( ctx, gi ) != NULL )
+    {
+        pj_grid_quant_rows( gi, first_row, tile->row_count, tile->cvs );
+
+        tile->next = ctx->grid_tiles;
+        ctx->grid_tiles = tile;
+        ctx->grid_tile_count++;
+
+        return tile->cvs + (row - first_row) * ct->lim.lam;
+    }
+
+    if( ctx->stats != NULL )
+        start = pj_clock_ns();
+
+    fid = pj_open_lib( ctx, gi->filename, "rb" );
+
+    if( tile->cvs == NULL || fid == NULL
+        || !pj_gridinfo_load_rows( ctx, gi, fid, first_row, tile->row_count,
+                                   tile->cvs ) )
+    {
+        if( fid != NULL )
+            pj_ctx_fclose( ctx, fid );
+        pj_grid_tile_destroy( ctx, tile );
+        pj_ctx_set_errno( ctx, -38 );
+        return NULL;
+    }
+
+    pj_ctx_fclose( ctx, fid );
+
+    if( ctx->stats != NULL )
+        pj_stats_add_grid_load( ctx->stats,
+                                (double) sizeof(FLP) * ct->lim.lam
+                                * tile->row_count,
+                                pj_clock_ns() - start );
+
+    pj_log( ctx, PJ_LOG_DEBUG_MINOR,
+            "Loaded rows %d to %d of grid %s",
+            first_row, first_row + tile->row_count - 1, gi->ct->id );
+
+    tile->next = ctx->grid_tiles;
+    ctx->grid_tiles = tile;
+    ctx->grid_tile_count++;
+
+    return tile->cvs + (row - first_row) * ct->lim.lam;
+}
+
+/************************************************************************/
+/*                         pj_grid_tiles_free()                         */
+/*                                                                      */
+/*      Release the tiles of the context for one grid, or all of        */
+/*      them if gi is NULL.                                             */
+/************************************************************************/
+
+void pj_grid_tiles_free( projCtx ctx, PJ_GRIDINFO *gi )
+
+{
+    PJ_GRID_TILE **link = &(ctx->grid_tiles);
+
+    while( *link != NULL )
+    {
+        PJ_GRID_TILE *tile = *link;
+
+        if( gi == NULL || tile->gi == gi )
+        {
+            *link = tile->next;
+            pj_grid_tile_destroy( ctx, tile );
+            ctx->grid_tile_count--;
+        }
+        else
+            link = &(tile->next);
+    }
+}
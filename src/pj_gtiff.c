@@ -0,0 +1,1412 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Reading of horizontal and vertical shift grids in GeoTIFF,
+ *           tiled or in strips, uncompressed or deflate or LZW compressed.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** Each image of the file (IFD) holding float samples is a grid, a
+** subgrid of the one named by its parent_grid_name GDAL metadata item
+** if any.  Horizontal grids have latitude_offset and longitude_offset
+** samples, in arc seconds unless the metadata says otherwise and with
+** longitudes positive east unless positive_value says west.  Vertical
+** grids have a single height sample in metres.  Nodes are taken at the
+** tie point if GTRasterTypeGeoKey is PixelIsPoint, at the centre of the
+** pixels otherwise.  Nodes of the GDAL_NODATA value do not shift, or
+** have the nodata height of gtx grids.
+**
+** Only the TIFF tiles (or strips) holding the rows asked for by
+** pj_gridinfo_load_rows() are read and decoded, so large grids are read
+** a band of rows at a time through pj_grid_tile_row() like the other
+** row oriented formats.  Classic TIFF only; BigTIFF is refused.
+*/
+
+#define TIFFTAG_SUBFILETYPE       254
+#define TIFFTAG_IMAGEWIDTH        256
+#define TIFFTAG_IMAGELENGTH       257
+#define TIFFTAG_BITSPERSAMPLE     258
+#define TIFFTAG_COMPRESSION       259
+#define TIFFTAG_STRIPOFFSETS      273
+#define TIFFTAG_SAMPLESPERPIXEL   277
+#define TIFFTAG_ROWSPERSTRIP      278
+#define TIFFTAG_STRIPBYTECOUNTS   279
+#define TIFFTAG_PLANARCONFIG      284
+#define TIFFTAG_PREDICTOR         317
+#define TIFFTAG_TILEWIDTH         322
+#define TIFFTAG_TILELENGTH        323
+#define TIFFTAG_TILEOFFSETS       324
+#define TIFFTAG_TILEBYTECOUNTS    325
+#define TIFFTAG_SAMPLEFORMAT      339
+#define TIFFTAG_MODELPIXELSCALE   33550
+#define TIFFTAG_MODELTIEPOINT     33922
+#define TIFFTAG_GEOKEYDIRECTORY   34735
+#define TIFFTAG_GDAL_METADATA     42112
+#define TIFFTAG_GDAL_NODATA       42113
+
+#define GTRasterTypeGeoKey        1025
+#define RasterPixelIsPoint        2
+
+#define GTIFF_MAX_IFDS            10000
+#define GTIFF_NODATA              -88.88880f   /* as in gtx grids */
+
+typedef struct PJ_GTIFF_t {
+    int    big_endian;
+    int    width, height;
+    int    samples;             /* per pixel */
+    int    planar;              /* 1 interleaved, 2 a plane per sample */
+    int    compression;         /* 1 none, 5 LZW, 8 deflate */
+    int    predictor;           /* 1 none, 2 horizontal, 3 floating point */
+    int    tiled;               /* or in strips, tiles of full rows */
+    int    tile_width, tile_height;
+    int    tiles_across, tiles_down;
+    int    tile_count;          /* of all the planes */
+    projFileOffset *offsets;
+    unsigned long  *byte_counts;
+    int    sample[2];           /* latitude and longitude, or height */
+    double factor[2];           /* to radians positive west, or metres */
+    double offset[2];
+    int    has_nodata;
+    double nodata;
+} PJ_GTIFF;
+
+static int  byte_order_test = 1;
+#define IS_LSB	(((unsigned char *) (&byte_order_test))[0] == 1)
+
+/************************************************************************/
+/* ==================================================================== */
+/*      Deflate decoding, after RFC 1950 and 1951.                      */
+/* ==================================================================== */
+/************************************************************************/
+
+typedef struct {
+    const unsigned char *in;
+    size_t in_len, in_pos;
+    unsigned char *out;
+    size_t out_len, out_pos;
+    unsigned long bit_buf;
+    int    bit_count;
+    int    error;
+} GTIFF_INFLATE;
+
+typedef struct {
+    short count[16];            /* codes of each length */
+    short symbol[288];          /* symbols by code */
+} GTIFF_HUFFMAN;
+
+static const short inflate_len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const short inflate_len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const short inflate_dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577 };
+static const short inflate_dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static int inflate_bits( GTIFF_INFLATE *s, int need )
+
+{
+    unsigned long value = s->bit_buf;
+
+    while( s->bit_count < need )
+    {
+        if( s->in_pos == s->in_len )
+        {
+            s->error = 1;
+            return 0;
+        }
+        value |= (unsigned long) s->in[s->in_pos++] << s->bit_count;
+        s->bit_count += 8;
+    }
+
+    s->bit_buf = value >> need;
+    s->bit_count -= need;
+
+    return (int) (value & ((1UL << need) - 1));
+}
+
+/* canonical codes of the given lengths, FALSE if over subscribed */
+static int inflate_build( GTIFF_HUFFMAN *h, const short *length, int n )
+
+{
+    short offs[16];
+    int   len, symbol, left = 1;
+
+    memset( h->count, 0, sizeof(h->count) );
+    for( symbol = 0; symbol < n; symbol++ )
+        h->count[length[symbol]]++;
+
+    for( len = 1; len < 16; len++ )
+    {
+        left = (left << 1) - h->count[len];
+        if( left < 0 )
+            return 0;
+    }
+
+    offs[1] = 0;
+    for( len = 1; len < 15; len++ )
+        offs[len + 1] = offs[len] + h->count[len];
+    for( symbol = 0; symbol < n; symbol++ )
+        if( length[symbol] != 0 )
+            h->symbol[offs[length[symbol]]++] = (short) symbol;
+
+    return 1;
+}
+
+static int inflate_decode( GTIFF_INFLATE *s, const GTIFF_HUFFMAN *h )
+
+{
+    int code = 0, first = 0, index = 0, len;
+
+    for( len = 1; len < 16; len++ )
+    {
+        int count = h->count[len];
+
+        code |= inflate_bits( s, 1 );
+        if( s->error )
+            return -1;
+        if( code - count < first )
+            return h->symbol[index + (code - first)];
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+
+    return -1;
+}
+
+static int inflate_codes( GTIFF_INFLATE *s, const GTIFF_HUFFMAN *lencode,
+                          const GTIFF_HUFFMAN *distcode )
+
+{
+    int symbol;
+
+    for( ; ; )
+    {
+        size_t len, dist;
+
+        symbol = inflate_decode( s, lencode );
+        if( symbol < 0 )
+            return 0;
+        if( symbol == 256 )
+            return 1;
+
+        if( symbol < 256 )
+        {
+            if( s->out_pos == s->out_len )
+                return 0;
+            s->out[s->out_pos++] = (unsigned char) symbol;
+            continue;
+        }
+
+        symbol -= 257;
+        if( symbol >= 29 )
+            return 0;
+        len = inflate_len_base[symbol]
+            + inflate_bits( s, inflate_len_extra[symbol] );
+
+        symbol = inflate_decode( s, distcode );
+        if( symbol < 0 || symbol >= 30 )
+            return 0;
+        dist = inflate_dist_base[symbol]
+            + inflate_bits( s, inflate_dist_extra[symbol] );
+
+        if( s->error || dist > s->out_pos || len > s->out_len - s->out_pos )
+            return 0;
+        for( ; len > 0; len--, s->out_pos++ )
+            s->out[s->out_pos] = s->out[s->out_pos - dist];
+    }
+}
+
+static int inflate_stored( GTIFF_INFLATE *s )
+
+{
+    size_t len;
+
+    s->bit_buf = 0;
+    s->bit_count = 0;
+
+    if( s->in_len - s->in_pos < 4 )
+        return 0;
+    len = s->in[s->in_pos] | (s->in[s->in_pos + 1] << 8);
+    if( (s->in[s->in_pos + 2] ^ 0xff) != (len & 0xff)
+        || (s->in[s->in_pos + 3] ^ 0xff) != (len >> 8) )
+        return 0;
+    s->in_pos += 4;
+
+    if( len > s->in_len - s->in_pos || len > s->out_len - s->out_pos )
+        return 0;
+    memcpy( s->out + s->out_pos, s->in + s->in_pos, len );
+    s->in_pos += len;
+    s->out_pos += len;
+
+    return 1;
+}
+
+static int inflate_fixed( GTIFF_INFLATE *s )
+
+{
+    GTIFF_HUFFMAN lencode, distcode;
+    short lengths[288];
+    int   i;
+
+    for( i = 0; i < 144; i++ )
+        lengths[i] = 8;
+    for( ; i < 256; i++ )
+        lengths[i] = 9;
+    for( ; i < 280; i++ )
+        lengths[i] = 7;
+    for( ; i < 288; i++ )
+        lengths[i] = 8;
+    inflate_build( &lencode, lengths, 288 );
+
+    for( i = 0; i < 30; i++ )
+        lengths[i] = 5;
+    inflate_build( &distcode, lengths, 30 );
+
+    return inflate_codes( s, &lencode, &distcode );
+}
+
+static int inflate_dynamic( GTIFF_INFLATE *s )
+
+{
+    static const short order[19] =
+        { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    GTIFF_HUFFMAN lencode, distcode;
+    short lengths[320];
+    int   nlen, ndist, ncode, index;
+
+    nlen = inflate_bits( s, 5 ) + 257;
+    ndist = inflate_bits( s, 5 ) + 1;
+    ncode = inflate_bits( s, 4 ) + 4;
+    if( s->error || nlen > 286 || ndist > 30 )
+        return 0;
+
+    for( index = 0; index < ncode; index++ )
+        lengths[order[index]] = (short) inflate_bits( s, 3 );
+    for( ; index < 19; index++ )
+        lengths[order[index]] = 0;
+    if( s->error || !inflate_build( &lencode, lengths, 19 ) )
+        return 0;
+
+    for( index = 0; index < nlen + ndist; )
+    {
+        int symbol = inflate_decode( s, &lencode ), len = 0, repeat;
+
+        if( symbol < 0 )
+            return 0;
+        if( symbol < 16 )
+        {
+            lengths[index++] = (short) symbol;
+            continue;
+        }
+
+        if( symbol == 16 )
+        {
+            if( index == 0 )
+                return 0;
+            len = lengths[index - 1];
+            repeat = 3 + inflate_bits( s, 2 );
+        }
+        else if( symbol == 17 )
+            repeat = 3 + inflate_bits( s, 3 );
+        else
+            repeat = 11 + inflate_bits( s, 7 );
+
+        if( s->error || index + repeat > nlen + ndist )
+            return 0;
+        while( repeat-- > 0 )
+            lengths[index++] = (short) len;
+    }
+
+    if( lengths[256] == 0
+        || !inflate_build( &lencode, lengths, nlen )
+        || !inflate_build( &distcode, lengths + nlen, ndist ) )
+        return 0;
+
+    return inflate_codes( s, &lencode, &distcode );
+}
+
+/************************************************************************/
+/*                           gtiff_inflate()                            */
+/*                                                                      */
+/*      Decode a zlib stream into exactly out_len bytes.                */
+/************************************************************************/
+
+static int gtiff_inflate( const unsigned char *in, size_t in_len,
+                          unsigned char *out, size_t out_len )
+
+{
+    GTIFF_INFLATE s;
+    int last;
+
+    if( in_len < 2 || (in[0] & 0x0f) != 8 || (in[0] << 8 | in[1]) % 31 != 0
+        || (in[1] & 0x20) != 0 )
+        return 0;
+
+    memset( &s, 0, sizeof(s) );
+    s.in = in;
+    s.in_len = in_len;
+    s.in_pos = 2;
+    s.out = out;
+    s.out_len = out_len;
+
+    do
+    {
+        int type, ok;
+
+        last = inflate_bits( &s, 1 );
+        type = inflate_bits( &s, 2 );
+        if( s.error )
+            return 0;
+
+        if( type == 0 )
+            ok = inflate_stored( &s );
+        else if( type == 1 )
+            ok = inflate_fixed( &s );
+        else if( type == 2 )
+            ok = inflate_dynamic( &s );
+        else
+            ok = 0;
+
+        if( !ok || s.error )
+            return 0;
+    } while( !last );
+
+    return s.out_pos == out_len;
+}
+
+/************************************************************************/
+/*                             gtiff_lzw()                              */
+/*                                                                      */
+/*      Decode a TIFF LZW strip or tile into exactly out_len bytes.     */
+/*      Codes are read MSB first, and widen one code early, as          */
+/*      libtiff writes them.                                            */
+/************************************************************************/
+
+static int gtiff_lzw( const unsigned char *in, size_t in_len,
+                      unsigned char *out, size_t out_len )
+
+{
+    unsigned short prefix[4096], length[4096];
+    unsigned char  suffix[4096], first[4096];
+    size_t in_pos = 0, out_pos = 0;
+    unsigned long bit_buf = 0;
+    int    bit_count = 0, bits = 9, next = 258, old = -1, i;
+
+    for( i = 0; i < 256; i++ )
+    {
+        suffix[i] = first[i] = (unsigned char) i;
+        length[i] = 1;
+        prefix[i] = 0;
+    }
+
+    for( ; ; )
+    {
+        int code, k, len;
+
+        while( bit_count < bits && in_pos < in_len )
+        {
+            bit_buf = ((bit_buf << 8) | in[in_pos++]) & 0xffffffUL;
+            bit_count += 8;
+        }
+        if( bit_count < bits )
+            break;
+        code = (int) ((bit_buf >> (bit_count - bits)) & ((1 << bits) - 1));
+        bit_count -= bits;
+
+        if( code == 257 )
+            break;
+        if( code == 256 )
+        {
+            next = 258;
+            bits = 9;
+            old = -1;
+            continue;
+        }
+
+        if( old == -1 )
+        {
+            if( code > 255 || out_pos == out_len )
+                return 0;
+            out[out_pos++] = (unsigned char) code;
+            old = code;
+            continue;
+        }
+
+        /* a code not yet in the table is the old string and its head */
+        if( code > next || (code == next && next == 4096) )
+            return 0;
+        k = code == next ? old : code;
+        len = length[k];
+        if( (size_t) len + (code == next) > out_len - out_pos )
+            return 0;
+        for( i = len - 1; i >= 0; i-- )
+        {
+            out[out_pos + i] = suffix[k];
+            k = prefix[k];
+        }
+        if( code == next )
+            out[out_pos + len] = first[old];
+        out_pos += len + (code == next);
+
+        if( next < 4096 )
+        {
+            prefix[next] = (unsigned short) old;
+            first[next] = first[old];
+            suffix[next] = code == next ? first[old] : first[code];
+            length[next] = (unsigned short) (length[old] + 1);
+            next++;
+            if( next >= (1 << bits) - 1 && bits < 12 )
+                bits++;
+        }
+
+        old = code;
+    }
+
+    return out_pos == out_len;
+}
+
+/************************************************************************/
+/* ==================================================================== */
+/*      The TIFF structure.                                             */
+/* ==================================================================== */
+/************************************************************************/
+
+static unsigned long gtiff_get( const PJ_GTIFF *g, const unsigned char *p,
+                                int size )
+
+{
+    unsigned long value = 0;
+    int i;
+
+    for( i = 0; i < size; i++ )
+        value |= (unsigned long) p[g->big_endian ? size - 1 - i : i] << (8*i);
+
+    return value;
+}
+
+static int gtiff_type_size( int type )
+
+{
+    switch( type )
+    {
+      case 1: case 2: case 6: case 7: return 1;
+      case 3: case 8: return 2;
+      case 4: case 9: case 11: return 4;
+      case 5: case 10: case 12: return 8;
+      default: return 0;
+    }
+}
+
+/************************************************************************/
+/*                           gtiff_tag_data()                           */
+/*                                                                      */
+/*      The bytes of the values of an IFD entry, allocated and nul      */
+/*      terminated, with their count and type.  NULL if they cannot     */
+/*      be read.                                                        */
+/************************************************************************/
+
+static unsigned char *gtiff_tag_data( projCtx ctx, PAFile fid,
+                                      const PJ_GTIFF *g,
+                                      const unsigned char *entry,
+                                      unsigned long *count, int *type )
+
+{
+    unsigned char *data;
+    size_t size;
+
+    *type = (int) gtiff_get( g, entry + 2, 2 );
+    *count = gtiff_get( g, entry + 4, 4 );
+    if( gtiff_type_size( *type ) == 0 || *count == 0
+        || *count > 100000000UL )
+        return NULL;
+
+    size = (size_t) *count * gtiff_type_size( *type );
+    data = (unsigned char *) pj_malloc( size + 1 );
+    if( data == NULL )
+        return NULL;
+
+    if( size <= 4 )
+        memcpy( data, entry + 8, size );
+    else if( pj_ctx_fread_at( ctx, fid, data, size,
+                              (projFileOffset) gtiff_get( g, entry + 8, 4 ) )
+             != size )
+    {
+        pj_dalloc( data );
+        return NULL;
+    }
+    data[size] = '\0';
+
+    return data;
+}
+
+/* value i of the numeric data of an entry, as a double */
+static double gtiff_number( const PJ_GTIFF *g, const unsigned char *data,
+                            int type, unsigned long i )
+
+{
+    const unsigned char *p = data + i * gtiff_type_size( type );
+    unsigned char native[8];
+    int k, size = gtiff_type_size( type );
+
+    switch( type )
+    {
+      case 1: 
+        return p[0];
+      case 3: case 4:
+        return (double) gtiff_get( g, p, size );
+      case 5:
+        return gtiff_get( g, p + 4, 4 ) == 0 ? 0.0
+            : (double) gtiff_get( g, p, 4 ) / gtiff_get( g, p + 4, 4 );
+      case 11: case 12:
+        for( k = 0; k < size; k++ )
+            native[k] = p[g->big_endian == IS_LSB ? size - 1 - k : k];
+        if( size == 4 )
+        {
+            float f;
+            memcpy( &f, native, 4 );
+            return f;
+        }
+        else
+        {
+            double d;
+            memcpy( &d, native, 8 );
+            return d;
+        }
+      default:
+        return 0.0;
+    }
+}
+
+/************************************************************************/
+/*                        gtiff_metadata_item()                         */
+/*                                                                      */
+/*      Copy into value the text of the GDAL metadata item of that      */
+/*      name, of the given sample or of the image if sample is -1.      */
+/*      Returns FALSE if there is none.                                 */
+/************************************************************************/
+
+static int gtiff_metadata_item( const char *xml, const char *name,
+                                int sample, char *value, int size )
+
+{
+    char key[80];
+    const char *p;
+
+    if( xml == NULL )
+        return 0;
+
+    sprintf( key, "name=\"%.60s\"", name );
+    for( p = strstr( xml, key ); p != NULL; p = strstr( p + 1, key ) )
+    {
+        const char *tag = p, *start = strchr( p, '>' ), *end, *attr;
+        int n;
+
+        while( tag > xml && *tag != '<' )
+            tag--;
+        if( start == NULL )
+            return 0;
+
+        attr = strstr( tag, "sample=\"" );
+        if( attr != NULL && attr > start )
+            attr = NULL;
+        if( (attr == NULL) != (sample < 0)
+            || (attr != NULL && atoi( attr + 8 ) != sample) )
+            continue;
+
+        start++;
+        end = strstr( start, "</Item>" );
+        if( end == NULL )
+            return 0;
+        n = end - start < size - 1 ? (int) (end - start) : size - 1;
+        memcpy( value, start, n );
+        value[n] = '\0';
+        return 1;
+    }
+
+    return 0;
+}
+
+/* the sample of that DESCRIPTION, or -1 */
+static int gtiff_find_sample( const char *xml, int samples,
+                              const char *description )
+
+{
+    char value[80];
+    int  s;
+
+    for( s = 0; s < samples; s++ )
+        if( gtiff_metadata_item( xml, "DESCRIPTION", s, value, sizeof(value) )
+            && strcmp( value, description ) == 0 )
+            return s;
+
+    return -1;
+}
+
+/************************************************************************/
+/*                         gtiff_sample_scale()                         */
+/*                                                                      */
+/*      Set the factor and offset bringing the values of a sample to    */
+/*      radians or metres, from its SCALE, OFFSET and UNITTYPE          */
+/*      metadata.  Returns FALSE for an unknown unit.                   */
+/************************************************************************/
+
+static int gtiff_sample_scale( PJ_GTIFF *g, const char *xml, int i,
+                               int vertical )
+
+{
+    char   value[80];
+    double unit;
+    int    s = g->sample[i];
+
+    if( !gtiff_metadata_item( xml, "UNITTYPE", s, value, sizeof(value) ) )
+        unit = vertical ? 1.0 : (PI/180.0) / 3600.0;
+    else if( strcmp( value, "arc-second" ) == 0 )
+        unit = (PI/180.0) / 3600.0;
+    else if( strcmp( value, "degree" ) == 0 )
+        unit = PI/180.0;
+    else if( strcmp( value, "radian" ) == 0 )
+        unit = 1.0;
+    else if( strcmp( value, "metre" ) == 0 )
+        unit = 1.0;
+    else
+        return 0;
+
+    g->factor[i] = unit;
+    g->offset[i] = 0.0;
+    if( gtiff_metadata_item( xml, "SCALE", s, value, sizeof(value) ) )
+        g->factor[i] *= pj_atof( value );
+    if( gtiff_metadata_item( xml, "OFFSET", s, value, sizeof(value) ) )
+        g->offset[i] = pj_atof( value ) * unit;
+
+    return 1;
+}
+
+/************************************************************************/
+/*                           pj_gtiff_free()                            */
+/************************************************************************/
+
+void pj_gtiff_free( PJ_GRIDINFO *gi )
+
+{
+    if( gi->gtiff == NULL )
+        return;
+
+    pj_dalloc( gi->gtiff->offsets );
+    pj_dalloc( gi->gtiff->byte_counts );
+    pj_dalloc( gi->gtiff );
+    gi->gtiff = NULL;
+}
+
+/************************************************************************/
+/*                           gtiff_read_ifd()                           */
+/*                                                                      */
+/*      Parse the entries of one IFD into g and ct, and the names of    */
+/*      the grid and its parent.  Returns 1 for a grid, 0 for an        */
+/*      image to skip, like an overview or a mask, and -1 with an       */
+/*      error logged for an image that cannot be read.                  */
+/************************************************************************/
+
+static int gtiff_read_ifd( projCtx ctx, PAFile fid, PJ_GTIFF *g,
+                           const unsigned char *entries, int entry_count,
+                           struct CTABLE *ct, char *parent, int *vertical )
+
+{
+    double  scale[3] = { 0, 0, 0 }, tie[6] = { 0, 0, 0, 0, 0, 0 };
+    unsigned char *offsets = NULL, *counts = NULL;
+    unsigned long offsets_count = 0, counts_count = 0;
+    int     offsets_type = 0, counts_type = 0;
+    int     bits = 0, sample_format = 1, subfile = 0, pixel_is_point = 0;
+    int     rows_per_strip = 0, i, result = -1;
+    char   *xml = NULL, value[80];
+    const char *problem = NULL;
+    double  west, north;
+
+    g->samples = 1;
+    g->planar = 1;
+    g->compression = 1;
+    g->predictor = 1;
+
+    for( i = 0; i < entry_count; i++ )
+    {
+        const unsigned char *entry = entries + 12 * i;
+        int     tag = (int) gtiff_get( g, entry, 2 ), type;
+        unsigned long count, k;
+        unsigned char *data;
+
+        data = gtiff_tag_data( ctx, fid, g, entry, &count, &type );
+        if( data == NULL )
+            continue;
+
+        switch( tag )
+        {
+          case TIFFTAG_STRIPOFFSETS: case TIFFTAG_TILEOFFSETS:
+            pj_dalloc( offsets );
+            offsets = data;
+            offsets_count = count;
+            offsets_type = type;
+            data = NULL;
+            break;
+          case TIFFTAG_STRIPBYTECOUNTS: case TIFFTAG_TILEBYTECOUNTS:
+            pj_dalloc( counts );
+            counts = data;
+            counts_count = count;
+            counts_type = type;
+            data = NULL;
+            break;
+          case TIFFTAG_GDAL_METADATA:
+            pj_dalloc( xml );
+            xml = (char *) data;
+            data = NULL;
+            break;
+          case TIFFTAG_GDAL_NODATA:
+            g->has_nodata = 1;
+            g->nodata = pj_atof( (const char *) data );
+            break;
+          case TIFFTAG_SUBFILETYPE:
+            subfile = (int) gtiff_number( g, data, type, 0 );
+            break;
+          case TIFFTAG_IMAGEWIDTH:
+            g->width = (int) gtiff_number( g, data, type, 0 );
+            break;
+          case TIFFTAG_IMAGELENGTH:
+            g->height = (int) gtiff_number( g, data, type, 0 );
+            break;
+          case TIFFTAG_BITSPERSAMPLE:
+            bits = (int) gtiff_number( g, data, type, 0 );
+            break;
+          case TIFFTAG_COMPRESSION:
+            g->compression = (int) gtiff_number( g, data, type, 0 );
+            break;
+          case TIFFTAG_SAMPLESPERPIXEL:
+            g->samples = (int) gtiff_number( g, data, type, 0 );
+            break;
+          case TIFFTAG_ROWSPERSTRIP:
+            rows_per_strip = (int) gtiff_number( g, data, type, 0 );
+            break;
+          case TIFFTAG_PLANARCONFIG:
+            g->planar = (int) gtiff_number( g, data, type, 0 );
+            break;
+          case TIFFTAG_PREDICTOR:
+            g->predictor = (int) gtiff_number( g, data, type, 0 );
+            break;
+          case TIFFTAG_TILEWIDTH:
+            g->tile_width = (int) gtiff_number( g, data, type, 0 );
+            break;
+          case TIFFTAG_TILELENGTH:
+            g->tile_height = (int) gtiff_number( g, data, type, 0 );
+            break;
+          case TIFFTAG_SAMPLEFORMAT:
+            sample_format = (int) gtiff_number( g, data, type, 0 );
+            break;
+          case TIFFTAG_MODELPIXELSCALE:
+            for( k = 0; k < 3 && k < count; k++ )
+                scale[k] = gtiff_number( g, data, type, k );
+            break;
+          case TIFFTAG_MODELTIEPOINT:
+            for( k = 0; k < 6 && k < count; k++ )
+                tie[k] = gtiff_number( g, data, type, k );
+            break;
+          case TIFFTAG_GEOKEYDIRECTORY:
+            for( k = 4; k + 3 < count; k += 4 )
+                if( (int) gtiff_number( g, data, type, k )
+                    == GTRasterTypeGeoKey )
+                    pixel_is_point = (int) gtiff_number( g, data, type, k+3 )
+                        == RasterPixelIsPoint;
+            break;
+        }
+
+        pj_dalloc( data );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Skip overviews and masks, and check the layout is one we read.  */
+/* -------------------------------------------------------------------- */
+    if( (subfile & 0x5) != 0 )
+    {
+        result = 0;
+        goto done;
+    }
+
+    g->tiled = g->tile_width > 0 && g->tile_height > 0;
+    if( g->tiled )
+    {
+        g->tiles_across = (g->width + g->tile_width - 1) / g->tile_width;
+    }
+    else
+    {
+        g->tile_width = g->width;
+        g->tile_height = rows_per_strip > 0 && rows_per_strip < g->height
+            ? rows_per_strip : g->height;
+        g->tiles_across = 1;
+    }
+
+    if( g->width < 1 || g->height < 1 || g->samples < 1 
+        || g->samples > 64 || g->tile_width < 1 || g->tile_height < 1 )
+        problem = "has an invalid size";
+    else if( bits != 32 || sample_format != 3 )
+        problem = "does not hold float samples";
+    else if( g->planar != 1 && g->planar != 2 )
+        problem = "has an unknown planar configuration";
+    else if( g->compression != 1 && g->compression != 5 
+             && g->compression != 8 && g->compression != 32946 )
+        problem = "is neither uncompressed, deflate nor LZW compressed";
+    else if( g->predictor < 1 || g->predictor > 3 )
+        problem = "has an unknown predictor";
+    else if( scale[0] <= 0.0 || scale[1] <= 0.0 )
+        problem = "has no pixel scale";
+
+    if( problem == NULL )
+    {
+        g->tiles_down = (g->height + g->tile_height - 1) / g->tile_height;
+        g->tile_count = g->tiles_across * g->tiles_down
+            * (g->planar == 2 ? g->samples : 1);
+
+        if( offsets == NULL || counts == NULL
+            || offsets_count < (unsigned long) g->tile_count 
+            || counts_count < (unsigned long) g->tile_count )
+            problem = "has missing tile offsets";
+    }
+
+    if( problem == NULL )
+    {
+        g->offsets = (projFileOffset *) 
+            pj_malloc( sizeof(projFileOffset) * g->tile_count );
+        g->byte_counts = (unsigned long *) 
+            pj_malloc( sizeof(unsigned long) * g->tile_count );
+        if( g->offsets == NULL || g->byte_counts == NULL )
+            problem = "is too large";
+    }
+
+    if( problem != NULL )
+    {
+        pj_log( ctx, PJ_LOG_ERROR, "GeoTIFF grid %s.", problem );
+        goto done;
+    }
+
+    for( i = 0; i < g->tile_count; i++ )
+    {
+        g->offsets[i] = (projFileOffset) 
+            gtiff_number( g, offsets, offsets_type, i );
+        g->byte_counts[i] = (unsigned long) 
+            gtiff_number( g, counts, counts_type, i );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Find the samples holding the shifts.  Without descriptions       */
+/*      a single sample is a height, and the first two latitude and     */
+/*      longitude offsets.                                              */
+/* -------------------------------------------------------------------- */
+    g->sample[0] = gtiff_find_sample( xml, g->samples, "latitude_offset" );
+    g->sample[1] = gtiff_find_sample( xml, g->samples, "longitude_offset" );
+
+    if( g->sample[0] >= 0 && g->sample[1] >= 0 )
+        *vertical = 0;
+    else if( (g->sample[0] = gtiff_find_sample( xml, g->samples, 
+                                                "geoid_undulation" )) >= 0
+             || (g->sample[0] = gtiff_find_sample( xml, g->samples, 
+                                                   "vertical_offset" )) >= 0 )
+        *vertical = 1;
+    else if( g->samples == 1 )
+    {
+        g->sample[0] = 0;
+        *vertical = 1;
+    }
+    else
+    {
+        g->sample[0] = 0;
+        g->sample[1] = 1;
+        *vertical = 0;
+    }
+
+    if( !gtiff_sample_scale( g, xml, 0, *vertical )
+        || (!*vertical && !gtiff_sample_scale( g, xml, 1, 0 )) )
+    {
+        pj_log( ctx, PJ_LOG_ERROR, "GeoTIFF grid has an unknown unit." );
+        goto done;
+    }
+
+    /* longitude offsets are positive east unless said otherwise, and
+       the CTABLE shifts are positive west */
+    if( !*vertical
+        && !(gtiff_metadata_item( xml, "positive_value", g->sample[1],
+                                  value, sizeof(value) )
+             && strcmp( value, "west" ) == 0) )
+    {
+        g->factor[1] = -g->factor[1];
+        g->offset[1] = -g->offset[1];
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Fill in the CTABLE, of nodes south to north.                    */
+/* -------------------------------------------------------------------- */
+    if( !gtiff_metadata_item( xml, "grid_name", -1, ct->id, MAX_TAB_ID ) )
+        strcpy( ct->id, "GeoTIFF Grid Shift File" );
+    if( !gtiff_metadata_item( xml, "parent_grid_name", -1, parent, 
+                              MAX_TAB_ID ) )
+        parent[0] = '\0';
+
+    west = tie[3] - tie[0] * scale[0];
+    north = tie[4] + tie[1] * scale[1];
+    if( !pixel_is_point )
+    {
+        west += scale[0] * 0.5;
+        north -= scale[1] * 0.5;
+    }
+
+    ct->ll.lam = west;
+    ct->ll.phi = north - (g->height - 1) * scale[1];
+    ct->del.lam = scale[0];
+    ct->del.phi = scale[1];
+    ct->lim.lam = g->width;
+    ct->lim.phi = g->height;
+    ct->cvs = NULL;
+
+    if( ct->ll.lam >= 180.0 )
+        ct->ll.lam -= 360.0;
+
+    pj_log( ctx, PJ_LOG_DEBUG_MINOR,
+            "GeoTIFF %s %dx%d: LL=(%.9g,%.9g) UR=(%.9g,%.9g)",
+            ct->id, ct->lim.lam, ct->lim.phi,
+            ct->ll.lam, ct->ll.phi,
+            ct->ll.lam + (ct->lim.lam-1) * ct->del.lam, north );
+
+    ct->ll.lam *= DEG_TO_RAD;
+    ct->ll.phi *= DEG_TO_RAD;
+    ct->del.lam *= DEG_TO_RAD;
+    ct->del.phi *= DEG_TO_RAD;
+
+    result = 1;
+
+  done:
+    pj_dalloc( offsets );
+    pj_dalloc( counts );
+    pj_dalloc( xml );
+
+    return result;
+}
+
+/************************************************************************/
+/*                           pj_gtiff_find()                            */
+/*                                                                      */
+/*      The first grid of that name of the tree, or NULL.               */
+/************************************************************************/
+
+static PJ_GRIDINFO *pj_gtiff_find( PJ_GRIDINFO *gi, const char *name )
+
+{
+    for( ; gi != NULL; gi = gi->next )
+    {
+        PJ_GRIDINFO *found;
+
+        if( gi->ct != NULL && strncmp( gi->ct->id, name, MAX_TAB_ID ) == 0 )
+            return gi;
+        if( (found = pj_gtiff_find( gi->child, name )) != NULL )
+            return found;
+    }
+
+    return NULL;
+}
+
+/************************************************************************/
+/*                       pj_gridinfo_init_gtiff()                       */
+/*                                                                      */
+/*      Load the headers of the grids of a GeoTIFF file, one for        */
+/*      each full resolution image.                                     */
+/************************************************************************/
+
+int pj_gridinfo_init_gtiff( projCtx ctx, PAFile fid, PJ_GRIDINFO *gilist )
+
+{
+    unsigned char header[8], count_buf[2], *entries;
+    PJ_GTIFF    probe, *g;
+    PJ_GRIDINFO *gi, *top_tail = gilist;
+    unsigned long ifd;
+    int         ifd_count, entry_count, vertical, result;
+    char        parent[MAX_TAB_ID];
+
+    if( pj_ctx_fread_at( ctx, fid, header, 8, 0 ) != 8 )
+    {
+        pj_ctx_set_errno( ctx, -38 );
+        return 0;
+    }
+
+    memset( &probe, 0, sizeof(probe) );
+    probe.big_endian = header[0] == 'M';
+    if( gtiff_get( &probe, header + 2, 2 ) != 42 )
+    {
+        pj_log( ctx, PJ_LOG_ERROR, 
+                "GeoTIFF grid %s is not a classic TIFF file.", 
+                gilist->gridname );
+        pj_ctx_set_errno( ctx, -38 );
+        return 0;
+    }
+
+    for( ifd = gtiff_get( &probe, header + 4, 4 ), ifd_count = 0; 
+         ifd != 0 && ifd_count < GTIFF_MAX_IFDS; ifd_count++ )
+    {
+        struct CTABLE *ct;
+
+        if( pj_ctx_fread_at( ctx, fid, count_buf, 2, 
+                             (projFileOffset) ifd ) != 2 )
+            break;
+        entry_count = (int) gtiff_get( &probe, count_buf, 2 );
+
+        entries = (unsigned char *) pj_malloc( 12 * entry_count + 4 );
+        if( entries == NULL
+            || pj_ctx_fread_at( ctx, fid, entries, 12 * entry_count + 4,
+                                (projFileOffset) ifd + 2 ) 
+               != (size_t) (12 * entry_count + 4) )
+        {
+            pj_dalloc( entries );
+            break;
+        }
+        ifd = gtiff_get( &probe, entries + 12 * entry_count, 4 );
+
+        g = (PJ_GTIFF *) pj_malloc( sizeof(PJ_GTIFF) );
+        ct = (struct CTABLE *) pj_malloc( sizeof(struct CTABLE) );
+        if( g == NULL || ct == NULL )
+        {
+            pj_dalloc( g );
+            pj_dalloc( ct );
+            pj_dalloc( entries );
+            break;
+        }
+        memcpy( g, &probe, sizeof(PJ_GTIFF) );
+
+        result = gtiff_read_ifd( ctx, fid, g, entries, entry_count, ct, 
+                                 parent, &vertical );
+        pj_dalloc( entries );
+
+        if( result <= 0 )
+        {
+            pj_dalloc( g->offsets );
+            pj_dalloc( g->byte_counts );
+            pj_dalloc( g );
+            pj_dalloc( ct );
+            if( result < 0 )
+                break;
+            continue;
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Create a new gridinfo for this if we aren't processing the      */
+/*      1st grid, and attach it under its parent if it names one we     */
+/*      have seen, at the top level otherwise.                          */
+/* -------------------------------------------------------------------- */
+        if( gilist->ct == NULL )
+            gi = gilist;
+        else
+        {
+            gi = (PJ_GRIDINFO *) pj_allocator_malloc( &(gilist->allocator),
+                                                      sizeof(PJ_GRIDINFO) );
+            memset( gi, 0, sizeof(PJ_GRIDINFO) );
+            gi->allocator = gilist->allocator;
+            gi->lock = pj_mutex_create( PJ_LOCK_GRID );
+
+            gi->gridname = pj_allocator_strdup( &(gi->allocator), 
+                                                gilist->gridname );
+            gi->filename = pj_allocator_strdup( &(gi->allocator), 
+                                                gilist->filename );
+            gi->next = NULL;
+        }
+
+        gi->ct = ct;
+        gi->gtiff = g;
+        gi->format = vertical ? "gtiff_heights" : "gtiff";
+
+        if( gi != gilist )
+        {
+            PJ_GRIDINFO *parent_gi = NULL;
+
+            if( parent[0] != '\0' )
+                parent_gi = pj_gtiff_find( gilist, parent );
+
+            if( parent_gi == NULL )
+            {
+                top_tail->next = gi;
+                top_tail = gi;
+            }
+            else if( parent_gi->child == NULL )
+                parent_gi->child = gi;
+            else
+            {
+                PJ_GRIDINFO *tail;
+
+                for( tail = parent_gi->child; tail->next != NULL; 
+                     tail = tail->next ) {}
+                tail->next = gi;
+            }
+        }
+    }
+
+    if( gilist->ct == NULL )
+    {
+        pj_log( ctx, PJ_LOG_ERROR, 
+                "GeoTIFF grid %s holds no readable grid.", 
+                gilist->gridname );
+        pj_ctx_set_errno( ctx, -38 );
+        return 0;
+    }
+
+    return 1;
+}
+
+/************************************************************************/
+/*                          gtiff_read_tile()                           */
+/*                                                                      */
+/*      Read and decode tile (or strip) number index, of rows rows,     */
+/*      into buf as native floats.                                      */
+/************************************************************************/
+
+static int gtiff_read_tile( projCtx ctx, PAFile fid, const PJ_GTIFF *g,
+                            int index, int rows, float *buf )
+
+{
+    int     stride = g->planar == 1 ? g->samples : 1;
+    size_t  row_words = (size_t) g->tile_width * stride;
+    size_t  size = row_words * rows * sizeof(float);
+    size_t  in_size = g->byte_counts[index];
+    unsigned char *in, *out = (unsigned char *) buf;
+    int     ok, r;
+
+    if( in_size == 0 || in_size > 4 * size + 65536 )
+        return 0;
+
+    in = (unsigned char *) pj_malloc( in_size );
+    if( in == NULL )
+        return 0;
+
+    if( pj_ctx_fread_at( ctx, fid, in, in_size, g->offsets[index] ) 
+        != in_size )
+        ok = 0;
+    else if( g->compression == 1 )
+    {
+        ok = in_size >= size;
+        if( ok )
+            memcpy( out, in, size );
+    }
+    else if( g->compression == 5 )
+        ok = gtiff_lzw( in, in_size, out, size );
+    else
+        ok = gtiff_inflate( in, in_size, out, size );
+
+    pj_dalloc( in );
+    if( !ok )
+        return 0;
+
+/* -------------------------------------------------------------------- */
+/*      The floating point predictor differences the bytes of each      */
+/*      row, most significant bytes of all the words first, leaving     */
+/*      the words in native order once undone.                          */
+/* -------------------------------------------------------------------- */
+    if( g->predictor == 3 )
+    {
+        size_t row_size = row_words * 4, i, w;
+        unsigned char *tmp = (unsigned char *) pj_malloc( row_size );
+
+        if( tmp == NULL )
+            return 0;
+
+        for( r = 0; r < rows; r++ )
+        {
+            unsigned char *row = out + r * row_size;
+
+            for( i = stride; i < row_size; i++ )
+                row[i] = (unsigned char) (row[i] + row[i - stride]);
+
+            memcpy( tmp, row, row_size );
+            for( w = 0; w < row_words; w++ )
+            {
+                if( IS_LSB )
+                {
+                    row[4*w]   = tmp[3*row_words + w];
+                    row[4*w+1] = tmp[2*row_words + w];
+                    row[4*w+2] = tmp[row_words + w];
+                    row[4*w+3] = tmp[w];
+                }
+                else
+                {
+                    row[4*w]   = tmp[w];
+                    row[4*w+1] = tmp[row_words + w];
+                    row[4*w+2] = tmp[2*row_words + w];
+                    row[4*w+3] = tmp[3*row_words + w];
+                }
+            }
+        }
+
+        pj_dalloc( tmp );
+        return 1;
+    }
+
+    if( g->big_endian == IS_LSB )
+        pj_swap_words( out, 4, row_words * rows );
+
+    /* horizontal differencing of the words, seen as integers */
+    if( g->predictor == 2 )
+    {
+        unsigned int *words = (unsigned int *) buf;
+        size_t i;
+
+        for( r = 0; r < rows; r++ )
+            for( i = stride; i < row_words; i++ )
+                words[r * row_words + i] += words[r * row_words + i - stride];
+    }
+
+    return 1;
+}
+
+/************************************************************************/
+/*                         pj_gtiff_load_rows()                         */
+/*                                                                      */
+/*      Read row_count rows of a GeoTIFF grid, starting at first_row,   */
+/*      into cvs in the CTABLE layout, FLP shifts or float heights.     */
+/*      Only the tiles crossing those rows are read.  The TIFF rows     */
+/*      run north to south, the CTABLE rows south to north.             */
+/************************************************************************/
+
+int pj_gtiff_load_rows( projCtx ctx, PJ_GRIDINFO *gi, PAFile fid,
+                        int first_row, int row_count, FLP *cvs )
+
+{
+    const PJ_GTIFF *g = gi->gtiff;
+    int     vertical = pj_gridinfo_heights( gi );
+    int     planes = g->planar == 2 ? (vertical ? 1 : 2) : 1;
+    int     stride = g->planar == 1 ? g->samples : 1;
+    int     top = g->height - first_row - row_count;  /* first TIFF row */
+    int     tile_row, tile_col, p;
+    size_t  tile_words = (size_t) g->tile_width * g->tile_height * stride;
+    float  *tiles;
+
+    tiles = (float *) pj_malloc( sizeof(float) * tile_words * planes );
+    if( tiles == NULL )
+    {
+        pj_ctx_set_errno( ctx, -38 );
+        return 0;
+    }
+
+    for( tile_row = top / g->tile_height; 
+         tile_row * g->tile_height < top + row_count; tile_row++ )
+    {
+        int y0 = tile_row * g->tile_height;
+        int rows = g->height - y0 < g->tile_height 
+            ? g->height - y0 : g->tile_height;
+        int ya = y0 < top ? top : y0;
+        int yb = y0 + rows < top + row_count ? y0 + rows : top + row_count;
+
+        for( tile_col = 0; tile_col < g->tiles_across; tile_col++ )
+        {
+            int x0 = tile_col * g->tile_width;
+            int xb = x0 + g->tile_width < g->width 
+                ? x0 + g->tile_width : g->width;
+            int x, y;
+
+            /* tiles are full size even at the edges, strips are not */
+            if( g->tiled )
+                rows = g->tile_height;
+
+            for( p = 0; p < planes; p++ )
+            {
+                int index = tile_row * g->tiles_across + tile_col;
+
+                if( g->planar == 2 )
+                    index += g->sample[p] * g->tiles_across * g->tiles_down;
+
+                if( !gtiff_read_tile( ctx, fid, g, index, rows, 
+                                      tiles + p * tile_words ) )
+                {
+                    pj_log( ctx, PJ_LOG_ERROR, 
+                            "GeoTIFF grid %s: tile %d is unreadable.",
+                            gi->ct->id, index );
+                    pj_dalloc( tiles );
+                    pj_ctx_set_errno( ctx, -38 );
+                    return 0;
+                }
+            }
+
+            for( y = ya; y < yb; y++ )
+            {
+                int    row = g->height - 1 - y - first_row;
+                size_t base = (size_t) (y - y0) * g->tile_width * stride;
+
+                for( x = x0; x < xb; x++ )
+                {
+                    size_t at = base + (size_t) (x - x0) * stride;
+                    double v0, v1;
+
+                    if( g->planar == 1 )
+                    {
+                        v0 = tiles[at + g->sample[0]];
+                        v1 = vertical ? 0.0 : tiles[at + g->sample[1]];
+                    }
+                    else
+                    {
+                        v0 = tiles[at];
+                        v1 = vertical ? 0.0 : tiles[tile_words + at];
+                    }
+
+                    if( vertical )
+                        ((float *) cvs)[(size_t) row * g->width + x] =
+                            g->has_nodata && v0 == g->nodata 
+                            ? GTIFF_NODATA 
+                            : (float) (v0 * g->factor[0] + g->offset[0]);
+
+                    /* no shift where there is no data */
+                    else if( g->has_nodata 
+                             && (v0 == g->nodata || v1 == g->nodata) )
+                    {
+                        cvs[(size_t) row * g->width + x].phi = 0.0;
+                        cvs[(size_t) row * g->width + x].lam = 0.0;
+                    }
+                    else
+                    {
+                        cvs[(size_t) row * g->width + x].phi = (float)
+                            (v0 * g->factor[0] + g->offset[0]);
+                        cvs[(size_t) row * g->width + x].lam = (float)
+                            (v1 * g->factor[1] + g->offset[1]);
+                    }
+                }
+            }
+        }
+    }
+
+    pj_dalloc( tiles );
+    return 1;
+}
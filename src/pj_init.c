@@ -34,7 +34,6 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
-#include <locale.h>
 #include <ctype.h>
 
 PJ_CVSID("$Id$");
@@ -94,25 +93,69 @@ static const char *fill_buffer(pj_read_state *state, const char *last_char)
 }
 
 /************************************************************************/
-/*                              get_opt()                               */
+/*                              add_opt()                               */
+/*                                                                      */
+/*      Append a parameter read from an init or defaults file, unless   */
+/*      the definition already has it.  It is allocated from *arena.    */
 /************************************************************************/
 static paralist *
-get_opt(projCtx ctx, paralist **start, PAFile fid, char *name, paralist *next,
-        int *found_def) {
-    pj_read_state *state = (pj_read_state*) calloc(1,sizeof(pj_read_state));
+add_opt(projCtx ctx, PJ_ARENA **arena, paralist **start, paralist *next,
+        const char *word) {
     char sword[302];
+
+    *sword = 't';
+    strncpy(sword+1, word, sizeof(sword)-2);
+    sword[sizeof(sword)-1] = '\0';
+
+    /* do not override existing parameter value of same name */
+    if (!pj_param(ctx, *start, sword).i) {
+        /* don't default ellipse if datum, ellps or any earth model
+           information is set. */
+        if( strncmp(sword+1,"ellps=",6) != 0 
+            || (!pj_param(ctx, *start, "tdatum").i 
+                && !pj_param(ctx, *start, "tellps").i 
+                && !pj_param(ctx, *start, "ta").i 
+                && !pj_param(ctx, *start, "tb").i 
+                && !pj_param(ctx, *start, "trf").i 
+                && !pj_param(ctx, *start, "tf").i) )
+        {
+            next = next->next = pj_mkparam_arena(arena, sword+1);
+        }
+    }
+
+    return next;
+}
+
+/************************************************************************/
+/*                              get_opt()                               */
+/*                                                                      */
+/*      Read the <name> definition from fid, or from the nul            */
+/*      terminated text if it is not NULL.                              */
+/************************************************************************/
+static paralist *
+get_opt(projCtx ctx, PJ_ARENA **arena, paralist **start, PAFile fid, 
+        const char *text, char *name, paralist *next, int *found_def) {
+    pj_read_state *state = (pj_read_state*) 
+        pj_ctx_malloc(ctx, sizeof(pj_read_state));
+    char sword[301];
     int len;
     int in_target = 0;
     const char *next_char = NULL;
 
+    memset(state, 0, sizeof(pj_read_state));
+
     state->fid = fid;
     state->ctx = ctx;
-    next_char = fill_buffer(state, NULL);
+    if (text != NULL) {
+        state->at_eof = 1; /* so fill_buffer() leaves it */
+        next_char = text;
+    }
+    else
+        next_char = fill_buffer(state, NULL);
     if(found_def)
         *found_def = 0;
 
     len = strlen(name);
-    *sword = 't';
 
     /* loop till we find our target keyword */
     while (*next_char) 
@@ -181,25 +224,12 @@ get_opt(projCtx ctx, paralist **start, PAFile fid, char *name, paralist *next,
                 word_len++;
             }
 
-            strncpy(sword+1, start_of_word, word_len);
-            sword[word_len+1] = '\0';
-
-            /* do not override existing parameter value of same name */
-            if (!pj_param(ctx, *start, sword).i) {
-                /* don't default ellipse if datum, ellps or any earth model
-                   information is set. */
-                if( strncmp(sword+1,"ellps=",6) != 0 
-                    || (!pj_param(ctx, *start, "tdatum").i 
-                        && !pj_param(ctx, *start, "tellps").i 
-                        && !pj_param(ctx, *start, "ta").i 
-                        && !pj_param(ctx, *start, "tb").i 
-                        && !pj_param(ctx, *start, "trf").i 
-                        && !pj_param(ctx, *start, "tf").i) )
-                {
-                    next = next->next = pj_mkparam(sword+1);
-                }
-            }
-            
+            if (word_len > (int) sizeof(sword) - 1)
+                word_len = sizeof(sword) - 1;
+            strncpy(sword, start_of_word, word_len);
+            sword[word_len] = '\0';
+
+            next = add_opt(ctx, arena, start, next, sword);
         }
         else 
         {
@@ -213,7 +243,7 @@ get_opt(projCtx ctx, paralist **start, PAFile fid, char *name, paralist *next,
     if (errno == 25)
         errno = 0;
 
-    free(state);
+    pj_ctx_dalloc(ctx, state);
 
     return next;
 }
@@ -222,14 +252,22 @@ get_opt(projCtx ctx, paralist **start, PAFile fid, char *name, paralist *next,
 /*                            get_defaults()                            */
 /************************************************************************/
 static paralist *
-get_defaults(projCtx ctx, paralist **start, paralist *next, char *name) {
-    PAFile fid;
+get_defaults(projCtx ctx, PJ_ARENA **arena, paralist **start, paralist *next,
+             char *name) {
+    const char *tags[2];
+    int i;
 
-    if ( (fid = pj_open_lib(ctx,"proj_def.dat", "rt")) != NULL) {
-        next = get_opt(ctx, start, fid, "general", next, NULL);
-        pj_ctx_fseek(ctx, fid, 0, SEEK_SET);
-        next = get_opt(ctx, start, fid, name, next, NULL);
-        pj_ctx_fclose(ctx, fid);
+    /* proj_def.dat is only read once, see pj_search_defaults() */
+    tags[0] = "general";
+    tags[1] = name;
+    for (i = 0; i < 2; i++) {
+        paralist *defaults = pj_search_defaults(ctx, tags[i]), *item;
+
+        for (item = defaults; item != NULL; item = defaults) {
+            next = add_opt(ctx, arena, start, next, item->param);
+            defaults = item->next;
+            pj_free_param(item);
+        }
     }
     if (errno)
         errno = 0; /* don't care if can't open file */
@@ -238,16 +276,40 @@ get_defaults(projCtx ctx, paralist **start, paralist *next, char *name) {
     return next;
 }
 
+/************************************************************************/
+/*                             read_init()                              */
+/*                                                                      */
+/*      Read the <tag> definition of the open init file fid, from its   */
+/*      text if it is already read, as by preload_init_files().         */
+/************************************************************************/
+static paralist *
+read_init(projCtx ctx, PJ_ARENA **arena, paralist **start, paralist *next,
+          PAFile fid, const char *text, const char *fname, char *tag, 
+          int *found_def) {
+    /* seek straight to the definition if the file index knows it */
+    int at = pj_seek_init_tag(ctx, fname, fid, tag);
+
+    if (at == 0) {
+        *found_def = 0;
+        return next;
+    }
+    if (text != NULL && at > 0)
+        text += pj_ctx_ftell(ctx, fid);
+    return get_opt(ctx, arena, start, fid, text, tag, next, found_def);
+}
+
 /************************************************************************/
 /*                              get_init()                              */
 /************************************************************************/
 static paralist *
-get_init(projCtx ctx, paralist **start, paralist *next, char *name,
-         int *found_def) {
+get_init(projCtx ctx, PJ_ARENA **arena, paralist **start, paralist *next,
+         char *name, int *found_def) {
     char fname[MAX_PATH_FILENAME+ID_TAG_MAX+3], *opt;
     PAFile fid;
     paralist *init_items = NULL;
     const paralist *orig_next = next;
+    const PJ_INIT_DB_ENTRY *entry;
+    int count, i;
 
     (void)strncpy(fname, name, MAX_PATH_FILENAME + ID_TAG_MAX + 1);
 	
@@ -255,7 +317,14 @@ get_init(projCtx ctx, paralist **start, paralist *next, char *name,
     ** Search for file/key pair in cache 
     */
 	
-    init_items = pj_search_initcache( name );
+    init_items = pj_search_initcache( name, arena );
+    if( ctx->stats != NULL )
+    {
+        if( init_items != NULL )
+            ctx->stats->stats.initcache_hits += 1.0;
+        else
+            ctx->stats->stats.initcache_misses += 1.0;
+    }
     if( init_items != NULL )
     {
         next->next = init_items;
@@ -272,20 +341,31 @@ get_init(projCtx ctx, paralist **start, paralist *next, char *name,
         *opt++ = '\0';
     else { pj_ctx_set_errno(ctx,-3); return NULL; }
 
-    if ( (fid = pj_open_lib(ctx,fname, "rt")) != NULL)
-        next = get_opt(ctx, start, fid, opt, next, found_def);
-    else
-        return NULL;
-    pj_ctx_fclose(ctx, fid);
-    if (errno == 25)
-        errno = 0; /* unknown problem with some sys errno<-25 */
+    /* files built into the library are not searched for */
+    if ( pj_init_db_file(fname, &count) != NULL ) {
+        entry = pj_init_db_find(fname, opt);
+        *found_def = entry != NULL;
+        for (i = 0; entry != NULL && i < entry->count; i++)
+            next = add_opt(ctx, arena, start, next, 
+                           pj_init_db_param(entry, i));
+    }
+    else {
+        if ( (fid = pj_open_lib(ctx,fname, "rt")) == NULL)
+            return NULL;
+
+        next = read_init(ctx, arena, start, next, fid, NULL, fname, opt, 
+                         found_def);
+        pj_ctx_fclose(ctx, fid);
+        if (errno == 25)
+            errno = 0; /* unknown problem with some sys errno<-25 */
+    }
 
     /* 
     ** If we seem to have gotten a result, insert it into the 
     ** init file cache.
     */
     if( next != NULL && next != orig_next )
-        pj_insert_initcache( name, orig_next->next );
+        pj_insert_initcache( ctx, name, orig_next->next );
 
     return next;
 }
@@ -305,20 +385,19 @@ pj_init_plus( const char *definition )
     return pj_init_plus_ctx( pj_get_default_ctx(), definition );
 }
 
-PJ *
-pj_init_plus_ctx( projCtx ctx, const char *definition )
+/************************************************************************/
+/*                        pj_split_definition()                         */
+/*                                                                      */
+/*      Split a "+proj=... +ellps=..." definition, in place, into at    */
+/*      most max_arg - 1 parameters, without their '+' and the white    */
+/*      space around them.  Returns their count, or -1 if there are     */
+/*      more.                                                           */
+/************************************************************************/
+
+int
+pj_split_definition( char *defn_copy, char **argv, int max_arg )
 {
-#define MAX_ARG 200
-    char	*argv[MAX_ARG];
-    char	*defn_copy;
     int		argc = 0, i, blank_count = 0;
-    PJ	    *result = NULL;
-    
-    /* make a copy that we can manipulate */
-    defn_copy = (char *) pj_malloc( strlen(definition)+1 );
-    strcpy( defn_copy, definition );
-
-    /* split into arguments based on '+' and trim white space */
 
     for( i = 0; defn_copy[i] != '\0'; i++ )
     {
@@ -334,11 +413,8 @@ pj_init_plus_ctx( projCtx ctx, const char *definition )
                     blank_count = 0;
                 }
                 
-                if( argc+1 == MAX_ARG )
-                {
-                    pj_ctx_set_errno( ctx, -44 );
-                    goto bum_call;
-                }
+                if( argc+1 == max_arg )
+                    return -1;
                 
                 argv[argc++] = defn_copy + i + 1;
             }
@@ -362,11 +438,35 @@ pj_init_plus_ctx( projCtx ctx, const char *definition )
     /* trim trailing spaces from the last param */
     defn_copy[i - blank_count] = '\0';
 
+    return argc;
+}
+
+PJ *
+pj_init_plus_ctx( projCtx ctx, const char *definition )
+{
+#define MAX_ARG 200
+    char	*argv[MAX_ARG];
+    char	defn_buf[1024];
+    char	*defn_copy = defn_buf;
+    int		argc;
+    PJ	    *result = NULL;
+    
+    /* make a copy that we can manipulate, on the stack if it fits */
+    if( strlen(definition) >= sizeof(defn_buf) )
+        defn_copy = (char *) pj_malloc( strlen(definition)+1 );
+    strcpy( defn_copy, definition );
+
+    /* split into arguments based on '+' and trim white space */
+    argc = pj_split_definition( defn_copy, argv, MAX_ARG );
+
     /* perform actual initialization */
-    result = pj_init_ctx( ctx, argc, argv );
+    if( argc < 0 )
+        pj_ctx_set_errno( ctx, -44 );
+    else
+        result = pj_init_ctx( ctx, argc, argv );
 
-bum_call:
-    pj_dalloc( defn_copy );
+    if( defn_copy != defn_buf )
+        pj_dalloc( defn_copy );
 
     return result;
 }
@@ -385,48 +485,57 @@ pj_init(int argc, char **argv) {
     return pj_init_ctx( pj_get_default_ctx(), argc, argv );
 }
 
-PJ *
-pj_init_ctx(projCtx ctx, int argc, char **argv) {
-    char *s, *name;
+/************************************************************************/
+/*                          pj_expand_params()                          */
+/*                                                                      */
+/*      Build the parameter list of a definition, expanded with the     */
+/*      +init= definition and the proj_def.dat defaults, in *arena.     */
+/*      The arena is left to the caller to free, also on failure.       */
+/************************************************************************/
+
+static paralist *
+pj_expand_list(projCtx ctx, PJ_ARENA **arena, paralist *start,
+               paralist *curr);
+
+static paralist *
+pj_expand_params(projCtx ctx, PJ_ARENA **arena, int argc, char **argv) {
     paralist *start = NULL;
-    PJ *(*proj)(PJ *);
     paralist *curr;
     int i;
-    PJ *PIN = 0;
-    char *old_locale;
-
-    ctx->last_errno = 0;
-    start = NULL;
-
-    /*
-    ** MS Visual Studio 2012+ may have problems in multithreaded cases
-    ** as discussed in this ticket:
-    ** http://trac.osgeo.org/proj/ticket/226
-    */
-    old_locale = setlocale(LC_NUMERIC, NULL);
-    if (old_locale != NULL) {
-       if (strcmp(old_locale,"C") != 0) {
-	  old_locale = strdup(old_locale);
-	  setlocale(LC_NUMERIC,"C");
-       }else
-	  old_locale = NULL;
-    }
 
     /* put arguments into internal linked list */
-    if (argc <= 0) { pj_ctx_set_errno( ctx, -1 ); goto bum_call; }
+    if (argc <= 0) { pj_ctx_set_errno( ctx, -1 ); return NULL; }
     for (i = 0; i < argc; ++i)
         if (i)
-            curr = curr->next = pj_mkparam(argv[i]);
+            curr = curr->next = pj_mkparam_arena(arena, argv[i]);
         else
-            start = curr = pj_mkparam(argv[i]);
+            start = curr = pj_mkparam_arena(arena, argv[i]);
     if (ctx->last_errno) goto bum_call;
 
+    return pj_expand_list(ctx, arena, start, curr);
+
+  bum_call: /* cleanup error return */
+    pj_free_paralist(start);
+    return NULL;
+}
+
+/************************************************************************/
+/*                           pj_expand_list()                           */
+/*                                                                      */
+/*      Expand the parameter list start, ending at curr, as             */
+/*      pj_expand_params().  The list is freed on failure.              */
+/************************************************************************/
+
+static paralist *
+pj_expand_list(projCtx ctx, PJ_ARENA **arena, paralist *start,
+               paralist *curr) {
+    char *name;
+
     /* check if +init present */
     if (pj_param(ctx, start, "tinit").i) {
-        paralist *last = curr;
         int found_def = 0;
 
-        if (!(curr = get_init(ctx,&start, curr,
+        if (!(curr = get_init(ctx, arena, &start, curr,
                               pj_param(ctx, start, "sinit").s,
                               &found_def)))
             goto bum_call;
@@ -436,29 +545,70 @@ pj_init_ctx(projCtx ctx, int argc, char **argv) {
     /* find projection selection */
     if (!(name = pj_param(ctx, start, "sproj").s))
     { pj_ctx_set_errno( ctx, -4 ); goto bum_call; }
-    for (i = 0; (s = pj_list[i].id) && strcmp(name, s) ; ++i) ;
-    if (!s) { pj_ctx_set_errno( ctx, -5 ); goto bum_call; }
+    if (!pj_find_proj(name)) { pj_ctx_set_errno( ctx, -5 ); goto bum_call; }
 
     /* set defaults, unless inhibited */
     if (!pj_param(ctx, start, "bno_defs").i)
-        curr = get_defaults(ctx,&start, curr, name);
-    proj = (PJ *(*)(PJ *)) pj_list[i].proj;
+        curr = get_defaults(ctx, arena, &start, curr, name);
+
+    return start;
+
+  bum_call: /* cleanup error return */
+    pj_free_paralist(start);
+    return NULL;
+}
+
+/************************************************************************/
+/*                           pj_init_params()                           */
+/*                                                                      */
+/*      Set up a projection from an expanded parameter list and the     */
+/*      arena it is in, which become owned by the result (or are        */
+/*      freed on failure).                                              */
+/************************************************************************/
+
+static PJ *
+pj_init_params(projCtx ctx, paralist *start, PJ_ARENA *arena) {
+    char *s, *name;
+    struct PJ_LIST *proj_entry;
+    struct PJ_UNITS *units;
+    PJ *(*proj)(PJ *);
+    paralist *last;
+    PJ *PIN = 0;
+
+    for (last = start; last->next != NULL; last = last->next) {}
+
+    /* as pj_expand_params() would, for lists expanded earlier */
+    (void)pj_param(ctx, start, "sinit");
+    (void)pj_param(ctx, start, "bno_defs");
+
+    /* find projection selection */
+    if (!(name = pj_param(ctx, start, "sproj").s))
+    { pj_ctx_set_errno( ctx, -4 ); goto bum_call; }
+    if (!(proj_entry = pj_find_proj(name)))
+    { pj_ctx_set_errno( ctx, -5 ); goto bum_call; }
+
+    proj = (PJ *(*)(PJ *)) proj_entry->proj;
 
     /* allocate projection structure */
     if (!(PIN = (*proj)(0))) goto bum_call;
     PIN->ctx = ctx;
     PIN->params = start;
+    PIN->cold->arena = arena;
+    PIN->cold->last_defn_param = last;
     PIN->is_latlong = 0;
     PIN->is_geocent = 0;
-    PIN->is_long_wrap_set = 0;
-    PIN->long_wrap_center = 0.0;
-    strcpy( PIN->axis, "enu" );
+    PIN->cold->is_long_wrap_set = 0;
+    PIN->cold->long_wrap_center = 0.0;
+    strcpy( PIN->cold->axis, "enu" );
 
-    PIN->gridlist = NULL;
-    PIN->gridlist_count = 0;
+    PIN->cold->gridlist = NULL;
+    PIN->cold->gridlist_count = 0;
+    PIN->gridlist_last = NULL;
+    PIN->gridlist_last_table = 0;
 
-    PIN->vgridlist_geoid = NULL;
-    PIN->vgridlist_geoid_count = 0;
+    PIN->cold->vgridlist_geoid = NULL;
+    PIN->cold->vgridlist_geoid_count = 0;
+    PIN->cold->grid_registry = NULL;
 
     /* set datum parameters */
     if (pj_datum_set(ctx, start, PIN)) goto bum_call;
@@ -466,8 +616,8 @@ pj_init_ctx(projCtx ctx, int argc, char **argv) {
     /* set ellipsoid/sphere parameters */
     if (pj_ell_set(ctx, start, &PIN->a, &PIN->es)) goto bum_call;
 
-    PIN->a_orig = PIN->a;
-    PIN->es_orig = PIN->es;
+    PIN->cold->a_orig = PIN->a;
+    PIN->cold->es_orig = PIN->es;
 
     PIN->e = sqrt(PIN->es);
     PIN->ra = 1. / PIN->a;
@@ -476,14 +626,14 @@ pj_init_ctx(projCtx ctx, int argc, char **argv) {
     PIN->rone_es = 1./PIN->one_es;
 
     /* Now that we have ellipse information check for WGS84 datum */
-    if( PIN->datum_type == PJD_3PARAM 
-        && PIN->datum_params[0] == 0.0
-        && PIN->datum_params[1] == 0.0
-        && PIN->datum_params[2] == 0.0
+    if( PIN->cold->datum_type == PJD_3PARAM 
+        && PIN->cold->datum_params[0] == 0.0
+        && PIN->cold->datum_params[1] == 0.0
+        && PIN->cold->datum_params[2] == 0.0
         && PIN->a == 6378137.0
         && ABS(PIN->es - 0.006694379990) < 0.000000000050 )/*WGS84/GRS80*/
     {
-        PIN->datum_type = PJD_WGS84;
+        PIN->cold->datum_type = PJD_WGS84;
     }
         
     /* set PIN->geoc coordinate system */
@@ -493,14 +643,14 @@ pj_init_ctx(projCtx ctx, int argc, char **argv) {
     PIN->over = pj_param(ctx, start, "bover").i;
 
     /* vertical datum geoid grids */
-    PIN->has_geoid_vgrids = pj_param(ctx, start, "tgeoidgrids").i;
-    if( PIN->has_geoid_vgrids ) /* we need to mark it as used. */
+    PIN->cold->has_geoid_vgrids = pj_param(ctx, start, "tgeoidgrids").i;
+    if( PIN->cold->has_geoid_vgrids ) /* we need to mark it as used. */
         pj_param(ctx, start, "sgeoidgrids");
 
     /* longitude center for wrapping */
-    PIN->is_long_wrap_set = pj_param(ctx, start, "tlon_wrap").i;
-    if (PIN->is_long_wrap_set)
-        PIN->long_wrap_center = pj_param(ctx, start, "rlon_wrap").f;
+    PIN->cold->is_long_wrap_set = pj_param(ctx, start, "tlon_wrap").i;
+    if (PIN->cold->is_long_wrap_set)
+        PIN->cold->long_wrap_center = pj_param(ctx, start, "rlon_wrap").f;
 
     /* axis orientation */
     if( (pj_param(ctx, start,"saxis").s) != NULL )
@@ -522,12 +672,12 @@ pj_init_ctx(projCtx ctx, int argc, char **argv) {
         }
 
         /* it would be nice to validate we don't have on axis repeated */
-        strcpy( PIN->axis, axis_arg );
+        strcpy( PIN->cold->axis, axis_arg );
     }
 
-    PIN->is_long_wrap_set = pj_param(ctx, start, "tlon_wrap").i;
-    if (PIN->is_long_wrap_set)
-        PIN->long_wrap_center = pj_param(ctx, start, "rlon_wrap").f;
+    PIN->cold->is_long_wrap_set = pj_param(ctx, start, "tlon_wrap").i;
+    if (PIN->cold->is_long_wrap_set)
+        PIN->cold->long_wrap_center = pj_param(ctx, start, "rlon_wrap").f;
 
     /* central meridian */
     PIN->lam0=pj_param(ctx, start, "rlon_0").f;
@@ -554,14 +704,14 @@ pj_init_ctx(projCtx ctx, int argc, char **argv) {
     /* set units */
     s = 0;
     if ((name = pj_param(ctx, start, "sunits").s) != NULL) { 
-        for (i = 0; (s = pj_units[i].id) && strcmp(name, s) ; ++i) ;
-        if (!s) { pj_ctx_set_errno( ctx, -7 ); goto bum_call; }
-        s = pj_units[i].to_meter;
+        if (!(units = pj_find_units(name)))
+        { pj_ctx_set_errno( ctx, -7 ); goto bum_call; }
+        s = units->to_meter;
     }
     if (s || (s = pj_param(ctx, start, "sto_meter").s)) {
-        PIN->to_meter = strtod(s, &s);
+        PIN->to_meter = pj_strtod(s, &s);
         if (*s == '/') /* ratio number */
-            PIN->to_meter /= strtod(++s, 0);
+            PIN->to_meter /= pj_strtod(++s, 0);
         PIN->fr_meter = 1. / PIN->to_meter;
     } else
         PIN->to_meter = PIN->fr_meter = 1.;
@@ -569,18 +719,18 @@ pj_init_ctx(projCtx ctx, int argc, char **argv) {
     /* set vertical units */
     s = 0;
     if ((name = pj_param(ctx, start, "svunits").s) != NULL) { 
-        for (i = 0; (s = pj_units[i].id) && strcmp(name, s) ; ++i) ;
-        if (!s) { pj_ctx_set_errno( ctx, -7 ); goto bum_call; }
-        s = pj_units[i].to_meter;
+        if (!(units = pj_find_units(name)))
+        { pj_ctx_set_errno( ctx, -7 ); goto bum_call; }
+        s = units->to_meter;
     }
     if (s || (s = pj_param(ctx, start, "svto_meter").s)) {
-        PIN->vto_meter = strtod(s, &s);
+        PIN->cold->vto_meter = pj_strtod(s, &s);
         if (*s == '/') /* ratio number */
-            PIN->vto_meter /= strtod(++s, 0);
-        PIN->vfr_meter = 1. / PIN->vto_meter;
+            PIN->cold->vto_meter /= pj_strtod(++s, 0);
+        PIN->cold->vfr_meter = 1. / PIN->cold->vto_meter;
     } else {
-        PIN->vto_meter = PIN->to_meter;
-        PIN->vfr_meter = PIN->fr_meter;
+        PIN->cold->vto_meter = PIN->to_meter;
+        PIN->cold->vfr_meter = PIN->fr_meter;
     }
 
     /* prime meridian */
@@ -588,15 +738,10 @@ pj_init_ctx(projCtx ctx, int argc, char **argv) {
     if ((name = pj_param(ctx, start, "spm").s) != NULL) { 
         const char *value = NULL;
         char *next_str = NULL;
+        struct PJ_PRIME_MERIDIANS *pm = pj_find_prime_meridian(name);
 
-        for (i = 0; pj_prime_meridians[i].id != NULL; ++i )
-        {
-            if( strcmp(name,pj_prime_meridians[i].id) == 0 )
-            {
-                value = pj_prime_meridians[i].defn;
-                break;
-            }
-        }
+        if( pm != NULL )
+            value = pm->defn;
             
         if( value == NULL 
             && (dmstor_ctx(ctx,name,&next_str) != 0.0  || *name == '0')
@@ -604,32 +749,520 @@ pj_init_ctx(projCtx ctx, int argc, char **argv) {
             value = name;
 
         if (!value) { pj_ctx_set_errno( ctx, -46 ); goto bum_call; }
-        PIN->from_greenwich = dmstor_ctx(ctx,value,NULL);
+        PIN->cold->from_greenwich = dmstor_ctx(ctx,value,NULL);
     }
     else
-        PIN->from_greenwich = 0.0;
+        PIN->cold->from_greenwich = 0.0;
+
+    /* error allowed in exchange for cheaper series, if supported */
+    PIN->cold->accuracy = pj_param(ctx, start, "daccuracy").f;
+    if (PIN->cold->accuracy < 0.)
+    { pj_ctx_set_errno( ctx, -52 ); goto bum_call; }
 
     /* projection specific initialization */
-    if (!(PIN = (*proj)(PIN)) || ctx->last_errno) {
+    if (!(PIN = (*proj)(PIN)) || ctx->last_errno
+        || pj_approx_init(PIN)) {
       bum_call: /* cleanup error return */
         if (PIN)
             pj_free(PIN);
-        else
-            for ( ; start; start = curr) {
-                curr = start->next;
-                pj_dalloc(start);
-            }
+        else {
+            /* the projection freed itself, or was never allocated */
+            pj_free_paralist(start);
+            pj_arena_free(arena);
+        }
         PIN = 0;
     }
 
-    if (old_locale != NULL) {
-       setlocale(LC_NUMERIC,old_locale);
-       free( (char*)old_locale );
+    return PIN;
+}
+
+PJ *
+pj_init_ctx(projCtx ctx, int argc, char **argv) {
+    PJ_ARENA *arena = NULL;
+    paralist *start;
+    PJ *PIN = 0;
+    double begin = ctx->stats != NULL ? pj_clock_ns() : 0.;
+
+    ctx->last_errno = 0;
+
+    if ((start = pj_expand_params(ctx, &arena, argc, argv)) != NULL)
+        PIN = pj_init_params(ctx, start, arena);
+    else
+        pj_arena_free(arena);
+
+    if (ctx->stats != NULL) {
+        pj_stats_add_latency(&(ctx->stats->stats.init_latency),
+                             pj_clock_ns() - begin);
+        pj_stats_poll(ctx);
+    }
+
+    return PIN;
+}
+
+/************************************************************************/
+/*                         pj_clone_defn_params()                       */
+/*                                                                      */
+/*      Copy the expanded definition of a projection, leaving out       */
+/*      the parameters pj_datum_set() appended while setting it up.     */
+/*      The copy is allocated from *arena, unless arena is NULL.        */
+/************************************************************************/
+
+static paralist *
+pj_clone_defn_params(PJ *P, PJ_ARENA **arena) {
+    paralist *start = NULL, *curr = NULL, *item;
+
+    for (item = P->params; item != NULL; item = item->next) {
+        paralist *copy = pj_mkparam_copy(arena, item);
+
+        if (curr)
+            curr = curr->next = copy;
+        else
+            start = curr = copy;
+        if (item == P->cold->last_defn_param)
+            break;
+    }
+    return start;
+}
+
+/************************************************************************/
+/*                              pj_clone()                              */
+/*                                                                      */
+/*      Create a new projection with the same definition as P, bound    */
+/*      to ctx, without reading init or defaults files again.  The      */
+/*      projection specific setup is repeated, as there is no           */
+/*      general way to copy the private state of each projection.       */
+/************************************************************************/
+
+PJ *
+pj_clone(projCtx ctx, PJ *P) {
+    PJ_ARENA *arena = NULL;
+    paralist *start;
+
+    ctx->last_errno = 0;
+
+    if (P == NULL || (start = pj_clone_defn_params(P, &arena)) == NULL)
+    { pj_arena_free( arena ); pj_ctx_set_errno( ctx, -1 ); return NULL; }
+
+    return pj_init_params(ctx, start, arena);
+}
+
+/************************************************************************/
+/*                           pj_clone_exact()                           */
+/*                                                                      */
+/*      Same as pj_clone(), without the +approx approximation, for      */
+/*      the workers sampling the exact projection to fit it.            */
+/************************************************************************/
+
+PJ *
+pj_clone_exact(projCtx ctx, PJ *P) {
+    PJ_ARENA *arena = NULL;
+    paralist *start, **link;
+
+    ctx->last_errno = 0;
+
+    if (P == NULL || (start = pj_clone_defn_params(P, &arena)) == NULL)
+    { pj_arena_free( arena ); pj_ctx_set_errno( ctx, -1 ); return NULL; }
+
+    /* the copies are in the arena, so only give back their text */
+    for (link = &start; *link != NULL; ) {
+        if (strncmp((*link)->param, "approx", 6) == 0
+            && ((*link)->param[6] == '\0' || (*link)->param[6] == '=')) {
+            paralist *item = *link;
+
+            *link = item->next;
+            pj_free_param(item);
+        } else
+            link = &(*link)->next;
+    }
+
+    return pj_init_params(ctx, start, arena);
+}
+
+/************************************************************************/
+/*                          pj_init_from_def()                          */
+/*                                                                      */
+/*      Same as pj_init_ctx(), but for the parameters of a definition   */
+/*      built with pj_def_set_double() and pj_def_set_string(), so      */
+/*      that numbers are neither formatted nor parsed.  The             */
+/*      definition stays owned by the caller, and may be reused.        */
+/************************************************************************/
+
+PJ *
+pj_init_from_def(projCtx ctx, PJ_DEF *def) {
+    PJ_ARENA *arena = NULL;
+    paralist *start = NULL, *curr = NULL, *item;
+
+    ctx->last_errno = 0;
+
+    if (def == NULL || def->start == NULL)
+    { pj_ctx_set_errno( ctx, -1 ); return NULL; }
+
+    for (item = def->start; item != NULL; item = item->next) {
+        paralist *copy = pj_mkparam_copy(&arena, item);
+
+        if (copy == NULL) {
+            pj_free_paralist(start);
+            pj_arena_free(arena);
+            pj_ctx_set_errno( ctx, ENOMEM );
+            return NULL;
+        }
+        if (curr)
+            curr = curr->next = copy;
+        else
+            start = curr = copy;
+    }
+
+    if ((start = pj_expand_list(ctx, &arena, start, curr)) == NULL) {
+        pj_arena_free(arena);
+        return NULL;
+    }
+    return pj_init_params(ctx, start, arena);
+}
+
+/************************************************************************/
+/*                        pj_init_plus_cached()                         */
+/*                                                                      */
+/*      Same as pj_init_plus_ctx(), but the expanded parameters of      */
+/*      each successfully initialized definition string are cached,     */
+/*      so repeated definitions skip tokenizing, and the init and       */
+/*      defaults files.  A definition not cached as it is written is   */
+/*      looked up by its pj_canonical_def() too, so the same           */
+/*      parameters in another order, or with the units given by        */
+/*      +to_meter, make the same definition.                            */
+/************************************************************************/
+
+PJ *
+pj_init_plus_cached(projCtx ctx, const char *definition) {
+    PJ_ARENA *arena = NULL;
+    paralist *start;
+    char *key = NULL;
+    PJ *PIN;
+
+    start = pj_search_defncache(definition, &arena);
+    if (!start) {
+        pj_arena_free(arena);
+        arena = NULL;
+        if ((key = pj_canonical_def(ctx, definition)) == NULL)
+            ctx->last_errno = 0; /* left to pj_init_plus_ctx() */
+        else if (strcmp(key, definition) != 0
+                 && (start = pj_search_defncache(key, &arena)) != NULL)
+            pj_insert_defncache(ctx, definition, start);
+    }
+    if (ctx->stats) {
+        if (start)
+            ctx->stats->stats.initcache_hits += 1.;
+        else
+            ctx->stats->stats.initcache_misses += 1.;
+    }
+    if (start) {
+        pj_dalloc(key);
+        ctx->last_errno = 0;
+        return pj_init_params(ctx, start, arena);
+    }
+    pj_arena_free(arena);
+
+    PIN = pj_init_plus_ctx(ctx, definition);
+    if (PIN != NULL && (start = pj_clone_defn_params(PIN, NULL)) != NULL) {
+        pj_insert_defncache(ctx, definition, start);
+        if (key != NULL && strcmp(key, definition) != 0)
+            pj_insert_defncache(ctx, key, start);
+        pj_free_paralist(start);
     }
+    pj_dalloc(key);
 
     return PIN;
 }
 
+/************************************************************************/
+/*                             init_name()                              */
+/*                                                                      */
+/*      The +init file:key of a definition, with its length, or NULL.   */
+/************************************************************************/
+
+static const char *
+init_name(const char *definition, size_t *len) {
+    const char *s;
+
+    for (s = strstr(definition, "init="); s != NULL; s = strstr(s + 5, "init=")) {
+        if (s == definition || s[-1] == '+' || isspace((unsigned char) s[-1])) {
+            s += 5;
+            *len = strcspn(s, " \t\n+");
+            return *len > 0 && *len <= MAX_PATH_FILENAME + ID_TAG_MAX ? s : NULL;
+        }
+    }
+    return NULL;
+}
+
+/************************************************************************/
+/*                          preload_init_files()                        */
+/*                                                                      */
+/*      Read the +init definitions of the definitions not cached yet    */
+/*      into the init cache, reading each file once for all its keys.  */
+/*      A definition is cached as get_init() does for one with just    */
+/*      its +init.  Errors are left to pj_init() of the definitions.   */
+/************************************************************************/
+
+static char *
+read_text(projCtx ctx, PAFile fid) {
+    size_t size = 0, alloc = 0, got;
+    char *text = NULL;
+
+    do {
+        if (size + 65536 > alloc) {
+            char *grown = (char *) pj_malloc(alloc * 2 + 65536 + 1);
+
+            if (grown == NULL) {
+                pj_dalloc(text);
+                return NULL;
+            }
+            if (size > 0)
+                memcpy(grown, text, size);
+            pj_dalloc(text);
+            text = grown;
+            alloc = alloc * 2 + 65536;
+        }
+        got = pj_ctx_fread(ctx, text + size, 1, alloc - size, fid);
+        size += got;
+    } while (got > 0);
+    text[size] = '\0';
+
+    return text;
+}
+
+static void
+preload_init_files(projCtx ctx, int count, const char * const *definitions) {
+    char *done = (char *) pj_malloc(count);
+    int i, j, dummy;
+
+    if (done == NULL)
+        return;
+    memset(done, 0, count);
+
+    for (i = 0; i < count; i++) {
+        char fname[MAX_PATH_FILENAME+ID_TAG_MAX+3];
+        const char *name = NULL, *colon;
+        size_t len = 0, flen;
+        PAFile fid;
+        char *text;
+
+        if (!done[i] && definitions[i] != NULL)
+            name = init_name(definitions[i], &len);
+        if (name == NULL || (colon = memchr(name, ':', len)) == NULL)
+            continue;
+        flen = colon - name;
+        memcpy(fname, name, flen);
+        fname[flen] = '\0';
+        if (pj_init_db_file(fname, &dummy) != NULL
+            || (fid = pj_open_lib(ctx, fname, "rt")) == NULL)
+            continue;
+        if ((text = read_text(ctx, fid)) == NULL) {
+            pj_ctx_fclose(ctx, fid);
+            continue;
+        }
+
+        /* all the keys of the same file */
+        for (j = i; j < count; j++) {
+            char key[MAX_PATH_FILENAME+ID_TAG_MAX+3];
+            const char *other = NULL;
+            PJ_ARENA *arena = NULL;
+            paralist *start;
+            size_t olen = 0;
+            int found_def = 0;
+
+            if (!done[j] && definitions[j] != NULL)
+                other = init_name(definitions[j], &olen);
+            if (other == NULL || olen <= flen + 1 || other[flen] != ':'
+                || strncmp(other, fname, flen) != 0)
+                continue;
+            done[j] = 1;
+
+            strcpy(key, "init=");
+            memcpy(key + 5, other, olen);
+            key[5 + olen] = '\0';
+            if (pj_search_initcache(key + 5, &arena) != NULL
+                || (start = pj_mkparam_arena(&arena, key)) == NULL) {
+                pj_arena_free(arena);
+                continue;
+            }
+
+            if (read_init(ctx, &arena, &start, start, fid, text, fname,
+                          key + 5 + flen + 1, &found_def) != NULL
+                && found_def && start->next != NULL)
+                pj_insert_initcache(ctx, key + 5, start->next);
+            pj_arena_free(arena);
+        }
+        pj_dalloc(text);
+        pj_ctx_fclose(ctx, fid);
+    }
+    if (errno == 25)
+        errno = 0;
+    ctx->last_errno = 0;
+
+    pj_dalloc(done);
+}
+
+/************************************************************************/
+/*                            pj_init_many()                            */
+/*                                                                      */
+/*      Initialize count definitions, as pj_init_plus_ctx(), into out.  */
+/*      The init files they name are read once for each group of them  */
+/*      the init cache holds, unless ctx is in low memory mode, and     */
+/*      the definitions are initialized by the threads of the context,  */
+/*      see pj_ctx_set_threads(), each result being bound to ctx.       */
+/*      out[i] is NULL for a definition that failed, or that is NULL.   */
+/*      Returns the number of failed definitions, with the error of     */
+/*      the first set in the context.                                   */
+/************************************************************************/
+
+#define INIT_MANY_MIN_SPLIT 16   /* definitions a thread at least gets */
+#define INIT_MANY_GROUP     1024 /* well within the init cache */
+
+typedef struct {
+    projCtx  ctx;          /* own context, NULL for the calling thread */
+    projCtx  caller;
+    const char * const *definitions;
+    PJ       **out;
+    int      *errors;
+    int      end;          /* of the group */
+    int      *next;        /* shared, under lock */
+    void     *lock;
+    void     *thread;
+} init_worker;
+
+static void init_worker_run(void *arg) {
+    init_worker *worker = (init_worker *) arg;
+    projCtx ctx = worker->ctx != NULL ? worker->ctx : worker->caller;
+
+    for (;;) {
+        int i;
+
+        pj_mutex_lock(worker->lock);
+        i = (*worker->next)++;
+        pj_mutex_unlock(worker->lock);
+        if (i >= worker->end)
+            break;
+
+        if (worker->definitions[i] == NULL) {
+            worker->out[i] = NULL;
+            worker->errors[i] = -1;
+            continue;
+        }
+        worker->out[i] = pj_init_plus_ctx(ctx, worker->definitions[i]);
+        worker->errors[i] = worker->out[i] == NULL ? 
+            (ctx->last_errno != 0 ? ctx->last_errno : -1) : 0;
+    }
+}
+
+int
+pj_init_many(projCtx ctx, int count, const char * const *definitions,
+             PJ **out) {
+    init_worker *workers;
+    int *errors, worker_count, next, base, failures = 0, i, j;
+    void *lock;
+
+    if (ctx == NULL)
+        ctx = pj_get_default_ctx();
+    ctx->last_errno = 0;
+    if (count <= 0)
+        return 0;
+
+    worker_count = ctx->threads > 1 ? ctx->threads : 1;
+    if (worker_count > count / INIT_MANY_MIN_SPLIT)
+        worker_count = count / INIT_MANY_MIN_SPLIT > 0 ? 
+            count / INIT_MANY_MIN_SPLIT : 1;
+
+    errors = (int *) pj_malloc(sizeof(int) * count);
+    workers = (init_worker *) pj_malloc(sizeof(init_worker) * worker_count);
+    lock = pj_mutex_create(PJ_LOCK_BATCH);
+    if (errors == NULL || workers == NULL || lock == NULL) {
+        pj_dalloc(errors);
+        pj_dalloc(workers);
+        if (lock != NULL)
+            pj_mutex_destroy(lock);
+        for (i = 0; i < count; i++)
+            out[i] = NULL;
+        pj_ctx_set_errno(ctx, ENOMEM);
+        return count;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Other workers get a copy of the context, as for the batches     */
+/*      of pj_transform(), and take definitions of the group until      */
+/*      none are left.                                                  */
+/* -------------------------------------------------------------------- */
+    memset(workers, 0, sizeof(init_worker) * worker_count);
+    for (j = 0; j < worker_count; j++) {
+        init_worker *worker = workers + j;
+
+        worker->caller = ctx;
+        worker->definitions = definitions;
+        worker->out = out;
+        worker->errors = errors;
+        worker->next = &next;
+        worker->lock = lock;
+        if (j == 0 || (worker->ctx = pj_ctx_alloc()) == NULL)
+            continue;
+
+        memcpy(worker->ctx, ctx, sizeof(projCtx_t));
+        worker->ctx->last_errno = 0;
+        worker->ctx->grid_tiles = NULL;
+        worker->ctx->grid_tile_count = 0;
+        worker->ctx->errno_globals = 0;
+        worker->ctx->threads = 1;
+        worker->ctx->stats = NULL;
+        if (ctx->stats != NULL)
+            pj_ctx_set_stats(worker->ctx, 1);
+    }
+
+    for (base = 0; base < count; base += INIT_MANY_GROUP) {
+        int end = count - base > INIT_MANY_GROUP ? 
+            base + INIT_MANY_GROUP : count;
+
+        /* whole init files would be read, see pj_ctx_set_low_memory() */
+        if (!ctx->low_memory)
+            preload_init_files(ctx, end - base, definitions + base);
+
+        next = base;
+        for (j = 0; j < worker_count; j++) {
+            workers[j].end = end;
+            if (workers[j].ctx != NULL)
+                workers[j].thread = 
+                    pj_thread_start(init_worker_run, workers + j);
+        }
+
+        init_worker_run(workers);
+
+        for (j = 1; j < worker_count; j++)
+            if (workers[j].thread != NULL)
+                pj_thread_join(workers[j].thread);
+    }
+
+    for (j = 1; j < worker_count; j++) {
+        init_worker *worker = workers + j;
+
+        if (worker->ctx != NULL) {
+            if (ctx->stats != NULL && worker->ctx->stats != NULL)
+                pj_stats_merge(ctx->stats, worker->ctx->stats);
+            pj_ctx_free(worker->ctx);
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        if (out[i] != NULL)
+            pj_set_ctx(out[i], ctx);
+        else if (failures++ == 0)
+            ctx->last_errno = errors[i];
+    }
+    if (failures > 0)
+        pj_ctx_set_errno(ctx, ctx->last_errno);
+
+    pj_mutex_destroy(lock);
+    pj_dalloc(workers);
+    pj_dalloc(errors);
+
+    return failures;
+}
+
 /************************************************************************/
 /*                              pj_free()                               */
 /*                                                                      */
@@ -643,25 +1276,24 @@ pj_init_ctx(projCtx ctx, int argc, char **argv) {
 void
 pj_free(PJ *P) {
     if (P) {
-        paralist *t = P->params, *n;
+        PJ_ARENA *arena = P->cold->arena;
 
         /* free parameter list elements */
-        for (t = P->params; t; t = n) {
-            n = t->next;
-            pj_dalloc(t);
-        }
+        pj_free_paralist(P->params);
 
-        /* free array of grid pointers if we have one */
-        if( P->gridlist != NULL )
-            pj_dalloc( P->gridlist );
+        /* free the arrays of grid pointers, and let go of their
+           registry */
+        pj_grid_registry_unbind( P );
 
-        if( P->vgridlist_geoid != NULL )
-            pj_dalloc( P->vgridlist_geoid );
+        /* the catalog itself belongs to the grid registry */
+        if( P->cold->catalog_name != NULL )
+            free( P->cold->catalog_name );
 
-        if( P->catalog != NULL )
-            pj_dalloc( P->catalog );
+        pj_approx_free(P);
 
         /* free projection parameters */
         P->pfree(P);
+
+        pj_arena_free(arena);
     }
 }
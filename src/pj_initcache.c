@@ -28,34 +28,111 @@
  *****************************************************************************/
 
 #include <projects.h>
+#include <pj_trace.h>
 #include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
 
 PJ_CVSID("$Id: pj_transform.c 1504 2009-01-06 02:11:57Z warmerdam $");
 
-static int cache_count = 0;
-static int cache_alloc = 0;
-static char **cache_key = NULL;
-static paralist **cache_paralist = NULL;
+/*
+** Init file definitions are kept in a hash table keyed by "file:key", and
+** the expanded parameters of pj_init_plus_cached() definitions in another
+** keyed by the definition string.  Each holds at most INITCACHE_MAX
+** entries.  Lookups only take the shared side of the init
+** cache lock, so they only mark the entry as referenced, and eviction
+** uses the CLOCK approximation of LRU: the hand sweeps the slots,
+** clearing reference marks, until it finds an unreferenced entry.
+**
+** The bytes held by the entries of both tables are counted, so that
+** with pj_set_initcache_memory_limit() entries are also evicted until
+** the tables are back under the limit.  Contexts in low memory mode
+** insert under the smaller limit of PJ_LOW_MEMORY_INITCACHE.
+*/
+#define INITCACHE_MAX      4096
+#define INITCACHE_BUCKETS  4096    /* power of two */
+
+typedef struct {
+    char     *key;
+    paralist *list;
+    int      next;       /* next slot in the hash chain, or -1 */
+    int      referenced; /* set by lookups since the hand last passed */
+} cache_slot;
+
+typedef struct {
+    int        count;
+    int        alloc;
+    int        hand;
+    cache_slot *slots;
+    int        *buckets;   /* first slot of each chain, or -1 */
+    size_t     bytes;      /* of the keys and lists of the entries */
+} cache_table;
+
+static cache_table init_table = { 0, 0, 0, NULL, NULL, 0 };
+static cache_table defn_table = { 0, 0, 0, NULL, NULL, 0 };
+static size_t cache_limit = 0;  /* of the bytes of both, 0 for none */
+
+/* index of the <tag> definitions in each init file, see pj_seek_init_tag() */
+#define INIT_TAG_MAX 255
+
+typedef struct {
+    char *tag;
+    long offset;       /* of the '<' */
+} init_tag;
+
+/* an index shared between processes, see init_index_share() */
+typedef struct {
+    long     offset;
+    long     tag;      /* offset of the nul terminated tag in the pool */
+} init_shm_tag;
+
+typedef struct {
+    char     *filename;
+    long     size;
+    int      tag_count;
+    init_tag *tags;    /* sorted by tag, first occurrence only */
+    PJ_SHM   *shm;     /* or the tags mapped from a shared segment */
+    const init_shm_tag *shm_tags;
+    const char *shm_pool;
+} init_index;
+
+static int index_count = 0;
+static init_index *index_list = NULL;
+
+/* parsed blocks of proj_def.dat for each file api, see pj_search_defaults() */
+#define DEFAULTS_WORD_MAX 300
+
+typedef struct {
+    char     *tag;
+    paralist *list;
+} defaults_block;
+
+typedef struct defaults_file {
+    projFileAPI          *fileapi;
+    int                  block_count;
+    defaults_block       *blocks;
+    struct defaults_file *next;
+} defaults_file;
+
+static defaults_file *defaults_list = NULL;
+
+static void init_index_clear( init_index *index );
 
 /************************************************************************/
 /*                            pj_clone_paralist()                       */
 /*                                                                      */
-/*     Allocate a copy of a parameter list.                             */
+/*     Allocate a copy of a parameter list, from *arena unless it is    */
+/*     NULL.                                                            */
 /************************************************************************/
 
-paralist *pj_clone_paralist( const paralist *list)
+paralist *pj_clone_paralist( const paralist *list, PJ_ARENA **arena )
 {
   paralist *list_copy = NULL, *next_copy = NULL;
 
   for( ; list != NULL; list = list->next )
     {
-      paralist *newitem = (paralist *)
-	pj_malloc(sizeof(paralist) + strlen(list->param));
+      paralist *newitem = pj_mkparam_copy( arena, list );
 
-      newitem->used = 0;
-      newitem->next = 0;
-      strcpy( newitem->param, list->param );
-      
       if( list_copy == NULL )
 	list_copy = newitem;
       else
@@ -67,115 +144,1329 @@ paralist *pj_clone_paralist( const paralist *list)
   return list_copy;
 }
 
+/************************************************************************/
+/*                          cache_free_list()                           */
+/************************************************************************/
+
+static void cache_free_list( paralist *t )
+
+{
+    paralist *n;
+
+    for( ; t != NULL; t = n )
+    {
+        n = t->next;
+        pj_free_param( t );
+    }
+}
+
+/************************************************************************/
+/*                          cache_slot_bytes()                          */
+/************************************************************************/
+
+static size_t cache_slot_bytes( const cache_slot *slot )
+
+{
+    size_t bytes = strlen( slot->key ) + 1;
+    const paralist *t;
+
+    /* the texts are shared, and counted apart, see pj_intern.c */
+    for( t = slot->list; t != NULL; t = t->next )
+        bytes += sizeof(paralist);
+
+    return bytes;
+}
+
+/************************************************************************/
+/*                             cache_hash()                             */
+/*                                                                      */
+/*      FNV-1a hash of a key, reduced to a bucket number.               */
+/************************************************************************/
+
+static int cache_hash( const char *key )
+
+{
+    unsigned long hash = 2166136261UL;
+
+    for( ; *key != '\0'; key++ )
+    {
+        hash ^= (unsigned char) *key;
+        hash = (hash * 16777619UL) & 0xffffffffUL;
+    }
+
+    return (int) (hash & (INITCACHE_BUCKETS - 1));
+}
+
+/************************************************************************/
+/*                             cache_find()                             */
+/************************************************************************/
+
+static int cache_find( cache_table *table, const char *key, int bucket )
+
+{
+    int slot;
+
+    if( table->buckets == NULL )
+        return -1;
+
+    for( slot = table->buckets[bucket]; slot != -1; 
+         slot = table->slots[slot].next )
+    {
+        if( strcmp(key, table->slots[slot].key) == 0 )
+            return slot;
+    }
+
+    return -1;
+}
+
+/************************************************************************/
+/*                            cache_clear()                             */
+/************************************************************************/
+
+static void cache_clear( cache_table *table )
+
+{
+    int i;
+
+    if( table->alloc == 0 )
+        return;
+
+    pj_acquire_initcache_lock( 1 );
+
+    for( i = 0; i < table->count; i++ )
+    {
+        pj_dalloc( table->slots[i].key );
+        cache_free_list( table->slots[i].list );
+    }
+
+    pj_dalloc( table->slots );
+    pj_dalloc( table->buckets );
+    table->count = 0;
+    table->alloc = 0;
+    table->hand = 0;
+    table->slots = NULL;
+    table->buckets = NULL;
+    table->bytes = 0;
+
+    pj_release_initcache_lock( 1 );
+}
+
+/************************************************************************/
+/*                            cache_search()                            */
+/************************************************************************/
+
+static paralist *cache_search( cache_table *table, const char *key,
+                                PJ_ARENA **arena )
+
+{
+    int slot;
+    paralist *result = NULL;
+
+    pj_acquire_initcache_lock( 0 );
+
+    slot = cache_find( table, key, cache_hash( key ) );
+    if( slot != -1 )
+    {
+        /* concurrent lookups may all store this, which is harmless */
+        table->slots[slot].referenced = 1;
+        result = pj_clone_paralist( table->slots[slot].list, arena );
+    }
+
+    pj_release_initcache_lock( 0 );
+
+    return result;
+}
+
+/************************************************************************/
+/*                            cache_evict()                             */
+/*                                                                      */
+/*      Free the first unreferenced entry under the hand, passing over  */
+/*      the keep slot, and return its slot, now empty.                  */
+/************************************************************************/
+
+static int cache_evict( cache_table *table, int keep )
+
+{
+    int slot, *link;
+
+    while( table->slots[table->hand].referenced || table->hand == keep )
+    {
+        table->slots[table->hand].referenced = 0;
+        table->hand = (table->hand + 1) % table->count;
+    }
+    slot = table->hand;
+    table->hand = (table->hand + 1) % table->count;
+
+    link = table->buckets + cache_hash( table->slots[slot].key );
+    while( *link != slot )
+        link = &(table->slots[*link].next);
+    *link = table->slots[slot].next;
+
+    table->bytes -= cache_slot_bytes( table->slots + slot );
+    pj_dalloc( table->slots[slot].key );
+    cache_free_list( table->slots[slot].list );
+
+    return slot;
+}
+
+/************************************************************************/
+/*                            cache_remove()                            */
+/*                                                                      */
+/*      Drop an empty slot, moving the last one into it.  Returns the   */
+/*      slot now holding the entry that was in slot keep.               */
+/************************************************************************/
+
+static int cache_remove( cache_table *table, int slot, int keep )
+
+{
+    int last = --table->count;
+
+    if( slot != last )
+    {
+        int *link = table->buckets + cache_hash( table->slots[last].key );
+
+        while( *link != last )
+            link = &(table->slots[*link].next);
+        *link = slot;
+        table->slots[slot] = table->slots[last];
+        if( keep == last )
+            keep = slot;
+    }
+    if( table->hand >= table->count )
+        table->hand = 0;
+
+    return keep;
+}
+
+/************************************************************************/
+/*                            cache_insert()                            */
+/************************************************************************/
+
+static void cache_insert( projCtx ctx, cache_table *table,
+                          const char *key_in, const paralist *list )
+
+{
+    int bucket = cache_hash( key_in );
+    int slot, i;
+    char *key;
+    size_t limit;
+
+    pj_acquire_initcache_lock( 1 );
+
+    if( table->buckets == NULL )
+    {
+        table->buckets = (int *) pj_malloc(sizeof(int) * INITCACHE_BUCKETS);
+        if( table->buckets == NULL )
+        {
+            pj_release_initcache_lock( 1 );
+            return;
+        }
+        for( i = 0; i < INITCACHE_BUCKETS; i++ )
+            table->buckets[i] = -1;
+    }
+
+    /* another thread may have inserted it meanwhile */
+    key = (char *) pj_malloc(strlen(key_in)+1);
+    if( key == NULL || cache_find( table, key_in, bucket ) != -1 )
+    {
+        pj_dalloc( key );
+        pj_release_initcache_lock( 1 );
+        return;
+    }
+    strcpy( key, key_in );
+
+    /* 
+    ** Grow the slots if required, up to the cap.
+    */
+    if( table->count == table->alloc && table->alloc < INITCACHE_MAX )
+    {
+        cache_slot *slots_new;
+        int new_alloc = table->alloc * 2 + 15;
+
+        if( new_alloc > INITCACHE_MAX )
+            new_alloc = INITCACHE_MAX;
+
+        slots_new = (cache_slot *) pj_malloc(sizeof(cache_slot) * new_alloc);
+        if( slots_new == NULL )
+        {
+            pj_dalloc( key );
+            pj_release_initcache_lock( 1 );
+            return;
+        }
+        if( table->count > 0 )
+            memcpy( slots_new, table->slots, 
+                    sizeof(cache_slot) * table->count );
+        pj_dalloc( table->slots );
+        table->slots = slots_new;
+        table->alloc = new_alloc;
+    }
+
+    if( table->count < table->alloc )
+        slot = table->count++;
+
+    else
+        slot = cache_evict( table, -1 );
+
+    /*
+    ** Store the key and a copy of the paralist, and link it in.
+    */
+    table->slots[slot].key = key;
+    table->slots[slot].list = pj_clone_paralist( list, NULL );
+    table->slots[slot].referenced = 0;
+    table->slots[slot].next = table->buckets[bucket];
+    table->buckets[bucket] = slot;
+    table->bytes += cache_slot_bytes( table->slots + slot );
+
+/* -------------------------------------------------------------------- */
+/*      Keep both tables under the limit, evicting from this one, but   */
+/*      not the entry just inserted.                                    */
+/* -------------------------------------------------------------------- */
+    limit = cache_limit;
+    if( ctx != NULL && ctx->low_memory
+        && (limit == 0 || limit > PJ_LOW_MEMORY_INITCACHE) )
+        limit = PJ_LOW_MEMORY_INITCACHE;
+
+    while( limit > 0 && table->count > 1
+           && init_table.bytes + defn_table.bytes > limit )
+        slot = cache_remove( table, cache_evict( table, slot ), slot );
+
+    pj_release_initcache_lock( 1 );
+}
+
+/************************************************************************/
+/*                   pj_set_initcache_memory_limit()                    */
+/*                                                                      */
+/*      Limit the bytes held by the init file and definition caches,    */
+/*      0 for no limit other than their number of entries.  Entries     */
+/*      are evicted as others are inserted, so the limit is only        */
+/*      exceeded by a single entry larger than it.                      */
+/************************************************************************/
+
+void pj_set_initcache_memory_limit( size_t bytes )
+
+{
+    pj_acquire_initcache_lock( 1 );
+    cache_limit = bytes;
+    while( bytes > 0 && init_table.count > 0
+           && init_table.bytes + defn_table.bytes > bytes )
+        cache_remove( &init_table, cache_evict( &init_table, -1 ), -1 );
+    while( bytes > 0 && defn_table.count > 0
+           && init_table.bytes + defn_table.bytes > bytes )
+        cache_remove( &defn_table, cache_evict( &defn_table, -1 ), -1 );
+    pj_release_initcache_lock( 1 );
+}
+
+/************************************************************************/
+/*                   pj_get_initcache_memory_limit()                    */
+/************************************************************************/
+
+size_t pj_get_initcache_memory_limit()
+
+{
+    return cache_limit;
+}
+
+/************************************************************************/
+/*                        pj_initcache_memory()                         */
+/*                                                                      */
+/*      Bytes held by the init file and definition caches, and in       */
+/*      *index_bytes those of the indexes of init files and of the      */
+/*      parsed defaults.                                                */
+/************************************************************************/
+
+double pj_initcache_memory( double *index_bytes )
+
+{
+    double bytes;
+    const defaults_file *file;
+    int i, j;
+
+    pj_acquire_initcache_lock( 0 );
+
+    bytes = (double) init_table.bytes + (double) defn_table.bytes;
+    if( init_table.buckets != NULL )
+        bytes += sizeof(int) * INITCACHE_BUCKETS
+            + sizeof(cache_slot) * init_table.alloc;
+    if( defn_table.buckets != NULL )
+        bytes += sizeof(int) * INITCACHE_BUCKETS
+            + sizeof(cache_slot) * defn_table.alloc;
+
+    *index_bytes = sizeof(init_index) * (double) index_count;
+    for( i = 0; i < index_count; i++ )
+    {
+        const init_index *ix = index_list + i;
+
+        *index_bytes += (double) strlen( ix->filename ) + 1;
+        if( ix->tags != NULL )
+            for( j = 0; j < ix->tag_count; j++ )
+                *index_bytes += sizeof(init_tag)
+                    + strlen( ix->tags[j].tag ) + 1;
+        /* segments are mapped and shared, so not counted */
+    }
+    for( file = defaults_list; file != NULL; file = file->next )
+    {
+        *index_bytes += sizeof(defaults_file)
+            + sizeof(defaults_block) * (double) file->block_count;
+        for( i = 0; i < file->block_count; i++ )
+        {
+            const paralist *t;
+
+            *index_bytes += (double) strlen( file->blocks[i].tag ) + 1;
+            for( t = file->blocks[i].list; t != NULL; t = t->next )
+                *index_bytes += sizeof(paralist);
+        }
+    }
+
+    pj_release_initcache_lock( 0 );
+
+    return bytes;
+}
+
 /************************************************************************/
 /*                            pj_clear_initcache()                      */
 /*                                                                      */
-/*      Clear out all memory held in the init file cache.               */
+/*      Clear out all memory held in the init file cache, and forget    */
+/*      where the files were found.                                     */
 /************************************************************************/
 
 void pj_clear_initcache()
 {
-    if( cache_alloc > 0 )
+    cache_clear( &init_table );
+    cache_clear( &defn_table );
+
+    if( index_count > 0 )
     {
         int i;
 
-        pj_acquire_lock();
+        pj_acquire_initcache_lock( 1 );
+
+        for( i = 0; i < index_count; i++ )
+        {
+            init_index_clear( index_list + i );
+            pj_dalloc( index_list[i].filename );
+        }
+        pj_dalloc( index_list );
+        index_list = NULL;
+        index_count = 0;
+
+        pj_release_initcache_lock( 1 );
+    }
+
+    pj_clear_defaults();
+    pj_clear_open_lib_cache();
+}
+
+/************************************************************************/
+/*                            pj_search_initcache()                     */
+/*                                                                      */
+/*      Search for a matching definition in the init cache.  The copy   */
+/*      returned is allocated from *arena, unless arena is NULL.        */
+/************************************************************************/
+
+paralist *pj_search_initcache( const char *filekey, PJ_ARENA **arena )
+
+{
+    paralist *result = cache_search( &init_table, filekey, arena );
+
+    PJ_TRACE2( initcache__lookup, filekey, result != NULL );
+    return result;
+}
+
+/************************************************************************/
+/*                            pj_insert_initcache()                     */
+/*                                                                      */
+/*      Insert a paralist definition in the init file cache, under     */
+/*      the limit of ctx, which may be NULL.                            */
+/************************************************************************/
+
+void pj_insert_initcache( projCtx ctx, const char *filekey,
+                          const paralist *list )
+
+{
+    cache_insert( ctx, &init_table, filekey, list );
+}
+
+/************************************************************************/
+/*                          pj_search_defncache()                       */
+/*                                                                      */
+/*      Search for the expanded parameters of a definition string,      */
+/*      as pj_search_initcache().                                       */
+/************************************************************************/
+
+paralist *pj_search_defncache( const char *definition, PJ_ARENA **arena )
+
+{
+    paralist *result = cache_search( &defn_table, definition, arena );
+
+    PJ_TRACE2( defncache__lookup, definition, result != NULL );
+    return result;
+}
+
+/************************************************************************/
+/*                          pj_insert_defncache()                       */
+/************************************************************************/
+
+void pj_insert_defncache( projCtx ctx, const char *definition,
+                          const paralist *list )
+
+{
+    cache_insert( ctx, &defn_table, definition, list );
+}
+
+/************************************************************************/
+/*                          pj_walk_initcache()                         */
+/*                                                                      */
+/*      Call walker with each key and list of the init file cache, or   */
+/*      of the definition cache if defn is TRUE, until it returns       */
+/*      FALSE.  Returns FALSE if it did.  The cache stays locked for    */
+/*      reading meanwhile, so walker must not insert into it.           */
+/************************************************************************/
+
+int pj_walk_initcache( int defn,
+                       int (*walker)( void *, const char *, const paralist * ),
+                       void *data )
+
+{
+    cache_table *table = defn ? &defn_table : &init_table;
+    int i, ok = 1;
+
+    pj_acquire_initcache_lock( 0 );
+
+    for( i = 0; i < table->count && ok; i++ )
+        ok = walker( data, table->slots[i].key, table->slots[i].list );
+
+    pj_release_initcache_lock( 0 );
+
+    return ok;
+}
+
+
+/* ==================================================================== */
+/*      Index of the <tag> definitions in each init file, so that      */
+/*      get_init() can seek straight to a definition instead of        */
+/*      scanning the whole file on every cache miss.                    */
+/* ==================================================================== */
+
+/************************************************************************/
+/*                          init_tag_compare()                          */
+/************************************************************************/
+
+static int init_tag_compare( const void *a, const void *b )
+
+{
+    const init_tag *ta = (const init_tag *) a;
+    const init_tag *tb = (const init_tag *) b;
+    int result = strcmp( ta->tag, tb->tag );
+
+    if( result == 0 )
+        result = (ta->offset > tb->offset) - (ta->offset < tb->offset);
+    return result;
+}
+
+static int init_tag_compare_tag( const void *a, const void *b )
+
+{
+    return strcmp( ((const init_tag *) a)->tag, ((const init_tag *) b)->tag );
+}
+
+/************************************************************************/
+/*                          init_index_clear()                          */
+/************************************************************************/
+
+static void init_index_clear( init_index *index )
+
+{
+    int i;
+
+    for( i = 0; i < index->tag_count && index->tags != NULL; i++ )
+        pj_dalloc( index->tags[i].tag );
+    pj_dalloc( index->tags );
+    index->tags = NULL;
+    index->tag_count = 0;
+
+    pj_shm_release( index->shm );
+    index->shm = NULL;
+    index->shm_tags = NULL;
+    index->shm_pool = NULL;
+}
+
+/************************************************************************/
+/*                          init_index_find()                           */
+/*                                                                      */
+/*      The offset of the definition of tag, or -1 if there is none.    */
+/************************************************************************/
+
+static long init_index_find( const init_index *index, const char *tag )
+
+{
+    init_tag key, *found;
+    int lo = 0, hi = index->tag_count;
+
+    if( index->shm == NULL )
+    {
+        key.tag = (char *) tag;
+        key.offset = 0;
+        found = (init_tag *) bsearch( &key, index->tags, index->tag_count,
+                                      sizeof(init_tag), init_tag_compare_tag );
+        return found == NULL ? -1 : found->offset;
+    }
+
+    while( lo < hi )
+    {
+        int mid = lo + (hi - lo) / 2;
+        int result = strcmp( tag, index->shm_pool + index->shm_tags[mid].tag );
+
+        if( result == 0 )
+            return index->shm_tags[mid].offset;
+        if( result < 0 )
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    return -1;
+}
+
+/************************************************************************/
+/*                           init_index_key()                           */
+/*                                                                      */
+/*      The key of the shared segment of the index of an init file,     */
+/*      or FALSE if it is not to be shared.                             */
+/************************************************************************/
+
+static int init_index_key( projCtx ctx, PAFile fid, const char *filename,
+                           char *key )
+
+{
+    double id[4];
+
+    if( !ctx->init_shm || strlen( filename ) > PJ_SHM_KEY_MAX - 100 
+        || !pj_ctx_fidentity( ctx, fid, id ) )
+        return 0;
+
+    sprintf( key, "init|%.0f|%.0f|%.0f|%.0f|%d|%s", id[0], id[1], id[2],
+             id[3], (int) sizeof(init_shm_tag), filename );
+    return 1;
+}
+
+/************************************************************************/
+/*                          init_index_attach()                         */
+/*                                                                      */
+/*      Use the index of the file made by another process, if any.      */
+/************************************************************************/
+
+static int init_index_attach( projCtx ctx, PAFile fid, const char *filename,
+                              init_index *index )
+
+{
+    char key[PJ_SHM_KEY_MAX];
+    PJ_SHM *shm;
+    const long *count;
+    size_t size;
+
+    if( !init_index_key( ctx, fid, filename, key )
+        || (shm = pj_shm_attach( "init", key )) == NULL )
+        return 0;
+
+    count = (const long *) pj_shm_data( shm );
+    size = pj_shm_size( shm );
+    if( size < sizeof(init_shm_tag) || *count < 0 
+        || (size_t) *count > (size - sizeof(init_shm_tag))
+                              / sizeof(init_shm_tag) )
+    {
+        pj_shm_release( shm );
+        return 0;
+    }
+
+    index->shm = shm;
+    index->shm_tags = ((const init_shm_tag *) count) + 1;
+    index->shm_pool = (const char *) (index->shm_tags + *count);
+    index->tag_count = (int) *count;
+
+    pj_log( ctx, PJ_LOG_DEBUG_MINOR, "Mapped %d definitions of %s from %s",
+            index->tag_count, filename, pj_shm_get_name( shm ) );
+    return 1;
+}
+
+/************************************************************************/
+/*                          init_index_share()                          */
+/*                                                                      */
+/*      Copy the index just built into a shared segment, as a count,    */
+/*      the tags in order and a pool of their names, for the other      */
+/*      processes to map, and use it from there.                        */
+/************************************************************************/
+
+static void init_index_share( projCtx ctx, PAFile fid, const char *filename,
+                              init_index *index )
+
+{
+    char key[PJ_SHM_KEY_MAX], *pool;
+    init_shm_tag *tags;
+    size_t size, pos = 0;
+    PJ_SHM *shm;
+    int i, count = index->tag_count;
+
+    if( !init_index_key( ctx, fid, filename, key ) )
+        return;
 
-        for( i = 0; i < cache_count; i++ )
+    size = sizeof(init_shm_tag) * (count + 1);
+    for( i = 0; i < count; i++ )
+        size += strlen( index->tags[i].tag ) + 1;
+
+    if( (shm = pj_shm_create( "init", key, size )) == NULL )
+        return;
+
+    tags = (init_shm_tag *) pj_shm_data( shm );
+    *(long *) tags = count;
+    tags++;
+    pool = (char *) (tags + count);
+    for( i = 0; i < count; i++ )
+    {
+        tags[i].offset = index->tags[i].offset;
+        tags[i].tag = (long) pos;
+        strcpy( pool + pos, index->tags[i].tag );
+        pos += strlen( index->tags[i].tag ) + 1;
+    }
+    pj_shm_ready( shm );
+
+    init_index_clear( index );
+    index->shm = shm;
+    index->shm_tags = tags;
+    index->shm_pool = pool;
+    index->tag_count = count;
+}
+
+/************************************************************************/
+/*                          init_index_build()                          */
+/*                                                                      */
+/*      Scan the file once, following the same rules as get_opt() in    */
+/*      pj_init.c: tags only start a word, and comments and the rest    */
+/*      of the line after a tag are ignored.  Returns FALSE if the      */
+/*      file could not be indexed.                                      */
+/************************************************************************/
+
+static int init_index_build( projCtx ctx, PAFile fid, init_index *index )
+
+{
+    char buffer[8192], tag[INIT_TAG_MAX+1];
+    size_t buffer_filled = 0, pos = 0;
+    long buffer_offset = 0, tag_offset = 0;
+    int tag_alloc = 0, tag_len = 0;
+    enum { AT_SPACE, IN_WORD, TO_EOL, IN_TAG } state = AT_SPACE;
+
+    index->tag_count = 0;
+    index->tags = NULL;
+
+    pj_ctx_fseek( ctx, fid, 0, SEEK_SET );
+
+    for( ;; pos++ )
+    {
+        int c;
+
+        if( pos == buffer_filled )
+        {
+            buffer_offset += buffer_filled;
+            buffer_filled = pj_ctx_fread( ctx, buffer, 1, sizeof(buffer), fid );
+            pos = 0;
+            if( buffer_filled == 0 )
+                break;
+        }
+
+        c = (unsigned char) buffer[pos];
+        if( c == '\0' )
+            break;
+
+        switch( state )
         {
-            paralist *n, *t = cache_paralist[i];
-		
-            pj_dalloc( cache_key[i] );
+          case AT_SPACE:
+            if( isspace(c) )
+                break;
+            if( c == '#' )
+                state = TO_EOL;
+            else if( c == '<' )
+            {
+                state = IN_TAG;
+                tag_len = 0;
+                tag_offset = buffer_offset + (long) pos;
+            }
+            else
+                state = IN_WORD;
+            break;
+
+          case IN_WORD:
+            if( isspace(c) )
+                state = AT_SPACE;
+            break;
+
+          case TO_EOL:
+            if( c == '\n' )
+                state = AT_SPACE;
+            break;
+
+          case IN_TAG:
+            if( c == '\n' )
+            {
+                state = AT_SPACE;
+                break;
+            }
+            if( c != '>' )
+            {
+                if( tag_len == INIT_TAG_MAX )
+                {
+                    init_index_clear( index );
+                    return 0;
+                }
+                tag[tag_len++] = (char) c;
+                break;
+            }
+
+            if( index->tag_count == tag_alloc )
+            {
+                init_tag *new_tags;
+
+                tag_alloc = tag_alloc * 2 + 256;
+                new_tags = (init_tag *) pj_malloc(sizeof(init_tag) * tag_alloc);
+                if( new_tags == NULL )
+                {
+                    init_index_clear( index );
+                    return 0;
+                }
+                if( index->tag_count > 0 )
+                    memcpy( new_tags, index->tags, 
+                            sizeof(init_tag) * index->tag_count );
+                pj_dalloc( index->tags );
+                index->tags = new_tags;
+            }
 
-            /* free parameter list elements */
-            for (; t != NULL; t = n) {
-                n = t->next;
-                pj_dalloc(t);
+            tag[tag_len] = '\0';
+            index->tags[index->tag_count].tag = 
+                (char *) pj_malloc(tag_len + 1);
+            if( index->tags[index->tag_count].tag == NULL )
+            {
+                init_index_clear( index );
+                return 0;
             }
+            strcpy( index->tags[index->tag_count].tag, tag );
+            index->tags[index->tag_count].offset = tag_offset;
+            index->tag_count++;
+            state = TO_EOL;
+            break;
         }
+    }
 
-        pj_dalloc( cache_key );
-        pj_dalloc( cache_paralist );
-        cache_count = 0;
-        cache_alloc= 0;
-        cache_key = NULL;
-        cache_paralist = NULL;
+/* -------------------------------------------------------------------- */
+/*      Sort, keeping only the first definition of each tag as that     */
+/*      is the one get_opt() would find.                                */
+/* -------------------------------------------------------------------- */
+    if( index->tag_count > 0 )
+    {
+        int i, kept = 1;
 
-        pj_release_lock();
+        qsort( index->tags, index->tag_count, sizeof(init_tag),
+               init_tag_compare );
+        for( i = 1; i < index->tag_count; i++ )
+        {
+            if( strcmp(index->tags[i].tag, index->tags[kept-1].tag) == 0 )
+                pj_dalloc( index->tags[i].tag );
+            else
+                index->tags[kept++] = index->tags[i];
+        }
+        index->tag_count = kept;
     }
+
+    return 1;
 }
 
 /************************************************************************/
-/*                            pj_search_initcache()                     */
+/*                         pj_seek_init_tag()                           */
 /*                                                                      */
-/*      Search for a matching definition in the init cache.             */
+/*      Position fid, an open init file, at the definition of tag.      */
+/*      Returns 1 if positioned at the tag, 0 if the file has no such   */
+/*      definition, or -1 if the caller has to scan from the start      */
+/*      (the file was rewound), for instance when text mode offsets     */
+/*      do not match byte counts on this platform.  The index is        */
+/*      built on first use and rebuilt if the file size changes, or     */
+/*      with pj_ctx_set_init_shm() mapped from another process that     */
+/*      built it.                                                       */
 /************************************************************************/
 
-paralist *pj_search_initcache( const char *filekey )
+int pj_seek_init_tag( projCtx ctx, const char *filename, PAFile fid,
+                      const char *tag )
+
+{
+    init_index *index = NULL;
+    long offset;
+    char check[INIT_TAG_MAX+3];
+    size_t len = strlen(tag);
+    long size;
+    int i, exclusive;
+
+    if( len > INIT_TAG_MAX 
+        || pj_ctx_fseek( ctx, fid, 0, SEEK_END ) != 0 )
+    {
+        pj_ctx_fseek( ctx, fid, 0, SEEK_SET );
+        return -1;
+    }
+    size = pj_ctx_ftell( ctx, fid );
+
+/* -------------------------------------------------------------------- */
+/*      Look the index up with the lock shared, and only take it        */
+/*      exclusively to add or refresh it.                               */
+/* -------------------------------------------------------------------- */
+    for( exclusive = 0; ; exclusive = 1 )
+    {
+        pj_acquire_initcache_lock( exclusive );
+
+        for( i = 0; i < index_count; i++ )
+        {
+            if( strcmp(index_list[i].filename, filename) == 0 )
+            {
+                index = index_list + i;
+                break;
+            }
+        }
+
+        if( (index != NULL && index->size == size) || exclusive )
+            break;
+
+        pj_release_initcache_lock( exclusive );
+        index = NULL;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Add a new index, or refresh it if the file has changed.         */
+/* -------------------------------------------------------------------- */
+    if( index == NULL )
+    {
+        init_index *new_list = (init_index *)
+            pj_malloc(sizeof(init_index) * (index_count + 1));
+        char *new_name = (char *) pj_malloc(strlen(filename) + 1);
+
+        if( new_list == NULL || new_name == NULL )
+        {
+            pj_dalloc( new_list );
+            pj_dalloc( new_name );
+            pj_release_initcache_lock( exclusive );
+            pj_ctx_fseek( ctx, fid, 0, SEEK_SET );
+            return -1;
+        }
+        if( index_count > 0 )
+            memcpy( new_list, index_list, sizeof(init_index) * index_count );
+        pj_dalloc( index_list );
+        index_list = new_list;
+
+        index = index_list + index_count++;
+        strcpy( new_name, filename );
+        index->filename = new_name;
+        index->size = -1;
+        index->tag_count = 0;
+        index->tags = NULL;
+        index->shm = NULL;
+        index->shm_tags = NULL;
+        index->shm_pool = NULL;
+    }
+
+    if( index->size != size )
+    {
+        init_index_clear( index );
+
+        if( !init_index_attach( ctx, fid, filename, index ) )
+        {
+            if( !init_index_build( ctx, fid, index ) )
+            {
+                /* retried on the next lookup */
+                index->size = -1;
+                pj_release_initcache_lock( exclusive );
+                pj_ctx_fseek( ctx, fid, 0, SEEK_SET );
+                return -1;
+            }
+
+            pj_log( ctx, PJ_LOG_DEBUG_MINOR, "Indexed %d definitions of %s",
+                    index->tag_count, filename );
+            init_index_share( ctx, fid, filename, index );
+        }
+        index->size = size;
+    }
+
+    offset = init_index_find( index, tag );
+    if( offset < 0 )
+    {
+        pj_release_initcache_lock( exclusive );
+        pj_ctx_fseek( ctx, fid, 0, SEEK_SET );
+        return 0;
+    }
+
+    pj_release_initcache_lock( exclusive );
+
+/* -------------------------------------------------------------------- */
+/*      Check that the tag really is where we expect it.                */
+/* -------------------------------------------------------------------- */
+    if( pj_ctx_fseek( ctx, fid, offset, SEEK_SET ) == 0
+        && pj_ctx_fread( ctx, check, 1, len + 2, fid ) == len + 2
+        && check[0] == '<' && strncmp(check+1, tag, len) == 0 
+        && check[len+1] == '>' )
+    {
+        pj_ctx_fseek( ctx, fid, offset, SEEK_SET );
+        return 1;
+    }
+
+    pj_ctx_fseek( ctx, fid, 0, SEEK_SET );
+    return -1;
+}
+
+
+/* ==================================================================== */
+/*      Parsed copy of the defaults file, so that pj_init() does not   */
+/*      open and scan proj_def.dat for every definition.                */
+/* ==================================================================== */
+
+/************************************************************************/
+/*                         defaults_file_free()                         */
+/************************************************************************/
+
+static void defaults_file_free( defaults_file *file )
 
 {
     int i;
-    paralist *result = NULL;
 
-    pj_acquire_lock();
+    for( i = 0; i < file->block_count; i++ )
+    {
+        pj_dalloc( file->blocks[i].tag );
+        cache_free_list( file->blocks[i].list );
+    }
+    pj_dalloc( file->blocks );
+    pj_dalloc( file );
+}
 
-    for( i = 0; result == NULL && i < cache_count; i++)
+/************************************************************************/
+/*                         defaults_add_block()                         */
+/*                                                                      */
+/*      Returns the new block, or NULL if out of memory.                */
+/************************************************************************/
+
+static defaults_block *defaults_add_block( defaults_file *file, 
+                                           const char *tag, int *alloc )
+
+{
+    defaults_block *block;
+
+    if( file->block_count == *alloc )
     {
-        if( strcmp(filekey,cache_key[i]) == 0 )
-	{
-            result = pj_clone_paralist( cache_paralist[i] );
-	}
+        defaults_block *new_blocks;
+
+        *alloc = *alloc * 2 + 32;
+        new_blocks = (defaults_block *) 
+            pj_malloc(sizeof(defaults_block) * *alloc);
+        if( new_blocks == NULL )
+            return NULL;
+        if( file->block_count > 0 )
+            memcpy( new_blocks, file->blocks, 
+                    sizeof(defaults_block) * file->block_count );
+        pj_dalloc( file->blocks );
+        file->blocks = new_blocks;
     }
 
-    pj_release_lock();
+    block = file->blocks + file->block_count;
+    block->tag = (char *) pj_malloc(strlen(tag) + 1);
+    if( block->tag == NULL )
+        return NULL;
+    strcpy( block->tag, tag );
+    block->list = NULL;
+    file->block_count++;
 
-    return result;
+    return block;
 }
 
 /************************************************************************/
-/*                            pj_insert_initcache()                     */
+/*                           defaults_parse()                           */
 /*                                                                      */
-/*      Insert a paralist definition in the init file cache.            */
+/*      Split the file into its <tag> blocks, following the rules of    */
+/*      get_opt() in pj_init.c: a block runs from its tag to the next   */
+/*      tag, a leading '+' is dropped from parameters, and only the     */
+/*      first block of a given tag is kept.  Returns FALSE if out of    */
+/*      memory.                                                         */
 /************************************************************************/
 
-void pj_insert_initcache( const char *filekey, const paralist *list )
+static int defaults_parse( projCtx ctx, PAFile fid, defaults_file *file )
 
 {
-    pj_acquire_lock();
+    char buffer[8192], word[DEFAULTS_WORD_MAX+1];
+    size_t buffer_filled = 0, pos = 0;
+    int block_alloc = 0, word_len = 0, i;
+    defaults_block *block = NULL;
+    paralist *last = NULL;
+    enum { AT_SPACE, IN_WORD, TO_EOL, IN_TAG } state = AT_SPACE;
 
-    /* 
-    ** Grow list if required.
-    */
-    if( cache_count == cache_alloc )
+    for( ;; pos++ )
     {
-        char **cache_key_new;
-        paralist **cache_paralist_new;
+        int c;
+
+        if( pos == buffer_filled )
+        {
+            buffer_filled = pj_ctx_fread( ctx, buffer, 1, sizeof(buffer), fid );
+            pos = 0;
+            if( buffer_filled == 0 )
+                c = '\0';
+            else
+                c = (unsigned char) buffer[pos];
+        }
+        else
+            c = (unsigned char) buffer[pos];
+
+        if( state == IN_WORD && (c == '\0' || isspace(c)) && block != NULL )
+        {
+            paralist *item;
+
+            word[word_len] = '\0';
+            item = pj_mkparam( word[0] == '+' ? word + 1 : word );
+            if( item == NULL )
+                return 0;
+            if( last == NULL )
+                block->list = item;
+            else
+                last->next = item;
+            last = item;
+        }
+        if( state == IN_WORD && (c == '\0' || isspace(c)) )
+            state = AT_SPACE;
+
+        if( c == '\0' )
+            break;
+
+        switch( state )
+        {
+          case AT_SPACE:
+            if( isspace(c) )
+                break;
+            if( c == '#' )
+                state = TO_EOL;
+            else if( c == '<' )
+            {
+                /* any tag ends the current block */
+                block = NULL;
+                last = NULL;
+                state = IN_TAG;
+                word_len = 0;
+            }
+            else
+            {
+                /* words outside of a block are skipped */
+                state = IN_WORD;
+                word[0] = (char) c;
+                word_len = 1;
+            }
+            break;
 
-        cache_alloc = cache_alloc * 2 + 15;
+          case IN_WORD:
+            if( word_len < DEFAULTS_WORD_MAX )
+                word[word_len++] = (char) c;
+            break;
 
-        cache_key_new = (char **) pj_malloc(sizeof(char*) * cache_alloc);
-        memcpy( cache_key_new, cache_key, sizeof(char*) * cache_count);
-        pj_dalloc( cache_key );
-        cache_key = cache_key_new;
+          case TO_EOL:
+            if( c == '\n' )
+                state = AT_SPACE;
+            break;
 
-        cache_paralist_new = (paralist **) 
-            pj_malloc(sizeof(paralist*) * cache_alloc);
-        memcpy( cache_paralist_new, cache_paralist, 
-                sizeof(paralist*) * cache_count );
-        pj_dalloc( cache_paralist );
-        cache_paralist = cache_paralist_new;
+          case IN_TAG:
+            if( c == '\n' )
+            {
+                state = AT_SPACE;
+                break;
+            }
+            if( c != '>' )
+            {
+                if( word_len < DEFAULTS_WORD_MAX )
+                    word[word_len++] = (char) c;
+                break;
+            }
+
+            word[word_len] = '\0';
+            for( i = 0; i < file->block_count; i++ )
+                if( strcmp(file->blocks[i].tag, word) == 0 )
+                    break;
+
+            if( i == file->block_count )
+            {
+                block = defaults_add_block( file, word, &block_alloc );
+                if( block == NULL )
+                    return 0;
+            }
+            state = AT_SPACE;
+            break;
+        }
     }
 
-    /*
-    ** Duplicate the filekey and paralist, and insert in cache.
-    */
-    cache_key[cache_count] = (char *) pj_malloc(strlen(filekey)+1);
-    strcpy( cache_key[cache_count], filekey );
+    return 1;
+}
+
+/************************************************************************/
+/*                           defaults_load()                            */
+/*                                                                      */
+/*      Read proj_def.dat through the file api of ctx.  A missing       */
+/*      file gives an empty set of blocks, so that we don't search      */
+/*      for it again.  Returns NULL if out of memory.                   */
+/************************************************************************/
+
+static defaults_file *defaults_load( projCtx ctx )
+
+{
+    defaults_file *file;
+    const PJ_INIT_DB_ENTRY *entries;
+    PAFile fid;
+    int count, block_alloc = 0, i, j;
+
+    file = (defaults_file *) pj_malloc(sizeof(defaults_file));
+    if( file == NULL )
+        return NULL;
+    file->fileapi = ctx->fileapi;
+    file->block_count = 0;
+    file->blocks = NULL;
+    file->next = NULL;
+
+/* -------------------------------------------------------------------- */
+/*      Copy the blocks of a proj_def.dat built into the library.       */
+/* -------------------------------------------------------------------- */
+    if( (entries = pj_init_db_file( "proj_def.dat", &count )) != NULL )
+    {
+        for( i = 0; i < count; i++ )
+        {
+            defaults_block *block = 
+                defaults_add_block( file, pj_init_db_tag( entries + i ), 
+                                    &block_alloc );
+            paralist *last = NULL;
+
+            if( block == NULL )
+            {
+                defaults_file_free( file );
+                return NULL;
+            }
+
+            for( j = 0; j < entries[i].count; j++ )
+            {
+                paralist *item = pj_mkparam( (char *) 
+                                    pj_init_db_param( entries + i, j ) );
+
+                if( item == NULL )
+                {
+                    defaults_file_free( file );
+                    return NULL;
+                }
+                if( last == NULL )
+                    block->list = item;
+                else
+                    last->next = item;
+                last = item;
+            }
+        }
+    }
+
+    else if( (fid = pj_open_lib(ctx, "proj_def.dat", "rt")) != NULL )
+    {
+        int ok = defaults_parse( ctx, fid, file );
+
+        pj_ctx_fclose( ctx, fid );
+        if( !ok )
+        {
+            defaults_file_free( file );
+            return NULL;
+        }
+    }
+
+    pj_log( ctx, PJ_LOG_DEBUG_MINOR, "Loaded %d blocks of proj_def.dat",
+            file->block_count );
+
+    return file;
+}
+
+/************************************************************************/
+/*                         pj_search_defaults()                         */
+/*                                                                      */
+/*      Return a copy of the parameters of the <tag> block of           */
+/*      proj_def.dat as found through the file api of ctx, or NULL      */
+/*      if there is no such block.  The file is only read the first     */
+/*      time, until pj_clear_defaults() is called.                      */
+/************************************************************************/
+
+paralist *pj_search_defaults( projCtx ctx, const char *tag )
+
+{
+    defaults_file *file;
+    paralist *result = NULL;
+    int i;
+
+    pj_acquire_initcache_lock( 0 );
 
-    cache_paralist[cache_count] = pj_clone_paralist( list );
+    for( file = defaults_list; file != NULL; file = file->next )
+    {
+        if( file->fileapi == ctx->fileapi )
+            break;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Load the file outside of the lock, and add it unless another    */
+/*      thread got there first.                                         */
+/* -------------------------------------------------------------------- */
+    if( file == NULL )
+    {
+        defaults_file *new_file, *other;
+
+        pj_release_initcache_lock( 0 );
+
+        new_file = defaults_load( ctx );
+        if( new_file == NULL )
+            return NULL;
+
+        pj_acquire_initcache_lock( 1 );
+        for( other = defaults_list; other != NULL; other = other->next )
+        {
+            if( other->fileapi == ctx->fileapi )
+                break;
+        }
+        if( other == NULL )
+        {
+            new_file->next = defaults_list;
+            defaults_list = new_file;
+        }
+        else
+            defaults_file_free( new_file );
+        pj_release_initcache_lock( 1 );
 
-    cache_count++;
+        return pj_search_defaults( ctx, tag );
+    }
 
-    pj_release_lock();
+    for( i = 0; i < file->block_count; i++ )
+    {
+        if( strcmp(file->blocks[i].tag, tag) == 0 )
+        {
+            result = pj_clone_paralist( file->blocks[i].list, NULL );
+            break;
+        }
+    }
+
+    pj_release_initcache_lock( 0 );
+
+    return result;
 }
 
+/************************************************************************/
+/*                         pj_clear_defaults()                          */
+/*                                                                      */
+/*      Forget the parsed defaults files, for instance because the      */
+/*      search path has changed.                                        */
+/************************************************************************/
+
+void pj_clear_defaults()
+
+{
+    pj_acquire_initcache_lock( 1 );
+
+    while( defaults_list != NULL )
+    {
+        defaults_file *next = defaults_list->next;
+
+        defaults_file_free( defaults_list );
+        defaults_list = next;
+    }
+
+    pj_release_initcache_lock( 1 );
+}
@@ -0,0 +1,140 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Lookup of the init file definitions built into the library.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <projects.h>
+#include <string.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** With PJ_EMBED_INIT defined, as by the EMBED_INIT_FILES cmake option,
+** the epsg, esri, IGNF and proj_def.dat files are compiled by init2c
+** into pj_init_db_embedded, and get_init() and the defaults of
+** pj_init() read their definitions from it without any file i/o.  An
+** embedded file hides any file of the same name on the search path;
+** such a file is still read if given with a path, as in
+** +init=./epsg:4326.
+*/
+
+#ifdef PJ_EMBED_INIT
+extern const PJ_INIT_DB pj_init_db_embedded;
+#define INIT_DB (&pj_init_db_embedded)
+#else
+static const PJ_INIT_DB init_db_none = { 0, NULL, 0, NULL, NULL, NULL };
+#define INIT_DB (&init_db_none)
+#endif
+
+/************************************************************************/
+/*                          pj_init_db_file()                           */
+/*                                                                      */
+/*      The definitions of an embedded init file, sorted by tag, and    */
+/*      their count.  NULL if the file is not embedded.                 */
+/************************************************************************/
+
+const PJ_INIT_DB_ENTRY *pj_init_db_file( const char *file, int *count )
+
+{
+    const PJ_INIT_DB *db = INIT_DB;
+    int lo = 0, hi = db->entry_count, i, f;
+
+    for( f = 0; f < db->file_count; f++ )
+        if( strcmp( db->files[f], file ) == 0 )
+            break;
+    if( f == db->file_count )
+        return NULL;
+
+    /* the first entry of the file */
+    while( lo < hi )
+    {
+        int mid = (lo + hi) / 2;
+
+        if( db->entries[mid].file < f )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for( i = lo; i < db->entry_count && db->entries[i].file == f; i++ ) {}
+    *count = i - lo;
+
+    return db->entries + lo;
+}
+
+/************************************************************************/
+/*                          pj_init_db_find()                           */
+/*                                                                      */
+/*      The <tag> definition of an embedded init file, or NULL.         */
+/************************************************************************/
+
+const PJ_INIT_DB_ENTRY *pj_init_db_find( const char *file, const char *tag )
+
+{
+    const PJ_INIT_DB_ENTRY *entries;
+    int lo = 0, hi;
+
+    entries = pj_init_db_file( file, &hi );
+    if( entries == NULL )
+        return NULL;
+
+    while( lo < hi )
+    {
+        int mid = (lo + hi) / 2;
+        int result = strcmp( pj_init_db_tag( entries + mid ), tag );
+
+        if( result == 0 )
+            return entries + mid;
+        if( result < 0 )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return NULL;
+}
+
+/************************************************************************/
+/*                           pj_init_db_tag()                           */
+/************************************************************************/
+
+const char *pj_init_db_tag( const PJ_INIT_DB_ENTRY *entry )
+
+{
+    return INIT_DB->strings + entry->tag;
+}
+
+/************************************************************************/
+/*                          pj_init_db_param()                          */
+/*                                                                      */
+/*      Parameter i of a definition, without a leading '+'.             */
+/************************************************************************/
+
+const char *pj_init_db_param( const PJ_INIT_DB_ENTRY *entry, int i )
+
+{
+    return INIT_DB->strings + INIT_DB->params[entry->first + i];
+}
@@ -0,0 +1,418 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Save the init and definition caches to a snapshot file, and
+ *           load them back for a fast warm start.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+
+#include <projects.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** A snapshot holds the entries of the init file cache and of the
+** pj_init_plus_cached() definition cache, so that a process can load
+** what another one expanded from the init and defaults files, and then
+** set up each cached definition without reading any of them.  The set
+** up of the projections themselves is not saved, as their private data
+** holds pointers and may depend on the grids found at run time, but it
+** only takes microseconds.
+**
+** All numbers are 32 bit little endian:
+**
+**     "PJSNAP\r\n" magic, version, entry count, and for each entry:
+**     kind (0 init, 1 definition), key length, key, parameter count,
+**     and the length and text of each parameter.
+**
+** Strings are not nul terminated.  A snapshot is read all at once, and
+** is checked in full before any of its entries are inserted.
+*/
+
+#define SNAP_MAGIC    "PJSNAP\r\n"
+#define SNAP_VERSION  1
+
+typedef struct {
+    unsigned char *data;
+    size_t size, alloc;
+    int    count;
+    int    kind;
+    int    failed;
+} snap_buffer;
+
+/************************************************************************/
+/*                              snap_put()                              */
+/************************************************************************/
+
+static void snap_put( snap_buffer *buf, const void *data, size_t size )
+
+{
+    if( buf->failed )
+        return;
+
+    if( buf->size + size > buf->alloc )
+    {
+        size_t new_alloc = buf->alloc * 2 + size + 65536;
+        unsigned char *new_data = (unsigned char *) pj_malloc( new_alloc );
+
+        if( new_data == NULL )
+        {
+            buf->failed = 1;
+            return;
+        }
+        if( buf->size > 0 )
+            memcpy( new_data, buf->data, buf->size );
+        pj_dalloc( buf->data );
+        buf->data = new_data;
+        buf->alloc = new_alloc;
+    }
+    memcpy( buf->data + buf->size, data, size );
+    buf->size += size;
+}
+
+static void snap_put_u32( snap_buffer *buf, unsigned long value )
+
+{
+    unsigned char bytes[4];
+
+    bytes[0] = (unsigned char) (value & 0xff);
+    bytes[1] = (unsigned char) ((value >> 8) & 0xff);
+    bytes[2] = (unsigned char) ((value >> 16) & 0xff);
+    bytes[3] = (unsigned char) ((value >> 24) & 0xff);
+    snap_put( buf, bytes, 4 );
+}
+
+static void snap_put_string( snap_buffer *buf, const char *s )
+
+{
+    size_t len = strlen( s );
+
+    snap_put_u32( buf, (unsigned long) len );
+    snap_put( buf, s, len );
+}
+
+/************************************************************************/
+/*                             snap_entry()                             */
+/*                                                                      */
+/*      pj_walk_initcache() callback adding an entry.                   */
+/************************************************************************/
+
+static int snap_entry( void *data, const char *key, const paralist *list )
+
+{
+    snap_buffer *buf = (snap_buffer *) data;
+    const paralist *item;
+    unsigned long count = 0;
+
+    for( item = list; item != NULL; item = item->next )
+        count++;
+
+    snap_put_u32( buf, (unsigned long) buf->kind );
+    snap_put_string( buf, key );
+    snap_put_u32( buf, count );
+    for( item = list; item != NULL; item = item->next )
+        snap_put_string( buf, pj_param_text( (paralist *) item ) );
+    buf->count++;
+
+    return !buf->failed;
+}
+
+/************************************************************************/
+/*                          pj_save_initcache()                         */
+/*                                                                      */
+/*      Write the init and definition caches to filename, replacing     */
+/*      it only once the snapshot is complete.  Returns the number      */
+/*      of entries written, or -1 with the context errno set.           */
+/************************************************************************/
+
+int pj_save_initcache( projCtx ctx, const char *filename )
+
+{
+    snap_buffer buf;
+    size_t size;
+    char *tmp;
+    FILE *fp;
+    int ok;
+
+    if( ctx == NULL )
+        ctx = pj_get_default_ctx();
+
+    memset( &buf, 0, sizeof(buf) );
+    snap_put( &buf, SNAP_MAGIC, 8 );
+    snap_put_u32( &buf, SNAP_VERSION );
+    snap_put_u32( &buf, 0 );        /* entry count, filled in below */
+
+    buf.kind = 0;
+    pj_walk_initcache( 0, snap_entry, &buf );
+    buf.kind = 1;
+    pj_walk_initcache( 1, snap_entry, &buf );
+
+    tmp = (char *) pj_malloc( strlen(filename) + 5 );
+    if( buf.failed || tmp == NULL )
+    {
+        pj_dalloc( buf.data );
+        pj_dalloc( tmp );
+        pj_ctx_set_errno( ctx, ENOMEM );
+        return -1;
+    }
+    size = buf.size;
+    buf.size = 12;
+    snap_put_u32( &buf, (unsigned long) buf.count );
+    buf.size = size;
+
+/* -------------------------------------------------------------------- */
+/*      Write to a temporary file renamed over the target, so that      */
+/*      readers never see a partial snapshot.                           */
+/* -------------------------------------------------------------------- */
+    sprintf( tmp, "%s.tmp", filename );
+    fp = fopen( tmp, "wb" );
+    ok = fp != NULL;
+    if( ok )
+    {
+        ok = fwrite( buf.data, 1, buf.size, fp ) == buf.size;
+        ok = fclose( fp ) == 0 && ok;
+#ifdef _WIN32
+        if( ok )
+            remove( filename );
+#endif
+        if( !ok || rename( tmp, filename ) != 0 )
+        {
+            remove( tmp );
+            ok = 0;
+        }
+    }
+
+    pj_dalloc( buf.data );
+    pj_dalloc( tmp );
+
+    if( !ok )
+    {
+        pj_ctx_set_errno( ctx, errno ? errno : EIO );
+        return -1;
+    }
+
+    return buf.count;
+}
+
+/************************************************************************/
+/*                            snap_get_u32()                            */
+/************************************************************************/
+
+static int snap_get_u32( const unsigned char **p, const unsigned char *end,
+                         unsigned long *value )
+
+{
+    if( end - *p < 4 )
+        return 0;
+    *value = (unsigned long) (*p)[0] | ((unsigned long) (*p)[1] << 8)
+        | ((unsigned long) (*p)[2] << 16) | ((unsigned long) (*p)[3] << 24);
+    *p += 4;
+    return 1;
+}
+
+/************************************************************************/
+/*                            snap_entries()                            */
+/*                                                                      */
+/*      Check the entries of a snapshot, inserting them in the caches   */
+/*      if insert is TRUE.  Returns FALSE if the snapshot is invalid,   */
+/*      or if a list could not be allocated.                            */
+/************************************************************************/
+
+static int snap_entries( projCtx ctx, const unsigned char *p,
+                         const unsigned char *end, unsigned long count,
+                         int insert )
+
+{
+    char *text = NULL;
+    size_t text_alloc = 0;
+    unsigned long e, i;
+    int ok = 1;
+
+    for( e = 0; e < count && ok; e++ )
+    {
+        unsigned long kind, key_len, param_count, len;
+        const unsigned char *key;
+        paralist *start = NULL, *curr = NULL;
+
+        ok = snap_get_u32( &p, end, &kind ) && kind <= 1
+            && snap_get_u32( &p, end, &key_len )
+            && (unsigned long) (end - p) >= key_len;
+        if( !ok )
+            break;
+        key = p;
+        p += key_len;
+        ok = snap_get_u32( &p, end, &param_count ) && param_count > 0;
+
+        for( i = 0; ok && i < param_count; i++ )
+        {
+            ok = snap_get_u32( &p, end, &len )
+                && (unsigned long) (end - p) >= len;
+            if( !ok || !insert )
+            {
+                p += ok ? len : 0;
+                continue;
+            }
+
+            if( len + 1 > text_alloc )
+            {
+                pj_dalloc( text );
+                text_alloc = len + 1 > 256 ? len + 1 : 256;
+                if( (text = (char *) pj_malloc( text_alloc )) == NULL )
+                {
+                    text_alloc = 0;
+                    ok = 0;
+                    break;
+                }
+            }
+            memcpy( text, p, len );
+            text[len] = '\0';
+            p += len;
+
+            if( curr )
+                curr = curr->next = pj_mkparam( text );
+            else
+                start = curr = pj_mkparam( text );
+            ok = curr != NULL;
+        }
+
+        if( ok && insert )
+        {
+            char *keytext = (char *) pj_malloc( key_len + 1 );
+
+            ok = keytext != NULL;
+            if( ok )
+            {
+                memcpy( keytext, key, key_len );
+                keytext[key_len] = '\0';
+                if( kind == 0 )
+                    pj_insert_initcache( ctx, keytext, start );
+                else
+                    pj_insert_defncache( ctx, keytext, start );
+                pj_dalloc( keytext );
+            }
+        }
+        pj_free_paralist( start );
+    }
+
+    pj_dalloc( text );
+
+    return ok && (insert || p == end);
+}
+
+/************************************************************************/
+/*                          pj_load_initcache()                         */
+/*                                                                      */
+/*      Insert the entries of a snapshot written by                     */
+/*      pj_save_initcache() in the caches, reading the file with the    */
+/*      context file api, mapped if the context maps files.  Returns    */
+/*      the number of entries, or -1 with the context errno set: -51    */
+/*      if the file is not a snapshot of this version, and is then      */
+/*      left unused.                                                    */
+/************************************************************************/
+
+int pj_load_initcache( projCtx ctx, const char *filename )
+
+{
+    PAFile fid;
+    long size;
+    unsigned char *data = NULL;
+    void *handle = NULL;
+    void (*unmap)(void *) = NULL;
+    const unsigned char *p, *end;
+    unsigned long version, count;
+    int ok;
+
+    if( ctx == NULL )
+        ctx = pj_get_default_ctx();
+
+    fid = pj_ctx_fopen( ctx, filename, "rb" );
+    if( fid == NULL )
+    {
+        pj_ctx_set_errno( ctx, errno ? errno : ENOENT );
+        return -1;
+    }
+
+    if( pj_ctx_fseek( ctx, fid, 0, SEEK_END ) != 0
+        || (size = pj_ctx_ftell( ctx, fid )) < 16 )
+    {
+        pj_ctx_fclose( ctx, fid );
+        pj_ctx_set_errno( ctx, -51 );
+        return -1;
+    }
+
+    data = (unsigned char *)
+        pj_ctx_fmap_at( ctx, fid, 0, (size_t) size, &handle, &unmap );
+    if( data == NULL )
+    {
+        unmap = NULL;
+        data = (unsigned char *) pj_malloc( (size_t) size );
+        if( data == NULL )
+        {
+            pj_ctx_fclose( ctx, fid );
+            pj_ctx_set_errno( ctx, ENOMEM );
+            return -1;
+        }
+        if( pj_ctx_fseek( ctx, fid, 0, SEEK_SET ) != 0
+            || pj_ctx_fread( ctx, data, 1, (size_t) size, fid )
+               != (size_t) size )
+        {
+            pj_dalloc( data );
+            pj_ctx_fclose( ctx, fid );
+            pj_ctx_set_errno( ctx, -51 );
+            return -1;
+        }
+    }
+
+    p = data + 8;
+    end = data + size;
+    ok = memcmp( data, SNAP_MAGIC, 8 ) == 0
+        && snap_get_u32( &p, end, &version ) && version == SNAP_VERSION
+        && snap_get_u32( &p, end, &count )
+        && snap_entries( ctx, p, end, count, 0 );
+    if( ok && !snap_entries( ctx, p, end, count, 1 ) )
+    {
+        pj_ctx_set_errno( ctx, ENOMEM );
+        count = 0;
+        ok = -1;
+    }
+
+    if( unmap != NULL )
+        unmap( handle );
+    else
+        pj_dalloc( data );
+    pj_ctx_fclose( ctx, fid );
+
+    if( ok != 1 )
+    {
+        if( ok == 0 )
+            pj_ctx_set_errno( ctx, -51 );
+        return -1;
+    }
+
+    return (int) count;
+}
@@ -0,0 +1,283 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Process wide table of the texts of parameters, shared by the
+ *           parameter lists of all definitions.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <projects.h>
+#include <stddef.h>
+#include <string.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** The same few hundred parameters, +ellps=GRS80, +units=m, +no_defs and
+** the like, make up most of the definitions of a process, repeated in
+** each of them and in each copy the init caches hand out.  A
+** parameter list node only refers to its text here, so the text is held
+** once, with a count of the nodes referring to it, and a copy of a list
+** only takes more references.  A text is freed with its last reference.
+*/
+
+#define INTERN_BUCKETS_MIN 256   /* power of two */
+
+typedef struct PJ_INTERNED_s {
+    struct PJ_INTERNED_s *next;  /* of the bucket */
+    unsigned long hash;
+    unsigned long refs;
+    size_t        len;
+    char          text[1];
+} PJ_INTERNED;
+
+#define INTERNED_OF(text) \
+    ((PJ_INTERNED *) ((char *) (text) - offsetof(PJ_INTERNED, text)))
+
+static volatile long intern_once = 0;
+static void *intern_lock = NULL;
+static PJ_INTERNED **buckets = NULL;
+static unsigned long bucket_count = 0;
+static unsigned long text_count = 0;
+static double text_bytes = 0.0;
+
+/************************************************************************/
+/*                          pj_intern_setup()                           */
+/************************************************************************/
+
+static void pj_intern_setup( void )
+
+{
+    intern_lock = pj_mutex_create( PJ_LOCK_PARAMS );
+}
+
+/************************************************************************/
+/*                           pj_intern_hash()                           */
+/************************************************************************/
+
+static unsigned long pj_intern_hash( const char *text, size_t len )
+
+{
+    unsigned long hash = 2166136261UL;
+
+    while( len-- > 0 )
+    {
+        hash ^= (unsigned char) *text++;
+        hash = (hash * 16777619UL) & 0xffffffffUL;
+    }
+    return hash;
+}
+
+/************************************************************************/
+/*                          pj_intern_grow()                            */
+/*                                                                      */
+/*      Double the buckets, keeping the old ones if out of memory.      */
+/************************************************************************/
+
+static void pj_intern_grow( void )
+
+{
+    unsigned long new_count = bucket_count ? 2 * bucket_count
+        : INTERN_BUCKETS_MIN;
+    PJ_INTERNED **new_buckets;
+    unsigned long i;
+
+    new_buckets = (PJ_INTERNED **)
+        pj_malloc( sizeof(PJ_INTERNED *) * new_count );
+    if( new_buckets == NULL )
+        return;
+    memset( new_buckets, 0, sizeof(PJ_INTERNED *) * new_count );
+
+    for( i = 0; i < bucket_count; i++ )
+    {
+        PJ_INTERNED *entry, *next;
+
+        for( entry = buckets[i]; entry != NULL; entry = next )
+        {
+            PJ_INTERNED **bucket = new_buckets
+                + (entry->hash & (new_count - 1));
+
+            next = entry->next;
+            entry->next = *bucket;
+            *bucket = entry;
+        }
+    }
+
+    pj_dalloc( buckets );
+    buckets = new_buckets;
+    bucket_count = new_count;
+}
+
+/************************************************************************/
+/*                             pj_intern()                              */
+/*                                                                      */
+/*      Return the shared copy of the len first bytes of text, with a   */
+/*      new reference to it to be given back with pj_intern_release().  */
+/*      Returns NULL if out of memory.                                  */
+/************************************************************************/
+
+const char *pj_intern( const char *text, size_t len )
+
+{
+    unsigned long hash = pj_intern_hash( text, len );
+    PJ_INTERNED *entry = NULL;
+
+    pj_once( &intern_once, pj_intern_setup );
+    pj_mutex_lock( intern_lock );
+
+    if( text_count >= bucket_count )
+        pj_intern_grow();
+
+    if( bucket_count > 0 )
+    {
+        PJ_INTERNED **bucket = buckets + (hash & (bucket_count - 1));
+
+        for( entry = *bucket; entry != NULL; entry = entry->next )
+            if( entry->hash == hash && entry->len == len
+                && memcmp( entry->text, text, len ) == 0 )
+                break;
+
+        if( entry == NULL
+            && (entry = (PJ_INTERNED *)
+                pj_malloc( sizeof(PJ_INTERNED) + len )) != NULL )
+        {
+            entry->hash = hash;
+            entry->refs = 0;
+            entry->len = len;
+            memcpy( entry->text, text, len );
+            entry->text[len] = '\0';
+            entry->next = *bucket;
+            *bucket = entry;
+            text_count++;
+            text_bytes += sizeof(PJ_INTERNED) + len;
+        }
+        if( entry != NULL )
+            entry->refs++;
+    }
+
+    pj_mutex_unlock( intern_lock );
+
+    return entry != NULL ? entry->text : NULL;
+}
+
+/************************************************************************/
+/*                           pj_intern_ref()                            */
+/*                                                                      */
+/*      Take another reference to a text returned by pj_intern().       */
+/************************************************************************/
+
+const char *pj_intern_ref( const char *text )
+
+{
+    pj_mutex_lock( intern_lock );
+    INTERNED_OF(text)->refs++;
+    pj_mutex_unlock( intern_lock );
+
+    return text;
+}
+
+/************************************************************************/
+/*                          pj_intern_unref()                           */
+/*                                                                      */
+/*      Drop a reference to entry, holding the lock.                    */
+/************************************************************************/
+
+static void pj_intern_unref( PJ_INTERNED *entry )
+
+{
+    PJ_INTERNED **link;
+
+    if( --entry->refs > 0 )
+        return;
+
+    link = buckets + (entry->hash & (bucket_count - 1));
+    while( *link != entry )
+        link = &(*link)->next;
+    *link = entry->next;
+    text_count--;
+    text_bytes -= sizeof(PJ_INTERNED) + entry->len;
+    pj_dalloc( entry );
+}
+
+/************************************************************************/
+/*                         pj_intern_release()                          */
+/*                                                                      */
+/*      Give back a reference taken by pj_intern() or pj_intern_ref(),  */
+/*      freeing the text with the last one.  text may be NULL.          */
+/************************************************************************/
+
+void pj_intern_release( const char *text )
+
+{
+    if( text == NULL )
+        return;
+
+    pj_mutex_lock( intern_lock );
+    pj_intern_unref( INTERNED_OF(text) );
+    pj_mutex_unlock( intern_lock );
+}
+
+/************************************************************************/
+/*                       pj_intern_release_text()                       */
+/*                                                                      */
+/*      Same as pj_intern_release(), for the text of the len first      */
+/*      bytes of text, which must hold a reference.                     */
+/************************************************************************/
+
+void pj_intern_release_text( const char *text, size_t len )
+
+{
+    unsigned long hash = pj_intern_hash( text, len );
+    PJ_INTERNED *entry;
+
+    pj_mutex_lock( intern_lock );
+    for( entry = buckets[hash & (bucket_count - 1)]; entry != NULL;
+         entry = entry->next )
+        if( entry->hash == hash && entry->len == len
+            && memcmp( entry->text, text, len ) == 0 )
+        {
+            pj_intern_unref( entry );
+            break;
+        }
+    pj_mutex_unlock( intern_lock );
+}
+
+/************************************************************************/
+/*                         pj_intern_memory()                           */
+/*                                                                      */
+/*      The bytes of the texts held, and of the table.                  */
+/************************************************************************/
+
+double pj_intern_memory( void )
+
+{
+    double bytes;
+
+    pj_once( &intern_once, pj_intern_setup );
+    pj_mutex_lock( intern_lock );
+    bytes = text_bytes + sizeof(PJ_INTERNED *) * (double) bucket_count;
+    pj_mutex_unlock( intern_lock );
+
+    return bytes;
+}
@@ -14,7 +14,8 @@ pj_inv(XY xy, PJ *P) {
                 return lp;
 	}
 
-	errno = pj_errno = 0;
+	if (P->ctx->errno_globals)
+		errno = pj_errno = 0;
         P->ctx->last_errno = 0;
 
 	xy.x = (xy.x * P->to_meter - P->x0) * P->ra; /* descale and de-offset */
@@ -31,3 +32,153 @@ pj_inv(XY xy, PJ *P) {
 	}
 	return lp;
 }
+
+/************************************************************************/
+/*                           pj_inv_kernel()                            */
+/*                                                                      */
+/*      Run the inverse projection of P over an array of points        */
+/*      normalized as for P->inv, with its array kernel if it has one.  */
+/*      Failed points are set to HUGE_VAL and the error of the last    */
+/*      failed point is returned.                                      */
+/************************************************************************/
+
+	int
+pj_inv_kernel(PJ *P, long n, int point_offset, double *x, double *y) {
+	long i;
+	int err = 0;
+
+	if (P->inv_n)
+		return (*P->inv_n)(P, n, point_offset, x, y);
+
+	for (i = 0; i < n; i++) {
+		long io = i * point_offset;
+		XY xy;
+		LP lp;
+
+		if (x[io] == HUGE_VAL)
+			continue;
+		xy.x = x[io];
+		xy.y = y[io];
+		lp = (*P->inv)(xy, P);
+		if (P->ctx->last_errno) {
+			err = P->ctx->last_errno;
+			P->ctx->last_errno = 0;
+			lp.lam = lp.phi = HUGE_VAL;
+		}
+		x[io] = lp.lam;
+		y[io] = lp.phi;
+	}
+	return err;
+}
+
+/************************************************************************/
+/*                            pj_inv_array()                            */
+/*                                                                      */
+/*      Inverse project an array of points in place.  Results are in   */
+/*      radians.  Points with x already HUGE_VAL are skipped, failed   */
+/*      points are set to HUGE_VAL and the error of the last failed    */
+/*      point is returned.                                             */
+/************************************************************************/
+
+	int
+pj_inv_array(PJ *P, long point_count, int point_offset, double *x, double *y) {
+	return pj_inv_array_steps(P, point_count, point_offset, x, y, NULL, NULL);
+}
+
+/************************************************************************/
+/*                         pj_inv_array_steps()                         */
+/*                                                                      */
+/*      pj_inv_array(), with the axis and z scale of steps applied to  */
+/*      the points first, and its prime meridian and longitude         */
+/*      wrapping to the results, as the pj_transform() stages would,   */
+/*      while the points of a chunk are at hand.  z may be NULL, as    */
+/*      may steps.                                                     */
+/************************************************************************/
+
+	int
+pj_inv_array_steps(PJ *P, long point_count, int point_offset, double *x,
+                   double *y, double *z, const PJ_ARRAY_STEPS *steps) {
+	long i, base, n, chunk;
+	int err = 0, kerr;
+
+	if (point_offset == 0)
+		point_offset = 1;
+
+	if (P->ctx->errno_globals)
+		errno = pj_errno = 0;
+	P->ctx->last_errno = 0;
+
+	/* points run together, see pj_ctx_set_array_chunk() */
+	chunk = P->ctx->array_chunk > 0 ? P->ctx->array_chunk
+	                                : PJ_ARRAY_DEFAULT_CHUNK;
+
+	for (base = 0; base < point_count; base += chunk) {
+		double *cx = x + base * point_offset;
+		double *cy = y + base * point_offset;
+		double *cz = z && steps && steps->z_scale != 1. ?
+			z + base * point_offset : NULL;
+
+		n = point_count - base;
+		if (n > chunk)
+			n = chunk;
+
+		/* descale and de-offset, from the axis of steps */
+		for (i = 0; i < n; i++) {
+			long io = i * point_offset;
+
+			if (steps) {
+				double X = cx[io], Y = cy[io];
+
+				cx[io] = steps->x_sign * (steps->axis_swap ? Y : X);
+				cy[io] = steps->y_sign * (steps->axis_swap ? X : Y);
+				if (cz)
+					cz[io] *= steps->z_scale;
+			}
+			if (cx[io] == HUGE_VAL) /* already failed */
+				continue;
+			if (cy[io] == HUGE_VAL) {
+				cx[io] = cy[io] = HUGE_VAL;
+				err = -15;
+				continue;
+			}
+			cx[io] = (cx[io] * P->to_meter - P->x0) * P->ra;
+			cy[io] = (cy[io] * P->to_meter - P->y0) * P->ra;
+		}
+
+		/* inverse project */
+		if ((kerr = pj_inv_kernel(P, n, point_offset, cx, cy)) != 0)
+			err = kerr;
+
+		/* reduce from del lp.lam and adjust longitude to CM */
+		for (i = 0; i < n; i++) {
+			long io = i * point_offset;
+
+			if (cx[io] != HUGE_VAL)
+				cx[io] += P->lam0;
+		}
+		if (!P->over)
+			adjlon_n(n, point_offset, cx);
+		if (P->geoc)
+			for (i = 0; i < n; i++) {
+				long io = i * point_offset;
+
+				if (cx[io] != HUGE_VAL && fabs(fabs(cy[io])-HALFPI) > EPS)
+					cy[io] = atan(P->one_es * tan(cy[io]));
+			}
+		if (steps && steps->pm != 0.)
+			for (i = 0; i < n; i++) {
+				long io = i * point_offset;
+
+				if (cx[io] != HUGE_VAL)
+					cx[io] += steps->pm;
+			}
+		if (steps && steps->long_wrap)
+			adjlon_wrap_n(n, point_offset, cx, steps->long_wrap_center);
+	}
+
+	if (err)
+		pj_ctx_set_errno(P->ctx, err);
+	else
+		P->ctx->last_errno = 0;
+	return err;
+}
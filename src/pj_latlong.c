@@ -49,6 +49,8 @@ INVERSE(inverse);
         lp.lam = xy.x * P->a;
         return lp;
 }
+FORWARD_ARRAY(forward_n, forward)
+INVERSE_ARRAY(inverse_n, inverse)
 FREEUP; if (P) pj_dalloc(P); }
 
 ENTRY0(latlong)
@@ -56,6 +58,7 @@ ENTRY0(latlong)
         P->x0 = 0.0;
         P->y0 = 0.0;
 	P->inv = inverse; P->fwd = forward;
+	P->inv_n = inverse_n; P->fwd_n = forward_n;
 ENDENTRY(P)
 
 ENTRY0(longlat)
@@ -63,6 +66,7 @@ ENTRY0(longlat)
         P->x0 = 0.0;
         P->y0 = 0.0;
 	P->inv = inverse; P->fwd = forward;
+	P->inv_n = inverse_n; P->fwd_n = forward_n;
 ENDENTRY(P)
 
 ENTRY0(latlon)
@@ -70,6 +74,7 @@ ENTRY0(latlon)
         P->x0 = 0.0;
         P->y0 = 0.0;
 	P->inv = inverse; P->fwd = forward;
+	P->inv_n = inverse_n; P->fwd_n = forward_n;
 ENDENTRY(P)
 
 ENTRY0(lonlat)
@@ -77,4 +82,5 @@ ENTRY0(lonlat)
         P->x0 = 0.0;
         P->y0 = 0.0;
 	P->inv = inverse; P->fwd = forward;
+	P->inv_n = inverse_n; P->fwd_n = forward_n;
 ENDENTRY(P)
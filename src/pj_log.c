@@ -43,6 +43,44 @@ void pj_stderr_logger( void *app_data, int level, const char *msg )
     fprintf( stderr, "%s\n", msg );
 }
 
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#  define vsnprintf _vsnprintf
+#endif
+
+#define PJ_LOG_BUFFER 4096  /* longer messages are truncated */
+
+/************************************************************************/
+/*                              pj_vlog()                               */
+/*                                                                      */
+/*      Format the message on the stack and pass it to the record       */
+/*      logger if there is one, or else to the plain logger.            */
+/************************************************************************/
+
+static void pj_vlog( projCtx ctx, int level, const char *gridname,
+                     long point_index, int error_code,
+                     const char *fmt, va_list args )
+
+{
+    char msg_buf[PJ_LOG_BUFFER];
+
+    vsnprintf( msg_buf, sizeof(msg_buf), fmt, args );
+    msg_buf[sizeof(msg_buf)-1] = '\0';
+
+    if( ctx->record_logger != NULL )
+    {
+        projLogRecord record;
+
+        record.level = level;
+        record.message = msg_buf;
+        record.gridname = gridname;
+        record.point_index = point_index;
+        record.error_code = error_code;
+        ctx->record_logger( ctx->app_data, &record );
+    }
+    else
+        ctx->logger( ctx->app_data, level, msg_buf );
+}
+
 /************************************************************************/
 /*                               pj_log()                               */
 /************************************************************************/
@@ -51,23 +89,64 @@ void pj_log( projCtx ctx, int level, const char *fmt, ... )
 
 {
     va_list args;
-    char *msg_buf;
 
     if( level > ctx->debug_level )
         return;
 
-    msg_buf = (char *) malloc(100000);
-    if( msg_buf == NULL )
+    va_start( args, fmt );
+    pj_vlog( ctx, level, NULL, -1, 0, fmt, args );
+    va_end( args );
+}
+
+/************************************************************************/
+/*                           pj_log_record()                            */
+/*                                                                      */
+/*      As pj_log(), for a message about a grid, a point or an error.   */
+/************************************************************************/
+
+void pj_log_record( projCtx ctx, int level, const char *gridname,
+                    long point_index, int error_code, const char *fmt, ... )
+
+{
+    va_list args;
+
+    if( level > ctx->debug_level )
         return;
 
     va_start( args, fmt );
+    pj_vlog( ctx, level, gridname, point_index, error_code, fmt, args );
+    va_end( args );
+}
 
-    /* we should use vsnprintf where available once we add configure detect.*/
-    vsprintf( msg_buf, fmt, args );
+/************************************************************************/
+/*                         pj_log_site_count()                          */
+/*                                                                      */
+/*      Count a message from one of the PJ_LOG_SITE_* sites, and        */
+/*      return whether it should still be logged.  Once a site has      */
+/*      reached its limit on the context a last message says so, and    */
+/*      the site is silent until pj_ctx_reset_log_limits().  Used       */
+/*      through pj_log_site_wanted(), after the level check.            */
+/************************************************************************/
 
-    va_end( args );
+int pj_log_site_count( projCtx ctx, int level, int site )
 
-    ctx->logger( ctx->app_data, level, msg_buf );
-    
-    free( msg_buf );
+{
+    if( ctx->log_site_count[site] > PJ_LOG_SITE_LIMIT )
+        return 0;
+
+    if( ++ctx->log_site_count[site] <= PJ_LOG_SITE_LIMIT )
+        return 1;
+
+    pj_log( ctx, level, "(further messages of this kind are suppressed)" );
+    return 0;
+}
+
+/************************************************************************/
+/*                      pj_ctx_reset_log_limits()                       */
+/************************************************************************/
+
+void pj_ctx_reset_log_limits( projCtx ctx )
+
+{
+    memset( ctx->log_site_count, 0, sizeof(ctx->log_site_count) );
 }
@@ -4,6 +4,7 @@
 ** application procedures.  */
 #include <projects.h>
 #include <errno.h>
+#include <string.h>
 
 	void *
 pj_malloc(size_t size) {
@@ -24,4 +25,37 @@ pj_malloc(size_t size) {
 	void
 pj_dalloc(void *ptr) {
 	free(ptr);
+}
+	void * /* from an allocator of pj_ctx_set_allocator() */
+pj_allocator_malloc(const PJ_ALLOCATOR *a, size_t size) {
+	return a->alloc ? a->alloc(a->user_data, size) : pj_malloc(size);
+}
+	void
+pj_allocator_free(const PJ_ALLOCATOR *a, void *ptr) {
+	if (!ptr)
+		return;
+	if (a->alloc)
+		a->dalloc(a->user_data, ptr);
+	else
+		pj_dalloc(ptr);
+}
+	char *
+pj_allocator_strdup(const PJ_ALLOCATOR *a, const char *s) {
+	char *copy = (char *) pj_allocator_malloc(a, strlen(s) + 1);
+
+	if (copy)
+		strcpy(copy, s);
+	return copy;
+}
+	void * /* memory that goes back to pj_ctx_dalloc() on the same ctx */
+pj_ctx_malloc(projCtx ctx, size_t size) {
+	return pj_allocator_malloc(&ctx->allocator, size);
+}
+	void
+pj_ctx_dalloc(projCtx ctx, void *ptr) {
+	pj_allocator_free(&ctx->allocator, ptr);
+}
+	char *
+pj_ctx_strdup(projCtx ctx, const char *s) {
+	return pj_allocator_strdup(&ctx->allocator, s);
 }
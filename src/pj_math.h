@@ -0,0 +1,177 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Inline versions of the small math helpers of the projection
+ *           kernels, so that they are compiled into the loops using them.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+/*
+** Each pj_xxx_i() computes just what pj_xxx() of its own source does, and
+** those functions are compiled from these, so a kernel gets the same
+** results from either.  Only internal code of the library includes this
+** file, after projects.h.
+*/
+
+#ifndef PJ_MATH_H
+#define PJ_MATH_H
+
+#include <projects.h>
+
+#define PJ_MATH_ONE_TOL  1.00000000000001
+#define PJ_MATH_ATOL     1e-50
+#define PJ_MATH_QS_EPS   1.0e-7
+
+/* sin and cos of one angle, which the compiler may compute at once */
+static PJ_INLINE void pj_sincos(double x, double *s, double *c) {
+	*s = sin(x);
+	*c = cos(x);
+}
+
+/* small t of the conformal latitude, as pj_tsfn() */
+static PJ_INLINE double pj_tsfn_i(double phi, double sinphi, double e) {
+	sinphi *= e;
+	return (tan (.5 * (HALFPI - phi)) /
+	   pow((1. - sinphi) / (1. + sinphi), .5 * e));
+}
+
+/* small m, as pj_msfn() */
+static PJ_INLINE double pj_msfn_i(double sinphi, double cosphi, double es) {
+	return (cosphi / sqrt (1. - es * sinphi * sinphi));
+}
+
+/* small q of the authalic latitude, as pj_qsfn() */
+static PJ_INLINE double pj_qsfn_i(double sinphi, double e, double one_es) {
+	double con;
+
+	if (e >= PJ_MATH_QS_EPS) {
+		con = e * sinphi;
+		return (one_es * (sinphi / (1. - con * con) -
+		   (.5 / e) * log ((1. - con) / (1. + con))));
+	} else
+		return (sinphi + sinphi);
+}
+
+/* latitude of the authalic latitude beta, as pj_authlat(), its series
+   in sines of multiples of 2 beta summed by Clenshaw's recurrence, so
+   that one sin and cos are taken instead of three sines */
+static PJ_INLINE double pj_authlat_i(double beta, const double *APA) {
+	double s, c, b1, b2;
+
+	pj_sincos(beta + beta, &s, &c);
+	c += c;
+	b2 = APA[2];
+	b1 = APA[1] + c * b2;
+	return (beta + s * (APA[0] + c * b1 - b2));
+}
+
+/* meridian distance, as pj_mlfn() */
+static PJ_INLINE double pj_mlfn_i(double phi, double sphi, double cphi,
+                                  const double *en) {
+	cphi *= sphi;
+	sphi *= sphi;
+	return(en[0] * phi - cphi * (en[1] + sphi*(en[2]
+		+ sphi*(en[3] + sphi*en[4]))));
+}
+
+/* asin and acos clamping arguments just past +-1, as aasin() and aacos() */
+static PJ_INLINE double pj_aasin_i(projCtx ctx, double v) {
+	double av;
+
+	if ((av = fabs(v)) >= 1.) {
+		if (av > PJ_MATH_ONE_TOL)
+			pj_ctx_set_errno( ctx, -19 );
+		return (v < 0. ? -HALFPI : HALFPI);
+	}
+	return asin(v);
+}
+
+static PJ_INLINE double pj_aacos_i(projCtx ctx, double v) {
+	double av;
+
+	if ((av = fabs(v)) >= 1.) {
+		if (av > PJ_MATH_ONE_TOL)
+			pj_ctx_set_errno( ctx, -19 );
+		return (v < 0. ? PI : 0.);
+	}
+	return acos(v);
+}
+
+/* atan2 that is 0 at the origin, as aatan2() */
+static PJ_INLINE double pj_aatan2_i(double n, double d) {
+	return ((fabs(n) < PJ_MATH_ATOL && fabs(d) < PJ_MATH_ATOL) ?
+		0. : atan2(n,d));
+}
+
+/* start of Newton's method for t + sin t = k, |k| <= PI, as solved by
+   the Mollweide family: the series of t for small k, and of PI - t,
+   which goes as the cube root of PI - k, near the pole.  Within 0.02 of
+   the root, which then takes 3 steps at most to 1e-7. */
+static PJ_INLINE double pj_tsin_start(double k) {
+	double a = fabs(k), c, t;
+
+	if (a < 2.2) {
+		c = a * a;
+		t = a * (.5 + c * (1. / 96. + c / 1920.));
+	} else {
+		c = a < PI ? pow(6. * (PI - a), 1. / 3.) : 0.;
+		t = PI - c * (1. + c * c / 60.);
+	}
+	return (k < 0. ? -t : t);
+}
+
+/* points of a run of the array kernels going through local buffers */
+#define PJ_ARRAY_RUN 64
+
+/* Newton's method over a run of m points of the array kernels, for the
+   iterative forward of a projection.  Each step does t[j] -= V =
+   step(t[j], k[j], P) until |V| < tol, as the scalar loop of the
+   projection, at most max_iter times.  conv[j] is 1 for points to skip,
+   and is set to 2 for those converging, leaving 0 for the others.  The
+   steps of all points go together, so that the loop over a run, with
+   step inlined, is without calls and the points are independent of
+   each other.  Returns the count of points left unconverged. */
+#define PJ_NEWTON_RUN 64
+typedef double (*PJ_NEWTON_STEP)(double t, double k, PJ *P);
+static PJ_INLINE long pj_newton_run(PJ_NEWTON_STEP step, PJ *P,
+		int max_iter, double tol, long m, double *t, const double *k,
+		char *conv) {
+	long j, left;
+
+	for (left = m; max_iter && left; --max_iter)
+		for (j = 0, left = 0; j < m; ++j) {
+			double V;
+
+			if (conv[j])
+				continue;
+			t[j] -= V = step(t[j], k[j], P);
+			if (fabs(V) < tol)
+				conv[j] = 2;
+			else
+				++left;
+		}
+	return left;
+}
+
+#endif /* PJ_MATH_H */
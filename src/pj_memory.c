@@ -0,0 +1,284 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Accounting of the memory held by the library for a context,
+ *           by subsystem and by grid.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <projects.h>
+#include <string.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** The bytes are counted from the sizes of what is held rather than
+** tracked on every allocation, so that nothing is added to the paths
+** allocating them, and they leave out the overhead of the allocator.
+** Grids, catalogs and their derived tables are those of the registry of
+** the context, the tiles its own, and the init caches, ellipsoid tables
+** and parameter texts those of the process.  The soft limits enforced by eviction
+** are pj_set_grid_memory_limit(), pj_set_initcache_memory_limit() and
+** pj_ctx_set_grid_tile_limit().
+*/
+
+typedef struct {
+    double held;        /* values allocated for the grid */
+    double mapped;      /* values mapped from the file or a segment */
+    double tables;      /* inverse, row pair, quantized and child tables */
+} grid_memory;
+
+/************************************************************************/
+/*                          pj_memory_of_grid()                         */
+/*                                                                      */
+/*      The bytes of one grid, not of its children.                     */
+/************************************************************************/
+
+static void pj_memory_of_grid( const PJ_GRIDINFO *gi, grid_memory *m )
+
+{
+    double nodes;
+
+    memset( m, 0, sizeof(grid_memory) );
+    if( gi->ct == NULL )
+        return;
+
+    nodes = (double) gi->ct->lim.lam * gi->ct->lim.phi;
+    if( gi->ct->cvs != NULL )
+    {
+        double values = nodes * (pj_gridinfo_heights( gi )
+                                 ? sizeof(float) : sizeof(FLP));
+
+        if( gi->map_handle != NULL )
+            m->mapped = values;
+        else
+            m->held = values;
+    }
+    if( gi->inverse_ct != NULL )
+        m->tables += nodes * sizeof(FLP);
+    if( gi->row_pairs != NULL )
+        m->tables += 2 * (nodes - gi->ct->lim.lam) * sizeof(FLP);
+    if( gi->quant != NULL )
+    {
+        double blocks = (double) gi->quant->blocks_x
+            * ((gi->ct->lim.phi + PJ_GRID_QUANT_BLOCK - 1)
+               / PJ_GRID_QUANT_BLOCK);
+
+        m->tables += sizeof(PJ_GRID_QUANT)
+            + 2 * blocks * gi->quant->components * sizeof(double);
+        if( gi->quant->values != NULL )
+            m->tables += nodes * gi->quant->components
+                * sizeof(unsigned short);
+    }
+    if( gi->child_index != NULL )
+    {
+        const PJ_GRID_INDEX *index = gi->child_index;
+        const PJ_GRIDINFO *child;
+        int bins = index->nx * index->ny;
+
+        m->tables += sizeof(PJ_GRID_INDEX)
+            + (bins + 1 + index->bin_start[bins]) * sizeof(int);
+        for( child = gi->child; child != NULL; child = child->next )
+            m->tables += sizeof(PJ_GRID_INDEX_ENTRY);
+    }
+}
+
+/************************************************************************/
+/*                        pj_memory_add_grids()                         */
+/************************************************************************/
+
+static void pj_memory_add_grids( const PJ_GRIDINFO *gi,
+                                 projMemoryUsage *usage )
+
+{
+    grid_memory m;
+
+    for( ; gi != NULL; gi = gi->next )
+    {
+        pj_memory_of_grid( gi, &m );
+        usage->grid_values += m.held;
+        usage->grid_mapped += m.mapped;
+        usage->grid_tables += m.tables;
+        pj_memory_add_grids( gi->child, usage );
+    }
+}
+
+/************************************************************************/
+/*                        pj_memory_walk_grids()                        */
+/************************************************************************/
+
+static int pj_memory_walk_grids( const PJ_GRIDINFO *gi,
+                                 int (*walker)( void *, const char *,
+                                                double, double ),
+                                 void *data )
+
+{
+    grid_memory m;
+
+    for( ; gi != NULL; gi = gi->next )
+    {
+        pj_memory_of_grid( gi, &m );
+        if( (m.held + m.tables > 0 || m.mapped > 0)
+            && !walker( data, gi->gridname, m.held + m.tables, m.mapped ) )
+            return 0;
+        if( !pj_memory_walk_grids( gi->child, walker, data ) )
+            return 0;
+    }
+
+    return 1;
+}
+
+/************************************************************************/
+/*                      pj_ctx_get_memory_usage()                       */
+/*                                                                      */
+/*      Fill usage with the bytes held for the context now.  Returns    */
+/*      0.                                                              */
+/************************************************************************/
+
+int pj_ctx_get_memory_usage( projCtx ctx, projMemoryUsage *usage )
+
+{
+    PJ_GRID_REGISTRY *registry = pj_ctx_grid_registry( ctx );
+    const PJ_GRID_TILE *tile;
+    const PJ_GEOID_DIFF *diff;
+    const PJ_GRID_PAIR *pair;
+    const PJ_GridCatalog *catalog;
+    int i;
+
+    memset( usage, 0, sizeof(projMemoryUsage) );
+
+/* -------------------------------------------------------------------- */
+/*      Grids, and the tables derived from pairs of them.               */
+/* -------------------------------------------------------------------- */
+    pj_rwlock_acquire( registry->grid_lock, 0 );
+
+    pj_memory_add_grids( registry->grid_list, usage );
+
+    for( diff = registry->geoid_diffs; diff != NULL; diff = diff->next )
+    {
+        usage->grid_derived += sizeof(PJ_GEOID_DIFF);
+        if( diff->ct.cvs != NULL )
+            usage->grid_derived += (double) diff->ct.lim.lam
+                * diff->ct.lim.phi * sizeof(float);
+    }
+    for( pair = registry->grid_pairs; pair != NULL; pair = pair->next )
+    {
+        double nx = pair->ct.lim.lam, ny = pair->ct.lim.phi;
+
+        usage->grid_derived += sizeof(PJ_GRID_PAIR)
+            + strlen( pair->src_grids ) + strlen( pair->dst_grids ) + 2;
+        if( pair->ct.cvs != NULL )
+            usage->grid_derived += nx * ny * sizeof(FLP);
+        if( pair->exact != NULL )
+            usage->grid_derived += (nx - 1) * (ny - 1);
+    }
+
+    pj_rwlock_release( registry->grid_lock, 0 );
+
+    for( tile = ctx->grid_tiles; tile != NULL; tile = tile->next )
+        usage->grid_tiles += sizeof(PJ_GRID_TILE) + (double) tile->row_count
+            * tile->gi->ct->lim.lam * sizeof(FLP);
+
+/* -------------------------------------------------------------------- */
+/*      Catalogs, with the image of binary ones.                        */
+/* -------------------------------------------------------------------- */
+    pj_rwlock_acquire( registry->catalog_lock, 0 );
+
+    for( catalog = registry->catalog_list; catalog != NULL;
+         catalog = catalog->next )
+    {
+        usage->catalogs += sizeof(PJ_GridCatalog)
+            + strlen( catalog->catalog_name ) + 1
+            + sizeof(PJ_GridCatalogEntry) * (double) catalog->entry_count;
+
+        if( catalog->image != NULL )
+        {
+            if( catalog->image_unmap != NULL )
+                usage->grid_mapped += catalog->image_size;
+            else
+                usage->catalogs += catalog->image_size;
+        }
+        else
+        {
+            for( i = 0; i < catalog->entry_count; i++ )
+                usage->catalogs +=
+                    strlen( catalog->entries[i].definition ) + 1;
+        }
+
+        if( catalog->index != NULL )
+        {
+            const PJ_GC_INDEX *index = catalog->index;
+            int bins = index->nx * index->ny;
+
+            usage->catalogs += sizeof(PJ_GC_INDEX);
+            if( !index->in_image )
+                usage->catalogs +=
+                    (bins + 1 + index->bin_start[bins]) * sizeof(int)
+                    + index->date_count * sizeof(double);
+        }
+    }
+
+    pj_rwlock_release( registry->catalog_lock, 0 );
+
+/* -------------------------------------------------------------------- */
+/*      What the process holds for every context.                       */
+/* -------------------------------------------------------------------- */
+    usage->init_cache = pj_initcache_memory( &(usage->init_index) );
+    usage->ellps_tables = pj_table_memory();
+    usage->param_texts = pj_intern_memory();
+
+    usage->total = usage->grid_values + usage->grid_tables
+        + usage->grid_tiles + usage->grid_derived + usage->catalogs
+        + usage->init_cache + usage->init_index + usage->ellps_tables
+        + usage->param_texts;
+
+    return 0;
+}
+
+/************************************************************************/
+/*                      pj_ctx_walk_grid_memory()                       */
+/*                                                                      */
+/*      Call walker with the name of each grid of the registry of the   */
+/*      context holding memory, children included, with the bytes it    */
+/*      holds, tables included, and the bytes of its values mapped,     */
+/*      until it returns FALSE.  Returns FALSE if it did.  The grids    */
+/*      stay locked for reading meanwhile, so walker must not load      */
+/*      any.                                                            */
+/************************************************************************/
+
+int pj_ctx_walk_grid_memory( projCtx ctx,
+                             int (*walker)( void *, const char *gridname,
+                                            double bytes, double mapped ),
+                             void *data )
+
+{
+    PJ_GRID_REGISTRY *registry = pj_ctx_grid_registry( ctx );
+    int ok;
+
+    pj_rwlock_acquire( registry->grid_lock, 0 );
+    ok = pj_memory_walk_grids( registry->grid_list, walker, data );
+    pj_rwlock_release( registry->grid_lock, 0 );
+
+    return ok;
+}
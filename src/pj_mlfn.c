@@ -1,8 +1,15 @@
 #include <projects.h>
+#include <pj_math.h>
 /* meridinal distance for ellipsoid and inverse
 **	8th degree - accurate to < 1e-5 meters when used in conjuction
 **		with typical major axis values.
 **	Inverse determines phi to EPS (1e-11) radians, about 1e-6 seconds.
+**
+**	With pj_inv_mlfn_accuracy(), the inverse is instead the series of
+**	phi in the rectifying latitude mu = arg / en[0], to the fifth power
+**	of the third flattening n, summed by Clenshaw.  Against the
+**	forward series its error is close to SERIES_ERR * es^5 radians, and
+**	it is not used beyond SERIES_MAX_ES.
 */
 #define C00 1.
 #define C02 .25
@@ -18,37 +25,79 @@
 #define C88 .3076171875
 #define EPS 1e-11
 #define MAX_ITER 10
-#define EN_SIZE 5
-	double *
-pj_enfn(double es) {
-	double t, *en;
+#define EN_SIZE 11	/* 5 of pj_mlfn(), the series flag and 5 of the series */
+#define EN_SERIES 5
+#define SERIES_ERR 0.06
+#define SERIES_MAX_ES 0.1
+	static void /* the coefficients, without the series flag */
+fill_en(double es, double *en) {
+	double t;
 
-	if ((en = (double *)pj_malloc(EN_SIZE * sizeof(double))) != NULL) {
-		en[0] = C00 - es * (C02 + es * (C04 + es * (C06 + es * C08)));
-		en[1] = es * (C22 - es * (C04 + es * (C06 + es * C08)));
-		en[2] = (t = es * es) * (C44 - es * (C46 + es * C48));
-		en[3] = (t *= es) * (C66 - es * C68);
-		en[4] = t * es * C88;
-	} /* else return NULL if unable to allocate memory */
-	return en;
+	en[0] = C00 - es * (C02 + es * (C04 + es * (C06 + es * C08)));
+	en[1] = es * (C22 - es * (C04 + es * (C06 + es * C08)));
+	en[2] = (t = es * es) * (C44 - es * (C46 + es * C48));
+	en[3] = (t *= es) * (C66 - es * C68);
+	en[4] = t * es * C88;
+	t = sqrt(1. - es);
+	t = (1. - t) / (1. + t);
+	en[EN_SERIES] = 0.;
+	en[EN_SERIES+1] = t * (1.5 + t * t * (-27./32. + t * t * 269./512.));
+	en[EN_SERIES+2] = t * t * (21./16. - t * t * 55./32.);
+	en[EN_SERIES+3] = t * t * t * (151./96. - t * t * 417./128.);
+	en[EN_SERIES+4] = t * t * t * t * 1097./512.;
+	en[EN_SERIES+5] = t * t * t * t * t * 8011./2560.;
+}
+	static void
+fill_en_series(double es, double *en) {
+	fill_en(es, en);
+	en[EN_SERIES] = 1.;
+}
+	double * /* shared by the projections on the ellipsoid, which
+	            release it with pj_table_release() */
+pj_enfn(double es) {
+	/* else return NULL if unable to allocate memory */
+	return pj_table_acquire(PJ_TABLE_EN, es, EN_SIZE, fill_en);
 }
 	double
 pj_mlfn(double phi, double sphi, double cphi, double *en) {
-	cphi *= sphi;
-	sphi *= sphi;
-	return(en[0] * phi - cphi * (en[1] + sphi*(en[2]
-		+ sphi*(en[3] + sphi*en[4]))));
+	return pj_mlfn_i(phi, sphi, cphi, en);
+}
+	double * /* en, or the table using the series for an error in
+	            meters within accuracy, which replaces it */
+pj_inv_mlfn_accuracy(double *en, double es, double a, double accuracy) {
+	double *series;
+
+	if (en && accuracy > 0. && es <= SERIES_MAX_ES &&
+	    SERIES_ERR * pow(es, 5.) * a <= accuracy &&
+	    (series = pj_table_acquire(PJ_TABLE_EN_SERIES, es, EN_SIZE,
+	                               fill_en_series)) != NULL) {
+		pj_table_release(en);
+		return series;
+	}
+	return en;
 }
 	double
 pj_inv_mlfn(projCtx ctx, double arg, double es, double *en) {
 	double s, t, phi, k = 1./(1.-es);
 	int i;
 
+	if (en[EN_SERIES] != 0.) {
+		double mu = arg / en[0], c2 = 2. * cos(2. * mu), h = 0., h1 = 0.;
+
+		for (i = EN_SERIES + 5; i > EN_SERIES; --i) {
+			t = h;
+			h = c2 * h - h1 + en[i];
+			h1 = t;
+		}
+		return mu + sin(2. * mu) * h;
+	}
 	phi = arg;
 	for (i = MAX_ITER; i ; --i) { /* rarely goes over 2 iterations */
-		s = sin(phi);
+		double c;
+
+		pj_sincos(phi, &s, &c);
 		t = 1. - es * s * s;
-		phi -= t = (pj_mlfn(phi, s, cos(phi), en) - arg) * (t * sqrt(t)) * k;
+		phi -= t = (pj_mlfn_i(phi, s, c, en) - arg) * (t * sqrt(t)) * k;
 		if (fabs(t) < EPS)
 			return phi;
 	}
@@ -1,7 +1,7 @@
 /* determine constant small m */
-#include <math.h>
 #include <projects.h>
+#include <pj_math.h>
 	double
 pj_msfn(double sinphi, double cosphi, double es) {
-	return (cosphi / sqrt (1. - es * sinphi * sinphi));
+	return pj_msfn_i(sinphi, cosphi, es);
 }
@@ -36,6 +36,7 @@ PJ_CVSID("$Id: pj_transform.c 1504 2009-01-06 02:11:57Z warmerdam $");
 #else
 #include <proj_api.h>
 #endif
+#include <pj_trace.h>
 
 /* on win32 we always use win32 mutexes, even if pthreads are available */
 #if defined(_WIN32) && !defined(MUTEX_stub)
@@ -47,6 +48,65 @@ PJ_CVSID("$Id: pj_transform.c 1504 2009-01-06 02:11:57Z warmerdam $");
 #  define MUTEX_stub
 #endif
 
+/*
+** Each lock belongs to one of the PJ_LOCK_* classes, for which we count
+** the acquisitions and those that had to wait because the lock was held
+** by another thread.  The counts are meant to measure contention, and
+** are only approximate where there is no atomic increment.
+*/
+static volatile long lock_acquired[PJ_LOCK_CLASS_COUNT];
+static volatile long lock_waited[PJ_LOCK_CLASS_COUNT];
+
+/*
+** The time spent waiting is added once the lock is held, so it is
+** exact for the exclusive locks and approximate for shared holders.
+*/
+static volatile double lock_wait_ns[PJ_LOCK_CLASS_COUNT];
+
+#if defined(__GNUC__) && !defined(MUTEX_stub)
+#  define LOCK_COUNT(counter)  __sync_fetch_and_add( &(counter), 1 )
+#else
+#  define LOCK_COUNT(counter)  ((counter)++)
+#endif
+
+/************************************************************************/
+/*                         pj_get_lock_stats()                          */
+/*                                                                      */
+/*      Fetch how many times locks of a class were acquired, and how    */
+/*      many of those had to wait for another thread.                   */
+/************************************************************************/
+
+void pj_get_lock_stats( int lock_class, long *acquired, long *waited )
+{
+    if( lock_class < 0 || lock_class >= PJ_LOCK_CLASS_COUNT )
+    {
+        *acquired = *waited = 0;
+        return;
+    }
+
+    *acquired = lock_acquired[lock_class];
+    *waited = lock_waited[lock_class];
+}
+
+/************************************************************************/
+/*                         pj_get_lock_wait()                           */
+/*                                                                      */
+/*      Fetch how many lock acquisitions of any class had to wait,      */
+/*      and the nanoseconds they waited in total.                       */
+/************************************************************************/
+
+void pj_get_lock_wait( double *waits, double *nanoseconds )
+{
+    int i;
+
+    *waits = *nanoseconds = 0.0;
+    for( i = 0; i < PJ_LOCK_CLASS_COUNT; i++ )
+    {
+        *waits += lock_waited[i];
+        *nanoseconds += lock_wait_ns[i];
+    }
+}
+
 /************************************************************************/
 /* ==================================================================== */
 /*                      stub mutex implementation                       */
@@ -55,6 +115,8 @@ PJ_CVSID("$Id: pj_transform.c 1504 2009-01-06 02:11:57Z warmerdam $");
 
 #ifdef MUTEX_stub
 
+#include <time.h>
+
 /************************************************************************/
 /*                            pj_acquire_lock()                         */
 /*                                                                      */
@@ -63,6 +125,7 @@ PJ_CVSID("$Id: pj_transform.c 1504 2009-01-06 02:11:57Z warmerdam $");
 
 void pj_acquire_lock()
 {
+    LOCK_COUNT( lock_acquired[PJ_LOCK_CORE] );
 }
 
 /************************************************************************/
@@ -82,6 +145,134 @@ void pj_cleanup_lock()
 {
 }
 
+/************************************************************************/
+/*                     pj_acquire_initcache_lock()                      */
+/************************************************************************/
+void pj_acquire_initcache_lock( int exclusive )
+{
+    LOCK_COUNT( lock_acquired[PJ_LOCK_INITCACHE] );
+}
+
+/************************************************************************/
+/*                     pj_release_initcache_lock()                      */
+/************************************************************************/
+void pj_release_initcache_lock( int exclusive )
+{
+}
+
+/************************************************************************/
+/*                            pj_clock_ns()                             */
+/*                                                                      */
+/*      A monotonic clock in nanoseconds, for the instrumentation.      */
+/*      Without clock_gettime() we fall back on processor time.         */
+/************************************************************************/
+
+double pj_clock_ns()
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+#else
+    return clock() * (1e9 / CLOCKS_PER_SEC);
+#endif
+}
+
+/************************************************************************/
+/*                          pj_mutex_create()                           */
+/*                                                                      */
+/*      Mutexes and read/write locks for finer grained locking than     */
+/*      the core lock.  A NULL lock falls back to the core lock.        */
+/************************************************************************/
+void *pj_mutex_create( int lock_class )
+{
+    return NULL;
+}
+
+/************************************************************************/
+/*                          pj_mutex_destroy()                          */
+/************************************************************************/
+void pj_mutex_destroy( void *mutex )
+{
+}
+
+/************************************************************************/
+/*                           pj_mutex_lock()                            */
+/************************************************************************/
+void pj_mutex_lock( void *mutex )
+{
+    pj_acquire_lock();
+}
+
+/************************************************************************/
+/*                          pj_mutex_unlock()                           */
+/************************************************************************/
+void pj_mutex_unlock( void *mutex )
+{
+}
+
+/************************************************************************/
+/*                          pj_rwlock_create()                          */
+/************************************************************************/
+void *pj_rwlock_create( int lock_class )
+{
+    return NULL;
+}
+
+/************************************************************************/
+/*                         pj_rwlock_destroy()                          */
+/************************************************************************/
+void pj_rwlock_destroy( void *rwlock )
+{
+}
+
+/************************************************************************/
+/*                         pj_rwlock_acquire()                          */
+/************************************************************************/
+void pj_rwlock_acquire( void *rwlock, int exclusive )
+{
+    pj_acquire_lock();
+}
+
+/************************************************************************/
+/*                         pj_rwlock_release()                          */
+/************************************************************************/
+void pj_rwlock_release( void *rwlock, int exclusive )
+{
+}
+
+/************************************************************************/
+/*                          pj_thread_start()                           */
+/*                                                                      */
+/*      Without threads the caller does the work itself.                */
+/************************************************************************/
+
+void *pj_thread_start( void (*func)(void *), void *arg )
+{
+    (void) func;
+    (void) arg;
+    return NULL;
+}
+
+/************************************************************************/
+/*                           pj_thread_join()                           */
+/************************************************************************/
+
+void pj_thread_join( void *thread )
+{
+    (void) thread;
+}
+
+/************************************************************************/
+/*                            pj_cpu_count()                            */
+/************************************************************************/
+
+int pj_cpu_count( void )
+{
+    return 1;
+}
+
 #endif // def MUTEX_stub
 
 /************************************************************************/
@@ -93,10 +284,105 @@ void pj_cleanup_lock()
 #ifdef MUTEX_pthread
 
 #include "pthread.h"
+#include <time.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+typedef struct {
+    pthread_mutex_t  mutex;
+    int              lock_class;
+} pj_pthread_mutex;
+
+typedef struct {
+    pthread_rwlock_t rwlock;
+    int              lock_class;
+} pj_pthread_rwlock;
 
 static pthread_mutex_t pj_precreated_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t pj_core_lock;
 static int pj_core_lock_created = 0;
+static pthread_rwlock_t pj_initcache_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/************************************************************************/
+/*                        pj_counted_mutex_lock()                       */
+/*                                                                      */
+/*      Lock, counting whether we had to wait for another thread.       */
+/************************************************************************/
+
+static void pj_counted_mutex_lock( pthread_mutex_t *mutex, int lock_class )
+{
+    double waited = 0.0;
+
+    if( pthread_mutex_trylock( mutex ) != 0 )
+    {
+        double start = pj_clock_ns();
+
+        PJ_TRACE1( lock__wait, lock_class );
+        LOCK_COUNT( lock_waited[lock_class] );
+        pthread_mutex_lock( mutex );
+        lock_wait_ns[lock_class] += waited = pj_clock_ns() - start;
+    }
+    LOCK_COUNT( lock_acquired[lock_class] );
+    PJ_TRACE2( lock__acquire, lock_class, (long) waited );
+}
+
+/************************************************************************/
+/*                       pj_counted_rwlock_lock()                       */
+/************************************************************************/
+
+static void pj_counted_rwlock_lock( pthread_rwlock_t *rwlock, int lock_class,
+                                    int exclusive )
+{
+    double waited = 0.0;
+
+    if( exclusive )
+    {
+        if( pthread_rwlock_trywrlock( rwlock ) != 0 )
+        {
+            double start = pj_clock_ns();
+
+            PJ_TRACE1( lock__wait, lock_class );
+            LOCK_COUNT( lock_waited[lock_class] );
+            pthread_rwlock_wrlock( rwlock );
+            lock_wait_ns[lock_class] += waited = pj_clock_ns() - start;
+        }
+    }
+    else
+    {
+        if( pthread_rwlock_tryrdlock( rwlock ) != 0 )
+        {
+            double start = pj_clock_ns();
+
+            PJ_TRACE1( lock__wait, lock_class );
+            LOCK_COUNT( lock_waited[lock_class] );
+            pthread_rwlock_rdlock( rwlock );
+            lock_wait_ns[lock_class] += waited = pj_clock_ns() - start;
+        }
+    }
+    LOCK_COUNT( lock_acquired[lock_class] );
+    PJ_TRACE2( lock__acquire, lock_class, (long) waited );
+}
+
+/************************************************************************/
+/*                     pj_init_recursive_mutex()                        */
+/************************************************************************/
+
+static int pj_init_recursive_mutex( pthread_mutex_t *mutex )
+{
+    pthread_mutexattr_t mutex_attr;
+    int result;
+
+    pthread_mutexattr_init(&mutex_attr);
+#ifndef PTHREAD_MUTEX_RECURSIVE
+    pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_RECURSIVE_NP);
+#else
+    pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_RECURSIVE);
+#endif
+    result = pthread_mutex_init(mutex, &mutex_attr);
+    pthread_mutexattr_destroy(&mutex_attr);
+
+    return result;
+}
 
 /************************************************************************/
 /*                          pj_acquire_lock()                           */
@@ -113,23 +399,18 @@ void pj_acquire_lock()
         ** initialization so we have pj_precreated_lock only for the purpose
         ** of protecting the creation of the core lock.
         */
-        pthread_mutexattr_t mutex_attr;
-
         pthread_mutex_lock( &pj_precreated_lock);
 
-        pthread_mutexattr_init(&mutex_attr);
-#ifndef PTHREAD_MUTEX_RECURSIVE
-        pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_RECURSIVE_NP);
-#else
-        pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_RECURSIVE);
-#endif
-        pthread_mutex_init(&pj_core_lock, &mutex_attr);
-        pj_core_lock_created = 1;
+        if( !pj_core_lock_created )
+        {
+            pj_init_recursive_mutex( &pj_core_lock );
+            pj_core_lock_created = 1;
+        }
 
         pthread_mutex_unlock( &pj_precreated_lock );
     }
 
-    pthread_mutex_lock( &pj_core_lock);
+    pj_counted_mutex_lock( &pj_core_lock, PJ_LOCK_CORE );
 }
 
 /************************************************************************/
@@ -150,6 +431,248 @@ void pj_cleanup_lock()
 {
 }
 
+/************************************************************************/
+/*                     pj_acquire_initcache_lock()                      */
+/*                                                                      */
+/*      Acquire the init cache lock, shared by lookups or exclusive     */
+/*      for updates.  It is not recursive.                              */
+/************************************************************************/
+
+void pj_acquire_initcache_lock( int exclusive )
+{
+    pj_counted_rwlock_lock( &pj_initcache_lock, PJ_LOCK_INITCACHE, 
+                            exclusive );
+}
+
+/************************************************************************/
+/*                     pj_release_initcache_lock()                      */
+/************************************************************************/
+
+void pj_release_initcache_lock( int exclusive )
+{
+    pthread_rwlock_unlock( &pj_initcache_lock );
+}
+
+/************************************************************************/
+/*                            pj_clock_ns()                             */
+/*                                                                      */
+/*      A monotonic clock in nanoseconds, for the instrumentation.      */
+/************************************************************************/
+
+double pj_clock_ns()
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+#else
+    struct timeval tv;
+
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec * 1e9 + tv.tv_usec * 1e3;
+#endif
+}
+
+/************************************************************************/
+/*                          pj_mutex_create()                           */
+/*                                                                      */
+/*      Mutexes for finer grained locking than the core lock.  They     */
+/*      are recursive like the core lock, which a NULL mutex falls      */
+/*      back to.                                                        */
+/************************************************************************/
+
+void *pj_mutex_create( int lock_class )
+{
+    pj_pthread_mutex *mutex;
+
+    mutex = (pj_pthread_mutex *) malloc(sizeof(pj_pthread_mutex));
+    if( mutex == NULL )
+        return NULL;
+
+    if( pj_init_recursive_mutex( &(mutex->mutex) ) != 0 )
+    {
+        free( mutex );
+        return NULL;
+    }
+    mutex->lock_class = lock_class;
+
+    return mutex;
+}
+
+/************************************************************************/
+/*                          pj_mutex_destroy()                          */
+/************************************************************************/
+
+void pj_mutex_destroy( void *mutex )
+{
+    if( mutex != NULL )
+    {
+        pthread_mutex_destroy( &(((pj_pthread_mutex *) mutex)->mutex) );
+        free( mutex );
+    }
+}
+
+/************************************************************************/
+/*                           pj_mutex_lock()                            */
+/************************************************************************/
+
+void pj_mutex_lock( void *mutex )
+{
+    if( mutex != NULL )
+        pj_counted_mutex_lock( &(((pj_pthread_mutex *) mutex)->mutex),
+                               ((pj_pthread_mutex *) mutex)->lock_class );
+    else
+        pj_acquire_lock();
+}
+
+/************************************************************************/
+/*                          pj_mutex_unlock()                           */
+/************************************************************************/
+
+void pj_mutex_unlock( void *mutex )
+{
+    if( mutex != NULL )
+        pthread_mutex_unlock( &(((pj_pthread_mutex *) mutex)->mutex) );
+    else
+        pj_release_lock();
+}
+
+/************************************************************************/
+/*                          pj_rwlock_create()                          */
+/*                                                                      */
+/*      Read/write locks, shared by lookups or exclusive for updates.   */
+/*      Unlike the mutexes they are not recursive.  A NULL lock falls   */
+/*      back to the core lock.                                          */
+/************************************************************************/
+
+void *pj_rwlock_create( int lock_class )
+{
+    pj_pthread_rwlock *rwlock;
+
+    rwlock = (pj_pthread_rwlock *) malloc(sizeof(pj_pthread_rwlock));
+    if( rwlock == NULL )
+        return NULL;
+
+    if( pthread_rwlock_init( &(rwlock->rwlock), NULL ) != 0 )
+    {
+        free( rwlock );
+        return NULL;
+    }
+    rwlock->lock_class = lock_class;
+
+    return rwlock;
+}
+
+/************************************************************************/
+/*                         pj_rwlock_destroy()                          */
+/************************************************************************/
+
+void pj_rwlock_destroy( void *rwlock )
+{
+    if( rwlock != NULL )
+    {
+        pthread_rwlock_destroy( &(((pj_pthread_rwlock *) rwlock)->rwlock) );
+        free( rwlock );
+    }
+}
+
+/************************************************************************/
+/*                         pj_rwlock_acquire()                          */
+/************************************************************************/
+
+void pj_rwlock_acquire( void *rwlock, int exclusive )
+{
+    if( rwlock != NULL )
+        pj_counted_rwlock_lock( &(((pj_pthread_rwlock *) rwlock)->rwlock),
+                                ((pj_pthread_rwlock *) rwlock)->lock_class,
+                                exclusive );
+    else
+        pj_acquire_lock();
+}
+
+/************************************************************************/
+/*                         pj_rwlock_release()                          */
+/************************************************************************/
+
+void pj_rwlock_release( void *rwlock, int exclusive )
+{
+    if( rwlock != NULL )
+        pthread_rwlock_unlock( &(((pj_pthread_rwlock *) rwlock)->rwlock) );
+    else
+        pj_release_lock();
+}
+
+/************************************************************************/
+/*                          pj_thread_start()                           */
+/*                                                                      */
+/*      Run func(arg) on a new thread, returning a handle for           */
+/*      pj_thread_join(), or NULL if no thread could be started.        */
+/************************************************************************/
+
+typedef struct {
+    pthread_t thread;
+    void      (*func)(void *);
+    void      *arg;
+} pj_pthread_thread;
+
+static void *pj_pthread_run( void *thread )
+{
+    ((pj_pthread_thread *) thread)->func( ((pj_pthread_thread *) thread)->arg );
+    return NULL;
+}
+
+void *pj_thread_start( void (*func)(void *), void *arg )
+{
+    pj_pthread_thread *thread;
+
+    thread = (pj_pthread_thread *) pj_malloc(sizeof(pj_pthread_thread));
+    if( thread == NULL )
+        return NULL;
+
+    thread->func = func;
+    thread->arg = arg;
+    if( pthread_create( &(thread->thread), NULL, pj_pthread_run, thread ) != 0 )
+    {
+        pj_dalloc( thread );
+        return NULL;
+    }
+
+    return thread;
+}
+
+/************************************************************************/
+/*                           pj_thread_join()                           */
+/*                                                                      */
+/*      Wait for the thread to finish, and release its handle.          */
+/************************************************************************/
+
+void pj_thread_join( void *thread )
+{
+    if( thread == NULL )
+        return;
+
+    pthread_join( ((pj_pthread_thread *) thread)->thread, NULL );
+    pj_dalloc( thread );
+}
+
+/************************************************************************/
+/*                            pj_cpu_count()                            */
+/*                                                                      */
+/*      The processors online, or 1 if that is not known.               */
+/************************************************************************/
+
+int pj_cpu_count( void )
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    long count = sysconf( _SC_NPROCESSORS_ONLN );
+
+    return count > 0 ? (int) count : 1;
+#else
+    return 1;
+#endif
+}
+
 #endif // def MUTEX_pthread
 
 /************************************************************************/
@@ -161,9 +684,61 @@ void pj_cleanup_lock()
 #ifdef MUTEX_win32
 
 #include <windows.h>
+#include <stdlib.h>
+
+typedef struct {
+    HANDLE  handle;
+    int     lock_class;
+} pj_win32_mutex;
 
 static HANDLE mutex_lock = NULL;
 
+/************************************************************************/
+/*                            pj_clock_ns()                             */
+/*                                                                      */
+/*      A monotonic clock in nanoseconds, for the instrumentation.      */
+/************************************************************************/
+
+double pj_clock_ns()
+{
+    static double ns_per_tick = 0.0;
+    LARGE_INTEGER count;
+
+    if( ns_per_tick == 0.0 )
+    {
+        LARGE_INTEGER frequency;
+
+        QueryPerformanceFrequency( &frequency );
+        ns_per_tick = 1e9 / (double) frequency.QuadPart;
+    }
+    QueryPerformanceCounter( &count );
+    return (double) count.QuadPart * ns_per_tick;
+}
+
+/************************************************************************/
+/*                        pj_counted_wait()                             */
+/*                                                                      */
+/*      Wait for a mutex, counting whether it was held by another       */
+/*      thread.                                                         */
+/************************************************************************/
+
+static void pj_counted_wait( HANDLE handle, int lock_class )
+{
+    double waited = 0.0;
+
+    if( WaitForSingleObject( handle, 0 ) == WAIT_TIMEOUT )
+    {
+        double start = pj_clock_ns();
+
+        PJ_TRACE1( lock__wait, lock_class );
+        InterlockedIncrement( (LONG volatile *) &(lock_waited[lock_class]) );
+        WaitForSingleObject( handle, INFINITE );
+        lock_wait_ns[lock_class] += waited = pj_clock_ns() - start;
+    }
+    InterlockedIncrement( (LONG volatile *) &(lock_acquired[lock_class]) );
+    PJ_TRACE2( lock__acquire, lock_class, (long) waited );
+}
+
 /************************************************************************/
 /*                            pj_init_lock()                            */
 /************************************************************************/
@@ -186,7 +761,7 @@ void pj_acquire_lock()
     if( mutex_lock == NULL )
         pj_init_lock();
 
-    WaitForSingleObject( mutex_lock, INFINITE );
+    pj_counted_wait( mutex_lock, PJ_LOCK_CORE );
 }
 
 /************************************************************************/
@@ -215,4 +790,233 @@ void pj_cleanup_lock()
     }
 }
 
+/************************************************************************/
+/*                     pj_acquire_initcache_lock()                      */
+/*                                                                      */
+/*      Win32 mutexes have no shared mode, so lookups are serialized    */
+/*      on the core lock here.                                          */
+/************************************************************************/
+
+void pj_acquire_initcache_lock( int exclusive )
+{
+    pj_acquire_lock();
+}
+
+/************************************************************************/
+/*                     pj_release_initcache_lock()                      */
+/************************************************************************/
+
+void pj_release_initcache_lock( int exclusive )
+{
+    pj_release_lock();
+}
+
+/************************************************************************/
+/*                          pj_mutex_create()                           */
+/*                                                                      */
+/*      Mutexes for finer grained locking than the core lock.  A NULL   */
+/*      mutex falls back to the core lock.                              */
+/************************************************************************/
+
+void *pj_mutex_create( int lock_class )
+{
+    pj_win32_mutex *mutex;
+
+    mutex = (pj_win32_mutex *) malloc(sizeof(pj_win32_mutex));
+    if( mutex == NULL )
+        return NULL;
+
+    mutex->handle = CreateMutex( NULL, FALSE, NULL );
+    if( mutex->handle == NULL )
+    {
+        free( mutex );
+        return NULL;
+    }
+    mutex->lock_class = lock_class;
+
+    return mutex;
+}
+
+/************************************************************************/
+/*                          pj_mutex_destroy()                          */
+/************************************************************************/
+
+void pj_mutex_destroy( void *mutex )
+{
+    if( mutex != NULL )
+    {
+        CloseHandle( ((pj_win32_mutex *) mutex)->handle );
+        free( mutex );
+    }
+}
+
+/************************************************************************/
+/*                           pj_mutex_lock()                            */
+/************************************************************************/
+
+void pj_mutex_lock( void *mutex )
+{
+    if( mutex != NULL )
+        pj_counted_wait( ((pj_win32_mutex *) mutex)->handle,
+                         ((pj_win32_mutex *) mutex)->lock_class );
+    else
+        pj_acquire_lock();
+}
+
+/************************************************************************/
+/*                          pj_mutex_unlock()                           */
+/************************************************************************/
+
+void pj_mutex_unlock( void *mutex )
+{
+    if( mutex != NULL )
+        ReleaseMutex( ((pj_win32_mutex *) mutex)->handle );
+    else
+        pj_release_lock();
+}
+
+/************************************************************************/
+/*                          pj_rwlock_create()                          */
+/*                                                                      */
+/*      Without a shared mode the read/write locks are plain mutexes    */
+/*      here.                                                           */
+/************************************************************************/
+
+void *pj_rwlock_create( int lock_class )
+{
+    return pj_mutex_create( lock_class );
+}
+
+/************************************************************************/
+/*                         pj_rwlock_destroy()                          */
+/************************************************************************/
+
+void pj_rwlock_destroy( void *rwlock )
+{
+    pj_mutex_destroy( rwlock );
+}
+
+/************************************************************************/
+/*                         pj_rwlock_acquire()                          */
+/************************************************************************/
+
+void pj_rwlock_acquire( void *rwlock, int exclusive )
+{
+    pj_mutex_lock( rwlock );
+}
+
+/************************************************************************/
+/*                         pj_rwlock_release()                          */
+/************************************************************************/
+
+void pj_rwlock_release( void *rwlock, int exclusive )
+{
+    pj_mutex_unlock( rwlock );
+}
+
+/************************************************************************/
+/*                          pj_thread_start()                           */
+/************************************************************************/
+
+typedef struct {
+    HANDLE  handle;
+    void    (*func)(void *);
+    void    *arg;
+} pj_win32_thread;
+
+static DWORD WINAPI pj_win32_run( LPVOID thread )
+{
+    ((pj_win32_thread *) thread)->func( ((pj_win32_thread *) thread)->arg );
+    return 0;
+}
+
+void *pj_thread_start( void (*func)(void *), void *arg )
+{
+    pj_win32_thread *thread;
+
+    thread = (pj_win32_thread *) malloc(sizeof(pj_win32_thread));
+    if( thread == NULL )
+        return NULL;
+
+    thread->func = func;
+    thread->arg = arg;
+    thread->handle = CreateThread( NULL, 0, pj_win32_run, thread, 0, NULL );
+    if( thread->handle == NULL )
+    {
+        free( thread );
+        return NULL;
+    }
+
+    return thread;
+}
+
+/************************************************************************/
+/*                           pj_thread_join()                           */
+/************************************************************************/
+
+void pj_thread_join( void *thread )
+{
+    if( thread == NULL )
+        return;
+
+    WaitForSingleObject( ((pj_win32_thread *) thread)->handle, INFINITE );
+    CloseHandle( ((pj_win32_thread *) thread)->handle );
+    free( thread );
+}
+
+/************************************************************************/
+/*                            pj_cpu_count()                            */
+/************************************************************************/
+
+int pj_cpu_count( void )
+{
+    SYSTEM_INFO info;
+
+    GetSystemInfo( &info );
+    return info.dwNumberOfProcessors > 0 ? (int) info.dwNumberOfProcessors : 1;
+}
+
 #endif // def MUTEX_win32
+
+/************************************************************************/
+/* ==================================================================== */
+/*                       one time initialization                        */
+/* ==================================================================== */
+/************************************************************************/
+
+#if defined(__GNUC__) && defined(__ATOMIC_ACQUIRE) && !defined(MUTEX_stub)
+#  define ONCE_DONE(once)      __atomic_load_n( (once), __ATOMIC_ACQUIRE )
+#  define ONCE_SET_DONE(once)  __atomic_store_n( (once), 1, __ATOMIC_RELEASE )
+#elif defined(__GNUC__) && !defined(MUTEX_stub)
+#  define ONCE_DONE(once)      __sync_fetch_and_add( (once), 0 )
+#  define ONCE_SET_DONE(once)  (__sync_synchronize(), *(once) = 1)
+#elif defined(MUTEX_win32)
+#  define ONCE_DONE(once)      InterlockedCompareExchange( (once), 0, 0 )
+#  define ONCE_SET_DONE(once)  InterlockedExchange( (once), 1 )
+#else
+#  define ONCE_DONE(once)      (*(once))
+#  define ONCE_SET_DONE(once)  (*(once) = 1)
+#endif
+
+/************************************************************************/
+/*                              pj_once()                               */
+/*                                                                      */
+/*      Call init the first time, with once a static long initialized   */
+/*      to 0.  Later calls only read once, without taking a lock, so    */
+/*      this may guard paths as hot as pj_get_default_ctx().  init      */
+/*      runs holding the core lock, which it may take again.            */
+/************************************************************************/
+
+void pj_once( volatile long *once, void (*init)(void) )
+{
+    if( ONCE_DONE( once ) )
+        return;
+
+    pj_acquire_lock();
+    if( !*once )
+    {
+        init();
+        ONCE_SET_DONE( once );
+    }
+    pj_release_lock();
+}
@@ -0,0 +1,1000 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Reading grid files from http(s) urls with range requests,
+ *           through a local block cache.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef HAVE_LIBCURL
+#  include <curl/curl.h>
+#  include <stdlib.h>
+#  include <time.h>
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  ifdef _WIN32
+#    include <io.h>
+#    include <process.h>
+#    include <sys/utime.h>
+#    define getpid _getpid
+#    define utime _utime
+#  else
+#    include <dirent.h>
+#    include <unistd.h>
+#    include <utime.h>
+#  endif
+#endif
+
+PJ_CVSID("$Id$");
+
+/************************************************************************/
+/*                         pj_network_is_url()                          */
+/************************************************************************/
+
+int pj_network_is_url( const char *name )
+
+{
+    return name != NULL
+        && (strncmp(name, "http://", 7) == 0
+            || strncmp(name, "https://", 8) == 0);
+}
+
+#ifdef HAVE_LIBCURL
+
+/*
+** A context with the network enabled uses the file api below, which
+** passes local files to the stdio api and reads urls a block at a time
+** with http range requests.  Blocks are kept in a directory set with
+** pj_set_network_cache(), one file per block named from the url, size
+** and date of the remote file, so that they survive the process and a
+** changed file is fetched again.  The least recently used blocks are
+** removed once the directory grows past its limit.  Grids read from
+** urls are always read tile by tile, see pj_gridinfo_tiled(), so only
+** the blocks of the tiles touched are fetched.
+**
+** The size and date of every url opened are remembered for the life of
+** the process, as the grid code opens a file for each tile it loads.
+*/
+
+#define NET_BLOCK_SIZE    65536
+#define NET_MAX_RUN       64        /* blocks fetched by one request */
+#define NET_CURL_POOL     4
+
+typedef struct PJ_NET_REMOTE
+{
+    struct PJ_NET_REMOTE *next;
+    char           *url;
+    projFileOffset  size;
+    long            filetime;
+} PJ_NET_REMOTE;
+
+typedef struct
+{
+    PAFile          local;          /* stdio file, NULL for a url */
+    projCtx         ctx;
+    PJ_NET_REMOTE  *remote;
+    char            key[24];        /* of the blocks in the cache */
+    projFileOffset  pos;
+    long            block_index;    /* held in block, -1 if none */
+    unsigned char  *block;
+    CURL           *curl;
+} PJ_NET_FILE;
+
+static PJ_NET_REMOTE *remote_list = NULL;
+static CURL *curl_pool[NET_CURL_POOL];
+static int curl_pool_count = 0;
+static int curl_initialized = 0;
+
+static char *cache_dir = NULL;
+static double cache_limit = 0.0;
+static double cache_bytes = -1.0;   /* unknown until first scanned */
+
+static PAFile pj_net_fopen(projCtx ctx, const char *filename,
+                           const char *access);
+static size_t pj_net_fread(void *buffer, size_t size, size_t nmemb,
+                           PAFile file);
+static int pj_net_fseek(PAFile file, long offset, int whence);
+static long pj_net_ftell(PAFile file);
+static void pj_net_fclose(PAFile file);
+static size_t pj_net_fread_at(PAFile file, void *buffer, size_t size,
+                              projFileOffset offset);
+static void *pj_net_fmap(PAFile file, projFileOffset offset, size_t size,
+                         void **handle);
+static void pj_net_funmap(void *handle);
+
+static projFileAPI network_fileapi = {
+    pj_net_fopen,
+    pj_net_fread,
+    pj_net_fseek,
+    pj_net_ftell,
+    pj_net_fclose
+};
+
+static projFileAPIEx network_fileapi_ex = {
+    PJ_FILEAPI_EX_VERSION,
+    pj_net_fread_at,
+    pj_net_fmap,
+    pj_net_funmap
+};
+
+/************************************************************************/
+/*                           pj_net_curl_get()                          */
+/*                                                                      */
+/*      Take a handle from the pool, whose connections are reused.      */
+/************************************************************************/
+
+static CURL *pj_net_curl_get( void )
+
+{
+    CURL *curl = NULL;
+
+    pj_acquire_lock();
+    if( !curl_initialized )
+    {
+        curl_global_init( CURL_GLOBAL_DEFAULT );
+        curl_initialized = 1;
+    }
+    if( curl_pool_count > 0 )
+        curl = curl_pool[--curl_pool_count];
+    pj_release_lock();
+
+    if( curl == NULL )
+        curl = curl_easy_init();
+
+    return curl;
+}
+
+/************************************************************************/
+/*                         pj_net_curl_release()                        */
+/************************************************************************/
+
+static void pj_net_curl_release( CURL *curl )
+
+{
+    if( curl == NULL )
+        return;
+
+    pj_acquire_lock();
+    if( curl_pool_count < NET_CURL_POOL )
+    {
+        curl_pool[curl_pool_count++] = curl;
+        curl = NULL;
+    }
+    pj_release_lock();
+
+    if( curl != NULL )
+        curl_easy_cleanup( curl );
+}
+
+/************************************************************************/
+/*                          pj_net_curl_setup()                         */
+/************************************************************************/
+
+static void pj_net_curl_setup( CURL *curl, const char *url )
+
+{
+    curl_easy_reset( curl );
+    curl_easy_setopt( curl, CURLOPT_URL, url );
+    curl_easy_setopt( curl, CURLOPT_FOLLOWLOCATION, 1L );
+    curl_easy_setopt( curl, CURLOPT_FAILONERROR, 1L );
+    curl_easy_setopt( curl, CURLOPT_NOSIGNAL, 1L );
+}
+
+/************************************************************************/
+/*                          pj_net_remote_get()                         */
+/*                                                                      */
+/*      The size and date of a url, from a HEAD request the first       */
+/*      time it is opened.                                              */
+/************************************************************************/
+
+static PJ_NET_REMOTE *pj_net_remote_get( projCtx ctx, CURL *curl,
+                                         const char *url )
+
+{
+    PJ_NET_REMOTE *remote;
+    CURLcode res;
+    long filetime = -1;
+#if LIBCURL_VERSION_NUM >= 0x073700
+    curl_off_t length = -1;
+#else
+    double length = -1.0;
+#endif
+
+    pj_acquire_lock();
+    for( remote = remote_list; remote != NULL; remote = remote->next )
+    {
+        if( strcmp( remote->url, url ) == 0 )
+            break;
+    }
+    pj_release_lock();
+
+    if( remote != NULL )
+        return remote;
+
+    pj_net_curl_setup( curl, url );
+    curl_easy_setopt( curl, CURLOPT_NOBODY, 1L );
+    curl_easy_setopt( curl, CURLOPT_FILETIME, 1L );
+
+    res = curl_easy_perform( curl );
+#if LIBCURL_VERSION_NUM >= 0x073700
+    if( res == CURLE_OK )
+        res = curl_easy_getinfo( curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T,
+                                 &length );
+#else
+    if( res == CURLE_OK )
+        res = curl_easy_getinfo( curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD,
+                                 &length );
+#endif
+    if( res == CURLE_OK )
+        curl_easy_getinfo( curl, CURLINFO_FILETIME, &filetime );
+
+    if( res != CURLE_OK || length < 0 )
+    {
+        pj_log( ctx, PJ_LOG_DEBUG_MAJOR, "HEAD %s failed: %s", url,
+                res != CURLE_OK ? curl_easy_strerror( res )
+                                : "no content length" );
+        return NULL;
+    }
+
+    remote = (PJ_NET_REMOTE *) pj_malloc( sizeof(PJ_NET_REMOTE) );
+    if( remote == NULL )
+        return NULL;
+    remote->url = (char *) pj_malloc( strlen(url) + 1 );
+    if( remote->url == NULL )
+    {
+        pj_dalloc( remote );
+        return NULL;
+    }
+    strcpy( remote->url, url );
+    remote->size = (projFileOffset) length;
+    remote->filetime = filetime;
+
+    pj_acquire_lock();
+    remote->next = remote_list;
+    remote_list = remote;
+    pj_release_lock();
+
+    pj_log( ctx, PJ_LOG_DEBUG_MAJOR, "Remote %s is %.0f bytes", url,
+            (double) remote->size );
+
+    return remote;
+}
+
+/************************************************************************/
+/*                             pj_net_key()                             */
+/*                                                                      */
+/*      Name the blocks of a remote file, from two FNV-1a hashes of     */
+/*      its url, size and date.                                         */
+/************************************************************************/
+
+static void pj_net_key( PJ_NET_FILE *f )
+
+{
+    char id[64];
+    unsigned long h1, h2;
+    size_t url_size = strlen( f->remote->url );
+
+    sprintf( id, "|%.0f|%ld", (double) f->remote->size,
+             f->remote->filetime );
+    h1 = pj_fnv1a( PJ_FNV1A_BASIS, f->remote->url, url_size );
+    h1 = pj_fnv1a( h1, id, strlen(id) );
+    h2 = pj_fnv1a( 84696351UL, f->remote->url, url_size );
+    h2 = pj_fnv1a( h2, id, strlen(id) );
+
+    sprintf( f->key, "%08lx%08lx", h1, h2 );
+}
+
+/************************************************************************/
+/*                          pj_net_block_path()                         */
+/************************************************************************/
+
+static int pj_net_block_path( PJ_NET_FILE *f, long block, char *path )
+
+{
+    if( cache_dir == NULL
+        || strlen(cache_dir) + strlen(f->key) + 24 > MAX_PATH_FILENAME )
+        return 0;
+
+    sprintf( path, "%s%c%s-%ld.blk", cache_dir, DIR_CHAR, f->key, block );
+    return 1;
+}
+
+/************************************************************************/
+/*                         pj_net_block_bytes()                         */
+/*                                                                      */
+/*      The size of a block, shorter for the last one of the file.      */
+/************************************************************************/
+
+static size_t pj_net_block_bytes( PJ_NET_FILE *f, long block )
+
+{
+    projFileOffset start = (projFileOffset) block * NET_BLOCK_SIZE;
+
+    if( f->remote->size - start < NET_BLOCK_SIZE )
+        return (size_t) (f->remote->size - start);
+    return NET_BLOCK_SIZE;
+}
+
+/************************************************************************/
+/*                          pj_net_cache_read()                         */
+/*                                                                      */
+/*      Read a block from the cache directory, marking it as recently   */
+/*      used.  Returns FALSE if it is not there.                        */
+/************************************************************************/
+
+static int pj_net_cache_read( PJ_NET_FILE *f, long block,
+                              unsigned char *data )
+
+{
+    char path[MAX_PATH_FILENAME+1];
+    size_t bytes = pj_net_block_bytes( f, block );
+    FILE *fp;
+    int ok;
+
+    if( !pj_net_block_path( f, block, path )
+        || (fp = fopen( path, "rb" )) == NULL )
+        return 0;
+
+    ok = fread( data, 1, bytes, fp ) == bytes;
+    fclose( fp );
+
+    if( ok )
+        utime( path, NULL );
+
+    return ok;
+}
+
+/************************************************************************/
+/*                          pj_net_cache_has()                          */
+/************************************************************************/
+
+static int pj_net_cache_has( PJ_NET_FILE *f, long block )
+
+{
+    char path[MAX_PATH_FILENAME+1];
+    struct stat st;
+
+    return pj_net_block_path( f, block, path ) && stat( path, &st ) == 0
+        && (size_t) st.st_size == pj_net_block_bytes( f, block );
+}
+
+/************************************************************************/
+/*                           Cache eviction.                            */
+/************************************************************************/
+
+typedef struct
+{
+    char    *name;
+    time_t   used;
+    double   bytes;
+} PJ_NET_ENTRY;
+
+static int pj_net_entry_compare( const void *a, const void *b )
+
+{
+    const PJ_NET_ENTRY *ea = (const PJ_NET_ENTRY *) a;
+    const PJ_NET_ENTRY *eb = (const PJ_NET_ENTRY *) b;
+
+    if( ea->used < eb->used )
+        return -1;
+    return ea->used > eb->used;
+}
+
+static int pj_net_entry_add( PJ_NET_ENTRY **entries, int *count, int *max,
+                             const char *name, time_t used, double bytes )
+
+{
+    size_t len = strlen( name );
+
+    if( len < 4 || strcmp( name + len - 4, ".blk" ) != 0 )
+        return 1;
+
+    if( *count == *max )
+    {
+        int new_max = *max * 2 + 64;
+        PJ_NET_ENTRY *grown = (PJ_NET_ENTRY *)
+            pj_malloc( sizeof(PJ_NET_ENTRY) * new_max );
+
+        if( grown == NULL )
+            return 0;
+        if( *count > 0 )
+            memcpy( grown, *entries, sizeof(PJ_NET_ENTRY) * *count );
+        pj_dalloc( *entries );
+        *entries = grown;
+        *max = new_max;
+    }
+
+    (*entries)[*count].name = (char *) pj_malloc( len + 1 );
+    if( (*entries)[*count].name == NULL )
+        return 0;
+    strcpy( (*entries)[*count].name, name );
+    (*entries)[*count].used = used;
+    (*entries)[*count].bytes = bytes;
+    (*count)++;
+
+    return 1;
+}
+
+/************************************************************************/
+/*                          pj_net_cache_trim()                         */
+/*                                                                      */
+/*      Total the blocks of the cache directory and, if they exceed     */
+/*      its limit, remove the least recently used down to three         */
+/*      quarters of it.  Called with the lock held.                     */
+/************************************************************************/
+
+static void pj_net_cache_trim( void )
+
+{
+    PJ_NET_ENTRY *entries = NULL;
+    int count = 0, max = 0, i;
+    char path[MAX_PATH_FILENAME+1];
+    double total = 0.0;
+#ifdef _WIN32
+    struct _finddata_t fd;
+    intptr_t search;
+
+    if( strlen(cache_dir) + 8 > MAX_PATH_FILENAME )
+        return;
+    sprintf( path, "%s%c*.blk", cache_dir, DIR_CHAR );
+    search = _findfirst( path, &fd );
+    if( search != -1 )
+    {
+        do {
+            if( !pj_net_entry_add( &entries, &count, &max, fd.name,
+                                   fd.time_write, (double) fd.size ) )
+                break;
+        } while( _findnext( search, &fd ) == 0 );
+        _findclose( search );
+    }
+#else
+    DIR *dir = opendir( cache_dir );
+    struct dirent *entry;
+    struct stat st;
+
+    if( dir == NULL )
+        return;
+    while( (entry = readdir( dir )) != NULL )
+    {
+        if( strlen(cache_dir) + strlen(entry->d_name) + 2 > MAX_PATH_FILENAME )
+            continue;
+        sprintf( path, "%s%c%s", cache_dir, DIR_CHAR, entry->d_name );
+        if( stat( path, &st ) != 0 )
+            continue;
+        if( !pj_net_entry_add( &entries, &count, &max, entry->d_name,
+                               st.st_mtime, (double) st.st_size ) )
+            break;
+    }
+    closedir( dir );
+#endif
+
+    for( i = 0; i < count; i++ )
+        total += entries[i].bytes;
+
+    if( total > cache_limit )
+    {
+        qsort( entries, count, sizeof(PJ_NET_ENTRY), pj_net_entry_compare );
+        for( i = 0; i < count && total > cache_limit * 0.75; i++ )
+        {
+            sprintf( path, "%s%c%s", cache_dir, DIR_CHAR, entries[i].name );
+            if( remove( path ) == 0 )
+                total -= entries[i].bytes;
+        }
+    }
+
+    cache_bytes = total;
+
+    for( i = 0; i < count; i++ )
+        pj_dalloc( entries[i].name );
+    pj_dalloc( entries );
+}
+
+/************************************************************************/
+/*                         pj_net_cache_write()                         */
+/*                                                                      */
+/*      Add a block to the cache directory.  It is written to a         */
+/*      temporary file renamed into place, so that other processes      */
+/*      sharing the directory never read a partial block.               */
+/************************************************************************/
+
+static void pj_net_cache_write( PJ_NET_FILE *f, long block,
+                                const unsigned char *data )
+
+{
+    char path[MAX_PATH_FILENAME+1], tmp[MAX_PATH_FILENAME+40];
+    size_t bytes = pj_net_block_bytes( f, block );
+    FILE *fp;
+    int ok;
+
+    if( !pj_net_block_path( f, block, path ) )
+        return;
+
+    sprintf( tmp, "%s.%lx.%lx.tmp", path, (unsigned long) getpid(),
+             (unsigned long) (size_t) f );
+    fp = fopen( tmp, "wb" );
+    if( fp == NULL )
+        return;
+
+    ok = fwrite( data, 1, bytes, fp ) == bytes;
+    ok = fclose( fp ) == 0 && ok;
+#ifdef _WIN32
+    if( ok )
+        remove( path );
+#endif
+    if( !ok || rename( tmp, path ) != 0 )
+    {
+        remove( tmp );
+        return;
+    }
+
+    pj_acquire_lock();
+    if( cache_dir != NULL && cache_limit > 0.0 )
+    {
+        if( cache_bytes < 0.0 )
+            pj_net_cache_trim();
+        else
+            cache_bytes += bytes;
+        if( cache_bytes > cache_limit )
+            pj_net_cache_trim();
+    }
+    pj_release_lock();
+}
+
+/************************************************************************/
+/*                            pj_net_fetch()                            */
+/*                                                                      */
+/*      Read bytes [start,start+size) of a url into data.  Servers      */
+/*      ignoring the range and sending the whole file are put up with.  */
+/************************************************************************/
+
+typedef struct
+{
+    CURL           *curl;
+    unsigned char  *data;
+    size_t          size;
+    size_t          got;
+    projFileOffset  skip;       /* bytes to drop before data */
+    int             started;
+} PJ_NET_FETCH;
+
+static size_t pj_net_fetch_write( char *ptr, size_t size, size_t nmemb,
+                                  void *user )
+
+{
+    PJ_NET_FETCH *fetch = (PJ_NET_FETCH *) user;
+    size_t bytes = size * nmemb, used = 0, n;
+
+    if( !fetch->started )
+    {
+        long code = 0;
+
+        curl_easy_getinfo( fetch->curl, CURLINFO_RESPONSE_CODE, &code );
+        if( code != 206 && code != 200 )
+            return 0;
+        if( code == 206 )
+            fetch->skip = 0;
+        fetch->started = 1;
+    }
+
+    if( fetch->skip > 0 )
+    {
+        used = fetch->skip < (projFileOffset) bytes
+            ? (size_t) fetch->skip : bytes;
+        fetch->skip -= used;
+    }
+
+    n = bytes - used;
+    if( n > fetch->size - fetch->got )
+        n = fetch->size - fetch->got;
+    memcpy( fetch->data + fetch->got, ptr + used, n );
+    fetch->got += n;
+
+    /* stop a full body once we have our range */
+    if( fetch->got == fetch->size && used + n < bytes )
+        return 0;
+
+    return bytes;
+}
+
+static int pj_net_fetch( PJ_NET_FILE *f, projFileOffset start, size_t size,
+                         unsigned char *data )
+
+{
+    PJ_NET_FETCH fetch;
+    char range[64];
+    CURLcode res;
+
+    sprintf( range, "%.0f-%.0f", (double) start,
+             (double) (start + size - 1) );
+
+    fetch.curl = f->curl;
+    fetch.data = data;
+    fetch.size = size;
+    fetch.got = 0;
+    fetch.skip = start;
+    fetch.started = 0;
+
+    pj_net_curl_setup( f->curl, f->remote->url );
+    curl_easy_setopt( f->curl, CURLOPT_RANGE, range );
+    curl_easy_setopt( f->curl, CURLOPT_WRITEFUNCTION, pj_net_fetch_write );
+    curl_easy_setopt( f->curl, CURLOPT_WRITEDATA, &fetch );
+
+    res = curl_easy_perform( f->curl );
+    if( fetch.got == size && (res == CURLE_OK || res == CURLE_WRITE_ERROR) )
+        return 1;
+
+    pj_log( f->ctx, PJ_LOG_ERROR, "GET %s bytes %s failed: %s",
+            f->remote->url, range,
+            res != CURLE_OK ? curl_easy_strerror( res ) : "short read" );
+    return 0;
+}
+
+/************************************************************************/
+/*                           pj_net_read_at()                           */
+/*                                                                      */
+/*      Copy size bytes at offset of a url, from the block in hand,     */
+/*      the cache directory or the server.  Runs of blocks missing      */
+/*      from the cache are fetched by one request.                      */
+/************************************************************************/
+
+static size_t pj_net_read_at( PJ_NET_FILE *f, void *buffer, size_t size,
+                              projFileOffset offset )
+
+{
+    unsigned char *out = (unsigned char *) buffer;
+    size_t done = 0;
+
+    if( offset >= f->remote->size )
+        return 0;
+    if( (projFileOffset) size > f->remote->size - offset )
+        size = (size_t) (f->remote->size - offset);
+
+    while( done < size )
+    {
+        projFileOffset at = offset + done;
+        long block = (long) (at / NET_BLOCK_SIZE);
+        size_t skip = (size_t) (at - (projFileOffset) block * NET_BLOCK_SIZE);
+        size_t n = pj_net_block_bytes( f, block ) - skip;
+
+        if( n > size - done )
+            n = size - done;
+
+        if( block != f->block_index )
+        {
+            f->block_index = -1;
+            if( !pj_net_cache_read( f, block, f->block ) )
+            {
+                long last_block = (long) ((offset + size - 1) / NET_BLOCK_SIZE);
+                long run_end = block, b;
+                unsigned char *run;
+                size_t run_bytes;
+
+                while( run_end < last_block
+                       && run_end - block + 1 < NET_MAX_RUN
+                       && !pj_net_cache_has( f, run_end + 1 ) )
+                    run_end++;
+
+                run_bytes = (size_t) ((projFileOffset) (run_end - block)
+                                      * NET_BLOCK_SIZE)
+                    + pj_net_block_bytes( f, run_end );
+                run = run_end == block
+                    ? f->block : (unsigned char *) pj_malloc( run_bytes );
+                if( run == NULL
+                    || !pj_net_fetch( f, (projFileOffset) block
+                                      * NET_BLOCK_SIZE, run_bytes, run ) )
+                {
+                    if( run != f->block )
+                        pj_dalloc( run );
+                    break;
+                }
+
+                for( b = block; b <= run_end; b++ )
+                    pj_net_cache_write( f, b, run + (size_t) (b - block)
+                                        * NET_BLOCK_SIZE );
+
+                if( run != f->block )
+                {
+                    n = run_bytes - skip < size - done
+                        ? run_bytes - skip : size - done;
+                    memcpy( out + done, run + skip, n );
+                    done += n;
+
+                    /* keep the last block of the run in hand */
+                    memcpy( f->block, run + (size_t) (run_end - block)
+                            * NET_BLOCK_SIZE, pj_net_block_bytes( f, run_end ) );
+                    f->block_index = run_end;
+                    pj_dalloc( run );
+                    continue;
+                }
+            }
+            f->block_index = block;
+        }
+
+        memcpy( out + done, f->block + skip, n );
+        done += n;
+    }
+
+    return done;
+}
+
+/************************************************************************/
+/*                            pj_net_fopen()                            */
+/************************************************************************/
+
+static PAFile pj_net_fopen(projCtx ctx, const char *filename,
+                           const char *access)
+
+{
+    PJ_NET_FILE *f;
+
+    f = (PJ_NET_FILE *) pj_malloc( sizeof(PJ_NET_FILE) );
+    if( f == NULL )
+        return NULL;
+    memset( f, 0, sizeof(PJ_NET_FILE) );
+    f->ctx = ctx;
+    f->block_index = -1;
+
+    if( !pj_network_is_url( filename ) )
+    {
+        f->local = pj_get_default_fileapi()->FOpen( ctx, filename, access );
+        if( f->local == NULL )
+        {
+            pj_dalloc( f );
+            return NULL;
+        }
+        return (PAFile) f;
+    }
+
+    if( access[0] != 'r' || strchr( access, '+' ) != NULL )
+    {
+        pj_dalloc( f );
+        return NULL;
+    }
+
+    f->curl = pj_net_curl_get();
+    f->block = (unsigned char *) pj_malloc( NET_BLOCK_SIZE );
+    if( f->curl == NULL || f->block == NULL
+        || (f->remote = pj_net_remote_get( ctx, f->curl, filename )) == NULL )
+    {
+        pj_net_curl_release( f->curl );
+        pj_dalloc( f->block );
+        pj_dalloc( f );
+        return NULL;
+    }
+
+    pj_net_key( f );
+
+    return (PAFile) f;
+}
+
+/************************************************************************/
+/*                            pj_net_fread()                            */
+/************************************************************************/
+
+static size_t pj_net_fread(void *buffer, size_t size, size_t nmemb,
+                           PAFile file)
+
+{
+    PJ_NET_FILE *f = (PJ_NET_FILE *) file;
+    size_t bytes;
+
+    if( f->local != NULL )
+        return pj_get_default_fileapi()->FRead( buffer, size, nmemb,
+                                                f->local );
+
+    if( size == 0 )
+        return 0;
+
+    bytes = pj_net_read_at( f, buffer, size * nmemb, f->pos );
+    f->pos += bytes;
+
+    return bytes / size;
+}
+
+/************************************************************************/
+/*                            pj_net_fseek()                            */
+/************************************************************************/
+
+static int pj_net_fseek(PAFile file, long offset, int whence)
+
+{
+    PJ_NET_FILE *f = (PJ_NET_FILE *) file;
+    projFileOffset pos;
+
+    if( f->local != NULL )
+        return pj_get_default_fileapi()->FSeek( f->local, offset, whence );
+
+    if( whence == SEEK_SET )
+        pos = offset;
+    else if( whence == SEEK_CUR )
+        pos = f->pos + offset;
+    else
+        pos = f->remote->size + offset;
+
+    if( pos < 0 )
+        return -1;
+
+    f->pos = pos;
+    return 0;
+}
+
+/************************************************************************/
+/*                            pj_net_ftell()                            */
+/************************************************************************/
+
+static long pj_net_ftell(PAFile file)
+
+{
+    PJ_NET_FILE *f = (PJ_NET_FILE *) file;
+
+    if( f->local != NULL )
+        return pj_get_default_fileapi()->FTell( f->local );
+
+    return (long) f->pos;
+}
+
+/************************************************************************/
+/*                            pj_net_fclose()                           */
+/************************************************************************/
+
+static void pj_net_fclose(PAFile file)
+
+{
+    PJ_NET_FILE *f = (PJ_NET_FILE *) file;
+
+    if( f->local != NULL )
+        pj_get_default_fileapi()->FClose( f->local );
+
+    pj_net_curl_release( f->curl );
+    pj_dalloc( f->block );
+    pj_dalloc( f );
+}
+
+/************************************************************************/
+/*                           pj_net_fread_at()                          */
+/************************************************************************/
+
+static size_t pj_net_fread_at(PAFile file, void *buffer, size_t size,
+                              projFileOffset offset)
+
+{
+    PJ_NET_FILE *f = (PJ_NET_FILE *) file;
+
+    if( f->local != NULL )
+        return pj_get_default_fileapi_ex()->FReadAt( f->local, buffer, size,
+                                                     offset );
+
+    return pj_net_read_at( f, buffer, size, offset );
+}
+
+/************************************************************************/
+/*                             pj_net_fmap()                            */
+/*                                                                      */
+/*      Local files are mapped by the stdio api, urls never are.        */
+/************************************************************************/
+
+static void *pj_net_fmap(PAFile file, projFileOffset offset, size_t size,
+                         void **handle)
+
+{
+    PJ_NET_FILE *f = (PJ_NET_FILE *) file;
+
+    if( f->local == NULL )
+        return NULL;
+
+    return pj_get_default_fileapi_ex()->FMap( f->local, offset, size,
+                                              handle );
+}
+
+static void pj_net_funmap(void *handle)
+
+{
+    pj_get_default_fileapi_ex()->FUnmap( handle );
+}
+
+#endif /* def HAVE_LIBCURL */
+
+/************************************************************************/
+/*                         pj_ctx_set_network()                         */
+/*                                                                      */
+/*      Let the context read grids and other files from http and        */
+/*      https urls, such as +nadgrids=https://host/grid.gsb.  This      */
+/*      replaces the file api of the context by one reading local       */
+/*      files with stdio, and disabling it restores the default file    */
+/*      api.  Returns FALSE if the library was built without libcurl.   */
+/************************************************************************/
+
+int pj_ctx_set_network( projCtx ctx, int enable )
+
+{
+    if( !enable )
+    {
+        if( pj_ctx_get_network( ctx ) )
+            pj_ctx_set_fileapi( ctx, pj_get_default_fileapi() );
+        return 1;
+    }
+
+#ifdef HAVE_LIBCURL
+    pj_ctx_set_fileapi( ctx, &network_fileapi );
+    pj_ctx_set_fileapi_ex( ctx, &network_fileapi_ex );
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/************************************************************************/
+/*                         pj_ctx_get_network()                         */
+/************************************************************************/
+
+int pj_ctx_get_network( projCtx ctx )
+
+{
+#ifdef HAVE_LIBCURL
+    return ctx->fileapi == &network_fileapi;
+#else
+    return 0;
+#endif
+}
+
+/************************************************************************/
+/*                        pj_set_network_cache()                        */
+/*                                                                      */
+/*      Keep the blocks read from urls in directory, which must         */
+/*      exist, up to about max_megabytes, or without limit for 0.       */
+/*      The directory may be shared by several processes, and is used   */
+/*      by all contexts, so this should be called before any of them    */
+/*      reads a url.  Call with NULL to stop caching blocks.            */
+/************************************************************************/
+
+void pj_set_network_cache( const char *directory, long max_megabytes )
+
+{
+#ifdef HAVE_LIBCURL
+    char *dir = NULL;
+
+    if( directory != NULL )
+    {
+        dir = (char *) pj_malloc( strlen(directory) + 1 );
+        if( dir != NULL )
+            strcpy( dir, directory );
+    }
+
+    pj_acquire_lock();
+    pj_dalloc( cache_dir );
+    cache_dir = dir;
+    cache_limit = max_megabytes * 1048576.0;
+    cache_bytes = -1.0;
+    pj_release_lock();
+#else
+    (void) directory;
+    (void) max_megabytes;
+#endif
+}
@@ -32,6 +32,7 @@
 
 #define PJ_LIB__
 #include <projects.h>
+#include <pj_trace.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
@@ -48,6 +49,176 @@ PROJ_LIB;
 0;
 #endif
 
+/*
+** Where the names found through the finder, PROJ_LIB and the search
+** path were opened from, and those that could not be opened, for each
+** file api.  Optional grids that are not installed are otherwise looked
+** for again in every directory on each use.  The entries are dropped
+** when the finder or search path are set, PROJ_LIB changes or the init
+** cache is cleared, and a path that cannot be opened again is searched
+** afresh.  Only opens for reading are cached, and only names that do
+** not exist are taken as not found.
+*/
+
+#define OPEN_LIB_CACHE_MAX 256
+
+typedef struct {
+    projFileAPI *fileapi;
+    char        *name;
+    char        *path;      /* NULL if not found */
+    int         err;        /* errno of the failure */
+} open_lib_entry;
+
+static open_lib_entry *open_lib_cache = NULL;
+static int open_lib_count = 0;
+static char *open_lib_proj_lib = NULL; /* PROJ_LIB of the entries */
+
+/************************************************************************/
+/*                      pj_clear_open_lib_cache()                       */
+/************************************************************************/
+
+static void open_lib_drop_entries( void )
+
+{
+    int i;
+
+    for( i = 0; i < open_lib_count; i++ )
+    {
+        pj_dalloc( open_lib_cache[i].name );
+        pj_dalloc( open_lib_cache[i].path );
+    }
+    open_lib_count = 0;
+}
+
+static void open_lib_cache_clear( void )
+
+{
+    open_lib_drop_entries();
+    pj_dalloc( open_lib_cache );
+    open_lib_cache = NULL;
+    pj_dalloc( open_lib_proj_lib );
+    open_lib_proj_lib = NULL;
+}
+
+void pj_clear_open_lib_cache( void )
+
+{
+    pj_acquire_lock();
+    open_lib_cache_clear();
+    pj_release_lock();
+}
+
+/************************************************************************/
+/*                          open_lib_lookup()                           */
+/*                                                                      */
+/*      Find the entry of the name, after dropping all of them if       */
+/*      PROJ_LIB is no longer the one they were found with.  Returns    */
+/*      -1 if there is none, 1 with the path copied to fname, or 0      */
+/*      with the errno of the failure in *err.  Called with the core    */
+/*      lock held.                                                      */
+/************************************************************************/
+
+static int open_lib_lookup( projFileAPI *fileapi, const char *name, 
+                            char *fname, int *err )
+
+{
+    const char *proj_lib = getenv("PROJ_LIB");
+    int i;
+
+    if( (proj_lib == NULL) != (open_lib_proj_lib == NULL)
+        || (proj_lib != NULL && strcmp(proj_lib, open_lib_proj_lib) != 0) )
+    {
+        open_lib_cache_clear();
+        if( proj_lib != NULL 
+            && (open_lib_proj_lib = pj_malloc(strlen(proj_lib)+1)) != NULL )
+            strcpy( open_lib_proj_lib, proj_lib );
+        return -1;
+    }
+
+    for( i = 0; i < open_lib_count; i++ )
+    {
+        open_lib_entry *entry = open_lib_cache + i;
+
+        if( entry->fileapi != fileapi || strcmp(entry->name, name) != 0 )
+            continue;
+
+        if( entry->path == NULL )
+        {
+            *err = entry->err;
+            return 0;
+        }
+
+        strcpy( fname, entry->path );
+        return 1;
+    }
+
+    return -1;
+}
+
+/************************************************************************/
+/*                          open_lib_remember()                         */
+/*                                                                      */
+/*      Record where the name was opened from, or that it was not       */
+/*      found, replacing any entry it had.  The cache only grows to     */
+/*      OPEN_LIB_CACHE_MAX names, and is then started again.            */
+/************************************************************************/
+
+static void open_lib_remember( projFileAPI *fileapi, const char *name,
+                               const char *path, int err )
+
+{
+    open_lib_entry *entry;
+    char *path_copy = NULL;
+    int i;
+
+    if( path != NULL && (path_copy = pj_malloc(strlen(path)+1)) != NULL )
+        strcpy( path_copy, path );
+
+    pj_acquire_lock();
+
+    for( i = 0; i < open_lib_count; i++ )
+    {
+        if( open_lib_cache[i].fileapi == fileapi 
+            && strcmp(open_lib_cache[i].name, name) == 0 )
+            break;
+    }
+
+    if( i == open_lib_count )
+    {
+        if( open_lib_count == OPEN_LIB_CACHE_MAX )
+            open_lib_drop_entries();
+        if( open_lib_cache == NULL )
+            open_lib_cache = (open_lib_entry *) 
+                pj_malloc( sizeof(open_lib_entry) * OPEN_LIB_CACHE_MAX );
+        i = open_lib_count;
+        if( open_lib_cache == NULL
+            || (open_lib_cache[i].name = pj_malloc(strlen(name)+1)) == NULL )
+        {
+            pj_release_lock();
+            pj_dalloc( path_copy );
+            return;
+        }
+        strcpy( open_lib_cache[i].name, name );
+        open_lib_cache[i].fileapi = fileapi;
+        open_lib_cache[i].path = NULL;
+        open_lib_count++;
+    }
+
+    entry = open_lib_cache + i;
+    pj_dalloc( entry->path );
+    entry->path = path_copy;
+    entry->err = err;
+
+    /* a path that could not be copied is not taken for a failure */
+    if( path != NULL && path_copy == NULL )
+    {
+        pj_dalloc( entry->name );
+        *entry = open_lib_cache[--open_lib_count];
+    }
+
+    pj_release_lock();
+}
+
 /************************************************************************/
 /*                           pj_set_finder()                            */
 /************************************************************************/
@@ -56,6 +227,8 @@ void pj_set_finder( const char *(*new_finder)(const char *) )
 
 {
     pj_finder = new_finder;
+    pj_clear_open_lib_cache();
+    pj_clear_defaults();
 }
 
 /************************************************************************/
@@ -92,6 +265,63 @@ void pj_set_searchpath ( int count, const char **path )
     }
         
     path_count = count;
+    pj_clear_open_lib_cache();
+    pj_clear_defaults();
+}
+
+/************************************************************************/
+/*                          open_lib_search()                           */
+/*                                                                      */
+/*      Open sysname, or if it is NULL look for the name through the    */
+/*      finder, PROJ_LIB, or as it is, and else in each directory of    */
+/*      the search path.  The path tried last is left in fname.         */
+/************************************************************************/
+
+static PAFile open_lib_search( projCtx ctx, const char *name, 
+                               const char *sysname, const char *mode, 
+                               char *fname )
+
+{
+    PAFile fid;
+    int n = 0;
+    int i;
+
+    if( sysname == NULL ) {
+        /* try to use application provided file finder */
+        if( pj_finder != NULL && pj_finder( name ) != NULL )
+            sysname = pj_finder( name );
+
+        /* or is environment PROJ_LIB defined */
+        else if ((sysname = getenv("PROJ_LIB")) || (sysname = proj_lib_name)) {
+            (void)strcpy(fname, sysname);
+            fname[n = strlen(fname)] = DIR_CHAR;
+            fname[++n] = '\0';
+            (void)strcpy(fname+n, name);
+            sysname = fname;
+        } else /* just try it bare bones */
+            sysname = name;
+    }
+
+    if ((fid = pj_ctx_fopen(ctx, sysname, mode)) != NULL)
+        errno = 0;
+
+    /* If none of those work and we have a search path, try it */
+    if (!fid && path_count > 0)
+    {
+        for (i = 0; fid == NULL && i < path_count; i++)
+        {
+            sprintf(fname, "%s%c%s", search_path[i], DIR_CHAR, name);
+            sysname = fname;
+            fid = pj_ctx_fopen(ctx, sysname, mode);
+        }
+        if (fid)
+            errno = 0;
+    }
+
+    if( sysname != fname )
+        strcpy( fname, sysname );
+
+    return fid;
 }
 
 /************************************************************************/
@@ -101,10 +331,10 @@ void pj_set_searchpath ( int count, const char **path )
 PAFile
 pj_open_lib(projCtx ctx, const char *name, const char *mode) {
     char fname[MAX_PATH_FILENAME+1];
+    char home_name[MAX_PATH_FILENAME+1];
     const char *sysname;
-    PAFile fid;
-    int n = 0;
-    int i;
+    PAFile fid = NULL;
+    int n = 0, cached = -1;
 #ifdef WIN32
     static const char dir_chars[] = "/\\";
 #else
@@ -116,57 +346,60 @@ pj_open_lib(projCtx ctx, const char *name, const char *mode) {
     /* check if ~/name */
     if (*name == '~' && strchr(dir_chars,name[1]) )
         if ((sysname = getenv("HOME")) != NULL) {
-            (void)strcpy(fname, sysname);
-            fname[n = strlen(fname)] = DIR_CHAR;
-            fname[++n] = '\0';
-            (void)strcpy(fname+n, name + 1);
-            sysname = fname;
+            (void)strcpy(home_name, sysname);
+            home_name[n = strlen(home_name)] = DIR_CHAR;
+            home_name[++n] = '\0';
+            (void)strcpy(home_name+n, name + 1);
+            fid = open_lib_search(ctx, name, home_name, mode, fname);
         } else
             return NULL;
 
-    /* or fixed path: /name, ./name or ../name */
+    /* or fixed path: /name, ./name, ../name or a url */
     else if (strchr(dir_chars,*name)
+             || pj_network_is_url(name)
              || (*name == '.' && strchr(dir_chars,name[1])) 
              || (!strncmp(name, "..", 2) && strchr(dir_chars,name[2]))
              || (name[1] == ':' && strchr(dir_chars,name[2])) )
-        sysname = name;
-
-    /* or try to use application provided file finder */
-    else if( pj_finder != NULL && pj_finder( name ) != NULL )
-        sysname = pj_finder( name );
-
-    /* or is environment PROJ_LIB defined */
-    else if ((sysname = getenv("PROJ_LIB")) || (sysname = proj_lib_name)) {
-        (void)strcpy(fname, sysname);
-        fname[n = strlen(fname)] = DIR_CHAR;
-        fname[++n] = '\0';
-        (void)strcpy(fname+n, name);
-        sysname = fname;
-    } else /* just try it bare bones */
-        sysname = name;
+        fid = open_lib_search(ctx, name, name, mode, fname);
 
-    if ((fid = pj_ctx_fopen(ctx, sysname, mode)) != NULL)
-        errno = 0;
+    /* or look for it, unless where it is, or that it is not, is known */
+    else {
+        projFileAPI *fileapi = pj_ctx_get_fileapi( ctx );
+        int err = 0;
 
-    /* If none of those work and we have a search path, try it */
-    if (!fid && path_count > 0)
-    {
-        for (i = 0; fid == NULL && i < path_count; i++)
+        if( *mode == 'r' )
         {
-            sprintf(fname, "%s%c%s", search_path[i], DIR_CHAR, name);
-            sysname = fname;
-            fid = pj_ctx_fopen(ctx, sysname, mode);
+            pj_acquire_lock();
+            cached = open_lib_lookup( fileapi, name, fname, &err );
+            pj_release_lock();
         }
-        if (fid)
+
+        if( cached == 0 )
+        {
+            strcpy( fname, name );
+            errno = err;
+        }
+        else if( cached == 1 
+                 && (fid = pj_ctx_fopen(ctx, fname, mode)) != NULL )
             errno = 0;
+        else
+        {
+            fid = open_lib_search( ctx, name, NULL, mode, fname );
+            /* other failures, as of too many open files, may pass */
+            if( *mode == 'r' && (fid != NULL || errno == ENOENT) )
+                open_lib_remember( fileapi, name, fid ? fname : NULL, 
+                                   errno );
+        }
     }
 
     if( ctx->last_errno == 0 && errno != 0 )
         pj_ctx_set_errno( ctx, errno );
 
+    PJ_TRACE4( open__lib, name, fname, fid != NULL, cached );
+
     pj_log( ctx, PJ_LOG_DEBUG_MAJOR, 
             "pj_open_lib(%s): call fopen(%s) - %s\n",
-            name, sysname,
+            name, fname,
             fid == NULL ? "failed" : "succeeded" );
 
     return(fid);
@@ -4,17 +4,348 @@
 #include <string.h>
 	paralist * /* create parameter list entry */
 pj_mkparam(char *str) {
+	return pj_mkparam_arena(NULL, str);
+}
+	static paralist * /* node of text, from *arena unless arena is NULL */
+pj_mkparam_node(PJ_ARENA **arena, const char *text) {
 	paralist *newitem;
 
-	if((newitem = (paralist *)pj_malloc(sizeof(paralist) + strlen(str))) != NULL) {
-		newitem->used = 0;
-		newitem->next = 0;
-		if (*str == '+')
-			++str;
-		(void)strcpy(newitem->param, str);
+	if (text == NULL)
+		return NULL;
+	if (arena)
+		newitem = (paralist *)pj_arena_alloc(arena, sizeof(paralist));
+	else
+		newitem = (paralist *)pj_malloc(sizeof(paralist));
+	if (newitem == NULL) {
+		pj_intern_release(text);
+		return NULL;
 	}
+	newitem->used = 0;
+	newitem->next = 0;
+	newitem->index = 0;
+	newitem->in_arena = arena != NULL;
+	newitem->typed = 0;
+	newitem->formatted = 0;
+	newitem->value = 0.;
+	newitem->param = text;
 	return newitem;
 }
+	paralist * /* same, from *arena unless arena is NULL */
+pj_mkparam_arena(PJ_ARENA **arena, const char *str) {
+	if (*str == '+')
+		++str;
+	return pj_mkparam_node(arena, pj_intern(str, strlen(str)));
+}
+
+/*
+** A typed parameter, as set by pj_def_set_double(), holds its value as a
+** number which pj_param() returns as is, or in radians for 'r' as the
+** value is in degrees.  Its param is only the name, until pj_param_text()
+** replaces it with name=value the first time the text is needed, as for
+** 's' lookups and pj_get_def().  The name is kept until the node is
+** freed, for lookups still reading it.
+*/
+#define PARAM_VALUE_LEN  32   /* "=%.17g" */
+#define PARAM_DEG_TO_RAD .0174532925199433 /* as dmstor(), for the same radians */
+
+	paralist * /* create typed parameter list entry */
+pj_mkparam_value(PJ_ARENA **arena, const char *name, double value) {
+	paralist *newitem;
+
+	if (*name == '+')
+		++name;
+	newitem = pj_mkparam_node(arena, pj_intern(name, strcspn(name, "=")));
+	if (newitem != NULL) {
+		newitem->typed = 1;
+		newitem->value = value;
+	}
+	return newitem;
+}
+	paralist * /* copy of a parameter list entry, not its link */
+pj_mkparam_copy(PJ_ARENA **arena, const paralist *item) {
+	if (item->typed)
+		return pj_mkparam_value(arena, item->param, item->value);
+	return pj_mkparam_node(arena, pj_intern_ref(item->param));
+}
+	const char * /* name=value text of a parameter */
+pj_param_text(paralist *pl) {
+	if (pl->typed && !pl->formatted) {
+		pj_acquire_lock();
+		if (!pl->formatted) {
+			char buf[80], *text = buf, *s, *c;
+			size_t len = strcspn(pl->param, "=");
+			int digits = 15;
+
+			if (len + PARAM_VALUE_LEN > sizeof(buf)
+			    && !(text = (char *)pj_malloc(len + PARAM_VALUE_LEN))) {
+				pj_release_lock();
+				return pl->param;
+			}
+			memcpy(text, pl->param, len);
+			s = text + len;
+
+			/* the shortest text that reads back as the value */
+			do {
+				(void)sprintf(s, "=%.*g", digits, pl->value);
+				for (c = s; *c; ++c) /* in case of a decimal comma */
+					if (*c == ',')
+						*c = '.';
+			} while (++digits <= 17 && pj_atof(s + 1) != pl->value);
+
+			/* left as the name alone if out of memory */
+			if ((s = (char *)pj_intern(text, strlen(text))) != NULL) {
+				pl->param = s;
+				pl->formatted = 1;
+			}
+			if (text != buf)
+				pj_dalloc(text);
+		}
+		pj_release_lock();
+	}
+	return pl->param;
+}
+
+/*
+** Long parameter lists get a hash index of the first parameter of each
+** name, hung off the head of the list, so that the many lookups done
+** while setting up a projection do not each walk the whole list.  The
+** list may still be appended to after the index is built, which is
+** picked up on the next lookup, and pj_param_truncate() has to be used
+** to remove parameters from it.
+*/
+#define PARAM_INDEX_MIN      8    /* shorter lists are just scanned */
+#define PARAM_INDEX_BUCKETS  64   /* power of two */
+
+typedef struct {
+	paralist *node;
+	unsigned hash;
+	int name_len;
+	int next;  /* next entry of the bucket, -1 at the end, or -2 if a
+	              parameter of the same name is earlier in the list */
+} param_entry;
+
+struct PJ_PARAM_INDEX {
+	int count;
+	int alloc;
+	param_entry *entries;      /* in list order */
+	int buckets[PARAM_INDEX_BUCKETS];
+};
+
+/************************************************************************/
+/*                          pj_param_hash()                             */
+/************************************************************************/
+
+static unsigned pj_param_hash(const char *name, int len) {
+	unsigned long hash = 2166136261UL;
+
+	while (len-- > 0) {
+		hash ^= (unsigned char) *name++;
+		hash = (hash * 16777619UL) & 0xffffffffUL;
+	}
+	return (unsigned) hash;
+}
+
+/************************************************************************/
+/*                        pj_param_index_find()                         */
+/************************************************************************/
+
+static paralist *
+pj_param_index_find(struct PJ_PARAM_INDEX *index, const char *name, int len,
+                    unsigned hash) {
+	int e;
+
+	for (e = index->buckets[hash & (PARAM_INDEX_BUCKETS-1)]; e >= 0;
+	     e = index->entries[e].next) {
+		param_entry *entry = index->entries + e;
+
+		if (entry->hash == hash && entry->name_len == len
+		    && !strncmp(entry->node->param, name, len))
+			return entry->node;
+	}
+	return NULL;
+}
+
+/************************************************************************/
+/*                         pj_param_index_add()                         */
+/*                                                                      */
+/*      Add the nodes of the list from node on.  Returns FALSE if       */
+/*      out of memory, in which case the index is dropped.              */
+/************************************************************************/
+
+static int
+pj_param_index_add(paralist *list, paralist *node) {
+	struct PJ_PARAM_INDEX *index = list->index;
+
+	for ( ; node != NULL; node = node->next) {
+		param_entry *entry;
+
+		if (index->count == index->alloc) {
+			param_entry *new_entries;
+
+			index->alloc = index->alloc * 2 + 16;
+			new_entries = (param_entry *)
+			    pj_malloc(sizeof(param_entry) * index->alloc);
+			if (new_entries == NULL) {
+				pj_param_index_free(list);
+				return 0;
+			}
+			if (index->count > 0)
+				memcpy(new_entries, index->entries,
+				       sizeof(param_entry) * index->count);
+			pj_dalloc(index->entries);
+			index->entries = new_entries;
+		}
+
+		entry = index->entries + index->count;
+		entry->node = node;
+		entry->name_len = strcspn(node->param, "=");
+		entry->hash = pj_param_hash(node->param, entry->name_len);
+		if (pj_param_index_find(index, node->param, entry->name_len,
+		                        entry->hash) != NULL)
+			entry->next = -2;
+		else {
+			int *bucket = index->buckets
+			    + (entry->hash & (PARAM_INDEX_BUCKETS-1));
+
+			entry->next = *bucket;
+			*bucket = index->count;
+		}
+		index->count++;
+	}
+	return 1;
+}
+
+/************************************************************************/
+/*                        pj_param_index_free()                         */
+/************************************************************************/
+
+void
+pj_param_index_free(paralist *list) {
+	if (list != NULL && list->index != NULL) {
+		pj_dalloc(list->index->entries);
+		pj_dalloc(list->index);
+		list->index = NULL;
+	}
+}
+
+/************************************************************************/
+/*                           pj_param_find()                            */
+/*                                                                      */
+/*      Return the first parameter named name (of length len), or       */
+/*      the first one starting with name=value if name has a value.     */
+/************************************************************************/
+
+static paralist *
+pj_param_find(paralist *list, const char *name, unsigned len) {
+	struct PJ_PARAM_INDEX *index;
+	paralist *pl;
+	int count = 0;
+
+	if (list == NULL)
+		return NULL;
+
+	if ((index = list->index) != NULL) {
+		/* pick up parameters appended since the last lookup */
+		paralist *last = index->entries[index->count-1].node;
+
+		if (last->next == NULL || pj_param_index_add(list, last->next)) {
+			if (strchr(name, '=') == NULL)
+				return pj_param_index_find(list->index, name, len,
+				                           pj_param_hash(name, len));
+		}
+	}
+
+	/* simple linear lookup */
+	for (pl = list; pl && !(!strncmp(pl->param, name, len) &&
+	  (!pl->param[len] || pl->param[len] == '=')); pl = pl->next)
+		count++;
+
+	/* index the list if it proved long enough */
+	if (pl == NULL && count >= PARAM_INDEX_MIN && list->index == NULL) {
+		index = (struct PJ_PARAM_INDEX *)
+		    pj_malloc(sizeof(struct PJ_PARAM_INDEX));
+		if (index != NULL) {
+			int i;
+
+			index->count = index->alloc = 0;
+			index->entries = NULL;
+			for (i = 0; i < PARAM_INDEX_BUCKETS; i++)
+				index->buckets[i] = -1;
+			list->index = index;
+			pj_param_index_add(list, list);
+		}
+	}
+
+	return pl;
+}
+
+/************************************************************************/
+/*                         pj_param_truncate()                          */
+/*                                                                      */
+/*      Free the parameters following last, keeping the index of the    */
+/*      list in step.                                                   */
+/************************************************************************/
+
+void
+pj_param_truncate(paralist *list, paralist *last) {
+	struct PJ_PARAM_INDEX *index = list->index;
+	paralist *pl, *next;
+
+	/* entries are in list order, so those of removed nodes are on top,
+	   and the most recent of their buckets */
+	while (index != NULL && index->count > 1) {
+		param_entry *entry = index->entries + index->count - 1;
+
+		for (pl = last->next; pl != NULL && pl != entry->node; pl = pl->next) {}
+		if (pl == NULL)
+			break;
+
+		if (entry->next != -2)
+			index->buckets[entry->hash & (PARAM_INDEX_BUCKETS-1)]
+			    = entry->next;
+		index->count--;
+	}
+
+	for (pl = last->next; pl != NULL; pl = next) {
+		next = pl->next;
+		pj_free_param(pl);
+	}
+	last->next = NULL;
+}
+
+/************************************************************************/
+/*                          pj_free_paralist()                          */
+/*                                                                      */
+/*      Free the nodes of the list, but for those of an arena, which    */
+/*      go with it.                                                     */
+/************************************************************************/
+
+void
+pj_free_paralist(paralist *list) {
+	paralist *next;
+
+	for ( ; list != NULL; list = next) {
+		next = list->next;
+		pj_param_index_free(list);
+		pj_free_param(list);
+	}
+}
+
+/************************************************************************/
+/*                            pj_free_param()                           */
+/*                                                                      */
+/*      Free a node unlinked from its list, giving back its text, but   */
+/*      for the node itself if it is in an arena.                       */
+/************************************************************************/
+
+void
+pj_free_param(paralist *pl) {
+	if (pl->formatted)
+		pj_intern_release_text(pl->param, strcspn(pl->param, "="));
+	pj_intern_release(pl->param);
+	if (!pl->in_arena)
+		pj_dalloc(pl);
+}
 
 /************************************************************************/
 /*                              pj_param()                              */
@@ -44,16 +375,33 @@ pj_param(projCtx ctx, paralist *pl, const char *opt) {
 		ctx = pj_get_default_ctx();
 
 	type = *opt++;
-	/* simple linear lookup */
 	l = strlen(opt);
-	while (pl && !(!strncmp(pl->param, opt, l) &&
-	  (!pl->param[l] || pl->param[l] == '=')))
-		pl = pl->next;
+	pl = pj_param_find(pl, opt, l);
 	if (type == 't')
 		value.i = pl != 0;
-	else if (pl) {
-		pl->used |= 1;
-		opt = pl->param + l;
+	else if (pl && pl->typed && type != 's') {
+		if (!pl->used) /* not written again, for shared definitions */
+			pl->used |= 1;
+		switch (type) {
+		case 'i':
+			value.i = (int) pl->value;
+			break;
+		case 'd':
+			value.f = pl->value;
+			break;
+		case 'r':
+			value.f = pl->value * PARAM_DEG_TO_RAD;
+			break;
+		case 'b':
+			value.i = pl->value != 0.;
+			break;
+		default:
+			goto bum_type;
+		}
+	} else if (pl) {
+		if (!pl->used) /* not written again, for shared definitions */
+			pl->used |= 1;
+		opt = pj_param_text(pl) + l;
 		if (*opt == '=')
 			++opt;
 		switch (type) {
@@ -61,7 +409,7 @@ pj_param(projCtx ctx, paralist *pl, const char *opt) {
 			value.i = atoi(opt);
 			break;
 		case 'd':	/* simple real input */
-			value.f = atof(opt);
+			value.f = pj_atof(opt);
 			break;
 		case 'r':	/* degrees input */
 			value.f = dmstor_ctx(ctx, opt, 0);
@@ -4,14 +4,14 @@
 #define HALFPI		1.5707963267948966
 #define TOL 1.0e-10
 #define N_ITER 15
+#define SERIES_MAX_N 0.01	/* third flattening the series is exact for */
 
-	double
-pj_phi2(projCtx ctx, double ts, double e) {
-	double eccnth, Phi, con, dphi;
+	static double /* the original fixed point iteration, from Phi */
+phi2_iterate(projCtx ctx, double ts, double e, double Phi) {
+	double eccnth, con, dphi;
 	int i;
 
 	eccnth = .5 * e;
-	Phi = HALFPI - 2. * atan (ts);
 	i = N_ITER;
 	do {
 		con = e * sin (Phi);
@@ -22,4 +22,81 @@ pj_phi2(projCtx ctx, double ts, double e) {
 	if (i <= 0)
 		pj_ctx_set_errno( ctx, -18 );
 	return Phi;
+}
+	void /* series coefficients for eccentricity e */
+pj_phi2_init(struct PJ_PHI2 *q, double e) {
+	double f, n, np;
+
+	/* conformal -> geodetic latitude in the third flattening n, as
+	   cgb of proj_etmerc.c, Engsager and Poder: ICC2007 */
+	f = e * e / (1. + sqrt(1. - e * e));
+	np = n = f / (2. - f);
+	q->e = e;
+	q->series = n <= SERIES_MAX_N;
+	q->cgb[0] = n*( 2 + n*(-2/3.0  + n*(-2      + n*(116/45.0 + n*(26/45.0 +
+		n*(-2854/675.0 ))))));
+	np *= n;
+	q->cgb[1] = np*(7/3.0 + n*( -8/5.0  + n*(-227/45.0 + n*(2704/315.0 +
+		n*( 2323/945.0)))));
+	np *= n;
+	q->cgb[2] = np*( 56/15.0  + n*(-136/35.0 + n*(-1262/105.0 +
+		n*( 73814/2835.0))));
+	np *= n;
+	q->cgb[3] = np*(4279/630.0 + n*(-332/35.0 + n*(-399572/14175.0)));
+	np *= n;
+	q->cgb[4] = np*(4174/315.0 + n*(-144838/6237.0 ));
+	np *= n;
+	q->cgb[5] = np*(601676/22275.0 );
+}
+	static double /* latitude of ts through the series */
+phi2_series(const struct PJ_PHI2 *q, double ts) {
+	const double *p;
+	double chi, t2, s, c, sin_2chi, cos_2chi2, h = 0., h1, h2 = 0.;
+
+	/* chi = HALFPI - 2 atan(ts), whose sine and cosine need no
+	   trigonometry: sin chi = (1 - ts^2)/(1 + ts^2), cos chi =
+	   2 ts/(1 + ts^2), using 1/ts the same way for large ts */
+	chi = HALFPI - 2. * atan(ts);
+	if (ts <= 1.) {
+		t2 = ts * ts;
+		s = (1. - t2) / (1. + t2);
+		c = 2. * ts / (1. + t2);
+	} else {
+		t2 = 1. / ts;
+		c = 2. * t2 / (1. + t2 * t2);
+		t2 *= t2;
+		s = (t2 - 1.) / (t2 + 1.);
+	}
+	sin_2chi = 2. * s * c;
+	cos_2chi2 = 2. * (c - s) * (c + s); /* twice cos(2 chi) */
+	/* Clenshaw summation, as gatg() of proj_etmerc.c */
+	for (p = q->cgb + PJ_PHI2_ORDER, h1 = *--p; p - q->cgb; h2 = h1, h1 = h)
+		h = -h2 + cos_2chi2 * h1 + *--p;
+	return chi + h * sin_2chi;
+}
+	double /* latitude of the isometric ts, for the setup of pj_phi2_init() */
+pj_phi2_ts(projCtx ctx, const struct PJ_PHI2 *q, double ts) {
+	double Phi = phi2_series(q, ts);
+
+	return q->series ? Phi : phi2_iterate(ctx, ts, q->e, Phi);
+}
+	void /* pj_phi2_ts() of n values in place, skipping HUGE_VAL */
+pj_phi2_array(projCtx ctx, const struct PJ_PHI2 *q, long n, double *ts) {
+	long i;
+
+	if (q->series) {
+		for (i = 0; i < n; ++i)
+			if (ts[i] != HUGE_VAL)
+				ts[i] = phi2_series(q, ts[i]);
+	} else
+		for (i = 0; i < n; ++i)
+			if (ts[i] != HUGE_VAL)
+				ts[i] = phi2_iterate(ctx, ts[i], q->e, phi2_series(q, ts[i]));
+}
+	double
+pj_phi2(projCtx ctx, double ts, double e) {
+	struct PJ_PHI2 q;
+
+	pj_phi2_init(&q, e);
+	return pj_phi2_ts(ctx, &q, ts);
 }
@@ -0,0 +1,339 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Loading of grids on a background thread, ahead of the first
+ *           transformation that needs them, or while the contexts that
+ *           must not wait on them report their points as not ready.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <string.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** The worker has its own context, copied from the caller's so that it
+** uses the same grid registry and file api.  Grids are loaded whole, as
+** tiles are cached per context and those of the worker could not be
+** used by anyone else.
+*/
+typedef struct {
+    projCtx_t  ctx;
+    char       *nadgrids;
+    double     ll_long, ll_lat, ur_long, ur_lat;
+    void       *thread;  /* NULL if the load ran in the caller */
+    int        result;   /* 0, or the error of the first failed load */
+} PJ_GRID_PREFETCH;
+
+/************************************************************************/
+/*                        pj_prefetch_overlaps()                        */
+/************************************************************************/
+
+static int pj_prefetch_overlaps( PJ_GRID_PREFETCH *prefetch,
+                                 struct CTABLE *ct )
+
+{
+    double ur_lam = ct->ll.lam + ct->del.lam * (ct->lim.lam - 1);
+    double ur_phi = ct->ll.phi + ct->del.phi * (ct->lim.phi - 1);
+
+    return ct->ll.lam <= prefetch->ur_long && ur_lam >= prefetch->ll_long
+        && ct->ll.phi <= prefetch->ur_lat && ur_phi >= prefetch->ll_lat;
+}
+
+/************************************************************************/
+/*                         pj_prefetch_grid()                           */
+/*                                                                      */
+/*      Load a grid if it meets the region, then its subgrids.          */
+/************************************************************************/
+
+static void pj_prefetch_grid( PJ_GRID_PREFETCH *prefetch, PJ_GRIDINFO *gi )
+
+{
+    PJ_GRIDINFO *child;
+
+    if( gi->ct == NULL || !pj_prefetch_overlaps( prefetch, gi->ct ) )
+        return;
+
+    if( !pj_gridinfo_load( &(prefetch->ctx), gi ) )
+    {
+        if( prefetch->result == 0 )
+            prefetch->result = prefetch->ctx.last_errno
+                ? prefetch->ctx.last_errno : -38;
+        return;
+    }
+
+    for( child = gi->child; child != NULL; child = child->next )
+        pj_prefetch_grid( prefetch, child );
+}
+
+/************************************************************************/
+/*                          pj_prefetch_run()                           */
+/************************************************************************/
+
+static void pj_prefetch_run( void *arg )
+
+{
+    PJ_GRID_PREFETCH *prefetch = (PJ_GRID_PREFETCH *) arg;
+    PJ_GRIDINFO **gridlist;
+    int grid_count, i;
+
+    gridlist = pj_gridlist_from_nadgrids( &(prefetch->ctx),
+                                          prefetch->nadgrids, &grid_count );
+    if( gridlist == NULL )
+    {
+        prefetch->result = prefetch->ctx.last_errno
+            ? prefetch->ctx.last_errno : -38;
+        return;
+    }
+
+    for( i = 0; i < grid_count; i++ )
+        pj_prefetch_grid( prefetch, gridlist[i] );
+
+    pj_dalloc( gridlist );
+}
+
+/************************************************************************/
+/*                       pj_ctx_prefetch_grids()                        */
+/*                                                                      */
+/*      Start loading the grids of a +nadgrids list on another thread,  */
+/*      those and the subgrids meeting the region (in radians, all of   */
+/*      them for -HUGE_VAL, -HUGE_VAL, HUGE_VAL, HUGE_VAL) only.  The   */
+/*      result must be passed to pj_grid_prefetch_wait().  Without      */
+/*      threads the grids are loaded before returning.  Returns NULL    */
+/*      if out of memory.                                               */
+/************************************************************************/
+
+projGridPrefetch pj_ctx_prefetch_grids( projCtx ctx, const char *nadgrids,
+                                        double ll_long, double ll_lat,
+                                        double ur_long, double ur_lat )
+
+{
+    PJ_GRID_PREFETCH *prefetch;
+
+    if( ctx == NULL )
+        ctx = pj_get_default_ctx();
+
+    prefetch = (PJ_GRID_PREFETCH *) pj_malloc(sizeof(PJ_GRID_PREFETCH));
+    if( prefetch == NULL )
+    {
+        pj_ctx_set_errno( ctx, -38 );
+        return NULL;
+    }
+
+    prefetch->nadgrids = (char *) pj_malloc(strlen(nadgrids) + 1);
+    if( prefetch->nadgrids == NULL )
+    {
+        pj_dalloc( prefetch );
+        pj_ctx_set_errno( ctx, -38 );
+        return NULL;
+    }
+    strcpy( prefetch->nadgrids, nadgrids );
+
+    memcpy( &(prefetch->ctx), ctx, sizeof(projCtx_t) );
+    prefetch->ctx.last_errno = 0;
+    prefetch->ctx.grid_tiles = NULL;
+    prefetch->ctx.grid_tile_count = 0;
+    prefetch->ctx.grid_tile_limit = 0;
+    prefetch->ctx.errno_globals = 0;
+    prefetch->ctx.stats = NULL; /* not shared with the calling thread */
+
+    prefetch->ll_long = ll_long;
+    prefetch->ll_lat = ll_lat;
+    prefetch->ur_long = ur_long;
+    prefetch->ur_lat = ur_lat;
+    prefetch->result = 0;
+
+    prefetch->thread = pj_thread_start( pj_prefetch_run, prefetch );
+    if( prefetch->thread == NULL )
+        pj_prefetch_run( prefetch );
+
+    return prefetch;
+}
+
+/************************************************************************/
+/*                       pj_grid_prefetch_wait()                        */
+/*                                                                      */
+/*      Wait for a prefetch to complete and release it.  Returns 0 if   */
+/*      all the grids were loaded, or the error of the first one that   */
+/*      could not be.                                                   */
+/************************************************************************/
+
+int pj_grid_prefetch_wait( projGridPrefetch handle )
+
+{
+    PJ_GRID_PREFETCH *prefetch = (PJ_GRID_PREFETCH *) handle;
+    int result;
+
+    if( prefetch == NULL )
+        return -38;
+
+    pj_thread_join( prefetch->thread );
+
+    result = prefetch->result;
+    pj_dalloc( prefetch->nadgrids );
+    pj_dalloc( prefetch );
+
+    return result;
+}
+
+/*
+** A grid is loaded in the background for contexts that must not block on
+** it, see pj_ctx_set_grid_nonblocking(), by a thread of its own with a
+** copy of the context.  The grid keeps the thread, joined by the next
+** load or when the grid is freed, and whether it is running or failed,
+** under its lock, so that the points waiting on it start a single load.
+*/
+typedef struct {
+    projCtx_t   ctx;
+    PJ_GRIDINFO *gi;
+} PJ_GRID_LOAD;
+
+/************************************************************************/
+/*                       pj_gridinfo_quant_ready()                      */
+/*                                                                      */
+/*      Whether the context would use quantized values for the grid,    */
+/*      and, if wanted is FALSE, whether they are there.                */
+/************************************************************************/
+
+static int pj_gridinfo_quant_ready( projCtx ctx, PJ_GRIDINFO *gi,
+                                    int wanted )
+
+{
+    const PJ_GRID_QUANT *quant = gi->quant;
+
+    if( ctx->grid_quantize <= 0.0
+        || (!pj_gridinfo_heights( gi ) && !pj_gridinfo_tiled( ctx, gi )) )
+        return 0;
+
+    return wanted || (quant != NULL && quant->values != NULL
+                      && quant->max_error <= ctx->grid_quantize);
+}
+
+/************************************************************************/
+/*                         pj_grid_load_run()                           */
+/************************************************************************/
+
+static void pj_grid_load_run( void *arg )
+
+{
+    PJ_GRID_LOAD *load = (PJ_GRID_LOAD *) arg;
+    PJ_GRIDINFO *gi = load->gi;
+    int ok;
+
+    /* the whole grid if it could not be quantized */
+    ok = (pj_gridinfo_quant_ready( &(load->ctx), gi, 1 )
+          && pj_gridinfo_quantized( &(load->ctx), gi ) != NULL)
+        || pj_gridinfo_load( &(load->ctx), gi );
+
+    pj_mutex_lock( gi->lock );
+    gi->load_async = ok ? 0 : -1;
+    pj_mutex_unlock( gi->lock );
+
+    pj_dalloc( load );
+}
+
+/************************************************************************/
+/*                       pj_gridinfo_load_async()                       */
+/*                                                                      */
+/*      Start loading a grid on another thread, unless it already is    */
+/*      or a load there failed.  Without threads the grid is loaded     */
+/*      before returning.                                               */
+/************************************************************************/
+
+void pj_gridinfo_load_async( projCtx ctx, PJ_GRIDINFO *gi )
+
+{
+    PJ_GRID_LOAD *load = NULL;
+    void *thread = NULL;
+
+    pj_mutex_lock( gi->lock );
+    if( gi->load_async == 0 )
+    {
+        /* that of an earlier load, since evicted, has returned */
+        pj_thread_join( gi->load_thread );
+        gi->load_thread = NULL;
+
+        load = (PJ_GRID_LOAD *) pj_malloc(sizeof(PJ_GRID_LOAD));
+        if( load != NULL )
+        {
+            memcpy( &(load->ctx), ctx, sizeof(projCtx_t) );
+            load->ctx.last_errno = 0;
+            load->ctx.grid_tiles = NULL;
+            load->ctx.grid_tile_count = 0;
+            load->ctx.errno_globals = 0;
+            load->ctx.stats = NULL; /* not shared with the calling thread */
+            load->ctx.grid_nonblocking = 0;
+            load->gi = gi;
+
+            gi->load_async = 1;
+            thread = gi->load_thread = pj_thread_start( pj_grid_load_run,
+                                                        load );
+            if( thread == NULL )
+                gi->load_async = 0;
+        }
+    }
+    pj_mutex_unlock( gi->lock );
+
+    if( load != NULL && thread == NULL )
+        pj_grid_load_run( load );
+}
+
+/************************************************************************/
+/*                         pj_gridinfo_ready()                          */
+/*                                                                      */
+/*      Whether the values of a grid can be used without reading it.    */
+/*      They always can unless the context is non-blocking, in which    */
+/*      case a grid not in memory is loaded in the background.          */
+/*      Returns 0, PJD_ERR_GRID_NOT_READY meanwhile, or -38 if the      */
+/*      load failed, with the error set on the context.                 */
+/************************************************************************/
+
+int pj_gridinfo_ready( projCtx ctx, PJ_GRIDINFO *gi )
+
+{
+    if( !ctx->grid_nonblocking || gi->ct->cvs != NULL
+        || pj_gridinfo_quant_ready( ctx, gi, 0 ) )
+        return 0;
+
+    if( gi->load_async == 0 )
+    {
+        pj_gridinfo_load_async( ctx, gi );
+
+        /* loaded here, without threads */
+        if( gi->ct->cvs != NULL || pj_gridinfo_quant_ready( ctx, gi, 0 ) )
+            return 0;
+    }
+
+    if( gi->load_async == -1 )
+    {
+        pj_ctx_set_errno( ctx, -38 );
+        return -38;
+    }
+
+    pj_ctx_set_errno( ctx, PJD_ERR_GRID_NOT_READY );
+    return PJD_ERR_GRID_NOT_READY;
+}
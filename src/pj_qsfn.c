@@ -1,16 +1,16 @@
 /* determine small q */
-#include <math.h>
 #include <projects.h>
-
-# define EPSILON 1.0e-7
+#include <pj_math.h>
 	double
 pj_qsfn(double sinphi, double e, double one_es) {
-	double con;
+	return pj_qsfn_i(sinphi, e, one_es);
+}
+	void /* n latitudes, stride doubles apart, replaced in place by
+	        pj_qsfn() of their sines.  HUGE_VAL values are left as they are */
+pj_qsfn_n(long n, int stride, double *phi, double e, double one_es) {
+	long i;
 
-	if (e >= EPSILON) {
-		con = e * sinphi;
-		return (one_es * (sinphi / (1. - con * con) -
-		   (.5 / e) * log ((1. - con) / (1. + con))));
-	} else
-		return (sinphi + sinphi);
+	for (i = 0; i < n; ++i, phi += stride)
+		if (*phi != HUGE_VAL)
+			*phi = pj_qsfn_i(sin(*phi), e, one_es);
 }
@@ -0,0 +1,375 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Named shared memory segments, filled once by one process and
+ *           then mapped read-only by every process of the host.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#if !defined(_WIN32) && !defined(SHM_stub) && defined(__GNUC__)
+#  define SHM_posix
+/* off_t of 64 bits for mmap() on 32 bit systems too */
+#  ifndef _FILE_OFFSET_BITS
+#    define _FILE_OFFSET_BITS 64
+#  endif
+#endif
+
+#include <projects.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef SHM_posix
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+PJ_CVSID("$Id$");
+
+/*
+** A segment holds data that one process computes, such as the values of
+** a grid converted on loading, for the other processes of the host to
+** map instead of computing it again.  It is named from a hash of a key
+** string, which the caller builds from whatever identifies the data and
+** its layout, and which is kept in the header page too, to guard
+** against names that collide.  The first process creates the segment,
+** exclusively, fills it and marks it ready; from then on it is only
+** read.  A process finding a segment not ready yet, as one still being
+** filled, does the work itself.  A count of the processes mapping the
+** segment is kept in the header, and the last one releasing it removes
+** the name.  Processes ending without releasing their segments leave
+** them for the next ones; "rm /dev/shm/proj-*" clears them on Linux.
+**
+** Only on POSIX systems, with the GNU atomic builtins the count relies
+** on; elsewhere no segment is ever found or created.
+*/
+
+#define PJ_SHM_MAGIC   "PJGSHM1"   /* version of the layout */
+
+#ifdef SHM_posix
+
+typedef struct {
+    char          magic[8];
+    volatile int  ready;        /* the data is complete */
+    volatile int  refs;         /* processes mapping it */
+    double        size;         /* bytes of data */
+    char          key[PJ_SHM_KEY_MAX];
+} PJ_SHM_HEADER;
+
+struct PJ_SHM_t {
+    PJ_SHM_HEADER *header;      /* the first page, read-write */
+    void        *data;          /* the pages after it */
+    size_t      page, size;
+    ino_t       inode;
+    int         created;        /* by this process, maybe not ready */
+    char        name[48];
+};
+
+/************************************************************************/
+/*                            pj_shm_name()                             */
+/*                                                                      */
+/*      "/proj-<prefix>-" and the pj_hash_name() of the key.            */
+/************************************************************************/
+
+static int pj_shm_name( const char *prefix, const char *key, char *name )
+
+{
+    char hash[17];
+
+    if( strlen( prefix ) > 16 || strlen( key ) >= PJ_SHM_KEY_MAX )
+        return 0;
+
+    pj_hash_name( key, hash );
+    sprintf( name, "/proj-%s-%s", prefix, hash );
+
+    return 1;
+}
+
+/************************************************************************/
+/*                            pj_shm_map()                              */
+/*                                                                      */
+/*      Map the header and the data of an open segment, which must be   */
+/*      a ready one of key unless just created, and count this          */
+/*      process as a user.                                              */
+/************************************************************************/
+
+static PJ_SHM *pj_shm_map( int fd, const char *key, const char *name,
+                           int created )
+
+{
+    PJ_SHM *shm;
+    struct stat st;
+    long page = sysconf( _SC_PAGESIZE );
+    void *header;
+
+    if( page < (long) sizeof(PJ_SHM_HEADER) || fstat( fd, &st ) != 0
+        || st.st_size < page )
+        return NULL;
+
+    header = mmap( NULL, page, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if( header == MAP_FAILED )
+        return NULL;
+
+    shm = (PJ_SHM *) pj_malloc( sizeof(PJ_SHM) );
+    if( shm == NULL )
+    {
+        munmap( header, page );
+        return NULL;
+    }
+    shm->header = (PJ_SHM_HEADER *) header;
+    shm->page = page;
+    shm->size = (size_t) (st.st_size - page);
+    shm->inode = st.st_ino;
+    shm->created = created;
+    strcpy( shm->name, name );
+
+    if( !created
+        && (memcmp( shm->header->magic, PJ_SHM_MAGIC, 8 ) != 0
+            || !shm->header->ready
+            || strcmp( shm->header->key, key ) != 0
+            || shm->header->size != (double) shm->size) )
+    {
+        munmap( header, page );
+        pj_dalloc( shm );
+        return NULL;
+    }
+
+    shm->data = shm->size == 0 ? NULL
+        : mmap( NULL, shm->size, created ? PROT_READ | PROT_WRITE
+                : PROT_READ, MAP_SHARED, fd, (off_t) page );
+    if( shm->data == MAP_FAILED )
+    {
+        munmap( header, page );
+        pj_dalloc( shm );
+        return NULL;
+    }
+
+    __sync_fetch_and_add( &(shm->header->refs), 1 );
+
+    return shm;
+}
+
+#else
+
+struct PJ_SHM_t {
+    void        *data;
+    size_t      size;
+    char        name[48];
+};
+
+#endif /* def SHM_posix */
+
+/************************************************************************/
+/*                           pj_shm_attach()                            */
+/*                                                                      */
+/*      Map the ready segment of key read-only, or return NULL if       */
+/*      there is none.                                                  */
+/************************************************************************/
+
+PJ_SHM *pj_shm_attach( const char *prefix, const char *key )
+
+{
+#ifdef SHM_posix
+    char name[48];
+    PJ_SHM *shm;
+    int fd;
+
+    if( !pj_shm_name( prefix, key, name ) )
+        return NULL;
+
+    fd = shm_open( name, O_RDWR, 0 );
+    if( fd < 0 )
+        return NULL;
+
+    shm = pj_shm_map( fd, key, name, 0 );
+    close( fd );
+
+    return shm;
+#else
+    (void) prefix;
+    (void) key;
+    return NULL;
+#endif
+}
+
+/************************************************************************/
+/*                           pj_shm_create()                            */
+/*                                                                      */
+/*      Create the segment of key with size bytes of data, mapped       */
+/*      read-write for the caller to fill before pj_shm_ready().        */
+/*      Returns NULL if it exists already, made by another process,     */
+/*      or cannot be made.                                              */
+/************************************************************************/
+
+PJ_SHM *pj_shm_create( const char *prefix, const char *key, size_t size )
+
+{
+#ifdef SHM_posix
+    char name[48];
+    long page = sysconf( _SC_PAGESIZE );
+    PJ_SHM *shm = NULL;
+    int fd;
+
+    if( !pj_shm_name( prefix, key, name ) || page <= 0 )
+        return NULL;
+
+    fd = shm_open( name, O_RDWR | O_CREAT | O_EXCL, 0600 );
+    if( fd < 0 )
+        return NULL;
+
+    /* tmpfs pages are only taken when touched, and a full one would
+       raise SIGBUS as the data is written, so they are reserved up
+       front */
+    if( ftruncate( fd, (off_t) page + size ) != 0
+#ifdef __linux__
+        || posix_fallocate( fd, 0, (off_t) page + size ) != 0
+#endif
+        || (shm = pj_shm_map( fd, key, name, 1 )) == NULL )
+    {
+        shm_unlink( name );
+        close( fd );
+        return NULL;
+    }
+    close( fd );
+
+    memcpy( shm->header->magic, PJ_SHM_MAGIC, 8 );
+    strcpy( shm->header->key, key );
+    shm->header->size = (double) size;
+
+    return shm;
+#else
+    (void) prefix;
+    (void) key;
+    (void) size;
+    return NULL;
+#endif
+}
+
+/************************************************************************/
+/*                            pj_shm_ready()                            */
+/*                                                                      */
+/*      Mark a segment filled by pj_shm_create()'s caller ready for     */
+/*      the other processes, its data being read-only from now on.      */
+/************************************************************************/
+
+void pj_shm_ready( PJ_SHM *shm )
+
+{
+#ifdef SHM_posix
+    __sync_synchronize();
+    shm->header->ready = 1;
+    if( shm->size > 0 )
+        mprotect( shm->data, shm->size, PROT_READ );
+#else
+    (void) shm;
+#endif
+}
+
+/************************************************************************/
+/*                          pj_shm_release()                            */
+/*                                                                      */
+/*      Unmap a segment, of type void * to be the unmap function of     */
+/*      grids.  The last process removes the name, unless it names a    */
+/*      newer segment by then, as does the creator of a segment not     */
+/*      made ready.                                                     */
+/************************************************************************/
+
+void pj_shm_release( void *handle )
+
+{
+#ifdef SHM_posix
+    PJ_SHM *shm = (PJ_SHM *) handle;
+    int last;
+
+    if( shm == NULL )
+        return;
+
+    if( shm->data != NULL )
+        munmap( shm->data, shm->size );
+    last = __sync_sub_and_fetch( &(shm->header->refs), 1 ) == 0
+        || (shm->created && !shm->header->ready);
+    if( last )
+    {
+        int fd = shm_open( shm->name, O_RDONLY, 0 );
+        struct stat st;
+
+        if( fd >= 0 )
+        {
+            if( fstat( fd, &st ) == 0 && st.st_ino == shm->inode )
+                shm_unlink( shm->name );
+            close( fd );
+        }
+    }
+    munmap( (void *) shm->header, shm->page );
+    pj_dalloc( shm );
+#else
+    (void) handle;
+#endif
+}
+
+/************************************************************************/
+/*                            pj_shm_data()                             */
+/************************************************************************/
+
+void *pj_shm_data( PJ_SHM *shm )
+
+{
+    return shm->data;
+}
+
+/************************************************************************/
+/*                            pj_shm_size()                             */
+/************************************************************************/
+
+size_t pj_shm_size( PJ_SHM *shm )
+
+{
+    return shm->size;
+}
+
+/************************************************************************/
+/*                          pj_shm_get_name()                           */
+/************************************************************************/
+
+const char *pj_shm_get_name( PJ_SHM *shm )
+
+{
+    return shm->name;
+}
+
+/************************************************************************/
+/*                          pj_shm_supported()                          */
+/************************************************************************/
+
+int pj_shm_supported( void )
+
+{
+#ifdef SHM_posix
+    return 1;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,346 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Optional per context instrumentation of the transformation
+ *           stages, grid loads, init caches and lock waits.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <projects.h>
+#include <string.h>
+#include <math.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** The counters are only kept once pj_ctx_set_stats() has been called
+** on a context, and each instrumented site then costs a test of
+** ctx->stats.  A context is used by one thread at a time, so they are
+** updated without locking: the threads sharing a batch, pj_init_many()
+** or an asynchronous transformation count into scratch contexts of
+** their own, merged into the calling one with pj_stats_merge() when
+** they are done, and each PJ_STATS is kept on cache lines of its own.
+*/
+
+/************************************************************************/
+/*                          pj_ctx_set_stats()                          */
+/*                                                                      */
+/*      Enable or disable the instrumentation of a context.  Enabling   */
+/*      it again resets the counters.                                   */
+/************************************************************************/
+
+void pj_ctx_set_stats( projCtx ctx, int enable )
+
+{
+    if( !enable )
+    {
+        pj_dalloc( ctx->stats );
+        ctx->stats = NULL;
+        return;
+    }
+
+    if( ctx->stats == NULL )
+    {
+        ctx->stats = (PJ_STATS *) pj_malloc(sizeof(PJ_STATS));
+        if( ctx->stats != NULL )
+            memset( ctx->stats, 0, sizeof(PJ_STATS) );
+    }
+    if( ctx->stats != NULL )
+        pj_ctx_reset_stats( ctx );
+}
+
+/************************************************************************/
+/*                         pj_ctx_reset_stats()                         */
+/*                                                                      */
+/*      Zero the counters.  The callback, if any, is kept.              */
+/************************************************************************/
+
+void pj_ctx_reset_stats( projCtx ctx )
+
+{
+    if( ctx->stats == NULL )
+        return;
+
+    memset( &(ctx->stats->stats), 0, sizeof(projStats) );
+    pj_get_lock_wait( &(ctx->stats->lock_waits_at_reset),
+                      &(ctx->stats->lock_wait_ns_at_reset) );
+}
+
+/************************************************************************/
+/*                          pj_ctx_get_stats()                          */
+/*                                                                      */
+/*      Copy the counters of the context since the last reset.  The     */
+/*      locks are shared by all contexts, so lock_wait counts the       */
+/*      waits of the whole process meanwhile, and isa is that of the    */
+/*      kernels, see pj_ctx_get_isa().  Returns -1, with the counters   */
+/*      zeroed, if the instrumentation is not enabled.                  */
+/************************************************************************/
+
+int pj_ctx_get_stats( projCtx ctx, projStats *stats )
+
+{
+    double waits, wait_ns;
+
+    if( ctx->stats == NULL )
+    {
+        memset( stats, 0, sizeof(projStats) );
+        return -1;
+    }
+
+    memcpy( stats, &(ctx->stats->stats), sizeof(projStats) );
+
+    pj_get_lock_wait( &waits, &wait_ns );
+    stats->lock_wait.calls = waits - ctx->stats->lock_waits_at_reset;
+    stats->lock_wait.nanoseconds = wait_ns - ctx->stats->lock_wait_ns_at_reset;
+    stats->isa = pj_ctx_get_isa( ctx );
+
+    return 0;
+}
+
+/************************************************************************/
+/*                     pj_ctx_set_stats_callback()                      */
+/*                                                                      */
+/*      Have callback called with the counters, as pj_ctx_get_stats()   */
+/*      returns them, and the app data of the context once interval     */
+/*      seconds have passed, enabling the instrumentation if needed.    */
+/*      It is called on the thread of the context, at the end of a      */
+/*      transformation or pj_init_ctx() call, so a context left idle    */
+/*      is not reported.  A NULL callback stops the calls.              */
+/************************************************************************/
+
+void pj_ctx_set_stats_callback( projCtx ctx,
+                                void (*callback)(void *, const projStats *),
+                                double interval )
+
+{
+    if( ctx->stats == NULL )
+    {
+        if( callback == NULL )
+            return;
+
+        pj_ctx_set_stats( ctx, 1 );
+        if( ctx->stats == NULL )
+            return;
+    }
+
+    ctx->stats->callback = callback;
+    ctx->stats->callback_interval_ns = interval > 0.0 ? interval * 1e9 : 0.0;
+    ctx->stats->callback_due_ns = 
+        pj_clock_ns() + ctx->stats->callback_interval_ns;
+}
+
+/************************************************************************/
+/*                           pj_stats_poll()                            */
+/*                                                                      */
+/*      Call the callback of the context if it is due.                  */
+/************************************************************************/
+
+void pj_stats_poll( projCtx ctx )
+
+{
+    PJ_STATS  *stats = ctx->stats;
+    projStats snapshot;
+    double    now;
+
+    if( stats == NULL || stats->callback == NULL )
+        return;
+
+    now = pj_clock_ns();
+    if( now < stats->callback_due_ns )
+        return;
+
+    /* due again an interval from now, not from the previous due time,
+       so that a context idle for a while is not reported in a burst */
+    stats->callback_due_ns = now + stats->callback_interval_ns;
+
+    pj_ctx_get_stats( ctx, &snapshot );
+    stats->callback( ctx->app_data, &snapshot );
+}
+
+/************************************************************************/
+/*                            pj_stats_add()                            */
+/************************************************************************/
+
+void pj_stats_add( projStatsCounter *counter, double points, double ns )
+
+{
+    counter->calls += 1.0;
+    counter->points += points;
+    counter->nanoseconds += ns;
+}
+
+/************************************************************************/
+/*                        pj_stats_add_latency()                        */
+/*                                                                      */
+/*      Count a call of ns nanoseconds in its power of two bucket.      */
+/************************************************************************/
+
+void pj_stats_add_latency( projStatsLatency *latency, double ns )
+
+{
+    int    bucket = 0, exponent;
+
+    /* ns = m * 2^exponent with 0.5 <= m < 1 */
+    if( ns >= 2.0 )
+    {
+        frexp( ns, &exponent );
+        bucket = exponent - 1;
+        if( bucket >= PJ_STATS_LATENCY_BUCKETS )
+            bucket = PJ_STATS_LATENCY_BUCKETS - 1;
+    }
+
+    latency->counts[bucket] += 1.0;
+}
+
+/************************************************************************/
+/*                       pj_stats_add_grid_load()                       */
+/*                                                                      */
+/*      Account a load of bytes of grid data.                           */
+/************************************************************************/
+
+void pj_stats_add_grid_load( PJ_STATS *stats, double bytes, double ns )
+
+{
+    pj_stats_add( &(stats->stats.grid_load), bytes, ns );
+    pj_stats_add_latency( &(stats->stats.grid_load_latency), ns );
+}
+
+/************************************************************************/
+/*                       pj_stats_grid_counter()                        */
+/*                                                                      */
+/*      The counter of the named grid.  Only the first                  */
+/*      PJ_STATS_MAX_GRIDS grids seen are kept apart, NULL is returned  */
+/*      for the others.                                                 */
+/************************************************************************/
+
+static projStatsCounter *pj_stats_grid_counter( PJ_STATS *stats, 
+                                                const char *gridname )
+
+{
+    projStats *s = &(stats->stats);
+    int i;
+
+    for( i = 0; i < s->grid_count; i++ )
+    {
+        if( strncmp( s->grids[i].gridname, gridname,
+                     sizeof(s->grids[i].gridname) - 1 ) == 0 )
+            break;
+    }
+
+    if( i == s->grid_count )
+    {
+        if( i == PJ_STATS_MAX_GRIDS )
+            return NULL;
+
+        strncpy( s->grids[i].gridname, gridname,
+                 sizeof(s->grids[i].gridname) - 1 );
+        s->grid_count++;
+    }
+
+    return &(s->grids[i].shift);
+}
+
+/************************************************************************/
+/*                         pj_stats_add_grid()                          */
+/*                                                                      */
+/*      Account a run of points shifted by the named grid.  Those past  */
+/*      the first PJ_STATS_MAX_GRIDS grids are still in the gridshift   */
+/*      total.                                                          */
+/************************************************************************/
+
+void pj_stats_add_grid( PJ_STATS *stats, const char *gridname,
+                        double points, double ns )
+
+{
+    projStatsCounter *shift = pj_stats_grid_counter( stats, gridname );
+
+    if( shift != NULL )
+        pj_stats_add( shift, points, ns );
+}
+
+/************************************************************************/
+/*                           pj_stats_merge()                           */
+/*                                                                      */
+/*      Add the counters of other, kept by a scratch context working    */
+/*      for the one of stats, into stats.  lock_wait is process wide    */
+/*      and left alone.                                                 */
+/************************************************************************/
+
+static void pj_stats_merge_counter( projStatsCounter *counter, 
+                                    const projStatsCounter *other )
+
+{
+    counter->calls += other->calls;
+    counter->points += other->points;
+    counter->nanoseconds += other->nanoseconds;
+}
+
+static void pj_stats_merge_latency( projStatsLatency *latency, 
+                                    const projStatsLatency *other )
+
+{
+    int i;
+
+    for( i = 0; i < PJ_STATS_LATENCY_BUCKETS; i++ )
+        latency->counts[i] += other->counts[i];
+}
+
+void pj_stats_merge( PJ_STATS *stats, const PJ_STATS *other )
+
+{
+    projStats *s = &(stats->stats);
+    const projStats *o = &(other->stats);
+    int i;
+
+    pj_stats_merge_counter( &(s->inv), &(o->inv) );
+    pj_stats_merge_counter( &(s->datum), &(o->datum) );
+    pj_stats_merge_counter( &(s->gridshift), &(o->gridshift) );
+    pj_stats_merge_counter( &(s->vgridshift), &(o->vgridshift) );
+    pj_stats_merge_counter( &(s->fwd), &(o->fwd) );
+    pj_stats_merge_counter( &(s->grid_load), &(o->grid_load) );
+    s->initcache_hits += o->initcache_hits;
+    s->initcache_misses += o->initcache_misses;
+    s->memo_hits += o->memo_hits;
+    s->memo_misses += o->memo_misses;
+    s->memo_bypassed += o->memo_bypassed;
+    pj_stats_merge_counter( &(s->parallel), &(o->parallel) );
+    pj_stats_merge_counter( &(s->backend), &(o->backend) );
+    pj_stats_merge_latency( &(s->transform_latency), &(o->transform_latency) );
+    pj_stats_merge_latency( &(s->grid_load_latency), &(o->grid_load_latency) );
+    pj_stats_merge_latency( &(s->init_latency), &(o->init_latency) );
+
+    for( i = 0; i < o->worker_count; i++ )
+        pj_stats_merge_counter( &(s->workers[i]), &(o->workers[i]) );
+    if( s->worker_count < o->worker_count )
+        s->worker_count = o->worker_count;
+
+    for( i = 0; i < o->grid_count; i++ )
+    {
+        projStatsCounter *shift = 
+            pj_stats_grid_counter( stats, o->grids[i].gridname );
+
+        if( shift != NULL )
+            pj_stats_merge_counter( shift, &(o->grids[i].shift) );
+    }
+}
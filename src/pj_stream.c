@@ -0,0 +1,279 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Streams of points pushed in and pulled out transformed, in
+ *           chunks transformed on another thread while the next fills.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <string.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** A stream has two chunks of chunk_size points.  Points pushed go into
+** the chunk filling; once full it is started with
+** pj_transform_plan_execute_async() and the other one fills, so that the
+** caller reads the next points while the last ones are transformed.
+** Pulls take the points of the oldest chunk, in the order they were
+** pushed, waiting for it if it is still running.  A chunk is filled
+** again only once all its points have been pulled.
+*/
+
+#define PJ_STREAM_CHUNKS 2
+
+#define PJ_STREAM_EMPTY   0     /* filling, or not used yet */
+#define PJ_STREAM_RUNNING 1
+#define PJ_STREAM_READY   2     /* transformed, being pulled */
+
+typedef struct {
+    double     *x, *y, *z;
+    int        *status;
+    long       count;           /* points in it */
+    long       pulled;          /* those pulled already */
+    int        state;
+    projTransformAsync async;
+} PJ_STREAM_CHUNK;
+
+typedef struct {
+    PJ_TRANSFORM_PLAN *plan;
+    long       chunk_size;
+    int        fill, read;      /* chunks filling and pulled from */
+    PJ_STREAM_CHUNK chunks[PJ_STREAM_CHUNKS];
+} PJ_STREAM;
+
+/************************************************************************/
+/*                          pj_stream_start()                           */
+/************************************************************************/
+
+static void pj_stream_start( PJ_STREAM *stream, PJ_STREAM_CHUNK *chunk )
+
+{
+    chunk->state = PJ_STREAM_RUNNING;
+    chunk->async = pj_transform_plan_execute_async(
+        stream->plan, chunk->count, 1, chunk->x, chunk->y, chunk->z,
+        chunk->status, NULL, NULL );
+
+    /* out of memory for a thread: transform it here */
+    if( chunk->async == NULL )
+    {
+        pj_transform_plan_execute_status( stream->plan, chunk->count, 1,
+                                          chunk->x, chunk->y, chunk->z,
+                                          chunk->status );
+        chunk->state = PJ_STREAM_READY;
+    }
+
+    stream->fill = (stream->fill + 1) % PJ_STREAM_CHUNKS;
+}
+
+/************************************************************************/
+/*                           pj_stream_open()                           */
+/*                                                                      */
+/*      Open a stream of points through the plan, transformed in        */
+/*      chunks of chunk_size points.  Returns NULL if out of memory.    */
+/************************************************************************/
+
+projStream pj_stream_open( PJ_TRANSFORM_PLAN *plan, long chunk_size )
+
+{
+    PJ_STREAM *stream;
+    int       i;
+
+    if( chunk_size <= 0 )
+        chunk_size = 4096;
+
+    stream = (PJ_STREAM *) pj_malloc( sizeof(PJ_STREAM) );
+    if( stream == NULL )
+    {
+        pj_ctx_set_errno( plan->srcdefn->ctx, -38 );
+        return NULL;
+    }
+    memset( stream, 0, sizeof(PJ_STREAM) );
+    stream->plan = plan;
+    stream->chunk_size = chunk_size;
+
+    for( i = 0; i < PJ_STREAM_CHUNKS; i++ )
+    {
+        PJ_STREAM_CHUNK *chunk = stream->chunks + i;
+
+        chunk->x = (double *) pj_malloc( sizeof(double) * 3 * chunk_size );
+        chunk->status = (int *) pj_malloc( sizeof(int) * chunk_size );
+        if( chunk->x == NULL || chunk->status == NULL )
+        {
+            pj_stream_close( stream );
+            pj_ctx_set_errno( plan->srcdefn->ctx, -38 );
+            return NULL;
+        }
+        chunk->y = chunk->x + chunk_size;
+        chunk->z = chunk->y + chunk_size;
+    }
+
+    return stream;
+}
+
+/************************************************************************/
+/*                           pj_stream_push()                           */
+/*                                                                      */
+/*      Add count points to the stream, z being 0 for each if z is      */
+/*      NULL.  Returns the number of points taken, less than count      */
+/*      when the points of both chunks are waiting to be pulled.        */
+/************************************************************************/
+
+long pj_stream_push( projStream handle, long count,
+                     const double *x, const double *y, const double *z )
+
+{
+    PJ_STREAM *stream = (PJ_STREAM *) handle;
+    long      taken = 0;
+
+    while( taken < count )
+    {
+        PJ_STREAM_CHUNK *chunk = stream->chunks + stream->fill;
+        long      n = stream->chunk_size - chunk->count;
+
+        if( chunk->state != PJ_STREAM_EMPTY )
+            break;
+
+        if( n > count - taken )
+            n = count - taken;
+        memcpy( chunk->x + chunk->count, x + taken, sizeof(double) * n );
+        memcpy( chunk->y + chunk->count, y + taken, sizeof(double) * n );
+        if( z != NULL )
+            memcpy( chunk->z + chunk->count, z + taken, sizeof(double) * n );
+        else
+            memset( chunk->z + chunk->count, 0, sizeof(double) * n );
+        chunk->count += n;
+        taken += n;
+
+        if( chunk->count == stream->chunk_size )
+            pj_stream_start( stream, chunk );
+    }
+
+    return taken;
+}
+
+/************************************************************************/
+/*                          pj_stream_flush()                           */
+/*                                                                      */
+/*      Start the chunk filling, so that all the points pushed can be   */
+/*      pulled, as at the end of the input.                             */
+/************************************************************************/
+
+void pj_stream_flush( projStream handle )
+
+{
+    PJ_STREAM *stream = (PJ_STREAM *) handle;
+    PJ_STREAM_CHUNK *chunk = stream->chunks + stream->fill;
+
+    if( chunk->state == PJ_STREAM_EMPTY && chunk->count > 0 )
+        pj_stream_start( stream, chunk );
+}
+
+/************************************************************************/
+/*                           pj_stream_pull()                           */
+/*                                                                      */
+/*      Take up to max of the points transformed, in the order they     */
+/*      were pushed, waiting for those being transformed.  z and        */
+/*      status may be NULL.  A point that failed is HUGE_VAL, with      */
+/*      its error in status as for pj_transform_plan_execute_status().  */
+/*      Returns the number of points taken, less than max once the      */
+/*      points left have not been started, by a full chunk or by        */
+/*      pj_stream_flush().                                              */
+/************************************************************************/
+
+long pj_stream_pull( projStream handle, long max,
+                     double *x, double *y, double *z, int *status )
+
+{
+    PJ_STREAM *stream = (PJ_STREAM *) handle;
+    long      taken = 0;
+
+    while( taken < max )
+    {
+        PJ_STREAM_CHUNK *chunk = stream->chunks + stream->read;
+        long      n;
+
+        if( chunk->state == PJ_STREAM_EMPTY )
+            break;
+
+        if( chunk->state == PJ_STREAM_RUNNING )
+        {
+            pj_transform_async_wait( chunk->async );
+            chunk->async = NULL;
+            chunk->state = PJ_STREAM_READY;
+        }
+
+        n = chunk->count - chunk->pulled;
+        if( n > max - taken )
+            n = max - taken;
+        memcpy( x + taken, chunk->x + chunk->pulled, sizeof(double) * n );
+        memcpy( y + taken, chunk->y + chunk->pulled, sizeof(double) * n );
+        if( z != NULL )
+            memcpy( z + taken, chunk->z + chunk->pulled, sizeof(double) * n );
+        if( status != NULL )
+            memcpy( status + taken, chunk->status + chunk->pulled,
+                    sizeof(int) * n );
+        chunk->pulled += n;
+        taken += n;
+
+        if( chunk->pulled == chunk->count )
+        {
+            chunk->count = chunk->pulled = 0;
+            chunk->state = PJ_STREAM_EMPTY;
+            stream->read = (stream->read + 1) % PJ_STREAM_CHUNKS;
+        }
+    }
+
+    return taken;
+}
+
+/************************************************************************/
+/*                          pj_stream_close()                           */
+/*                                                                      */
+/*      Free the stream, dropping the points not pulled.                */
+/************************************************************************/
+
+void pj_stream_close( projStream handle )
+
+{
+    PJ_STREAM *stream = (PJ_STREAM *) handle;
+    int       i;
+
+    if( stream == NULL )
+        return;
+
+    for( i = 0; i < PJ_STREAM_CHUNKS; i++ )
+    {
+        PJ_STREAM_CHUNK *chunk = stream->chunks + i;
+
+        if( chunk->state == PJ_STREAM_RUNNING )
+            pj_transform_async_wait( chunk->async );
+        pj_dalloc( chunk->x );
+        pj_dalloc( chunk->status );
+    }
+    pj_dalloc( stream );
+}
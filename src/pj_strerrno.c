@@ -55,6 +55,12 @@ pj_err_list[] = {
 	"illegal axis orientation combination",		/* -47 */
 	"point not within available datum shift grids", /* -48 */
 	"invalid sweep axis, choose x or y",            /* -49 */
+	"invalid approx, approx_tol or approx_region",  /* -50 */
+	"invalid or incompatible init cache snapshot",  /* -51 */
+	"accuracy < 0",                                 /* -52 */
+	"unsupported Arrow coordinate array",           /* -53 */
+	"grid not ready, loading in the background",    /* -54 */
+	"definition not frozen for sharing",            /* -55 */
 };
 	char *
 pj_strerrno(int err) 
@@ -0,0 +1,220 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Locale independent conversion of numbers in definitions, so that
+ *           parameters can be parsed without switching LC_NUMERIC.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <locale.h>
+
+PJ_CVSID("$Id$");
+
+/* 10^15 < 2^53, so up to 15 digits are held exactly in a double */
+#define FAST_DIGITS_MAX 15
+#define FAST_POWER_MAX  22
+
+static const double powers_of_ten[FAST_POWER_MAX+1] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/************************************************************************/
+/*                          pj_strtod_slow()                            */
+/*                                                                      */
+/*      Convert the number in [start,end) with the C library, which     */
+/*      expects the decimal point of the current locale.  Reading the   */
+/*      locale is safe in threads, unlike changing it.                  */
+/************************************************************************/
+
+static double pj_strtod_slow( const char *start, const char *end )
+
+{
+    const char *point = localeconv()->decimal_point;
+    size_t point_len, len = end - start, i, j;
+    char local_buf[128], *buf = local_buf;
+    double result;
+
+    if( point == NULL || *point == '\0' )
+        point = ".";
+    point_len = strlen(point);
+
+    if( len * point_len + 1 > sizeof(local_buf) )
+    {
+        buf = (char *) pj_malloc(len * point_len + 1);
+        if( buf == NULL )
+            return 0.0;
+    }
+
+    for( i = 0, j = 0; i < len; i++ )
+    {
+        if( start[i] == '.' )
+        {
+            memcpy( buf + j, point, point_len );
+            j += point_len;
+        }
+        else
+            buf[j++] = start[i];
+    }
+    buf[j] = '\0';
+
+    result = strtod( buf, NULL );
+
+    if( buf != local_buf )
+        pj_dalloc( buf );
+
+    return result;
+}
+
+/************************************************************************/
+/*                             pj_strtod()                              */
+/*                                                                      */
+/*      strtod() as it behaves in the "C" locale, whatever the locale   */
+/*      of the process.  Numbers of up to 15 significant digits with    */
+/*      small exponents, which covers nearly all definitions, are       */
+/*      converted directly with a single exactly rounded operation.     */
+/*      Others are handed to strtod() once rewritten for the locale.    */
+/************************************************************************/
+
+double pj_strtod( const char *nptr, char **endptr )
+
+{
+    const char *s = nptr, *start;
+    double mantissa = 0.0, result;
+    int negative = 0, digits = 0, sig_digits = 0, zero_run = 0;
+    int exponent = 0, seen_point = 0, fast = 1;
+
+    while( isspace((unsigned char) *s) )
+        s++;
+    start = s;
+
+    if( *s == '+' || *s == '-' )
+        negative = (*s++ == '-');
+
+/* -------------------------------------------------------------------- */
+/*      Hexadecimal, infinity and nan do not depend on the locale.      */
+/* -------------------------------------------------------------------- */
+    if( (s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+        || (!isdigit((unsigned char) *s) && *s != '.') )
+        return strtod( nptr, endptr );
+
+/* -------------------------------------------------------------------- */
+/*      Mantissa.  Trailing zeros are kept out of the digits as a       */
+/*      pending power of ten, so that "45.500000000" stays exact.       */
+/* -------------------------------------------------------------------- */
+    for( ; ; s++ )
+    {
+        int d;
+
+        if( *s == '.' && !seen_point )
+        {
+            seen_point = 1;
+            continue;
+        }
+        if( !isdigit((unsigned char) *s) )
+            break;
+
+        digits++;
+        if( seen_point )
+            exponent--;
+
+        d = *s - '0';
+        if( d == 0 )
+        {
+            if( sig_digits > 0 )
+                zero_run++;
+            continue;
+        }
+
+        sig_digits += zero_run + 1;
+        if( sig_digits > FAST_DIGITS_MAX )
+            fast = 0;
+        else
+            mantissa = mantissa * powers_of_ten[zero_run] * 10.0 + d;
+        zero_run = 0;
+    }
+
+    /* no digits at all, "." or "-." alone are not numbers */
+    if( digits == 0 )
+    {
+        if( endptr )
+            *endptr = (char *) nptr;
+        return 0.0;
+    }
+    exponent += zero_run;
+
+/* -------------------------------------------------------------------- */
+/*      Optional exponent, only taken if it has digits.                 */
+/* -------------------------------------------------------------------- */
+    if( *s == 'e' || *s == 'E' )
+    {
+        const char *e = s + 1;
+        int exp_negative = 0, exp_value = 0;
+
+        if( *e == '+' || *e == '-' )
+            exp_negative = (*e++ == '-');
+        if( isdigit((unsigned char) *e) )
+        {
+            for( ; isdigit((unsigned char) *e); e++ )
+            {
+                if( exp_value < 10000 )
+                    exp_value = exp_value * 10 + (*e - '0');
+            }
+            exponent += exp_negative ? -exp_value : exp_value;
+            s = e;
+        }
+    }
+
+    if( endptr )
+        *endptr = (char *) s;
+
+    if( mantissa == 0.0 && fast )
+        return negative ? -0.0 : 0.0;
+
+    if( !fast || exponent > FAST_POWER_MAX || exponent < -FAST_POWER_MAX )
+        return pj_strtod_slow( start, s );
+
+    if( exponent >= 0 )
+        result = mantissa * powers_of_ten[exponent];
+    else
+        result = mantissa / powers_of_ten[-exponent];
+
+    return negative ? -result : result;
+}
+
+/************************************************************************/
+/*                              pj_atof()                               */
+/************************************************************************/
+
+double pj_atof( const char *nptr )
+
+{
+    return pj_strtod( nptr, NULL );
+}
@@ -0,0 +1,222 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Keyword lookup in the projection, ellipsoid, units, datum and
+ *           prime meridian tables through sorted indexes.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <string.h>
+#include <stdlib.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** The tables are terminated by a NULL id, and start with the id.  The
+** indexes are sorted on first use rather than at build time, as an
+** application may link its own pj_list[] with a subset of projections.
+*/
+typedef struct {
+    const char *id;
+    int        position;
+} table_key;
+
+typedef struct {
+    int        count;
+    table_key  *keys;      /* sorted by id, then table position */
+} table_index;
+
+static table_index list_index = { 0, NULL };
+static table_index ellps_index = { 0, NULL };
+static table_index units_index = { 0, NULL };
+static table_index datums_index = { 0, NULL };
+static table_index pm_index = { 0, NULL };
+
+/************************************************************************/
+/*                         table_key_compare()                          */
+/************************************************************************/
+
+static int table_key_compare( const void *a, const void *b )
+
+{
+    const table_key *ka = (const table_key *) a;
+    const table_key *kb = (const table_key *) b;
+    int result = strcmp( ka->id, kb->id );
+
+    if( result == 0 )
+        result = ka->position - kb->position;
+    return result;
+}
+
+static int table_key_compare_id( const void *a, const void *b )
+
+{
+    return strcmp( ((const table_key *) a)->id, ((const table_key *) b)->id );
+}
+
+/************************************************************************/
+/*                             table_id()                               */
+/************************************************************************/
+
+static const char *table_id( const void *table, size_t entry_size, int i )
+
+{
+    return *(const char * const *) ((const char *) table + entry_size * i);
+}
+
+/************************************************************************/
+/*                            table_find()                              */
+/*                                                                      */
+/*      Return the position of the first entry with the given id, or    */
+/*      -1.  If the index cannot be allocated the table is scanned.     */
+/************************************************************************/
+
+static int table_find( table_index *index, const void *table,
+                       size_t entry_size, const char *id )
+
+{
+    table_key key, *found;
+    int i;
+
+    if( id == NULL )
+        return -1;
+
+    if( index->keys == NULL )
+    {
+        pj_acquire_lock();
+        if( index->keys == NULL )
+        {
+            table_key *keys;
+            int count;
+
+            for( count = 0; table_id( table, entry_size, count ) != NULL;
+                 count++ ) {}
+
+            keys = (table_key *) pj_malloc(sizeof(table_key) * (count + 1));
+            if( keys != NULL )
+            {
+                for( i = 0; i < count; i++ )
+                {
+                    keys[i].id = table_id( table, entry_size, i );
+                    keys[i].position = i;
+                }
+                qsort( keys, count, sizeof(table_key), table_key_compare );
+                index->count = count;
+                index->keys = keys;
+            }
+        }
+        pj_release_lock();
+
+        if( index->keys == NULL )
+        {
+            for( i = 0; table_id( table, entry_size, i ) != NULL; i++ )
+            {
+                if( strcmp( id, table_id( table, entry_size, i ) ) == 0 )
+                    return i;
+            }
+            return -1;
+        }
+    }
+
+    key.id = id;
+    key.position = 0;
+    found = (table_key *) bsearch( &key, index->keys, index->count,
+                                   sizeof(table_key), table_key_compare_id );
+    if( found == NULL )
+        return -1;
+
+    /* the first of duplicate ids is the one a linear scan finds */
+    while( found > index->keys && strcmp( found[-1].id, id ) == 0 )
+        found--;
+
+    return found->position;
+}
+
+/************************************************************************/
+/*                            pj_find_proj()                            */
+/*                                                                      */
+/*      Look up a keyword in one of the tables, returning NULL if it    */
+/*      is not found.                                                   */
+/************************************************************************/
+
+struct PJ_LIST *pj_find_proj( const char *id )
+
+{
+    int i = table_find( &list_index, pj_list, sizeof(struct PJ_LIST), id );
+
+    return i < 0 ? NULL : pj_list + i;
+}
+
+/************************************************************************/
+/*                           pj_find_ellps()                            */
+/************************************************************************/
+
+struct PJ_ELLPS *pj_find_ellps( const char *id )
+
+{
+    int i = table_find( &ellps_index, pj_ellps, sizeof(struct PJ_ELLPS), id );
+
+    return i < 0 ? NULL : pj_ellps + i;
+}
+
+/************************************************************************/
+/*                           pj_find_units()                            */
+/************************************************************************/
+
+struct PJ_UNITS *pj_find_units( const char *id )
+
+{
+    int i = table_find( &units_index, pj_units, sizeof(struct PJ_UNITS), id );
+
+    return i < 0 ? NULL : pj_units + i;
+}
+
+/************************************************************************/
+/*                           pj_find_datum()                            */
+/************************************************************************/
+
+struct PJ_DATUMS *pj_find_datum( const char *id )
+
+{
+    int i = table_find( &datums_index, pj_datums, sizeof(struct PJ_DATUMS),
+                        id );
+
+    return i < 0 ? NULL : pj_datums + i;
+}
+
+/************************************************************************/
+/*                       pj_find_prime_meridian()                       */
+/************************************************************************/
+
+struct PJ_PRIME_MERIDIANS *pj_find_prime_meridian( const char *id )
+
+{
+    int i = table_find( &pm_index, pj_prime_meridians,
+                        sizeof(struct PJ_PRIME_MERIDIANS), id );
+
+    return i < 0 ? NULL : pj_prime_meridians + i;
+}
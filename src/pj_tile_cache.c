@@ -0,0 +1,626 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Cache of the lattices transformed for the tiles of a map,
+ *           which repeated renders of a tile interpolate without any
+ *           transformation.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** A tile of nx by ny points is rendered from a lattice of lattice by
+** lattice cells over its bounds, whose corners are transformed exactly
+** with pj_transform_grid().  Each point is the bilinear interpolation of
+** the corners of its cell, the points of cells with a failed corner, at
+** the edge of what can be transformed, being transformed exactly.
+**
+** The lattices are kept by the cache under the definitions of the plan,
+** as pj_get_def() gives them, the bounds of the tile and the lattice
+** resolution, so that the layers of a tile server sharing a plan share
+** them, whatever the size of their renders.  The least recently used
+** are dropped beyond the size of the cache.  With a directory, lattices
+** are also saved there, one file per key, and loaded by later caches of
+** this or other processes, as the tiles of pj_set_approx_cache().  The
+** files are not invalidated when the grids of a definition change.
+*/
+#define TILE_BUCKETS       256
+#define TILE_DEFAULT_BYTES (32 * 1024 * 1024)
+#define TILE_MAX_LATTICE   1024
+#define TILE_MAGIC         "PJTILE01"
+
+typedef struct PJ_TILE_ENTRY_s {
+    char          *key;
+    unsigned long hash;
+    long          lattice;
+    double        *x, *y;           /* (lattice+1)^2 corners, by rows */
+    size_t        bytes;
+    struct PJ_TILE_ENTRY_s *next;           /* in its bucket */
+    struct PJ_TILE_ENTRY_s *older, *newer;  /* by last use */
+} PJ_TILE_ENTRY;
+
+typedef struct {
+    PJ_TILE_ENTRY *buckets[TILE_BUCKETS];
+    PJ_TILE_ENTRY *newest, *oldest;
+    size_t        bytes, max_bytes;
+    char          *directory;
+} PJ_TILE_CACHE;
+
+/************************************************************************/
+/*                              tile_def()                              */
+/*                                                                      */
+/*      The canonical definition of P, so that plans of equivalent      */
+/*      definitions share their lattices.                               */
+/************************************************************************/
+
+static char *tile_def( PJ *P )
+
+{
+    char *def = pj_get_def( P, 0 ), *canonical;
+
+    if( def == NULL )
+        return NULL;
+    canonical = pj_canonical_def( P->ctx, def );
+    pj_dalloc( def );
+
+    return canonical;
+}
+
+/************************************************************************/
+/*                              tile_key()                              */
+/*                                                                      */
+/*      The key of the lattice of a tile, in memory from pj_malloc().   */
+/************************************************************************/
+
+static char *tile_key( PJ_TRANSFORM_PLAN *plan, double x0, double y0,
+                       double x1, double y1, long lattice )
+
+{
+    char *src_def = tile_def( plan->srcdefn );
+    char *dst_def = tile_def( plan->dstdefn );
+    char *key = NULL;
+
+    if( src_def != NULL && dst_def != NULL )
+        key = (char *) pj_malloc( strlen(src_def) + strlen(dst_def) + 128 );
+    if( key != NULL )
+        sprintf( key, "%s\n%s\n%.17g %.17g %.17g %.17g %ld",
+                 src_def, dst_def, x0, y0, x1, y1, lattice );
+    pj_dalloc( src_def );
+    pj_dalloc( dst_def );
+
+    return key;
+}
+
+/************************************************************************/
+/*                           tile_unlink()                              */
+/*                                                                      */
+/*      Take an entry out of the list by use.  Under the lock.          */
+/************************************************************************/
+
+static void tile_unlink( PJ_TILE_CACHE *cache, PJ_TILE_ENTRY *entry )
+
+{
+    if( entry->older != NULL )
+        entry->older->newer = entry->newer;
+    else
+        cache->oldest = entry->newer;
+    if( entry->newer != NULL )
+        entry->newer->older = entry->older;
+    else
+        cache->newest = entry->older;
+    entry->older = entry->newer = NULL;
+}
+
+/************************************************************************/
+/*                           tile_use()                                 */
+/*                                                                      */
+/*      Make an entry the most recently used.  Under the lock.          */
+/************************************************************************/
+
+static void tile_use( PJ_TILE_CACHE *cache, PJ_TILE_ENTRY *entry )
+
+{
+    if( cache->newest == entry )
+        return;
+    if( entry->older != NULL || entry->newer != NULL
+        || cache->oldest == entry )
+        tile_unlink( cache, entry );
+    entry->older = cache->newest;
+    if( cache->newest != NULL )
+        cache->newest->newer = entry;
+    else
+        cache->oldest = entry;
+    cache->newest = entry;
+}
+
+/************************************************************************/
+/*                          tile_entry_free()                           */
+/************************************************************************/
+
+static void tile_entry_free( PJ_TILE_ENTRY *entry )
+
+{
+    pj_dalloc( entry->key );
+    pj_dalloc( entry->x );
+    pj_dalloc( entry );
+}
+
+/************************************************************************/
+/*                            tile_drop()                               */
+/*                                                                      */
+/*      Drop the least recently used entries until the cache fits in    */
+/*      its size, keeping the newest one.  Under the lock.              */
+/************************************************************************/
+
+static void tile_drop( PJ_TILE_CACHE *cache )
+
+{
+    while( cache->bytes > cache->max_bytes
+           && cache->oldest != NULL && cache->oldest != cache->newest )
+    {
+        PJ_TILE_ENTRY *entry = cache->oldest, **link;
+
+        link = cache->buckets + entry->hash % TILE_BUCKETS;
+        while( *link != entry )
+            link = &((*link)->next);
+        *link = entry->next;
+
+        tile_unlink( cache, entry );
+        cache->bytes -= entry->bytes;
+        tile_entry_free( entry );
+    }
+}
+
+/************************************************************************/
+/*                           tile_lookup()                              */
+/*                                                                      */
+/*      Copy the corners of the lattice of key into x and y.  Returns   */
+/*      FALSE if it is not in memory.                                   */
+/************************************************************************/
+
+static int tile_lookup( PJ_TILE_CACHE *cache, const char *key,
+                        unsigned long hash, long count,
+                        double *x, double *y )
+
+{
+    PJ_TILE_ENTRY *entry;
+    int found = 0;
+
+    pj_acquire_lock();
+    for( entry = cache->buckets[hash % TILE_BUCKETS]; entry != NULL;
+         entry = entry->next )
+    {
+        if( entry->hash == hash && strcmp( entry->key, key ) == 0 )
+        {
+            memcpy( x, entry->x, sizeof(double) * count );
+            memcpy( y, entry->y, sizeof(double) * count );
+            tile_use( cache, entry );
+            found = 1;
+            break;
+        }
+    }
+    pj_release_lock();
+
+    return found;
+}
+
+/************************************************************************/
+/*                            tile_insert()                             */
+/*                                                                      */
+/*      Keep a copy of the corners of the lattice of key, unless        */
+/*      another thread put it there first or out of memory.             */
+/************************************************************************/
+
+static void tile_insert( PJ_TILE_CACHE *cache, const char *key,
+                         unsigned long hash, long lattice,
+                         const double *x, const double *y )
+
+{
+    long count = (lattice + 1) * (lattice + 1);
+    PJ_TILE_ENTRY *entry, *other;
+
+    entry = (PJ_TILE_ENTRY *) pj_malloc( sizeof(PJ_TILE_ENTRY) );
+    if( entry == NULL )
+        return;
+    memset( entry, 0, sizeof(PJ_TILE_ENTRY) );
+    entry->key = (char *) pj_malloc( strlen(key) + 1 );
+    entry->x = (double *) pj_malloc( sizeof(double) * 2 * count );
+    if( entry->key == NULL || entry->x == NULL )
+    {
+        tile_entry_free( entry );
+        return;
+    }
+    strcpy( entry->key, key );
+    entry->hash = hash;
+    entry->lattice = lattice;
+    entry->y = entry->x + count;
+    memcpy( entry->x, x, sizeof(double) * count );
+    memcpy( entry->y, y, sizeof(double) * count );
+    entry->bytes = sizeof(PJ_TILE_ENTRY) + strlen(key) + 1
+        + sizeof(double) * 2 * count;
+
+    pj_acquire_lock();
+    for( other = cache->buckets[hash % TILE_BUCKETS]; other != NULL;
+         other = other->next )
+        if( other->hash == hash && strcmp( other->key, key ) == 0 )
+            break;
+    if( other == NULL )
+    {
+        entry->next = cache->buckets[hash % TILE_BUCKETS];
+        cache->buckets[hash % TILE_BUCKETS] = entry;
+        cache->bytes += entry->bytes;
+        tile_use( cache, entry );
+        tile_drop( cache );
+        entry = NULL;
+    }
+    pj_release_lock();
+
+    if( entry != NULL )
+        tile_entry_free( entry );
+}
+
+/************************************************************************/
+/*                            tile_path()                               */
+/*                                                                      */
+/*      The file of the directory of the cache for a key, named by      */
+/*      pj_hash_name().  Returns FALSE without a directory.             */
+/************************************************************************/
+
+static int tile_path( PJ_TILE_CACHE *cache, const char *key, char *path )
+
+{
+    char name[17];
+
+    if( cache->directory == NULL
+        || strlen(cache->directory) + 24 > MAX_PATH_FILENAME )
+        return 0;
+    pj_hash_name( key, name );
+    sprintf( path, "%s%c%s.tll", cache->directory, DIR_CHAR, name );
+    return 1;
+}
+
+/************************************************************************/
+/*                           tile_load()                                */
+/*                                                                      */
+/*      Read the corners of the lattice of key from the directory of    */
+/*      the cache, if they are there, see pj_cache_file_open().         */
+/************************************************************************/
+
+static int tile_load( PJ_TILE_CACHE *cache, const char *key, long lattice,
+                      double *x, double *y )
+
+{
+    char path[MAX_PATH_FILENAME+1];
+    long count = (lattice + 1) * (lattice + 1), stored_lattice;
+    PJ_CACHE_FILE f;
+    int ok;
+
+    if( !tile_path( cache, key, path )
+        || !pj_cache_file_open( &f, path, TILE_MAGIC, key ) )
+        return 0;
+
+    ok = pj_cache_file_get( &f, &stored_lattice, sizeof(long), 1 )
+        && stored_lattice == lattice
+        && pj_cache_file_get( &f, x, sizeof(double), count )
+        && pj_cache_file_get( &f, y, sizeof(double), count );
+
+    return pj_cache_file_close( &f, ok );
+}
+
+/************************************************************************/
+/*                           tile_save()                                */
+/*                                                                      */
+/*      Save the corners of a lattice in the directory of the cache,    */
+/*      see pj_cache_file_create().  Failures only cost transforming    */
+/*      the lattice again next time.                                    */
+/************************************************************************/
+
+static void tile_save( PJ_TILE_CACHE *cache, const char *key, long lattice,
+                       const double *x, const double *y )
+
+{
+    char path[MAX_PATH_FILENAME+1];
+    long count = (lattice + 1) * (lattice + 1);
+    PJ_CACHE_FILE f;
+    int ok;
+
+    if( !tile_path( cache, key, path ) )
+        return;
+
+    ok = pj_cache_file_create( &f, path, x, TILE_MAGIC, key )
+        && pj_cache_file_put( &f, &lattice, sizeof(long), 1 )
+        && pj_cache_file_put( &f, x, sizeof(double), count )
+        && pj_cache_file_put( &f, y, sizeof(double), count );
+    if( f.fp != NULL )
+        pj_cache_file_commit( &f, path, ok );
+}
+
+/************************************************************************/
+/*                         tile_interpolate()                           */
+/*                                                                      */
+/*      Fill the points of a tile from the corners of its lattice.      */
+/*      Points of cells with a failed corner are left at HUGE_VAL in    */
+/*      out_x and flagged in exact.  Returns the number flagged.        */
+/************************************************************************/
+
+static long tile_interpolate( const double *lx, const double *ly,
+                              long lattice, long nx, long ny,
+                              double *out_x, double *out_y,
+                              long *cell, double *frac,
+                              unsigned char *exact )
+
+{
+    long i, j, stride = lattice + 1, flagged = 0;
+
+    /* the cell and position in it of each column */
+    for( i = 0; i < nx; i++ )
+    {
+        double u = nx > 1 ? (double) i * lattice / (nx - 1) : 0.0;
+        long c = (long) u;
+
+        if( c > lattice - 1 )
+            c = lattice - 1;
+        cell[i] = c;
+        frac[i] = u - c;
+    }
+
+    for( j = 0; j < ny; j++ )
+    {
+        double v = ny > 1 ? (double) j * lattice / (ny - 1) : 0.0;
+        long r = (long) v, row = j * nx;
+        const double *x0, *y0, *x1, *y1;
+
+        if( r > lattice - 1 )
+            r = lattice - 1;
+        v -= r;
+        x0 = lx + r * stride;
+        y0 = ly + r * stride;
+        x1 = x0 + stride;
+        y1 = y0 + stride;
+
+        for( i = 0; i < nx; i++ )
+        {
+            long c = cell[i];
+            double u = frac[i];
+
+            if( x0[c] == HUGE_VAL || x0[c+1] == HUGE_VAL
+                || x1[c] == HUGE_VAL || x1[c+1] == HUGE_VAL )
+            {
+                out_x[row+i] = out_y[row+i] = HUGE_VAL;
+                exact[row+i] = 1;
+                flagged++;
+                continue;
+            }
+            out_x[row+i] = (1-v) * ((1-u) * x0[c] + u * x0[c+1])
+                + v * ((1-u) * x1[c] + u * x1[c+1]);
+            out_y[row+i] = (1-v) * ((1-u) * y0[c] + u * y0[c+1])
+                + v * ((1-u) * y1[c] + u * y1[c+1]);
+            exact[row+i] = 0;
+        }
+    }
+
+    return flagged;
+}
+
+/************************************************************************/
+/*                           tile_exact()                               */
+/*                                                                      */
+/*      Transform the flagged points of a tile exactly, those that      */
+/*      fail being left at HUGE_VAL.                                    */
+/************************************************************************/
+
+static int tile_exact( PJ_TRANSFORM_PLAN *plan, long flagged,
+                       double x0, double dx, long nx, double y0, double dy,
+                       long ny, double *out_x, double *out_y,
+                       const unsigned char *exact )
+
+{
+    double *px = (double *) pj_malloc( sizeof(double) * 2 * flagged );
+    int *status = (int *) pj_malloc( sizeof(int) * flagged );
+    double *py;
+    long i, n = 0, total = nx * ny;
+
+    if( px == NULL || status == NULL )
+    {
+        pj_dalloc( px );
+        pj_dalloc( status );
+        pj_ctx_set_errno( plan->srcdefn->ctx, -38 );
+        return -38;
+    }
+    py = px + flagged;
+
+    for( i = 0; i < total; i++ )
+        if( exact[i] )
+        {
+            px[n] = x0 + (i % nx) * dx;
+            py[n] = y0 + (i / nx) * dy;
+            n++;
+        }
+
+    pj_transform_plan_execute_status( plan, n, 1, px, py, NULL, status );
+
+    for( i = 0, n = 0; i < total; i++ )
+        if( exact[i] )
+        {
+            out_x[i] = px[n];
+            out_y[i] = py[n];
+            n++;
+        }
+
+    pj_dalloc( px );
+    pj_dalloc( status );
+    return 0;
+}
+
+/************************************************************************/
+/*                        pj_tile_cache_alloc()                         */
+/*                                                                      */
+/*      A cache of tile lattices of up to max_bytes, 32 MB if 0,        */
+/*      also kept in directory, which must exist, unless it is NULL.    */
+/*      Returns NULL if out of memory.                                  */
+/************************************************************************/
+
+projTileCache pj_tile_cache_alloc( size_t max_bytes, const char *directory )
+
+{
+    PJ_TILE_CACHE *cache;
+
+    cache = (PJ_TILE_CACHE *) pj_malloc( sizeof(PJ_TILE_CACHE) );
+    if( cache == NULL )
+        return NULL;
+    memset( cache, 0, sizeof(PJ_TILE_CACHE) );
+    cache->max_bytes = max_bytes > 0 ? max_bytes : TILE_DEFAULT_BYTES;
+
+    if( directory != NULL )
+    {
+        cache->directory = (char *) pj_malloc( strlen(directory) + 1 );
+        if( cache->directory == NULL )
+        {
+            pj_dalloc( cache );
+            return NULL;
+        }
+        strcpy( cache->directory, directory );
+    }
+
+    return (projTileCache) cache;
+}
+
+/************************************************************************/
+/*                         pj_tile_cache_free()                         */
+/************************************************************************/
+
+void pj_tile_cache_free( projTileCache handle )
+
+{
+    PJ_TILE_CACHE *cache = (PJ_TILE_CACHE *) handle;
+    PJ_TILE_ENTRY *entry, *older;
+
+    if( cache == NULL )
+        return;
+
+    for( entry = cache->newest; entry != NULL; entry = older )
+    {
+        older = entry->older;
+        tile_entry_free( entry );
+    }
+    pj_dalloc( cache->directory );
+    pj_dalloc( cache );
+}
+
+/************************************************************************/
+/*                         pj_transform_tile()                          */
+/*                                                                      */
+/*      Transform the nx by ny points x0 + i * dx, y0 + j * dy of a     */
+/*      tile into out_x[j * nx + i] and out_y[j * nx + i], as           */
+/*      pj_transform_grid(), interpolating them in a lattice of         */
+/*      lattice by lattice cells over the tile, taken from the cache    */
+/*      when it has it.  The error is that of bilinear interpolation    */
+/*      over a cell, which lattice must keep small enough.  cache may   */
+/*      be NULL, and may be shared by threads.                          */
+/************************************************************************/
+
+int pj_transform_tile( projTileCache handle, PJ_TRANSFORM_PLAN *plan,
+                       double x0, double dx, long nx,
+                       double y0, double dy, long ny,
+                       long lattice, double *out_x, double *out_y )
+
+{
+    PJ_TILE_CACHE *cache = (PJ_TILE_CACHE *) handle;
+    double x1 = x0 + (nx - 1) * dx, y1 = y0 + (ny - 1) * dy;
+    double *lx = NULL, *ly, *frac = NULL;
+    long count, *cell = NULL, flagged;
+    unsigned char *exact = NULL;
+    unsigned long hash = 0;
+    char *key = NULL;
+    int err = 0;
+
+    if( nx <= 0 || ny <= 0 )
+        return 0;
+    if( lattice < 1 )
+        lattice = 1;
+    if( lattice > TILE_MAX_LATTICE )
+        lattice = TILE_MAX_LATTICE;
+    count = (lattice + 1) * (lattice + 1);
+
+    lx = (double *) pj_malloc( sizeof(double) * 2 * count );
+    frac = (double *) pj_malloc( sizeof(double) * nx );
+    cell = (long *) pj_malloc( sizeof(long) * nx );
+    exact = (unsigned char *) pj_malloc( (size_t) nx * ny );
+    if( cache != NULL )
+        key = tile_key( plan, x0, y0, x1, y1, lattice );
+    if( lx == NULL || frac == NULL || cell == NULL || exact == NULL
+        || (cache != NULL && key == NULL) )
+    {
+        err = -38;
+        pj_ctx_set_errno( plan->srcdefn->ctx, err );
+        goto done;
+    }
+    ly = lx + count;
+
+/* -------------------------------------------------------------------- */
+/*      The lattice, from memory, from the directory, or transformed.   */
+/* -------------------------------------------------------------------- */
+    if( key != NULL )
+        hash = pj_fnv1a( PJ_FNV1A_BASIS, key, strlen(key) );
+    if( key == NULL || !tile_lookup( cache, key, hash, count, lx, ly ) )
+    {
+        if( key != NULL && tile_load( cache, key, lattice, lx, ly ) )
+            tile_insert( cache, key, hash, lattice, lx, ly );
+        else
+        {
+            err = pj_transform_grid( plan, x0, (x1 - x0) / lattice,
+                                     lattice + 1, y0, (y1 - y0) / lattice,
+                                     lattice + 1, lx, ly, 0.0 );
+            if( err != 0 )
+                goto done;
+            if( key != NULL )
+            {
+                tile_insert( cache, key, hash, lattice, lx, ly );
+                tile_save( cache, key, lattice, lx, ly );
+            }
+        }
+    }
+
+    flagged = tile_interpolate( lx, ly, lattice, nx, ny, out_x, out_y,
+                                cell, frac, exact );
+    if( flagged > 0 )
+        err = tile_exact( plan, flagged, x0, dx, nx, y0, dy, ny,
+                          out_x, out_y, exact );
+
+  done:
+    pj_dalloc( key );
+    pj_dalloc( lx );
+    pj_dalloc( frac );
+    pj_dalloc( cell );
+    pj_dalloc( exact );
+    return err;
+}
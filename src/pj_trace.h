@@ -0,0 +1,80 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Static trace points, always compiled in, for tracing tools to
+ *           attach to in a running process.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+/*
+** With <sys/sdt.h> (HAVE_SYS_SDT_H, found by configure and CMake) each
+** PJ_TRACEn() is a USDT probe of the "proj" provider: a nop in the code
+** until a tool such as bpftrace, perf or SystemTap attaches to it, with
+** its arguments where the tool can read them.  Elsewhere a platform may
+** map the probes onto its own tracing, such as ETW TraceLogging, by
+** naming in PJ_TRACE_HEADER a header defining PJ_TRACE0() to
+** PJ_TRACE4(); otherwise they compile to nothing.
+**
+** The probes, with their arguments, are:
+**
+**   transform__start    plan, point_count
+**   transform__done     plan, error
+**   stage__start        stage (PJ_TP_* of pj_transform.c), point_count
+**   stage__done         stage, error
+**   grid__load__start   grid name
+**   grid__load__done    grid name, bytes, nanoseconds, 1 if loaded
+**   open__lib           name, path, 1 if opened, -1 if searched or else
+**                       whether the path was known (1) or missing (0)
+**   initcache__lookup   "file:tag" key, 1 if found
+**   defncache__lookup   definition, 1 if found
+**   lock__wait          lock class (PJ_LOCK_*), when held by another thread
+**   lock__acquire       lock class, nanoseconds waited
+**
+** Durations not passed are those between the start and done probes.
+** Only internal code of the library includes this file.
+*/
+
+#ifndef PJ_TRACE_H
+#define PJ_TRACE_H
+
+#if defined(PJ_TRACE_HEADER)
+#  include PJ_TRACE_HEADER
+#elif defined(HAVE_SYS_SDT_H)
+#  include <sys/sdt.h>
+#  define PJ_TRACE0(name)              DTRACE_PROBE(proj, name)
+#  define PJ_TRACE1(name, a)           DTRACE_PROBE1(proj, name, a)
+#  define PJ_TRACE2(name, a, b)        DTRACE_PROBE2(proj, name, a, b)
+#  define PJ_TRACE3(name, a, b, c)     DTRACE_PROBE3(proj, name, a, b, c)
+#  define PJ_TRACE4(name, a, b, c, d)  DTRACE_PROBE4(proj, name, a, b, c, d)
+#endif
+
+#ifndef PJ_TRACE0
+#  define PJ_TRACE0(name)              ((void) 0)
+#  define PJ_TRACE1(name, a)           ((void) 0)
+#  define PJ_TRACE2(name, a, b)        ((void) 0)
+#  define PJ_TRACE3(name, a, b, c)     ((void) 0)
+#  define PJ_TRACE4(name, a, b, c, d)  ((void) 0)
+#endif
+
+#endif /* PJ_TRACE_H */
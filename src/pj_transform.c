@@ -30,13 +30,17 @@
  *****************************************************************************/
 
 #include <projects.h>
+#include <pj_trace.h>
 #include <string.h>
 #include <math.h>
+#include <errno.h>
 #include "geocent.h"
 
 PJ_CVSID("$Id$");
 
-static int pj_adjust_axis( projCtx ctx, const char *axis, int denormalize_flag,
+static void pj_axis_map_init( const char *axis, int denormalize_flag,
+                              PJ_AXIS_MAP *map );
+static int pj_adjust_axis( projCtx ctx, const PJ_AXIS_MAP *map,
                            long point_count, int point_offset, 
                            double *x, double *y, double *z );
 
@@ -48,17 +52,17 @@ static int pj_adjust_axis( projCtx ctx, const char *axis, int denormalize_flag,
 #define SRS_WGS84_ESQUARED 0.0066943799901413165
 #endif
 
-#define Dx_BF (defn->datum_params[0])
-#define Dy_BF (defn->datum_params[1])
-#define Dz_BF (defn->datum_params[2])
-#define Rx_BF (defn->datum_params[3])
-#define Ry_BF (defn->datum_params[4])
-#define Rz_BF (defn->datum_params[5])
-#define M_BF  (defn->datum_params[6])
+#define Dx_BF (defn->cold->datum_params[0])
+#define Dy_BF (defn->cold->datum_params[1])
+#define Dz_BF (defn->cold->datum_params[2])
+#define Rx_BF (defn->cold->datum_params[3])
+#define Ry_BF (defn->cold->datum_params[4])
+#define Rz_BF (defn->cold->datum_params[5])
+#define M_BF  (defn->cold->datum_params[6])
 
 /* 
 ** This table is intended to indicate for any given error code in 
-** the range 0 to -44, whether that error will occur for all locations (ie.
+** the range 0 to -55, whether that error will occur for all locations (ie.
 ** it is a problem with the coordinate system as a whole) in which case the
 ** value would be 0, or if the problem is with the point being transformed
 ** in which case the value is 1. 
@@ -67,306 +71,3397 @@ static int pj_adjust_axis( projCtx ctx, const char *axis, int denormalize_flag,
 ** list or something, but while experimenting with it this should be fine. 
 */
 
-static const int transient_error[50] = {
+static const int transient_error[56] = {
     /*             0  1  2  3  4  5  6  7  8  9   */
     /* 0 to 9 */   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
     /* 10 to 19 */ 0, 0, 0, 0, 1, 1, 0, 1, 1, 1,  
     /* 20 to 29 */ 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 
     /* 30 to 39 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 
-    /* 40 to 49 */ 0, 0, 0, 0, 0, 0, 0, 0, 1, 0 };
+    /* 40 to 49 */ 0, 0, 0, 0, 0, 0, 0, 0, 1, 0,
+    /* 50 to 55 */ 0, 0, 0, 0, 1, 0 };
+
+/* -------------------------------------------------------------------- */
+/*      Stages of the pj_transform() pipeline.  A transform plan is     */
+/*      the ordered list of the stages actually required for a given   */
+/*      source and destination definition.                              */
+/* -------------------------------------------------------------------- */
+#define PJ_TP_SRC_AXIS          1
+#define PJ_TP_SRC_VTO_METER     2
+#define PJ_TP_SRC_GEOCENT       3
+#define PJ_TP_SRC_INV           4
+#define PJ_TP_SRC_PM            5
+#define PJ_TP_SRC_VGRIDS        6
+#define PJ_TP_DATUM             7
+#define PJ_TP_DST_VGRIDS        8
+#define PJ_TP_DST_PM            9
+#define PJ_TP_DST_GEOCENT       10
+#define PJ_TP_DST_FWD           11
+#define PJ_TP_DST_LONG_WRAP     12
+#define PJ_TP_DST_VFR_METER     13
+#define PJ_TP_DST_AXIS          14
+#define PJ_TP_XY_SCALE          15
+#define PJ_TP_Z_SCALE           16
+#define PJ_TP_HELMERT           17
+#define PJ_TP_SRC_SPHMERC_INV   18
+#define PJ_TP_DST_SPHMERC_FWD   19
+#define PJ_TP_ETMERC            20
+#define PJ_TP_GEOCENT_HELMERT   21
+#define PJ_TP_GEOID_DIFF        22
+#define PJ_TP_GRID_PAIR         23
+
+static int pj_datum_transform_core( PJ *srcdefn, PJ *dstdefn, 
+                                    long point_count, int point_offset,
+                                    double *x, double *y, double *z,
+                                    const double *t );
+static int pj_helmert_compose( PJ *srcdefn, PJ *dstdefn, double *m );
+static int pj_helmert_transform( PJ *srcdefn, PJ *dstdefn, const double *m,
+                                 long point_count, int point_offset,
+                                 double *x, double *y, double *z );
+
+/************************************************************************/
+/*                         pj_param_is_generic()                        */
+/*                                                                      */
+/*      Is this parameter one whose effect is fully captured by the     */
+/*      generic members of the PJ structure (ellipsoid, datum, units,   */
+/*      axis, etc), rather than by projection specific members?        */
+/************************************************************************/
+
+static int pj_param_is_generic( const char *param )
+
+{
+    static const char *generic_keys[] = {
+        "proj", "init", "no_defs", "ellps", "datum", "a", "b", "rf", "f",
+        "es", "e", "R", "R_A", "R_V", "R_a", "R_g", "R_h", "R_lat_a",
+        "R_lat_g", "towgs84", "nadgrids", "catalog", "date", "geoidgrids",
+        "units", "to_meter", "vunits", "vto_meter", "axis", "pm",
+        "lon_wrap", "over", "geoc", "lon_0", "lat_0", "x_0", "y_0",
+        "k_0", "k", NULL };
+    int  i, key_len;
+
+    for( key_len = 0; 
+         param[key_len] != '\0' && param[key_len] != '='; 
+         key_len++ ) {}
+
+    for( i = 0; generic_keys[i] != NULL; i++ )
+    {
+        if( strncmp(param, generic_keys[i], key_len) == 0 
+            && generic_keys[i][key_len] == '\0' )
+            return 1;
+    }
+
+    return 0;
+}
+
+/************************************************************************/
+/*                       pj_compare_param_ptrs()                        */
+/************************************************************************/
+
+static int pj_compare_param_ptrs( const void *a, const void *b )
+
+{
+    return strcmp( *((const char **) a), *((const char **) b) );
+}
+
+/************************************************************************/
+/*                      pj_specific_params_match()                      */
+/*                                                                      */
+/*      Compare the projection specific parameters of two              */
+/*      definitions, ignoring their order.  Values are compared as     */
+/*      text so "lat_1=30" and "lat_1=30.0" are taken as different,    */
+/*      which is harmless since we only use this to skip work.         */
+/************************************************************************/
+
+#define PJ_PARAMS_ON_STACK 64
+
+static int pj_specific_params_match( PJ *srcdefn, PJ *dstdefn )
+
+{
+    const char *src_stack[PJ_PARAMS_ON_STACK], *dst_stack[PJ_PARAMS_ON_STACK];
+    const char **src_list, **dst_list;
+    paralist *pl;
+    int src_count = 0, dst_count = 0, i, match;
+
+    for( pl = srcdefn->params; pl != NULL; pl = pl->next )
+        src_count++;
+    for( pl = dstdefn->params; pl != NULL; pl = pl->next )
+        dst_count++;
+
+    if( src_count <= PJ_PARAMS_ON_STACK && dst_count <= PJ_PARAMS_ON_STACK )
+    {
+        src_list = src_stack;
+        dst_list = dst_stack;
+    }
+    else
+    {
+        src_list = (const char **) pj_malloc(sizeof(char*) * (src_count+1));
+        dst_list = (const char **) pj_malloc(sizeof(char*) * (dst_count+1));
+        if( src_list == NULL || dst_list == NULL )
+        {
+            pj_dalloc( src_list );
+            pj_dalloc( dst_list );
+            return 0;
+        }
+    }
+
+    src_count = dst_count = 0;
+    for( pl = srcdefn->params; pl != NULL; pl = pl->next )
+    {
+        if( !pj_param_is_generic( pl->param ) )
+            src_list[src_count++] = pj_param_text( pl );
+    }
+    for( pl = dstdefn->params; pl != NULL; pl = pl->next )
+    {
+        if( !pj_param_is_generic( pl->param ) )
+            dst_list[dst_count++] = pj_param_text( pl );
+    }
+
+    match = (src_count == dst_count);
+    if( match )
+    {
+        qsort( src_list, src_count, sizeof(char*), pj_compare_param_ptrs );
+        qsort( dst_list, dst_count, sizeof(char*), pj_compare_param_ptrs );
+
+        for( i = 0; match && i < src_count; i++ )
+            match = (strcmp(src_list[i], dst_list[i]) == 0);
+    }
+
+    if( src_list != src_stack )
+    {
+        pj_dalloc( src_list );
+        pj_dalloc( dst_list );
+    }
+
+    return match;
+}
+
+/************************************************************************/
+/*                       pj_projections_equal()                         */
+/*                                                                      */
+/*      Do the two projected definitions have the same projection,      */
+/*      on the same ellipsoid and with the same parameters, so that     */
+/*      the forward projection of one inverts that of the other?  The   */
+/*      units are not compared.                                         */
+/************************************************************************/
+
+static int pj_projections_equal( PJ *srcdefn, PJ *dstdefn )
+
+{
+    if( srcdefn->descr != dstdefn->descr
+        || srcdefn->a != dstdefn->a || srcdefn->es != dstdefn->es
+        || srcdefn->lam0 != dstdefn->lam0 
+        || srcdefn->phi0 != dstdefn->phi0
+        || srcdefn->x0 != dstdefn->x0 || srcdefn->y0 != dstdefn->y0
+        || srcdefn->k0 != dstdefn->k0
+        || srcdefn->geoc != dstdefn->geoc 
+        || srcdefn->over != dstdefn->over )
+        return 0;
+
+    return pj_specific_params_match( srcdefn, dstdefn );
+}
+
+/************************************************************************/
+/*                        pj_defns_equivalent()                         */
+/*                                                                      */
+/*      Returns TRUE if the two coordinate systems only differ (if at   */
+/*      all) in their horizontal or vertical units and axis order,      */
+/*      so that transforming between them is at most a scaling and     */
+/*      an axis swap.  This is deliberately conservative: returning     */
+/*      FALSE just means the full pipeline will be run.                 */
+/************************************************************************/
+
+static int pj_defns_equivalent( PJ *srcdefn, PJ *dstdefn )
+
+{
+    if( srcdefn->is_latlong != dstdefn->is_latlong
+        || srcdefn->is_geocent != dstdefn->is_geocent )
+        return 0;
+
+    /* lat/long and geocentric systems only depend on the earth model. */
+    if( !srcdefn->is_latlong && !srcdefn->is_geocent
+        && !pj_projections_equal( srcdefn, dstdefn ) )
+        return 0;
+
+    if( srcdefn->cold->a_orig != dstdefn->cold->a_orig 
+        || srcdefn->cold->es_orig != dstdefn->cold->es_orig
+        || srcdefn->cold->datum_type != dstdefn->cold->datum_type
+        || !pj_compare_datums( srcdefn, dstdefn ) )
+        return 0;
+
+    if( (srcdefn->cold->catalog_name == NULL)
+            != (dstdefn->cold->catalog_name == NULL)
+        || (srcdefn->cold->catalog_name != NULL 
+            && strcmp(srcdefn->cold->catalog_name,
+                      dstdefn->cold->catalog_name) != 0) )
+        return 0;
+
+    if( srcdefn->cold->from_greenwich != dstdefn->cold->from_greenwich )
+        return 0;
+
+    if( srcdefn->cold->has_geoid_vgrids != dstdefn->cold->has_geoid_vgrids )
+        return 0;
+
+    if( srcdefn->cold->has_geoid_vgrids
+        && strcmp(pj_param(srcdefn->ctx, srcdefn->params,"sgeoidgrids").s,
+                  pj_param(dstdefn->ctx, dstdefn->params,"sgeoidgrids").s) != 0 )
+        return 0;
+
+    return 1;
+}
+
+/************************************************************************/
+/*                        pj_nadgrids_are_null()                        */
+/*                                                                      */
+/*      Is the grid shift of this definition only the optional          */
+/*      "@null" grid?  It has zero shifts everywhere and leaves the     */
+/*      points it does not cover unshifted, so it changes nothing.      */
+/************************************************************************/
+
+static int pj_nadgrids_are_null( PJ *defn )
+
+{
+    const char *nadgrids;
+
+    if( defn->cold->datum_type != PJD_GRIDSHIFT
+        || defn->cold->catalog_name != NULL )
+        return 0;
+
+    nadgrids = pj_param(defn->ctx, defn->params, "snadgrids").s;
+    return nadgrids != NULL && strcmp( nadgrids, "@null" ) == 0;
+}
+
+/************************************************************************/
+/*                        pj_datum_is_wgs84()                           */
+/*                                                                      */
+/*      Does the datum shift of this definition leave WGS84 lat/long    */
+/*      unchanged?  This is the case of the WGS84 datum itself, and     */
+/*      of the "@null" grid shift.                                      */
+/************************************************************************/
+
+static int pj_datum_is_wgs84( PJ *defn )
+
+{
+    if( defn->cold->datum_type == PJD_WGS84 )
+        return defn->cold->a_orig == SRS_WGS84_SEMIMAJOR 
+            && defn->cold->es_orig == SRS_WGS84_ESQUARED;
+
+    return pj_nadgrids_are_null( defn );
+}
+
+/************************************************************************/
+/*                          pj_is_sphmerc()                             */
+/*                                                                      */
+/*      Is this the spherical Mercator, as used by web maps?  Its       */
+/*      plan stages are done in closed form rather than through         */
+/*      pj_fwd() and pj_inv().                                          */
+/************************************************************************/
+
+static int pj_is_sphmerc( PJ *defn )
+
+{
+    return !defn->is_latlong && !defn->is_geocent 
+        && defn->es == 0.0 && !defn->geoc
+        && strcmp( pj_param(defn->ctx, defn->params, "sproj").s, 
+                   "merc" ) == 0;
+}
+
+/************************************************************************/
+/*                        pj_grid_shifts_cancel()                       */
+/*                                                                      */
+/*      Two grid shift datums with the same grids both go through       */
+/*      WGS84 on the grid, whatever their ellipsoids, so that the       */
+/*      shift of one to WGS84 is followed by its exact inverse.         */
+/************************************************************************/
+
+static int pj_grid_shifts_cancel( PJ *srcdefn, PJ *dstdefn )
+
+{
+    return srcdefn->cold->datum_type == PJD_GRIDSHIFT
+        && dstdefn->cold->datum_type == PJD_GRIDSHIFT
+        && srcdefn->cold->catalog_name == NULL
+        && dstdefn->cold->catalog_name == NULL
+        && strcmp( pj_param(srcdefn->ctx, srcdefn->params, "snadgrids").s,
+                   pj_param(dstdefn->ctx, dstdefn->params, "snadgrids").s )
+           == 0;
+}
+
+/************************************************************************/
+/*                        pj_helmert_is_identity()                      */
+/*                                                                      */
+/*      Is the composed Helmert m, between equal ellipsoids, just a     */
+/*      trip to geocentric coordinates and back?                        */
+/************************************************************************/
+
+static int pj_helmert_is_identity( PJ *srcdefn, PJ *dstdefn, const double *m )
+
+{
+    int       i;
+
+    if( srcdefn->cold->a_orig != dstdefn->cold->a_orig
+        || srcdefn->cold->es_orig != dstdefn->cold->es_orig )
+        return 0;
+
+    for( i = 0; i < 12; i++ )
+    {
+        if( m[i] != ((i % 5 == 0) ? 1.0 : 0.0) )
+            return 0;
+    }
+
+    return 1;
+}
+
+/************************************************************************/
+/*                        pj_tp_stages_cancel()                         */
+/*                                                                      */
+/*      Is the destination stage after the source stage its inverse?    */
+/************************************************************************/
+
+static int pj_tp_stages_cancel( PJ_TRANSFORM_PLAN *plan, 
+                                int src_stage, int dst_stage )
+
+{
+    PJ        *srcdefn = plan->srcdefn, *dstdefn = plan->dstdefn;
+
+    switch( src_stage )
+    {
+      case PJ_TP_SRC_AXIS:
+        return dst_stage == PJ_TP_DST_AXIS
+            && strcmp( srcdefn->cold->axis, dstdefn->cold->axis ) == 0;
+
+      case PJ_TP_SRC_VTO_METER:
+        return dst_stage == PJ_TP_DST_VFR_METER
+            && srcdefn->cold->vto_meter == dstdefn->cold->vto_meter;
+
+      case PJ_TP_SRC_GEOCENT:
+        return dst_stage == PJ_TP_DST_GEOCENT
+            && srcdefn->cold->a_orig == dstdefn->cold->a_orig
+            && srcdefn->cold->es_orig == dstdefn->cold->es_orig
+            && srcdefn->to_meter == dstdefn->to_meter;
+
+      case PJ_TP_SRC_INV:
+        return dst_stage == PJ_TP_DST_FWD
+            && srcdefn->to_meter == dstdefn->to_meter
+            && pj_projections_equal( srcdefn, dstdefn );
+
+      case PJ_TP_SRC_SPHMERC_INV:
+        return dst_stage == PJ_TP_DST_SPHMERC_FWD
+            && srcdefn->to_meter == dstdefn->to_meter
+            && pj_projections_equal( srcdefn, dstdefn );
+
+      case PJ_TP_SRC_PM:
+        return dst_stage == PJ_TP_DST_PM
+            && srcdefn->cold->from_greenwich == dstdefn->cold->from_greenwich;
+
+      case PJ_TP_SRC_VGRIDS:
+        return dst_stage == PJ_TP_DST_VGRIDS
+            && strcmp( pj_param(srcdefn->ctx, srcdefn->params,
+                                "sgeoidgrids").s,
+                       pj_param(dstdefn->ctx, dstdefn->params,
+                                "sgeoidgrids").s ) == 0;
+    }
+
+    return 0;
+}
+
+/************************************************************************/
+/*                        pj_tp_cancel_stages()                         */
+/*                                                                      */
+/*      Drop the datum stage if it undoes itself, and each              */
+/*      destination stage that inverts the source stage right before    */
+/*      it, together with that one.  The source and destination        */
+/*      stages are recorded in mirrored order, so that pairs nest and   */
+/*      dropping one pair can bring the next outer one together, as    */
+/*      the inverse and forward projection around a datum shift that    */
+/*      has gone.  The points a dropped stage would have failed, such   */
+/*      as those outside a geoid grid, are then passed unchanged, as    */
+/*      they are between equivalent definitions.                        */
+/************************************************************************/
+
+static void pj_tp_cancel_stages( PJ_TRANSFORM_PLAN *plan )
+
+{
+    int       i, n = 0;
+
+    for( i = 0; i < plan->stage_count; i++ )
+    {
+        int       stage = plan->stages[i];
+
+        if( (stage == PJ_TP_DATUM 
+             && pj_grid_shifts_cancel( plan->srcdefn, plan->dstdefn ))
+            || (stage == PJ_TP_HELMERT
+                && pj_helmert_is_identity( plan->srcdefn, plan->dstdefn,
+                                           plan->helmert )) )
+            continue;
+
+        if( n > 0 && pj_tp_stages_cancel( plan, plan->stages[n-1], stage ) )
+            n--;
+        else
+            plan->stages[n++] = stage;
+    }
+
+    plan->stage_count = n;
+}
+
+/************************************************************************/
+/*                         pj_tp_join_etmerc()                          */
+/*                                                                      */
+/*      Replace the inverse projection right followed by the forward    */
+/*      one, between two extended transverse Mercators on the same      */
+/*      ellipsoid, by their direct conversion, see proj_etmerc.c.      */
+/************************************************************************/
+
+static void pj_tp_join_etmerc( PJ_TRANSFORM_PLAN *plan )
+
+{
+    int       i;
+
+    if( !pj_etmerc_compatible( plan->srcdefn, plan->dstdefn ) )
+        return;
+
+    for( i = 0; i + 1 < plan->stage_count; i++ )
+    {
+        if( plan->stages[i] == PJ_TP_SRC_INV 
+            && plan->stages[i+1] == PJ_TP_DST_FWD )
+        {
+            plan->stages[i] = PJ_TP_ETMERC;
+            memmove( plan->stages + i + 1, plan->stages + i + 2, 
+                     (plan->stage_count - i - 2) * sizeof(int) );
+            plan->stage_count--;
+            return;
+        }
+    }
+}
+
+/************************************************************************/
+/*                       pj_tp_grid_pair_allowed()                      */
+/*                                                                      */
+/*      May the shift between two grid based datums go through their    */
+/*      composed shifts, see pj_grid_pair_get()?  Both definitions      */
+/*      must allow an error with +accuracy=, the smaller being the      */
+/*      one kept to, and shift with plain grid lists.                   */
+/************************************************************************/
+
+static int pj_tp_grid_pair_allowed( PJ *srcdefn, PJ *dstdefn )
+
+{
+    return srcdefn->cold->datum_type == PJD_GRIDSHIFT 
+        && dstdefn->cold->datum_type == PJD_GRIDSHIFT
+        && srcdefn->cold->catalog_name == NULL
+        && dstdefn->cold->catalog_name == NULL
+        && srcdefn->cold->accuracy > 0.0 && dstdefn->cold->accuracy > 0.0
+        && !pj_nadgrids_are_null( srcdefn ) 
+        && !pj_nadgrids_are_null( dstdefn );
+}
+
+/************************************************************************/
+/*                         pj_tp_join_geoids()                          */
+/*                                                                      */
+/*      Replace the shift from the geoid of the source to ellipsoidal   */
+/*      heights, right before the one from them to the geoid of the     */
+/*      destination, as with no datum shift in between, by the shift    */
+/*      between the two geoids, see pj_apply_geoid_diff().              */
+/************************************************************************/
+
+static void pj_tp_join_geoids( PJ_TRANSFORM_PLAN *plan )
+
+{
+    int       i;
+
+    for( i = 0; i + 1 < plan->stage_count; i++ )
+    {
+        if( plan->stages[i] == PJ_TP_SRC_VGRIDS 
+            && plan->stages[i+1] == PJ_TP_DST_VGRIDS )
+        {
+            plan->stages[i] = PJ_TP_GEOID_DIFF;
+            memmove( plan->stages + i + 1, plan->stages + i + 2, 
+                     (plan->stage_count - i - 2) * sizeof(int) );
+            plan->stage_count--;
+            return;
+        }
+    }
+}
+
+/************************************************************************/
+/*                         pj_tp_join_geocent()                         */
+/*                                                                      */
+/*      Replace going from geocentric source coordinates to geodetic    */
+/*      ones, through a Helmert shift or none, and back to geocentric   */
+/*      ones, by the single affine transform it amounts to, with the    */
+/*      horizontal unit changes folded into plan->helmert.  Without a   */
+/*      shift, this needs the same ellipsoid on both sides.             */
+/************************************************************************/
+
+static void pj_tp_join_geocent( PJ_TRANSFORM_PLAN *plan )
+
+{
+    PJ        *srcdefn = plan->srcdefn, *dstdefn = plan->dstdefn;
+    double    *m = plan->helmert;
+    int       i, r, len;
+
+    for( i = 0; i + 1 < plan->stage_count; i++ )
+    {
+        if( plan->stages[i] == PJ_TP_SRC_GEOCENT )
+            break;
+    }
+    if( i + 1 >= plan->stage_count )
+        return;
+
+    if( plan->stages[i+1] == PJ_TP_HELMERT 
+        && i + 2 < plan->stage_count
+        && plan->stages[i+2] == PJ_TP_DST_GEOCENT )
+        len = 3;
+    else if( plan->stages[i+1] == PJ_TP_DST_GEOCENT
+             && srcdefn->cold->a_orig == dstdefn->cold->a_orig
+             && srcdefn->cold->es_orig == dstdefn->cold->es_orig )
+    {
+        len = 2;
+        memset( m, 0, sizeof(plan->helmert) );
+        m[0] = m[5] = m[10] = 1.0;
+    }
+    else
+        return;
+
+    for( r = 0; r < 3; r++ )
+    {
+        m[r*4+0] *= srcdefn->to_meter;
+        m[r*4+1] *= srcdefn->to_meter;
+    }
+    for( r = 0; r < 8; r++ )
+        m[r] *= dstdefn->fr_meter;
+
+    plan->stages[i] = PJ_TP_GEOCENT_HELMERT;
+    memmove( plan->stages + i + 1, plan->stages + i + len, 
+             (plan->stage_count - i - len) * sizeof(int) );
+    plan->stage_count -= len - 1;
+}
+
+/************************************************************************/
+/*                          pj_tp_init_steps()                          */
+/*                                                                      */
+/*      Steps doing nothing.                                            */
+/************************************************************************/
+
+static void pj_tp_init_steps( PJ_ARRAY_STEPS *steps )
+
+{
+    steps->axis_swap = 0;
+    steps->x_sign = 1.0;
+    steps->y_sign = 1.0;
+    steps->z_scale = 1.0;
+    steps->pm = 0.0;
+    steps->long_wrap = 0;
+    steps->long_wrap_center = 0.0;
+}
+
+/************************************************************************/
+/*                          pj_tp_axis_steps()                          */
+/*                                                                      */
+/*      Add the axis map to steps if it only exchanges and turns x      */
+/*      and y, keeping z in place.  Returns FALSE for other axes.       */
+/************************************************************************/
+
+static int pj_tp_axis_steps( const PJ_AXIS_MAP *map, PJ_ARRAY_STEPS *steps )
+
+{
+    if( map->from[0] < 0 || map->from[0] > 1 || map->from[1] > 1
+        || map->from[0] == map->from[1] || map->from[2] != 2 )
+        return 0;
+
+    steps->axis_swap = map->from[0] == 1;
+    steps->x_sign = map->sign[0];
+    steps->y_sign = map->sign[1];
+    steps->z_scale *= map->sign[2];
+
+    return 1;
+}
+
+/************************************************************************/
+/*                          pj_tp_fold_steps()                          */
+/*                                                                      */
+/*      Fold the axis, vertical unit, prime meridian and longitude      */
+/*      wrapping stages right around a projection with an array        */
+/*      kernel into its stage, so that pj_inv_array_steps() and         */
+/*      pj_fwd_array_steps() do them in their loops over the points,    */
+/*      rather than each in a pass of its own.  The arithmetic, and     */
+/*      its order, are those of the stages.                             */
+/************************************************************************/
+
+static void pj_tp_fold_steps( PJ_TRANSFORM_PLAN *plan )
+
+{
+    PJ        *srcdefn = plan->srcdefn;
+    PJ        *dstdefn = plan->dstdefn;
+    int       *stages = plan->stages;
+    int        count = plan->stage_count, i, n = 0;
+
+    for( i = 0; i < count; i++ )
+    {
+        int    stage = stages[i];
+
+        if( stage == PJ_TP_SRC_INV && srcdefn->inv_n != NULL )
+        {
+            PJ_ARRAY_STEPS *steps = &(plan->inv_steps);
+
+            if( n > 0 && stages[n-1] == PJ_TP_SRC_VTO_METER )
+            {
+                steps->z_scale = srcdefn->cold->vto_meter;
+                n--;
+            }
+            if( n > 0 && stages[n-1] == PJ_TP_SRC_AXIS
+                && pj_tp_axis_steps( &(plan->src_axis), steps ) )
+                n--;
+            if( i + 1 < count && stages[i+1] == PJ_TP_SRC_PM )
+            {
+                steps->pm = srcdefn->cold->from_greenwich;
+                i++;
+            }
+            if( i + 1 < count && stages[i+1] == PJ_TP_DST_LONG_WRAP )
+            {
+                steps->long_wrap = 1;
+                steps->long_wrap_center = dstdefn->cold->long_wrap_center;
+                i++;
+            }
+        }
+        else if( stage == PJ_TP_DST_FWD && dstdefn->fwd_n != NULL )
+        {
+            PJ_ARRAY_STEPS *steps = &(plan->fwd_steps);
+
+            if( n > 0 && stages[n-1] == PJ_TP_DST_PM )
+            {
+                steps->pm = dstdefn->cold->from_greenwich;
+                n--;
+            }
+            if( i + 1 < count && stages[i+1] == PJ_TP_DST_VFR_METER )
+            {
+                steps->z_scale = dstdefn->cold->vfr_meter;
+                i++;
+            }
+            if( i + 1 < count && stages[i+1] == PJ_TP_DST_AXIS
+                && pj_tp_axis_steps( &(plan->dst_axis), steps ) )
+                i++;
+        }
+        stages[n++] = stage;
+    }
+    plan->stage_count = n;
+}
+
+/************************************************************************/
+/*                       pj_transform_plan_init()                       */
+/*                                                                      */
+/*      Work out which stages of the transformation pipeline are        */
+/*      needed to go from srcdefn to dstdefn, and record them in        */
+/*      the passed plan.                                                */
+/************************************************************************/
+
+int pj_transform_plan_init( PJ_TRANSFORM_PLAN *plan, 
+                            PJ *srcdefn, PJ *dstdefn )
+
+{
+    int n = 0;
+
+    plan->srcdefn = srcdefn;
+    plan->dstdefn = dstdefn;
+    plan->memo = NULL;
+    plan->backend = NULL;
+    plan->backend_handle = NULL;
+    plan->xy_scale = 1.0;
+    plan->z_scale = 1.0;
+    pj_tp_init_steps( &(plan->inv_steps) );
+    pj_tp_init_steps( &(plan->fwd_steps) );
+    pj_axis_map_init( srcdefn->cold->axis, 0, &(plan->src_axis) );
+    pj_axis_map_init( dstdefn->cold->axis, 1, &(plan->dst_axis) );
+
+/* -------------------------------------------------------------------- */
+/*      Short circuit equivalent coordinate systems to a scaling of     */
+/*      the units and axis swapping, if even that is needed.            */
+/* -------------------------------------------------------------------- */
+    if( pj_defns_equivalent( srcdefn, dstdefn ) )
+    {
+        int same_axis = strcmp(srcdefn->cold->axis, dstdefn->cold->axis) == 0;
+
+        if( !same_axis && strcmp(srcdefn->cold->axis,"enu") != 0 )
+            plan->stages[n++] = PJ_TP_SRC_AXIS;
+
+        if( !srcdefn->is_latlong && srcdefn->to_meter != dstdefn->to_meter )
+        {
+            plan->xy_scale = srcdefn->to_meter * dstdefn->fr_meter;
+            plan->stages[n++] = PJ_TP_XY_SCALE;
+        }
+
+        if( srcdefn->cold->vto_meter != dstdefn->cold->vto_meter )
+        {
+            plan->z_scale = srcdefn->cold->vto_meter
+                * dstdefn->cold->vfr_meter;
+            plan->stages[n++] = PJ_TP_Z_SCALE;
+        }
+
+        if( dstdefn->is_latlong && dstdefn->cold->is_long_wrap_set )
+            plan->stages[n++] = PJ_TP_DST_LONG_WRAP;
+
+        if( !same_axis && strcmp(dstdefn->cold->axis,"enu") != 0 )
+            plan->stages[n++] = PJ_TP_DST_AXIS;
+
+        plan->stage_count = n;
+
+        return 0;
+    }
+
+    if( strcmp(srcdefn->cold->axis,"enu") != 0 )
+        plan->stages[n++] = PJ_TP_SRC_AXIS;
+
+    if( srcdefn->cold->vto_meter != 1.0 )
+        plan->stages[n++] = PJ_TP_SRC_VTO_METER;
+
+    if( srcdefn->is_geocent )
+        plan->stages[n++] = PJ_TP_SRC_GEOCENT;
+    else if( pj_is_sphmerc( srcdefn ) )
+        plan->stages[n++] = PJ_TP_SRC_SPHMERC_INV;
+    else if( !srcdefn->is_latlong )
+        plan->stages[n++] = PJ_TP_SRC_INV;
+
+    if( srcdefn->cold->from_greenwich != 0.0 )
+        plan->stages[n++] = PJ_TP_SRC_PM;
+
+    if( srcdefn->cold->has_geoid_vgrids )
+        plan->stages[n++] = PJ_TP_SRC_VGRIDS;
+
+    /* The datum shift is not needed for unknown or identical datums, */
+    /* nor between WGS84 and a "@null" grid shift.                    */
+    if( srcdefn->cold->datum_type != PJD_UNKNOWN 
+        && dstdefn->cold->datum_type != PJD_UNKNOWN
+        && !pj_compare_datums( srcdefn, dstdefn )
+        && !(pj_datum_is_wgs84( srcdefn ) && pj_datum_is_wgs84( dstdefn )) )
+    {
+        if( pj_helmert_compose( srcdefn, dstdefn, plan->helmert ) )
+            plan->stages[n++] = PJ_TP_HELMERT;
+        else if( pj_tp_grid_pair_allowed( srcdefn, dstdefn ) )
+            plan->stages[n++] = PJ_TP_GRID_PAIR;
+        else
+            plan->stages[n++] = PJ_TP_DATUM;
+    }
+
+    if( dstdefn->cold->has_geoid_vgrids )
+        plan->stages[n++] = PJ_TP_DST_VGRIDS;
+
+    if( dstdefn->cold->from_greenwich != 0.0 )
+        plan->stages[n++] = PJ_TP_DST_PM;
+
+    if( dstdefn->is_geocent )
+        plan->stages[n++] = PJ_TP_DST_GEOCENT;
+    else if( pj_is_sphmerc( dstdefn ) )
+        plan->stages[n++] = PJ_TP_DST_SPHMERC_FWD;
+    else if( !dstdefn->is_latlong )
+        plan->stages[n++] = PJ_TP_DST_FWD;
+    else if( dstdefn->cold->is_long_wrap_set )
+        plan->stages[n++] = PJ_TP_DST_LONG_WRAP;
+
+    if( dstdefn->cold->vto_meter != 1.0 )
+        plan->stages[n++] = PJ_TP_DST_VFR_METER;
+
+    if( strcmp(dstdefn->cold->axis,"enu") != 0 )
+        plan->stages[n++] = PJ_TP_DST_AXIS;
+
+    plan->stage_count = n;
+    pj_tp_cancel_stages( plan );
+    pj_tp_join_etmerc( plan );
+    pj_tp_join_geocent( plan );
+    pj_tp_join_geoids( plan );
+    pj_tp_fold_steps( plan );
+
+    return 0;
+}
+
+/************************************************************************/
+/*                   pj_transform_plan_init_vertical()                  */
+/*                                                                      */
+/*      As pj_transform_plan_init(), for the heights alone of points    */
+/*      in geographic coordinates, with longitudes from Greenwich.      */
+/*      Only the geoid grids and vertical units of the two              */
+/*      definitions are applied: x and y are only read to look up       */
+/*      the grids, and any horizontal difference between the            */
+/*      definitions is ignored.                                         */
+/************************************************************************/
+
+int pj_transform_plan_init_vertical( PJ_TRANSFORM_PLAN *plan, 
+                                     PJ *srcdefn, PJ *dstdefn )
+
+{
+    int n = 0;
+
+    plan->srcdefn = srcdefn;
+    plan->dstdefn = dstdefn;
+    plan->memo = NULL;
+    plan->backend = NULL;
+    plan->backend_handle = NULL;
+    plan->xy_scale = 1.0;
+    plan->z_scale = 1.0;
+    pj_tp_init_steps( &(plan->inv_steps) );
+    pj_tp_init_steps( &(plan->fwd_steps) );
+    pj_axis_map_init( "enu", 0, &(plan->src_axis) );
+    pj_axis_map_init( "enu", 1, &(plan->dst_axis) );
+
+    if( !srcdefn->cold->has_geoid_vgrids && !dstdefn->cold->has_geoid_vgrids )
+    {
+        if( srcdefn->cold->vto_meter != dstdefn->cold->vto_meter )
+        {
+            plan->z_scale = srcdefn->cold->vto_meter
+                * dstdefn->cold->vfr_meter;
+            plan->stages[n++] = PJ_TP_Z_SCALE;
+        }
+        plan->stage_count = n;
+
+        return 0;
+    }
+
+    if( srcdefn->cold->vto_meter != 1.0 )
+        plan->stages[n++] = PJ_TP_SRC_VTO_METER;
+    if( srcdefn->cold->has_geoid_vgrids )
+        plan->stages[n++] = PJ_TP_SRC_VGRIDS;
+    if( dstdefn->cold->has_geoid_vgrids )
+        plan->stages[n++] = PJ_TP_DST_VGRIDS;
+    if( dstdefn->cold->vto_meter != 1.0 )
+        plan->stages[n++] = PJ_TP_DST_VFR_METER;
+
+    plan->stage_count = n;
+    pj_tp_cancel_stages( plan );
+    pj_tp_join_geoids( plan );
+
+    return 0;
+}
+
+/************************************************************************/
+/*                 pj_transform_plan_create_vertical()                  */
+/*                                                                      */
+/*      A plan of pj_transform_plan_init_vertical(), run with the       */
+/*      pj_transform_plan_execute() functions, for converting between   */
+/*      ellipsoidal and orthometric heights, or between two geoids,     */
+/*      without any horizontal work.                                    */
+/************************************************************************/
+
+PJ_TRANSFORM_PLAN *pj_transform_plan_create_vertical( PJ *srcdefn, 
+                                                      PJ *dstdefn )
+
+{
+    PJ_TRANSFORM_PLAN *plan;
+
+    plan = (PJ_TRANSFORM_PLAN *) pj_malloc(sizeof(PJ_TRANSFORM_PLAN));
+    if( plan == NULL )
+        return NULL;
+
+    if( pj_transform_plan_init_vertical( plan, srcdefn, dstdefn ) != 0 )
+    {
+        pj_dalloc( plan );
+        return NULL;
+    }
+
+    return plan;
+}
+
+/************************************************************************/
+/*                      pj_transform_plan_create()                      */
+/*                                                                      */
+/*      Allocate a plan for repeated transformations between the two    */
+/*      given coordinate systems.  The plan keeps references to         */
+/*      srcdefn and dstdefn, which must not be freed before the plan.   */
+/************************************************************************/
+
+PJ_TRANSFORM_PLAN *pj_transform_plan_create( PJ *srcdefn, PJ *dstdefn )
+
+{
+    PJ_TRANSFORM_PLAN *plan;
+
+    plan = (PJ_TRANSFORM_PLAN *) pj_malloc(sizeof(PJ_TRANSFORM_PLAN));
+    if( plan == NULL )
+        return NULL;
+
+    if( pj_transform_plan_init( plan, srcdefn, dstdefn ) != 0 )
+    {
+        pj_dalloc( plan );
+        return NULL;
+    }
+
+    return plan;
+}
+
+/************************************************************************/
+/*                       pj_transform_plan_free()                       */
+/************************************************************************/
+
+void pj_transform_plan_free( PJ_TRANSFORM_PLAN *plan )
+
+{
+    if( plan != NULL )
+    {
+        pj_transform_plan_set_memo( plan, 0 );
+        pj_transform_plan_set_backend( plan, NULL );
+        pj_dalloc( plan );
+    }
+}
+
+/************************************************************************/
+/*                      pj_tp_error_is_transient()                      */
+/*                                                                      */
+/*      Should a per-point projection error just mark the point as     */
+/*      failed rather than abort the whole transformation?             */
+/************************************************************************/
+
+static int pj_tp_error_is_transient( int err, long point_count )
+
+{
+    if( err == 33 /*EDOM*/ || err == 34 /*ERANGE*/ )
+        return 1;
+
+    /* the points of a grid being loaded are tried again by the caller */
+    if( err == PJD_ERR_GRID_NOT_READY )
+        return 1;
+
+    return err < 0 && err >= -44 && point_count != 1
+        && transient_error[-err] != 0;
+}
+
+/************************************************************************/
+/*                          pj_tp_inv_points()                          */
+/*                                                                      */
+/*      Inverse project source points to lat/long.  With a status,      */
+/*      the error of each point is recorded there.  The steps folded    */
+/*      into the stage come with the array kernel, the only one they    */
+/*      are folded for.                                                 */
+/************************************************************************/
+
+static int pj_tp_inv_points( PJ *srcdefn, long point_count, int point_offset,
+                             double *x, double *y, double *z, 
+                             const PJ_ARRAY_STEPS *steps, int *status )
+
+{
+    long      i;
+
+    if( srcdefn->inv == NULL )
+    {
+        pj_ctx_set_errno( pj_get_ctx(srcdefn), -17 );
+        pj_log( pj_get_ctx(srcdefn), PJ_LOG_ERROR, 
+                "pj_transform(): source projection not invertable" );
+        return -17;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Projections with an array kernel get the whole batch at once.   */
+/*      Their kernels only raise transient errors, so the per-point     */
+/*      policy below reduces to the point_count == 1 case.              */
+/* -------------------------------------------------------------------- */
+    if( srcdefn->inv_n != NULL )
+    {
+        int err = pj_inv_array_steps( srcdefn, point_count, point_offset,
+                                      x, y, z, steps );
+
+        if( err != 0 && !pj_tp_error_is_transient( err, point_count ) )
+            return err;
+        return 0;
+    }
+
+    for( i = 0; i < point_count; i++ )
+    {
+        XY         projected_loc;
+        LP	       geodetic_loc;
+
+        projected_loc.u = x[point_offset*i];
+        projected_loc.v = y[point_offset*i];
+
+        if( projected_loc.u == HUGE_VAL )
+            continue;
+
+        geodetic_loc = pj_inv( projected_loc, srcdefn );
+        if( srcdefn->ctx->last_errno != 0 )
+        {
+            if( status != NULL )
+            {
+                status[i] = srcdefn->ctx->last_errno;
+                geodetic_loc.u = HUGE_VAL;
+                geodetic_loc.v = HUGE_VAL;
+            }
+            else if( (srcdefn->ctx->last_errno != 33 /*EDOM*/ 
+                 && srcdefn->ctx->last_errno != 34 /*ERANGE*/ )
+                && (srcdefn->ctx->last_errno > 0 
+                    || srcdefn->ctx->last_errno < -44 || point_count == 1
+                    || transient_error[-srcdefn->ctx->last_errno] == 0 ) )
+                return srcdefn->ctx->last_errno;
+            else
+            {
+                geodetic_loc.u = HUGE_VAL;
+                geodetic_loc.v = HUGE_VAL;
+            }
+        }
+
+        x[point_offset*i] = geodetic_loc.u;
+        y[point_offset*i] = geodetic_loc.v;
+    }
+
+    return 0;
+}
+
+/************************************************************************/
+/*                          pj_tp_fwd_points()                          */
+/*                                                                      */
+/*      Forward project lat/long points to destination coordinates.     */
+/*      With a status, the error of each point is recorded there.       */
+/*      Steps as for pj_tp_inv_points().                                */
+/************************************************************************/
+
+static int pj_tp_fwd_points( PJ *dstdefn, long point_count, int point_offset,
+                             double *x, double *y, double *z, 
+                             const PJ_ARRAY_STEPS *steps, int *status )
+
+{
+    long      i;
+
+    if( dstdefn->fwd_n != NULL )
+    {
+        int err = pj_fwd_array_steps( dstdefn, point_count, point_offset,
+                                      x, y, z, steps );
+
+        if( err != 0 && !pj_tp_error_is_transient( err, point_count ) )
+            return err;
+        return 0;
+    }
+
+    for( i = 0; i < point_count; i++ )
+    {
+        XY         projected_loc;
+        LP	       geodetic_loc;
+
+        geodetic_loc.u = x[point_offset*i];
+        geodetic_loc.v = y[point_offset*i];
+
+        if( geodetic_loc.u == HUGE_VAL )
+            continue;
+
+        projected_loc = pj_fwd( geodetic_loc, dstdefn );
+        if( dstdefn->ctx->last_errno != 0 )
+        {
+            if( status != NULL )
+            {
+                status[i] = dstdefn->ctx->last_errno;
+                projected_loc.u = HUGE_VAL;
+                projected_loc.v = HUGE_VAL;
+            }
+            else if( (dstdefn->ctx->last_errno != 33 /*EDOM*/ 
+                 && dstdefn->ctx->last_errno != 34 /*ERANGE*/ )
+                && (dstdefn->ctx->last_errno > 0 
+                    || dstdefn->ctx->last_errno < -44 || point_count == 1
+                    || transient_error[-dstdefn->ctx->last_errno] == 0 ) )
+                return dstdefn->ctx->last_errno;
+            else
+            {
+                projected_loc.u = HUGE_VAL;
+                projected_loc.v = HUGE_VAL;
+            }
+        }
+
+        x[point_offset*i] = projected_loc.u;
+        y[point_offset*i] = projected_loc.v;
+    }
+
+    return 0;
+}
+
+/************************************************************************/
+/*                        pj_tp_sphmerc_inv()                           */
+/*                                                                      */
+/*      pj_inv() of a spherical Mercator, in closed form.  The          */
+/*      arithmetic is that of pj_inv() and the merc s_inverse().        */
+/************************************************************************/
+
+static int pj_tp_sphmerc_inv( PJ *srcdefn, long point_count, int point_offset,
+                              double *x, double *y )
+
+{
+    double    k0 = srcdefn->k0;
+    long      i;
+    int       err = 0;
+
+    for( i = 0; i < point_count; i++ )
+    {
+        double *px = x + point_offset*i, *py = y + point_offset*i;
+
+        if( *px == HUGE_VAL )
+            continue;
+        if( *py == HUGE_VAL )
+        {
+            *px = HUGE_VAL;
+            err = -15;
+            continue;
+        }
+
+        *py = HALFPI - 2. * atan(exp(-((*py * srcdefn->to_meter 
+                                        - srcdefn->y0) * srcdefn->ra) / k0));
+        *px = (*px * srcdefn->to_meter - srcdefn->x0) * srcdefn->ra / k0
+            + srcdefn->lam0;
+    }
+    if( !srcdefn->over )
+        adjlon_n( point_count, point_offset, x );
+
+    if( err != 0 )
+    {
+        pj_ctx_set_errno( srcdefn->ctx, err );
+        if( !pj_tp_error_is_transient( err, point_count ) )
+            return err;
+    }
+    return 0;
+}
+
+/************************************************************************/
+/*                        pj_tp_sphmerc_fwd()                           */
+/*                                                                      */
+/*      pj_fwd() of a spherical Mercator, in closed form.  The range    */
+/*      checks and arithmetic are those of pj_fwd() and the merc        */
+/*      s_forward().                                                    */
+/************************************************************************/
+
+static int pj_tp_sphmerc_fwd( PJ *dstdefn, long point_count, int point_offset,
+                              double *x, double *y )
+
+{
+    double    k0 = dstdefn->k0;
+    long      i;
+    int       err = 0;
+
+    for( i = 0; i < point_count; i++ )
+    {
+        double *px = x + point_offset*i, *py = y + point_offset*i;
+        double t;
+
+        if( *px == HUGE_VAL )
+            continue;
+
+        if( (t = fabs(*py) - HALFPI) > 1.0e-12 || fabs(*px) > 10. )
+        {
+            *px = *py = HUGE_VAL;
+            err = -14;
+        }
+        else if( fabs(t) <= 1.0e-10 )
+        {
+            *px = *py = HUGE_VAL;
+            err = -20;
+        }
+        else
+            *px -= dstdefn->lam0;
+    }
+
+    if( !dstdefn->over )
+        adjlon_n( point_count, point_offset, x );
+
+    for( i = 0; i < point_count; i++ )
+    {
+        double *px = x + point_offset*i, *py = y + point_offset*i;
+
+        if( *px == HUGE_VAL )
+            continue;
+
+        *px = dstdefn->fr_meter * (dstdefn->a * (k0 * *px) + dstdefn->x0);
+        *py = dstdefn->fr_meter 
+            * (dstdefn->a * (k0 * log(tan(FORTPI + .5 * *py))) + dstdefn->y0);
+    }
+
+    if( err != 0 )
+    {
+        pj_ctx_set_errno( dstdefn->ctx, err );
+        if( !pj_tp_error_is_transient( err, point_count ) )
+            return err;
+    }
+    return 0;
+}
+
+/************************************************************************/
+/*                           pj_tp_account()                            */
+/*                                                                      */
+/*      Add a stage run to the instrumentation of the context.          */
+/************************************************************************/
+
+static void pj_tp_account( PJ_STATS *stats, int stage, long point_count,
+                           double ns )
+
+{
+    switch( stage )
+    {
+      case PJ_TP_SRC_INV:
+      case PJ_TP_SRC_SPHMERC_INV:
+        pj_stats_add( &(stats->stats.inv), point_count, ns );
+        break;
+
+      case PJ_TP_SRC_VGRIDS:
+      case PJ_TP_DST_VGRIDS:
+      case PJ_TP_GEOID_DIFF:
+        pj_stats_add( &(stats->stats.vgridshift), point_count, ns );
+        break;
+
+      case PJ_TP_DATUM:
+      case PJ_TP_HELMERT:
+      case PJ_TP_GEOCENT_HELMERT:
+      case PJ_TP_GRID_PAIR:
+        pj_stats_add( &(stats->stats.datum), point_count, ns );
+        break;
+
+      case PJ_TP_DST_FWD:
+      case PJ_TP_DST_SPHMERC_FWD:
+      case PJ_TP_ETMERC:
+        pj_stats_add( &(stats->stats.fwd), point_count, ns );
+        break;
+    }
+}
+
+/************************************************************************/
+/*                           pj_tp_grid_pair()                          */
+/*                                                                      */
+/*      The shift between two grid based datums, through their          */
+/*      composed shifts where these are within the error allowed, and   */
+/*      as pj_datum_transform_core() elsewhere, for each run of points  */
+/*      left.                                                           */
+/************************************************************************/
+
+#define PJ_TP_GRID_PAIR_CHUNK 256
+
+static int pj_tp_grid_pair( PJ *srcdefn, PJ *dstdefn, 
+                            long point_count, int point_offset,
+                            double *x, double *y, double *z, 
+                            const double *t )
+
+{
+    PJ_GRID_PAIR  *pair;
+    unsigned char left[PJ_TP_GRID_PAIR_CHUNK];
+    long          base, k, k1;
+    int           n, err;
+
+    pair = pj_grid_pair_get( srcdefn, dstdefn, 
+                             MIN( srcdefn->cold->accuracy,
+                                  dstdefn->cold->accuracy ) );
+    if( pair == NULL )
+        return pj_datum_transform_core( srcdefn, dstdefn, point_count, 
+                                        point_offset, x, y, z, t );
+
+    for( base = 0; base < point_count; base += n )
+    {
+        n = point_count - base > PJ_TP_GRID_PAIR_CHUNK
+            ? PJ_TP_GRID_PAIR_CHUNK : (int) (point_count - base);
+
+        pj_grid_pair_apply( pair, n, point_offset, 
+                            x + base * point_offset,
+                            y + base * point_offset, left );
+
+        for( k = 0; k < n; k = k1 )
+        {
+            long io = (base + k) * point_offset;
+
+            for( k1 = k; k1 < n && left[k1]; k1++ ) {}
+            if( k1 == k )
+            {
+                k1++;
+                continue;
+            }
+
+            err = pj_datum_transform_core( srcdefn, dstdefn, k1 - k, 
+                                           point_offset, x + io, y + io,
+                                           z != NULL ? z + io : NULL, 
+                                           t != NULL ? t + io : NULL );
+            if( err != 0 )
+                return err;
+        }
+    }
+
+    return 0;
+}
+
+/************************************************************************/
+/*                         pj_tp_mark_failed()                          */
+/*                                                                      */
+/*      Give the points a stage has just set to HUGE_VAL their status.  */
+/************************************************************************/
+
+static void pj_tp_mark_failed( long point_count, int point_offset,
+                               double *x, double *y, int *status, int code )
+
+{
+    long      i;
+
+    for( i = 0; i < point_count; i++ )
+    {
+        if( status[i] == 0 && x[point_offset*i] == HUGE_VAL )
+        {
+            status[i] = code;
+            y[point_offset*i] = HUGE_VAL;
+        }
+    }
+}
+
+/************************************************************************/
+/*                          pj_tp_run_stages()                          */
+/*                                                                      */
+/*      Run the stages first_stage to end_stage - 1 of the plan over    */
+/*      the passed points, as pj_tp_execute().                          */
+/************************************************************************/
+
+static int pj_tp_run_stages( PJ_TRANSFORM_PLAN *plan, 
+                             int first_stage, int end_stage,
+                             long point_count, int point_offset,
+                             double *x, double *y, double *z, 
+                             const double *t, int *status )
+
+{
+    PJ        *srcdefn = plan->srcdefn;
+    PJ        *dstdefn = plan->dstdefn;
+    PJ_STATS  *stats = srcdefn->ctx->stats;
+    double    start = 0.0;
+    long      i;
+    int       err, istage;
+
+    for( istage = first_stage; istage < end_stage; istage++ )
+    {
+        if( stats != NULL )
+            start = pj_clock_ns();
+
+        err = 0;
+
+        PJ_TRACE2( stage__start, plan->stages[istage], point_count );
+
+        switch( plan->stages[istage] )
+        {
+/* -------------------------------------------------------------------- */
+/*      Transform unusual input coordinate axis orientation to          */
+/*      standard form if needed.                                        */
+/* -------------------------------------------------------------------- */
+          case PJ_TP_SRC_AXIS:
+            err = pj_adjust_axis( srcdefn->ctx, &(plan->src_axis),
+                                  point_count, point_offset, x, y, z );
+            break;
+
+/* -------------------------------------------------------------------- */
+/*      Transform Z to meters if it isn't already.                      */
+/* -------------------------------------------------------------------- */
+          case PJ_TP_SRC_VTO_METER:
+            if( z != NULL )
+            {
+                for( i = 0; i < point_count; i++ )
+                    z[point_offset*i] *= srcdefn->cold->vto_meter;
+            }
+            break;
+
+/* -------------------------------------------------------------------- */
+/*      Transform geocentric source coordinates to lat/long.            */
+/* -------------------------------------------------------------------- */
+          case PJ_TP_SRC_GEOCENT:
+            if( z == NULL )
+            {
+                pj_ctx_set_errno( pj_get_ctx(srcdefn), PJD_ERR_GEOCENTRIC);
+                err = PJD_ERR_GEOCENTRIC;
+                break;
+            }
+
+            if( srcdefn->to_meter != 1.0 )
+            {
+                for( i = 0; i < point_count; i++ )
+                {
+                    if( x[point_offset*i] != HUGE_VAL )
+                    {
+                        x[point_offset*i] *= srcdefn->to_meter;
+                        y[point_offset*i] *= srcdefn->to_meter;
+                    }
+                }
+            }
+
+            err = pj_geocentric_to_geodetic( srcdefn->cold->a_orig,
+                                             srcdefn->cold->es_orig,
+                                             point_count, point_offset, 
+                                             x, y, z );
+            break;
+
+/* -------------------------------------------------------------------- */
+/*      Transform source points to lat/long, if they aren't             */
+/*      already.                                                        */
+/* -------------------------------------------------------------------- */
+          case PJ_TP_SRC_INV:
+            err = pj_tp_inv_points( srcdefn, point_count, point_offset, 
+                                    x, y, z, &(plan->inv_steps), status );
+            break;
+
+          case PJ_TP_SRC_SPHMERC_INV:
+            err = pj_tp_sphmerc_inv( srcdefn, point_count, point_offset, 
+                                     x, y );
+            break;
+
+/* -------------------------------------------------------------------- */
+/*      But if they are already lat long, adjust for the prime          */
+/*      meridian if there is one in effect.                             */
+/* -------------------------------------------------------------------- */
+          case PJ_TP_SRC_PM:
+            for( i = 0; i < point_count; i++ )
+            {
+                if( x[point_offset*i] != HUGE_VAL )
+                    x[point_offset*i] += srcdefn->cold->from_greenwich;
+            }
+            break;
+
+/* -------------------------------------------------------------------- */
+/*      Do we need to translate from geoid to ellipsoidal vertical      */
+/*      datum?                                                          */
+/* -------------------------------------------------------------------- */
+          case PJ_TP_SRC_VGRIDS:
+            if( pj_apply_vgridshift( srcdefn, "sgeoidgrids", 
+                                     &(srcdefn->cold->vgridlist_geoid), 
+                                     &(srcdefn->cold->vgridlist_geoid_count),
+                                     0, point_count, point_offset, x, y, z,
+                                     status ) != 0 )
+                err = pj_ctx_get_errno(srcdefn->ctx);
+            break;
+        
+/* -------------------------------------------------------------------- */
+/*      Convert datums if needed, and possible.                         */
+/* -------------------------------------------------------------------- */
+          case PJ_TP_DATUM:
+            if( pj_datum_transform_core( srcdefn, dstdefn, point_count, 
+                                         point_offset, x, y, z, t ) != 0 )
+            {
+                if( srcdefn->ctx->last_errno != 0 )
+                    err = srcdefn->ctx->last_errno;
+                else
+                    err = dstdefn->ctx->last_errno;
+            }
+            break;
+
+          case PJ_TP_HELMERT:
+            err = pj_helmert_transform( srcdefn, dstdefn, plan->helmert,
+                                        point_count, point_offset, x, y, z );
+            break;
+
+          case PJ_TP_GRID_PAIR:
+            if( pj_tp_grid_pair( srcdefn, dstdefn, point_count, 
+                                 point_offset, x, y, z, t ) != 0 )
+            {
+                if( srcdefn->ctx->last_errno != 0 )
+                    err = srcdefn->ctx->last_errno;
+                else
+                    err = dstdefn->ctx->last_errno;
+            }
+            break;
+
+/* -------------------------------------------------------------------- */
+/*      Do we need to translate from geoid to ellipsoidal vertical      */
+/*      datum?                                                          */
+/* -------------------------------------------------------------------- */
+          case PJ_TP_DST_VGRIDS:
+            if( pj_apply_vgridshift( dstdefn, "sgeoidgrids", 
+                                     &(dstdefn->cold->vgridlist_geoid), 
+                                     &(dstdefn->cold->vgridlist_geoid_count),
+                                     1, point_count, point_offset, x, y, z,
+                                     status ) != 0 )
+                err = dstdefn->ctx->last_errno;
+            break;
+
+          case PJ_TP_GEOID_DIFF:
+            err = pj_apply_geoid_diff( srcdefn, dstdefn, point_count, 
+                                       point_offset, x, y, z, status );
+            break;
+        
+/* -------------------------------------------------------------------- */
+/*      But if they are staying lat long, adjust for the prime          */
+/*      meridian if there is one in effect.                             */
+/* -------------------------------------------------------------------- */
+          case PJ_TP_DST_PM:
+            for( i = 0; i < point_count; i++ )
+            {
+                if( x[point_offset*i] != HUGE_VAL )
+                    x[point_offset*i] -= dstdefn->cold->from_greenwich;
+            }
+            break;
+
+/* -------------------------------------------------------------------- */
+/*      Transform destination latlong to geocentric if required.        */
+/* -------------------------------------------------------------------- */
+          case PJ_TP_DST_GEOCENT:
+            if( z == NULL )
+            {
+                pj_ctx_set_errno( dstdefn->ctx, PJD_ERR_GEOCENTRIC );
+                return PJD_ERR_GEOCENTRIC;
+            }
+
+            pj_geodetic_to_geocentric( dstdefn->cold->a_orig,
+                                       dstdefn->cold->es_orig,
+                                       point_count, point_offset, x, y, z );
+
+            if( dstdefn->fr_meter != 1.0 )
+            {
+                for( i = 0; i < point_count; i++ )
+                {
+                    if( x[point_offset*i] != HUGE_VAL )
+                    {
+                        x[point_offset*i] *= dstdefn->fr_meter;
+                        y[point_offset*i] *= dstdefn->fr_meter;
+                    }
+                }
+            }
+            break;
+
+/* -------------------------------------------------------------------- */
+/*      Transform destination points to projection coordinates, if      */
+/*      desired.                                                        */
+/* -------------------------------------------------------------------- */
+          case PJ_TP_DST_FWD:
+            err = pj_tp_fwd_points( dstdefn, point_count, point_offset, 
+                                    x, y, z, &(plan->fwd_steps), status );
+            break;
+
+          case PJ_TP_DST_SPHMERC_FWD:
+            err = pj_tp_sphmerc_fwd( dstdefn, point_count, point_offset, 
+                                     x, y );
+            break;
+
+          case PJ_TP_GEOCENT_HELMERT:
+            if( z == NULL )
+            {
+                pj_ctx_set_errno( pj_get_ctx(srcdefn), PJD_ERR_GEOCENTRIC);
+                err = PJD_ERR_GEOCENTRIC;
+                break;
+            }
+
+            for( i = 0; i < point_count; i++ )
+            {
+                const double *m = plan->helmert;
+                long io = i * point_offset;
+                double X = x[io], Y = y[io], Z = z[io];
+
+                if( X == HUGE_VAL )
+                    continue;
+
+                x[io] = m[0]*X + m[1]*Y + m[2]*Z + m[3];
+                y[io] = m[4]*X + m[5]*Y + m[6]*Z + m[7];
+                z[io] = m[8]*X + m[9]*Y + m[10]*Z + m[11];
+            }
+            break;
+
+          case PJ_TP_ETMERC:
+            err = pj_etmerc_convert( srcdefn, dstdefn, point_count, 
+                                     point_offset, x, y );
+            if( err != 0 )
+            {
+                pj_ctx_set_errno( srcdefn->ctx, err );
+                if( pj_tp_error_is_transient( err, point_count ) )
+                    err = 0;
+            }
+            break;
+
+/* -------------------------------------------------------------------- */
+/*      If a wrapping center other than 0 is provided, rewrap around    */
+/*      the suggested center (for latlong coordinate systems only).     */
+/* -------------------------------------------------------------------- */
+          case PJ_TP_DST_LONG_WRAP:
+            adjlon_wrap_n( point_count, point_offset, x, 
+                           dstdefn->cold->long_wrap_center );
+            break;
+
+/* -------------------------------------------------------------------- */
+/*      Transform Z from meters if needed.                              */
+/* -------------------------------------------------------------------- */
+          case PJ_TP_DST_VFR_METER:
+            if( z != NULL )
+            {
+                for( i = 0; i < point_count; i++ )
+                    z[point_offset*i] *= dstdefn->cold->vfr_meter;
+            }
+            break;
+
+/* -------------------------------------------------------------------- */
+/*      Transform normalized axes into unusual output coordinate axis   */
+/*      orientation if needed.                                          */
+/* -------------------------------------------------------------------- */
+          case PJ_TP_DST_AXIS:
+            err = pj_adjust_axis( dstdefn->ctx, &(plan->dst_axis),
+                                  point_count, point_offset, x, y, z );
+            break;
+
+/* -------------------------------------------------------------------- */
+/*      Direct unit changes between otherwise equivalent systems.       */
+/* -------------------------------------------------------------------- */
+          case PJ_TP_XY_SCALE:
+            for( i = 0; i < point_count; i++ )
+            {
+                if( x[point_offset*i] != HUGE_VAL )
+                {
+                    x[point_offset*i] *= plan->xy_scale;
+                    y[point_offset*i] *= plan->xy_scale;
+                }
+            }
+            break;
+
+          case PJ_TP_Z_SCALE:
+            if( z != NULL )
+            {
+                for( i = 0; i < point_count; i++ )
+                    z[point_offset*i] *= plan->z_scale;
+            }
+            break;
+        }
+
+        PJ_TRACE2( stage__done, plan->stages[istage], err );
+
+        if( stats != NULL )
+            pj_tp_account( stats, plan->stages[istage], point_count,
+                           pj_clock_ns() - start );
+
+/* -------------------------------------------------------------------- */
+/*      Without a status any error stops here, as do points left for    */
+/*      a grid being loaded.  With one, only errors that are not about  */
+/*      single points do, and the points the stage failed are given     */
+/*      their status.                                                   */
+/* -------------------------------------------------------------------- */
+        if( status == NULL )
+        {
+            if( err == 0 
+                && (srcdefn->ctx->last_errno == PJD_ERR_GRID_NOT_READY
+                    || dstdefn->ctx->last_errno == PJD_ERR_GRID_NOT_READY) )
+                err = PJD_ERR_GRID_NOT_READY;
+            if( err != 0 )
+                return err;
+        }
+        else if( err != 0 && !pj_tp_error_is_transient( err, 0 ) )
+            return err;
+        else if( err != 0 || srcdefn->ctx->last_errno != 0 
+                 || dstdefn->ctx->last_errno != 0 )
+        {
+            if( err == 0 )
+                err = srcdefn->ctx->last_errno != 0 
+                    ? srcdefn->ctx->last_errno : dstdefn->ctx->last_errno;
+            pj_tp_mark_failed( point_count, point_offset, x, y, status, err );
+            srcdefn->ctx->last_errno = 0;
+            dstdefn->ctx->last_errno = 0;
+        }
+    }
+
+    return 0;
+}
+
+/************************************************************************/
+/*                         pj_tp_has_kernel()                           */
+/*                                                                      */
+/*      Does the plan run a stage over whole arrays of points, an       */
+/*      array kernel of a projection or a fused loop, rather than one   */
+/*      point at a time?                                                */
+/************************************************************************/
+
+static int pj_tp_has_kernel( PJ_TRANSFORM_PLAN *plan )
+
+{
+    int istage;
+
+    for( istage = 0; istage < plan->stage_count; istage++ )
+    {
+        switch( plan->stages[istage] )
+        {
+          case PJ_TP_SRC_SPHMERC_INV:
+          case PJ_TP_DST_SPHMERC_FWD:
+          case PJ_TP_ETMERC:
+            return 1;
+
+          case PJ_TP_SRC_INV:
+            if( plan->srcdefn->inv_n != NULL )
+                return 1;
+            break;
+
+          case PJ_TP_DST_FWD:
+            if( plan->dstdefn->fwd_n != NULL )
+                return 1;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/************************************************************************/
+/*                          pj_tp_grid_stage()                          */
+/*                                                                      */
+/*      The first stage of the plan looking points up in grids, or      */
+/*      stage_count if there is none.                                   */
+/************************************************************************/
+
+static int pj_tp_grid_stage( PJ_TRANSFORM_PLAN *plan )
+
+{
+    int istage;
+
+    for( istage = 0; istage < plan->stage_count; istage++ )
+    {
+        switch( plan->stages[istage] )
+        {
+          case PJ_TP_SRC_VGRIDS:
+          case PJ_TP_DST_VGRIDS:
+          case PJ_TP_GEOID_DIFF:
+          case PJ_TP_GRID_PAIR:
+            return istage;
+
+          case PJ_TP_DATUM:
+            if( plan->srcdefn->cold->datum_type == PJD_GRIDSHIFT
+                || plan->dstdefn->cold->datum_type == PJD_GRIDSHIFT )
+                return istage;
+            break;
+        }
+    }
+
+    return plan->stage_count;
+}
+
+/************************************************************************/
+/*                     pj_transform_plan_separable()                    */
+/*                                                                      */
+/*      Does the plan give x from the source x only, and y from the     */
+/*      source y only?  That holds with no axis, datum or vertical      */
+/*      grid stage when each projection in the plan is separable,       */
+/*      with failures of a point coming from either coordinate, so      */
+/*      that a regular grid is done from one row and one column.        */
+/************************************************************************/
+
+int pj_transform_plan_separable( PJ_TRANSFORM_PLAN *plan )
+
+{
+    int istage;
+
+    for( istage = 0; istage < plan->stage_count; istage++ )
+    {
+        switch( plan->stages[istage] )
+        {
+          case PJ_TP_SRC_VTO_METER:
+          case PJ_TP_SRC_PM:
+          case PJ_TP_DST_PM:
+          case PJ_TP_DST_LONG_WRAP:
+          case PJ_TP_DST_VFR_METER:
+          case PJ_TP_XY_SCALE:
+          case PJ_TP_Z_SCALE:
+            break;
+
+          case PJ_TP_SRC_INV:
+          case PJ_TP_SRC_SPHMERC_INV:
+            if( !plan->srcdefn->separable || plan->srcdefn->approx != NULL
+                || plan->inv_steps.axis_swap )
+                return 0;
+            break;
+
+          case PJ_TP_DST_FWD:
+          case PJ_TP_DST_SPHMERC_FWD:
+            if( !plan->dstdefn->separable || plan->dstdefn->approx != NULL
+                || plan->fwd_steps.axis_swap )
+                return 0;
+            break;
+
+          default:
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/************************************************************************/
+/*                         pj_tp_grids_tiled()                          */
+/*                                                                      */
+/*      Are any of the grids the definition has looked up so far read  */
+/*      a tile at a time, and too large for all their tiles to stay    */
+/*      resident?                                                       */
+/************************************************************************/
+
+static int pj_tp_grid_tiled( projCtx ctx, PJ_GRIDINFO *gi )
+
+{
+    return pj_gridinfo_tiled( ctx, gi ) 
+        && gi->ct->lim.phi > ctx->grid_tile_limit * PJ_GRID_TILE_ROWS;
+}
+
+static int pj_tp_grids_tiled( PJ *defn )
+
+{
+    int i;
+
+    for( i = 0; i < defn->cold->gridlist_count; i++ )
+        if( pj_tp_grid_tiled( defn->ctx, defn->cold->gridlist[i] ) )
+            return 1;
+
+    for( i = 0; i < defn->cold->vgridlist_geoid_count; i++ )
+        if( pj_tp_grid_tiled( defn->ctx, defn->cold->vgridlist_geoid[i] ) )
+            return 1;
+
+    return 0;
+}
+
+/************************************************************************/
+/*                          pj_tp_run_blocks()                          */
+/*                                                                      */
+/*      pj_tp_run_stages() over blocks of PJ_TP_FUSE_BLOCK points, so   */
+/*      that the points stay in cache from one stage to the next        */
+/*      rather than each stage taking the whole batch through memory.   */
+/*      Each point goes through the same arithmetic, in the same       */
+/*      order.  The last block is not left with a single point, whose   */
+/*      error would fail the batch.                                     */
+/************************************************************************/
+
+#define PJ_TP_FUSE_BLOCK 1024
+
+static int pj_tp_run_blocks( PJ_TRANSFORM_PLAN *plan, 
+                             int first_stage, int end_stage,
+                             long point_count, int point_offset,
+                             double *x, double *y, double *z, 
+                             const double *t, int *status )
+
+{
+    long      base, n;
+    int       err = 0;
+
+    if( point_count < 2 * PJ_TP_FUSE_BLOCK )
+        return pj_tp_run_stages( plan, first_stage, end_stage, point_count,
+                                 point_offset, x, y, z, t, status );
+
+    for( base = 0; base < point_count && err == 0; base += n )
+    {
+        long offset = base * point_offset;
+
+        n = point_count - base;
+        if( n > PJ_TP_FUSE_BLOCK )
+            n = n - PJ_TP_FUSE_BLOCK < 2 ? PJ_TP_FUSE_BLOCK / 2 
+                : PJ_TP_FUSE_BLOCK;
+
+        err = pj_tp_run_stages( plan, first_stage, end_stage, n, 
+                                point_offset, x + offset, y + offset,
+                                z != NULL ? z + offset : NULL, 
+                                t != NULL ? t + offset : NULL,
+                                status != NULL ? status + base : NULL );
+    }
+
+    return err;
+}
+
+/************************************************************************/
+/*                        pj_tp_execute_points()                        */
+/*                                                                      */
+/*      Run the stages recorded in the plan over the passed points.     */
+/*      Without status, arguments and return value are as for           */
+/*      pj_transform().  With status, errors of single points are       */
+/*      recorded there instead, and only errors of the whole batch      */
+/*      are returned.  t, if not NULL, holds the dates of the points.   */
+/*                                                                      */
+/*      Batches of at least the grid sort threshold of the context      */
+/*      are run through the grid stages, and those after them, in       */
+/*      windows of up to PJ_TP_SORT_WINDOW points, or                   */
+/*      PJ_LOW_MEMORY_WINDOW in low memory mode, see                    */
+/*      pj_ctx_set_low_memory().  Where the grids looked up are read a  */
+/*      tile at a time, and have more tiles than can stay resident,     */
+/*      the points of a window are copied in the order of               */
+/*      pj_grid_order(), and back, as in their own order they could     */
+/*      need a tile read for each point.                                */
+/*      Grids held in memory do not gain enough from it to pay for      */
+/*      the copies.  Each point is shifted the same in any order.       */
+/*      The stages are run block by block, see pj_tp_run_blocks().      */
+/************************************************************************/
+
+#define PJ_TP_SORT_WINDOW 262144
+
+static int pj_tp_execute_points( PJ_TRANSFORM_PLAN *plan,
+                                 long point_count, int point_offset,
+                                 double *x, double *y, double *z, 
+                                 const double *t, int *status )
+
+{
+    projCtx   ctx = plan->srcdefn->ctx;
+    double    *sx, *sy, *sz, *st;
+    long      *order;
+    int       *ss;
+    unsigned short *keys;
+    long      window, base, n, i;
+    int       grid_stage, err = 0;
+
+    plan->srcdefn->ctx->last_errno = 0;
+    plan->dstdefn->ctx->last_errno = 0;
+
+    if( ctx->grid_sort_threshold <= 0 
+        || point_count < ctx->grid_sort_threshold 
+        || point_count < 2
+        || (grid_stage = pj_tp_grid_stage( plan )) == plan->stage_count )
+        return pj_tp_run_blocks( plan, 0, plan->stage_count, point_count, 
+                                 point_offset, x, y, z, t, status );
+
+    err = pj_tp_run_blocks( plan, 0, grid_stage, point_count, point_offset, 
+                            x, y, z, t, status );
+    if( err != 0 )
+        return err;
+
+    /* a window of one point would fail on the error of that point */
+    window = ctx->low_memory ? PJ_LOW_MEMORY_WINDOW : PJ_TP_SORT_WINDOW;
+    if( point_count < window + 2 )
+        window = point_count;
+
+    sx = (double *) pj_malloc( window * (4 * sizeof(double) 
+                                         + 2 * sizeof(long) + sizeof(int)
+                                         + 2 * sizeof(unsigned short)) );
+    if( sx == NULL )
+        return pj_tp_run_blocks( plan, grid_stage, plan->stage_count, 
+                                 point_count, point_offset, x, y, z, t, 
+                                 status );
+    sy = sx + window;
+    sz = z != NULL ? sx + 2 * window : NULL;
+    st = t != NULL ? sx + 3 * window : NULL;
+    order = (long *) (sx + 4 * window);
+    ss = status != NULL ? (int *) (order + 2 * window) : NULL;
+    keys = (unsigned short *) ((int *) (order + 2 * window) + window);
+
+    for( base = 0; base < point_count && err == 0; base += n )
+    {
+        long   offset = base * point_offset;
+
+        n = point_count - base;
+        if( n > window )
+            n = n - window < 2 ? window / 2 : window;
+
+        /* the grid lists are only known once they have been used */
+        if( !(pj_tp_grids_tiled( plan->srcdefn ) 
+              || pj_tp_grids_tiled( plan->dstdefn ))
+            || !pj_grid_order( n, point_offset, x + offset, y + offset, 
+                               order, keys ) )
+        {
+            err = pj_tp_run_blocks( plan, grid_stage, plan->stage_count, n,
+                                    point_offset, x + offset, y + offset,
+                                    z != NULL ? z + offset : NULL, 
+                                    t != NULL ? t + offset : NULL,
+                                    status != NULL ? status + base : NULL );
+            continue;
+        }
+
+        for( i = 0; i < n; i++ )
+        {
+            long io = offset + order[i] * point_offset;
+
+            sx[i] = x[io];
+            sy[i] = y[io];
+            if( sz != NULL )
+                sz[i] = z[io];
+            if( st != NULL )
+                st[i] = t[io];
+            if( ss != NULL )
+                ss[i] = status[base + order[i]];
+        }
+
+        err = pj_tp_run_blocks( plan, grid_stage, plan->stage_count, n, 1,
+                                sx, sy, sz, st, ss );
+
+        for( i = 0; i < n; i++ )
+        {
+            long io = offset + order[i] * point_offset;
+
+            x[io] = sx[i];
+            y[io] = sy[i];
+            if( sz != NULL )
+                z[io] = sz[i];
+            if( ss != NULL )
+                status[base + order[i]] = ss[i];
+        }
+    }
+
+    pj_dalloc( sx );
+
+    return err;
+}
+
+/************************************************************************/
+/*                           pj_tp_execute()                            */
+/*                                                                      */
+/*      pj_tp_execute_points() over the points not passed as            */
+/*      HUGE_VAL.  When at least one in PJ_TP_COMPACT_RATIO of a        */
+/*      batch is, and the plan has an array kernel, see                 */
+/*      pj_tp_has_kernel(), the others are copied together, in windows  */
+/*      of up to PJ_TP_COMPACT_WINDOW points, or PJ_LOW_MEMORY_WINDOW   */
+/*      in low memory mode, for the stages to run over them without     */
+/*      holes, and copied back.  The points passed as HUGE_VAL are      */
+/*      then left as they are.  A window of several points with only    */
+/*      one to transform is run in place, as that point alone would     */
+/*      fail the batch on its error.                                    */
+/************************************************************************/
+
+#define PJ_TP_COMPACT_RATIO  16
+#define PJ_TP_COMPACT_WINDOW 262144
+
+static int pj_tp_execute( PJ_TRANSFORM_PLAN *plan,
+                          long point_count, int point_offset,
+                          double *x, double *y, double *z, 
+                          const double *t, int *status )
+
+{
+    double    *dx, *dy, *dz, *dt;
+    long      *index;
+    int       *ds;
+    long      window, base, n, m, i, missing = 0;
+    int       err = 0;
+
+    if( point_offset == 0 )
+        point_offset = 1;
+
+    if( point_count >= 2 && pj_tp_has_kernel( plan ) )
+    {
+        for( i = 0; i < point_count; i++ )
+            missing += x[point_offset*i] == HUGE_VAL;
+    }
+
+    if( missing == point_count 
+        || missing * PJ_TP_COMPACT_RATIO < point_count )
+        return pj_tp_execute_points( plan, point_count, point_offset, 
+                                     x, y, z, t, status );
+
+    /* the last window is not left with a single point either */
+    window = plan->srcdefn->ctx->low_memory 
+        ? PJ_LOW_MEMORY_WINDOW : PJ_TP_COMPACT_WINDOW;
+    if( point_count < window + 2 )
+        window = point_count;
+
+    dx = (double *) pj_malloc( window * (4 * sizeof(double) + sizeof(long)
+                                         + sizeof(int)) );
+    if( dx == NULL )
+        return pj_tp_execute_points( plan, point_count, point_offset, 
+                                     x, y, z, t, status );
+    dy = dx + window;
+    dz = z != NULL ? dx + 2 * window : NULL;
+    dt = t != NULL ? dx + 3 * window : NULL;
+    index = (long *) (dx + 4 * window);
+    ds = status != NULL ? (int *) (index + window) : NULL;
+
+    for( base = 0; base < point_count && err == 0; base += n )
+    {
+        long offset = base * point_offset;
+
+        n = point_count - base;
+        if( n > window )
+            n = n - window < 2 ? window / 2 : window;
+
+        /* the indices of the points to transform, without branches */
+        for( i = 0, m = 0; i < n; i++ )
+        {
+            index[m] = i;
+            m += x[offset + i * point_offset] != HUGE_VAL;
+        }
+
+        if( m == 0 )
+            continue;
+
+        if( m == 1 && n > 1 )
+        {
+            err = pj_tp_execute_points( plan, n, point_offset, 
+                                        x + offset, y + offset,
+                                        z != NULL ? z + offset : NULL, 
+                                        t != NULL ? t + offset : NULL,
+                                        status != NULL ? status + base 
+                                                       : NULL );
+            continue;
+        }
+
+        for( i = 0; i < m; i++ )
+        {
+            long io = offset + index[i] * point_offset;
+
+            dx[i] = x[io];
+            dy[i] = y[io];
+            if( dz != NULL )
+                dz[i] = z[io];
+            if( dt != NULL )
+                dt[i] = t[io];
+            if( ds != NULL )
+                ds[i] = status[base + index[i]];
+        }
+
+        err = pj_tp_execute_points( plan, m, 1, dx, dy, dz, dt, ds );
+
+        for( i = 0; i < m; i++ )
+        {
+            long io = offset + index[i] * point_offset;
+
+            x[io] = dx[i];
+            y[io] = dy[i];
+            if( dz != NULL )
+                z[io] = dz[i];
+            if( ds != NULL )
+                status[base + index[i]] = ds[i];
+        }
+    }
+
+    pj_dalloc( dx );
+
+    return err;
+}
+
+/*
+** With pj_ctx_set_threads() above 1, batches of at least two times
+** the minimum split of the context are cut in chunks of its grain, see
+** pj_ctx_set_batch_grain() and pj_ctx_set_batch_min_split(), and
+** each thread is given a run of consecutive chunks to work through in
+** order.  One that is done with its own steals the upper half of the
+** run with the most chunks left, so the costly points, outside grids or
+** iterated, do not leave threads idle, while neighbouring points, on
+** the same grid tiles, mostly stay on one thread.
+**
+** The calling thread works with the definitions of the plan.  Each
+** other one gets a scratch copy of their context, clones of the
+** definitions bound to it, so that their grid lists, catalog state and
+** errors are its own.  The grids themselves are shared through the
+** registry of the context.
+*/
+
+struct PJ_TP_BATCH_s;
+
+typedef struct {
+    PJ_TRANSFORM_PLAN plan;
+    projCtx   ctx;            /* scratch context, NULL for the caller's */
+    struct PJ_TP_BATCH_s *batch;
+    long      next, end;      /* chunks left to it, under batch->lock */
+    projStatsCounter work;    /* chunks, points and busy time */
+    void      *thread;
+} PJ_TP_WORKER;
+
+typedef struct PJ_TP_BATCH_s {
+    long      point_count;
+    int       point_offset;
+    double    *x, *y, *z;
+    const double *t;
+    int       *status;
+    long      grain;          /* points of a chunk */
+    long      chunk_count;
+    void      *lock;
+    long      failed_chunk;   /* first chunk that failed, or chunk_count */
+    int       err;            /* its error */
+    int       timed;          /* account the work of each worker */
+    int       worker_count;
+    PJ_TP_WORKER *workers;
+} PJ_TP_BATCH;
+
+/************************************************************************/
+/*                        pj_tp_next_chunk()                            */
+/*                                                                      */
+/*      The next chunk for the worker, its own or stolen, or -1 when    */
+/*      there is none left worth running.                               */
+/************************************************************************/
+
+static long pj_tp_next_chunk( PJ_TP_WORKER *worker )
+
+{
+    PJ_TP_BATCH *batch = worker->batch;
+    long        chunk = -1;
+
+    pj_mutex_lock( batch->lock );
+
+    if( worker->next >= worker->end )
+    {
+        PJ_TP_WORKER *victim = NULL;
+        int          j;
+
+        for( j = 0; j < batch->worker_count; j++ )
+        {
+            PJ_TP_WORKER *other = batch->workers + j;
+
+            if( other->end > other->next
+                && (victim == NULL 
+                    || other->end - other->next > victim->end - victim->next) )
+                victim = other;
+        }
+
+        if( victim != NULL )
+        {
+            worker->end = victim->end;
+            worker->next = victim->end 
+                - (victim->end - victim->next + 1) / 2;
+            victim->end = worker->next;
+        }
+    }
+
+    /* chunks after one that failed are not needed for its error */
+    if( worker->next < worker->end && worker->next < batch->failed_chunk )
+        chunk = worker->next++;
+
+    pj_mutex_unlock( batch->lock );
+
+    return chunk;
+}
+
+/************************************************************************/
+/*                         pj_tp_worker_run()                           */
+/************************************************************************/
+
+static void pj_tp_worker_run( void *arg )
+
+{
+    PJ_TP_WORKER *worker = (PJ_TP_WORKER *) arg;
+    PJ_TP_BATCH  *batch = worker->batch;
+    long         chunk;
+
+    while( (chunk = pj_tp_next_chunk( worker )) >= 0 )
+    {
+        long   first = chunk * batch->grain;
+        long   count = chunk == batch->chunk_count - 1 
+            ? batch->point_count - first : batch->grain;
+        long   offset = first * batch->point_offset;
+        double start = batch->timed ? pj_clock_ns() : 0.0;
+        int    err;
+
+        err = pj_tp_execute( &(worker->plan), count, batch->point_offset, 
+                             batch->x + offset, batch->y + offset, 
+                             batch->z != NULL ? batch->z + offset : NULL,
+                             batch->t != NULL ? batch->t + offset : NULL,
+                             batch->status != NULL 
+                             ? batch->status + first : NULL );
+
+        if( batch->timed )
+            pj_stats_add( &(worker->work), count, pj_clock_ns() - start );
+
+        if( err != 0 )
+        {
+            pj_mutex_lock( batch->lock );
+            if( chunk < batch->failed_chunk )
+            {
+                batch->failed_chunk = chunk;
+                batch->err = err;
+            }
+            pj_mutex_unlock( batch->lock );
+        }
+    }
+}
+
+/************************************************************************/
+/*                        pj_tp_worker_free()                           */
+/************************************************************************/
+
+static void pj_tp_worker_free( PJ_TP_WORKER *worker )
+
+{
+    if( worker->ctx == NULL )
+        return;
+
+    if( worker->plan.dstdefn != worker->plan.srcdefn )
+        pj_free( worker->plan.dstdefn );
+    pj_free( worker->plan.srcdefn );
+    pj_ctx_free( worker->ctx );
+}
+
+/************************************************************************/
+/*                        pj_tp_worker_init()                           */
+/*                                                                      */
+/*      Give the worker a scratch context, copied from ctx, and the     */
+/*      plan over clones of the definitions.  Returns 0 on failure,     */
+/*      with nothing left to free.                                      */
+/************************************************************************/
+
+static int pj_tp_worker_init( PJ_TP_WORKER *worker, PJ_TRANSFORM_PLAN *plan,
+                              projCtx ctx )
+
+{
+    worker->ctx = pj_ctx_alloc();
+    if( worker->ctx == NULL )
+        return 0;
+
+    memcpy( worker->ctx, ctx, sizeof(projCtx_t) );
+    worker->ctx->last_errno = 0;
+    worker->ctx->grid_tiles = NULL;
+    worker->ctx->grid_tile_count = 0;
+    worker->ctx->errno_globals = 0; /* set once by the calling thread */
+    worker->ctx->threads = 1;
+    worker->ctx->stats = NULL;
+    if( ctx->stats != NULL )
+        pj_ctx_set_stats( worker->ctx, 1 );
+
+    memcpy( &(worker->plan), plan, sizeof(PJ_TRANSFORM_PLAN) );
+    worker->plan.srcdefn = pj_clone( worker->ctx, plan->srcdefn );
+    if( worker->plan.srcdefn == NULL )
+    {
+        pj_ctx_free( worker->ctx );
+        return 0;
+    }
+
+    if( plan->dstdefn == plan->srcdefn )
+        worker->plan.dstdefn = worker->plan.srcdefn;
+    else if( (worker->plan.dstdefn = 
+              pj_clone( worker->ctx, plan->dstdefn )) == NULL )
+    {
+        pj_free( worker->plan.srcdefn );
+        pj_ctx_free( worker->ctx );
+        return 0;
+    }
+
+    return 1;
+}
+
+/************************************************************************/
+/*                        pj_tp_account_batch()                         */
+/*                                                                      */
+/*      Add the work of the scratch contexts and of each worker to      */
+/*      the statistics of the calling context.                          */
+/************************************************************************/
+
+static void pj_tp_account_batch( PJ_STATS *stats, PJ_TP_BATCH *batch, 
+                                 double ns )
+
+{
+    projStats *s = &(stats->stats);
+    int       j;
+
+    pj_stats_add( &(s->parallel), batch->point_count, ns );
+
+    for( j = 0; j < batch->worker_count; j++ )
+    {
+        PJ_TP_WORKER *worker = batch->workers + j;
+
+        if( worker->ctx != NULL && worker->ctx->stats != NULL )
+            pj_stats_merge( stats, worker->ctx->stats );
+
+        if( j >= PJ_STATS_MAX_WORKERS )
+            continue;
+        if( j >= s->worker_count )
+            s->worker_count = j + 1;
+        s->workers[j].calls += worker->work.calls;
+        s->workers[j].points += worker->work.points;
+        s->workers[j].nanoseconds += worker->work.nanoseconds;
+    }
+}
+
+/************************************************************************/
+/*                        pj_tp_execute_chunks()                        */
+/*                                                                      */
+/*      pj_tp_execute() shared by the threads of the context of the     */
+/*      source.  The error of the first chunk to fail, in the order     */
+/*      of the points, is returned and left in that context.  Batches   */
+/*      too small to share, or for which the scratch state cannot be    */
+/*      set up, are run on the calling thread alone.                    */
+/************************************************************************/
+
+static int pj_tp_execute_chunks( PJ_TRANSFORM_PLAN *plan,
+                                 long point_count, int point_offset,
+                                 double *x, double *y, double *z, 
+                                 const double *t, int *status )
+
+{
+    projCtx     ctx = plan->srcdefn->ctx;
+    PJ_TP_BATCH batch;
+    double      start = 0.0;
+    int         j;
+
+    if( ctx->threads < 2 || point_count < 2 * ctx->batch_min_split )
+        return pj_tp_execute( plan, point_count, point_offset, x, y, z, 
+                              t, status );
+
+    batch.point_count = point_count;
+    batch.point_offset = point_offset;
+    batch.x = x;
+    batch.y = y;
+    batch.z = z;
+    batch.t = t;
+    batch.status = status;
+    batch.grain = ctx->batch_grain;
+    batch.chunk_count = point_count / batch.grain; /* the last is longer */
+    batch.failed_chunk = batch.chunk_count;
+    batch.err = 0;
+    batch.timed = ctx->stats != NULL;
+    batch.worker_count = ctx->threads;
+    if( batch.worker_count > point_count / ctx->batch_min_split )
+        batch.worker_count = (int) (point_count / ctx->batch_min_split);
+
+    batch.lock = pj_mutex_create( PJ_LOCK_BATCH );
+    if( batch.lock == NULL )
+        return pj_tp_execute( plan, point_count, point_offset, x, y, z, 
+                              t, status );
+
+    batch.workers = (PJ_TP_WORKER *) 
+        pj_malloc( batch.worker_count * sizeof(PJ_TP_WORKER) );
+    if( batch.workers == NULL )
+    {
+        pj_mutex_destroy( batch.lock );
+        return pj_tp_execute( plan, point_count, point_offset, x, y, z, 
+                              t, status );
+    }
+
+    for( j = 0; j < batch.worker_count; j++ )
+    {
+        PJ_TP_WORKER *worker = batch.workers + j;
+
+        if( j == 0 )
+        {
+            memcpy( &(worker->plan), plan, sizeof(PJ_TRANSFORM_PLAN) );
+            worker->ctx = NULL;
+        }
+        else if( !pj_tp_worker_init( worker, plan, ctx ) )
+        {
+            while( --j > 0 )
+                pj_tp_worker_free( batch.workers + j );
+            pj_dalloc( batch.workers );
+            pj_mutex_destroy( batch.lock );
+            return pj_tp_execute( plan, point_count, point_offset, x, y, z, 
+                                  t, status );
+        }
+
+        worker->batch = &batch;
+        worker->next = batch.chunk_count * j / batch.worker_count;
+        worker->end = batch.chunk_count * (j + 1) / batch.worker_count;
+        memset( &(worker->work), 0, sizeof(projStatsCounter) );
+        worker->thread = NULL;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Start the other workers, work on the calling thread, and        */
+/*      wait.  The chunks of a worker whose thread could not be         */
+/*      started are stolen by the others.                               */
+/* -------------------------------------------------------------------- */
+    if( batch.timed )
+        start = pj_clock_ns();
+
+    for( j = 1; j < batch.worker_count; j++ )
+        batch.workers[j].thread = 
+            pj_thread_start( pj_tp_worker_run, batch.workers + j );
+
+    pj_tp_worker_run( batch.workers );
+
+    for( j = 1; j < batch.worker_count; j++ )
+        pj_thread_join( batch.workers[j].thread );
+
+    if( batch.timed )
+        pj_tp_account_batch( ctx->stats, &batch, pj_clock_ns() - start );
+
+    if( batch.err != 0 )
+        pj_ctx_set_errno( ctx, batch.err );
+
+    for( j = 1; j < batch.worker_count; j++ )
+        pj_tp_worker_free( batch.workers + j );
+    pj_dalloc( batch.workers );
+    pj_mutex_destroy( batch.lock );
+
+    return batch.err;
+}
+
+/************************************************************************/
+/*                    pj_transform_plan_set_memo()                      */
+/*                                                                      */
+/*      Keep the outputs of the last points of the plan, in a table of  */
+/*      entries slots rounded up to a power of two, so that points      */
+/*      given again, down to the bits of each coordinate, are not       */
+/*      transformed again.  That serves vertices shared by the rings    */
+/*      of polygons, or points coming back from one request to the      */
+/*      next, within a batch as across batches.  0 drops the memo.      */
+/*                                                                      */
+/*      The memo times itself over windows of PJ_TP_MEMO_WINDOW         */
+/*      lookups, against the time of the points it did not have.  If    */
+/*      the hits of a window do not save more than the lookups cost,    */
+/*      the points go past it for as many points as the last idle       */
+/*      run doubled, from a window up to PJ_TP_MEMO_MAX_IDLE, and it    */
+/*      is tried again.  Points with dates, as for grid catalogs, are   */
+/*      never looked up.  Several threads may run the plan at once.     */
+/*      Returns FALSE if the table cannot be allocated.                 */
+/************************************************************************/
+
+#define PJ_TP_MEMO_MIN       64
+#define PJ_TP_MEMO_MAX       (1L << 24)
+#define PJ_TP_MEMO_WINDOW    4096
+#define PJ_TP_MEMO_MAX_IDLE  (1L << 24)
+
+/* the memo kinds of the points of a slot */
+#define PJ_TP_MEMO_USED      1
+#define PJ_TP_MEMO_Z         2      /* with z */
+#define PJ_TP_MEMO_STATUS    4      /* from a batch with a status */
+
+typedef struct {
+    double        in[3], out[3];    /* in[2] and out[2] 0 without z */
+    int           status;
+    int           kind;
+    unsigned long serial;           /* of the batch the point is to come
+                                       from, 0 once it is set */
+    long          pending;          /* its miss in that batch */
+} PJ_TP_MEMO_SLOT;
+
+struct PJ_TP_MEMO_s {
+    void          *lock;
+    long          mask;             /* slot count less one */
+    PJ_TP_MEMO_SLOT *slots;
+    unsigned long serial;           /* of the last batch */
+    long          lookups, hits;    /* of the current window */
+    double        memo_ns, miss_ns;
+    long          idle;             /* points left to go past */
+    long          idle_run;         /* length of the last idle run */
+};
+
+int pj_transform_plan_set_memo( PJ_TRANSFORM_PLAN *plan, long entries )
+
+{
+    struct PJ_TP_MEMO_s *memo;
+    long      slot_count;
+
+    if( plan->memo != NULL )
+    {
+        pj_mutex_destroy( plan->memo->lock );
+        pj_dalloc( plan->memo->slots );
+        pj_dalloc( plan->memo );
+        plan->memo = NULL;
+    }
+    if( entries <= 0 )
+        return 1;
+
+    for( slot_count = PJ_TP_MEMO_MIN; 
+         slot_count < entries && slot_count < PJ_TP_MEMO_MAX; 
+         slot_count *= 2 ) {}
+
+    memo = (struct PJ_TP_MEMO_s *) pj_malloc( sizeof(struct PJ_TP_MEMO_s) );
+    if( memo == NULL )
+        return 0;
+    memset( memo, 0, sizeof(struct PJ_TP_MEMO_s) );
+    memo->mask = slot_count - 1;
+    memo->idle_run = PJ_TP_MEMO_WINDOW / 2;
+    memo->slots = (PJ_TP_MEMO_SLOT *) 
+        pj_malloc( sizeof(PJ_TP_MEMO_SLOT) * slot_count );
+    memo->lock = pj_mutex_create( PJ_LOCK_BATCH );
+    if( memo->slots == NULL || memo->lock == NULL )
+    {
+        if( memo->lock != NULL )
+            pj_mutex_destroy( memo->lock );
+        pj_dalloc( memo->slots );
+        pj_dalloc( memo );
+        return 0;
+    }
+    memset( memo->slots, 0, sizeof(PJ_TP_MEMO_SLOT) * slot_count );
+
+    plan->memo = memo;
+    return 1;
+}
+
+/************************************************************************/
+/*                          pj_tp_memo_clear()                          */
+/************************************************************************/
+
+static void pj_tp_memo_clear( struct PJ_TP_MEMO_s *memo )
+
+{
+    pj_mutex_lock( memo->lock );
+    memset( memo->slots, 0, sizeof(PJ_TP_MEMO_SLOT) * (memo->mask + 1) );
+    pj_mutex_unlock( memo->lock );
+}
+
+/************************************************************************/
+/*                         pj_tp_memo_slot()                            */
+/*                                                                      */
+/*      The slot of a point, hashed from the words of its coordinates   */
+/*      as MurmurHash3 does.                                            */
+/************************************************************************/
+
+static PJ_TP_MEMO_SLOT *pj_tp_memo_slot( struct PJ_TP_MEMO_s *memo,
+                                         const double *in )
+
+{
+    unsigned int words[6], h = 0x9747b28cU;
+    int          i;
+
+    memcpy( words, in, sizeof(words) );
+    for( i = 0; i < 6; i++ )
+    {
+        unsigned int k = words[i] * 0xcc9e2d51U;
+
+        k = (k << 15) | (k >> 17);
+        h ^= k * 0x1b873593U;
+        h = ((h << 13) | (h >> 19)) * 5 + 0xe6546b64U;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+
+    return memo->slots + (h & memo->mask);
+}
+
+/************************************************************************/
+/*                         pj_tp_memo_decide()                          */
+/*                                                                      */
+/*      At the end of a window, keep the memo going if its hits saved   */
+/*      more than its lookups cost, or else leave it idle.              */
+/************************************************************************/
+
+static void pj_tp_memo_decide( struct PJ_TP_MEMO_s *memo )
+
+{
+    long misses = memo->lookups - memo->hits;
+    double saved;
+
+    if( memo->lookups < PJ_TP_MEMO_WINDOW )
+        return;
+
+    saved = misses > 0 ? memo->hits * (memo->miss_ns / misses) : 1.0;
+    if( saved > memo->memo_ns )
+        memo->idle_run = PJ_TP_MEMO_WINDOW / 2;
+    else
+    {
+        memo->idle_run = memo->idle_run < PJ_TP_MEMO_MAX_IDLE / 2
+            ? memo->idle_run * 2 : PJ_TP_MEMO_MAX_IDLE;
+        memo->idle = memo->idle_run;
+    }
+
+    memo->lookups = memo->hits = 0;
+    memo->memo_ns = memo->miss_ns = 0.0;
+}
+
+/************************************************************************/
+/*                         pj_tp_execute_memo()                         */
+/*                                                                      */
+/*      pj_tp_execute_chunks() through the memo of the plan, if it has  */
+/*      one.  The points are looked up first, a point met earlier in    */
+/*      the batch being taken from that one, the points missed are      */
+/*      run together, and their outputs are then kept.  Only points     */
+/*      carried through without error are kept, and those of batches    */
+/*      with a status and without are kept apart, as these fail         */
+/*      points differently.  Points with a status set already are       */
+/*      left to pj_tp_execute_chunks().                                 */
+/************************************************************************/
+
+static int pj_tp_execute_memo( PJ_TRANSFORM_PLAN *plan,
+                               long point_count, int point_offset,
+                               double *x, double *y, double *z, 
+                               const double *t, int *status )
+
+{
+    struct PJ_TP_MEMO_s *memo = plan->memo;
+    PJ_STATS  *stats = plan->srcdefn->ctx->stats;
+    int       kind = PJ_TP_MEMO_USED | (z != NULL ? PJ_TP_MEMO_Z : 0)
+                     | (status != NULL ? PJ_TP_MEMO_STATUS : 0);
+    double    start, end, miss_ns, *mx, *my, *mz;
+    long      *miss, *copy, miss_count = 0, copy_count = 0, hits = 0, i;
+    int       *mstatus = NULL, err;
+    PJ_TP_MEMO_SLOT **mslot;
+    unsigned long serial;
+
+    if( memo == NULL || t != NULL || point_count == 0 )
+        return pj_tp_execute_chunks( plan, point_count, point_offset, 
+                                     x, y, z, t, status );
+
+    pj_mutex_lock( memo->lock );
+    if( memo->idle > 0 )
+    {
+        memo->idle -= point_count < memo->idle ? point_count : memo->idle;
+        pj_mutex_unlock( memo->lock );
+        if( stats != NULL )
+            stats->stats.memo_bypassed += point_count;
+        return pj_tp_execute_chunks( plan, point_count, point_offset, 
+                                     x, y, z, t, status );
+    }
+    pj_mutex_unlock( memo->lock );
+
+    start = pj_clock_ns();
+
+    /* miss[] and copy[] hold point indices, copy[] followed by the
+       misses the copies are taken from */
+    miss = (long *) pj_malloc( sizeof(long) * point_count * 3 );
+    mx = (double *) pj_malloc( sizeof(double) * point_count * 3 );
+    if( status != NULL )
+        mstatus = (int *) pj_malloc( sizeof(int) * point_count );
+    mslot = (PJ_TP_MEMO_SLOT **) 
+        pj_malloc( sizeof(PJ_TP_MEMO_SLOT *) * point_count );
+    if( miss == NULL || mx == NULL || mslot == NULL
+        || (status != NULL && mstatus == NULL) )
+    {
+        pj_dalloc( miss );
+        pj_dalloc( mx );
+        pj_dalloc( mstatus );
+        pj_dalloc( mslot );
+        return pj_tp_execute_chunks( plan, point_count, point_offset, 
+                                     x, y, z, t, status );
+    }
+    copy = miss + point_count;
+    my = mx + point_count;
+    mz = my + point_count;
+
+/* -------------------------------------------------------------------- */
+/*      Look the points up.                                             */
+/* -------------------------------------------------------------------- */
+    pj_mutex_lock( memo->lock );
+    serial = ++memo->serial;
+    if( serial == 0 )
+        serial = ++memo->serial;
+
+    for( i = 0; i < point_count; i++ )
+    {
+        long   io = i * point_offset;
+        double in[3];
+        PJ_TP_MEMO_SLOT *slot;
+
+        if( status != NULL && status[i] != 0 )
+            continue;
+
+        in[0] = x[io];
+        in[1] = y[io];
+        in[2] = z != NULL ? z[io] : 0.0;
+        slot = pj_tp_memo_slot( memo, in );
+
+        if( slot->kind == kind && memcmp( slot->in, in, sizeof(in) ) == 0
+            && (slot->serial == 0 || slot->serial == serial) )
+        {
+            hits++;
+            if( slot->serial == serial )
+            {
+                copy[copy_count] = i;
+                copy[point_count + copy_count++] = slot->pending;
+                continue;
+            }
+            x[io] = slot->out[0];
+            y[io] = slot->out[1];
+            if( z != NULL )
+                z[io] = slot->out[2];
+            if( status != NULL )
+                status[i] = slot->status;
+            continue;
+        }
+
+        /* the point is to be kept in the slot of a point missed */
+        memcpy( slot->in, in, sizeof(in) );
+        slot->kind = kind;
+        slot->serial = serial;
+        slot->pending = miss_count;
+
+        miss[miss_count] = i;
+        mslot[miss_count] = slot;
+        mx[miss_count] = in[0];
+        my[miss_count] = in[1];
+        mz[miss_count] = in[2];
+        if( mstatus != NULL )
+            mstatus[miss_count] = 0;
+        miss_count++;
+    }
+    pj_mutex_unlock( memo->lock );
+
+/* -------------------------------------------------------------------- */
+/*      Run the misses, and give them and their copies their outputs.   */
+/* -------------------------------------------------------------------- */
+    end = pj_clock_ns();
+    err = pj_tp_execute_chunks( plan, miss_count, 1, mx, my, 
+                                z != NULL ? mz : NULL, NULL, mstatus );
+    miss_ns = pj_clock_ns() - end;
+    start += miss_ns;
+
+    for( i = 0; i < miss_count; i++ )
+    {
+        long io = miss[i] * point_offset;
+
+        x[io] = mx[i];
+        y[io] = my[i];
+        if( z != NULL )
+            z[io] = mz[i];
+        if( status != NULL )
+            status[miss[i]] = mstatus[i];
+    }
+    for( i = 0; i < copy_count; i++ )
+    {
+        long io = copy[i] * point_offset, m = copy[point_count + i];
+
+        x[io] = mx[m];
+        y[io] = my[m];
+        if( z != NULL )
+            z[io] = mz[m];
+        if( status != NULL )
+            status[copy[i]] = mstatus[m];
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Keep the outputs, in the slots still waiting for them.          */
+/* -------------------------------------------------------------------- */
+    pj_mutex_lock( memo->lock );
+    for( i = 0; i < miss_count; i++ )
+    {
+        PJ_TP_MEMO_SLOT *slot = mslot[i];
+
+        if( slot->serial != serial || slot->pending != i )
+            continue;
+
+        if( (status == NULL && err != 0) 
+            || (status != NULL && mstatus[i] != 0) )
+        {
+            slot->kind = 0;
+            slot->serial = 0;
+            continue;
+        }
+        slot->out[0] = mx[i];
+        slot->out[1] = my[i];
+        slot->out[2] = z != NULL ? mz[i] : 0.0;
+        slot->status = 0;
+        slot->serial = 0;
+    }
+
+    memo->lookups += miss_count + hits;
+    memo->hits += hits;
+    memo->miss_ns += miss_ns;
+    memo->memo_ns += pj_clock_ns() - start;
+    pj_tp_memo_decide( memo );
+    pj_mutex_unlock( memo->lock );
+
+    if( stats != NULL )
+    {
+        stats->stats.memo_hits += hits;
+        stats->stats.memo_misses += miss_count;
+    }
+
+    pj_dalloc( miss );
+    pj_dalloc( mx );
+    pj_dalloc( mstatus );
+    pj_dalloc( mslot );
+
+    return err;
+}
 
 /************************************************************************/
-/*                            pj_transform()                            */
+/*                   pj_transform_plan_set_backend()                    */
 /*                                                                      */
-/*      Currently this function doesn't recognise if two projections    */
-/*      are identical (to short circuit reprojection) because it is     */
-/*      difficult to compare PJ structures (since there are some        */
-/*      projection specific components).                                */
+/*      Run the batches of the plan of at least backend->min_points     */
+/*      points through an execution backend, see projPlanBackend.       */
+/*      Smaller batches, batches with dates or with points failed       */
+/*      already, and those the backend gives back run on the CPU as     */
+/*      before.  The backend must outlive the plan.  NULL drops it.     */
+/*      Returns FALSE, the plan staying on the CPU, if the backend      */
+/*      does not handle the pair of the plan.                           */
 /************************************************************************/
 
-int pj_transform( PJ *srcdefn, PJ *dstdefn, long point_count, int point_offset,
-                  double *x, double *y, double *z )
+int pj_transform_plan_set_backend( PJ_TRANSFORM_PLAN *plan, 
+                                   const projPlanBackend *backend )
 
 {
-    long      i;
-    int       err;
+    void      *handle;
 
-    srcdefn->ctx->last_errno = 0;
-    dstdefn->ctx->last_errno = 0;
+    if( plan->backend != NULL )
+    {
+        if( plan->backend->Release != NULL )
+            plan->backend->Release( plan->backend_handle );
+        plan->backend = NULL;
+        plan->backend_handle = NULL;
+    }
+    if( backend == NULL )
+        return 1;
 
-    if( point_offset == 0 )
-        point_offset = 1;
+    if( backend->version < 1 || backend->Prepare == NULL 
+        || backend->Execute == NULL )
+        return 0;
 
-/* -------------------------------------------------------------------- */
-/*      Transform unusual input coordinate axis orientation to          */
-/*      standard form if needed.                                        */
-/* -------------------------------------------------------------------- */
-    if( strcmp(srcdefn->axis,"enu") != 0 )
-    {
-        int err;
+    handle = backend->Prepare( backend->user, plan->srcdefn, plan->dstdefn );
+    if( handle == NULL )
+        return 0;
 
-        err = pj_adjust_axis( srcdefn->ctx, srcdefn->axis, 
-                              0, point_count, point_offset, x, y, z );
-        if( err != 0 )
-            return err;
-    }
+    plan->backend = backend;
+    plan->backend_handle = handle;
+    return 1;
+}
 
-/* -------------------------------------------------------------------- */
-/*      Transform Z to meters if it isn't already.                      */
-/* -------------------------------------------------------------------- */
-    if( srcdefn->vto_meter != 1.0 && z != NULL )
-    {
-        for( i = 0; i < point_count; i++ )
-            z[point_offset*i] *= srcdefn->vto_meter;
-    }
+/************************************************************************/
+/*                        pj_tp_execute_batch()                         */
+/*                                                                      */
+/*      A batch of the plan through its backend, if it takes it, or     */
+/*      else through pj_tp_execute_memo().                              */
+/************************************************************************/
 
-/* -------------------------------------------------------------------- */
-/*      Transform geocentric source coordinates to lat/long.            */
-/* -------------------------------------------------------------------- */
-    if( srcdefn->is_geocent )
+static int pj_tp_execute_batch( PJ_TRANSFORM_PLAN *plan,
+                                long point_count, int point_offset,
+                                double *x, double *y, double *z, 
+                                const double *t, int *status )
+
+{
+    const projPlanBackend *backend = plan->backend;
+    int       err;
+
+    PJ_TRACE2( transform__start, plan, point_count );
+
+    /* the batches from now on use grids updated by pj_deallocate_grids();
+       the memo holds points shifted with those replaced */
+    if( (pj_grid_registry_refresh( plan->srcdefn )
+         | pj_grid_registry_refresh( plan->dstdefn ))
+        && plan->memo != NULL )
+        pj_tp_memo_clear( plan->memo );
+
+    if( backend != NULL && t == NULL && point_count > 0
+        && point_count >= backend->min_points )
     {
-        if( z == NULL )
-        {
-            pj_ctx_set_errno( pj_get_ctx(srcdefn), PJD_ERR_GEOCENTRIC);
-            return PJD_ERR_GEOCENTRIC;
-        }
+        PJ_STATS  *stats = plan->srcdefn->ctx->stats;
+        double    start = stats != NULL ? pj_clock_ns() : 0.0;
+        long      i = 0;
 
-        if( srcdefn->to_meter != 1.0 )
+        if( status != NULL )
+            for( i = 0; i < point_count && status[i] == 0; i++ ) {}
+
+        if( (status == NULL || i == point_count)
+            && backend->Execute( plan->backend_handle, point_count,
+                                 point_offset, x, y, z ) == 0 )
         {
-            for( i = 0; i < point_count; i++ )
+            if( stats != NULL )
             {
-                if( x[point_offset*i] != HUGE_VAL )
-                {
-                    x[point_offset*i] *= srcdefn->to_meter;
-                    y[point_offset*i] *= srcdefn->to_meter;
-                }
+                stats->stats.backend.calls++;
+                stats->stats.backend.points += point_count;
+                stats->stats.backend.nanoseconds += pj_clock_ns() - start;
             }
+            PJ_TRACE2( transform__done, plan, 0 );
+            return 0;
         }
-
-        err = pj_geocentric_to_geodetic( srcdefn->a_orig, srcdefn->es_orig,
-                                         point_count, point_offset, 
-                                         x, y, z );
-        if( err != 0 )
-            return err;
     }
 
-/* -------------------------------------------------------------------- */
-/*      Transform source points to lat/long, if they aren't             */
-/*      already.                                                        */
-/* -------------------------------------------------------------------- */
-    else if( !srcdefn->is_latlong )
-    {
-        if( srcdefn->inv == NULL )
-        {
-            pj_ctx_set_errno( pj_get_ctx(srcdefn), -17 );
-            pj_log( pj_get_ctx(srcdefn), PJ_LOG_ERROR, 
-                    "pj_transform(): source projection not invertable" );
-            return -17;
-        }
+    err = pj_tp_execute_memo( plan, point_count, point_offset, 
+                              x, y, z, t, status );
+    PJ_TRACE2( transform__done, plan, err );
 
-        for( i = 0; i < point_count; i++ )
-        {
-            XY         projected_loc;
-            LP	       geodetic_loc;
+    return err;
+}
 
-            projected_loc.u = x[point_offset*i];
-            projected_loc.v = y[point_offset*i];
+/************************************************************************/
+/*                         pj_tp_execute_plan()                         */
+/*                                                                      */
+/*      pj_tp_execute_batch(), timed into the latencies of the          */
+/*      context when it is instrumented.                                */
+/************************************************************************/
 
-            if( projected_loc.u == HUGE_VAL )
-                continue;
+static int pj_tp_execute_plan( PJ_TRANSFORM_PLAN *plan,
+                               long point_count, int point_offset,
+                               double *x, double *y, double *z, 
+                               const double *t, int *status )
 
-            geodetic_loc = pj_inv( projected_loc, srcdefn );
-            if( srcdefn->ctx->last_errno != 0 )
-            {
-                if( (srcdefn->ctx->last_errno != 33 /*EDOM*/ 
-                     && srcdefn->ctx->last_errno != 34 /*ERANGE*/ )
-                    && (srcdefn->ctx->last_errno > 0 
-                        || srcdefn->ctx->last_errno < -44 || point_count == 1
-                        || transient_error[-srcdefn->ctx->last_errno] == 0 ) )
-                    return srcdefn->ctx->last_errno;
-                else
-                {
-                    geodetic_loc.u = HUGE_VAL;
-                    geodetic_loc.v = HUGE_VAL;
-                }
-            }
+{
+    projCtx   ctx = plan->srcdefn->ctx;
+    double    start;
+    int       err;
 
-            x[point_offset*i] = geodetic_loc.u;
-            y[point_offset*i] = geodetic_loc.v;
-        }
+    if( ctx->stats == NULL )
+        return pj_tp_execute_batch( plan, point_count, point_offset,
+                                    x, y, z, t, status );
+
+    start = pj_clock_ns();
+    err = pj_tp_execute_batch( plan, point_count, point_offset,
+                               x, y, z, t, status );
+
+    if( ctx->stats != NULL )
+    {
+        pj_stats_add_latency( &(ctx->stats->stats.transform_latency),
+                              pj_clock_ns() - start );
+        pj_stats_poll( ctx );
     }
-/* -------------------------------------------------------------------- */
-/*      But if they are already lat long, adjust for the prime          */
-/*      meridian if there is one in effect.                             */
-/* -------------------------------------------------------------------- */
-    if( srcdefn->from_greenwich != 0.0 )
+
+    return err;
+}
+
+/************************************************************************/
+/*                     pj_transform_plan_execute()                      */
+/*                                                                      */
+/*      Run the stages recorded in the plan over the passed points.     */
+/*      Arguments and return value are as for pj_transform().           */
+/************************************************************************/
+
+int pj_transform_plan_execute( PJ_TRANSFORM_PLAN *plan,
+                               long point_count, int point_offset,
+                               double *x, double *y, double *z )
+
+{
+    if( point_offset == 0 )
+        point_offset = 1;
+
+    return pj_tp_execute_plan( plan, point_count, point_offset, 
+                               x, y, z, NULL, NULL );
+}
+
+/************************************************************************/
+/*                    pj_transform_plan_execute_t()                     */
+/*                                                                      */
+/*      As pj_transform_plan_execute(), with the date of each point     */
+/*      in t, in decimal years and at the stride of x.  Grid catalogs   */
+/*      use these dates rather than the +date of the definitions, so    */
+/*      that a time series is transformed in one call.                  */
+/************************************************************************/
+
+int pj_transform_plan_execute_t( PJ_TRANSFORM_PLAN *plan,
+                                 long point_count, int point_offset,
+                                 double *x, double *y, double *z,
+                                 const double *t )
+
+{
+    if( point_offset == 0 )
+        point_offset = 1;
+
+    return pj_tp_execute_plan( plan, point_count, point_offset, 
+                               x, y, z, t, NULL );
+}
+
+/************************************************************************/
+/*                  pj_transform_plan_execute_status()                  */
+/*                                                                      */
+/*      As pj_transform_plan_execute(), but the batch is not stopped    */
+/*      by the error of a point.  status gets one entry per point:      */
+/*      0 where the point was transformed, or else the error code,      */
+/*      the point being set to HUGE_VAL.  Points passed as HUGE_VAL     */
+/*      get -14.  An error of the whole batch, such as a missing        */
+/*      grid, fails every point not failed already.  Returns the        */
+/*      number of failed points, the last error being left in the       */
+/*      context of the source.                                          */
+/************************************************************************/
+
+long pj_transform_plan_execute_status( PJ_TRANSFORM_PLAN *plan,
+                                       long point_count, int point_offset,
+                                       double *x, double *y, double *z,
+                                       int *status )
+
+{
+    return pj_transform_plan_execute_t_status( plan, point_count, 
+                                               point_offset, x, y, z, 
+                                               NULL, status );
+}
+
+/************************************************************************/
+/*                 pj_transform_plan_execute_t_status()                 */
+/*                                                                      */
+/*      As pj_transform_plan_execute_status(), with the dates of the    */
+/*      points as for pj_transform_plan_execute_t().                    */
+/************************************************************************/
+
+long pj_transform_plan_execute_t_status( PJ_TRANSFORM_PLAN *plan,
+                                         long point_count, int point_offset,
+                                         double *x, double *y, double *z,
+                                         const double *t, int *status )
+
+{
+    long      i, failures = 0;
+    int       err, last_error = 0;
+
+    if( point_offset == 0 )
+        point_offset = 1;
+
+    for( i = 0; i < point_count; i++ )
+        status[i] = x[point_offset*i] == HUGE_VAL ? -14 : 0;
+
+    err = pj_tp_execute_plan( plan, point_count, point_offset, 
+                              x, y, z, t, status );
+
+    for( i = 0; i < point_count; i++ )
     {
-        for( i = 0; i < point_count; i++ )
+        if( err != 0 && status[i] == 0 )
+        {
+            status[i] = err;
+            x[point_offset*i] = y[point_offset*i] = HUGE_VAL;
+        }
+        if( status[i] != 0 )
         {
-            if( x[point_offset*i] != HUGE_VAL )
-                x[point_offset*i] += srcdefn->from_greenwich;
+            last_error = status[i];
+            failures++;
         }
     }
 
-/* -------------------------------------------------------------------- */
-/*      Do we need to translate from geoid to ellipsoidal vertical      */
-/*      datum?                                                          */
-/* -------------------------------------------------------------------- */
-    if( srcdefn->has_geoid_vgrids )
+    if( last_error != 0 )
+        pj_ctx_set_errno( plan->srcdefn->ctx, last_error );
+
+    return failures;
+}
+
+/************************************************************************/
+/*                         pj_tp_stage_shared()                         */
+/*                                                                      */
+/*      Does stage i of the plan do the same as in the model, so that   */
+/*      one run of it serves both?  The source stages only depend on    */
+/*      the source, the datum shift also on a destination datum equal   */
+/*      in every value it reads.  Shifts to a destination grid are      */
+/*      not shared, the grid lists being those of each definition.      */
+/************************************************************************/
+
+static int pj_tp_stage_shared( const PJ_TRANSFORM_PLAN *plan,
+                               const PJ_TRANSFORM_PLAN *model, int i )
+
+{
+    PJ        *dst = plan->dstdefn, *mdst = model->dstdefn;
+
+    if( i >= plan->stage_count || i >= model->stage_count
+        || plan->stages[i] != model->stages[i] )
+        return 0;
+
+    switch( plan->stages[i] )
     {
-        if( pj_apply_vgridshift( srcdefn, "sgeoidgrids", 
-                                 &(srcdefn->vgridlist_geoid), 
-                                 &(srcdefn->vgridlist_geoid_count),
-                                 0, point_count, point_offset, x, y, z ) != 0 )
-            return pj_ctx_get_errno(srcdefn->ctx);
+      case PJ_TP_SRC_AXIS:
+      case PJ_TP_SRC_VTO_METER:
+      case PJ_TP_SRC_GEOCENT:
+      case PJ_TP_SRC_SPHMERC_INV:
+      case PJ_TP_SRC_PM:
+      case PJ_TP_SRC_VGRIDS:
+        return 1;
+
+      /* unless a longitude wrap of the destination is folded in */
+      case PJ_TP_SRC_INV:
+        return plan->inv_steps.long_wrap == model->inv_steps.long_wrap
+            && plan->inv_steps.long_wrap_center 
+               == model->inv_steps.long_wrap_center;
+
+      case PJ_TP_DATUM:
+        return dst->cold->datum_type != PJD_GRIDSHIFT
+            && dst->cold->a_orig == mdst->cold->a_orig
+            && dst->cold->es_orig == mdst->cold->es_orig
+            && pj_compare_datums( dst, mdst );
+
+      case PJ_TP_HELMERT:
+        return dst->cold->a_orig == mdst->cold->a_orig
+            && dst->cold->es_orig == mdst->cold->es_orig
+            && memcmp( plan->helmert, model->helmert, 
+                       sizeof(plan->helmert) ) == 0;
     }
-        
-/* -------------------------------------------------------------------- */
-/*      Convert datums if needed, and possible.                         */
-/* -------------------------------------------------------------------- */
-    if( pj_datum_transform( srcdefn, dstdefn, point_count, point_offset, 
-                            x, y, z ) != 0 )
+
+    return 0;
+}
+
+/************************************************************************/
+/*                          pj_tp_copy_points()                         */
+/************************************************************************/
+
+static void pj_tp_copy_points( long point_count, int point_offset,
+                               const double *from, double *to )
+
+{
+    long      i;
+
+    for( i = 0; i < point_count; i++ )
+        to[point_offset*i] = from[point_offset*i];
+}
+
+/************************************************************************/
+/*                        pj_transform_fanout()                         */
+/*                                                                      */
+/*      Transform the same points from srcdefn to each of the           */
+/*      dst_count definitions of dstdefns, the points for dstdefns[i]   */
+/*      going to out_x[i], out_y[i] and out_z[i], at the point_offset   */
+/*      of the input, which is left as it is.  out_z is only used if    */
+/*      z is not NULL, and must then have an array for every            */
+/*      destination.                                                    */
+/*                                                                      */
+/*      The stages the destinations have in common, those of the        */
+/*      source and the datum shift to equal datums, are run once on     */
+/*      the points and the others for each destination.  Returns 0,     */
+/*      or the first error, as pj_transform() would for the             */
+/*      destination, the outputs of this and the later ones being       */
+/*      then undefined.                                                 */
+/************************************************************************/
+
+int pj_transform_fanout( PJ *srcdefn, int dst_count, PJ **dstdefns,
+                         long point_count, int point_offset,
+                         const double *x, const double *y, const double *z,
+                         double **out_x, double **out_y, double **out_z )
+
+{
+    PJ_TRANSFORM_PLAN *plans, part;
+    int       i, shared, err = 0;
+
+    if( dst_count <= 0 )
+        return 0;
+    if( point_offset == 0 )
+        point_offset = 1;
+
+    plans = (PJ_TRANSFORM_PLAN *) 
+        pj_malloc( dst_count * sizeof(PJ_TRANSFORM_PLAN) );
+    if( plans == NULL )
     {
-        if( srcdefn->ctx->last_errno != 0 )
-            return srcdefn->ctx->last_errno;
-        else
-            return dstdefn->ctx->last_errno;
+        pj_ctx_set_errno( srcdefn->ctx, ENOMEM );
+        return ENOMEM;
     }
 
+    for( i = 0; i < dst_count; i++ )
+        pj_transform_plan_init( plans + i, srcdefn, dstdefns[i] );
+
 /* -------------------------------------------------------------------- */
-/*      Do we need to translate from geoid to ellipsoidal vertical      */
-/*      datum?                                                          */
+/*      Find the stages common to all the plans.                        */
 /* -------------------------------------------------------------------- */
-    if( dstdefn->has_geoid_vgrids )
+    for( shared = 0; shared < plans[0].stage_count; shared++ )
     {
-        if( pj_apply_vgridshift( dstdefn, "sgeoidgrids", 
-                                 &(dstdefn->vgridlist_geoid), 
-                                 &(dstdefn->vgridlist_geoid_count),
-                                 1, point_count, point_offset, x, y, z ) != 0 )
-            return dstdefn->ctx->last_errno;
+        for( i = 1; i < dst_count; i++ )
+        {
+            if( !pj_tp_stage_shared( plans + i, plans, shared ) )
+                break;
+        }
+        if( i < dst_count )
+            break;
     }
-        
+
 /* -------------------------------------------------------------------- */
-/*      But if they are staying lat long, adjust for the prime          */
-/*      meridian if there is one in effect.                             */
+/*      Run them in the output of the first destination.                */
 /* -------------------------------------------------------------------- */
-    if( dstdefn->from_greenwich != 0.0 )
+    pj_tp_copy_points( point_count, point_offset, x, out_x[0] );
+    pj_tp_copy_points( point_count, point_offset, y, out_y[0] );
+    if( z != NULL )
+        pj_tp_copy_points( point_count, point_offset, z, out_z[0] );
+
+    if( shared > 0 )
     {
-        for( i = 0; i < point_count; i++ )
-        {
-            if( x[point_offset*i] != HUGE_VAL )
-                x[point_offset*i] -= dstdefn->from_greenwich;
-        }
+        part = plans[0];
+        part.stage_count = shared;
+        err = pj_tp_execute_chunks( &part, point_count, point_offset,
+                                    out_x[0], out_y[0], 
+                                    z != NULL ? out_z[0] : NULL, NULL, NULL );
     }
 
-
 /* -------------------------------------------------------------------- */
-/*      Transform destination latlong to geocentric if required.        */
+/*      Then what is left of each plan, the first one last as its       */
+/*      output holds the points the others start from.                  */
 /* -------------------------------------------------------------------- */
-    if( dstdefn->is_geocent )
+    for( i = 1; i <= dst_count && err == 0; i++ )
     {
-        if( z == NULL )
+        int       id = i % dst_count;
+
+        if( id != 0 )
         {
-            pj_ctx_set_errno( dstdefn->ctx, PJD_ERR_GEOCENTRIC );
-            return PJD_ERR_GEOCENTRIC;
+            pj_tp_copy_points( point_count, point_offset, out_x[0], out_x[id] );
+            pj_tp_copy_points( point_count, point_offset, out_y[0], out_y[id] );
+            if( z != NULL )
+                pj_tp_copy_points( point_count, point_offset, 
+                                   out_z[0], out_z[id] );
         }
 
-        pj_geodetic_to_geocentric( dstdefn->a_orig, dstdefn->es_orig,
-                                   point_count, point_offset, x, y, z );
+        if( plans[id].stage_count == shared )
+            continue;
 
-        if( dstdefn->fr_meter != 1.0 )
-        {
-            for( i = 0; i < point_count; i++ )
-            {
-                if( x[point_offset*i] != HUGE_VAL )
-                {
-                    x[point_offset*i] *= dstdefn->fr_meter;
-                    y[point_offset*i] *= dstdefn->fr_meter;
-                }
-            }
-        }
+        part = plans[id];
+        part.stage_count -= shared;
+        memmove( part.stages, part.stages + shared, 
+                 part.stage_count * sizeof(int) );
+        err = pj_tp_execute_chunks( &part, point_count, point_offset,
+                                    out_x[id], out_y[id],
+                                    z != NULL ? out_z[id] : NULL, NULL, NULL );
     }
 
-/* -------------------------------------------------------------------- */
-/*      Transform destination points to projection coordinates, if      */
-/*      desired.                                                        */
-/* -------------------------------------------------------------------- */
-    else if( !dstdefn->is_latlong )
-    {
-        for( i = 0; i < point_count; i++ )
-        {
-            XY         projected_loc;
-            LP	       geodetic_loc;
+    pj_dalloc( plans );
+
+    return err;
+}
+
+/************************************************************************/
+/*                            pj_transform()                            */
+/*                                                                      */
+/*      Equivalent source and destination definitions (differing at    */
+/*      most in units and axis order) are recognised and reduced to     */
+/*      a scaling pass, or nothing at all.                              */
+/*                                                                      */
+/*      Each call works out the required stages from scratch; callers   */
+/*      transforming many batches between the same pair of coordinate   */
+/*      systems should use pj_transform_plan_create() instead.          */
+/************************************************************************/
+
+int pj_transform( PJ *srcdefn, PJ *dstdefn, long point_count, int point_offset,
+                  double *x, double *y, double *z )
+
+{
+    PJ_TRANSFORM_PLAN plan;
+
+    pj_transform_plan_init( &plan, srcdefn, dstdefn );
+
+    return pj_transform_plan_execute( &plan, point_count, point_offset, 
+                                      x, y, z );
+}
+
+/************************************************************************/
+/*                         pj_transform_status()                        */
+/*                                                                      */
+/*      pj_transform() reporting the error of each point in status,     */
+/*      see pj_transform_plan_execute_status().                         */
+/************************************************************************/
+
+long pj_transform_status( PJ *srcdefn, PJ *dstdefn, 
+                          long point_count, int point_offset,
+                          double *x, double *y, double *z, int *status )
+
+{
+    PJ_TRANSFORM_PLAN plan;
+
+    pj_transform_plan_init( &plan, srcdefn, dstdefn );
+
+    return pj_transform_plan_execute_status( &plan, point_count, point_offset, 
+                                             x, y, z, status );
+}
+
+/************************************************************************/
+/*                        pj_transform_heights()                        */
+/*                                                                      */
+/*      Transform the heights z of points at longitude x and latitude   */
+/*      y, in radians, from the vertical datum and units of srcdefn     */
+/*      to those of dstdefn, see pj_transform_plan_init_vertical().     */
+/*      x and y are left as passed.  Arguments and return value are     */
+/*      otherwise as for pj_transform().                                */
+/************************************************************************/
+
+int pj_transform_heights( PJ *srcdefn, PJ *dstdefn, 
+                          long point_count, int point_offset,
+                          double *x, double *y, double *z )
+
+{
+    PJ_TRANSFORM_PLAN plan;
+
+    pj_transform_plan_init_vertical( &plan, srcdefn, dstdefn );
+
+    return pj_transform_plan_execute( &plan, point_count, point_offset, 
+                                      x, y, z );
+}
+
+/************************************************************************/
+/*                     pj_geodetic_to_geocentric_pt()                   */
+/*                                                                      */
+/*      Same arithmetic as pj_Convert_Geodetic_To_Geocentric(), but     */
+/*      cheap enough to be inlined in the array loops.                  */
+/************************************************************************/
+
+static int pj_geodetic_to_geocentric_pt( const GeocentricInfo *gi,
+                                         double lon, double lat, double h,
+                                         double *X, double *Y, double *Z )
 
-            geodetic_loc.u = x[point_offset*i];
-            geodetic_loc.v = y[point_offset*i];
+{
+    double sin_lat, cos_lat, rn;
 
-            if( geodetic_loc.u == HUGE_VAL )
-                continue;
+    /* tolerate latitudes a rounding error beyond the poles */
+    if( lat < -HALFPI && lat > -1.001 * HALFPI )
+        lat = -HALFPI;
+    else if( lat > HALFPI && lat < 1.001 * HALFPI )
+        lat = HALFPI;
+    else if( lat < -HALFPI || lat > HALFPI )
+        return -14;
 
-            projected_loc = pj_fwd( geodetic_loc, dstdefn );
-            if( dstdefn->ctx->last_errno != 0 )
-            {
-                if( (dstdefn->ctx->last_errno != 33 /*EDOM*/ 
-                     && dstdefn->ctx->last_errno != 34 /*ERANGE*/ )
-                    && (dstdefn->ctx->last_errno > 0 
-                        || dstdefn->ctx->last_errno < -44 || point_count == 1
-                        || transient_error[-dstdefn->ctx->last_errno] == 0 ) )
-                    return dstdefn->ctx->last_errno;
-                else
-                {
-                    projected_loc.u = HUGE_VAL;
-                    projected_loc.v = HUGE_VAL;
-                }
-            }
+    if( lon > PI )
+        lon -= (2*PI);
+    sin_lat = sin(lat);
+    cos_lat = cos(lat);
+    rn = gi->Geocent_a / sqrt(1.0 - gi->Geocent_e2 * sin_lat * sin_lat);
+    *X = (rn + h) * cos_lat * cos(lon);
+    *Y = (rn + h) * cos_lat * sin(lon);
+    *Z = ((rn * (1 - gi->Geocent_e2)) + h) * sin_lat;
 
-            x[point_offset*i] = projected_loc.u;
-            y[point_offset*i] = projected_loc.v;
-        }
-    }
+    return 0;
+}
 
-/* -------------------------------------------------------------------- */
-/*      If a wrapping center other than 0 is provided, rewrap around    */
-/*      the suggested center (for latlong coordinate systems only).     */
-/* -------------------------------------------------------------------- */
-    else if( dstdefn->is_latlong && dstdefn->is_long_wrap_set )
-    {
-        for( i = 0; i < point_count; i++ )
-        {
-            if( x[point_offset*i] == HUGE_VAL )
-                continue;
+/************************************************************************/
+/*                     pj_geocentric_to_geodetic_pt()                   */
+/*                                                                      */
+/*      Uses the closed form solution of Vermeille (2002), "Direct      */
+/*      transformation from geocentric coordinates to geodetic          */
+/*      coordinates", J. Geodesy 76:451-454, rather than iterating.     */
+/*      It only holds outside the evolute of the ellipsoid, so points   */
+/*      within about a*es of the earth centre still go through          */
+/*      pj_Convert_Geocentric_To_Geodetic().                            */
+/************************************************************************/
 
-            while( x[point_offset*i] < dstdefn->long_wrap_center - PI )
-                x[point_offset*i] += TWOPI;
-            while( x[point_offset*i] > dstdefn->long_wrap_center + PI )
-                x[point_offset*i] -= TWOPI;
-        }
-    }
+static void pj_geocentric_to_geodetic_pt( GeocentricInfo *gi,
+                                          double X, double Y, double Z,
+                                          double *lon, double *lat, 
+                                          double *h )
 
-/* -------------------------------------------------------------------- */
-/*      Transform Z from meters if needed.                              */
-/* -------------------------------------------------------------------- */
-    if( dstdefn->vto_meter != 1.0 && z != NULL )
-    {
-        for( i = 0; i < point_count; i++ )
-            z[point_offset*i] *= dstdefn->vfr_meter;
-    }
+{
+    double e2 = gi->Geocent_e2, e4 = e2 * e2;
+    double w2, p, q, r, s, t, u, v, w, k, d, dz;
 
-/* -------------------------------------------------------------------- */
-/*      Transform normalized axes into unusual output coordinate axis   */
-/*      orientation if needed.                                          */
-/* -------------------------------------------------------------------- */
-    if( strcmp(dstdefn->axis,"enu") != 0 )
-    {
-        int err;
+    w2 = X*X + Y*Y;
+    p = w2 / gi->Geocent_a2;
+    q = Z * Z * (1.0 - e2) / gi->Geocent_a2;
+    r = (p + q - e4) / 6.0;
 
-        err = pj_adjust_axis( dstdefn->ctx, dstdefn->axis, 
-                              1, point_count, point_offset, x, y, z );
-        if( err != 0 )
-            return err;
+    if( r <= 0.0 )
+    {
+        pj_Convert_Geocentric_To_Geodetic( gi, X, Y, Z, lat, lon, h );
+        return;
     }
 
-    return 0;
+    s = e4 * p * q / (4.0 * r * r * r);
+    t = pow( 1.0 + s + sqrt(s * (2.0 + s)), 1.0 / 3.0 );
+    u = r * (1.0 + t + 1.0 / t);
+    v = sqrt(u * u + e4 * q);
+    w = e2 * (u + v - q) / (2.0 * v);
+    k = (u + v) / (sqrt(w * w + u + v) + w);
+    d = k * sqrt(w2) / (k + e2);
+    dz = sqrt(d * d + Z * Z);
+
+    *lon = sqrt(w2) / gi->Geocent_a < 1.0e-12 ? 0.0 : atan2(Y, X);
+    *lat = 2.0 * atan2(Z, dz + d);
+    *h = (k + e2 - 1.0) * dz / k;
 }
 
 /************************************************************************/
@@ -379,7 +3474,7 @@ int pj_geodetic_to_geocentric( double a, double es,
 
 {
     double b;
-    int    i;
+    long   i;
     GeocentricInfo gi;
     int ret_errno = 0;
 
@@ -400,8 +3495,8 @@ int pj_geodetic_to_geocentric( double a, double es,
         if( x[io] == HUGE_VAL  )
             continue;
 
-        if( pj_Convert_Geodetic_To_Geocentric( &gi, y[io], x[io], z[io], 
-                                               x+io, y+io, z+io ) != 0 )
+        if( pj_geodetic_to_geocentric_pt( &gi, x[io], y[io], z[io], 
+                                          x+io, y+io, z+io ) != 0 )
         {
             ret_errno = -14;
             x[io] = y[io] = HUGE_VAL;
@@ -413,7 +3508,7 @@ int pj_geodetic_to_geocentric( double a, double es,
 }
 
 /************************************************************************/
-/*                     pj_geodetic_to_geocentric()                      */
+/*                     pj_geocentric_to_geodetic()                      */
 /************************************************************************/
 
 int pj_geocentric_to_geodetic( double a, double es, 
@@ -422,7 +3517,7 @@ int pj_geocentric_to_geodetic( double a, double es,
 
 {
     double b;
-    int    i;
+    long   i;
     GeocentricInfo gi;
 
     if( es == 0.0 )
@@ -442,8 +3537,8 @@ int pj_geocentric_to_geodetic( double a, double es,
         if( x[io] == HUGE_VAL )
             continue;
 
-        pj_Convert_Geocentric_To_Geodetic( &gi, x[io], y[io], z[io], 
-                                           y+io, x+io, z+io );
+        pj_geocentric_to_geodetic_pt( &gi, x[io], y[io], z[io], 
+                                      x+io, y+io, z+io );
     }
 
     return 0;
@@ -459,34 +3554,36 @@ int pj_geocentric_to_geodetic( double a, double es,
 int pj_compare_datums( PJ *srcdefn, PJ *dstdefn )
 
 {
-    if( srcdefn->datum_type != dstdefn->datum_type )
+    PJ_COLD *src = srcdefn->cold, *dst = dstdefn->cold;
+
+    if( src->datum_type != dst->datum_type )
     {
         return 0;
     }
-    else if( srcdefn->a_orig != dstdefn->a_orig 
-             || ABS(srcdefn->es_orig - dstdefn->es_orig) > 0.000000000050 )
+    else if( src->a_orig != dst->a_orig 
+             || ABS(src->es_orig - dst->es_orig) > 0.000000000050 )
     {
         /* the tolerence for es is to ensure that GRS80 and WGS84 are
            considered identical */
         return 0;
     }
-    else if( srcdefn->datum_type == PJD_3PARAM )
+    else if( src->datum_type == PJD_3PARAM )
     {
-        return (srcdefn->datum_params[0] == dstdefn->datum_params[0]
-                && srcdefn->datum_params[1] == dstdefn->datum_params[1]
-                && srcdefn->datum_params[2] == dstdefn->datum_params[2]);
+        return (src->datum_params[0] == dst->datum_params[0]
+                && src->datum_params[1] == dst->datum_params[1]
+                && src->datum_params[2] == dst->datum_params[2]);
     }
-    else if( srcdefn->datum_type == PJD_7PARAM )
+    else if( src->datum_type == PJD_7PARAM )
     {
-        return (srcdefn->datum_params[0] == dstdefn->datum_params[0]
-                && srcdefn->datum_params[1] == dstdefn->datum_params[1]
-                && srcdefn->datum_params[2] == dstdefn->datum_params[2]
-                && srcdefn->datum_params[3] == dstdefn->datum_params[3]
-                && srcdefn->datum_params[4] == dstdefn->datum_params[4]
-                && srcdefn->datum_params[5] == dstdefn->datum_params[5]
-                && srcdefn->datum_params[6] == dstdefn->datum_params[6]);
+        return (src->datum_params[0] == dst->datum_params[0]
+                && src->datum_params[1] == dst->datum_params[1]
+                && src->datum_params[2] == dst->datum_params[2]
+                && src->datum_params[3] == dst->datum_params[3]
+                && src->datum_params[4] == dst->datum_params[4]
+                && src->datum_params[5] == dst->datum_params[5]
+                && src->datum_params[6] == dst->datum_params[6]);
     }
-    else if( srcdefn->datum_type == PJD_GRIDSHIFT )
+    else if( src->datum_type == PJD_GRIDSHIFT )
     {
         return strcmp( pj_param(srcdefn->ctx, srcdefn->params,"snadgrids").s,
                        pj_param(dstdefn->ctx, dstdefn->params,"snadgrids").s ) == 0;
@@ -506,7 +3603,7 @@ int pj_geocentric_to_wgs84( PJ *defn,
 {
     int       i;
 
-    if( defn->datum_type == PJD_3PARAM )
+    if( defn->cold->datum_type == PJD_3PARAM )
     {
         for( i = 0; i < point_count; i++ )
         {
@@ -520,7 +3617,7 @@ int pj_geocentric_to_wgs84( PJ *defn,
             z[io] = z[io] + Dz_BF;
         }
     }
-    else if( defn->datum_type == PJD_7PARAM )
+    else if( defn->cold->datum_type == PJD_7PARAM )
     {
         for( i = 0; i < point_count; i++ )
         {
@@ -554,7 +3651,7 @@ int pj_geocentric_from_wgs84( PJ *defn,
 {
     int       i;
 
-    if( defn->datum_type == PJD_3PARAM )
+    if( defn->cold->datum_type == PJD_3PARAM )
     {
         for( i = 0; i < point_count; i++ )
         {
@@ -568,7 +3665,7 @@ int pj_geocentric_from_wgs84( PJ *defn,
             z[io] = z[io] - Dz_BF;
         }
     }
-    else if( defn->datum_type == PJD_7PARAM )
+    else if( defn->cold->datum_type == PJD_7PARAM )
     {
         for( i = 0; i < point_count; i++ )
         {
@@ -604,223 +3701,486 @@ int pj_datum_transform( PJ *srcdefn, PJ *dstdefn,
                         double *x, double *y, double *z )
 
 {
-    double      src_a, src_es, dst_a, dst_es;
-    int         z_is_temp = FALSE;
-
 /* -------------------------------------------------------------------- */
 /*      We cannot do any meaningful datum transformation if either      */
 /*      the source or destination are of an unknown datum type          */
 /*      (ie. only a +ellps declaration, no +datum).  This is new        */
 /*      behavior for PROJ 4.6.0.                                        */
 /* -------------------------------------------------------------------- */
-    if( srcdefn->datum_type == PJD_UNKNOWN
-        || dstdefn->datum_type == PJD_UNKNOWN )
+    if( srcdefn->cold->datum_type == PJD_UNKNOWN
+        || dstdefn->cold->datum_type == PJD_UNKNOWN )
         return 0;
 
 /* -------------------------------------------------------------------- */
 /*      Short cut if the datums are identical.                          */
 /* -------------------------------------------------------------------- */
-    if( pj_compare_datums( srcdefn, dstdefn ) )
+    if( pj_compare_datums( srcdefn, dstdefn ) 
+        || pj_grid_shifts_cancel( srcdefn, dstdefn ) )
         return 0;
 
-    src_a = srcdefn->a_orig;
-    src_es = srcdefn->es_orig;
+    {
+        double helmert[12];
+
+        if( pj_helmert_compose( srcdefn, dstdefn, helmert ) )
+        {
+            if( pj_helmert_is_identity( srcdefn, dstdefn, helmert ) )
+                return 0;
+            return pj_helmert_transform( srcdefn, dstdefn, helmert, 
+                                         point_count, point_offset, x, y, z );
+        }
+    }
+
+    return pj_datum_transform_core( srcdefn, dstdefn, point_count, 
+                                    point_offset, x, y, z, NULL );
+}
+
+/************************************************************************/
+/*                         pj_helmert_compose()                         */
+/*                                                                      */
+/*      If the datum shift between srcdefn and dstdefn only involves    */
+/*      3/7 parameter (or WGS84) datums, compose the to_wgs84 step of   */
+/*      the source and the from_wgs84 step of the destination into a    */
+/*      single affine transform of geocentric coordinates, stored row   */
+/*      major as m[0..11] = { a11 a12 a13 t1  a21 ... t3 }.             */
+/*      Returns FALSE if the shift needs grids.                         */
+/************************************************************************/
+
+static int pj_helmert_compose( PJ *srcdefn, PJ *dstdefn, double *m )
 
-    dst_a = dstdefn->a_orig;
-    dst_es = dstdefn->es_orig;
+{
+    double s[12], d[12];
+    int    r, c;
+    PJ     *defn;
+
+    if( (srcdefn->cold->datum_type != PJD_3PARAM 
+         && srcdefn->cold->datum_type != PJD_7PARAM
+         && srcdefn->cold->datum_type != PJD_WGS84)
+        || (dstdefn->cold->datum_type != PJD_3PARAM 
+            && dstdefn->cold->datum_type != PJD_7PARAM
+            && dstdefn->cold->datum_type != PJD_WGS84) )
+        return FALSE;
 
 /* -------------------------------------------------------------------- */
-/*      Create a temporary Z array if one is not provided.              */
+/*      Source to WGS84, as in pj_geocentric_to_wgs84().                */
 /* -------------------------------------------------------------------- */
-    if( z == NULL )
+    defn = srcdefn;
+    memset( s, 0, sizeof(s) );
+    s[0] = s[5] = s[10] = 1.0;
+    if( defn->cold->datum_type == PJD_7PARAM )
     {
-        int	bytes = sizeof(double) * point_count * point_offset;
-        z = (double *) pj_malloc(bytes);
-        memset( z, 0, bytes );
-        z_is_temp = TRUE;
+        s[0] = M_BF;        s[1] = -M_BF*Rz_BF; s[2] =  M_BF*Ry_BF;
+        s[4] = M_BF*Rz_BF;  s[5] = M_BF;        s[6] = -M_BF*Rx_BF;
+        s[8] = -M_BF*Ry_BF; s[9] =  M_BF*Rx_BF; s[10] = M_BF;
+    }
+    if( defn->cold->datum_type != PJD_WGS84 )
+    {
+        s[3] = Dx_BF;
+        s[7] = Dy_BF;
+        s[11] = Dz_BF;
     }
-
-#define CHECK_RETURN(defn) {if( defn->ctx->last_errno != 0 && (defn->ctx->last_errno > 0 || transient_error[-defn->ctx->last_errno] == 0) ) { if( z_is_temp ) pj_dalloc(z); return defn->ctx->last_errno; }}
 
 /* -------------------------------------------------------------------- */
-/*	If this datum requires grid shifts, then apply it to geodetic   */
-/*      coordinates.                                                    */
+/*      WGS84 to destination, as in pj_geocentric_from_wgs84().         */
 /* -------------------------------------------------------------------- */
-    if( srcdefn->datum_type == PJD_GRIDSHIFT )
+    defn = dstdefn;
+    memset( d, 0, sizeof(d) );
+    d[0] = d[5] = d[10] = 1.0;
+    if( defn->cold->datum_type == PJD_7PARAM )
     {
-        pj_apply_gridshift_2( srcdefn, 0, point_count, point_offset, x, y, z );
-        CHECK_RETURN(srcdefn);
+        d[0] = 1.0 / M_BF;    d[1] = Rz_BF / M_BF;  d[2] = -Ry_BF / M_BF;
+        d[4] = -Rz_BF / M_BF; d[5] = 1.0 / M_BF;    d[6] = Rx_BF / M_BF;
+        d[8] = Ry_BF / M_BF;  d[9] = -Rx_BF / M_BF; d[10] = 1.0 / M_BF;
+    }
+    if( defn->cold->datum_type != PJD_WGS84 )
+    {
+        d[3] = -(d[0]*Dx_BF + d[1]*Dy_BF + d[2]*Dz_BF);
+        d[7] = -(d[4]*Dx_BF + d[5]*Dy_BF + d[6]*Dz_BF);
+        d[11] = -(d[8]*Dx_BF + d[9]*Dy_BF + d[10]*Dz_BF);
+    }
 
-        src_a = SRS_WGS84_SEMIMAJOR;
-        src_es = SRS_WGS84_ESQUARED;
+/* -------------------------------------------------------------------- */
+/*      m = d * s                                                       */
+/* -------------------------------------------------------------------- */
+    for( r = 0; r < 3; r++ )
+    {
+        for( c = 0; c < 4; c++ )
+            m[r*4+c] = d[r*4+0] * s[c] + d[r*4+1] * s[4+c] 
+                + d[r*4+2] * s[8+c];
+        m[r*4+3] += d[r*4+3];
     }
 
-    if( dstdefn->datum_type == PJD_GRIDSHIFT )
+    return TRUE;
+}
+
+/************************************************************************/
+/*                        pj_helmert_transform()                        */
+/*                                                                      */
+/*      Apply a datum shift composed by pj_helmert_compose() to         */
+/*      geodetic coordinates, going through geocentric coordinates      */
+/*      point by point in a single pass.  z may be NULL, in which       */
+/*      case heights are taken as zero.                                 */
+/************************************************************************/
+
+static int pj_helmert_transform( PJ *srcdefn, PJ *dstdefn, const double *m,
+                                 long point_count, int point_offset,
+                                 double *x, double *y, double *z )
+
+{
+    GeocentricInfo src_gi, dst_gi;
+    long   i;
+
+    if( pj_Set_Geocentric_Parameters( &src_gi, srcdefn->cold->a_orig, 
+                                      srcdefn->cold->a_orig 
+                                      * sqrt(1-srcdefn->cold->es_orig) ) != 0 )
     {
-        dst_a = SRS_WGS84_SEMIMAJOR;
-        dst_es = SRS_WGS84_ESQUARED;
+        pj_ctx_set_errno( srcdefn->ctx, PJD_ERR_GEOCENTRIC );
+        return PJD_ERR_GEOCENTRIC;
+    }
+    if( pj_Set_Geocentric_Parameters( &dst_gi, dstdefn->cold->a_orig, 
+                                      dstdefn->cold->a_orig 
+                                      * sqrt(1-dstdefn->cold->es_orig) ) != 0 )
+    {
+        pj_ctx_set_errno( dstdefn->ctx, PJD_ERR_GEOCENTRIC );
+        return PJD_ERR_GEOCENTRIC;
     }
 
-/* ==================================================================== */
-/*      Do we need to go through geocentric coordinates?                */
-/* ==================================================================== */
-    if( src_es != dst_es || src_a != dst_a
-        || srcdefn->datum_type == PJD_3PARAM 
-        || srcdefn->datum_type == PJD_7PARAM
-        || dstdefn->datum_type == PJD_3PARAM 
-        || dstdefn->datum_type == PJD_7PARAM)
+    for( i = 0; i < point_count; i++ )
     {
+        long io = i * point_offset;
+        double X, Y, Z, h = 0.0;
+
+        if( x[io] == HUGE_VAL )
+            continue;
+
+        if( pj_geodetic_to_geocentric_pt( &src_gi, x[io], y[io],
+                                          z ? z[io] : 0.0, &X, &Y, &Z ) != 0 )
+        {
+            x[io] = y[io] = HUGE_VAL;
+            continue;
+        }
+
+        pj_geocentric_to_geodetic_pt( &dst_gi, 
+                                      m[0]*X + m[1]*Y + m[2]*Z + m[3],
+                                      m[4]*X + m[5]*Y + m[6]*Z + m[7],
+                                      m[8]*X + m[9]*Y + m[10]*Z + m[11],
+                                      x+io, y+io, &h );
+        if( z )
+            z[io] = h;
+    }
+
+    return 0;
+}
+
+#define CHECK_RETURN(defn) {if( defn->ctx->last_errno != 0 && (defn->ctx->last_errno > 0 || transient_error[-defn->ctx->last_errno] == 0) ) { return defn->ctx->last_errno; }}
+
+/************************************************************************/
+/*                        pj_datum_geocentric()                         */
+/*                                                                      */
+/*      The datum shift through geocentric coordinates of               */
+/*      pj_datum_transform_core(), between the given ellipsoids.        */
+/************************************************************************/
+
+static int pj_datum_geocentric( PJ *srcdefn, PJ *dstdefn, 
+                                double src_a, double src_es,
+                                double dst_a, double dst_es,
+                                long point_count, int point_offset,
+                                double *x, double *y, double *z )
+
+{
 /* -------------------------------------------------------------------- */
 /*      Convert to geocentric coordinates.                              */
 /* -------------------------------------------------------------------- */
-        srcdefn->ctx->last_errno = 
-            pj_geodetic_to_geocentric( src_a, src_es,
-                                       point_count, point_offset, x, y, z );
-        CHECK_RETURN(srcdefn);
+    srcdefn->ctx->last_errno = 
+        pj_geodetic_to_geocentric( src_a, src_es,
+                                   point_count, point_offset, x, y, z );
+    CHECK_RETURN(srcdefn);
 
 /* -------------------------------------------------------------------- */
 /*      Convert between datums.                                         */
 /* -------------------------------------------------------------------- */
-        if( srcdefn->datum_type == PJD_3PARAM 
-            || srcdefn->datum_type == PJD_7PARAM )
-        {
-            pj_geocentric_to_wgs84( srcdefn, point_count, point_offset,x,y,z);
-            CHECK_RETURN(srcdefn);
-        }
+    if( srcdefn->cold->datum_type == PJD_3PARAM 
+        || srcdefn->cold->datum_type == PJD_7PARAM )
+    {
+        pj_geocentric_to_wgs84( srcdefn, point_count, point_offset,x,y,z);
+        CHECK_RETURN(srcdefn);
+    }
+
+    if( dstdefn->cold->datum_type == PJD_3PARAM 
+        || dstdefn->cold->datum_type == PJD_7PARAM )
+    {
+        pj_geocentric_from_wgs84( dstdefn, point_count,point_offset,x,y,z);
+        CHECK_RETURN(dstdefn);
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Convert back to geodetic coordinates.                           */
+/* -------------------------------------------------------------------- */
+    dstdefn->ctx->last_errno = 
+        pj_geocentric_to_geodetic( dst_a, dst_es,
+                                   point_count, point_offset, x, y, z );
+    CHECK_RETURN(dstdefn);
+
+    return 0;
+}
+
+/************************************************************************/
+/*                       pj_datum_geocentric_2d()                       */
+/*                                                                      */
+/*      pj_datum_geocentric() of points without heights, which are      */
+/*      taken as zero.  Their heights go through a zeroed buffer on     */
+/*      the stack, a chunk of points at a time, rather than a heap      */
+/*      array of all the points.                                        */
+/************************************************************************/
 
-        if( dstdefn->datum_type == PJD_3PARAM 
-            || dstdefn->datum_type == PJD_7PARAM )
+#define PJ_DATUM_Z_CHUNK 1024
+
+static int pj_datum_geocentric_2d( PJ *srcdefn, PJ *dstdefn, 
+                                   double src_a, double src_es,
+                                   double dst_a, double dst_es,
+                                   long point_count, int point_offset,
+                                   double *x, double *y )
+
+{
+    double z[PJ_DATUM_Z_CHUNK];
+    long   chunk = PJ_DATUM_Z_CHUNK / point_offset, base, n;
+    int    src_errno = 0, dst_errno = 0, err = 0;
+
+    if( chunk < 2 )
+    {
+        size_t bytes = sizeof(double) * point_count * point_offset;
+        double *heap_z = (double *) pj_malloc( bytes );
+
+        if( heap_z == NULL )
         {
-            pj_geocentric_from_wgs84( dstdefn, point_count,point_offset,x,y,z);
-            CHECK_RETURN(dstdefn);
+            pj_ctx_set_errno( srcdefn->ctx, ENOMEM );
+            return ENOMEM;
         }
+        memset( heap_z, 0, bytes );
+        err = pj_datum_geocentric( srcdefn, dstdefn, src_a, src_es, 
+                                   dst_a, dst_es, point_count, point_offset,
+                                   x, y, heap_z );
+        pj_dalloc( heap_z );
+        return err;
+    }
+
+    for( base = 0; base < point_count; base += n )
+    {
+        long offset = base * point_offset;
+
+        n = point_count - base > chunk ? chunk : point_count - base;
+
+        /* as one batch, never leave a single point on its own */
+        if( point_count - base - n == 1 )
+            n--;
+
+        memset( z, 0, sizeof(double) * n * point_offset );
+        err = pj_datum_geocentric( srcdefn, dstdefn, src_a, src_es, 
+                                   dst_a, dst_es, n, point_offset,
+                                   x + offset, y + offset, z );
+        if( err != 0 )
+            return err;
+
+        /* keep the transient errors of earlier chunks */
+        if( srcdefn->ctx->last_errno != 0 )
+            src_errno = srcdefn->ctx->last_errno;
+        if( dstdefn->ctx->last_errno != 0 )
+            dst_errno = dstdefn->ctx->last_errno;
+    }
+
+    if( src_errno != 0 )
+        srcdefn->ctx->last_errno = src_errno;
+    if( dst_errno != 0 )
+        dstdefn->ctx->last_errno = dst_errno;
+
+    return 0;
+}
+
+/************************************************************************/
+/*                      pj_datum_transform_core()                       */
+/*                                                                      */
+/*      Do the actual datum shift, once pj_datum_transform() or a       */
+/*      transform plan has established it is required.  t, if not       */
+/*      NULL, holds the dates of the points for grid catalogs.  z may   */
+/*      be NULL, the grid shifts not needing heights.                   */
+/************************************************************************/
+
+static int pj_datum_transform_core( PJ *srcdefn, PJ *dstdefn, 
+                                    long point_count, int point_offset,
+                                    double *x, double *y, double *z,
+                                    const double *t )
+
+{
+    double      src_a, src_es, dst_a, dst_es;
+    int         src_errno = 0;
+
+    src_a = srcdefn->cold->a_orig;
+    src_es = srcdefn->cold->es_orig;
+
+    dst_a = dstdefn->cold->a_orig;
+    dst_es = dstdefn->cold->es_orig;
 
 /* -------------------------------------------------------------------- */
-/*      Convert back to geodetic coordinates.                           */
+/*	If this datum requires grid shifts, then apply it to geodetic   */
+/*      coordinates.                                                    */
 /* -------------------------------------------------------------------- */
-        dstdefn->ctx->last_errno = 
-            pj_geocentric_to_geodetic( dst_a, dst_es,
-                                       point_count, point_offset, x, y, z );
-        CHECK_RETURN(dstdefn);
+    if( srcdefn->cold->datum_type == PJD_GRIDSHIFT )
+    {
+        if( !pj_nadgrids_are_null( srcdefn ) )
+        {
+            pj_apply_gridshift_t( srcdefn, 0, point_count, point_offset, 
+                                  x, y, z, t );
+            CHECK_RETURN(srcdefn);
+            src_errno = srcdefn->ctx->last_errno;
+        }
+
+        src_a = SRS_WGS84_SEMIMAJOR;
+        src_es = SRS_WGS84_ESQUARED;
+    }
+
+    if( dstdefn->cold->datum_type == PJD_GRIDSHIFT )
+    {
+        dst_a = SRS_WGS84_SEMIMAJOR;
+        dst_es = SRS_WGS84_ESQUARED;
+    }
+
+/* ==================================================================== */
+/*      Do we need to go through geocentric coordinates?                */
+/* ==================================================================== */
+    if( src_es != dst_es || src_a != dst_a
+        || srcdefn->cold->datum_type == PJD_3PARAM 
+        || srcdefn->cold->datum_type == PJD_7PARAM
+        || dstdefn->cold->datum_type == PJD_3PARAM 
+        || dstdefn->cold->datum_type == PJD_7PARAM)
+    {
+        int err;
+
+        if( z == NULL )
+            err = pj_datum_geocentric_2d( srcdefn, dstdefn, src_a, src_es,
+                                          dst_a, dst_es, point_count, 
+                                          point_offset, x, y );
+        else
+            err = pj_datum_geocentric( srcdefn, dstdefn, src_a, src_es,
+                                       dst_a, dst_es, point_count, 
+                                       point_offset, x, y, z );
+        if( err != 0 )
+            return err;
     }
 
 /* -------------------------------------------------------------------- */
 /*      Apply grid shift to destination if required.                    */
 /* -------------------------------------------------------------------- */
-    if( dstdefn->datum_type == PJD_GRIDSHIFT )
+    if( dstdefn->cold->datum_type == PJD_GRIDSHIFT 
+        && !pj_nadgrids_are_null( dstdefn ) )
     {
-        pj_apply_gridshift_2( dstdefn, 1, point_count, point_offset, x, y, z );
+        pj_apply_gridshift_t( dstdefn, 1, point_count, point_offset, 
+                              x, y, z, t );
         CHECK_RETURN(dstdefn);
     }
 
-    if( z_is_temp )
-        pj_dalloc( z );
+    /* not lost to the geocentric conversion */
+    if( src_errno != 0 && srcdefn->ctx->last_errno == 0 )
+        srcdefn->ctx->last_errno = src_errno;
 
     return 0;
 }
 
+/************************************************************************/
+/*                          pj_axis_map_init()                          */
+/*                                                                      */
+/*      Compile an axis, to normalize it to "enu" (easting, northing,  */
+/*      up) or to denormalize to it.  Normalizing, the ith coordinate  */
+/*      goes to the one its letter names, the last such winning, and   */
+/*      a coordinate no letter names is left as it is.                 */
+/************************************************************************/
+
+static void pj_axis_map_init( const char *axis, int denormalize_flag,
+                              PJ_AXIS_MAP *map )
+
+{
+    int i_axis;
+
+    for( i_axis = 0; i_axis < 3; i_axis++ )
+    {
+        map->from[i_axis] = i_axis;
+        map->sign[i_axis] = 1.0;
+    }
+
+    for( i_axis = 0; i_axis < 3; i_axis++ )
+    {
+        const char *letter = strchr( "ewnsud", axis[i_axis] );
+        int target;
+
+        if( axis[i_axis] == '\0' || letter == NULL )
+        {
+            map->from[0] = -1;
+            return;
+        }
+
+        target = (int) (letter - "ewnsud") / 2;
+        if( denormalize_flag )
+        {
+            map->from[i_axis] = target;
+            map->sign[i_axis] = (letter - "ewnsud") % 2 ? -1.0 : 1.0;
+        }
+        else
+        {
+            map->from[target] = i_axis;
+            map->sign[target] = (letter - "ewnsud") % 2 ? -1.0 : 1.0;
+        }
+    }
+}
+
 /************************************************************************/
 /*                           pj_adjust_axis()                           */
 /*                                                                      */
-/*      Normalize or de-normalized the x/y/z axes.  The normal form     */
-/*      is "enu" (easting, northing, up).                               */
+/*      Normalize or de-normalized the x/y/z axes, as compiled by       */
+/*      pj_axis_map_init().  Without z, its value is taken as 0, and   */
+/*      is not set.                                                     */
 /************************************************************************/
-static int pj_adjust_axis( projCtx ctx, 
-                           const char *axis, int denormalize_flag,
+static int pj_adjust_axis( projCtx ctx, const PJ_AXIS_MAP *map,
                            long point_count, int point_offset, 
                            double *x, double *y, double *z )
 
 {
-    double x_in, y_in, z_in = 0.0;
-    int i, i_axis;
+    int    fx = map->from[0], fy = map->from[1], fz = map->from[2];
+    double sx = map->sign[0], sy = map->sign[1], sz = map->sign[2];
+    long   i;
 
-    if( !denormalize_flag )
+    if( fx < 0 )
+    {
+        pj_ctx_set_errno( ctx, PJD_ERR_AXIS );
+        return PJD_ERR_AXIS;
+    }
+
+    if( z == NULL )
     {
         for( i = 0; i < point_count; i++ )
         {
-            x_in = x[point_offset*i];
-            y_in = y[point_offset*i];
-            if( z )
-                z_in = z[point_offset*i];
-     
-            for( i_axis = 0; i_axis < 3; i_axis++ )
-            {
-                double value;
+            long   io = point_offset * i;
+            double in[3];
 
-                if( i_axis == 0 )
-                    value = x_in;
-                else if( i_axis == 1 )
-                    value = y_in;
-                else
-                    value = z_in;
-                
-                switch( axis[i_axis] )
-                {
-                  case 'e':
-                    x[point_offset*i] = value; break;
-                  case 'w':
-                    x[point_offset*i] = -value; break;
-                  case 'n':
-                    y[point_offset*i] = value; break;
-                  case 's':
-                    y[point_offset*i] = -value; break;
-                  case 'u':
-                    if( z ) z[point_offset*i] = value; break;
-                  case 'd':
-                    if( z ) z[point_offset*i] = -value; break;
-                  default:
-                    pj_ctx_set_errno( ctx, PJD_ERR_AXIS );
-                    return PJD_ERR_AXIS;
-                }
-            } /* i_axis */
-        } /* i (point) */
+            in[0] = x[io];
+            in[1] = y[io];
+            in[2] = 0.0;
+            x[io] = sx * in[fx];
+            y[io] = sy * in[fy];
+        }
     }
-
-    else /* denormalize */
+    else
     {
         for( i = 0; i < point_count; i++ )
         {
-            x_in = x[point_offset*i];
-            y_in = y[point_offset*i];
-            if( z )
-                z_in = z[point_offset*i];
-     
-            for( i_axis = 0; i_axis < 3; i_axis++ )
-            {
-                double *target;
+            long   io = point_offset * i;
+            double in[3];
 
-                if( i_axis == 2 && z == NULL )
-                    continue;
-
-                if( i_axis == 0 )
-                    target = x;
-                else if( i_axis == 1 )
-                    target = y;
-                else
-                    target = z;
-                
-                switch( axis[i_axis] )
-                {
-                  case 'e':
-                    target[point_offset*i] = x_in; break;
-                  case 'w':
-                    target[point_offset*i] = -x_in; break;
-                  case 'n':
-                    target[point_offset*i] = y_in; break;
-                  case 's':
-                    target[point_offset*i] = -y_in; break;
-                  case 'u':
-                    target[point_offset*i] = z_in; break;
-                  case 'd':
-                    target[point_offset*i] = -z_in; break;
-                  default:
-                    pj_ctx_set_errno( ctx, PJD_ERR_AXIS );
-                    return PJD_ERR_AXIS;
-                }
-            } /* i_axis */
-        } /* i (point) */
+            in[0] = x[io];
+            in[1] = y[io];
+            in[2] = z[io];
+            x[io] = sx * in[fx];
+            y[io] = sy * in[fy];
+            z[io] = sz * in[fz];
+        }
     }
-    
+
     return 0;
 }
-
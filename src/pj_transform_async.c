@@ -0,0 +1,209 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Transformation of batches of points on background threads,
+ *           with a callback when each is done.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <string.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** Each batch runs on a thread of its own, over clones of the definitions
+** of the plan in a scratch context copied from theirs, as the workers of
+** split batches do, so that the caller goes on using its context while
+** the batch waits on grid reads.  Grids are shared through the registry
+** of the context, and tiles are read through its file api, so batches in
+** flight overlap their reads with the work of the others.  The memo and
+** the backend of the plan, if any, are shared with the caller.
+*/
+typedef struct {
+    PJ_TRANSFORM_PLAN plan;     /* over the clones */
+    PJ_TRANSFORM_PLAN *caller_plan;
+    projCtx    ctx;
+    long       point_count;
+    int        point_offset;
+    double     *x, *y, *z;
+    int        *status;
+    void       (*done)(void *user, long result);
+    void       *user;
+    void       *thread;         /* NULL if the batch ran in the caller */
+    long       result;
+} PJ_TRANSFORM_ASYNC;
+
+/************************************************************************/
+/*                          pj_async_release()                          */
+/************************************************************************/
+
+static void pj_async_release( PJ_TRANSFORM_ASYNC *async )
+
+{
+    if( async->plan.dstdefn != NULL
+        && async->plan.dstdefn != async->plan.srcdefn )
+        pj_free( async->plan.dstdefn );
+    if( async->plan.srcdefn != NULL )
+        pj_free( async->plan.srcdefn );
+    if( async->ctx != NULL )
+        pj_ctx_free( async->ctx );
+    pj_dalloc( async );
+}
+
+/************************************************************************/
+/*                            pj_async_run()                            */
+/************************************************************************/
+
+static void pj_async_run( void *arg )
+
+{
+    PJ_TRANSFORM_ASYNC *async = (PJ_TRANSFORM_ASYNC *) arg;
+
+    if( async->status != NULL )
+        async->result = pj_transform_plan_execute_status(
+            &(async->plan), async->point_count, async->point_offset,
+            async->x, async->y, async->z, async->status );
+    else
+        async->result = pj_transform_plan_execute(
+            &(async->plan), async->point_count, async->point_offset,
+            async->x, async->y, async->z );
+
+    if( async->done != NULL )
+        async->done( async->user, async->result );
+}
+
+/************************************************************************/
+/*                  pj_transform_plan_execute_async()                   */
+/*                                                                      */
+/*      Start pj_transform_plan_execute() of the batch, or              */
+/*      pj_transform_plan_execute_status() if status is not NULL, on    */
+/*      another thread, and call done(user, result) on that thread      */
+/*      with what it returned when the batch is transformed.  The       */
+/*      points, and the plan, must stay until then, but the caller      */
+/*      may use the context and definitions of the plan meanwhile.      */
+/*      The result must be passed to pj_transform_async_wait().         */
+/*      Without threads the batch is transformed before returning.      */
+/*      Returns NULL, without calling done, if out of memory.           */
+/************************************************************************/
+
+projTransformAsync
+pj_transform_plan_execute_async( PJ_TRANSFORM_PLAN *plan,
+                                 long point_count, int point_offset,
+                                 double *x, double *y, double *z,
+                                 int *status,
+                                 void (*done)(void *user, long result),
+                                 void *user )
+
+{
+    projCtx   ctx = plan->srcdefn->ctx;
+    PJ_TRANSFORM_ASYNC *async;
+
+    async = (PJ_TRANSFORM_ASYNC *) pj_malloc(sizeof(PJ_TRANSFORM_ASYNC));
+    if( async == NULL )
+    {
+        pj_ctx_set_errno( ctx, -38 );
+        return NULL;
+    }
+    memset( async, 0, sizeof(PJ_TRANSFORM_ASYNC) );
+
+    async->ctx = pj_ctx_alloc();
+    if( async->ctx == NULL )
+    {
+        pj_async_release( async );
+        pj_ctx_set_errno( ctx, -38 );
+        return NULL;
+    }
+    memcpy( async->ctx, ctx, sizeof(projCtx_t) );
+    async->ctx->last_errno = 0;
+    async->ctx->grid_tiles = NULL;
+    async->ctx->grid_tile_count = 0;
+    async->ctx->errno_globals = 0; /* set once by the calling thread */
+    async->ctx->stats = NULL;
+    if( ctx->stats != NULL )
+        pj_ctx_set_stats( async->ctx, 1 );
+
+    memcpy( &(async->plan), plan, sizeof(PJ_TRANSFORM_PLAN) );
+    async->plan.srcdefn = async->plan.dstdefn = NULL;
+    async->plan.srcdefn = pj_clone( async->ctx, plan->srcdefn );
+    if( async->plan.srcdefn != NULL )
+        async->plan.dstdefn = plan->dstdefn == plan->srcdefn
+            ? async->plan.srcdefn : pj_clone( async->ctx, plan->dstdefn );
+    if( async->plan.dstdefn == NULL )
+    {
+        pj_async_release( async );
+        pj_ctx_set_errno( ctx, -38 );
+        return NULL;
+    }
+
+    async->caller_plan = plan;
+    async->point_count = point_count;
+    async->point_offset = point_offset;
+    async->x = x;
+    async->y = y;
+    async->z = z;
+    async->status = status;
+    async->done = done;
+    async->user = user;
+
+    async->thread = pj_thread_start( pj_async_run, async );
+    if( async->thread == NULL )
+        pj_async_run( async );
+
+    return async;
+}
+
+/************************************************************************/
+/*                       pj_transform_async_wait()                      */
+/*                                                                      */
+/*      Wait for a batch to be done and release it, adding its          */
+/*      statistics to the context of the plan, and returning what       */
+/*      the transformation returned, as passed to its callback.         */
+/************************************************************************/
+
+long pj_transform_async_wait( projTransformAsync handle )
+
+{
+    PJ_TRANSFORM_ASYNC *async = (PJ_TRANSFORM_ASYNC *) handle;
+    projCtx   ctx;
+    long      result;
+
+    if( async == NULL )
+        return -38;
+
+    pj_thread_join( async->thread );
+
+    ctx = async->caller_plan->srcdefn->ctx;
+    if( ctx->stats != NULL && async->ctx->stats != NULL )
+        pj_stats_merge( ctx->stats, async->ctx->stats );
+    if( async->ctx->last_errno != 0 )
+        pj_ctx_set_errno( ctx, async->ctx->last_errno );
+
+    result = async->result;
+    pj_async_release( async );
+
+    return result;
+}
@@ -0,0 +1,312 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Transformation of a bounding box, densifying its edges where
+ *           they are curved in the destination coordinate system.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** The edges of the box are followed counterclockwise from xmin,ymin,
+** as a ring of BOUNDS_EDGE_SEGMENTS segments on each edge, densified
+** by pj_transform_line().
+**
+** A geographic destination is in longitude and latitude: segments that
+** jump across the antimeridian give, if it is narrower, an extent with
+** xmin > xmax, and a pole within the box gives the latitude of the pole
+** and all longitudes.
+*/
+#define BOUNDS_EDGE_SEGMENTS  20
+
+typedef struct {
+    int               geographic;   /* extent in longitude and latitude */
+    int               crossing;     /* of the antimeridian seen */
+    int               err;
+    long              count;        /* of transformed points */
+    double            xmin, ymin, xmax, ymax;
+    double            *lons;        /* of the points, if geographic */
+    long              lon_count, lon_alloc;
+} PJ_BOUNDS;
+
+/************************************************************************/
+/*                            bounds_add()                              */
+/*                                                                      */
+/*      Extend the extent by the transformed points.                    */
+/************************************************************************/
+
+static void bounds_add( PJ_BOUNDS *B, long n, const double *x,
+                        const double *y )
+
+{
+    long i;
+
+    for( i = 0; i < n; i++ )
+    {
+        if( x[i] == HUGE_VAL )
+            continue;
+
+        if( B->count++ == 0 )
+        {
+            B->xmin = B->xmax = x[i];
+            B->ymin = B->ymax = y[i];
+        }
+        else
+        {
+            B->xmin = MIN(B->xmin, x[i]);
+            B->xmax = MAX(B->xmax, x[i]);
+            B->ymin = MIN(B->ymin, y[i]);
+            B->ymax = MAX(B->ymax, y[i]);
+        }
+
+        if( !B->geographic )
+            continue;
+
+        if( B->lon_count == B->lon_alloc )
+        {
+            long   alloc = B->lon_alloc * 2 + 1024;
+            double *lons = (double *) pj_malloc( sizeof(double) * alloc );
+
+            if( lons == NULL )
+            {
+                B->err = -38;
+                return;
+            }
+            if( B->lon_count > 0 )
+                memcpy( lons, B->lons, sizeof(double) * B->lon_count );
+            pj_dalloc( B->lons );
+            B->lons = lons;
+            B->lon_alloc = alloc;
+        }
+        B->lons[B->lon_count++] = x[i];
+    }
+}
+
+/************************************************************************/
+/*                           bounds_jumps()                             */
+/*                                                                      */
+/*      Note a segment between two points that crosses the              */
+/*      antimeridian.                                                   */
+/************************************************************************/
+
+static void bounds_jumps( PJ_BOUNDS *B, double x0, double x1 )
+
+{
+    if( B->geographic && x0 != HUGE_VAL && x1 != HUGE_VAL
+        && fabs( x1 - x0 ) > PI )
+        B->crossing = 1;
+}
+
+/************************************************************************/
+/*                          bounds_compare()                            */
+/************************************************************************/
+
+static int bounds_compare( const void *a, const void *b )
+
+{
+    double da = *(const double *) a, db = *(const double *) b;
+
+    return da < db ? -1 : da > db ? 1 : 0;
+}
+
+/************************************************************************/
+/*                          bounds_antimeridian()                       */
+/*                                                                      */
+/*      The longitudes leaving the widest gap out, xmin > xmax if the   */
+/*      gap is not across the antimeridian.                             */
+/************************************************************************/
+
+static void bounds_antimeridian( PJ_BOUNDS *B )
+
+{
+    double gap;
+    long   i, widest = -1;
+
+    qsort( B->lons, B->lon_count, sizeof(double), bounds_compare );
+
+    gap = B->lons[0] + TWOPI - B->lons[B->lon_count-1];
+    for( i = 0; i + 1 < B->lon_count; i++ )
+        if( B->lons[i+1] - B->lons[i] > gap )
+        {
+            gap = B->lons[i+1] - B->lons[i];
+            widest = i;
+        }
+
+    if( widest >= 0 )
+    {
+        B->xmin = B->lons[widest+1];
+        B->xmax = B->lons[widest];
+    }
+}
+
+/************************************************************************/
+/*                         bounds_pole_inside()                         */
+/*                                                                      */
+/*      Is the pole at latitude phi of the geographic destination       */
+/*      within the box of a projected source?  The edges of a           */
+/*      geographic box already reach the poles it has.                  */
+/************************************************************************/
+
+static int bounds_pole_inside( PJ_TRANSFORM_PLAN *plan, double phi,
+                               double xmin, double ymin,
+                               double xmax, double ymax )
+
+{
+    PJ_TRANSFORM_PLAN *inverse;
+    double x[2], y[2];
+    int    inside = 0, err = pj_ctx_get_errno( plan->srcdefn->ctx );
+
+    inverse = pj_transform_plan_create( plan->dstdefn, plan->srcdefn );
+    if( inverse == NULL )
+        return 0;
+
+    x[0] = x[1] = plan->dstdefn->cold->long_wrap_center;
+    y[0] = y[1] = phi;
+    if( pj_transform_plan_execute( inverse, 2, 1, x, y, NULL ) == 0
+        && x[0] != HUGE_VAL )
+    {
+        inside = x[0] >= xmin && x[0] <= xmax
+            && y[0] >= ymin && y[0] <= ymax;
+    }
+
+    pj_transform_plan_free( inverse );
+    pj_ctx_set_errno( plan->srcdefn->ctx, err );
+
+    return inside;
+}
+
+/************************************************************************/
+/*                        pj_transform_bounds()                         */
+/*                                                                      */
+/*      The extent of the box xmin, ymin, xmax, ymax once transformed,  */
+/*      in the units used by pj_transform().  The edges are densified   */
+/*      till bent less than densify_tol, in destination units, or not   */
+/*      beyond 21 points if it is 0.  A geographic source box with      */
+/*      xmin > xmax crosses the antimeridian, and so does a geographic  */
+/*      result with out_xmin > out_xmax.                                */
+/************************************************************************/
+
+int pj_transform_bounds( PJ_TRANSFORM_PLAN *plan,
+                         double xmin, double ymin, double xmax, double ymax,
+                         double densify_tol,
+                         double *out_xmin, double *out_ymin,
+                         double *out_xmax, double *out_ymax )
+
+{
+    PJ_BOUNDS B;
+    double    px[4 * BOUNDS_EDGE_SEGMENTS + 1], py[4 * BOUNDS_EDGE_SEGMENTS + 1];
+    double    *ring_x, *ring_y;
+    long      ring_count, i;
+
+    if( plan->srcdefn->is_latlong && xmin > xmax )
+        xmax += TWOPI;
+
+    memset( &B, 0, sizeof(B) );
+    B.geographic = plan->dstdefn->is_latlong
+        && strcmp( plan->dstdefn->cold->axis, "enu" ) == 0;
+
+/* -------------------------------------------------------------------- */
+/*      Points along the edges, counterclockwise, and back to the       */
+/*      first.                                                          */
+/* -------------------------------------------------------------------- */
+    for( i = 0; i < BOUNDS_EDGE_SEGMENTS; i++ )
+    {
+        double t = (double) i / BOUNDS_EDGE_SEGMENTS;
+
+        px[i] = xmin + t * (xmax - xmin);
+        py[i] = ymin;
+        px[i + BOUNDS_EDGE_SEGMENTS] = xmax;
+        py[i + BOUNDS_EDGE_SEGMENTS] = ymin + t * (ymax - ymin);
+        px[i + 2 * BOUNDS_EDGE_SEGMENTS] = xmax - t * (xmax - xmin);
+        py[i + 2 * BOUNDS_EDGE_SEGMENTS] = ymax;
+        px[i + 3 * BOUNDS_EDGE_SEGMENTS] = xmin;
+        py[i + 3 * BOUNDS_EDGE_SEGMENTS] = ymax - t * (ymax - ymin);
+    }
+    px[4 * BOUNDS_EDGE_SEGMENTS] = px[0];
+    py[4 * BOUNDS_EDGE_SEGMENTS] = py[0];
+
+    B.err = pj_transform_line( plan, 4 * BOUNDS_EDGE_SEGMENTS + 1, px, py,
+                               densify_tol, &ring_count, &ring_x, &ring_y );
+    if( B.err != 0 )
+        return B.err;
+
+    bounds_add( &B, ring_count, ring_x, ring_y );
+    for( i = 0; i + 1 < ring_count; i++ )
+        bounds_jumps( &B, ring_x[i], ring_x[i+1] );
+    pj_dalloc( ring_x );
+    pj_dalloc( ring_y );
+
+    if( B.err == 0 && B.count == 0 )
+        B.err = -14;
+
+/* -------------------------------------------------------------------- */
+/*      Geographic results across the antimeridian or a pole.           */
+/* -------------------------------------------------------------------- */
+    if( B.err == 0 && B.geographic )
+    {
+        int north = 0, south = 0;
+
+        if( !plan->srcdefn->is_latlong )
+        {
+            north = bounds_pole_inside( plan, HALFPI, xmin, ymin, xmax, ymax );
+            south = bounds_pole_inside( plan, -HALFPI, xmin, ymin, xmax, ymax );
+        }
+
+        if( north || south )
+        {
+            B.xmin = plan->dstdefn->cold->long_wrap_center - PI;
+            B.xmax = plan->dstdefn->cold->long_wrap_center + PI;
+            if( north )
+                B.ymax = HALFPI;
+            if( south )
+                B.ymin = -HALFPI;
+        }
+        else if( B.crossing )
+            bounds_antimeridian( &B );
+    }
+
+    pj_dalloc( B.lons );
+
+    if( B.err != 0 )
+    {
+        if( B.err == -38 || B.err == -14 )
+            pj_ctx_set_errno( plan->srcdefn->ctx, B.err );
+        return B.err;
+    }
+
+    *out_xmin = B.xmin;
+    *out_ymin = B.ymin;
+    *out_xmax = B.xmax;
+    *out_ymax = B.ymax;
+
+    return 0;
+}
@@ -0,0 +1,342 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Transformation of coordinates in columns or packed points of
+ *           doubles or floats, through contiguous tiles.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <string.h>
+#include <limits.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** The points are copied a tile at a time into contiguous columns of
+** doubles, transformed there by the plan with a point_offset of 1, and
+** copied out to the destination layout.  Every stage so sees unit
+** strides whatever the layout of the caller, and a tile stays in the
+** cache from the copy in to the copy out.  Doubles transformed in place
+** with one stride for all components are already in a layout the plan
+** takes, and are passed to it directly.  Scaled integers are decoded and
+** encoded in the same copies, so that clouds of them are transformed in
+** one pass over the integers.
+*/
+
+#define COORD_TILE 256
+
+/************************************************************************/
+/*                         pj_coords_columns()                          */
+/*                                                                      */
+/*      Describe coordinates held in separate arrays.  z may be NULL.  */
+/************************************************************************/
+
+void pj_coords_columns( projCoords *coords, int type,
+                        void *x, void *y, void *z )
+
+{
+    coords->type = type;
+    coords->x = x;
+    coords->y = y;
+    coords->z = z;
+    coords->stride_x = coords->stride_y = coords->stride_z = 1;
+    coords->t = NULL;
+    coords->stride_t = 1;
+    pj_coords_scaled( coords, NULL, NULL );
+}
+
+/************************************************************************/
+/*                          pj_coords_packed()                          */
+/*                                                                      */
+/*      Describe points packed as xy, xyz or xyzt, or more generally    */
+/*      dimension values per point of which the first two or three     */
+/*      are x, y and z.  The others are left as they are.  t is not    */
+/*      taken as the date of the points unless the caller sets it.     */
+/************************************************************************/
+
+void pj_coords_packed( projCoords *coords, int type,
+                       void *points, int dimension )
+
+{
+    size_t size = type == PJ_COORD_FLOAT ? sizeof(float)
+        : type == PJ_COORD_INT32 ? sizeof(int) : sizeof(double);
+
+    coords->type = type;
+    coords->x = points;
+    coords->y = (char *) points + size;
+    coords->z = dimension >= 3 ? (char *) points + 2 * size : NULL;
+    coords->stride_x = coords->stride_y = coords->stride_z = dimension;
+    coords->t = NULL;
+    coords->stride_t = dimension;
+    pj_coords_scaled( coords, NULL, NULL );
+}
+
+/************************************************************************/
+/*                          pj_coords_scaled()                          */
+/*                                                                      */
+/*      Set the scale and offset of x, y and z of PJ_COORD_INT32        */
+/*      coordinates, 1 and 0 where scale or offset are NULL.            */
+/************************************************************************/
+
+void pj_coords_scaled( projCoords *coords,
+                       const double *scale, const double *offset )
+
+{
+    int i;
+
+    for( i = 0; i < 3; i++ )
+    {
+        coords->scale[i] = scale != NULL ? scale[i] : 1.0;
+        coords->offset[i] = offset != NULL ? offset[i] : 0.0;
+    }
+}
+
+/************************************************************************/
+/*                           pj_coords_get()                            */
+/*                                                                      */
+/*      Copy n values of one component, from point first on, into a    */
+/*      column of doubles.  Integers are scaled by scale and offset.    */
+/************************************************************************/
+
+static void pj_coords_get( int type, const void *base, long stride,
+                           long first, long n, double *out,
+                           double scale, double offset )
+
+{
+    long i;
+
+    if( type == PJ_COORD_INT32 )
+    {
+        const int *in = (const int *) base + first * stride;
+
+        for( i = 0; i < n; i++ )
+            out[i] = in[i * stride] == INT_MIN ? HUGE_VAL
+                : in[i * stride] * scale + offset;
+    }
+    else if( type == PJ_COORD_FLOAT )
+    {
+        const float *in = (const float *) base + first * stride;
+
+        for( i = 0; i < n; i++ )
+            out[i] = in[i * stride];
+    }
+    else
+    {
+        const double *in = (const double *) base + first * stride;
+
+        for( i = 0; i < n; i++ )
+            out[i] = in[i * stride];
+    }
+}
+
+/************************************************************************/
+/*                           pj_coords_put()                            */
+/************************************************************************/
+
+static void pj_coords_put( int type, void *base, long stride,
+                           long first, long n, const double *in,
+                           double scale, double offset )
+
+{
+    long i;
+
+    if( type == PJ_COORD_INT32 )
+    {
+        int *out = (int *) base + first * stride;
+
+        /* rounded to the nearest, values out of range as HUGE_VAL */
+        for( i = 0; i < n; i++ )
+        {
+            double v = floor( (in[i] - offset) / scale + 0.5 );
+
+            out[i * stride] = v > INT_MIN && v <= INT_MAX ? (int) v : INT_MIN;
+        }
+    }
+    else if( type == PJ_COORD_FLOAT )
+    {
+        float *out = (float *) base + first * stride;
+
+        for( i = 0; i < n; i++ )
+            out[i * stride] = (float) in[i];
+    }
+    else
+    {
+        double *out = (double *) base + first * stride;
+
+        for( i = 0; i < n; i++ )
+            out[i * stride] = in[i];
+    }
+}
+
+/************************************************************************/
+/*                          pj_coords_direct()                          */
+/*                                                                      */
+/*      Can the plan run on the values of src itself?                   */
+/************************************************************************/
+
+static int pj_coords_direct( const projCoords *src, const projCoords *dst )
+
+{
+    return src->type == PJ_COORD_DOUBLE && dst->type == PJ_COORD_DOUBLE
+        && src->x == dst->x && src->y == dst->y && src->z == dst->z
+        && src->stride_x == src->stride_y 
+        && (src->z == NULL || src->stride_z == src->stride_x)
+        && src->stride_x == dst->stride_x && src->stride_y == dst->stride_y
+        && (src->z == NULL || src->stride_z == dst->stride_z)
+        && (src->t == NULL || src->stride_t == src->stride_x)
+        && src->stride_x > 0 && src->stride_x <= INT_MAX;
+}
+
+/************************************************************************/
+/*                           pj_coords_tiles()                          */
+/*                                                                      */
+/*      Run the plan over the points a tile at a time.  With status,    */
+/*      as pj_transform_plan_execute_status() and returning the count   */
+/*      of failed points, otherwise as pj_transform_plan_execute()      */
+/*      and stopping at the first tile that fails.                      */
+/************************************************************************/
+
+static long pj_coords_tiles( PJ_TRANSFORM_PLAN *plan, long point_count,
+                             const projCoords *src, const projCoords *dst,
+                             int *status )
+
+{
+    double tx[COORD_TILE], ty[COORD_TILE], tz[COORD_TILE], tt[COORD_TILE];
+    double *z = (src->z != NULL || dst->z != NULL) ? tz : NULL;
+    double *t = src->t != NULL ? tt : NULL;
+    long   base, n, failures = 0;
+    int    last_error = 0;
+
+    if( pj_coords_direct( src, dst ) )
+    {
+        if( status != NULL )
+            return pj_transform_plan_execute_t_status( 
+                plan, point_count, (int) src->stride_x, 
+                (double *) src->x, (double *) src->y, (double *) src->z, 
+                (const double *) src->t, status );
+        return pj_transform_plan_execute_t( 
+            plan, point_count, (int) src->stride_x, 
+            (double *) src->x, (double *) src->y, (double *) src->z,
+            (const double *) src->t );
+    }
+
+    for( base = 0; base < point_count; base += n )
+    {
+        n = point_count - base > COORD_TILE ? COORD_TILE : point_count - base;
+
+        /* errors of a single point fail a batch of one, see
+           pj_transform(), so no tile is of one point but a lone one */
+        if( point_count - base - n == 1 )
+            n--;
+
+        pj_coords_get( src->type, src->x, src->stride_x, base, n, tx,
+                           src->scale[0], src->offset[0] );
+        pj_coords_get( src->type, src->y, src->stride_y, base, n, ty,
+                           src->scale[1], src->offset[1] );
+        if( src->z != NULL )
+            pj_coords_get( src->type, src->z, src->stride_z, base, n, tz,
+                           src->scale[2], src->offset[2] );
+        else if( z != NULL )
+            memset( tz, 0, n * sizeof(double) );
+        if( t != NULL )
+            pj_coords_get( src->type, src->t, src->stride_t, base, n, tt,
+                           1.0, 0.0 );
+
+        if( status != NULL )
+        {
+            long tile_failures =
+                pj_transform_plan_execute_t_status( plan, n, 1, tx, ty, z, t,
+                                                    status + base );
+            if( tile_failures > 0 )
+            {
+                failures += tile_failures;
+                last_error = pj_ctx_get_errno( plan->srcdefn->ctx );
+            }
+        }
+        else
+        {
+            int err = pj_transform_plan_execute_t( plan, n, 1, tx, ty, z, t );
+
+            if( err != 0 )
+                return err;
+        }
+
+        pj_coords_put( dst->type, dst->x, dst->stride_x, base, n, tx,
+                           dst->scale[0], dst->offset[0] );
+        pj_coords_put( dst->type, dst->y, dst->stride_y, base, n, ty,
+                           dst->scale[1], dst->offset[1] );
+        if( dst->z != NULL )
+            pj_coords_put( dst->type, dst->z, dst->stride_z, base, n, tz,
+                           dst->scale[2], dst->offset[2] );
+    }
+
+    if( status != NULL )
+    {
+        pj_ctx_set_errno( plan->srcdefn->ctx, last_error );
+        return failures;
+    }
+
+    return 0;
+}
+
+/************************************************************************/
+/*                  pj_transform_plan_execute_coords()                  */
+/*                                                                      */
+/*      As pj_transform_plan_execute(), with the points read from src   */
+/*      and written to dst, in any layout and in doubles, floats or     */
+/*      scaled integers.                                                */
+/*      dst may describe the same values as src, for an in place        */
+/*      transformation, but must not overlap them otherwise.  If src    */
+/*      has no z, the points are at height 0, as with a NULL z.  The    */
+/*      dates of src, if any, go to pj_transform_plan_execute_t().      */
+/************************************************************************/
+
+int pj_transform_plan_execute_coords( PJ_TRANSFORM_PLAN *plan,
+                                      long point_count,
+                                      const projCoords *src,
+                                      const projCoords *dst )
+
+{
+    return (int) pj_coords_tiles( plan, point_count, src, dst, NULL );
+}
+
+/************************************************************************/
+/*              pj_transform_plan_execute_coords_status()               */
+/*                                                                      */
+/*      As pj_transform_plan_execute_status(), with the points in the   */
+/*      layouts of pj_transform_plan_execute_coords().                  */
+/************************************************************************/
+
+long pj_transform_plan_execute_coords_status( PJ_TRANSFORM_PLAN *plan,
+                                              long point_count,
+                                              const projCoords *src,
+                                              const projCoords *dst,
+                                              int *status )
+
+{
+    return pj_coords_tiles( plan, point_count, src, dst, status );
+}
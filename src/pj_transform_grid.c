@@ -0,0 +1,453 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Transformation of a regular grid of points, interpolating
+ *           between exactly transformed points within an error bound.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <string.h>
+#include <math.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** A lattice of every GRID_STEP points is transformed exactly, through
+** pj_transform_plan_execute().  Each cell of the lattice is then checked
+** on a 5 by 5 grid of its quarters: if bilinear interpolation of the
+** corners is within the error bound there, the cell is interpolated,
+** otherwise it is split in four, down to blocks small enough to be
+** transformed exactly.  This is the approximate transformer of GDAL,
+** done in both directions.
+**
+** Exactly transformed points are flagged, so that a cell interpolating
+** its edge leaves alone the points of a neighbour which was split.
+**
+** A plan that is separable, as between cylindrical projections and
+** geographic coordinates, needs no lattice: one column and one row of
+** the grid are transformed exactly and every point is made of them.
+*/
+#define GRID_STEP         32
+#define GRID_EXACT_BLOCK  64
+
+/* next lattice index after i, the last being n - 1, then n */
+#define GRID_NEXT(i, n) \
+    ((i) == (n) - 1 ? (n) : MIN((i) + GRID_STEP, (n) - 1))
+
+typedef struct {
+    PJ_TRANSFORM_PLAN *plan;
+    double            x0, dx, y0, dy;
+    long              nx;
+    double            *out_x, *out_y;
+    unsigned char     *exact;
+    double            max_error;
+    int               err;
+} PJ_GRID_WARP;
+
+/************************************************************************/
+/*                             grid_exact()                             */
+/*                                                                      */
+/*      Transform n points in place, failed points being set to         */
+/*      HUGE_VAL.  Only errors that fail the whole transformation are   */
+/*      kept.                                                           */
+/************************************************************************/
+
+static void grid_exact( PJ_GRID_WARP *W, long n, double *x, double *y )
+
+{
+    int err;
+
+    if( n < 1 || W->err != 0 )
+        return;
+
+    /* a single point fails the transformation on any error */
+    if( n == 1 )
+    {
+        double px[2], py[2];
+
+        px[0] = px[1] = *x;
+        py[0] = py[1] = *y;
+        grid_exact( W, 2, px, py );
+        *x = px[0];
+        *y = py[0];
+        return;
+    }
+
+    err = pj_transform_plan_execute( W->plan, n, 1, x, y, NULL );
+    if( err != 0 )
+        W->err = err;
+}
+
+/************************************************************************/
+/*                          grid_exact_block()                          */
+/*                                                                      */
+/*      Transform all points of a block that are not already done.      */
+/************************************************************************/
+
+static void grid_exact_block( PJ_GRID_WARP *W, long i0, long i1,
+                              long j0, long j1 )
+
+{
+    long i, j, start;
+
+    for( j = j0; j <= j1; j++ )
+    {
+        long row = j * W->nx;
+
+        /* runs of points not done yet */
+        for( i = i0; i <= i1; )
+        {
+            if( W->exact != NULL && W->exact[row+i] )
+            {
+                i++;
+                continue;
+            }
+            for( start = i;
+                 i <= i1 && (W->exact == NULL || !W->exact[row+i]); i++ )
+            {
+                W->out_x[row+i] = W->x0 + i * W->dx;
+                W->out_y[row+i] = W->y0 + j * W->dy;
+            }
+            grid_exact( W, i - start, W->out_x + row + start,
+                        W->out_y + row + start );
+            if( W->exact != NULL )
+                memset( W->exact + row + start, 1, i - start );
+        }
+    }
+}
+
+/************************************************************************/
+/*                             grid_block()                             */
+/*                                                                      */
+/*      Fill a block whose corners are transformed.                     */
+/************************************************************************/
+
+static void grid_block( PJ_GRID_WARP *W, long i0, long i1, long j0, long j1 )
+
+{
+    long pi[25], pj[25], ic[5], jc[5], i, j, im, jm;
+    double cx[4], cy[4], px[25], py[25];
+    int count = 0, ok = 1, k;
+
+    if( W->err != 0 )
+        return;
+
+    /* small enough that checking costs more than transforming */
+    if( (i1 - i0 + 1) * (j1 - j0 + 1) <= GRID_EXACT_BLOCK
+        || (i1 - i0 < 4 && j1 - j0 < 4) )
+    {
+        grid_exact_block( W, i0, i1, j0, j1 );
+        return;
+    }
+    im = i1 - i0 < 2 ? i0 : (i0 + i1) / 2;
+    jm = j1 - j0 < 2 ? j0 : (j0 + j1) / 2;
+
+/* -------------------------------------------------------------------- */
+/*      Transform the check points, at quarters so that errors odd      */
+/*      about the middle are seen.  Those at the middle and quarters    */
+/*      are the corners and middles of the quarters if it is split.     */
+/* -------------------------------------------------------------------- */
+    ic[0] = i0;
+    ic[1] = (i0 + im) / 2;
+    ic[2] = im;
+    ic[3] = (im + i1) / 2;
+    ic[4] = i1;
+    jc[0] = j0;
+    jc[1] = (j0 + jm) / 2;
+    jc[2] = jm;
+    jc[3] = (jm + j1) / 2;
+    jc[4] = j1;
+
+    for( k = 0; k < 25; k++ )
+    {
+        long index;
+
+        i = ic[k % 5];
+        j = jc[k / 5];
+        index = j * W->nx + i;
+        if( W->exact[index] )
+            continue;
+        W->exact[index] = 1;
+        pi[count] = i;
+        pj[count] = j;
+        px[count] = W->x0 + i * W->dx;
+        py[count] = W->y0 + j * W->dy;
+        count++;
+    }
+    grid_exact( W, count, px, py );
+    for( k = 0; k < count; k++ )
+    {
+        W->out_x[pj[k] * W->nx + pi[k]] = px[k];
+        W->out_y[pj[k] * W->nx + pi[k]] = py[k];
+    }
+
+    cx[0] = W->out_x[j0 * W->nx + i0];
+    cy[0] = W->out_y[j0 * W->nx + i0];
+    cx[1] = W->out_x[j0 * W->nx + i1];
+    cy[1] = W->out_y[j0 * W->nx + i1];
+    cx[2] = W->out_x[j1 * W->nx + i0];
+    cy[2] = W->out_y[j1 * W->nx + i0];
+    cx[3] = W->out_x[j1 * W->nx + i1];
+    cy[3] = W->out_y[j1 * W->nx + i1];
+
+/* -------------------------------------------------------------------- */
+/*      A block failing everywhere, as off the side of the earth that   */
+/*      is seen, is done at once rather than split down to points.      */
+/* -------------------------------------------------------------------- */
+    for( k = 0; k < 25; k++ )
+        if( W->out_x[jc[k / 5] * W->nx + ic[k % 5]] != HUGE_VAL )
+            break;
+    if( k == 25 )
+    {
+        grid_exact_block( W, i0, i1, j0, j1 );
+        return;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Compare them with the interpolation of the corners.             */
+/* -------------------------------------------------------------------- */
+    for( k = 0; k < 25 && ok; k++ )
+    {
+        double u, v, x, y;
+        long index;
+
+        i = ic[k % 5];
+        j = jc[k / 5];
+        index = j * W->nx + i;
+        u = i1 > i0 ? (double) (i - i0) / (i1 - i0) : 0.0;
+        v = j1 > j0 ? (double) (j - j0) / (j1 - j0) : 0.0;
+        x = (1-v) * ((1-u) * cx[0] + u * cx[1])
+            + v * ((1-u) * cx[2] + u * cx[3]);
+        y = (1-v) * ((1-u) * cy[0] + u * cy[1])
+            + v * ((1-u) * cy[2] + u * cy[3]);
+
+        /* also false for failed points */
+        ok = W->out_x[index] != HUGE_VAL
+            && hypot( x - W->out_x[index], y - W->out_y[index] )
+               <= W->max_error;
+    }
+
+    if( !ok )
+    {
+        /* a side too short to split is kept whole */
+        long ia = im > i0 ? im : i1, ja = jm > j0 ? jm : j1;
+
+        grid_block( W, i0, ia, j0, ja );
+        if( im > i0 )
+            grid_block( W, im, i1, j0, ja );
+        if( jm > j0 )
+        {
+            grid_block( W, i0, ia, jm, j1 );
+            if( im > i0 )
+                grid_block( W, im, i1, jm, j1 );
+        }
+        return;
+    }
+
+    for( j = j0; j <= j1; j++ )
+    {
+        double v = j1 > j0 ? (double) (j - j0) / (j1 - j0) : 0.0;
+        double lx = (1-v) * cx[0] + v * cx[2], ly = (1-v) * cy[0] + v * cy[2];
+        double rx = (1-v) * cx[1] + v * cx[3], ry = (1-v) * cy[1] + v * cy[3];
+        long row = j * W->nx;
+
+        for( i = i0; i <= i1; i++ )
+        {
+            double u = i1 > i0 ? (double) (i - i0) / (i1 - i0) : 0.0;
+
+            if( W->exact[row+i] )
+                continue;
+            W->out_x[row+i] = (1-u) * lx + u * rx;
+            W->out_y[row+i] = (1-u) * ly + u * ry;
+        }
+    }
+}
+
+/************************************************************************/
+/*                           grid_separable()                           */
+/*                                                                      */
+/*      Fill the grid of a separable plan from the points of the        */
+/*      column i = nx / 2 and of a row whose point of that column is    */
+/*      transformed.  Returns FALSE, having done nothing, if there is   */
+/*      no such row or out of memory.                                   */
+/************************************************************************/
+
+static int grid_separable( PJ_GRID_WARP *W, long ny )
+
+{
+    long   nx = W->nx, ic = nx / 2, i, j;
+    double *col_x, *col_y, *row_x, *row_y;
+
+    col_x = (double *) pj_malloc( sizeof(double) * 2 * (ny + nx) );
+    if( col_x == NULL )
+        return 0;
+    col_y = col_x + ny;
+    row_x = col_y + ny;
+    row_y = row_x + nx;
+
+    for( j = 0; j < ny; j++ )
+    {
+        col_x[j] = W->x0 + ic * W->dx;
+        col_y[j] = W->y0 + j * W->dy;
+    }
+    grid_exact( W, ny, col_x, col_y );
+
+    /* a failed point of the column fails its row, unless all fail */
+    for( j = 0; j < ny && col_x[j] == HUGE_VAL; j++ ) {}
+    if( j == ny || W->err != 0 )
+    {
+        pj_dalloc( col_x );
+        return W->err != 0;
+    }
+
+    for( i = 0; i < nx; i++ )
+    {
+        row_x[i] = W->x0 + i * W->dx;
+        row_y[i] = W->y0 + j * W->dy;
+    }
+    grid_exact( W, nx, row_x, row_y );
+
+    for( j = 0; j < ny && W->err == 0; j++ )
+    {
+        double *out_x = W->out_x + j * nx, *out_y = W->out_y + j * nx;
+
+        for( i = 0; i < nx; i++ )
+        {
+            if( col_x[j] == HUGE_VAL || row_x[i] == HUGE_VAL )
+                out_x[i] = out_y[i] = HUGE_VAL;
+            else
+            {
+                out_x[i] = row_x[i];
+                out_y[i] = col_y[j];
+            }
+        }
+    }
+
+    pj_dalloc( col_x );
+    return 1;
+}
+
+/************************************************************************/
+/*                         pj_transform_grid()                          */
+/*                                                                      */
+/*      Transform the nx by ny points x0 + i * dx, y0 + j * dy into     */
+/*      out_x[j * nx + i] and out_y[j * nx + i], in the units used      */
+/*      by pj_transform().  Points are interpolated where that is       */
+/*      within max_error of the exact result, in destination units,     */
+/*      at the points checked.  max_error = 0 transforms all points     */
+/*      exactly.  Points that cannot be transformed get HUGE_VAL.       */
+/************************************************************************/
+
+int pj_transform_grid( PJ_TRANSFORM_PLAN *plan,
+                       double x0, double dx, long nx,
+                       double y0, double dy, long ny,
+                       double *out_x, double *out_y, double max_error )
+
+{
+    PJ_GRID_WARP W;
+    long i, j, i_next, j_prev = 0;
+
+    if( nx <= 0 || ny <= 0 )
+        return 0;
+
+    W.plan = plan;
+    W.x0 = x0;
+    W.dx = dx;
+    W.y0 = y0;
+    W.dy = dy;
+    W.nx = nx;
+    W.out_x = out_x;
+    W.out_y = out_y;
+    W.max_error = max_error;
+    W.exact = NULL;
+    W.err = 0;
+
+    /* exact, whatever max_error is */
+    if( pj_transform_plan_separable( plan ) && grid_separable( &W, ny ) )
+        return W.err;
+
+    if( !(max_error > 0.0) )
+    {
+        grid_exact_block( &W, 0, nx - 1, 0, ny - 1 );
+        return W.err;
+    }
+
+    W.exact = (unsigned char *) pj_malloc( (size_t) nx * ny );
+    if( W.exact == NULL )
+    {
+        pj_ctx_set_errno( plan->srcdefn->ctx, -38 );
+        return -38;
+    }
+    memset( W.exact, 0, (size_t) nx * ny );
+
+/* -------------------------------------------------------------------- */
+/*      Transform the lattice, one row at a time, then fill the cells   */
+/*      between a row and the one before.                               */
+/* -------------------------------------------------------------------- */
+    for( j = 0; j < ny && W.err == 0; j = GRID_NEXT(j, ny) )
+    {
+        long row = j * nx, count = 0;
+
+        for( i = 0; i < nx; i = GRID_NEXT(i, nx) )
+        {
+            out_x[row+count] = x0 + i * dx;
+            out_y[row+count] = y0 + j * dy;
+            count++;
+        }
+        grid_exact( &W, count, out_x + row, out_y + row );
+
+        /* spread out from the start of the row, last first */
+        for( i = (count - 1) * GRID_STEP; count > 0; i -= GRID_STEP )
+        {
+            long at = MIN(i, nx - 1);
+
+            count--;
+            out_x[row+at] = out_x[row+count];
+            out_y[row+at] = out_y[row+count];
+            W.exact[row+at] = 1;
+        }
+
+        for( i = 0; j > 0 && i < nx - 1; i = i_next )
+        {
+            i_next = MIN(i + GRID_STEP, nx - 1);
+            grid_block( &W, i, i_next, j_prev, j );
+        }
+        if( nx == 1 && j > 0 )
+            grid_block( &W, 0, 0, j_prev, j );
+        j_prev = j;
+    }
+    if( ny == 1 )
+        for( i = 0; i < nx - 1; i = i_next )
+        {
+            i_next = MIN(i + GRID_STEP, nx - 1);
+            grid_block( &W, i, i_next, 0, 0 );
+        }
+
+    pj_dalloc( W.exact );
+
+    return W.err;
+}
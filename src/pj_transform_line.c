@@ -0,0 +1,303 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Transformation of lines, densifying them where they are
+ *           curved in the destination coordinate system.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <string.h>
+#include <math.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** Every vertex is transformed, then the middle of each segment in
+** source coordinates.  A segment whose middle is further than the
+** tolerance from the middle of its transformed ends, or which only
+** partly fails, is split in two there, down to LINE_MAX_DEPTH times.
+** All the middles of a pass go through the plan in one batch.
+**
+** Points that are inserted and fail are left out of the result, those
+** of the line are kept as HUGE_VAL.  For a geographic destination the
+** segments go the short way round in longitude, so that a line across
+** the antimeridian is not split for its jump from 180 to -180.
+*/
+#define LINE_MAX_DEPTH  16
+
+typedef struct {
+    double sx, sy;              /* in source coordinates */
+    double x, y;                /* transformed, or HUGE_VAL */
+    char   inserted;
+    char   split;               /* the segment to the next point */
+} PJ_LINE_POINT;
+
+/************************************************************************/
+/*                             line_exact()                             */
+/*                                                                      */
+/*      Transform n points in place as grid_exact() does in             */
+/*      pj_transform_grid.c, failed points being set to HUGE_VAL.       */
+/************************************************************************/
+
+static int line_exact( PJ_TRANSFORM_PLAN *plan, long n, double *x, double *y )
+
+{
+    /* a single point fails the transformation on any error */
+    if( n == 1 )
+    {
+        double px[2], py[2];
+        int    err;
+
+        px[0] = px[1] = *x;
+        py[0] = py[1] = *y;
+        err = line_exact( plan, 2, px, py );
+        *x = px[0];
+        *y = py[0];
+        return err;
+    }
+
+    return n < 1 ? 0 : pj_transform_plan_execute( plan, n, 1, x, y, NULL );
+}
+
+/************************************************************************/
+/*                            line_delta()                              */
+/*                                                                      */
+/*      From a to b, the short way round for longitudes.                */
+/************************************************************************/
+
+static double line_delta( int geographic, double a, double b )
+
+{
+    double d = b - a;
+
+    if( geographic )
+    {
+        if( d > PI )
+            d -= TWOPI;
+        else if( d < -PI )
+            d += TWOPI;
+    }
+
+    return d;
+}
+
+/************************************************************************/
+/*                             line_pass()                              */
+/*                                                                      */
+/*      Split the segments of the line that are marked so.  Returns     */
+/*      the new line, with the segments to split next marked, or the    */
+/*      line as it was on error.                                        */
+/************************************************************************/
+
+static PJ_LINE_POINT *line_pass( PJ_TRANSFORM_PLAN *plan, int geographic,
+                                 PJ_LINE_POINT *line, long *count,
+                                 long split_count, double tol, int *err )
+
+{
+    PJ_LINE_POINT *next;
+    double        *mx, *my;
+    long          i, k, n;
+
+    next = (PJ_LINE_POINT *)
+        pj_malloc( sizeof(PJ_LINE_POINT) * (*count + split_count)
+                   + sizeof(double) * 2 * split_count );
+    if( next == NULL )
+    {
+        *err = -38;
+        return line;
+    }
+    mx = (double *) (next + *count + split_count);
+    my = mx + split_count;
+
+    for( i = 0, k = 0; i < *count; i++ )
+        if( line[i].split )
+        {
+            mx[k] = 0.5 * (line[i].sx + line[i+1].sx);
+            my[k] = 0.5 * (line[i].sy + line[i+1].sy);
+            k++;
+        }
+    *err = line_exact( plan, split_count, mx, my );
+    if( *err != 0 )
+    {
+        pj_dalloc( next );
+        return line;
+    }
+
+    for( i = 0, k = 0, n = 0; i < *count; i++ )
+    {
+        PJ_LINE_POINT *a = line + i, *b = a + 1, *m;
+        int failed;
+
+        next[n] = *a;
+        next[n++].split = 0;
+        if( !a->split )
+            continue;
+
+        m = next + n++;
+        m->sx = 0.5 * (a->sx + b->sx);
+        m->sy = 0.5 * (a->sy + b->sy);
+        m->x = mx[k];
+        m->y = my[k++];
+        m->inserted = 1;
+        m->split = 0;
+
+/* -------------------------------------------------------------------- */
+/*      Are the halves to be split in turn?                             */
+/* -------------------------------------------------------------------- */
+        failed = (a->x == HUGE_VAL) + (b->x == HUGE_VAL) + (m->x == HUGE_VAL);
+        if( failed == 0 )
+        {
+            double ex = 0.5 * line_delta( geographic, a->x, b->x );
+            double ey = 0.5 * (b->y - a->y);
+
+            if( hypot( line_delta( geographic, a->x, m->x ) - ex,
+                       m->y - a->y - ey ) > tol )
+                next[n-2].split = m->split = 1;
+        }
+        else if( failed < 3 )
+        {
+            /* down to where the line leaves the valid area */
+            next[n-2].split = a->x == HUGE_VAL || m->x == HUGE_VAL;
+            m->split = m->x == HUGE_VAL || b->x == HUGE_VAL;
+        }
+    }
+
+    pj_dalloc( line );
+    *count = n;
+
+    return next;
+}
+
+/************************************************************************/
+/*                         pj_transform_line()                          */
+/*                                                                      */
+/*      Transform the line through the point_count points x, y, in      */
+/*      the units used by pj_transform(), inserting points till the     */
+/*      transformed segments are within tol of the line, in             */
+/*      destination units.  tol = 0 transforms the points only.  A      */
+/*      ring is given closed, its first point repeated at the end.      */
+/*                                                                      */
+/*      The out_count points of the result are returned in *out_x      */
+/*      and *out_y, to be freed with pj_dalloc().                       */
+/************************************************************************/
+
+int pj_transform_line( PJ_TRANSFORM_PLAN *plan,
+                       long point_count, const double *x, const double *y,
+                       double tol,
+                       long *out_count, double **out_x, double **out_y )
+
+{
+    PJ_LINE_POINT *line;
+    double        *px, *py;
+    long          count = point_count, i, n;
+    int           geographic, depth, err;
+
+    *out_count = 0;
+    *out_x = *out_y = NULL;
+    if( point_count <= 0 )
+        return 0;
+
+    geographic = plan->dstdefn->is_latlong
+        && strcmp( plan->dstdefn->cold->axis, "enu" ) == 0;
+
+    line = (PJ_LINE_POINT *) pj_malloc( sizeof(PJ_LINE_POINT) * count );
+    px = (double *) pj_malloc( sizeof(double) * 2 * count );
+    if( line == NULL || px == NULL )
+    {
+        pj_dalloc( line );
+        pj_dalloc( px );
+        pj_ctx_set_errno( plan->srcdefn->ctx, -38 );
+        return -38;
+    }
+    py = px + count;
+
+    memcpy( px, x, sizeof(double) * count );
+    memcpy( py, y, sizeof(double) * count );
+    err = line_exact( plan, count, px, py );
+    for( i = 0; i < count; i++ )
+    {
+        line[i].sx = x[i];
+        line[i].sy = y[i];
+        line[i].x = px[i];
+        line[i].y = py[i];
+        line[i].inserted = 0;
+        line[i].split = tol > 0.0 && i + 1 < count;
+    }
+    pj_dalloc( px );
+
+/* -------------------------------------------------------------------- */
+/*      Split segments, one pass for each level.                        */
+/* -------------------------------------------------------------------- */
+    for( depth = 0; depth < LINE_MAX_DEPTH && err == 0; depth++ )
+    {
+        long split_count = 0;
+
+        for( i = 0; i < count; i++ )
+            split_count += line[i].split;
+        if( split_count == 0 )
+            break;
+
+        line = line_pass( plan, geographic, line, &count, split_count,
+                          tol, &err );
+    }
+
+    if( err != 0 )
+    {
+        pj_dalloc( line );
+        if( err == -38 )
+            pj_ctx_set_errno( plan->srcdefn->ctx, err );
+        return err;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      The result, without inserted points that failed.                */
+/* -------------------------------------------------------------------- */
+    *out_x = (double *) pj_malloc( sizeof(double) * count );
+    *out_y = (double *) pj_malloc( sizeof(double) * count );
+    if( *out_x == NULL || *out_y == NULL )
+    {
+        pj_dalloc( line );
+        pj_dalloc( *out_x );
+        pj_dalloc( *out_y );
+        *out_x = *out_y = NULL;
+        pj_ctx_set_errno( plan->srcdefn->ctx, -38 );
+        return -38;
+    }
+
+    for( i = 0, n = 0; i < count; i++ )
+    {
+        if( line[i].inserted && line[i].x == HUGE_VAL )
+            continue;
+        (*out_x)[n] = line[i].x;
+        (*out_y)[n++] = line[i].y;
+    }
+    *out_count = n;
+
+    pj_dalloc( line );
+
+    return 0;
+}
@@ -0,0 +1,383 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  PROJ.4
+ * Purpose:  Tuning of the batch settings of a context to the host, by
+ *           timing representative transformations, kept in a file.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#define PJ_LIB__
+
+#include <projects.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+PJ_CVSID("$Id$");
+
+/*
+** The settings are tuned one after the other, each keeping the best of
+** those before: the array chunk on one thread, then the thread count,
+** the grain and the minimum split of the batches split between them.
+** Each candidate is timed over PJ_TUNE_POINTS points of every plan of
+** tune_plans, the best of PJ_TUNE_RUNS runs, and only replaces the
+** current value when faster by PJ_TUNE_GAIN, so that the noise of the
+** timings does not move settings away from their defaults.
+*/
+#define PJ_TUNE_POINTS      131072
+#define PJ_TUNE_RUNS        3
+#define PJ_TUNE_GAIN        0.97
+#define PJ_TUNE_MAX_THREADS 64
+
+typedef struct {
+    const char *src_def;
+    const char *dst_def;
+    double      lon_min, lon_max, lat_min, lat_max;
+    int         projected;      /* points projected by src first */
+} PJ_TUNE_PLAN;
+
+static const PJ_TUNE_PLAN tune_plans[] = {
+    { "+proj=latlong +datum=WGS84", "+proj=utm +zone=32 +datum=WGS84",
+      6, 12, -60, 60, 0 },
+    { "+proj=latlong +ellps=intl +towgs84=-87,-98,-121",
+      "+proj=lcc +lat_1=44 +lat_2=49 +lat_0=46.5 +lon_0=3 +ellps=GRS80 "
+      "+towgs84=0,0,0", -5, 10, 40, 52, 0 },
+    { "+proj=tmerc +lat_0=49 +lon_0=-2 +k=0.9996012717 +x_0=400000 "
+      "+y_0=-100000 +ellps=airy", "+proj=latlong +ellps=airy",
+      -6, 2, 50, 58, 1 }
+};
+
+#define PJ_TUNE_PLAN_COUNT ((int) (sizeof(tune_plans) / sizeof(PJ_TUNE_PLAN)))
+
+typedef struct {
+    projCtx ctx;
+    projPJ  src[PJ_TUNE_PLAN_COUNT], dst[PJ_TUNE_PLAN_COUNT];
+    double  *x0, *y0;           /* the points of each plan, in turn */
+    double  *x, *y;             /* transformed in place */
+} PJ_TUNE;
+
+/************************************************************************/
+/*                           pj_tune_time()                             */
+/*                                                                      */
+/*      The best time, in nanoseconds, of the plans over their points   */
+/*      in batches of batch points, with the settings of the context.   */
+/************************************************************************/
+
+static double pj_tune_time( PJ_TUNE *tune, long batch )
+
+{
+    double best = 0.0;
+    int run, k;
+
+    for( run = 0; run < PJ_TUNE_RUNS; run++ )
+    {
+        double start, elapsed = 0.0;
+        long base;
+
+        for( k = 0; k < PJ_TUNE_PLAN_COUNT; k++ )
+        {
+            size_t size = sizeof(double) * PJ_TUNE_POINTS;
+
+            memcpy( tune->x, tune->x0 + k * PJ_TUNE_POINTS, size );
+            memcpy( tune->y, tune->y0 + k * PJ_TUNE_POINTS, size );
+
+            start = pj_clock_ns();
+            for( base = 0; base < PJ_TUNE_POINTS; base += batch )
+            {
+                long n = PJ_TUNE_POINTS - base < batch
+                    ? PJ_TUNE_POINTS - base : batch;
+
+                pj_transform( tune->src[k], tune->dst[k], n, 1,
+                              tune->x + base, tune->y + base, NULL );
+            }
+            elapsed += pj_clock_ns() - start;
+        }
+
+        if( run == 0 || elapsed < best )
+            best = elapsed;
+    }
+
+    return best;
+}
+
+/************************************************************************/
+/*                          pj_tune_setup()                             */
+/*                                                                      */
+/*      The definitions of the plans and their points, spread over     */
+/*      their lon/lat boxes.  Returns 0, or the error of the            */
+/*      definitions.                                                    */
+/************************************************************************/
+
+static int pj_tune_setup( PJ_TUNE *tune, projCtx ctx )
+
+{
+    long i;
+    int k, side = 362; /* about PJ_TUNE_POINTS nodes */
+
+    memset( tune, 0, sizeof(PJ_TUNE) );
+    tune->ctx = ctx;
+    tune->x0 = (double *)
+        pj_malloc( sizeof(double) * PJ_TUNE_POINTS
+                   * (2 * PJ_TUNE_PLAN_COUNT + 2) );
+    if( tune->x0 == NULL )
+        return ENOMEM;
+    tune->y0 = tune->x0 + PJ_TUNE_PLAN_COUNT * PJ_TUNE_POINTS;
+    tune->x = tune->y0 + PJ_TUNE_PLAN_COUNT * PJ_TUNE_POINTS;
+    tune->y = tune->x + PJ_TUNE_POINTS;
+
+    for( k = 0; k < PJ_TUNE_PLAN_COUNT; k++ )
+    {
+        const PJ_TUNE_PLAN *plan = tune_plans + k;
+        double *x = tune->x0 + k * PJ_TUNE_POINTS;
+        double *y = tune->y0 + k * PJ_TUNE_POINTS;
+
+        tune->src[k] = pj_init_plus_ctx( ctx, plan->src_def );
+        tune->dst[k] = pj_init_plus_ctx( ctx, plan->dst_def );
+        if( tune->src[k] == NULL || tune->dst[k] == NULL )
+            return ctx->last_errno != 0 ? ctx->last_errno : -1;
+
+        for( i = 0; i < PJ_TUNE_POINTS; i++ )
+        {
+            x[i] = (plan->lon_min + (plan->lon_max - plan->lon_min)
+                    * (i % side + 0.5) / side) * DEG_TO_RAD;
+            y[i] = (plan->lat_min + (plan->lat_max - plan->lat_min)
+                    * ((i / side) % side + 0.5) / side) * DEG_TO_RAD;
+        }
+
+        /* the inverse plans start from projected points */
+        if( plan->projected )
+        {
+            projPJ ll = pj_latlong_from_proj( tune->src[k] );
+
+            if( ll == NULL )
+                return ctx->last_errno != 0 ? ctx->last_errno : -1;
+            pj_transform( ll, tune->src[k], PJ_TUNE_POINTS, 1, x, y, NULL );
+            pj_free( ll );
+        }
+    }
+
+    return 0;
+}
+
+/************************************************************************/
+/*                          pj_tune_cleanup()                           */
+/************************************************************************/
+
+static void pj_tune_cleanup( PJ_TUNE *tune )
+
+{
+    int k;
+
+    for( k = 0; k < PJ_TUNE_PLAN_COUNT; k++ )
+    {
+        if( tune->src[k] != NULL )
+            pj_free( tune->src[k] );
+        if( tune->dst[k] != NULL )
+            pj_free( tune->dst[k] );
+    }
+    pj_dalloc( tune->x0 );
+}
+
+/************************************************************************/
+/*                            pj_ctx_tune()                             */
+/*                                                                      */
+/*      Time the transformations of tune_plans with candidate           */
+/*      threads, batch grains and minimum splits, and array chunks,     */
+/*      set the fastest on ctx, and write them to filename, unless it  */
+/*      is NULL, to be set again by pj_ctx_load_tuning(), or by         */
+/*      PROJ_TUNE_FILE on the default context.  This takes a few        */
+/*      seconds, so is meant to run once for a host, as "projbench -T"  */
+/*      does.  Returns 0, or the error of the definitions or of         */
+/*      writing the file.                                               */
+/************************************************************************/
+
+int pj_ctx_tune( projCtx ctx, const char *filename )
+
+{
+    static const int  chunks[] = { 64, 128, 512, 1024 };
+    static const long grains[] = { 512, 1024, 4096, 8192 };
+    static const long splits[] = { 1024, 2048, 4096, 8192, 32768 };
+    PJ_TUNE tune;
+    double  best, t;
+    int     cpus = pj_cpu_count(), threads, err;
+    size_t  i;
+
+    if( ctx == NULL )
+        ctx = pj_get_default_ctx();
+
+    ctx->threads = 1;
+    ctx->batch_grain = PJ_BATCH_DEFAULT_GRAIN;
+    ctx->batch_min_split = PJ_BATCH_DEFAULT_MIN_SPLIT;
+    ctx->array_chunk = PJ_ARRAY_DEFAULT_CHUNK;
+
+    if( (err = pj_tune_setup( &tune, ctx )) != 0 )
+    {
+        pj_tune_cleanup( &tune );
+        pj_ctx_set_errno( ctx, err );
+        return err;
+    }
+
+    /* the array chunk, on one thread */
+    best = pj_tune_time( &tune, PJ_TUNE_POINTS );
+    for( i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++ )
+    {
+        int previous = ctx->array_chunk;
+
+        ctx->array_chunk = chunks[i];
+        if( (t = pj_tune_time( &tune, PJ_TUNE_POINTS )) < best * PJ_TUNE_GAIN )
+            best = t;
+        else
+            ctx->array_chunk = previous;
+    }
+
+    /* the threads, doubled up to the processors, while it pays */
+    if( cpus > PJ_TUNE_MAX_THREADS )
+        cpus = PJ_TUNE_MAX_THREADS;
+    for( threads = 2; ctx->threads < cpus; threads *= 2 )
+    {
+        int previous = ctx->threads;
+
+        ctx->threads = threads < cpus ? threads : cpus;
+        if( (t = pj_tune_time( &tune, PJ_TUNE_POINTS )) < best * PJ_TUNE_GAIN )
+            best = t;
+        else
+        {
+            ctx->threads = previous;
+            break;
+        }
+    }
+
+    /* how the batches are split between them */
+    if( ctx->threads > 1 )
+    {
+        for( i = 0; i < sizeof(grains) / sizeof(grains[0]); i++ )
+        {
+            long previous = ctx->batch_grain;
+
+            ctx->batch_grain = grains[i];
+            if( (t = pj_tune_time( &tune, PJ_TUNE_POINTS ))
+                < best * PJ_TUNE_GAIN )
+                best = t;
+            else
+                ctx->batch_grain = previous;
+        }
+
+        /* the smallest split worth it, batches of twice it being split */
+        for( i = 0; i < sizeof(splits) / sizeof(splits[0]); i++ )
+        {
+            double single;
+
+            ctx->batch_min_split = splits[i];
+            if( splits[i] < ctx->batch_grain )
+                continue;
+            t = pj_tune_time( &tune, 2 * splits[i] );
+            threads = ctx->threads;
+            ctx->threads = 1;
+            single = pj_tune_time( &tune, 2 * splits[i] );
+            ctx->threads = threads;
+            if( t < single * PJ_TUNE_GAIN )
+                break;
+        }
+        if( i == sizeof(splits) / sizeof(splits[0]) )
+            ctx->batch_min_split = PJ_BATCH_DEFAULT_MIN_SPLIT;
+    }
+
+    pj_tune_cleanup( &tune );
+
+    pj_log( ctx, PJ_LOG_DEBUG_MINOR,
+            "pj_ctx_tune(): %d threads, grain %ld, min split %ld, "
+            "array chunk %d", ctx->threads, ctx->batch_grain,
+            ctx->batch_min_split, ctx->array_chunk );
+
+    if( filename != NULL )
+    {
+        FILE *fp = fopen( filename, "w" );
+
+        if( fp == NULL )
+        {
+            pj_ctx_set_errno( ctx, errno );
+            return errno;
+        }
+        fprintf( fp, "# pj_ctx_tune() on %d processors\n", pj_cpu_count() );
+        fprintf( fp, "threads %d\n", ctx->threads );
+        fprintf( fp, "batch_grain %ld\n", ctx->batch_grain );
+        fprintf( fp, "batch_min_split %ld\n", ctx->batch_min_split );
+        fprintf( fp, "array_chunk %d\n", ctx->array_chunk );
+        if( fclose( fp ) != 0 )
+        {
+            pj_ctx_set_errno( ctx, errno );
+            return errno;
+        }
+    }
+
+    return 0;
+}
+
+/************************************************************************/
+/*                         pj_ctx_load_tuning()                         */
+/*                                                                      */
+/*      Set the settings written by pj_ctx_tune() to filename on ctx.   */
+/*      Each remains overridable with its own pj_ctx_set_ function.     */
+/*      Lines of settings this library does not know are ignored.       */
+/*      Returns 0, or the error opening the file.                       */
+/************************************************************************/
+
+int pj_ctx_load_tuning( projCtx ctx, const char *filename )
+
+{
+    FILE *fp;
+    char line[128], key[64];
+    long value;
+
+    if( ctx == NULL )
+        ctx = pj_get_default_ctx();
+
+    if( (fp = fopen( filename, "r" )) == NULL )
+    {
+        int err = errno != 0 ? errno : ENOENT;
+
+        pj_ctx_set_errno( ctx, err );
+        return err;
+    }
+
+    while( fgets( line, sizeof(line), fp ) != NULL )
+    {
+        if( line[0] == '#'
+            || sscanf( line, "%63s %ld", key, &value ) != 2 || value < 1 )
+            continue;
+
+        if( strcmp(key, "threads") == 0 )
+            pj_ctx_set_threads( ctx, (int) value );
+        else if( strcmp(key, "batch_grain") == 0 )
+            pj_ctx_set_batch_grain( ctx, value );
+        else if( strcmp(key, "batch_min_split") == 0 )
+            pj_ctx_set_batch_min_split( ctx, value );
+        else if( strcmp(key, "array_chunk") == 0 )
+            pj_ctx_set_array_chunk( ctx, (int) value );
+    }
+
+    fclose( fp );
+
+    return 0;
+}
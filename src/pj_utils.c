@@ -31,8 +31,15 @@
 #define PJ_LIB__
 
 #include <projects.h>
+#include <stdio.h>
 #include <string.h>
 #include <math.h>
+#ifdef _WIN32
+#  include <process.h>
+#  define getpid _getpid
+#else
+#  include <unistd.h>
+#endif
 
 /************************************************************************/
 /*                           pj_is_latlong()                            */
@@ -65,7 +72,8 @@ int pj_is_geocent( PJ *pj )
 /*      Return a PJ* definition defining the lat/long coordinate        */
 /*      system on which a projection is based.  If the coordinate       */
 /*      system passed in is latlong, a clone of the same will be        */
-/*      returned.                                                       */
+/*      returned.  The definition is initialized through the            */
+/*      definition cache, see pj_init_plus_cached().                    */
 /************************************************************************/
 
 PJ *pj_latlong_from_proj( PJ *pj_in )
@@ -151,7 +159,8 @@ PJ *pj_latlong_from_proj( PJ *pj_in )
         sprintf( defn+strlen(defn), " +pm=%s", 
                  pj_param(pj_in->ctx,pj_in->params,"spm").s );
 
-    return pj_init_plus_ctx( pj_in->ctx, defn );
+    /* the same few definitions come back for every projection */
+    return pj_init_plus_cached( pj_in->ctx, defn );
 }
 
 /************************************************************************/
@@ -171,3 +180,170 @@ void pj_get_spheroid_defn(projPJ defn, double *major_axis, double *eccentricity_
 	if ( eccentricity_squared )
 		*eccentricity_squared = defn->es;
 };
+
+/************************************************************************/
+/*                             pj_fnv1a()                               */
+/*                                                                      */
+/*      The 32 bit FNV-1a hash of size bytes of data, continuing from   */
+/*      hash, PJ_FNV1A_BASIS for a new one.                             */
+/************************************************************************/
+
+unsigned long pj_fnv1a( unsigned long hash, const void *data, size_t size )
+
+{
+    const unsigned char *c = (const unsigned char *) data;
+
+    while( size-- > 0 )
+        hash = ((hash ^ *c++) * 16777619UL) & 0xffffffffUL;
+
+    return hash;
+}
+
+/************************************************************************/
+/*                            pj_hash_name()                            */
+/*                                                                      */
+/*      Sixteen hexadecimal digits from two FNV-1a hashes of key, to    */
+/*      name the files or segments of a cache by key.                   */
+/************************************************************************/
+
+void pj_hash_name( const char *key, char name[17] )
+
+{
+    size_t size = strlen( key );
+
+    sprintf( name, "%08lx%08lx", pj_fnv1a( PJ_FNV1A_BASIS, key, size ),
+             pj_fnv1a( 84696351UL, key, size ) );
+}
+
+/************************************************************************/
+/*                pj_cache_file_put() / pj_cache_file_get()             */
+/*                                                                      */
+/*      Write or read count items of a cache file, adding their bytes   */
+/*      to its FNV-1a sum, which catches damaged files.                 */
+/************************************************************************/
+
+int pj_cache_file_put( PJ_CACHE_FILE *f, const void *data, size_t size,
+                       size_t count )
+
+{
+    f->sum = pj_fnv1a( f->sum, data, size * count );
+    return fwrite( data, size, count, f->fp ) == count;
+}
+
+int pj_cache_file_get( PJ_CACHE_FILE *f, void *data, size_t size,
+                       size_t count )
+
+{
+    if( fread( data, size, count, f->fp ) != count )
+        return 0;
+    f->sum = pj_fnv1a( f->sum, data, size * count );
+    return 1;
+}
+
+/************************************************************************/
+/*                         pj_cache_file_open()                         */
+/*                                                                      */
+/*      Open a cache file to read it, if it is there.  It starts with   */
+/*      an 8 byte format magic, a native double check value, which      */
+/*      rejects files of another byte order, and the whole key, which   */
+/*      must all be those passed.  Returns FALSE, with nothing left     */
+/*      open, otherwise.                                                */
+/************************************************************************/
+
+int pj_cache_file_open( PJ_CACHE_FILE *f, const char *path,
+                        const char *magic, const char *key )
+
+{
+    char stored_magic[8], *stored;
+    size_t key_length = strlen(key) + 1;
+    double check;
+    int ok;
+
+    if( (f->fp = fopen( path, "rb" )) == NULL )
+        return 0;
+    f->sum = PJ_FNV1A_BASIS;
+
+    stored = (char *) pj_malloc( key_length );
+    ok = stored != NULL
+        && pj_cache_file_get( f, stored_magic, 1, 8 )
+        && memcmp( stored_magic, magic, 8 ) == 0
+        && pj_cache_file_get( f, &check, sizeof(double), 1 ) && check == 1.0
+        && pj_cache_file_get( f, stored, 1, key_length )
+        && memcmp( stored, key, key_length ) == 0;
+    pj_dalloc( stored );
+    if( !ok )
+        fclose( f->fp );
+
+    return ok;
+}
+
+/************************************************************************/
+/*                        pj_cache_file_close()                         */
+/*                                                                      */
+/*      Close a cache file from pj_cache_file_open().  If all was       */
+/*      read well so far, as ok says, the sum that ends the file is     */
+/*      checked.  Returns TRUE if the file is good.                     */
+/************************************************************************/
+
+int pj_cache_file_close( PJ_CACHE_FILE *f, int ok )
+
+{
+    unsigned long sum = f->sum, stored_sum;
+
+    ok = ok && pj_cache_file_get( f, &stored_sum, sizeof(unsigned long), 1 )
+        && stored_sum == sum;
+    fclose( f->fp );
+
+    return ok;
+}
+
+/************************************************************************/
+/*                        pj_cache_file_create()                        */
+/*                                                                      */
+/*      Start writing a cache file for path, with the header read by    */
+/*      pj_cache_file_open().  It goes to a temporary file named from   */
+/*      the process and id, renamed into place by                       */
+/*      pj_cache_file_commit() so that other processes sharing the      */
+/*      directory never read a partial file.                            */
+/************************************************************************/
+
+int pj_cache_file_create( PJ_CACHE_FILE *f, const char *path, const void *id,
+                          const char *magic, const char *key )
+
+{
+    double check = 1.0;
+
+    sprintf( f->tmp, "%s.%lx.%lx.tmp", path, (unsigned long) getpid(),
+             (unsigned long) (size_t) id );
+    f->fp = fopen( f->tmp, "wb" );
+    if( f->fp == NULL )
+        return 0;
+    f->sum = PJ_FNV1A_BASIS;
+
+    return pj_cache_file_put( f, magic, 1, 8 )
+        && pj_cache_file_put( f, &check, sizeof(double), 1 )
+        && pj_cache_file_put( f, key, 1, strlen(key) + 1 );
+}
+
+/************************************************************************/
+/*                        pj_cache_file_commit()                        */
+/*                                                                      */
+/*      End a file from pj_cache_file_create() with its sum and         */
+/*      rename it to path if all was written well, as ok says, or       */
+/*      remove it.                                                      */
+/************************************************************************/
+
+void pj_cache_file_commit( PJ_CACHE_FILE *f, const char *path, int ok )
+
+{
+    unsigned long sum = f->sum;
+
+    ok = ok && pj_cache_file_put( f, &sum, sizeof(unsigned long), 1 );
+    ok = fclose( f->fp ) == 0 && ok;
+#ifdef _WIN32
+    if( ok )
+        remove( path );
+#endif
+    if( !ok || rename( f->tmp, path ) != 0 )
+        remove( f->tmp );
+}
@@ -18,6 +18,8 @@
 /* ! TK 1999-02-13 */
 
 #define MAX_LINE 1000
+#define BATCH_LINES 4096	/* points per pj_fwd_array() call with -j */
+#define BATCH_READ_SIZE 1048576
 #define MAX_PARGS 100
 #define PJ_INVERS(P) (P->inv ? 1 : 0)
 	static PJ
@@ -36,13 +38,14 @@ prescale = 0,	/* != 0 apply cartesian scale factor */
 dofactors = 0,	/* determine scale factors */
 facs_bad = 0,	/* return condition from pj_factors */
 very_verby = 0, /* very verbose mode */
+threads = 0,	/* != 0 process input in batches on this many threads */
 postscale = 0;
 	static char
 *cheby_str,		/* string controlling Chebychev evaluation */
 *oform = (char *)0,	/* output format for x-y or decimal degrees */
 *oterr = "*\t*",	/* output line for unprojectable input */
 *usage =
-"%s\nusage: %s [ -beEfiIlormsStTvVwW [args] ] [ +opts[=arg] ] [ files ]\n";
+"%s\nusage: %s [ -beEfiIjlormsStTvVwW [args] ] [ +opts[=arg] ] [ files ]\n";
 	static struct FACTORS
 facs;
 	static double
@@ -55,6 +58,13 @@ int_proj(projUV data) {
 	if (postscale && data.u != HUGE_VAL)
 		{ data.u *= fscale; data.v *= fscale; }
 	return(data);
+}
+	static void	/* printf() of a single number */
+print_double(const char *format, double value) {
+	char buf[MAX_LINE];
+
+	(void)pj_format_double(buf, format, value);
+	(void)fputs(buf, stdout);
 }
 	static void	/* file processing function */
 process(FILE *fid) {
@@ -108,7 +118,8 @@ process(FILE *fid) {
 				facs_bad = pj_factors(data, Proj, 0., &facs);
 			if (postscale && data.u != HUGE_VAL)
 				{ data.u *= fscale; data.v *= fscale; }
-		}
+		} else
+			facs_bad = 1;
 		if (bin_out) { /* binary output */
 			(void)fwrite(&data, sizeof(projUV), 1, stdout);
 			continue;
@@ -130,11 +141,11 @@ process(FILE *fid) {
 				data.u *= RAD_TO_DEG;
 			}
 			if (reverseout) {
-				(void)printf(oform,data.v); putchar('\t');
-				(void)printf(oform,data.u);
+				print_double(oform,data.v); putchar('\t');
+				print_double(oform,data.u);
 			} else {
-				(void)printf(oform,data.u); putchar('\t');
-				(void)printf(oform,data.v);
+				print_double(oform,data.u); putchar('\t');
+				print_double(oform,data.v);
 			}
 		}
 		if (dofactors) /* print scale factor data */
@@ -148,6 +159,320 @@ process(FILE *fid) {
                 }
 		(void)fputs(bin_in ? "\n" : s, stdout);
 	}
+}
+/*
+** With -j the input is read in large blocks and cut into batches of
+** lines, each parsed, projected with a single pj_fwd_array() or
+** pj_inv_array() call and formatted on a worker thread with its own
+** context and copy of the projection.  The output of the batches is
+** written in input order.
+*/
+	typedef struct {
+	projCtx ctx;
+	PJ *P;
+	void *thread;
+	int line_count;
+	char *text;		/* the lines, each with its newline */
+	size_t text_len, text_size;
+	size_t line_start[BATCH_LINES];
+	char *rest[BATCH_LINES];	/* after the coordinates, NULL for tags */
+	double u[BATCH_LINES], v[BATCH_LINES];
+	int point_line[BATCH_LINES];
+	double x[BATCH_LINES], y[BATCH_LINES];
+	int facs_bad[BATCH_LINES];
+	struct FACTORS facs[BATCH_LINES];
+	char *out;
+	size_t out_len, out_size;
+} BATCH_JOB;
+	typedef struct {
+	FILE *fid;
+	char *buf;
+	size_t len, pos;
+	int eof;
+} BATCH_READER;
+	static BATCH_JOB
+*jobs;
+	static char *
+batch_grow(char *buf, size_t *size, size_t needed) {
+	if (needed <= *size)
+		return buf;
+	while (*size < needed)
+		*size = *size ? *size * 2 : 65536;
+	if ((buf = (char *)realloc(buf, *size)) == NULL)
+		emess(3,"out of memory for batch");
+	return buf;
+}
+	static int	/* next line of a batch, cut as fgets() is in process() */
+batch_read_line(BATCH_READER *reader, BATCH_JOB *job) {
+	size_t kept = 0;
+	int found_newline = 0;
+	char *line;
+
+	job->text = batch_grow(job->text, &job->text_size,
+		job->text_len + MAX_LINE + 2);
+	line = job->text + job->text_len;
+	while (!found_newline) {
+		char *start, *newline;
+		size_t n;
+
+		if (reader->pos == reader->len) {
+			if (reader->eof)
+				break;
+			reader->len = fread(reader->buf, 1, BATCH_READ_SIZE,
+				reader->fid);
+			reader->pos = 0;
+			reader->eof = reader->len < BATCH_READ_SIZE;
+			continue;
+		}
+		start = reader->buf + reader->pos;
+		n = reader->len - reader->pos;
+		if ((newline = (char *)memchr(start, '\n', n)) != NULL) {
+			n = newline - start;
+			found_newline = 1;
+		}
+		reader->pos += n + found_newline;
+		/* overlong lines are cut, as with fgets() */
+		if (n > MAX_LINE - 1 - kept)
+			n = MAX_LINE - 1 - kept;
+		(void)memcpy(line + kept, start, n);
+		kept += n;
+	}
+	if (kept == 0 && !found_newline)
+		return 0;
+	line[kept++] = '\n';
+	line[kept++] = '\0';
+	job->line_start[job->line_count++] = job->text_len;
+	job->text_len += kept;
+	return 1;
+}
+	static void	/* next points of binary input */
+batch_read_binary(FILE *fid, BATCH_JOB *job) {
+	projUV *data;
+	int i;
+
+	job->text = batch_grow(job->text, &job->text_size,
+		BATCH_LINES * sizeof(projUV));
+	data = (projUV *)job->text;
+	job->line_count = (int)fread(data, sizeof(projUV), BATCH_LINES, fid);
+	for (i = 0; i < job->line_count; ++i) {
+		job->u[i] = data[i].u;
+		job->v[i] = data[i].v;
+	}
+}
+	static void
+batch_write(BATCH_JOB *job, const void *data, size_t len) {
+	job->out = batch_grow(job->out, &job->out_size, job->out_len + len);
+	(void)memcpy(job->out + job->out_len, data, len);
+	job->out_len += len;
+}
+	static void
+batch_puts(BATCH_JOB *job, const char *s) {
+	batch_write(job, s, strlen(s));
+}
+	static void
+batch_printf(BATCH_JOB *job, const char *format, double value) {
+	char buf[MAX_LINE];
+
+	batch_write(job, buf, pj_format_double(buf, format, value) - buf);
+}
+	static void	/* parse, project and format a batch as process() does */
+batch_run(void *arg) {
+	BATCH_JOB *job = (BATCH_JOB *)arg;
+	char pline[40], buf[MAX_LINE];
+	int i, k, n = 0;
+
+	/* parse the lines, gathering the points to project */
+	for (i = 0; i < job->line_count; ++i) {
+		char *line = job->text + job->line_start[i], *s = line;
+
+		job->facs_bad[i] = 1;
+		if (bin_in) /* read already */
+			job->rest[i] = "\n";
+		else if (*s == tag) {
+			job->rest[i] = NULL;
+			continue;
+		} else {
+			if (reversein) {
+				job->v[i] = (*informat)(s, &s);
+				job->u[i] = (*informat)(s, &s);
+			} else {
+				job->u[i] = (*informat)(s, &s);
+				job->v[i] = (*informat)(s, &s);
+			}
+			if (job->v[i] == HUGE_VAL)
+				job->u[i] = HUGE_VAL;
+			if (!*s && (s > line)) --s; /* assumed we gobbled \n */
+			job->rest[i] = s;
+		}
+		if (job->u[i] != HUGE_VAL) {
+			if (prescale) { job->u[i] *= fscale; job->v[i] *= fscale; }
+			if (dofactors && !inverse) {
+				projUV lp;
+
+				lp.u = job->u[i];
+				lp.v = job->v[i];
+				job->facs_bad[i] = pj_factors(lp, job->P, 0.,
+					job->facs + i);
+			}
+			job->point_line[n] = i;
+			job->x[n] = job->u[i];
+			job->y[n] = job->v[i];
+			n++;
+		}
+	}
+	/* project them in one call, failed points are set to HUGE_VAL */
+	if (inverse)
+		(void)pj_inv_array(job->P, n, 1, job->x, job->y);
+	else
+		(void)pj_fwd_array(job->P, n, 1, job->x, job->y);
+	for (k = 0; k < n; ++k) {
+		i = job->point_line[k];
+		job->u[i] = job->x[k];
+		job->v[i] = job->y[k];
+		if (dofactors && inverse) {
+			projUV lp;
+
+			lp.u = job->u[i];
+			lp.v = job->v[i];
+			job->facs_bad[i] = pj_factors(lp, job->P, 0., job->facs + i);
+		}
+		if (postscale && job->u[i] != HUGE_VAL)
+			{ job->u[i] *= fscale; job->v[i] *= fscale; }
+	}
+	/* format the output lines */
+	job->out_len = 0;
+	for (i = 0; i < job->line_count; ++i) {
+		char *line = job->text + job->line_start[i], *s = job->rest[i];
+		double u = job->u[i], v = job->v[i];
+
+		if (s == NULL) {
+			if (!bin_out)
+				batch_puts(job, line);
+			continue;
+		}
+		if (bin_out) { /* binary output */
+			projUV data;
+
+			data.u = u;
+			data.v = v;
+			batch_write(job, &data, sizeof(projUV));
+			continue;
+		}
+		if (!bin_in && echoin) {
+			int t;
+			t = *s;
+			*s = '\0';
+			batch_puts(job, line);
+			*s = t;
+			batch_puts(job, "\t");
+		}
+		if (u == HUGE_VAL) /* error output */
+			batch_puts(job, oterr);
+		else if (inverse && !oform) {	/*ascii DMS output */
+			if (reverseout) {
+				batch_puts(job, rtodms(pline, v, 'N', 'S'));
+				batch_puts(job, "\t");
+				batch_puts(job, rtodms(pline, u, 'E', 'W'));
+			} else {
+				batch_puts(job, rtodms(pline, u, 'E', 'W'));
+				batch_puts(job, "\t");
+				batch_puts(job, rtodms(pline, v, 'N', 'S'));
+			}
+		} else {	/* x-y or decimal degree ascii output */
+			if (inverse) {
+				v *= RAD_TO_DEG;
+				u *= RAD_TO_DEG;
+			}
+			if (reverseout) {
+				batch_printf(job, oform, v); batch_puts(job, "\t");
+				batch_printf(job, oform, u);
+			} else {
+				batch_printf(job, oform, u); batch_puts(job, "\t");
+				batch_printf(job, oform, v);
+			}
+		}
+		if (dofactors) { /* print scale factor data */
+			struct FACTORS *f = job->facs + i;
+
+			if (!job->facs_bad[i]) {
+				(void)sprintf(buf, "\t<%g %g %g %g %g %g>",
+					f->h, f->k, f->s,
+					f->omega * RAD_TO_DEG, f->a, f->b);
+				batch_puts(job, buf);
+			} else
+				batch_puts(job, "\t<* * * * * *>");
+		}
+		batch_puts(job, s);
+	}
+}
+	static void	/* file processing function for -j */
+process_batch(FILE *fid) {
+	BATCH_READER reader;
+	int done = 0;
+
+	reader.fid = fid;
+	reader.len = reader.pos = 0;
+	reader.eof = 0;
+	reader.buf = NULL;
+	if (!bin_in && (reader.buf = (char *)malloc(BATCH_READ_SIZE)) == NULL)
+		emess(3,"out of memory for batch");
+	while (!done) {
+		int j, job_count = 0;
+
+		for (j = 0; j < threads; ++j) {
+			BATCH_JOB *job = jobs + j;
+
+			job->line_count = 0;
+			job->text_len = 0;
+			if (bin_in)
+				batch_read_binary(fid, job);
+			else
+				while (job->line_count < BATCH_LINES
+					&& batch_read_line(&reader, job)) ;
+			emess_dat.File_line += job->line_count;
+			if (job->line_count < BATCH_LINES)
+				done = 1;
+			if (job->line_count == 0)
+				break;
+			/* run it here if no thread can be started */
+			if ((job->thread = pj_thread_start(batch_run, job)) == NULL)
+				batch_run(job);
+			job_count++;
+			if (done)
+				break;
+		}
+		for (j = 0; j < job_count; ++j) {
+			pj_thread_join(jobs[j].thread);
+			(void)fwrite(jobs[j].out, 1, jobs[j].out_len, stdout);
+		}
+	}
+	free(reader.buf);
+}
+	static void
+batch_jobs_init(void) {
+	int j;
+
+	if ((jobs = (BATCH_JOB *)calloc(threads, sizeof(BATCH_JOB))) == NULL)
+		emess(3,"out of memory for batch");
+	for (j = 0; j < threads; ++j) {
+		jobs[j].ctx = pj_ctx_alloc();
+		pj_ctx_set_errno_globals(jobs[j].ctx, 0);
+		if (!(jobs[j].P = pj_clone(jobs[j].ctx, Proj)))
+			emess(3,"projection initialization failure\ncause: %s",
+				pj_strerrno(pj_ctx_get_errno(jobs[j].ctx)));
+	}
+}
+	static void
+batch_jobs_free(void) {
+	int j;
+
+	for (j = 0; j < threads; ++j) {
+		pj_free(jobs[j].P);
+		pj_ctx_free(jobs[j].ctx);
+		free(jobs[j].text);
+		free(jobs[j].out);
+	}
+	free(jobs);
 }
 	static void	/* file processing function --- verbosely */
 vprocess(FILE *fid) {
@@ -187,8 +512,8 @@ vprocess(FILE *fid) {
 				emess(-1,"inverse for this projection not avail.\n");
 				continue;
 			}
-			dat_xy.u = strtod(s, &s);
-			dat_xy.v = strtod(s, &s);
+			dat_xy.u = pj_strtod(s, &s);
+			dat_xy.v = pj_strtod(s, &s);
 			if (dat_xy.u == HUGE_VAL || dat_xy.v == HUGE_VAL) {
 				emess(-1,"lon-lat input conversion failure\n");
 				continue;
@@ -393,6 +718,11 @@ int main(int argc, char **argv) {
               case 's': /* reverse output */
                 reverseout = 1;
                 continue;
+              case 'j': /* batches on n threads */
+                if (--argc <= 0) goto noargument;
+                if ((threads = atoi(*++argv)) < 1)
+                    emess(1,"-j argument must be at least 1");
+                continue;
               default:
                 emess(1, "invalid option: -%c",*arg);
                 break;
@@ -457,7 +787,7 @@ int main(int argc, char **argv) {
         }
     }
     if (inverse)
-        informat = strtod;
+        informat = pj_strtod;
     else {
         informat = dmstor;
         if (!oform)
@@ -469,6 +799,11 @@ int main(int argc, char **argv) {
         SET_BINARY_MODE(stdout);
     }
 
+    if (very_verby)
+        threads = 0;
+    if (threads > 0)
+        batch_jobs_init();
+
     /* process input file list */
     for ( ; eargc-- ; ++eargv) {
         if (**eargv == '-') {
@@ -490,11 +825,15 @@ int main(int argc, char **argv) {
         emess_dat.File_line = 0;
         if (very_verby)
             vprocess(fid);
+        else if (threads > 0)
+            process_batch(fid);
         else
             process(fid);
         (void)fclose(fid);
         emess_dat.File_name = 0;
     }
+    if (threads > 0)
+        batch_jobs_free();
     if( Proj )
         pj_free(Proj);
     exit(0); /* normal completion */
@@ -56,13 +56,26 @@ extern int pj_errno;	/* global error return code */
     #define projXY projUV
     #define projLP projUV
     typedef void *projCtx;
+    typedef void *projTransformPlan;
+    typedef void *projGridRegistry;
+    typedef void *projDef;
 #else
     typedef PJ *projPJ;
     typedef projCtx_t *projCtx;
+    typedef PJ_TRANSFORM_PLAN *projTransformPlan;
+    typedef PJ_GRID_REGISTRY *projGridRegistry;
+    typedef PJ_DEF *projDef;
 #   define projXY	XY
 #   define projLP       LP
 #endif
 
+typedef void *projGridPrefetch;
+typedef void *projCtxPool;
+typedef void *projTransformAsync;
+typedef void *projStream;
+typedef void *projTileCache;
+typedef void *projExecutor;
+
 /* file reading api, like stdio */
 typedef int *PAFile;
 typedef struct projFileAPI_t {
@@ -73,15 +86,308 @@ typedef struct projFileAPI_t {
     void    (*FClose)(PAFile);
 } projFileAPI;
 
+/* Optional memory mapping hooks matching a projFileAPI, used to share
+   grid file contents between processes instead of reading them.  FMap
+   returns a read-only pointer to size bytes at offset, and a handle for
+   FUnmap, or NULL if the file cannot be mapped. */
+typedef struct projFileMapAPI_t {
+    void   *(*FMap)(PAFile file, long offset, size_t size, void **handle);
+    void    (*FUnmap)(void *handle);
+} projFileMapAPI;
+
+/* 64 bit file offsets, where the compiler has such integers */
+#if defined(_MSC_VER)
+typedef __int64 projFileOffset;
+#elif defined(__GNUC__) || defined(__STDC_VERSION__)
+typedef long long projFileOffset;
+#else
+typedef long projFileOffset;
+#endif
+
+/* Optional positional read and mapping hooks matching a projFileAPI, for
+   files larger than a long addresses and for reads from several threads
+   at once.  FReadAt reads up to size bytes at offset without moving the
+   position of the file, and must be safe to call concurrently on the
+   same file.  Any hook may be NULL, for the projFileAPI (and the
+   projFileMapAPI) to be used instead.  version is PJ_FILEAPI_EX_VERSION,
+   for hooks added later to be told apart. */
+#define PJ_FILEAPI_EX_VERSION 1
+typedef struct projFileAPIEx_t {
+    int     version;
+    size_t  (*FReadAt)(PAFile file, void *buffer, size_t size, 
+                       projFileOffset offset);
+    void   *(*FMap)(PAFile file, projFileOffset offset, size_t size, 
+                    void **handle);
+    void    (*FUnmap)(void *handle);
+} projFileAPIEx;
+
+/* An execution backend of transform plans, set by
+   pj_transform_plan_set_backend(), such as one running the stages of
+   common plans on a GPU.  Prepare is called once for the plan, with
+   its definitions, and returns the handle passed to Execute and
+   Release, or NULL if the backend does not handle the pair, leaving
+   the plan on the CPU.  Execute transforms a batch of at least
+   min_points points in place, as pj_transform() would, and returns 0,
+   or else nonzero with the points left as passed for the CPU stages of
+   the plan to run the batch.  It may be called from several threads at
+   once.  version is PJ_PLAN_BACKEND_VERSION. */
+#define PJ_PLAN_BACKEND_VERSION 1
+typedef struct projPlanBackend_t {
+    int     version;
+    long    min_points;
+    void   *user;
+    void   *(*Prepare)(void *user, projPJ src, projPJ dst);
+    int     (*Execute)(void *handle, long point_count, int point_offset,
+                       double *x, double *y, double *z);
+    void    (*Release)(void *handle);
+} projPlanBackend;
+
+/* A log message with the fields it is about, as passed to the logger
+   set by pj_ctx_set_record_logger().  gridname is NULL, point_index -1
+   and error_code 0 where they do not apply. */
+typedef struct projLogRecord_t {
+    int         level;
+    const char  *message;
+    const char  *gridname;
+    long        point_index;
+    int         error_code;
+} projLogRecord;
+
+/* Instruction sets of the variants of the kernels, see pj_ctx_set_isa().
+   NEON is the ARM counterpart of the x86 ones. */
+#define PJ_ISA_GENERIC  0
+#define PJ_ISA_SSE2     1
+#define PJ_ISA_AVX2     2
+#define PJ_ISA_AVX512   3
+#define PJ_ISA_NEON     4
+#define PJ_ISA_BEST     255
+
+/* Instrumentation of a context, see pj_ctx_set_stats().  Counts are
+   doubles so that they stay exact well past 2^31 on every platform. */
+typedef struct {
+    double  calls;          /* times the stage ran */
+    double  points;         /* points processed, or bytes for grid loads */
+    double  nanoseconds;    /* total time spent */
+} projStatsCounter;
+
+/* Latencies of calls in powers of two of nanoseconds: counts[i] is the
+   number of calls that took from 2^i to 2^(i+1) ns, counts[0] taking
+   those under 2 ns and the last bucket those of 2^39 ns (some nine
+   minutes) or more. */
+#define PJ_STATS_LATENCY_BUCKETS 40
+
+typedef struct {
+    double  counts[PJ_STATS_LATENCY_BUCKETS];
+} projStatsLatency;
+
+#define PJ_STATS_MAX_GRIDS 16
+#define PJ_STATS_MAX_WORKERS 16
+
+typedef struct {
+    projStatsCounter inv;           /* inverse projection of the source */
+    projStatsCounter datum;         /* datum shifts, grid shifts included */
+    projStatsCounter gridshift;     /* horizontal grid shifts */
+    projStatsCounter vgridshift;    /* vertical grid shifts */
+    projStatsCounter fwd;           /* forward projection to the target */
+    projStatsCounter grid_load;     /* grid data loads */
+    double  initcache_hits;         /* init file and definition caches */
+    double  initcache_misses;
+    projStatsCounter lock_wait;     /* contended locks, process wide */
+    int     grid_count;             /* entries used in grids[] */
+    struct {
+        char    gridname[64];
+        projStatsCounter shift;
+    } grids[PJ_STATS_MAX_GRIDS];    /* gridshift by grid, the first seen */
+    projStatsCounter parallel;      /* batches split across threads, with
+                                       the time from start to end */
+    int     worker_count;           /* entries used in workers[] */
+    projStatsCounter workers[PJ_STATS_MAX_WORKERS]; /* chunks, points and
+                                       busy time of the threads of split
+                                       batches, the calling one first */
+    double  memo_hits;              /* points of plans with a memo, see */
+    double  memo_misses;            /* pj_transform_plan_set_memo(), and */
+    double  memo_bypassed;          /* those passed while it is idle */
+    projStatsCounter backend;       /* batches run by the execution
+                                       backends of plans */
+    int     isa;                    /* PJ_ISA_* of the kernels */
+    projStatsLatency transform_latency; /* transformations, by call */
+    projStatsLatency grid_load_latency; /* grid data loads */
+    projStatsLatency init_latency;  /* pj_init_ctx() and so
+                                       pj_init_plus_ctx() */
+} projStats;
+
+/* Bytes held by the library for a context, see pj_ctx_get_memory_usage().
+   Mapped bytes are not in the total, as the system can drop them. */
+typedef struct {
+    double  grid_values;    /* values of loaded grids, allocated */
+    double  grid_mapped;    /* values and catalogs mapped from files or
+                               shared segments */
+    double  grid_tables;    /* inverse, row pair, quantized and child
+                               index tables of grids */
+    double  grid_tiles;     /* tiles of large grids read by the context */
+    double  grid_derived;   /* geoid differences and grid pairs */
+    double  catalogs;       /* grid catalogs and their indexes */
+    double  init_cache;     /* init file and definition caches */
+    double  init_index;     /* indexes of init files, parsed defaults */
+    double  ellps_tables;   /* coefficient tables of projections */
+    double  param_texts;    /* parameter texts, shared by all definitions */
+    double  total;
+} projMemoryUsage;
+
+/* Coordinates of a batch, see pj_transform_plan_execute_coords().  Each
+   component has its own first value and stride, counted in values of
+   the type, so that columns (stride 1) and packed xy, xyz or xyzt
+   points (stride 2, 3 or 4) are described alike.  The dates t of the
+   points, for grid catalogs, are only read, and are never set by
+   pj_coords_columns() or pj_coords_packed().  PJ_COORD_INT32 values,
+   as the ints of point cloud formats, stand for value * scale + offset
+   of their axis, see pj_coords_scaled(), INT_MIN standing for HUGE_VAL;
+   their dates are taken as they are. */
+#define PJ_COORD_DOUBLE 0
+#define PJ_COORD_FLOAT  1
+#define PJ_COORD_INT32  2
+
+typedef struct {
+    int     type;                   /* PJ_COORD_DOUBLE, _FLOAT or _INT32 */
+    void    *x, *y, *z;             /* first values, z may be NULL */
+    long    stride_x, stride_y, stride_z;
+    void    *t;                     /* dates in decimal years, or NULL */
+    long    stride_t;
+    double  scale[3], offset[3];    /* of x, y and z, for PJ_COORD_INT32 */
+} projCoords;
+
+/* Arrays of the Arrow C data interface, see
+   pj_transform_plan_execute_arrow() */
+struct ArrowSchema;
+struct ArrowArray;
+
 /* procedure prototypes */
 
 projXY pj_fwd(projLP, projPJ);
 projLP pj_inv(projXY, projPJ);
+int pj_fwd_array( projPJ, long point_count, int point_offset,
+                  double *x, double *y );
+int pj_inv_array( projPJ, long point_count, int point_offset,
+                  double *x, double *y );
+int pj_isea_cells( projPJ, long point_count, int point_offset,
+                   const double *lam, const double *phi, unsigned long *cells );
+int pj_healpix_cells( projPJ, int order, int nest,
+                      long point_count, int point_offset,
+                      const double *lam, const double *phi, long *cells );
+int pj_healpix_centers( projPJ, int order, int nest,
+                        long point_count, int point_offset,
+                        const long *cells, double *lam, double *phi );
+int pj_utm_array( projPJ, long point_count, int point_offset,
+                  const double *lam, const double *phi,
+                  double *x, double *y, int *zones );
+int pj_geos_grid( projPJ, int col_count, const double *x,
+                  int row_count, const double *y,
+                  double *lam, double *phi, unsigned char *mask );
 
 int pj_transform( projPJ src, projPJ dst, long point_count, int point_offset,
                   double *x, double *y, double *z );
+long pj_transform_status( projPJ src, projPJ dst,
+                          long point_count, int point_offset,
+                          double *x, double *y, double *z, int *status );
+int pj_freeze( projPJ );
+int pj_transform_ctx( projCtx, projPJ src, projPJ dst,
+                      long point_count, int point_offset,
+                      double *x, double *y, double *z );
+long pj_transform_status_ctx( projCtx, projPJ src, projPJ dst,
+                              long point_count, int point_offset,
+                              double *x, double *y, double *z, int *status );
+int pj_transform_fanout( projPJ src, int dst_count, projPJ *dsts,
+                         long point_count, int point_offset,
+                         const double *x, const double *y, const double *z,
+                         double **out_x, double **out_y, double **out_z );
 int pj_datum_transform( projPJ src, projPJ dst, long point_count, int point_offset,
                         double *x, double *y, double *z );
+int pj_transform_heights( projPJ src, projPJ dst,
+                          long point_count, int point_offset,
+                          double *x, double *y, double *z );
+projTransformPlan pj_transform_plan_create( projPJ src, projPJ dst );
+projTransformPlan pj_transform_plan_create_vertical( projPJ src, 
+                                                     projPJ dst );
+int pj_transform_plan_execute( projTransformPlan plan,
+                               long point_count, int point_offset,
+                               double *x, double *y, double *z );
+long pj_transform_plan_execute_status( projTransformPlan plan,
+                                       long point_count, int point_offset,
+                                       double *x, double *y, double *z,
+                                       int *status );
+int pj_transform_plan_execute_t( projTransformPlan plan,
+                                 long point_count, int point_offset,
+                                 double *x, double *y, double *z,
+                                 const double *t );
+long pj_transform_plan_execute_t_status( projTransformPlan plan,
+                                         long point_count, int point_offset,
+                                         double *x, double *y, double *z,
+                                         const double *t, int *status );
+int pj_transform_plan_execute_coords( projTransformPlan plan,
+                                      long point_count,
+                                      const projCoords *src,
+                                      const projCoords *dst );
+long pj_transform_plan_execute_coords_status( projTransformPlan plan,
+                                              long point_count,
+                                              const projCoords *src,
+                                              const projCoords *dst,
+                                              int *status );
+int pj_transform_plan_execute_arrow( projTransformPlan plan,
+                                     const struct ArrowSchema *schema,
+                                     struct ArrowArray *array,
+                                     struct ArrowArray *out );
+void pj_coords_columns( projCoords *coords, int type,
+                        void *x, void *y, void *z );
+void pj_coords_packed( projCoords *coords, int type,
+                       void *points, int dimension );
+void pj_coords_scaled( projCoords *coords,
+                       const double *scale, const double *offset );
+void pj_transform_plan_free( projTransformPlan plan );
+int pj_transform_plan_set_memo( projTransformPlan plan, long entries );
+int pj_transform_plan_set_backend( projTransformPlan plan,
+                                   const projPlanBackend *backend );
+projTransformAsync pj_transform_plan_execute_async( projTransformPlan plan,
+                                   long point_count, int point_offset,
+                                   double *x, double *y, double *z,
+                                   int *status,
+                                   void (*done)(void *user, long result),
+                                   void *user );
+long pj_transform_async_wait( projTransformAsync );
+projExecutor pj_executor_alloc( long max_points, double max_wait );
+int pj_executor_submit( projExecutor, projTransformPlan plan,
+                        long point_count, double *x, double *y, double *z,
+                        int *status, void (*done)(void *user, long result),
+                        void *user );
+void pj_executor_poll( projExecutor );
+void pj_executor_flush( projExecutor );
+void pj_executor_wait( projExecutor );
+void pj_executor_free( projExecutor );
+projStream pj_stream_open( projTransformPlan plan, long chunk_size );
+long pj_stream_push( projStream, long count,
+                     const double *x, const double *y, const double *z );
+void pj_stream_flush( projStream );
+long pj_stream_pull( projStream, long max,
+                     double *x, double *y, double *z, int *status );
+void pj_stream_close( projStream );
+int pj_transform_grid( projTransformPlan plan,
+                       double x0, double dx, long nx,
+                       double y0, double dy, long ny,
+                       double *out_x, double *out_y, double max_error );
+projTileCache pj_tile_cache_alloc( size_t max_bytes, const char *directory );
+void pj_tile_cache_free( projTileCache );
+int pj_transform_tile( projTileCache cache, projTransformPlan plan,
+                       double x0, double dx, long nx,
+                       double y0, double dy, long ny,
+                       long lattice, double *out_x, double *out_y );
+int pj_transform_bounds( projTransformPlan plan,
+                         double xmin, double ymin, double xmax, double ymax,
+                         double densify_tol,
+                         double *out_xmin, double *out_ymin,
+                         double *out_xmax, double *out_ymax );
+int pj_transform_line( projTransformPlan plan,
+                       long point_count, const double *x, const double *y,
+                       double tol,
+                       long *out_count, double **out_x, double **out_y );
 int pj_geocentric_to_geodetic( double a, double es,
                                long point_count, int point_offset,
                                double *x, double *y, double *z );
@@ -94,6 +400,8 @@ int pj_apply_gridshift( projCtx, const char *, int,
                         double *x, double *y, double *z );
 void pj_deallocate_grids(void);
 void pj_clear_initcache(void);
+int pj_save_initcache( projCtx, const char *filename );
+int pj_load_initcache( projCtx, const char *filename );
 int pj_is_latlong(projPJ);
 int pj_is_geocent(projPJ);
 void pj_get_spheroid_defn(projPJ defn, double *major_axis, double *eccentricity_squared);
@@ -105,7 +413,17 @@ projPJ pj_init(int, char **);
 projPJ pj_init_plus(const char *);
 projPJ pj_init_ctx( projCtx, int, char ** );
 projPJ pj_init_plus_ctx( projCtx, const char * );
+projPJ pj_init_plus_cached( projCtx, const char * );
+int pj_init_many( projCtx, int count, const char * const *definitions,
+                  projPJ *out );
+projPJ pj_clone( projCtx, projPJ );
+projDef pj_def_new( void );
+int pj_def_set_double( projDef, const char *name, double value );
+int pj_def_set_string( projDef, const char *name, const char *value );
+void pj_def_free( projDef );
+projPJ pj_init_from_def( projCtx, projDef );
 char *pj_get_def(projPJ, int);
+char *pj_canonical_def( projCtx, const char * );
 projPJ pj_latlong_from_proj( projPJ );
 void *pj_malloc(size_t);
 void pj_dalloc(void *);
@@ -115,26 +433,115 @@ const char *pj_get_release(void);
 void pj_acquire_lock(void);
 void pj_release_lock(void);
 void pj_cleanup_lock(void);
+void pj_get_lock_stats( int lock_class, long *acquired, long *waited );
+void pj_set_grid_memory_limit( size_t bytes );
+size_t pj_get_grid_memory_limit(void);
+void pj_get_grid_memory_stats( long *loads, long *evictions, size_t *bytes );
+void pj_set_initcache_memory_limit( size_t bytes );
+size_t pj_get_initcache_memory_limit(void);
 
 projCtx pj_get_default_ctx(void);
 projCtx pj_get_ctx( projPJ );
 void pj_set_ctx( projPJ, projCtx );
 projCtx pj_ctx_alloc(void);
 void    pj_ctx_free( projCtx );
+projCtxPool pj_ctx_pool_alloc( projCtx model, int max_idle );
+projCtx pj_ctx_pool_acquire( projCtxPool );
+void    pj_ctx_pool_release( projCtxPool, projCtx );
+void    pj_ctx_pool_free( projCtxPool );
 int pj_ctx_get_errno( projCtx );
 void pj_ctx_set_errno( projCtx, int );
+void pj_ctx_set_errno_globals( projCtx, int );
+int pj_ctx_get_errno_globals( projCtx );
 void pj_ctx_set_debug( projCtx, int );
 void pj_ctx_set_logger( projCtx, void (*)(void *, int, const char *) );
+void pj_ctx_set_record_logger( projCtx,
+                               void (*)(void *, const projLogRecord *) );
+void pj_ctx_reset_log_limits( projCtx );
 void pj_ctx_set_app_data( projCtx, void * );
 void *pj_ctx_get_app_data( projCtx );
+void pj_ctx_set_grid_tile_limit( projCtx, int );
+int pj_ctx_get_grid_tile_limit( projCtx );
+void pj_ctx_set_inverse_grids( projCtx, int );
+int pj_ctx_get_inverse_grids( projCtx );
+void pj_ctx_set_grid_row_pairs( projCtx, int );
+int pj_ctx_get_grid_row_pairs( projCtx );
+void pj_ctx_set_grid_quantize( projCtx, double );
+double pj_ctx_get_grid_quantize( projCtx );
+void pj_ctx_set_grid_shm( projCtx, int );
+int pj_ctx_get_grid_shm( projCtx );
+void pj_ctx_set_init_shm( projCtx, int );
+int pj_ctx_get_init_shm( projCtx );
+void pj_ctx_set_grid_nonblocking( projCtx, int );
+int pj_ctx_get_grid_nonblocking( projCtx );
+void pj_ctx_set_low_memory( projCtx, int );
+int pj_ctx_get_low_memory( projCtx );
+void pj_ctx_set_isa( projCtx, int isa );
+int pj_ctx_get_isa( projCtx );
+const char *pj_isa_name( int isa );
+void pj_ctx_set_grid_registry( projCtx, projGridRegistry );
+projGridRegistry pj_ctx_get_grid_registry( projCtx );
+void pj_ctx_set_threads( projCtx, int );
+int pj_ctx_get_threads( projCtx );
+void pj_ctx_set_grid_sort_threshold( projCtx, long );
+long pj_ctx_get_grid_sort_threshold( projCtx );
+void pj_ctx_set_batch_grain( projCtx, long );
+long pj_ctx_get_batch_grain( projCtx );
+void pj_ctx_set_batch_min_split( projCtx, long );
+long pj_ctx_get_batch_min_split( projCtx );
+void pj_ctx_set_array_chunk( projCtx, int );
+int pj_ctx_get_array_chunk( projCtx );
+int pj_ctx_tune( projCtx, const char *filename );
+int pj_ctx_load_tuning( projCtx, const char *filename );
+void pj_ctx_set_allocator( projCtx, void *(*alloc)(void *, size_t),
+                           void (*dalloc)(void *, void *), void *user_data );
+void pj_ctx_set_grid_huge_pages( projCtx, int mode );
+int pj_ctx_get_grid_huge_pages( projCtx );
+void pj_ctx_set_stats( projCtx, int enable );
+int pj_ctx_get_stats( projCtx, projStats * );
+void pj_ctx_reset_stats( projCtx );
+void pj_ctx_set_stats_callback( projCtx,
+                                void (*)(void *, const projStats *),
+                                double interval );
+int pj_ctx_get_memory_usage( projCtx, projMemoryUsage * );
+int pj_ctx_walk_grid_memory( projCtx,
+                             int (*walker)( void *, const char *gridname,
+                                            double bytes, double mapped ),
+                             void * );
+projGridRegistry pj_grid_registry_alloc(void);
+void pj_grid_registry_free( projGridRegistry );
+void pj_grid_registry_set_allocator( projGridRegistry,
+                                     void *(*alloc)(void *, size_t),
+                                     void (*dalloc)(void *, void *),
+                                     void *user_data );
 void pj_ctx_set_fileapi( projCtx, projFileAPI *);
 projFileAPI *pj_ctx_get_fileapi( projCtx );
+void pj_ctx_set_filemapapi( projCtx, projFileMapAPI *);
+projFileMapAPI *pj_ctx_get_filemapapi( projCtx );
+void pj_ctx_set_fileapi_ex( projCtx, projFileAPIEx *);
+projFileAPIEx *pj_ctx_get_fileapi_ex( projCtx );
+int pj_ctx_set_network( projCtx, int enable );
+int pj_ctx_get_network( projCtx );
+void pj_set_network_cache( const char *directory, long max_megabytes );
+void pj_set_approx_cache( const char *directory );
+projGridPrefetch pj_ctx_prefetch_grids( projCtx, const char *nadgrids,
+                                        double ll_long, double ll_lat,
+                                        double ur_long, double ur_lat );
+int pj_grid_prefetch_wait( projGridPrefetch );
+int pj_grid_coverage( projCtx, const char *nadgrids, long point_count,
+                      const double *lon, const double *lat,
+                      unsigned char *mask );
+int pj_vgrid_coverage( projCtx, const char *geoidgrids, long point_count,
+                       const double *lon, const double *lat,
+                       unsigned char *mask );
 
 void pj_log( projCtx ctx, int level, const char *fmt, ... );
 void pj_stderr_logger( void *, int, const char * );
 
 /* file api */
 projFileAPI *pj_get_default_fileapi();
+projFileMapAPI *pj_get_default_filemapapi();
+projFileAPIEx *pj_get_default_fileapi_ex();
 
 PAFile pj_ctx_fopen(projCtx ctx, const char *filename, const char *access);
 size_t pj_ctx_fread(projCtx ctx, void *buffer, size_t size, size_t nmemb, PAFile file);
@@ -142,6 +549,10 @@ int    pj_ctx_fseek(projCtx ctx, PAFile file, long offset, int whence);
 long   pj_ctx_ftell(projCtx ctx, PAFile file);
 void   pj_ctx_fclose(projCtx ctx, PAFile file);
 char  *pj_ctx_fgets(projCtx ctx, char *line, int size, PAFile file);
+void  *pj_ctx_fmap(projCtx ctx, PAFile file, long offset, size_t size, 
+                   void **handle);
+size_t pj_ctx_fread_at(projCtx ctx, PAFile file, void *buffer, size_t size,
+                       projFileOffset offset);
 
 PAFile pj_open_lib(projCtx, const char *, const char *);
 
@@ -150,6 +561,23 @@ PAFile pj_open_lib(projCtx, const char *, const char *);
 #define PJ_LOG_DEBUG_MAJOR 2
 #define PJ_LOG_DEBUG_MINOR 3
 
+/* lock classes for pj_get_lock_stats() */
+#define PJ_LOCK_CORE         0
+#define PJ_LOCK_INITCACHE    1
+#define PJ_LOCK_GRID_LIST    2
+#define PJ_LOCK_CATALOG_LIST 3
+#define PJ_LOCK_GRID         4
+#define PJ_LOCK_BATCH        5
+#define PJ_LOCK_CTX_POOL     6
+#define PJ_LOCK_EXECUTOR     7
+#define PJ_LOCK_PARAMS       8
+#define PJ_LOCK_CLASS_COUNT  9
+
+/* modes of pj_ctx_set_grid_huge_pages() */
+#define PJ_HUGE_PAGES_NONE     0
+#define PJ_HUGE_PAGES_ADVISE   1
+#define PJ_HUGE_PAGES_EXPLICIT 2
+
 #ifdef __cplusplus
 }
 #endif
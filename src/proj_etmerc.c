@@ -43,7 +43,8 @@
     double    cgb[6]; /* Constants for Gauss -> Geo lat */ \
     double    cbg[6]; /* Constants for Geo lat -> Gauss */ \
     double    utg[6]; /* Constants for transv. merc. -> geo */ \
-    double    gtu[6]; /* Constants for geo -> transv. merc. */
+    double    gtu[6]; /* Constants for geo -> transv. merc. */ \
+    int       order;  /* of the series used, see etmerc_order() */
 
 #define PROJ_LIB__
 #define PJ_LIB__
@@ -145,12 +146,40 @@ clens(double *a, int size, double arg_r) {
     return(sin(arg_r)*hr);
 }
 
-FORWARD(e_forward); /* ellipsoid */
+/*
+** With +accuracy= the series are cut to the lowest order whose
+** truncation error, measured against the full ones for GRS80, is within
+** the budget.  The error goes with n^(order+1), and so is scaled to the
+** third flattening and size of the ellipsoid.  It grows quickly away
+** from the central meridian, so the cut series are only used within 40
+** degrees of it going forward, and the corresponding normalized easting
+** going back, and the full ones beyond.
+*/
+#define ETMERC_CUT_LAM 0.7     /* radians */
+#define ETMERC_CUT_CE  0.78
+static const double etmerc_cut_error[PROJ_ETMERC_ORDER] = {
+    0, 0, 0.5, 5e-3, 5e-5, 1e-6    /* meters, by order */
+};
+#define ETMERC_GRS80_N 0.0016792203946287433
+
+    static int
+etmerc_order(PJ *P, double n) {
+    int order;
+
+    if (P->cold->accuracy > 0)
+        for (order = 2; order < PROJ_ETMERC_ORDER; ++order)
+            if (etmerc_cut_error[order] * pow(n / ETMERC_GRS80_N, order+1)
+                * P->k0 * P->a / 6378137. <= P->cold->accuracy)
+                return order;
+    return PROJ_ETMERC_ORDER;
+}
+
+    static XY
+gauss_fwd(PJ *P, double Cn, double Ce,
+          int order) { /* Gaussian LAT, LNG -> E, N */
+    XY xy;
     double sin_Cn, cos_Cn, cos_Ce, sin_Ce, dCn, dCe;
-    double Cn = lp.phi, Ce = lp.lam;
 
-    /* ell. LAT, LNG -> Gaussian LAT, LNG */
-    Cn  = gatg(P->cbg, PROJ_ETMERC_ORDER, Cn);
     /* Gaussian LAT, LNG -> compl. sph. LAT */
 #ifdef _GNU_SOURCE
     sincos(Cn, &sin_Cn, &cos_Cn);
@@ -166,7 +195,7 @@ FORWARD(e_forward); /* ellipsoid */
     Ce     = atan2(sin_Ce*cos_Cn, hypot(sin_Cn, cos_Cn*cos_Ce));
     /* compl. sph. N, E -> ell. norm. N, E */
     Ce  = asinhy(tan(Ce));     /* Replaces: Ce  = log(tan(FORTPI + Ce*0.5)); */
-    Cn += clenS(P->gtu, PROJ_ETMERC_ORDER, 2*Cn, 2*Ce, &dCn, &dCe);
+    Cn += clenS(P->gtu, order, 2*Cn, 2*Ce, &dCn, &dCe);
     Ce += dCe;
     if (fabs(Ce) <= 2.623395162778) {
         xy.y  = P->Qn * Cn + P->Zb;  /* Northing */
@@ -176,32 +205,50 @@ FORWARD(e_forward); /* ellipsoid */
     return (xy);
 }
 
-INVERSE(e_inverse); /* ellipsoid */
+    static int
+gauss_inv(PJ *P, XY xy, double *pCn, double *pCe) { /* E, N -> Gaussian */
     double sin_Cn, cos_Cn, cos_Ce, sin_Ce, dCn, dCe;
     double Cn = xy.y, Ce = xy.x;
 
     /* normalize N, E */
     Cn = (Cn - P->Zb)/P->Qn;
     Ce = Ce/P->Qn;
-    if (fabs(Ce) <= 2.623395162778) { /* 150 degrees */
+    if (fabs(Ce) > 2.623395162778) /* 150 degrees */
+        return 0;
     /* norm. N, E -> compl. sph. LAT, LNG */
-        Cn += clenS(P->utg, PROJ_ETMERC_ORDER, 2*Cn, 2*Ce, &dCn, &dCe);
-        Ce += dCe;
-        Ce = atan(sinh(Ce)); /* Replaces: Ce = 2*(atan(exp(Ce)) - FORTPI); */
-        /* compl. sph. LAT -> Gaussian LAT, LNG */
+    Cn += clenS(P->utg, fabs(Ce) < ETMERC_CUT_CE ? P->order : PROJ_ETMERC_ORDER,
+                2*Cn, 2*Ce, &dCn, &dCe);
+    Ce += dCe;
+    Ce = atan(sinh(Ce)); /* Replaces: Ce = 2*(atan(exp(Ce)) - FORTPI); */
+    /* compl. sph. LAT -> Gaussian LAT, LNG */
 #ifdef _GNU_SOURCE
-        sincos(Cn, &sin_Cn, &cos_Cn);
-        sincos(Ce, &sin_Ce, &cos_Ce);
+    sincos(Cn, &sin_Cn, &cos_Cn);
+    sincos(Ce, &sin_Ce, &cos_Ce);
 #else
-        sin_Cn = sin(Cn);
-        cos_Cn = cos(Cn);
-        sin_Ce = sin(Ce);
-        cos_Ce = cos(Ce);
+    sin_Cn = sin(Cn);
+    cos_Cn = cos(Cn);
+    sin_Ce = sin(Ce);
+    cos_Ce = cos(Ce);
 #endif
-        Ce     = atan2(sin_Ce, cos_Ce*cos_Cn);
-        Cn     = atan2(sin_Cn*cos_Ce, hypot(sin_Ce, cos_Ce*cos_Cn));
+    *pCe   = atan2(sin_Ce, cos_Ce*cos_Cn);
+    *pCn   = atan2(sin_Cn*cos_Ce, hypot(sin_Ce, cos_Ce*cos_Cn));
+    return 1;
+}
+
+FORWARD(e_forward); /* ellipsoid */
+    int order = fabs(lp.lam) < ETMERC_CUT_LAM ? P->order : PROJ_ETMERC_ORDER;
+
+    /* ell. LAT, LNG -> Gaussian LAT, LNG */
+    xy = gauss_fwd(P, gatg(P->cbg, order, lp.phi), lp.lam, order);
+    return (xy);
+}
+
+INVERSE(e_inverse); /* ellipsoid */
+    double Cn, Ce;
+
+    if (gauss_inv(P, xy, &Cn, &Ce)) {
         /* Gaussian LAT, LNG -> ell. LAT, LNG */
-        lp.phi = gatg(P->cgb,  PROJ_ETMERC_ORDER, Cn);
+        lp.phi = gatg(P->cgb,  P->order, Cn);
         lp.lam = Ce;
     }
     else
@@ -209,6 +256,113 @@ INVERSE(e_inverse); /* ellipsoid */
     return (lp);
 }
 
+SPECIAL(e_fac) { /* ellipsoid */
+    double sin_Cn, cos_Cn, cos_Ce, sin_Ce, dCn, dCe, b, d, lCn, lCe;
+    double c_r, c_i, t_r, t_i, t1_r, t1_i, t2_r, t2_i, f_r, f_i;
+    double Cn = lp.phi, Ce = lp.lam;
+    int j;
+
+    /* as e_forward(), with the lam derivatives of the sph. N, E */
+    Cn  = gatg(P->cbg, PROJ_ETMERC_ORDER, Cn);
+    sin_Cn = sin(Cn);
+    cos_Cn = cos(Cn);
+    sin_Ce = sin(Ce);
+    cos_Ce = cos(Ce);
+    b = cos_Cn*sin_Ce;
+    if ((d = 1 - b*b) <= 1e-10)
+        return;
+    lCn = sin_Cn*b/d;
+    lCe = cos_Cn*cos_Ce/d;
+    Cn     = atan2(sin_Cn, cos_Ce*cos_Cn);
+    Ce     = atan2(sin_Ce*cos_Cn, hypot(sin_Cn, cos_Cn*cos_Ce));
+    Ce  = asinhy(tan(Ce));
+    /* derivative of the series, 1 + sum 2j gtu[j-1] cos(2j (Cn + i Ce)) */
+    c_r =  cos(2*Cn)*cosh(2*Ce);
+    c_i = -sin(2*Cn)*sinh(2*Ce);
+    t2_r = 1; t2_i = 0;
+    t1_r = c_r; t1_i = c_i;
+    f_r = 1 + 2*P->gtu[0]*c_r;
+    f_i = 2*P->gtu[0]*c_i;
+    for (j = 2; j <= PROJ_ETMERC_ORDER; ++j) {
+        t_r = 2*(c_r*t1_r - c_i*t1_i) - t2_r;
+        t_i = 2*(c_r*t1_i + c_i*t1_r) - t2_i;
+        f_r += 2*j*P->gtu[j-1]*t_r;
+        f_i += 2*j*P->gtu[j-1]*t_i;
+        t2_r = t1_r; t2_i = t1_i;
+        t1_r = t_r; t1_i = t_i;
+    }
+    clenS(P->gtu, PROJ_ETMERC_ORDER, 2*Cn, 2*Ce, &dCn, &dCe);
+    if (fabs(Ce + dCe) > 2.623395162778)
+        return;
+    pj_conformal_der(lp, P, P->Qn * (f_r*lCe + f_i*lCn),
+        P->Qn * (f_r*lCn - f_i*lCe), fac);
+}
+
+FORWARD_ARRAY(e_forward_n, e_forward)
+INVERSE_ARRAY(e_inverse_n, e_inverse)
+
+/*
+** The Gaussian latitude of a point only depends on the ellipsoid, so
+** that between two of these projections on the same one the point can
+** go from the Gaussian LAT, LNG of the first to the second with just
+** the change of central meridian, skipping the two series to the
+** ellipsoidal latitude and back.  The scaling and offsets, central
+** meridians and checks are those of pj_inv() and pj_fwd().
+*/
+    int
+pj_etmerc_compatible(PJ *src, PJ *dst) {
+    return src->fwd == e_forward && src->inv == e_inverse
+        && dst->fwd == e_forward && dst->inv == e_inverse
+        && src->es == dst->es && !src->geoc && !dst->geoc;
+}
+
+    int
+pj_etmerc_convert(PJ *src, PJ *dst, long n, int stride,
+                  double *x, double *y) {
+    long i;
+    int err = 0;
+
+    for (i = 0; i < n; i++) {
+        double *px = x + i * stride, *py = y + i * stride;
+        double Cn, Ce;
+        XY xy;
+
+        if (*px == HUGE_VAL) /* already failed */
+            continue;
+        if (*py == HUGE_VAL) {
+            *px = HUGE_VAL;
+            err = -15;
+            continue;
+        }
+        xy.x = (*px * src->to_meter - src->x0) * src->ra;
+        xy.y = (*py * src->to_meter - src->y0) * src->ra;
+        if (!gauss_inv(src, xy, &Cn, &Ce)) {
+            *px = *py = HUGE_VAL;
+            continue;
+        }
+        Ce += src->lam0;
+        if (!src->over)
+            Ce = adjlon(Ce);
+        if (fabs(Ce) > 10.) {
+            *px = *py = HUGE_VAL;
+            err = -14;
+            continue;
+        }
+        Ce -= dst->lam0;
+        if (!dst->over)
+            Ce = adjlon(Ce);
+        xy = gauss_fwd(dst, Cn, Ce,
+                       fabs(Ce) < ETMERC_CUT_LAM ? dst->order : PROJ_ETMERC_ORDER);
+        if (xy.x == HUGE_VAL) {
+            *px = *py = HUGE_VAL;
+            continue;
+        }
+        *px = dst->fr_meter * (dst->a * xy.x + dst->x0);
+        *py = dst->fr_meter * (dst->a * xy.y + dst->y0);
+    }
+    return err;
+}
+
 FREEUP; if (P) free(P); }
 
 ENTRY0(etmerc)
@@ -286,4 +440,8 @@ ENTRY0(etmerc)
     P->Zb  = - P->Qn*(Z + clens(P->gtu, PROJ_ETMERC_ORDER, 2*Z));
     P->inv = e_inverse;
     P->fwd = e_forward;
+    P->inv_n = e_inverse_n;
+    P->fwd_n = e_forward_n;
+    P->spc = e_fac;
+    P->order = etmerc_order(P, n);
 ENDENTRY(P)
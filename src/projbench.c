@@ -0,0 +1,1822 @@
+/******************************************************************************
+ *
+ * Project:  PROJ.4
+ * Purpose:  Mainline program measuring the multithreaded throughput of
+ *           PROJ.4 processing, the cost of each projection of pj_list,
+ *           and that of the runs of the nad/ test scripts, as comma
+ *           separated values or JSON.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "projects.h"
+#include "geodesic.h"
+#include "workload.h"
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/time.h>
+	#include <time.h>
+#endif
+
+#define MAX_COUNTS   32
+
+static int huge_pages = PJ_HUGE_PAGES_NONE;
+
+/* the layout of the points of the point stages, from -w */
+static WorkloadSpec workload;
+static int use_workload = 0;
+
+typedef enum {
+    BENCH_FWD, BENCH_INV, BENCH_TRANSFORM,
+    BENCH_INIT, BENCH_INIT_CACHED, BENCH_GEOD
+} BenchKind;
+
+/*
+** Each stage runs on points spread over lon/lat boxes, in degrees, where
+** its definitions are valid.  Stages using a grid that cannot be loaded
+** are skipped.
+*/
+typedef struct {
+    const char *name;
+    BenchKind   kind;
+    const char *src_def;
+    const char *dst_def;
+    double      lon_min, lon_max, lat_min, lat_max;
+} BenchStage;
+
+static BenchStage stage_list[] = {
+    { "fwd_utm", BENCH_FWD,
+      "+proj=utm +zone=31 +ellps=WGS84", NULL, 0, 6, -60, 60 },
+    { "inv_utm", BENCH_INV,
+      "+proj=utm +zone=31 +ellps=WGS84", NULL, 0, 6, -60, 60 },
+    { "fwd_lcc", BENCH_FWD,
+      "+proj=lcc +lat_1=44 +lat_2=49 +lat_0=46.5 +lon_0=3 +ellps=GRS80",
+      NULL, -5, 10, 40, 52 },
+    { "inv_lcc", BENCH_INV,
+      "+proj=lcc +lat_1=44 +lat_2=49 +lat_0=46.5 +lon_0=3 +ellps=GRS80",
+      NULL, -5, 10, 40, 52 },
+    { "fwd_merc", BENCH_FWD,
+      "+proj=merc +ellps=WGS84", NULL, -180, 180, -80, 80 },
+    { "transform_3param", BENCH_TRANSFORM,
+      "+proj=latlong +ellps=GRS80 +towgs84=2,3,5",
+      "+proj=latlong +ellps=intl +towgs84=10,12,15", -180, 180, -80, 80 },
+    { "transform_7param", BENCH_TRANSFORM,
+      "+proj=latlong +ellps=intl +towgs84=-87,-98,-121,0.5,0.1,0.2,1.5",
+      "+proj=utm +zone=31 +datum=WGS84", 0, 6, 40, 60 },
+    { "transform_ntv2", BENCH_TRANSFORM,
+      "+proj=latlong +ellps=clrk80 +nadgrids=ntf_r93.gsb",
+      "+proj=latlong +ellps=GRS80 +towgs84=0,0,0", -4, 8, 42, 51 },
+    { "transform_ntv1", BENCH_TRANSFORM,
+      "+proj=latlong +ellps=clrk66 +nadgrids=ntv1_can.dat",
+      "+proj=latlong +datum=NAD83", -100, -70, 45, 55 },
+    { "transform_ctable", BENCH_TRANSFORM,
+      "+proj=latlong +ellps=clrk66 +nadgrids=conus",
+      "+proj=latlong +datum=NAD83", -110, -80, 30, 45 },
+    { "transform_ctable2", BENCH_TRANSFORM,
+      "+proj=latlong +ellps=WGS84 +nadgrids=null",
+      "+proj=latlong +datum=WGS84", -180, 180, -80, 80 },
+    { "transform_gtx", BENCH_TRANSFORM,
+      "+proj=latlong +datum=WGS84 +geoidgrids=egm96_15.gtx",
+      "+proj=latlong +datum=WGS84", -180, 180, -80, 80 },
+    { "init_plus", BENCH_INIT,
+      "+init=epsg:2154", NULL, 0, 0, 0, 0 },
+    { "init_plus_cached", BENCH_INIT_CACHED,
+      "+init=epsg:2154", NULL, 0, 0, 0, 0 },
+    { "geod_inverse", BENCH_GEOD,
+      "+proj=latlong +ellps=WGS84", NULL, -180, 180, -90, 90 },
+};
+
+/*
+** The sweep of -a runs every projection of pj_list with a sphere and an
+** ellipsoid, on points of the lon/lat box, in degrees, given here for
+** the projections needing parameters or points of their own, and -30 to
+** 30 in both otherwise.  The others failing to initialize with the
+** sphere or ellipsoid alone are tried again with SWEEP_EXTRA.
+*/
+typedef struct {
+    const char *id;
+    const char *params;
+    double      lon_min, lon_max, lat_min, lat_max;
+} SweepProj;
+
+#define SWEEP_EXTRA " +lat_1=30 +lat_2=50"
+#define SWEEP_SPHERE " +R=6370997"
+#define SWEEP_ELLIPSOID " +ellps=WGS84"
+
+static SweepProj sweep_list[] = {
+    { "chamb", "+lat_1=10 +lon_1=-10 +lat_2=20 +lon_2=10 "
+      "+lat_3=-10 +lon_3=0", -30, 30, -30, 30 },
+    { "geos", "+h=35785831", -30, 30, -30, 30 },
+    { "gn_sinu", "+m=2 +n=3", -30, 30, -30, 30 },
+    { "krovak", "", 12, 19, 48, 51 },
+    { "lcca", "+lat_0=35", -30, 30, 20, 50 },
+    { "lsat", "+lsat=5 +path=100", -90, -80, 30, 40 },
+    { "nsper", "+h=3000000", -20, 20, -20, 20 },
+    { "ob_tran", "+o_proj=mill +o_lat_p=40 +o_lon_p=0", -30, 30, -30, 30 },
+    { "oea", "+m=1 +n=2", -30, 30, -30, 30 },
+    { "omerc", "+lat_0=40 +lonc=0 +alpha=30", -10, 10, 30, 50 },
+    { "tpeqd", "+lat_1=20 +lon_1=-20 +lat_2=20 +lon_2=20",
+      -30, 30, -30, 30 },
+    { "tpers", "+h=3000000 +tilt=10 +azi=20", -20, 20, -20, 20 },
+    { "ups", "", -180, 180, 60, 88 },
+    { "urmfps", "+n=0.5", -30, 30, -30, 30 },
+    { "utm", "+zone=31", 0, 6, -60, 60 },
+};
+
+/*
+** The work of one thread: its own context and definitions, and its own
+** copy of the input points, transformed in place by batches.
+*/
+typedef struct {
+    BenchStage *stage;
+    long        point_count;
+    long        batch;
+    projCtx     ctx;
+    projPJ      src, dst;
+    struct geod_geodesic geod;
+    double      *x, *y, *z;        /* input points */
+    double      *wx, *wy, *wz;     /* working copy of a batch */
+    double      *s12;
+    int         error;
+    void        *thread;
+} BenchJob;
+
+/************************************************************************/
+/*                              bench_now()                             */
+/************************************************************************/
+
+static double bench_now()
+
+{
+#ifdef _WIN32
+    LARGE_INTEGER count, frequency;
+
+    QueryPerformanceCounter( &count );
+    QueryPerformanceFrequency( &frequency );
+    return (double) count.QuadPart / (double) frequency.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+    struct timeval tv;
+
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+#endif
+}
+
+/************************************************************************/
+/*                           parse_counts()                             */
+/*                                                                      */
+/*      Parse a comma separated list of positive counts.                */
+/************************************************************************/
+
+static int parse_counts( const char *text, long *counts )
+
+{
+    int n = 0;
+
+    while( *text && n < MAX_COUNTS )
+    {
+        char *end;
+
+        counts[n] = strtol( text, &end, 10 );
+        if( end == text || counts[n] <= 0 )
+            return 0;
+        n++;
+        text = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+/************************************************************************/
+/*                            job_prepare()                             */
+/*                                                                      */
+/*      Initialize the definitions of a job and its input points,       */
+/*      outside of the timed section.  Returns 0 if the stage cannot    */
+/*      run, for instance because a grid is missing.                    */
+/************************************************************************/
+
+static int job_prepare( BenchJob *job, unsigned seed )
+
+{
+    BenchStage *stage = job->stage;
+    long i, n = job->point_count, nb = job->batch;
+    double a, es;
+
+    job->ctx = pj_ctx_alloc();
+    job->ctx->errno_globals = 0;
+    pj_ctx_set_grid_huge_pages( job->ctx, huge_pages );
+    if( stage->kind == BENCH_INIT || stage->kind == BENCH_INIT_CACHED )
+        return 1;
+
+    job->src = pj_init_plus_ctx( job->ctx, stage->src_def );
+    if( job->src == NULL )
+        return 0;
+    if( stage->dst_def != NULL
+        && (job->dst = pj_init_plus_ctx( job->ctx, stage->dst_def )) == NULL )
+        return 0;
+
+    job->x = (double *) malloc( sizeof(double) * n );
+    job->y = (double *) malloc( sizeof(double) * n );
+    job->z = (double *) malloc( sizeof(double) * n );
+    job->wx = (double *) malloc( sizeof(double) * nb );
+    job->wy = (double *) malloc( sizeof(double) * nb );
+    job->wz = (double *) malloc( sizeof(double) * nb );
+    job->s12 = (double *) malloc( sizeof(double) * nb );
+    if( !job->x || !job->y || !job->z || !job->wx || !job->wy || !job->wz
+        || !job->s12 )
+        return 0;
+
+    if( use_workload )
+    {
+        /* the layout of -w over the box of the stage */
+        WorkloadSpec spec = workload;
+
+        spec.lon_min = stage->lon_min;
+        spec.lon_max = stage->lon_max;
+        spec.lat_min = stage->lat_min;
+        spec.lat_max = stage->lat_max;
+        spec.seed = seed;
+        if( stage->kind == BENCH_GEOD )
+            spec.nodata = 0.0;
+        workload_generate( &spec, n, job->x, job->y, NULL );
+    }
+    else
+    {
+        /* a small linear congruential generator, the same for all
+           platforms */
+        for( i = 0; i < n; i++ )
+        {
+            seed = seed * 1103515245u + 12345u;
+            job->x[i] = stage->lon_min + (stage->lon_max - stage->lon_min)
+                * ((seed >> 8) & 0xffff) / 65535.0;
+            seed = seed * 1103515245u + 12345u;
+            job->y[i] = stage->lat_min + (stage->lat_max - stage->lat_min)
+                * ((seed >> 8) & 0xffff) / 65535.0;
+        }
+    }
+
+    for( i = 0; i < n; i++ )
+    {
+        job->z[i] = 0.0;
+        if( stage->kind != BENCH_GEOD && job->x[i] != HUGE_VAL )
+        {
+            job->x[i] *= DEG_TO_RAD;
+            job->y[i] *= DEG_TO_RAD;
+        }
+    }
+
+    if( stage->kind == BENCH_INV )
+    {
+        /* the inverse runs on the projected points, those of a
+           workload failing to project being left at HUGE_VAL */
+        if( pj_fwd_array( job->src, n, 1, job->x, job->y ) != 0
+            && !use_workload )
+            return 0;
+    }
+    else if( stage->kind == BENCH_TRANSFORM )
+    {
+        /* load the grids now, and skip stages that cannot use them, on
+           the centre of the box as the points may be outside of them */
+        job->wx[0] = DEG_TO_RAD * (stage->lon_min + stage->lon_max) / 2;
+        job->wy[0] = DEG_TO_RAD * (stage->lat_min + stage->lat_max) / 2;
+        job->wz[0] = 0.0;
+        if( pj_transform( job->src, job->dst, 1, 0,
+                          job->wx, job->wy, job->wz ) != 0 )
+            return 0;
+    }
+    else if( stage->kind == BENCH_GEOD )
+    {
+        pj_get_spheroid_defn( job->src, &a, &es );
+        geod_init( &job->geod, a, 1 - sqrt(1 - es) );
+    }
+
+    return 1;
+}
+
+/************************************************************************/
+/*                            job_release()                             */
+/************************************************************************/
+
+static void job_release( BenchJob *job )
+
+{
+    if( job->src )
+        pj_free( job->src );
+    if( job->dst )
+        pj_free( job->dst );
+    free( job->x );
+    free( job->y );
+    free( job->z );
+    free( job->wx );
+    free( job->wy );
+    free( job->wz );
+    free( job->s12 );
+    if( job->ctx )
+        pj_ctx_free( job->ctx );
+}
+
+/************************************************************************/
+/*                              job_run()                               */
+/*                                                                      */
+/*      The timed work of one thread.  A batch of one uses the          */
+/*      single point entry points.                                      */
+/************************************************************************/
+
+static void job_run( void *arg )
+
+{
+    BenchJob *job = (BenchJob *) arg;
+    BenchStage *stage = job->stage;
+    long i, j, n;
+
+    if( stage->kind == BENCH_INIT || stage->kind == BENCH_INIT_CACHED )
+    {
+        for( i = 0; i < job->point_count; i++ )
+        {
+            projPJ pj = stage->kind == BENCH_INIT
+                ? pj_init_plus_ctx( job->ctx, stage->src_def )
+                : pj_init_plus_cached( job->ctx, stage->src_def );
+
+            if( pj == NULL )
+                job->error = 1;
+            else
+                pj_free( pj );
+        }
+        return;
+    }
+
+    for( i = 0; i < job->point_count; i += n )
+    {
+        n = job->point_count - i;
+        if( n > job->batch )
+            n = job->batch;
+
+        memcpy( job->wx, job->x + i, sizeof(double) * n );
+        memcpy( job->wy, job->y + i, sizeof(double) * n );
+
+        switch( stage->kind )
+        {
+          case BENCH_FWD:
+            if( n == 1 )
+            {
+                projLP lp;
+                projXY xy;
+
+                lp.u = job->wx[0];
+                lp.v = job->wy[0];
+                xy = pj_fwd( lp, job->src );
+                job->wx[0] = xy.u;
+                job->wy[0] = xy.v;
+            }
+            else
+                pj_fwd_array( job->src, n, 1, job->wx, job->wy );
+            break;
+
+          case BENCH_INV:
+            if( n == 1 )
+            {
+                projXY xy;
+                projLP lp;
+
+                xy.u = job->wx[0];
+                xy.v = job->wy[0];
+                lp = pj_inv( xy, job->src );
+                job->wx[0] = lp.u;
+                job->wy[0] = lp.v;
+            }
+            else
+                pj_inv_array( job->src, n, 1, job->wx, job->wy );
+            break;
+
+          case BENCH_TRANSFORM:
+            memcpy( job->wz, job->z + i, sizeof(double) * n );
+            if( pj_transform( job->src, job->dst, n, 1,
+                              job->wx, job->wy, job->wz ) != 0 )
+                job->error = 1;
+            break;
+
+          case BENCH_GEOD:
+            if( n == 1 )
+                geod_inverse( &job->geod, job->wy[0], job->wx[0],
+                              job->y[job->point_count - 1 - i],
+                              job->x[job->point_count - 1 - i],
+                              job->s12, NULL, NULL );
+            else
+            {
+                /* pair each point with one from the other end */
+                for( j = 0; j < n; j++ )
+                {
+                    job->wz[j] = job->y[job->point_count - 1 - i - j];
+                    job->s12[j] = job->x[job->point_count - 1 - i - j];
+                }
+                geod_inverse_n( &job->geod, n, job->wy, job->wx,
+                                job->wz, job->s12, job->s12, NULL, NULL );
+            }
+            break;
+
+          default:
+            break;
+        }
+    }
+}
+
+/************************************************************************/
+/*                             run_stage()                              */
+/*                                                                      */
+/*      Run a stage on thread_count threads, each with point_count      */
+/*      points, and return the elapsed seconds, or a negative value     */
+/*      if the stage cannot run.                                        */
+/************************************************************************/
+
+static double run_stage( BenchStage *stage, int thread_count,
+                         long point_count, long batch )
+
+{
+    BenchJob *jobs;
+    double start, elapsed = -1.0;
+    int i, ok = 1;
+
+    jobs = (BenchJob *) calloc( thread_count, sizeof(BenchJob) );
+    if( jobs == NULL )
+        return -1.0;
+
+    for( i = 0; i < thread_count && ok; i++ )
+    {
+        jobs[i].stage = stage;
+        jobs[i].point_count = point_count;
+        jobs[i].batch = batch;
+        ok = job_prepare( jobs + i, 17u * (i + 1) );
+    }
+
+    if( ok )
+    {
+        start = bench_now();
+        for( i = 1; i < thread_count; i++ )
+            jobs[i].thread = pj_thread_start( job_run, jobs + i );
+        job_run( jobs );
+        for( i = 1; i < thread_count; i++ )
+        {
+            if( jobs[i].thread )
+                pj_thread_join( jobs[i].thread );
+            else
+                job_run( jobs + i );
+        }
+        elapsed = bench_now() - start;
+
+        for( i = 0; i < thread_count; i++ )
+            if( jobs[i].error )
+                elapsed = -1.0;
+    }
+
+    for( i = 0; i < thread_count; i++ )
+        job_release( jobs + i );
+    free( jobs );
+
+    return elapsed;
+}
+
+/************************************************************************/
+/*                           sweep_prepare()                            */
+/*                                                                      */
+/*      Initialize projection id with variant (a sphere or an           */
+/*      ellipsoid), and set the points of its box, in radians, in lp.   */
+/*      Returns NULL if it cannot be initialized.                       */
+/************************************************************************/
+
+static projPJ sweep_prepare( projCtx ctx, const char *id, 
+                             const char *variant, long n, 
+                             double *lam, double *phi, char *defn )
+
+{
+    const SweepProj *sp = NULL;
+    double lon_min = -30, lon_max = 30, lat_min = -30, lat_max = 30;
+    unsigned seed = 17u;
+    projPJ pj;
+    int i;
+
+    for( i = 0; i < (int) (sizeof(sweep_list) / sizeof(SweepProj)); i++ )
+        if( strcmp( sweep_list[i].id, id ) == 0 )
+            sp = sweep_list + i;
+
+    sprintf( defn, "+proj=%s %s%s", id, sp != NULL ? sp->params : "",
+             variant );
+    pj = pj_init_plus_ctx( ctx, defn );
+    if( pj == NULL && sp == NULL )
+    {
+        sprintf( defn, "+proj=%s%s%s", id, SWEEP_EXTRA, variant );
+        pj = pj_init_plus_ctx( ctx, defn );
+    }
+    if( pj == NULL )
+        return NULL;
+
+    if( sp != NULL )
+    {
+        lon_min = sp->lon_min;
+        lon_max = sp->lon_max;
+        lat_min = sp->lat_min;
+        lat_max = sp->lat_max;
+    }
+    for( i = 0; i < n; i++ )
+    {
+        seed = seed * 1103515245u + 12345u;
+        lam[i] = DEG_TO_RAD * (lon_min + (lon_max - lon_min)
+                               * ((seed >> 8) & 0xffff) / 65535.0);
+        seed = seed * 1103515245u + 12345u;
+        phi[i] = DEG_TO_RAD * (lat_min + (lat_max - lat_min)
+                               * ((seed >> 8) & 0xffff) / 65535.0);
+    }
+
+    return pj;
+}
+
+/************************************************************************/
+/*                            sweep_output()                            */
+/************************************************************************/
+
+static void sweep_output( int json, int *first, const char *id, 
+                          const char *variant, long points, 
+                          const double *ns, int count )
+
+{
+    static const char *names[] = { "init_ns", "fwd_ns", "fwd_array_ns",
+                                   "inv_ns", "inv_array_ns" };
+    int i;
+
+    if( json )
+    {
+        printf( "%s\n  {\"projection\": \"%s\", \"variant\": \"%s\", "
+                "\"points\": %ld", *first ? "" : ",", id, variant, points );
+        for( i = 0; i < count; i++ )
+        {
+            if( ns[i] < 0.0 )
+                printf( ", \"%s\": null", names[i] );
+            else
+                printf( ", \"%s\": %.1f", names[i], ns[i] );
+        }
+        printf( "}" );
+    }
+    else
+    {
+        printf( "%s,%s,%ld", id, variant, points );
+        for( i = 0; i < count; i++ )
+        {
+            if( ns[i] < 0.0 )
+                printf( "," );
+            else
+                printf( ",%.1f", ns[i] );
+        }
+        printf( "\n" );
+    }
+    *first = 0;
+    fflush( stdout );
+}
+
+/************************************************************************/
+/*                             run_sweep()                              */
+/*                                                                      */
+/*      Time the initialization, and the forward and inverse of each    */
+/*      point alone and as arrays, of every projection of pj_list       */
+/*      whose id contains filter, in nanoseconds per call or point.     */
+/*      The inverse runs on the points the forward projected.           */
+/************************************************************************/
+
+static void run_sweep( long n, const char *filter, int json )
+
+{
+    static const char *variants[] = { SWEEP_SPHERE, SWEEP_ELLIPSOID };
+    static const char *variant_names[] = { "sph", "ell" };
+    struct PJ_LIST *entry;
+    projCtx ctx = pj_ctx_alloc();
+    double *lam, *phi, *x, *y, *wx, *wy;
+    long init_count = (n + 99) / 100;
+    char defn[256];
+    int first = 1;
+
+    lam = (double *) malloc( sizeof(double) * n );
+    phi = (double *) malloc( sizeof(double) * n );
+    x = (double *) malloc( sizeof(double) * n );
+    y = (double *) malloc( sizeof(double) * n );
+    wx = (double *) malloc( sizeof(double) * n );
+    wy = (double *) malloc( sizeof(double) * n );
+    if( ctx == NULL || !lam || !phi || !x || !y || !wx || !wy )
+    {
+        fprintf( stderr, "projbench: out of memory\n" );
+        exit( 1 );
+    }
+    ctx->errno_globals = 0;
+
+    if( json )
+        printf( "[" );
+    else
+        printf( "projection,variant,points,init_ns,fwd_ns,fwd_array_ns,"
+                "inv_ns,inv_array_ns\n" );
+
+    for( entry = pj_get_list_ref(); entry->id != NULL; entry++ )
+    {
+        int v;
+
+        if( filter != NULL && strstr( entry->id, filter ) == NULL )
+            continue;
+
+        for( v = 0; v < 2; v++ )
+        {
+            double ns[5], start;
+            long i, m;
+            projPJ pj;
+
+            pj = sweep_prepare( ctx, entry->id, variants[v], n, lam, phi, 
+                                defn );
+            if( pj == NULL )
+            {
+                fprintf( stderr, "%s,%s: skipped, initialization failed\n",
+                         entry->id, variant_names[v] );
+                continue;
+            }
+
+            start = bench_now();
+            for( i = 0; i < init_count; i++ )
+                pj_free( pj_init_plus_ctx( ctx, defn ) );
+            ns[0] = (bench_now() - start) * 1e9 / init_count;
+
+/* -------------------------------------------------------------------- */
+/*      Forward, keeping the points it projected for the inverse.       */
+/* -------------------------------------------------------------------- */
+            start = bench_now();
+            for( i = 0; i < n; i++ )
+            {
+                projLP lp;
+                projXY xy;
+
+                lp.u = lam[i];
+                lp.v = phi[i];
+                xy = pj_fwd( lp, pj );
+                x[i] = xy.u;
+                y[i] = xy.v;
+            }
+            ns[1] = (bench_now() - start) * 1e9 / n;
+
+            memcpy( wx, lam, sizeof(double) * n );
+            memcpy( wy, phi, sizeof(double) * n );
+            start = bench_now();
+            pj_fwd_array( pj, n, 1, wx, wy );
+            ns[2] = (bench_now() - start) * 1e9 / n;
+
+            for( i = 0, m = 0; i < n; i++ )
+            {
+                if( x[i] != HUGE_VAL )
+                {
+                    x[m] = x[i];
+                    y[m++] = y[i];
+                }
+            }
+
+/* -------------------------------------------------------------------- */
+/*      Inverse, if the projection has one.                             */
+/* -------------------------------------------------------------------- */
+            ns[3] = ns[4] = -1.0;
+            if( pj->inv != NULL && m > 0 )
+            {
+                start = bench_now();
+                for( i = 0; i < m; i++ )
+                {
+                    projXY xy;
+
+                    xy.u = x[i];
+                    xy.v = y[i];
+                    pj_inv( xy, pj );
+                }
+                ns[3] = (bench_now() - start) * 1e9 / m;
+
+                memcpy( wx, x, sizeof(double) * m );
+                memcpy( wy, y, sizeof(double) * m );
+                start = bench_now();
+                pj_inv_array( pj, m, 1, wx, wy );
+                ns[4] = (bench_now() - start) * 1e9 / m;
+            }
+
+            sweep_output( json, &first, entry->id, variant_names[v], m,
+                          ns, 5 );
+            pj_free( pj );
+        }
+    }
+
+    if( json )
+        printf( "\n]\n" );
+
+    free( lam );
+    free( phi );
+    free( x );
+    free( y );
+    free( wx );
+    free( wy );
+    pj_ctx_free( ctx );
+}
+
+/*
+** The replay of -r runs the cases of a corpus recorded by nad/testperf
+** from the nad/ test scripts through the library.  Each case is a line
+** "@", test, tool ("cs2cs" or "proj") and its arguments, separated by
+** tabs, followed by the input lines it was given.  The inputs of a
+** case are repeated in a random order up to the points asked for, and
+** run in batches for the throughput.  The latency percentiles are those
+** of single points.
+*/
+#define REPLAY_LINE_MAX  4096
+#define REPLAY_ARG_MAX   64
+#define REPLAY_LATENCY_MAX 20000
+
+typedef struct {
+    char        test[64];
+    int         index;          /* in its test, from 1 */
+    char        tool[16];
+    int         arg_count;
+    char        *args[REPLAY_ARG_MAX];
+    long        point_count;
+    long        point_alloc;
+    double      *x, *y, *z;     /* parsed input points */
+} ReplayCase;
+
+/************************************************************************/
+/*                          replay_compare()                            */
+/************************************************************************/
+
+static int replay_compare( const void *a, const void *b )
+
+{
+    double da = *(const double *) a, db = *(const double *) b;
+
+    return da < db ? -1 : da > db ? 1 : 0;
+}
+
+/************************************************************************/
+/*                          replay_defns()                              */
+/*                                                                      */
+/*      Initialize the definitions of a case, from and to in the        */
+/*      direction the tool runs them.  Returns 0 if one fails.          */
+/************************************************************************/
+
+static int replay_defns( projCtx ctx, ReplayCase *rc, projPJ *from, 
+                         projPJ *to, int *reversed )
+
+{
+    char defn[2][REPLAY_LINE_MAX];
+    int  i, side = 0, inverse = 0;
+    projPJ pj[2];
+
+    defn[0][0] = defn[1][0] = '\0';
+    *reversed = 0;
+    for( i = 0; i < rc->arg_count; i++ )
+    {
+        const char *arg = rc->args[i];
+
+        if( strcmp( arg, "+to" ) == 0 )
+            side = 1;
+        else if( arg[0] == '-' && arg[1] != '\0' && arg[2] == '\0'
+                 && strchr( "femjSdcCT", arg[1] ) != NULL )
+            i++;                /* options with a value */
+        else if( strcmp( arg, "-I" ) == 0 )
+            inverse = 1;
+        else if( strcmp( arg, "-r" ) == 0 )
+            *reversed = 1;
+        else if( arg[0] != '-' 
+                 && strlen( defn[side] ) + strlen( arg ) + 2 
+                    < REPLAY_LINE_MAX )
+        {
+            strcat( defn[side], " " );
+            strcat( defn[side], arg );
+        }
+    }
+
+    if( (pj[0] = pj_init_plus_ctx( ctx, defn[0] )) == NULL )
+        return 0;
+    if( strcmp( rc->tool, "proj" ) == 0 )
+        pj[1] = pj[0], pj[0] = pj_latlong_from_proj( pj[1] );
+    else
+        pj[1] = pj_init_plus_ctx( ctx, defn[1] );
+    if( pj[0] == NULL || pj[1] == NULL )
+    {
+        if( pj[0] != NULL )
+            pj_free( pj[0] );
+        if( pj[1] != NULL )
+            pj_free( pj[1] );
+        return 0;
+    }
+
+    *from = pj[inverse];
+    *to = pj[!inverse];
+
+    return 1;
+}
+
+/************************************************************************/
+/*                          replay_input()                              */
+/*                                                                      */
+/*      Parse an input line of a case, as the tools do, and add its     */
+/*      point.  Lines that are not points are ignored.                  */
+/************************************************************************/
+
+static void replay_input( ReplayCase *rc, projPJ from, int reversed,
+                          const char *line )
+
+{
+    double v[3];
+    char *next;
+    int i;
+
+    for( i = 0; i < 3; i++ )
+    {
+        while( *line == ' ' || *line == '\t' )
+            line++;
+        if( i < 2 && pj_is_latlong( from ) )
+            v[i] = dmstor( line, &next );
+        else
+            v[i] = strtod( line, &next );
+        if( next == line )
+        {
+            if( i < 2 )
+                return;
+            v[2] = 0.0;
+            break;
+        }
+        line = next;
+    }
+
+    if( rc->point_count == rc->point_alloc )
+    {
+        rc->point_alloc = rc->point_alloc * 2 + 16;
+        rc->x = (double *) realloc( rc->x, sizeof(double) * rc->point_alloc );
+        rc->y = (double *) realloc( rc->y, sizeof(double) * rc->point_alloc );
+        rc->z = (double *) realloc( rc->z, sizeof(double) * rc->point_alloc );
+        if( !rc->x || !rc->y || !rc->z )
+        {
+            fprintf( stderr, "projbench: out of memory\n" );
+            exit( 1 );
+        }
+    }
+    rc->x[rc->point_count] = reversed ? v[1] : v[0];
+    rc->y[rc->point_count] = reversed ? v[0] : v[1];
+    rc->z[rc->point_count++] = v[2];
+}
+
+/************************************************************************/
+/*                           replay_case()                              */
+/*                                                                      */
+/*      Time a case over n points in batches of batch, and print its    */
+/*      results.  Returns 0 if it cannot run.                           */
+/************************************************************************/
+
+static int replay_case( ReplayCase *rc, projPJ from, projPJ to, 
+                        long n, long batch )
+
+{
+    double *x, *y, *z, *wx, *wy, *wz, *latency, start, seconds;
+    long i, j, m, latency_count = n < REPLAY_LATENCY_MAX 
+        ? n : REPLAY_LATENCY_MAX;
+    long work = batch > rc->point_count ? batch : rc->point_count;
+    unsigned seed = 17u;
+    int ok = 1;
+
+    if( rc->point_count == 0 )
+        return 0;
+
+    x = (double *) malloc( sizeof(double) * n );
+    y = (double *) malloc( sizeof(double) * n );
+    z = (double *) malloc( sizeof(double) * n );
+    wx = (double *) malloc( sizeof(double) * work );
+    wy = (double *) malloc( sizeof(double) * work );
+    wz = (double *) malloc( sizeof(double) * work );
+    latency = (double *) malloc( sizeof(double) * latency_count );
+    if( !x || !y || !z || !wx || !wy || !wz || !latency )
+    {
+        fprintf( stderr, "projbench: out of memory\n" );
+        exit( 1 );
+    }
+
+    /* the inputs of the case repeated in a random order */
+    for( i = 0; i < n; i++ )
+    {
+        seed = seed * 1103515245u + 12345u;
+        j = (long) ((seed >> 8) % (unsigned) rc->point_count);
+        x[i] = rc->x[j];
+        y[i] = rc->y[j];
+        z[i] = rc->z[j];
+    }
+
+    /* the case must run as the test ran it, loading its grids */
+    memcpy( wx, rc->x, sizeof(double) * rc->point_count );
+    memcpy( wy, rc->y, sizeof(double) * rc->point_count );
+    memcpy( wz, rc->z, sizeof(double) * rc->point_count );
+    if( pj_transform( from, to, rc->point_count, 1, wx, wy, wz ) != 0 )
+        ok = 0;
+
+    start = bench_now();
+    for( i = 0; i < n && ok; i += m )
+    {
+        m = n - i < batch ? n - i : batch;
+        memcpy( wx, x + i, sizeof(double) * m );
+        memcpy( wy, y + i, sizeof(double) * m );
+        memcpy( wz, z + i, sizeof(double) * m );
+        pj_transform( from, to, m, 1, wx, wy, wz );
+    }
+    seconds = bench_now() - start;
+    if( seconds <= 0.0 )
+        seconds = 1e-9;
+
+    for( i = 0; i < latency_count && ok; i++ )
+    {
+        wx[0] = x[i];
+        wy[0] = y[i];
+        wz[0] = z[i];
+        start = bench_now();
+        pj_transform( from, to, 1, 0, wx, wy, wz );
+        latency[i] = (bench_now() - start) * 1e9;
+    }
+
+    if( ok )
+    {
+        qsort( latency, latency_count, sizeof(double), replay_compare );
+        printf( "lib,%s:%d,%ld,%.0f,%.0f,%.0f,%.0f\n", 
+                rc->test, rc->index, n, n / seconds,
+                latency[latency_count / 2], 
+                latency[latency_count * 9 / 10],
+                latency[latency_count * 99 / 100] );
+        fflush( stdout );
+    }
+
+    free( x );
+    free( y );
+    free( z );
+    free( wx );
+    free( wy );
+    free( wz );
+    free( latency );
+
+    return ok;
+}
+
+/************************************************************************/
+/*                            run_replay()                              */
+/************************************************************************/
+
+static void run_replay( const char *corpus, long n, long batch, 
+                        const char *filter )
+
+{
+    FILE *fp = fopen( corpus, "r" );
+    char line[REPLAY_LINE_MAX];
+    ReplayCase rc;
+    projCtx ctx = pj_ctx_alloc();
+    projPJ from = NULL, to = NULL;
+    int reversed = 0, have_case = 0, done = 0;
+
+    if( fp == NULL || ctx == NULL )
+    {
+        fprintf( stderr, "projbench: cannot read %s\n", corpus );
+        exit( 1 );
+    }
+    ctx->errno_globals = 0;
+    memset( &rc, 0, sizeof(rc) );
+
+    printf( "mode,case,points,points_per_second,p50_ns,p90_ns,p99_ns\n" );
+
+    while( !done )
+    {
+        char *eol;
+
+        done = fgets( line, sizeof(line), fp ) == NULL;
+        if( !done && (eol = strpbrk( line, "\r\n" )) != NULL )
+            *eol = '\0';
+
+        if( !done && line[0] != '@' )
+        {
+            if( have_case )
+                replay_input( &rc, from, reversed, line );
+            continue;
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Run the case read so far, then start the next one.              */
+/* -------------------------------------------------------------------- */
+        if( have_case )
+        {
+            if( !replay_case( &rc, from, to, n, batch ) )
+                fprintf( stderr, "%s:%d: skipped, transformation failed\n",
+                         rc.test, rc.index );
+            if( from != to )
+                pj_free( to );
+            pj_free( from );
+            have_case = 0;
+        }
+        for( ; rc.arg_count > 0; rc.arg_count-- )
+            free( rc.args[rc.arg_count - 1] );
+        rc.point_count = 0;
+        if( done )
+            break;
+
+        {
+            char test[64], *field, *rest = line + 1;
+            int  k = 0;
+
+            test[0] = '\0';
+            while( (field = strtok( rest, "\t" )) != NULL )
+            {
+                rest = NULL;
+                if( k == 0 )
+                    sprintf( test, "%.63s", field );
+                else if( k == 1 )
+                    sprintf( rc.tool, "%.15s", field );
+                else if( rc.arg_count < REPLAY_ARG_MAX )
+                {
+                    rc.args[rc.arg_count] = (char *) malloc( strlen(field)+1 );
+                    strcpy( rc.args[rc.arg_count++], field );
+                }
+                k++;
+            }
+            rc.index = strcmp( test, rc.test ) == 0 ? rc.index + 1 : 1;
+            strcpy( rc.test, test );
+        }
+
+        if( filter != NULL && strstr( rc.test, filter ) == NULL )
+            continue;
+        if( !replay_defns( ctx, &rc, &from, &to, &reversed ) )
+        {
+            fprintf( stderr, "%s:%d: skipped, initialization failed\n",
+                     rc.test, rc.index );
+            continue;
+        }
+        have_case = 1;
+    }
+
+    for( ; rc.arg_count > 0; rc.arg_count-- )
+        free( rc.args[rc.arg_count - 1] );
+    free( rc.x );
+    free( rc.y );
+    free( rc.z );
+    fclose( fp );
+    pj_ctx_free( ctx );
+}
+
+/*
+** The accuracy report of -e runs the implementations available for a
+** definition on random points of a lon/lat region, in degrees: the
+** definition as given, with each +accuracy= budget, with +approx=cheby
+** fitted to each budget over the region, with tmerc and etmerc swapped,
+** and, for a transformation "src +to dst", with its grids quantized to
+** each budget, see pj_ctx_set_grid_quantize().  There is no long double
+** or multiple precision evaluation of the projections, so the forward
+** error is taken against the definition at full accuracy, with etmerc
+** for tmerc, whose series are good to nanometres near the central
+** meridian.  The inverse runs on the points of the reference forward
+** and its error is taken against the points themselves, the exact
+** answer.  Errors are in metres, on the ellipsoid for angles.
+*/
+#define ACC_IMPL_MAX  32
+#define ACC_DEFN_MAX  1024
+#define ACC_REPEAT    3         /* runs timed of each direction */
+
+static const double acc_budgets[] = { 1e-4, 1e-3, 1e-2 };
+
+typedef struct {
+    char    name[64];
+    char    src[ACC_DEFN_MAX];      /* empty for a projection */
+    char    dst[ACC_DEFN_MAX];
+    double  quantize;
+    double  init_ms, fwd_pps, inv_pps;
+    double  fwd_max, fwd_rms, inv_max, inv_rms;
+    long    failed;
+    int     ok;
+} AccImpl;
+
+/************************************************************************/
+/*                              acc_add()                               */
+/************************************************************************/
+
+static void acc_add( AccImpl *list, int *count, const char *name,
+                     const char *src, const char *src_extra,
+                     const char *dst, const char *dst_extra,
+                     double quantize )
+
+{
+    AccImpl *impl;
+
+    if( *count == ACC_IMPL_MAX
+        || strlen( src ) + strlen( src_extra ) >= ACC_DEFN_MAX
+        || strlen( dst ) + strlen( dst_extra ) >= ACC_DEFN_MAX )
+        return;
+
+    impl = list + (*count)++;
+    memset( impl, 0, sizeof(AccImpl) );
+    sprintf( impl->name, "%.63s", name );
+    if( *src != '\0' )
+        sprintf( impl->src, "%s%s", src, src_extra );
+    sprintf( impl->dst, "%s%s", dst, dst_extra );
+    impl->quantize = quantize;
+}
+
+/************************************************************************/
+/*                           acc_swap_tmerc()                           */
+/*                                                                      */
+/*      Copy defn with +proj=tmerc and +proj=etmerc swapped into out.   */
+/*      Returns FALSE if it has neither.                                */
+/************************************************************************/
+
+static int acc_swap_tmerc( const char *defn, char *out )
+
+{
+    const char *tm = strstr( defn, "+proj=tmerc" );
+    const char *etm = strstr( defn, "+proj=etmerc" );
+
+    if( strlen( defn ) + 2 >= ACC_DEFN_MAX )
+        return 0;
+    if( tm != NULL && (tm[11] == ' ' || tm[11] == '\0') )
+        sprintf( out, "%.*s+proj=etmerc%s", (int) (tm - defn), defn,
+                 tm + 11 );
+    else if( etm != NULL && (etm[12] == ' ' || etm[12] == '\0') )
+        sprintf( out, "%.*s+proj=tmerc%s", (int) (etm - defn), defn,
+                 etm + 12 );
+    else
+        return 0;
+
+    return 1;
+}
+
+/************************************************************************/
+/*                           acc_projected()                            */
+/************************************************************************/
+
+static int acc_projected( const char *defn )
+
+{
+    return *defn != '\0' && strstr( defn, "+proj=latlong" ) == NULL
+        && strstr( defn, "+proj=longlat" ) == NULL
+        && strstr( defn, "+proj=latlon" ) == NULL
+        && strstr( defn, "+proj=lonlat" ) == NULL;
+}
+
+/************************************************************************/
+/*                         acc_implementations()                        */
+/*                                                                      */
+/*      Fill list with the implementations of the definition, the      */
+/*      first being the one as given.  Returns their count.             */
+/************************************************************************/
+
+static int acc_implementations( const char *src, const char *dst,
+                                const char *region, AccImpl *list )
+
+{
+    char extra[256], name[64], swapped[ACC_DEFN_MAX];
+    int count = 0, b;
+    int budget_count = sizeof(acc_budgets) / sizeof(double);
+
+    acc_add( list, &count, "exact", src, "", dst, "", 0.0 );
+
+    for( b = 0; b < budget_count; b++ )
+    {
+        sprintf( name, "accuracy=%g", acc_budgets[b] );
+        sprintf( extra, " +accuracy=%g", acc_budgets[b] );
+        acc_add( list, &count, name, src, *src ? extra : "", dst, extra,
+                 0.0 );
+    }
+
+    for( b = 0; b < budget_count && strlen( region ) < 128
+             && (acc_projected( src ) || acc_projected( dst )); b++ )
+    {
+        sprintf( name, "cheby=%g", acc_budgets[b] );
+        sprintf( extra, " +approx=cheby +approx_region=%s +approx_tol=%g",
+                 region, acc_budgets[b] );
+        acc_add( list, &count, name, src, acc_projected( src ) ? extra : "",
+                 dst, acc_projected( dst ) ? extra : "", 0.0 );
+    }
+
+    if( acc_swap_tmerc( dst, swapped ) )
+    {
+        const char *id = strstr( swapped, "+proj=etmerc" ) ? "etmerc"
+                                                          : "tmerc";
+
+        acc_add( list, &count, id, src, "", swapped, "", 0.0 );
+        for( b = 0; b < budget_count; b++ )
+        {
+            sprintf( name, "%s,accuracy=%g", id, acc_budgets[b] );
+            sprintf( extra, " +accuracy=%g", acc_budgets[b] );
+            acc_add( list, &count, name, src, *src ? extra : "", swapped,
+                     extra, 0.0 );
+        }
+    }
+
+    if( *src != '\0' )
+    {
+        for( b = 0; b < budget_count; b++ )
+        {
+            sprintf( name, "quantize=%g", acc_budgets[b] );
+            acc_add( list, &count, name, src, "", dst, "", acc_budgets[b] );
+        }
+    }
+
+    return count;
+}
+
+/************************************************************************/
+/*                            acc_metres()                              */
+/*                                                                      */
+/*      The distance between two points of the coordinates of pj.       */
+/************************************************************************/
+
+static double acc_metres( projPJ pj, double x0, double y0, double z0,
+                          double x1, double y1, double z1 )
+
+{
+    PJ *P = (PJ *) pj;
+    double dx, dy, dz = (z1 - z0) * P->cold->vto_meter;
+
+    if( pj_is_latlong( pj ) )
+    {
+        dx = adjlon( x1 - x0 ) * cos( y0 ) * P->a;
+        dy = (y1 - y0) * P->a;
+    }
+    else
+    {
+        dx = (x1 - x0) * P->to_meter;
+        dy = (y1 - y0) * P->to_meter;
+    }
+
+    return sqrt( dx * dx + dy * dy + dz * dz );
+}
+
+/************************************************************************/
+/*                              acc_run()                               */
+/*                                                                      */
+/*      Run one direction of from to to, or the inverse of to if from   */
+/*      is NULL, ACC_REPEAT times on the n points of ix, iy and iz      */
+/*      copied to x, y and z.  Returns the fewest seconds taken.        */
+/************************************************************************/
+
+static double acc_run( projPJ from, projPJ to, int inverse, long n,
+                       const double *ix, const double *iy, const double *iz,
+                       double *x, double *y, double *z )
+
+{
+    double best = HUGE_VAL;
+    int r;
+
+    for( r = 0; r < ACC_REPEAT; r++ )
+    {
+        double start;
+
+        memcpy( x, ix, sizeof(double) * n );
+        memcpy( y, iy, sizeof(double) * n );
+        memcpy( z, iz, sizeof(double) * n );
+
+        start = bench_now();
+        if( from == NULL && !inverse )
+            pj_fwd_array( to, n, 1, x, y );
+        else if( from == NULL )
+            pj_inv_array( to, n, 1, x, y );
+        else if( !inverse )
+            pj_transform( from, to, n, 1, x, y, z );
+        else
+            pj_transform( to, from, n, 1, x, y, z );
+        if( bench_now() - start < best )
+            best = bench_now() - start;
+    }
+
+    return best > 0.0 ? best : 1e-9;
+}
+
+/************************************************************************/
+/*                             acc_errors()                             */
+/*                                                                      */
+/*      Compare the n points of x, y and z with those of the reference  */
+/*      in the coordinates of pj.  Returns the points failed.           */
+/************************************************************************/
+
+static long acc_errors( projPJ pj, long n, const double *x, const double *y,
+                        const double *z, const double *rx, const double *ry,
+                        const double *rz, double *max, double *rms )
+
+{
+    double sum = 0.0;
+    long i, failed = 0;
+
+    *max = 0.0;
+    for( i = 0; i < n; i++ )
+    {
+        double e;
+
+        if( x[i] == HUGE_VAL || y[i] == HUGE_VAL )
+        {
+            failed++;
+            continue;
+        }
+        e = acc_metres( pj, rx[i], ry[i], rz[i], x[i], y[i], z[i] );
+        if( e > *max )
+            *max = e;
+        sum += e * e;
+    }
+    *rms = n > failed ? sqrt( sum / (n - failed) ) : 0.0;
+
+    return failed;
+}
+
+/************************************************************************/
+/*                            acc_output()                              */
+/************************************************************************/
+
+static void acc_output( int json, int first, const AccImpl *impl,
+                        long points, const char *pareto )
+
+{
+    if( json )
+    {
+        printf( "%s\n  {\"implementation\": \"%s\", \"points\": %ld, "
+                "\"init_ms\": %.3f, \"fwd_points_per_second\": %.0f, "
+                "\"fwd_max_m\": %.3g, \"fwd_rms_m\": %.3g",
+                first ? "" : ",", impl->name, points, impl->init_ms,
+                impl->fwd_pps, impl->fwd_max, impl->fwd_rms );
+        if( impl->inv_pps < 0.0 )
+            printf( ", \"inv_points_per_second\": null, "
+                    "\"inv_max_m\": null, \"inv_rms_m\": null" );
+        else
+            printf( ", \"inv_points_per_second\": %.0f, "
+                    "\"inv_max_m\": %.3g, \"inv_rms_m\": %.3g",
+                    impl->inv_pps, impl->inv_max, impl->inv_rms );
+        printf( ", \"failed\": %ld, \"pareto\": \"%s\"}", impl->failed,
+                pareto );
+    }
+    else
+    {
+        printf( "%s,%ld,%.3f,%.0f,%.3g,%.3g", impl->name, points,
+                impl->init_ms, impl->fwd_pps, impl->fwd_max,
+                impl->fwd_rms );
+        if( impl->inv_pps < 0.0 )
+            printf( ",,," );
+        else
+            printf( ",%.0f,%.3g,%.3g", impl->inv_pps, impl->inv_max,
+                    impl->inv_rms );
+        printf( ",%ld,%s\n", impl->failed, pareto );
+    }
+}
+
+/************************************************************************/
+/*                           acc_dominated()                            */
+/*                                                                      */
+/*      Is impl beaten on both the throughput and the maximum error of  */
+/*      a direction by another, or failing points?                      */
+/************************************************************************/
+
+static int acc_dominated( const AccImpl *list, int count, int impl,
+                          int inverse )
+
+{
+    const AccImpl *a = list + impl;
+    double pps = inverse ? a->inv_pps : a->fwd_pps;
+    double err = inverse ? a->inv_max : a->fwd_max;
+    int j;
+
+    if( !a->ok || a->failed > 0 || pps < 0.0 )
+        return 1;
+
+    for( j = 0; j < count; j++ )
+    {
+        const AccImpl *b = list + j;
+        double b_pps = inverse ? b->inv_pps : b->fwd_pps;
+        double b_err = inverse ? b->inv_max : b->fwd_max;
+
+        if( j != impl && b->ok && b->failed == 0 && b_pps >= pps
+            && b_err <= err && (b_pps > pps || b_err < err) )
+            return 1;
+    }
+
+    return 0;
+}
+
+/************************************************************************/
+/*                            run_accuracy()                            */
+/*                                                                      */
+/*      Print the init time, throughput and errors of each              */
+/*      implementation of defn on n points of region, and which are on  */
+/*      the Pareto front of throughput and maximum error, going         */
+/*      forward, back or both.                                          */
+/************************************************************************/
+
+static void run_accuracy( const char *defn, const char *region, long n,
+                          int json )
+
+{
+    static AccImpl list[ACC_IMPL_MAX];
+    char src[ACC_DEFN_MAX], dst[ACC_DEFN_MAX], ref_defn[ACC_DEFN_MAX];
+    const char *to = strstr( defn, "+to " );
+    double w, s, e, nn;
+    double *ix, *iy, *iz, *rx, *ry, *rz, *x, *y, *z;
+    projCtx ref_ctx = pj_ctx_alloc();
+    projPJ ref_from = NULL, ref_to;
+    unsigned seed = 17u;
+    long i, m;
+    int count, k, first = 1;
+
+    if( sscanf( region, "%lf,%lf,%lf,%lf", &w, &s, &e, &nn ) != 4
+        || !(w < e) || !(s < nn) || strlen( defn ) >= ACC_DEFN_MAX )
+    {
+        fprintf( stderr, "projbench: bad definition or region %s\n",
+                 region );
+        exit( 1 );
+    }
+
+    src[0] = '\0';
+    if( to != NULL && (to == defn || to[-1] == ' ') )
+    {
+        sprintf( src, "%.*s", (int) (to - defn), defn );
+        strcpy( dst, to + 4 );
+    }
+    else
+        strcpy( dst, defn );
+    count = acc_implementations( src, dst, region, list );
+
+    ix = (double *) malloc( sizeof(double) * n * 9 );
+    if( ix == NULL || ref_ctx == NULL )
+    {
+        fprintf( stderr, "projbench: out of memory\n" );
+        exit( 1 );
+    }
+    iy = ix + n; iz = iy + n;
+    rx = iz + n; ry = rx + n; rz = ry + n;
+    x = rz + n; y = x + n; z = y + n;
+    ref_ctx->errno_globals = 0;
+
+/* -------------------------------------------------------------------- */
+/*      The reference, and the points it projects or transforms.        */
+/* -------------------------------------------------------------------- */
+    if( !acc_swap_tmerc( dst, ref_defn )
+        || strstr( ref_defn, "+proj=etmerc" ) == NULL )
+        strcpy( ref_defn, dst );
+    if( (ref_to = pj_init_plus_ctx( ref_ctx, ref_defn )) == NULL
+        || (*src && (ref_from = pj_init_plus_ctx( ref_ctx, src )) == NULL) )
+    {
+        fprintf( stderr, "projbench: cannot initialize %s\n", defn );
+        exit( 1 );
+    }
+
+    for( i = 0; i < n; i++ )
+    {
+        seed = seed * 1103515245u + 12345u;
+        ix[i] = DEG_TO_RAD * (w + (e - w) * ((seed >> 8) & 0xffff) / 65535.0);
+        seed = seed * 1103515245u + 12345u;
+        iy[i] = DEG_TO_RAD * (s + (nn - s) * ((seed >> 8) & 0xffff)
+                              / 65535.0);
+        iz[i] = 0.0;
+    }
+    if( ref_from != NULL && !pj_is_latlong( ref_from ) )
+    {
+        projPJ geo = pj_latlong_from_proj( ref_from );
+
+        pj_transform( geo, ref_from, n, 1, ix, iy, iz );
+        pj_free( geo );
+    }
+
+    acc_run( ref_from, ref_to, 0, n, ix, iy, iz, rx, ry, rz );
+    for( i = 0, m = 0; i < n; i++ )
+    {
+        if( ix[i] == HUGE_VAL || rx[i] == HUGE_VAL || ry[i] == HUGE_VAL )
+            continue;
+        ix[m] = ix[i]; iy[m] = iy[i]; iz[m] = iz[i];
+        rx[m] = rx[i]; ry[m] = ry[i]; rz[m] = rz[i];
+        m++;
+    }
+    if( m == 0 )
+    {
+        fprintf( stderr, "projbench: no point of %s in the region\n", defn );
+        exit( 1 );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Each implementation in its own context, with its own grids      */
+/*      when they are quantized.                                        */
+/* -------------------------------------------------------------------- */
+    for( k = 0; k < count; k++ )
+    {
+        AccImpl *impl = list + k;
+        projCtx ctx = pj_ctx_alloc();
+        projGridRegistry registry = NULL;
+        projPJ from = NULL, pj;
+        double start, seconds;
+
+        ctx->errno_globals = 0;
+        if( impl->quantize > 0.0 )
+        {
+            registry = pj_grid_registry_alloc();
+            pj_ctx_set_grid_registry( ctx, registry );
+            pj_ctx_set_grid_quantize( ctx, impl->quantize );
+        }
+
+        start = bench_now();
+        pj = pj_init_plus_ctx( ctx, impl->dst );
+        if( pj != NULL && *src
+            && (from = pj_init_plus_ctx( ctx, impl->src )) == NULL )
+        {
+            pj_free( pj );
+            pj = NULL;
+        }
+        impl->init_ms = (bench_now() - start) * 1e3;
+
+        if( pj == NULL )
+            fprintf( stderr, "%s: skipped, initialization failed\n",
+                     impl->name );
+        else
+        {
+            seconds = acc_run( from, pj, 0, m, ix, iy, iz, x, y, z );
+            impl->fwd_pps = m / seconds;
+            impl->failed = acc_errors( ref_to, m, x, y, z, rx, ry, rz,
+                                       &impl->fwd_max, &impl->fwd_rms );
+
+            impl->inv_pps = -1.0;
+            if( from != NULL || ((PJ *) pj)->inv != NULL )
+            {
+                seconds = acc_run( from, pj, 1, m, rx, ry, rz, x, y, z );
+                impl->inv_pps = m / seconds;
+                impl->failed += acc_errors( from != NULL ? from : ref_to,
+                                            m, x, y, z, ix, iy, iz,
+                                            &impl->inv_max,
+                                            &impl->inv_rms );
+            }
+            impl->ok = 1;
+        }
+
+        pj_free( from );
+        pj_free( pj );
+        pj_ctx_free( ctx );
+        if( registry != NULL )
+            pj_grid_registry_free( registry );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      The table.                                                      */
+/* -------------------------------------------------------------------- */
+    if( json )
+        printf( "[" );
+    else
+        printf( "implementation,points,init_ms,fwd_points_per_second,"
+                "fwd_max_m,fwd_rms_m,inv_points_per_second,inv_max_m,"
+                "inv_rms_m,failed,pareto\n" );
+
+    for( k = 0; k < count; k++ )
+    {
+        int fwd_front = !acc_dominated( list, count, k, 0 );
+        int inv_front = !acc_dominated( list, count, k, 1 );
+
+        if( !list[k].ok )
+            continue;
+        acc_output( json, first, list + k, m,
+                    fwd_front && inv_front ? "fwd+inv"
+                    : fwd_front ? "fwd" : inv_front ? "inv" : "" );
+        first = 0;
+    }
+
+    if( json )
+        printf( "\n]\n" );
+
+    pj_free( ref_from );
+    pj_free( ref_to );
+    pj_ctx_free( ref_ctx );
+    free( ix );
+}
+
+/************************************************************************/
+/*                               Usage()                                */
+/************************************************************************/
+
+static void Usage()
+
+{
+    printf( "Usage: projbench [-t threads,...] [-b batch,...] [-n points]\n"
+            "                 [-p none|advise|explicit] [-w kind[,nodata]]\n"
+            "                 [-s stage] [-l]\n"
+            "       projbench -a [-j] [-n points] [-s projection]\n"
+            "       projbench -r corpus [-b batch] [-n points] [-s test]\n"
+            "       projbench -e definition -R w,s,e,n [-j] [-n points]\n"
+            "       projbench -T file\n"
+            "\n"
+            "  -t: thread counts to run each stage with (1,2,4,8)\n"
+            "  -b: batch sizes of the point stages (1,16,256,4096)\n"
+            "  -n: points per thread of the point stages (200000),\n"
+            "      the init stages run n/100 initializations\n"
+            "  -p: huge pages for the values of grids (none), see\n"
+            "      pj_ctx_set_grid_huge_pages()\n"
+            "  -w: the layout of the points of the point stages over\n"
+            "      their boxes, uniform, track, lattice, poi or global,\n"
+            "      and the fraction of them at HUGE_VAL, see projgen\n"
+            "  -s: only run the stages whose name contains stage\n"
+            "  -l: list the stages\n"
+            "  -a: time each projection of pj_list instead, in nanoseconds\n"
+            "      per initialization or point, with a sphere and an\n"
+            "      ellipsoid; -s only runs the projections whose id\n"
+            "      contains projection\n"
+            "  -j: print the times of -a as JSON\n"
+            "  -r: replay the cases of a corpus of nad/testperf instead,\n"
+            "      each over n points in batches of the first batch\n"
+            "      size (4096); -s only runs the cases of the tests whose\n"
+            "      name contains test\n"
+            "  -e: report the init time, throughput and errors in metres\n"
+            "      of the implementations of a definition, or \"src +to\n"
+            "      dst\", instead, on n points of the lon/lat region of -R,\n"
+            "      in degrees, with those on the Pareto front of throughput\n"
+            "      and maximum error; -j prints them as JSON\n"
+            "  -T: tune the batch settings to this host, see pj_ctx_tune(),\n"
+            "      and write them to file, for PROJ_TUNE_FILE\n"
+            "\n"
+            "The results are printed as comma separated values, the speedup\n"
+            "being relative to the first thread count of the same batch.\n" );
+    exit( 1 );
+}
+
+/************************************************************************/
+/*                                main()                                */
+/************************************************************************/
+
+int main( int argc, char **argv )
+
+{
+    long thread_counts[MAX_COUNTS] = { 1, 2, 4, 8 };
+    long batches[MAX_COUNTS] = { 1, 16, 256, 4096 };
+    int thread_n = 4, batch_n = 4;
+    long point_count = 200000;
+    const char *filter = NULL;
+    int stage_count = sizeof(stage_list) / sizeof(BenchStage);
+    int sweep = 0, json = 0, batch_set = 0;
+    const char *corpus = NULL, *defn = NULL, *region = NULL;
+    const char *tune_file = NULL;
+    int i, s, t, b;
+
+    for( i = 1; i < argc; i++ )
+    {
+        if( strcmp(argv[i], "-t") == 0 && i + 1 < argc )
+        {
+            if( (thread_n = parse_counts( argv[++i], thread_counts )) == 0 )
+                Usage();
+        }
+        else if( strcmp(argv[i], "-b") == 0 && i + 1 < argc )
+        {
+            if( (batch_n = parse_counts( argv[++i], batches )) == 0 )
+                Usage();
+            batch_set = 1;
+        }
+        else if( strcmp(argv[i], "-n") == 0 && i + 1 < argc )
+        {
+            if( (point_count = atol( argv[++i] )) <= 0 )
+                Usage();
+        }
+        else if( strcmp(argv[i], "-p") == 0 && i + 1 < argc )
+        {
+            i++;
+            if( strcmp(argv[i], "none") == 0 )
+                huge_pages = PJ_HUGE_PAGES_NONE;
+            else if( strcmp(argv[i], "advise") == 0 )
+                huge_pages = PJ_HUGE_PAGES_ADVISE;
+            else if( strcmp(argv[i], "explicit") == 0 )
+                huge_pages = PJ_HUGE_PAGES_EXPLICIT;
+            else
+                Usage();
+        }
+        else if( strcmp(argv[i], "-w") == 0 && i + 1 < argc )
+        {
+            workload_init( &workload, WORKLOAD_UNIFORM );
+            if( !workload_parse( &workload, argv[++i] ) )
+                Usage();
+            use_workload = 1;
+        }
+        else if( strcmp(argv[i], "-s") == 0 && i + 1 < argc )
+            filter = argv[++i];
+        else if( strcmp(argv[i], "-a") == 0 )
+            sweep = 1;
+        else if( strcmp(argv[i], "-j") == 0 )
+            json = 1;
+        else if( strcmp(argv[i], "-r") == 0 && i + 1 < argc )
+            corpus = argv[++i];
+        else if( strcmp(argv[i], "-e") == 0 && i + 1 < argc )
+            defn = argv[++i];
+        else if( strcmp(argv[i], "-R") == 0 && i + 1 < argc )
+            region = argv[++i];
+        else if( strcmp(argv[i], "-T") == 0 && i + 1 < argc )
+            tune_file = argv[++i];
+        else if( strcmp(argv[i], "-l") == 0 )
+        {
+            for( s = 0; s < stage_count; s++ )
+                printf( "%s\n", stage_list[s].name );
+            exit( 0 );
+        }
+        else
+            Usage();
+    }
+
+    if( tune_file != NULL )
+    {
+        projCtx ctx = pj_ctx_alloc();
+
+        if( pj_ctx_tune( ctx, tune_file ) != 0 )
+        {
+            fprintf( stderr, "projbench: tuning failed: %s\n",
+                     pj_strerrno( pj_ctx_get_errno( ctx ) ) );
+            return 1;
+        }
+        printf( "threads,batch_grain,batch_min_split,array_chunk\n"
+                "%d,%ld,%ld,%d\n", pj_ctx_get_threads( ctx ),
+                pj_ctx_get_batch_grain( ctx ),
+                pj_ctx_get_batch_min_split( ctx ),
+                pj_ctx_get_array_chunk( ctx ) );
+        pj_ctx_free( ctx );
+        return 0;
+    }
+
+    if( defn != NULL )
+    {
+        if( region == NULL )
+            Usage();
+        run_accuracy( defn, region, point_count, json );
+        return 0;
+    }
+
+    if( corpus != NULL )
+    {
+        run_replay( corpus, point_count, batch_set ? batches[0] : 4096,
+                    filter );
+        return 0;
+    }
+
+    if( sweep )
+    {
+        run_sweep( point_count, filter, json );
+        return 0;
+    }
+
+    printf( "stage,threads,batch,points,seconds,points_per_second,speedup\n" );
+
+    for( s = 0; s < stage_count; s++ )
+    {
+        BenchStage *stage = stage_list + s;
+        int is_init = (stage->kind == BENCH_INIT
+                       || stage->kind == BENCH_INIT_CACHED);
+        long count = is_init ? (point_count + 99) / 100 : point_count;
+
+        if( filter != NULL && strstr( stage->name, filter ) == NULL )
+            continue;
+
+        for( b = 0; b < (is_init ? 1 : batch_n); b++ )
+        {
+            long batch = is_init ? 1 : batches[b];
+            double base_rate = 0.0;
+
+            for( t = 0; t < thread_n; t++ )
+            {
+                double seconds, rate;
+                long total = count * thread_counts[t];
+
+                seconds = run_stage( stage, (int) thread_counts[t],
+                                     count, batch );
+                if( seconds < 0.0 )
+                {
+                    fprintf( stderr, "%s: skipped, initialization or "
+                             "transformation failed\n", stage->name );
+                    b = batch_n;
+                    break;
+                }
+                if( seconds <= 0.0 )
+                    seconds = 1e-9;
+                rate = total / seconds;
+                if( t == 0 )
+                    base_rate = rate;
+                printf( "%s,%ld,%ld,%ld,%.6f,%.0f,%.3f\n",
+                        stage->name, thread_counts[t], batch, total,
+                        seconds, rate, rate / base_rate );
+                fflush( stdout );
+            }
+        }
+    }
+
+    return 0;
+}
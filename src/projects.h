@@ -122,14 +122,63 @@ extern double hypot(double, double);
 #endif
 
 struct projFileAPI_t;
+struct projFileMapAPI_t;
+struct projFileAPIEx_t;
+struct PJ_GRID_TILE_t;
+struct PJ_GRID_REGISTRY_t;
+struct PJ_STATS_t;
+struct projLogRecord_t;
+struct projPlanBackend_t;
+
+/* pj_log() sites whose messages can repeat for every point are limited
+   to PJ_LOG_SITE_LIMIT messages per context, see pj_log_site_wanted() */
+#define PJ_LOG_SITE_GRID_USED    0
+#define PJ_LOG_SITE_GRID_MISSED  1
+#define PJ_LOG_SITE_VGRID_USED   2
+#define PJ_LOG_SITE_GRID_INVERSE 3
+#define PJ_LOG_SITE_COUNT        4
+#define PJ_LOG_SITE_LIMIT        20
+
+/* memory of a context, see pj_ctx_set_allocator().  NULL alloc for 
+   pj_malloc() and pj_dalloc(). */
+typedef struct {
+    void    *(*alloc)(void *, size_t);
+    void    (*dalloc)(void *, void *);
+    void    *user_data;
+} PJ_ALLOCATOR;
 
 /* proj thread context */
 typedef struct {
     int	    last_errno;
     int     debug_level;
     void    (*logger)(void *, int, const char *);
+    void    (*record_logger)(void *, const struct projLogRecord_t *);
+    int     log_site_count[PJ_LOG_SITE_COUNT]; /* messages sent per site */
     void    *app_data;
     struct projFileAPI_t *fileapi;
+    struct projFileMapAPI_t *filemapapi; /* NULL if mapping unsupported */
+    struct projFileAPIEx_t *fileapi_ex; /* NULL for fileapi alone */
+    struct PJ_GRID_TILE_t *grid_tiles; /* most recently used first */
+    int     grid_tile_count;
+    int     grid_tile_limit; /* 0 to load whole grids */
+    struct PJ_GRID_REGISTRY_t *grid_registry; /* NULL for the default */
+    int     errno_globals; /* also set the global pj_errno and errno */
+    int     inverse_grids; /* apply reverse shifts with inverse tables */
+    struct PJ_STATS_t *stats; /* NULL unless pj_ctx_set_stats() enabled */
+    int     threads; /* threads sharing large batches, see pj_ctx_set_threads() */
+    long    grid_sort_threshold; /* see pj_ctx_set_grid_sort_threshold() */
+    long    batch_grain; /* see pj_ctx_set_batch_grain() */
+    long    batch_min_split; /* see pj_ctx_set_batch_min_split() */
+    int     array_chunk; /* see pj_ctx_set_array_chunk() */
+    PJ_ALLOCATOR allocator; /* of grid values, tiles and catalogs */
+    int     grid_huge_pages; /* see pj_ctx_set_grid_huge_pages() */
+    int     grid_row_pairs; /* see pj_ctx_set_grid_row_pairs() */
+    double  grid_quantize; /* see pj_ctx_set_grid_quantize() */
+    int     grid_shm; /* see pj_ctx_set_grid_shm() */
+    int     init_shm; /* see pj_ctx_set_init_shm() */
+    int     grid_nonblocking; /* see pj_ctx_set_grid_nonblocking() */
+    int     low_memory; /* see pj_ctx_set_low_memory() */
+    int     isa_limit; /* see pj_ctx_set_isa() */
 } projCtx_t;
 
 /* datum_type values */
@@ -144,6 +193,8 @@ typedef struct {
 #define PJD_ERR_AXIS                -47
 #define PJD_ERR_GRID_AREA           -48
 #define PJD_ERR_CATALOG             -49
+#define PJD_ERR_GRID_NOT_READY      -54
+#define PJD_ERR_NOT_FROZEN          -55
 
 #define USE_PROJUV 
 
@@ -215,40 +266,41 @@ struct FACTORS {
 #define IS_ANAL_XP_YP 02	/* derivatives of lat analytic */
 #define IS_ANAL_HK	04		/* h and k analytic */
 #define IS_ANAL_CONV 010	/* convergence analytic */
+    /* conformal to geodetic latitude series, see pj_phi2.c */
+#define PJ_PHI2_ORDER 6
+struct PJ_PHI2 {
+	double e;
+	int series;	/* cgb alone is exact to rounding for e */
+	double cgb[PJ_PHI2_ORDER];
+};
     /* parameter list struct */
 typedef struct ARG_list {
 	struct ARG_list *next;
+	struct PJ_PARAM_INDEX *index; /* lookup index, see pj_param.c */
 	char used;
-	char param[1]; } paralist;
-	/* base projection data structure */
+	char in_arena; /* freed with the arena of its PJ, not on its own */
+	char typed; /* value holds the parameter, see pj_def.c */
+	char formatted; /* param of a typed parameter is name=value */
+	double value;
+	const char *param; /* shared with other lists, see pj_intern.c */
+	} paralist;
+
+    /* objects set up with a PJ and freed with it, see pj_arena.c */
+typedef struct PJ_ARENA_s {
+	struct PJ_ARENA_s *next;
+	size_t size, used;
+} PJ_ARENA;
+
+    /* members of a PJ set up with it, or used once per call of
+       pj_transform() rather than for each point, kept apart from the
+       projection constants, see PJ_COLD_OFFSET() */
+typedef struct PJ_COLD_s {
+        PJ_ARENA *arena; /* of the parameters, NULL if none */
+        paralist *last_defn_param; /* end of the definition, later ones are
+                                      added by pj_datum_set() */
+        double  a_orig; /* major axis before any +proj related adjustment */
+        double  es_orig; /* es before any +proj related adjustment */
 
-
-typedef struct PJconsts {
-    projCtx_t *ctx;
-	XY  (*fwd)(LP, struct PJconsts *);
-	LP  (*inv)(XY, struct PJconsts *);
-	void (*spc)(LP, struct PJconsts *, struct FACTORS *);
-	void (*pfree)(struct PJconsts *);
-	const char *descr;
-	paralist *params;   /* parameter list */
-	int over;   /* over-range flag */
-	int geoc;   /* geocentric latitude flag */
-        int is_latlong; /* proj=latlong ... not really a projection at all */
-        int is_geocent; /* proj=geocent ... not really a projection at all */
-	double
-		a,  /* major axis or radius if es==0 */
-                a_orig, /* major axis before any +proj related adjustment */
-		es, /* e ^ 2 */
-                es_orig, /* es before any +proj related adjustment */
-		e,  /* eccentricity */
-		ra, /* 1/A */
-		one_es, /* 1 - e^2 */
-		rone_es, /* 1/one_es */
-		lam0, phi0, /* central longitude, latitude */
-		x0, y0, /* easting and northing */
-		k0,	/* general scaling factor */
-		to_meter, fr_meter; /* cartesian scaling */
-    
         int     datum_type; /* PJD_UNKNOWN/3PARAM/7PARAM/GRIDSHIFT/WGS84 */
         double  datum_params[7];
         struct _pj_gi **gridlist;
@@ -267,25 +319,173 @@ typedef struct PJconsts {
         /* New Datum Shift Grid Catalogs */
         char   *catalog_name;
         struct _PJ_GridCatalog *catalog;
+
+        /* of the grids and catalog above, see pj_grid_registry_of() */
+        struct PJ_GRID_REGISTRY_t *grid_registry;
     
         double   datum_date;
     
         struct _pj_gi *last_before_grid;
         PJ_Region     last_before_region;
         double        last_before_date;
+        double        last_before_span[2]; /* see pj_gc_date_span() */
 
         struct _pj_gi *last_after_grid;
         PJ_Region     last_after_region;
         double        last_after_date;
+        double        last_after_span[2];
+        struct PJ_GC_BLEND_s *gc_blends; /* see pj_gc_apply_gridshift() */
+
+        /* +accuracy= error allowed in meters, 0 for full accuracy */
+        double  accuracy;
+} PJ_COLD;
+
+    /* offset of the PJ_COLD of a projection of size bytes, after its
+       own members, in the same allocation on a cache line of its own */
+#define PJ_COLD_OFFSET(size) (((size_t) (size) + 63) & ~(size_t) 63)
+#define PJ_ALLOC_SIZE(size) (PJ_COLD_OFFSET(size) + sizeof(PJ_COLD))
+
+	/* base projection data structure, the members used for each
+	   point first, next to those of the projection */
+
+typedef struct PJconsts {
+    projCtx_t *ctx;
+	XY  (*fwd)(LP, struct PJconsts *);
+	LP  (*inv)(XY, struct PJconsts *);
+        /* optional array kernels, see pj_fwd_array() and pj_inv_array() */
+	int (*fwd_n)(struct PJconsts *, long, int, double *, double *);
+	int (*inv_n)(struct PJconsts *, long, int, double *, double *);
+	int over;   /* over-range flag */
+	int geoc;   /* geocentric latitude flag */
+        int is_latlong; /* proj=latlong ... not really a projection at all */
+        int is_geocent; /* proj=geocent ... not really a projection at all */
+	double
+		a,  /* major axis or radius if es==0 */
+		es, /* e ^ 2 */
+		e,  /* eccentricity */
+		ra, /* 1/A */
+		one_es, /* 1 - e^2 */
+		rone_es, /* 1/one_es */
+		lam0, phi0, /* central longitude, latitude */
+		x0, y0, /* easting and northing */
+		k0,	/* general scaling factor */
+		to_meter, fr_meter; /* cartesian scaling */
+
+        struct _pj_gi *gridlist_last;  /* grid of the last shifted point */
+        int     gridlist_last_table;   /* and its entry in cold->gridlist */
+
+        /* x depends on lam only and y on phi only, as set by cylindrical
+           projections, see pj_transform_plan_separable() */
+        int     separable;
+
+        /* Runtime approximation of fwd and inv, see pj_approx.c */
+        struct PJ_APPROX *approx;
+
+        /* bytes of P with the members of its projection, the projection
+           it applies if any, as ob_tran does, and whether it may be
+           shared between threads, see pj_freeze() */
+        size_t  struct_size;
+        struct PJconsts *link;
+        int     frozen;
+
+        PJ_COLD *cold; /* at PJ_COLD_OFFSET(struct_size) of P */
+	void (*spc)(LP, struct PJconsts *, struct FACTORS *);
+	void (*pfree)(struct PJconsts *);
+	const char *descr;
+	paralist *params;   /* parameter list */
 
 #ifdef PROJ_PARMS__
 PROJ_PARMS__
 #endif /* end of optional extensions */
 } PJ;
 
+/* An axis compiled to the coordinate, 0 to 2 for x, y and z, that each
+   output coordinate is taken from and its sign, see pj_transform.c */
+typedef struct PJ_AXIS_MAP_s {
+    int    from[3];         /* from[0] is -1 for an invalid axis */
+    double sign[3];
+} PJ_AXIS_MAP;
+
+/* pj_transform() stages next to a projection, done in the loops of
+   pj_fwd_array_steps() and pj_inv_array_steps() around its kernel */
+typedef struct PJ_ARRAY_STEPS_s {
+    int    axis_swap;       /* x and y exchanged by the axis */
+    double x_sign, y_sign;  /* of the axis, after any exchange */
+    double z_scale;         /* vertical units, and sign of the axis */
+    double pm;              /* from_greenwich */
+    int    long_wrap;       /* inverse only, rewrap around the center */
+    double long_wrap_center;
+} PJ_ARRAY_STEPS;
+
+/* pj_transform() pipeline resolved for one src/dst pair */
+#define PJ_TP_MAX_STAGES 16
+
+typedef struct PJ_TRANSFORM_PLAN_s {
+    PJ   *srcdefn;
+    PJ   *dstdefn;
+    int  stage_count;
+    int  stages[PJ_TP_MAX_STAGES];
+    double xy_scale; /* unit change between equivalent definitions */
+    double z_scale;
+    double helmert[12]; /* composed 3/7 parameter datum shift */
+    PJ_AXIS_MAP src_axis; /* normalizing the source axis */
+    PJ_AXIS_MAP dst_axis; /* denormalizing to the destination axis */
+    PJ_ARRAY_STEPS inv_steps; /* folded into PJ_TP_SRC_INV */
+    PJ_ARRAY_STEPS fwd_steps; /* folded into PJ_TP_DST_FWD */
+    struct PJ_TP_MEMO_s *memo; /* see pj_transform_plan_set_memo() */
+    const struct projPlanBackend_t *backend; /* see */
+    void *backend_handle;      /* pj_transform_plan_set_backend() */
+} PJ_TRANSFORM_PLAN;
+
+/* The grids of a grid name or of a nadgrids string, see pj_gridlist.c */
+#define PJ_GRID_NAME_BUCKETS 64
+
+typedef struct PJ_GRID_NAME_s {
+    struct PJ_GRID_NAME_s *next;  /* in its hash bucket */
+    char   *name;
+    struct _pj_gi **grids;
+    int    grid_count;
+} PJ_GRID_NAME;
+
+/* Grids and grid catalogs loaded for a set of contexts, see pj_gridlist.c */
+typedef struct PJ_GRID_REGISTRY_t {
+    void   *grid_lock;     /* read/write lock of grid_list and the names */
+    void   *catalog_lock;  /* read/write lock of catalog_list */
+    struct _pj_gi *grid_list;
+    struct _PJ_GridCatalog *catalog_list;
+    PJ_ALLOCATOR allocator;  /* of its grids, NULL alloc for the context's */
+    PJ_GRID_NAME *grid_names[PJ_GRID_NAME_BUCKETS];
+    PJ_GRID_NAME *nadgrids_lists[PJ_GRID_NAME_BUCKETS];
+    struct PJ_GEOID_DIFF_s *geoid_diffs;  /* under grid_lock */
+    struct PJ_GRID_PAIR_s *grid_pairs;    /* under grid_lock */
+    int    refs;           /* projections bound to it, under the core lock */
+    int    retired;        /* to be freed with its last projection */
+} PJ_GRID_REGISTRY;
+
+/* A definition built one parameter at a time, see pj_def.c */
+typedef struct PJ_DEF_s {
+    paralist *start, *last;
+} PJ_DEF;
+
 /* public API */
 #include "proj_api.h"
 
+/* Instrumentation of a context, see pj_stats.c.  The counters of the
+   contexts of different threads are written at the same time, so they
+   are kept off the cache lines of any other allocation. */
+#define PJ_CACHE_LINE 64
+
+typedef struct PJ_STATS_t {
+    char       pad_head[PJ_CACHE_LINE];
+    projStats  stats;
+    double     lock_waits_at_reset;   /* process wide values at the reset */
+    double     lock_wait_ns_at_reset;
+    void     (*callback)(void *, const projStats *);
+    double     callback_interval_ns;  /* see pj_ctx_set_stats_callback() */
+    double     callback_due_ns;
+    char       pad_tail[PJ_CACHE_LINE];
+} PJ_STATS;
+
 /* Generate pj_list external or make list from include file */
 #ifndef USE_PJ_LIST_H
 extern struct PJ_LIST pj_list[];
@@ -317,16 +517,45 @@ extern struct PJ_DATUMS pj_datums[];
 extern struct PJ_PRIME_MERIDIANS pj_prime_meridians[];
 #endif
 
+/* forced inlining of small static functions of the kernels */
+#if defined(__GNUC__)
+#  define PJ_INLINE __inline__ __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#  define PJ_INLINE __forceinline
+#else
+#  define PJ_INLINE
+#endif
+
+/* variants of kernels for later x86 instruction sets, built with these
+   attributes next to the generic ones and picked with pj_isa_select().
+   Other compilers, or PJ_NO_ISA_VARIANTS, only build the generic ones. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) \
+    && !defined(PJ_NO_ISA_VARIANTS)
+#  define PJ_ISA_VARIANTS_X86
+#  define PJ_TARGET_AVX2   __attribute__((target("avx2")))
+#  define PJ_TARGET_AVX512 \
+    __attribute__((target("avx512f,avx512bw,avx512vl")))
+#endif
+
+typedef void (*PJ_ISA_FN)( void );
+typedef struct {
+    int       isa;      /* PJ_ISA_* */
+    PJ_ISA_FN fn;       /* cast back to the type of the kernel */
+} PJ_ISA_VARIANT;
+
 #ifdef PJ_LIB__
     /* repeatative projection code */
 #define PROJ_HEAD(id, name) static const char des_##id [] = name
 #define ENTRYA(name) \
         C_NAMESPACE_VAR const char * const pj_s_##name = des_##name; \
 	C_NAMESPACE PJ *pj_##name(PJ *P) { if (!P) { \
-	if( (P = (PJ*) pj_malloc(sizeof(PJ))) != NULL) { \
-        memset( P, 0, sizeof(PJ) ); \
+	if( (P = (PJ*) pj_malloc(PJ_ALLOC_SIZE(sizeof(PJ)))) != NULL) { \
+        memset( P, 0, PJ_ALLOC_SIZE(sizeof(PJ)) ); \
+	P->cold = (PJ_COLD *) ((char *) P + PJ_COLD_OFFSET(sizeof(PJ))); \
 	P->pfree = freeup; P->fwd = 0; P->inv = 0; \
-	P->spc = 0; P->descr = des_##name;
+	P->spc = 0; P->fwd_n = 0; P->inv_n = 0; P->descr = des_##name; \
+	P->struct_size = sizeof(PJ);
 #define ENTRYX } return P; } else {
 #define ENTRY0(name) ENTRYA(name) ENTRYX
 #define ENTRY1(name, a) ENTRYA(name) P->a = 0; ENTRYX
@@ -340,6 +569,59 @@ extern struct PJ_PRIME_MERIDIANS pj_prime_meridians[];
 #define INVERSE(name) static LP name(XY xy, PJ *P) { LP lp = {0.0,0.0}
 #define FREEUP static void freeup(PJ *P) {
 #define SPECIAL(name) static void name(LP lp, PJ *P, struct FACTORS *fac)
+    /* array kernels looping over an already defined FORWARD/INVERSE.  The
+       points are normalized as for P->fwd/P->inv, failed points are set
+       to HUGE_VAL and the last error is returned. */
+#define FORWARD_ARRAY(name, scalar) \
+static int name(PJ *P, long n, int stride, double *x, double *y) { \
+	long i; int err = 0; \
+	for (i = 0; i < n; i++) { \
+		LP lp; XY xy; long io = i * stride; \
+		if (x[io] == HUGE_VAL) continue; \
+		lp.lam = x[io]; lp.phi = y[io]; \
+		xy = scalar(lp, P); \
+		if (P->ctx->last_errno) { \
+			err = P->ctx->last_errno; P->ctx->last_errno = 0; \
+			xy.x = xy.y = HUGE_VAL; } \
+		x[io] = xy.x; y[io] = xy.y; } \
+	return err; }
+#define INVERSE_ARRAY(name, scalar) \
+static int name(PJ *P, long n, int stride, double *x, double *y) { \
+	long i; int err = 0; \
+	for (i = 0; i < n; i++) { \
+		LP lp; XY xy; long io = i * stride; \
+		if (x[io] == HUGE_VAL) continue; \
+		xy.x = x[io]; xy.y = y[io]; \
+		lp = scalar(xy, P); \
+		if (P->ctx->last_errno) { \
+			err = P->ctx->last_errno; P->ctx->last_errno = 0; \
+			lp.lam = lp.phi = HUGE_VAL; } \
+		x[io] = lp.lam; y[io] = lp.phi; } \
+	return err; }
+    /* kernels specialized by mode.  A modal FORWARD/INVERSE takes the
+       mode fixed at setup as a last argument; FORWARD_MODE/INVERSE_MODE
+       define the plain and array functions of one constant mode, where
+       the compiler folds the tests of the mode away, and the setup picks
+       the functions of its mode from a table of MODE_KERNELS. */
+#define FORWARD_MODAL(name) \
+static PJ_INLINE XY name(LP lp, PJ *P, int mode) { XY xy = {0.0,0.0}
+#define INVERSE_MODAL(name) \
+static PJ_INLINE LP name(XY xy, PJ *P, int mode) { LP lp = {0.0,0.0}
+#define FORWARD_MODE(name, modal, mode) \
+static XY name(LP lp, PJ *P) { return modal(lp, P, mode); } \
+FORWARD_ARRAY(name##_n, name)
+#define INVERSE_MODE(name, modal, mode) \
+static LP name(XY xy, PJ *P) { return modal(xy, P, mode); } \
+INVERSE_ARRAY(name##_n, name)
+struct PJ_KERNELS {
+	XY (*fwd)(LP, PJ *);
+	LP (*inv)(XY, PJ *);
+	int (*fwd_n)(PJ *, long, int, double *, double *);
+	int (*inv_n)(PJ *, long, int, double *, double *);
+};
+#define MODE_KERNELS(fwd, inv) { fwd, inv, fwd##_n, inv##_n }
+#define SET_KERNELS(P, k) ((P)->fwd = (k).fwd, (P)->inv = (k).inv, \
+	(P)->fwd_n = (k).fwd_n, (P)->inv_n = (k).inv_n)
 #endif
 #define MAX_TAB_ID 80
 typedef struct { float lam, phi; } FLP;
@@ -353,21 +635,186 @@ struct CTABLE {
 	FLP *cvs;   /* conversion matrix */
 };
 
+/* Grid cache format written by "nad2bin -f cache": the header, then
+   grid_count index entries (parents before their children), then the
+   FLP values of each grid exactly as in a loaded CTABLE.  Everything
+   is in the byte order of the producing host. */
+#define PJ_GRID_CACHE_MAGIC "PROJ GRID CACHE1"
+#define PJ_GRID_CACHE_BYTE_ORDER 0x01020304
+
+typedef struct {
+    char   magic[16];
+    int    byte_order;          /* PJ_GRID_CACHE_BYTE_ORDER */
+    int    grid_count;
+    unsigned int index_checksum; /* pj_grid_checksum() of the entries */
+    int    reserved;
+    double source_mtime;        /* source file time, seconds since 1970 */
+    double source_size;         /* source file size in bytes */
+    char   source[160];         /* source file name */
+} PJ_GRID_CACHE_HEADER;
+
+typedef struct {
+    char   id[MAX_TAB_ID];
+    LP     ll;
+    LP     del;
+    ILP    lim;
+    int    parent;              /* index of the parent entry, or -1 */
+    int    data_offset;
+    unsigned int checksum;      /* pj_grid_checksum() of the values */
+    int    reserved;
+} PJ_GRID_CACHE_ENTRY;
+
+struct PJ_GRID_INDEX_t;
+
 typedef struct _pj_gi {
     char *gridname;   /* identifying name of grid, eg "conus" or ntv2_0.gsb */
     char *filename;   /* full path to filename */
     
     const char *format; /* format of this grid, ie "ctable", "ntv1", 
-                           "ntv2" or "missing". */
+                           "ntv2", "cache", "gtx", "gtiff", 
+                           "gtiff_heights" or "missing". */
 
     int   grid_offset; /* offset in file, for delayed loading */
 
     struct CTABLE *ct;
 
+    unsigned int checksum; /* of the values, for "cache" grids */
+
+    int   is_null;     /* all shifts are zero, set when loaded */
+
+    void  (*unmap)(void *); /* set if ct->cvs is file mapped */
+    void  *map_handle;
+
+    int   tile_serial; /* identifies tiles of this grid, 0 if none yet */
+
+    struct CTABLE *inverse_ct; /* see pj_gridinfo_inverse() */
+    FLP   *row_pairs;  /* see pj_gridinfo_row_pairs() */
+
+    PJ_ALLOCATOR allocator; /* of the values, names and the PJ_GRIDINFO,
+                               from the registry or context that opened
+                               the file */
+    int   values_paged;  /* ct->cvs from pj_grid_pages_alloc() */
+    int   inverse_paged; /* inverse_ct->cvs from pj_grid_pages_alloc() */
+    int   row_pairs_paged; /* row_pairs from pj_grid_pages_alloc() */
+
+    void  *lock;       /* serializes loading, NULL to use the core lock */
+
+    volatile int users;     /* pins, see pj_gridinfo_acquire() */
+    volatile int evicting;
+    volatile long last_used;
+    size_t resident_size;   /* bytes counted in the grid memory budget */
+    int    resident;        /* on the list of loaded grids */
+    struct _pj_gi *resident_next;
+
     struct _pj_gi *next;
     struct _pj_gi *child;
+
+    struct PJ_GRID_INDEX_t *child_index; /* built on first use */
+
+    struct PJ_GRID_QUANT_t *quant; /* see pj_gridinfo_quantized() */
+
+    struct PJ_GTIFF_t *gtiff;  /* tile layout of "gtiff" grids */
+
+    void  *load_thread;     /* see pj_gridinfo_load_async() */
+    volatile int load_async; /* 1 while loading there, -1 if that failed */
 } PJ_GRIDINFO;
 
+/* Uniform bins over the area of a grid, listing the children that may
+   cover each bin in their list order.  See pj_gridinfo_descend(). */
+typedef struct {
+    PJ_GRIDINFO *gi;
+    LP     min, max;            /* extent of the grid nodes */
+    double epsilon;             /* tolerance of pj_apply_gridshift_3() */
+    int    exclusive;           /* widened extent is within the parent's, 
+                                   and meets no earlier sibling's */
+} PJ_GRID_INDEX_ENTRY;
+
+typedef struct PJ_GRID_INDEX_t {
+    LP     ll;                  /* origin and size of the bins */
+    LP     del;
+    int    nx, ny;
+    PJ_GRID_INDEX_ENTRY *entries;
+    int    *bin_start;          /* nx*ny+1 offsets into bin_members */
+    int    *bin_members;        /* entry numbers, ascending in each bin */
+} PJ_GRID_INDEX;
+
+/* Large grids with a row oriented file layout are read on demand in
+   blocks of PJ_GRID_TILE_ROWS rows, kept in a per context LRU list. */
+#define PJ_GRID_TILE_ROWS          64
+#define PJ_GRID_TILE_DEFAULT_LIMIT 64
+
+/* The tiles, bytes of the init caches, and points of the scratch
+   windows of pj_transform() of contexts in low memory mode, see
+   pj_ctx_set_low_memory(). */
+#define PJ_LOW_MEMORY_TILE_LIMIT   4
+#define PJ_LOW_MEMORY_INITCACHE    65536
+#define PJ_LOW_MEMORY_WINDOW       4096
+
+/* Batches of points going through grids are reordered for them from
+   this size on, see pj_ctx_set_grid_sort_threshold(). */
+#define PJ_GRID_SORT_DEFAULT_THRESHOLD 16384
+
+/* Batches split between threads are cut in chunks of this many points,
+   with at least PJ_BATCH_DEFAULT_MIN_SPLIT for each thread, and array
+   kernels are run on this many points at a time, unless tuned
+   otherwise, see pj_ctx_tune(). */
+#define PJ_BATCH_DEFAULT_GRAIN     2048
+#define PJ_BATCH_DEFAULT_MIN_SPLIT 16384
+#define PJ_ARRAY_DEFAULT_CHUNK     256
+
+typedef struct PJ_GRID_TILE_t {
+    PJ_GRIDINFO *gi;
+    int    serial;              /* gi->tile_serial when loaded */
+    int    first_row;
+    int    row_count;
+    FLP    *cvs;
+    struct PJ_GRID_TILE_t *next;
+} PJ_GRID_TILE;
+
+/* Values of a grid held as 16 bit steps above an offset, by blocks of
+   PJ_GRID_QUANT_BLOCK nodes square.  Nodata heights of gtx grids are
+   kept as PJ_GRID_QUANT_NODATA. */
+#define PJ_GRID_QUANT_BLOCK  64
+#define PJ_GRID_QUANT_NODATA 65535
+
+typedef struct PJ_GRID_QUANT_t {
+    int    components;          /* 2 for FLP shifts, 1 for gtx heights */
+    int    blocks_x;            /* blocks across a row */
+    double max_error;           /* largest error of a node, in metres */
+    double *offset;             /* per block and component */
+    double *scale;
+    unsigned short *values;     /* per node and component, row major,
+                                   NULL if the grid is not quantized */
+    int    values_paged;        /* from pj_grid_pages_alloc() */
+} PJ_GRID_QUANT;
+
+/* The geoid heights of one grid less those of another, on the nodes
+   the two share, for going between their vertical datums with one
+   interpolation.  Kept by the registry of the grids, see
+   pj_apply_vgridshift.c. */
+typedef struct PJ_GEOID_DIFF_s {
+    struct PJ_GEOID_DIFF_s *next;
+    PJ_GRIDINFO *src, *dst;     /* heights of src less those of dst */
+    struct CTABLE ct;           /* the shared nodes, NULL cvs if the
+                                   grids do not qualify */
+    int    values_paged;        /* from pj_grid_pages_alloc() */
+} PJ_GEOID_DIFF;
+
+/* The shift of one grid list forward composed with the shift of another
+   inverse, sampled on a lattice over the first list, for going between
+   two grid based datums in one bilinear step.  Cells the samples did
+   not match within the error allowed are left to the two shifts.  Kept
+   by the registry of the grids, see pj_apply_gridshift.c. */
+typedef struct PJ_GRID_PAIR_s {
+    struct PJ_GRID_PAIR_s *next;
+    char   *src_grids, *dst_grids; /* +nadgrids= of the two datums */
+    double tol;                 /* error allowed, in metres */
+    struct CTABLE ct;           /* composed shifts in cvs, NULL if no
+                                   cell is within the error */
+    unsigned char *exact;       /* per cell, row major, 1 if left to the
+                                   two shifts */
+} PJ_GRID_PAIR;
+
 typedef struct {
     PJ_Region region;
     int  priority; /* higher used before lower */
@@ -378,6 +825,19 @@ typedef struct {
     int available; /* 0=unknown, 1=true, -1=false */
 } PJ_GridCatalogEntry;
 
+/* Uniform bins over the extent of a catalog, listing the entries whose
+   region meets each bin in catalog order.  See pj_gc_findgrid(). */
+typedef struct PJ_GC_INDEX_t {
+    LP     ll;                  /* origin and size of the bins */
+    LP     del;
+    int    nx, ny;
+    int    *bin_start;          /* nx*ny+1 offsets into bin_members */
+    int    *bin_members;        /* entry numbers, ascending in each bin */
+    double *dates;              /* distinct entry dates, ascending */
+    int    date_count;
+    int    in_image;            /* arrays in the catalog image, not owned */
+} PJ_GC_INDEX;
+
 typedef struct _PJ_GridCatalog {
     char *catalog_name;
 
@@ -386,6 +846,24 @@ typedef struct _PJ_GridCatalog {
     int entry_count;
     PJ_GridCatalogEntry *entries;
 
+    PJ_GC_INDEX *index; /* NULL to scan the entries */
+
+    /* of the csv text, as recorded in a binary catalog */
+    double source_size;
+    unsigned int source_checksum;
+
+    /* a binary catalog, mapped if unmap is set, holding the definitions
+       and index arrays; NULL if read from the csv */
+    void *image;
+    size_t image_size;
+    void *image_handle;
+    void (*image_unmap)(void *);
+
+    PJ_ALLOCATOR allocator; /* of the context that read the catalog */
+
+    /* keeping the catalog, and the grids of its entries */
+    struct PJ_GRID_REGISTRY_t *registry;
+
     struct _PJ_GridCatalog *next;
 } PJ_GridCatalog;
 
@@ -393,36 +871,163 @@ typedef struct _PJ_GridCatalog {
 /* procedure prototypes */
 double dmstor(const char *, char **);
 double dmstor_ctx(projCtx ctx, const char *, char **);
+double pj_strtod(const char *, char **);
+char *pj_format_fixed(char *, double, int);
+char *pj_format_double(char *, const char *, double);
+double pj_atof(const char *);
 void set_rtodms(int, int);
 char *rtodms(char *, double, int, int);
 double adjlon(double);
+void adjlon_n(long, int, double *);
+void adjlon_wrap_n(long, int, double *, double);
+int pj_fwd_kernel(PJ *, long, int, double *, double *);
+int pj_inv_kernel(PJ *, long, int, double *, double *);
+int pj_fwd_array_steps(PJ *, long, int, double *, double *, double *,
+                       const PJ_ARRAY_STEPS *);
+int pj_inv_array_steps(PJ *, long, int, double *, double *, double *,
+                       const PJ_ARRAY_STEPS *);
 double aacos(projCtx,double), aasin(projCtx,double), asqrt(double), aatan2(double, double);
 PVALUE pj_param(projCtx ctx, paralist *, const char *);
 paralist *pj_mkparam(char *);
+paralist *pj_mkparam_arena(PJ_ARENA **, const char *);
+paralist *pj_mkparam_value(PJ_ARENA **, const char *, double);
+paralist *pj_mkparam_copy(PJ_ARENA **, const paralist *);
+const char *pj_param_text(paralist *);
+void *pj_arena_alloc(PJ_ARENA **, size_t);
+void pj_arena_free(PJ_ARENA *);
+const char *pj_intern(const char *, size_t);
+const char *pj_intern_ref(const char *);
+void pj_intern_release(const char *);
+void pj_intern_release_text(const char *, size_t);
+double pj_intern_memory(void);
+void *pj_allocator_malloc(const PJ_ALLOCATOR *, size_t);
+void pj_allocator_free(const PJ_ALLOCATOR *, void *);
+char *pj_allocator_strdup(const PJ_ALLOCATOR *, const char *);
+void *pj_ctx_malloc(projCtx, size_t);
+void pj_ctx_dalloc(projCtx, void *);
+char *pj_ctx_strdup(projCtx, const char *);
+void pj_param_truncate(paralist *, paralist *);
+void pj_param_index_free(paralist *);
+void pj_free_paralist(paralist *);
+void pj_free_param(paralist *);
 int pj_ell_set(projCtx ctx, paralist *, double *, double *);
 int pj_datum_set(projCtx,paralist *, PJ *);
 int pj_prime_meridian_set(paralist *, PJ *);
 int pj_angular_units_set(paralist *, PJ *);
 
-paralist *pj_clone_paralist( const paralist* );
-paralist*pj_search_initcache( const char *filekey );
-void pj_insert_initcache( const char *filekey, const paralist *list);
+paralist *pj_clone_paralist( const paralist*, PJ_ARENA ** );
+int pj_walk_initcache( int, int (*)( void *, const char *, const paralist * ),
+                       void * );
+struct PJ_LIST *pj_find_proj( const char *id );
+struct PJ_ELLPS *pj_find_ellps( const char *id );
+struct PJ_UNITS *pj_find_units( const char *id );
+struct PJ_DATUMS *pj_find_datum( const char *id );
+struct PJ_PRIME_MERIDIANS *pj_find_prime_meridian( const char *id );
+paralist*pj_search_initcache( const char *filekey, PJ_ARENA **arena );
+void pj_insert_initcache( projCtx ctx, const char *filekey,
+                          const paralist *list );
+paralist *pj_search_defncache( const char *definition, PJ_ARENA **arena );
+int pj_split_definition( char *, char **, int );
+void pj_insert_defncache( projCtx ctx, const char *definition,
+                          const paralist *list );
+void pj_acquire_initcache_lock( int exclusive );
+void pj_release_initcache_lock( int exclusive );
+void *pj_mutex_create( int lock_class );
+void pj_mutex_destroy( void *mutex );
+void pj_mutex_lock( void *mutex );
+void pj_mutex_unlock( void *mutex );
+void *pj_rwlock_create( int lock_class );
+void pj_rwlock_destroy( void *rwlock );
+void pj_rwlock_acquire( void *rwlock, int exclusive );
+void pj_rwlock_release( void *rwlock, int exclusive );
+void *pj_thread_start( void (*func)(void *), void *arg );
+void pj_thread_join( void *thread );
+int pj_cpu_count( void );
+void pj_once( volatile long *once, void (*init)(void) );
+/* checked before the arguments of pj_log() are even evaluated */
+#define pj_log_enabled(ctx, level)  ((level) <= (ctx)->debug_level)
+#define pj_log_site_wanted(ctx, level, site) \
+    (pj_log_enabled(ctx, level) && pj_log_site_count(ctx, level, site))
+
+int pj_log_site_count( projCtx ctx, int level, int site );
+void pj_log_record( projCtx ctx, int level, const char *gridname,
+                    long point_index, int error_code, const char *fmt, ... );
+void pj_get_lock_wait( double *waits, double *nanoseconds );
+double pj_clock_ns( void );
+int pj_cpu_isa( void );
+int pj_isa_by_name( const char *name );
+PJ_ISA_FN pj_isa_select( projCtx, const PJ_ISA_VARIANT *, int );
+void pj_stats_add( projStatsCounter *counter, double points, double ns );
+void pj_stats_merge( PJ_STATS *stats, const PJ_STATS *other );
+void pj_stats_add_grid( PJ_STATS *stats, const char *gridname,
+                        double points, double ns );
+void pj_stats_add_latency( projStatsLatency *latency, double ns );
+void pj_stats_add_grid_load( PJ_STATS *stats, double bytes, double ns );
+void pj_stats_poll( projCtx ctx );
+int pj_seek_init_tag( projCtx ctx, const char *filename, PAFile fid,
+                      const char *tag );
+paralist *pj_search_defaults( projCtx ctx, const char *tag );
+void pj_clear_defaults( void );
+double pj_initcache_memory( double *index_bytes );
+
+/* Init files compiled into the library by init2c, see pj_initdb.c. */
+typedef struct {
+    unsigned short file;        /* in files, which are sorted by name */
+    unsigned short count;       /* of parameters */
+    unsigned int   tag;         /* offset in strings */
+    unsigned int   first;       /* index of the first parameter in params */
+} PJ_INIT_DB_ENTRY;
+
+typedef struct {
+    int    file_count;
+    const char * const *files;
+    int    entry_count;
+    const PJ_INIT_DB_ENTRY *entries;  /* by file, then by tag */
+    const unsigned int *params;       /* offsets in strings */
+    const char *strings;
+} PJ_INIT_DB;
+
+const PJ_INIT_DB_ENTRY *pj_init_db_file( const char *file, int *count );
+const PJ_INIT_DB_ENTRY *pj_init_db_find( const char *file, const char *tag );
+const char *pj_init_db_tag( const PJ_INIT_DB_ENTRY * );
+const char *pj_init_db_param( const PJ_INIT_DB_ENTRY *, int i );
+void pj_clear_open_lib_cache( void );
 
 double *pj_enfn(double);
 double pj_mlfn(double, double, double, double *);
 double pj_inv_mlfn(projCtx, double, double, double *);
+double *pj_inv_mlfn_accuracy(double *, double, double, double);
 double pj_qsfn(double, double, double);
+void pj_qsfn_n(long, int, double *, double, double);
 double pj_tsfn(double, double, double);
 double pj_msfn(double, double, double);
 double pj_phi2(projCtx, double, double);
+void pj_phi2_init(struct PJ_PHI2 *, double);
+double pj_phi2_ts(projCtx, const struct PJ_PHI2 *, double);
+void pj_phi2_array(projCtx, const struct PJ_PHI2 *, long, double *);
 double pj_qsfn_(double, PJ *);
 double *pj_authset(double);
 double pj_authlat(double, double *);
+void pj_authlat_n(long, int, double *, const double *);
+#define PJ_TABLE_EN        1
+#define PJ_TABLE_EN_SERIES 2
+#define PJ_TABLE_APA       3
+double *pj_table_acquire(int, double, int, void (*)(double, double *));
+void pj_table_release(double *);
+double pj_table_memory(void);
 COMPLEX pj_zpoly1(COMPLEX, COMPLEX *, int);
 COMPLEX pj_zpolyd1(COMPLEX, COMPLEX *, int, COMPLEX *);
 
 int pj_deriv(LP, double, PJ *, struct DERIVS *);
 int pj_factors(LP, PJ *, double, struct FACTORS *);
+long pj_factors_array(PJ *, long, int, const double *, const double *,
+        double, struct FACTORS *, int *);
+void pj_conformal_der(LP, PJ *, double, double, struct FACTORS *);
+int pj_approx_init(PJ *);
+void pj_approx_free(PJ *);
+PJ *pj_clone_exact(projCtx, PJ *);
+int pj_etmerc_compatible(PJ *, PJ *);
+int pj_etmerc_convert(PJ *, PJ *, long, int, double *, double *);
 
 struct PW_COEF {/* row coefficient structure */
     int m;		/* number of c coefficients (=0 for none) */
@@ -436,19 +1041,42 @@ typedef struct {	/* Chebyshev or Power series structure */
 	struct PW_COEF *cu, *cv;
 	int mu, mv;		/* maximum cu and cv index (+1 for count) */
 	int power;		/* != 0 if power series, else Chebyshev */
+	double *packed;	/* cu then cv rows of packed_m coefficients, */
+	int packed_m;	/* zero padded, for the _n evaluators, or NULL */
 } Tseries;
 Tseries *mk_cheby(projUV, projUV, double, projUV *, projUV (*)(projUV), int, int, int);
+Tseries *mk_cheby_data(projUV, projUV, double, projUV *,
+                       projUV (*)(projUV, void *), void *, int, int, int);
+Tseries *mk_cheby_values(projUV, projUV, double, projUV *, projUV **,
+                         int, int, int);
 projUV bpseval(projUV, Tseries *);
 projUV bcheval(projUV, Tseries *);
 projUV biveval(projUV, Tseries *);
+int pack_series(Tseries *);
+void bpseval_n(const projUV *, projUV *, long, Tseries *);
+void bcheval_n(const projUV *, projUV *, long, Tseries *);
+void biveval_n(const projUV *, projUV *, long, Tseries *);
 void *vector1(int, int);
 void **vector2(int, int, int);
 void freev2(void **v, int nrows);
 int bchgen(projUV, projUV, int, int, projUV **, projUV(*)(projUV));
+int bchgen_data(projUV, projUV, int, int, projUV **,
+                projUV(*)(projUV, void *), void *);
+void bchgen_nodes(projUV, projUV, int, int, projUV **);
+int bchgen_values(int, int, projUV **);
 int bch2bps(projUV, projUV, projUV **, int, int);
 /* nadcon related protos */
 LP nad_intr(LP, struct CTABLE *);
 LP nad_cvt(LP, int, struct CTABLE *);
+LP nad_intr_tiled(LP, projCtx, PJ_GRIDINFO *);
+LP nad_cvt_tiled(LP, int, projCtx, PJ_GRIDINFO *);
+int nad_covers(LP, struct CTABLE *);
+/* largest batch of nad_intr_array() */
+#define NAD_ARRAY_MAX 64
+void nad_intr_array(struct CTABLE *, const FLP *, int, const LP *, LP *,
+                    LP *, LP *);
+LP nad_intr_slope(LP, struct CTABLE *, projCtx, PJ_GRIDINFO *, LP *, LP *);
+void nad_cvt_array(projCtx, struct CTABLE *, const FLP *, int, long, LP *);
 struct CTABLE *nad_init(projCtx ctx, char *);
 struct CTABLE *nad_ctable_init( projCtx ctx, PAFile fid );
 int nad_ctable_load( projCtx ctx, struct CTABLE *, PAFile fid );
@@ -463,31 +1091,140 @@ int pj_apply_vgridshift( PJ *defn, const char *listname,
                          int *gridlist_count_p,
                          int inverse, 
                          long point_count, int point_offset,
-                         double *x, double *y, double *z );
+                         double *x, double *y, double *z, int *status );
+int pj_apply_geoid_diff( PJ *srcdefn, PJ *dstdefn,
+                         long point_count, int point_offset,
+                         double *x, double *y, double *z, int *status );
+void pj_geoid_diffs_free( PJ_GRID_REGISTRY * );
+PJ_GRID_PAIR *pj_grid_pair_get( PJ *srcdefn, PJ *dstdefn, double tol );
+void pj_grid_pair_apply( const PJ_GRID_PAIR *, long point_count, 
+                         int point_offset, double *x, double *y,
+                         unsigned char *left );
+void pj_grid_pairs_free( PJ_GRID_REGISTRY * );
 int pj_apply_gridshift_2( PJ *defn, int inverse, 
                           long point_count, int point_offset,
                           double *x, double *y, double *z );
+int pj_apply_gridshift_t( PJ *defn, int inverse, 
+                          long point_count, int point_offset,
+                          double *x, double *y, double *z,
+                          const double *t );
 int pj_apply_gridshift_3( projCtx ctx, 
                           PJ_GRIDINFO **gridlist, int gridlist_count,
                           int inverse, long point_count, int point_offset,
                           double *x, double *y, double *z );
+int pj_apply_gridshift_last( projCtx ctx, 
+                             PJ_GRIDINFO **gridlist, int gridlist_count,
+                             int inverse, long point_count, int point_offset,
+                             double *x, double *y, double *z,
+                             PJ_GRIDINFO **p_last, int *p_last_table );
+int pj_grid_order( long point_count, int point_offset, 
+                   const double *x, const double *y,
+                   long *order, unsigned short *keys );
+
+int pj_transform_plan_init( PJ_TRANSFORM_PLAN *plan, PJ *srcdefn, PJ *dstdefn );
+int pj_transform_plan_init_vertical( PJ_TRANSFORM_PLAN *plan, 
+                                     PJ *srcdefn, PJ *dstdefn );
+int pj_transform_plan_separable( PJ_TRANSFORM_PLAN *plan );
 
 PJ_GRIDINFO **pj_gridlist_from_nadgrids( projCtx, const char *, int * );
+PJ_GRIDINFO **pj_gridlist_from_registry( projCtx, PJ_GRID_REGISTRY *,
+                                         const char *, int * );
 void pj_deallocate_grids();
+PJ_GRID_REGISTRY *pj_ctx_grid_registry( projCtx );
+PJ_GRID_REGISTRY *pj_grid_registry_of( PJ * );
+void pj_grid_registry_unbind( PJ * );
+int pj_grid_registry_refresh( PJ * );
 
 PJ_GRIDINFO *pj_gridinfo_init( projCtx, const char * );
 int pj_gridinfo_load( projCtx, PJ_GRIDINFO * );
 void pj_gridinfo_free( projCtx, PJ_GRIDINFO * );
+void pj_gridinfo_free_table( PJ_GRIDINFO *, struct CTABLE *, int paged );
+void *pj_gridinfo_alloc_values( projCtx, PJ_GRIDINFO *, size_t, int *paged );
+void pj_gridinfo_free_values( PJ_GRIDINFO *, void *, int paged );
+void *pj_grid_pages_alloc( int mode, size_t );
+void pj_grid_pages_free( void * );
+void pj_grid_pages_advise( void *, size_t );
+void *pj_ctx_fmap_at( projCtx, PAFile, projFileOffset, size_t, void **handle,
+                      void (**unmap)(void *) );
+int pj_ctx_fidentity( projCtx, PAFile, double id[4] );
+typedef struct PJ_SHM_t PJ_SHM;     /* see pj_shm.c */
+#define PJ_SHM_KEY_MAX 480
+PJ_SHM *pj_shm_attach( const char *prefix, const char *key );
+PJ_SHM *pj_shm_create( const char *prefix, const char *key, size_t size );
+void pj_shm_ready( PJ_SHM * );
+void pj_shm_release( void * );
+void *pj_shm_data( PJ_SHM * );
+size_t pj_shm_size( PJ_SHM * );
+const char *pj_shm_get_name( PJ_SHM * );
+int pj_shm_supported( void );
+unsigned long pj_fnv1a( unsigned long hash, const void *data, size_t size );
+#define PJ_FNV1A_BASIS 2166136261UL
+void pj_hash_name( const char *key, char name[17] );
+typedef struct {     /* cache file of pj_approx.c or pj_tile_cache.c */
+    FILE          *fp;
+    unsigned long sum;      /* pj_fnv1a() of the bytes so far */
+    char          tmp[MAX_PATH_FILENAME+40];  /* written to, then renamed */
+} PJ_CACHE_FILE;
+int pj_cache_file_open( PJ_CACHE_FILE *, const char *path,
+                        const char *magic, const char *key );
+int pj_cache_file_close( PJ_CACHE_FILE *, int ok );
+int pj_cache_file_create( PJ_CACHE_FILE *, const char *path, const void *id,
+                          const char *magic, const char *key );
+void pj_cache_file_commit( PJ_CACHE_FILE *, const char *path, int ok );
+int pj_cache_file_put( PJ_CACHE_FILE *, const void *, size_t, size_t );
+int pj_cache_file_get( PJ_CACHE_FILE *, void *, size_t, size_t );
+int pj_network_is_url( const char * );
+/* size of the block cache set with the PROJ_NETWORK_CACHE variable */
+#define PJ_NETWORK_CACHE_DEFAULT_MB 1024
+int pj_gridinfo_tiled( projCtx, PJ_GRIDINFO * );
+int pj_gridinfo_acquire( projCtx, PJ_GRIDINFO * );
+int pj_gridinfo_ready( projCtx, PJ_GRIDINFO * );
+void pj_gridinfo_load_async( projCtx, PJ_GRIDINFO * );
+void pj_gridinfo_release( PJ_GRIDINFO * );
+void pj_grid_resident_add( PJ_GRIDINFO *, int loaded );
+void pj_grid_resident_remove( PJ_GRIDINFO * );
+void pj_grid_budget_enforce( PJ_GRIDINFO *keep );
+struct CTABLE *pj_gridinfo_inverse( projCtx, PJ_GRIDINFO * );
+FLP *pj_gridinfo_row_pairs( projCtx, PJ_GRIDINFO * );
+int pj_gridinfo_load_rows( projCtx, PJ_GRIDINFO *, PAFile, 
+                           int first_row, int row_count, FLP *cvs );
+FLP *pj_grid_tile_row( projCtx, PJ_GRIDINFO *, int row );
+PJ_GRIDINFO *pj_gridinfo_descend( PJ_GRIDINFO *, LP, int widen,
+                                  int *exclusive );
+void pj_grid_index_free( PJ_GRID_INDEX * );
+void pj_grid_tiles_free( projCtx, PJ_GRIDINFO * );
+PJ_GRID_QUANT *pj_gridinfo_quantized( projCtx, PJ_GRIDINFO * );
+void pj_grid_quant_rows( PJ_GRIDINFO *, int first_row, int row_count,
+                         FLP *cvs );
+float pj_grid_quant_height( PJ_GRIDINFO *, int col, int row );
+void pj_grid_quant_free( PJ_GRIDINFO * );
+int pj_gridinfo_heights( const PJ_GRIDINFO * );
+int pj_grid_shm_usable( projCtx, PJ_GRIDINFO * );
+int pj_grid_shm_attach( projCtx, PJ_GRIDINFO * );
+void pj_grid_shm_publish( projCtx, PJ_GRIDINFO * );
+int pj_gridinfo_init_gtiff( projCtx, PAFile, PJ_GRIDINFO * );
+int pj_gtiff_load_rows( projCtx, PJ_GRIDINFO *, PAFile,
+                        int first_row, int row_count, FLP *cvs );
+void pj_gtiff_free( PJ_GRIDINFO * );
+void pj_swap_words( unsigned char *data, int word_size, int word_count );
+unsigned int pj_grid_checksum( const void *data, size_t size );
+unsigned int pj_grid_checksum_update( unsigned int, const void *, size_t );
 
 PJ_GridCatalog *pj_gc_findcatalog( projCtx, const char * );
+PJ_GridCatalog *pj_gc_findcatalog_in( projCtx, PJ_GRID_REGISTRY *, 
+                                      const char * );
 PJ_GridCatalog *pj_gc_readcatalog( projCtx, const char * );
+int pj_gc_writecatalog( projCtx, const char *catalog_name, 
+                        const char *filename );
+PJ_GC_INDEX *pj_gc_index_build( PJ_GridCatalog * );
+void pj_gc_free_catalog( PJ_GridCatalog * );
 void pj_gc_unloadall( projCtx );
+void pj_gc_free_catalogs( PJ_GRID_REGISTRY * );
 int pj_gc_apply_gridshift( PJ *defn, int inverse, 
                            long point_count, int point_offset,
-                           double *x, double *y, double *z );
-int pj_gc_apply_gridshift( PJ *defn, int inverse, 
-                           long point_count, int point_offset,
-                           double *x, double *y, double *z );
+                           double *x, double *y, double *z,
+                           const double *t );
+void pj_gc_blend_free( PJ *defn );
 
 PJ_GRIDINFO *pj_gc_findgrid( projCtx ctx, 
                              PJ_GridCatalog *catalog, int after, 
@@ -503,6 +1240,8 @@ double proj_inv_mdist(projCtx ctx, double, const void *);
 void *pj_gauss_ini(double, double, double *,double *);
 LP pj_gauss(projCtx, LP, const void *);
 LP pj_inv_gauss(projCtx, LP, const void *);
+int pj_gauss_array(projCtx, long, int, double *, double *, const void *);
+int pj_inv_gauss_array(projCtx, long, int, double *, double *, const void *);
 
 extern char const pj_release[];
 
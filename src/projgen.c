@@ -0,0 +1,148 @@
+/******************************************************************************
+ *
+ * Project:  PROJ.4
+ * Purpose:  Mainline program writing the points of a realistic workload,
+ *           as input of proj, cs2cs and the benchmarks.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "projects.h"
+#include "workload.h"
+
+/************************************************************************/
+/*                               Usage()                                */
+/************************************************************************/
+
+static void Usage()
+
+{
+    printf( "Usage: projgen [-w kind[,nodata]] [-n points] [-s seed]\n"
+            "               [-R w,s,e,n | -g grid] [-d t0,t1] [-t]\n"
+            "\n"
+            "  -w: the layout of the points (uniform), one of\n"
+            "        uniform  independent points of the region\n"
+            "        track    GPS tracks of %d one second fixes\n"
+            "        lattice  the cell centres of a raster of the region\n"
+            "        poi      points clustered by %d around centres\n"
+            "        global   points even over the sphere, most of them\n"
+            "                 outside of the grids\n"
+            "      with the fraction of nodata points, written as 1e400,\n"
+            "      read as HUGE_VAL\n"
+            "  -n: number of points (10000)\n"
+            "  -s: seed of the generator (17)\n"
+            "  -R: the lon/lat region of the points, in degrees\n"
+            "      (-180,-90,180,90)\n"
+            "  -g: the region of a grid of PROJ_LIB, as in +nadgrids\n"
+            "  -d: the range of the dates, in decimal years (2000,2020)\n"
+            "  -t: write the date of each point after its height\n"
+            "\n"
+            "The points are written as \"lon lat 0\", in degrees, one per\n"
+            "line, for cs2cs.\n",
+            WORKLOAD_TRACK_POINTS, WORKLOAD_POI_POINTS );
+    exit( 1 );
+}
+
+/************************************************************************/
+/*                                main()                                */
+/************************************************************************/
+
+int main( int argc, char **argv )
+
+{
+    WorkloadSpec spec;
+    long point_count = 10000, i;
+    int dates = 0;
+    double *lon, *lat, *t;
+
+    workload_init( &spec, WORKLOAD_UNIFORM );
+
+    for( i = 1; i < argc; i++ )
+    {
+        if( strcmp(argv[i], "-w") == 0 && i + 1 < argc )
+        {
+            if( !workload_parse( &spec, argv[++i] ) )
+                Usage();
+        }
+        else if( strcmp(argv[i], "-n") == 0 && i + 1 < argc )
+        {
+            if( (point_count = atol( argv[++i] )) <= 0 )
+                Usage();
+        }
+        else if( strcmp(argv[i], "-s") == 0 && i + 1 < argc )
+            spec.seed = (unsigned) strtoul( argv[++i], NULL, 10 );
+        else if( strcmp(argv[i], "-R") == 0 && i + 1 < argc )
+        {
+            if( !workload_region( &spec, argv[++i] ) )
+                Usage();
+        }
+        else if( strcmp(argv[i], "-g") == 0 && i + 1 < argc )
+        {
+            if( !workload_grid_region( &spec, argv[++i] ) )
+            {
+                fprintf( stderr, "projgen: cannot open grid %s\n",
+                         argv[i] );
+                return 1;
+            }
+        }
+        else if( strcmp(argv[i], "-d") == 0 && i + 1 < argc )
+        {
+            if( sscanf( argv[++i], "%lf,%lf", &spec.t_min,
+                        &spec.t_max ) != 2 || spec.t_max < spec.t_min )
+                Usage();
+        }
+        else if( strcmp(argv[i], "-t") == 0 )
+            dates = 1;
+        else
+            Usage();
+    }
+
+    lon = (double *) malloc( sizeof(double) * point_count );
+    lat = (double *) malloc( sizeof(double) * point_count );
+    t = (double *) malloc( sizeof(double) * point_count );
+    if( !lon || !lat || !t )
+    {
+        fprintf( stderr, "projgen: out of memory\n" );
+        return 1;
+    }
+
+    workload_generate( &spec, point_count, lon, lat, dates ? t : NULL );
+
+    for( i = 0; i < point_count; i++ )
+    {
+        if( lon[i] == HUGE_VAL )
+            fputs( "1e400\t1e400\t0", stdout );
+        else
+            printf( "%.9f\t%.9f\t0", lon[i], lat[i] );
+        if( dates )
+            printf( "\t%.6f", t[i] );
+        putchar( '\n' );
+    }
+
+    free( lon );
+    free( lat );
+    free( t );
+    return 0;
+}
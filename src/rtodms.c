@@ -14,6 +14,7 @@ CONV = 206264806.24709635515796003417;
 	static char
 format[50] = "%dd%d'%.3f\"%c";
 	static int
+fract_digits = 3,
 dolong = 0;
 	void
 set_rtodms(int fract, int con_w) {
@@ -31,8 +32,27 @@ set_rtodms(int fract, int con_w) {
 		else
 			(void)sprintf(format,"%%dd%%02d'%%0%d.%df\"%%c",
 				fract+2+(fract?1:0), fract);
+		fract_digits = fract;
 		dolong = con_w;
 	}
+}
+/* non negative integer, zero padded to width */
+	static char *
+put_int(char *s, int v, int width) {
+	char digits[12];
+	int n = 0;
+
+	if (v < 0)
+		return s + sprintf(s, "%0*d", width, v);
+	do {
+		digits[n++] = (char)('0' + v % 10);
+		v /= 10;
+	} while (v);
+	while (width-- > n)
+		*s++ = '0';
+	while (n)
+		*s++ = digits[--n];
+	return s;
 }
 	char *
 rtodms(char *s, double r, int pos, int neg) {
@@ -53,20 +73,34 @@ rtodms(char *s, double r, int pos, int neg) {
         r = floor(r / 60.);
         deg = r;
 
-	if (dolong)
+	/* nan and infinity keep the padding of printf() */
+	if (!(sec >= 0. && sec < 60.)) {
 		(void)sprintf(ss,format,deg,min,sec,sign);
-	else if (sec) {
-		char *p, *q;
+		return s;
+	}
 
-		(void)sprintf(ss,format,deg,min,sec,sign);
-		for (q = p = ss + strlen(ss) - (sign ? 3 : 2); *p == '0'; --p) ;
-		if (*p != '.')
-			++p;
-		if (++q != p)
-			(void)strcpy(p, q);
-	} else if (min)
-		(void)sprintf(ss,"%dd%d'%c",deg,min,sign);
-	else
-		(void)sprintf(ss,"%dd%c",deg, sign);
+	ss = put_int(ss, deg, 0);
+	*ss++ = 'd';
+	if (dolong || sec || min) {
+		ss = put_int(ss, min, dolong ? 2 : 0);
+		*ss++ = '\'';
+	}
+	if (dolong || sec) {
+		char *p;
+
+		if (dolong && sec < 10.)
+			*ss++ = '0';
+		p = ss;
+		ss = pj_format_fixed(ss, sec, fract_digits);
+		if (!dolong && fract_digits) { /* drop trailing zeros */
+			while (ss > p && ss[-1] == '0')
+				--ss;
+			if (ss > p && ss[-1] == '.')
+				--ss;
+		}
+		*ss++ = '"';
+	}
+	*ss++ = (char)sign;
+	*ss = '\0';
 	return s;
 }
@@ -0,0 +1,384 @@
+/******************************************************************************
+ *
+ * Project:  PROJ.4
+ * Purpose:  Generation of the points of realistic workloads, shared by
+ *           projgen and projbench.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "projects.h"
+#include "workload.h"
+
+/* a second of a decimal year, for the dates of the tracks */
+#define YEAR_SECOND (1.0 / 31556952.0)
+
+/* metres of a degree of latitude */
+#define DEGREE_METRES 111320.0
+
+static const char *kind_names[] = {
+    "uniform", "track", "lattice", "poi", "global"
+};
+
+/************************************************************************/
+/*                            workload_next()                           */
+/*                                                                      */
+/*      A small linear congruential generator, the same for all         */
+/*      platforms, returning 24 bits in [0,1).                          */
+/************************************************************************/
+
+static double workload_next( unsigned *seed )
+
+{
+    *seed = *seed * 1103515245u + 12345u;
+    return ((*seed >> 8) & 0xffffff) / 16777216.0;
+}
+
+/************************************************************************/
+/*                           workload_normal()                          */
+/*                                                                      */
+/*      A standard normal number, by Box-Muller.                        */
+/************************************************************************/
+
+static double workload_normal( unsigned *seed )
+
+{
+    double u = workload_next( seed ), v = workload_next( seed );
+
+    return sqrt( -2.0 * log( 1.0 - u ) ) * cos( 2.0 * M_PI * v );
+}
+
+/************************************************************************/
+/*                            workload_init()                           */
+/*                                                                      */
+/*      Set up a workload over the whole lon/lat range, without         */
+/*      nodata points, dated over 2000 to 2020.                         */
+/************************************************************************/
+
+void workload_init( WorkloadSpec *spec, WorkloadKind kind )
+
+{
+    memset( spec, 0, sizeof(WorkloadSpec) );
+    spec->kind = kind;
+    spec->lon_min = -180.0;
+    spec->lon_max = 180.0;
+    spec->lat_min = -90.0;
+    spec->lat_max = 90.0;
+    spec->t_min = 2000.0;
+    spec->t_max = 2020.0;
+    spec->seed = 17u;
+}
+
+/************************************************************************/
+/*                            workload_kind()                           */
+/*                                                                      */
+/*      The kind of a name, or -1.                                      */
+/************************************************************************/
+
+int workload_kind( const char *name )
+
+{
+    int i;
+
+    for( i = 0; i < (int) (sizeof(kind_names) / sizeof(kind_names[0])); i++ )
+        if( strcmp( name, kind_names[i] ) == 0 )
+            return i;
+    return -1;
+}
+
+/************************************************************************/
+/*                            workload_name()                           */
+/************************************************************************/
+
+const char *workload_name( WorkloadKind kind )
+
+{
+    return kind_names[kind];
+}
+
+/************************************************************************/
+/*                           workload_parse()                           */
+/*                                                                      */
+/*      Set the kind, and the nodata fraction if given, from            */
+/*      "kind[,nodata]".  Returns 0 if it cannot be parsed.             */
+/************************************************************************/
+
+int workload_parse( WorkloadSpec *spec, const char *text )
+
+{
+    char name[32];
+    const char *comma = strchr( text, ',' );
+    size_t len = comma ? (size_t) (comma - text) : strlen( text );
+    int kind;
+
+    if( len >= sizeof(name) )
+        return 0;
+    memcpy( name, text, len );
+    name[len] = '\0';
+    if( (kind = workload_kind( name )) < 0 )
+        return 0;
+    spec->kind = (WorkloadKind) kind;
+
+    if( comma != NULL )
+    {
+        char *end;
+
+        spec->nodata = strtod( comma + 1, &end );
+        if( end == comma + 1 || *end != '\0'
+            || spec->nodata < 0.0 || spec->nodata > 1.0 )
+            return 0;
+    }
+    return 1;
+}
+
+/************************************************************************/
+/*                           workload_region()                          */
+/*                                                                      */
+/*      Set the region from "w,s,e,n", in degrees.  Returns 0 if it     */
+/*      cannot be parsed.                                               */
+/************************************************************************/
+
+int workload_region( WorkloadSpec *spec, const char *text )
+
+{
+    double w, s, e, n;
+
+    if( sscanf( text, "%lf,%lf,%lf,%lf", &w, &s, &e, &n ) != 4
+        || e <= w || n <= s )
+        return 0;
+    spec->lon_min = w;
+    spec->lat_min = s;
+    spec->lon_max = e;
+    spec->lat_max = n;
+    return 1;
+}
+
+/************************************************************************/
+/*                        workload_grid_region()                        */
+/*                                                                      */
+/*      Set the region to the extent of a grid, as named in             */
+/*      +nadgrids or +geoidgrids.  Returns 0 if it cannot be opened.    */
+/************************************************************************/
+
+int workload_grid_region( WorkloadSpec *spec, const char *gridname )
+
+{
+    projCtx ctx = pj_get_default_ctx();
+    PJ_GRIDINFO *gi = pj_gridinfo_init( ctx, gridname );
+    struct CTABLE *ct;
+    int ok = 0;
+
+    if( gi != NULL && (ct = gi->ct) != NULL )
+    {
+        spec->lon_min = ct->ll.u * RAD_TO_DEG;
+        spec->lat_min = ct->ll.v * RAD_TO_DEG;
+        spec->lon_max = (ct->ll.u + (ct->lim.lam - 1) * ct->del.u)
+            * RAD_TO_DEG;
+        spec->lat_max = (ct->ll.v + (ct->lim.phi - 1) * ct->del.v)
+            * RAD_TO_DEG;
+        ok = spec->lon_max > spec->lon_min && spec->lat_max > spec->lat_min;
+    }
+    if( gi != NULL )
+        pj_gridinfo_free( ctx, gi );
+    return ok;
+}
+
+/************************************************************************/
+/*                           workload_track()                           */
+/************************************************************************/
+
+static void workload_track( const WorkloadSpec *spec, unsigned *seed,
+                            long n, double *lon, double *lat, double *t )
+
+{
+    double w = spec->lon_min, e = spec->lon_max;
+    double s = spec->lat_min, nn = spec->lat_max;
+    double x = 0.0, y = 0.0, heading = 0.0, speed = 0.0, date = 0.0;
+    long i;
+
+    for( i = 0; i < n; i++ )
+    {
+        double step, cos_lat;
+
+        if( i % WORKLOAD_TRACK_POINTS == 0 )
+        {
+            /* a new vehicle: somewhere in the region, at 5 to 30 m/s */
+            x = w + (e - w) * workload_next( seed );
+            y = s + (nn - s) * workload_next( seed );
+            heading = 2.0 * M_PI * workload_next( seed );
+            speed = 5.0 + 25.0 * workload_next( seed );
+            date = spec->t_min + (spec->t_max - spec->t_min)
+                * workload_next( seed );
+        }
+        else
+        {
+            /* one fix a second, the heading drifting */
+            heading += 0.05 * workload_normal( seed );
+            step = speed * (0.8 + 0.4 * workload_next( seed ))
+                / DEGREE_METRES;
+            cos_lat = cos( y * DEG_TO_RAD );
+            if( cos_lat < 0.01 )
+                cos_lat = 0.01;
+            x += step * sin( heading ) / cos_lat;
+            y += step * cos( heading );
+            date += YEAR_SECOND;
+
+            /* turn back at the edges of the region */
+            if( x < w || x > e || y < s || y > nn )
+            {
+                heading += M_PI;
+                x = x < w ? w : x > e ? e : x;
+                y = y < s ? s : y > nn ? nn : y;
+            }
+        }
+        lon[i] = x;
+        lat[i] = y;
+        if( t != NULL )
+            t[i] = date;
+    }
+}
+
+/************************************************************************/
+/*                          workload_lattice()                          */
+/************************************************************************/
+
+static void workload_lattice( const WorkloadSpec *spec, long n,
+                              double *lon, double *lat )
+
+{
+    double w = spec->lon_max - spec->lon_min;
+    double h = spec->lat_max - spec->lat_min;
+    long cols = (long) ceil( sqrt( (double) n * w / h ) ), rows, i;
+
+    if( cols < 1 )
+        cols = 1;
+    rows = (n + cols - 1) / cols;
+    for( i = 0; i < n; i++ )
+    {
+        lon[i] = spec->lon_min + w * ((i % cols) + 0.5) / cols;
+        lat[i] = spec->lat_max - h * ((i / cols) + 0.5) / rows;
+    }
+}
+
+/************************************************************************/
+/*                            workload_poi()                            */
+/************************************************************************/
+
+static void workload_poi( const WorkloadSpec *spec, unsigned *seed,
+                          long n, double *lon, double *lat )
+
+{
+    long clusters = (n + WORKLOAD_POI_POINTS - 1) / WORKLOAD_POI_POINTS, i;
+    double *cx = (double *) pj_malloc( sizeof(double) * 2 * clusters );
+    double *cy = cx + clusters;
+    double w = spec->lon_min, e = spec->lon_max;
+    double s = spec->lat_min, nn = spec->lat_max;
+
+    if( cx == NULL )
+    {
+        for( i = 0; i < n; i++ )
+            lon[i] = lat[i] = HUGE_VAL;
+        return;
+    }
+
+    for( i = 0; i < clusters; i++ )
+    {
+        cx[i] = w + (e - w) * workload_next( seed );
+        cy[i] = s + (nn - s) * workload_next( seed );
+    }
+
+    /* within some 5 km of the centre of a cluster */
+    for( i = 0; i < n; i++ )
+    {
+        long c = (long) (clusters * workload_next( seed ));
+        double x = cx[c] + 0.05 * workload_normal( seed );
+        double y = cy[c] + 0.05 * workload_normal( seed );
+
+        lon[i] = x < w ? w : x > e ? e : x;
+        lat[i] = y < s ? s : y > nn ? nn : y;
+    }
+
+    pj_dalloc( cx );
+}
+
+/************************************************************************/
+/*                          workload_generate()                         */
+/*                                                                      */
+/*      Fill n points, in degrees, with their dates if t is not NULL.   */
+/*      The nodata points are drawn apart, so the others stay the       */
+/*      same whatever their fraction.                                   */
+/************************************************************************/
+
+void workload_generate( const WorkloadSpec *spec, long n,
+                        double *lon, double *lat, double *t )
+
+{
+    unsigned seed = spec->seed, nodata_seed = spec->seed ^ 0x5bd1e995u;
+    long i;
+
+    switch( spec->kind )
+    {
+      case WORKLOAD_TRACK:
+        workload_track( spec, &seed, n, lon, lat, t );
+        break;
+
+      case WORKLOAD_LATTICE:
+        workload_lattice( spec, n, lon, lat );
+        break;
+
+      case WORKLOAD_POI:
+        workload_poi( spec, &seed, n, lon, lat );
+        break;
+
+      case WORKLOAD_GLOBAL:
+        /* even over the sphere */
+        for( i = 0; i < n; i++ )
+        {
+            lon[i] = -180.0 + 360.0 * workload_next( &seed );
+            lat[i] = asin( 2.0 * workload_next( &seed ) - 1.0 )
+                * RAD_TO_DEG;
+        }
+        break;
+
+      default:
+        for( i = 0; i < n; i++ )
+        {
+            lon[i] = spec->lon_min + (spec->lon_max - spec->lon_min)
+                * workload_next( &seed );
+            lat[i] = spec->lat_min + (spec->lat_max - spec->lat_min)
+                * workload_next( &seed );
+        }
+        break;
+    }
+
+    if( t != NULL && spec->kind != WORKLOAD_TRACK )
+        for( i = 0; i < n; i++ )
+            t[i] = spec->t_min + (spec->t_max - spec->t_min)
+                * workload_next( &seed );
+
+    if( spec->nodata > 0.0 )
+        for( i = 0; i < n; i++ )
+            if( workload_next( &nodata_seed ) < spec->nodata )
+                lon[i] = lat[i] = HUGE_VAL;
+}
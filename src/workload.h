@@ -0,0 +1,79 @@
+/******************************************************************************
+ *
+ * Project:  PROJ.4
+ * Purpose:  Generation of the points of realistic workloads, shared by
+ *           projgen and projbench.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+#if !defined(WORKLOAD_H)
+#define WORKLOAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+** The layouts of the points, within a lon/lat region, in degrees:
+**
+**  uniform: independent points, the points of the older benchmarks.
+**  track:   GPS tracks, consecutive points a few metres apart along
+**           slowly turning headings, a new track every
+**           WORKLOAD_TRACK_POINTS points.
+**  lattice: the cell centres of a raster covering the region, row by row.
+**  poi:     points of interest, clustered around a point of the region
+**           every WORKLOAD_POI_POINTS points, each point near a random
+**           one.
+**  global:  points spread evenly over the whole sphere, ignoring the
+**           region, most of them outside of any grid.
+*/
+typedef enum {
+    WORKLOAD_UNIFORM, WORKLOAD_TRACK, WORKLOAD_LATTICE, WORKLOAD_POI,
+    WORKLOAD_GLOBAL
+} WorkloadKind;
+
+#define WORKLOAD_TRACK_POINTS 10000
+#define WORKLOAD_POI_POINTS   2000
+
+typedef struct {
+    WorkloadKind kind;
+    double       lon_min, lon_max, lat_min, lat_max;
+    double       nodata;        /* fraction of points left at HUGE_VAL */
+    double       t_min, t_max;  /* range of the dates, decimal years */
+    unsigned     seed;
+} WorkloadSpec;
+
+void workload_init( WorkloadSpec *spec, WorkloadKind kind );
+int  workload_kind( const char *name );
+const char *workload_name( WorkloadKind kind );
+int  workload_parse( WorkloadSpec *spec, const char *text );
+int  workload_region( WorkloadSpec *spec, const char *text );
+int  workload_grid_region( WorkloadSpec *spec, const char *gridname );
+void workload_generate( const WorkloadSpec *spec, long n,
+                        double *lon, double *lat, double *t );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ndef WORKLOAD_H */